@@ -26,6 +26,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <unistd.h>
 #include <zlib.h>
@@ -50,6 +51,8 @@
 #include <android-base/macros.h>
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
+#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 
 using namespace android;
 using pdx::default_transport::ServiceUtility;
@@ -337,6 +340,9 @@ static const char* k_traceStreamPath =
 static const char* k_traceMarkerPath =
     "trace_marker";
 
+static const char* k_perCpuStatsPathFormat =
+    "per_cpu/cpu%d/stats";
+
 // Check whether a file exists.
 static bool fileExists(const char* filename) {
     return access((g_traceFolder + filename).c_str(), F_OK) != -1;
@@ -897,27 +903,111 @@ static void stopTrace()
     setTracingEnabled(false);
 }
 
+// Sum the events that the kernel lost on each CPU, because they were
+// overwritten or because the buffer of the CPU was full.
+static std::vector<uint64_t> readLostEvents()
+{
+    std::vector<uint64_t> lostEvents;
+    for (int cpu = 0; ; cpu++) {
+        std::string stats;
+        std::string path = g_traceFolder +
+                android::base::StringPrintf(k_perCpuStatsPathFormat, cpu);
+        if (!android::base::ReadFileToString(path, &stats)) {
+            break;
+        }
+        uint64_t lost = 0;
+        for (const std::string& line : android::base::Split(stats, "\n")) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) {
+                continue;
+            }
+            std::string key = line.substr(0, colon);
+            if (key == "overrun" || key == "dropped events") {
+                lost += strtoull(line.c_str() + colon + 1, nullptr, 10);
+            }
+        }
+        lostEvents.push_back(lost);
+    }
+    return lostEvents;
+}
+
+// Move data from the tracing pipe to stdout through a pipe, without copying
+// it to userspace. Returns false if the data could not be moved.
+static bool spliceTrace(int traceFD)
+{
+    constexpr size_t kSpliceSize = 64 * 1024;
+    int pipeFDs[2];
+    if (pipe2(pipeFDs, O_CLOEXEC) == -1) {
+        fprintf(stderr, "error creating pipe: %s (%d)\n", strerror(errno), errno);
+        return false;
+    }
+    android::base::unique_fd readFD(pipeFDs[0]);
+    android::base::unique_fd writeFD(pipeFDs[1]);
+    while (!g_traceAborted) {
+        ssize_t bytes = splice(traceFD, nullptr, writeFD, nullptr, kSpliceSize,
+                               SPLICE_F_MOVE);
+        if (bytes <= 0) {
+            if (!g_traceAborted) {
+                fprintf(stderr, "splice returned %zd bytes err %d (%s)\n",
+                        bytes, errno, strerror(errno));
+            }
+            break;
+        }
+        while (bytes > 0) {
+            ssize_t written = TEMP_FAILURE_RETRY(splice(readFD, nullptr, STDOUT_FILENO,
+                                                        nullptr, bytes, SPLICE_F_MOVE));
+            if (written <= 0) {
+                fprintf(stderr, "error writing trace: %s (%d)\n", strerror(errno), errno);
+                return false;
+            }
+            bytes -= written;
+        }
+    }
+    return true;
+}
+
 // Read data from the tracing pipe and forward to stdout
 static void streamTrace()
 {
     char trace_data[4096];
-    int traceFD = open((g_traceFolder + k_traceStreamPath).c_str(), O_RDWR);
+    android::base::unique_fd traceFD(open((g_traceFolder + k_traceStreamPath).c_str(), O_RDWR));
     if (traceFD == -1) {
         fprintf(stderr, "error opening %s: %s (%d)\n", k_traceStreamPath,
                 strerror(errno), errno);
         return;
     }
-    while (!g_traceAborted) {
-        ssize_t bytes_read = read(traceFD, trace_data, 4096);
-        if (bytes_read > 0) {
-            write(STDOUT_FILENO, trace_data, bytes_read);
-            fflush(stdout);
-        } else {
-            if (!g_traceAborted) {
-                fprintf(stderr, "read returned %zd bytes err %d (%s)\n",
-                        bytes_read, errno, strerror(errno));
+    std::vector<uint64_t> lostBefore = readLostEvents();
+
+    // Splicing needs stdout to be a pipe, a socket or a file, terminals are
+    // written to through userspace.
+    struct stat st;
+    fflush(stdout);
+    if (fstat(STDOUT_FILENO, &st) == 0 &&
+            (S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode) || S_ISREG(st.st_mode))) {
+        spliceTrace(traceFD);
+    } else {
+        while (!g_traceAborted) {
+            ssize_t bytes_read = read(traceFD, trace_data, 4096);
+            if (bytes_read > 0) {
+                if (!android::base::WriteFully(STDOUT_FILENO, trace_data, bytes_read)) {
+                    fprintf(stderr, "error writing trace: %s (%d)\n", strerror(errno), errno);
+                    break;
+                }
+            } else {
+                if (!g_traceAborted) {
+                    fprintf(stderr, "read returned %zd bytes err %d (%s)\n",
+                            bytes_read, errno, strerror(errno));
+                }
+                break;
             }
-            break;
+        }
+    }
+
+    std::vector<uint64_t> lostAfter = readLostEvents();
+    for (size_t cpu = 0; cpu < lostAfter.size() && cpu < lostBefore.size(); cpu++) {
+        if (lostAfter[cpu] > lostBefore[cpu]) {
+            fprintf(stderr, "cpu %zu lost %" PRIu64 " events while streaming\n", cpu,
+                    lostAfter[cpu] - lostBefore[cpu]);
         }
     }
 }
@@ -45,6 +45,12 @@ uint64_t Nanotime() {
     return static_cast<uint64_t>(ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec);
 }
 
+uint64_t ThreadCpuNanotime() {
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<uint64_t>(ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec);
+}
+
 // Switches to non-root user and group.
 bool DropRootUser() {
     struct group* grp = getgrnam("shell");
@@ -51,6 +51,8 @@
 const uint64_t NANOS_PER_SEC = 1000000000;
 const uint64_t NANOS_PER_MILLI = 1000000;
 uint64_t Nanotime();
+// CPU time used by the calling thread, in nanoseconds.
+uint64_t ThreadCpuNanotime();
 
 // Switches to non-root user and group.
 bool DropRootUser();
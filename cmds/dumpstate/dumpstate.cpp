@@ -230,6 +230,8 @@ static const std::string DUMP_INCIDENT_REPORT_TASK = "INCIDENT REPORT";
 static const std::string DUMP_HALS_TASK = "DUMP HALS";
 static const std::string DUMP_BOARD_TASK = "dumpstate_board()";
 static const std::string DUMP_CHECKINS_TASK = "DUMP CHECKINS";
+static const std::string DUMP_APP_INFOS_TASK = "DUMP APP INFOS";
+static const std::string DUMP_VISIBLE_WINDOW_VIEWS_TASK = "VISIBLE WINDOW VIEWS";
 
 namespace android {
 namespace os {
@@ -819,6 +821,12 @@ static const std::set<std::string> PROBLEMATIC_FILE_EXTENSIONS = {
       ".shb", ".sys", ".vb",  ".vbe", ".vbs", ".vxd", ".wsc", ".wsf", ".wsh"
 };
 
+// List of file extensions of files that are already compressed. Deflating them again takes time
+// on the main thread and barely makes them smaller, so they are stored as they are.
+static const std::set<std::string> COMPRESSED_FILE_EXTENSIONS = {
+      ".br", ".bz2", ".gz", ".jpeg", ".jpg", ".lz4", ".mp4", ".png", ".webp", ".xz", ".zip", ".zst"
+};
+
 status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
                                       std::chrono::milliseconds timeout = 0ms) {
     if (!IsZipping()) {
@@ -827,6 +835,7 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
         return INVALID_OPERATION;
     }
     std::string valid_name = entry_name;
+    size_t flags = ZipWriter::kCompress;
 
     // Rename extension if necessary.
     size_t idx = entry_name.rfind('.');
@@ -837,11 +846,14 @@ status_t Dumpstate::AddZipEntryFromFd(const std::string& entry_name, int fd,
             valid_name = entry_name + ".renamed";
             MYLOGI("Renaming entry %s to %s\n", entry_name.c_str(), valid_name.c_str());
         }
+        if (COMPRESSED_FILE_EXTENSIONS.count(extension) != 0) {
+            flags = 0;
+        }
     }
 
     // Logging statement  below is useful to time how long each entry takes, but it's too verbose.
     // MYLOGD("Adding zip entry %s\n", entry_name.c_str());
-    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), ZipWriter::kCompress,
+    int32_t err = zip_writer_->StartEntryWithTime(valid_name.c_str(), flags,
                                                   get_mtime(fd, ds.now_));
     if (err != 0) {
         MYLOGE("zip_writer_->StartEntryWithTime(%s): %s\n", valid_name.c_str(),
@@ -1081,7 +1093,6 @@ static void DumpVisibleWindowViews() {
         MYLOGD("Not dumping visible views because it's not a zipped bugreport\n");
         return;
     }
-    DurationReporter duration_reporter("VISIBLE WINDOW VIEWS");
     const std::string path = ds.bugreport_internal_dir_ + "/tmp_visible_window_views";
     auto fd = android::base::unique_fd(TEMP_FAILURE_RETRY(open(path.c_str(),
                 O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | O_NOFOLLOW,
@@ -1094,11 +1105,11 @@ static void DumpVisibleWindowViews() {
                    CommandOptions::WithTimeout(120).Build());
     bool empty = 0 == lseek(fd, 0, SEEK_END);
     if (!empty) {
-        ds.AddZipEntry("visible_windows.zip", path);
+        ds.EnqueueAddZipEntryAndCleanupIfNeeded("visible_windows.zip", path);
     } else {
         MYLOGW("Failed to dump visible windows\n");
+        unlink(path.c_str());
     }
-    unlink(path.c_str());
 }
 
 static void DumpIpTablesAsRoot() {
@@ -1596,13 +1607,16 @@ static Dumpstate::RunStatus dumpstate() {
     // Enqueue slow functions into the thread pool, if the parallel run is enabled.
     if (ds.dump_pool_) {
         // Pool was shutdown in DumpstateDefaultAfterCritical method in order to
-        // drop root user. Restarts it with two threads for the parallel run.
-        ds.dump_pool_->start(/* thread_counts = */2);
+        // drop root user. Restarts it with three threads for the parallel run, the app infos and
+        // the visible window views mostly wait on other processes and keep a thread busy for long.
+        ds.dump_pool_->start(/* thread_counts = */3);
 
         ds.dump_pool_->enqueueTaskWithFd(DUMP_HALS_TASK, &DumpHals, _1);
         ds.dump_pool_->enqueueTask(DUMP_INCIDENT_REPORT_TASK, &DumpIncidentReport);
         ds.dump_pool_->enqueueTaskWithFd(DUMP_BOARD_TASK, &Dumpstate::DumpstateBoard, &ds, _1);
         ds.dump_pool_->enqueueTaskWithFd(DUMP_CHECKINS_TASK, &DumpCheckins, _1);
+        ds.dump_pool_->enqueueTaskWithFd(DUMP_APP_INFOS_TASK, &DumpAppInfos, _1);
+        ds.dump_pool_->enqueueTask(DUMP_VISIBLE_WINDOW_VIEWS_TASK, &DumpVisibleWindowViews);
     }
 
     // Dump various things. Note that anything that takes "long" (i.e. several seconds) should
@@ -1617,8 +1631,6 @@ static Dumpstate::RunStatus dumpstate() {
 
     RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(RunCommand, "PROCRANK", {"procrank"}, AS_ROOT_20);
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(DumpVisibleWindowViews);
-
     DumpFile("VIRTUAL MEMORY STATS", "/proc/vmstat");
     DumpFile("VMALLOC INFO", "/proc/vmallocinfo");
     DumpFile("SLAB INFO", "/proc/slabinfo");
@@ -1768,7 +1780,11 @@ static Dumpstate::RunStatus dumpstate() {
         RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK_AND_LOG(DUMP_CHECKINS_TASK, DumpCheckins);
     }
 
-    RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK(DumpAppInfos);
+    if (ds.dump_pool_) {
+        WAIT_TASK_WITH_CONSENT_CHECK(DUMP_APP_INFOS_TASK, ds.dump_pool_);
+    } else {
+        RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK_AND_LOG(DUMP_APP_INFOS_TASK, DumpAppInfos);
+    }
 
     printf("========================================================\n");
     printf("== Dropbox crashes\n");
@@ -1803,6 +1819,13 @@ static Dumpstate::RunStatus dumpstate() {
                 DumpIncidentReport);
     }
 
+    if (ds.dump_pool_) {
+        WAIT_TASK_WITH_CONSENT_CHECK(DUMP_VISIBLE_WINDOW_VIEWS_TASK, ds.dump_pool_);
+    } else {
+        RUN_SLOW_FUNCTION_WITH_CONSENT_CHECK_AND_LOG(DUMP_VISIBLE_WINDOW_VIEWS_TASK,
+                DumpVisibleWindowViews);
+    }
+
     return Dumpstate::RunStatus::OK;
 }
 
@@ -2394,6 +2417,13 @@ bool Dumpstate::FinishZipFile() {
         MYLOGE("Failed to add main_entry.txt to .zip file\n");
         return false;
     }
+    {
+        std::lock_guard<std::mutex> lock(section_stats_lock_);
+        if (!AddTextZipEntry("dumpstate_sections.txt",
+                             "section\twall_ms\tcpu_ms\tbytes\n" + section_stats_)) {
+            MYLOGE("Failed to add dumpstate_sections.txt to .zip file\n");
+        }
+    }
 
     // Add log file (which contains stderr output) to zip...
     fprintf(stderr, "dumpstate_log.txt entry on zip file logged up to here\n");
@@ -3279,12 +3309,15 @@ DurationReporter::DurationReporter(const std::string& title, bool logcat_only, b
         duration_fd_(duration_fd) {
     if (!title_.empty()) {
         started_ = Nanotime();
+        cpu_started_ = ThreadCpuNanotime();
+        offset_started_ = lseek(duration_fd_, 0, SEEK_CUR);
     }
 }
 
 DurationReporter::~DurationReporter() {
     if (!title_.empty()) {
-        float elapsed = (float)(Nanotime() - started_) / NANOS_PER_SEC;
+        uint64_t wall_ns = Nanotime() - started_;
+        float elapsed = (float)wall_ns / NANOS_PER_SEC;
         if (elapsed >= .5f || verbose_) {
             MYLOGD("Duration of '%s': %.2fs\n", title_.c_str(), elapsed);
         }
@@ -3293,9 +3326,21 @@ DurationReporter::~DurationReporter() {
             dprintf(duration_fd_, "------ %.3fs was the duration of '%s' ------\n",
                     elapsed, title_.c_str());
         }
+        off_t offset = offset_started_ == -1 ? -1 : lseek(duration_fd_, 0, SEEK_CUR);
+        ds.AddSectionStats(title_, wall_ns, ThreadCpuNanotime() - cpu_started_,
+                           offset == -1 ? -1 : offset - offset_started_);
     }
 }
 
+void Dumpstate::AddSectionStats(const std::string& title, uint64_t wall_ns, uint64_t cpu_ns,
+                                int64_t bytes) {
+    std::string line = StringPrintf("%s\t%" PRIu64 "\t%" PRIu64 "\t%" PRId64 "\n",
+                                    title.c_str(), wall_ns / NANOS_PER_MILLI,
+                                    cpu_ns / NANOS_PER_MILLI, bytes);
+    std::lock_guard<std::mutex> lock(section_stats_lock_);
+    section_stats_ += line;
+}
+
 const int32_t Progress::kDefaultMax = 5000;
 
 Progress::Progress(const std::string& path) : Progress(Progress::kDefaultMax, 1.1, path) {
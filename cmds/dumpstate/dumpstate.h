@@ -68,7 +68,9 @@ extern "C" {
 #endif
 
 /*
- * Helper class used to report how long it takes for a section to finish.
+ * Helper class used to report how long it takes for a section to finish. The wall time, the CPU
+ * time of the calling thread and the bytes written to |duration_fd| are also recorded, so that
+ * they can be added to the zip file (see Dumpstate::AddSectionStats).
  *
  * Typical usage:
  *
@@ -87,6 +89,8 @@ class DurationReporter {
     bool logcat_only_;
     bool verbose_;
     uint64_t started_;
+    uint64_t cpu_started_;
+    off_t offset_started_;
     int duration_fd_;
 
     DISALLOW_COPY_AND_ASSIGN(DurationReporter);
@@ -288,6 +292,15 @@ class Dumpstate {
      */
     bool AddTextZipEntry(const std::string& entry_name, const std::string& content);
 
+    /*
+     * Records the stats of a finished section, they are added to the zip file as
+     * dumpstate_sections.txt with one tab separated line per section.
+     *
+     * |bytes| is the number of bytes the section wrote to its output, or -1 if it is unknown.
+     */
+    void AddSectionStats(const std::string& title, uint64_t wall_ns, uint64_t cpu_ns,
+                         int64_t bytes);
+
     /*
      * Adds all files from a directory to the zipped bugreport file.
      */
@@ -520,6 +533,11 @@ class Dumpstate {
     // parallel run is enabled.
     std::unique_ptr<android::os::dumpstate::TaskQueue> zip_entry_tasks_;
 
+    // Stats of the finished sections, as added by AddSectionStats. Sections running in the
+    // DumpPool finish on its threads, hence the lock.
+    std::mutex section_stats_lock_;
+    std::string section_stats_;
+
     // A callback to IncidentCompanion service, which checks user consent for sharing the
     // bugreport with the calling app. If the user has not responded yet to the dialog it will
     // be neither confirmed nor denied.
@@ -15,13 +15,16 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <future>
 #include <iomanip>
 #include <thread>
 
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <android-base/unique_fd.h>
+#include <binder/BinderStats.h>
 #include <binder/Parcel.h>
 #include <binder/ProcessState.h>
 #include <binder/TextOutput.h>
@@ -33,9 +36,11 @@
 #include <iostream>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
@@ -61,7 +66,9 @@ static void usage() {
             "usage: dumpsys\n"
             "         To dump all services.\n"
             "or:\n"
-            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--thread] [--help | -l | "
+            "       dumpsys [-t TIMEOUT] [--priority LEVEL] [--pid] [--thread] [--parcel-pool] "
+            "[--binder-stats] [--jobs JOBS] "
+            "[--help | -l | "
             "--skip SERVICES "
             "| SERVICE [ARGS]]\n"
             "         --help: shows this help\n"
@@ -70,10 +77,15 @@ static void usage() {
             "         -T TIMEOUT_MS: TIMEOUT to use in milliseconds instead of default 10 seconds\n"
             "         --pid: dump PID instead of usual dump\n"
             "         --thread: dump thread usage instead of usual dump\n"
+            "         --parcel-pool: dump Parcel buffer pool counters instead of usual dump\n"
+            "         --binder-stats: dump per-transaction-code counts and latencies instead of\n"
+            "               usual dump\n"
             "         --proto: filter services that support dumping data in proto format. Dumps\n"
             "               will be in proto format.\n"
             "         --priority LEVEL: filter services based on specified priority\n"
             "               LEVEL must be one of CRITICAL | HIGH | NORMAL\n"
+            "         --jobs JOBS: dumps up to JOBS services at once, the output of each service\n"
+            "               is still written in one piece and in the usual order\n"
             "         --skip SERVICES: dumps all services but SERVICES (comma-separated list)\n"
             "         SERVICE [ARGS]: dumps only service SERVICE, optionally passing ARGS to it\n");
 }
@@ -127,11 +139,15 @@ int Dumpsys::main(int argc, char* const argv[]) {
     bool asProto = false;
     Type type = Type::DUMP;
     int timeoutArgMs = 10000;
+    int jobs = 1;
     int priorityFlags = IServiceManager::DUMP_FLAG_PRIORITY_ALL;
     static struct option longOptions[] = {{"thread", no_argument, 0, 0},
                                           {"pid", no_argument, 0, 0},
+                                          {"parcel-pool", no_argument, 0, 0},
+                                          {"binder-stats", no_argument, 0, 0},
                                           {"priority", required_argument, 0, 0},
                                           {"proto", no_argument, 0, 0},
+                                          {"jobs", required_argument, 0, 0},
                                           {"skip", no_argument, 0, 0},
                                           {"help", no_argument, 0, 0},
                                           {0, 0, 0, 0}};
@@ -165,10 +181,21 @@ int Dumpsys::main(int argc, char* const argv[]) {
                     usage();
                     return -1;
                 }
+            } else if (!strcmp(longOptions[optionIndex].name, "jobs")) {
+                char* endptr;
+                jobs = strtol(optarg, &endptr, 10);
+                if (*endptr != '\0' || jobs <= 0) {
+                    fprintf(stderr, "Error: invalid jobs number: '%s'\n", optarg);
+                    return -1;
+                }
             } else if (!strcmp(longOptions[optionIndex].name, "pid")) {
                 type = Type::PID;
             } else if (!strcmp(longOptions[optionIndex].name, "thread")) {
                 type = Type::THREAD;
+            } else if (!strcmp(longOptions[optionIndex].name, "parcel-pool")) {
+                type = Type::PARCEL_POOL;
+            } else if (!strcmp(longOptions[optionIndex].name, "binder-stats")) {
+                type = Type::BINDER_STATS;
             }
             break;
 
@@ -254,37 +281,115 @@ int Dumpsys::main(int argc, char* const argv[]) {
         return 0;
     }
 
+    Vector<String16> dumpedServices;
     for (size_t i = 0; i < N; i++) {
-        const String16& serviceName = services[i];
-        if (IsSkipped(skippedServices, serviceName)) continue;
+        if (!IsSkipped(skippedServices, services[i])) {
+            dumpedServices.add(services[i]);
+        }
+    }
 
-        if (startDumpThread(type, serviceName, args) == OK) {
-            bool addSeparator = (N > 1);
-            if (addSeparator) {
-                writeDumpHeader(STDOUT_FILENO, serviceName, priorityFlags);
-            }
-            std::chrono::duration<double> elapsedDuration;
-            size_t bytesWritten = 0;
-            status_t status =
-                writeDump(STDOUT_FILENO, serviceName, std::chrono::milliseconds(timeoutArgMs),
-                          asProto, elapsedDuration, bytesWritten);
-
-            if (status == TIMED_OUT) {
-                std::cout << std::endl
-                     << "*** SERVICE '" << serviceName << "' DUMP TIMEOUT (" << timeoutArgMs
-                     << "ms) EXPIRED ***" << std::endl
-                     << std::endl;
+    const std::chrono::milliseconds timeout(timeoutArgMs);
+    const bool addSeparator = (N > 1);
+    if (jobs > 1 && dumpedServices.size() > 1) {
+        dumpServicesInParallel(jobs, type, dumpedServices, args, priorityFlags, addSeparator,
+                               timeout, asProto);
+        return 0;
+    }
+
+    for (const String16& serviceName : dumpedServices) {
+        dumpService(STDOUT_FILENO, type, serviceName, args, priorityFlags, addSeparator, timeout,
+                    asProto);
+    }
+
+    return 0;
+}
+
+void Dumpsys::dumpService(int fd, Type type, const String16& serviceName,
+                          const Vector<String16>& args, int priorityFlags, bool addSeparator,
+                          std::chrono::milliseconds timeout, bool asProto) {
+    if (startDumpThread(type, serviceName, args) != OK) {
+        return;
+    }
+    if (addSeparator) {
+        writeDumpHeader(fd, serviceName, priorityFlags);
+    }
+    std::chrono::duration<double> elapsedDuration;
+    size_t bytesWritten = 0;
+    status_t status = writeDump(fd, serviceName, timeout, asProto, elapsedDuration, bytesWritten);
+
+    if (status == TIMED_OUT) {
+        WriteStringToFd(StringPrintf("\n*** SERVICE '%s' DUMP TIMEOUT (%lldms) EXPIRED ***\n\n",
+                                     String8(serviceName).string(),
+                                     static_cast<long long>(timeout.count())),
+                        fd);
+    }
+
+    if (addSeparator) {
+        writeDumpFooter(fd, serviceName, elapsedDuration);
+    }
+    bool dumpComplete = (status == OK);
+    stopDumpThread(dumpComplete);
+}
+
+void Dumpsys::dumpServicesInParallel(int jobs, Type type, const Vector<String16>& services,
+                                     const Vector<String16>& args, int priorityFlags,
+                                     bool addSeparator, std::chrono::milliseconds timeout,
+                                     bool asProto) {
+    // Each service is dumped into its own memory file by one of the workers, and the dumps are
+    // then copied to stdout in the order of the services, so that they don't interleave.
+    std::vector<std::promise<unique_fd>> dumps(services.size());
+    std::vector<std::future<unique_fd>> results;
+    for (std::promise<unique_fd>& dump : dumps) {
+        results.push_back(dump.get_future());
+    }
+
+    std::atomic<size_t> nextService(0);
+    auto dumpServices = [&]() {
+        // The dump thread and the pipe of a service belong to a Dumpsys, so each worker needs
+        // its own.
+        Dumpsys dumpsys(sm_);
+        for (size_t i = nextService++; i < services.size(); i = nextService++) {
+            unique_fd dumpFd(memfd_create("dumpsys", MFD_CLOEXEC));
+            if (dumpFd == -1) {
+                std::cerr << "Failed to create memory file to dump " << services[i] << ": "
+                          << strerror(errno) << std::endl;
+            } else {
+                dumpsys.dumpService(dumpFd.get(), type, services[i], args, priorityFlags,
+                                    addSeparator, timeout, asProto);
             }
+            dumps[i].set_value(std::move(dumpFd));
+        }
+    };
 
-            if (addSeparator) {
-                writeDumpFooter(STDOUT_FILENO, serviceName, elapsedDuration);
+    std::vector<std::thread> workers;
+    const size_t workerCount = std::min(static_cast<size_t>(jobs), services.size());
+    for (size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back(dumpServices);
+    }
+
+    for (size_t i = 0; i < services.size(); i++) {
+        unique_fd dumpFd = results[i].get();
+        if (dumpFd == -1) {
+            // The service could not be dumped aside, so it is dumped on this thread instead.
+            dumpService(STDOUT_FILENO, type, services[i], args, priorityFlags, addSeparator,
+                        timeout, asProto);
+            continue;
+        }
+        char buf[4096];
+        ssize_t rc;
+        lseek(dumpFd.get(), 0, SEEK_SET);
+        while ((rc = TEMP_FAILURE_RETRY(read(dumpFd.get(), buf, sizeof(buf)))) > 0) {
+            if (!WriteFully(STDOUT_FILENO, buf, rc)) {
+                std::cerr << "Failed to write dump of service " << services[i] << ": "
+                          << strerror(errno) << std::endl;
+                break;
             }
-            bool dumpComplete = (status == OK);
-            stopDumpThread(dumpComplete);
         }
     }
 
-    return 0;
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
 }
 
 Vector<String16> Dumpsys::listServices(int priorityFilterFlags, bool filterByProto) const {
@@ -352,6 +457,51 @@ static status_t dumpThreadsToFd(const sp<IBinder>& service, const unique_fd& fd)
     return OK;
 }
 
+static status_t dumpParcelPoolToFd(const sp<IBinder>& service, const unique_fd& fd) {
+    uint64_t hits, misses, cachedBytes;
+    status_t status = service->getDebugParcelPoolStats(&hits, &misses, &cachedBytes);
+    if (status != OK) {
+        return status;
+    }
+    WriteStringToFd("Parcel buffer pool hits: " + std::to_string(hits) +
+                        ", misses: " + std::to_string(misses) +
+                        ", cached: " + std::to_string(cachedBytes) + " bytes\n",
+                    fd.get());
+    return OK;
+}
+
+// upper bound of the latency bucket holding the given percentile, in microseconds
+static uint64_t latencyPercentileUs(const BinderTransactionStats& stats, uint64_t percentile) {
+    uint64_t target = (stats.count * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BinderTransactionStats::kNumLatencyBuckets; i++) {
+        seen += stats.latencyBuckets[i];
+        if (seen >= target) return 2ull << i;
+    }
+    return 2ull << (BinderTransactionStats::kNumLatencyBuckets - 1);
+}
+
+static status_t dumpBinderStatsToFd(const sp<IBinder>& service, const unique_fd& fd) {
+    std::vector<BinderTransactionStats> allStats;
+    status_t status = service->getDebugTransactionStats(&allStats);
+    if (status != OK) {
+        return status;
+    }
+    std::sort(allStats.begin(), allStats.end(),
+              [](const auto& lhs, const auto& rhs) { return lhs.code < rhs.code; });
+
+    std::string msg = "Binder transaction stats: " + std::to_string(allStats.size()) + " codes\n";
+    for (const BinderTransactionStats& stats : allStats) {
+        StringAppendF(&msg,
+                      "  code %u: count %" PRIu64 ", data %" PRIu64 " bytes, reply %" PRIu64
+                      " bytes, latency p50 < %" PRIu64 "us, p99 < %" PRIu64 "us\n",
+                      stats.code, stats.count, stats.dataBytes, stats.replyBytes,
+                      latencyPercentileUs(stats, 50), latencyPercentileUs(stats, 99));
+    }
+    WriteStringToFd(msg, fd.get());
+    return OK;
+}
+
 status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
                                   const Vector<String16>& args) {
     sp<IBinder> service = sm_->checkService(serviceName);
@@ -385,6 +535,12 @@ status_t Dumpsys::startDumpThread(Type type, const String16& serviceName,
         case Type::THREAD:
             err = dumpThreadsToFd(service, remote_end);
             break;
+        case Type::PARCEL_POOL:
+            err = dumpParcelPoolToFd(service, remote_end);
+            break;
+        case Type::BINDER_STATS:
+            err = dumpBinderStatsToFd(service, remote_end);
+            break;
         default:
             std::cerr << "Unknown dump type" << static_cast<int>(type) << std::endl;
             return;
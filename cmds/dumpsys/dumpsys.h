@@ -52,9 +52,11 @@ class Dumpsys {
     static void setServiceArgs(Vector<String16>& args, bool asProto, int priorityFlags);
 
     enum class Type {
-        DUMP,    // dump using `dump` function
-        PID,     // dump pid of server only
-        THREAD,  // dump thread usage of server only
+        DUMP,         // dump using `dump` function
+        PID,          // dump pid of server only
+        THREAD,       // dump thread usage of server only
+        PARCEL_POOL,  // dump Parcel buffer pool counters of server only
+        BINDER_STATS, // dump per-code transaction stats of server only
     };
 
     /**
@@ -123,6 +125,23 @@ class Dumpsys {
     }
 
   private:
+    /**
+     * Dumps a service to a file descriptor, between a section header and footer if
+     * {@code addSeparator} is set.
+     */
+    void dumpService(int fd, Type type, const String16& serviceName, const Vector<String16>& args,
+                     int priorityFlags, bool addSeparator, std::chrono::milliseconds timeout,
+                     bool asProto);
+
+    /**
+     * Dumps services to stdout with up to {@code jobs} of them being dumped at once. The output
+     * of each service is written in one piece, in the order of {@code services}.
+     */
+    void dumpServicesInParallel(int jobs, Type type, const Vector<String16>& services,
+                                const Vector<String16>& args, int priorityFlags,
+                                bool addSeparator, std::chrono::milliseconds timeout,
+                                bool asProto);
+
     android::IServiceManager* sm_;
     std::thread activeThread_;
     mutable android::base::unique_fd redirectFd_;
@@ -447,6 +447,24 @@ TEST_F(DumpsysTest, DumpMultipleServices) {
     AssertDumped("running3", "dump3");
 }
 
+// Tests 'dumpsys --jobs 2' with a slow service, which should keep the dumps in order
+TEST_F(DumpsysTest, DumpMultipleServicesInParallel) {
+    ExpectListServices({"running1", "stopped2", "running3", "running4"});
+    ExpectDumpAndHang("running1", 1, "dump1");
+    ExpectCheckService("stopped2", false);
+    ExpectDump("running3", "dump3");
+    ExpectDump("running4", "dump4");
+
+    CallMain({"--jobs", "2"});
+
+    AssertRunningServices({"running1", "running3", "running4"});
+    AssertDumped("running1", "dump1");
+    AssertStopped("stopped2");
+    AssertDumped("running3", "dump3");
+    AssertDumped("running4", "dump4");
+    AssertOutputFormat("(.|\n)*dump1(.|\n)*dump3(.|\n)*dump4(.|\n)*");
+}
+
 // Tests 'dumpsys --skip skipped3 skipped5', which should skip these services
 TEST_F(DumpsysTest, DumpWithSkip) {
     ExpectListServices({"running1", "stopped2", "skipped3", "running4", "skipped5"});
@@ -606,6 +624,26 @@ TEST_F(DumpsysTest, ListServiceWithThread) {
     AssertOutputFormat(format);
 }
 
+// Tests 'dumpsys --parcel-pool service_name'
+TEST_F(DumpsysTest, ListServiceWithParcelPool) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--parcel-pool", "Locksmith"});
+
+    const std::string format(
+            "Parcel buffer pool hits: [0-9]+, misses: [0-9]+, cached: [0-9]+ bytes\n");
+    AssertOutputFormat(format);
+}
+
+// Tests 'dumpsys --binder-stats service_name'
+TEST_F(DumpsysTest, ListServiceWithBinderStats) {
+    ExpectCheckService("Locksmith");
+
+    CallMain({"--binder-stats", "Locksmith"});
+
+    AssertOutputFormat("Binder transaction stats: [0-9]+ codes\n(  code [0-9]+: .*\n)*");
+}
+
 TEST_F(DumpsysTest, GetBytesWritten) {
     const char* serviceName = "service2";
     const char* dumpContents = "dump1";
@@ -18,6 +18,7 @@
 
 #include "CacheTracker.h"
 
+#include <algorithm>
 #include <fts.h>
 #include <sys/xattr.h>
 #include <utils/Trace.h>
@@ -161,6 +162,21 @@ void CacheTracker::loadItemsFrom(const std::string& path) {
     fts_close(fts);
 }
 
+// Orders items from the last to the first one to purge, so that the items to purge first are the
+// least recently modified ones, and then the deepest ones, files before directories.
+static bool compareItems(const std::shared_ptr<CacheItem>& left,
+        const std::shared_ptr<CacheItem>& right) {
+    // TODO: sort dotfiles last
+    // TODO: sort code_cache last
+    if (left->modified != right->modified) {
+        return (left->modified > right->modified);
+    }
+    if (left->level != right->level) {
+        return (left->level < right->level);
+    }
+    return left->directory && !right->directory;
+}
+
 void CacheTracker::loadItems() {
     items.clear();
 
@@ -171,22 +187,20 @@ void CacheTracker::loadItems() {
     }
     ATRACE_END();
 
+    // Only the items that are purged before enough space is free are ever looked at, so they are
+    // kept in a heap rather than fully sorted.
     ATRACE_BEGIN("sortItems");
-    auto cmp = [](std::shared_ptr<CacheItem> left, std::shared_ptr<CacheItem> right) {
-        // TODO: sort dotfiles last
-        // TODO: sort code_cache last
-        if (left->modified != right->modified) {
-            return (left->modified > right->modified);
-        }
-        if (left->level != right->level) {
-            return (left->level < right->level);
-        }
-        return left->directory;
-    };
-    std::stable_sort(items.begin(), items.end(), cmp);
+    std::make_heap(items.begin(), items.end(), compareItems);
     ATRACE_END();
 }
 
+std::shared_ptr<CacheItem> CacheTracker::popItem() {
+    std::pop_heap(items.begin(), items.end(), compareItems);
+    auto item = items.back();
+    items.pop_back();
+    return item;
+}
+
 void CacheTracker::ensureItems() {
     if (mItemsLoaded) {
         return;
@@ -51,11 +51,15 @@ public:
 
     void ensureItems();
 
+    /** Removes and returns the loaded item to purge first. */
+    std::shared_ptr<CacheItem> popItem();
+
     int getCacheRatio();
 
     int64_t cacheUsed;
     int64_t cacheQuota;
 
+    /** Loaded items, kept as a heap that popItem() takes them from. */
     std::vector<std::shared_ptr<CacheItem>> items;
 
 private:
@@ -30,7 +30,7 @@
 #include <vector>
 
 #ifndef CRATE_DEBUG
-#define CRATE_DEBUG 1
+#define CRATE_DEBUG 0
 #endif
 
 namespace android {
@@ -19,6 +19,8 @@
 #define ATRACE_TAG ATRACE_TAG_PACKAGE_MANAGER
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <errno.h>
 #include <fstream>
 #include <fts.h>
@@ -38,6 +40,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
+#include <thread>
 #include <unistd.h>
 
 #include <android-base/file.h>
@@ -88,7 +91,6 @@ static constexpr const char* kTestUuid = "TEST";
 
 static constexpr const mode_t kRollbackFolderMode = 0700;
 
-static constexpr const char* kCpPath = "/system/bin/cp";
 static constexpr const char* kXattrDefault = "user.default";
 
 static constexpr const char* kDataMirrorCePath = "/data_mirror/data_ce";
@@ -307,6 +309,14 @@ status_t InstalldNativeService::dump(int fd, const Vector<String16> & /* args */
         }
     }
 
+    out << endl << "Dexopt jobs:" << endl;
+    for (const auto& n : mDexoptStats) {
+        const DexoptStats& stats = n.second;
+        out << "    " << n.first << ": count=" << stats.count << " failures=" << stats.failures
+                << " wall=" << stats.wallTimeMs << "ms max=" << stats.maxWallTimeMs
+                << "ms cpu=" << stats.cpuTimeMs << "ms" << endl;
+    }
+
     out << endl;
     out.flush();
 
@@ -790,123 +800,137 @@ static gid_t get_cache_gid(uid_t uid) {
     return (gid != -1) ? gid : uid;
 }
 
-binder::Status InstalldNativeService::fixupAppData(const std::optional<std::string>& uuid,
-        int32_t flags) {
-    ENFORCE_UID(AID_SYSTEM);
-    CHECK_ARGUMENT_UUID(uuid);
-    std::lock_guard<std::recursive_mutex> lock(mLock);
+// Most threads fixing up the app data trees of a single fixupAppData() call.
+static constexpr size_t kFixupThreads = 4;
 
-    const char* uuid_ = uuid ? uuid->c_str() : nullptr;
-    for (auto user : get_known_users(uuid_)) {
-        ATRACE_BEGIN("fixup user");
-        FTS* fts;
-        FTSENT* p;
-        auto ce_path = create_data_user_ce_path(uuid_, user);
-        auto de_path = create_data_user_de_path(uuid_, user);
-        char *argv[] = { (char*) ce_path.c_str(), (char*) de_path.c_str(), nullptr };
-        if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
-            return error("Failed to fts_open");
-        }
-        while ((p = fts_read(fts)) != nullptr) {
-            if (p->fts_info == FTS_D && p->fts_level == 1) {
-                // Track down inodes of cache directories
-                uint64_t raw = 0;
-                ino_t inode_cache = 0;
-                ino_t inode_code_cache = 0;
-                if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_cache = raw;
-                }
-                if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
-                    inode_code_cache = raw;
-                }
+// Fixes up the GIDs of the app data below a CE or DE user directory.
+static bool fixup_app_data_tree(const std::string& path, int32_t flags) {
+    ATRACE_BEGIN("fixup user");
+    FTS* fts;
+    FTSENT* p;
+    char *argv[] = { (char*) path.c_str(), nullptr };
+    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
+        PLOG(ERROR) << "Failed to fts_open " << path;
+        ATRACE_END();
+        return false;
+    }
+    while ((p = fts_read(fts)) != nullptr) {
+        if (p->fts_info == FTS_D && p->fts_level == 1) {
+            // Track down inodes of cache directories
+            uint64_t raw = 0;
+            ino_t inode_cache = 0;
+            ino_t inode_code_cache = 0;
+            if (getxattr(p->fts_path, kXattrInodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_cache = raw;
+            }
+            if (getxattr(p->fts_path, kXattrInodeCodeCache, &raw, sizeof(raw)) == sizeof(raw)) {
+                inode_code_cache = raw;
+            }
 
-                // Figure out expected GID of each child
-                FTSENT* child = fts_children(fts, 0);
-                while (child != nullptr) {
-                    if ((child->fts_statp->st_ino == inode_cache)
-                            || (child->fts_statp->st_ino == inode_code_cache)
-                            || !strcmp(child->fts_name, "cache")
-                            || !strcmp(child->fts_name, "code_cache")) {
-                        child->fts_number = get_cache_gid(p->fts_statp->st_uid);
-                    } else {
-                        child->fts_number = p->fts_statp->st_uid;
-                    }
-                    child = child->fts_link;
-                }
-            } else if (p->fts_level >= 2) {
-                if (p->fts_level > 2) {
-                    // Inherit GID from parent once we're deeper into tree
-                    p->fts_number = p->fts_parent->fts_number;
+            // Figure out expected GID of each child
+            FTSENT* child = fts_children(fts, 0);
+            while (child != nullptr) {
+                if ((child->fts_statp->st_ino == inode_cache)
+                        || (child->fts_statp->st_ino == inode_code_cache)
+                        || !strcmp(child->fts_name, "cache")
+                        || !strcmp(child->fts_name, "code_cache")) {
+                    child->fts_number = get_cache_gid(p->fts_statp->st_uid);
+                } else {
+                    child->fts_number = p->fts_statp->st_uid;
                 }
+                child = child->fts_link;
+            }
+        } else if (p->fts_level >= 2) {
+            if (p->fts_level > 2) {
+                // Inherit GID from parent once we're deeper into tree
+                p->fts_number = p->fts_parent->fts_number;
+            }
 
-                uid_t uid = p->fts_parent->fts_statp->st_uid;
-                gid_t cache_gid = get_cache_gid(uid);
-                gid_t expected = p->fts_number;
-                gid_t actual = p->fts_statp->st_gid;
-                if (actual == expected) {
+            uid_t uid = p->fts_parent->fts_statp->st_uid;
+            gid_t cache_gid = get_cache_gid(uid);
+            gid_t expected = p->fts_number;
+            gid_t actual = p->fts_statp->st_gid;
+            if (actual == expected) {
 #if FIXUP_DEBUG
-                    LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
+                LOG(DEBUG) << "Ignoring " << p->fts_path << " with expected GID " << expected;
 #endif
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
-                    }
-                } else if ((actual == uid) || (actual == cache_gid)) {
-                    // Only consider fixing up when current GID belongs to app
-                    if (p->fts_info != FTS_D) {
-                        LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
-                                << " instead of " << expected;
-                    }
-                    switch (p->fts_info) {
-                    case FTS_DP:
-                        // If we're moving towards cache GID, we need to set S_ISGID
-                        if (expected == cache_gid) {
-                            if (chmod(p->fts_path, 02771) != 0) {
-                                PLOG(WARNING) << "Failed to chmod " << p->fts_path;
-                            }
-                        }
-                        [[fallthrough]]; // also set GID
-                    case FTS_F:
-                        if (chown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
-                        }
-                        break;
-                    case FTS_SL:
-                    case FTS_SLNONE:
-                        if (lchown(p->fts_path, -1, expected) != 0) {
-                            PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
+                }
+            } else if ((actual == uid) || (actual == cache_gid)) {
+                // Only consider fixing up when current GID belongs to app
+                if (p->fts_info != FTS_D) {
+                    LOG(INFO) << "Fixing " << p->fts_path << " with unexpected GID " << actual
+                            << " instead of " << expected;
+                }
+                switch (p->fts_info) {
+                case FTS_DP:
+                    // If we're moving towards cache GID, we need to set S_ISGID
+                    if (expected == cache_gid) {
+                        if (chmod(p->fts_path, 02771) != 0) {
+                            PLOG(WARNING) << "Failed to chmod " << p->fts_path;
                         }
-                        break;
                     }
-                } else {
-                    // Ignore all other GID transitions, since they're kinda shady
-                    LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
-                            << " instead of " << expected;
-                    if (!(flags & FLAG_FORCE)) {
-                        fts_set(fts, p, FTS_SKIP);
+                    [[fallthrough]]; // also set GID
+                case FTS_F:
+                    if (chown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
+                    }
+                    break;
+                case FTS_SL:
+                case FTS_SLNONE:
+                    if (lchown(p->fts_path, -1, expected) != 0) {
+                        PLOG(WARNING) << "Failed to chown " << p->fts_path;
                     }
+                    break;
+                }
+            } else {
+                // Ignore all other GID transitions, since they're kinda shady
+                LOG(WARNING) << "Ignoring " << p->fts_path << " with unexpected GID " << actual
+                        << " instead of " << expected;
+                if (!(flags & FLAG_FORCE)) {
+                    fts_set(fts, p, FTS_SKIP);
                 }
             }
         }
-        fts_close(fts);
-        ATRACE_END();
     }
-    return ok();
+    fts_close(fts);
+    ATRACE_END();
+    return true;
 }
 
-static int32_t copy_directory_recursive(const char* from, const char* to) {
-    char *argv[] = {
-        (char*) kCpPath,
-        (char*) "-F", /* delete any existing destination file first (--remove-destination) */
-        (char*) "-p", /* preserve timestamps, ownership, and permissions */
-        (char*) "-R", /* recurse into subdirectories (DEST must be a directory) */
-        (char*) "-P", /* Do not follow symlinks [default] */
-        (char*) "-d", /* don't dereference symlinks */
-        (char*) from,
-        (char*) to
-    };
+binder::Status InstalldNativeService::fixupAppData(const std::optional<std::string>& uuid,
+        int32_t flags) {
+    ENFORCE_UID(AID_SYSTEM);
+    CHECK_ARGUMENT_UUID(uuid);
+    std::lock_guard<std::recursive_mutex> lock(mLock);
 
-    LOG(DEBUG) << "Copying " << from << " to " << to;
-    return logwrap_fork_execvp(ARRAY_SIZE(argv), argv, nullptr, false, LOG_ALOG, false, nullptr);
+    const char* uuid_ = uuid ? uuid->c_str() : nullptr;
+    std::vector<std::string> paths;
+    for (auto user : get_known_users(uuid_)) {
+        paths.push_back(create_data_user_ce_path(uuid_, user));
+        paths.push_back(create_data_user_de_path(uuid_, user));
+    }
+
+    // The trees don't share any app directory, so they are fixed up on several threads at once.
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto fixup = [&]() {
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            if (!fixup_app_data_tree(paths[i], flags)) {
+                failed = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(paths.size(), kFixupThreads); i++) {
+        threads.emplace_back(fixup);
+    }
+    fixup();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return failed ? error("Failed to fts_open") : ok();
 }
 
 binder::Status InstalldNativeService::snapshotAppData(
@@ -968,7 +992,7 @@ binder::Status InstalldNativeService::snapshotAppData(
 
         // Check if we have data to copy.
         if (access(from.c_str(), F_OK) == 0) {
-          rc = copy_directory_recursive(from.c_str(), to.c_str());
+          rc = copy_directory_recursive(from, to);
         }
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
@@ -1018,7 +1042,7 @@ binder::Status InstalldNativeService::snapshotAppData(
             return error(rc, "Failed clearing existing snapshot " + rollback_package_path);
         }
 
-        rc = copy_directory_recursive(from.c_str(), to.c_str());
+        rc = copy_directory_recursive(from, to);
         if (rc != 0) {
             res = error(rc, "Failed copying " + from + " to " + to);
             clear_ce_on_exit = true;
@@ -1082,7 +1106,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
 
     if (needs_ce_rollback) {
         auto to_ce = create_data_user_ce_path(volume_uuid, user);
-        int rc = copy_directory_recursive(from_ce.c_str(), to_ce.c_str());
+        int rc = copy_directory_recursive(from_ce, to_ce);
         if (rc != 0) {
             res = error(rc, "Failed copying " + from_ce + " to " + to_ce);
             return res;
@@ -1092,7 +1116,7 @@ binder::Status InstalldNativeService::restoreAppDataSnapshot(
 
     if (needs_de_rollback) {
         auto to_de = create_data_user_de_path(volume_uuid, user);
-        int rc = copy_directory_recursive(from_de.c_str(), to_de.c_str());
+        int rc = copy_directory_recursive(from_de, to_de);
         if (rc != 0) {
             if (needs_ce_rollback) {
                 auto ce_data = create_data_user_ce_package_path(volume_uuid, user, package_name);
@@ -1237,7 +1261,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::optional<std::s
             auto from = create_data_user_de_package_path(from_uuid, user, package_name);
             auto to = create_data_user_de_path(to_uuid, user);
 
-            int rc = copy_directory_recursive(from.c_str(), to.c_str());
+            int rc = copy_directory_recursive(from, to);
             if (rc != 0) {
                 res = error(rc, "Failed copying " + from + " to " + to);
                 goto fail;
@@ -1247,7 +1271,7 @@ binder::Status InstalldNativeService::moveCompleteApp(const std::optional<std::s
             auto from = create_data_user_ce_package_path(from_uuid, user, package_name);
             auto to = create_data_user_ce_path(to_uuid, user);
 
-            int rc = copy_directory_recursive(from.c_str(), to.c_str());
+            int rc = copy_directory_recursive(from, to);
             if (rc != 0) {
                 res = error(rc, "Failed copying " + from + " to " + to);
                 goto fail;
@@ -1475,8 +1499,7 @@ binder::Status InstalldNativeService::freeCache(const std::optional<std::string>
                 active = nullptr;
                 continue;
             } else {
-                auto item = active->items.back();
-                active->items.pop_back();
+                auto item = active->popItem();
 
                 LOG(DEBUG) << "Purging " << item->toString() << " from " << active->toString();
                 if (!noop) {
@@ -1749,11 +1772,13 @@ static void collectManualExternalStatsForUser(const std::string& path, struct st
     fts_close(fts);
 }
 
-binder::Status InstalldNativeService::getAppSize(const std::optional<std::string>& uuid,
+// Most threads measuring the apps of a single getAppSizeBatched() call.
+static constexpr size_t kAppSizeBatchThreads = 4;
+
+static binder::Status measureAppSize(const std::optional<std::string>& uuid,
         const std::vector<std::string>& packageNames, int32_t userId, int32_t flags,
         int32_t appId, const std::vector<int64_t>& ceDataInodes,
         const std::vector<std::string>& codePaths, std::vector<int64_t>* _aidl_return) {
-    ENFORCE_UID(AID_SYSTEM);
     CHECK_ARGUMENT_UUID(uuid);
     for (const auto& packageName : packageNames) {
         CHECK_ARGUMENT_PACKAGE_NAME(packageName);
@@ -1876,6 +1901,45 @@ binder::Status InstalldNativeService::getAppSize(const std::optional<std::string
     return ok();
 }
 
+binder::Status InstalldNativeService::getAppSize(const std::optional<std::string>& uuid,
+        const std::vector<std::string>& packageNames, int32_t userId, int32_t flags,
+        int32_t appId, const std::vector<int64_t>& ceDataInodes,
+        const std::vector<std::string>& codePaths, std::vector<int64_t>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    return measureAppSize(uuid, packageNames, userId, flags, appId, ceDataInodes, codePaths,
+            _aidl_return);
+}
+
+binder::Status InstalldNativeService::getAppSizeBatched(
+        const std::vector<android::os::GetAppSizeArgs>& args,
+        std::vector<android::os::GetAppSizeResult>* _aidl_return) {
+    ENFORCE_UID(AID_SYSTEM);
+    // Like getAppSize(), this only measures without mutating, so the apps are measured on
+    // several threads at once when they can't use quotas and have to be walked.
+
+    std::vector<android::os::GetAppSizeResult> results(args.size());
+    std::atomic<size_t> next(0);
+    auto measure = [&]() {
+        for (size_t i = next++; i < args.size(); i = next++) {
+            const auto& arg = args[i];
+            auto status = measureAppSize(arg.uuid, arg.packageNames, arg.userId, arg.flags,
+                    arg.appId, arg.ceDataInodes, arg.codePaths, &results[i].sizes);
+            results[i].exceptionCode = status.exceptionCode();
+            results[i].exceptionMessage = status.exceptionMessage();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(args.size(), kAppSizeBatchThreads); i++) {
+        threads.emplace_back(measure);
+    }
+    measure();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    *_aidl_return = std::move(results);
+    return ok();
+}
+
 struct external_sizes {
     int64_t audioSize;
     int64_t videoSize;
@@ -2393,6 +2457,11 @@ static const char* getCStr(const std::optional<std::string>& data,
         const char* default_value = nullptr) {
     return data ? data->c_str() : default_value;
 }
+
+static int64_t timevalToMs(const struct timeval& tv) {
+    return tv.tv_sec * 1000LL + tv.tv_usec / 1000;
+}
+
 binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t uid,
         const std::optional<std::string>& packageName, const std::string& instructionSet,
         int32_t dexoptNeeded, const std::optional<std::string>& outputPath, int32_t dexFlags,
@@ -2429,9 +2498,27 @@ binder::Status InstalldNativeService::dexopt(const std::string& apkPath, int32_t
     const char* dm_path = getCStr(dexMetadataPath);
     const char* compilation_reason = getCStr(compilationReason);
     std::string error_msg;
+    struct rusage before;
+    getrusage(RUSAGE_CHILDREN, &before);
+    auto start = std::chrono::steady_clock::now();
     int res = android::installd::dexopt(apk_path, uid, pkgname, instruction_set, dexoptNeeded,
             oat_dir, dexFlags, compiler_filter, volume_uuid, class_loader_context, se_info,
             downgrade, targetSdkVersion, profile_name, dm_path, compilation_reason, &error_msg);
+    int64_t wallTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    struct rusage after;
+    getrusage(RUSAGE_CHILDREN, &after);
+    int64_t cpuTimeMs = timevalToMs(after.ru_utime) + timevalToMs(after.ru_stime)
+            - timevalToMs(before.ru_utime) - timevalToMs(before.ru_stime);
+
+    DexoptStats& stats = mDexoptStats[getCStr(compilationReason, "unknown")];
+    stats.count++;
+    stats.failures += (res != 0);
+    stats.wallTimeMs += wallTimeMs;
+    stats.maxWallTimeMs = std::max(stats.maxWallTimeMs, wallTimeMs);
+    stats.cpuTimeMs += cpuTimeMs;
+    LOG(DEBUG) << "Dexopt of " << apkPath << " for " << instructionSet << " took " << wallTimeMs
+            << "ms, " << cpuTimeMs << "ms of CPU";
     return res ? error(res, error_msg) : ok();
 }
 
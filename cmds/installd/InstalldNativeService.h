@@ -84,6 +84,9 @@ public:
             const std::vector<std::string>& packageNames, int32_t userId, int32_t flags,
             int32_t appId, const std::vector<int64_t>& ceDataInodes,
             const std::vector<std::string>& codePaths, std::vector<int64_t>* _aidl_return);
+    binder::Status getAppSizeBatched(
+            const std::vector<android::os::GetAppSizeArgs>& args,
+            std::vector<android::os::GetAppSizeResult>* _aidl_return);
     binder::Status getUserSize(const std::optional<std::string>& uuid,
             int32_t userId, int32_t flags, const std::vector<int32_t>& appIds,
             std::vector<int64_t>* _aidl_return);
@@ -187,6 +190,19 @@ private:
     /* Map from UID to cache quota size */
     std::unordered_map<uid_t, int64_t> mCacheQuotas;
 
+    /* Timings of the dexopt jobs run since installd started, for one compilation reason */
+    struct DexoptStats {
+        int64_t count = 0;
+        int64_t failures = 0;
+        int64_t wallTimeMs = 0;
+        int64_t maxWallTimeMs = 0;
+        /* CPU time of the dex2oat and other children that the jobs waited for */
+        int64_t cpuTimeMs = 0;
+    };
+
+    /* Map from compilation reason to dexopt timings, guarded by mLock */
+    std::unordered_map<std::string, DexoptStats> mDexoptStats;
+
     std::string findDataMediaPath(const std::optional<std::string>& uuid, userid_t userid);
 };
 
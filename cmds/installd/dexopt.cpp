@@ -557,6 +557,11 @@ class RunProfman : public ExecVHelper {
     std::vector<unique_fd> apk_fds_;
 };
 
+static bool is_empty_profile(const unique_fd& fd) {
+    struct stat st;
+    return fstat(fd.get(), &st) == 0 && st.st_size == 0;
+}
+
 static int analyze_profiles(uid_t uid, const std::string& package_name,
         const std::string& location, bool is_secondary_dex) {
     std::vector<unique_fd> profiles_fd;
@@ -569,6 +574,19 @@ static int analyze_profiles(uid_t uid, const std::string& package_name,
         return PROFILES_ANALYSIS_DONT_OPTIMIZE_EMPTY_PROFILES;
     }
 
+    // Current profiles are cleared once they are merged, so when all of them are empty the app
+    // didn't record anything new and profman would find no delta. That is the case of most
+    // packages in a background dexopt run, so don't fork profman for them.
+    bool current_profiles_empty = true;
+    for (const unique_fd& profile_fd : profiles_fd) {
+        current_profiles_empty = current_profiles_empty && is_empty_profile(profile_fd);
+    }
+    if (current_profiles_empty) {
+        return is_empty_profile(reference_profile_fd)
+                ? PROFILES_ANALYSIS_DONT_OPTIMIZE_EMPTY_PROFILES
+                : PROFILES_ANALYSIS_DONT_OPTIMIZE_SMALL_DELTA;
+    }
+
     RunProfman profman_merge;
     const std::vector<unique_fd>& apk_fds = std::vector<unique_fd>();
     const std::vector<std::string>& dex_locations = std::vector<std::string>();
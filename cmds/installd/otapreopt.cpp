@@ -15,6 +15,7 @@
  */
 
 #include <algorithm>
+#include <chrono>
 #include <inttypes.h>
 #include <limits>
 #include <random>
@@ -25,6 +26,7 @@
 #include <string.h>
 #include <sys/capability.h>
 #include <sys/prctl.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
 
@@ -503,11 +505,30 @@ private:
         return res;
     }
 
+    // Run dexopt, and log how long it took so that the duration of the OTA can be tuned. This
+    // process preopts a single package, so all its children ran for that package.
     int RunPreopt() {
         if (ShouldSkipPreopt()) {
             return 0;
         }
 
+        auto start = std::chrono::steady_clock::now();
+        int dexopt_result = DexoptWithDowngrade();
+        int64_t wall_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        struct rusage usage;
+        int64_t cpu_time_ms = -1;
+        if (getrusage(RUSAGE_CHILDREN, &usage) == 0) {
+            cpu_time_ms = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000LL
+                    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000;
+        }
+        LOG(INFO) << "Preopt of " << parameters_.pkgName << " (" << parameters_.apk_path << ", "
+                << parameters_.instruction_set << ") took " << wall_time_ms << "ms, "
+                << cpu_time_ms << "ms of CPU, result " << dexopt_result;
+        return dexopt_result;
+    }
+
+    int DexoptWithDowngrade() {
         int dexopt_result = Dexopt();
         if (dexopt_result == 0) {
             return 0;
@@ -1148,6 +1148,16 @@ TEST_F(ProfileTest, ProfileMergeOkNoReference) {
     mergePackageProfiles(package_name_, "primary.prof", PROFILES_ANALYSIS_OPTIMIZE);
 }
 
+// The current profiles are cleared by the first merge, so there is nothing new for the second.
+TEST_F(ProfileTest, ProfileMergeTwiceNoDelta) {
+    LOG(INFO) << "ProfileMergeTwiceNoDelta";
+
+    SetupProfiles(/*setup_ref*/ true);
+    mergePackageProfiles(package_name_, "primary.prof", PROFILES_ANALYSIS_OPTIMIZE);
+    mergePackageProfiles(package_name_, "primary.prof",
+            PROFILES_ANALYSIS_DONT_OPTIMIZE_SMALL_DELTA);
+}
+
 TEST_F(ProfileTest, ProfileMergeFailWrongPackage) {
     LOG(INFO) << "ProfileMergeFailWrongPackage";
 
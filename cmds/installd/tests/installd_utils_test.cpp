@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/scopeguard.h>
 #include <gtest/gtest.h>
@@ -638,5 +639,61 @@ TEST_F(UtilsTest, TestCreateDirIfNeeded) {
     ASSERT_NE(0, create_dir_if_needed("/data/local/tmp/user/0/bar/baz", 0700));
 }
 
+TEST_F(UtilsTest, TestCalculateTreeSize) {
+    const std::string root = "/data/local/tmp/user/0/tree";
+    system("mkdir -p /data/local/tmp/user/0");
+
+    auto deleter = [&]() {
+        delete_dir_contents_and_dir("/data/local/tmp/user/0", true /* ignore_if_missing */);
+    };
+    auto scope_guard = android::base::make_scope_guard(deleter);
+
+    // Enough directories for the walk to be shared by several threads.
+    ASSERT_EQ(0, mkdir(root.c_str(), 0700));
+    std::vector<std::string> paths = { root };
+    for (int i = 0; i < 8; i++) {
+        std::string dir = root + "/" + std::to_string(i);
+        ASSERT_EQ(0, mkdir(dir.c_str(), 0700));
+        paths.push_back(dir);
+        for (int j = 0; j < 16; j++) {
+            std::string subdir = dir + "/" + std::to_string(j);
+            ASSERT_EQ(0, mkdir(subdir.c_str(), 0700));
+            paths.push_back(subdir);
+            std::string file = subdir + "/file";
+            ASSERT_TRUE(android::base::WriteStringToFile(std::string(4096, 'a'), file));
+            paths.push_back(file);
+        }
+    }
+    std::string link = root + "/link";
+    ASSERT_EQ(0, symlink("/system", link.c_str()));
+    paths.push_back(link);
+
+    int64_t expected = 0;
+    for (const std::string& path : paths) {
+        struct stat st;
+        ASSERT_EQ(0, lstat(path.c_str(), &st));
+        expected += st.st_blocks * 512;
+    }
+
+    int64_t size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size));
+    EXPECT_EQ(expected, size);
+
+    // Sizes are added to the given one.
+    ASSERT_EQ(0, calculate_tree_size(root + "/0", &size));
+    EXPECT_GT(size, expected);
+
+    // Nothing is measured when filtering out the gid of every entry.
+    struct stat st;
+    ASSERT_EQ(0, stat(root.c_str(), &st));
+    size = 0;
+    ASSERT_EQ(0, calculate_tree_size(root, &size, -1, st.st_gid));
+    EXPECT_EQ(0, size);
+
+    size = 0;
+    EXPECT_EQ(-1, calculate_tree_size(root + "/missing", &size));
+    EXPECT_EQ(0, size);
+}
+
 }  // namespace installd
 }  // namespace android
@@ -20,12 +20,21 @@
 #include <fcntl.h>
 #include <fts.h>
 #include <stdlib.h>
+#include <linux/fs.h>
 #include <sys/capability.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #include <sys/xattr.h>
 #include <sys/statvfs.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
@@ -47,6 +56,9 @@
 
 #define DEBUG_XATTRS 0
 
+// Most bytes that copy_directory_recursive() copies in a single system call.
+static constexpr size_t kCopyChunkSize = 1 << 20;
+
 using android::base::EndsWith;
 using android::base::Fdopendir;
 using android::base::StringPrintf;
@@ -376,47 +388,146 @@ std::vector<userid_t> get_known_users(const char* volume_uuid) {
     return users;
 }
 
-int calculate_tree_size(const std::string& path, int64_t* size,
-        int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
-    FTS *fts;
-    FTSENT *p;
-    int64_t matchedSize = 0;
-    char *argv[] = { (char*) path.c_str(), nullptr };
-    if (!(fts = fts_open(argv, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, nullptr))) {
-        if (errno != ENOENT) {
-            PLOG(ERROR) << "Failed to fts_open " << path;
+// Threads that help the calling thread measure a large tree in calculate_tree_size().
+static constexpr size_t kTreeSizeHelperThreads = 3;
+
+// Directories that have to be waiting before the helper threads are started, so that the many
+// small trees that are measured don't pay for starting them.
+static constexpr size_t kTreeSizeParallelThreshold = 32;
+
+// State shared by the threads measuring a single tree in calculate_tree_size().
+struct TreeSizeWalk {
+    int32_t include_gid;
+    int32_t exclude_gid;
+    bool exclude_apps;
+    // Directories on other devices are measured but not traversed.
+    dev_t dev;
+
+    std::mutex lock;
+    std::condition_variable cond;
+    // Directories that have been measured but not listed yet.
+    std::vector<std::string> pending;
+    // Threads listing a directory, which may still add to the pending ones.
+    size_t busy = 0;
+    int64_t size = 0;
+};
+
+static bool is_app_owned(const struct stat& st) {
+    int32_t user_uid = multiuser_get_app_id(st.st_uid);
+    int32_t user_gid = multiuser_get_app_id(st.st_gid);
+    return (user_uid >= AID_APP_START && user_uid <= AID_APP_END)
+            || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
+            || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END);
+}
+
+// Adds the size of the entry to *size, and returns whether it is a directory to traverse.
+static bool measure_tree_entry(const TreeSizeWalk& walk, const struct stat& st, int64_t* size) {
+    if (walk.exclude_apps && is_app_owned(st)) {
+        // Don't traverse inside or measure
+        return false;
+    }
+    int32_t gid = st.st_gid;
+    if ((walk.include_gid == -1 || gid == walk.include_gid)
+            && (walk.exclude_gid == -1 || gid != walk.exclude_gid)) {
+        *size += st.st_blocks * 512;
+    }
+    return S_ISDIR(st.st_mode) && st.st_dev == walk.dev;
+}
+
+// Measures the entries of the directory at path, relative to its fd so that no path has to be
+// resolved for each of them, and adds the directories to traverse to *subdirs.
+static void measure_tree_dir(const TreeSizeWalk& walk, const std::string& path, int64_t* size,
+        std::vector<std::string>* subdirs) {
+    unique_fd fd(open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+    if (fd < 0) {
+        // The directory itself was measured already, like fts does for unreadable ones.
+        return;
+    }
+    DIR* dir = Fdopendir(std::move(fd));
+    if (dir == nullptr) {
+        return;
+    }
+    int dfd = dirfd(dir);
+    struct dirent* de;
+    while ((de = readdir(dir)) != nullptr) {
+        const char* name = de->d_name;
+        if (!strcmp(name, ".") || !strcmp(name, "..")) {
+            continue;
+        }
+        struct stat st;
+        if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            continue;
+        }
+        if (measure_tree_entry(walk, st, size)) {
+            subdirs->push_back(path + "/" + name);
         }
-        return -1;
     }
-    while ((p = fts_read(fts)) != nullptr) {
-        switch (p->fts_info) {
-        case FTS_D:
-        case FTS_DEFAULT:
-        case FTS_F:
-        case FTS_SL:
-        case FTS_SLNONE:
-            int32_t uid = p->fts_statp->st_uid;
-            int32_t gid = p->fts_statp->st_gid;
-            int32_t user_uid = multiuser_get_app_id(uid);
-            int32_t user_gid = multiuser_get_app_id(gid);
-            if (exclude_apps && ((user_uid >= AID_APP_START && user_uid <= AID_APP_END)
-                    || (user_gid >= AID_CACHE_GID_START && user_gid <= AID_CACHE_GID_END)
-                    || (user_gid >= AID_SHARED_GID_START && user_gid <= AID_SHARED_GID_END))) {
-                // Don't traverse inside or measure
-                fts_set(fts, p, FTS_SKIP);
+    closedir(dir);
+}
+
+// Lists pending directories until the whole tree has been measured. The calling thread passes
+// helpers, and starts the helper threads once enough directories are waiting for them.
+static void walk_tree(TreeSizeWalk* walk, std::vector<std::thread>* helpers) {
+    int64_t size = 0;
+    std::vector<std::string> subdirs;
+    std::unique_lock<std::mutex> lock(walk->lock);
+    while (true) {
+        if (walk->pending.empty()) {
+            if (walk->busy == 0) {
                 break;
             }
-            if (include_gid != -1 && gid != include_gid) {
-                break;
+            walk->cond.wait(lock);
+            continue;
+        }
+        std::string path = std::move(walk->pending.back());
+        walk->pending.pop_back();
+        walk->busy++;
+        lock.unlock();
+        measure_tree_dir(*walk, path, &size, &subdirs);
+        lock.lock();
+        walk->busy--;
+        if (!subdirs.empty()) {
+            for (std::string& subdir : subdirs) {
+                walk->pending.push_back(std::move(subdir));
             }
-            if (exclude_gid != -1 && gid == exclude_gid) {
-                break;
+            subdirs.clear();
+            walk->cond.notify_all();
+        } else if (walk->busy == 0 && walk->pending.empty()) {
+            walk->cond.notify_all();
+        }
+        if (helpers != nullptr && helpers->empty()
+                && walk->pending.size() >= kTreeSizeParallelThreshold) {
+            for (size_t i = 0; i < kTreeSizeHelperThreads; i++) {
+                helpers->emplace_back(walk_tree, walk, nullptr);
             }
-            matchedSize += (p->fts_statp->st_blocks * 512);
-            break;
         }
     }
-    fts_close(fts);
+    walk->size += size;
+}
+
+int calculate_tree_size(const std::string& path, int64_t* size,
+        int32_t include_gid, int32_t exclude_gid, bool exclude_apps) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        if (errno != ENOENT) {
+            PLOG(ERROR) << "Failed to lstat " << path;
+        }
+        return -1;
+    }
+    TreeSizeWalk walk;
+    walk.include_gid = include_gid;
+    walk.exclude_gid = exclude_gid;
+    walk.exclude_apps = exclude_apps;
+    walk.dev = st.st_dev;
+    if (measure_tree_entry(walk, st, &walk.size)) {
+        walk.pending.push_back(path);
+        std::vector<std::thread> helpers;
+        walk_tree(&walk, &helpers);
+        for (std::thread& helper : helpers) {
+            helper.join();
+        }
+    }
+    int64_t matchedSize = walk.size;
 #if MEASURE_DEBUG
     if ((include_gid == -1) && (exclude_gid == -1)) {
         LOG(DEBUG) << "Measured " << path << " size " << matchedSize;
@@ -714,6 +825,151 @@ int copy_dir_files(const char *srcname,
     return res;
 }
 
+// Copies the contents of a regular file, sharing its blocks when the filesystem can clone them,
+// and otherwise copying them in the kernel rather than through userspace buffers.
+static int copy_file_contents(int from_fd, int to_fd) {
+    if (ioctl(to_fd, FICLONE, from_fd) == 0) {
+        return 0;
+    }
+    bool use_copy_file_range = true;
+    while (true) {
+        ssize_t copied = -1;
+        if (use_copy_file_range) {
+            // Not wrapped by this bionic, so call it directly.
+            copied = syscall(__NR_copy_file_range, from_fd, nullptr, to_fd, nullptr,
+                    kCopyChunkSize, 0);
+            if (copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL
+                    || errno == EOPNOTSUPP)) {
+                use_copy_file_range = false;
+                continue;
+            }
+        } else {
+            copied = sendfile(to_fd, from_fd, nullptr, kCopyChunkSize);
+        }
+        if (copied < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (copied == 0) {
+            return 0;
+        }
+    }
+}
+
+// Copies the ownership, permissions and timestamps of st to the entry name in dfd, which was
+// just created.
+static int copy_attributes_at(int dfd, const char* name, const struct stat& st) {
+    // Changing the owner clears the set-id bits, so do it before the mode.
+    if (fchownat(dfd, name, st.st_uid, st.st_gid, AT_SYMLINK_NOFOLLOW) != 0) {
+        return -1;
+    }
+    if (!S_ISLNK(st.st_mode) && fchmodat(dfd, name, st.st_mode & ALLPERMS, 0) != 0) {
+        return -1;
+    }
+    const struct timespec times[2] = { st.st_atim, st.st_mtim };
+    return utimensat(dfd, name, times, AT_SYMLINK_NOFOLLOW);
+}
+
+// Copies the entry name of from_dfd, and everything below it, to the same name in to_dfd.
+static int copy_tree_at(int from_dfd, int to_dfd, const char* name, const std::string& path,
+        int64_t* copied_bytes) {
+    struct stat st;
+    if (fstatat(from_dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        PLOG(ERROR) << "Failed to stat " << path;
+        return -1;
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        if (mkdirat(to_dfd, name, 0700) != 0 && errno != EEXIST) {
+            PLOG(ERROR) << "Failed to create copy of " << path;
+            return -1;
+        }
+        unique_fd from_fd(
+                openat(from_dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        unique_fd to_fd(openat(to_dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC));
+        if (from_fd < 0 || to_fd < 0) {
+            PLOG(ERROR) << "Failed to open " << path << " or its copy";
+            return -1;
+        }
+        DIR* dir = Fdopendir(std::move(from_fd));
+        if (dir == nullptr) {
+            PLOG(ERROR) << "Failed to opendir " << path;
+            return -1;
+        }
+        int res = 0;
+        struct dirent* de;
+        while (res == 0 && (de = readdir(dir)) != nullptr) {
+            if (!strcmp(de->d_name, ".") || !strcmp(de->d_name, "..")) {
+                continue;
+            }
+            res = copy_tree_at(dirfd(dir), to_fd.get(), de->d_name, path + "/" + de->d_name,
+                    copied_bytes);
+        }
+        closedir(dir);
+        if (res != 0) {
+            return res;
+        }
+    } else {
+        // Like cp -F, replace anything that is in the way of the copy.
+        if (unlinkat(to_dfd, name, 0) != 0 && errno != ENOENT) {
+            PLOG(ERROR) << "Failed to remove the destination of " << path;
+            return -1;
+        }
+        if (S_ISREG(st.st_mode)) {
+            unique_fd from_fd(openat(from_dfd, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+            unique_fd to_fd(openat(to_dfd, name,
+                    O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600));
+            if (from_fd < 0 || to_fd < 0 || copy_file_contents(from_fd, to_fd) != 0) {
+                PLOG(ERROR) << "Failed to copy " << path;
+                return -1;
+            }
+            *copied_bytes += st.st_size;
+        } else if (S_ISLNK(st.st_mode)) {
+            // The size of encrypted symlinks isn't the length of their target on every kernel.
+            char target[PATH_MAX];
+            ssize_t length = readlinkat(from_dfd, name, target, sizeof(target) - 1);
+            if (length >= 0) {
+                target[length] = '\0';
+            }
+            if (length < 0 || symlinkat(target, to_dfd, name) != 0) {
+                PLOG(ERROR) << "Failed to copy symlink " << path;
+                return -1;
+            }
+        } else if (mknodat(to_dfd, name, st.st_mode, st.st_rdev) != 0) {
+            PLOG(ERROR) << "Failed to copy node " << path;
+            return -1;
+        }
+    }
+
+    if (copy_attributes_at(to_dfd, name, st) != 0) {
+        PLOG(ERROR) << "Failed to copy attributes of " << path;
+        return -1;
+    }
+    return 0;
+}
+
+int copy_directory_recursive(const std::string& from, const std::string& to) {
+    LOG(DEBUG) << "Copying " << from << " to " << to;
+    auto start = std::chrono::steady_clock::now();
+    unique_fd from_parent(open(android::base::Dirname(from).c_str(),
+            O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    unique_fd to_fd(open(to.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (from_parent < 0 || to_fd < 0) {
+        PLOG(ERROR) << "Failed to open the parent of " << from << " or " << to;
+        return -1;
+    }
+    int64_t copied_bytes = 0;
+    int res = copy_tree_at(from_parent, to_fd, android::base::Basename(from).c_str(), from,
+            &copied_bytes);
+    int64_t duration_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    LOG(INFO) << "Copied " << copied_bytes << " bytes from " << from << " to " << to << " in "
+            << duration_ms << "ms";
+    return res;
+}
+
 int64_t data_disk_free(const std::string& data_path) {
     struct statvfs sfs;
     if (statvfs(data_path.c_str(), &sfs) == 0) {
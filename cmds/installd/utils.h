@@ -131,6 +131,12 @@ int rm_package_dir(const std::string& package_dir);
 
 int copy_dir_files(const char *srcname, const char *dstname, uid_t owner, gid_t group);
 
+/**
+ * Copies from, and everything below it, into the directory to, preserving the ownership,
+ * permissions and timestamps of every entry like cp -pR does.
+ */
+int copy_directory_recursive(const std::string& from, const std::string& to);
+
 int64_t data_disk_free(const std::string& data_path);
 
 int get_path_inode(const std::string& path, ino_t *inode);
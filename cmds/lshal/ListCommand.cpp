@@ -19,6 +19,7 @@
 #include <getopt.h>
 
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <functional>
 #include <iomanip>
@@ -26,6 +27,7 @@
 #include <map>
 #include <regex>
 #include <sstream>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -52,6 +54,9 @@ using ::android::hidl::manager::V1_0::IServiceManager;
 namespace android {
 namespace lshal {
 
+// Number of binderized services that are queried at once.
+static constexpr size_t kFetchThreads = 8;
+
 vintf::SchemaType toSchemaType(Partition p) {
     return (p == Partition::SYSTEM) ? vintf::SchemaType::FRAMEWORK : vintf::SchemaType::DEVICE;
 }
@@ -208,6 +213,22 @@ bool ListCommand::getPidInfo(
     return status == OK;
 }
 
+bool ListCommand::getPidInfos(const std::vector<pid_t>& serverPids,
+                              std::map<pid_t, BinderPidInfo>* pidInfos) const {
+    return getBinderPidInfos(BinderDebugContext::HWBINDER, serverPids, pidInfos) == OK;
+}
+
+void ListCommand::prefetchPidInfos(const std::vector<pid_t>& serverPids) {
+    std::map<pid_t, BinderPidInfo> pidInfos;
+    if (!getPidInfos(serverPids, &pidInfos)) {
+        return;
+    }
+    // Processes left out are looked up one by one by getPidInfoCached.
+    for (auto& pair : pidInfos) {
+        mCachedPidInfos.insert(std::move(pair));
+    }
+}
+
 const BinderPidInfo* ListCommand::getPidInfoCached(pid_t serverPid) {
     auto pair = mCachedPidInfos.insert({serverPid, BinderPidInfo{}});
     if (pair.second /* did insertion take place? */) {
@@ -585,16 +606,55 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
         return DUMP_BINDERIZED_ERROR;
     }
 
-    Status status = OK;
     std::map<std::string, TableEntry> allTableEntries;
+    std::vector<TableEntry*> entries;
     for (const auto &fqInstanceName : fqInstanceNames) {
         // create entry and default assign all fields.
         TableEntry& entry = allTableEntries[fqInstanceName];
         entry.interfaceName = fqInstanceName;
         entry.transport = mode;
         entry.serviceStatus = ServiceStatus::NON_RESPONSIVE;
+        entries.push_back(&entry);
+    }
+
+    // Each service is queried by one of a few threads, as most of the time is spent waiting
+    // for the services to answer. Warnings are kept per entry so that they are not interleaved.
+    std::vector<Status> entryStatuses(entries.size(), OK);
+    std::vector<std::string> entryErrors(entries.size());
+    std::atomic<size_t> nextEntry(0);
+    const auto fetchEntries = [&] {
+        for (size_t i = nextEntry++; i < entries.size(); i = nextEntry++) {
+            entryStatuses[i] = fetchBinderizedEntry(manager, entries[i], &entryErrors[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    const size_t threadCount = std::min(kFetchThreads, entries.size());
+    for (size_t i = 0; i < threadCount; i++) {
+        threads.emplace_back(fetchEntries);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    // The binder state of all servers is then read at once.
+    std::vector<pid_t> serverPids;
+    for (const TableEntry* entry : entries) {
+        if (entry->serverPid != NO_PID) {
+            serverPids.push_back(entry->serverPid);
+        }
+    }
+    std::sort(serverPids.begin(), serverPids.end());
+    serverPids.erase(std::unique(serverPids.begin(), serverPids.end()), serverPids.end());
+    prefetchPidInfos(serverPids);
 
-        status |= fetchBinderizedEntry(manager, &entry);
+    Status status = OK;
+    for (size_t i = 0; i < entries.size(); i++) {
+        entryStatuses[i] |= fetchBinderizedPidInfo(entries[i], &entryErrors[i]);
+        if (entryStatuses[i] == OK) {
+            entries[i]->serviceStatus = ServiceStatus::ALIVE;
+        }
+        err() << entryErrors[i];
+        status |= entryStatuses[i];
     }
 
     for (auto& pair : allTableEntries) {
@@ -603,11 +663,16 @@ Status ListCommand::fetchBinderized(const sp<IServiceManager> &manager) {
     return status;
 }
 
+static void addBinderizedError(const TableEntry& entry, const std::string& msg,
+                               std::string* errors) {
+    *errors += "Warning: Skipping \"" + entry.interfaceName + "\": " + msg + "\n";
+}
+
 Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
-                                         TableEntry *entry) {
+                                         TableEntry *entry, std::string *errors) {
     Status status = OK;
     const auto handleError = [&](Status additionalError, const std::string& msg) {
-        err() << "Warning: Skipping \"" << entry->interfaceName << "\": " << msg << std::endl;
+        addBinderizedError(*entry, msg, errors);
         status |= DUMP_BINDERIZED_ERROR | additionalError;
     };
 
@@ -641,24 +706,6 @@ Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
         entry->serverPid = debugInfo.pid;
         entry->serverObjectAddress = debugInfo.ptr;
         entry->arch = fromBaseArchitecture(debugInfo.arch);
-
-        if (debugInfo.pid != NO_PID) {
-            const BinderPidInfo* pidInfo = getPidInfoCached(debugInfo.pid);
-            if (pidInfo == nullptr) {
-                handleError(IO_ERROR,
-                            "no information for PID " + std::to_string(debugInfo.pid) +
-                            ", are you root?");
-                break;
-            }
-            if (debugInfo.ptr != NO_PTR) {
-                auto it = pidInfo->refPids.find(debugInfo.ptr);
-                if (it != pidInfo->refPids.end()) {
-                    entry->clientPids = it->second;
-                }
-            }
-            entry->threadUsage = pidInfo->threadUsage;
-            entry->threadCount = pidInfo->threadCount;
-        }
     } while (0);
 
     // hash
@@ -698,12 +745,31 @@ Status ListCommand::fetchBinderizedEntry(const sp<IServiceManager> &manager,
             handleError(TRANSACTION_ERROR, "getHashChain failed: " + hashRet.description());
         }
     } while (0);
-    if (status == OK) {
-        entry->serviceStatus = ServiceStatus::ALIVE;
-    }
     return status;
 }
 
+Status ListCommand::fetchBinderizedPidInfo(TableEntry *entry, std::string *errors) {
+    if (entry->serverPid == NO_PID) {
+        return OK;
+    }
+    const BinderPidInfo* pidInfo = getPidInfoCached(entry->serverPid);
+    if (pidInfo == nullptr) {
+        addBinderizedError(*entry,
+                           "no information for PID " + std::to_string(entry->serverPid) +
+                           ", are you root?", errors);
+        return DUMP_BINDERIZED_ERROR | IO_ERROR;
+    }
+    if (entry->serverObjectAddress != NO_PTR) {
+        auto it = pidInfo->refPids.find(entry->serverObjectAddress);
+        if (it != pidInfo->refPids.end()) {
+            entry->clientPids = it->second;
+        }
+    }
+    entry->threadUsage = pidInfo->threadUsage;
+    entry->threadCount = pidInfo->threadCount;
+    return OK;
+}
+
 Status ListCommand::fetchManifestHals() {
     if (!shouldFetchHalType(HalType::VINTF_MANIFEST)) { return OK; }
     Status status = OK;
@@ -99,13 +99,23 @@ protected:
     Status fetchManifestHals();
     Status fetchLazyHals();
 
+    // Queries a binderized service for everything but its binder state. Warnings are appended
+    // to errors, as this runs on several threads at once.
     Status fetchBinderizedEntry(const sp<::android::hidl::manager::V1_0::IServiceManager> &manager,
-                                TableEntry *entry);
+                                TableEntry *entry, std::string *errors);
+    // Fills in the binder state of the server of entry.
+    Status fetchBinderizedPidInfo(TableEntry *entry, std::string *errors);
 
     // Get relevant information for a PID by parsing files under
     // /dev/binderfs/binder_logs or /d/binder.
     // It is a virtual member function so that it can be mocked.
     virtual bool getPidInfo(pid_t serverPid, BinderPidInfo *info) const;
+    // Same as getPidInfo for many PIDs, reading the binder state a single time.
+    // It is a virtual member function so that it can be mocked.
+    virtual bool getPidInfos(const std::vector<pid_t>& serverPids,
+                             std::map<pid_t, BinderPidInfo>* pidInfos) const;
+    // Fill mCachedPidInfos with getPidInfos.
+    void prefetchPidInfos(const std::vector<pid_t>& serverPids);
     // Retrieve from mCachedPidInfos and call getPidInfo if necessary.
     const BinderPidInfo* getPidInfoCached(pid_t serverPid);
 
@@ -237,6 +237,10 @@ public:
 
     MOCK_METHOD0(postprocess, void());
     MOCK_CONST_METHOD2(getPidInfo, bool(pid_t, BinderPidInfo*));
+    // Leave every PID to the mocked getPidInfo.
+    bool getPidInfos(const std::vector<pid_t>&, std::map<pid_t, BinderPidInfo>*) const override {
+        return false;
+    }
     MOCK_CONST_METHOD1(parseCmdline, std::string(pid_t));
     MOCK_METHOD1(getPartition, Partition(pid_t));
 
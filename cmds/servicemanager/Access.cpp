@@ -43,10 +43,24 @@ static std::string getPidcon(pid_t pid) {
     return result;
 }
 
+// Bumped by libselinux callbacks, which run from selinux_status_updated().
+static int gPolicySeqno = 0;
+
+static int policyChangedCallback(int /*seqnoOrEnforcing*/) {
+    gPolicySeqno++;
+    return 0;
+}
+
+static void checkPolicyUpdates() {
+    (void)selinux_status_updated();
+}
+
 static struct selabel_handle* getSehandle() {
     static struct selabel_handle* gSehandle = nullptr;
+    static int gSehandleSeqno = 0;
 
-    if (gSehandle != nullptr && selinux_status_updated()) {
+    checkPolicyUpdates();
+    if (gSehandle != nullptr && gSehandleSeqno != gPolicySeqno) {
         selabel_close(gSehandle);
         gSehandle = nullptr;
     }
@@ -55,6 +69,7 @@ static struct selabel_handle* getSehandle() {
         gSehandle = kIsVendor
             ? selinux_android_vendor_service_context_handle()
             : selinux_android_service_context_handle();
+        gSehandleSeqno = gPolicySeqno;
     }
 
     CHECK(gSehandle != nullptr);
@@ -88,6 +103,12 @@ Access::Access() {
     cb.func_log = kIsVendor ? selinux_vendor_log_callback : selinux_log_callback;
     selinux_set_callback(SELINUX_CB_LOG, cb);
 
+    cb.func_policyload = policyChangedCallback;
+    selinux_set_callback(SELINUX_CB_POLICYLOAD, cb);
+
+    cb.func_setenforce = policyChangedCallback;
+    selinux_set_callback(SELINUX_CB_SETENFORCE, cb);
+
     CHECK(selinux_status_open(true /*fallback*/) >= 0);
 
     CHECK(getcon(&mThisProcessContext) == 0);
@@ -119,7 +140,36 @@ bool Access::canAdd(const CallingContext& ctx, const std::string& name) {
 }
 
 bool Access::canList(const CallingContext& ctx) {
-    return actionAllowed(ctx, mThisProcessContext, "list", "service_manager");
+    std::string key = ctx.sid + '\0' + "list";
+    if (lookupCachedDecision(key)) return true;
+
+    bool allowed = actionAllowed(ctx, mThisProcessContext, "list", "service_manager");
+    if (allowed) mAllowedCache.insert(std::move(key));
+    return allowed;
+}
+
+Access::CacheStats Access::getCacheStats() const {
+    CacheStats stats = mCacheStats;
+    stats.entries = mAllowedCache.size();
+    return stats;
+}
+
+bool Access::lookupCachedDecision(const std::string& key) {
+    // keeps memory bounded if callers churn through SIDs (e.g. app processes)
+    constexpr size_t kMaxCacheEntries = 8192;
+
+    checkPolicyUpdates();
+    if (mAllowedCacheSeqno != gPolicySeqno || mAllowedCache.size() >= kMaxCacheEntries) {
+        mAllowedCache.clear();
+        mAllowedCacheSeqno = gPolicySeqno;
+    }
+
+    if (mAllowedCache.count(key) > 0) {
+        mCacheStats.hits++;
+        return true;
+    }
+    mCacheStats.misses++;
+    return false;
 }
 
 bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
@@ -136,6 +186,9 @@ bool Access::actionAllowed(const CallingContext& sctx, const char* tctx, const c
 }
 
 bool Access::actionAllowedFromLookup(const CallingContext& sctx, const std::string& name, const char *perm) {
+    std::string key = sctx.sid + '\0' + perm + '\0' + name;
+    if (lookupCachedDecision(key)) return true;
+
     char *tctx = nullptr;
     if (selabel_lookup(getSehandle(), &tctx, name.c_str(), SELABEL_CTX_ANDROID_SERVICE) != 0) {
         LOG(ERROR) << "SELinux: No match for " << name << " in service_contexts.\n";
@@ -144,6 +197,7 @@ bool Access::actionAllowedFromLookup(const CallingContext& sctx, const std::stri
 
     bool allowed = actionAllowed(sctx, tctx, perm, name);
     freecon(tctx);
+    if (allowed) mAllowedCache.insert(std::move(key));
     return allowed;
 }
 
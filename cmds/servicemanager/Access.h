@@ -18,6 +18,7 @@
 
 #include <string>
 #include <sys/types.h>
+#include <unordered_set>
 
 namespace android {
 
@@ -44,13 +45,28 @@ public:
     virtual bool canAdd(const CallingContext& ctx, const std::string& name);
     virtual bool canList(const CallingContext& ctx);
 
+    struct CacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+    };
+    CacheStats getCacheStats() const;
+
 private:
     bool actionAllowed(const CallingContext& sctx, const char* tctx, const char* perm,
             const std::string& tname);
     bool actionAllowedFromLookup(const CallingContext& sctx, const std::string& name,
             const char *perm);
+    bool lookupCachedDecision(const std::string& key);
 
     char* mThisProcessContext = nullptr;
+
+    // Allowed (caller SID, permission, service name) triples, cleared when the
+    // policy is reloaded or the enforcing mode changes. Denials aren't cached
+    // so they are still audited every time.
+    std::unordered_set<std::string> mAllowedCache;
+    int mAllowedCacheSeqno = 0;
+    CacheStats mCacheStats;
 };
 
 };
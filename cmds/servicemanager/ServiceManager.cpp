@@ -16,14 +16,18 @@
 
 #include "ServiceManager.h"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/properties.h>
+#include <android-base/stringprintf.h>
 #include <binder/BpBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/ProcessState.h>
 #include <binder/Stability.h>
 #include <cutils/android_filesystem_config.h>
 #include <cutils/multiuser.h>
+#include <inttypes.h>
+#include <algorithm>
 #include <thread>
 
 #ifndef VENDORSERVICEMANAGER
@@ -36,6 +40,15 @@ using ::android::internal::Stability;
 
 namespace android {
 
+// A lazy service which is requested again this soon after shutting down is restarting too eagerly,
+// so it is kept alive for longer (hold-down) the next time it loses its clients.
+static constexpr std::chrono::seconds kQuickRestartWindow{30};
+static constexpr std::chrono::seconds kBaseHoldDown{10};
+static constexpr std::chrono::seconds kMaxHoldDown{300};
+// Start requests which are never answered (e.g. the service is not installed) are forgotten.
+static constexpr std::chrono::seconds kPendingStartTimeout{60};
+static constexpr size_t kMaxPrewarmHintsPerTrigger = 16;
+
 #ifndef VENDORSERVICEMANAGER
 struct ManifestWithDescription {
     std::shared_ptr<const vintf::HalManifest> manifest;
@@ -217,17 +230,76 @@ sp<IBinder> ServiceManager::tryGetService(const std::string& name, bool startIfN
 
     if (!out && startIfNotFound) {
         tryStartService(name);
+        noteStartRequested(name, false /*prewarm*/);
     }
 
     if (out) {
         // Setting this guarantee each time we hand out a binder ensures that the client-checking
         // loop knows about the event even if the client immediately drops the service
         service->guaranteeClient = true;
+
+        if (auto lazy = mLazyServices.find(name); lazy != mLazyServices.end()) {
+            lazy->second.lastClientSeen = Clock::now();
+            if (service->prewarmed) lazy->second.prewarmHits++;
+        }
+        service->prewarmed = false;
+    }
+
+    if (startIfNotFound) {
+        prewarmFor(name);
     }
 
     return out;
 }
 
+void ServiceManager::noteStartRequested(const std::string& name, bool prewarm) {
+    auto now = Clock::now();
+
+    auto [pending, inserted] = mPendingStarts.try_emplace(name, PendingStart{now, prewarm});
+    if (!inserted) {
+        // a client is now waiting on a start which may have begun as a prewarm
+        if (!prewarm) pending->second.prewarm = false;
+        return;
+    }
+
+    // prewarming never counts against a service's restart history
+    if (prewarm) return;
+
+    auto lazyIt = mLazyServices.find(name);
+    if (lazyIt == mLazyServices.end() || !lazyIt->second.lastShutdown) return;
+    LazyService& lazy = lazyIt->second;
+
+    if (now - *lazy.lastShutdown < kQuickRestartWindow) {
+        lazy.quickRestarts = std::min(lazy.quickRestarts + 1, 32u);
+        LOG(INFO) << name << " was requested soon after shutting down, holding it for "
+                  << std::chrono::duration_cast<std::chrono::seconds>(lazy.holdDown()).count()
+                  << "s after its next client";
+    } else {
+        lazy.quickRestarts = 0;
+    }
+    lazy.lastShutdown.reset();
+}
+
+void ServiceManager::prewarmFor(const std::string& trigger) {
+    auto hints = mPrewarmHints.find(trigger);
+    if (hints == mPrewarmHints.end()) return;
+
+    for (const std::string& name : hints->second) {
+        if (mNameToService.count(name) > 0 || mPendingStarts.count(name) > 0) continue;
+
+        LOG(INFO) << "Prewarming " << name << " for a client of " << trigger;
+        tryStartService(name);
+        noteStartRequested(name, true /*prewarm*/);
+    }
+}
+
+ServiceManager::Clock::duration ServiceManager::LazyService::holdDown() const {
+    if (quickRestarts == 0) return Clock::duration::zero();
+
+    Clock::duration holdDown = kBaseHoldDown * (1 << std::min(quickRestarts - 1, 5u));
+    return std::min<Clock::duration>(holdDown, kMaxHoldDown);
+}
+
 bool isValidServiceName(const std::string& name) {
     if (name.size() == 0) return false;
     if (name.size() > 127) return false;
@@ -278,12 +350,23 @@ Status ServiceManager::addService(const std::string& name, const sp<IBinder>& bi
         return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE);
     }
 
+    std::optional<std::chrono::nanoseconds> startLatency;
+    bool prewarmed = false;
+    if (auto pending = mPendingStarts.find(name); pending != mPendingStarts.end()) {
+        startLatency = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - pending->second.requested);
+        prewarmed = pending->second.prewarm;
+        mPendingStarts.erase(pending);
+    }
+
     // Overwrite the old service if it exists
     mNameToService[name] = Service {
         .binder = binder,
         .allowIsolated = allowIsolated,
         .dumpPriority = dumpPriority,
         .debugPid = ctx.debugPid,
+        .startLatency = startLatency,
+        .prewarmed = prewarmed,
     };
 
     auto it = mNameToRegistrationCallback.find(name);
@@ -526,6 +609,21 @@ Status ServiceManager::registerClientCallback(const std::string& name, const sp<
 
     mNameToClientCallback[name].push_back(cb);
 
+    // Registering a client callback is what makes this a lazy service, so this is the first
+    // point at which the start (if servicemanager requested it) can be attributed.
+    LazyService& lazy = mLazyServices[name];
+    lazy.lastClientSeen = Clock::now();
+    if (Service& service = serviceIt->second; service.startLatency) {
+        if (service.prewarmed) {
+            lazy.prewarmStarts++;
+        } else {
+            lazy.coldStarts++;
+            lazy.totalColdStartLatency += *service.startLatency;
+            lazy.maxColdStartLatency = std::max(lazy.maxColdStartLatency, *service.startLatency);
+        }
+        service.startLatency.reset();
+    }
+
     return Status::ok();
 }
 
@@ -559,6 +657,15 @@ void ServiceManager::handleClientCallbacks() {
     for (const auto& [name, service] : mNameToService) {
         handleServiceClientCallback(name, true);
     }
+
+    auto now = Clock::now();
+    for (auto it = mPendingStarts.begin(); it != mPendingStarts.end();) {
+        if (now - it->second.requested > kPendingStartTimeout) {
+            it = mPendingStarts.erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 ssize_t ServiceManager::handleServiceClientCallback(const std::string& serviceName,
@@ -576,6 +683,12 @@ ssize_t ServiceManager::handleServiceClientCallback(const std::string& serviceNa
 
     bool hasClients = count > 1; // this process holds a strong count
 
+    LazyService* lazy = nullptr;
+    if (auto lazyIt = mLazyServices.find(serviceName); lazyIt != mLazyServices.end()) {
+        lazy = &lazyIt->second;
+        if (hasClients || service.guaranteeClient) lazy->lastClientSeen = Clock::now();
+    }
+
     if (service.guaranteeClient) {
         // we have no record of this client
         if (!service.hasClients && !hasClients) {
@@ -593,8 +706,10 @@ ssize_t ServiceManager::handleServiceClientCallback(const std::string& serviceNa
             sendClientCallbackNotifications(serviceName, true);
         }
 
-        // there are no more clients, but the callback has not been called yet
-        if (!hasClients && service.hasClients) {
+        // there are no more clients, but the callback has not been called yet. Services which
+        // keep getting restarted right after shutting down are held for a while first.
+        if (!hasClients && service.hasClients &&
+            (lazy == nullptr || Clock::now() - lazy->lastClientSeen >= lazy->holdDown())) {
             sendClientCallbackNotifications(serviceName, false);
         }
     }
@@ -678,9 +793,75 @@ Status ServiceManager::tryUnregisterService(const std::string& name, const sp<IB
 
     mNameToService.erase(name);
 
+    if (auto lazy = mLazyServices.find(name); lazy != mLazyServices.end()) {
+        lazy->second.lastShutdown = Clock::now();
+    }
+
+    return Status::ok();
+}
+
+Status ServiceManager::registerPrewarmHint(const std::string& name, const std::string& trigger) {
+    auto ctx = mAccess->getCallingContext();
+
+    // apps cannot add services, so they cannot have them prewarmed either
+    if (multiuser_get_app_id(ctx.uid) >= AID_APP) {
+        return Status::fromExceptionCode(Status::EX_SECURITY);
+    }
+
+    if (!mAccess->canAdd(ctx, name)) {
+        return Status::fromExceptionCode(Status::EX_SECURITY);
+    }
+
+    if (!isValidServiceName(name) || !isValidServiceName(trigger) || name == trigger) {
+        LOG(ERROR) << "Invalid prewarm hint: " << trigger << " -> " << name;
+        return Status::fromExceptionCode(Status::EX_ILLEGAL_ARGUMENT);
+    }
+
+    std::set<std::string>& hints = mPrewarmHints[trigger];
+    if (hints.size() >= kMaxPrewarmHintsPerTrigger && hints.count(name) == 0) {
+        LOG(ERROR) << "Too many prewarm hints for " << trigger << ", dropping " << name;
+        return Status::fromExceptionCode(Status::EX_ILLEGAL_STATE);
+    }
+    hints.insert(name);
+
     return Status::ok();
 }
 
+status_t ServiceManager::dump(int fd, const Vector<String16>& /*args*/) {
+    if (!mAccess->canList(mAccess->getCallingContext())) {
+        return PERMISSION_DENIED;
+    }
+
+    Access::CacheStats stats = mAccess->getCacheStats();
+    uint64_t lookups = stats.hits + stats.misses;
+    std::string msg = base::StringPrintf(
+            "SELinux access cache: %" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate), %zu "
+            "entries\n",
+            stats.hits, stats.misses, lookups == 0 ? 0.0 : 100.0 * stats.hits / lookups,
+            stats.entries);
+
+    using Millis = std::chrono::duration<double, std::milli>;
+    for (const auto& [name, lazy] : mLazyServices) {
+        Millis avgColdStart = lazy.coldStarts == 0
+                ? Millis::zero()
+                : Millis(lazy.totalColdStartLatency) / lazy.coldStarts;
+        // every prewarm hit is a client which would otherwise have waited for a cold start
+        msg += base::StringPrintf(
+                "Lazy service %s: %" PRIu64 " cold starts (avg %.1f ms, max %.1f ms), %" PRIu64
+                " prewarmed starts, %" PRIu64 " prewarm hits (~%.1f ms saved), hold-down %llds\n",
+                name.c_str(), lazy.coldStarts, avgColdStart.count(),
+                Millis(lazy.maxColdStartLatency).count(), lazy.prewarmStarts, lazy.prewarmHits,
+                avgColdStart.count() * lazy.prewarmHits,
+                static_cast<long long>(
+                        std::chrono::duration_cast<std::chrono::seconds>(lazy.holdDown()).count()));
+    }
+
+    if (!base::WriteStringToFd(msg, fd)) {
+        return -errno;
+    }
+    return OK;
+}
+
 Status ServiceManager::getServiceDebugInfo(std::vector<ServiceDebugInfo>* outReturn) {
     if (!mAccess->canList(mAccess->getCallingContext())) {
         return Status::fromExceptionCode(Status::EX_SECURITY);
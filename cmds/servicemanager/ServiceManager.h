@@ -20,6 +20,10 @@
 #include <android/os/IClientCallback.h>
 #include <android/os/IServiceCallback.h>
 
+#include <chrono>
+#include <optional>
+#include <set>
+
 #include "Access.h"
 
 namespace android {
@@ -51,10 +55,14 @@ public:
     binder::Status registerClientCallback(const std::string& name, const sp<IBinder>& service,
                                           const sp<IClientCallback>& cb) override;
     binder::Status tryUnregisterService(const std::string& name, const sp<IBinder>& binder) override;
+    binder::Status registerPrewarmHint(const std::string& name,
+                                       const std::string& trigger) override;
     binder::Status getServiceDebugInfo(std::vector<ServiceDebugInfo>* outReturn) override;
     void binderDied(const wp<IBinder>& who) override;
     void handleClientCallbacks();
 
+    status_t dump(int fd, const Vector<String16>& args) override;
+
 protected:
     virtual void tryStartService(const std::string& name);
 
@@ -66,6 +74,9 @@ private:
         bool hasClients = false; // notifications sent on true -> false.
         bool guaranteeClient = false; // forces the client check to true
         pid_t debugPid = 0; // the process in which this service runs
+        // time from the start request to registration, if servicemanager started it
+        std::optional<std::chrono::nanoseconds> startLatency;
+        bool prewarmed = false; // started from a prewarm hint, and not yet handed out
 
         // the number of clients of the service, including servicemanager itself
         ssize_t getNodeStrongRefCount();
@@ -74,6 +85,31 @@ private:
     using ServiceCallbackMap = std::map<std::string, std::vector<sp<IServiceCallback>>>;
     using ClientCallbackMap = std::map<std::string, std::vector<sp<IClientCallback>>>;
     using ServiceMap = std::map<std::string, Service>;
+    using Clock = std::chrono::steady_clock;
+
+    // A start request which has not been answered by addService yet
+    struct PendingStart {
+        Clock::time_point requested;
+        bool prewarm; // false once any client asked for the service directly
+    };
+
+    // History of a lazy service (one which registered a client callback). Unlike Service, this
+    // survives the service unregistering itself, so it tracks behavior across restarts.
+    struct LazyService {
+        std::optional<Clock::time_point> lastShutdown;
+        Clock::time_point lastClientSeen;
+        // consecutive restarts shortly after a shutdown; each doubles the hold-down
+        uint32_t quickRestarts = 0;
+
+        uint64_t coldStarts = 0;    // starts a client had to wait for
+        uint64_t prewarmStarts = 0; // starts from a prewarm hint
+        uint64_t prewarmHits = 0;   // prewarmed services later handed to a client
+        std::chrono::nanoseconds totalColdStartLatency{0};
+        std::chrono::nanoseconds maxColdStartLatency{0};
+
+        // how long a service must be without clients before it is told to shut down
+        Clock::duration holdDown() const;
+    };
 
     // removes a callback from mNameToRegistrationCallback, removing it if the vector is empty
     // this updates iterator to the next location
@@ -88,10 +124,17 @@ private:
     void removeClientCallback(const wp<IBinder>& who, ClientCallbackMap::iterator* it);
 
     sp<IBinder> tryGetService(const std::string& name, bool startIfNotFound);
+    // records that 'name' has been requested, for restart history and start latency
+    void noteStartRequested(const std::string& name, bool prewarm);
+    // starts any services hinted for 'trigger' which are not already running or starting
+    void prewarmFor(const std::string& trigger);
 
     ServiceMap mNameToService;
     ServiceCallbackMap mNameToRegistrationCallback;
     ClientCallbackMap mNameToClientCallback;
+    std::map<std::string, PendingStart> mPendingStarts;
+    std::map<std::string, LazyService> mLazyServices;
+    std::map<std::string, std::set<std::string>> mPrewarmHints; // trigger -> services
 
     std::unique_ptr<Access> mAccess;
 };
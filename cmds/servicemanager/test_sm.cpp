@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <android-base/file.h>
 #include <android/os/BnServiceCallback.h>
 #include <binder/Binder.h>
 #include <binder/ProcessState.h>
@@ -63,7 +64,7 @@ class MockServiceManager : public ServiceManager {
     MOCK_METHOD1(tryStartService, void(const std::string& name));
 };
 
-static sp<ServiceManager> getPermissiveServiceManager() {
+static std::unique_ptr<MockAccess> getPermissiveAccess() {
     std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
 
     ON_CALL(*access, getCallingContext()).WillByDefault(Return(Access::CallingContext{}));
@@ -71,7 +72,11 @@ static sp<ServiceManager> getPermissiveServiceManager() {
     ON_CALL(*access, canFind(_, _)).WillByDefault(Return(true));
     ON_CALL(*access, canList(_)).WillByDefault(Return(true));
 
-    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+    return access;
+}
+
+static sp<ServiceManager> getPermissiveServiceManager() {
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(getPermissiveAccess());
     return sm;
 }
 
@@ -287,6 +292,29 @@ TEST(ListServices, AllServices) {
     EXPECT_THAT(out, ElementsAre("sa", "sb", "sc", "sd"));
 }
 
+TEST(Dump, AccessCacheStats) {
+    auto sm = getPermissiveServiceManager();
+
+    android::base::TemporaryFile file;
+    EXPECT_EQ(android::OK, sm->dump(file.fd, {}));
+
+    std::string out;
+    EXPECT_TRUE(android::base::ReadFileToString(file.path, &out));
+    EXPECT_THAT(out, testing::StartsWith("SELinux access cache: 0 hits, 0 misses"));
+}
+
+TEST(Dump, NoPermissions) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    EXPECT_CALL(*access, getCallingContext()).WillOnce(Return(Access::CallingContext{}));
+    EXPECT_CALL(*access, canList(_)).WillOnce(Return(false));
+
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    android::base::TemporaryFile file;
+    EXPECT_EQ(android::PERMISSION_DENIED, sm->dump(file.fd, {}));
+}
+
 TEST(ListServices, CriticalServices) {
     auto sm = getPermissiveServiceManager();
 
@@ -447,3 +475,54 @@ TEST(ServiceNotifications, GetMultipleNotification) {
     EXPECT_THAT(cb->registrations, ElementsAre("asdfasdf", "asdfasdf"));
     EXPECT_THAT(cb->registrations, ElementsAre("asdfasdf", "asdfasdf"));
 }
+
+TEST(PrewarmHint, StartsHintedServiceOnTriggerLookup) {
+    auto sm = sp<NiceMock<MockServiceManager>>::make(getPermissiveAccess());
+
+    EXPECT_TRUE(sm->addService("trigger", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->registerPrewarmHint("hinted", "trigger").isOk());
+
+    // only started once, since the first start is still pending
+    EXPECT_CALL(*sm, tryStartService("hinted")).Times(1);
+
+    sp<IBinder> out;
+    EXPECT_TRUE(sm->getService("trigger", &out).isOk());
+    EXPECT_NE(nullptr, out);
+    EXPECT_TRUE(sm->getService("trigger", &out).isOk());
+}
+
+TEST(PrewarmHint, NotStartedWhenRunningOrChecked) {
+    auto sm = sp<NiceMock<MockServiceManager>>::make(getPermissiveAccess());
+
+    EXPECT_TRUE(sm->addService("trigger", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->addService("hinted", getBinder(), false /*allowIsolated*/,
+        IServiceManager::DUMP_FLAG_PRIORITY_DEFAULT).isOk());
+    EXPECT_TRUE(sm->registerPrewarmHint("hinted", "trigger").isOk());
+
+    EXPECT_CALL(*sm, tryStartService(_)).Times(0);
+
+    sp<IBinder> out;
+    EXPECT_TRUE(sm->getService("trigger", &out).isOk());
+    EXPECT_TRUE(sm->checkService("trigger", &out).isOk());
+}
+
+TEST(PrewarmHint, InvalidHints) {
+    auto sm = getPermissiveServiceManager();
+
+    EXPECT_FALSE(sm->registerPrewarmHint("foo", "foo").isOk());
+    EXPECT_FALSE(sm->registerPrewarmHint("", "foo").isOk());
+    EXPECT_FALSE(sm->registerPrewarmHint("foo", "happy$foo$foo").isOk());
+}
+
+TEST(PrewarmHint, NoPermissions) {
+    std::unique_ptr<MockAccess> access = std::make_unique<NiceMock<MockAccess>>();
+
+    EXPECT_CALL(*access, getCallingContext()).WillOnce(Return(Access::CallingContext{}));
+    EXPECT_CALL(*access, canAdd(_, _)).WillOnce(Return(false));
+
+    sp<ServiceManager> sm = sp<NiceMock<MockServiceManager>>::make(std::move(access));
+
+    EXPECT_FALSE(sm->registerPrewarmHint("foo", "bar").isOk());
+}
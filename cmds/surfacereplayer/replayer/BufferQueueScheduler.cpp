@@ -23,8 +23,12 @@
 using namespace android;
 
 BufferQueueScheduler::BufferQueueScheduler(
-        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id)
-      : mSurfaceControl(surfaceControl), mColor(color), mSurfaceId(id), mContinueScheduling(true) {}
+        const sp<SurfaceControl>& surfaceControl, const HSV& color, int id, bool benchmark)
+      : mSurfaceControl(surfaceControl),
+        mColor(color),
+        mSurfaceId(id),
+        mBenchmark(benchmark),
+        mContinueScheduling(true) {}
 
 void BufferQueueScheduler::startScheduling() {
     ALOGV("Starting Scheduler for %d Layer", mSurfaceId);
@@ -75,6 +79,13 @@ void BufferQueueScheduler::setSurfaceControl(
 void BufferQueueScheduler::bufferUpdate(const Dimensions& dimensions) {
     sp<Surface> s = mSurfaceControl->getSurface();
     s->setBuffersDimensions(dimensions.width, dimensions.height);
+
+    if (mBenchmark &&
+            (dimensions.width != mDimensions.width || dimensions.height != mDimensions.height)) {
+        mDimensions = dimensions;
+        mFilledBuffers.clear();
+        s->allocateBuffers();
+    }
 }
 
 void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
@@ -88,6 +99,13 @@ void BufferQueueScheduler::fillSurface(const std::shared_ptr<Event>& event) {
         return;
     }
 
+    if (mBenchmark && !mFilledBuffers.insert(outBuffer.bits).second) {
+        event->readyToExecute();
+        status = s->unlockAndPost();
+        ALOGE_IF(status != NO_ERROR, "fillSurface: failed to unlock and post buffer, (%d)", status);
+        return;
+    }
+
     auto color = mColor.getRGB();
 
     auto img = reinterpret_cast<uint8_t*>(outBuffer.bits);
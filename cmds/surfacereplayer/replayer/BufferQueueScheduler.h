@@ -28,6 +28,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <queue>
+#include <unordered_set>
 #include <utility>
 
 namespace android {
@@ -52,7 +53,11 @@ struct BufferEvent {
 
 class BufferQueueScheduler {
   public:
-    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id);
+    // In benchmark mode, buffers are allocated ahead of the first frame of each size and filled
+    // only the first time they are dequeued, so that the client side of the replay does not skew
+    // the frame timings.
+    BufferQueueScheduler(const sp<SurfaceControl>& surfaceControl, const HSV& color, int id,
+            bool benchmark = false);
 
     void startScheduling();
     void addEvent(const BufferEvent&);
@@ -70,9 +75,13 @@ class BufferQueueScheduler {
     sp<SurfaceControl> mSurfaceControl;
     HSV mColor;
     const int mSurfaceId;
+    const bool mBenchmark;
 
     bool mContinueScheduling;
 
+    Dimensions mDimensions;
+    std::unordered_set<void*> mFilledBuffers;
+
     std::queue<BufferEvent> mBufferEvents;
     std::mutex mMutex;
     std::condition_variable mCondition;
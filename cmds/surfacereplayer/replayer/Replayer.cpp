@@ -28,10 +28,13 @@
 #include <gui/Surface.h>
 #include <private/gui/ComposerService.h>
 
+#include <binder/IInterface.h>
+
 #include <utils/Log.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cmath>
 #include <condition_variable>
@@ -45,19 +48,23 @@
 #include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 using namespace android;
 
 std::atomic_bool Replayer::sReplayingManually(false);
 
 Replayer::Replayer(const std::string& filename, bool replayManually, int numThreads, bool wait,
-        nsecs_t stopHere)
+        nsecs_t stopHere, bool benchmark)
       : mTrace(),
         mLoaded(false),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
 
     std::string input;
@@ -81,14 +88,16 @@ Replayer::Replayer(const std::string& filename, bool replayManually, int numThre
     }
 }
 
-Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere)
+Replayer::Replayer(const Trace& t, bool replayManually, int numThreads, bool wait, nsecs_t stopHere,
+        bool benchmark)
       : mTrace(t),
         mLoaded(true),
         mIncrementIndex(0),
         mCurrentTime(0),
         mNumThreads(numThreads),
         mWaitForTimeStamps(wait),
-        mStopTimeStamp(stopHere) {
+        mStopTimeStamp(stopHere),
+        mBenchmark(benchmark) {
     srand(RAND_COLOR_SEED);
     mCurrentTime = mTrace.increment(0).time_stamp();
 
@@ -115,7 +124,13 @@ status_t Replayer::replay() {
 
     initReplay();
 
+    if (mBenchmark) {
+        startBenchmark();
+    }
+
     ALOGV("Starting actual Replay!");
+    mTraceStartTime = mCurrentTime;
+    mReplayStartTime = Clock::now();
     while (!mPendingIncrements.empty()) {
         mCurrentIncrement = mTrace.increment(mIncrementIndex);
 
@@ -124,7 +139,13 @@ status_t Replayer::replay() {
             sReplayingManually.store(true);
         }
 
+        const bool waitsForConsole = sReplayingManually && !mWaitingForNextVSync;
         waitForConsoleCommmand();
+        if (waitsForConsole) {
+            // Resume the timing from the previous increment, as if it had just been replayed.
+            mReplayStartTime =
+                    Clock::now() - std::chrono::nanoseconds(mCurrentTime - mTraceStartTime);
+        }
 
         if (mWaitForTimeStamps) {
             waitUntilTimestamp(mCurrentIncrement.time_stamp());
@@ -154,6 +175,10 @@ status_t Replayer::replay() {
 
     SurfaceComposerClient::enableVSyncInjections(false);
 
+    if (mBenchmark) {
+        reportBenchmark();
+    }
+
     return status;
 }
 
@@ -295,7 +320,7 @@ status_t Replayer::dispatchEvent(int index) {
             auto layerId = increment.buffer_update().id();
             if (mBufferQueueSchedulers.count(layerId) == 0) {
                 mBufferQueueSchedulers[layerId] = std::make_shared<BufferQueueScheduler>(
-                        mLayers[layerId], mColors[layerId], layerId);
+                        mLayers[layerId], mColors[layerId], layerId, mBenchmark);
                 mBufferQueueSchedulers[layerId]->addEvent(bufferEvent);
 
                 std::thread(&BufferQueueScheduler::startScheduling,
@@ -655,7 +680,57 @@ void Replayer::updatePowerMode(const PowerModeUpdate& pmu, const std::shared_ptr
 
 void Replayer::waitUntilTimestamp(int64_t timestamp) {
     ALOGV("Waiting for %lld nanoseconds...", static_cast<int64_t>(timestamp - mCurrentTime));
-    std::this_thread::sleep_for(std::chrono::nanoseconds(timestamp - mCurrentTime));
+
+    // Sleeping until an absolute time, rather than for the time between increments, keeps the
+    // time spent replaying each increment from adding up over the trace.
+    const auto replayTime =
+            mReplayStartTime + std::chrono::nanoseconds(timestamp - mTraceStartTime);
+    std::this_thread::sleep_until(replayTime);
+
+    const auto lateness = Clock::now() - replayTime;
+    mTotalLateness += lateness;
+    mMaxLateness = std::max(mMaxLateness, std::chrono::nanoseconds(lateness));
+    mTimedIncrementCount++;
+}
+
+static status_t dumpSurfaceFlinger(const std::vector<const char*>& args, int fd) {
+    Vector<String16> dumpArgs;
+    for (const char* arg : args) {
+        dumpArgs.add(String16(arg));
+    }
+    return IInterface::asBinder(ComposerService::getComposerService())->dump(fd, dumpArgs);
+}
+
+void Replayer::startBenchmark() {
+    const int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    status_t status = dumpSurfaceFlinger({"--timestats", "-disable", "-clear", "-enable"}, fd);
+    close(fd);
+    if (status != NO_ERROR) {
+        std::cerr << "Could not reset SurfaceFlinger TimeStats (" << status << ")" << std::endl;
+    }
+}
+
+void Replayer::reportBenchmark() {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+
+    std::cout << "Replay timing: " << mTimedIncrementCount << " timed increments, "
+              << duration_cast<microseconds>(mTotalLateness / std::max(mTimedIncrementCount, 1))
+                         .count()
+              << " us late on average, " << duration_cast<microseconds>(mMaxLateness).count()
+              << " us at most" << std::endl;
+
+    // The global stats cover the frame latency, the jank, and the main thread time per frame.
+    std::cout << "SurfaceFlinger TimeStats:" << std::endl;
+    status_t status = dumpSurfaceFlinger({"--timestats", "-dump", "-maxlayers", "0"},
+                                         STDOUT_FILENO);
+    if (status != NO_ERROR) {
+        std::cerr << "Could not dump SurfaceFlinger TimeStats (" << status << ")" << std::endl;
+    }
+
+    const int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    dumpSurfaceFlinger({"--timestats", "-disable"}, fd);
+    close(fd);
 }
 
 status_t Replayer::loadSurfaceComposerClient() {
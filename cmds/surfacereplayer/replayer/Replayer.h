@@ -30,6 +30,7 @@
 #include <utils/StrongPointer.h>
 
 #include <stdatomic.h>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
@@ -55,9 +56,10 @@ typedef google::protobuf::RepeatedPtrField<DisplayChange> DisplayChanges;
 class Replayer {
   public:
     Replayer(const std::string& filename, bool replayManually = false,
-            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1);
+            int numThreads = DEFAULT_THREADS, bool wait = true, nsecs_t stopHere = -1,
+            bool benchmark = false);
     Replayer(const Trace& trace, bool replayManually = false, int numThreads = DEFAULT_THREADS,
-            bool wait = true, nsecs_t stopHere = -1);
+            bool wait = true, nsecs_t stopHere = -1, bool benchmark = false);
 
     status_t replay();
 
@@ -131,6 +133,11 @@ class Replayer {
     void waitUntilTimestamp(int64_t timestamp);
     status_t loadSurfaceComposerClient();
 
+    // In benchmark mode, SurfaceFlinger's TimeStats, which FrameTimeline classifies jank into, are
+    // reset before the replay and printed after it.
+    void startBenchmark();
+    void reportBenchmark();
+
     Trace mTrace;
     bool mLoaded = false;
     int32_t mIncrementIndex = 0;
@@ -146,6 +153,16 @@ class Replayer {
     bool mWaitForTimeStamps;
     nsecs_t mStopTimeStamp;
     bool mHasStopped;
+    bool mBenchmark;
+
+    // Increments are replayed at the time they were traced at, relative to the start of the trace.
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point mReplayStartTime;
+    int64_t mTraceStartTime = 0;
+    // How late the increments were replayed, as the timing accuracy of the replay.
+    std::chrono::nanoseconds mTotalLateness{0};
+    std::chrono::nanoseconds mMaxLateness{0};
+    int32_t mTimedIncrementCount = 0;
 
     std::mutex mLayerLock;
     std::condition_variable mLayerCond;
@@ -22,9 +22,24 @@
 
 __BEGIN_DECLS
 
+/* Most threads that the threaded walks below use. */
+#define MAX_DIR_SIZE_THREADS 16
+
 int64_t stat_size(struct stat *s);
 int64_t calculate_dir_size(int dfd);
 
+/*
+ * Like calculate_dir_size, but walks the directory with up to num_threads threads, the calling
+ * one included, and counts a file with several hard links only once. Closes dfd.
+ */
+int64_t calculate_dir_size_threaded(int dfd, int num_threads);
+
+/*
+ * Returns 1 if the size of the directory, as calculate_dir_size_threaded counts it, is larger
+ * than threshold, and 0 otherwise. The walk stops as soon as the answer is known. Closes dfd.
+ */
+int is_dir_size_above(int dfd, int64_t threshold, int num_threads);
+
 __END_DECLS
 
 #endif /* __LIBDISKUSAGE_DIRSIZE_H */
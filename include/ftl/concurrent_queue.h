@@ -0,0 +1,347 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace android::ftl {
+namespace details {
+
+// Data touched by different threads is kept this far apart to avoid false sharing.
+constexpr std::size_t kCacheLineSize = 64;
+
+template <typename T>
+class QueueSlot {
+ public:
+  template <typename... Args>
+  void construct(Args&&... args) {
+    new (&storage_) T(std::forward<Args>(args)...);
+  }
+
+  T& get() { return *std::launder(reinterpret_cast<T*>(&storage_)); }
+
+  // Moves the element out, and destroys it.
+  T take() {
+    T& element = get();
+    T value = std::move(element);
+    element.~T();
+    return value;
+  }
+
+ private:
+  std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
+};
+
+}  // namespace details
+
+// Bounded, lock-free queue with a single producer thread and a single consumer thread. Elements are
+// stored in place in a ring of N slots, where N is a power of two. Each side caches the position of
+// the other, so it only reads the other side's cache line when the ring looks full or empty.
+//
+// Example usage:
+//
+//   ftl::SpscQueue<int, 4> queue;
+//   assert(queue.empty());
+//
+//   // On the producer thread.
+//   for (int i = 0; i < 4; i++) assert(queue.try_push(i));
+//   assert(!queue.try_push(4));
+//
+//   // On the consumer thread.
+//   assert(queue.try_pop() == 0);
+//   assert(queue.try_pop() == 1);
+//   assert(queue.size() == 2u);
+//
+template <typename T, std::size_t N>
+class SpscQueue final {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  SpscQueue() = default;
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  ~SpscQueue() {
+    while (try_pop()) {
+    }
+  }
+
+  static constexpr size_type capacity() { return N; }
+
+  // The following are exact only when called from the producer or consumer thread while the other
+  // one is idle. Otherwise, they are a snapshot that may be stale by the time it is returned.
+  size_type size() const {
+    const size_type head = head_.load(std::memory_order_acquire);
+    const size_type size = tail_.load(std::memory_order_acquire) - head;
+    return size < N ? size : N;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  // Producer only. Constructs an element at the back of the queue in place, unless it is full.
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {
+    const size_type tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ == N) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ == N) return false;
+    }
+
+    slots_[tail & (N - 1)].construct(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(const value_type& value) { return try_emplace(value); }
+  bool try_push(value_type&& value) { return try_emplace(std::move(value)); }
+
+  // Consumer only. Removes the element at the front of the queue, or returns std::nullopt if the
+  // queue is empty.
+  std::optional<value_type> try_pop() {
+    const size_type head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) return std::nullopt;
+    }
+
+    std::optional<value_type> value = slots_[head & (N - 1)].take();
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+ private:
+  // Written by the consumer, along with its view of the tail.
+  alignas(details::kCacheLineSize) std::atomic<size_type> head_{0};
+  size_type tail_cache_ = 0;
+
+  // Written by the producer, along with its view of the head.
+  alignas(details::kCacheLineSize) std::atomic<size_type> tail_{0};
+  size_type head_cache_ = 0;
+
+  alignas(details::kCacheLineSize) details::QueueSlot<value_type> slots_[N];
+};
+
+// Bounded queue with any number of producer threads and a single consumer thread. Elements are
+// stored in place in a ring of N slots, where N is a power of two. Producers claim slots with a
+// compare-and-swap on the tail, so pushing never blocks, but fails when the queue is full.
+//
+// Each slot carries a sequence number that tells whether it is free or published, after Dmitry
+// Vyukov's bounded queue. Note that a producer preempted between claiming and publishing its slot
+// holds back the consumer at that slot, even if later slots are published.
+//
+// Example usage:
+//
+//   ftl::MpscQueue<std::string, 8> queue;
+//
+//   // On any producer thread.
+//   assert(queue.try_emplace(3u, '!'));
+//   assert(queue.try_push("abc"));
+//
+//   // On the consumer thread.
+//   assert(queue.try_pop() == "!!!");
+//   assert(queue.try_pop() == "abc");
+//   assert(!queue.try_pop());
+//
+template <typename T, std::size_t N>
+class MpscQueue final {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  MpscQueue() {
+    for (size_type i = 0; i < N; i++) {
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  ~MpscQueue() {
+    while (try_pop()) {
+    }
+  }
+
+  static constexpr size_type capacity() { return N; }
+
+  // Snapshot that may be stale by the time it is returned, unless producers are idle.
+  size_type size() const {
+    const size_type head = head_.load(std::memory_order_acquire);
+    const size_type size = tail_.load(std::memory_order_acquire) - head;
+    return size < N ? size : N;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  // Constructs an element at the back of the queue in place, unless it is full.
+  template <typename... Args>
+  bool try_emplace(Args&&... args) {
+    size_type tail = tail_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[tail & (N - 1)];
+      const size_type sequence = cell->sequence.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::intptr_t>(sequence - tail);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) break;
+      } else if (diff < 0) {
+        // The consumer has yet to free the slot from the previous lap.
+        return false;
+      } else {
+        tail = tail_.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->slot.construct(std::forward<Args>(args)...);
+    cell->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_push(const value_type& value) { return try_emplace(value); }
+  bool try_push(value_type&& value) { return try_emplace(std::move(value)); }
+
+  // Consumer only. Removes the element at the front of the queue, or returns std::nullopt if the
+  // queue is empty.
+  std::optional<value_type> try_pop() {
+    const size_type head = head_.load(std::memory_order_relaxed);
+    Cell& cell = cells_[head & (N - 1)];
+    if (cell.sequence.load(std::memory_order_acquire) != head + 1) return std::nullopt;
+
+    std::optional<value_type> value = cell.slot.take();
+    cell.sequence.store(head + N, std::memory_order_release);
+    head_.store(head + 1, std::memory_order_release);
+    return value;
+  }
+
+ private:
+  struct Cell {
+    std::atomic<size_type> sequence;
+    details::QueueSlot<value_type> slot;
+  };
+
+  alignas(details::kCacheLineSize) std::atomic<size_type> head_{0};
+  alignas(details::kCacheLineSize) std::atomic<size_type> tail_{0};
+  alignas(details::kCacheLineSize) Cell cells_[N];
+};
+
+// Unbounded queue with any number of producer threads and a single consumer thread. Each element
+// is allocated in its own node, and producers link their node with a single atomic exchange on the
+// tail, so pushing never blocks nor fails. Use MpscQueue instead if a bound is acceptable, as it
+// does not allocate.
+//
+// The consumer walks the list from a stub node, after Dmitry Vyukov's intrusive queue. Note that a
+// producer preempted between the exchange and linking its node hides the elements pushed after it
+// until it resumes, so try_pop may fail even though size is not zero.
+//
+// Example usage:
+//
+//   ftl::UnboundedMpscQueue<std::string> queue;
+//
+//   // On any producer thread.
+//   queue.emplace(3u, '!');
+//   queue.push("abc");
+//
+//   // On the consumer thread.
+//   assert(queue.size() == 2u);
+//   assert(*queue.peek() == "!!!");
+//   assert(queue.try_pop() == "!!!");
+//   assert(queue.try_pop() == "abc");
+//   assert(!queue.try_pop());
+//
+template <typename T>
+class UnboundedMpscQueue final {
+ public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  UnboundedMpscQueue() : head_(new Node), tail_(head_) {}
+
+  UnboundedMpscQueue(const UnboundedMpscQueue&) = delete;
+  UnboundedMpscQueue& operator=(const UnboundedMpscQueue&) = delete;
+
+  ~UnboundedMpscQueue() {
+    while (try_pop()) {
+    }
+    delete head_;
+  }
+
+  // Snapshot that may be stale by the time it is returned, unless producers are idle. Unlike peek
+  // and try_pop, this may be called from any thread.
+  size_type size() const { return size_.load(std::memory_order_acquire); }
+  bool empty() const { return size() == 0; }
+
+  // Constructs an element at the back of the queue.
+  template <typename... Args>
+  void emplace(Args&&... args) {
+    Node* const node = new Node;
+    node->slot.construct(std::forward<Args>(args)...);
+    size_.fetch_add(1, std::memory_order_release);
+
+    Node* const prev = tail_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  void push(const value_type& value) { emplace(value); }
+  void push(value_type&& value) { emplace(std::move(value)); }
+
+  // Consumer only. Returns the element at the front of the queue, or nullptr if the queue is empty.
+  // The element stays valid until it is popped.
+  value_type* peek() {
+    Node* const next = head_->next.load(std::memory_order_acquire);
+    return next ? &next->slot.get() : nullptr;
+  }
+
+  // Consumer only. Removes the element at the front of the queue, or returns std::nullopt if the
+  // queue is empty.
+  std::optional<value_type> try_pop() {
+    Node* const next = head_->next.load(std::memory_order_acquire);
+    if (!next) return std::nullopt;
+
+    // The node of the element becomes the stub.
+    std::optional<value_type> value = next->slot.take();
+    delete head_;
+    head_ = next;
+    size_.fetch_sub(1, std::memory_order_release);
+    return value;
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    details::QueueSlot<value_type> slot;
+  };
+
+  // Only touched by the consumer.
+  alignas(details::kCacheLineSize) Node* head_;
+
+  alignas(details::kCacheLineSize) std::atomic<Node*> tail_;
+  alignas(details::kCacheLineSize) std::atomic<size_type> size_{0};
+};
+
+}  // namespace android::ftl
@@ -0,0 +1,420 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace android::ftl {
+namespace details {
+
+// Smallest power of two with room for N mappings at a load factor of at most 3/4.
+constexpr std::size_t flat_hash_map_slots(std::size_t n) {
+  std::size_t slots = 1;
+  while (slots * 3 < n * 4) slots *= 2;
+  return n == 0 ? 0 : slots;
+}
+
+template <typename T>
+struct FlatHashMapSlot {
+  T& value() { return *std::launder(reinterpret_cast<T*>(&storage)); }
+  const T& value() const { return *std::launder(reinterpret_cast<const T*>(&storage)); }
+
+  bool full = false;
+  std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+};
+
+}  // namespace details
+
+// Associative container with unique, unordered keys, implemented as an open-addressing hash table
+// with linear probing. Unlike std::unordered_map, key-value pairs are stored in a contiguous array
+// of slots rather than in per-node allocations. Like SmallMap, the slots are allocated statically
+// until the size exceeds N, at which point mappings are relocated to dynamic memory. (Since the slot
+// count is rounded up to a power of two, the static slots may fit a few more than N.) Unlike
+// SmallMap, lookup is constant time rather than linear, which pays off beyond a dozen mappings or
+// so, or for keys that are expensive to compare.
+//
+// Erasing shifts the following mappings of the probe sequence back instead of leaving tombstones,
+// so lookups stay short under churn. Insertion and erasure invalidate iterators and references.
+//
+// FlatHashMap<K, V, 0> unconditionally allocates on the heap.
+//
+// Example usage:
+//
+//   ftl::FlatHashMap<int, std::string, 3> map;
+//   assert(map.empty());
+//   assert(!map.dynamic());
+//
+//   assert(map.try_emplace(123, "abc").second);
+//   assert(map.try_emplace(-1).second);
+//   assert(map.try_emplace(42, 3u, '?').second);
+//   assert(!map.try_emplace(42, "!!!").second);
+//   assert(map.size() == 3u);
+//
+//   assert(map.contains(123));
+//   assert(map.find(42)->get() == "???");
+//
+//   assert(map.erase(-1));
+//   assert(!map.contains(-1));
+//
+//   map[7] = "a";
+//   assert(!map.dynamic());
+//
+//   map[8] = "b";
+//   assert(map.dynamic());
+//   assert(map.size() == 4u);
+//
+template <typename K, typename V, std::size_t N, typename Hash = std::hash<K>,
+          typename KeyEqual = std::equal_to<K>>
+class FlatHashMap final {
+  using Slot = details::FlatHashMapSlot<std::pair<const K, V>>;
+
+  static constexpr std::size_t kStaticSlots = details::flat_hash_map_slots(N);
+
+  template <typename Value, typename SlotPtr>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Value;
+    using difference_type = std::ptrdiff_t;
+    using pointer = Value*;
+    using reference = Value&;
+
+    Iterator() = default;
+
+    // Converts iterator to const_iterator.
+    template <typename OtherValue, typename OtherSlotPtr,
+              typename = std::enable_if_t<std::is_convertible_v<OtherSlotPtr, SlotPtr>>>
+    Iterator(const Iterator<OtherValue, OtherSlotPtr>& other)
+        : slot_(other.slot_), end_(other.end_) {}
+
+    reference operator*() const { return slot_->value(); }
+    pointer operator->() const { return &slot_->value(); }
+
+    Iterator& operator++() {
+      ++slot_;
+      skip_empty();
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.slot_ == rhs.slot_;
+    }
+
+    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return !(lhs == rhs); }
+
+   private:
+    friend FlatHashMap;
+    template <typename, typename>
+    friend class Iterator;
+
+    Iterator(SlotPtr slot, SlotPtr end) : slot_(slot), end_(end) { skip_empty(); }
+
+    void skip_empty() {
+      while (slot_ != end_ && !slot_->full) ++slot_;
+    }
+
+    SlotPtr slot_ = nullptr;
+    SlotPtr end_ = nullptr;
+  };
+
+ public:
+  using key_type = K;
+  using mapped_type = V;
+
+  using value_type = std::pair<const K, V>;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  using hasher = Hash;
+  using key_equal = KeyEqual;
+
+  using reference = value_type&;
+  using iterator = Iterator<value_type, Slot*>;
+
+  using const_reference = const value_type&;
+  using const_iterator = Iterator<const value_type, const Slot*>;
+
+  // Creates an empty map.
+  FlatHashMap() = default;
+
+  FlatHashMap(const FlatHashMap& other) : hash_(other.hash_), equal_(other.equal_) {
+    reserve(other.size());
+    for (const auto& [key, value] : other) {
+      emplace_unique(key, value);
+    }
+  }
+
+  FlatHashMap(FlatHashMap&& other) : hash_(other.hash_), equal_(other.equal_) {
+    take(std::move(other));
+  }
+
+  FlatHashMap& operator=(const FlatHashMap& other) {
+    if (this != &other) {
+      clear();
+      reserve(other.size());
+      for (const auto& [key, value] : other) {
+        emplace_unique(key, value);
+      }
+    }
+    return *this;
+  }
+
+  FlatHashMap& operator=(FlatHashMap&& other) {
+    if (this != &other) {
+      release();
+      take(std::move(other));
+    }
+    return *this;
+  }
+
+  ~FlatHashMap() { release(); }
+
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Number of mappings the map can hold before growing.
+  size_type capacity() const { return max_load(capacity_); }
+
+  // Returns whether the map is backed by static or dynamic storage.
+  bool dynamic() const { return dynamic_slots_ != nullptr; }
+
+  iterator begin() { return iterator(slots(), slots() + capacity_); }
+  const_iterator begin() const { return cbegin(); }
+  const_iterator cbegin() const { return const_iterator(slots(), slots() + capacity_); }
+
+  iterator end() { return iterator(slots() + capacity_, slots() + capacity_); }
+  const_iterator end() const { return cend(); }
+  const_iterator cend() const {
+    return const_iterator(slots() + capacity_, slots() + capacity_);
+  }
+
+  // Returns whether a mapping exists for the given key.
+  bool contains(const key_type& key) const { return find_slot(key) != nullptr; }
+
+  // Returns a reference to the value for the given key, or std::nullopt if the key was not found.
+  auto find(const key_type& key) const -> std::optional<std::reference_wrapper<const mapped_type>> {
+    if (const Slot* slot = find_slot(key)) return std::cref(slot->value().second);
+    return {};
+  }
+
+  auto find(const key_type& key) -> std::optional<std::reference_wrapper<mapped_type>> {
+    if (Slot* slot = const_cast<Slot*>(std::as_const(*this).find_slot(key))) {
+      return std::ref(slot->value().second);
+    }
+    return {};
+  }
+
+  // Constructs the value for the given key in place from the given arguments, unless the key is
+  // already mapped. Returns an iterator to the mapping, and whether it was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    if (Slot* slot = const_cast<Slot*>(std::as_const(*this).find_slot(key))) {
+      return {iterator(slot, slots() + capacity_), false};
+    }
+
+    if (size_ + 1 > capacity()) grow(size_ + 1);
+    Slot* slot = emplace_unique(key, std::forward<Args>(args)...);
+    return {iterator(slot, slots() + capacity_), true};
+  }
+
+  // Returns a reference to the value for the given key, which is value-initialized if the key was
+  // not mapped.
+  mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+
+  // Removes the mapping for the given key. Returns whether the key was found.
+  bool erase(const key_type& key) {
+    Slot* slot = const_cast<Slot*>(std::as_const(*this).find_slot(key));
+    if (!slot) return false;
+
+    const size_type mask = capacity_ - 1;
+    size_type hole = static_cast<size_type>(slot - slots());
+    destroy(slots()[hole]);
+
+    // Shift back the mappings that follow in the probe sequence, unless that would move them
+    // before their home slot.
+    for (size_type i = (hole + 1) & mask; slots()[i].full; i = (i + 1) & mask) {
+      const size_type home = home_slot(slots()[i].value().first);
+      const bool in_place = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+      if (in_place) continue;
+
+      construct(slots()[hole], std::move(slots()[i].value()));
+      destroy(slots()[i]);
+      hole = i;
+    }
+
+    size_--;
+    return true;
+  }
+
+  // Removes all mappings, but keeps the storage.
+  void clear() {
+    for (size_type i = 0; i < capacity_ && size_ > 0; i++) {
+      if (slots()[i].full) {
+        destroy(slots()[i]);
+        size_--;
+      }
+    }
+  }
+
+  // Makes room for at least n mappings without growing.
+  void reserve(size_type n) {
+    if (n > capacity()) grow(n);
+  }
+
+  const hasher& hash_function() const { return hash_; }
+  const key_equal& key_eq() const { return equal_; }
+
+ private:
+  static constexpr size_type max_load(size_type slots) { return slots * 3 / 4; }
+
+  Slot* slots() { return dynamic_slots_ ? dynamic_slots_.get() : static_slots_; }
+  const Slot* slots() const { return dynamic_slots_ ? dynamic_slots_.get() : static_slots_; }
+
+  // Fibonacci hashing spreads hashes that differ only in their high bits, like std::hash of
+  // pointers or identity hashes of aligned integers.
+  size_type home_slot(const key_type& key) const {
+    const std::uint64_t hash = static_cast<std::uint64_t>(hash_(key)) * 0x9e3779b97f4a7c15ull;
+    return static_cast<size_type>(hash >> shift_);
+  }
+
+  const Slot* find_slot(const key_type& key) const {
+    if (size_ == 0) return nullptr;
+
+    const size_type mask = capacity_ - 1;
+    for (size_type i = home_slot(key);; i = (i + 1) & mask) {
+      const Slot& slot = slots()[i];
+      if (!slot.full) return nullptr;
+      if (equal_(slot.value().first, key)) return &slot;
+    }
+  }
+
+  // Inserts a mapping for a key known to be absent. The map must have room for it.
+  template <typename... Args>
+  Slot* emplace_unique(const key_type& key, Args&&... args) {
+    const size_type mask = capacity_ - 1;
+    size_type i = home_slot(key);
+    while (slots()[i].full) i = (i + 1) & mask;
+
+    construct(slots()[i], std::piecewise_construct, std::forward_as_tuple(key),
+              std::forward_as_tuple(std::forward<Args>(args)...));
+    size_++;
+    return &slots()[i];
+  }
+
+  template <typename... Args>
+  static void construct(Slot& slot, Args&&... args) {
+    new (&slot.storage) value_type(std::forward<Args>(args)...);
+    slot.full = true;
+  }
+
+  static void destroy(Slot& slot) {
+    slot.value().~value_type();
+    slot.full = false;
+  }
+
+  // Reallocates the slots with room for at least n mappings, and rehashes the mappings.
+  void grow(size_type n) {
+    size_type capacity = capacity_ > 0 ? capacity_ * 2 : 4;
+    while (max_load(capacity) < n) capacity *= 2;
+
+    std::unique_ptr<Slot[]> old_dynamic_slots = std::move(dynamic_slots_);
+    Slot* const old_slots = old_dynamic_slots ? old_dynamic_slots.get() : static_slots_;
+    const size_type old_capacity = capacity_;
+
+    dynamic_slots_ = std::make_unique<Slot[]>(capacity);
+    set_capacity(capacity);
+    size_ = 0;
+
+    for (size_type i = 0; i < old_capacity; i++) {
+      Slot& slot = old_slots[i];
+      if (!slot.full) continue;
+
+      auto& [key, value] = slot.value();
+      emplace_unique(key, std::move(value));
+      destroy(slot);
+    }
+  }
+
+  void set_capacity(size_type capacity) {
+    capacity_ = capacity;
+    shift_ = 64;
+    while (capacity > 1) {
+      capacity /= 2;
+      shift_--;
+    }
+  }
+
+  // Moves the mappings of the other map into this empty one, and leaves the other one empty.
+  void take(FlatHashMap&& other) {
+    if (other.dynamic()) {
+      dynamic_slots_ = std::move(other.dynamic_slots_);
+      set_capacity(other.capacity_);
+      size_ = other.size_;
+    } else {
+      for (size_type i = 0; i < other.capacity_; i++) {
+        Slot& slot = other.static_slots_[i];
+        if (!slot.full) continue;
+
+        auto& [key, value] = slot.value();
+        emplace_unique(key, std::move(value));
+        other.destroy(slot);
+      }
+    }
+
+    other.set_capacity(kStaticSlots);
+    other.size_ = 0;
+  }
+
+  // Destroys the mappings, and returns to static storage.
+  void release() {
+    clear();
+    dynamic_slots_.reset();
+    set_capacity(kStaticSlots);
+  }
+
+  Slot static_slots_[kStaticSlots > 0 ? kStaticSlots : 1];
+  std::unique_ptr<Slot[]> dynamic_slots_;
+
+  size_type capacity_ = kStaticSlots;
+  size_type size_ = 0;
+  unsigned shift_ = initial_shift();
+
+  hasher hash_;
+  key_equal equal_;
+
+  static constexpr unsigned initial_shift() {
+    unsigned shift = 64;
+    for (size_type slots = kStaticSlots; slots > 1; slots /= 2) shift--;
+    return shift;
+  }
+};
+
+}  // namespace android::ftl
@@ -32,6 +32,9 @@ namespace android::ftl {
 //
 // SmallMap<K, V, 0> unconditionally allocates on the heap.
 //
+// Lookup is a linear search, so SortedSmallMap is a better fit for maps that may grow beyond a dozen
+// mappings or so.
+//
 // Example usage:
 //
 //   ftl::SmallMap<int, std::string, 3> map;
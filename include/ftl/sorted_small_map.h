@@ -0,0 +1,307 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ftl/small_vector.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace android::ftl {
+namespace details {
+
+template <typename Compare, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename Compare>
+struct is_transparent<Compare, std::void_t<typename Compare::is_transparent>> : std::true_type {};
+
+template <typename Compare>
+constexpr bool is_transparent_v = is_transparent<Compare>::value;
+
+}  // namespace details
+
+// Sorted counterpart of SmallMap, for maps that may grow beyond a handful of mappings. Keys are kept
+// in order of Compare, so lookup is a binary search rather than a linear scan, and the worst case is
+// logarithmic even after the map has spilled into dynamic memory. Insertion and erasure shift the
+// following mappings, so they are linear, but cheap for trivially movable keys and values.
+//
+// Keys and values are stored in two separate vectors, which keeps the keys dense for the search.
+// Hence, iterators dereference to std::pair<const K&, V&> (or std::pair<const K&, const V&>)
+// rather than a reference to a pair, in the way of std::flat_map. Both vectors are allocated
+// statically until the size exceeds N.
+//
+// If Compare is transparent, like the default std::less<>, lookups accept any type comparable with
+// K, e.g. std::string_view for std::string keys, without constructing a temporary key.
+//
+// Example usage:
+//
+//   ftl::SortedSmallMap<std::string, int, 2> map = {{"b", 2}, {"a", 1}};
+//   assert(map.size() == 2u);
+//   assert(!map.dynamic());
+//
+//   assert(map.try_emplace("c", 3).second);
+//   assert(!map.try_emplace("a", 0).second);
+//   assert(map.dynamic());
+//
+//   using namespace std::literals;
+//   assert(map.contains("b"sv));
+//   assert(map.find("c"sv) == 3);
+//
+//   assert(map.begin()->first == "a");
+//   assert(map.erase("b"sv));
+//   assert(map.size() == 2u);
+//
+template <typename K, typename V, std::size_t N, typename Compare = std::less<>>
+class SortedSmallMap final {
+  using Keys = SmallVector<K, N>;
+  using Values = SmallVector<V, N>;
+
+  // Lookups by Q rather than key_type are only allowed if Compare is transparent.
+  template <typename Q>
+  using enable_if_lookup_t = std::enable_if_t<details::is_transparent_v<Compare>, Q>;
+
+  template <typename Map, typename Reference>
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = Reference;
+    using difference_type = std::ptrdiff_t;
+    using reference = Reference;
+
+    // Gives iterator->first and iterator->second since there is no pair to point to.
+    struct pointer {
+      const Reference* operator->() const { return &value; }
+      Reference value;
+    };
+
+    Iterator() = default;
+
+    // Converts iterator to const_iterator.
+    template <typename OtherMap, typename OtherReference,
+              typename = std::enable_if_t<std::is_convertible_v<OtherMap*, Map*>>>
+    Iterator(const Iterator<OtherMap, OtherReference>& other)
+        : map_(other.map_), index_(other.index_) {}
+
+    reference operator*() const { return {map_->keys_[index_], map_->values_[index_]}; }
+    pointer operator->() const { return {**this}; }
+
+    Iterator& operator++() {
+      index_++;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator it = *this;
+      index_++;
+      return it;
+    }
+
+    friend bool operator==(const Iterator& lhs, const Iterator& rhs) {
+      return lhs.index_ == rhs.index_;
+    }
+
+    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) { return !(lhs == rhs); }
+
+   private:
+    friend SortedSmallMap;
+    template <typename, typename>
+    friend class Iterator;
+
+    Iterator(Map* map, std::size_t index) : map_(map), index_(index) {}
+
+    Map* map_ = nullptr;
+    std::size_t index_ = 0;
+  };
+
+ public:
+  using key_type = K;
+  using mapped_type = V;
+  using key_compare = Compare;
+
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+
+  using reference = std::pair<const K&, V&>;
+  using iterator = Iterator<SortedSmallMap, reference>;
+
+  using const_reference = std::pair<const K&, const V&>;
+  using const_iterator = Iterator<const SortedSmallMap, const_reference>;
+
+  // Creates an empty map.
+  SortedSmallMap() = default;
+
+  // Inserts the given mappings in order. Later mappings for a key that is already mapped are
+  // ignored.
+  SortedSmallMap(std::initializer_list<std::pair<K, V>> list) {
+    for (const auto& [key, value] : list) {
+      try_emplace(key, value);
+    }
+  }
+
+  size_type max_size() const { return keys_.max_size(); }
+  size_type size() const { return keys_.size(); }
+  bool empty() const { return keys_.empty(); }
+
+  // Returns whether the map is backed by static or dynamic storage.
+  bool dynamic() const { return keys_.dynamic(); }
+
+  iterator begin() { return iterator(this, 0); }
+  const_iterator begin() const { return cbegin(); }
+  const_iterator cbegin() const { return const_iterator(this, 0); }
+
+  iterator end() { return iterator(this, size()); }
+  const_iterator end() const { return cend(); }
+  const_iterator cend() const { return const_iterator(this, size()); }
+
+  // The keys in ascending order, and their values in the same order.
+  const Keys& keys() const { return keys_; }
+  const Values& values() const { return values_; }
+
+  // Returns whether a mapping exists for the given key.
+  bool contains(const key_type& key) const { return index_of(key) < size(); }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  bool contains(const Q& key) const {
+    return index_of(key) < size();
+  }
+
+  // Returns a reference to the value for the given key, or std::nullopt if the key was not found.
+  auto find(const key_type& key) const -> std::optional<std::reference_wrapper<const mapped_type>> {
+    return find_impl(*this, key);
+  }
+
+  auto find(const key_type& key) -> std::optional<std::reference_wrapper<mapped_type>> {
+    return find_impl(*this, key);
+  }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  auto find(const Q& key) const -> std::optional<std::reference_wrapper<const mapped_type>> {
+    return find_impl(*this, key);
+  }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  auto find(const Q& key) -> std::optional<std::reference_wrapper<mapped_type>> {
+    return find_impl(*this, key);
+  }
+
+  // Returns an iterator to the first mapping whose key is not less than the given key.
+  iterator lower_bound(const key_type& key) { return iterator(this, lower_bound_index(key)); }
+
+  const_iterator lower_bound(const key_type& key) const {
+    return const_iterator(this, lower_bound_index(key));
+  }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  iterator lower_bound(const Q& key) {
+    return iterator(this, lower_bound_index(key));
+  }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  const_iterator lower_bound(const Q& key) const {
+    return const_iterator(this, lower_bound_index(key));
+  }
+
+  // Constructs the value for the given key in place from the given arguments, unless the key is
+  // already mapped. Returns an iterator to the mapping, and whether it was inserted.
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const key_type& key, Args&&... args) {
+    const size_type index = lower_bound_index(key);
+    if (index < size() && !compare_(key, keys_[index])) {
+      return {iterator(this, index), false};
+    }
+
+    keys_.emplace_back(key);
+    values_.emplace_back(std::forward<Args>(args)...);
+    std::rotate(keys_.begin() + index, keys_.end() - 1, keys_.end());
+    std::rotate(values_.begin() + index, values_.end() - 1, values_.end());
+    return {iterator(this, index), true};
+  }
+
+  // Returns a reference to the value for the given key, which is value-initialized if the key was
+  // not mapped.
+  mapped_type& operator[](const key_type& key) { return try_emplace(key).first->second; }
+
+  // Removes the mapping for the given key. Returns whether the key was found.
+  bool erase(const key_type& key) { return erase_impl(key); }
+
+  template <typename Q, typename = enable_if_lookup_t<Q>>
+  bool erase(const Q& key) {
+    return erase_impl(key);
+  }
+
+  void clear() {
+    while (!empty()) {
+      keys_.pop_back();
+      values_.pop_back();
+    }
+  }
+
+  friend bool operator==(const SortedSmallMap& lhs, const SortedSmallMap& rhs) {
+    return lhs.keys_ == rhs.keys_ && lhs.values_ == rhs.values_;
+  }
+
+  friend bool operator!=(const SortedSmallMap& lhs, const SortedSmallMap& rhs) {
+    return !(lhs == rhs);
+  }
+
+ private:
+  template <typename Q>
+  size_type lower_bound_index(const Q& key) const {
+    const auto it = std::lower_bound(keys_.begin(), keys_.end(), key, compare_);
+    return static_cast<size_type>(it - keys_.begin());
+  }
+
+  // Returns the index of the given key, or size() if the key was not found.
+  template <typename Q>
+  size_type index_of(const Q& key) const {
+    const size_type index = lower_bound_index(key);
+    return index < size() && !compare_(key, keys_[index]) ? index : size();
+  }
+
+  template <typename Map, typename Q>
+  static auto find_impl(Map& map, const Q& key)
+      -> std::optional<std::reference_wrapper<std::remove_reference_t<decltype(map.values_[0])>>> {
+    const size_type index = map.index_of(key);
+    if (index == map.size()) return {};
+    return std::ref(map.values_[index]);
+  }
+
+  template <typename Q>
+  bool erase_impl(const Q& key) {
+    const size_type index = index_of(key);
+    if (index == size()) return false;
+
+    std::rotate(keys_.begin() + index, keys_.begin() + index + 1, keys_.end());
+    std::rotate(values_.begin() + index, values_.begin() + index + 1, values_.end());
+    keys_.pop_back();
+    values_.pop_back();
+    return true;
+  }
+
+  Keys keys_;
+  Values values_;
+  Compare compare_;
+};
+
+}  // namespace android::ftl
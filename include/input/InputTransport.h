@@ -31,6 +31,7 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <android-base/chrono_utils.h>
 #include <android-base/result.h>
@@ -39,6 +40,7 @@
 #include <binder/IBinder.h>
 #include <binder/Parcelable.h>
 #include <input/Input.h>
+#include <input/TouchResampler.h>
 #include <sys/stat.h>
 #include <ui/Transform.h>
 #include <utils/BitSet.h>
@@ -258,6 +260,17 @@ public:
      */
     status_t sendMessage(const InputMessage* msg);
 
+    /* Send several messages to the other endpoint, in order, with as few system calls as
+     * possible.
+     *
+     * outSentCount is set to the number of messages that were sent, which are always the first
+     * ones. The others are guaranteed not to have been sent at all.
+     *
+     * Return OK if all of the messages were sent.
+     * Otherwise return the error of the first message that was not sent, as for sendMessage.
+     */
+    status_t sendMessages(const InputMessage* msgs, size_t count, size_t* outSentCount);
+
     /* Receive a message sent by the other endpoint.
      *
      * If there is no message present, try again after poll() indicates that the fd
@@ -387,6 +400,41 @@ public:
      */
     status_t publishDragEvent(uint32_t seq, int32_t eventId, float x, float y, bool isExiting);
 
+    /* Publishes a copy of a message that was already built for another channel, with seq as its
+     * sequence number. This saves building the same event again for each channel it is sent to
+     * unchanged, such as the monitors of a display.
+     *
+     * Returns OK on success.
+     * Returns WOULD_BLOCK if the channel is full.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Returns BAD_VALUE if seq is 0.
+     * Other errors probably indicate that the channel is broken.
+     */
+    status_t publishMessageCopy(uint32_t seq, const InputMessage& msg);
+
+    /* Defers sending the events published from now on, until sendDeferredEvents() sends them
+     * all together. The publish methods then return OK once the event is deferred, unless the
+     * event itself is invalid.
+     */
+    void deferEvents();
+
+    /* Sends the deferred events, in the order they were published, and stops deferring them.
+     *
+     * outSentCount is set to the number of events that were sent, which are always the first
+     * ones. The others are dropped, and need to be published again.
+     *
+     * Returns OK if all of the events were sent.
+     * Returns WOULD_BLOCK if the channel is full.
+     * Returns DEAD_OBJECT if the channel's peer has been closed.
+     * Other errors probably indicate that the channel is broken.
+     */
+    status_t sendDeferredEvents(size_t* outSentCount);
+
+    /* Gets the last event deferred since deferEvents(), or null if there is none. */
+    inline const InputMessage* getLastDeferredMessage() const {
+        return mDeferredMessages.empty() ? nullptr : &mDeferredMessages.back();
+    }
+
     struct Finished {
         uint32_t seq;
         bool handled;
@@ -423,6 +471,11 @@ public:
 
 private:
     std::shared_ptr<InputChannel> mChannel;
+
+    bool mDeferEvents = false;
+    std::vector<InputMessage> mDeferredMessages;
+
+    status_t sendOrDeferMessage(const InputMessage& msg);
 };
 
 /*
@@ -519,6 +572,9 @@ private:
     // True if touch resampling is enabled.
     const bool mResampleTouch;
 
+    // Predicts the touches resampled past their most recent sample.
+    const TouchResampler mResampler;
+
     std::shared_ptr<InputChannel> mChannel;
 
     // The current input message.
@@ -573,11 +629,13 @@ private:
         }
     };
     struct TouchState {
+        static constexpr size_t HISTORY_SIZE = TouchResampler::MAX_SAMPLES;
+
         int32_t deviceId;
         int32_t source;
         size_t historyCurrent;
         size_t historySize;
-        History history[2];
+        History history[HISTORY_SIZE];
         History lastResample;
 
         void initialize(int32_t deviceId, int32_t source) {
@@ -590,15 +648,27 @@ private:
         }
 
         void addHistory(const InputMessage& msg) {
-            historyCurrent ^= 1;
-            if (historySize < 2) {
+            historyCurrent = (historyCurrent + 1) % HISTORY_SIZE;
+            if (historySize < HISTORY_SIZE) {
                 historySize += 1;
             }
             history[historyCurrent].initializeFrom(msg);
         }
 
         const History* getHistory(size_t index) const {
-            return &history[(historyCurrent + index) & 1];
+            return &history[(historyCurrent + HISTORY_SIZE - index) % HISTORY_SIZE];
+        }
+
+        // Gets the most recent samples of a pointer, from the most recent one, up to the first
+        // one that is missing the pointer. Returns how many there are.
+        size_t getPointerSamples(uint32_t id, TouchResampler::Sample* outSamples) const {
+            size_t count = 0;
+            while (count < historySize && getHistory(count)->hasPointerId(id)) {
+                const History* sample = getHistory(count);
+                const PointerCoords& coords = sample->getPointerById(id);
+                outSamples[count++] = {sample->eventTime, coords.getX(), coords.getY()};
+            }
+            return count;
         }
 
         bool recentCoordinatesAreIdentical(uint32_t id) const {
@@ -668,6 +738,7 @@ private:
     static bool shouldResampleTool(int32_t toolType);
 
     static bool isTouchResamplingEnabled();
+    static TouchResampler::Strategy getTouchResamplingStrategy();
 };
 
 } // namespace android
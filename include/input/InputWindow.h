@@ -130,6 +130,18 @@ struct InputWindowInfo : public Parcelable {
         DISABLE_USER_ACTIVITY = 0x00000004,
     };
 
+    // Groups of fields that may change from one update of a window to the next.
+    enum class Change : uint32_t {
+        // Where the window is and how it is composited: its frame, surface inset, scale, alpha,
+        // transform, display size and touchable region. None of these affect focus.
+        GEOMETRY = 0x00000001,
+        // Every other field.
+        STATE = 0x00000002,
+        // The fields that decide whether the window can be focused: its token, visibility and
+        // focusability. They are part of STATE too, so a change to them sets both groups.
+        FOCUS = 0x00000004,
+    };
+
     /* These values are filled in by the WM and passed through SurfaceFlinger
      * unless specified otherwise.
      */
@@ -210,6 +222,9 @@ struct InputWindowInfo : public Parcelable {
 
     bool operator==(const InputWindowInfo& inputChannel) const;
 
+    // The groups of fields that differ from another update of the same window.
+    Flags<Change> getChanges(const InputWindowInfo& other) const;
+
     status_t writeToParcel(android::Parcel* parcel) const override;
 
     status_t readFromParcel(const android::Parcel* parcel) override;
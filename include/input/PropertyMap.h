@@ -81,6 +81,12 @@ public:
     /* Loads a property map from a file. */
     static android::base::Result<std::unique_ptr<PropertyMap>> load(const char* filename);
 
+    /* Loads a property map from a file, or shares the one already loaded from it if the file has
+     * not changed since. Devices with the same configuration file then share one parsed map.
+     */
+    static android::base::Result<std::shared_ptr<const PropertyMap>> loadShared(
+            const char* filename);
+
 private:
     class Parser {
         PropertyMap* mMap;
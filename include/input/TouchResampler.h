@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_TOUCH_RESAMPLER_H
+#define _LIBINPUT_TOUCH_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/*
+ * Predicts the position of a touch pointer at the time a frame samples it, when no sample newer
+ * than that time has been received yet.
+ *
+ * Predicting further ahead lowers the perceived latency of touches, at the cost of mispredicting
+ * their position when they change speed or direction. Each strategy picks its own trade-off.
+ */
+class TouchResampler {
+public:
+    enum class Strategy : int32_t {
+        DEFAULT = -1,
+        MIN = 0,
+        // Extrapolates linearly from the two most recent samples, behind the frame time.
+        LINEAR = 0,
+        // Extrapolates from the three most recent samples assuming a constant acceleration, up to
+        // the frame time. The acceleration is only trusted up to a fraction of the predicted
+        // movement, which bounds the error it adds over the linear prediction.
+        ACCELERATION = 1,
+        MAX = ACCELERATION,
+    };
+
+    struct Sample {
+        nsecs_t eventTime;
+        float x, y;
+    };
+
+    // Most samples of a pointer that any strategy uses.
+    static constexpr size_t MAX_SAMPLES = 3;
+
+    explicit TouchResampler(Strategy strategy = Strategy::DEFAULT);
+
+    inline Strategy getStrategy() const { return mStrategy; }
+
+    // How far behind the frame time touches are resampled.
+    nsecs_t getLatency() const;
+
+    // Latest time to predict to, given the times of the two most recent samples.
+    nsecs_t getMaxPredictionTime(nsecs_t currentTime, nsecs_t previousTime) const;
+
+    // Predicts the position of a pointer at sampleTime, which is no earlier than the time of its
+    // most recent sample. The samples are ordered from the most recent one, at least two of them
+    // are required, and at most MAX_SAMPLES are used.
+    void extrapolate(const Sample* samples, size_t count, nsecs_t sampleTime, float* outX,
+                     float* outY) const;
+
+private:
+    // The default strategy keeps the resampling that applications have always been getting.
+    static const Strategy DEFAULT_STRATEGY = Strategy::LINEAR;
+
+    const Strategy mStrategy;
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_TOUCH_RESAMPLER_H
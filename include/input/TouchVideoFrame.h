@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 #include <sys/time.h>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,6 +28,10 @@ namespace android {
  * Represents data from a single scan of the touchscreen device.
  * Similar in concept to a video frame, but the touch strength is used as
  * the values instead.
+ *
+ * Copies of a frame share its data, so that a frame can be passed along by value from the reader
+ * to the classifier without copying the heatmap each time. The data is only copied when one of
+ * the copies is rotated.
  */
 class TouchVideoFrame {
 public:
@@ -64,7 +69,7 @@ public:
 private:
     uint32_t mHeight;
     uint32_t mWidth;
-    std::vector<int16_t> mData;
+    std::shared_ptr<std::vector<int16_t>> mData;
     struct timeval mTimestamp;
 
     /**
@@ -24,6 +24,10 @@
 #include <android/hardware/power/Mode.h>
 #include <powermanager/PowerHalWrapper.h>
 
+#include <array>
+#include <chrono>
+#include <optional>
+
 namespace android {
 
 namespace power {
@@ -46,11 +50,15 @@ public:
 // This relies on HalConnector to connect to the underlying Power HAL
 // service and reconnects to it after each failed api call. This also ensures
 // connecting to the service is thread-safe.
+// A non-zero rate limit window makes the controller drop a setBoost or setMode
+// call that repeats the last successful one for the same boost or mode within
+// that window, instead of forwarding it to the HAL.
 class PowerHalController : public HalWrapper {
 public:
     PowerHalController() : PowerHalController(std::make_unique<HalConnector>()) {}
-    explicit PowerHalController(std::unique_ptr<HalConnector> connector)
-          : mHalConnector(std::move(connector)) {}
+    explicit PowerHalController(std::unique_ptr<HalConnector> connector,
+                                std::chrono::milliseconds rateLimitWindow = {})
+          : mHalConnector(std::move(connector)), mRateLimitWindow(rateLimitWindow) {}
     virtual ~PowerHalController() = default;
 
     void init();
@@ -63,8 +71,24 @@ public:
     virtual HalResult<int64_t> getHintSessionPreferredRate() override;
 
 private:
+    // Last call forwarded to the HAL for a boost or mode, with its duration or
+    // enabled state.
+    struct HalCall {
+        std::optional<std::chrono::steady_clock::time_point> time;
+        int32_t value = 0;
+    };
+
     std::mutex mConnectedHalMutex;
     std::unique_ptr<HalConnector> mHalConnector;
+    const std::chrono::milliseconds mRateLimitWindow;
+
+    // Same bounds as the supported arrays of AidlHalWrapper, calls for later
+    // boosts and modes are never rate limited.
+    std::mutex mLastHalCallMutex;
+    std::array<HalCall, static_cast<int32_t>(hardware::power::Boost::DISPLAY_UPDATE_IMMINENT) + 1>
+            mLastBoostCalls GUARDED_BY(mLastHalCallMutex);
+    std::array<HalCall, static_cast<int32_t>(hardware::power::Mode::DISPLAY_INACTIVE) + 1>
+            mLastModeCalls GUARDED_BY(mLastHalCallMutex);
 
     // Shared pointers to keep global pointer and allow local copies to be used in
     // different threads
@@ -74,6 +98,14 @@ private:
     std::shared_ptr<HalWrapper> initHal();
     template <typename T>
     HalResult<T> processHalResult(HalResult<T> result, const char* functionName);
+    // Returns false if the call with value repeats the last one recorded in
+    // calls[index] within the rate limit window, otherwise records it.
+    template <size_t N>
+    bool shouldForwardHalCall(std::array<HalCall, N>& calls, size_t index, int32_t value);
+    // Forgets the call recorded in calls[index], so that the next one is
+    // forwarded even if it repeats it.
+    template <size_t N>
+    void forgetHalCall(std::array<HalCall, N>& calls, size_t index);
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -206,6 +206,9 @@ private:
     std::array<std::atomic<HalSupport>,
                static_cast<int32_t>(hardware::power::Mode::DISPLAY_INACTIVE) + 1>
             mModeSupportedArray GUARDED_BY(mModeMutex) = {HalSupport::UNKNOWN};
+    // The preferred rate doesn't change for the lifetime of the HAL, so it is
+    // only queried once successfully. Negative while unknown.
+    std::atomic<int64_t> mHintSessionPreferredRate = -1;
 };
 
 }; // namespace power
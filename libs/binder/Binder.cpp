@@ -17,7 +17,11 @@
 #include <binder/Binder.h>
 
 #include <atomic>
+#include <cutils/compiler.h>
+#include <cutils/trace.h>
+#include <utils/String8.h>
 #include <utils/misc.h>
+#include <binder/BinderStats.h>
 #include <binder/BpBinder.h>
 #include <binder/IInterface.h>
 #include <binder/IResultReceiver.h>
@@ -27,6 +31,8 @@
 #include <linux/sched.h>
 #include <stdio.h>
 
+#include "TransactionStatsTable.h"
+
 namespace android {
 
 // Service implementations inherit from BBinder and IBinder, and this is frozen
@@ -136,11 +142,77 @@ status_t IBinder::getDebugPid(pid_t* out) {
     return OK;
 }
 
+status_t IBinder::getDebugParcelPoolStats(uint64_t* outHits, uint64_t* outMisses,
+                                          uint64_t* outCachedBytes) {
+    BBinder* local = this->localBinder();
+    if (local != nullptr) {
+        *outHits = Parcel::getGlobalBufferPoolHits();
+        *outMisses = Parcel::getGlobalBufferPoolMisses();
+        *outCachedBytes = Parcel::getGlobalBufferPoolCachedBytes();
+        return OK;
+    }
+
+    BpBinder* proxy = this->remoteBinder();
+    LOG_ALWAYS_FATAL_IF(proxy == nullptr);
+
+    Parcel data;
+    Parcel reply;
+    status_t status = transact(DEBUG_PARCEL_POOL_TRANSACTION, data, &reply);
+    if (status != OK) return status;
+
+    if ((status = reply.readUint64(outHits)) != OK) return status;
+    if ((status = reply.readUint64(outMisses)) != OK) return status;
+    return reply.readUint64(outCachedBytes);
+}
+
+status_t IBinder::getDebugTransactionStats(std::vector<BinderTransactionStats>* out) {
+    BBinder* local = this->localBinder();
+    if (local != nullptr) {
+        *out = local->getTransactionStats();
+        return OK;
+    }
+
+    BpBinder* proxy = this->remoteBinder();
+    LOG_ALWAYS_FATAL_IF(proxy == nullptr);
+
+    Parcel data;
+    Parcel reply;
+    status_t status = transact(DEBUG_TRANSACTION_STATS_TRANSACTION, data, &reply);
+    if (status != OK) return status;
+
+    int32_t numCodes;
+    if ((status = reply.readInt32(&numCodes)) != OK) return status;
+    if (numCodes < 0 || static_cast<size_t>(numCodes) > reply.dataAvail()) return BAD_VALUE;
+
+    out->clear();
+    out->resize(numCodes);
+    for (BinderTransactionStats& stats : *out) {
+        if ((status = reply.readUint32(&stats.code)) != OK) return status;
+        if ((status = reply.readUint64(&stats.count)) != OK) return status;
+        if ((status = reply.readUint64(&stats.dataBytes)) != OK) return status;
+        if ((status = reply.readUint64(&stats.replyBytes)) != OK) return status;
+
+        int32_t numBuckets;
+        if ((status = reply.readInt32(&numBuckets)) != OK) return status;
+        if (static_cast<size_t>(numBuckets) != BinderTransactionStats::kNumLatencyBuckets) {
+            return BAD_VALUE;
+        }
+        for (uint64_t& bucket : stats.latencyBuckets) {
+            if ((status = reply.readUint64(&bucket)) != OK) return status;
+        }
+    }
+    return OK;
+}
+
 // ---------------------------------------------------------------------------
 
+static std::atomic<bool> gTransactionStatsEnabled = false;
+
 class BBinder::Extras
 {
 public:
+    ~Extras() { delete mStats.load(std::memory_order_relaxed); }
+
     // unlocked objects
     bool mRequestingSid = false;
     bool mInheritRt = false;
@@ -148,6 +220,9 @@ public:
     int mPolicy = SCHED_NORMAL;
     int mPriority = 0;
 
+    // only allocated while transaction stats are enabled
+    std::atomic<TransactionStatsTable*> mStats = nullptr;
+
     // for below objects
     Mutex mLock;
     BpBinder::ObjectManager mObjects;
@@ -182,6 +257,45 @@ const String16& BBinder::getInterfaceDescriptor() const
 status_t BBinder::transact(
     uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags)
 {
+    if (CC_UNLIKELY(gTransactionStatsEnabled.load(std::memory_order_relaxed))) {
+        return transactAndRecordStats(code, data, reply, flags);
+    }
+    return transactInternal(code, data, reply, flags);
+}
+
+status_t BBinder::transactAndRecordStats(uint32_t code, const Parcel& data, Parcel* reply,
+                                         uint32_t flags) {
+    nsecs_t startNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    status_t err = transactInternal(code, data, reply, flags);
+    nsecs_t latencyNs = systemTime(SYSTEM_TIME_MONOTONIC) - startNs;
+
+    Extras* e = getOrCreateExtras();
+    if (!e) return err; // out of memory
+
+    TransactionStatsTable* stats = e->mStats.load(std::memory_order_acquire);
+    if (!stats) {
+        stats = new TransactionStatsTable;
+        TransactionStatsTable* expected = nullptr;
+        if (!e->mStats.compare_exchange_strong(expected, stats, std::memory_order_release,
+                                               std::memory_order_acquire)) {
+            delete stats;
+            stats = expected; // Filled in by CAS
+        }
+    }
+    stats->record(code, data.dataSize(), reply != nullptr ? reply->dataSize() : 0, latencyNs);
+
+    // shows up as a counter track in perfetto/systrace
+    if (CC_UNLIKELY(atrace_is_tag_enabled(ATRACE_TAG_AIDL))) {
+        String8 name = String8::format("binder latency us %s:%u",
+                                       String8(getInterfaceDescriptor()).c_str(), code);
+        atrace_int64(ATRACE_TAG_AIDL, name.c_str(), latencyNs / 1000);
+    }
+
+    return err;
+}
+
+status_t BBinder::transactInternal(uint32_t code, const Parcel& data, Parcel* reply,
+                                   uint32_t flags) {
     data.setDataPosition(0);
 
     if (reply != nullptr && (flags & FLAG_CLEAR_BUF)) {
@@ -199,6 +313,30 @@ status_t BBinder::transact(
         case DEBUG_PID_TRANSACTION:
             err = reply->writeInt32(getDebugPid());
             break;
+        case DEBUG_PARCEL_POOL_TRANSACTION:
+            if ((err = reply->writeUint64(Parcel::getGlobalBufferPoolHits())) != OK) break;
+            if ((err = reply->writeUint64(Parcel::getGlobalBufferPoolMisses())) != OK) break;
+            err = reply->writeUint64(Parcel::getGlobalBufferPoolCachedBytes());
+            break;
+        case DEBUG_TRANSACTION_STATS_TRANSACTION: {
+            std::vector<BinderTransactionStats> allStats = getTransactionStats();
+            if ((err = reply->writeInt32(allStats.size())) != OK) break;
+            for (const BinderTransactionStats& stats : allStats) {
+                if ((err = reply->writeUint32(stats.code)) != OK) break;
+                if ((err = reply->writeUint64(stats.count)) != OK) break;
+                if ((err = reply->writeUint64(stats.dataBytes)) != OK) break;
+                if ((err = reply->writeUint64(stats.replyBytes)) != OK) break;
+                if ((err = reply->writeInt32(static_cast<int32_t>(
+                             BinderTransactionStats::kNumLatencyBuckets))) != OK) {
+                    break;
+                }
+                for (uint64_t bucket : stats.latencyBuckets) {
+                    if ((err = reply->writeUint64(bucket)) != OK) break;
+                }
+                if (err != OK) break;
+            }
+            break;
+        }
         default:
             err = onTransact(code, data, reply, flags);
             break;
@@ -363,6 +501,19 @@ pid_t BBinder::getDebugPid() {
     return getpid();
 }
 
+void BBinder::setTransactionStatsEnabled(bool enabled) {
+    gTransactionStatsEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+std::vector<BinderTransactionStats> BBinder::getTransactionStats() {
+    Extras* e = mExtras.load(std::memory_order_acquire);
+    if (e == nullptr) return {};
+
+    TransactionStatsTable* stats = e->mStats.load(std::memory_order_acquire);
+    if (stats == nullptr) return {};
+    return stats->snapshot();
+}
+
 void BBinder::setExtension(const sp<IBinder>& extension) {
     Extras* e = getOrCreateExtras();
     e->mExtension = extension;
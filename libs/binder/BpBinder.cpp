@@ -35,24 +35,44 @@ namespace android {
 
 // ---------------------------------------------------------------------------
 
-Mutex BpBinder::sTrackingLock;
-std::unordered_map<int32_t, uint32_t> BpBinder::sTrackingMap;
-std::unordered_map<int32_t, uint32_t> sLastLimitCallbackMap;
 int BpBinder::sNumTrackedUids = 0;
 std::atomic_bool BpBinder::sCountByUidEnabled(false);
-binder_proxy_limit_callback BpBinder::sLimitCallback;
+std::atomic<binder_proxy_limit_callback> BpBinder::sLimitCallback;
 bool BpBinder::sBinderProxyThrottleCreate = false;
 
 // Arbitrarily high value that probably distinguishes a bad behaving app
-uint32_t BpBinder::sBinderProxyCountHighWatermark = 2500;
+std::atomic<uint32_t> BpBinder::sBinderProxyCountHighWatermark = 2500;
 // Another arbitrary value a binder count needs to drop below before another callback will be called
-uint32_t BpBinder::sBinderProxyCountLowWatermark = 2000;
+std::atomic<uint32_t> BpBinder::sBinderProxyCountLowWatermark = 2000;
 
 enum {
     LIMIT_REACHED_MASK = 0x80000000,        // A flag denoting that the limit has been reached
     COUNTING_VALUE_MASK = 0x7FFFFFFF,       // A mask of the remaining bits for the count value
 };
 
+namespace {
+
+// Proxies are counted per calling uid. The counts are split across shards by
+// uid so that processes creating many proxies, for many uids, on many threads
+// don't all serialize on a single lock.
+constexpr size_t kNumTrackingShards = 16;
+
+struct TrackingShard {
+    Mutex lock;
+    // uid -> proxy count, with LIMIT_REACHED_MASK
+    std::unordered_map<int32_t, uint32_t> counts;
+    // uid -> count at which the limit callback was last called
+    std::unordered_map<int32_t, uint32_t> lastLimitCallback;
+};
+
+TrackingShard gTrackingShards[kNumTrackingShards];
+
+TrackingShard& trackingShard(int32_t uid) {
+    return gTrackingShards[static_cast<uint32_t>(uid) % kNumTrackingShards];
+}
+
+} // namespace
+
 BpBinder::ObjectManager::ObjectManager()
 {
 }
@@ -71,35 +91,30 @@ void BpBinder::ObjectManager::attach(
     e.cleanupCookie = cleanupCookie;
     e.func = func;
 
-    if (mObjects.indexOfKey(objectID) >= 0) {
+    if (!mObjects.emplace(objectID, e).second) {
         ALOGE("Trying to attach object ID %p to binder ObjectManager %p with object %p, but object ID already in use",
                 objectID, this,  object);
-        return;
     }
-
-    mObjects.add(objectID, e);
 }
 
 void* BpBinder::ObjectManager::find(const void* objectID) const
 {
-    const ssize_t i = mObjects.indexOfKey(objectID);
-    if (i < 0) return nullptr;
-    return mObjects.valueAt(i).object;
+    auto i = mObjects.find(objectID);
+    if (i == mObjects.end()) return nullptr;
+    return i->second.object;
 }
 
 void BpBinder::ObjectManager::detach(const void* objectID)
 {
-    mObjects.removeItem(objectID);
+    mObjects.erase(objectID);
 }
 
 void BpBinder::ObjectManager::kill()
 {
-    const size_t N = mObjects.size();
-    ALOGV("Killing %zu objects in manager %p", N, this);
-    for (size_t i=0; i<N; i++) {
-        const entry_t& e = mObjects.valueAt(i);
+    ALOGV("Killing %zu objects in manager %p", mObjects.size(), this);
+    for (const auto& [objectID, e] : mObjects) {
         if (e.func != nullptr) {
-            e.func(mObjects.keyAt(i), e.object, e.cleanupCookie);
+            e.func(objectID, e.object, e.cleanupCookie);
         }
     }
 
@@ -112,39 +127,42 @@ sp<BpBinder> BpBinder::create(int32_t handle) {
     int32_t trackedUid = -1;
     if (sCountByUidEnabled) {
         trackedUid = IPCThreadState::self()->getCallingUid();
-        AutoMutex _l(sTrackingLock);
-        uint32_t trackedValue = sTrackingMap[trackedUid];
+        TrackingShard& shard = trackingShard(trackedUid);
+        AutoMutex _l(shard.lock);
+        uint32_t& trackedCount = shard.counts[trackedUid];
+        uint32_t trackedValue = trackedCount;
+        const uint32_t highWatermark = sBinderProxyCountHighWatermark.load();
         if (CC_UNLIKELY(trackedValue & LIMIT_REACHED_MASK)) {
             if (sBinderProxyThrottleCreate) {
                 return nullptr;
             }
             trackedValue = trackedValue & COUNTING_VALUE_MASK;
-            uint32_t lastLimitCallbackAt = sLastLimitCallbackMap[trackedUid];
+            uint32_t lastLimitCallbackAt = shard.lastLimitCallback[trackedUid];
 
             if (trackedValue > lastLimitCallbackAt &&
-                (trackedValue - lastLimitCallbackAt > sBinderProxyCountHighWatermark)) {
+                (trackedValue - lastLimitCallbackAt > highWatermark)) {
                 ALOGE("Still too many binder proxy objects sent to uid %d from uid %d (%d proxies "
                       "held)",
                       getuid(), trackedUid, trackedValue);
-                if (sLimitCallback) sLimitCallback(trackedUid);
-                sLastLimitCallbackMap[trackedUid] = trackedValue;
+                if (auto cb = sLimitCallback.load()) cb(trackedUid);
+                shard.lastLimitCallback[trackedUid] = trackedValue;
             }
         } else {
-            if ((trackedValue & COUNTING_VALUE_MASK) >= sBinderProxyCountHighWatermark) {
+            if ((trackedValue & COUNTING_VALUE_MASK) >= highWatermark) {
                 ALOGE("Too many binder proxy objects sent to uid %d from uid %d (%d proxies held)",
                       getuid(), trackedUid, trackedValue);
-                sTrackingMap[trackedUid] |= LIMIT_REACHED_MASK;
-                if (sLimitCallback) sLimitCallback(trackedUid);
-                sLastLimitCallbackMap[trackedUid] = trackedValue & COUNTING_VALUE_MASK;
+                trackedCount |= LIMIT_REACHED_MASK;
+                if (auto cb = sLimitCallback.load()) cb(trackedUid);
+                shard.lastLimitCallback[trackedUid] = trackedValue & COUNTING_VALUE_MASK;
                 if (sBinderProxyThrottleCreate) {
                     ALOGI("Throttling binder proxy creates from uid %d in uid %d until binder proxy"
                           " count drops below %d",
-                          trackedUid, getuid(), sBinderProxyCountLowWatermark);
+                          trackedUid, getuid(), sBinderProxyCountLowWatermark.load());
                     return nullptr;
                 }
             }
         }
-        sTrackingMap[trackedUid]++;
+        trackedCount++;
     }
     return sp<BpBinder>::make(BinderHandle{handle}, trackedUid);
 }
@@ -454,23 +472,25 @@ BpBinder::~BpBinder()
     IPCThreadState* ipc = IPCThreadState::self();
 
     if (mTrackedUid >= 0) {
-        AutoMutex _l(sTrackingLock);
-        uint32_t trackedValue = sTrackingMap[mTrackedUid];
-        if (CC_UNLIKELY((trackedValue & COUNTING_VALUE_MASK) == 0)) {
+        TrackingShard& shard = trackingShard(mTrackedUid);
+        AutoMutex _l(shard.lock);
+        auto it = shard.counts.find(mTrackedUid);
+        if (CC_UNLIKELY(it == shard.counts.end() || (it->second & COUNTING_VALUE_MASK) == 0)) {
             ALOGE("Unexpected Binder Proxy tracking decrement in %p handle %d\n", this,
                   binderHandle());
         } else {
+            uint32_t& trackedCount = it->second;
             if (CC_UNLIKELY(
-                (trackedValue & LIMIT_REACHED_MASK) &&
-                ((trackedValue & COUNTING_VALUE_MASK) <= sBinderProxyCountLowWatermark)
+                (trackedCount & LIMIT_REACHED_MASK) &&
+                ((trackedCount & COUNTING_VALUE_MASK) <= sBinderProxyCountLowWatermark.load())
                 )) {
                 ALOGI("Limit reached bit reset for uid %d (fewer than %d proxies from uid %d held)",
-                      getuid(), sBinderProxyCountLowWatermark, mTrackedUid);
-                sTrackingMap[mTrackedUid] &= ~LIMIT_REACHED_MASK;
-                sLastLimitCallbackMap.erase(mTrackedUid);
+                      getuid(), sBinderProxyCountLowWatermark.load(), mTrackedUid);
+                trackedCount &= ~LIMIT_REACHED_MASK;
+                shard.lastLimitCallback.erase(mTrackedUid);
             }
-            if (--sTrackingMap[mTrackedUid] == 0) {
-                sTrackingMap.erase(mTrackedUid);
+            if (--trackedCount == 0) {
+                shard.counts.erase(it);
             }
         }
     }
@@ -535,9 +555,10 @@ bool BpBinder::onIncStrongAttempted(uint32_t /*flags*/, const void* /*id*/)
 
 uint32_t BpBinder::getBinderProxyCount(uint32_t uid)
 {
-    AutoMutex _l(sTrackingLock);
-    auto it = sTrackingMap.find(uid);
-    if (it != sTrackingMap.end()) {
+    TrackingShard& shard = trackingShard(uid);
+    AutoMutex _l(shard.lock);
+    auto it = shard.counts.find(uid);
+    if (it != shard.counts.end()) {
         return it->second & COUNTING_VALUE_MASK;
     }
     return 0;
@@ -545,12 +566,12 @@ uint32_t BpBinder::getBinderProxyCount(uint32_t uid)
 
 void BpBinder::getCountByUid(Vector<uint32_t>& uids, Vector<uint32_t>& counts)
 {
-    AutoMutex _l(sTrackingLock);
-    uids.setCapacity(sTrackingMap.size());
-    counts.setCapacity(sTrackingMap.size());
-    for (const auto& it : sTrackingMap) {
-        uids.push_back(it.first);
-        counts.push_back(it.second & COUNTING_VALUE_MASK);
+    for (TrackingShard& shard : gTrackingShards) {
+        AutoMutex _l(shard.lock);
+        for (const auto& it : shard.counts) {
+            uids.push_back(it.first);
+            counts.push_back(it.second & COUNTING_VALUE_MASK);
+        }
     }
 }
 
@@ -559,14 +580,12 @@ void BpBinder::disableCountByUid() { sCountByUidEnabled.store(false); }
 void BpBinder::setCountByUidEnabled(bool enable) { sCountByUidEnabled.store(enable); }
 
 void BpBinder::setLimitCallback(binder_proxy_limit_callback cb) {
-    AutoMutex _l(sTrackingLock);
-    sLimitCallback = cb;
+    sLimitCallback.store(cb);
 }
 
 void BpBinder::setBinderProxyCountWatermarks(int high, int low) {
-    AutoMutex _l(sTrackingLock);
-    sBinderProxyCountHighWatermark = high;
-    sBinderProxyCountLowWatermark = low;
+    sBinderProxyCountHighWatermark.store(high);
+    sBinderProxyCountLowWatermark.store(low);
 }
 
 // ---------------------------------------------------------------------------
@@ -62,7 +62,9 @@ private:
 
     void free_heap(const wp<IBinder>& binder);
 
-    Mutex mHeapCacheLock;  // Protects entire vector below.
+    // Protects entire vector below. Looking up a heap, which IMemory::fastPointer does on every
+    // call, only needs to read it.
+    RWLock mHeapCacheLock;
     KeyedVector< wp<IBinder>, heap_info_t > mHeapCache;
     // We do not use the copy-on-write capabilities of KeyedVector.
     // TODO: Reimplemement based on standard C++ container?
@@ -90,6 +92,7 @@ public:
 
 private:
     friend class IMemory;
+    friend class BpMemory;
     friend class HeapCache;
 
     // for debugging in this module
@@ -106,8 +109,19 @@ private:
         gHeapCache->dump_heaps();
     }
 
-    void assertMapped() const;
-    void assertReallyMapped() const;
+    // What HEAP_ID replies with, which GET_MEMORY also sends along with the heap.
+    struct HeapInfo {
+        int fd;
+        uint64_t size;
+        int64_t offset;
+        uint32_t flags;
+    };
+
+    static bool readHeapInfo(const Parcel& reply, HeapInfo* outInfo);
+
+    // Maps the heap, using info instead of asking the remote heap for it when given.
+    void assertMapped(const HeapInfo* info = nullptr) const;
+    void assertReallyMapped(const HeapInfo* info = nullptr) const;
 
     mutable std::atomic<int32_t> mHeapId;
     mutable void*       mBase;
@@ -196,6 +210,13 @@ sp<IMemoryHeap> BpMemory::getMemory(ssize_t* offset, size_t* size) const
                 if (mHeap != nullptr) {
                     const int64_t offset64 = reply.readInt64();
                     const uint64_t size64 = reply.readUint64();
+                    // Newer implementations send the heap along, which saves the HEAP_ID
+                    // transaction that mapping it would otherwise make.
+                    BpMemoryHeap::HeapInfo heapInfo;
+                    if (heap->remoteBinder() != nullptr && reply.dataAvail() > 0 &&
+                            BpMemoryHeap::readHeapInfo(reply, &heapInfo)) {
+                        static_cast<const BpMemoryHeap*>(mHeap.get())->assertMapped(&heapInfo);
+                    }
                     const ssize_t o = (ssize_t)offset64;
                     const size_t s = (size_t)size64;
                     size_t heapSize = mHeap->getSize();
@@ -240,9 +261,19 @@ status_t BnMemory::onTransact(
             CHECK_INTERFACE(IMemory, data, reply);
             ssize_t offset;
             size_t size;
-            reply->writeStrongBinder( IInterface::asBinder(getMemory(&offset, &size)) );
+            sp<IMemoryHeap> heap = getMemory(&offset, &size);
+            reply->writeStrongBinder( IInterface::asBinder(heap) );
             reply->writeInt64(offset);
             reply->writeUint64(size);
+            // Also send what HEAP_ID would, after what older clients read, unless the heap
+            // isn't ours to map.
+            if (heap != nullptr && IInterface::asBinder(heap)->localBinder() != nullptr &&
+                    heap->getHeapID() >= 0) {
+                reply->writeFileDescriptor(heap->getHeapID());
+                reply->writeUint64(heap->getSize());
+                reply->writeInt64(heap->getOffset());
+                reply->writeUint32(heap->getFlags());
+            }
             return NO_ERROR;
         } break;
         default:
@@ -283,13 +314,24 @@ BpMemoryHeap::~BpMemoryHeap() {
     }
 }
 
-void BpMemoryHeap::assertMapped() const
+bool BpMemoryHeap::readHeapInfo(const Parcel& reply, HeapInfo* outInfo)
+{
+    outInfo->fd = reply.readFileDescriptor();
+    if (reply.readUint64(&outInfo->size) != NO_ERROR ||
+            reply.readInt64(&outInfo->offset) != NO_ERROR ||
+            reply.readUint32(&outInfo->flags) != NO_ERROR) {
+        return false;
+    }
+    return outInfo->fd >= 0;
+}
+
+void BpMemoryHeap::assertMapped(const HeapInfo* info) const
 {
     int32_t heapId = mHeapId.load(memory_order_acquire);
     if (heapId == -1) {
         sp<IBinder> binder(IInterface::asBinder(const_cast<BpMemoryHeap*>(this)));
         sp<BpMemoryHeap> heap = sp<BpMemoryHeap>::cast(find_heap(binder));
-        heap->assertReallyMapped();
+        heap->assertReallyMapped(info);
         if (heap->mBase != MAP_FAILED) {
             Mutex::Autolock _l(mLock);
             if (mHeapId.load(memory_order_relaxed) == -1) {
@@ -308,7 +350,7 @@ void BpMemoryHeap::assertMapped() const
     }
 }
 
-void BpMemoryHeap::assertReallyMapped() const
+void BpMemoryHeap::assertReallyMapped(const HeapInfo* info) const
 {
     int32_t heapId = mHeapId.load(memory_order_acquire);
     if (heapId == -1) {
@@ -317,13 +359,25 @@ void BpMemoryHeap::assertReallyMapped() const
         // calling transact() from multiple threads, but that's not a problem,
         // only mmap below must be in the critical section.
 
-        Parcel data, reply;
-        data.writeInterfaceToken(IMemoryHeap::getInterfaceDescriptor());
-        status_t err = remote()->transact(HEAP_ID, data, &reply);
-        int parcel_fd = reply.readFileDescriptor();
-        const uint64_t size64 = reply.readUint64();
-        const int64_t offset64 = reply.readInt64();
-        const uint32_t flags = reply.readUint32();
+        status_t err = NO_ERROR;
+        // Owns the fd of the heap, until it is dup'ed below.
+        Parcel reply;
+        HeapInfo heapInfo;
+        if (info != nullptr) {
+            heapInfo = *info;
+        } else {
+            Parcel data;
+            data.writeInterfaceToken(IMemoryHeap::getInterfaceDescriptor());
+            err = remote()->transact(HEAP_ID, data, &reply);
+            heapInfo.fd = reply.readFileDescriptor();
+            heapInfo.size = reply.readUint64();
+            heapInfo.offset = reply.readInt64();
+            heapInfo.flags = reply.readUint32();
+        }
+        int parcel_fd = heapInfo.fd;
+        const uint64_t size64 = heapInfo.size;
+        const int64_t offset64 = heapInfo.offset;
+        const uint32_t flags = heapInfo.flags;
         const size_t size = (size_t)size64;
         const off_t offset = (off_t)offset64;
         if (err != NO_ERROR || // failed transaction
@@ -433,7 +487,7 @@ void HeapCache::binderDied(const wp<IBinder>& binder)
 
 sp<IMemoryHeap> HeapCache::find_heap(const sp<IBinder>& binder)
 {
-    Mutex::Autolock _l(mHeapCacheLock);
+    RWLock::AutoWLock _l(mHeapCacheLock);
     ssize_t i = mHeapCache.indexOfKey(binder);
     if (i>=0) {
         heap_info_t& info = mHeapCache.editValueAt(i);
@@ -465,7 +519,7 @@ void HeapCache::free_heap(const wp<IBinder>& binder)
 {
     sp<IMemoryHeap> rel;
     {
-        Mutex::Autolock _l(mHeapCacheLock);
+        RWLock::AutoWLock _l(mHeapCacheLock);
         ssize_t i = mHeapCache.indexOfKey(binder);
         if (i>=0) {
             heap_info_t& info(mHeapCache.editValueAt(i));
@@ -489,7 +543,7 @@ void HeapCache::free_heap(const wp<IBinder>& binder)
 sp<IMemoryHeap> HeapCache::get_heap(const sp<IBinder>& binder)
 {
     sp<IMemoryHeap> realHeap;
-    Mutex::Autolock _l(mHeapCacheLock);
+    RWLock::AutoRLock _l(mHeapCacheLock);
     ssize_t i = mHeapCache.indexOfKey(binder);
     if (i>=0)   realHeap = mHeapCache.valueAt(i).heap;
     else        realHeap = interface_cast<IMemoryHeap>(binder);
@@ -498,7 +552,7 @@ sp<IMemoryHeap> HeapCache::get_heap(const sp<IBinder>& binder)
 
 void HeapCache::dump_heaps()
 {
-    Mutex::Autolock _l(mHeapCacheLock);
+    RWLock::AutoRLock _l(mHeapCacheLock);
     int c = mHeapCache.size();
     for (int i=0 ; i<c ; i++) {
         const heap_info_t& info = mHeapCache.valueAt(i);
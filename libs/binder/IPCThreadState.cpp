@@ -21,6 +21,7 @@
 #include <binder/Binder.h>
 #include <binder/BpBinder.h>
 #include <binder/TextOutput.h>
+#include <binder/TransactionTrace.h>
 
 #include <android-base/macros.h>
 #include <cutils/sched_policy.h>
@@ -32,6 +33,7 @@
 #include <atomic>
 #include <errno.h>
 #include <inttypes.h>
+#include <poll.h>
 #include <pthread.h>
 #include <sched.h>
 #include <signal.h>
@@ -40,6 +42,7 @@
 #include <sys/resource.h>
 #include <unistd.h>
 
+#include "ParcelBufferPool.h"
 #include "Static.h"
 #include "binder_module.h"
 
@@ -284,6 +287,10 @@ static std::atomic<bool> gHaveTLS(false);
 static pthread_key_t gTLS = 0;
 static std::atomic<bool> gShutdown = false;
 static std::atomic<bool> gDisableBackgroundScheduling = false;
+static std::atomic<bool> gAutoOnewayBatching = false;
+
+// Upper bound on oneway transactions queued in mOut before they are flushed.
+static constexpr size_t kMaxBatchedOneway = 32;
 
 IPCThreadState* IPCThreadState::self()
 {
@@ -352,6 +359,11 @@ bool IPCThreadState::backgroundSchedulingDisabled()
     return gDisableBackgroundScheduling.load(std::memory_order_relaxed);
 }
 
+void IPCThreadState::enableAutoOnewayBatching(bool enable)
+{
+    gAutoOnewayBatching.store(enable, std::memory_order_relaxed);
+}
+
 sp<ProcessState> IPCThreadState::process()
 {
     return mProcess;
@@ -475,6 +487,9 @@ void IPCThreadState::flushCommands()
 {
     if (mProcess->mDriverFD < 0)
         return;
+    if (mPendingOnewayCount > 0) {
+        flushOnewayBatch();
+    }
     talkWithDriver(false);
     // The flush could have caused post-write refcount decrements to have
     // been executed, which in turn could result in BC_RELEASE/BC_DECREFS
@@ -502,6 +517,40 @@ bool IPCThreadState::flushIfNeeded()
     return true;
 }
 
+void IPCThreadState::beginOnewayBatch()
+{
+    mOnewayBatchDepth++;
+}
+
+status_t IPCThreadState::endOnewayBatch()
+{
+    LOG_ALWAYS_FATAL_IF(mOnewayBatchDepth == 0, "endOnewayBatch() without beginOnewayBatch()");
+    if (--mOnewayBatchDepth > 0) {
+        return NO_ERROR;
+    }
+    return flushOnewayBatch();
+}
+
+status_t IPCThreadState::flushOnewayBatch()
+{
+    status_t result = NO_ERROR;
+    while (mPendingOnewayCount > 0) {
+        // The first wait writes every queued transaction with a single ioctl. Each of
+        // them is then answered by exactly one BR_TRANSACTION_COMPLETE or error.
+        mPendingOnewayCount--;
+        const status_t err = waitForResponse(nullptr, nullptr);
+        if (err == NO_ERROR) continue;
+
+        ALOGW("Batched oneway transaction failed: %s", statusToString(err).c_str());
+        if (result == NO_ERROR) result = err;
+        if (err != DEAD_OBJECT && err != FAILED_TRANSACTION) {
+            // Not a per-transaction error from the driver, we can't tell what is left.
+            mPendingOnewayCount = 0;
+        }
+    }
+    return result;
+}
+
 void IPCThreadState::blockUntilThreadAvailable()
 {
     pthread_mutex_lock(&mProcess->mThreadCountLock);
@@ -531,14 +580,29 @@ status_t IPCThreadState::getAndExecuteCommand()
                  << getReturnString(cmd) << endl;
         }
 
+        bool spawnThread = false;
         pthread_mutex_lock(&mProcess->mThreadCountLock);
         mProcess->mExecutingThreadsCount++;
         if (mProcess->mExecutingThreadsCount >= mProcess->mMaxThreads &&
                 mProcess->mStarvationStartTimeMs == 0) {
             mProcess->mStarvationStartTimeMs = uptimeMillis();
+            mProcess->mThreadPoolStats.starvations++;
+        }
+        // No pool thread is left waiting for the next command, so add one
+        // before it arrives.
+        if (mProcess->mAdaptiveThreadPool &&
+                mProcess->mExecutingThreadsCount >= mProcess->mPoolThreadCount &&
+                mProcess->mPoolThreadCount < mProcess->mMaxThreads) {
+            mProcess->mPoolThreadCount++;
+            mProcess->mThreadPoolStats.spawned++;
+            spawnThread = true;
         }
         pthread_mutex_unlock(&mProcess->mThreadCountLock);
 
+        if (spawnThread) {
+            mProcess->spawnAdaptiveThread();
+        }
+
         result = executeCommand(cmd);
 
         pthread_mutex_lock(&mProcess->mThreadCountLock);
@@ -615,15 +679,59 @@ void IPCThreadState::processPostWriteDerefs()
 }
 
 void IPCThreadState::joinThreadPool(bool isMain)
+{
+    joinThreadPoolInternal(isMain, false /*canRetire*/);
+}
+
+void IPCThreadState::joinThreadPoolUntilIdle()
+{
+    joinThreadPoolInternal(false /*isMain*/, true /*canRetire*/);
+}
+
+// Returns false if this thread was idle for too long and has been removed
+// from the adaptive thread pool.
+bool IPCThreadState::waitForWorkOrRetire()
+{
+    // queued commands (e.g. BC_FREE_BUFFER) shouldn't wait for the timeout
+    if (mOut.dataSize() > 0) {
+        talkWithDriver(false);
+    }
+
+    struct pollfd pfd = {.fd = mProcess->mDriverFD, .events = POLLIN};
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, mProcess->mThreadIdleTimeoutMs));
+    if (ret != 0) return true; // work, or an error getAndExecuteCommand will see
+
+    bool retire = false;
+    pthread_mutex_lock(&mProcess->mThreadCountLock);
+    if (mProcess->mPoolThreadCount > mProcess->mMinThreads) {
+        mProcess->mPoolThreadCount--;
+        mProcess->mThreadPoolStats.retired++;
+        retire = true;
+    }
+    pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    return !retire;
+}
+
+void IPCThreadState::joinThreadPoolInternal(bool isMain, bool canRetire)
 {
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS JOINING THE THREAD POOL\n", (void*)pthread_self(), getpid());
 
-    mOut.writeInt32(isMain ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
+    // Threads of an adaptive pool aren't requested by the driver, so they
+    // can't register as such.
+    mOut.writeInt32(isMain || canRetire ? BC_ENTER_LOOPER : BC_REGISTER_LOOPER);
 
     mIsLooper = true;
+    bool retired = false;
     status_t result;
     do {
         processPendingDerefs();
+
+        if (canRetire && mIn.dataPosition() >= mIn.dataSize() && !waitForWorkOrRetire()) {
+            retired = true;
+            result = TIMED_OUT;
+            break;
+        }
+
         // now get the next command to be processed, waiting if necessary
         result = getAndExecuteCommand();
 
@@ -639,6 +747,12 @@ void IPCThreadState::joinThreadPool(bool isMain)
         }
     } while (result != -ECONNREFUSED && result != -EBADF);
 
+    if (canRetire && !retired) {
+        pthread_mutex_lock(&mProcess->mThreadCountLock);
+        mProcess->mPoolThreadCount--;
+        pthread_mutex_unlock(&mProcess->mThreadCountLock);
+    }
+
     LOG_THREADPOOL("**** THREAD %p (PID %d) IS LEAVING THE THREAD POOL err=%d\n",
         (void*)pthread_self(), getpid(), result);
 
@@ -692,6 +806,9 @@ status_t IPCThreadState::transact(int32_t handle,
 
     flags |= TF_ACCEPT_FDS;
 
+    const bool traced = TransactionTrace::isEnabled();
+    const nsecs_t traceStartNs = traced ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+
     IF_LOG_TRANSACTIONS() {
         TextOutput::Bundle _b(alog);
         alog << "BC_TRANSACTION thr " << (void*)pthread_self() << " / hand "
@@ -699,6 +816,15 @@ status_t IPCThreadState::transact(int32_t handle,
             << indent << data << dedent << endl;
     }
 
+    const bool batchOneway = (flags & TF_ONE_WAY) != 0 &&
+            (mOnewayBatchDepth > 0 ||
+             (mServingStackPointer != nullptr &&
+              gAutoOnewayBatching.load(std::memory_order_relaxed)));
+    if (!batchOneway && mPendingOnewayCount > 0) {
+        // Keep error reporting of queued oneway calls separate from this one.
+        flushOnewayBatch();
+    }
+
     LOG_ONEWAY(">>>> SEND from pid %d uid %d %s", getpid(), getuid(),
         (flags & TF_ONE_WAY) == 0 ? "READ REPLY" : "ONE WAY");
     err = writeTransactionData(BC_TRANSACTION, flags, handle, code, data, nullptr);
@@ -747,10 +873,26 @@ status_t IPCThreadState::transact(int32_t handle,
             if (reply) alog << indent << *reply << dedent << endl;
             else alog << "(none requested)" << endl;
         }
+    } else if (batchOneway) {
+        err = ++mPendingOnewayCount >= kMaxBatchedOneway ? flushOnewayBatch() : NO_ERROR;
     } else {
         err = waitForResponse(nullptr, nullptr);
     }
 
+    if (traced) {
+        BinderTransactionEvent event;
+        event.startNs = traceStartNs;
+        event.endNs = systemTime(SYSTEM_TIME_MONOTONIC);
+        event.code = code;
+        event.flags = flags;
+        event.dataSize = static_cast<uint32_t>(data.dataSize());
+        event.replySize = reply ? static_cast<uint32_t>(reply->dataSize()) : 0;
+        event.handle = handle;
+        event.status = err;
+        event.direction = BinderTransactionEvent::OUTGOING;
+        TransactionTrace::record(event);
+    }
+
     return err;
 }
 
@@ -844,11 +986,14 @@ status_t IPCThreadState::clearDeathNotification(int32_t handle, BpBinder* proxy)
 
 IPCThreadState::IPCThreadState()
       : mProcess(ProcessState::self()),
+        mParcelBufferPool(mProcess->mParcelBufferPoolEnabled ? new ParcelBufferPool : nullptr),
         mServingStackPointer(nullptr),
         mWorkSource(kUnsetWorkSource),
         mPropagateWorkSource(false),
         mIsLooper(false),
         mIsFlushing(false),
+        mOnewayBatchDepth(0),
+        mPendingOnewayCount(0),
         mStrictModePolicy(0),
         mLastTransactionBinderFlags(0),
         mCallRestriction(mProcess->mCallRestriction) {
@@ -860,6 +1005,10 @@ IPCThreadState::IPCThreadState()
 
 IPCThreadState::~IPCThreadState()
 {
+    // mIn and mOut are destroyed after this, and hand their buffers back to
+    // free() once the pool is gone.
+    delete mParcelBufferPool;
+    mParcelBufferPool = nullptr;
 }
 
 status_t IPCThreadState::sendReply(const Parcel& reply, uint32_t flags)
@@ -1218,6 +1367,10 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 "Not enough command data for brTRANSACTION");
             if (result != NO_ERROR) break;
 
+            const bool traced = TransactionTrace::isEnabled();
+            const nsecs_t traceStartNs = traced ? systemTime(SYSTEM_TIME_MONOTONIC) : 0;
+            uint32_t traceDescriptorId = 0;
+
             Parcel buffer;
             buffer.ipcSetDataReference(
                 reinterpret_cast<const uint8_t*>(tr.data.ptr.buffer),
@@ -1267,6 +1420,10 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 // safely acquire a strong reference before doing anything else with it.
                 if (reinterpret_cast<RefBase::weakref_type*>(
                         tr.target.ptr)->attemptIncStrong(this)) {
+                    if (traced) {
+                        traceDescriptorId = TransactionTrace::internDescriptor(
+                                reinterpret_cast<BBinder*>(tr.cookie)->getInterfaceDescriptor());
+                    }
                     error = reinterpret_cast<BBinder*>(tr.cookie)->transact(tr.code, buffer,
                             &reply, tr.flags);
                     reinterpret_cast<BBinder*>(tr.cookie)->decStrong(this);
@@ -1275,12 +1432,21 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 }
 
             } else {
+                if (traced) {
+                    traceDescriptorId = TransactionTrace::internDescriptor(
+                            the_context_object->getInterfaceDescriptor());
+                }
                 error = the_context_object->transact(tr.code, buffer, &reply, tr.flags);
             }
 
             //ALOGI("<<<< TRANSACT from pid %d restore pid %d sid %s uid %d\n",
             //     mCallingPid, origPid, (origSid ? origSid : "<N/A>"), origUid);
 
+            if (mPendingOnewayCount > 0 && mOnewayBatchDepth == 0) {
+                // Oneway calls made while serving this transaction were batched.
+                flushOnewayBatch();
+            }
+
             if ((tr.flags & TF_ONE_WAY) == 0) {
                 LOG_ONEWAY("Sending reply to %d!", mCallingPid);
                 if (error < NO_ERROR) reply.setError(error);
@@ -1308,6 +1474,21 @@ status_t IPCThreadState::executeCommand(int32_t cmd)
                 LOG_ONEWAY("NOT sending reply to %d!", mCallingPid);
             }
 
+            if (traced) {
+                BinderTransactionEvent event;
+                event.startNs = traceStartNs;
+                event.endNs = systemTime(SYSTEM_TIME_MONOTONIC);
+                event.descriptorId = traceDescriptorId;
+                event.code = tr.code;
+                event.flags = tr.flags;
+                event.dataSize = static_cast<uint32_t>(tr.data_size);
+                event.replySize = static_cast<uint32_t>(reply.dataSize());
+                event.callingPid = mCallingPid;
+                event.status = error;
+                event.direction = BinderTransactionEvent::INCOMING;
+                TransactionTrace::record(event);
+            }
+
             mServingStackPointer = origServingStackPointer;
             mCallingPid = origPid;
             mCallingSid = origSid;
@@ -21,6 +21,10 @@
 #include <inttypes.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <map>
+#include <mutex>
+
 #include <android/os/BnServiceCallback.h>
 #include <android/os/IServiceManager.h>
 #include <binder/IPCThreadState.h>
@@ -61,6 +65,120 @@ const String16& IServiceManager::getInterfaceDescriptor() const {
 IServiceManager::IServiceManager() {}
 IServiceManager::~IServiceManager() {}
 
+static std::atomic<bool> gServiceHandleCacheEnabled = false;
+
+void setServiceHandleCacheEnabled(bool enabled) {
+    gServiceHandleCacheEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+// Process-local cache of checkService() results. Entries are dropped when the
+// service dies, and replaced when servicemanager reports that the name was
+// registered again.
+class ServiceHandleCache : public IBinder::DeathRecipient
+{
+public:
+    explicit ServiceHandleCache(const sp<AidlServiceManager>& sm) : mServiceManager(sm) {}
+
+    sp<IBinder> lookup(const std::string& name);
+    void insert(const std::string& name, const sp<IBinder>& binder);
+
+    void binderDied(const wp<IBinder>& who) override;
+
+private:
+    class Callback : public android::os::BnServiceCallback {
+    public:
+        explicit Callback(const wp<ServiceHandleCache>& cache) : mCache(cache) {}
+        Status onRegistration(const std::string& name, const sp<IBinder>& binder) override {
+            sp<ServiceHandleCache> cache = mCache.promote();
+            if (cache != nullptr) cache->update(name, binder);
+            return Status::ok();
+        }
+    private:
+        wp<ServiceHandleCache> mCache;
+    };
+
+    void update(const std::string& name, const sp<IBinder>& binder);
+
+    sp<AidlServiceManager> mServiceManager;
+
+    std::mutex mMutex; // for below
+    std::map<std::string, sp<IBinder>> mServices;
+    // names we are registered for notifications on
+    std::map<std::string, sp<Callback>> mCallbacks;
+};
+
+sp<IBinder> ServiceHandleCache::lookup(const std::string& name) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    auto it = mServices.find(name);
+    if (it == mServices.end()) return nullptr;
+    return it->second;
+}
+
+void ServiceHandleCache::insert(const std::string& name, const sp<IBinder>& binder) {
+    bool registered;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        registered = mCallbacks.count(name) > 0;
+    }
+
+    if (!registered) {
+        // Without notifications, a replaced service would be missed, so don't
+        // cache it at all (e.g. callers which can't register).
+        sp<Callback> callback = sp<Callback>::make(wp<ServiceHandleCache>::fromExisting(this));
+        if (!mServiceManager->registerForNotifications(name, callback).isOk()) return;
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (!mCallbacks.emplace(name, callback).second) {
+            // lost a race with another thread registering this name
+            lock.unlock();
+            mServiceManager->unregisterForNotifications(name, callback);
+        }
+    }
+
+    update(name, binder);
+}
+
+void ServiceHandleCache::update(const std::string& name, const sp<IBinder>& binder) {
+    if (binder == nullptr) return;
+
+    sp<IBinder> old;
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        auto it = mServices.find(name);
+        if (it != mServices.end() && it->second == binder) return;
+    }
+
+    // local binders never die
+    if (binder->remoteBinder() != nullptr &&
+        binder->linkToDeath(sp<IBinder::DeathRecipient>::fromExisting(this)) != OK) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        sp<IBinder>& entry = mServices[name];
+        old = entry;
+        entry = binder;
+    }
+
+    if (old != nullptr && old->remoteBinder() != nullptr) {
+        old->unlinkToDeath(sp<IBinder::DeathRecipient>::fromExisting(this));
+    }
+}
+
+void ServiceHandleCache::binderDied(const wp<IBinder>& who) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    for (auto it = mServices.begin(); it != mServices.end();) {
+        if (it->second.get() == who.unsafe_get()) {
+            it = mServices.erase(it);
+        } else {
+            it++;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
 // From the old libbinder IServiceManager interface to IServiceManager.
 class ServiceManagerShim : public IServiceManager
 {
@@ -86,6 +204,7 @@ public:
     }
 private:
     sp<AidlServiceManager> mTheRealServiceManager;
+    sp<ServiceHandleCache> mCache;
 };
 
 [[clang::no_destroy]] static std::once_flag gSmOnce;
@@ -206,7 +325,8 @@ bool checkPermission(const String16& permission, pid_t pid, uid_t uid)
 // ----------------------------------------------------------------------
 
 ServiceManagerShim::ServiceManagerShim(const sp<AidlServiceManager>& impl)
- : mTheRealServiceManager(impl)
+ : mTheRealServiceManager(impl),
+   mCache(sp<ServiceHandleCache>::make(impl))
 {}
 
 // This implementation could be simplified and made more efficient by delegating
@@ -259,10 +379,20 @@ sp<IBinder> ServiceManagerShim::getService(const String16& name) const
 
 sp<IBinder> ServiceManagerShim::checkService(const String16& name) const
 {
+    const std::string name8 = String8(name).c_str();
+    const bool useCache = gServiceHandleCacheEnabled.load(std::memory_order_relaxed);
+    if (useCache) {
+        sp<IBinder> cached = mCache->lookup(name8);
+        if (cached != nullptr) return cached;
+    }
+
     sp<IBinder> ret;
-    if (!mTheRealServiceManager->checkService(String8(name).c_str(), &ret).isOk()) {
+    if (!mTheRealServiceManager->checkService(name8, &ret).isOk()) {
         return nullptr;
     }
+    if (useCache && ret != nullptr) {
+        mCache->insert(name8, ret);
+    }
     return ret;
 }
 
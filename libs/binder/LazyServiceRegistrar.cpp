@@ -349,5 +349,17 @@ void LazyServiceRegistrar::reRegister() {
     mClientCC->reRegister();
 }
 
+status_t LazyServiceRegistrar::registerPrewarmHint(const std::string& name,
+                                                   const std::string& trigger) {
+    auto manager = interface_cast<internal::AidlServiceManager>(asBinder(defaultServiceManager()));
+
+    if (Status status = manager->registerPrewarmHint(name, trigger); !status.isOk()) {
+        ALOGE("Failed to register prewarm hint %s -> %s (%s)", trigger.c_str(), name.c_str(),
+              status.toString8().c_str());
+        return status.exceptionCode() == Status::EX_SECURITY ? PERMISSION_DENIED : BAD_VALUE;
+    }
+    return OK;
+}
+
 }  // namespace hardware
 }  // namespace android
@@ -38,6 +38,8 @@
 #include <sys/mman.h>
 #include <sys/file.h>
 
+#include <unordered_map>
+
 namespace android {
 // ----------------------------------------------------------------------------
 
@@ -120,22 +122,59 @@ private:
 
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator
+class MemoryDealerAllocator
+{
+public:
+    virtual ~MemoryDealerAllocator() {}
+
+    virtual size_t      allocate(size_t size, uint32_t flags = 0) = 0;
+    virtual status_t    deallocate(size_t offset) = 0;
+    virtual size_t      size() const = 0;
+    virtual void        dump(const char* what) const = 0;
+    virtual void        dump(String8& res, const char* what) const = 0;
+
+    // align all the memory blocks on a cache-line boundary
+    static constexpr int kMemoryAlign = 32;
+
+    static size_t getAllocationAlignment() { return kMemoryAlign; }
+
+protected:
+    struct FreeStats {
+        size_t freeBytes = 0;
+        size_t freeChunks = 0;
+        size_t largestFreeBytes = 0;
+
+        void add(size_t bytes) {
+            freeBytes += bytes;
+            freeChunks++;
+            if (bytes > largestFreeBytes) largestFreeBytes = bytes;
+        }
+        void dump(String8& result) const {
+            // share of free memory which can't be handed out as one allocation
+            int fragmentation = freeBytes == 0 ? 0 :
+                    int(100 - (100 * (uint64_t)largestFreeBytes) / freeBytes);
+            result.appendFormat("  size free: %zu in %zu chunks, largest %zu, fragmentation %d%%\n",
+                                freeBytes, freeChunks, largestFreeBytes, fragmentation);
+        }
+    };
+};
+
+// ----------------------------------------------------------------------------
+
+class SimpleBestFitAllocator : public MemoryDealerAllocator
 {
     enum {
         PAGE_ALIGNED = 0x00000001
     };
 public:
     explicit SimpleBestFitAllocator(size_t size);
-    ~SimpleBestFitAllocator();
-
-    size_t      allocate(size_t size, uint32_t flags = 0);
-    status_t    deallocate(size_t offset);
-    size_t      size() const;
-    void        dump(const char* what) const;
-    void        dump(String8& res, const char* what) const;
+    ~SimpleBestFitAllocator() override;
 
-    static size_t getAllocationAlignment() { return kMemoryAlign; }
+    size_t      allocate(size_t size, uint32_t flags = 0) override;
+    status_t    deallocate(size_t offset) override;
+    size_t      size() const override;
+    void        dump(const char* what) const override;
+    void        dump(String8& res, const char* what) const override;
 
 private:
 
@@ -155,7 +194,6 @@ private:
     void     dump_l(const char* what) const;
     void     dump_l(String8& res, const char* what) const;
 
-    static const int    kMemoryAlign;
     mutable Mutex       mLock;
     LinkedList<chunk_t> mList;
     size_t              mHeapSize;
@@ -163,6 +201,61 @@ private:
 
 // ----------------------------------------------------------------------------
 
+/*
+ * Chunks are kept in address order, for merging neighbours, and free chunks are
+ * also kept in one list per size class, class c holding sizes in [2^c, 2^(c+1))
+ * units. A bitmap of non-empty classes finds a large enough chunk without
+ * walking lists, and allocated chunks are found again by their offset.
+ */
+class SegregatedFitAllocator : public MemoryDealerAllocator
+{
+public:
+    explicit SegregatedFitAllocator(size_t size);
+    ~SegregatedFitAllocator() override;
+
+    size_t      allocate(size_t size, uint32_t flags = 0) override;
+    status_t    deallocate(size_t offset) override;
+    size_t      size() const override;
+    void        dump(const char* what) const override;
+    void        dump(String8& res, const char* what) const override;
+
+private:
+    struct chunk_t {
+        chunk_t(size_t start, size_t size) : start(start), size(size) {}
+        size_t              start; // in units of kMemoryAlign
+        size_t              size;  // in units of kMemoryAlign
+        bool                free = true;
+        // address order
+        mutable chunk_t*    prev = nullptr;
+        mutable chunk_t*    next = nullptr;
+        // size class, while free
+        chunk_t*            prevFree = nullptr;
+        chunk_t*            nextFree = nullptr;
+    };
+
+    static constexpr size_t kNumClasses = sizeof(size_t) * 8;
+    // chunks of the exact size class examined before taking a larger class
+    static constexpr size_t kMaxClassScan = 8;
+
+    static size_t sizeClass(size_t units) {
+        return kNumClasses - 1 - __builtin_clzl(units);
+    }
+
+    void     insertFree(chunk_t* chunk);
+    void     removeFree(chunk_t* chunk);
+    chunk_t* findFree(size_t units) const;
+    void     dump_l(String8& res, const char* what) const;
+
+    mutable Mutex       mLock;
+    LinkedList<chunk_t> mList;
+    chunk_t*            mFreeLists[kNumClasses] = {};
+    uint64_t            mNonEmptyClasses = 0; // bit c set iff mFreeLists[c]
+    std::unordered_map<size_t, chunk_t*> mAllocated; // by start
+    size_t              mHeapSize;
+};
+
+// ----------------------------------------------------------------------------
+
 Allocation::Allocation(
         const sp<MemoryDealer>& dealer,
         const sp<IMemoryHeap>& heap, ssize_t offset, size_t size)
@@ -228,8 +321,14 @@ Allocation::~Allocation()
 // ----------------------------------------------------------------------------
 
 MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags)
+      : MemoryDealer(size, name, flags, AllocatorType::BEST_FIT) {}
+
+MemoryDealer::MemoryDealer(size_t size, const char* name, uint32_t flags,
+                           AllocatorType allocatorType)
       : mHeap(sp<MemoryHeapBase>::make(size, flags, name)),
-        mAllocator(new SimpleBestFitAllocator(size)) {}
+        mAllocator(allocatorType == AllocatorType::SEGREGATED_FIT
+                           ? static_cast<MemoryDealerAllocator*>(new SegregatedFitAllocator(size))
+                           : new SimpleBestFitAllocator(size)) {}
 
 MemoryDealer::~MemoryDealer()
 {
@@ -260,21 +359,18 @@ const sp<IMemoryHeap>& MemoryDealer::heap() const {
     return mHeap;
 }
 
-SimpleBestFitAllocator* MemoryDealer::allocator() const {
+MemoryDealerAllocator* MemoryDealer::allocator() const {
     return mAllocator;
 }
 
 // static
 size_t MemoryDealer::getAllocationAlignment()
 {
-    return SimpleBestFitAllocator::getAllocationAlignment();
+    return MemoryDealerAllocator::getAllocationAlignment();
 }
 
 // ----------------------------------------------------------------------------
 
-// align all the memory blocks on a cache-line boundary
-const int SimpleBestFitAllocator::kMemoryAlign = 32;
-
 SimpleBestFitAllocator::SimpleBestFitAllocator(size_t size)
 {
     size_t pagesize = getpagesize();
@@ -444,6 +540,7 @@ void SimpleBestFitAllocator::dump_l(String8& result,
 {
     size_t size = 0;
     int32_t i = 0;
+    FreeStats freeStats;
     chunk_t const* cur = mList.head();
     
     const size_t SIZE = 256;
@@ -469,6 +566,8 @@ void SimpleBestFitAllocator::dump_l(String8& result,
 
         if (!cur->free)
             size += cur->size*kMemoryAlign;
+        else
+            freeStats.add(cur->size*kMemoryAlign);
 
         i++;
         cur = cur->next;
@@ -476,6 +575,177 @@ void SimpleBestFitAllocator::dump_l(String8& result,
     snprintf(buffer, SIZE,
             "  size allocated: %u (%u KB)\n", int(size), int(size/1024));
     result.append(buffer);
+    freeStats.dump(result);
+}
+
+// ----------------------------------------------------------------------------
+
+SegregatedFitAllocator::SegregatedFitAllocator(size_t size)
+{
+    size_t pagesize = getpagesize();
+    mHeapSize = ((size + pagesize-1) & ~(pagesize-1));
+
+    if (mHeapSize >= kMemoryAlign) {
+        chunk_t* node = new chunk_t(0, mHeapSize / kMemoryAlign);
+        mList.insertHead(node);
+        insertFree(node);
+    }
+}
+
+SegregatedFitAllocator::~SegregatedFitAllocator()
+{
+    while (!mList.isEmpty()) {
+        delete mList.remove(mList.head());
+    }
+}
+
+size_t SegregatedFitAllocator::size() const
+{
+    return mHeapSize;
+}
+
+void SegregatedFitAllocator::insertFree(chunk_t* chunk)
+{
+    size_t c = sizeClass(chunk->size);
+    chunk->prevFree = nullptr;
+    chunk->nextFree = mFreeLists[c];
+    if (chunk->nextFree) chunk->nextFree->prevFree = chunk;
+    mFreeLists[c] = chunk;
+    mNonEmptyClasses |= uint64_t(1) << c;
+}
+
+void SegregatedFitAllocator::removeFree(chunk_t* chunk)
+{
+    size_t c = sizeClass(chunk->size);
+    if (chunk->prevFree) chunk->prevFree->nextFree = chunk->nextFree;
+    else                 mFreeLists[c] = chunk->nextFree;
+    if (chunk->nextFree) chunk->nextFree->prevFree = chunk->prevFree;
+    chunk->prevFree = chunk->nextFree = nullptr;
+    if (!mFreeLists[c]) mNonEmptyClasses &= ~(uint64_t(1) << c);
+}
+
+SegregatedFitAllocator::chunk_t* SegregatedFitAllocator::findFree(size_t units) const
+{
+    const size_t c = sizeClass(units);
+
+    // chunks of the same class may still be too small
+    chunk_t* cur = mFreeLists[c];
+    for (size_t i = 0; cur && i < kMaxClassScan; i++, cur = cur->nextFree) {
+        if (cur->size >= units) return cur;
+    }
+
+    // anything in a larger class fits
+    const uint64_t larger = mNonEmptyClasses & ~((uint64_t(2) << c) - 1);
+    if (larger) return mFreeLists[__builtin_ctzll(larger)];
+
+    // nothing else left, finish looking through this class
+    for (; cur; cur = cur->nextFree) {
+        if (cur->size >= units) return cur;
+    }
+    return nullptr;
+}
+
+size_t SegregatedFitAllocator::allocate(size_t size, uint32_t /*flags*/)
+{
+    if (size == 0) {
+        return 0;
+    }
+    const size_t units = (size + kMemoryAlign-1) / kMemoryAlign;
+
+    Mutex::Autolock _l(mLock);
+    chunk_t* chunk = findFree(units);
+    if (!chunk) {
+        return NO_MEMORY;
+    }
+
+    removeFree(chunk);
+    if (chunk->size > units) {
+        chunk_t* split = new chunk_t(chunk->start + units, chunk->size - units);
+        mList.insertAfter(chunk, split);
+        insertFree(split);
+        chunk->size = units;
+    }
+    chunk->free = false;
+    mAllocated[chunk->start] = chunk;
+
+    return chunk->start * kMemoryAlign;
+}
+
+status_t SegregatedFitAllocator::deallocate(size_t offset)
+{
+    if (offset % kMemoryAlign != 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    Mutex::Autolock _l(mLock);
+    auto it = mAllocated.find(offset / kMemoryAlign);
+    if (it == mAllocated.end()) {
+        return NAME_NOT_FOUND;
+    }
+    chunk_t* chunk = it->second;
+    mAllocated.erase(it);
+    chunk->free = true;
+
+    // merge freed blocks together
+    chunk_t* const n = chunk->next;
+    if (n && n->free) {
+        removeFree(n);
+        chunk->size += n->size;
+        delete mList.remove(n);
+    }
+    chunk_t* const p = chunk->prev;
+    if (p && p->free) {
+        removeFree(p);
+        p->size += chunk->size;
+        delete mList.remove(chunk);
+        chunk = p;
+    }
+    insertFree(chunk);
+
+    return NO_ERROR;
+}
+
+void SegregatedFitAllocator::dump(const char* what) const
+{
+    String8 result;
+    dump(result, what);
+    ALOGD("%s", result.string());
+}
+
+void SegregatedFitAllocator::dump(String8& result, const char* what) const
+{
+    Mutex::Autolock _l(mLock);
+    dump_l(result, what);
+}
+
+void SegregatedFitAllocator::dump_l(String8& result, const char* what) const
+{
+    size_t size = 0;
+    int32_t i = 0;
+    FreeStats freeStats;
+
+    result.appendFormat("  %s (%p, size=%u, segregated fit)\n", what, this,
+                        (unsigned int)mHeapSize);
+
+    for (chunk_t const* cur = mList.head(); cur; cur = cur->next, i++) {
+        result.appendFormat("  %3u: %p | 0x%08X | 0x%08X | %s\n", i, cur,
+                            int(cur->start*kMemoryAlign), int(cur->size*kMemoryAlign),
+                            cur->free ? "F" : "A");
+        if (!cur->free) size += cur->size*kMemoryAlign;
+        else            freeStats.add(cur->size*kMemoryAlign);
+    }
+
+    result.appendFormat("  size allocated: %u (%u KB)\n", int(size), int(size/1024));
+    freeStats.dump(result);
+
+    for (size_t c = 0; c < kNumClasses; c++) {
+        size_t count = 0;
+        for (chunk_t const* cur = mFreeLists[c]; cur; cur = cur->nextFree) count++;
+        if (count) {
+            result.appendFormat("  free class %zu (>= %zu bytes): %zu chunks\n", c,
+                                (size_t(1) << c) * kMemoryAlign, count);
+        }
+    }
 }
 
 
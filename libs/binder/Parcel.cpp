@@ -48,6 +48,8 @@
 #include <utils/String8.h>
 #include <utils/misc.h>
 
+#include "ParcelBufferPool.h"
+#include "RpcSharedMemory.h"
 #include "RpcState.h"
 #include "Static.h"
 #include "Utils.h"
@@ -96,6 +98,8 @@ enum {
     BLOB_INPLACE = 0,
     BLOB_ASHMEM_IMMUTABLE = 1,
     BLOB_ASHMEM_MUTABLE = 2,
+    // offset into the RPC session's shared memory, see RpcSharedMemory
+    BLOB_RPC_SHARED = 3,
 };
 
 static void acquire_object(const sp<ProcessState>& proc,
@@ -332,6 +336,18 @@ size_t Parcel::getGlobalAllocCount() {
     return gParcelGlobalAllocCount.load();
 }
 
+size_t Parcel::getGlobalBufferPoolHits() {
+    return ParcelBufferPool::getStats().hits;
+}
+
+size_t Parcel::getGlobalBufferPoolMisses() {
+    return ParcelBufferPool::getStats().misses;
+}
+
+size_t Parcel::getGlobalBufferPoolCachedBytes() {
+    return ParcelBufferPool::getStats().cachedBytes;
+}
+
 const uint8_t* Parcel::data() const
 {
     return mData;
@@ -1206,7 +1222,26 @@ status_t Parcel::writeBlob(size_t len, bool mutableCopy, WritableBlob* outBlob)
     }
 
     status_t status;
-    if (!mAllowFds || len <= BLOB_INPLACE_LIMIT) {
+    if (isForRpc() && len > BLOB_INPLACE_LIMIT) {
+        // RPC sessions can't carry ashmem fds, but may have shared memory set up. If it is
+        // full (or absent), fall back to writing in place.
+        RpcSharedMemory* shm = mSession->state()->sharedMemory();
+        void* ptr;
+        uint64_t offset;
+        if (shm != nullptr && shm->allocate(this, len, &ptr, &offset) == OK) {
+            ALOGV("writeBlob: write to RPC shared memory");
+            status = writeInt32(BLOB_RPC_SHARED);
+            if (status) return status;
+            status = writeUint64(offset);
+            if (status) return status;
+
+            // released with this parcel
+            outBlob->init(-1, ptr, len, true);
+            return NO_ERROR;
+        }
+    }
+
+    if (isForRpc() || !mAllowFds || len <= BLOB_INPLACE_LIMIT) {
         ALOGV("writeBlob: write in place");
         status = writeInt32(BLOB_INPLACE);
         if (status) return status;
@@ -1743,6 +1778,32 @@ const char* Parcel::readString8Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString8View(std::string_view* str) const
+{
+    size_t len;
+    const char* data = readString8Inplace(&len);
+    if (data == nullptr) {
+        *str = std::string_view();
+        return UNEXPECTED_NULL;
+    }
+    *str = std::string_view(data, len);
+    return OK;
+}
+
+status_t Parcel::readString8View(std::optional<std::string_view>* str) const
+{
+    const size_t start = dataPosition();
+    int32_t size;
+    status_t status = readInt32(&size);
+    str->reset();
+    if (status != OK || size == -1) return status;
+
+    setDataPosition(start);
+    std::string_view view;
+    if ((status = readString8View(&view)) == OK) str->emplace(view);
+    return status;
+}
+
 String16 Parcel::readString16() const
 {
     size_t len;
@@ -1784,6 +1845,32 @@ const char16_t* Parcel::readString16Inplace(size_t* outLen) const
     return nullptr;
 }
 
+status_t Parcel::readString16View(std::u16string_view* str) const
+{
+    size_t len;
+    const char16_t* data = readString16Inplace(&len);
+    if (data == nullptr) {
+        *str = std::u16string_view();
+        return UNEXPECTED_NULL;
+    }
+    *str = std::u16string_view(data, len);
+    return OK;
+}
+
+status_t Parcel::readString16View(std::optional<std::u16string_view>* str) const
+{
+    const size_t start = dataPosition();
+    int32_t size;
+    status_t status = readInt32(&size);
+    str->reset();
+    if (status != OK || size == -1) return status;
+
+    setDataPosition(start);
+    std::u16string_view view;
+    if ((status = readString16View(&view)) == OK) str->emplace(view);
+    return status;
+}
+
 status_t Parcel::readStrongBinder(sp<IBinder>* val) const
 {
     status_t status = readNullableStrongBinder(val);
@@ -1941,6 +2028,24 @@ status_t Parcel::readBlob(size_t len, ReadableBlob* outBlob) const
         return NO_ERROR;
     }
 
+    if (blobType == BLOB_RPC_SHARED) {
+        ALOGV("readBlob: read from RPC shared memory");
+        RpcSharedMemory* shm = isForRpc() ? mSession->state()->sharedMemory() : nullptr;
+        if (shm == nullptr) return BAD_TYPE;
+
+        uint64_t offset;
+        status = readUint64(&offset);
+        if (status) return status;
+
+        const void* ptr;
+        status = shm->map(this, offset, len, &ptr);
+        if (status) return status;
+
+        // owned by this parcel, like in place blobs
+        outBlob->init(-1, const_cast<void*>(ptr), len, false);
+        return NO_ERROR;
+    }
+
     ALOGV("readBlob: read from ashmem");
     bool isMutable = (blobType == BLOB_ASHMEM_MUTABLE);
     int fd = readFileDescriptor();
@@ -2225,6 +2330,12 @@ void Parcel::freeData()
 
 void Parcel::freeDataNoInit()
 {
+    if (mSession != nullptr) {
+        if (RpcSharedMemory* shm = mSession->state()->sharedMemory(); shm != nullptr) {
+            shm->onParcelFreed(this);
+        }
+    }
+
     if (mOwner) {
         LOG_ALLOC("Parcel %p: freeing other owner data", this);
         //ALOGI("Freeing data ref of %p (pid=%d)", this, getpid());
@@ -2239,7 +2350,7 @@ void Parcel::freeDataNoInit()
             if (mDeallocZero) {
                 zeroMemory(mData, mDataSize);
             }
-            free(mData);
+            freeDataBuffer(mData, mDataCapacity);
         }
         if (mObjects) free(mObjects);
     }
@@ -2261,16 +2372,53 @@ status_t Parcel::growData(size_t len)
             : continueWrite(std::max(newSize, (size_t) 128));
 }
 
-static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t newCapacity, bool zero) {
+// Allocates a data buffer of at least *capacity bytes, updating *capacity to
+// the actual size when the buffer comes from the thread's pool.
+static uint8_t* mallocData(size_t* capacity) {
+    if (ParcelBufferPool* pool = ParcelBufferPool::forCurrentThread()) {
+        *capacity = ParcelBufferPool::roundUpCapacity(*capacity);
+        if (uint8_t* data = pool->acquire(*capacity)) return data;
+    }
+    return (uint8_t*)malloc(*capacity);
+}
+
+static void freeDataBuffer(uint8_t* data, size_t capacity) {
+    ParcelBufferPool* pool = ParcelBufferPool::forCurrentThread();
+    if (pool == nullptr || !pool->release(data, capacity)) {
+        free(data);
+    }
+}
+
+static uint8_t* reallocZeroFree(uint8_t* data, size_t oldCapacity, size_t* newCapacity, bool zero) {
+    if (*newCapacity != 0 && ParcelBufferPool::forCurrentThread() != nullptr) {
+        if (data != nullptr &&
+            ParcelBufferPool::roundUpCapacity(*newCapacity) == oldCapacity) {
+            *newCapacity = oldCapacity;
+            return data;
+        }
+        uint8_t* newData = mallocData(newCapacity);
+        if (!newData) {
+            return nullptr;
+        }
+        if (data) {
+            memcpy(newData, data, std::min(oldCapacity, *newCapacity));
+            if (zero) {
+                zeroMemory(data, oldCapacity);
+            }
+            freeDataBuffer(data, oldCapacity);
+        }
+        return newData;
+    }
+
     if (!zero) {
-        return (uint8_t*)realloc(data, newCapacity);
+        return (uint8_t*)realloc(data, *newCapacity);
     }
-    uint8_t* newData = (uint8_t*)malloc(newCapacity);
+    uint8_t* newData = (uint8_t*)malloc(*newCapacity);
     if (!newData) {
         return nullptr;
     }
 
-    memcpy(newData, data, std::min(oldCapacity, newCapacity));
+    memcpy(newData, data, std::min(oldCapacity, *newCapacity));
     zeroMemory(data, oldCapacity);
     free(data);
     return newData;
@@ -2289,7 +2437,7 @@ status_t Parcel::restartWrite(size_t desired)
         return continueWrite(desired);
     }
 
-    uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+    uint8_t* data = reallocZeroFree(mData, mDataCapacity, &desired, mDeallocZero);
     if (!data && desired > mDataCapacity) {
         mError = NO_MEMORY;
         return NO_MEMORY;
@@ -2360,7 +2508,7 @@ status_t Parcel::continueWrite(size_t desired)
 
         // If there is a different owner, we need to take
         // posession.
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = mallocData(&desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -2370,7 +2518,7 @@ status_t Parcel::continueWrite(size_t desired)
         if (objectsSize) {
             objects = (binder_size_t*)calloc(objectsSize, sizeof(binder_size_t));
             if (!objects) {
-                free(data);
+                freeDataBuffer(data, desired);
 
                 mError = NO_MEMORY;
                 return NO_MEMORY;
@@ -2440,7 +2588,7 @@ status_t Parcel::continueWrite(size_t desired)
 
         // We own the data, so we can just do a realloc().
         if (desired > mDataCapacity) {
-            uint8_t* data = reallocZeroFree(mData, mDataCapacity, desired, mDeallocZero);
+            uint8_t* data = reallocZeroFree(mData, mDataCapacity, &desired, mDeallocZero);
             if (data) {
                 LOG_ALLOC("Parcel %p: continue from %zu to %zu capacity", this, mDataCapacity,
                         desired);
@@ -2465,7 +2613,7 @@ status_t Parcel::continueWrite(size_t desired)
 
     } else {
         // This is the first data.  Easy!
-        uint8_t* data = (uint8_t*)malloc(desired);
+        uint8_t* data = mallocData(&desired);
         if (!data) {
             mError = NO_MEMORY;
             return NO_MEMORY;
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParcelBufferPool.h"
+
+#include <binder/IPCThreadState.h>
+
+#include <atomic>
+
+#include <stdlib.h>
+
+namespace android {
+
+static std::atomic<size_t> gPoolHits;
+static std::atomic<size_t> gPoolMisses;
+static std::atomic<size_t> gPoolCachedBytes;
+
+ParcelBufferPool::ParcelBufferPool() : mBuffers(), mCounts() {}
+
+ParcelBufferPool::~ParcelBufferPool() {
+    for (size_t bucket = 0; bucket < kNumBuckets; bucket++) {
+        for (size_t i = 0; i < mCounts[bucket]; i++) {
+            free(mBuffers[bucket][i]);
+        }
+        gPoolCachedBytes -= mCounts[bucket] << (kMinBufferShift + bucket);
+    }
+}
+
+ParcelBufferPool* ParcelBufferPool::forCurrentThread() {
+    IPCThreadState* self = IPCThreadState::selfOrNull();
+    return self == nullptr ? nullptr : self->mParcelBufferPool;
+}
+
+size_t ParcelBufferPool::roundUpCapacity(size_t size) {
+    size_t capacity = size_t(1) << kMinBufferShift;
+    for (size_t bucket = 0; bucket < kNumBuckets; bucket++, capacity <<= 1) {
+        if (size <= capacity) return capacity;
+    }
+    return size;
+}
+
+ssize_t ParcelBufferPool::bucketFor(size_t capacity) {
+    for (size_t bucket = 0; bucket < kNumBuckets; bucket++) {
+        if (capacity == (size_t(1) << (kMinBufferShift + bucket))) return bucket;
+    }
+    return -1;
+}
+
+uint8_t* ParcelBufferPool::acquire(size_t capacity) {
+    ssize_t bucket = bucketFor(capacity);
+    if (bucket < 0) return nullptr;
+
+    if (mCounts[bucket] == 0) {
+        gPoolMisses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    gPoolHits.fetch_add(1, std::memory_order_relaxed);
+    gPoolCachedBytes.fetch_sub(capacity, std::memory_order_relaxed);
+    return mBuffers[bucket][--mCounts[bucket]];
+}
+
+bool ParcelBufferPool::release(uint8_t* data, size_t capacity) {
+    ssize_t bucket = bucketFor(capacity);
+    if (bucket < 0 || mCounts[bucket] == kBuffersPerBucket) return false;
+
+    gPoolCachedBytes.fetch_add(capacity, std::memory_order_relaxed);
+    mBuffers[bucket][mCounts[bucket]++] = data;
+    return true;
+}
+
+ParcelBufferPool::Stats ParcelBufferPool::getStats() {
+    return {
+            .hits = gPoolHits.load(std::memory_order_relaxed),
+            .misses = gPoolMisses.load(std::memory_order_relaxed),
+            .cachedBytes = gPoolCachedBytes.load(std::memory_order_relaxed),
+    };
+}
+
+} // namespace android
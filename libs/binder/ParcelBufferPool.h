@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+/**
+ * Small per-thread cache of Parcel data buffers, owned by IPCThreadState.
+ *
+ * Buffers are plain malloc() allocations rounded up to a power-of-two size
+ * class, so a buffer acquired on one thread may be released on another, or
+ * simply free()d when no pool is available.
+ */
+class ParcelBufferPool {
+public:
+    ParcelBufferPool();
+    ~ParcelBufferPool();
+
+    ParcelBufferPool(const ParcelBufferPool&) = delete;
+    ParcelBufferPool& operator=(const ParcelBufferPool&) = delete;
+
+    // Pool of the calling thread, or nullptr if it doesn't have an
+    // IPCThreadState or pooling is not enabled for this process.
+    static ParcelBufferPool* forCurrentThread();
+
+    // Capacity a poolable allocation of 'size' bytes is rounded up to, or
+    // 'size' itself if it is too large to be pooled.
+    static size_t roundUpCapacity(size_t size);
+
+    // Returns a buffer of exactly 'capacity' bytes (as returned by
+    // roundUpCapacity), or nullptr if the caller should malloc() one.
+    uint8_t* acquire(size_t capacity);
+
+    // Takes ownership of 'data' if it can be cached. Returns false if the
+    // caller still needs to free() it.
+    bool release(uint8_t* data, size_t capacity);
+
+    struct Stats {
+        size_t hits;
+        size_t misses;
+        size_t cachedBytes;
+    };
+    // Process-wide totals across all thread pools.
+    static Stats getStats();
+
+private:
+    static constexpr size_t kMinBufferShift = 7; // 128 bytes, Parcel's minimum growth
+    static constexpr size_t kNumBuckets = 6;     // up to 4096 bytes
+    static constexpr size_t kBuffersPerBucket = 4;
+
+    static ssize_t bucketFor(size_t capacity);
+
+    uint8_t* mBuffers[kNumBuckets][kBuffersPerBucket];
+    size_t mCounts[kNumBuckets];
+};
+
+} // namespace android
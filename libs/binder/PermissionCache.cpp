@@ -36,42 +36,61 @@ PermissionCache::PermissionCache() {
 
 status_t PermissionCache::check(bool* granted,
         const String16& permission, uid_t uid) const {
-    Mutex::Autolock _l(mLock);
+    const Shard& shard = shardFor(uid);
+    RWLock::AutoRLock _l(shard.lock);
     Entry e;
     e.name = permission;
     e.uid  = uid;
-    ssize_t index = mCache.indexOf(e);
+    ssize_t index = shard.entries.indexOf(e);
     if (index >= 0) {
-        *granted = mCache.itemAt(index).granted;
+        *granted = shard.entries.itemAt(index).granted;
+        mHits.fetch_add(1, std::memory_order_relaxed);
         return NO_ERROR;
     }
+    mMisses.fetch_add(1, std::memory_order_relaxed);
     return NAME_NOT_FOUND;
 }
 
 void PermissionCache::cache(const String16& permission,
         uid_t uid, bool granted) {
-    Mutex::Autolock _l(mLock);
     Entry e;
-    ssize_t index = mPermissionNamesPool.indexOf(permission);
-    if (index > 0) {
-        e.name = mPermissionNamesPool.itemAt(index);
-    } else {
-        mPermissionNamesPool.add(permission);
-        e.name = permission;
+    {
+        Mutex::Autolock _l(mPoolLock);
+        ssize_t index = mPermissionNamesPool.indexOf(permission);
+        if (index >= 0) {
+            e.name = mPermissionNamesPool.itemAt(index);
+        } else {
+            mPermissionNamesPool.add(permission);
+            e.name = permission;
+        }
     }
     // note, we don't need to store the pid, which is not actually used in
     // permission checks
     e.uid  = uid;
     e.granted = granted;
-    index = mCache.indexOf(e);
-    if (index < 0) {
-        mCache.add(e);
+
+    Shard& shard = shardFor(uid);
+    RWLock::AutoWLock _l(shard.lock);
+    if (shard.entries.indexOf(e) < 0) {
+        shard.entries.add(e);
     }
 }
 
 void PermissionCache::purge() {
-    Mutex::Autolock _l(mLock);
-    mCache.clear();
+    for (Shard& shard : mShards) {
+        RWLock::AutoWLock _l(shard.lock);
+        shard.entries.clear();
+    }
+}
+
+void PermissionCache::purge(uid_t uid) {
+    Shard& shard = shardFor(uid);
+    RWLock::AutoWLock _l(shard.lock);
+    for (size_t i = shard.entries.size(); i > 0; i--) {
+        if (shard.entries.itemAt(i - 1).uid == uid) {
+            shard.entries.removeAt(i - 1);
+        }
+    }
 }
 
 bool PermissionCache::checkCallingPermission(const String16& permission) {
@@ -114,5 +133,24 @@ void PermissionCache::purgeCache() {
     pc.purge();
 }
 
+void PermissionCache::purgeCache(uid_t uid) {
+    PermissionCache& pc(PermissionCache::getInstance());
+    pc.purge(uid);
+}
+
+PermissionCache::Stats PermissionCache::getStats() {
+    PermissionCache& pc(PermissionCache::getInstance());
+    Stats stats = {
+        .hits = pc.mHits.load(std::memory_order_relaxed),
+        .misses = pc.mMisses.load(std::memory_order_relaxed),
+        .entries = 0,
+    };
+    for (const Shard& shard : pc.mShards) {
+        RWLock::AutoRLock _l(shard.lock);
+        stats.entries += shard.entries.size();
+    }
+    return stats;
+}
+
 // ---------------------------------------------------------------------------
 } // namespace android
@@ -18,6 +18,7 @@
 
 #include <binder/PersistableBundle.h>
 
+#include <atomic>
 #include <limits>
 
 #include <binder/IBinder.h>
@@ -57,6 +58,8 @@ enum {
 };
 
 namespace {
+std::atomic_bool gLazyUnparceling = false;
+
 template <typename T>
 bool getValue(const android::String16& key, T* out, const map<android::String16, T>& map) {
     const auto& it = map.find(key);
@@ -74,12 +77,92 @@ set<android::String16> getKeys(const map<android::String16, T>& map) {
     }
     return keys;
 }
+
+template <typename T, typename P>
+set<android::String16> getKeys(const map<android::String16, T>& map, const P& pending,
+                               int32_t type) {
+    set<android::String16> keys = getKeys(map);
+    for (const auto& [key, value] : pending) {
+        if (value.type == type) keys.emplace(key);
+    }
+    return keys;
+}
+
+/*
+ * Moves |parcel| past |count| elements of |elementSize| bytes each, as written
+ * by the Parcel vector writers. Null arrays are rejected, like the readers do.
+ */
+status_t skipArray(const Parcel* parcel, size_t elementSize) {
+    int32_t count;
+    status_t status = parcel->readInt32(&count);
+    if (status != NO_ERROR) return status;
+    if (count < 0) return UNEXPECTED_NULL;
+    if (static_cast<size_t>(count) > parcel->dataAvail() / elementSize) return BAD_VALUE;
+    return parcel->readInplace(count * elementSize) == nullptr ? BAD_VALUE : NO_ERROR;
+}
+
+status_t skipString16(const Parcel* parcel) {
+    size_t len;
+    return parcel->readString16Inplace(&len) == nullptr ? BAD_VALUE : NO_ERROR;
+}
+
+// Moves |parcel| past a value of |type| without decoding it.
+status_t skipValue(const Parcel* parcel, int32_t type) {
+    switch (type) {
+        case VAL_STRING:
+            return skipString16(parcel);
+        case VAL_INTEGER:
+        case VAL_BOOLEAN:
+            return parcel->readInplace(sizeof(int32_t)) == nullptr ? BAD_VALUE : NO_ERROR;
+        case VAL_LONG:
+        case VAL_DOUBLE:
+            return parcel->readInplace(sizeof(int64_t)) == nullptr ? BAD_VALUE : NO_ERROR;
+        case VAL_STRINGARRAY: {
+            int32_t count;
+            status_t status = parcel->readInt32(&count);
+            if (status != NO_ERROR) return status;
+            if (count < 0) return UNEXPECTED_NULL;
+            for (; count > 0; --count) {
+                status = skipString16(parcel);
+                if (status != NO_ERROR) return status;
+            }
+            return NO_ERROR;
+        }
+        case VAL_INTARRAY:
+        case VAL_BOOLEANARRAY:
+            return skipArray(parcel, sizeof(int32_t));
+        case VAL_LONGARRAY:
+        case VAL_DOUBLEARRAY:
+            return skipArray(parcel, sizeof(int64_t));
+        case VAL_PERSISTABLEBUNDLE: {
+            int32_t length;
+            status_t status = parcel->readInt32(&length);
+            if (status != NO_ERROR) return status;
+            if (length < 0) return UNEXPECTED_NULL;
+            if (length == 0) return NO_ERROR;
+            // The length doesn't include the magic number that precedes the entries.
+            size_t bytes = static_cast<size_t>(length) + sizeof(int32_t);
+            if (bytes > parcel->dataAvail()) return BAD_VALUE;
+            return parcel->readInplace(bytes) == nullptr ? BAD_VALUE : NO_ERROR;
+        }
+        default:
+            ALOGE("Unrecognized type: %d", type);
+            return BAD_TYPE;
+    }
+}
 }  // namespace
 
 namespace android {
 
 namespace os {
 
+struct PersistableBundle::LazyState {
+    // Guards the read position of |parcel| and the maps of every bundle sharing this state.
+    std::mutex lock;
+    // The magic number followed by the entries, exactly as read.
+    Parcel parcel;
+};
+
 #define RETURN_IF_FAILED(calledOnce)                                     \
     {                                                                    \
         status_t returnStatus = calledOnce;                              \
@@ -104,6 +187,14 @@ status_t PersistableBundle::writeToParcel(Parcel* parcel) const {
      * frameworks/base/core/java/android/os/BaseBundle.java.
      */
 
+    // Unmodified bundles are written back from the bytes they were read from.
+    if (mLazy) {
+        size_t raw_size = mLazy->parcel.dataSize();
+        RETURN_IF_FAILED(parcel->writeInt32(static_cast<int32_t>(raw_size - sizeof(int32_t))));
+        RETURN_IF_FAILED(parcel->write(mLazy->parcel.data(), raw_size));
+        return NO_ERROR;
+    }
+
     // Special case for empty bundles.
     if (empty()) {
         RETURN_IF_FAILED(parcel->writeInt32(0));
@@ -141,15 +232,84 @@ status_t PersistableBundle::readFromParcel(const Parcel* parcel) {
         return UNEXPECTED_NULL;
     }
 
+    // Merging new entries into a lazily read bundle would invalidate its raw bytes.
+    unparcelForWrite();
+    if (length != 0 && empty() && gLazyUnparceling.load(std::memory_order_relaxed)) {
+        return readFromParcelLazy(parcel, static_cast<size_t>(length));
+    }
     return readFromParcelInner(parcel, static_cast<size_t>(length));
 }
 
+void PersistableBundle::setLazyUnparcelingEnabled(bool enabled) {
+    gLazyUnparceling.store(enabled, std::memory_order_relaxed);
+}
+
+std::unique_lock<std::mutex> PersistableBundle::lockLazy() const {
+    if (!mLazy) return {};
+    return std::unique_lock<std::mutex>(mLazy->lock);
+}
+
+std::unique_lock<std::mutex> PersistableBundle::unparcelKey(const String16& key,
+                                                            int32_t type) const {
+    std::unique_lock<std::mutex> lock = lockLazy();
+    if (!mLazy) return lock;
+
+    auto it = mPending.find(key);
+    if (it == mPending.end() || it->second.type != type) return lock;
+
+    mLazy->parcel.setDataPosition(it->second.offset);
+    if (status_t status = readValue(&mLazy->parcel, key, type); status != NO_ERROR) {
+        ALOGE("Failed to unparcel value of type %d: %s", type, statusToString(status).c_str());
+        discardValue(key);
+    }
+    mPending.erase(it);
+    return lock;
+}
+
+void PersistableBundle::unparcelAll() const {
+    std::unique_lock<std::mutex> lock = lockLazy();
+    if (!mLazy) return;
+
+    for (const auto& [key, value] : mPending) {
+        mLazy->parcel.setDataPosition(value.offset);
+        if (status_t status = readValue(&mLazy->parcel, key, value.type); status != NO_ERROR) {
+            ALOGE("Failed to unparcel value of type %d: %s", value.type,
+                  statusToString(status).c_str());
+            discardValue(key);
+        }
+    }
+    mPending.clear();
+}
+
+void PersistableBundle::discardValue(const String16& key) const {
+    // A value which failed to decode may have been partially inserted.
+    mBoolMap.erase(key);
+    mIntMap.erase(key);
+    mLongMap.erase(key);
+    mDoubleMap.erase(key);
+    mStringMap.erase(key);
+    mBoolVectorMap.erase(key);
+    mIntVectorMap.erase(key);
+    mLongVectorMap.erase(key);
+    mDoubleVectorMap.erase(key);
+    mStringVectorMap.erase(key);
+    mPersistableBundleMap.erase(key);
+}
+
+void PersistableBundle::unparcelForWrite() {
+    if (!mLazy) return;
+    unparcelAll();
+    mLazy.reset();
+}
+
 bool PersistableBundle::empty() const {
     return size() == 0u;
 }
 
 size_t PersistableBundle::size() const {
-    return (mBoolMap.size() +
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return (mPending.size() +
+            mBoolMap.size() +
             mIntMap.size() +
             mLongMap.size() +
             mDoubleMap.size() +
@@ -163,6 +323,7 @@ size_t PersistableBundle::size() const {
 }
 
 size_t PersistableBundle::erase(const String16& key) {
+    unparcelForWrite();
     RETURN_IF_ENTRY_ERASED(mBoolMap, key);
     RETURN_IF_ENTRY_ERASED(mIntMap, key);
     RETURN_IF_ENTRY_ERASED(mLongMap, key);
@@ -232,91 +393,113 @@ void PersistableBundle::putPersistableBundle(const String16& key, const Persista
 }
 
 bool PersistableBundle::getBoolean(const String16& key, bool* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_BOOLEAN);
     return getValue(key, out, mBoolMap);
 }
 
 bool PersistableBundle::getInt(const String16& key, int32_t* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_INTEGER);
     return getValue(key, out, mIntMap);
 }
 
 bool PersistableBundle::getLong(const String16& key, int64_t* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_LONG);
     return getValue(key, out, mLongMap);
 }
 
 bool PersistableBundle::getDouble(const String16& key, double* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_DOUBLE);
     return getValue(key, out, mDoubleMap);
 }
 
 bool PersistableBundle::getString(const String16& key, String16* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_STRING);
     return getValue(key, out, mStringMap);
 }
 
 bool PersistableBundle::getBooleanVector(const String16& key, vector<bool>* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_BOOLEANARRAY);
     return getValue(key, out, mBoolVectorMap);
 }
 
 bool PersistableBundle::getIntVector(const String16& key, vector<int32_t>* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_INTARRAY);
     return getValue(key, out, mIntVectorMap);
 }
 
 bool PersistableBundle::getLongVector(const String16& key, vector<int64_t>* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_LONGARRAY);
     return getValue(key, out, mLongVectorMap);
 }
 
 bool PersistableBundle::getDoubleVector(const String16& key, vector<double>* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_DOUBLEARRAY);
     return getValue(key, out, mDoubleVectorMap);
 }
 
 bool PersistableBundle::getStringVector(const String16& key, vector<String16>* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_STRINGARRAY);
     return getValue(key, out, mStringVectorMap);
 }
 
 bool PersistableBundle::getPersistableBundle(const String16& key, PersistableBundle* out) const {
+    std::unique_lock<std::mutex> lock = unparcelKey(key, VAL_PERSISTABLEBUNDLE);
     return getValue(key, out, mPersistableBundleMap);
 }
 
 set<String16> PersistableBundle::getBooleanKeys() const {
-    return getKeys(mBoolMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mBoolMap, mPending, VAL_BOOLEAN);
 }
 
 set<String16> PersistableBundle::getIntKeys() const {
-    return getKeys(mIntMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mIntMap, mPending, VAL_INTEGER);
 }
 
 set<String16> PersistableBundle::getLongKeys() const {
-    return getKeys(mLongMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mLongMap, mPending, VAL_LONG);
 }
 
 set<String16> PersistableBundle::getDoubleKeys() const {
-    return getKeys(mDoubleMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mDoubleMap, mPending, VAL_DOUBLE);
 }
 
 set<String16> PersistableBundle::getStringKeys() const {
-    return getKeys(mStringMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mStringMap, mPending, VAL_STRING);
 }
 
 set<String16> PersistableBundle::getBooleanVectorKeys() const {
-    return getKeys(mBoolVectorMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mBoolVectorMap, mPending, VAL_BOOLEANARRAY);
 }
 
 set<String16> PersistableBundle::getIntVectorKeys() const {
-    return getKeys(mIntVectorMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mIntVectorMap, mPending, VAL_INTARRAY);
 }
 
 set<String16> PersistableBundle::getLongVectorKeys() const {
-    return getKeys(mLongVectorMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mLongVectorMap, mPending, VAL_LONGARRAY);
 }
 
 set<String16> PersistableBundle::getDoubleVectorKeys() const {
-    return getKeys(mDoubleVectorMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mDoubleVectorMap, mPending, VAL_DOUBLEARRAY);
 }
 
 set<String16> PersistableBundle::getStringVectorKeys() const {
-    return getKeys(mStringVectorMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mStringVectorMap, mPending, VAL_STRINGARRAY);
 }
 
 set<String16> PersistableBundle::getPersistableBundleKeys() const {
-    return getKeys(mPersistableBundleMap);
+    std::unique_lock<std::mutex> lock = lockLazy();
+    return getKeys(mPersistableBundleMap, mPending, VAL_PERSISTABLEBUNDLE);
 }
 
 status_t PersistableBundle::writeToParcelInner(Parcel* parcel) const {
@@ -429,56 +612,103 @@ status_t PersistableBundle::readFromParcelInner(const Parcel* parcel, size_t len
          * We assume that both the C++ and Java APIs ensure that all keys in a PersistableBundle
          * are unique.
          */
-        switch (value_type) {
-            case VAL_STRING: {
-                RETURN_IF_FAILED(parcel->readString16(&mStringMap[key]));
-                break;
-            }
-            case VAL_INTEGER: {
-                RETURN_IF_FAILED(parcel->readInt32(&mIntMap[key]));
-                break;
-            }
-            case VAL_LONG: {
-                RETURN_IF_FAILED(parcel->readInt64(&mLongMap[key]));
-                break;
-            }
-            case VAL_DOUBLE: {
-                RETURN_IF_FAILED(parcel->readDouble(&mDoubleMap[key]));
-                break;
-            }
-            case VAL_BOOLEAN: {
-                RETURN_IF_FAILED(parcel->readBool(&mBoolMap[key]));
-                break;
-            }
-            case VAL_STRINGARRAY: {
-                RETURN_IF_FAILED(parcel->readString16Vector(&mStringVectorMap[key]));
-                break;
-            }
-            case VAL_INTARRAY: {
-                RETURN_IF_FAILED(parcel->readInt32Vector(&mIntVectorMap[key]));
-                break;
-            }
-            case VAL_LONGARRAY: {
-                RETURN_IF_FAILED(parcel->readInt64Vector(&mLongVectorMap[key]));
-                break;
-            }
-            case VAL_BOOLEANARRAY: {
-                RETURN_IF_FAILED(parcel->readBoolVector(&mBoolVectorMap[key]));
-                break;
-            }
-            case VAL_PERSISTABLEBUNDLE: {
-                RETURN_IF_FAILED(mPersistableBundleMap[key].readFromParcel(parcel));
-                break;
-            }
-            case VAL_DOUBLEARRAY: {
-                RETURN_IF_FAILED(parcel->readDoubleVector(&mDoubleVectorMap[key]));
-                break;
-            }
-            default: {
-                ALOGE("Unrecognized type: %d", value_type);
-                return BAD_TYPE;
-                break;
-            }
+        RETURN_IF_FAILED(readValue(parcel, key, value_type));
+    }
+
+    return NO_ERROR;
+}
+
+status_t PersistableBundle::readFromParcelLazy(const Parcel* parcel, size_t length) {
+    // The length doesn't include the magic number that precedes the entries.
+    size_t start_pos = parcel->dataPosition();
+    size_t raw_size = length + sizeof(int32_t);
+    if (raw_size > parcel->dataAvail()) {
+        ALOGE("PersistableBundle length (%zu) exceeds the parcel (%zu available)", length,
+              parcel->dataAvail());
+        return BAD_VALUE;
+    }
+
+    auto lazy = std::make_shared<LazyState>();
+    const Parcel* raw = &lazy->parcel;
+    RETURN_IF_FAILED(lazy->parcel.setData(parcel->data() + start_pos, raw_size));
+
+    int32_t magic;
+    RETURN_IF_FAILED(raw->readInt32(&magic));
+    if (magic != BUNDLE_MAGIC && magic != BUNDLE_MAGIC_NATIVE) {
+        ALOGE("Bad magic number for PersistableBundle: 0x%08x", magic);
+        return BAD_VALUE;
+    }
+
+    // Only the keys are decoded here; values are skipped and decoded on first access.
+    map<String16, PendingValue> pending;
+    int32_t num_entries;
+    RETURN_IF_FAILED(raw->readInt32(&num_entries));
+    for (; num_entries > 0; --num_entries) {
+        String16 key;
+        int32_t value_type;
+        RETURN_IF_FAILED(raw->readString16(&key));
+        RETURN_IF_FAILED(raw->readInt32(&value_type));
+        pending[key] = {value_type, raw->dataPosition()};
+        RETURN_IF_FAILED(skipValue(raw, value_type));
+    }
+
+    parcel->setDataPosition(start_pos + raw->dataPosition());
+    mPending = std::move(pending);
+    mLazy = std::move(lazy);
+    return NO_ERROR;
+}
+
+status_t PersistableBundle::readValue(const Parcel* parcel, const String16& key,
+                                      int32_t type) const {
+    switch (type) {
+        case VAL_STRING: {
+            RETURN_IF_FAILED(parcel->readString16(&mStringMap[key]));
+            break;
+        }
+        case VAL_INTEGER: {
+            RETURN_IF_FAILED(parcel->readInt32(&mIntMap[key]));
+            break;
+        }
+        case VAL_LONG: {
+            RETURN_IF_FAILED(parcel->readInt64(&mLongMap[key]));
+            break;
+        }
+        case VAL_DOUBLE: {
+            RETURN_IF_FAILED(parcel->readDouble(&mDoubleMap[key]));
+            break;
+        }
+        case VAL_BOOLEAN: {
+            RETURN_IF_FAILED(parcel->readBool(&mBoolMap[key]));
+            break;
+        }
+        case VAL_STRINGARRAY: {
+            RETURN_IF_FAILED(parcel->readString16Vector(&mStringVectorMap[key]));
+            break;
+        }
+        case VAL_INTARRAY: {
+            RETURN_IF_FAILED(parcel->readInt32Vector(&mIntVectorMap[key]));
+            break;
+        }
+        case VAL_LONGARRAY: {
+            RETURN_IF_FAILED(parcel->readInt64Vector(&mLongVectorMap[key]));
+            break;
+        }
+        case VAL_BOOLEANARRAY: {
+            RETURN_IF_FAILED(parcel->readBoolVector(&mBoolVectorMap[key]));
+            break;
+        }
+        case VAL_PERSISTABLEBUNDLE: {
+            RETURN_IF_FAILED(mPersistableBundleMap[key].readFromParcel(parcel));
+            break;
+        }
+        case VAL_DOUBLEARRAY: {
+            RETURN_IF_FAILED(parcel->readDoubleVector(&mDoubleVectorMap[key]));
+            break;
+        }
+        default: {
+            ALOGE("Unrecognized type: %d", type);
+            return BAD_TYPE;
+            break;
         }
     }
 
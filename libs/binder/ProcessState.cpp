@@ -58,19 +58,24 @@ namespace android {
 class PoolThread : public Thread
 {
 public:
-    explicit PoolThread(bool isMain)
-        : mIsMain(isMain)
+    explicit PoolThread(bool isMain, bool canRetire = false)
+        : mIsMain(isMain), mCanRetire(canRetire)
     {
     }
 
 protected:
     virtual bool threadLoop()
     {
-        IPCThreadState::self()->joinThreadPool(mIsMain);
+        if (mCanRetire) {
+            IPCThreadState::self()->joinThreadPoolUntilIdle();
+        } else {
+            IPCThreadState::self()->joinThreadPool(mIsMain);
+        }
         return false;
     }
 
     const bool mIsMain;
+    const bool mCanRetire;
 };
 
 sp<ProcessState> ProcessState::self()
@@ -142,6 +147,18 @@ void ProcessState::startThreadPool()
     if (!mThreadPoolStarted) {
         mThreadPoolStarted = true;
         spawnPooledThread(true);
+
+        if (mAdaptiveThreadPool) {
+            pthread_mutex_lock(&mThreadCountLock);
+            size_t extra = mMinThreads - 1;
+            mPoolThreadCount += mMinThreads;
+            mThreadPoolStats.spawned += extra;
+            pthread_mutex_unlock(&mThreadCountLock);
+
+            for (size_t i = 0; i < extra; i++) {
+                spawnAdaptiveThread();
+            }
+        }
     }
 }
 
@@ -234,6 +251,13 @@ void ProcessState::setCallRestriction(CallRestriction restriction) {
     mCallRestriction = restriction;
 }
 
+void ProcessState::setParcelBufferPoolEnabled(bool enabled) {
+    LOG_ALWAYS_FATAL_IF(IPCThreadState::selfOrNull() != nullptr,
+        "Parcel buffer pooling must be set before the threadpool is started.");
+
+    mParcelBufferPoolEnabled = enabled;
+}
+
 ProcessState::handle_entry* ProcessState::lookupHandleLocked(int32_t handle)
 {
     const size_t N=mHandleToObject.size();
@@ -339,6 +363,10 @@ String8 ProcessState::makeBinderThreadName() {
 void ProcessState::spawnPooledThread(bool isMain)
 {
     if (mThreadPoolStarted) {
+        pthread_mutex_lock(&mThreadCountLock);
+        mThreadPoolStats.spawned++;
+        pthread_mutex_unlock(&mThreadCountLock);
+
         String8 name = makeBinderThreadName();
         ALOGV("Spawning new pooled thread, name=%s\n", name.string());
         sp<Thread> t = sp<PoolThread>::make(isMain);
@@ -346,6 +374,15 @@ void ProcessState::spawnPooledThread(bool isMain)
     }
 }
 
+// Caller accounts for the thread in mPoolThreadCount and mThreadPoolStats.
+void ProcessState::spawnAdaptiveThread()
+{
+    String8 name = makeBinderThreadName();
+    ALOGV("Spawning new adaptive pooled thread, name=%s\n", name.string());
+    sp<Thread> t = sp<PoolThread>::make(false /*isMain*/, true /*canRetire*/);
+    t->run(name.string());
+}
+
 status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     LOG_ALWAYS_FATAL_IF(mThreadPoolStarted && maxThreads < mMaxThreads,
            "Binder threadpool cannot be shrunk after starting");
@@ -359,6 +396,41 @@ status_t ProcessState::setThreadPoolMaxThreadCount(size_t maxThreads) {
     return result;
 }
 
+status_t ProcessState::setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                             int64_t idleTimeoutMs) {
+    if (minThreads < 1 || maxThreads < minThreads || idleTimeoutMs <= 0) {
+        return BAD_VALUE;
+    }
+    LOG_ALWAYS_FATAL_IF(mThreadPoolStarted,
+                        "Adaptive thread pool must be configured before starting it");
+
+    // Threads are spawned from userspace with BC_ENTER_LOOPER, so stop the
+    // driver from asking for more. It never forgets threads it started, so it
+    // couldn't regrow the pool after threads retire anyway.
+    size_t kernelMaxThreads = 0;
+    if (ioctl(mDriverFD, BINDER_SET_MAX_THREADS, &kernelMaxThreads) == -1) {
+        status_t result = -errno;
+        ALOGE("Binder ioctl to set max threads failed: %s", strerror(-result));
+        return result;
+    }
+
+    pthread_mutex_lock(&mThreadCountLock);
+    mAdaptiveThreadPool = true;
+    mMinThreads = minThreads;
+    mMaxThreads = maxThreads;
+    mThreadIdleTimeoutMs = idleTimeoutMs;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return NO_ERROR;
+}
+
+ProcessState::ThreadPoolStats ProcessState::getThreadPoolStats() {
+    pthread_mutex_lock(&mThreadCountLock);
+    ThreadPoolStats stats = mThreadPoolStats;
+    stats.threads = mPoolThreadCount;
+    pthread_mutex_unlock(&mThreadCountLock);
+    return stats;
+}
+
 status_t ProcessState::enableOnewaySpamDetection(bool enable) {
     uint32_t enableDetection = enable ? 1 : 0;
     if (ioctl(mDriverFD, BINDER_ENABLE_ONEWAY_SPAM_DETECTION, &enableDetection) == -1) {
@@ -419,9 +491,14 @@ ProcessState::ProcessState(const char *driver)
     , mWaitingForThreads(0)
     , mMaxThreads(DEFAULT_MAX_BINDER_THREADS)
     , mStarvationStartTimeMs(0)
+    , mAdaptiveThreadPool(false)
+    , mMinThreads(0)
+    , mThreadIdleTimeoutMs(0)
+    , mPoolThreadCount(0)
     , mThreadPoolStarted(false)
     , mThreadPoolSeq(1)
     , mCallRestriction(CallRestriction::NONE)
+    , mParcelBufferPoolEnabled(false)
 {
     if (mDriverFD >= 0) {
         // mmap the binder, providing a chunk of virtual address space to receive transactions.
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "RpcServer"
 
+#include <sys/epoll.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 
@@ -107,6 +108,11 @@ size_t RpcServer::getMaxThreads() {
     return mMaxThreads;
 }
 
+void RpcServer::setEventLoopEnabled(bool enabled) {
+    LOG_ALWAYS_FATAL_IF(mStarted, "must be called before started");
+    mEventLoop = enabled;
+}
+
 void RpcServer::setRootObject(const sp<IBinder>& binder) {
     std::lock_guard<std::mutex> _l(mLock);
     mRootObjectWeak = mRootObject = binder;
@@ -185,6 +191,7 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
 
     std::thread thisThread;
     sp<RpcSession> session;
+    sp<RpcSession::RpcConnection> failedConnection;
     {
         std::lock_guard<std::mutex> _l(mLock);
 
@@ -216,8 +223,19 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
             session = it->second;
         }
 
-        detachGuard.Disable();
-        session->preJoin(std::move(thisThread));
+        if (mEventLoop) {
+            // this thread isn't needed anymore, detachGuard lets it go
+            failedConnection = addEventLoopConnectionLocked(session, std::move(clientFd));
+        } else {
+            detachGuard.Disable();
+            session->preJoin(std::move(thisThread));
+        }
+    }
+
+    if (mEventLoop) {
+        // may call onSessionTerminating, which takes mLock
+        if (failedConnection != nullptr) (void)session->removeServerConnection(failedConnection);
+        return;
     }
 
     // avoid strong cycle
@@ -230,6 +248,76 @@ void RpcServer::establishConnection(sp<RpcServer>&& server, base::unique_fd clie
     session->join(std::move(clientFd));
 }
 
+sp<RpcSession::RpcConnection> RpcServer::addEventLoopConnectionLocked(const sp<RpcSession>& session,
+                                                                      unique_fd clientFd) {
+    if (!mEpollFd.ok()) {
+        mEpollFd.reset(epoll_create1(EPOLL_CLOEXEC));
+        LOG_ALWAYS_FATAL_IF(!mEpollFd.ok(), "Could not create epoll fd: %s", strerror(errno));
+
+        // Like join(), these run forever and keep the server alive.
+        for (size_t i = 0; i < mMaxThreads; i++) {
+            std::thread([server = sp<RpcServer>::fromExisting(this)]() {
+                server->eventLoopThread();
+            }).detach();
+        }
+    }
+
+    int fd = clientFd.get();
+    sp<RpcSession::RpcConnection> connection = session->addServerConnection(std::move(clientFd));
+
+    // one shot, so that only one thread at a time reads a given connection
+    epoll_event event{
+            .events = EPOLLIN | EPOLLONESHOT,
+            .data.ptr = connection.get(),
+    };
+    mEventLoopConnections[connection.get()] = {.session = session, .connection = connection};
+    if (0 != epoll_ctl(mEpollFd.get(), EPOLL_CTL_ADD, fd, &event)) {
+        ALOGE("Could not add fd %d to epoll: %s", fd, strerror(errno));
+        mEventLoopConnections.erase(connection.get());
+        return connection;
+    }
+    return nullptr;
+}
+
+void RpcServer::eventLoopThread() {
+    while (true) {
+        epoll_event event;
+        int ready = TEMP_FAILURE_RETRY(epoll_wait(mEpollFd.get(), &event, 1, -1 /*timeout*/));
+        if (ready < 0) {
+            ALOGE("epoll_wait failed, event loop thread exiting: %s", strerror(errno));
+            return;
+        }
+        if (ready == 0) continue;
+
+        auto key = static_cast<RpcSession::RpcConnection*>(event.data.ptr);
+        EventLoopConnection entry;
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            auto it = mEventLoopConnections.find(key);
+            if (it == mEventLoopConnections.end()) continue;
+            entry = it->second;
+        }
+
+        int fd = entry.connection->fd.get();
+        status_t error = entry.session->serveOneCommand(entry.connection);
+        if (error == OK) {
+            event.events = EPOLLIN | EPOLLONESHOT;
+            if (0 == epoll_ctl(mEpollFd.get(), EPOLL_CTL_MOD, fd, &event)) continue;
+            error = -errno;
+        }
+
+        ALOGI("Binder connection closing w/ status %s", statusToString(error).c_str());
+        (void)epoll_ctl(mEpollFd.get(), EPOLL_CTL_DEL, fd, nullptr);
+        {
+            std::lock_guard<std::mutex> _l(mLock);
+            mEventLoopConnections.erase(key);
+        }
+        // may call onSessionTerminating, which takes mLock
+        LOG_ALWAYS_FATAL_IF(!entry.session->removeServerConnection(entry.connection),
+                            "bad state: connection object guaranteed to be in list");
+    }
+}
+
 bool RpcServer::setupSocketServer(const RpcSocketAddress& addr) {
     LOG_RPC_DETAIL("Setting up socket server %s", addr.toString().c_str());
     LOG_ALWAYS_FATAL_IF(hasServer(), "Each RpcServer can only have one server.");
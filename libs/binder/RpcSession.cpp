@@ -88,18 +88,43 @@ bool RpcSession::addNullDebuggingClient() {
     return true;
 }
 
+void RpcSession::setMultiplexed(bool multiplexed) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    LOG_ALWAYS_FATAL_IF(mClientConnections.size() != 0,
+                        "Must set multiplexed mode before setting up the session");
+    mMultiplexed = multiplexed;
+}
+
 sp<IBinder> RpcSession::getRootObject() {
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        return state()->getRootObject(shared->fd, sp<RpcSession>::fromExisting(this));
+    }
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
     return state()->getRootObject(connection.fd(), sp<RpcSession>::fromExisting(this));
 }
 
 status_t RpcSession::getRemoteMaxThreads(size_t* maxThreads) {
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        return state()->getMaxThreads(shared->fd, sp<RpcSession>::fromExisting(this), maxThreads);
+    }
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
     return state()->getMaxThreads(connection.fd(), sp<RpcSession>::fromExisting(this), maxThreads);
 }
 
+status_t RpcSession::setupSharedMemory(size_t size) {
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        return state()->setupSharedMemory(shared->fd, sp<RpcSession>::fromExisting(this), size);
+    }
+    ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
+    return state()->setupSharedMemory(connection.fd(), sp<RpcSession>::fromExisting(this), size);
+}
+
 status_t RpcSession::transact(const RpcAddress& address, uint32_t code, const Parcel& data,
                               Parcel* reply, uint32_t flags) {
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        return state()->transact(shared->fd, address, code, data,
+                                 sp<RpcSession>::fromExisting(this), reply, flags);
+    }
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    (flags & IBinder::FLAG_ONEWAY) ? ConnectionUse::CLIENT_ASYNC
                                                                   : ConnectionUse::CLIENT);
@@ -108,6 +133,9 @@ status_t RpcSession::transact(const RpcAddress& address, uint32_t code, const Pa
 }
 
 status_t RpcSession::sendDecStrong(const RpcAddress& address) {
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        return state()->sendDecStrong(shared->fd, address);
+    }
     ExclusiveConnection connection(sp<RpcSession>::fromExisting(this),
                                    ConnectionUse::CLIENT_REFCOUNT);
     return state()->sendDecStrong(connection.fd(), address);
@@ -120,10 +148,14 @@ status_t RpcSession::readId() {
     }
 
     int32_t id;
+    status_t status;
 
-    ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
-    status_t status =
-            state()->getSessionId(connection.fd(), sp<RpcSession>::fromExisting(this), &id);
+    if (sp<RpcConnection> shared = multiplexedConnection(); shared != nullptr) {
+        status = state()->getSessionId(shared->fd, sp<RpcSession>::fromExisting(this), &id);
+    } else {
+        ExclusiveConnection connection(sp<RpcSession>::fromExisting(this), ConnectionUse::CLIENT);
+        status = state()->getSessionId(connection.fd(), sp<RpcSession>::fromExisting(this), &id);
+    }
     if (status != OK) return status;
 
     LOG_RPC_DETAIL("RpcSession %p has id %d", this, id);
@@ -197,6 +229,20 @@ bool RpcSession::setupSocketClient(const RpcSocketAddress& addr) {
 
     if (!setupOneSocketClient(addr, RPC_SESSION_ID_NEW)) return false;
 
+    if (mMultiplexed) {
+        {
+            std::lock_guard<std::mutex> _l(mMutex);
+            state()->setMultiplexedFd(mClientConnections[0]->fd);
+        }
+        // one connection is plenty, however many threads the server has
+        if (status_t status = readId(); status != OK) {
+            ALOGE("Could not get session id after initial session to %s; %s",
+                  addr.toString().c_str(), statusToString(status).c_str());
+            return false;
+        }
+        return true;
+    }
+
     // TODO(b/185167543): we should add additional sessions dynamically
     // instead of all at once.
     // TODO(b/186470974): first risk of blocking
@@ -285,6 +331,32 @@ sp<RpcSession::RpcConnection> RpcSession::assignServerToThisThread(unique_fd fd)
     return session;
 }
 
+sp<RpcSession::RpcConnection> RpcSession::addServerConnection(unique_fd fd) {
+    std::lock_guard<std::mutex> _l(mMutex);
+    sp<RpcConnection> session = sp<RpcConnection>::make();
+    session->fd = std::move(fd);
+    mServerConnections.push_back(session);
+
+    return session;
+}
+
+status_t RpcSession::serveOneCommand(const sp<RpcConnection>& connection) {
+    {
+        // allows nested calls from this thread to find this connection
+        std::lock_guard<std::mutex> _l(mMutex);
+        connection->exclusiveTid = gettid();
+    }
+
+    status_t error =
+            state()->getAndExecuteCommand(connection->fd, sp<RpcSession>::fromExisting(this));
+
+    {
+        std::lock_guard<std::mutex> _l(mMutex);
+        connection->exclusiveTid = std::nullopt;
+    }
+    return error;
+}
+
 bool RpcSession::removeServerConnection(const sp<RpcConnection>& connection) {
     std::lock_guard<std::mutex> _l(mMutex);
     if (auto it = std::find(mServerConnections.begin(), mServerConnections.end(), connection);
@@ -298,6 +370,18 @@ bool RpcSession::removeServerConnection(const sp<RpcConnection>& connection) {
     return false;
 }
 
+sp<RpcSession::RpcConnection> RpcSession::multiplexedConnection() {
+    if (!mMultiplexed) return nullptr;
+
+    pid_t tid = gettid();
+    std::lock_guard<std::mutex> _l(mMutex);
+    for (const sp<RpcConnection>& connection : mServerConnections) {
+        if (connection->exclusiveTid == tid) return nullptr;
+    }
+    if (mClientConnections.size() == 0) return nullptr;
+    return mClientConnections[0];
+}
+
 RpcSession::ExclusiveConnection::ExclusiveConnection(const sp<RpcSession>& session,
                                                      ConnectionUse use)
       : mSession(session) {
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "RpcSharedMemory"
+
+#include "RpcSharedMemory.h"
+
+#include <log/log.h>
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace android {
+
+using base::unique_fd;
+
+// Start of the region. The halves follow it, client -> server first.
+struct RpcSharedMemoryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t halfSize;
+};
+
+static constexpr uint32_t kMagic = 0x52504d53; // 'RPMS'
+static constexpr uint32_t kVersion = 1;
+static constexpr size_t kHeaderSize = 4096;
+// chunks are cache line aligned, so the refcount never shares a line with
+// another chunk's data
+static constexpr size_t kAlignment = 64;
+static constexpr size_t kChunkHeaderSize = kAlignment;
+
+std::unique_ptr<RpcSharedMemory> RpcSharedMemory::create(size_t size, unique_fd* outFd) {
+    if (size < kMinSize || size > kMaxSize) {
+        ALOGE("Shared memory size %zu must be between %zu and %zu", size, kMinSize, kMaxSize);
+        return nullptr;
+    }
+    size_t halfSize = (size / 2) & ~(kAlignment - 1);
+    size_t total = kHeaderSize + 2 * halfSize;
+
+    unique_fd fd(memfd_create("rpc_binder_blobs", MFD_CLOEXEC | MFD_ALLOW_SEALING));
+    if (!fd.ok()) {
+        ALOGE("Could not create memfd: %s", strerror(errno));
+        return nullptr;
+    }
+    if (0 != TEMP_FAILURE_RETRY(ftruncate(fd.get(), total))) {
+        ALOGE("Could not size memfd to %zu: %s", total, strerror(errno));
+        return nullptr;
+    }
+    // the server refuses regions which could be shrunk under it (SIGBUS)
+    if (0 != fcntl(fd.get(), F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        ALOGE("Could not seal memfd: %s", strerror(errno));
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (base == MAP_FAILED) {
+        ALOGE("Could not map memfd of size %zu: %s", total, strerror(errno));
+        return nullptr;
+    }
+
+    RpcSharedMemoryHeader* header = static_cast<RpcSharedMemoryHeader*>(base);
+    header->magic = kMagic;
+    header->version = kVersion;
+    header->halfSize = halfSize;
+
+    *outFd = std::move(fd);
+    return std::unique_ptr<RpcSharedMemory>(new RpcSharedMemory(base, total, true /*isClient*/));
+}
+
+std::unique_ptr<RpcSharedMemory> RpcSharedMemory::accept(unique_fd fd, size_t size) {
+    if (!fd.ok()) {
+        ALOGE("No fd was sent with the shared memory region");
+        return nullptr;
+    }
+    if (size < kHeaderSize + kMinSize || size > kHeaderSize + kMaxSize) {
+        ALOGE("Refusing shared memory region of size %zu", size);
+        return nullptr;
+    }
+
+    struct stat st;
+    if (0 != fstat(fd.get(), &st) || static_cast<uint64_t>(st.st_size) != size) {
+        ALOGE("Shared memory region does not have the advertised size %zu", size);
+        return nullptr;
+    }
+    int seals = fcntl(fd.get(), F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        ALOGE("Shared memory region can be shrunk, refusing it");
+        return nullptr;
+    }
+
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (base == MAP_FAILED) {
+        ALOGE("Could not map shared memory region of size %zu: %s", size, strerror(errno));
+        return nullptr;
+    }
+
+    const RpcSharedMemoryHeader* header = static_cast<const RpcSharedMemoryHeader*>(base);
+    if (header->magic != kMagic || header->version != kVersion ||
+        header->halfSize % kAlignment != 0 || kHeaderSize + 2 * header->halfSize != size) {
+        ALOGE("Shared memory region has an unexpected layout");
+        munmap(base, size);
+        return nullptr;
+    }
+
+    return std::unique_ptr<RpcSharedMemory>(new RpcSharedMemory(base, size, false /*isClient*/));
+}
+
+RpcSharedMemory::RpcSharedMemory(void* base, size_t size, bool isClient)
+      : mBase(base), mSize(size), mHalfSize((size - kHeaderSize) / 2) {
+    uint8_t* clientToServer = static_cast<uint8_t*>(base) + kHeaderSize;
+    uint8_t* serverToClient = clientToServer + mHalfSize;
+    mOutgoing = isClient ? clientToServer : serverToClient;
+    mIncoming = isClient ? serverToClient : clientToServer;
+}
+
+RpcSharedMemory::~RpcSharedMemory() {
+    LOG_ALWAYS_FATAL_IF(!mParcelChunks.empty(),
+                        "Shared memory destroyed while %zu parcels still use it",
+                        mParcelChunks.size());
+    munmap(mBase, mSize);
+}
+
+RpcSharedMemory::ChunkHeader* RpcSharedMemory::outgoingChunk(uint64_t offset) {
+    return reinterpret_cast<ChunkHeader*>(mOutgoing + offset);
+}
+
+RpcSharedMemory::ChunkHeader* RpcSharedMemory::incomingChunk(uint64_t offset) {
+    return reinterpret_cast<ChunkHeader*>(mIncoming + offset);
+}
+
+bool RpcSharedMemory::validIncoming(uint64_t offset, size_t len) {
+    if (offset % kAlignment != 0) return false;
+    if (offset > mHalfSize - kChunkHeaderSize) return false;
+    return len <= mHalfSize - kChunkHeaderSize - offset;
+}
+
+void RpcSharedMemory::reclaimLocked() {
+    while (!mLiveChunks.empty()) {
+        const LiveChunk& chunk = mLiveChunks.front();
+        if (!chunk.padding &&
+            outgoingChunk(chunk.offset)->refs.load(std::memory_order_acquire) != 0) {
+            break;
+        }
+        mLiveChunks.pop_front();
+    }
+    if (mLiveChunks.empty()) mHead = 0;
+}
+
+status_t RpcSharedMemory::allocate(const Parcel* parcel, size_t len, void** outData,
+                                   uint64_t* outOffset) {
+    if (len > mHalfSize - kChunkHeaderSize) return NO_MEMORY;
+    size_t need = (kChunkHeaderSize + len + kAlignment - 1) & ~(kAlignment - 1);
+
+    std::lock_guard<std::mutex> _l(mLock);
+    reclaimLocked();
+
+    if (!mLiveChunks.empty() && mHead <= mLiveChunks.front().offset) {
+        // free space is [head, tail)
+        if (mLiveChunks.front().offset - mHead < need) return NO_MEMORY;
+    } else if (mHalfSize - mHead < need) {
+        // free space is [head, end) and [0, tail), but only the start fits
+        size_t tail = mLiveChunks.empty() ? 0 : mLiveChunks.front().offset;
+        if (tail < need) return NO_MEMORY;
+        mLiveChunks.push_back({.offset = mHead, .padding = true});
+        mHead = 0;
+    }
+
+    outgoingChunk(mHead)->refs.store(1, std::memory_order_relaxed);
+    mLiveChunks.push_back({.offset = mHead, .padding = false});
+    mParcelChunks[parcel].outgoing.push_back(mHead);
+
+    *outData = mOutgoing + mHead + kChunkHeaderSize;
+    *outOffset = mHead;
+
+    mHead += need;
+    if (mHead == mHalfSize) mHead = 0;
+    return OK;
+}
+
+status_t RpcSharedMemory::map(const Parcel* parcel, uint64_t offset, size_t len,
+                              const void** outData) {
+    std::lock_guard<std::mutex> _l(mLock);
+
+    auto it = mParcelChunks.find(parcel);
+    if (it == mParcelChunks.end() ||
+        std::find(it->second.incoming.begin(), it->second.incoming.end(), offset) ==
+                it->second.incoming.end()) {
+        ALOGE("Blob at %" PRIu64 " was not sent with this parcel", offset);
+        return BAD_VALUE;
+    }
+    if (!validIncoming(offset, len)) {
+        ALOGE("Blob at %" PRIu64 " of size %zu is outside of shared memory", offset, len);
+        return BAD_VALUE;
+    }
+
+    *outData = mIncoming + offset + kChunkHeaderSize;
+    return OK;
+}
+
+std::vector<uint64_t> RpcSharedMemory::outgoingOffsets(const Parcel* parcel) {
+    std::lock_guard<std::mutex> _l(mLock);
+    auto it = mParcelChunks.find(parcel);
+    if (it == mParcelChunks.end()) return {};
+    return it->second.outgoing;
+}
+
+void RpcSharedMemory::onSend(const std::vector<uint64_t>& offsets) {
+    for (uint64_t offset : offsets) {
+        outgoingChunk(offset)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void RpcSharedMemory::onSendFailed(const std::vector<uint64_t>& offsets) {
+    for (uint64_t offset : offsets) {
+        outgoingChunk(offset)->refs.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+status_t RpcSharedMemory::onReceive(const Parcel* parcel, const uint64_t* offsets, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (!validIncoming(offsets[i], 0)) {
+            ALOGE("Received blob at %" PRIu64 " outside of shared memory", offsets[i]);
+            return BAD_VALUE;
+        }
+    }
+
+    if (parcel == nullptr) {
+        for (size_t i = 0; i < count; i++) {
+            incomingChunk(offsets[i])->refs.fetch_sub(1, std::memory_order_release);
+        }
+        return OK;
+    }
+
+    std::lock_guard<std::mutex> _l(mLock);
+    std::vector<uint64_t>& incoming = mParcelChunks[parcel].incoming;
+    incoming.insert(incoming.end(), offsets, offsets + count);
+    return OK;
+}
+
+void RpcSharedMemory::onParcelFreed(const Parcel* parcel) {
+    ParcelChunks chunks;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        auto it = mParcelChunks.find(parcel);
+        if (it == mParcelChunks.end()) return;
+        chunks = std::move(it->second);
+        mParcelChunks.erase(it);
+    }
+
+    for (uint64_t offset : chunks.outgoing) {
+        outgoingChunk(offset)->refs.fetch_sub(1, std::memory_order_release);
+    }
+    for (uint64_t offset : chunks.incoming) {
+        incomingChunk(offset)->refs.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+} // namespace android
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <utils/Errors.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * A memfd shared by both sides of an RPC session, so that large blobs
+ * (Parcel::writeBlob) don't have to be copied through the socket.
+ *
+ * The region is split in two halves, one per direction. Each side allocates
+ * blobs from its outgoing half as a ring, and the other side only reads from
+ * it. Every blob starts with a reference count in shared memory: one for the
+ * Parcel which wrote it, and one more each time that Parcel is sent. The
+ * receiving side drops its reference when the received Parcel is freed, and
+ * the writer reuses the space once the count reaches zero.
+ *
+ * The list of blobs in a Parcel is sent alongside it (see RpcWireTransaction),
+ * so the receiver releases them even if it never calls readBlob.
+ */
+class RpcSharedMemory {
+public:
+    // Creates a region for a client. The fd should be sent to the server,
+    // which maps it with 'accept'.
+    static std::unique_ptr<RpcSharedMemory> create(size_t size, base::unique_fd* outFd);
+    static std::unique_ptr<RpcSharedMemory> accept(base::unique_fd fd, size_t size);
+    ~RpcSharedMemory();
+
+    /**
+     * Reserves 'len' bytes in the outgoing half for a blob written into 'parcel'.
+     * The blob stays valid until 'parcel' is freed.
+     */
+    status_t allocate(const Parcel* parcel, size_t len, void** outData, uint64_t* outOffset);
+
+    /**
+     * Looks up a blob which was received as part of 'parcel'.
+     */
+    status_t map(const Parcel* parcel, uint64_t offset, size_t len, const void** outData);
+
+    // offsets of blobs written into 'parcel', to be sent along with it
+    std::vector<uint64_t> outgoingOffsets(const Parcel* parcel);
+
+    // takes a reference for the remote side on each outgoing blob of 'parcel'
+    void onSend(const std::vector<uint64_t>& offsets);
+    // undoes onSend, if the parcel never made it to the other side
+    void onSendFailed(const std::vector<uint64_t>& offsets);
+
+    /**
+     * Records blobs which arrived with 'parcel', so they are released when it
+     * is freed. If 'parcel' is null, they are released immediately.
+     */
+    status_t onReceive(const Parcel* parcel, const uint64_t* offsets, size_t count);
+
+    // releases every blob 'parcel' holds, whether written or received
+    void onParcelFreed(const Parcel* parcel);
+
+    static constexpr size_t kMinSize = 64 * 1024;
+    static constexpr size_t kMaxSize = 256 * 1024 * 1024;
+
+private:
+    struct ChunkHeader {
+        std::atomic<uint32_t> refs;
+    };
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    // a chunk allocated from the outgoing half, in ring order
+    struct LiveChunk {
+        size_t offset;
+        bool padding; // unused space at the end of the half, skipped on wrap
+    };
+
+    struct ParcelChunks {
+        std::vector<uint64_t> outgoing;
+        std::vector<uint64_t> incoming;
+    };
+
+    RpcSharedMemory(void* base, size_t size, bool isClient);
+
+    ChunkHeader* outgoingChunk(uint64_t offset);
+    ChunkHeader* incomingChunk(uint64_t offset);
+    bool validIncoming(uint64_t offset, size_t len);
+    void reclaimLocked();
+
+    void* mBase;
+    size_t mSize;
+    size_t mHalfSize;
+    uint8_t* mOutgoing;
+    uint8_t* mIncoming;
+
+    std::mutex mLock; // for below
+    std::deque<LiveChunk> mLiveChunks;
+    size_t mHead = 0; // next offset to allocate at
+    std::unordered_map<const Parcel*, ParcelChunks> mParcelChunks;
+};
+
+} // namespace android
@@ -18,13 +18,20 @@
 
 #include "RpcState.h"
 
+#include <android-base/macros.h>
 #include <binder/BpBinder.h>
 #include <binder/RpcServer.h>
 
 #include "Debug.h"
+#include "RpcSharedMemory.h"
 #include "RpcWireFormat.h"
 
+#include <fcntl.h>
 #include <inttypes.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include <thread>
 
 namespace android {
 
@@ -194,9 +201,8 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
     // transaction (in some cases, additional fixed size amounts are added),
     // though for rough consistency, we should avoid cases where this data type
     // is used for multiple dynamic allocations for a single transaction.
-    constexpr size_t kMaxTransactionAllocation = 100 * 1000;
     if (size == 0) return;
-    if (size > kMaxTransactionAllocation) {
+    if (size > kMaxAllocation) {
         ALOGW("Transaction requested too much data allocation %zu", size);
         return;
     }
@@ -204,7 +210,21 @@ RpcState::CommandData::CommandData(size_t size) : mSize(size) {
 }
 
 bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, const void* data, size_t size) {
-    LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, fd.get(), hexString(data, size).c_str());
+    iovec iov{const_cast<void*>(data), size};
+    return rpcSend(fd, what, &iov, 1);
+}
+
+bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, iovec* iovs, size_t niovs,
+                       int ancillaryFd) {
+    size_t size = 0;
+    for (size_t i = 0; i < niovs; i++) {
+        LOG_RPC_DETAIL("Sending %s on fd %d: %s", what, fd.get(),
+                       hexString(iovs[i].iov_base, iovs[i].iov_len).c_str());
+        if (__builtin_add_overflow(size, iovs[i].iov_len, &size)) {
+            size = std::numeric_limits<size_t>::max();
+            break;
+        }
+    }
 
     if (size > std::numeric_limits<ssize_t>::max()) {
         ALOGE("Cannot send %s at size %zu (too big)", what, size);
@@ -212,27 +232,90 @@ bool RpcState::rpcSend(const base::unique_fd& fd, const char* what, const void*
         return false;
     }
 
-    ssize_t sent = TEMP_FAILURE_RETRY(send(fd.get(), data, size, MSG_NOSIGNAL));
-
-    if (sent < 0 || sent != static_cast<ssize_t>(size)) {
-        ALOGE("Failed to send %s (sent %zd of %zu bytes) on fd %d, error: %s", what, sent, size,
-              fd.get(), strerror(errno));
-
-        terminate();
-        return false;
+    // Scatter-gather straight from the caller's buffers (e.g. Parcel data), so
+    // headers and payloads go out in one syscall without being copied together.
+    msghdr msg{
+            .msg_iov = iovs,
+            .msg_iovlen = niovs,
+    };
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    if (ancillaryFd != -1) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &ancillaryFd, sizeof(int));
+    }
+    size_t sentTotal = 0;
+    while (sentTotal < size) {
+        ssize_t sent = TEMP_FAILURE_RETRY(sendmsg(fd.get(), &msg, MSG_NOSIGNAL));
+        // the fd goes out with the first part of the message only
+        msg.msg_control = nullptr;
+        msg.msg_controllen = 0;
+
+        if (sent <= 0) {
+            ALOGE("Failed to send %s (sent %zu of %zu bytes) on fd %d, error: %s", what,
+                  sentTotal, size, fd.get(), strerror(errno));
+
+            terminate();
+            return false;
+        }
+        sentTotal += sent;
+
+        // partial send, skip over whatever made it out
+        while (sent > 0) {
+            if (static_cast<size_t>(sent) < msg.msg_iov->iov_len) {
+                msg.msg_iov->iov_base = static_cast<uint8_t*>(msg.msg_iov->iov_base) + sent;
+                msg.msg_iov->iov_len -= sent;
+                break;
+            }
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
     }
 
     return true;
 }
 
 bool RpcState::rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size) {
+    return rpcRec(fd, what, data, size, nullptr /*outAncillaryFd*/);
+}
+
+bool RpcState::rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size,
+                      base::unique_fd* outAncillaryFd) {
     if (size > std::numeric_limits<ssize_t>::max()) {
         ALOGE("Cannot rec %s at size %zu (too big)", what, size);
         terminate();
         return false;
     }
 
-    ssize_t recd = TEMP_FAILURE_RETRY(recv(fd.get(), data, size, MSG_WAITALL | MSG_NOSIGNAL));
+    ssize_t recd;
+    if (outAncillaryFd == nullptr) {
+        recd = TEMP_FAILURE_RETRY(recv(fd.get(), data, size, MSG_WAITALL | MSG_NOSIGNAL));
+    } else {
+        iovec iov{data, size};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr msg{
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = control,
+                .msg_controllen = sizeof(control),
+        };
+        recd = TEMP_FAILURE_RETRY(
+                recvmsg(fd.get(), &msg, MSG_WAITALL | MSG_NOSIGNAL | MSG_CMSG_CLOEXEC));
+        if (recd > 0) {
+            for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+                int receivedFd;
+                memcpy(&receivedFd, CMSG_DATA(cmsg), sizeof(int));
+                outAncillaryFd->reset(receivedFd);
+            }
+        }
+    }
 
     if (recd < 0 || recd != static_cast<ssize_t>(size)) {
         terminate();
@@ -313,9 +396,102 @@ status_t RpcState::getSessionId(const base::unique_fd& fd, const sp<RpcSession>&
     return OK;
 }
 
+status_t RpcState::setupSharedMemory(const base::unique_fd& fd, const sp<RpcSession>& session,
+                                     size_t size) {
+    if (sharedMemory() != nullptr) {
+        ALOGE("Shared memory was already set up for this session");
+        return INVALID_OPERATION;
+    }
+
+    sockaddr_storage addr;
+    socklen_t addrLen = sizeof(addr);
+    if (0 != getsockname(fd.get(), reinterpret_cast<sockaddr*>(&addr), &addrLen) ||
+        addr.ss_family != AF_UNIX) {
+        ALOGE("Shared memory requires a unix domain socket to pass the region");
+        return INVALID_OPERATION;
+    }
+
+    base::unique_fd memFd;
+    std::unique_ptr<RpcSharedMemory> sharedMemory = RpcSharedMemory::create(size, &memFd);
+    if (sharedMemory == nullptr) return NO_MEMORY;
+
+    struct stat st;
+    if (0 != fstat(memFd.get(), &st)) return -errno;
+
+    Parcel data;
+    data.markForRpc(session);
+    Parcel reply;
+    if (status_t status = data.writeUint64(st.st_size); status != OK) return status;
+
+    status_t status = transact(fd, RpcAddress::zero(), RPC_SPECIAL_TRANSACT_SETUP_SHARED_MEMORY,
+                               data, session, &reply, 0, memFd.get());
+    if (status != OK) {
+        ALOGE("Error setting up shared memory: %s", statusToString(status).c_str());
+        return status;
+    }
+
+    return installSharedMemory(std::move(sharedMemory));
+}
+
+status_t RpcState::acceptSharedMemory(base::unique_fd memFd, uint64_t size) {
+    std::unique_ptr<RpcSharedMemory> sharedMemory = RpcSharedMemory::accept(std::move(memFd), size);
+    if (sharedMemory == nullptr) return BAD_VALUE;
+    return installSharedMemory(std::move(sharedMemory));
+}
+
+status_t RpcState::installSharedMemory(std::unique_ptr<RpcSharedMemory> sharedMemory) {
+    std::lock_guard<std::mutex> _l(mNodeMutex);
+    if (mSharedMemoryOwner != nullptr) {
+        ALOGE("Shared memory was already set up for this session");
+        return INVALID_OPERATION;
+    }
+    mSharedMemoryOwner = std::move(sharedMemory);
+    mSharedMemory.store(mSharedMemoryOwner.get(), std::memory_order_release);
+    return OK;
+}
+
+std::vector<uint64_t> RpcState::outgoingSharedBlobs(const Parcel& parcel) {
+    RpcSharedMemory* shm = sharedMemory();
+    if (shm == nullptr) return {};
+    std::vector<uint64_t> offsets = shm->outgoingOffsets(&parcel);
+    shm->onSend(offsets);
+    return offsets;
+}
+
+status_t RpcState::takeSharedBlobs(uint32_t count, const uint8_t* data, size_t* dataSize,
+                                   std::vector<uint64_t>* outOffsets) {
+    if (count == 0) return OK;
+    if (count > *dataSize / sizeof(uint64_t)) {
+        ALOGE("Shared blob list (%" PRIu32 ") is larger than the data (%zu). Terminating!", count,
+              *dataSize);
+        terminate();
+        return BAD_VALUE;
+    }
+    *dataSize -= count * sizeof(uint64_t);
+    outOffsets->resize(count);
+    memcpy(outOffsets->data(), data + *dataSize, count * sizeof(uint64_t));
+    return OK;
+}
+
+status_t RpcState::recordSharedBlobs(const Parcel* parcel, const std::vector<uint64_t>& offsets) {
+    if (offsets.empty()) return OK;
+
+    RpcSharedMemory* shm = sharedMemory();
+    if (shm == nullptr) {
+        ALOGE("Received shared memory blobs without shared memory. Terminating!");
+        terminate();
+        return BAD_VALUE;
+    }
+    if (status_t status = shm->onReceive(parcel, offsets.data(), offsets.size()); status != OK) {
+        terminate();
+        return status;
+    }
+    return OK;
+}
+
 status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address, uint32_t code,
                             const Parcel& data, const sp<RpcSession>& session, Parcel* reply,
-                            uint32_t flags) {
+                            uint32_t flags, int ancillaryFd) {
     uint64_t asyncNumber = 0;
 
     if (!address.isZero()) {
@@ -347,28 +523,59 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
             .asyncNumber = asyncNumber,
     };
 
-    CommandData transactionData(sizeof(RpcWireTransaction) + data.dataSize());
-    if (!transactionData.valid()) {
+    // Sent without an intermediate copy, but the other side still has to
+    // allocate room for it.
+    if (data.dataSize() > CommandData::kMaxAllocation - sizeof(RpcWireTransaction)) {
+        ALOGE("Transaction size too big %zu", data.dataSize());
         return NO_MEMORY;
     }
 
-    memcpy(transactionData.data() + 0, &transaction, sizeof(RpcWireTransaction));
-    memcpy(transactionData.data() + sizeof(RpcWireTransaction), data.data(), data.dataSize());
-
-    if (transactionData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Transaction size too big %zu", transactionData.size());
-        return BAD_VALUE;
+    std::vector<uint64_t> blobs = outgoingSharedBlobs(data);
+    size_t blobsSize = blobs.size() * sizeof(uint64_t);
+    if (data.dataSize() + blobsSize > CommandData::kMaxAllocation - sizeof(RpcWireTransaction)) {
+        ALOGE("Transaction size too big %zu with %zu shared blobs", data.dataSize(), blobs.size());
+        if (!blobs.empty()) sharedMemory()->onSendFailed(blobs);
+        return NO_MEMORY;
+    }
+    transaction.sharedBlobCount = static_cast<uint32_t>(blobs.size());
+
+    const bool multiplexed = fd.get() == mMultiplexer.fd;
+    uint64_t requestId = 0;
+    if (multiplexed && !(flags & IBinder::FLAG_ONEWAY)) {
+        std::lock_guard<std::mutex> _l(mMultiplexer.mutex);
+        if (mMultiplexer.dead) {
+            if (!blobs.empty()) sharedMemory()->onSendFailed(blobs);
+            return DEAD_OBJECT;
+        }
+        requestId = mMultiplexer.nextRequestId++;
+        mMultiplexer.replies[requestId] = std::nullopt;
     }
 
     RpcWireHeader command{
             .command = RPC_COMMAND_TRANSACT,
-            .bodySize = static_cast<uint32_t>(transactionData.size()),
+            .bodySize = static_cast<uint32_t>(sizeof(RpcWireTransaction) + data.dataSize() +
+                                              blobsSize),
+            .requestId = requestId,
     };
-
-    if (!rpcSend(fd, "transact header", &command, sizeof(command))) {
-        return DEAD_OBJECT;
+    iovec iovs[]{
+            {&command, sizeof(command)},
+            {&transaction, sizeof(transaction)},
+            {const_cast<uint8_t*>(data.data()), data.dataSize()},
+            {blobs.data(), blobsSize},
+    };
+    bool sent;
+    if (multiplexed) {
+        std::lock_guard<std::mutex> _l(mMultiplexer.writeMutex);
+        sent = rpcSend(fd, "transaction", iovs, arraysize(iovs), ancillaryFd);
+    } else {
+        sent = rpcSend(fd, "transaction", iovs, arraysize(iovs), ancillaryFd);
     }
-    if (!rpcSend(fd, "command body", transactionData.data(), transactionData.size())) {
+    if (!sent) {
+        if (!blobs.empty()) sharedMemory()->onSendFailed(blobs);
+        if (requestId != 0) {
+            std::lock_guard<std::mutex> _l(mMultiplexer.mutex);
+            mMultiplexer.replies.erase(requestId);
+        }
         return DEAD_OBJECT;
     }
 
@@ -378,9 +585,17 @@ status_t RpcState::transact(const base::unique_fd& fd, const RpcAddress& address
 
     LOG_ALWAYS_FATAL_IF(reply == nullptr, "Reply parcel must be used for synchronous transaction.");
 
+    if (requestId != 0) {
+        return waitForMultiplexedReply(fd, session, reply, requestId);
+    }
     return waitForReply(fd, session, reply);
 }
 
+void RpcState::setMultiplexedFd(const base::unique_fd& fd) {
+    LOG_ALWAYS_FATAL_IF(mMultiplexer.fd != -1, "Only one connection may be multiplexed");
+    mMultiplexer.fd = fd.get();
+}
+
 static void cleanup_reply_data(Parcel* p, const uint8_t* data, size_t dataSize,
                                const binder_size_t* objects, size_t objectsCount) {
     (void)p;
@@ -400,7 +615,7 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
 
         if (command.command == RPC_COMMAND_REPLY) break;
 
-        status_t status = processServerCommand(fd, session, command);
+        status_t status = processServerCommand(fd, session, command, base::unique_fd());
         if (status != OK) return status;
     }
 
@@ -413,22 +628,98 @@ status_t RpcState::waitForReply(const base::unique_fd& fd, const sp<RpcSession>&
         return DEAD_OBJECT;
     }
 
-    if (command.bodySize < sizeof(RpcWireReply)) {
-        ALOGE("Expecting %zu but got %" PRId32 " bytes for RpcWireReply. Terminating!",
-              sizeof(RpcWireReply), command.bodySize);
+    return processReply(session, reply, std::move(data));
+}
+
+status_t RpcState::waitForMultiplexedReply(const base::unique_fd& fd,
+                                           const sp<RpcSession>& session, Parcel* reply,
+                                           uint64_t requestId) {
+    std::unique_lock<std::mutex> _l(mMultiplexer.mutex);
+    while (true) {
+        auto it = mMultiplexer.replies.find(requestId);
+        LOG_ALWAYS_FATAL_IF(it == mMultiplexer.replies.end(), "Lost request %" PRIu64, requestId);
+
+        if (it->second.has_value()) {
+            CommandData data = std::move(*it->second);
+            mMultiplexer.replies.erase(it);
+            _l.unlock();
+            return processReply(session, reply, std::move(data));
+        }
+        if (mMultiplexer.dead) {
+            mMultiplexer.replies.erase(it);
+            return DEAD_OBJECT;
+        }
+        if (mMultiplexer.reading) {
+            mMultiplexer.cv.wait(_l);
+            continue;
+        }
+
+        // nobody is reading, so this thread reads the next reply, whoever it
+        // belongs to
+        mMultiplexer.reading = true;
+        _l.unlock();
+
+        RpcWireHeader command;
+        std::optional<CommandData> data;
+        if (rpcRec(fd, "command header", &command, sizeof(command))) {
+            if (command.command != RPC_COMMAND_REPLY) {
+                // would need a thread to serve it
+                ALOGE("Unexpected command %d on multiplexed connection. Terminating!",
+                      command.command);
+                terminate();
+            } else if (data.emplace(command.bodySize); !data->valid() ||
+                       !rpcRec(fd, "reply body", data->data(), data->size())) {
+                data.reset();
+                terminate();
+            }
+        }
+
+        _l.lock();
+        mMultiplexer.reading = false;
+        auto replyIt = data.has_value() ? mMultiplexer.replies.find(command.requestId)
+                                        : mMultiplexer.replies.end();
+        if (replyIt != mMultiplexer.replies.end() && !replyIt->second.has_value()) {
+            replyIt->second = std::move(data);
+        } else {
+            if (data.has_value()) {
+                ALOGE("Reply for unknown request %" PRIu64 ". Terminating!", command.requestId);
+                terminate();
+            }
+            mMultiplexer.dead = true;
+        }
+        mMultiplexer.cv.notify_all();
+    }
+}
+
+status_t RpcState::processReply(const sp<RpcSession>& session, Parcel* reply, CommandData data) {
+    if (data.size() < sizeof(RpcWireReply)) {
+        ALOGE("Expecting %zu but got %zu bytes for RpcWireReply. Terminating!",
+              sizeof(RpcWireReply), data.size());
         terminate();
         return BAD_VALUE;
     }
     RpcWireReply* rpcReply = reinterpret_cast<RpcWireReply*>(data.data());
-    if (rpcReply->status != OK) return rpcReply->status;
+
+    size_t dataSize = data.size() - offsetof(RpcWireReply, data);
+    std::vector<uint64_t> blobs;
+    if (status_t status = takeSharedBlobs(rpcReply->sharedBlobCount, rpcReply->data, &dataSize,
+                                          &blobs);
+        status != OK) {
+        return status;
+    }
+
+    if (rpcReply->status != OK) {
+        // nobody will read the reply, release its blobs now
+        if (status_t status = recordSharedBlobs(nullptr, blobs); status != OK) return status;
+        return rpcReply->status;
+    }
 
     data.release();
-    reply->ipcSetDataReference(rpcReply->data, command.bodySize - offsetof(RpcWireReply, data),
-                               nullptr, 0, cleanup_reply_data);
+    reply->ipcSetDataReference(rpcReply->data, dataSize, nullptr, 0, cleanup_reply_data);
 
     reply->markForRpc(session);
 
-    return OK;
+    return recordSharedBlobs(reply, blobs);
 }
 
 status_t RpcState::sendDecStrong(const base::unique_fd& fd, const RpcAddress& addr) {
@@ -451,28 +742,35 @@ status_t RpcState::sendDecStrong(const base::unique_fd& fd, const RpcAddress& ad
             .command = RPC_COMMAND_DEC_STRONG,
             .bodySize = sizeof(RpcWireAddress),
     };
-    if (!rpcSend(fd, "dec ref header", &cmd, sizeof(cmd))) return DEAD_OBJECT;
-    if (!rpcSend(fd, "dec ref body", &addr.viewRawEmbedded(), sizeof(RpcWireAddress)))
-        return DEAD_OBJECT;
+    iovec iovs[]{
+            {&cmd, sizeof(cmd)},
+            {const_cast<RpcWireAddress*>(&addr.viewRawEmbedded()), sizeof(RpcWireAddress)},
+    };
+    std::unique_lock<std::mutex> _l;
+    if (fd.get() == mMultiplexer.fd) _l = std::unique_lock<std::mutex>(mMultiplexer.writeMutex);
+    if (!rpcSend(fd, "dec ref", iovs, arraysize(iovs))) return DEAD_OBJECT;
     return OK;
 }
 
 status_t RpcState::getAndExecuteCommand(const base::unique_fd& fd, const sp<RpcSession>& session) {
     LOG_RPC_DETAIL("getAndExecuteCommand on fd %d", fd.get());
 
+    // clients may send a shared memory region (RPC_SPECIAL_TRANSACT_SETUP_SHARED_MEMORY)
     RpcWireHeader command;
-    if (!rpcRec(fd, "command header", &command, sizeof(command))) {
+    base::unique_fd ancillaryFd;
+    if (!rpcRec(fd, "command header", &command, sizeof(command), &ancillaryFd)) {
         return DEAD_OBJECT;
     }
 
-    return processServerCommand(fd, session, command);
+    return processServerCommand(fd, session, command, std::move(ancillaryFd));
 }
 
 status_t RpcState::processServerCommand(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                        const RpcWireHeader& command) {
+                                        const RpcWireHeader& command,
+                                        base::unique_fd ancillaryFd) {
     switch (command.command) {
         case RPC_COMMAND_TRANSACT:
-            return processTransact(fd, session, command);
+            return processTransact(fd, session, command, std::move(ancillaryFd));
         case RPC_COMMAND_DEC_STRONG:
             return processDecStrong(fd, command);
     }
@@ -487,7 +785,7 @@ status_t RpcState::processServerCommand(const base::unique_fd& fd, const sp<RpcS
     return DEAD_OBJECT;
 }
 status_t RpcState::processTransact(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                   const RpcWireHeader& command) {
+                                   const RpcWireHeader& command, base::unique_fd ancillaryFd) {
     LOG_ALWAYS_FATAL_IF(command.command != RPC_COMMAND_TRANSACT, "command: %d", command.command);
 
     CommandData transactionData(command.bodySize);
@@ -498,7 +796,37 @@ status_t RpcState::processTransact(const base::unique_fd& fd, const sp<RpcSessio
         return DEAD_OBJECT;
     }
 
-    return processTransactInternal(fd, session, std::move(transactionData));
+    if (command.requestId != 0) {
+        // Multiplexed transactions are served concurrently, up to the server's
+        // thread count, so that a slow call doesn't hold up replies to the
+        // others. Beyond that, serve inline, which stops reading new commands
+        // until a thread frees up. Such calls can't be nested.
+        sp<RpcServer> server = session->server().promote();
+        size_t maxInFlight = server ? server->getMaxThreads() : 0;
+        base::unique_fd workerFd;
+        if (mMultiplexedInFlight.fetch_add(1) < maxInFlight) {
+            workerFd.reset(TEMP_FAILURE_RETRY(fcntl(fd.get(), F_DUPFD_CLOEXEC, 0)));
+        }
+        if (workerFd.ok()) {
+            std::thread([this, session, workerFd = std::move(workerFd),
+                         transactionData = std::move(transactionData),
+                         requestId = command.requestId,
+                         ancillaryFd = std::move(ancillaryFd)]() mutable {
+                status_t status =
+                        processTransactInternal(workerFd, session, std::move(transactionData),
+                                                requestId, std::move(ancillaryFd));
+                if (status != OK) {
+                    ALOGW("Multiplexed transaction failed: %s", statusToString(status).c_str());
+                }
+                mMultiplexedInFlight--;
+            }).detach();
+            return OK;
+        }
+        mMultiplexedInFlight--;
+    }
+
+    return processTransactInternal(fd, session, std::move(transactionData), command.requestId,
+                                   std::move(ancillaryFd));
 }
 
 static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t dataSize,
@@ -511,7 +839,8 @@ static void do_nothing_to_transact_data(Parcel* p, const uint8_t* data, size_t d
 }
 
 status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                           CommandData transactionData) {
+                                           CommandData transactionData, uint64_t requestId,
+                                           base::unique_fd ancillaryFd) {
     if (transactionData.size() < sizeof(RpcWireTransaction)) {
         ALOGE("Expecting %zu but got %zu bytes for RpcWireTransaction. Terminating!",
               sizeof(RpcWireTransaction), transactionData.size());
@@ -570,19 +899,29 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
         }
     }
 
+    size_t dataSize = transactionData.size() - offsetof(RpcWireTransaction, data);
+    std::vector<uint64_t> blobs;
+    if (status_t status =
+                takeSharedBlobs(transaction->sharedBlobCount, transaction->data, &dataSize, &blobs);
+        status != OK) {
+        return status;
+    }
+
     Parcel reply;
     reply.markForRpc(session);
 
-    if (replyStatus == OK) {
+    if (replyStatus != OK) {
+        // nobody will read the transaction, release its blobs now
+        if (status_t status = recordSharedBlobs(nullptr, blobs); status != OK) return status;
+    } else {
         Parcel data;
         // transaction->data is owned by this function. Parcel borrows this data and
         // only holds onto it for the duration of this function call. Parcel will be
         // deleted before the 'transactionData' object.
-        data.ipcSetDataReference(transaction->data,
-                                 transactionData.size() - offsetof(RpcWireTransaction, data),
-                                 nullptr /*object*/, 0 /*objectCount*/,
-                                 do_nothing_to_transact_data);
+        data.ipcSetDataReference(transaction->data, dataSize, nullptr /*object*/,
+                                 0 /*objectCount*/, do_nothing_to_transact_data);
         data.markForRpc(session);
+        if (status_t status = recordSharedBlobs(&data, blobs); status != OK) return status;
 
         if (target) {
             replyStatus = target->transact(transaction->code, data, &reply, transaction->flags);
@@ -611,6 +950,14 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
                         replyStatus = reply.writeInt32(id);
                         break;
                     }
+                    case RPC_SPECIAL_TRANSACT_SETUP_SHARED_MEMORY: {
+                        uint64_t size;
+                        replyStatus = data.readUint64(&size);
+                        if (replyStatus == OK) {
+                            replyStatus = acceptSharedMemory(std::move(ancillaryFd), size);
+                        }
+                        break;
+                    }
                     default: {
                         replyStatus = UNKNOWN_TRANSACTION;
                     }
@@ -665,38 +1012,44 @@ status_t RpcState::processTransactInternal(const base::unique_fd& fd, const sp<R
                         const_cast<BinderNode::AsyncTodo&>(it->second.asyncTodo.top()).data);
                 it->second.asyncTodo.pop();
                 _l.unlock();
-                return processTransactInternal(fd, session, std::move(data));
+                return processTransactInternal(fd, session, std::move(data), 0 /*requestId*/,
+                                               base::unique_fd());
             }
         }
         return OK;
     }
 
+    std::vector<uint64_t> replyBlobs = outgoingSharedBlobs(reply);
+    size_t replyBlobsSize = replyBlobs.size() * sizeof(uint64_t);
+
     RpcWireReply rpcReply{
             .status = replyStatus,
+            .sharedBlobCount = static_cast<uint32_t>(replyBlobs.size()),
     };
 
-    CommandData replyData(sizeof(RpcWireReply) + reply.dataSize());
-    if (!replyData.valid()) {
-        return NO_MEMORY;
-    }
-    memcpy(replyData.data() + 0, &rpcReply, sizeof(RpcWireReply));
-    memcpy(replyData.data() + sizeof(RpcWireReply), reply.data(), reply.dataSize());
-
-    if (replyData.size() > std::numeric_limits<uint32_t>::max()) {
-        ALOGE("Reply size too big %zu", transactionData.size());
+    if (reply.dataSize() + replyBlobsSize > CommandData::kMaxAllocation - sizeof(RpcWireReply)) {
+        ALOGE("Reply size too big %zu", reply.dataSize());
+        if (!replyBlobs.empty()) sharedMemory()->onSendFailed(replyBlobs);
         terminate();
-        return BAD_VALUE;
+        return NO_MEMORY;
     }
 
     RpcWireHeader cmdReply{
             .command = RPC_COMMAND_REPLY,
-            .bodySize = static_cast<uint32_t>(replyData.size()),
+            .bodySize = static_cast<uint32_t>(sizeof(RpcWireReply) + reply.dataSize() +
+                                              replyBlobsSize),
+            .requestId = requestId,
     };
-
-    if (!rpcSend(fd, "reply header", &cmdReply, sizeof(RpcWireHeader))) {
-        return DEAD_OBJECT;
-    }
-    if (!rpcSend(fd, "reply body", replyData.data(), replyData.size())) {
+    iovec iovs[]{
+            {&cmdReply, sizeof(cmdReply)},
+            {&rpcReply, sizeof(rpcReply)},
+            {const_cast<uint8_t*>(reply.data()), reply.dataSize()},
+            {replyBlobs.data(), replyBlobsSize},
+    };
+    std::unique_lock<std::mutex> _l;
+    if (requestId != 0) _l = std::unique_lock<std::mutex>(mMultiplexedReplyMutex);
+    if (!rpcSend(fd, "reply", iovs, arraysize(iovs))) {
+        if (!replyBlobs.empty()) sharedMemory()->onSendFailed(replyBlobs);
         return DEAD_OBJECT;
     }
     return OK;
@@ -20,12 +20,20 @@
 #include <binder/Parcel.h>
 #include <binder/RpcSession.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <queue>
+#include <vector>
+
+#include <sys/uio.h>
 
 namespace android {
 
+class RpcSharedMemory;
 struct RpcWireHeader;
 
 /**
@@ -57,10 +65,17 @@ public:
                            size_t* maxThreadsOut);
     status_t getSessionId(const base::unique_fd& fd, const sp<RpcSession>& session,
                           int32_t* sessionIdOut);
+    status_t setupSharedMemory(const base::unique_fd& fd, const sp<RpcSession>& session,
+                               size_t size);
 
+    /**
+     * If 'ancillaryFd' is set, it is sent along with the transaction (only
+     * supported on unix domain sockets).
+     */
     [[nodiscard]] status_t transact(const base::unique_fd& fd, const RpcAddress& address,
                                     uint32_t code, const Parcel& data,
-                                    const sp<RpcSession>& session, Parcel* reply, uint32_t flags);
+                                    const sp<RpcSession>& session, Parcel* reply, uint32_t flags,
+                                    int ancillaryFd = -1);
     [[nodiscard]] status_t sendDecStrong(const base::unique_fd& fd, const RpcAddress& address);
     [[nodiscard]] status_t getAndExecuteCommand(const base::unique_fd& fd,
                                                 const sp<RpcSession>& session);
@@ -82,6 +97,20 @@ public:
     size_t countBinders();
     void dump();
 
+    /**
+     * Makes all transactions sent on 'fd' (other than nested ones) go through
+     * the multiplexer: they may be sent concurrently by several threads, and
+     * synchronous ones are tagged with a request id so their replies can be
+     * matched up when they come back in any order.
+     */
+    void setMultiplexedFd(const base::unique_fd& fd);
+
+    /**
+     * Region negotiated with setupSharedMemory which large blobs are written
+     * into instead of the parcel, or null.
+     */
+    RpcSharedMemory* sharedMemory() { return mSharedMemory.load(std::memory_order_acquire); }
+
 private:
     /**
      * Called when reading or writing data to a session fails to clean up
@@ -104,6 +133,9 @@ private:
     // Alternative to std::vector<uint8_t> that doesn't abort on allocation failure and caps
     // large allocations to avoid being requested from allocating too much data.
     struct CommandData {
+        // Largest body that will be allocated for a single command.
+        static constexpr size_t kMaxAllocation = 100 * 1000;
+
         explicit CommandData(size_t size);
         bool valid() { return mSize == 0 || mData != nullptr; }
         size_t size() { return mSize; }
@@ -117,18 +149,43 @@ private:
 
     [[nodiscard]] bool rpcSend(const base::unique_fd& fd, const char* what, const void* data,
                                size_t size);
+    // Sends all of 'iovs' in order, as a single message where possible. 'iovs' is
+    // modified in case of partial sends.
+    [[nodiscard]] bool rpcSend(const base::unique_fd& fd, const char* what, iovec* iovs,
+                               size_t niovs, int ancillaryFd = -1);
     [[nodiscard]] bool rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size);
+    // Like rpcRec, but also takes an fd passed with SCM_RIGHTS, if there is one.
+    [[nodiscard]] bool rpcRec(const base::unique_fd& fd, const char* what, void* data, size_t size,
+                              base::unique_fd* outAncillaryFd);
+
+    // shared memory blobs are listed after the parcel data of a transaction or reply
+    std::vector<uint64_t> outgoingSharedBlobs(const Parcel& parcel);
+    [[nodiscard]] status_t takeSharedBlobs(uint32_t count, const uint8_t* data, size_t* dataSize,
+                                           std::vector<uint64_t>* outOffsets);
+    [[nodiscard]] status_t recordSharedBlobs(const Parcel* parcel,
+                                             const std::vector<uint64_t>& offsets);
+    status_t acceptSharedMemory(base::unique_fd memFd, uint64_t size);
+    status_t installSharedMemory(std::unique_ptr<RpcSharedMemory> sharedMemory);
 
     [[nodiscard]] status_t waitForReply(const base::unique_fd& fd, const sp<RpcSession>& session,
                                         Parcel* reply);
+    [[nodiscard]] status_t waitForMultiplexedReply(const base::unique_fd& fd,
+                                                   const sp<RpcSession>& session, Parcel* reply,
+                                                   uint64_t requestId);
+    [[nodiscard]] status_t processReply(const sp<RpcSession>& session, Parcel* reply,
+                                        CommandData data);
     [[nodiscard]] status_t processServerCommand(const base::unique_fd& fd,
                                                 const sp<RpcSession>& session,
-                                                const RpcWireHeader& command);
+                                                const RpcWireHeader& command,
+                                                base::unique_fd ancillaryFd);
     [[nodiscard]] status_t processTransact(const base::unique_fd& fd, const sp<RpcSession>& session,
-                                           const RpcWireHeader& command);
+                                           const RpcWireHeader& command,
+                                           base::unique_fd ancillaryFd);
     [[nodiscard]] status_t processTransactInternal(const base::unique_fd& fd,
                                                    const sp<RpcSession>& session,
-                                                   CommandData transactionData);
+                                                   CommandData transactionData,
+                                                   uint64_t requestId,
+                                                   base::unique_fd ancillaryFd);
     [[nodiscard]] status_t processDecStrong(const base::unique_fd& fd,
                                             const RpcWireHeader& command);
 
@@ -179,6 +236,31 @@ private:
         // (no additional data specific to remote binders)
     };
 
+    // Client side of a multiplexed connection, see setMultiplexedFd
+    struct Multiplexer {
+        int fd = -1;
+        std::mutex writeMutex; // held while a whole command is being sent
+
+        std::mutex mutex; // for all below
+        std::condition_variable cv;
+        uint64_t nextRequestId = 1;
+        // whether one of the waiting threads is currently reading from fd
+        bool reading = false;
+        bool dead = false;
+        // replies read, but not yet claimed by the thread waiting for them
+        std::map<uint64_t, std::optional<CommandData>> replies;
+    };
+    Multiplexer mMultiplexer;
+
+    // Server side, replies to multiplexed transactions are sent from several
+    // threads, see processTransact.
+    std::mutex mMultiplexedReplyMutex;
+    std::atomic<size_t> mMultiplexedInFlight = 0;
+
+    // set once, by setupSharedMemory or when the client's region is accepted
+    std::unique_ptr<RpcSharedMemory> mSharedMemoryOwner;
+    std::atomic<RpcSharedMemory*> mSharedMemory = nullptr;
+
     std::mutex mNodeMutex;
     bool mTerminated = false;
     // binders known by both sides of a session
@@ -49,6 +49,12 @@ enum : uint32_t {
     RPC_SPECIAL_TRANSACT_GET_ROOT = 0,
     RPC_SPECIAL_TRANSACT_GET_MAX_THREADS = 1,
     RPC_SPECIAL_TRANSACT_GET_SESSION_ID = 2,
+    /**
+     * Carries a memfd (SCM_RIGHTS) for RpcSharedMemory, and its size as a
+     * uint64_t. Servers which don't support it drop the fd and reply
+     * UNKNOWN_TRANSACTION.
+     */
+    RPC_SPECIAL_TRANSACT_SETUP_SHARED_MEMORY = 3,
 };
 
 constexpr int32_t RPC_SESSION_ID_NEW = -1;
@@ -60,7 +66,10 @@ struct RpcWireHeader {
     uint32_t command; // RPC_COMMAND_*
     uint32_t bodySize;
 
-    uint32_t reserved[2];
+    // Non-zero for synchronous transactions sent over a multiplexed
+    // connection. The RPC_COMMAND_REPLY for such a transaction carries the
+    // same id, and replies may come back in any order.
+    uint64_t requestId;
 };
 
 struct RpcWireAddress {
@@ -74,13 +83,16 @@ struct RpcWireTransaction {
 
     uint64_t asyncNumber;
 
-    uint32_t reserved[4];
+    // number of uint64_t shared memory blob offsets following the parcel data
+    uint32_t sharedBlobCount;
+    uint32_t reserved[3];
 
     uint8_t data[0];
 };
 
 struct RpcWireReply {
     int32_t status; // transact return
+    uint32_t sharedBlobCount; // as in RpcWireTransaction
     uint8_t data[0];
 };
 
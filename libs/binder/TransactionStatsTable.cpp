@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TransactionStatsTable.h"
+
+namespace android {
+
+size_t TransactionStatsTable::latencyBucket(nsecs_t latencyNs) {
+    uint64_t latencyUs = latencyNs > 0 ? static_cast<uint64_t>(latencyNs) / 1000 : 0;
+    if (latencyUs == 0) return 0;
+
+    size_t bucket = 63 - __builtin_clzll(latencyUs);
+    if (bucket >= BinderTransactionStats::kNumLatencyBuckets) {
+        bucket = BinderTransactionStats::kNumLatencyBuckets - 1;
+    }
+    return bucket;
+}
+
+TransactionStatsTable::Slot* TransactionStatsTable::findOrClaim(uint32_t code) {
+    if (code == 0) return nullptr;
+
+    // AIDL codes are small and sequential, so they rarely collide, but fold in
+    // the high bytes for B_PACK_CHARS codes
+    size_t index = code ^ (code >> 8) ^ (code >> 16) ^ (code >> 24);
+    for (size_t i = 0; i < kNumSlots; i++) {
+        Slot* slot = &mSlots[(index + i) & (kNumSlots - 1)];
+
+        uint32_t current = slot->code.load(std::memory_order_acquire);
+        if (current == 0) {
+            // on failure, current is the code another thread just claimed
+            if (slot->code.compare_exchange_strong(current, code, std::memory_order_acq_rel)) {
+                return slot;
+            }
+        }
+        if (current == code) return slot;
+    }
+
+    // full, more codes than this binder should have
+    return nullptr;
+}
+
+void TransactionStatsTable::record(uint32_t code, size_t dataBytes, size_t replyBytes,
+                                   nsecs_t latencyNs) {
+    Slot* slot = findOrClaim(code);
+    if (slot == nullptr) return;
+
+    slot->count.fetch_add(1, std::memory_order_relaxed);
+    slot->dataBytes.fetch_add(dataBytes, std::memory_order_relaxed);
+    slot->replyBytes.fetch_add(replyBytes, std::memory_order_relaxed);
+    slot->latencyBuckets[latencyBucket(latencyNs)].fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<BinderTransactionStats> TransactionStatsTable::snapshot() const {
+    std::vector<BinderTransactionStats> ret;
+    for (const Slot& slot : mSlots) {
+        uint32_t code = slot.code.load(std::memory_order_acquire);
+        if (code == 0) continue;
+
+        BinderTransactionStats stats;
+        stats.code = code;
+        stats.count = slot.count.load(std::memory_order_relaxed);
+        stats.dataBytes = slot.dataBytes.load(std::memory_order_relaxed);
+        stats.replyBytes = slot.replyBytes.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < BinderTransactionStats::kNumLatencyBuckets; i++) {
+            stats.latencyBuckets[i] = slot.latencyBuckets[i].load(std::memory_order_relaxed);
+        }
+        ret.push_back(stats);
+    }
+    return ret;
+}
+
+} // namespace android
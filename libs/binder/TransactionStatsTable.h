@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <binder/BinderStats.h>
+#include <utils/Timers.h>
+
+#include <atomic>
+#include <vector>
+
+namespace android {
+
+/**
+ * Per-code transaction counters of a single BBinder.
+ *
+ * Slots are claimed with an atomic compare-and-swap and only incremented
+ * after that, so recording never takes a lock. Readers aggregate whatever has
+ * been recorded so far.
+ */
+class TransactionStatsTable {
+public:
+    void record(uint32_t code, size_t dataBytes, size_t replyBytes, nsecs_t latencyNs);
+    std::vector<BinderTransactionStats> snapshot() const;
+
+    static size_t latencyBucket(nsecs_t latencyNs);
+
+private:
+    // open addressing, must be a power of two
+    static constexpr size_t kNumSlots = 64;
+
+    struct Slot {
+        // 0 is free, it is never used as a transaction code
+        std::atomic<uint32_t> code{0};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> dataBytes{0};
+        std::atomic<uint64_t> replyBytes{0};
+        std::atomic<uint64_t> latencyBuckets[BinderTransactionStats::kNumLatencyBuckets] = {};
+    };
+
+    Slot* findOrClaim(uint32_t code);
+
+    Slot mSlots[kNumSlots];
+};
+
+} // namespace android
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TransactionTrace"
+
+#include <binder/TransactionTrace.h>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#ifdef __GLIBC__
+extern "C" pid_t gettid();
+#endif
+
+namespace android {
+
+namespace {
+
+// Per thread, a power of two. An event is about 50 bytes.
+constexpr uint64_t kEventsPerThread = 128;
+
+std::atomic<bool> gEnabled = true;
+
+/**
+ * The ring of one thread. It is a sequence lock per slot: the owning thread
+ * is the only writer and never waits, and drain() discards any slot which was
+ * overwritten while it was being copied.
+ */
+class ThreadBuffer {
+public:
+    explicit ThreadBuffer(pid_t tid) : mTid(tid) {}
+
+    // Only called by the owning thread.
+    void push(const BinderTransactionEvent& event) {
+        uint64_t index = mHead.load(std::memory_order_relaxed);
+        Slot& slot = mSlots[index % kEventsPerThread];
+        slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.event = event;
+        slot.event.tid = mTid;
+        slot.seq.store(2 * index + 2, std::memory_order_release);
+        mHead.store(index + 1, std::memory_order_release);
+    }
+
+    // Called with gRegistryLock held.
+    void drain(std::vector<BinderTransactionEvent>* events) {
+        uint64_t head = mHead.load(std::memory_order_acquire);
+        uint64_t index = head > kEventsPerThread ? std::max(mTail, head - kEventsPerThread) : mTail;
+        for (; index < head; index++) {
+            const Slot& slot = mSlots[index % kEventsPerThread];
+            uint64_t before = slot.seq.load(std::memory_order_acquire);
+            BinderTransactionEvent event = slot.event;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = slot.seq.load(std::memory_order_relaxed);
+            if (before != 2 * index + 2 || after != before) continue;
+            events->push_back(event);
+        }
+        mTail = head;
+    }
+
+private:
+    struct Slot {
+        // 2 * index + 1 while event is being written, 2 * index + 2 after
+        std::atomic<uint64_t> seq{0};
+        BinderTransactionEvent event;
+    };
+
+    const pid_t mTid;
+    std::atomic<uint64_t> mHead{0};
+    uint64_t mTail = 0;
+    Slot mSlots[kEventsPerThread];
+};
+
+// Never destroyed: threads may still be recording while the process exits.
+std::mutex& registryLock() {
+    static std::mutex* lock = new std::mutex;
+    return *lock;
+}
+
+std::vector<std::shared_ptr<ThreadBuffer>>& registry() {
+    static auto* buffers = new std::vector<std::shared_ptr<ThreadBuffer>>;
+    return *buffers;
+}
+
+std::mutex& descriptorLock() {
+    static std::mutex* lock = new std::mutex;
+    return *lock;
+}
+
+std::unordered_map<uint32_t, String16>& descriptors() {
+    static auto* descriptors = new std::unordered_map<uint32_t, String16>;
+    return *descriptors;
+}
+
+ThreadBuffer* threadBuffer() {
+    // The registry keeps the buffer alive after the thread exits, until it has been drained.
+    thread_local std::shared_ptr<ThreadBuffer> buffer = [] {
+        auto buffer = std::make_shared<ThreadBuffer>(gettid());
+        std::lock_guard<std::mutex> lock(registryLock());
+        registry().push_back(buffer);
+        return buffer;
+    }();
+    return buffer.get();
+}
+
+uint32_t hashDescriptor(const String16& descriptor) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    const char16_t* chars = descriptor.string();
+    for (size_t i = 0; i < descriptor.size(); i++) {
+        hash = (hash ^ chars[i]) * 16777619u;
+    }
+    return hash == 0 ? 1 : hash;
+}
+
+} // namespace
+
+void TransactionTrace::setEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionTrace::isEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+void TransactionTrace::drain(std::vector<BinderTransactionEvent>* events) {
+    std::lock_guard<std::mutex> lock(registryLock());
+    auto& buffers = registry();
+    for (const auto& buffer : buffers) {
+        buffer->drain(events);
+    }
+    // Buffers only referenced by the registry belong to threads which have exited.
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                 [](const auto& buffer) { return buffer.use_count() == 1; }),
+                  buffers.end());
+}
+
+String16 TransactionTrace::getDescriptor(uint32_t descriptorId) {
+    std::lock_guard<std::mutex> lock(descriptorLock());
+    auto it = descriptors().find(descriptorId);
+    return it == descriptors().end() ? String16() : it->second;
+}
+
+uint32_t TransactionTrace::internDescriptor(const String16& descriptor) {
+    if (descriptor.size() == 0) return 0;
+
+    // Threads mostly serve the same interface over and over, and descriptors
+    // are usually static, so avoid hashing the same string again.
+    thread_local const char16_t* lastChars = nullptr;
+    thread_local size_t lastSize = 0;
+    thread_local uint32_t lastId = 0;
+    if (descriptor.string() == lastChars && descriptor.size() == lastSize) return lastId;
+
+    uint32_t id = hashDescriptor(descriptor);
+    {
+        std::lock_guard<std::mutex> lock(descriptorLock());
+        descriptors().emplace(id, descriptor);
+    }
+    lastChars = descriptor.string();
+    lastSize = descriptor.size();
+    lastId = id;
+    return id;
+}
+
+void TransactionTrace::record(const BinderTransactionEvent& event) {
+    threadBuffer()->push(event);
+}
+
+} // namespace android
@@ -18,6 +18,7 @@
 
 #include <atomic>
 #include <stdint.h>
+#include <vector>
 #include <binder/IBinder.h>
 
 // ---------------------------------------------------------------------------
@@ -94,6 +95,13 @@ public:
 
     pid_t               getDebugPid();
 
+    // Record per-code transaction counts, sizes and latencies for all
+    // BBinders in this process. This costs a branch per transaction while
+    // disabled, which is the default. See IBinder::getDebugTransactionStats
+    // and 'dumpsys --binder-stats'.
+    static void         setTransactionStatsEnabled(bool enabled);
+    std::vector<BinderTransactionStats> getTransactionStats();
+
 protected:
     virtual             ~BBinder();
 
@@ -111,6 +119,11 @@ private:
 
     Extras*             getOrCreateExtras();
 
+    status_t            transactInternal(uint32_t code, const Parcel& data, Parcel* reply,
+                                         uint32_t flags);
+    status_t            transactAndRecordStats(uint32_t code, const Parcel& data,
+                                               Parcel* reply, uint32_t flags);
+
     std::atomic<Extras*> mExtras;
 
     friend ::android::internal::Stability;
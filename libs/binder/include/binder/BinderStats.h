@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Counters for one transaction code of a BBinder, recorded while
+ * BBinder::setTransactionStatsEnabled(true) is in effect.
+ */
+struct BinderTransactionStats {
+    static constexpr size_t kNumLatencyBuckets = 24;
+
+    uint32_t code = 0;
+    uint64_t count = 0;
+    uint64_t dataBytes = 0;
+    uint64_t replyBytes = 0;
+    // Bucket i counts calls which took [2^i, 2^(i+1)) microseconds. Bucket 0
+    // also counts faster calls, and the last bucket also counts slower ones.
+    uint64_t latencyBuckets[kNumLatencyBuckets] = {};
+};
+
+} // namespace android
@@ -22,6 +22,7 @@
 #include <utils/Mutex.h>
 #include <utils/threads.h>
 
+#include <atomic>
 #include <unordered_map>
 #include <variant>
 
@@ -117,7 +118,7 @@ public:
             IBinder::object_cleanup_func func;
         };
 
-        KeyedVector<const void*, entry_t> mObjects;
+        std::unordered_map<const void*, entry_t> mObjects;
     };
 
     class PrivateAccessorForId {
@@ -189,13 +190,11 @@ private:
     mutable String16            mDescriptorCache;
             int32_t             mTrackedUid;
 
-    static Mutex                                sTrackingLock;
-    static std::unordered_map<int32_t,uint32_t> sTrackingMap;
     static int                                  sNumTrackedUids;
     static std::atomic_bool                     sCountByUidEnabled;
-    static binder_proxy_limit_callback          sLimitCallback;
-    static uint32_t                             sBinderProxyCountHighWatermark;
-    static uint32_t                             sBinderProxyCountLowWatermark;
+    static std::atomic<binder_proxy_limit_callback> sLimitCallback;
+    static std::atomic<uint32_t>                sBinderProxyCountHighWatermark;
+    static std::atomic<uint32_t>                sBinderProxyCountLowWatermark;
     static bool                                 sBinderProxyThrottleCreate;
 };
 
@@ -22,6 +22,8 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <vector>
+
 // linux/binder.h defines this, but we don't want to include it here in order to
 // avoid exporting the kernel headers
 #ifndef B_PACK_CHARS
@@ -33,6 +35,7 @@
 namespace android {
 
 class BBinder;
+struct BinderTransactionStats;
 class BpBinder;
 class IInterface;
 class Parcel;
@@ -60,6 +63,8 @@ public:
         SYSPROPS_TRANSACTION = B_PACK_CHARS('_', 'S', 'P', 'R'),
         EXTENSION_TRANSACTION = B_PACK_CHARS('_', 'E', 'X', 'T'),
         DEBUG_PID_TRANSACTION = B_PACK_CHARS('_', 'P', 'I', 'D'),
+        DEBUG_PARCEL_POOL_TRANSACTION = B_PACK_CHARS('_', 'P', 'P', 'L'),
+        DEBUG_TRANSACTION_STATS_TRANSACTION = B_PACK_CHARS('_', 'S', 'T', 'A'),
 
         // See android.os.IBinder.TWEET_TRANSACTION
         // Most importantly, messages can be anything not exceeding 130 UTF-8
@@ -152,6 +157,20 @@ public:
      */
     status_t                getDebugPid(pid_t* outPid);
 
+    /**
+     * Dump Parcel buffer pool hit/miss counters of the process hosting a
+     * binder, for debugging. See ProcessState::setParcelBufferPoolEnabled.
+     */
+    status_t                getDebugParcelPoolStats(uint64_t* outHits, uint64_t* outMisses,
+                                                    uint64_t* outCachedBytes);
+
+    /**
+     * Dump per-code transaction stats of a binder, for debugging. Empty unless
+     * the hosting process called BBinder::setTransactionStatsEnabled(true).
+     */
+    status_t                getDebugTransactionStats(
+                                    std::vector<BinderTransactionStats>* outStats);
+
     // NOLINTNEXTLINE(google-default-arguments)
     virtual status_t        transact(   uint32_t code,
                                         const Parcel& data,
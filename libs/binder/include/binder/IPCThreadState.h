@@ -28,6 +28,8 @@ typedef  int  uid_t;
 // ---------------------------------------------------------------------------
 namespace android {
 
+class ParcelBufferPool;
+
 class IPCThreadState
 {
 public:
@@ -119,6 +121,17 @@ public:
             void                flushCommands();
             bool                flushIfNeeded();
 
+            // Oneway transactions made between beginOnewayBatch() and the matching
+            // endOnewayBatch() are queued in the out buffer and written to the driver
+            // together when the outermost batch ends, before the next blocking call, or
+            // when too many are pending. Scopes nest. Errors of batched transactions are
+            // reported by the call which flushes them.
+            void                beginOnewayBatch();
+            status_t            endOnewayBatch();
+            // Writes any queued oneway transactions and waits for the driver to accept them.
+            // Returns the first error encountered.
+            status_t            flushOnewayBatch();
+
             void                joinThreadPool(bool isMain = true);
             
             // Stop the local process.
@@ -149,6 +162,11 @@ public:
     static  void                disableBackgroundScheduling(bool disable);
             bool                backgroundSchedulingDisabled();
 
+    // Call this to batch oneway transactions made while serving an incoming
+    // binder call, as if the call were wrapped in beginOnewayBatch() and
+    // endOnewayBatch(). Useful for services fanning out to many listeners.
+    static  void                enableAutoOnewayBatching(bool enable);
+
             // Call blocks until the number of executing binder threads is less than
             // the maximum number of binder threads threads allowed for this process.
             void                blockUntilThreadAvailable();
@@ -170,6 +188,9 @@ public:
             // side.
             static const int32_t kUnsetWorkSource = -1;
 private:
+    friend class ParcelBufferPool;
+    friend class PoolThread;
+
                                 IPCThreadState();
                                 ~IPCThreadState();
 
@@ -184,6 +205,11 @@ private:
                                                      const Parcel& data,
                                                      status_t* statusBuffer);
             status_t            getAndExecuteCommand();
+            // Like joinThreadPool(false), but for threads spawned by an adaptive
+            // thread pool, which return once idle and no longer needed.
+            void                joinThreadPoolUntilIdle();
+            void                joinThreadPoolInternal(bool isMain, bool canRetire);
+            bool                waitForWorkOrRetire();
             status_t            executeCommand(int32_t command);
             void                processPendingDerefs();
             void                processPostWriteDerefs();
@@ -196,6 +222,8 @@ private:
                                            const binder_size_t* objects, size_t objectsSize);
 
     const   sp<ProcessState>    mProcess;
+            // Must outlive mIn and mOut, whose buffers may come from it.
+            ParcelBufferPool*   mParcelBufferPool;
             Vector<BBinder*>    mPendingStrongDerefs;
             Vector<RefBase::weakref_type*> mPendingWeakDerefs;
             Vector<RefBase*>    mPostWriteStrongDerefs;
@@ -214,6 +242,8 @@ private:
             bool                mPropagateWorkSource;
             bool                mIsLooper;
             bool mIsFlushing;
+            size_t              mOnewayBatchDepth;
+            size_t              mPendingOnewayCount;
             int32_t             mStrictModePolicy;
             int32_t             mLastTransactionBinderFlags;
             CallRestriction     mCallRestriction;
@@ -119,6 +119,17 @@ sp<IServiceManager> defaultServiceManager();
  */
 void setDefaultServiceManager(const sp<IServiceManager>& sm);
 
+/**
+ * Remember the services returned by defaultServiceManager()->checkService()
+ * and getService(), so that repeated lookups don't go to servicemanager.
+ * Entries are dropped when the service dies, and replaced when it registers
+ * again, which relies on this process having a started binder threadpool.
+ *
+ * Cached services are kept referenced, so lazy services found this way won't
+ * shut down.
+ */
+void setServiceHandleCacheEnabled(bool enabled);
+
 template<typename INTERFACE>
 sp<INTERFACE> waitForService(const String16& name) {
     const sp<IServiceManager> sm = defaultServiceManager();
@@ -93,6 +93,14 @@ class LazyServiceRegistrar {
       */
      void reRegister();
 
+     /**
+      * Ask servicemanager to start service 'name' whenever 'trigger' is looked up, so
+      * that clients which typically use both services do not wait for this process to
+      * cold start. The hint outlives this process, so it only needs to be registered
+      * once per boot (e.g. right after 'registerService').
+      */
+     status_t registerPrewarmHint(const std::string& name, const std::string& trigger);
+
    private:
      std::shared_ptr<internal::ClientCounterCallback> mClientCC;
      LazyServiceRegistrar();
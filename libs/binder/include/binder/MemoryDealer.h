@@ -25,15 +25,25 @@
 namespace android {
 // ----------------------------------------------------------------------------
 
-class SimpleBestFitAllocator;
+class MemoryDealerAllocator;
 
 // ----------------------------------------------------------------------------
 
 class MemoryDealer : public RefBase
 {
 public:
+    enum class AllocatorType {
+        // One address-ordered list of chunks, searched for the best fit. Compact,
+        // but allocate and deallocate walk the whole list.
+        BEST_FIT,
+        // Free chunks are also kept in lists per power-of-two size class, so
+        // allocate and deallocate are O(1) in the typical case.
+        SEGREGATED_FIT,
+    };
+
     explicit MemoryDealer(size_t size, const char* name = nullptr,
             uint32_t flags = 0 /* or bits such as MemoryHeapBase::READ_ONLY */ );
+    MemoryDealer(size_t size, const char* name, uint32_t flags, AllocatorType allocatorType);
 
     virtual sp<IMemory> allocate(size_t size);
     virtual void        deallocate(size_t offset);
@@ -49,10 +59,10 @@ protected:
 
 private:
     const sp<IMemoryHeap>&      heap() const;
-    SimpleBestFitAllocator*     allocator() const;
+    MemoryDealerAllocator*      allocator() const;
 
     sp<IMemoryHeap>             mHeap;
-    SimpleBestFitAllocator*     mAllocator;
+    MemoryDealerAllocator*      mAllocator;
 };
 
 
@@ -18,6 +18,7 @@
 
 #include <map> // for legacy reasons
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -305,7 +306,9 @@ public:
 
     // Writes a blob to the parcel.
     // If the blob is small, then it is stored in-place, otherwise it is
-    // transferred by way of an anonymous shared memory region.  Prefer sending
+    // transferred by way of an anonymous shared memory region (for RPC binder,
+    // the session's shared memory if RpcSession::setupSharedMemory was
+    // called, and in-place otherwise).  Prefer sending
     // immutable blobs if possible since they may be subsequently transferred between
     // processes without further copying whereas mutable blobs always need to be copied.
     // The caller should call release() on the blob after writing its contents.
@@ -358,6 +361,14 @@ public:
     status_t            readString16(std::optional<String16>* pArg) const;
     status_t            readString16(std::unique_ptr<String16>* pArg) const __attribute__((deprecated("use std::optional version instead")));
     const char16_t*     readString16Inplace(size_t* outLen) const;
+
+    // Views of a string in the Parcel's data, without copying it. They are
+    // only valid until the Parcel is freed or its data is changed. There is
+    // no UTF-8 view of a UTF-16 string, since that needs a conversion.
+    status_t            readString8View(std::string_view* str) const;
+    status_t            readString8View(std::optional<std::string_view>* str) const;
+    status_t            readString16View(std::u16string_view* str) const;
+    status_t            readString16View(std::optional<std::u16string_view>* str) const;
     sp<IBinder>         readStrongBinder() const;
     status_t            readStrongBinder(sp<IBinder>* val) const;
     status_t            readNullableStrongBinder(sp<IBinder>* val) const;
@@ -519,6 +530,11 @@ public:
     // Debugging: get metrics on current allocations.
     static size_t       getGlobalAllocSize();
     static size_t       getGlobalAllocCount();
+    // Debugging: get metrics on the per-thread buffer pools enabled by
+    // ProcessState::setParcelBufferPoolEnabled.
+    static size_t       getGlobalBufferPoolHits();
+    static size_t       getGlobalBufferPoolMisses();
+    static size_t       getGlobalBufferPoolCachedBytes();
 
     bool                replaceCallingWorkSourceUid(uid_t uid);
     // Returns the work source provided by the caller. This can only be trusted for trusted calling
@@ -21,6 +21,10 @@
 #include <stdint.h>
 #include <unistd.h>
 
+#include <atomic>
+
+#include <utils/Mutex.h>
+#include <utils/RWLock.h>
 #include <utils/String16.h>
 #include <utils/Singleton.h>
 #include <utils/SortedVector.h>
@@ -29,16 +33,11 @@ namespace android {
 // ---------------------------------------------------------------------------
 
 /*
- * PermissionCache caches permission checks for a given uid.
- *
- * Currently the cache is not updated when there is a permission change,
- * for instance when an application is uninstalled.
- *
- * IMPORTANT: for the reason stated above, only system permissions are safe
- * to cache. This restriction may be lifted at a later time.
- *
+ * PermissionCache caches permission check results per uid. Checks happen on
+ * many binder threads at once, so entries are split into shards by uid: a
+ * lookup only takes the reader side of its shard's lock, and a miss for one
+ * uid never blocks hits for uids in other shards.
  */
-
 class PermissionCache : Singleton<PermissionCache> {
     struct Entry {
         String16    name;
@@ -48,22 +47,44 @@ class PermissionCache : Singleton<PermissionCache> {
             return (uid == e.uid) ? (name < e.name) : (uid < e.uid);
         }
     };
-    mutable Mutex mLock;
+
+    static constexpr size_t kNumShards = 16;
+    struct Shard {
+        mutable RWLock lock;
+        // this is our cache per say. it stores pooled names.
+        SortedVector< Entry > entries;
+    };
+    Shard mShards[kNumShards];
+
+    Shard& shardFor(uid_t uid) { return mShards[uid % kNumShards]; }
+    const Shard& shardFor(uid_t uid) const { return mShards[uid % kNumShards]; }
+
     // we pool all the permission names we see, as many permissions checks
-    // will have identical names
+    // will have identical names. Only touched when caching a new result.
+    Mutex mPoolLock;
     SortedVector< String16 > mPermissionNamesPool;
-    // this is our cache per say. it stores pooled names.
-    SortedVector< Entry > mCache;
+
+    mutable std::atomic<uint64_t> mHits{0};
+    mutable std::atomic<uint64_t> mMisses{0};
 
     // free the whole cache, but keep the permission name pool
     void purge();
 
+    // free the cached results for a single uid
+    void purge(uid_t uid);
+
     status_t check(bool* granted,
             const String16& permission, uid_t uid) const;
 
     void cache(const String16& permission, uid_t uid, bool granted);
 
 public:
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+    };
+
     PermissionCache();
 
     static bool checkCallingPermission(const String16& permission);
@@ -75,6 +96,17 @@ public:
             pid_t pid, uid_t uid);
 
     static void purgeCache();
+
+    /*
+     * Drop the cached results for 'uid'. Permission changes in the
+     * permission controller are not pushed to native processes, so services
+     * that observe uid changes (e.g. an IUidObserver registered for
+     * UID_OBSERVER_GONE, since revoking a permission kills the uid's
+     * processes) should call this instead of purging the whole cache.
+     */
+    static void purgeCache(uid_t uid);
+
+    static Stats getStats();
 };
 
 // ---------------------------------------------------------------------------
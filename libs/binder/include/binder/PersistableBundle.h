@@ -17,6 +17,8 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <vector>
 
@@ -41,6 +43,15 @@ public:
     status_t writeToParcel(Parcel* parcel) const override;
     status_t readFromParcel(const Parcel* parcel) override;
 
+    /*
+     * Enables lazy unparceling for bundles subsequently read by this process.
+     * When enabled, readFromParcel() only indexes the keys of a bundle and
+     * keeps a copy of its raw bytes; each value is decoded the first time it
+     * is read through a getter. A bundle that is not modified after being read
+     * is written out again from the original bytes without being re-encoded.
+     */
+    static void setLazyUnparcelingEnabled(bool enabled);
+
     bool empty() const;
     size_t size() const;
     size_t erase(const String16& key);
@@ -93,6 +104,8 @@ public:
     std::set<String16> getPersistableBundleKeys() const;
 
     friend bool operator==(const PersistableBundle& lhs, const PersistableBundle& rhs) {
+        lhs.unparcelAll();
+        rhs.unparcelAll();
         return (lhs.mBoolMap == rhs.mBoolMap && lhs.mIntMap == rhs.mIntMap &&
                 lhs.mLongMap == rhs.mLongMap && lhs.mDoubleMap == rhs.mDoubleMap &&
                 lhs.mStringMap == rhs.mStringMap && lhs.mBoolVectorMap == rhs.mBoolVectorMap &&
@@ -110,18 +123,41 @@ public:
 private:
     status_t writeToParcelInner(Parcel* parcel) const;
     status_t readFromParcelInner(const Parcel* parcel, size_t length);
-
-    std::map<String16, bool> mBoolMap;
-    std::map<String16, int32_t> mIntMap;
-    std::map<String16, int64_t> mLongMap;
-    std::map<String16, double> mDoubleMap;
-    std::map<String16, String16> mStringMap;
-    std::map<String16, std::vector<bool>> mBoolVectorMap;
-    std::map<String16, std::vector<int32_t>> mIntVectorMap;
-    std::map<String16, std::vector<int64_t>> mLongVectorMap;
-    std::map<String16, std::vector<double>> mDoubleVectorMap;
-    std::map<String16, std::vector<String16>> mStringVectorMap;
-    std::map<String16, PersistableBundle> mPersistableBundleMap;
+    status_t readFromParcelLazy(const Parcel* parcel, size_t length);
+    status_t readValue(const Parcel* parcel, const String16& key, int32_t type) const;
+
+    // Decodes |key| if it is still pending and has the given value type. The
+    // returned lock must be held while the maps are accessed.
+    std::unique_lock<std::mutex> unparcelKey(const String16& key, int32_t type) const;
+    std::unique_lock<std::mutex> lockLazy() const;
+    void discardValue(const String16& key) const;
+    void unparcelAll() const;
+    // Decodes everything and drops the raw bytes, before the bundle is modified.
+    void unparcelForWrite();
+
+    struct LazyState;
+    struct PendingValue {
+        int32_t type;
+        size_t offset;  // of the value within LazyState::parcel
+    };
+
+    // Raw bytes of a lazily read bundle, shared between copies. Only set while
+    // the bundle is unmodified.
+    std::shared_ptr<LazyState> mLazy;
+    // Keys of a lazily read bundle that have not been decoded yet.
+    mutable std::map<String16, PendingValue> mPending;
+
+    mutable std::map<String16, bool> mBoolMap;
+    mutable std::map<String16, int32_t> mIntMap;
+    mutable std::map<String16, int64_t> mLongMap;
+    mutable std::map<String16, double> mDoubleMap;
+    mutable std::map<String16, String16> mStringMap;
+    mutable std::map<String16, std::vector<bool>> mBoolVectorMap;
+    mutable std::map<String16, std::vector<int32_t>> mIntVectorMap;
+    mutable std::map<String16, std::vector<int64_t>> mLongVectorMap;
+    mutable std::map<String16, std::vector<double>> mDoubleVectorMap;
+    mutable std::map<String16, std::vector<String16>> mStringVectorMap;
+    mutable std::map<String16, PersistableBundle> mPersistableBundleMap;
 };
 
 }  // namespace os
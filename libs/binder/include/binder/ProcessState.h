@@ -58,6 +58,24 @@ public:
             void                spawnPooledThread(bool isMain);
             
             status_t            setThreadPoolMaxThreadCount(size_t maxThreads);
+
+            // Instead of letting the driver grow the thread pool up to a fixed
+            // maximum, keep between minThreads and maxThreads pool threads, spawning
+            // one whenever all of them are busy. Threads beyond minThreads exit after
+            // being idle for idleTimeoutMs. This must be called before
+            // startThreadPool().
+            status_t            setThreadPoolAdaptive(size_t minThreads, size_t maxThreads,
+                                                      int64_t idleTimeoutMs);
+
+            struct ThreadPoolStats {
+                // pool threads currently running, adaptive mode only
+                size_t threads = 0;
+                uint64_t spawned = 0;
+                uint64_t retired = 0;
+                // times all of mMaxThreads were busy at once
+                uint64_t starvations = 0;
+            };
+            ThreadPoolStats     getThreadPoolStats();
             status_t            enableOnewaySpamDetection(bool enable);
             void                giveThreadPoolName();
 
@@ -85,10 +103,16 @@ public:
             // before any threads are spawned.
             void setCallRestriction(CallRestriction restriction);
 
+            // Gives each thread using binder a small cache of freed Parcel data buffers, so
+            // steady-state transactions don't go through malloc/free. This must be called
+            // before any threads are spawned.
+            void setParcelBufferPoolEnabled(bool enabled);
+
 private:
     static  sp<ProcessState>    init(const char *defaultDriver, bool requireDefault);
 
     friend class IPCThreadState;
+    friend class PoolThread;
     friend class sp<ProcessState>;
 
             explicit            ProcessState(const char* driver);
@@ -97,6 +121,7 @@ private:
                                 ProcessState(const ProcessState& o);
             ProcessState&       operator=(const ProcessState& o);
             String8             makeBinderThreadName();
+            void                spawnAdaptiveThread();
 
             struct handle_entry {
                 IBinder* binder;
@@ -121,6 +146,13 @@ private:
             size_t              mMaxThreads;
             // Time when thread pool was emptied
             int64_t             mStarvationStartTimeMs;
+            // See setThreadPoolAdaptive.
+            bool                mAdaptiveThreadPool;
+            size_t              mMinThreads;
+            int64_t             mThreadIdleTimeoutMs;
+            // Pool threads running or about to start, adaptive mode only.
+            size_t              mPoolThreadCount;
+            ThreadPoolStats     mThreadPoolStats;
 
     mutable Mutex               mLock;  // protects everything below.
 
@@ -130,6 +162,7 @@ private:
     volatile int32_t            mThreadPoolSeq;
 
             CallRestriction     mCallRestriction;
+            bool                mParcelBufferPoolEnabled;
 };
     
 } // namespace android
@@ -21,6 +21,7 @@
 #include <utils/Errors.h>
 #include <utils/RefBase.h>
 
+#include <map>
 #include <mutex>
 #include <thread>
 
@@ -103,6 +104,17 @@ public:
     void setMaxThreads(size_t threads);
     size_t getMaxThreads();
 
+    /**
+     * This must be called before adding a client session.
+     *
+     * Instead of dedicating a blocking thread to each connection, wait on all
+     * connections with a single epoll(7) set, and run commands as they arrive
+     * on a pool of getMaxThreads() threads. A thread keeps the connection it
+     * is reading from for the whole command, so nested transactions work the
+     * same way. This scales to many mostly idle clients.
+     */
+    void setEventLoopEnabled(bool enabled);
+
     /**
      * The root object can be retrieved by any client, without any
      * authentication. TODO(b/183988761)
@@ -148,9 +160,19 @@ private:
     void establishConnection(sp<RpcServer>&& session, base::unique_fd clientFd);
     bool setupSocketServer(const RpcSocketAddress& address);
 
+    // event loop mode only, returns a connection which must be removed on failure
+    sp<RpcSession::RpcConnection> addEventLoopConnectionLocked(const sp<RpcSession>& session,
+                                                               base::unique_fd clientFd);
+    void eventLoopThread();
+    struct EventLoopConnection {
+        sp<RpcSession> session;
+        sp<RpcSession::RpcConnection> connection;
+    };
+
     bool mAgreedExperimental = false;
     bool mStarted = false; // TODO(b/185167543): support dynamically added clients
     size_t mMaxThreads = 1;
+    bool mEventLoop = false;
     base::unique_fd mServer; // socket we are accepting sessions on
 
     std::mutex mLock; // for below
@@ -159,6 +181,9 @@ private:
     wp<IBinder> mRootObjectWeak;
     std::map<int32_t, sp<RpcSession>> mSessions;
     int32_t mSessionIdCounter = 0;
+    // connections waited on by mEpollFd, key is also the epoll_event data
+    base::unique_fd mEpollFd;
+    std::map<RpcSession::RpcConnection*, EventLoopConnection> mEventLoopConnections;
 };
 
 } // namespace android
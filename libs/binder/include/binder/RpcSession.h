@@ -46,6 +46,18 @@ class RpcSession final : public virtual RefBase {
 public:
     static sp<RpcSession> make();
 
+    /**
+     * Use a single connection for every call made through this session,
+     * instead of one per remote thread. Synchronous transactions are tagged
+     * with a request id, so calls from many threads can be in flight at once
+     * and their replies can return in any order. Must be called before setting
+     * up the client.
+     *
+     * The server runs these transactions on separate threads, which may not
+     * make nested calls back into this process.
+     */
+    void setMultiplexed(bool multiplexed);
+
     /**
      * This should be called once per thread, matching 'join' in the remote
      * process.
@@ -83,6 +95,19 @@ public:
      */
     status_t getRemoteMaxThreads(size_t* maxThreads);
 
+    /**
+     * Negotiate a shared memory region of 'size' bytes with the server, passed
+     * once over the socket. Afterwards, blobs ('Parcel::writeBlob') larger than
+     * the in-place limit are written into it instead of being copied through
+     * the socket, in both directions. Blobs written while the region is full
+     * are sent in-place as before.
+     *
+     * Must be called after setting up a unix domain client, before the
+     * session is used for blobs. Returns UNKNOWN_TRANSACTION if the server
+     * doesn't support this.
+     */
+    [[nodiscard]] status_t setupSharedMemory(size_t size);
+
     [[nodiscard]] status_t transact(const RpcAddress& address, uint32_t code, const Parcel& data,
                                     Parcel* reply, uint32_t flags);
     [[nodiscard]] status_t sendDecStrong(const RpcAddress& address);
@@ -134,6 +159,14 @@ private:
     void setForServer(const wp<RpcServer>& server, int32_t sessionId);
     sp<RpcConnection> assignServerToThisThread(base::unique_fd fd);
     bool removeServerConnection(const sp<RpcConnection>& connection);
+    // For RpcServer's event loop, a server connection not tied to a thread,
+    // which serves one command at a time on whichever thread calls
+    // serveOneCommand.
+    sp<RpcConnection> addServerConnection(base::unique_fd fd);
+    status_t serveOneCommand(const sp<RpcConnection>& connection);
+    // In multiplexed mode, the connection shared by all threads, unless this
+    // thread is serving a call and should make a nested call instead.
+    sp<RpcConnection> multiplexedConnection();
 
     enum class ConnectionUse {
         CLIENT,
@@ -182,6 +215,8 @@ private:
     // TODO(b/183988761): this shouldn't be guessable
     std::optional<int32_t> mId;
 
+    bool mMultiplexed = false;
+
     std::unique_ptr<RpcState> mState;
 
     std::mutex mMutex; // for all below
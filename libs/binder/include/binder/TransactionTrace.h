@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <utils/String16.h>
+
+#include <vector>
+
+namespace android {
+
+/**
+ * A single kernel binder transaction, as recorded by TransactionTrace.
+ */
+struct BinderTransactionEvent {
+    enum Direction : uint8_t {
+        // This thread sent the transaction and, unless it was oneway, waited for the reply.
+        OUTGOING,
+        // This thread received the transaction and ran it.
+        INCOMING,
+    };
+
+    // CLOCK_MONOTONIC, in nanoseconds
+    int64_t startNs = 0;
+    int64_t endNs = 0;
+    // see TransactionTrace::getDescriptor, 0 when unknown (always for outgoing transactions)
+    uint32_t descriptorId = 0;
+    uint32_t code = 0;
+    uint32_t flags = 0;
+    uint32_t dataSize = 0;
+    uint32_t replySize = 0;
+    // handle of the target, for outgoing transactions
+    int32_t handle = 0;
+    // pid of the sender, for incoming transactions
+    pid_t callingPid = 0;
+    pid_t tid = 0;
+    int32_t status = 0;
+    Direction direction = OUTGOING;
+};
+
+/**
+ * Always-on, low overhead record of the binder transactions made and served by
+ * this process.
+ *
+ * Each thread records into its own fixed size ring buffer without taking any
+ * locks, overwriting its oldest events once the ring is full. Events are
+ * collected with drain(), for instance by a tracing data source when a trace
+ * is taken.
+ */
+class TransactionTrace {
+public:
+    // Recording is enabled by default.
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    /**
+     * Appends the events recorded since the last drain, from every thread,
+     * to |events|. Events of a thread are in order, but threads are not
+     * interleaved by time.
+     */
+    static void drain(std::vector<BinderTransactionEvent>* events);
+
+    /**
+     * Returns the interface descriptor for a BinderTransactionEvent::descriptorId.
+     */
+    static String16 getDescriptor(uint32_t descriptorId);
+
+    // For libbinder, these record the events.
+    static uint32_t internDescriptor(const String16& descriptor);
+    static void record(const BinderTransactionEvent& event);
+};
+
+} // namespace android
@@ -30,6 +30,7 @@
 #include <android/binder_internal_logging.h>
 #include <android/binder_parcel.h>
 
+#include <limits>
 #include <optional>
 #include <string>
 #include <vector>
@@ -563,6 +564,33 @@ static inline binder_status_t AParcel_readVector(const AParcel* parcel, std::vec
                                        AParcel_readStdVectorParcelableElement<P>);
 }
 
+/**
+ * Writes a parcelable object of type P at index 'index' of a contiguous array of P to 'parcel'.
+ */
+template <typename P>
+binder_status_t AParcel_writeContiguousParcelableElement(AParcel* parcel, const void* arrayData,
+                                                         size_t index) {
+    const P* array = static_cast<const P*>(arrayData);
+    return AParcel_writeParcelable(parcel, array[index]);
+}
+
+/**
+ * Convenience API for writing 'length' parcelables stored contiguously at 'array', such as a
+ * std::array or part of a larger buffer, without first copying them into a std::vector. The
+ * format is the same as for AParcel_writeVector(std::vector<P>), and space for the elements is
+ * reserved once, based on the size of the first element.
+ */
+template <typename P>
+static inline binder_status_t AParcel_writeArray(AParcel* parcel, const P* array, size_t length) {
+    if (length > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        return STATUS_BAD_VALUE;
+    }
+    if (array == nullptr && length > 0) return STATUS_UNEXPECTED_NULL;
+    return AParcel_writeParcelableArray(parcel, static_cast<const void*>(array),
+                                        static_cast<int32_t>(length),
+                                        AParcel_writeContiguousParcelableElement<P>);
+}
+
 // @START
 /**
  * Writes a vector of int32_t to the next location in a non-null parcel.
@@ -84,22 +84,32 @@ binder_status_t WriteArray(AParcel* parcel, const T* array, int32_t length) {
     return STATUS_OK;
 }
 
-// Each element in a char16_t array is converted to an int32_t (not packed).
+// Elements of char16_t and bool arrays are each converted to an int32_t (not packed). Space for
+// the whole array is reserved with a single write so that elements are not bounds checked and
+// grown one at a time.
+int32_t* WriteWidenedArrayInplace(AParcel* parcel, int32_t length) {
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return nullptr;
+    return static_cast<int32_t*>(parcel->get()->writeInplace(size));
+}
+
+const int32_t* ReadWidenedArrayInplace(const AParcel* parcel, int32_t length) {
+    int32_t size = 0;
+    if (__builtin_smul_overflow(sizeof(int32_t), length, &size)) return nullptr;
+    return static_cast<const int32_t*>(parcel->get()->readInplace(size));
+}
+
 template <>
 binder_status_t WriteArray<char16_t>(AParcel* parcel, const char16_t* array, int32_t length) {
     binder_status_t status = WriteAndValidateArraySize(parcel, array == nullptr, length);
     if (status != STATUS_OK) return status;
     if (length <= 0) return STATUS_OK;
 
-    int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
-
-    Parcel* rawParcel = parcel->get();
+    int32_t* data = WriteWidenedArrayInplace(parcel, length);
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->writeChar(array[i]);
-
-        if (status != STATUS_OK) return PruneStatusT(status);
+        data[i] = static_cast<int32_t>(array[i]);
     }
 
     return STATUS_OK;
@@ -133,7 +143,6 @@ binder_status_t ReadArray(const AParcel* parcel, void* arrayData,
     return STATUS_OK;
 }
 
-// Each element in a char16_t array is converted to an int32_t (not packed)
 template <>
 binder_status_t ReadArray<char16_t>(const AParcel* parcel, void* arrayData,
                                     ContiguousArrayAllocator<char16_t> allocator) {
@@ -151,13 +160,11 @@ binder_status_t ReadArray<char16_t>(const AParcel* parcel, void* arrayData,
     if (length <= 0) return STATUS_OK;
     if (array == nullptr) return STATUS_NO_MEMORY;
 
-    int32_t size = 0;
-    if (__builtin_smul_overflow(sizeof(char16_t), length, &size)) return STATUS_NO_MEMORY;
+    const int32_t* data = ReadWidenedArrayInplace(parcel, length);
+    if (data == nullptr) return STATUS_NO_MEMORY;
 
     for (int32_t i = 0; i < length; i++) {
-        status = rawParcel->readChar(array + i);
-
-        if (status != STATUS_OK) return PruneStatusT(status);
+        array[i] = static_cast<char16_t>(data[i]);
     }
 
     return STATUS_OK;
@@ -209,6 +216,50 @@ binder_status_t ReadArray(const AParcel* parcel, void* arrayData, ArrayAllocator
     return STATUS_OK;
 }
 
+template <>
+binder_status_t WriteArray<bool>(AParcel* parcel, const void* arrayData, int32_t length,
+                                 ArrayGetter<bool> getter, status_t (Parcel::*)(bool)) {
+    bool arrayIsNull = length < 0;
+    binder_status_t status = WriteAndValidateArraySize(parcel, arrayIsNull, length);
+    if (status != STATUS_OK) return status;
+    if (length <= 0) return STATUS_OK;
+
+    int32_t* data = WriteWidenedArrayInplace(parcel, length);
+    if (data == nullptr) return STATUS_NO_MEMORY;
+
+    for (int32_t i = 0; i < length; i++) {
+        data[i] = getter(arrayData, i) ? 1 : 0;
+    }
+
+    return STATUS_OK;
+}
+
+template <>
+binder_status_t ReadArray<bool>(const AParcel* parcel, void* arrayData,
+                                ArrayAllocator<bool> allocator, ArraySetter<bool> setter,
+                                status_t (Parcel::*)(bool*) const) {
+    const Parcel* rawParcel = parcel->get();
+
+    int32_t length;
+    status_t status = rawParcel->readInt32(&length);
+
+    if (status != STATUS_OK) return PruneStatusT(status);
+    if (length < -1) return STATUS_BAD_VALUE;
+
+    if (!allocator(arrayData, length)) return STATUS_NO_MEMORY;
+
+    if (length <= 0) return STATUS_OK;
+
+    const int32_t* data = ReadWidenedArrayInplace(parcel, length);
+    if (data == nullptr) return STATUS_NO_MEMORY;
+
+    for (int32_t i = 0; i < length; i++) {
+        setter(arrayData, i, data[i] != 0);
+    }
+
+    return STATUS_OK;
+}
+
 void AParcel_delete(AParcel* parcel) {
     delete parcel;
 }
@@ -438,8 +489,24 @@ binder_status_t AParcel_writeParcelableArray(AParcel* parcel, const void* arrayD
     if (status != STATUS_OK) return status;
     if (length <= 0) return STATUS_OK;
 
-    for (int32_t i = 0; i < length; i++) {
-        binder_status_t status = elementWriter(parcel, arrayData, i);
+    Parcel* rawParcel = parcel->get();
+    size_t start = rawParcel->dataPosition();
+    status = elementWriter(parcel, arrayData, 0);
+    if (status != STATUS_OK) return status;
+
+    // Elements of a parcelable array usually have similar sizes, so reserve space for the rest of
+    // them up front instead of growing the parcel repeatedly. This is only a hint; failing to
+    // reserve leaves growth to the individual writes.
+    size_t elementSize = rawParcel->dataPosition() - start;
+    size_t remaining = 0;
+    size_t capacity = 0;
+    if (!__builtin_mul_overflow(elementSize, static_cast<size_t>(length - 1), &remaining) &&
+        !__builtin_add_overflow(rawParcel->dataPosition(), remaining, &capacity)) {
+        (void)rawParcel->setDataCapacity(capacity);
+    }
+
+    for (int32_t i = 1; i < length; i++) {
+        status = elementWriter(parcel, arrayData, i);
         if (status != STATUS_OK) return status;
     }
 
@@ -22,6 +22,7 @@
 #include <android/binder_ibinder_platform.h>
 #include <android/binder_libbinder.h>
 #include <android/binder_manager.h>
+#include <android/binder_parcel_utils.h>
 #include <android/binder_process.h>
 #include <gtest/gtest.h>
 #include <iface/iface.h>
@@ -667,6 +668,51 @@ TEST(NdkBinder, GetClassInterfaceDescriptor) {
     ASSERT_STREQ(IFoo::kIFooDescriptor, AIBinder_Class_getDescriptor(IFoo::kClass));
 }
 
+struct Point {
+    int32_t x = 0;
+    int32_t y = 0;
+
+    binder_status_t writeToParcel(AParcel* parcel) const {
+        binder_status_t status = AParcel_writeInt32(parcel, x);
+        if (status != STATUS_OK) return status;
+        return AParcel_writeInt32(parcel, y);
+    }
+    binder_status_t readFromParcel(const AParcel* parcel) {
+        binder_status_t status = AParcel_readInt32(parcel, &x);
+        if (status != STATUS_OK) return status;
+        return AParcel_readInt32(parcel, &y);
+    }
+    bool operator==(const Point& other) const { return x == other.x && y == other.y; }
+};
+
+TEST(NdkBinder, BulkArraysRoundTrip) {
+    ndk::ScopedAParcel parcel(AParcel_create());
+
+    const std::vector<char16_t> chars = {u'a', u'\0', u'\uffff'};
+    const std::vector<bool> bools = {true, false, true, true};
+    const Point points[] = {{1, 2}, {3, 4}, {5, 6}};
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_writeVector(parcel.get(), chars));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_writeVector(parcel.get(), bools));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_writeArray(parcel.get(), points, std::size(points)));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_writeArray<Point>(parcel.get(), nullptr, 0));
+
+    ASSERT_EQ(STATUS_OK, AParcel_setDataPosition(parcel.get(), 0));
+    std::vector<char16_t> readChars;
+    std::vector<bool> readBools;
+    std::vector<Point> readPoints;
+    std::vector<Point> readEmpty = {{7, 8}};
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_readVector(parcel.get(), &readChars));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_readVector(parcel.get(), &readBools));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_readVector(parcel.get(), &readPoints));
+    ASSERT_EQ(STATUS_OK, ndk::AParcel_readVector(parcel.get(), &readEmpty));
+
+    EXPECT_EQ(chars, readChars);
+    EXPECT_EQ(bools, readBools);
+    EXPECT_EQ(std::vector<Point>(std::begin(points), std::end(points)), readPoints);
+    EXPECT_TRUE(readEmpty.empty());
+    EXPECT_EQ(AParcel_getDataSize(parcel.get()), AParcel_getDataPosition(parcel.get()));
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
 
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BinderTraceDataSource"
+
+#include "binder_perfetto/BinderTraceDataSource.h"
+
+#include <binder/TransactionTrace.h>
+#include <perfetto/trace/track_event/debug_annotation.pbzero.h>
+#include <perfetto/trace/track_event/thread_descriptor.pbzero.h>
+#include <perfetto/trace/track_event/track_descriptor.pbzero.h>
+#include <perfetto/trace/track_event/track_event.pbzero.h>
+#include <unistd.h>
+#include <utils/String8.h>
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::BinderTraceDataSource);
+
+namespace android {
+
+namespace {
+
+using perfetto::protos::pbzero::TrackEvent;
+
+// Distinct from the uuids of other per-thread tracks of this process.
+uint64_t trackUuid(pid_t pid, pid_t tid) {
+    constexpr uint64_t kBinderTrackSalt = 0xb1d0'0000'0000'0000;
+    return kBinderTrackSalt ^ (static_cast<uint64_t>(pid) << 32) ^ static_cast<uint32_t>(tid);
+}
+
+void addAnnotation(TrackEvent* event, const char* name, uint64_t value) {
+    auto* annotation = event->add_debug_annotations();
+    annotation->set_name(name);
+    annotation->set_uint_value(value);
+}
+
+void writeEvents(const std::vector<BinderTransactionEvent>& events) {
+    if (events.empty()) return;
+
+    const pid_t pid = getpid();
+    std::unordered_map<uint32_t, std::string> descriptors;
+    auto descriptorName = [&](uint32_t id) -> const std::string& {
+        auto it = descriptors.find(id);
+        if (it == descriptors.end()) {
+            String8 name(TransactionTrace::getDescriptor(id));
+            it = descriptors.emplace(id, std::string(name.c_str(), name.size())).first;
+        }
+        return it->second;
+    };
+
+    BinderTraceDataSource::Trace([&](BinderTraceDataSource::TraceContext ctx) {
+        std::unordered_set<pid_t> describedThreads;
+        for (const auto& event : events) {
+            const uint64_t uuid = trackUuid(pid, event.tid);
+            if (describedThreads.insert(event.tid).second) {
+                auto packet = ctx.NewTracePacket();
+                auto* track = packet->set_track_descriptor();
+                track->set_uuid(uuid);
+                track->set_name("binder transactions");
+                auto* thread = track->set_thread();
+                thread->set_pid(pid);
+                thread->set_tid(event.tid);
+            }
+
+            {
+                auto packet = ctx.NewTracePacket();
+                packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
+                packet->set_timestamp(static_cast<uint64_t>(event.startNs));
+                auto* slice = packet->set_track_event();
+                slice->set_type(TrackEvent::TYPE_SLICE_BEGIN);
+                slice->set_track_uuid(uuid);
+                const bool incoming = event.direction == BinderTransactionEvent::INCOMING;
+                slice->set_name(incoming ? "binder reply" : "binder transaction");
+                if (event.descriptorId != 0) {
+                    auto* annotation = slice->add_debug_annotations();
+                    annotation->set_name("interface");
+                    annotation->set_string_value(descriptorName(event.descriptorId));
+                }
+                addAnnotation(slice, "code", event.code);
+                addAnnotation(slice, "flags", event.flags);
+                addAnnotation(slice, "data_size", event.dataSize);
+                addAnnotation(slice, "reply_size", event.replySize);
+                if (incoming) {
+                    addAnnotation(slice, "calling_pid", static_cast<uint64_t>(event.callingPid));
+                } else {
+                    addAnnotation(slice, "handle", static_cast<uint64_t>(event.handle));
+                }
+                if (event.status != 0) {
+                    auto* annotation = slice->add_debug_annotations();
+                    annotation->set_name("status");
+                    annotation->set_int_value(event.status);
+                }
+            }
+
+            {
+                auto packet = ctx.NewTracePacket();
+                packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
+                packet->set_timestamp(static_cast<uint64_t>(event.endNs));
+                auto* slice = packet->set_track_event();
+                slice->set_type(TrackEvent::TYPE_SLICE_END);
+                slice->set_track_uuid(uuid);
+            }
+        }
+        ctx.Flush();
+    });
+}
+
+} // namespace
+
+void BinderTraceDataSource::OnStop(const StopArgs&) {
+    // Sessions are still able to write from here.
+    flush();
+}
+
+void BinderTraceDataSource::initialize() {
+    perfetto::TracingInitArgs args;
+    args.backends = perfetto::kSystemBackend;
+    perfetto::Tracing::Initialize(args);
+    registerDataSource();
+}
+
+void BinderTraceDataSource::registerDataSource() {
+    perfetto::DataSourceDescriptor dsd;
+    dsd.set_name(kBinderTraceDataSource);
+    Register(dsd);
+}
+
+void BinderTraceDataSource::flush() {
+    std::vector<BinderTransactionEvent> events;
+    TransactionTrace::drain(&events);
+    writeEvents(events);
+}
+
+} // namespace android
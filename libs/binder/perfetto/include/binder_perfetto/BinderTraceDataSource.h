@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <perfetto/tracing.h>
+
+namespace android {
+
+/**
+ * Perfetto data source for the binder transactions recorded by
+ * TransactionTrace. When a trace session using it stops, the events recorded
+ * since the last drain are written out as slices on per-thread tracks, with
+ * the code, sizes and peer as debug annotations.
+ */
+class BinderTraceDataSource : public perfetto::DataSource<BinderTraceDataSource> {
+public:
+    void OnSetup(const SetupArgs&) override {}
+    void OnStart(const StartArgs&) override {}
+    void OnStop(const StopArgs&) override;
+
+    // Sets up the perfetto system backend and registers the data source.
+    static void initialize();
+    // Registers the data source, for processes which have already initialized perfetto.
+    static void registerDataSource();
+
+    /**
+     * Drains TransactionTrace into every active session now, rather than
+     * waiting for them to stop.
+     */
+    static void flush();
+
+    static constexpr char kBinderTraceDataSource[] = "android.binder.transactions";
+};
+
+} // namespace android
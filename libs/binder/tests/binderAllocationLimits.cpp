@@ -17,6 +17,7 @@
 #include <android-base/logging.h>
 #include <binder/Parcel.h>
 #include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
 #include <gtest/gtest.h>
 #include <utils/CallStack.h>
 
@@ -130,6 +131,7 @@ using android::String16;
 using android::defaultServiceManager;
 using android::sp;
 using android::IServiceManager;
+using android::ProcessState;
 
 static sp<IBinder> GetRemoteBinder() {
     // This gets binder representing the service manager
@@ -175,12 +177,35 @@ TEST(BinderAllocation, SmallTransaction) {
     EXPECT_EQ(mallocs, 1);
 }
 
+TEST(BinderAllocation, PooledSmallTransaction) {
+    String16 empty_descriptor = String16("");
+    sp<IServiceManager> manager = defaultServiceManager();
+
+    // first round trip on this thread fills its Parcel buffer pool
+    manager->checkService(empty_descriptor);
+
+    const auto m = ScopeDisallowMalloc();
+    manager->checkService(empty_descriptor);
+    manager->checkService(empty_descriptor);
+}
+
+TEST(BinderAllocation, PooledBufferCounters) {
+    sp<IServiceManager> manager = defaultServiceManager();
+    manager->checkService(String16(""));
+
+    size_t hits = Parcel::getGlobalBufferPoolHits();
+    manager->checkService(String16(""));
+    EXPECT_GT(Parcel::getGlobalBufferPoolHits(), hits);
+}
+
 int main(int argc, char** argv) {
     if (getenv("LIBC_HOOKS_ENABLE") == nullptr) {
         CHECK(0 == setenv("LIBC_HOOKS_ENABLE", "1", true /*overwrite*/));
         execv(argv[0], argv);
         return 1;
     }
+    // must be set before this thread starts using binder
+    ProcessState::self()->setParcelBufferPoolEnabled(true);
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// One matrix of transaction benchmarks, for kernel binder and RPC binder:
+//
+//   BM_transact/<transport>/<payload bytes>/<objects>/threads:<clients>
+//
+// where transport is 0 (kernel binder), 1 (RPC over unix domain socket) or
+// 2 (RPC over vsock), and objects is 0 (bytes only), 1 (one fd) or 2 (one
+// binder). Besides the mean, each run reports p50/p99/p99.9 latency counters.
+// With several client threads, these are the per-thread percentiles averaged
+// across threads.
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <binder/Binder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <binder/RpcServer.h>
+#include <binder/RpcSession.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "../vm_sockets.h" // for VMADDR_*
+
+using android::BBinder;
+using android::defaultServiceManager;
+using android::IBinder;
+using android::OK;
+using android::Parcel;
+using android::ProcessState;
+using android::RpcServer;
+using android::RpcSession;
+using android::sp;
+using android::status_t;
+using android::String16;
+using android::base::unique_fd;
+
+enum Transport : int64_t { KERNEL = 0, RPC_UNIX = 1, RPC_VSOCK = 2 };
+enum Objects : int64_t { NONE = 0, FD = 1, BINDER = 2 };
+
+static const String16 kServiceName = String16("binderIpcBenchmark");
+static constexpr unsigned int kVsockPort = 4567;
+static constexpr size_t kMaxClients = 8;
+
+// The kernel driver maps 1MB - 2 pages per process for incoming transactions
+// (half of that for oneway), and RPC binder refuses transactions over 100kB.
+static constexpr int64_t kMaxKernelPayload = 512 << 10;
+static constexpr int64_t kMaxKernelOnewayPayload = 64 << 10;
+static constexpr int64_t kMaxRpcPayload = 64 << 10;
+
+static sp<IBinder> gBinders[3];
+
+class EchoBinder : public BBinder {
+public:
+    enum { ECHO = IBinder::FIRST_CALL_TRANSACTION, SINK };
+
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        if (code != ECHO && code != SINK) return BBinder::onTransact(code, data, reply, flags);
+
+        int32_t objects;
+        std::vector<uint8_t> bytes;
+        if (status_t status = data.readInt32(&objects); status != OK) return status;
+        if (status_t status = data.readByteVector(&bytes); status != OK) return status;
+        unique_fd fd;
+        sp<IBinder> binder;
+        if (objects == FD) {
+            if (status_t status = data.readUniqueFileDescriptor(&fd); status != OK) return status;
+        } else if (objects == BINDER) {
+            if (status_t status = data.readStrongBinder(&binder); status != OK) return status;
+        }
+        if (code == SINK) return OK;
+
+        if (status_t status = reply->writeByteVector(bytes); status != OK) return status;
+        if (objects == FD) return reply->writeUniqueFileDescriptor(fd);
+        if (objects == BINDER) return reply->writeStrongBinder(binder);
+        return OK;
+    }
+};
+
+static void writePayload(Parcel* data, int64_t objects, const std::vector<uint8_t>& bytes,
+                         const unique_fd& fd, const sp<IBinder>& binder) {
+    CHECK_EQ(OK, data->writeInt32(objects));
+    CHECK_EQ(OK, data->writeByteVector(bytes));
+    if (objects == FD) CHECK_EQ(OK, data->writeFileDescriptor(fd.get()));
+    if (objects == BINDER) CHECK_EQ(OK, data->writeStrongBinder(binder));
+}
+
+static void reportLatencies(benchmark::State& state, std::vector<int64_t>* latenciesNs) {
+    if (latenciesNs->empty()) return;
+    std::sort(latenciesNs->begin(), latenciesNs->end());
+    auto percentileUs = [&](double p) {
+        size_t index = std::min(latenciesNs->size() - 1, size_t(p * latenciesNs->size()));
+        return benchmark::Counter((*latenciesNs)[index] / 1000.0,
+                                  benchmark::Counter::kAvgThreads);
+    };
+    state.counters["p50_us"] = percentileUs(0.50);
+    state.counters["p99_us"] = percentileUs(0.99);
+    state.counters["p99.9_us"] = percentileUs(0.999);
+}
+
+static void runTransactions(benchmark::State& state, bool oneway) {
+    const Transport transport = static_cast<Transport>(state.range(0));
+    const int64_t size = state.range(1);
+    const Objects objects = static_cast<Objects>(state.range(2));
+
+    sp<IBinder> binder = gBinders[transport];
+    if (binder == nullptr) {
+        state.SkipWithError("transport not available");
+        return;
+    }
+    if (transport != KERNEL && objects == FD) {
+        state.SkipWithError("RPC binder doesn't support fds");
+        return;
+    }
+    const int64_t maxSize = transport != KERNEL ? kMaxRpcPayload
+            : oneway                            ? kMaxKernelOnewayPayload
+                                                : kMaxKernelPayload;
+    if (size > maxSize) {
+        state.SkipWithError("payload too large for transport");
+        return;
+    }
+
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = i % 256;
+    unique_fd fd(open("/dev/null", O_RDONLY | O_CLOEXEC));
+    CHECK(fd.ok());
+    sp<IBinder> local = sp<BBinder>::make();
+
+    std::vector<int64_t> latenciesNs;
+    int64_t retries = 0;
+    for (auto _ : state) {
+        Parcel data, reply;
+        data.markForBinder(binder);
+        writePayload(&data, objects, bytes, fd, local);
+
+        auto start = std::chrono::steady_clock::now();
+        status_t status = binder->transact(oneway ? EchoBinder::SINK : EchoBinder::ECHO, data,
+                                           &reply, oneway ? IBinder::FLAG_ONEWAY : 0);
+        auto end = std::chrono::steady_clock::now();
+
+        // the server's async buffer space may be used up by earlier oneway calls
+        while (oneway && status == android::FAILED_TRANSACTION) {
+            retries++;
+            usleep(100);
+            start = std::chrono::steady_clock::now();
+            status = binder->transact(EchoBinder::SINK, data, &reply, IBinder::FLAG_ONEWAY);
+            end = std::chrono::steady_clock::now();
+        }
+        CHECK_EQ(OK, status);
+
+        latenciesNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+
+    state.SetBytesProcessed(int64_t(state.iterations()) * size * (oneway ? 1 : 2));
+    if (oneway) state.counters["retries"] = benchmark::Counter(retries);
+    reportLatencies(state, &latenciesNs);
+}
+
+void BM_transact(benchmark::State& state) {
+    runTransactions(state, false /*oneway*/);
+}
+
+void BM_transactOneway(benchmark::State& state) {
+    runTransactions(state, true /*oneway*/);
+}
+
+static void matrix(benchmark::internal::Benchmark* b) {
+    for (int64_t transport : {KERNEL, RPC_UNIX, RPC_VSOCK}) {
+        for (int64_t size : {0, 128, 4 << 10, 64 << 10, 512 << 10}) {
+            for (int64_t objects : {NONE, FD, BINDER}) {
+                b->Args({transport, size, objects});
+            }
+        }
+    }
+    b->ArgNames({"transport", "bytes", "objects"});
+    for (size_t clients = 1; clients <= kMaxClients; clients *= 2) {
+        b->Threads(clients);
+    }
+}
+BENCHMARK(BM_transact)->Apply(matrix)->UseRealTime();
+BENCHMARK(BM_transactOneway)->Apply(matrix)->UseRealTime();
+
+static std::string unixSocketPath() {
+    return std::string(getenv("TMPDIR") ?: "/tmp") + "/binderIpcBenchmark";
+}
+
+// Must be forked before this process uses binder.
+static void forkServers() {
+    if (fork() == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGHUP);
+        CHECK_EQ(OK, defaultServiceManager()->addService(kServiceName, sp<EchoBinder>::make()));
+        ProcessState::self()->setThreadPoolMaxThreadCount(kMaxClients);
+        ProcessState::self()->startThreadPool();
+        android::IPCThreadState::self()->joinThreadPool();
+        exit(1);
+    }
+
+    if (fork() == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGHUP);
+        std::string addr = unixSocketPath();
+        (void)unlink(addr.c_str());
+
+        std::thread([]() {
+            sp<RpcServer> server = RpcServer::make();
+            server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
+            server->setRootObject(sp<EchoBinder>::make());
+            server->setMaxThreads(kMaxClients);
+            if (!server->setupVsockServer(kVsockPort)) {
+                LOG(WARNING) << "vsock unavailable, RPC_VSOCK benchmarks will be skipped";
+                return;
+            }
+            server->join();
+        }).detach();
+
+        sp<RpcServer> server = RpcServer::make();
+        server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
+        server->setRootObject(sp<EchoBinder>::make());
+        server->setMaxThreads(kMaxClients);
+        CHECK(server->setupUnixDomainServer(addr.c_str()));
+        server->join();
+        exit(1);
+    }
+}
+
+static sp<IBinder> connectRpc(Transport transport) {
+    for (size_t tries = 0; tries < 50; tries++) {
+        sp<RpcSession> session = RpcSession::make();
+        bool connected = transport == RPC_UNIX
+                ? session->setupUnixDomainClient(unixSocketPath().c_str())
+                : session->setupVsockClient(VMADDR_CID_LOCAL, kVsockPort);
+        if (connected) return session->getRootObject();
+        usleep(10000);
+    }
+    return nullptr;
+}
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    forkServers();
+
+    ProcessState::self()->startThreadPool();
+    gBinders[KERNEL] = defaultServiceManager()->waitForService(kServiceName);
+    CHECK(gBinders[KERNEL] != nullptr);
+    gBinders[RPC_UNIX] = connectRpc(RPC_UNIX);
+    CHECK(gBinders[RPC_UNIX] != nullptr);
+    gBinders[RPC_VSOCK] = connectRpc(RPC_VSOCK);
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
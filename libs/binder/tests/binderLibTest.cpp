@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <errno.h>
 #include <fcntl.h>
 #include <fstream>
@@ -27,9 +28,12 @@
 #include <gtest/gtest.h>
 
 #include <binder/Binder.h>
+#include <binder/BinderStats.h>
+#include <binder/BpBinder.h>
 #include <binder/IBinder.h>
 #include <binder/IPCThreadState.h>
 #include <binder/IServiceManager.h>
+#include <binder/TransactionTrace.h>
 
 #include <linux/sched.h>
 #include <sys/epoll.h>
@@ -416,6 +420,172 @@ TEST_F(BinderLibTest, NopTransactionOneway) {
                 StatusEq(NO_ERROR));
 }
 
+TEST_F(BinderLibTest, NopTransactionOnewayBatch) {
+    Parcel data, reply;
+    IPCThreadState::self()->beginOnewayBatch();
+    for (int i = 0; i < 10; i++) {
+        EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply, TF_ONE_WAY),
+                    StatusEq(NO_ERROR));
+    }
+    EXPECT_THAT(IPCThreadState::self()->endOnewayBatch(), StatusEq(NO_ERROR));
+
+    // a blocking call flushes whatever is still queued
+    IPCThreadState::self()->beginOnewayBatch();
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply, TF_ONE_WAY),
+                StatusEq(NO_ERROR));
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+    EXPECT_THAT(IPCThreadState::self()->endOnewayBatch(), StatusEq(NO_ERROR));
+}
+
+TEST_F(BinderLibTest, LocalTransactionStats) {
+    sp<BBinder> binder = sp<BBinder>::make();
+    std::vector<BinderTransactionStats> stats;
+
+    BBinder::setTransactionStatsEnabled(true);
+    for (int i = 0; i < 3; i++) {
+        Parcel data, reply;
+        EXPECT_THAT(binder->transact(IBinder::PING_TRANSACTION, data, &reply), StatusEq(NO_ERROR));
+    }
+    BBinder::setTransactionStatsEnabled(false);
+
+    Parcel data, reply;
+    EXPECT_THAT(binder->transact(IBinder::PING_TRANSACTION, data, &reply), StatusEq(NO_ERROR));
+
+    EXPECT_THAT(binder->getDebugTransactionStats(&stats), StatusEq(NO_ERROR));
+    ASSERT_EQ(1u, stats.size());
+    EXPECT_EQ(IBinder::PING_TRANSACTION, stats[0].code);
+    EXPECT_EQ(3u, stats[0].count);
+
+    uint64_t bucketed = 0;
+    for (uint64_t bucket : stats[0].latencyBuckets) bucketed += bucket;
+    EXPECT_EQ(3u, bucketed);
+}
+
+TEST_F(BinderLibTest, TransactionTraceRecordsOutgoing) {
+    std::vector<BinderTransactionEvent> events;
+    TransactionTrace::drain(&events);
+    events.clear();
+
+    Parcel data, reply;
+    data.writeInt32(1);
+    EXPECT_THAT(m_server->transact(BINDER_LIB_TEST_NOP_TRANSACTION, data, &reply),
+                StatusEq(NO_ERROR));
+
+    TransactionTrace::drain(&events);
+    const pid_t tid = gettid();
+    auto it = std::find_if(events.begin(), events.end(), [&](const auto& event) {
+        return event.tid == tid && event.code == BINDER_LIB_TEST_NOP_TRANSACTION;
+    });
+    ASSERT_NE(events.end(), it);
+    EXPECT_EQ(BinderTransactionEvent::OUTGOING, it->direction);
+    EXPECT_EQ(data.dataSize(), it->dataSize);
+    EXPECT_EQ(NO_ERROR, it->status);
+    EXPECT_LE(it->startNs, it->endNs);
+
+    // drained events are not returned again
+    events.clear();
+    TransactionTrace::drain(&events);
+    EXPECT_TRUE(std::none_of(events.begin(), events.end(), [&](const auto& event) {
+        return event.tid == tid && event.code == BINDER_LIB_TEST_NOP_TRANSACTION;
+    }));
+}
+
+TEST_F(BinderLibTest, ProxyAttachedObjects) {
+    sp<IBinder> proxy;
+    {
+        Parcel data, reply;
+        ASSERT_THAT(m_server->transact(BINDER_LIB_TEST_CREATE_BINDER_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+        proxy = reply.readStrongBinder();
+    }
+    ASSERT_NE(nullptr, proxy);
+    ASSERT_NE(nullptr, proxy->remoteBinder());
+
+    static int sIds[8];
+    int objects[8];
+    int cleanedUp = 0;
+    auto cleanup = [](const void* /*id*/, void* /*obj*/, void* cookie) {
+        ++*static_cast<int*>(cookie);
+    };
+    for (int i = 0; i < 8; i++) {
+        proxy->attachObject(&sIds[i], &objects[i], &cleanedUp, cleanup);
+    }
+    for (int i = 0; i < 8; i++) {
+        EXPECT_EQ(&objects[i], proxy->findObject(&sIds[i]));
+    }
+    // attaching an id which is in use keeps the first object
+    proxy->attachObject(&sIds[0], &objects[1], nullptr, nullptr);
+    EXPECT_EQ(&objects[0], proxy->findObject(&sIds[0]));
+
+    proxy->detachObject(&sIds[3]);
+    EXPECT_EQ(nullptr, proxy->findObject(&sIds[3]));
+
+    proxy = nullptr;
+    IPCThreadState::self()->flushCommands();
+    EXPECT_EQ(7, cleanedUp);
+}
+
+TEST_F(BinderLibTest, ProxyCountByUid) {
+    // outside of a transaction, the calling uid is our own
+    const uid_t uid = getuid();
+    BpBinder::enableCountByUid();
+    const uint32_t before = BpBinder::getBinderProxyCount(uid);
+
+    std::vector<sp<IBinder>> proxies;
+    for (int i = 0; i < 4; i++) {
+        Parcel data, reply;
+        ASSERT_THAT(m_server->transact(BINDER_LIB_TEST_CREATE_BINDER_TRANSACTION, data, &reply),
+                    StatusEq(NO_ERROR));
+        proxies.push_back(reply.readStrongBinder());
+        ASSERT_NE(nullptr, proxies.back());
+    }
+    EXPECT_EQ(before + 4, BpBinder::getBinderProxyCount(uid));
+
+    Vector<uint32_t> uids, counts;
+    BpBinder::getCountByUid(uids, counts);
+    ASSERT_EQ(uids.size(), counts.size());
+    bool found = false;
+    for (size_t i = 0; i < uids.size(); i++) {
+        if (uids[i] != uid) continue;
+        EXPECT_FALSE(found);
+        found = true;
+        EXPECT_EQ(before + 4, counts[i]);
+    }
+    EXPECT_TRUE(found);
+
+    proxies.clear();
+    IPCThreadState::self()->flushCommands();
+    BpBinder::disableCountByUid();
+    EXPECT_EQ(before, BpBinder::getBinderProxyCount(uid));
+}
+
+TEST_F(BinderLibTest, AdaptiveThreadPoolRejectsBadSizes) {
+    sp<ProcessState> proc = ProcessState::self();
+    EXPECT_THAT(proc->setThreadPoolAdaptive(0, 4, 1000), StatusEq(BAD_VALUE));
+    EXPECT_THAT(proc->setThreadPoolAdaptive(4, 2, 1000), StatusEq(BAD_VALUE));
+    EXPECT_THAT(proc->setThreadPoolAdaptive(1, 4, 0), StatusEq(BAD_VALUE));
+
+    // main() started the (non-adaptive) pool
+    ProcessState::ThreadPoolStats stats = proc->getThreadPoolStats();
+    EXPECT_GE(stats.spawned, 1u);
+    EXPECT_EQ(0u, stats.retired);
+}
+
+TEST_F(BinderLibTest, ServiceHandleCache) {
+    sp<IServiceManager> sm = defaultServiceManager();
+
+    setServiceHandleCacheEnabled(true);
+    sp<IBinder> first = sm->checkService(binderLibTestServiceName);
+    sp<IBinder> second = sm->checkService(binderLibTestServiceName);
+    setServiceHandleCacheEnabled(false);
+
+    ASSERT_NE(nullptr, first);
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(m_server, first);
+    EXPECT_THAT(first->pingBinder(), StatusEq(NO_ERROR));
+}
+
 TEST_F(BinderLibTest, NopTransactionClear) {
     Parcel data, reply;
     // make sure it accepts the transaction flag
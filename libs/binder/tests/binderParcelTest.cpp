@@ -16,6 +16,7 @@
 
 #include <binder/Parcel.h>
 #include <binder/IPCThreadState.h>
+#include <binder/PersistableBundle.h>
 #include <gtest/gtest.h>
 
 using android::IPCThreadState;
@@ -23,7 +24,9 @@ using android::OK;
 using android::Parcel;
 using android::String16;
 using android::String8;
+using android::UNEXPECTED_NULL;
 using android::status_t;
+using android::os::PersistableBundle;
 
 TEST(Parcel, NonNullTerminatedString8) {
     String8 kTestString = String8("test-is-good");
@@ -59,6 +62,53 @@ TEST(Parcel, NonNullTerminatedString16) {
     EXPECT_EQ(output.size(), 0);
 }
 
+TEST(Parcel, LazyPersistableBundle) {
+    PersistableBundle nested;
+    nested.putString(String16("inner"), String16("value"));
+
+    PersistableBundle bundle;
+    bundle.putInt(String16("int"), 42);
+    bundle.putLong(String16("long"), -1);
+    bundle.putStringVector(String16("strings"), {String16("a"), String16("bc")});
+    bundle.putBooleanVector(String16("bools"), {true, false, true});
+    bundle.putDoubleVector(String16("doubles"), {3.14});
+    bundle.putPersistableBundle(String16("nested"), nested);
+
+    Parcel p;
+    ASSERT_EQ(OK, bundle.writeToParcel(&p));
+    p.writeInt32(0xc0ffee);  // must still be readable after the bundle
+    p.setDataPosition(0);
+
+    PersistableBundle::setLazyUnparcelingEnabled(true);
+    PersistableBundle lazy;
+    EXPECT_EQ(OK, lazy.readFromParcel(&p));
+    PersistableBundle::setLazyUnparcelingEnabled(false);
+    EXPECT_EQ(0xc0ffee, p.readInt32());
+
+    EXPECT_EQ(bundle.size(), lazy.size());
+    EXPECT_EQ(bundle.getStringVectorKeys(), lazy.getStringVectorKeys());
+
+    int32_t intValue;
+    int64_t longValue;
+    EXPECT_FALSE(lazy.getLong(String16("int"), &longValue));
+    EXPECT_TRUE(lazy.getInt(String16("int"), &intValue));
+    EXPECT_EQ(42, intValue);
+
+    // Untouched bundles are written back byte for byte.
+    Parcel rewritten;
+    ASSERT_EQ(OK, lazy.writeToParcel(&rewritten));
+    ASSERT_EQ(p.dataSize() - sizeof(int32_t), rewritten.dataSize());
+    EXPECT_EQ(0, memcmp(p.data(), rewritten.data(), rewritten.dataSize()));
+
+    EXPECT_EQ(bundle, lazy);
+
+    lazy.putInt(String16("int"), 7);
+    EXPECT_TRUE(lazy.getInt(String16("int"), &intValue));
+    EXPECT_EQ(7, intValue);
+    EXPECT_EQ(bundle.size(), lazy.size());
+    EXPECT_NE(bundle, lazy);
+}
+
 // Tests a second operation results in a parcel at the same location as it
 // started.
 void parcelOpSameLength(const std::function<void(Parcel*)>& a, const std::function<void(Parcel*)>& b) {
@@ -101,6 +151,51 @@ TEST(Parcel, Utf8AsUtf16Write) {
     });
 }
 
+TEST(Parcel, String16ViewRead) {
+    const String16 token = String16("asdf");
+    parcelOpSameLength([&] (Parcel* p) {
+        p->writeString16(token);
+    }, [&] (Parcel* p) {
+        std::u16string_view s;
+        EXPECT_EQ(OK, p->readString16View(&s));
+        EXPECT_EQ(u"asdf", s);
+        EXPECT_EQ(p->data() + sizeof(int32_t), reinterpret_cast<const uint8_t*>(s.data()));
+    });
+}
+
+TEST(Parcel, String8ViewRead) {
+    parcelOpSameLength([&] (Parcel* p) {
+        p->writeString8(String8("asdf"));
+    }, [&] (Parcel* p) {
+        std::string_view s;
+        EXPECT_EQ(OK, p->readString8View(&s));
+        EXPECT_EQ("asdf", s);
+    });
+}
+
+TEST(Parcel, NullableStringViewRead) {
+    parcelOpSameLength([&] (Parcel* p) {
+        p->writeString16(nullptr, 0);
+    }, [&] (Parcel* p) {
+        std::optional<std::u16string_view> s = u"";
+        EXPECT_EQ(OK, p->readString16View(&s));
+        EXPECT_EQ(std::nullopt, s);
+    });
+    parcelOpSameLength([&] (Parcel* p) {
+        p->writeString16(String16("a"));
+    }, [&] (Parcel* p) {
+        std::optional<std::u16string_view> s;
+        EXPECT_EQ(OK, p->readString16View(&s));
+        EXPECT_EQ(u"a", s);
+    });
+
+    Parcel p;
+    p.writeString16(nullptr, 0);
+    p.setDataPosition(0);
+    std::u16string_view s;
+    EXPECT_EQ(UNEXPECTED_NULL, p.readString16View(&s));
+}
+
 template <typename T>
 using readFunc = status_t (Parcel::*)(T* out) const;
 template <typename T>
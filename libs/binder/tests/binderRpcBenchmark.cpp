@@ -44,6 +44,10 @@ class MyBinderRpcBenchmark : public BnBinderRpcBenchmark {
         *out = str;
         return Status::ok();
     }
+    Status repeatBytes(const std::vector<uint8_t>& bytes, std::vector<uint8_t>* out) override {
+        *out = bytes;
+        return Status::ok();
+    }
 };
 
 static sp<RpcSession> gSession = RpcSession::make();
@@ -94,6 +98,29 @@ void BM_repeatString(benchmark::State& state) {
 }
 BENCHMARK(BM_repeatString);
 
+void BM_throughputForTransactionOfSize(benchmark::State& state) {
+    sp<IBinder> binder = gSession->getRootObject();
+    CHECK(binder != nullptr);
+    sp<IBinderRpcBenchmark> iface = interface_cast<IBinderRpcBenchmark>(binder);
+    CHECK(iface != nullptr);
+
+    std::vector<uint8_t> bytes = std::vector<uint8_t>(state.range(0));
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = i % 256;
+    }
+
+    while (state.KeepRunning()) {
+        std::vector<uint8_t> out;
+        Status ret = iface->repeatBytes(bytes, &out);
+        CHECK(ret.isOk()) << ret;
+    }
+    // counts both directions
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(bytes.size()) * 2);
+}
+// RPC binder refuses to allocate more than 100kB for a single transaction, so
+// payloads beyond 64kB can't be measured yet.
+BENCHMARK(BM_throughputForTransactionOfSize)->RangeMultiplier(2)->Range(4 << 10, 64 << 10);
+
 void BM_repeatBinder(benchmark::State& state) {
     sp<IBinder> binder = gSession->getRootObject();
     CHECK(binder != nullptr);
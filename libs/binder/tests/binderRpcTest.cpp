@@ -37,6 +37,7 @@
 #include <sys/prctl.h>
 #include <unistd.h>
 
+#include "../RpcSharedMemory.h" // for RpcSharedMemory::kMinSize
 #include "../RpcState.h"   // for debugging
 #include "../vm_sockets.h" // for VMADDR_*
 
@@ -323,7 +324,8 @@ public:
     // threads.
     ProcessSession createRpcTestSocketServerProcess(
             size_t numThreads, size_t numSessions,
-            const std::function<void(const sp<RpcServer>&)>& configure) {
+            const std::function<void(const sp<RpcServer>&)>& configure,
+            bool multiplexed = false, bool eventLoop = false) {
         CHECK_GE(numSessions, 1) << "Must have at least one session to a server";
 
         SocketType socketType = GetParam();
@@ -339,6 +341,7 @@ public:
 
                     server->iUnderstandThisCodeIsExperimentalAndIWillNotUseItInProduction();
                     server->setMaxThreads(numThreads);
+                    server->setEventLoopEnabled(eventLoop);
 
                     unsigned int outPort = 0;
 
@@ -375,6 +378,7 @@ public:
 
         for (size_t i = 0; i < numSessions; i++) {
             sp<RpcSession> session = RpcSession::make();
+            session->setMultiplexed(multiplexed);
             switch (socketType) {
                 case SocketType::UNIX:
                     if (session->setupUnixDomainClient(addr.c_str())) goto success;
@@ -396,7 +400,9 @@ public:
     }
 
     BinderRpcTestProcessSession createRpcTestSocketServerProcess(size_t numThreads,
-                                                                 size_t numSessions = 1) {
+                                                                 size_t numSessions = 1,
+                                                                 bool multiplexed = false,
+                                                                 bool eventLoop = false) {
         BinderRpcTestProcessSession ret{
                 .proc = createRpcTestSocketServerProcess(numThreads, numSessions,
                                                          [&](const sp<RpcServer>& server) {
@@ -404,7 +410,8 @@ public:
                                                                      new MyBinderRpcTest;
                                                              server->setRootObject(service);
                                                              service->server = server;
-                                                         }),
+                                                         },
+                                                         multiplexed, eventLoop),
         };
 
         ret.rootBinder = ret.proc.sessions.at(0).root;
@@ -786,6 +793,60 @@ TEST_P(BinderRpc, ThreadPoolOverSaturated) {
     EXPECT_LE(epochMsAfter, epochMsBefore + 3 * kSleepMs);
 }
 
+TEST_P(BinderRpc, EventLoopServesNestedAndParallelCalls) {
+    constexpr size_t kNumThreads = 5;
+    constexpr size_t kSleepMs = 500;
+
+    auto proc = createRpcTestSocketServerProcess(kNumThreads, 2 /*sessions*/,
+                                                 false /*multiplexed*/, true /*eventLoop*/);
+
+    auto nastyNester = sp<MyBinderRpcTest>::make();
+    EXPECT_OK(proc.rootIface->nestMe(nastyNester, 10));
+
+    size_t epochMsBefore = epochMillis();
+
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ts.push_back(std::thread([&] { EXPECT_OK(proc.rootIface->sleepMs(kSleepMs)); }));
+    }
+
+    for (auto& t : ts) t.join();
+
+    size_t epochMsAfter = epochMillis();
+
+    EXPECT_GE(epochMsAfter, epochMsBefore + kSleepMs);
+
+    // Potential flake, but make sure calls are handled in parallel.
+    EXPECT_LE(epochMsAfter, epochMsBefore + 2 * kSleepMs);
+}
+
+TEST_P(BinderRpc, MultiplexedCallsRunInParallel) {
+    constexpr size_t kNumThreads = 10;
+    constexpr size_t kSleepMs = 500;
+
+    auto proc = createRpcTestSocketServerProcess(kNumThreads, 1 /*sessions*/,
+                                                 true /*multiplexed*/);
+
+    size_t epochMsBefore = epochMillis();
+
+    std::vector<std::thread> ts;
+    for (size_t i = 0; i < kNumThreads; i++) {
+        ts.push_back(std::thread([&] { EXPECT_OK(proc.rootIface->sleepMs(kSleepMs)); }));
+    }
+
+    // other calls overtake the sleeping ones on the same connection
+    EXPECT_EQ(OK, proc.rootBinder->pingBinder());
+
+    for (auto& t : ts) t.join();
+
+    size_t epochMsAfter = epochMillis();
+
+    EXPECT_GE(epochMsAfter, epochMsBefore + kSleepMs);
+
+    // Potential flake, but make sure calls are handled in parallel.
+    EXPECT_LE(epochMsAfter, epochMsBefore + 2 * kSleepMs);
+}
+
 TEST_P(BinderRpc, ThreadingStressTest) {
     constexpr size_t kNumClientThreads = 10;
     constexpr size_t kNumServerThreads = 10;
@@ -921,6 +982,34 @@ ssize_t countFds() {
     return ret;
 }
 
+TEST_P(BinderRpc, SharedMemoryBlobs) {
+    auto proc = createRpcTestSocketServerProcess(1);
+    sp<RpcSession> session = proc.proc.sessions.at(0).session;
+
+    if (GetParam() != SocketType::UNIX) {
+        EXPECT_EQ(INVALID_OPERATION, session->setupSharedMemory(RpcSharedMemory::kMinSize));
+        return;
+    }
+    ASSERT_EQ(OK, session->setupSharedMemory(RpcSharedMemory::kMinSize));
+    EXPECT_EQ(INVALID_OPERATION, session->setupSharedMemory(RpcSharedMemory::kMinSize));
+
+    // many times the size of the ring, so space must be reclaimed as the
+    // server frees each transaction
+    for (size_t i = 0; i < 64; i++) {
+        Parcel data;
+        data.markForBinder(proc.rootBinder);
+        Parcel::WritableBlob blob;
+        ASSERT_EQ(OK, data.writeBlob(20 * 1024, false, &blob));
+        memset(blob.data(), 'a', blob.size());
+        blob.release();
+
+        Parcel reply;
+        EXPECT_EQ(UNKNOWN_TRANSACTION, proc.rootBinder->transact(1337, data, &reply, 0));
+    }
+
+    EXPECT_EQ(OK, proc.rootBinder->pingBinder());
+}
+
 TEST_P(BinderRpc, Fds) {
     ssize_t beforeFds = countFds();
     ASSERT_GE(beforeFds, 0);
@@ -14,18 +14,23 @@
  * limitations under the License.
  */
 
-#include <android-base/parseint.h>
-#include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <binder/Binder.h>
+#include <fcntl.h>
 #include <sys/types.h>
-#include <fstream>
-#include <regex>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <string_view>
 
 #include <binderdebug/BinderDebug.h>
 
 namespace android {
 
-static std::string contextToString(BinderDebugContext context) {
+using base::unique_fd;
+
+static std::string_view contextToString(BinderDebugContext context) {
     switch (context) {
         case BinderDebugContext::BINDER:
             return "binder";
@@ -34,86 +39,291 @@ static std::string contextToString(BinderDebugContext context) {
         case BinderDebugContext::VNDBINDER:
             return "vndbinder";
         default:
-            return std::string();
+            return std::string_view();
     }
 }
 
-static status_t scanBinderContext(pid_t pid, const std::string& contextName,
-                                  std::function<void(const std::string&)> eachLine) {
-    std::ifstream ifs("/dev/binderfs/binder_logs/proc/" + std::to_string(pid));
-    if (!ifs.is_open()) {
-        ifs.open("/d/binder/proc/" + std::to_string(pid));
-        if (!ifs.is_open()) {
+// Reads all of 'path' into 'buffer', reusing its allocation. debugfs and
+// binderfs don't report a size for these files, so it grows as needed.
+static status_t readBinderLog(const std::string& path, std::string* buffer) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path.c_str(), O_RDONLY | O_CLOEXEC)));
+    if (!fd.ok()) {
+        return -errno;
+    }
+
+    constexpr size_t kMinRead = 16 * 1024;
+    size_t size = 0;
+    buffer->resize(std::max(buffer->capacity(), kMinRead));
+    while (true) {
+        if (buffer->size() - size < kMinRead) {
+            buffer->resize(buffer->size() * 2);
+        }
+        ssize_t n = TEMP_FAILURE_RETRY(read(fd.get(), buffer->data() + size, buffer->size() - size));
+        if (n < 0) {
             return -errno;
         }
+        if (n == 0) {
+            break;
+        }
+        size += n;
+    }
+    buffer->resize(size);
+    return OK;
+}
+
+static status_t readBinderLog(const std::string& binderfsPath, const std::string& debugfsPath,
+                              std::string* buffer) {
+    if (readBinderLog(binderfsPath, buffer) == OK) {
+        return OK;
     }
-    static const std::regex kContextLine("^context (\\w+)$");
+    return readBinderLog(debugfsPath, buffer);
+}
 
+static status_t readProcLog(pid_t pid, std::string* buffer) {
+    return readBinderLog("/dev/binderfs/binder_logs/proc/" + std::to_string(pid),
+                         "/d/binder/proc/" + std::to_string(pid), buffer);
+}
+
+static bool consume(std::string_view* s, std::string_view prefix) {
+    if (s->substr(0, prefix.size()) != prefix) return false;
+    s->remove_prefix(prefix.size());
+    return true;
+}
+
+// returns whether any whitespace was skipped
+static bool skipSpaces(std::string_view* s) {
+    size_t n = 0;
+    while (n < s->size() && ((*s)[n] == ' ' || (*s)[n] == '\t')) n++;
+    s->remove_prefix(n);
+    return n > 0;
+}
+
+static bool consumeUint(std::string_view* s, uint64_t base, uint64_t* out) {
+    uint64_t value = 0;
+    size_t n = 0;
+    for (; n < s->size(); n++) {
+        char c = (*s)[n];
+        uint64_t digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (base == 16 && c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            break;
+        }
+        if (value > (UINT64_MAX - digit) / base) return false;
+        value = value * base + digit;
+    }
+    if (n == 0) return false;
+    s->remove_prefix(n);
+    *out = value;
+    return true;
+}
+
+static bool consumePid(std::string_view* s, pid_t* out) {
+    uint64_t value;
+    if (!consumeUint(s, 10, &value) || value > INT32_MAX) return false;
+    *out = static_cast<pid_t>(value);
+    return true;
+}
+
+/**
+ * Calls 'eachLine(pid, line)' for every line of a binder log which belongs to
+ * 'contextName'. Works for both a per process log and the state log, which
+ * lists every process as "proc <pid>" followed by "context <name>".
+ */
+template <typename F>
+static void scanBinderContext(std::string_view log, std::string_view contextName, F eachLine) {
+    pid_t pid = -1;
     bool isDesiredContext = false;
-    std::string line;
-    std::smatch match;
-    while (getline(ifs, line)) {
-        if (std::regex_search(line, match, kContextLine)) {
-            isDesiredContext = match.str(1) == contextName;
+    while (!log.empty()) {
+        size_t end = log.find('\n');
+        std::string_view line = log.substr(0, end);
+        log.remove_prefix(end == std::string_view::npos ? log.size() : end + 1);
+
+        std::string_view rest = line;
+        if (consume(&rest, "proc ")) {
+            if (!consumePid(&rest, &pid) || !rest.empty()) pid = -1;
+            isDesiredContext = false;
+            continue;
+        }
+        if (consume(&rest, "context ")) {
+            isDesiredContext = rest == contextName;
             continue;
         }
-        if (!isDesiredContext) {
+        if (!isDesiredContext || pid < 0) {
             continue;
         }
-        eachLine(line);
+        eachLine(pid, line);
     }
-    return OK;
 }
 
-status_t getBinderPidInfo(BinderDebugContext context, pid_t pid, BinderPidInfo* pidInfo) {
-    std::smatch match;
-    static const std::regex kReferencePrefix("^\\s*node \\d+:\\s+u([0-9a-f]+)\\s+c([0-9a-f]+)\\s+");
-    static const std::regex kThreadPrefix("^\\s*thread \\d+:\\s+l\\s+(\\d)(\\d)");
-    std::string contextStr = contextToString(context);
-    status_t ret = scanBinderContext(pid, contextStr, [&](const std::string& line) {
-        if (std::regex_search(line, match, kReferencePrefix)) {
-            const std::string& ptrString = "0x" + match.str(2); // use number after c
-            uint64_t ptr;
-            if (!::android::base::ParseUint(ptrString.c_str(), &ptr)) {
-                // Should not reach here, but just be tolerant.
-                return;
-            }
-            const std::string proc = " proc ";
-            auto pos = line.rfind(proc);
-            if (pos != std::string::npos) {
-                for (const std::string& pidStr : base::Split(line.substr(pos + proc.size()), " ")) {
-                    int32_t pid;
-                    if (!::android::base::ParseInt(pidStr, &pid)) {
-                        return;
-                    }
-                    pidInfo->refPids[ptr].push_back(pid);
-                }
-            }
+// "  node 5: u0000007a3c01b030 c0000007a3c01b050 ... proc 1234 5678"
+static bool parseNodeLine(std::string_view line, uint64_t* outId, uint64_t* outCookie,
+                          std::string_view* outPids) {
+    skipSpaces(&line);
+    uint64_t ptr;
+    if (!consume(&line, "node ") || !consumeUint(&line, 10, outId) || !consume(&line, ":") ||
+        !skipSpaces(&line) || !consume(&line, "u") || !consumeUint(&line, 16, &ptr) ||
+        !skipSpaces(&line) || !consume(&line, "c") || !consumeUint(&line, 16, outCookie) ||
+        !skipSpaces(&line)) {
+        return false;
+    }
+    constexpr std::string_view kProc = " proc ";
+    size_t pos = line.rfind(kProc);
+    *outPids = pos == std::string_view::npos ? std::string_view() : line.substr(pos + kProc.size());
+    return true;
+}
 
+// Parses a space separated list of pids into 'pids', stopping at the first
+// malformed entry. Returns false if there was one.
+static bool appendPids(std::string_view list, std::vector<pid_t>* pids) {
+    while (!list.empty()) {
+        pid_t pid;
+        if (!consumePid(&list, &pid)) return false;
+        pids->push_back(pid);
+        if (!list.empty() && !consume(&list, " ")) return false;
+    }
+    return true;
+}
+
+static void parsePidInfoLine(std::string_view line, BinderPidInfo* pidInfo) {
+    uint64_t id;
+    uint64_t cookie;
+    std::string_view pids;
+    if (parseNodeLine(line, &id, &cookie, &pids)) {
+        if (!pids.empty()) {
+            appendPids(pids, &pidInfo->refPids[cookie]);
+        }
+        return;
+    }
+
+    // "  thread 1235: l 12 need_return 0 tr 0"
+    std::string_view rest = line;
+    skipSpaces(&rest);
+    if (consume(&rest, "thread ") && consumeUint(&rest, 10, &id) && consume(&rest, ":") &&
+        skipSpaces(&rest) && consume(&rest, "l") && skipSpaces(&rest) && rest.size() >= 2 &&
+        rest[0] >= '0' && rest[0] <= '9' && rest[1] >= '0' && rest[1] <= '9') {
+        // "1" is waiting in binder driver
+        // "2" is poll. It's impossible to tell if these are in use.
+        //     and HIDL default code doesn't use it.
+        bool isInUse = rest[0] != '1';
+        // "0" is a thread that has called into binder
+        // "1" is looper thread
+        // "2" is main looper thread
+        bool isBinderThread = rest[1] != '0';
+        if (!isBinderThread) {
             return;
         }
-        if (std::regex_search(line, match, kThreadPrefix)) {
-            // "1" is waiting in binder driver
-            // "2" is poll. It's impossible to tell if these are in use.
-            //     and HIDL default code doesn't use it.
-            bool isInUse = match.str(1) != "1";
-            // "0" is a thread that has called into binder
-            // "1" is looper thread
-            // "2" is main looper thread
-            bool isBinderThread = match.str(2) != "0";
-            if (!isBinderThread) {
-                return;
+        if (isInUse) {
+            pidInfo->threadUsage++;
+        }
+
+        pidInfo->threadCount++;
+    }
+}
+
+status_t getBinderPidInfo(BinderDebugContext context, pid_t pid, BinderPidInfo* pidInfo) {
+    std::string log;
+    if (status_t status = readProcLog(pid, &log); status != OK) {
+        return status;
+    }
+    scanBinderContext(log, contextToString(context), [&](pid_t, std::string_view line) {
+        parsePidInfoLine(line, pidInfo);
+    });
+    return OK;
+}
+
+status_t getBinderPidInfos(BinderDebugContext context, const std::vector<pid_t>& pids,
+                           std::map<pid_t, BinderPidInfo>* pidInfos) {
+    std::vector<pid_t> wanted = pids;
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+    if (wanted.empty()) {
+        return OK;
+    }
+
+    std::string log;
+    status_t status =
+            readBinderLog("/dev/binderfs/binder_logs/state", "/d/binder/state", &log);
+    if (status == OK) {
+        pid_t lastPid = -1;
+        BinderPidInfo* pidInfo = nullptr;
+        scanBinderContext(log, contextToString(context), [&](pid_t pid, std::string_view line) {
+            if (pid != lastPid) {
+                lastPid = pid;
+                pidInfo = std::binary_search(wanted.begin(), wanted.end(), pid)
+                        ? &(*pidInfos)[pid]
+                        : nullptr;
             }
-            if (isInUse) {
-                pidInfo->threadUsage++;
+            if (pidInfo != nullptr) {
+                parsePidInfoLine(line, pidInfo);
             }
+        });
+        return OK;
+    }
+
+    // the state log may be restricted where per process logs aren't
+    bool anyFound = false;
+    for (pid_t pid : wanted) {
+        BinderPidInfo pidInfo;
+        status_t pidStatus = readProcLog(pid, &log);
+        if (pidStatus != OK) {
+            status = pidStatus;
+            continue;
+        }
+        scanBinderContext(log, contextToString(context), [&](pid_t, std::string_view line) {
+            parsePidInfoLine(line, &pidInfo);
+        });
+        (*pidInfos)[pid] = std::move(pidInfo);
+        anyFound = true;
+    }
+    return anyFound ? OK : status;
+}
+
+status_t getBinderClientPids(BinderDebugContext context, pid_t pid, pid_t servicePid,
+                             int32_t handle, std::vector<pid_t>* pids) {
+    std::string_view contextStr = contextToString(context);
+    std::string log;
+    if (status_t status = readProcLog(pid, &log); status != OK) {
+        return status;
+    }
 
-            pidInfo->threadCount++;
+    // "  ref 6: desc 3 node 42 s 1 w 1 d 0000000000000000"
+    uint64_t node = 0;
+    bool foundNode = false;
+    scanBinderContext(log, contextStr, [&](pid_t, std::string_view line) {
+        if (foundNode) return;
+        uint64_t id;
+        uint64_t desc;
+        skipSpaces(&line);
+        if (!consume(&line, "ref ") || !consumeUint(&line, 10, &id) || !consume(&line, ":") ||
+            !skipSpaces(&line) || !consume(&line, "desc ") || !consumeUint(&line, 10, &desc) ||
+            !skipSpaces(&line)) {
             return;
         }
-        return;
+        if (desc != static_cast<uint64_t>(static_cast<uint32_t>(handle))) return;
+        consume(&line, "dead ");
+        if (consume(&line, "node ") && consumeUint(&line, 10, &node)) {
+            foundNode = true;
+        }
+    });
+    if (!foundNode) {
+        return NAME_NOT_FOUND;
+    }
+
+    if (status_t status = readProcLog(servicePid, &log); status != OK) {
+        return status;
+    }
+    scanBinderContext(log, contextStr, [&](pid_t, std::string_view line) {
+        uint64_t id;
+        uint64_t cookie;
+        std::string_view nodePids;
+        if (parseNodeLine(line, &id, &cookie, &nodePids) && id == node) {
+            appendPids(nodePids, pids);
+        }
     });
-    return ret;
+    return OK;
 }
 
 } // namespace  android
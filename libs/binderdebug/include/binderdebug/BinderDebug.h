@@ -15,6 +15,8 @@
  */
 #pragma once
 
+#include <sys/types.h>
+
 #include <map>
 #include <vector>
 
@@ -22,8 +24,8 @@ namespace android {
 
 struct BinderPidInfo {
     std::map<uint64_t, std::vector<pid_t>> refPids; // cookie -> processes which hold binder
-    uint32_t threadUsage;                           // number of threads in use
-    uint32_t threadCount;                           // number of threads total
+    uint32_t threadUsage = 0;                       // number of threads in use
+    uint32_t threadCount = 0;                       // number of threads total
 };
 
 enum class BinderDebugContext {
@@ -34,4 +36,22 @@ enum class BinderDebugContext {
 
 status_t getBinderPidInfo(BinderDebugContext context, pid_t pid, BinderPidInfo* pidInfo);
 
+/**
+ * Same as getBinderPidInfo, for many processes at once. This reads the
+ * driver's state log a single time, instead of one log per process, so it
+ * should be preferred when enumerating services across the device.
+ *
+ * Processes which are not found (e.g. they died, or never opened the driver)
+ * are left out of 'pidInfos'.
+ */
+status_t getBinderPidInfos(BinderDebugContext context, const std::vector<pid_t>& pids,
+                           std::map<pid_t, BinderPidInfo>* pidInfos);
+
+/**
+ * Finds the processes holding the binder which 'pid' knows as 'handle', and
+ * which is hosted by 'servicePid'.
+ */
+status_t getBinderClientPids(BinderDebugContext context, pid_t pid, pid_t servicePid,
+                             int32_t handle, std::vector<pid_t>* pids);
+
 } // namespace  android
@@ -60,6 +60,18 @@ TEST(BinderDebugTests, BinderThreads) {
     EXPECT_GE(pidInfo.threadCount, 1);
 }
 
+TEST(BinderDebugTests, BinderPidInfosMatchSingle) {
+    BinderPidInfo pidInfo;
+    ASSERT_EQ(OK, getBinderPidInfo(BinderDebugContext::BINDER, getpid(), &pidInfo));
+
+    std::map<pid_t, BinderPidInfo> pidInfos;
+    ASSERT_EQ(OK, getBinderPidInfos(BinderDebugContext::BINDER, {getpid(), getpid()}, &pidInfos));
+    ASSERT_EQ(1u, pidInfos.size());
+    const BinderPidInfo& batched = pidInfos.at(getpid());
+    EXPECT_EQ(pidInfo.refPids, batched.refPids);
+    EXPECT_EQ(pidInfo.threadCount, batched.threadCount);
+}
+
 extern "C" {
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
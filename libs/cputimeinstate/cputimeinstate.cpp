@@ -22,8 +22,12 @@
 #include <dirent.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <sys/sysinfo.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <mutex>
 #include <numeric>
 #include <optional>
@@ -336,6 +340,86 @@ static std::optional<bool> uidUpdatedSince(uint32_t uid, uint64_t lastUpdate,
     return true;
 }
 
+// Same as uidUpdatedSince, remembering the answer for each uid in cache, as a uid has one entry
+// per bucket in the time maps.
+static std::optional<bool> uidUpdatedSinceCached(uint32_t uid, uint64_t lastUpdate,
+                                                 uint64_t *newLastUpdate,
+                                                 std::unordered_map<uint32_t, bool> *cache) {
+    auto it = cache->find(uid);
+    if (it != cache->end()) return it->second;
+    auto uidUpdated = uidUpdatedSince(uid, lastUpdate, newLastUpdate);
+    if (uidUpdated.has_value()) cache->emplace(uid, *uidUpdated);
+    return uidUpdated;
+}
+
+// Number of entries read by each BPF_MAP_LOOKUP_BATCH command.
+static constexpr uint32_t kMapBatchSize = 256;
+// Whether BPF_MAP_LOOKUP_BATCH was found not to be supported, it needs a 5.6 kernel.
+static std::atomic<bool> gMapBatchUnsupported = false;
+
+static int lookupMapBatch(int mapFd, const uint64_t *inBatch, uint64_t *outBatch, void *keys,
+                          void *values, uint32_t *count) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.batch.in_batch = reinterpret_cast<uintptr_t>(inBatch);
+    attr.batch.out_batch = reinterpret_cast<uintptr_t>(outBatch);
+    attr.batch.keys = reinterpret_cast<uintptr_t>(keys);
+    attr.batch.values = reinterpret_cast<uintptr_t>(values);
+    attr.batch.count = *count;
+    attr.batch.map_fd = mapFd;
+    int ret = syscall(__NR_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr));
+    *count = attr.batch.count;
+    return ret;
+}
+
+// Read all the entries of a per-CPU map, values holds gNCpus values for each key. This takes
+// a few system calls per kMapBatchSize entries if the kernel supports BPF_MAP_LOOKUP_BATCH,
+// and two per entry if it doesn't.
+template <class Key, class Value>
+static bool readPerCpuMap(int mapFd, std::vector<Key> *keys, std::vector<Value> *values) {
+    // The kernel copies the value of each CPU rounded up to 8 bytes.
+    static_assert(sizeof(Value) % 8 == 0);
+    keys->clear();
+    values->clear();
+    if (!gMapBatchUnsupported) {
+        uint64_t inBatch, outBatch;
+        bool first = true;
+        while (true) {
+            size_t offset = keys->size();
+            keys->resize(offset + kMapBatchSize);
+            values->resize((offset + kMapBatchSize) * gNCpus);
+            uint32_t count = kMapBatchSize;
+            int ret = lookupMapBatch(mapFd, first ? nullptr : &inBatch, &outBatch,
+                                     keys->data() + offset, values->data() + offset * gNCpus,
+                                     &count);
+            int savedErrno = errno;
+            keys->resize(offset + count);
+            values->resize((offset + count) * gNCpus);
+            // ENOENT means that the last entries were read.
+            if (ret == 0 || savedErrno == ENOENT) {
+                if (ret) return true;
+                inBatch = outBatch;
+                first = false;
+                continue;
+            }
+            if (first && savedErrno == EINVAL) gMapBatchUnsupported = true;
+            break;
+        }
+        keys->clear();
+        values->clear();
+    }
+
+    Key key, prevKey;
+    if (getFirstMapKey(mapFd, &key)) return errno == ENOENT;
+    do {
+        size_t offset = keys->size();
+        values->resize((offset + 1) * gNCpus);
+        if (findMapEntry(mapFd, &key, values->data() + offset * gNCpus)) return false;
+        keys->push_back(key);
+    } while (prevKey = key, !getNextMapKey(mapFd, &prevKey, &key));
+    return errno == ENOENT;
+}
+
 // Retrieve the times in ns that each uid spent running at each CPU freq.
 // Return contains no value on error, otherwise it contains a map from uids to vectors of vectors
 // using the format:
@@ -353,25 +437,25 @@ getUidsCpuFreqTimes() {
 std::optional<std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>>>
 getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, std::vector<std::vector<uint64_t>>> map;
-    if (getFirstMapKey(gTisMapFd, &key)) {
-        if (errno == ENOENT) return map;
-        return std::nullopt;
-    }
+    std::vector<time_key_t> keys;
+    std::vector<tis_val_t> allVals;
+    if (!readPerCpuMap(gTisMapFd, &keys, &allVals)) return {};
 
     std::vector<std::vector<uint64_t>> mapFormat;
     for (const auto &freqList : gPolicyFreqs) mapFormat.emplace_back(freqList.size(), 0);
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    std::vector<tis_val_t> vals(gNCpus);
-    do {
+    std::unordered_map<uint32_t, bool> uidsUpdated;
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const time_key_t &key = keys[k];
+        const tis_val_t *vals = allVals.data() + k * gNCpus;
         if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
+            auto uidUpdated = uidUpdatedSinceCached(key.uid, *lastUpdate, &newLastUpdate,
+                                                    &uidsUpdated);
             if (!uidUpdated.has_value()) return {};
             if (!*uidUpdated) continue;
         }
-        if (findMapEntry(gTisMapFd, &key, vals.data())) return {};
         if (map.find(key.uid) == map.end()) map.emplace(key.uid, mapFormat);
 
         auto offset = key.bucket * FREQS_PER_ENTRY;
@@ -385,9 +469,7 @@ getUidsUpdatedCpuFreqTimes(uint64_t *lastUpdate) {
                 std::transform(begin, end, std::begin(vals[cpu].ar), begin, std::plus<uint64_t>());
             }
         }
-        prevKey = key;
-    } while (prevKey = key, !getNextMapKey(gTisMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    }
     if (lastUpdate && newLastUpdate > *lastUpdate) *lastUpdate = newLastUpdate;
     return map;
 }
@@ -463,28 +545,28 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsConcurrent
 std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedConcurrentTimes(
         uint64_t *lastUpdate) {
     if (!gInitialized && !initGlobals()) return {};
-    time_key_t key, prevKey;
     std::unordered_map<uint32_t, concurrent_time_t> ret;
-    if (getFirstMapKey(gConcurrentMapFd, &key)) {
-        if (errno == ENOENT) return ret;
-        return {};
-    }
+    std::vector<time_key_t> keys;
+    std::vector<concurrent_val_t> allVals;
+    if (!readPerCpuMap(gConcurrentMapFd, &keys, &allVals)) return {};
 
     concurrent_time_t retFormat = {.active = std::vector<uint64_t>(gNCpus, 0)};
     for (const auto &cpuList : gPolicyCpus) retFormat.policy.emplace_back(cpuList.size(), 0);
 
-    std::vector<concurrent_val_t> vals(gNCpus);
     std::vector<uint64_t>::iterator activeBegin, activeEnd, policyBegin, policyEnd;
 
     uint64_t newLastUpdate = lastUpdate ? *lastUpdate : 0;
-    do {
+    std::unordered_map<uint32_t, bool> uidsUpdated;
+    for (size_t k = 0; k < keys.size(); ++k) {
+        const time_key_t &key = keys[k];
+        const concurrent_val_t *vals = allVals.data() + k * gNCpus;
         if (key.bucket > (gNCpus - 1) / CPUS_PER_ENTRY) return {};
         if (lastUpdate) {
-            auto uidUpdated = uidUpdatedSince(key.uid, *lastUpdate, &newLastUpdate);
+            auto uidUpdated = uidUpdatedSinceCached(key.uid, *lastUpdate, &newLastUpdate,
+                                                    &uidsUpdated);
             if (!uidUpdated.has_value()) return {};
             if (!*uidUpdated) continue;
         }
-        if (findMapEntry(gConcurrentMapFd, &key, vals.data())) return {};
         if (ret.find(key.uid) == ret.end()) ret.emplace(key.uid, retFormat);
 
         auto offset = key.bucket * CPUS_PER_ENTRY;
@@ -509,8 +591,7 @@ std::optional<std::unordered_map<uint32_t, concurrent_time_t>> getUidsUpdatedCon
                                std::plus<uint64_t>());
             }
         }
-    } while (prevKey = key, !getNextMapKey(gConcurrentMapFd, &prevKey, &key));
-    if (errno != ENOENT) return {};
+    }
     for (const auto &[key, value] : ret) {
         if (!verifyConcurrentTimes(value)) {
             auto val = getUidConcurrentTimes(key, false);
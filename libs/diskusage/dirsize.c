@@ -17,7 +17,10 @@
 
 #include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 
 #include <diskusage/dirsize.h>
@@ -69,3 +72,273 @@ int64_t calculate_dir_size(int dfd)
     closedir(d);
     return size;
 }
+
+/*
+ * A directory walk shared by several threads. The directories that are still to be read are
+ * kept open in a queue, from which each thread takes the next one to read. Files with more
+ * than one link are only counted the first time one of their links is seen.
+ */
+
+/* Most directories kept open in the queue, the threads read the ones past it themselves. */
+#define MAX_QUEUED_DIRS 256
+
+#define GETDENTS_BUFFER_SIZE 32768
+
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct inode_key {
+    dev_t dev;
+    ino_t ino;
+};
+
+struct dir_walk {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    /* The open directories left to read. */
+    int queue[MAX_QUEUED_DIRS];
+    size_t queued;
+    /* The directories that are queued or being read. */
+    size_t pending;
+    int64_t size;
+    /* The walk stops once size is over the threshold, when it isn't negative. */
+    int64_t threshold;
+    int done;
+    /* Open addressing set of the files with several links that were already counted. */
+    struct inode_key *inodes;
+    size_t inode_count;
+    size_t inode_capacity;
+};
+
+static size_t hash_inode(dev_t dev, ino_t ino, size_t capacity)
+{
+    uint64_t h = ((uint64_t) dev * 0x9e3779b97f4a7c15ULL) ^ (uint64_t) ino;
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+    return h & (capacity - 1);
+}
+
+/* Returns 1 if the inode wasn't in the set yet. Must be called with the walk locked. */
+static int insert_inode_locked(struct dir_walk *walk, dev_t dev, ino_t ino)
+{
+    size_t i;
+
+    if ((walk->inode_count + 1) * 2 > walk->inode_capacity) {
+        size_t capacity = walk->inode_capacity ? walk->inode_capacity * 2 : 64;
+        struct inode_key *inodes = calloc(capacity, sizeof(*inodes));
+        if (inodes == NULL) {
+            /* Count the file again rather than not at all. */
+            return 1;
+        }
+        for (i = 0; i < walk->inode_capacity; i++) {
+            struct inode_key *key = &walk->inodes[i];
+            if (key->ino != 0) {
+                size_t j = hash_inode(key->dev, key->ino, capacity);
+                while (inodes[j].ino != 0) {
+                    j = (j + 1) & (capacity - 1);
+                }
+                inodes[j] = *key;
+            }
+        }
+        free(walk->inodes);
+        walk->inodes = inodes;
+        walk->inode_capacity = capacity;
+    }
+
+    /* Inode 0 is never used by a file, so it marks the free entries. */
+    i = hash_inode(dev, ino, walk->inode_capacity);
+    while (walk->inodes[i].ino != 0) {
+        if (walk->inodes[i].dev == dev && walk->inodes[i].ino == ino) {
+            return 0;
+        }
+        i = (i + 1) & (walk->inode_capacity - 1);
+    }
+    walk->inodes[i].dev = dev;
+    walk->inodes[i].ino = ino;
+    walk->inode_count++;
+    return 1;
+}
+
+/* Adds to the total size, and returns 1 if the walk is done. */
+static int add_size(struct dir_walk *walk, int64_t size)
+{
+    int done;
+
+    pthread_mutex_lock(&walk->lock);
+    walk->size += size;
+    if (walk->threshold >= 0 && walk->size > walk->threshold) {
+        walk->done = 1;
+        pthread_cond_broadcast(&walk->cond);
+    }
+    done = walk->done;
+    pthread_mutex_unlock(&walk->lock);
+    return done;
+}
+
+/* Reads the directory, and closes dfd. */
+static void walk_dir(struct dir_walk *walk, int dfd)
+{
+    /* Not on the stack, since the threads can read directories recursively. */
+    char *buf = malloc(GETDENTS_BUFFER_SIZE);
+    int64_t size = 0;
+    long n;
+    int done = 0;
+
+    if (buf == NULL) {
+        close(dfd);
+        return;
+    }
+
+    while (!done && (n = syscall(SYS_getdents64, dfd, buf, GETDENTS_BUFFER_SIZE)) > 0) {
+        long pos;
+        for (pos = 0; pos < n;) {
+            struct linux_dirent64 *de = (struct linux_dirent64 *) (buf + pos);
+            const char *name = de->d_name;
+            struct stat s;
+            int subfd;
+
+            pos += de->d_reclen;
+
+            /* always skip "." and ".." */
+            if (name[0] == '.') {
+                if (name[1] == 0)
+                    continue;
+                if ((name[1] == '.') && (name[2] == 0))
+                    continue;
+            }
+
+            if (fstatat(dfd, name, &s, AT_SYMLINK_NOFOLLOW) != 0) {
+                continue;
+            }
+            if (!S_ISDIR(s.st_mode)) {
+                int first = 1;
+                if (s.st_nlink > 1) {
+                    pthread_mutex_lock(&walk->lock);
+                    first = insert_inode_locked(walk, s.st_dev, s.st_ino);
+                    pthread_mutex_unlock(&walk->lock);
+                }
+                if (first) {
+                    size += stat_size(&s);
+                }
+                continue;
+            }
+
+            size += stat_size(&s);
+            subfd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (subfd < 0) {
+                continue;
+            }
+            pthread_mutex_lock(&walk->lock);
+            if (walk->queued < MAX_QUEUED_DIRS) {
+                walk->queue[walk->queued++] = subfd;
+                walk->pending++;
+                pthread_cond_signal(&walk->cond);
+                subfd = -1;
+            }
+            pthread_mutex_unlock(&walk->lock);
+            if (subfd >= 0) {
+                /* The queue is full, so the other threads have enough to read. */
+                done = add_size(walk, size);
+                size = 0;
+                if (!done) {
+                    walk_dir(walk, subfd);
+                } else {
+                    close(subfd);
+                }
+            }
+        }
+        if (!done) {
+            done = add_size(walk, size);
+            size = 0;
+        }
+    }
+    free(buf);
+    close(dfd);
+}
+
+static void *walk_thread(void *arg)
+{
+    struct dir_walk *walk = arg;
+
+    pthread_mutex_lock(&walk->lock);
+    for (;;) {
+        int dfd;
+
+        while (!walk->done && walk->queued == 0 && walk->pending > 0) {
+            pthread_cond_wait(&walk->cond, &walk->lock);
+        }
+        if (walk->done || walk->pending == 0) {
+            break;
+        }
+
+        dfd = walk->queue[--walk->queued];
+        pthread_mutex_unlock(&walk->lock);
+        walk_dir(walk, dfd);
+        pthread_mutex_lock(&walk->lock);
+
+        if (--walk->pending == 0) {
+            walk->done = 1;
+            pthread_cond_broadcast(&walk->cond);
+        }
+    }
+    pthread_mutex_unlock(&walk->lock);
+    return NULL;
+}
+
+static int64_t walk_dir_threaded(int dfd, int num_threads, int64_t threshold)
+{
+    struct dir_walk walk = {
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+        .cond = PTHREAD_COND_INITIALIZER,
+        .queue = {dfd},
+        .queued = 1,
+        .pending = 1,
+        .threshold = threshold,
+    };
+    pthread_t threads[MAX_DIR_SIZE_THREADS];
+    int started = 0;
+    int i;
+
+    if (num_threads > MAX_DIR_SIZE_THREADS) {
+        num_threads = MAX_DIR_SIZE_THREADS;
+    }
+    /* The calling thread is one of them. */
+    for (i = 1; i < num_threads; i++) {
+        if (pthread_create(&threads[started], NULL, walk_thread, &walk) == 0) {
+            started++;
+        }
+    }
+    walk_thread(&walk);
+    for (i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* The directories left when the walk stopped early. */
+    while (walk.queued > 0) {
+        close(walk.queue[--walk.queued]);
+    }
+    free(walk.inodes);
+    pthread_mutex_destroy(&walk.lock);
+    pthread_cond_destroy(&walk.cond);
+    return walk.size;
+}
+
+int64_t calculate_dir_size_threaded(int dfd, int num_threads)
+{
+    return walk_dir_threaded(dfd, num_threads, -1);
+}
+
+int is_dir_size_above(int dfd, int64_t threshold, int num_threads)
+{
+    if (threshold < 0) {
+        close(dfd);
+        return 1;
+    }
+    return walk_dir_threaded(dfd, num_threads, threshold) > threshold;
+}
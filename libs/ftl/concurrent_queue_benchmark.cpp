@@ -0,0 +1,104 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ftl/concurrent_queue.h>
+
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+constexpr int kBatch = 4096;
+constexpr std::size_t kCapacity = 256;
+
+// What the ftl queues replace: a mutex-guarded deque bounded to the same capacity.
+template <typename T>
+class MutexQueue {
+ public:
+  bool try_push(T value) {
+    std::lock_guard lock(mutex_);
+    if (queue_.size() == kCapacity) return false;
+    queue_.push_back(std::move(value));
+    return true;
+  }
+
+  std::optional<T> try_pop() {
+    std::lock_guard lock(mutex_);
+    if (queue_.empty()) return std::nullopt;
+    T value = std::move(queue_.front());
+    queue_.pop_front();
+    return value;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<T> queue_;
+};
+
+// Moves kBatch elements per iteration from the producer threads to the benchmark thread.
+template <typename Queue>
+void transfer(benchmark::State& state, Queue& queue, int producers) {
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+      threads.emplace_back([&queue, producers] {
+        for (int i = 0; i < kBatch / producers; i++) {
+          while (!queue.try_push(i)) std::this_thread::yield();
+        }
+      });
+    }
+
+    for (int popped = 0; popped < kBatch / producers * producers;) {
+      if (auto value = queue.try_pop()) {
+        benchmark::DoNotOptimize(*value);
+        popped++;
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    for (auto& thread : threads) thread.join();
+  }
+  state.SetItemsProcessed(state.iterations() * kBatch);
+}
+
+void BM_SpscQueue(benchmark::State& state) {
+  ftl::SpscQueue<int, kCapacity> queue;
+  transfer(state, queue, 1);
+}
+BENCHMARK(BM_SpscQueue)->UseRealTime();
+
+void BM_MpscQueue(benchmark::State& state) {
+  ftl::MpscQueue<int, kCapacity> queue;
+  transfer(state, queue, static_cast<int>(state.range(0)));
+}
+BENCHMARK(BM_MpscQueue)->Arg(1)->Arg(4)->UseRealTime();
+
+void BM_MutexQueue(benchmark::State& state) {
+  MutexQueue<int> queue;
+  transfer(state, queue, static_cast<int>(state.range(0)));
+}
+BENCHMARK(BM_MutexQueue)->Arg(1)->Arg(4)->UseRealTime();
+
+}  // namespace
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/concurrent_queue.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android::test {
+
+using ftl::MpscQueue;
+using ftl::SpscQueue;
+using ftl::UnboundedMpscQueue;
+
+// Keep in sync with example usage in header file.
+TEST(SpscQueue, Example) {
+  ftl::SpscQueue<int, 4> queue;
+  EXPECT_TRUE(queue.empty());
+
+  for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.try_push(i));
+  EXPECT_FALSE(queue.try_push(4));
+
+  EXPECT_EQ(queue.try_pop(), 0);
+  EXPECT_EQ(queue.try_pop(), 1);
+  EXPECT_EQ(queue.size(), 2u);
+}
+
+TEST(SpscQueue, WrapAround) {
+  SpscQueue<std::string, 2> queue;
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_TRUE(queue.try_emplace(static_cast<std::size_t>(i), 'x'));
+    EXPECT_TRUE(queue.try_push(std::to_string(i)));
+    EXPECT_FALSE(queue.try_push("full"));
+
+    EXPECT_EQ(queue.try_pop(), std::string(static_cast<std::size_t>(i), 'x'));
+    EXPECT_EQ(queue.try_pop(), std::to_string(i));
+    EXPECT_FALSE(queue.try_pop());
+  }
+}
+
+TEST(SpscQueue, MoveOnly) {
+  SpscQueue<std::unique_ptr<int>, 4> queue;
+  EXPECT_TRUE(queue.try_push(std::make_unique<int>(42)));
+
+  auto value = queue.try_pop();
+  ASSERT_TRUE(value);
+  EXPECT_EQ(**value, 42);
+}
+
+TEST(SpscQueue, DestroysRemainingElements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    SpscQueue<std::shared_ptr<int>, 8> queue;
+    EXPECT_TRUE(queue.try_push(counter));
+    EXPECT_TRUE(queue.try_push(counter));
+    EXPECT_EQ(counter.use_count(), 3);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(SpscQueue, Threads) {
+  constexpr int kCount = 100000;
+  SpscQueue<int, 64> queue;
+
+  std::thread producer([&queue] {
+    for (int i = 0; i < kCount; i++) {
+      while (!queue.try_push(i)) std::this_thread::yield();
+    }
+  });
+
+  for (int expected = 0; expected < kCount;) {
+    if (const auto value = queue.try_pop()) {
+      ASSERT_EQ(*value, expected);
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+// Keep in sync with example usage in header file.
+TEST(MpscQueue, Example) {
+  ftl::MpscQueue<std::string, 8> queue;
+
+  EXPECT_TRUE(queue.try_emplace(3u, '!'));
+  EXPECT_TRUE(queue.try_push("abc"));
+
+  EXPECT_EQ(queue.try_pop(), "!!!");
+  EXPECT_EQ(queue.try_pop(), "abc");
+  EXPECT_FALSE(queue.try_pop());
+}
+
+TEST(MpscQueue, Full) {
+  MpscQueue<int, 4> queue;
+
+  for (int lap = 0; lap < 3; lap++) {
+    for (int i = 0; i < 4; i++) EXPECT_TRUE(queue.try_push(i));
+    EXPECT_FALSE(queue.try_push(4));
+    EXPECT_EQ(queue.size(), 4u);
+
+    for (int i = 0; i < 4; i++) EXPECT_EQ(queue.try_pop(), i);
+    EXPECT_TRUE(queue.empty());
+  }
+}
+
+TEST(MpscQueue, DestroysRemainingElements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    MpscQueue<std::shared_ptr<int>, 8> queue;
+    EXPECT_TRUE(queue.try_push(counter));
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(MpscQueue, Threads) {
+  constexpr int kProducers = 4;
+  constexpr int kCount = 25000;
+  MpscQueue<std::pair<int, int>, 64> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&queue, p] {
+      for (int i = 0; i < kCount; i++) {
+        while (!queue.try_emplace(p, i)) std::this_thread::yield();
+      }
+    });
+  }
+
+  // Elements of each producer come out in order.
+  std::vector<int> next(kProducers, 0);
+  for (int popped = 0; popped < kProducers * kCount;) {
+    if (const auto value = queue.try_pop()) {
+      const auto [p, i] = *value;
+      ASSERT_EQ(i, next[p]);
+      next[p]++;
+      popped++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  for (auto& producer : producers) producer.join();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(next, std::vector<int>(kProducers, kCount));
+}
+
+// Keep in sync with example usage in header file.
+TEST(UnboundedMpscQueue, Example) {
+  ftl::UnboundedMpscQueue<std::string> queue;
+
+  queue.emplace(3u, '!');
+  queue.push("abc");
+
+  EXPECT_EQ(queue.size(), 2u);
+  EXPECT_EQ(*queue.peek(), "!!!");
+  EXPECT_EQ(queue.try_pop(), "!!!");
+  EXPECT_EQ(queue.try_pop(), "abc");
+  EXPECT_FALSE(queue.try_pop());
+}
+
+TEST(UnboundedMpscQueue, Grows) {
+  UnboundedMpscQueue<int> queue;
+  EXPECT_EQ(queue.peek(), nullptr);
+
+  for (int i = 0; i < 1000; i++) queue.push(i);
+  EXPECT_EQ(queue.size(), 1000u);
+
+  for (int i = 0; i < 1000; i++) EXPECT_EQ(queue.try_pop(), i);
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.peek(), nullptr);
+}
+
+TEST(UnboundedMpscQueue, DestroysRemainingElements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    UnboundedMpscQueue<std::shared_ptr<int>> queue;
+    queue.push(counter);
+    queue.push(counter);
+    EXPECT_TRUE(queue.try_pop());
+    EXPECT_EQ(counter.use_count(), 2);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(UnboundedMpscQueue, Threads) {
+  constexpr int kProducers = 4;
+  constexpr int kCount = 25000;
+  UnboundedMpscQueue<std::pair<int, int>> queue;
+
+  std::vector<std::thread> producers;
+  for (int p = 0; p < kProducers; p++) {
+    producers.emplace_back([&queue, p] {
+      for (int i = 0; i < kCount; i++) queue.emplace(p, i);
+    });
+  }
+
+  // Elements of each producer come out in order.
+  std::vector<int> next(kProducers, 0);
+  for (int popped = 0; popped < kProducers * kCount;) {
+    if (const auto value = queue.try_pop()) {
+      const auto [p, i] = *value;
+      ASSERT_EQ(i, next[p]);
+      next[p]++;
+      popped++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  for (auto& producer : producers) producer.join();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(next, std::vector<int>(kProducers, kCount));
+}
+
+}  // namespace android::test
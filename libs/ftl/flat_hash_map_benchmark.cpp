@@ -0,0 +1,89 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+#include <ftl/flat_hash_map.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+namespace {
+
+using FlatMap = ftl::FlatHashMap<std::uint64_t, int, 16>;
+using StdMap = std::unordered_map<std::uint64_t, int>;
+
+// Layer ids and the like: sparse keys rather than a dense range.
+std::vector<std::uint64_t> makeKeys(std::size_t count) {
+  std::vector<std::uint64_t> keys;
+  for (std::size_t i = 0; i < count; i++) keys.push_back(i * 7919 + 13);
+  return keys;
+}
+
+template <typename Map>
+void BM_Find(benchmark::State& state) {
+  const auto keys = makeKeys(static_cast<std::size_t>(state.range(0)));
+  Map map;
+  for (std::size_t i = 0; i < keys.size(); i++) map.try_emplace(keys[i], static_cast<int>(i));
+
+  for (auto _ : state) {
+    for (const auto key : keys) {
+      benchmark::DoNotOptimize(map.find(key));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Find, FlatMap)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_Find, StdMap)->RangeMultiplier(4)->Range(4, 1024);
+
+// Builds a map from scratch, as done every frame for per-layer bookkeeping.
+template <typename Map>
+void BM_Build(benchmark::State& state) {
+  const auto keys = makeKeys(static_cast<std::size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    Map map;
+    for (std::size_t i = 0; i < keys.size(); i++) map.try_emplace(keys[i], static_cast<int>(i));
+    benchmark::DoNotOptimize(map);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Build, FlatMap)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_Build, StdMap)->RangeMultiplier(4)->Range(4, 1024);
+
+// Erases and reinserts every key, which leaves tombstones behind in many open-addressing tables.
+template <typename Map>
+void BM_Churn(benchmark::State& state) {
+  const auto keys = makeKeys(static_cast<std::size_t>(state.range(0)));
+  Map map;
+  for (std::size_t i = 0; i < keys.size(); i++) map.try_emplace(keys[i], static_cast<int>(i));
+
+  for (auto _ : state) {
+    for (const auto key : keys) {
+      map.erase(key);
+      map.try_emplace(key, 0);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_Churn, FlatMap)->RangeMultiplier(4)->Range(4, 1024);
+BENCHMARK_TEMPLATE(BM_Churn, StdMap)->RangeMultiplier(4)->Range(4, 1024);
+
+}  // namespace
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/flat_hash_map.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace android::test {
+
+using ftl::FlatHashMap;
+
+// Keep in sync with example usage in header file.
+TEST(FlatHashMap, Example) {
+  ftl::FlatHashMap<int, std::string, 3> map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_FALSE(map.dynamic());
+
+  EXPECT_TRUE(map.try_emplace(123, "abc").second);
+  EXPECT_TRUE(map.try_emplace(-1).second);
+  EXPECT_TRUE(map.try_emplace(42, 3u, '?').second);
+  EXPECT_FALSE(map.try_emplace(42, "!!!").second);
+  EXPECT_EQ(map.size(), 3u);
+
+  EXPECT_TRUE(map.contains(123));
+  EXPECT_EQ(map.find(42)->get(), "???");
+
+  EXPECT_TRUE(map.erase(-1));
+  EXPECT_FALSE(map.contains(-1));
+
+  map[7] = "a";
+  EXPECT_FALSE(map.dynamic());
+
+  map[8] = "b";
+  EXPECT_TRUE(map.dynamic());
+  EXPECT_EQ(map.size(), 4u);
+}
+
+TEST(FlatHashMap, Find) {
+  FlatHashMap<std::string, int, 4> map;
+  EXPECT_FALSE(map.find("a"));
+
+  const auto [it, inserted] = map.try_emplace("a", 1);
+  EXPECT_TRUE(inserted);
+  EXPECT_EQ(it->first, "a");
+  EXPECT_EQ(it->second, 1);
+
+  const auto opt = map.find("a");
+  ASSERT_TRUE(opt);
+  opt->get() = 2;
+  EXPECT_EQ(std::as_const(map).find("a")->get(), 2);
+  EXPECT_FALSE(map.find("b"));
+
+  // try_emplace does not overwrite.
+  EXPECT_EQ(map.try_emplace("a", 3).first->second, 2);
+}
+
+TEST(FlatHashMap, Iterate) {
+  FlatHashMap<int, int, 8> map;
+  for (int i = 0; i < 20; i++) map[i] = i * i;
+
+  int count = 0;
+  for (const auto& [key, value] : map) {
+    EXPECT_EQ(value, key * key);
+    count++;
+  }
+  EXPECT_EQ(count, 20);
+
+  for (auto& [key, value] : map) value = -key;
+  for (auto it = map.cbegin(); it != map.cend(); ++it) EXPECT_EQ(it->second, -it->first);
+}
+
+TEST(FlatHashMap, Dynamic) {
+  FlatHashMap<int, char, 0> map;
+  EXPECT_FALSE(map.dynamic());
+  EXPECT_EQ(map.capacity(), 0u);
+  EXPECT_FALSE(map.contains(0));
+  EXPECT_FALSE(map.erase(0));
+
+  map[0] = 'a';
+  EXPECT_TRUE(map.dynamic());
+  EXPECT_EQ(map.find(0), 'a');
+
+  map.reserve(100);
+  EXPECT_GE(map.capacity(), 100u);
+  EXPECT_EQ(map.find(0), 'a');
+}
+
+TEST(FlatHashMap, CopyAndMove) {
+  for (int size : {2, 20}) {
+    FlatHashMap<int, std::string, 4> map;
+    for (int i = 0; i < size; i++) map[i] = std::to_string(i);
+
+    FlatHashMap<int, std::string, 4> copy = map;
+    EXPECT_EQ(copy.size(), map.size());
+    EXPECT_EQ(copy.dynamic(), map.dynamic());
+
+    FlatHashMap<int, std::string, 4> moved = std::move(copy);
+    EXPECT_TRUE(copy.empty());
+    EXPECT_FALSE(copy.dynamic());
+    EXPECT_EQ(moved.size(), map.size());
+
+    copy = moved;
+    moved = std::move(map);
+    for (int i = 0; i < size; i++) {
+      EXPECT_EQ(copy.find(i)->get(), std::to_string(i));
+      EXPECT_EQ(moved.find(i)->get(), std::to_string(i));
+    }
+  }
+}
+
+TEST(FlatHashMap, DestroysValues) {
+  auto counter = std::make_shared<int>(0);
+  {
+    FlatHashMap<int, std::shared_ptr<int>, 2> map;
+    for (int i = 0; i < 10; i++) map[i] = counter;
+    EXPECT_EQ(counter.use_count(), 11);
+
+    EXPECT_TRUE(map.erase(3));
+    EXPECT_EQ(counter.use_count(), 10);
+
+    map.clear();
+    EXPECT_TRUE(map.empty());
+    EXPECT_EQ(counter.use_count(), 1);
+
+    map[0] = counter;
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+// Sends every key to the same home slot, so that erasure has to shift back long probe sequences.
+struct CollidingHash {
+  std::size_t operator()(int key) const { return static_cast<std::size_t>(key % 3); }
+};
+
+template <typename Map>
+void checkRandomOperations(Map& map, int range, int iterations) {
+  std::map<int, int> reference;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> keys(0, range);
+
+  for (int i = 0; i < iterations; i++) {
+    const int key = keys(random);
+    if (random() % 3 == 0) {
+      EXPECT_EQ(map.erase(key), reference.erase(key) > 0);
+    } else {
+      EXPECT_EQ(map.try_emplace(key, i).second, reference.emplace(key, i).second);
+    }
+
+    ASSERT_EQ(map.size(), reference.size());
+    for (const auto& [k, v] : reference) {
+      ASSERT_EQ(map.find(k), v) << "key " << k << " at iteration " << i;
+    }
+  }
+}
+
+TEST(FlatHashMap, RandomOperations) {
+  FlatHashMap<int, int, 4> map;
+  checkRandomOperations(map, 200, 2000);
+}
+
+TEST(FlatHashMap, Collisions) {
+  FlatHashMap<int, int, 16, CollidingHash> map;
+  checkRandomOperations(map, 40, 2000);
+}
+
+}  // namespace android::test
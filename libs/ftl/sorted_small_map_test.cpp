@@ -0,0 +1,133 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <ftl/sorted_small_map.h>
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std::literals;
+
+namespace android::test {
+
+using ftl::SortedSmallMap;
+
+// Keep in sync with example usage in header file.
+TEST(SortedSmallMap, Example) {
+  ftl::SortedSmallMap<std::string, int, 2> map = {{"b", 2}, {"a", 1}};
+  EXPECT_EQ(map.size(), 2u);
+  EXPECT_FALSE(map.dynamic());
+
+  EXPECT_TRUE(map.try_emplace("c", 3).second);
+  EXPECT_FALSE(map.try_emplace("a", 0).second);
+  EXPECT_TRUE(map.dynamic());
+
+  EXPECT_TRUE(map.contains("b"sv));
+  EXPECT_EQ(map.find("c"sv), 3);
+
+  EXPECT_EQ(map.begin()->first, "a");
+  EXPECT_TRUE(map.erase("b"sv));
+  EXPECT_EQ(map.size(), 2u);
+}
+
+TEST(SortedSmallMap, Order) {
+  SortedSmallMap<int, char, 4> map = {{3, 'c'}, {1, 'a'}, {4, 'd'}, {1, 'x'}, {5, 'e'}, {2, 'b'}};
+  EXPECT_EQ(map.size(), 5u);
+  EXPECT_TRUE(map.dynamic());
+
+  std::vector<int> keys;
+  std::string values;
+  for (const auto [key, value] : map) {
+    keys.push_back(key);
+    values.push_back(value);
+  }
+  EXPECT_EQ(keys, (std::vector{1, 2, 3, 4, 5}));
+  EXPECT_EQ(values, "abcde");
+
+  EXPECT_EQ(map.lower_bound(3)->first, 3);
+  EXPECT_EQ(map.lower_bound(0)->first, 1);
+  EXPECT_EQ(map.lower_bound(6), map.end());
+}
+
+TEST(SortedSmallMap, Find) {
+  SortedSmallMap<int, std::string, 2> map;
+  EXPECT_FALSE(map.find(1));
+  EXPECT_FALSE(map.contains(1));
+
+  map[1] = "one";
+  map[2];
+  EXPECT_EQ(map.find(1)->get(), "one");
+  EXPECT_TRUE(std::as_const(map).find(2)->get().empty());
+
+  map.find(2)->get() = "two";
+  EXPECT_EQ(std::as_const(map).find(2)->get(), "two");
+
+  for (auto [key, value] : map) value += '!';
+  EXPECT_EQ(map.find(1)->get(), "one!");
+  EXPECT_EQ(map.find(2)->get(), "two!");
+}
+
+// Compares with std::less<std::string>, so lookups have to construct a key.
+TEST(SortedSmallMap, OpaqueCompare) {
+  SortedSmallMap<std::string, int, 4, std::less<std::string>> map = {{"x", 1}, {"y", 2}};
+  EXPECT_TRUE(map.contains("x"));
+  EXPECT_EQ(map.find("y"), 2);
+  EXPECT_TRUE(map.erase("x"));
+  EXPECT_FALSE(map.contains("x"));
+}
+
+TEST(SortedSmallMap, Equality) {
+  SortedSmallMap<int, int, 3> map = {{1, 1}, {2, 2}};
+  SortedSmallMap<int, int, 3> other = {{2, 2}, {1, 1}};
+  EXPECT_EQ(map, other);
+
+  other[3] = 3;
+  EXPECT_NE(map, other);
+
+  other.erase(3);
+  EXPECT_EQ(map, other);
+
+  other.clear();
+  EXPECT_TRUE(other.empty());
+}
+
+TEST(SortedSmallMap, RandomOperations) {
+  SortedSmallMap<int, int, 8> map;
+  std::map<int, int> reference;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<int> keys(0, 100);
+
+  for (int i = 0; i < 2000; i++) {
+    const int key = keys(random);
+    if (random() % 3 == 0) {
+      EXPECT_EQ(map.erase(key), reference.erase(key) > 0);
+    } else {
+      EXPECT_EQ(map.try_emplace(key, i).second, reference.emplace(key, i).second);
+    }
+
+    ASSERT_EQ(map.size(), reference.size());
+    ASSERT_TRUE(std::equal(map.begin(), map.end(), reference.begin(), reference.end(),
+                           [](const auto& lhs, const auto& rhs) {
+                             return lhs.first == rhs.first && lhs.second == rhs.second;
+                           }));
+  }
+}
+
+}  // namespace android::test
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "libgralloctypes"
 
+#include <algorithm>
 #include <cstring>
 #include <cinttypes>
 #include <limits>
@@ -153,6 +154,34 @@ public:
         return NO_ERROR;
     }
 
+    status_t decode(hardware::hidl_string* string, size_t size) {
+        if (!mVec || hasAdditionOverflow(mOffset, size) || mOffset + size > mVec->size()) {
+            return BAD_VALUE;
+        }
+
+        string->setTo(reinterpret_cast<const char*>(mVec->data() + mOffset), size);
+
+        mOffset += size;
+        return NO_ERROR;
+    }
+
+    /**
+     * Consumes size bytes of the byte stream if they are the same as data, without copying them
+     * out of the hidl_vec.
+     */
+    status_t compare(const uint8_t* data, size_t size) {
+        if (!mVec || hasAdditionOverflow(mOffset, size) || mOffset + size > mVec->size()) {
+            return BAD_VALUE;
+        }
+
+        if (!std::equal(data, data + size, mVec->data() + mOffset)) {
+            return BAD_VALUE;
+        }
+
+        mOffset += size;
+        return NO_ERROR;
+    }
+
     bool hasRemainingData() {
         if (!mVec) {
             return false;
@@ -322,7 +351,7 @@ status_t decodeOptionalMetadata(const MetadataType& metadataType, const hidl_vec
     T tmp;
     status_t err = decodeMetadata(metadataType, input, &tmp, decodeHelper);
     if (!err) {
-        *output = tmp;
+        *output = std::move(tmp);
     }
     return err;
 }
@@ -386,6 +415,23 @@ status_t decodeString(InputHidlVec* input, std::string* output) {
     return input->decode(output, size);
 }
 
+status_t decodeHidlString(InputHidlVec* input, hardware::hidl_string* output) {
+    if (!output) {
+        return BAD_VALUE;
+    }
+
+    int64_t size = 0;
+    status_t err = decodeInteger<int64_t>(input, &size);
+    if (err) {
+        return err;
+    }
+    if (size < 0) {
+        return BAD_VALUE;
+    }
+
+    return input->decode(output, size);
+}
+
 status_t encodeByteVector(const std::vector<uint8_t>& input, OutputHidlVec* output) {
     if (!output) {
         return BAD_VALUE;
@@ -468,35 +514,33 @@ status_t encodeMetadataType(const MetadataType& input, OutputHidlVec* output) {
     return NO_ERROR;
 }
 
-status_t decodeMetadataType(InputHidlVec* input, MetadataType* output) {
-    std::string name;
-    status_t err = decodeString(input, &name);
+/**
+ * Every decoded metadata starts with its type, so it is compared in place with the expected type
+ * instead of being decoded into a MetadataType, which would copy its name twice.
+ */
+status_t validateMetadataType(InputHidlVec* input, const MetadataType& expectedMetadataType) {
+    int64_t nameSize = 0;
+    status_t err = decodeInteger<int64_t>(input, &nameSize);
     if (err) {
         return err;
     }
-    output->name = name;
+    if (nameSize != static_cast<int64_t>(expectedMetadataType.name.size())) {
+        return BAD_VALUE;
+    }
 
-    err = decodeInteger<int64_t>(input, &output->value);
+    err = input->compare(reinterpret_cast<const uint8_t*>(expectedMetadataType.name.c_str()),
+                         nameSize);
     if (err) {
         return err;
     }
 
-    return NO_ERROR;
-}
-
-status_t validateMetadataType(InputHidlVec* input, const MetadataType& expectedMetadataType) {
-    MetadataType receivedMetadataType;
-
-    status_t err = decodeMetadataType(input, &receivedMetadataType);
+    int64_t value = 0;
+    err = decodeInteger<int64_t>(input, &value);
     if (err) {
         return err;
     }
 
-    if (expectedMetadataType.name != receivedMetadataType.name) {
-        return BAD_VALUE;
-    }
-
-    if (receivedMetadataType.value != expectedMetadataType.value) {
+    if (value != expectedMetadataType.value) {
         return BAD_VALUE;
     }
 
@@ -589,12 +633,10 @@ status_t encodeBufferDescriptorInfoHelper(const BufferDescriptorInfo& input,
 }
 
 status_t decodeBufferDescriptorInfoHelper(InputHidlVec* input, BufferDescriptorInfo* output) {
-    std::string name;
-    status_t err = decodeString(input, &name);
+    status_t err = decodeHidlString(input, &output->name);
     if (err) {
         return err;
     }
-    output->name = name;
 
     err = decodeInteger<uint32_t>(input, &output->width);
     if (err) {
@@ -800,10 +842,14 @@ status_t decodePlaneLayoutsHelper(InputHidlVec* inputHidlVec, std::vector<PlaneL
     if (err) {
         return err;
     }
-    if (size < 0) {
+    // Each plane layout takes at least its component count and its eight fields, which bounds
+    // how many the remaining bytes can hold before reserving room for them.
+    constexpr size_t kMinPlaneLayoutSize = 9 * sizeof(int64_t);
+    if (size < 0 || size > inputHidlVec->getRemainingSize() / kMinPlaneLayoutSize) {
         return BAD_VALUE;
     }
 
+    outPlaneLayouts->reserve(outPlaneLayouts->size() + size);
     for (size_t i = 0; i < size; i++) {
         outPlaneLayouts->emplace_back();
         err = decodePlaneLayout(inputHidlVec, &outPlaneLayouts->back());
@@ -843,10 +889,12 @@ status_t decodeCropHelper(InputHidlVec* inputHidlVec, std::vector<Rect>* outCrop
     if (err) {
         return err;
     }
-    if (size < 0) {
+    constexpr size_t kRectSize = 4 * sizeof(int32_t);
+    if (size < 0 || size > inputHidlVec->getRemainingSize() / kRectSize) {
         return BAD_VALUE;
     }
 
+    outCrops->reserve(outCrops->size() + size);
     for (size_t i = 0; i < size; i++) {
         outCrops->emplace_back();
         err = decodeRect(inputHidlVec, &outCrops->back());
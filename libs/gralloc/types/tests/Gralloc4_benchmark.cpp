@@ -0,0 +1,209 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <gralloctypes/Gralloc4.h>
+
+using android::hardware::hidl_vec;
+
+using aidl::android::hardware::graphics::common::Dataspace;
+using aidl::android::hardware::graphics::common::PlaneLayout;
+using aidl::android::hardware::graphics::common::PlaneLayoutComponent;
+using aidl::android::hardware::graphics::common::Rect;
+using aidl::android::hardware::graphics::common::Smpte2086;
+
+using BufferDescriptorInfo =
+        android::hardware::graphics::mapper::V4_0::IMapper::BufferDescriptorInfo;
+
+namespace android {
+
+namespace {
+
+PlaneLayoutComponent makeComponent(
+        const aidl::android::hardware::graphics::common::ExtendableType& type,
+        int64_t offsetInBits) {
+    PlaneLayoutComponent component;
+    component.type = type;
+    component.offsetInBits = offsetInBits;
+    component.sizeInBits = 8;
+    return component;
+}
+
+std::vector<Rect> makeCrop() {
+    Rect crop;
+    crop.left = 0;
+    crop.top = 0;
+    crop.right = 1920;
+    crop.bottom = 1080;
+    return {crop};
+}
+
+// The plane layouts of a 1080p YCbCr 4:2:0 buffer with interleaved chroma, as mappers report
+// them for video frames.
+std::vector<PlaneLayout> makeYCbCr420PlaneLayouts() {
+    constexpr int64_t kWidth = 1920;
+    constexpr int64_t kHeight = 1080;
+
+    PlaneLayout y;
+    y.components.push_back(makeComponent(gralloc4::PlaneLayoutComponentType_Y, 0));
+    y.offsetInBytes = 0;
+    y.sampleIncrementInBits = 8;
+    y.strideInBytes = kWidth;
+    y.widthInSamples = kWidth;
+    y.heightInSamples = kHeight;
+    y.totalSizeInBytes = kWidth * kHeight;
+    y.horizontalSubsampling = 1;
+    y.verticalSubsampling = 1;
+
+    PlaneLayout cbcr;
+    cbcr.components.push_back(makeComponent(gralloc4::PlaneLayoutComponentType_CB, 0));
+    cbcr.components.push_back(makeComponent(gralloc4::PlaneLayoutComponentType_CR, 8));
+    cbcr.offsetInBytes = y.totalSizeInBytes;
+    cbcr.sampleIncrementInBits = 16;
+    cbcr.strideInBytes = kWidth;
+    cbcr.widthInSamples = kWidth / 2;
+    cbcr.heightInSamples = kHeight / 2;
+    cbcr.totalSizeInBytes = kWidth * kHeight / 2;
+    cbcr.horizontalSubsampling = 2;
+    cbcr.verticalSubsampling = 2;
+
+    return {y, cbcr};
+}
+
+Smpte2086 makeSmpte2086() {
+    Smpte2086 smpte2086;
+    smpte2086.primaryRed.x = 0.708f;
+    smpte2086.primaryRed.y = 0.292f;
+    smpte2086.primaryGreen.x = 0.170f;
+    smpte2086.primaryGreen.y = 0.797f;
+    smpte2086.primaryBlue.x = 0.131f;
+    smpte2086.primaryBlue.y = 0.046f;
+    smpte2086.whitePoint.x = 0.3127f;
+    smpte2086.whitePoint.y = 0.3290f;
+    smpte2086.maxLuminance = 1000.0f;
+    smpte2086.minLuminance = 0.0001f;
+    return smpte2086;
+}
+
+template <class T>
+using EncodeFunction = status_t (*)(const T&, hidl_vec<uint8_t>*);
+
+template <class T>
+using DecodeFunction = status_t (*)(const hidl_vec<uint8_t>&, T*);
+
+template <class T>
+void benchmarkEncode(benchmark::State& state, const T& input, EncodeFunction<T> encode) {
+    for (auto _ : state) {
+        hidl_vec<uint8_t> vec;
+        if (encode(input, &vec) != NO_ERROR) {
+            state.SkipWithError("Could not encode the metadata");
+            break;
+        }
+        benchmark::DoNotOptimize(vec.data());
+    }
+}
+
+template <class T>
+void benchmarkDecode(benchmark::State& state, const T& input, EncodeFunction<T> encode,
+                     DecodeFunction<T> decode) {
+    hidl_vec<uint8_t> vec;
+    if (encode(input, &vec) != NO_ERROR) {
+        state.SkipWithError("Could not encode the metadata");
+        return;
+    }
+    for (auto _ : state) {
+        T output;
+        if (decode(vec, &output) != NO_ERROR) {
+            state.SkipWithError("Could not decode the metadata");
+            break;
+        }
+        benchmark::DoNotOptimize(&output);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * vec.size()));
+}
+
+void BM_EncodePlaneLayouts(benchmark::State& state) {
+    benchmarkEncode(state, makeYCbCr420PlaneLayouts(), gralloc4::encodePlaneLayouts);
+}
+BENCHMARK(BM_EncodePlaneLayouts);
+
+void BM_DecodePlaneLayouts(benchmark::State& state) {
+    benchmarkDecode(state, makeYCbCr420PlaneLayouts(), gralloc4::encodePlaneLayouts,
+                    gralloc4::decodePlaneLayouts);
+}
+BENCHMARK(BM_DecodePlaneLayouts);
+
+void BM_EncodeDataspace(benchmark::State& state) {
+    benchmarkEncode(state, Dataspace::BT2020_ITU_PQ, gralloc4::encodeDataspace);
+}
+BENCHMARK(BM_EncodeDataspace);
+
+void BM_DecodeDataspace(benchmark::State& state) {
+    benchmarkDecode(state, Dataspace::BT2020_ITU_PQ, gralloc4::encodeDataspace,
+                    gralloc4::decodeDataspace);
+}
+BENCHMARK(BM_DecodeDataspace);
+
+void BM_EncodeSmpte2086(benchmark::State& state) {
+    benchmarkEncode(state, std::optional<Smpte2086>(makeSmpte2086()), gralloc4::encodeSmpte2086);
+}
+BENCHMARK(BM_EncodeSmpte2086);
+
+void BM_DecodeSmpte2086(benchmark::State& state) {
+    benchmarkDecode(state, std::optional<Smpte2086>(makeSmpte2086()), gralloc4::encodeSmpte2086,
+                    gralloc4::decodeSmpte2086);
+}
+BENCHMARK(BM_DecodeSmpte2086);
+
+void BM_EncodeCrop(benchmark::State& state) {
+    benchmarkEncode(state, makeCrop(), gralloc4::encodeCrop);
+}
+BENCHMARK(BM_EncodeCrop);
+
+void BM_DecodeCrop(benchmark::State& state) {
+    benchmarkDecode(state, makeCrop(), gralloc4::encodeCrop, gralloc4::decodeCrop);
+}
+BENCHMARK(BM_DecodeCrop);
+
+BufferDescriptorInfo makeBufferDescriptorInfo() {
+    BufferDescriptorInfo info;
+    info.name = "SurfaceView[com.example.video/com.example.video.PlayerActivity]#0";
+    info.width = 1920;
+    info.height = 1080;
+    info.layerCount = 1;
+    info.format = hardware::graphics::common::V1_2::PixelFormat::YCBCR_420_888;
+    info.usage = static_cast<uint64_t>(hardware::graphics::common::V1_2::BufferUsage::GPU_TEXTURE);
+    info.reservedSize = 0;
+    return info;
+}
+
+void BM_EncodeBufferDescriptorInfo(benchmark::State& state) {
+    benchmarkEncode(state, makeBufferDescriptorInfo(), gralloc4::encodeBufferDescriptorInfo);
+}
+BENCHMARK(BM_EncodeBufferDescriptorInfo);
+
+void BM_DecodeBufferDescriptorInfo(benchmark::State& state) {
+    benchmarkDecode(state, makeBufferDescriptorInfo(), gralloc4::encodeBufferDescriptorInfo,
+                    gralloc4::decodeBufferDescriptorInfo);
+}
+BENCHMARK(BM_DecodeBufferDescriptorInfo);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -16,6 +16,7 @@
 
 #define LOG_TAG "Gralloc4Test"
 
+#include <cstring>
 #include <limits>
 
 #include <gralloctypes/Gralloc4.h>
@@ -556,6 +557,32 @@ TEST_F(Gralloc4TestErrors, Gralloc4TestDecodeBadVec) {
     ASSERT_NE(NO_ERROR, gralloc4::decodeSmpte2094_40(vec, &smpte2094_40));
 }
 
+TEST_F(Gralloc4TestErrors, Gralloc4TestDecodeWrongMetadataType) {
+    hidl_vec<uint8_t> vec;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodeWidth(64, &vec));
+
+    uint64_t height;
+    ASSERT_NE(NO_ERROR, gralloc4::decodeHeight(vec, &height));
+}
+
+TEST_F(Gralloc4TestErrors, Gralloc4TestDecodeBadCount) {
+    // An empty list ends with its count, which is replaced by one that does not fit in the vec.
+    const int64_t badCount = std::numeric_limits<int64_t>::max() / 2;
+
+    hidl_vec<uint8_t> planeLayoutsVec;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodePlaneLayouts({}, &planeLayoutsVec));
+    memcpy(planeLayoutsVec.data() + planeLayoutsVec.size() - sizeof(badCount), &badCount,
+           sizeof(badCount));
+    std::vector<PlaneLayout> planeLayouts;
+    ASSERT_NE(NO_ERROR, gralloc4::decodePlaneLayouts(planeLayoutsVec, &planeLayouts));
+
+    hidl_vec<uint8_t> cropVec;
+    ASSERT_EQ(NO_ERROR, gralloc4::encodeCrop({}, &cropVec));
+    memcpy(cropVec.data() + cropVec.size() - sizeof(badCount), &badCount, sizeof(badCount));
+    std::vector<Rect> crops;
+    ASSERT_NE(NO_ERROR, gralloc4::decodeCrop(cropVec, &crops));
+}
+
 class Gralloc4TestHelpers : public testing::Test { };
 
 TEST_F(Gralloc4TestHelpers, Gralloc4TestIsStandard) {
@@ -33,6 +33,7 @@
 #include <log/log.h>
 #include <nativeloader/dlext_namespaces.h>
 #include <sys/prctl.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
 #include <memory>
@@ -143,6 +144,22 @@ void GraphicsEnv::setDriverPathAndSphalLibraries(const std::string path,
     mSphalLibraries = sphalLibraries;
 }
 
+void GraphicsEnv::preloadDriverNamespaceConfig() {
+    ATRACE_CALL();
+
+    std::lock_guard<std::mutex> lock(mNamespaceMutex);
+    loadSystemNativeLibrariesLocked();
+}
+
+void GraphicsEnv::loadSystemNativeLibrariesLocked() {
+    if (mSystemNativeLibrariesLoaded) {
+        return;
+    }
+    mSystemNativeLibrariesLoaded = true;
+    mLlndkLibraries = getSystemNativeLibraries(NativeLibrary::LLNDK);
+    mVndkspLibraries = getSystemNativeLibraries(NativeLibrary::VNDKSP);
+}
+
 void GraphicsEnv::hintActivityLaunch() {
     ATRACE_CALL();
 
@@ -449,20 +466,19 @@ void GraphicsEnv::setDebugLayersGLES(const std::string layers) {
 // Return true if all the required libraries from vndk and sphal namespace are
 // linked to the updatable gfx driver namespace correctly.
 bool GraphicsEnv::linkDriverNamespaceLocked(android_namespace_t* vndkNamespace) {
-    const std::string llndkLibraries = getSystemNativeLibraries(NativeLibrary::LLNDK);
-    if (llndkLibraries.empty()) {
+    loadSystemNativeLibrariesLocked();
+    if (mLlndkLibraries.empty()) {
         return false;
     }
-    if (!android_link_namespaces(mDriverNamespace, nullptr, llndkLibraries.c_str())) {
+    if (!android_link_namespaces(mDriverNamespace, nullptr, mLlndkLibraries.c_str())) {
         ALOGE("Failed to link default namespace[%s]", dlerror());
         return false;
     }
 
-    const std::string vndkspLibraries = getSystemNativeLibraries(NativeLibrary::VNDKSP);
-    if (vndkspLibraries.empty()) {
+    if (mVndkspLibraries.empty()) {
         return false;
     }
-    if (!android_link_namespaces(mDriverNamespace, vndkNamespace, vndkspLibraries.c_str())) {
+    if (!android_link_namespaces(mDriverNamespace, vndkNamespace, mVndkspLibraries.c_str())) {
         ALOGE("Failed to link vndk namespace[%s]", dlerror());
         return false;
     }
@@ -490,7 +506,7 @@ bool GraphicsEnv::linkDriverNamespaceLocked(android_namespace_t* vndkNamespace)
 android_namespace_t* GraphicsEnv::getDriverNamespace() {
     std::lock_guard<std::mutex> lock(mNamespaceMutex);
 
-    if (mDriverNamespace) {
+    if (mDriverNamespace || mDriverNamespaceFailed) {
         return mDriverNamespace;
     }
 
@@ -519,6 +535,11 @@ android_namespace_t* GraphicsEnv::getDriverNamespace() {
         ALOGI("Driver path is setup via UPDATABLE_GFX_DRIVER: %s", mDriverPath.c_str());
     }
 
+    // The driver path can't change anymore, so a failure below is final and isn't retried.
+    ATRACE_NAME("createDriverNamespace");
+    const nsecs_t start = systemTime();
+    mDriverNamespaceFailed = true;
+
     auto vndkNamespace = android_get_exported_namespace("vndk");
     if (!vndkNamespace) {
         return nullptr;
@@ -533,8 +554,11 @@ android_namespace_t* GraphicsEnv::getDriverNamespace() {
 
     if (!linkDriverNamespaceLocked(vndkNamespace)) {
         mDriverNamespace = nullptr;
+        return nullptr;
     }
 
+    mDriverNamespaceFailed = false;
+    ALOGD("Created updatable driver namespace in %.2fms", (systemTime() - start) / 1e6);
     return mDriverNamespace;
 }
 
@@ -554,6 +578,8 @@ android_namespace_t* GraphicsEnv::getAngleNamespace() {
         return nullptr;
     }
 
+    ATRACE_NAME("createAngleNamespace");
+    const nsecs_t start = systemTime();
     mAngleNamespace = android_create_namespace("ANGLE",
                                                nullptr,            // ld_library_path
                                                mAnglePath.c_str(), // default_library_path
@@ -562,6 +588,7 @@ android_namespace_t* GraphicsEnv::getAngleNamespace() {
                                                nullptr);
 
     ALOGD_IF(!mAngleNamespace, "Could not create ANGLE namespace from default");
+    ALOGD_IF(mAngleNamespace, "Created ANGLE namespace in %.2fms", (systemTime() - start) / 1e6);
 
     return mAngleNamespace;
 }
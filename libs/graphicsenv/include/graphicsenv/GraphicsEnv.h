@@ -56,6 +56,10 @@ public:
     // graphics drivers. The string is a list of libraries separated by ':',
     // which is required by android_link_namespaces.
     void setDriverPathAndSphalLibraries(const std::string path, const std::string sphalLibraries);
+    // Read the system library lists that the updatable driver namespace is linked against. The
+    // zygote calls this so that the processes it forks don't read them on their first GL or
+    // Vulkan call.
+    void preloadDriverNamespaceConfig();
     // Get the updatable driver namespace.
     android_namespace_t* getDriverNamespace();
     std::string getDriverPath() const;
@@ -130,6 +134,8 @@ private:
     void* loadLibrary(std::string name);
     // Update whether ANGLE should be used.
     void updateUseAngle();
+    // Read the llndk and vndk-sp library lists, once.
+    void loadSystemNativeLibrariesLocked();
     // Link updatable driver namespace with llndk and vndk-sp libs.
     bool linkDriverNamespaceLocked(android_namespace_t* vndkNamespace);
     // Check whether this process is ready to send stats.
@@ -168,6 +174,13 @@ private:
     std::mutex mNamespaceMutex;
     // Updatable driver namespace.
     android_namespace_t* mDriverNamespace = nullptr;
+    // Whether the updatable driver namespace creation failed, so that it isn't retried.
+    bool mDriverNamespaceFailed = false;
+    // Whether the llndk and vndk-sp library lists below have been read.
+    bool mSystemNativeLibrariesLoaded = false;
+    // The llndk and vndk-sp libraries, separated by ':'.
+    std::string mLlndkLibraries;
+    std::string mVndkspLibraries;
     // ANGLE namespace.
     android_namespace_t* mAngleNamespace = nullptr;
     // This App's namespace.
@@ -203,6 +203,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
                 mCore->mQueue.erase(front);
                 front = mCore->mQueue.begin();
             }
+            mCore->publishQueryStateLocked();
 
             // See if the front buffer is ready to be acquired
             nsecs_t desiredPresent = front->mTimestamp;
@@ -292,6 +293,7 @@ status_t BufferQueueConsumer::acquireBuffer(BufferItem* outBuffer,
         }
 
         mCore->mQueue.erase(front);
+        mCore->publishQueryStateLocked();
 
         // We might have freed a slot while dropping old buffers, or the producer
         // may be blocked waiting for the number of buffers in the queue to
@@ -549,6 +551,7 @@ status_t BufferQueueConsumer::disconnect() {
     mCore->mConsumerListener = nullptr;
     mCore->mQueue.clear();
     mCore->freeAllBuffersLocked();
+    mCore->publishQueryStateLocked();
     mCore->mSharedBufferSlot = BufferQueueCore::INVALID_BUFFER_SLOT;
     mCore->mDequeueCondition.notify_all();
     return NO_ERROR;
@@ -607,6 +610,7 @@ status_t BufferQueueConsumer::setDefaultBufferSize(uint32_t width,
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mDefaultWidth = width;
     mCore->mDefaultHeight = height;
+    mCore->publishQueryStateLocked();
     return NO_ERROR;
 }
 
@@ -703,6 +707,7 @@ status_t BufferQueueConsumer::setMaxAcquiredBufferCount(
 
         BQ_LOGV("setMaxAcquiredBufferCount: %d", maxAcquiredBuffers);
         mCore->mMaxAcquiredBufferCount = maxAcquiredBuffers;
+        mCore->publishQueryStateLocked();
         VALIDATE_CONSISTENCY();
         if (delta < 0 && mCore->mBufferReleasedCbEnabled) {
             listener = mCore->mConsumerListener;
@@ -730,6 +735,7 @@ status_t BufferQueueConsumer::setDefaultBufferFormat(PixelFormat defaultFormat)
     BQ_LOGV("setDefaultBufferFormat: %u", defaultFormat);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mDefaultBufferFormat = defaultFormat;
+    mCore->publishQueryStateLocked();
     return NO_ERROR;
 }
 
@@ -739,6 +745,7 @@ status_t BufferQueueConsumer::setDefaultBufferDataSpace(
     BQ_LOGV("setDefaultBufferDataSpace: %u", defaultDataSpace);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mDefaultBufferDataSpace = defaultDataSpace;
+    mCore->publishQueryStateLocked();
     return NO_ERROR;
 }
 
@@ -747,6 +754,7 @@ status_t BufferQueueConsumer::setConsumerUsageBits(uint64_t usage) {
     BQ_LOGV("setConsumerUsageBits: %#" PRIx64, usage);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mConsumerUsageBits = usage;
+    mCore->publishQueryStateLocked();
     return NO_ERROR;
 }
 
@@ -755,6 +763,7 @@ status_t BufferQueueConsumer::setConsumerIsProtected(bool isProtected) {
     BQ_LOGV("setConsumerIsProtected: %s", isProtected ? "true" : "false");
     std::lock_guard<std::mutex> lock(mCore->mMutex);
     mCore->mConsumerIsProtected = isProtected;
+    mCore->publishQueryStateLocked();
     return NO_ERROR;
 }
 
@@ -140,6 +140,7 @@ BufferQueueCore::BufferQueueCore()
             s++) {
         mUnusedSlots.push_front(s);
     }
+    publishQueryStateLocked();
 }
 
 BufferQueueCore::~BufferQueueCore() {}
@@ -176,6 +177,7 @@ void BufferQueueCore::dumpState(const String8& prefix, String8* outResult) const
     outResult->appendFormat("mId=%" PRIx64 ", producer=[%d:%s], consumer=[%d:%s])\n", mUniqueId,
                             mConnectedPid, producerProcName.string(), pid,
                             consumerProcName.string());
+    mOccupancyTracker.dumpOccupancyHistogram(prefix, outResult);
     Fifo::const_iterator current(mQueue.begin());
     while (current != mQueue.end()) {
         double timestamp = current->mTimestamp / 1e9;
@@ -232,6 +234,20 @@ int BufferQueueCore::getMinUndequeuedBufferCountLocked() const {
     return mMaxAcquiredBufferCount;
 }
 
+void BufferQueueCore::publishQueryStateLocked() {
+    constexpr auto kOrder = std::memory_order_relaxed;
+    mQueryState.isAbandoned.store(mIsAbandoned, kOrder);
+    mQueryState.defaultWidth.store(mDefaultWidth, kOrder);
+    mQueryState.defaultHeight.store(mDefaultHeight, kOrder);
+    mQueryState.defaultBufferFormat.store(mDefaultBufferFormat, kOrder);
+    mQueryState.defaultBufferDataSpace.store(mDefaultBufferDataSpace, kOrder);
+    mQueryState.consumerUsageBits.store(mConsumerUsageBits, kOrder);
+    mQueryState.consumerIsProtected.store(mConsumerIsProtected, kOrder);
+    mQueryState.minUndequeuedBufferCount.store(getMinUndequeuedBufferCountLocked(), kOrder);
+    mQueryState.consumerRunningBehind.store(mQueue.size() > 1, kOrder);
+    mQueryState.bufferAge.store(mBufferAge, kOrder);
+}
+
 int BufferQueueCore::getMinMaxBufferCountLocked() const {
     return getMinUndequeuedBufferCountLocked() + 1;
 }
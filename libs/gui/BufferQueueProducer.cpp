@@ -91,7 +91,24 @@ status_t BufferQueueProducer::requestBuffer(int slot, sp<GraphicBuffer>* buf) {
     ATRACE_CALL();
     BQ_LOGV("requestBuffer: slot %d", slot);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
+    return requestBufferLocked(slot, buf);
+}
 
+status_t BufferQueueProducer::requestBuffers(const std::vector<int32_t>& slots,
+        std::vector<RequestBufferOutput>* outputs) {
+    ATRACE_CALL();
+    BQ_LOGV("requestBuffers: %zu slots", slots.size());
+    outputs->clear();
+    outputs->reserve(slots.size());
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    for (int32_t slot : slots) {
+        RequestBufferOutput& output = outputs->emplace_back();
+        output.result = requestBufferLocked(static_cast<int>(slot), &output.buffer);
+    }
+    return NO_ERROR;
+}
+
+status_t BufferQueueProducer::requestBufferLocked(int slot, sp<GraphicBuffer>* buf) {
     if (mCore->mIsAbandoned) {
         BQ_LOGE("requestBuffer: BufferQueue has been abandoned");
         return NO_INIT;
@@ -239,6 +256,7 @@ status_t BufferQueueProducer::setAsyncMode(bool async) {
             return BAD_VALUE;
         }
         mCore->mAsyncMode = async;
+        mCore->publishQueryStateLocked();
         VALIDATE_CONSISTENCY();
         mCore->mDequeueCondition.notify_all();
         if (delta < 0) {
@@ -509,6 +527,7 @@ status_t BufferQueueProducer::dequeueBuffer(int* outSlot, sp<android::Fence>* ou
             // is queued
             mCore->mBufferAge = mCore->mFrameCounter + 1 - mSlots[found].mFrameNumber;
         }
+        mCore->publishQueryStateLocked();
 
         BQ_LOGV("dequeueBuffer: setting buffer age to %" PRIu64,
                 mCore->mBufferAge);
@@ -625,49 +644,40 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
     sp<IConsumerListener> listener;
     {
         std::lock_guard<std::mutex> lock(mCore->mMutex);
-
-        if (mCore->mIsAbandoned) {
-            BQ_LOGE("detachBuffer: BufferQueue has been abandoned");
-            return NO_INIT;
+        status_t result = detachBufferLocked(slot);
+        if (result != NO_ERROR) {
+            return result;
         }
+        listener = mCore->mConsumerListener;
+    }
 
-        if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
-            BQ_LOGE("detachBuffer: BufferQueue has no connected producer");
-            return NO_INIT;
-        }
+    if (listener != nullptr) {
+        listener->onBuffersReleased();
+    }
 
-        if (mCore->mSharedBufferMode || mCore->mSharedBufferSlot == slot) {
-            BQ_LOGE("detachBuffer: cannot detach a buffer in shared buffer mode");
-            return BAD_VALUE;
-        }
+    return NO_ERROR;
+}
 
-        if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
-            BQ_LOGE("detachBuffer: slot index %d out of range [0, %d)",
-                    slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
-            return BAD_VALUE;
-        } else if (!mSlots[slot].mBufferState.isDequeued()) {
-            BQ_LOGE("detachBuffer: slot %d is not owned by the producer "
-                    "(state = %s)", slot, mSlots[slot].mBufferState.string());
-            return BAD_VALUE;
-        } else if (!mSlots[slot].mRequestBufferCalled) {
-            BQ_LOGE("detachBuffer: buffer in slot %d has not been requested",
-                    slot);
-            return BAD_VALUE;
-        }
+status_t BufferQueueProducer::detachBuffers(const std::vector<int32_t>& slots,
+        std::vector<status_t>* results) {
+    ATRACE_CALL();
+    BQ_LOGV("detachBuffers: %zu slots", slots.size());
+    results->clear();
+    results->reserve(slots.size());
 
-        listener = mCore->mConsumerListener;
-        auto gb = mSlots[slot].mGraphicBuffer;
-        if (listener != nullptr && gb != nullptr) {
-            listener->onFrameDetached(gb->getId());
+    sp<IConsumerListener> listener;
+    {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
+        for (int32_t slot : slots) {
+            status_t result = detachBufferLocked(static_cast<int>(slot));
+            if (result == NO_ERROR) {
+                listener = mCore->mConsumerListener;
+            }
+            results->emplace_back(result);
         }
-        mSlots[slot].mBufferState.detachProducer();
-        mCore->mActiveBuffers.erase(slot);
-        mCore->mFreeSlots.insert(slot);
-        mCore->clearBufferSlotLocked(slot);
-        mCore->mDequeueCondition.notify_all();
-        VALIDATE_CONSISTENCY();
     }
 
+    // one callback covers every buffer released by the batch
     if (listener != nullptr) {
         listener->onBuffersReleased();
     }
@@ -675,6 +685,51 @@ status_t BufferQueueProducer::detachBuffer(int slot) {
     return NO_ERROR;
 }
 
+status_t BufferQueueProducer::detachBufferLocked(int slot) {
+    if (mCore->mIsAbandoned) {
+        BQ_LOGE("detachBuffer: BufferQueue has been abandoned");
+        return NO_INIT;
+    }
+
+    if (mCore->mConnectedApi == BufferQueueCore::NO_CONNECTED_API) {
+        BQ_LOGE("detachBuffer: BufferQueue has no connected producer");
+        return NO_INIT;
+    }
+
+    if (mCore->mSharedBufferMode || mCore->mSharedBufferSlot == slot) {
+        BQ_LOGE("detachBuffer: cannot detach a buffer in shared buffer mode");
+        return BAD_VALUE;
+    }
+
+    if (slot < 0 || slot >= BufferQueueDefs::NUM_BUFFER_SLOTS) {
+        BQ_LOGE("detachBuffer: slot index %d out of range [0, %d)",
+                slot, BufferQueueDefs::NUM_BUFFER_SLOTS);
+        return BAD_VALUE;
+    } else if (!mSlots[slot].mBufferState.isDequeued()) {
+        BQ_LOGE("detachBuffer: slot %d is not owned by the producer "
+                "(state = %s)", slot, mSlots[slot].mBufferState.string());
+        return BAD_VALUE;
+    } else if (!mSlots[slot].mRequestBufferCalled) {
+        BQ_LOGE("detachBuffer: buffer in slot %d has not been requested",
+                slot);
+        return BAD_VALUE;
+    }
+
+    const sp<IConsumerListener>& listener = mCore->mConsumerListener;
+    auto gb = mSlots[slot].mGraphicBuffer;
+    if (listener != nullptr && gb != nullptr) {
+        listener->onFrameDetached(gb->getId());
+    }
+    mSlots[slot].mBufferState.detachProducer();
+    mCore->mActiveBuffers.erase(slot);
+    mCore->mFreeSlots.insert(slot);
+    mCore->clearBufferSlotLocked(slot);
+    mCore->mDequeueCondition.notify_all();
+    VALIDATE_CONSISTENCY();
+
+    return NO_ERROR;
+}
+
 status_t BufferQueueProducer::detachNextBuffer(sp<GraphicBuffer>* outBuffer,
         sp<Fence>* outFence) {
     ATRACE_CALL();
@@ -936,7 +991,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
         item.mAutoRefresh = mCore->mSharedBufferMode && mCore->mAutoRefresh;
         item.mApi = mCore->mConnectedApi;
 
-        mStickyTransform = stickyTransform;
+        mStickyTransform.store(stickyTransform, std::memory_order_relaxed);
 
         // Cache the shared buffer data so that the BufferItem can be recreated.
         if (mCore->mSharedBufferMode) {
@@ -952,6 +1007,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
             // When the queue is empty, we can ignore mDequeueBufferCannotBlock
             // and simply queue this buffer
             mCore->mQueue.push_back(item);
+            mCore->publishQueryStateLocked();
             frameAvailableListener = mCore->mConsumerListener;
         } else {
             // When the queue is not empty, we need to look at the last buffer
@@ -992,6 +1048,7 @@ status_t BufferQueueProducer::queueBuffer(int slot,
                 frameReplacedListener = mCore->mConsumerListener;
             } else {
                 mCore->mQueue.push_back(item);
+                mCore->publishQueryStateLocked();
                 frameAvailableListener = mCore->mConsumerListener;
             }
         }
@@ -1079,7 +1136,23 @@ status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
     ATRACE_CALL();
     BQ_LOGV("cancelBuffer: slot %d", slot);
     std::lock_guard<std::mutex> lock(mCore->mMutex);
+    return cancelBufferLocked(slot, fence);
+}
 
+status_t BufferQueueProducer::cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+        std::vector<status_t>* results) {
+    ATRACE_CALL();
+    BQ_LOGV("cancelBuffers: %zu slots", inputs.size());
+    results->clear();
+    results->reserve(inputs.size());
+    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    for (const CancelBufferInput& input : inputs) {
+        results->emplace_back(cancelBufferLocked(input.slot, input.fence));
+    }
+    return NO_ERROR;
+}
+
+status_t BufferQueueProducer::cancelBufferLocked(int slot, const sp<Fence>& fence) {
     if (mCore->mIsAbandoned) {
         BQ_LOGE("cancelBuffer: BufferQueue has been abandoned");
         return NO_INIT;
@@ -1135,14 +1208,35 @@ status_t BufferQueueProducer::cancelBuffer(int slot, const sp<Fence>& fence) {
 
 int BufferQueueProducer::query(int what, int *outValue) {
     ATRACE_CALL();
-    std::lock_guard<std::mutex> lock(mCore->mMutex);
+    return queryLockFree(what, outValue);
+}
+
+status_t BufferQueueProducer::query(const std::vector<int32_t> inputs,
+        std::vector<QueryOutput>* outputs) {
+    ATRACE_CALL();
+    outputs->clear();
+    outputs->reserve(inputs.size());
+    for (int32_t input : inputs) {
+        QueryOutput& output = outputs->emplace_back();
+        int value{};
+        output.result = static_cast<status_t>(queryLockFree(static_cast<int>(input), &value));
+        output.value = static_cast<int64_t>(value);
+    }
+    return NO_ERROR;
+}
 
+int BufferQueueProducer::queryLockFree(int what, int *outValue) {
+    // mConsumerName, used by BQ_LOGE, is only stable under mMutex
     if (outValue == nullptr) {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
         BQ_LOGE("query: outValue was NULL");
         return BAD_VALUE;
     }
 
-    if (mCore->mIsAbandoned) {
+    const BufferQueueCore::QueryState& state = mCore->mQueryState;
+    constexpr auto kOrder = std::memory_order_relaxed;
+    if (state.isAbandoned.load(kOrder)) {
+        std::lock_guard<std::mutex> lock(mCore->mMutex);
         BQ_LOGE("query: BufferQueue has been abandoned");
         return NO_INIT;
     }
@@ -1150,49 +1244,50 @@ int BufferQueueProducer::query(int what, int *outValue) {
     int value;
     switch (what) {
         case NATIVE_WINDOW_WIDTH:
-            value = static_cast<int32_t>(mCore->mDefaultWidth);
+            value = static_cast<int32_t>(state.defaultWidth.load(kOrder));
             break;
         case NATIVE_WINDOW_HEIGHT:
-            value = static_cast<int32_t>(mCore->mDefaultHeight);
+            value = static_cast<int32_t>(state.defaultHeight.load(kOrder));
             break;
         case NATIVE_WINDOW_FORMAT:
-            value = static_cast<int32_t>(mCore->mDefaultBufferFormat);
+            value = state.defaultBufferFormat.load(kOrder);
             break;
         case NATIVE_WINDOW_LAYER_COUNT:
             // All BufferQueue buffers have a single layer.
             value = BQ_LAYER_COUNT;
             break;
         case NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS:
-            value = mCore->getMinUndequeuedBufferCountLocked();
+            value = state.minUndequeuedBufferCount.load(kOrder);
             break;
         case NATIVE_WINDOW_STICKY_TRANSFORM:
-            value = static_cast<int32_t>(mStickyTransform);
+            value = static_cast<int32_t>(mStickyTransform.load(kOrder));
             break;
         case NATIVE_WINDOW_CONSUMER_RUNNING_BEHIND:
-            value = (mCore->mQueue.size() > 1);
+            value = state.consumerRunningBehind.load(kOrder);
             break;
         case NATIVE_WINDOW_CONSUMER_USAGE_BITS:
             // deprecated; higher 32 bits are truncated
-            value = static_cast<int32_t>(mCore->mConsumerUsageBits);
+            value = static_cast<int32_t>(state.consumerUsageBits.load(kOrder));
             break;
         case NATIVE_WINDOW_DEFAULT_DATASPACE:
-            value = static_cast<int32_t>(mCore->mDefaultBufferDataSpace);
+            value = state.defaultBufferDataSpace.load(kOrder);
             break;
-        case NATIVE_WINDOW_BUFFER_AGE:
-            if (mCore->mBufferAge > INT32_MAX) {
+        case NATIVE_WINDOW_BUFFER_AGE: {
+            uint64_t bufferAge = state.bufferAge.load(kOrder);
+            if (bufferAge > INT32_MAX) {
                 value = 0;
             } else {
-                value = static_cast<int32_t>(mCore->mBufferAge);
+                value = static_cast<int32_t>(bufferAge);
             }
             break;
+        }
         case NATIVE_WINDOW_CONSUMER_IS_PROTECTED:
-            value = static_cast<int32_t>(mCore->mConsumerIsProtected);
+            value = static_cast<int32_t>(state.consumerIsProtected.load(kOrder));
             break;
         default:
             return BAD_VALUE;
     }
 
-    BQ_LOGV("query: %d? %d", what, value);
     *outValue = value;
     return NO_ERROR;
 }
@@ -1286,6 +1381,7 @@ status_t BufferQueueProducer::connect(const sp<IProducerListener>& listener,
         mCore->mDequeueBufferCannotBlock = mDequeueTimeout < 0;
         mCore->mQueueBufferCanDrop = mDequeueTimeout <= 0;
     }
+    mCore->publishQueryStateLocked();
 
     mCore->mAllowAllocation = true;
     VALIDATE_CONSISTENCY();
@@ -1579,6 +1675,7 @@ status_t BufferQueueProducer::setDequeueTimeout(nsecs_t timeout) {
 
     mDequeueTimeout = timeout;
     mCore->mDequeueBufferCannotBlock = dequeueBufferCannotBlock;
+    mCore->publishQueryStateLocked();
     if (timeout > 0) {
         mCore->mQueueBufferCanDrop = false;
     }
@@ -20,7 +20,10 @@
 
 #include <gui/CpuConsumer.h>
 
+#include <unistd.h>
+
 #include <gui/BufferItem.h>
+#include <ui/GraphicBufferMapper.h>
 #include <utils/Log.h>
 
 #define CC_LOGV(x, ...) ALOGV("[%s] " x, mName.string(), ##__VA_ARGS__)
@@ -59,6 +62,15 @@ static uintptr_t getLockedBufferId(const CpuConsumer::LockedBuffer& buffer) {
     return reinterpret_cast<uintptr_t>(buffer.data);
 }
 
+static void setFrameMetadata(const BufferItem& item, CpuConsumer::LockedBuffer* outBuffer) {
+    outBuffer->crop = item.mCrop;
+    outBuffer->transform = item.mTransform;
+    outBuffer->scalingMode = item.mScalingMode;
+    outBuffer->timestamp = item.mTimestamp;
+    outBuffer->dataSpace = item.mDataSpace;
+    outBuffer->frameNumber = item.mFrameNumber;
+}
+
 static bool isPossiblyYUV(PixelFormat format) {
     switch (static_cast<int>(format)) {
         case HAL_PIXEL_FORMAT_RGBA_8888:
@@ -138,16 +150,90 @@ status_t CpuConsumer::lockBufferItem(const BufferItem& item, LockedBuffer* outBu
     outBuffer->format = format;
     outBuffer->flexFormat = flexFormat;
 
-    outBuffer->crop = item.mCrop;
-    outBuffer->transform = item.mTransform;
-    outBuffer->scalingMode = item.mScalingMode;
-    outBuffer->timestamp = item.mTimestamp;
-    outBuffer->dataSpace = item.mDataSpace;
-    outBuffer->frameNumber = item.mFrameNumber;
+    setFrameMetadata(item, outBuffer);
+
+    return OK;
+}
+
+// Whether writes to the buffer may bypass the CPU caches, so that a mapping
+// kept across frames must be reread before its contents can be trusted.
+static bool needsReread(const sp<GraphicBuffer>& buffer) {
+    return (buffer->getUsage() &
+            ~static_cast<uint64_t>(GRALLOC_USAGE_SW_READ_MASK | GRALLOC_USAGE_SW_WRITE_MASK)) != 0;
+}
+
+status_t CpuConsumer::reuseMappedBufferLocked(const BufferItem& item, LockedBuffer* outBuffer) {
+    // The mapping was locked with an earlier acquire fence, so wait for this
+    // frame's here instead of handing it to gralloc.
+    if (item.mFence.get() && item.mFence->isValid()) {
+        status_t err = item.mFence->waitForever("CpuConsumer::lockNextBuffer");
+        if (err != OK) {
+            CC_LOGE("Failed to wait for acquire fence: %s (%d)", strerror(-err), err);
+            return err;
+        }
+    }
+
+    if (needsReread(item.mGraphicBuffer)) {
+        status_t err = GraphicBufferMapper::get().rereadLockedBuffer(item.mGraphicBuffer->handle);
+        if (err != OK) {
+            CC_LOGV("Unable to reread buffer in slot %d: %s (%d)", item.mSlot, strerror(-err),
+                    err);
+            return err;
+        }
+    }
 
+    *outBuffer = mMappedBuffers[item.mSlot].mLockedBuffer;
+    setFrameMetadata(item, outBuffer);
     return OK;
 }
 
+void CpuConsumer::unmapBufferLocked(int slot) {
+    MappedBuffer& mb = mMappedBuffers[slot];
+    if (mb.mGraphicBuffer == nullptr) {
+        return;
+    }
+    ALOG_ASSERT(!mb.mInUse);
+
+    // Nothing was written through a read only mapping, so the release fence
+    // doesn't need to be tracked.
+    int fenceFd = -1;
+    status_t err = mb.mGraphicBuffer->unlockAsync(&fenceFd);
+    if (err != OK) {
+        CC_LOGE("%s: Unable to unlock graphic buffer in slot %d", __FUNCTION__, slot);
+    }
+    if (fenceFd >= 0) {
+        close(fenceFd);
+    }
+    mb = MappedBuffer();
+}
+
+void CpuConsumer::setPersistentMapping(bool enabled) {
+    Mutex::Autolock _l(mMutex);
+    mPersistentMapping = enabled;
+    if (enabled) {
+        return;
+    }
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        if (mMappedBuffers[i].mInUse) {
+            // unlockBuffer will unmap it
+            continue;
+        }
+        unmapBufferLocked(i);
+    }
+}
+
+void CpuConsumer::freeBufferLocked(int slotIndex) {
+    MappedBuffer& mb = mMappedBuffers[slotIndex];
+    if (mb.mInUse) {
+        // Still acquired; forgetting the mapping makes unlockBuffer unlock
+        // the buffer it holds.
+        mb = MappedBuffer();
+    } else {
+        unmapBufferLocked(slotIndex);
+    }
+    ConsumerBase::freeBufferLocked(slotIndex);
+}
+
 status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
     status_t err;
 
@@ -176,9 +262,34 @@ status_t CpuConsumer::lockNextBuffer(LockedBuffer *nativeBuffer) {
         b.mGraphicBuffer = mSlots[b.mSlot].mGraphicBuffer;
     }
 
-    err = lockBufferItem(b, nativeBuffer);
-    if (err != OK) {
-        return err;
+    MappedBuffer& mb = mMappedBuffers[b.mSlot];
+    bool reused = false;
+    if (mb.mGraphicBuffer != nullptr) {
+        if (mPersistentMapping && mb.mGraphicBuffer == b.mGraphicBuffer && mb.mCrop == b.mCrop) {
+            err = reuseMappedBufferLocked(b, nativeBuffer);
+            if (err == INVALID_OPERATION) {
+                mRereadUnsupported = true;
+            }
+            reused = err == OK;
+        }
+        if (!reused) {
+            unmapBufferLocked(b.mSlot);
+        }
+    }
+
+    if (!reused) {
+        err = lockBufferItem(b, nativeBuffer);
+        if (err != OK) {
+            return err;
+        }
+        if (mPersistentMapping && !(mRereadUnsupported && needsReread(b.mGraphicBuffer))) {
+            mb.mGraphicBuffer = b.mGraphicBuffer;
+            mb.mCrop = b.mCrop;
+            mb.mLockedBuffer = *nativeBuffer;
+        }
+    }
+    if (mb.mGraphicBuffer != nullptr) {
+        mb.mInUse = true;
     }
 
     // find an unused AcquiredBuffer
@@ -208,6 +319,20 @@ status_t CpuConsumer::unlockBuffer(const LockedBuffer &nativeBuffer) {
 
     AcquiredBuffer& ab = mAcquiredBuffers.editItemAt(lockedIdx);
 
+    MappedBuffer& mb = mMappedBuffers[ab.mSlot];
+    if (mb.mInUse && mb.mGraphicBuffer == ab.mGraphicBuffer) {
+        mb.mInUse = false;
+        if (mPersistentMapping) {
+            // Keep it mapped for the next time this slot is acquired. Only
+            // the CPU read it, so there is no release fence.
+            releaseBufferLocked(ab.mSlot, ab.mGraphicBuffer);
+            ab.reset();
+            mCurrentLockedBuffers--;
+            return OK;
+        }
+        mb = MappedBuffer();
+    }
+
     int fenceFd = -1;
     status_t err = ab.mGraphicBuffer->unlockAsync(&fenceFd);
     if (err != OK) {
@@ -40,6 +40,16 @@ DisplayEventDispatcher::DisplayEventDispatcher(
     ALOGV("dispatcher %p ~ Initializing display event dispatcher.", this);
 }
 
+status_t DisplayEventDispatcher::useVsyncRing() {
+    status_t result = mReceiver.enableVsyncRing();
+    if (result) {
+        ALOGW("Failed to enable the vsync ring, status=%d", result);
+        return result;
+    }
+    mUseVsyncRing = true;
+    return OK;
+}
+
 status_t DisplayEventDispatcher::initialize() {
     status_t result = mReceiver.initCheck();
     if (result) {
@@ -52,6 +62,13 @@ status_t DisplayEventDispatcher::initialize() {
         if (rc < 0) {
             return UNKNOWN_ERROR;
         }
+        if (mUseVsyncRing) {
+            rc = mLooper->addFd(mReceiver.getVsyncFd(), 0, Looper::EVENT_INPUT, this, NULL);
+            if (rc < 0) {
+                mLooper->removeFd(mReceiver.getFd());
+                return UNKNOWN_ERROR;
+            }
+        }
     }
 
     return OK;
@@ -62,6 +79,9 @@ void DisplayEventDispatcher::dispose() {
 
     if (!mReceiver.initCheck() && mLooper != nullptr) {
         mLooper->removeFd(mReceiver.getFd());
+        if (mUseVsyncRing) {
+            mLooper->removeFd(mReceiver.getVsyncFd());
+        }
     }
 }
 
@@ -78,6 +98,9 @@ status_t DisplayEventDispatcher::scheduleVsync() {
             ALOGE("dispatcher %p ~ last event processed while scheduling was for %" PRId64 "", this,
                   ns2ms(static_cast<nsecs_t>(vsyncTimestamp)));
         }
+        // Stale vsyncs in the ring are skipped by consuming its sequence, no need to
+        // read the doorbell.
+        processLatestVsync(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount, &vsyncEventData);
 
         status_t status = mReceiver.requestNextVsync();
         if (status) {
@@ -98,7 +121,7 @@ int DisplayEventDispatcher::getFd() const {
     return mReceiver.getFd();
 }
 
-int DisplayEventDispatcher::handleEvent(int, int events, void*) {
+int DisplayEventDispatcher::handleEvent(int receiveFd, int events, void*) {
     if (events & (Looper::EVENT_ERROR | Looper::EVENT_HANGUP)) {
         ALOGE("Display event receiver pipe was closed or an error occurred.  "
               "events=0x%x",
@@ -118,7 +141,16 @@ int DisplayEventDispatcher::handleEvent(int, int events, void*) {
     PhysicalDisplayId vsyncDisplayId;
     uint32_t vsyncCount;
     VsyncEventData vsyncEventData;
-    if (processPendingEvents(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount, &vsyncEventData)) {
+    bool gotVsync;
+    if (mUseVsyncRing && receiveFd == mReceiver.getVsyncFd()) {
+        mReceiver.clearVsyncFd();
+        gotVsync = processLatestVsync(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount,
+                                      &vsyncEventData);
+    } else {
+        gotVsync = processPendingEvents(&vsyncTimestamp, &vsyncDisplayId, &vsyncCount,
+                                        &vsyncEventData);
+    }
+    if (gotVsync) {
         ALOGV("dispatcher %p ~ Vsync pulse: timestamp=%" PRId64
               ", displayId=%s, count=%d, vsyncId=%" PRId64,
               this, ns2ms(vsyncTimestamp), to_string(vsyncDisplayId).c_str(), vsyncCount,
@@ -130,6 +162,32 @@ int DisplayEventDispatcher::handleEvent(int, int events, void*) {
     return 1; // keep the callback
 }
 
+bool DisplayEventDispatcher::processLatestVsync(nsecs_t* outTimestamp,
+                                                PhysicalDisplayId* outDisplayId,
+                                                uint32_t* outCount,
+                                                VsyncEventData* outVsyncEventData) {
+    if (!mUseVsyncRing) {
+        return false;
+    }
+
+    DisplayEventReceiver::Event ev;
+    uint64_t sequence;
+    if (mReceiver.getLatestVsync(&ev, &sequence) != OK || sequence == mLastVsyncSequence) {
+        return false;
+    }
+    ALOGV_IF(sequence - mLastVsyncSequence > 1, "dispatcher %p ~ Skipped %" PRIu64 " vsyncs.",
+             this, sequence - mLastVsyncSequence - 1);
+    mLastVsyncSequence = sequence;
+
+    *outTimestamp = ev.header.timestamp;
+    *outDisplayId = ev.header.displayId;
+    *outCount = ev.vsync.count;
+    outVsyncEventData->id = ev.vsync.vsyncId;
+    outVsyncEventData->deadlineTimestamp = ev.vsync.deadlineTimestamp;
+    outVsyncEventData->frameInterval = ev.vsync.frameInterval;
+    return true;
+}
+
 bool DisplayEventDispatcher::processPendingEvents(nsecs_t* outTimestamp,
                                                   PhysicalDisplayId* outDisplayId,
                                                   uint32_t* outCount,
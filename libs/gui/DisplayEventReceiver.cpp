@@ -25,6 +25,7 @@
 #include <private/gui/ComposerService.h>
 
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncRing.h>
 
 // ---------------------------------------------------------------------------
 
@@ -80,6 +81,47 @@ status_t DisplayEventReceiver::requestNextVsync() {
     return NO_INIT;
 }
 
+status_t DisplayEventReceiver::enableVsyncRing() {
+    if (mEventConnection == nullptr) {
+        return NO_INIT;
+    }
+    if (mVsyncRing != nullptr) {
+        return NO_ERROR;
+    }
+
+    auto ring = std::make_unique<gui::VsyncRing>();
+    status_t result = mEventConnection->getVsyncRing(ring.get());
+    if (result != NO_ERROR) {
+        return result;
+    }
+    result = ring->initCheck();
+    if (result != NO_ERROR) {
+        return result;
+    }
+    mVsyncRing = std::move(ring);
+    return NO_ERROR;
+}
+
+int DisplayEventReceiver::getVsyncFd() const {
+    if (mVsyncRing == nullptr)
+        return NO_INIT;
+
+    return mVsyncRing->getDoorbellFd();
+}
+
+status_t DisplayEventReceiver::getLatestVsync(Event* outEvent, uint64_t* outSequence) const {
+    if (mVsyncRing == nullptr)
+        return NO_INIT;
+
+    return mVsyncRing->readLatest(outEvent, outSequence);
+}
+
+void DisplayEventReceiver::clearVsyncFd() {
+    if (mVsyncRing != nullptr) {
+        mVsyncRing->clearDoorbell();
+    }
+}
+
 ssize_t DisplayEventReceiver::getEvents(DisplayEventReceiver::Event* events,
         size_t count) {
     return DisplayEventReceiver::getEvents(mDataChannel.get(), events, count);
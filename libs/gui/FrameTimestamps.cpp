@@ -337,6 +337,9 @@ void ProducerFrameEventHistory::applyFenceDelta(FenceTimeline* timeline,
         case FenceTime::Snapshot::State::SIGNAL_TIME:
             if ((*dst)->isValid()) {
                 (*dst)->applyTrustedSnapshot(src);
+            } else if (src.signalTime == Fence::SIGNAL_TIME_INVALID) {
+                // Equivalent, without allocating a FenceTime per frame.
+                *dst = FenceTime::NO_FENCE;
             } else {
                 *dst = std::make_shared<FenceTime>(src.signalTime);
             }
@@ -498,6 +501,60 @@ void ConsumerFrameEventHistory::getAndResetDelta(
 // FrameEventsDelta
 // ============================================================================
 
+namespace {
+
+// Prefers the signal time over the fence, so fences which have already
+// signaled don't need to be sent.
+FenceTime::Snapshot getResolvedSnapshot(const std::shared_ptr<FenceTime>& fence) {
+    fence->getSignalTime();
+    return fence->getSnapshot();
+}
+
+// Layout of the uint16_t field mask which starts each flattened delta:
+//   bits 0-5:   which of the timestamps are set, see allTimestamps
+//   bit 6:      mAddPostCompositeCalled
+//   bit 7:      mAddReleaseCalled
+//   bits 8-13:  a FlatFenceState for each fence, see allFences
+//   bit 14:     times are flattened as 64 bit offsets
+constexpr uint16_t kAddPostCompositeCalledBit = 1 << 6;
+constexpr uint16_t kAddReleaseCalledBit = 1 << 7;
+constexpr int kFenceStateShift = 8;
+constexpr uint16_t kWideTimesBit = 1 << 14;
+constexpr uint16_t kKnownFieldBits = (1 << 15) - 1;
+
+enum FlatFenceState : uint16_t {
+    FLAT_FENCE_EMPTY = 0,
+    FLAT_FENCE_FENCE = 1,
+    FLAT_FENCE_SIGNAL_TIME = 2,
+    FLAT_FENCE_SIGNAL_TIME_INVALID = 3,
+};
+
+FlatFenceState getFlatFenceState(uint16_t fields, size_t fence) {
+    return static_cast<FlatFenceState>((fields >> (kFenceStateShift + 2 * fence)) & 3);
+}
+
+// After the first time, which is flattened whole, times are flattened as
+// offsets from it. The arithmetic wraps, so any time can round trip.
+uint64_t getTimeOffset(nsecs_t time, nsecs_t base) {
+    return static_cast<uint64_t>(time) - static_cast<uint64_t>(base);
+}
+
+bool isNarrowOffset(uint64_t offset) {
+    const int64_t signedOffset = static_cast<int64_t>(offset);
+    return signedOffset >= std::numeric_limits<int32_t>::min() &&
+            signedOffset <= std::numeric_limits<int32_t>::max();
+}
+
+size_t getFlattenedTimesSize(size_t count, uint16_t fields) {
+    if (count == 0) {
+        return 0;
+    }
+    return sizeof(nsecs_t) +
+            (count - 1) * ((fields & kWideTimesBit) ? sizeof(uint64_t) : sizeof(int32_t));
+}
+
+} // namespace
+
 FrameEventsDelta::FrameEventsDelta(
         size_t index,
         const FrameEvents& frameTimestamps,
@@ -514,37 +571,85 @@ FrameEventsDelta::FrameEventsDelta(
       mDequeueReadyTime(frameTimestamps.dequeueReadyTime) {
     if (dirtyFields.isDirty<FrameEvent::GPU_COMPOSITION_DONE>()) {
         mGpuCompositionDoneFence =
-                frameTimestamps.gpuCompositionDoneFence->getSnapshot();
+                getResolvedSnapshot(frameTimestamps.gpuCompositionDoneFence);
     }
     if (dirtyFields.isDirty<FrameEvent::DISPLAY_PRESENT>()) {
         mDisplayPresentFence =
-                frameTimestamps.displayPresentFence->getSnapshot();
+                getResolvedSnapshot(frameTimestamps.displayPresentFence);
     }
     if (dirtyFields.isDirty<FrameEvent::RELEASE>()) {
-        mReleaseFence = frameTimestamps.releaseFence->getSnapshot();
+        mReleaseFence = getResolvedSnapshot(frameTimestamps.releaseFence);
     }
 }
 
 constexpr size_t FrameEventsDelta::minFlattenedSize() {
     return sizeof(FrameEventsDelta::mFrameNumber) +
             sizeof(uint16_t) + // mIndex
-            sizeof(uint8_t) + // mAddPostCompositeCalled
-            sizeof(uint8_t) + // mAddReleaseCalled
-            sizeof(FrameEventsDelta::mPostedTime) +
-            sizeof(FrameEventsDelta::mRequestedPresentTime) +
-            sizeof(FrameEventsDelta::mLatchTime) +
-            sizeof(FrameEventsDelta::mFirstRefreshStartTime) +
-            sizeof(FrameEventsDelta::mLastRefreshStartTime) +
-            sizeof(FrameEventsDelta::mDequeueReadyTime);
+            sizeof(uint16_t); // field mask
+}
+
+size_t FrameEventsDelta::getFlattenedTimes(std::array<nsecs_t, 9>* times,
+                                           uint16_t* fields) const {
+    size_t count = 0;
+    *fields = 0;
+
+    auto timestamps = allTimestamps(this);
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        if (*timestamps[i] != FrameEvents::TIMESTAMP_PENDING) {
+            *fields |= 1 << i;
+            (*times)[count++] = *timestamps[i];
+        }
+    }
+    if (mAddPostCompositeCalled) {
+        *fields |= kAddPostCompositeCalledBit;
+    }
+    if (mAddReleaseCalled) {
+        *fields |= kAddReleaseCalledBit;
+    }
+
+    auto fences = allFences(this);
+    for (size_t i = 0; i < fences.size(); i++) {
+        FlatFenceState state = FLAT_FENCE_EMPTY;
+        switch (fences[i]->state) {
+            case FenceTime::Snapshot::State::EMPTY:
+                break;
+            case FenceTime::Snapshot::State::FENCE:
+                state = FLAT_FENCE_FENCE;
+                break;
+            case FenceTime::Snapshot::State::SIGNAL_TIME:
+                if (fences[i]->signalTime == Fence::SIGNAL_TIME_INVALID) {
+                    state = FLAT_FENCE_SIGNAL_TIME_INVALID;
+                } else {
+                    state = FLAT_FENCE_SIGNAL_TIME;
+                    (*times)[count++] = fences[i]->signalTime;
+                }
+                break;
+        }
+        *fields |= state << (kFenceStateShift + 2 * i);
+    }
+
+    for (size_t i = 1; i < count; i++) {
+        if (!isNarrowOffset(getTimeOffset((*times)[i], (*times)[0]))) {
+            *fields |= kWideTimesBit;
+            break;
+        }
+    }
+    return count;
 }
 
 // Flattenable implementation
 size_t FrameEventsDelta::getFlattenedSize() const {
+    std::array<nsecs_t, 9> times;
+    uint16_t fields = 0;
+    size_t count = getFlattenedTimes(&times, &fields);
+
     auto fences = allFences(this);
-    return minFlattenedSize() +
+    return minFlattenedSize() + getFlattenedTimesSize(count, fields) +
             std::accumulate(fences.begin(), fences.end(), size_t(0),
                     [](size_t a, const FenceTime::Snapshot* fence) {
-                            return a + fence->getFlattenedSize();
+                            return fence->state == FenceTime::Snapshot::State::FENCE
+                                    ? a + fence->fence->getFlattenedSize()
+                                    : a;
                     });
 }
 
@@ -567,25 +672,31 @@ status_t FrameEventsDelta::flatten(void*& buffer, size_t& size, int*& fds,
         return BAD_VALUE;
     }
 
-    FlattenableUtils::write(buffer, size, mFrameNumber);
+    std::array<nsecs_t, 9> times;
+    uint16_t fields = 0;
+    size_t timeCount = getFlattenedTimes(&times, &fields);
 
-    // These are static_cast to uint16_t/uint8_t for alignment.
+    FlattenableUtils::write(buffer, size, mFrameNumber);
     FlattenableUtils::write(buffer, size, static_cast<uint16_t>(mIndex));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddPostCompositeCalled));
-    FlattenableUtils::write(
-            buffer, size, static_cast<uint8_t>(mAddReleaseCalled));
-
-    FlattenableUtils::write(buffer, size, mPostedTime);
-    FlattenableUtils::write(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::write(buffer, size, mLatchTime);
-    FlattenableUtils::write(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::write(buffer, size, mDequeueReadyTime);
+    FlattenableUtils::write(buffer, size, fields);
+
+    for (size_t i = 0; i < timeCount; i++) {
+        if (i == 0) {
+            FlattenableUtils::write(buffer, size, times[0]);
+        } else if (fields & kWideTimesBit) {
+            FlattenableUtils::write(buffer, size, getTimeOffset(times[i], times[0]));
+        } else {
+            FlattenableUtils::write(buffer, size,
+                    static_cast<int32_t>(getTimeOffset(times[i], times[0])));
+        }
+    }
 
     // Fences
     for (auto fence : allFences(this)) {
-        status_t status = fence->flatten(buffer, size, fds, count);
+        if (fence->state != FenceTime::Snapshot::State::FENCE) {
+            continue;
+        }
+        status_t status = fence->fence->flatten(buffer, size, fds, count);
         if (status != NO_ERROR) {
             return status;
         }
@@ -601,31 +712,77 @@ status_t FrameEventsDelta::unflatten(void const*& buffer, size_t& size,
 
     FlattenableUtils::read(buffer, size, mFrameNumber);
 
-    // These were written as uint16_t/uint8_t for alignment.
     uint16_t temp16 = 0;
     FlattenableUtils::read(buffer, size, temp16);
     mIndex = temp16;
     if (mIndex >= FrameEventHistory::MAX_FRAME_HISTORY) {
         return BAD_VALUE;
     }
-    uint8_t temp8 = 0;
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddPostCompositeCalled = static_cast<bool>(temp8);
-    FlattenableUtils::read(buffer, size, temp8);
-    mAddReleaseCalled = static_cast<bool>(temp8);
+    uint16_t fields = 0;
+    FlattenableUtils::read(buffer, size, fields);
+    if (fields & ~kKnownFieldBits) {
+        return BAD_VALUE;
+    }
+    mAddPostCompositeCalled = (fields & kAddPostCompositeCalledBit) != 0;
+    mAddReleaseCalled = (fields & kAddReleaseCalledBit) != 0;
 
-    FlattenableUtils::read(buffer, size, mPostedTime);
-    FlattenableUtils::read(buffer, size, mRequestedPresentTime);
-    FlattenableUtils::read(buffer, size, mLatchTime);
-    FlattenableUtils::read(buffer, size, mFirstRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mLastRefreshStartTime);
-    FlattenableUtils::read(buffer, size, mDequeueReadyTime);
+    auto timestamps = allTimestamps(this);
+    auto fences = allFences(this);
+    size_t timeCount = 0;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        if (fields & (1 << i)) timeCount++;
+    }
+    for (size_t i = 0; i < fences.size(); i++) {
+        if (getFlatFenceState(fields, i) == FLAT_FENCE_SIGNAL_TIME) timeCount++;
+    }
+    if (size < getFlattenedTimesSize(timeCount, fields)) {
+        return NO_MEMORY;
+    }
+
+    nsecs_t base = 0;
+    auto readTime = [&](size_t i) {
+        if (i == 0) {
+            FlattenableUtils::read(buffer, size, base);
+            return base;
+        }
+        uint64_t offset = 0;
+        if (fields & kWideTimesBit) {
+            FlattenableUtils::read(buffer, size, offset);
+        } else {
+            int32_t narrowOffset = 0;
+            FlattenableUtils::read(buffer, size, narrowOffset);
+            offset = static_cast<uint64_t>(static_cast<int64_t>(narrowOffset));
+        }
+        return static_cast<nsecs_t>(static_cast<uint64_t>(base) + offset);
+    };
+
+    size_t timeIndex = 0;
+    for (size_t i = 0; i < timestamps.size(); i++) {
+        *timestamps[i] = (fields & (1 << i)) ? readTime(timeIndex++)
+                                             : FrameEvents::TIMESTAMP_PENDING;
+    }
 
     // Fences
-    for (auto fence : allFences(this)) {
-        status_t status = fence->unflatten(buffer, size, fds, count);
-        if (status != NO_ERROR) {
-            return status;
+    for (size_t i = 0; i < fences.size(); i++) {
+        FenceTime::Snapshot* fence = fences[i];
+        switch (getFlatFenceState(fields, i)) {
+            case FLAT_FENCE_EMPTY:
+                *fence = FenceTime::Snapshot();
+                break;
+            case FLAT_FENCE_FENCE: {
+                *fence = FenceTime::Snapshot(new Fence);
+                status_t status = fence->fence->unflatten(buffer, size, fds, count);
+                if (status != NO_ERROR) {
+                    return status;
+                }
+                break;
+            }
+            case FLAT_FENCE_SIGNAL_TIME:
+                *fence = FenceTime::Snapshot(readTime(timeIndex++));
+                break;
+            case FLAT_FENCE_SIGNAL_TIME_INVALID:
+                *fence = FenceTime::Snapshot(Fence::SIGNAL_TIME_INVALID);
+                break;
         }
     }
     return NO_ERROR;
@@ -29,7 +29,9 @@ namespace { // Anonymous
 enum class Tag : uint32_t {
     ON_TRANSACTION_COMPLETED = IBinder::FIRST_CALL_TRANSACTION,
     ON_RELEASE_BUFFER,
-    LAST = ON_RELEASE_BUFFER,
+    ON_RELEASE_BUFFERS,
+    ON_BUFFER_UNCACHED,
+    LAST = ON_BUFFER_UNCACHED,
 };
 
 } // Anonymous namespace
@@ -153,6 +155,34 @@ status_t SurfaceStats::readFromParcel(const Parcel* input) {
     return NO_ERROR;
 }
 
+status_t ReleasedBufferStats::writeToParcel(Parcel* output) const {
+    SAFE_PARCEL(output->writeParcelable, callbackId);
+    if (releaseFence) {
+        SAFE_PARCEL(output->writeBool, true);
+        SAFE_PARCEL(output->write, *releaseFence);
+    } else {
+        SAFE_PARCEL(output->writeBool, false);
+    }
+    SAFE_PARCEL(output->writeUint32, transformHint);
+    SAFE_PARCEL(output->writeUint32, currentMaxAcquiredBufferCount);
+    return NO_ERROR;
+}
+
+status_t ReleasedBufferStats::readFromParcel(const Parcel* input) {
+    SAFE_PARCEL(input->readParcelable, &callbackId);
+    bool hasFence = false;
+    SAFE_PARCEL(input->readBool, &hasFence);
+    if (hasFence) {
+        releaseFence = new Fence();
+        SAFE_PARCEL(input->read, *releaseFence);
+    } else {
+        releaseFence = Fence::NO_FENCE;
+    }
+    SAFE_PARCEL(input->readUint32, &transformHint);
+    SAFE_PARCEL(input->readUint32, &currentMaxAcquiredBufferCount);
+    return NO_ERROR;
+}
+
 status_t TransactionStats::writeToParcel(Parcel* output) const {
     status_t err = output->writeParcelableVector(callbackIds);
     if (err != NO_ERROR) {
@@ -261,6 +291,18 @@ public:
                                                                   transformHint,
                                                                   currentMaxAcquiredBufferCount);
     }
+
+    void onReleaseBuffers(std::vector<ReleasedBufferStats> releasedBuffers) override {
+        callRemoteAsync<decltype(
+                &ITransactionCompletedListener::onReleaseBuffers)>(Tag::ON_RELEASE_BUFFERS,
+                                                                   releasedBuffers);
+    }
+
+    void onBufferUncached(uint64_t cacheId) override {
+        callRemoteAsync<decltype(
+                &ITransactionCompletedListener::onBufferUncached)>(Tag::ON_BUFFER_UNCACHED,
+                                                                   cacheId);
+    }
 };
 
 // Out-of-line virtual method definitions to trigger vtable emission in this translation unit (see
@@ -281,6 +323,10 @@ status_t BnTransactionCompletedListener::onTransact(uint32_t code, const Parcel&
                                   &ITransactionCompletedListener::onTransactionCompleted);
         case Tag::ON_RELEASE_BUFFER:
             return callLocalAsync(data, reply, &ITransactionCompletedListener::onReleaseBuffer);
+        case Tag::ON_RELEASE_BUFFERS:
+            return callLocalAsync(data, reply, &ITransactionCompletedListener::onReleaseBuffers);
+        case Tag::ON_BUFFER_UNCACHED:
+            return callLocalAsync(data, reply, &ITransactionCompletedListener::onBufferUncached);
     }
 }
 
@@ -27,8 +27,11 @@ namespace android {
 
 LayerMetadata::LayerMetadata() = default;
 
-LayerMetadata::LayerMetadata(std::unordered_map<uint32_t, std::vector<uint8_t>> map)
-      : mMap(std::move(map)) {}
+LayerMetadata::LayerMetadata(std::unordered_map<uint32_t, std::vector<uint8_t>> map) {
+    for (auto& [key, value] : map) {
+        mMap.try_emplace(key, std::move(value));
+    }
+}
 
 LayerMetadata::LayerMetadata(const LayerMetadata& other) = default;
 
@@ -36,17 +39,19 @@ LayerMetadata::LayerMetadata(LayerMetadata&& other) = default;
 
 bool LayerMetadata::merge(const LayerMetadata& other, bool eraseEmpty) {
     bool changed = false;
-    for (const auto& entry : other.mMap) {
-        auto it = mMap.find(entry.first);
-        if (it != mMap.cend() && it->second != entry.second) {
-            if (eraseEmpty && entry.second.empty()) {
-                mMap.erase(it);
+    for (const auto& [key, value] : other.mMap) {
+        if (const auto current = mMap.find(key)) {
+            if (current->get() == value) {
+                continue;
+            }
+            if (eraseEmpty && value.empty()) {
+                mMap.erase(key);
             } else {
-                it->second = entry.second;
+                current->get() = value;
             }
             changed = true;
-        } else if (it == mMap.cend() && !entry.second.empty()) {
-            mMap[entry.first] = entry.second;
+        } else if (!value.empty()) {
+            mMap.try_emplace(key, value);
             changed = true;
         }
     }
@@ -94,33 +99,37 @@ LayerMetadata& LayerMetadata::operator=(LayerMetadata&& other) {
 }
 
 bool LayerMetadata::has(uint32_t key) const {
-    return mMap.count(key);
+    return mMap.contains(key);
 }
 
+// A Parcel keeps 32 and 64 bit integers in host order at the start of the data, so they are
+// copied straight out of and into the value rather than through a Parcel, which would allocate.
 int32_t LayerMetadata::getInt32(uint32_t key, int32_t fallback) const {
-    if (!has(key)) return fallback;
-    const std::vector<uint8_t>& data = mMap.at(key);
-    if (data.size() < sizeof(uint32_t)) return fallback;
-    Parcel p;
-    p.setData(data.data(), data.size());
-    return p.readInt32();
+    const auto data = mMap.find(key);
+    if (!data || data->get().size() < sizeof(int32_t)) return fallback;
+    int32_t value;
+    memcpy(&value, data->get().data(), sizeof(value));
+    return value;
 }
 
 void LayerMetadata::setInt32(uint32_t key, int32_t value) {
     std::vector<uint8_t>& data = mMap[key];
-    Parcel p;
-    p.writeInt32(value);
-    data.resize(p.dataSize());
-    memcpy(data.data(), p.data(), p.dataSize());
+    data.resize(sizeof(value));
+    memcpy(data.data(), &value, sizeof(value));
 }
 
 std::optional<int64_t> LayerMetadata::getInt64(uint32_t key) const {
-    if (!has(key)) return std::nullopt;
-    const std::vector<uint8_t>& data = mMap.at(key);
-    if (data.size() < sizeof(int64_t)) return std::nullopt;
-    Parcel p;
-    p.setData(data.data(), data.size());
-    return p.readInt64();
+    const auto data = mMap.find(key);
+    if (!data || data->get().size() < sizeof(int64_t)) return std::nullopt;
+    int64_t value;
+    memcpy(&value, data->get().data(), sizeof(value));
+    return value;
+}
+
+void LayerMetadata::setInt64(uint32_t key, int64_t value) {
+    std::vector<uint8_t>& data = mMap[key];
+    data.resize(sizeof(value));
+    memcpy(data.data(), &value, sizeof(value));
 }
 
 std::string LayerMetadata::itemToString(uint32_t key, const char* separator) const {
@@ -140,7 +149,7 @@ std::string LayerMetadata::itemToString(uint32_t key, const char* separator) con
             return StringPrintf("gameMode%s%d", separator, getInt32(key, 0));
         default:
             return StringPrintf("%d%s%dbytes", key, separator,
-                                static_cast<int>(mMap.at(key).size()));
+                                static_cast<int>(mMap.find(key)->get().size()));
     }
 }
 
@@ -24,6 +24,8 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 namespace android {
 
 status_t OccupancyTracker::Segment::writeToParcel(Parcel* parcel) const {
@@ -68,11 +70,10 @@ void OccupancyTracker::registerOccupancyChange(size_t occupancy) {
         recordPendingSegment();
     } else {
         mPendingSegment.totalTime += delta;
-        if (mPendingSegment.mOccupancyTimes.count(mLastOccupancy)) {
-            mPendingSegment.mOccupancyTimes[mLastOccupancy] += delta;
-        } else {
-            mPendingSegment.mOccupancyTimes[mLastOccupancy] = delta;
-        }
+        mPendingSegment.weightedTime += delta * static_cast<nsecs_t>(mLastOccupancy);
+        mPendingSegment.usedThirdBuffer =
+                mPendingSegment.usedThirdBuffer || (mLastOccupancy > 1);
+        mOccupancyHistogram[std::min(mLastOccupancy, OCCUPANCY_HISTOGRAM_SIZE - 1)] += delta;
     }
     if (occupancy > mLastOccupancy) {
         ++mPendingSegment.numFrames;
@@ -86,30 +87,48 @@ std::vector<OccupancyTracker::Segment> OccupancyTracker::getSegmentHistory(
     if (forceFlush) {
         recordPendingSegment();
     }
-    std::vector<Segment> segments(mSegmentHistory.cbegin(),
-            mSegmentHistory.cend());
-    mSegmentHistory.clear();
+    // Newest segment first
+    std::vector<Segment> segments;
+    segments.reserve(mSegmentCount);
+    for (size_t i = 1; i <= mSegmentCount; ++i) {
+        segments.push_back(mSegmentHistory[
+                (mNextSegment + MAX_HISTORY_SIZE - i) % MAX_HISTORY_SIZE]);
+    }
+    mSegmentCount = 0;
     return segments;
 }
 
+void OccupancyTracker::dumpOccupancyHistogram(const String8& prefix,
+        String8* outResult) const {
+    nsecs_t totalTime = 0;
+    for (nsecs_t time : mOccupancyHistogram) {
+        totalTime += time;
+    }
+    outResult->appendFormat("%s  occupancy histogram (%.3fs):", prefix.string(),
+            totalTime / 1e9);
+    for (size_t i = 0; i < OCCUPANCY_HISTOGRAM_SIZE; ++i) {
+        const float percent = totalTime > 0 ?
+                100.0f * mOccupancyHistogram[i] / totalTime : 0.0f;
+        outResult->appendFormat(" %zu%s=%.1f%%", i,
+                i + 1 == OCCUPANCY_HISTOGRAM_SIZE ? "+" : "", percent);
+    }
+    outResult->append("\n");
+}
+
 void OccupancyTracker::recordPendingSegment() {
     // Only record longer segments to get a better measurement of actual double-
     // vs. triple-buffered time
     if (mPendingSegment.numFrames > LONG_SEGMENT_THRESHOLD) {
         float occupancyAverage = 0.0f;
-        bool usedThirdBuffer = false;
-        for (const auto& timePair : mPendingSegment.mOccupancyTimes) {
-            size_t occupancy = timePair.first;
-            float timeRatio = static_cast<float>(timePair.second) /
+        if (mPendingSegment.totalTime > 0) {
+            occupancyAverage = static_cast<float>(mPendingSegment.weightedTime) /
                     mPendingSegment.totalTime;
-            occupancyAverage += timeRatio * occupancy;
-            usedThirdBuffer = usedThirdBuffer || (occupancy > 1);
-        }
-        mSegmentHistory.push_front({mPendingSegment.totalTime,
-                mPendingSegment.numFrames, occupancyAverage, usedThirdBuffer});
-        if (mSegmentHistory.size() > MAX_HISTORY_SIZE) {
-            mSegmentHistory.pop_back();
         }
+        mSegmentHistory[mNextSegment] = Segment(mPendingSegment.totalTime,
+                mPendingSegment.numFrames, occupancyAverage,
+                mPendingSegment.usedThirdBuffer);
+        mNextSegment = (mNextSegment + 1) % MAX_HISTORY_SIZE;
+        mSegmentCount = std::min(mSegmentCount + 1, MAX_HISTORY_SIZE);
     }
     mPendingSegment.clear();
 }
@@ -57,14 +57,25 @@ status_t StreamSplitter::createSplitter(
 }
 
 StreamSplitter::StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue)
-      : mIsAbandoned(false), mMutex(), mReleaseCondition(),
+      : mIsAbandoned(false), mIsStopping(false), mMutex(), mReleaseCondition(),
         mOutstandingBuffers(0), mInput(inputQueue), mOutputs(), mBuffers() {}
 
 StreamSplitter::~StreamSplitter() {
     mInput->consumerDisconnect();
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        (*output)->disconnect(NATIVE_WINDOW_API_CPU);
+
+    {
+        Mutex::Autolock lock(mMutex);
+        mIsStopping = true;
+        for (const std::unique_ptr<Output>& output : mOutputs) {
+            output->pendingCondition.broadcast();
+        }
+    }
+
+    for (const std::unique_ptr<Output>& output : mOutputs) {
+        if (output->thread.joinable()) {
+            output->thread.join();
+        }
+        output->producer->disconnect(NATIVE_WINDOW_API_CPU);
     }
 
     if (mBuffers.size() > 0) {
@@ -73,7 +84,7 @@ StreamSplitter::~StreamSplitter() {
 }
 
 status_t StreamSplitter::addOutput(
-        const sp<IGraphicBufferProducer>& outputQueue) {
+        const sp<IGraphicBufferProducer>& outputQueue, OutputPolicy policy) {
     if (outputQueue == nullptr) {
         ALOGE("addOutput: outputQueue must not be NULL");
         return BAD_VALUE;
@@ -91,7 +102,20 @@ status_t StreamSplitter::addOutput(
         return status;
     }
 
-    mOutputs.push_back(outputQueue);
+    if (policy == OutputPolicy::ASYNCHRONOUS_DROPPING) {
+        status = outputQueue->setDequeueTimeout(0);
+        if (status != NO_ERROR) {
+            ALOGE("addOutput: failed to set the dequeue timeout (%d)", status);
+            outputQueue->disconnect(NATIVE_WINDOW_API_CPU);
+            return status;
+        }
+    }
+
+    std::unique_ptr<Output> output(new Output{outputQueue, policy});
+    if (policy != OutputPolicy::SYNCHRONOUS) {
+        output->thread = std::thread(&StreamSplitter::outputThreadMain, this, output.get());
+    }
+    mOutputs.push_back(std::move(output));
 
     return NO_ERROR;
 }
@@ -103,86 +127,143 @@ void StreamSplitter::setName(const String8 &name) {
 
 void StreamSplitter::onFrameAvailable(const BufferItem& /* item */) {
     ATRACE_CALL();
-    Mutex::Autolock lock(mMutex);
-
-    // The current policy is that if any one consumer is consuming buffers too
-    // slowly, the splitter will stall the rest of the outputs by not acquiring
-    // any more buffers from the input. This will cause back pressure on the
-    // input queue, slowing down its producer.
-
-    // If there are too many outstanding buffers, we block until a buffer is
-    // released back to the input in onBufferReleased
-    while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
-        mReleaseCondition.wait(mMutex);
-
-        // If the splitter is abandoned while we are waiting, the release
-        // condition variable will be broadcast, and we should just return
-        // without attempting to do anything more (since the input queue will
-        // also be abandoned).
-        if (mIsAbandoned) {
-            return;
+    std::vector<Output*> synchronousOutputs;
+    std::optional<PendingBuffer> pendingBuffer;
+    { // Autolock scope
+        Mutex::Autolock lock(mMutex);
+
+        // The current policy is that if any one consumer is consuming buffers
+        // too slowly, the splitter will stall the rest of the outputs by not
+        // acquiring any more buffers from the input. This will cause back
+        // pressure on the input queue, slowing down its producer. Dropping
+        // outputs avoid this by not holding on to the buffers they are late
+        // for.
+
+        // If there are too many outstanding buffers, we block until a buffer is
+        // released back to the input in onBufferReleased
+        while (mOutstandingBuffers >= MAX_OUTSTANDING_BUFFERS) {
+            mReleaseCondition.wait(mMutex);
+
+            // If the splitter is abandoned while we are waiting, the release
+            // condition variable will be broadcast, and we should just return
+            // without attempting to do anything more (since the input queue
+            // will also be abandoned).
+            if (mIsAbandoned) {
+                return;
+            }
         }
-    }
-    ++mOutstandingBuffers;
+        ++mOutstandingBuffers;
 
-    // Acquire and detach the buffer from the input
-    BufferItem bufferItem;
-    status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "acquiring buffer from input failed (%d)", status);
+        // Acquire and detach the buffer from the input
+        BufferItem bufferItem;
+        status_t status = mInput->acquireBuffer(&bufferItem, /* presentWhen */ 0);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "acquiring buffer from input failed (%d)", status);
 
-    ALOGV("acquired buffer %#" PRIx64 " from input",
-            bufferItem.mGraphicBuffer->getId());
+        ALOGV("acquired buffer %#" PRIx64 " from input",
+                bufferItem.mGraphicBuffer->getId());
 
-    status = mInput->detachBuffer(bufferItem.mSlot);
-    LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-            "detaching buffer from input failed (%d)", status);
-
-    // Initialize our reference count for this buffer
-    mBuffers.add(bufferItem.mGraphicBuffer->getId(),
-            new BufferTracker(bufferItem.mGraphicBuffer));
-
-    IGraphicBufferProducer::QueueBufferInput queueInput(
-            bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
-            bufferItem.mDataSpace, bufferItem.mCrop,
-            static_cast<int32_t>(bufferItem.mScalingMode),
-            bufferItem.mTransform, bufferItem.mFence);
-
-    // Attach and queue the buffer to each of the outputs
-    Vector<sp<IGraphicBufferProducer> >::iterator output = mOutputs.begin();
-    for (; output != mOutputs.end(); ++output) {
-        int slot;
-        status = (*output)->attachBuffer(&slot, bufferItem.mGraphicBuffer);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
-            continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "attaching buffer to output failed (%d)", status);
+        status = mInput->detachBuffer(bufferItem.mSlot);
+        LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
+                "detaching buffer from input failed (%d)", status);
+
+        // Initialize our reference count for this buffer
+        sp<BufferTracker> tracker = new BufferTracker(bufferItem.mGraphicBuffer);
+        mBuffers.add(bufferItem.mGraphicBuffer->getId(), tracker);
+
+        pendingBuffer.emplace(PendingBuffer{tracker,
+                IGraphicBufferProducer::QueueBufferInput(
+                        bufferItem.mTimestamp, bufferItem.mIsAutoTimestamp,
+                        bufferItem.mDataSpace, bufferItem.mCrop,
+                        static_cast<int32_t>(bufferItem.mScalingMode),
+                        bufferItem.mTransform, bufferItem.mFence)});
+
+        // Hand the buffer to the thread of each asynchronous output. A dropping
+        // output only ever needs the newest buffer, so the ones it hasn't got
+        // to yet are dropped.
+        for (const std::unique_ptr<Output>& output : mOutputs) {
+            if (output->policy == OutputPolicy::SYNCHRONOUS) {
+                synchronousOutputs.push_back(output.get());
+                continue;
+            }
+            if (output->policy == OutputPolicy::ASYNCHRONOUS_DROPPING) {
+                while (!output->pending.empty()) {
+                    ALOGV("dropped buffer %#" PRIx64 " for output %p",
+                            output->pending.front().tracker->getBuffer()->getId(),
+                            output->producer.get());
+                    releaseToInputLocked(output->pending.front().tracker);
+                    output->pending.pop_front();
+                }
+            }
+            output->pending.push_back(*pendingBuffer);
+            output->pendingCondition.signal();
         }
+    } // Autolock scope
 
+    // Attach and queue the buffer to each of the synchronous outputs
+    for (Output* output : synchronousOutputs) {
+        queueToOutput(output, *pendingBuffer);
+    }
+}
+
+void StreamSplitter::queueToOutput(Output* output, const PendingBuffer& buffer) {
+    const sp<GraphicBuffer>& graphicBuffer = buffer.tracker->getBuffer();
+
+    int slot;
+    status_t status = output->producer->attachBuffer(&slot, graphicBuffer);
+    const bool attached = status == NO_ERROR;
+    if (attached) {
         IGraphicBufferProducer::QueueBufferOutput queueOutput;
-        status = (*output)->queueBuffer(slot, queueInput, &queueOutput);
-        if (status == NO_INIT) {
-            // If we just discovered that this output has been abandoned, note
-            // that, increment the release count so that we still release this
-            // buffer eventually, and move on to the next output
-            onAbandonedLocked();
-            mBuffers.editValueFor(bufferItem.mGraphicBuffer->getId())->
-                    incrementReleaseCountLocked();
-            continue;
-        } else {
-            LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
-                    "queueing buffer to output failed (%d)", status);
+        status = output->producer->queueBuffer(slot, buffer.input, &queueOutput);
+        if (status == NO_ERROR) {
+            ALOGV("queued buffer %#" PRIx64 " to output %p",
+                    graphicBuffer->getId(), output->producer.get());
+            return;
         }
+    }
 
-        ALOGV("queued buffer %#" PRIx64 " to output %p",
-                bufferItem.mGraphicBuffer->getId(), output->get());
+    Mutex::Autolock lock(mMutex);
+    if (status == NO_INIT) {
+        // If we just discovered that this output has been abandoned, note
+        // that, and increment the release count so that we still release this
+        // buffer eventually
+        onAbandonedLocked();
+        buffer.tracker->incrementReleaseCountLocked();
+        return;
+    }
+
+    // A dropping output has a dequeue timeout of 0, so attaching a buffer to it
+    // fails right away when it has no free slot
+    if (!attached && output->policy == OutputPolicy::ASYNCHRONOUS_DROPPING &&
+            (status == TIMED_OUT || status == WOULD_BLOCK)) {
+        ALOGV("dropped buffer %#" PRIx64 " for output %p",
+                graphicBuffer->getId(), output->producer.get());
+        releaseToInputLocked(buffer.tracker);
+        return;
+    }
+
+    LOG_ALWAYS_FATAL("%s buffer to output failed (%d)",
+            attached ? "queueing" : "attaching", status);
+}
+
+std::optional<StreamSplitter::PendingBuffer> StreamSplitter::takePendingBuffer(
+        Output* output) {
+    Mutex::Autolock lock(mMutex);
+    while (!mIsStopping && output->pending.empty()) {
+        output->pendingCondition.wait(mMutex);
+    }
+    if (mIsStopping) {
+        return std::nullopt;
+    }
+
+    PendingBuffer buffer = std::move(output->pending.front());
+    output->pending.pop_front();
+    return buffer;
+}
+
+void StreamSplitter::outputThreadMain(Output* output) {
+    while (std::optional<PendingBuffer> buffer = takePendingBuffer(output)) {
+        queueToOutput(output, *buffer);
     }
 }
 
@@ -207,15 +288,21 @@ void StreamSplitter::onBufferReleasedByOutput(
     ALOGV("detached buffer %#" PRIx64 " from output %p",
           buffer->getId(), from.get());
 
-    const sp<BufferTracker>& tracker = mBuffers.editValueFor(buffer->getId());
+    const sp<BufferTracker> tracker = mBuffers.valueFor(buffer->getId());
 
     // Merge the release fence of the incoming buffer so that the fence we send
     // back to the input includes all of the outputs' fences
     tracker->mergeFence(fence);
 
+    releaseToInputLocked(tracker);
+}
+
+void StreamSplitter::releaseToInputLocked(const sp<BufferTracker>& tracker) {
+    const uint64_t bufferId = tracker->getBuffer()->getId();
+
     // Check to see if this is the last outstanding reference to this buffer
     size_t releaseCount = tracker->incrementReleaseCountLocked();
-    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", buffer->getId(),
+    ALOGV("buffer %#" PRIx64 " reference count %zu (of %zu)", bufferId,
             releaseCount, mOutputs.size());
     if (releaseCount < mOutputs.size()) {
         return;
@@ -224,13 +311,13 @@ void StreamSplitter::onBufferReleasedByOutput(
     // If we've been abandoned, we can't return the buffer to the input, so just
     // stop tracking it and move on
     if (mIsAbandoned) {
-        mBuffers.removeItem(buffer->getId());
+        mBuffers.removeItem(bufferId);
         return;
     }
 
     // Attach and release the buffer back to the input
     int consumerSlot;
-    status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
+    status_t status = mInput->attachBuffer(&consumerSlot, tracker->getBuffer());
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "attaching buffer to input failed (%d)", status);
 
@@ -239,11 +326,11 @@ void StreamSplitter::onBufferReleasedByOutput(
     LOG_ALWAYS_FATAL_IF(status != NO_ERROR,
             "releasing buffer to input failed (%d)", status);
 
-    ALOGV("released buffer %#" PRIx64 " to input", buffer->getId());
+    ALOGV("released buffer %#" PRIx64 " to input", bufferId);
 
     // We no longer need to track the buffer once it has been returned to the
     // input
-    mBuffers.removeItem(buffer->getId());
+    mBuffers.removeItem(bufferId);
 
     // Notify any waiting onFrameAvailable calls
     --mOutstandingBuffers;
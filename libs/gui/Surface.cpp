@@ -23,6 +23,7 @@
 #include <condition_variable>
 #include <deque>
 #include <mutex>
+#include <optional>
 #include <thread>
 
 #include <inttypes.h>
@@ -60,6 +61,12 @@ bool isInterceptorRegistrationOp(int op) {
             op == NATIVE_WINDOW_SET_QUERY_INTERCEPTOR;
 }
 
+bool isSameDequeueInput(const IGraphicBufferProducer::DequeueBufferInput& a,
+                        const IGraphicBufferProducer::DequeueBufferInput& b) {
+    return a.width == b.width && a.height == b.height && a.format == b.format &&
+            a.usage == b.usage && a.getTimestamps == b.getTimestamps;
+}
+
 } // namespace
 
 Surface::Surface(const sp<IGraphicBufferProducer>& bufferProducer, bool controlledByApp,
@@ -119,6 +126,9 @@ Surface::~Surface() {
     if (mConnectedToCpu) {
         Surface::disconnect(NATIVE_WINDOW_API_CPU);
     }
+    if (mDequeueAhead != nullptr) {
+        mDequeueAhead->stop(true /*cancel*/);
+    }
 }
 
 sp<ISurfaceComposer> Surface::composerService() const {
@@ -615,6 +625,114 @@ private:
     std::mutex mMutex;
 };
 
+// Dequeues one buffer at a time on its own thread, see Surface::setDequeueAhead.
+class Surface::DequeueAheadThread {
+public:
+    struct Result {
+        IGraphicBufferProducer::DequeueBufferInput input;
+        status_t result = NO_INIT;
+        int slot = BufferItem::INVALID_BUFFER_SLOT;
+        sp<Fence> fence;
+        uint64_t bufferAge = 0;
+        FrameEventHistoryDelta timestamps;
+    };
+
+    static std::shared_ptr<DequeueAheadThread> create(const sp<IGraphicBufferProducer>& producer) {
+        std::shared_ptr<DequeueAheadThread> thread(new DequeueAheadThread(producer));
+        // The thread keeps itself alive, so that stop() never has to wait for
+        // a dequeue which is blocked in the producer.
+        std::thread([thread] { thread->loop(); }).detach();
+        return thread;
+    }
+
+    // Starts dequeueing a buffer for 'input', unless one is dequeued already.
+    void start(const IGraphicBufferProducer::DequeueBufferInput& input) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mStop) {
+            return;
+        }
+        if (mPending || mResult) {
+            mQueuedSinceDequeue++;
+            return;
+        }
+        mInput = input;
+        mPending = true;
+        mQueuedSinceDequeue = 0;
+        mCondition.notify_all();
+    }
+
+    // Waits for a dequeue in flight, then hands out its result if there is one.
+    std::optional<Result> take() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return !mPending; });
+        std::optional<Result> result = std::move(mResult);
+        mResult.reset();
+        // Frames queued while the buffer was held make it older. If the
+        // producer saw some of them already this overestimates the age,
+        // which only costs a larger repaint.
+        if (result && result->bufferAge != 0) {
+            result->bufferAge += mQueuedSinceDequeue;
+        }
+        return result;
+    }
+
+    // Lets the thread exit once a dequeue in flight returns. The buffer it
+    // holds is cancelled if 'cancel' is set, there is no point once the
+    // producer is disconnected.
+    void stop(bool cancel) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+        mCancelOnStop = cancel;
+        mCondition.notify_all();
+    }
+
+private:
+    explicit DequeueAheadThread(const sp<IGraphicBufferProducer>& producer)
+          : mProducer(producer) {}
+
+    void loop() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (true) {
+            mCondition.wait(lock, [this] { return mStop || mPending; });
+            if (mStop) {
+                break;
+            }
+            Result result;
+            result.input = mInput;
+            lock.unlock();
+            {
+                ATRACE_NAME("dequeue ahead");
+                const IGraphicBufferProducer::DequeueBufferInput& in = result.input;
+                result.result = mProducer->dequeueBuffer(&result.slot, &result.fence, in.width,
+                                                         in.height, in.format, in.usage,
+                                                         &result.bufferAge,
+                                                         in.getTimestamps ? &result.timestamps
+                                                                          : nullptr);
+            }
+            lock.lock();
+            mResult = std::move(result);
+            mPending = false;
+            mCondition.notify_all();
+        }
+        if (mCancelOnStop && mResult && mResult->result >= 0) {
+            mProducer->cancelBuffer(mResult->slot, mResult->fence);
+        }
+        mResult.reset();
+        mPending = false;
+        mCondition.notify_all();
+    }
+
+    const sp<IGraphicBufferProducer> mProducer;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    IGraphicBufferProducer::DequeueBufferInput mInput;
+    std::optional<Result> mResult;
+    uint64_t mQueuedSinceDequeue = 0;
+    bool mPending = false;
+    bool mStop = false;
+    bool mCancelOnStop = false;
+};
+
 void Surface::getDequeueBufferInputLocked(
         IGraphicBufferProducer::DequeueBufferInput* dequeueInput) {
     LOG_ALWAYS_FATAL_IF(dequeueInput == nullptr, "input is null");
@@ -633,6 +751,7 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     ALOGV("Surface::dequeueBuffer");
 
     IGraphicBufferProducer::DequeueBufferInput dqInput;
+    std::shared_ptr<DequeueAheadThread> dequeueAhead;
     {
         Mutex::Autolock lock(mMutex);
         if (mReportRemovedBuffers) {
@@ -650,6 +769,8 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
                 return OK;
             }
         }
+
+        dequeueAhead = mDequeueAhead;
     } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffer
 
     int buf = -1;
@@ -657,11 +778,30 @@ int Surface::dequeueBuffer(android_native_buffer_t** buffer, int* fenceFd) {
     nsecs_t startTime = systemTime();
 
     FrameEventHistoryDelta frameTimestamps;
-    status_t result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, dqInput.width,
-                                                            dqInput.height, dqInput.format,
-                                                            dqInput.usage, &mBufferAge,
-                                                            dqInput.getTimestamps ?
-                                                                    &frameTimestamps : nullptr);
+    status_t result;
+    std::optional<DequeueAheadThread::Result> ahead;
+    if (dequeueAhead != nullptr) {
+        ahead = dequeueAhead->take();
+    }
+    if (ahead && ahead->result >= 0 && isSameDequeueInput(ahead->input, dqInput)) {
+        result = ahead->result;
+        buf = ahead->slot;
+        fence = ahead->fence;
+        mBufferAge = ahead->bufferAge;
+        frameTimestamps = std::move(ahead->timestamps);
+    } else {
+        // Either nothing was dequeued ahead or the request changed since,
+        // e.g. the app resized the window. Do it the usual way.
+        if (ahead && ahead->result >= 0) {
+            Mutex::Autolock lock(mMutex);
+            cancelDequeuedAheadLocked(ahead->result, ahead->slot, ahead->fence);
+        }
+        result = mGraphicBufferProducer->dequeueBuffer(&buf, &fence, dqInput.width,
+                                                       dqInput.height, dqInput.format,
+                                                       dqInput.usage, &mBufferAge,
+                                                       dqInput.getTimestamps ?
+                                                               &frameTimestamps : nullptr);
+    }
     mLastDequeueDuration = systemTime() - startTime;
 
     if (result < 0) {
@@ -768,6 +908,8 @@ int Surface::dequeueBuffers(std::vector<BatchBuffer>* buffers) {
             mRemovedBuffers.clear();
         }
 
+        // the batch may need every buffer the producer allows
+        cancelDequeueAheadLocked();
         getDequeueBufferInputLocked(&input);
     } // Drop the lock so that we can still touch the Surface while blocking in IGBP::dequeueBuffers
 
@@ -1176,9 +1318,47 @@ int Surface::queueBuffer(android_native_buffer_t* buffer, int fenceFd) {
     }
 
     onBufferQueuedLocked(i, fence, output);
+
+    if (err == OK && mDequeueAheadEnabled && !mSharedBufferMode) {
+        if (mDequeueAhead == nullptr) {
+            mDequeueAhead = DequeueAheadThread::create(mGraphicBufferProducer);
+        }
+        IGraphicBufferProducer::DequeueBufferInput dqInput;
+        getDequeueBufferInputLocked(&dqInput);
+        mDequeueAhead->start(dqInput);
+    }
     return err;
 }
 
+void Surface::cancelDequeuedAheadLocked(status_t result, int slot, const sp<Fence>& fence) {
+    if (slot < 0 || slot >= NUM_BUFFER_SLOTS) {
+        ALOGE("%s: IGraphicBufferProducer returned invalid slot number %d", __FUNCTION__, slot);
+        return;
+    }
+    // The flags were meant for whoever received the buffer, so apply them
+    // before the slot is handed out again without them.
+    if (result & IGraphicBufferProducer::RELEASE_ALL_BUFFERS) {
+        freeAllBuffers();
+    }
+    if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+        if (mReportRemovedBuffers && mSlots[slot].buffer != nullptr) {
+            mRemovedBuffers.push_back(mSlots[slot].buffer);
+        }
+        mSlots[slot].buffer = nullptr;
+    }
+    mGraphicBufferProducer->cancelBuffer(slot, fence);
+}
+
+void Surface::cancelDequeueAheadLocked() {
+    if (mDequeueAhead == nullptr) {
+        return;
+    }
+    std::optional<DequeueAheadThread::Result> ahead = mDequeueAhead->take();
+    if (ahead && ahead->result >= 0) {
+        cancelDequeuedAheadLocked(ahead->result, ahead->slot, ahead->fence);
+    }
+}
+
 int Surface::queueBuffers(const std::vector<BatchQueuedBuffer>& buffers) {
     ATRACE_CALL();
     ALOGV("Surface::queueBuffers");
@@ -1506,6 +1686,9 @@ int Surface::perform(int operation, va_list args)
     case NATIVE_WINDOW_SET_FRAME_TIMELINE_INFO:
         res = dispatchSetFrameTimelineInfo(args);
         break;
+    case NATIVE_WINDOW_SET_DEQUEUE_AHEAD:
+        res = dispatchSetDequeueAhead(args);
+        break;
     default:
         res = NAME_NOT_FOUND;
         break;
@@ -1855,6 +2038,11 @@ int Surface::dispatchSetFrameTimelineInfo(va_list args) {
     return setFrameTimelineInfo({frameTimelineVsyncId, inputEventId});
 }
 
+int Surface::dispatchSetDequeueAhead(va_list args) {
+    bool dequeueAhead = va_arg(args, int);
+    return setDequeueAhead(dequeueAhead);
+}
+
 bool Surface::transformToDisplayInverse() const {
     return (mTransform & NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY) ==
             NATIVE_WINDOW_TRANSFORM_INVERSE_DISPLAY;
@@ -1922,6 +2110,11 @@ int Surface::disconnect(int api, IGraphicBufferProducer::DisconnectMode mode) {
     mSharedBufferHasBeenQueued = false;
     freeAllBuffers();
     int err = mGraphicBufferProducer->disconnect(api, mode);
+    if (mDequeueAhead != nullptr) {
+        // the disconnect freed the buffer or fails the dequeue in flight
+        mDequeueAhead->stop(err != NO_ERROR /*cancel*/);
+        mDequeueAhead = nullptr;
+    }
     if (!err) {
         mReqFormat = 0;
         mReqWidth = 0;
@@ -1955,6 +2148,7 @@ int Surface::detachNextBuffer(sp<GraphicBuffer>* outBuffer,
     if (mReportRemovedBuffers) {
         mRemovedBuffers.clear();
     }
+    cancelDequeueAheadLocked();
 
     sp<GraphicBuffer> buffer(nullptr);
     sp<Fence> fence(nullptr);
@@ -1993,6 +2187,7 @@ int Surface::attachBuffer(ANativeWindowBuffer* buffer)
     if (mReportRemovedBuffers) {
         mRemovedBuffers.clear();
     }
+    cancelDequeueAheadLocked();
 
     sp<GraphicBuffer> graphicBuffer(static_cast<GraphicBuffer*>(buffer));
     uint32_t priorGeneration = graphicBuffer->mGenerationNumber;
@@ -2048,6 +2243,7 @@ int Surface::setBufferCount(int bufferCount)
     ATRACE_CALL();
     ALOGV("Surface::setBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelDequeueAheadLocked();
 
     status_t err = NO_ERROR;
     if (bufferCount == 0) {
@@ -2072,6 +2268,7 @@ int Surface::setMaxDequeuedBufferCount(int maxDequeuedBuffers) {
     ATRACE_CALL();
     ALOGV("Surface::setMaxDequeuedBufferCount");
     Mutex::Autolock lock(mMutex);
+    cancelDequeueAheadLocked();
 
     status_t err = mGraphicBufferProducer->setMaxDequeuedBufferCount(
             maxDequeuedBuffers);
@@ -2085,6 +2282,7 @@ int Surface::setAsyncMode(bool async) {
     ATRACE_CALL();
     ALOGV("Surface::setAsyncMode");
     Mutex::Autolock lock(mMutex);
+    cancelDequeueAheadLocked();
 
     status_t err = mGraphicBufferProducer->setAsyncMode(async);
     ALOGE_IF(err, "IGraphicBufferProducer::setAsyncMode(%d) returned %s",
@@ -2097,6 +2295,7 @@ int Surface::setSharedBufferMode(bool sharedBufferMode) {
     ATRACE_CALL();
     ALOGV("Surface::setSharedBufferMode (%d)", sharedBufferMode);
     Mutex::Autolock lock(mMutex);
+    cancelDequeueAheadLocked();
 
     status_t err = mGraphicBufferProducer->setSharedBufferMode(
             sharedBufferMode);
@@ -2590,6 +2789,20 @@ int Surface::setAutoPrerotation(bool autoPrerotation) {
     return err;
 }
 
+int Surface::setDequeueAhead(bool dequeueAhead) {
+    ATRACE_CALL();
+    ALOGV("Surface::setDequeueAhead (%d)", dequeueAhead);
+    Mutex::Autolock lock(mMutex);
+
+    mDequeueAheadEnabled = dequeueAhead;
+    if (!dequeueAhead && mDequeueAhead != nullptr) {
+        cancelDequeueAheadLocked();
+        mDequeueAhead->stop(true /*cancel*/);
+        mDequeueAhead = nullptr;
+    }
+    return NO_ERROR;
+}
+
 void Surface::ProducerListenerProxy::onBuffersDiscarded(const std::vector<int32_t>& slots) {
     ATRACE_CALL();
     sp<Surface> parent = mParent.promote();
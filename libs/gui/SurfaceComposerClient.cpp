@@ -19,6 +19,8 @@
 #include <stdint.h>
 #include <sys/types.h>
 
+#include <algorithm>
+
 #include <utils/Errors.h>
 #include <utils/Log.h>
 #include <utils/SortedVector.h>
@@ -380,6 +382,28 @@ void TransactionCompletedListener::onReleaseBuffer(ReleaseCallbackId callbackId,
     callback(callbackId, releaseFence, transformHint, currentMaxAcquiredBufferCount);
 }
 
+void TransactionCompletedListener::onReleaseBuffers(
+        std::vector<ReleasedBufferStats> releasedBuffers) {
+    std::vector<ReleaseBufferCallback> callbacks;
+    callbacks.reserve(releasedBuffers.size());
+    {
+        std::scoped_lock<std::mutex> lock(mMutex);
+        for (const auto& releasedBuffer : releasedBuffers) {
+            callbacks.push_back(popReleaseBufferCallbackLocked(releasedBuffer.callbackId));
+        }
+    }
+    for (size_t i = 0; i < releasedBuffers.size(); i++) {
+        const ReleasedBufferStats& releasedBuffer = releasedBuffers[i];
+        if (!callbacks[i]) {
+            ALOGE("Could not call release buffer callback, buffer not found %s",
+                  releasedBuffer.callbackId.to_string().c_str());
+            continue;
+        }
+        callbacks[i](releasedBuffer.callbackId, releasedBuffer.releaseFence,
+                     releasedBuffer.transformHint, releasedBuffer.currentMaxAcquiredBufferCount);
+    }
+}
+
 ReleaseBufferCallback TransactionCompletedListener::popReleaseBufferCallbackLocked(
         const ReleaseCallbackId& callbackId) {
     ReleaseBufferCallback callback;
@@ -418,6 +442,9 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId);
  *        transaction.
  *     3. The client only references the Buffers by ID, and uses buffer->addDeathCallback
  *        to auto-evict destroyed buffers.
+ *     4. The server may still evict entries when the buffers cached by all processes go over
+ *        its memory budget. It then notifies the client via onBufferUncached, and the client
+ *        sends the buffer again the next time it is used.
  */
 class BufferCache : public Singleton<BufferCache> {
 public:
@@ -457,6 +484,12 @@ public:
         uncacheLocked(cacheId);
     }
 
+    // Forgets a buffer the server evicted from its side of the cache, without uncaching it there.
+    void onServerEvicted(uint64_t cacheId) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mBuffers.erase(cacheId);
+    }
+
     void uncacheLocked(uint64_t cacheId) REQUIRES(mMutex) {
         mBuffers.erase(cacheId);
         SurfaceComposerClient::doUncacheBufferTransaction(cacheId);
@@ -499,6 +532,10 @@ void removeDeadBufferCallback(void* /*context*/, uint64_t graphicBufferId) {
     BufferCache::getInstance().uncache(graphicBufferId);
 }
 
+void TransactionCompletedListener::onBufferUncached(uint64_t cacheId) {
+    BufferCache::getInstance().onServerEvicted(cacheId);
+}
+
 // ---------------------------------------------------------------------------
 
 // Initialize transaction id counter used to generate transaction ids
@@ -523,6 +560,7 @@ SurfaceComposerClient::Transaction::Transaction(const Transaction& other)
         mApplyToken(other.mApplyToken) {
     mDisplayStates = other.mDisplayStates;
     mComposerStates = other.mComposerStates;
+    mComposerStateHandles = other.mComposerStateHandles;
     mInputWindowCommands = other.mInputWindowCommands;
     mListenerCallbacks = other.mListenerCallbacks;
 }
@@ -601,8 +639,10 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
     if (count > parcel->dataSize()) {
         return BAD_VALUE;
     }
-    std::unordered_map<sp<IBinder>, ComposerState, IBinderHash> composerStates;
-    composerStates.reserve(count);
+    Vector<ComposerState> composerStates;
+    std::vector<IBinder*> composerStateHandles;
+    composerStates.setCapacity(count);
+    composerStateHandles.reserve(count);
     for (size_t i = 0; i < count; i++) {
         sp<IBinder> surfaceControlHandle;
         SAFE_PARCEL(parcel->readStrongBinder, &surfaceControlHandle);
@@ -612,7 +652,9 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
             return BAD_VALUE;
         }
 
-        composerStates[surfaceControlHandle] = composerState;
+        // keyed by the handle held in the state, which keeps it alive
+        composerStates.add(composerState);
+        composerStateHandles.push_back(composerState.state.surface.get());
     }
 
     InputWindowCommands inputWindowCommands;
@@ -631,6 +673,7 @@ status_t SurfaceComposerClient::Transaction::readFromParcel(const Parcel* parcel
     mDisplayStates = displayStates;
     mListenerCallbacks = listenerCallbacks;
     mComposerStates = composerStates;
+    mComposerStateHandles = std::move(composerStateHandles);
     mInputWindowCommands = inputWindowCommands;
     mApplyToken = applyToken;
     return NO_ERROR;
@@ -679,8 +722,8 @@ status_t SurfaceComposerClient::Transaction::writeToParcel(Parcel* parcel) const
     }
 
     parcel->writeUint32(static_cast<uint32_t>(mComposerStates.size()));
-    for (auto const& [handle, composerState] : mComposerStates) {
-        SAFE_PARCEL(parcel->writeStrongBinder, handle);
+    for (auto const& composerState : mComposerStates) {
+        SAFE_PARCEL(parcel->writeStrongBinder, composerState.state.surface);
         composerState.write(*parcel);
     }
 
@@ -689,11 +732,14 @@ status_t SurfaceComposerClient::Transaction::writeToParcel(Parcel* parcel) const
 }
 
 SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Transaction&& other) {
-    for (auto const& [handle, composerState] : other.mComposerStates) {
-        if (mComposerStates.count(handle) == 0) {
-            mComposerStates[handle] = composerState;
+    mComposerStates.setCapacity(mComposerStates.size() + other.mComposerStates.size());
+    for (auto const& composerState : other.mComposerStates) {
+        const sp<IBinder>& handle = composerState.state.surface;
+        ssize_t index = indexOfLayerState(handle);
+        if (index < 0) {
+            addLayerState(handle, composerState);
         } else {
-            mComposerStates[handle].state.merge(composerState.state);
+            mComposerStates.editItemAt(static_cast<size_t>(index)).state.merge(composerState.state);
         }
     }
 
@@ -744,6 +790,7 @@ SurfaceComposerClient::Transaction& SurfaceComposerClient::Transaction::merge(Tr
 
 void SurfaceComposerClient::Transaction::clear() {
     mComposerStates.clear();
+    mComposerStateHandles.clear();
     mDisplayStates.clear();
     mListenerCallbacks.clear();
     mInputWindowCommands.clear();
@@ -777,8 +824,8 @@ void SurfaceComposerClient::Transaction::cacheBuffers() {
     }
 
     size_t count = 0;
-    for (auto& [handle, cs] : mComposerStates) {
-        layer_state_t* s = &(mComposerStates[handle].state);
+    for (size_t i = 0; i < mComposerStates.size(); i++) {
+        layer_state_t* s = &(mComposerStates.editItemAt(i).state);
         if (!(s->what & layer_state_t::eBufferChanged)) {
             continue;
         } else if (s->what & layer_state_t::eCachedBufferChanged) {
@@ -853,16 +900,11 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
 
     cacheBuffers();
 
-    Vector<ComposerState> composerStates;
     Vector<DisplayState> displayStates;
     uint32_t flags = 0;
 
     mForceSynchronous |= synchronous;
 
-    for (auto const& kv : mComposerStates){
-        composerStates.add(kv.second);
-    }
-
     displayStates = std::move(mDisplayStates);
 
     if (mForceSynchronous) {
@@ -885,7 +927,7 @@ status_t SurfaceComposerClient::Transaction::apply(bool synchronous) {
             ? mApplyToken
             : IInterface::asBinder(TransactionCompletedListener::getIInstance());
 
-    sf->setTransactionState(mFrameTimelineInfo, composerStates, displayStates, flags, applyToken,
+    sf->setTransactionState(mFrameTimelineInfo, mComposerStates, displayStates, flags, applyToken,
                             mInputWindowCommands, mDesiredPresentTime, mIsAutoTimestamp,
                             {} /*uncacheBuffer - only set in doUncacheBufferTransaction*/,
                             hasListenerCallbacks, listenerCallbacks, mId);
@@ -940,17 +982,36 @@ void SurfaceComposerClient::Transaction::setEarlyWakeupEnd() {
 layer_state_t* SurfaceComposerClient::Transaction::getLayerState(const sp<SurfaceControl>& sc) {
     auto handle = sc->getLayerStateHandle();
 
-    if (mComposerStates.count(handle) == 0) {
+    ssize_t index = indexOfLayerState(handle);
+    if (index < 0) {
         // we don't have it, add an initialized layer_state to our list
-        ComposerState s;
+        layer_state_t* s = addLayerState(handle, ComposerState());
+        s->surface = handle;
+        s->layerId = sc->getLayerId();
+        return s;
+    }
 
-        s.state.surface = handle;
-        s.state.layerId = sc->getLayerId();
+    return &(mComposerStates.editItemAt(static_cast<size_t>(index)).state);
+}
 
-        mComposerStates[handle] = s;
+ssize_t SurfaceComposerClient::Transaction::indexOfLayerState(const sp<IBinder>& handle) {
+    if (mLastComposerStateIndex < mComposerStateHandles.size() &&
+        mComposerStateHandles[mLastComposerStateIndex] == handle.get()) {
+        return static_cast<ssize_t>(mLastComposerStateIndex);
+    }
+    auto it = std::find(mComposerStateHandles.begin(), mComposerStateHandles.end(), handle.get());
+    if (it == mComposerStateHandles.end()) {
+        return NAME_NOT_FOUND;
     }
+    mLastComposerStateIndex = static_cast<size_t>(it - mComposerStateHandles.begin());
+    return static_cast<ssize_t>(mLastComposerStateIndex);
+}
 
-    return &(mComposerStates[handle].state);
+layer_state_t* SurfaceComposerClient::Transaction::addLayerState(const sp<IBinder>& handle,
+                                                                 const ComposerState& state) {
+    mLastComposerStateIndex = static_cast<size_t>(mComposerStates.add(state));
+    mComposerStateHandles.push_back(handle.get());
+    return &(mComposerStates.editItemAt(mLastComposerStateIndex).state);
 }
 
 void SurfaceComposerClient::Transaction::registerSurfaceControlForCallback(
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "VsyncRing"
+
+#include <private/gui/VsyncRing.h>
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstring>
+
+#include <binder/Parcel.h>
+#include <cutils/ashmem.h>
+#include <utils/Log.h>
+
+namespace android {
+namespace gui {
+
+// Each slot is written under its own seqlock: the sequence is odd while the
+// writer is in the middle of updating the event. 'published' counts the events
+// and tells readers which slot holds the latest one.
+struct VsyncRing::Shared {
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        DisplayEventReceiver::Event event;
+    };
+
+    std::atomic<uint64_t> published;
+    Slot slots[kCapacity];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                      std::atomic<uint32_t>::is_always_lock_free,
+              "VsyncRing needs address free atomics to be shared across processes");
+
+VsyncRing::VsyncRing(CreateType) {
+    base::unique_fd memoryFd(ashmem_create_region("VsyncRing", sizeof(Shared)));
+    if (memoryFd < 0) {
+        ALOGE("VsyncRing: ashmem creation failed (%s)", strerror(errno));
+        return;
+    }
+    base::unique_fd doorbellFd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+    if (doorbellFd < 0) {
+        ALOGE("VsyncRing: eventfd creation failed (%s)", strerror(errno));
+        return;
+    }
+    if (map(std::move(memoryFd), std::move(doorbellFd), true) != NO_ERROR) {
+        return;
+    }
+    // Readers only ever get to map the ring read-only.
+    if (ashmem_set_prot_region(mMemoryFd, PROT_READ) < 0) {
+        ALOGE("VsyncRing: can't restrict ashmem protection (%s)", strerror(errno));
+        unmap();
+    }
+}
+
+VsyncRing::~VsyncRing() {
+    unmap();
+}
+
+status_t VsyncRing::map(base::unique_fd memoryFd, base::unique_fd doorbellFd, bool writable) {
+    unmap();
+
+    const int size = ashmem_get_size_region(memoryFd);
+    if (size < 0 || static_cast<size_t>(size) < sizeof(Shared)) {
+        ALOGE("VsyncRing: unexpected ashmem size %d", size);
+        return BAD_VALUE;
+    }
+    void* addr = mmap(nullptr, sizeof(Shared), writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                      MAP_SHARED, memoryFd, 0);
+    if (addr == MAP_FAILED) {
+        int error = errno;
+        ALOGE("VsyncRing: mmap failed (%s)", strerror(error));
+        return -error;
+    }
+
+    mShared = static_cast<Shared*>(addr);
+    mMemoryFd = std::move(memoryFd);
+    mDoorbellFd = std::move(doorbellFd);
+    mWritable = writable;
+    return NO_ERROR;
+}
+
+void VsyncRing::unmap() {
+    if (mShared != nullptr) {
+        munmap(mShared, sizeof(Shared));
+        mShared = nullptr;
+    }
+    mMemoryFd.reset();
+    mDoorbellFd.reset();
+    mWritable = false;
+}
+
+status_t VsyncRing::initCheck() const {
+    return mShared != nullptr ? NO_ERROR : NO_INIT;
+}
+
+int VsyncRing::getDoorbellFd() const {
+    return mDoorbellFd;
+}
+
+status_t VsyncRing::share(VsyncRing* outRing) const {
+    if (mShared == nullptr) return NO_INIT;
+
+    base::unique_fd memoryFd(fcntl(mMemoryFd, F_DUPFD_CLOEXEC, 0));
+    base::unique_fd doorbellFd(fcntl(mDoorbellFd, F_DUPFD_CLOEXEC, 0));
+    if (memoryFd < 0 || doorbellFd < 0) {
+        int error = errno;
+        ALOGE("VsyncRing::share: can't dup file descriptor (%s)", strerror(error));
+        return -error;
+    }
+    return outRing->map(std::move(memoryFd), std::move(doorbellFd), false);
+}
+
+status_t VsyncRing::publish(const DisplayEventReceiver::Event& event) {
+    if (!mWritable) return INVALID_OPERATION;
+
+    const uint64_t published = mShared->published.load(std::memory_order_relaxed);
+    Shared::Slot& slot = mShared->slots[published % kCapacity];
+    const uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.event, &event, sizeof(event));
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    mShared->published.store(published + 1, std::memory_order_release);
+
+    const uint64_t ring = 1;
+    ssize_t len = TEMP_FAILURE_RETRY(::write(mDoorbellFd, &ring, sizeof(ring)));
+    // EAGAIN only happens when the counter is about to overflow, which means
+    // the doorbell is readable anyway.
+    if (len < 0 && errno != EAGAIN) {
+        return -errno;
+    }
+    return NO_ERROR;
+}
+
+status_t VsyncRing::readLatest(DisplayEventReceiver::Event* outEvent,
+                               uint64_t* outSequence) const {
+    if (mShared == nullptr) return NO_INIT;
+
+    while (true) {
+        const uint64_t published = mShared->published.load(std::memory_order_acquire);
+        if (published == 0) {
+            return NOT_ENOUGH_DATA;
+        }
+        const Shared::Slot& slot = mShared->slots[(published - 1) % kCapacity];
+        const uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            // The writer lapped us and is rewriting this slot; by the time it
+            // is done there is a newer event to read.
+            continue;
+        }
+        memcpy(outEvent, &slot.event, sizeof(*outEvent));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before) {
+            *outSequence = published;
+            return NO_ERROR;
+        }
+    }
+}
+
+void VsyncRing::clearDoorbell() const {
+    uint64_t rings;
+    TEMP_FAILURE_RETRY(::read(mDoorbellFd, &rings, sizeof(rings)));
+}
+
+status_t VsyncRing::writeToParcel(Parcel* reply) const {
+    if (mShared == nullptr) return NO_INIT;
+
+    status_t result = reply->writeDupFileDescriptor(mMemoryFd);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    return reply->writeDupFileDescriptor(mDoorbellFd);
+}
+
+status_t VsyncRing::readFromParcel(const Parcel* parcel) {
+    base::unique_fd memoryFd;
+    base::unique_fd doorbellFd;
+    status_t result = parcel->readUniqueFileDescriptor(&memoryFd);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    result = parcel->readUniqueFileDescriptor(&doorbellFd);
+    if (result != NO_ERROR) {
+        return result;
+    }
+    return map(std::move(memoryFd), std::move(doorbellFd), false);
+}
+
+} // namespace gui
+} // namespace android
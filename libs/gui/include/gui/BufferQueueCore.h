@@ -29,6 +29,7 @@
 #include <utils/Trace.h>
 #include <utils/Vector.h>
 
+#include <atomic>
 #include <list>
 #include <set>
 #include <mutex>
@@ -130,6 +131,11 @@ private:
     // waitWhileAllocatingLocked blocks until mIsAllocating is false.
     void waitWhileAllocatingLocked(std::unique_lock<std::mutex>& lock) const;
 
+    // publishQueryStateLocked copies the values reported by
+    // IGraphicBufferProducer::query into mQueryState. It must be called
+    // whenever one of the member variables they are derived from changes.
+    void publishQueryStateLocked();
+
 #if DEBUG_ONLY_CODE
     // validateConsistencyLocked ensures that the free lists are in sync with
     // the information stored in mSlots
@@ -357,6 +363,24 @@ private:
     // This allows the consumer to acquire an additional buffer if that buffer is not droppable and
     // will eventually be released or acquired by the consumer.
     bool mAllowExtraAcquire = false;
+
+    // mQueryState mirrors the member variables which query() reports, so that
+    // producers polling them don't contend with dequeueBuffer and
+    // acquireBuffer for mMutex. It is only written by publishQueryStateLocked,
+    // and may be read without holding mMutex.
+    struct QueryState {
+        std::atomic<bool> isAbandoned;
+        std::atomic<uint32_t> defaultWidth;
+        std::atomic<uint32_t> defaultHeight;
+        std::atomic<int32_t> defaultBufferFormat;
+        std::atomic<int32_t> defaultBufferDataSpace;
+        std::atomic<uint64_t> consumerUsageBits;
+        std::atomic<bool> consumerIsProtected;
+        std::atomic<int32_t> minUndequeuedBufferCount;
+        std::atomic<bool> consumerRunningBehind;
+        std::atomic<uint64_t> bufferAge;
+    };
+    QueryState mQueryState;
 }; // class BufferQueueCore
 
 } // namespace android
@@ -20,6 +20,8 @@
 #include <gui/BufferQueueDefs.h>
 #include <gui/IGraphicBufferProducer.h>
 
+#include <atomic>
+
 namespace android {
 
 class IBinder;
@@ -202,7 +204,39 @@ public:
     // See IGraphicBufferProducer::setAutoPrerotation
     virtual status_t setAutoPrerotation(bool autoPrerotation);
 
+    // The batched operations below handle the whole batch under a single
+    // acquisition of mCore->mMutex (query doesn't take it at all).
+    // dequeueBuffers and queueBuffers keep the
+    // default implementation, since each call may wait or call out to the
+    // consumer with the lock released.
+
+    // See IGraphicBufferProducer::requestBuffers
+    virtual status_t requestBuffers(const std::vector<int32_t>& slots,
+            std::vector<RequestBufferOutput>* outputs) override;
+
+    // See IGraphicBufferProducer::detachBuffers
+    virtual status_t detachBuffers(const std::vector<int32_t>& slots,
+            std::vector<status_t>* results) override;
+
+    // See IGraphicBufferProducer::cancelBuffers
+    virtual status_t cancelBuffers(const std::vector<CancelBufferInput>& inputs,
+            std::vector<status_t>* results) override;
+
+    // See IGraphicBufferProducer::query
+    virtual status_t query(const std::vector<int32_t> inputs,
+            std::vector<QueryOutput>* outputs) override;
+
 private:
+    // Bodies of requestBuffer, detachBuffer and cancelBuffer, shared with
+    // their batched versions. mCore->mMutex must be held.
+    status_t requestBufferLocked(int slot, sp<GraphicBuffer>* buf);
+    status_t detachBufferLocked(int slot);
+    status_t cancelBufferLocked(int slot, const sp<Fence>& fence);
+
+    // Body of both query versions. It reads mCore->mQueryState, so it doesn't
+    // need mCore->mMutex.
+    int queryLockFree(int what, int* outValue);
+
     // This is required by the IBinder::DeathRecipient interface
     virtual void binderDied(const wp<IBinder>& who);
 
@@ -239,7 +273,7 @@ private:
     // most updates).
     String8 mConsumerName;
 
-    uint32_t mStickyTransform;
+    std::atomic<uint32_t> mStickyTransform;
 
     // This controls whether the GraphicBuffer pointer in the BufferItem is
     // cleared after being queued
@@ -111,6 +111,19 @@ class CpuConsumer : public ConsumerBase
     // lockNextBuffer.
     status_t unlockBuffer(const LockedBuffer &nativeBuffer);
 
+    // Keeps slot buffers locked for CPU access between unlockBuffer and the
+    // next lockNextBuffer of the same slot, instead of unlocking and locking
+    // them again every frame. A mapping is dropped when its slot is freed or
+    // reallocated, or when the crop changes. Buffers that a non-CPU producer
+    // may write to are reread through gralloc before they are returned
+    // again; where gralloc can't do that they are locked on every frame as
+    // before. Disabled by default.
+    void setPersistentMapping(bool enabled);
+
+  protected:
+    // Drops the persistent mapping of the slot, if any, before freeing it.
+    virtual void freeBufferLocked(int slotIndex) override;
+
   private:
     // Maximum number of buffers that can be locked at a time
     const size_t mMaxLockedBuffers;
@@ -142,10 +155,34 @@ class CpuConsumer : public ConsumerBase
 
     status_t lockBufferItem(const BufferItem& item, LockedBuffer* outBuffer) const;
 
+    // Fills outBuffer from the persistent mapping of item's slot, once the
+    // producer is done writing to it.
+    status_t reuseMappedBufferLocked(const BufferItem& item, LockedBuffer* outBuffer);
+
+    // Unlocks the persistent mapping of a slot that isn't currently acquired.
+    void unmapBufferLocked(int slot);
+
     Vector<AcquiredBuffer> mAcquiredBuffers;
 
     // Count of currently locked buffers
     size_t mCurrentLockedBuffers;
+
+    // A slot buffer kept locked by setPersistentMapping
+    struct MappedBuffer {
+        sp<GraphicBuffer> mGraphicBuffer;
+        Rect mCrop;
+        LockedBuffer mLockedBuffer;
+        // Whether the buffer is currently acquired by the user
+        bool mInUse = false;
+    };
+
+    bool mPersistentMapping = false;
+
+    // Set once gralloc fails to reread a buffer, after which buffers that
+    // need rereading are no longer kept mapped.
+    bool mRereadUnsupported = false;
+
+    MappedBuffer mMappedBuffers[BufferQueue::NUM_BUFFER_SLOTS];
 };
 
 } // namespace android
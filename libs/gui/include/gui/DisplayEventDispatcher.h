@@ -42,6 +42,10 @@ public:
             ISurfaceComposer::VsyncSource vsyncSource = ISurfaceComposer::eVsyncSourceApp,
             ISurfaceComposer::EventRegistrationFlags eventRegistration = {});
 
+    // Receives vsync events through shared memory instead of the event queue, see
+    // DisplayEventReceiver::enableVsyncRing(). Must be called before initialize().
+    status_t useVsyncRing();
+
     status_t initialize();
     void dispose();
     status_t scheduleVsync();
@@ -56,6 +60,9 @@ private:
     sp<Looper> mLooper;
     DisplayEventReceiver mReceiver;
     bool mWaitingForVsync;
+    bool mUseVsyncRing = false;
+    // Sequence of the last vsync from the ring that was dispatched or dropped
+    uint64_t mLastVsyncSequence = 0;
 
     std::vector<FrameRateOverride> mFrameRateOverrides;
 
@@ -74,5 +81,7 @@ private:
 
     bool processPendingEvents(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
                               uint32_t* outCount, VsyncEventData* outVsyncEventData);
+    bool processLatestVsync(nsecs_t* outTimestamp, PhysicalDisplayId* outDisplayId,
+                            uint32_t* outCount, VsyncEventData* outVsyncEventData);
 };
 } // namespace android
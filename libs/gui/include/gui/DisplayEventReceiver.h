@@ -37,6 +37,7 @@ class IDisplayEventConnection;
 
 namespace gui {
 class BitTube;
+class VsyncRing;
 } // namespace gui
 
 static inline constexpr uint32_t fourcc(char c1, char c2, char c3, char c4) {
@@ -163,9 +164,39 @@ public:
      */
     status_t requestNextVsync();
 
+    /*
+     * enableVsyncRing() switches Event::VSync delivery to a shared memory ring.
+     * Vsync events are no longer returned by getEvents(); instead getVsyncFd()
+     * becomes readable when one is published, and getLatestVsync() returns the
+     * most recent one. Other events are still read through getFd().
+     */
+    status_t enableVsyncRing();
+
+    /*
+     * getVsyncFd returns the file descriptor that signals new vsync events once
+     * enableVsyncRing() succeeded, or NO_INIT.
+     * OWNERSHIP IS RETAINED by DisplayEventReceiver. DO NOT CLOSE this
+     * file-descriptor.
+     */
+    int getVsyncFd() const;
+
+    /*
+     * getLatestVsync() copies the most recent vsync event to outEvent without
+     * a syscall. outSequence counts the vsync events published so far, so that
+     * callers can tell an event they already handled from a new one. Returns
+     * NOT_ENOUGH_DATA if no vsync was published yet.
+     */
+    status_t getLatestVsync(Event* outEvent, uint64_t* outSequence) const;
+
+    /*
+     * clearVsyncFd() resets getVsyncFd() to non readable until the next vsync.
+     */
+    void clearVsyncFd();
+
 private:
     sp<IDisplayEventConnection> mEventConnection;
     std::unique_ptr<gui::BitTube> mDataChannel;
+    std::unique_ptr<gui::VsyncRing> mVsyncRing;
 };
 
 // ----------------------------------------------------------------------------
@@ -244,6 +244,9 @@ private:
 // through Binder.
 // Although this may be sent multiple times for the same frame as new
 // timestamps are set, Fences only need to be sent once.
+// Fences which have already signaled are sent as their signal time, and
+// timestamps are sent as offsets from the first one, so most deltas only
+// flatten a few bytes per timestamp and no fds.
 class FrameEventsDelta : public Flattenable<FrameEventsDelta> {
 friend class ProducerFrameEventHistory;
 public:
@@ -270,6 +273,10 @@ public:
 private:
     static constexpr size_t minFlattenedSize();
 
+    // The timestamps and fence signal times which are flattened, in order,
+    // and the flattened field mask describing them. Returns how many there are.
+    size_t getFlattenedTimes(std::array<nsecs_t, 9>* times, uint16_t* fields) const;
+
     size_t mIndex{0};
     uint64_t mFrameNumber{0};
 
@@ -297,6 +304,16 @@ private:
             &fed->mReleaseFence
         }};
     }
+
+    template <typename ThisT>
+    static inline auto allTimestamps(ThisT fed) ->
+            std::array<decltype(&fed->mPostedTime), 6> {
+        return {{
+            &fed->mPostedTime, &fed->mRequestedPresentTime, &fed->mLatchTime,
+            &fed->mFirstRefreshStartTime, &fed->mLastRefreshStartTime,
+            &fed->mDequeueReadyTime
+        }};
+    }
 };
 
 
@@ -27,6 +27,7 @@ namespace android {
 
 namespace gui {
 class BitTube;
+class VsyncRing;
 } // namespace gui
 
 class IDisplayEventConnection : public IInterface {
@@ -51,6 +52,13 @@ public:
      * requestNextVsync() schedules the next vsync event. It has no effect if the vsync rate is > 0.
      */
     virtual void requestNextVsync() = 0; // Asynchronous
+
+    /*
+     * getVsyncRing() returns a read-only view of a shared memory ring holding the latest vsync
+     * events. From then on vsync events are published to the ring and signaled through its
+     * doorbell instead of being sent through the receive channel. Other events are unaffected.
+     */
+    virtual status_t getVsyncRing(gui::VsyncRing* outRing) = 0;
 };
 
 class BnDisplayEventConnection : public SafeBnInterface<IDisplayEventConnection> {
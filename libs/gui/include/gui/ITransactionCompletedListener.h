@@ -185,6 +185,26 @@ public:
     std::vector<TransactionStats> transactionStats;
 };
 
+// A buffer SurfaceFlinger no longer needs, sent outside of a transaction callback.
+class ReleasedBufferStats : public Parcelable {
+public:
+    status_t writeToParcel(Parcel* output) const override;
+    status_t readFromParcel(const Parcel* input) override;
+
+    ReleasedBufferStats() = default;
+    ReleasedBufferStats(const ReleaseCallbackId& id, const sp<Fence>& fence, uint32_t hint,
+                        uint32_t maxAcquiredBufferCount)
+          : callbackId(id),
+            releaseFence(fence),
+            transformHint(hint),
+            currentMaxAcquiredBufferCount(maxAcquiredBufferCount) {}
+
+    ReleaseCallbackId callbackId;
+    sp<Fence> releaseFence;
+    uint32_t transformHint = 0;
+    uint32_t currentMaxAcquiredBufferCount = 0;
+};
+
 class ITransactionCompletedListener : public IInterface {
 public:
     DECLARE_META_INTERFACE(TransactionCompletedListener)
@@ -194,6 +214,13 @@ public:
     virtual void onReleaseBuffer(ReleaseCallbackId callbackId, sp<Fence> releaseFence,
                                  uint32_t transformHint,
                                  uint32_t currentMaxAcquiredBufferCount) = 0;
+
+    // Same as onReleaseBuffer, for all the buffers released for this listener in one commit.
+    virtual void onReleaseBuffers(std::vector<ReleasedBufferStats> releasedBuffers) = 0;
+
+    // Called when SurfaceFlinger evicts a buffer this process cached, so the buffer has to be sent
+    // again instead of its cache id.
+    virtual void onBufferUncached(uint64_t cacheId) = 0;
 };
 
 class BnTransactionCompletedListener : public SafeBnInterface<ITransactionCompletedListener> {
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <binder/Parcelable.h>
+#include <ftl/sorted_small_map.h>
 
 #include <unordered_map>
 
@@ -34,7 +35,11 @@ enum {
 };
 
 struct LayerMetadata : public Parcelable {
-    std::unordered_map<uint32_t, std::vector<uint8_t>> mMap;
+    // Layers only carry a few of the well-known keys above, so the entries are kept sorted in
+    // inline storage rather than hashed, which makes copying and merging cheap.
+    static constexpr size_t kInlineEntries = 4;
+    using Map = ftl::SortedSmallMap<uint32_t, std::vector<uint8_t>, kInlineEntries>;
+    Map mMap;
 
     LayerMetadata();
     LayerMetadata(const LayerMetadata& other);
@@ -51,6 +56,8 @@ struct LayerMetadata : public Parcelable {
     status_t readFromParcel(const Parcel* parcel) override;
 
     bool has(uint32_t key) const;
+    // The integer accessors read and write the values in place, in the layout of the Parcel that
+    // clients write them with.
     int32_t getInt32(uint32_t key, int32_t fallback) const;
     void setInt32(uint32_t key, int32_t value);
     std::optional<int64_t> getInt64(uint32_t key) const;
@@ -22,8 +22,8 @@
 
 #include <utils/Timers.h>
 
-#include <deque>
-#include <unordered_map>
+#include <array>
+#include <vector>
 
 namespace android {
 
@@ -35,6 +35,9 @@ public:
     OccupancyTracker()
       : mPendingSegment(),
         mSegmentHistory(),
+        mNextSegment(0),
+        mSegmentCount(0),
+        mOccupancyHistogram(),
         mLastOccupancy(0),
         mLastOccupancyChangeTime(0) {}
 
@@ -69,9 +72,22 @@ public:
         bool usedThirdBuffer;
     };
 
+    // Time spent at each queue occupancy while frames are flowing, since the
+    // tracker was created. The last bucket also counts the time spent at any
+    // higher occupancy.
+    static constexpr size_t OCCUPANCY_HISTOGRAM_SIZE = 4;
+    using OccupancyHistogram = std::array<nsecs_t, OCCUPANCY_HISTOGRAM_SIZE>;
+
     void registerOccupancyChange(size_t occupancy);
     std::vector<Segment> getSegmentHistory(bool forceFlush);
 
+    // Unlike the segment history, the histogram is never cleared, so it can be
+    // read at any time without losing data for other readers.
+    const OccupancyHistogram& getOccupancyHistogram() const {
+        return mOccupancyHistogram;
+    }
+    void dumpOccupancyHistogram(const String8& prefix, String8* outResult) const;
+
 private:
     static constexpr size_t MAX_HISTORY_SIZE = 10;
     static constexpr nsecs_t NEW_SEGMENT_DELAY = ms2ns(100);
@@ -81,18 +97,31 @@ private:
         void clear() {
             totalTime = 0;
             numFrames = 0;
-            mOccupancyTimes.clear();
+            weightedTime = 0;
+            usedThirdBuffer = false;
         }
 
         nsecs_t totalTime;
         size_t numFrames;
-        std::unordered_map<size_t, nsecs_t> mOccupancyTimes;
+
+        // Sum of the time spent at each occupancy multiplied by the occupancy,
+        // which gives the average occupancy without keeping the time spent at
+        // each of them.
+        nsecs_t weightedTime;
+        bool usedThirdBuffer;
     };
 
     void recordPendingSegment();
 
     PendingSegment mPendingSegment;
-    std::deque<Segment> mSegmentHistory;
+
+    // Ring of the most recent segments, mNextSegment being where the next one
+    // goes.
+    std::array<Segment, MAX_HISTORY_SIZE> mSegmentHistory;
+    size_t mNextSegment;
+    size_t mSegmentCount;
+
+    OccupancyHistogram mOccupancyHistogram;
 
     size_t mLastOccupancy;
     nsecs_t mLastOccupancyChangeTime;
@@ -18,6 +18,7 @@
 #define ANDROID_GUI_STREAMSPLITTER_H
 
 #include <gui/IConsumerListener.h>
+#include <gui/IGraphicBufferProducer.h>
 #include <gui/IProducerListener.h>
 
 #include <utils/Condition.h>
@@ -25,11 +26,16 @@
 #include <utils/Mutex.h>
 #include <utils/StrongPointer.h>
 
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
 namespace android {
 
 class GraphicBuffer;
 class IGraphicBufferConsumer;
-class IGraphicBufferProducer;
 
 // StreamSplitter is an autonomous class that manages one input BufferQueue
 // and multiple output BufferQueues. By using the buffer attach and detach logic
@@ -50,18 +56,37 @@ public:
     static status_t createSplitter(const sp<IGraphicBufferConsumer>& inputQueue,
             sp<StreamSplitter>* outSplitter);
 
+    // How the buffers queued to the input are queued to an output.
+    enum class OutputPolicy {
+        // The buffers are queued to the output from the thread that queued
+        // them to the input, so an output that is slow to free its slots
+        // delays the outputs after it. Every buffer is queued to the output.
+        SYNCHRONOUS,
+        // The buffers are queued to the output from a thread of its own, so a
+        // slow output only delays the others once MAX_OUTSTANDING_BUFFERS are
+        // waiting for it. Every buffer is queued to the output.
+        ASYNCHRONOUS,
+        // Like ASYNCHRONOUS, but a buffer is dropped for this output instead of
+        // waiting for it: when a newer buffer is queued to the input before the
+        // thread of the output got to it, or when the output has no free slot
+        // for it. A dropped buffer counts as released by this output.
+        ASYNCHRONOUS_DROPPING,
+    };
+
     // addOutput adds an output BufferQueue to the splitter. The splitter
     // connects to outputQueue as a CPU producer, and any buffers queued
-    // to the input will be queued to each output. It is assumed that all of the
-    // outputs are added before any buffers are queued on the input. If any
-    // output is abandoned by its consumer, the splitter will abandon its input
-    // queue (see onAbandoned).
+    // to the input will be queued to each output, as set by policy. It is
+    // assumed that all of the outputs are added before any buffers are queued
+    // on the input. If any output is abandoned by its consumer, the splitter
+    // will abandon its input queue (see onAbandoned). A dropping output gets a
+    // dequeue timeout of 0, so that attaching a buffer to it never waits.
     //
     // A return value other than NO_ERROR means that an error has occurred and
     // outputQueue has not been added to the splitter. BAD_VALUE is returned if
     // outputQueue is NULL. See IGraphicBufferProducer::connect for explanations
     // of other error codes.
-    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue);
+    status_t addOutput(const sp<IGraphicBufferProducer>& outputQueue,
+            OutputPolicy policy = OutputPolicy::SYNCHRONOUS);
 
     // setName sets the consumer name of the input queue
     void setName(const String8& name);
@@ -70,10 +95,10 @@ private:
     // From IConsumerListener
     //
     // During this callback, we store some tracking information, detach the
-    // buffer from the input, and attach it to each of the outputs. This call
-    // can block if there are too many outstanding buffers. If it blocks, it
-    // will resume when onBufferReleasedByOutput releases a buffer back to the
-    // input.
+    // buffer from the input, hand it to the thread of each asynchronous output
+    // and attach it to each of the synchronous outputs. This call can block if
+    // there are too many outstanding buffers. If it blocks, it will resume when
+    // onBufferReleasedByOutput releases a buffer back to the input.
     virtual void onFrameAvailable(const BufferItem& item);
 
     // From IConsumerListener
@@ -153,6 +178,38 @@ private:
         size_t mReleaseCount;
     };
 
+    // A buffer acquired from the input, and how to queue it to the outputs
+    struct PendingBuffer {
+        sp<BufferTracker> tracker;
+        IGraphicBufferProducer::QueueBufferInput input;
+    };
+
+    struct Output {
+        sp<IGraphicBufferProducer> producer;
+        OutputPolicy policy;
+        // The buffers that the thread of an asynchronous output has yet to
+        // queue to it, oldest first, and the condition it waits on for them
+        std::deque<PendingBuffer> pending;
+        Condition pendingCondition;
+        std::thread thread;
+    };
+
+    // Counts one more release of the buffer of tracker, and releases it to the
+    // input if all of the outputs have released it. This must be called with
+    // mMutex locked.
+    void releaseToInputLocked(const sp<BufferTracker>& tracker);
+
+    // Attaches and queues buffer to output. This must be called with mMutex
+    // unlocked, since it can block until output has a free slot.
+    void queueToOutput(Output* output, const PendingBuffer& buffer);
+
+    // Waits for the next pending buffer of output, or returns nothing once the
+    // splitter is being destroyed.
+    std::optional<PendingBuffer> takePendingBuffer(Output* output);
+
+    // The thread of an asynchronous output
+    void outputThreadMain(Output* output);
+
     // Only called from createSplitter
     explicit StreamSplitter(const sp<IGraphicBufferConsumer>& inputQueue);
 
@@ -167,11 +224,15 @@ private:
     // communicate with it further.
     bool mIsAbandoned;
 
+    // mIsStopping is set to true when the splitter is destroyed, to stop the
+    // threads of the asynchronous outputs.
+    bool mIsStopping;
+
     Mutex mMutex;
     Condition mReleaseCondition;
     int mOutstandingBuffers;
     sp<IGraphicBufferConsumer> mInput;
-    Vector<sp<IGraphicBufferProducer> > mOutputs;
+    std::vector<std::unique_ptr<Output>> mOutputs;
 
     // Map of GraphicBuffer IDs (GraphicBuffer::getId()) to buffer tracking
     // objects (which are mostly for counting how many outputs have released the
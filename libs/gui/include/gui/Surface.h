@@ -30,6 +30,7 @@
 #include <utils/Mutex.h>
 #include <utils/RefBase.h>
 
+#include <memory>
 #include <shared_mutex>
 #include <unordered_set>
 
@@ -277,6 +278,7 @@ private:
     int dispatchGetLastQueuedBuffer(va_list args);
     int dispatchGetLastQueuedBuffer2(va_list args);
     int dispatchSetFrameTimelineInfo(va_list args);
+    int dispatchSetDequeueAhead(va_list args);
 
 protected:
     virtual int dequeueBuffer(ANativeWindowBuffer** buffer, int* fenceFd);
@@ -312,6 +314,11 @@ public:
     virtual int setSharedBufferMode(bool sharedBufferMode);
     virtual int setAutoRefresh(bool autoRefresh);
     virtual int setAutoPrerotation(bool autoPrerotation);
+    // When enabled, the next buffer is dequeued on a background thread as soon
+    // as a buffer is queued, so that the following dequeueBuffer usually
+    // returns without blocking. This keeps one more buffer dequeued while the
+    // app renders, and is ignored in shared buffer mode.
+    virtual int setDequeueAhead(bool dequeueAhead);
     virtual int setBuffersDimensions(uint32_t width, uint32_t height);
     virtual int lock(ANativeWindow_Buffer* outBuffer, ARect* inOutDirtyBounds);
     virtual int unlockAndPost();
@@ -401,6 +408,12 @@ protected:
     void onBufferQueuedLocked(int slot, sp<Fence> fence,
             const IGraphicBufferProducer::QueueBufferOutput& output);
 
+    // Returns a buffer which was dequeued ahead but not handed out to the
+    // producer, dropping any state the dequeue invalidated.
+    void cancelDequeuedAheadLocked(status_t result, int slot, const sp<Fence>& fence);
+    // Waits for a dequeue ahead in flight, then cancels its buffer.
+    void cancelDequeueAheadLocked();
+
     struct BufferSlot {
         sp<GraphicBuffer> buffer;
         Region dirtyRegion;
@@ -597,6 +610,12 @@ protected:
 
     // Buffers that are successfully dequeued/attached and handed to clients
     std::unordered_set<int> mDequeuedSlots;
+
+    // Set by setDequeueAhead. The thread is started by the first queueBuffer
+    // and stopped when the producer disconnects.
+    class DequeueAheadThread;
+    bool mDequeueAheadEnabled = false;
+    std::shared_ptr<DequeueAheadThread> mDequeueAhead;
 };
 
 } // namespace android
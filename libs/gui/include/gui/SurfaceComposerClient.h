@@ -21,12 +21,14 @@
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <binder/IBinder.h>
 
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 #include <utils/SortedVector.h>
+#include <utils/Vector.h>
 #include <utils/threads.h>
 
 #include <ui/BlurRegion.h>
@@ -353,7 +355,14 @@ public:
         int64_t generateId();
 
     protected:
-        std::unordered_map<sp<IBinder>, ComposerState, IBinderHash> mComposerStates;
+        // Layer states in the order they were first changed. They are handed to
+        // setTransactionState as they are, so applying doesn't copy them.
+        Vector<ComposerState> mComposerStates;
+        // The handle of each entry of mComposerStates, kept apart so that looking
+        // one up doesn't walk the much larger states.
+        std::vector<IBinder*> mComposerStateHandles;
+        // Setters usually come in runs for the same layer.
+        size_t mLastComposerStateIndex = 0;
         SortedVector<DisplayState> mDisplayStates;
         std::unordered_map<sp<ITransactionCompletedListener>, CallbackInfo, TCLHash>
                 mListenerCallbacks;
@@ -396,6 +405,8 @@ public:
         int mStatus = NO_ERROR;
 
         layer_state_t* getLayerState(const sp<SurfaceControl>& sc);
+        ssize_t indexOfLayerState(const sp<IBinder>& handle);
+        layer_state_t* addLayerState(const sp<IBinder>& handle, const ComposerState& state);
         DisplayState& getDisplayState(const sp<IBinder>& token);
 
         void cacheBuffers();
@@ -732,6 +743,8 @@ public:
     void onTransactionCompleted(ListenerStats stats) override;
     void onReleaseBuffer(ReleaseCallbackId, sp<Fence> releaseFence, uint32_t transformHint,
                          uint32_t currentMaxAcquiredBufferCount) override;
+    void onReleaseBuffers(std::vector<ReleasedBufferStats> releasedBuffers) override;
+    void onBufferUncached(uint64_t cacheId) override;
 
 private:
     ReleaseBufferCallback popReleaseBufferCallbackLocked(const ReleaseCallbackId&);
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/unique_fd.h>
+#include <binder/Parcelable.h>
+#include <gui/DisplayEventReceiver.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+class Parcel;
+
+namespace gui {
+
+/*
+ * VsyncRing carries the most recent vsync events of a display event connection
+ * in shared memory. The writer publishes each event into a small ring whose
+ * slots are guarded by seqlocks, then rings an eventfd doorbell. Readers map
+ * the ring read-only and can fetch the latest event at any time without a
+ * syscall, skipping whatever they missed.
+ */
+class VsyncRing : public Parcelable {
+public:
+    static constexpr size_t kCapacity = 4;
+
+    // creates an uninitialized VsyncRing (to unparcel into)
+    VsyncRing() = default;
+
+    // creates a writable VsyncRing backed by new shared memory and doorbell
+    struct CreateType {};
+    static constexpr CreateType Create{};
+    explicit VsyncRing(CreateType);
+
+    ~VsyncRing() override;
+
+    VsyncRing(const VsyncRing&) = delete;
+    VsyncRing& operator=(const VsyncRing&) = delete;
+
+    // check state after construction
+    status_t initCheck() const;
+
+    // get the doorbell file-descriptor, which becomes readable when an event is
+    // published
+    int getDoorbellFd() const;
+
+    // initializes outRing as a read-only view of this ring
+    status_t share(VsyncRing* outRing) const;
+
+    // Only the creator of the ring may publish, from a single thread.
+    status_t publish(const DisplayEventReceiver::Event& event);
+
+    // Copies the latest published event to outEvent and its sequence number,
+    // which counts the events published so far, to outSequence. Returns
+    // NOT_ENOUGH_DATA if nothing was published yet.
+    status_t readLatest(DisplayEventReceiver::Event* outEvent, uint64_t* outSequence) const;
+
+    // drains the doorbell so that the next publish wakes up the reader again
+    void clearDoorbell() const;
+
+    // implement the Parcelable protocol. Only parcels a read-only view
+    status_t writeToParcel(Parcel* reply) const override;
+    status_t readFromParcel(const Parcel* parcel) override;
+
+private:
+    struct Shared;
+
+    status_t map(base::unique_fd memoryFd, base::unique_fd doorbellFd, bool writable);
+    void unmap();
+
+    base::unique_fd mMemoryFd;
+    base::unique_fd mDoorbellFd;
+    Shared* mShared = nullptr;
+    bool mWritable = false;
+};
+
+} // namespace gui
+} // namespace android
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MockConsumer.h"
+
+#include <benchmark/benchmark.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <ui/GraphicBuffer.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Usage: atest BufferQueueContention_benchmark
+//
+// Measures how producer queries and the dequeue/queue/acquire/release cycle
+// of a BufferQueue interfere with each other, as with a camera or decoder
+// producer polling the queue while frames flow through it.
+
+using namespace android;
+
+namespace {
+
+struct Queue {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+
+    Queue() {
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        consumer->consumerConnect(new MockConsumer, false);
+        IGraphicBufferProducer::QueueBufferOutput output;
+        producer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output);
+        producer->setMaxDequeuedBufferCount(2);
+    }
+
+    ~Queue() {
+        producer->disconnect(NATIVE_WINDOW_API_CPU);
+        consumer->consumerDisconnect();
+    }
+
+    // Passes one frame through the queue.
+    void cycleFrame() {
+        int slot;
+        sp<Fence> fence;
+        status_t result = producer->dequeueBuffer(&slot, &fence, 1, 1, PIXEL_FORMAT_RGBA_8888,
+                                                  GRALLOC_USAGE_SW_READ_OFTEN, nullptr, nullptr);
+        if (result < 0) return;
+        if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+            sp<GraphicBuffer> buffer;
+            producer->requestBuffer(slot, &buffer);
+        }
+
+        IGraphicBufferProducer::QueueBufferInput input(0, false, HAL_DATASPACE_UNKNOWN,
+                                                       Rect(0, 0, 1, 1),
+                                                       NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                       Fence::NO_FENCE);
+        IGraphicBufferProducer::QueueBufferOutput output;
+        producer->queueBuffer(slot, input, &output);
+
+        BufferItem item;
+        if (consumer->acquireBuffer(&item, 0) == OK) {
+            consumer->releaseHelper(item.mSlot, item.mFrameNumber, Fence::NO_FENCE);
+        }
+    }
+};
+
+// Runs 'work' on 'count' threads until the returned stop function is called.
+template <typename F>
+auto runInBackground(size_t count, F work) {
+    auto stop = std::make_shared<std::atomic<bool>>(false);
+    auto threads = std::make_shared<std::vector<std::thread>>();
+    for (size_t i = 0; i < count; i++) {
+        threads->emplace_back([=] {
+            while (!stop->load(std::memory_order_relaxed)) work();
+        });
+    }
+    return [=] {
+        stop->store(true);
+        for (auto& t : *threads) t.join();
+    };
+}
+
+} // namespace
+
+// query() latency while frames are flowing through the queue
+void BM_QueryDuringFrames(benchmark::State& state) {
+    Queue queue;
+    auto stop = runInBackground(state.range(0), [&] { queue.cycleFrame(); });
+
+    int value;
+    for (auto _ : state) {
+        queue.producer->query(NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS, &value);
+        benchmark::DoNotOptimize(value);
+    }
+    stop();
+}
+BENCHMARK(BM_QueryDuringFrames)->Arg(0)->Arg(1);
+
+// Frame cycle latency while other threads poll query()
+void BM_FramesDuringQueries(benchmark::State& state) {
+    Queue queue;
+    auto stop = runInBackground(state.range(0), [&] {
+        int value;
+        queue.producer->query(NATIVE_WINDOW_BUFFER_AGE, &value);
+        queue.producer->query(NATIVE_WINDOW_CONSUMER_RUNNING_BEHIND, &value);
+    });
+
+    for (auto _ : state) {
+        queue.cycleFrame();
+    }
+    stop();
+}
+BENCHMARK(BM_FramesDuringQueries)->Arg(0)->Arg(1)->Arg(4);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,345 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Frame round trips through the producer/consumer path:
+//
+//   BM_bufferQueue/<queue>/<buffers>/<async>/<fence>
+//   BM_blastBufferQueue/<buffers>/<async>/<fence>
+//
+// where queue is 0 (BufferQueue in this process), 1 (BufferQueue in another
+// process, driven over binder) or 2 (StreamSplitter feeding one output
+// queue), and fence is 0 (Fence::NO_FENCE) or 1 (a native fence from an
+// empty GL flush). One iteration dequeues and queues a frame. Every
+// <buffers> frames the consumer acquires and releases all that is pending,
+// so that many frames are in flight at most. BLASTBufferQueue frames are
+// consumed by SurfaceFlinger, which must be running.
+//
+// Besides the mean, each run reports p50/p99/p99.9 latency counters.
+
+#define EGL_EGLEXT_PROTOTYPES
+
+#include "MockConsumer.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+#include <gui/BLASTBufferQueue.h>
+#include <gui/BufferItem.h>
+#include <gui/BufferQueue.h>
+#include <gui/IProducerListener.h>
+#include <gui/StreamSplitter.h>
+#include <gui/SurfaceComposerClient.h>
+#include <ui/GraphicBuffer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <vector>
+
+#include <signal.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+
+using namespace android;
+
+enum QueueType : int64_t { LOCAL = 0, REMOTE = 1, SPLITTER = 2 };
+enum FenceType : int64_t { NONE = 0, GPU = 1 };
+
+static const String16 kProducerName = String16("BufferQueue_benchmark_producer");
+static const String16 kConsumerName = String16("BufferQueue_benchmark_consumer");
+
+static sp<IGraphicBufferProducer> gRemoteProducer;
+static sp<IGraphicBufferConsumer> gRemoteConsumer;
+
+// Hands out native fences which signal as soon as the GPU gets to them.
+class GpuFences {
+public:
+    bool init() {
+        mDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (mDisplay == EGL_NO_DISPLAY || !eglInitialize(mDisplay, nullptr, nullptr)) {
+            return false;
+        }
+        const EGLint configAttribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE,
+                                        EGL_OPENGL_ES2_BIT, EGL_NONE};
+        EGLConfig config;
+        EGLint numConfigs = 0;
+        if (!eglChooseConfig(mDisplay, configAttribs, &config, 1, &numConfigs) ||
+            numConfigs != 1) {
+            return false;
+        }
+        const EGLint surfaceAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        mSurface = eglCreatePbufferSurface(mDisplay, config, surfaceAttribs);
+        const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+        mContext = eglCreateContext(mDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+        return mSurface != EGL_NO_SURFACE && mContext != EGL_NO_CONTEXT;
+    }
+
+    sp<Fence> next() {
+        if (eglGetCurrentContext() != mContext) {
+            eglMakeCurrent(mDisplay, mSurface, mSurface, mContext);
+        }
+        EGLSyncKHR sync = eglCreateSyncKHR(mDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
+        if (sync == EGL_NO_SYNC_KHR) return Fence::NO_FENCE;
+        glFlush();
+        int fd = eglDupNativeFenceFDANDROID(mDisplay, sync);
+        eglDestroySyncKHR(mDisplay, sync);
+        return fd == EGL_NO_NATIVE_FENCE_FD_ANDROID ? Fence::NO_FENCE : new Fence(fd);
+    }
+
+private:
+    EGLDisplay mDisplay = EGL_NO_DISPLAY;
+    EGLSurface mSurface = EGL_NO_SURFACE;
+    EGLContext mContext = EGL_NO_CONTEXT;
+};
+
+static GpuFences gGpuFences;
+static bool gHaveGpuFences = false;
+
+static void reportLatencies(benchmark::State& state, std::vector<int64_t>* latenciesNs) {
+    if (latenciesNs->empty()) return;
+    std::sort(latenciesNs->begin(), latenciesNs->end());
+    auto percentileUs = [&](double p) {
+        size_t index = std::min(latenciesNs->size() - 1, size_t(p * latenciesNs->size()));
+        return benchmark::Counter((*latenciesNs)[index] / 1000.0);
+    };
+    state.counters["p50_us"] = percentileUs(0.50);
+    state.counters["p99_us"] = percentileUs(0.99);
+    state.counters["p99.9_us"] = percentileUs(0.999);
+}
+
+// Dequeues and queues one frame, waiting on the dequeue fence like Surface does.
+static status_t produceFrame(const sp<IGraphicBufferProducer>& producer, FenceType fenceType) {
+    int slot;
+    sp<Fence> fence;
+    status_t result = producer->dequeueBuffer(&slot, &fence, 1, 1, PIXEL_FORMAT_RGBA_8888,
+                                              GRALLOC_USAGE_SW_READ_OFTEN |
+                                                      GRALLOC_USAGE_HW_TEXTURE,
+                                              nullptr, nullptr);
+    if (result < 0) return result;
+    if (result & IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION) {
+        sp<GraphicBuffer> buffer;
+        if (status_t status = producer->requestBuffer(slot, &buffer); status != OK) {
+            return status;
+        }
+    }
+    if (fence != nullptr && fence->isValid()) {
+        fence->waitForever("BufferQueue_benchmark");
+    }
+
+    IGraphicBufferProducer::QueueBufferInput input(systemTime(), true /*isAutoTimestamp*/,
+                                                   HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+                                                   NATIVE_WINDOW_SCALING_MODE_FREEZE, 0,
+                                                   fenceType == GPU ? gGpuFences.next()
+                                                                    : Fence::NO_FENCE);
+    IGraphicBufferProducer::QueueBufferOutput output;
+    return producer->queueBuffer(slot, input, &output);
+}
+
+static void consumeFrames(const sp<IGraphicBufferConsumer>& consumer) {
+    BufferItem item;
+    while (consumer->acquireBuffer(&item, 0) == OK) {
+        consumer->releaseBuffer(item.mSlot, item.mFrameNumber, EGL_NO_DISPLAY, EGL_NO_SYNC_KHR,
+                                Fence::NO_FENCE);
+    }
+}
+
+static void runFrames(benchmark::State& state, const sp<IGraphicBufferProducer>& producer,
+                      const sp<IGraphicBufferConsumer>& consumer, int64_t buffers,
+                      FenceType fenceType) {
+    std::vector<int64_t> latenciesNs;
+    int64_t framesSinceAcquire = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        status_t status = produceFrame(producer, fenceType);
+        if (consumer != nullptr && ++framesSinceAcquire >= buffers) {
+            consumeFrames(consumer);
+            framesSinceAcquire = 0;
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (status != OK) {
+            state.SkipWithError("frame was not queued");
+            break;
+        }
+
+        latenciesNs.push_back(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    }
+    reportLatencies(state, &latenciesNs);
+}
+
+static bool checkFenceType(benchmark::State& state, FenceType fenceType) {
+    if (fenceType == GPU && !gHaveGpuFences) {
+        state.SkipWithError("native fences not available");
+        return false;
+    }
+    return true;
+}
+
+void BM_bufferQueue(benchmark::State& state) {
+    const QueueType queueType = static_cast<QueueType>(state.range(0));
+    const int64_t buffers = state.range(1);
+    const bool async = state.range(2) != 0;
+    const FenceType fenceType = static_cast<FenceType>(state.range(3));
+    if (!checkFenceType(state, fenceType)) return;
+
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    sp<StreamSplitter> splitter;
+    sp<IGraphicBufferConsumer> splitterInput;
+    switch (queueType) {
+        case LOCAL:
+            BufferQueue::createBufferQueue(&producer, &consumer);
+            break;
+        case REMOTE:
+            producer = gRemoteProducer;
+            consumer = gRemoteConsumer;
+            break;
+        case SPLITTER: {
+            // the splitter blocks the input's queueBuffer beyond this many buffers in flight
+            if (buffers > 2) {
+                state.SkipWithError("StreamSplitter holds at most 2 buffers");
+                return;
+            }
+            sp<IGraphicBufferProducer> outputProducer;
+            BufferQueue::createBufferQueue(&producer, &splitterInput);
+            BufferQueue::createBufferQueue(&outputProducer, &consumer);
+            outputProducer->setMaxDequeuedBufferCount(buffers);
+            CHECK_EQ(OK, StreamSplitter::createSplitter(splitterInput, &splitter));
+            CHECK_EQ(OK, splitter->addOutput(outputProducer));
+            break;
+        }
+    }
+    if (producer == nullptr || consumer == nullptr) {
+        state.SkipWithError("queue not available");
+        return;
+    }
+
+    CHECK_EQ(OK, consumer->consumerConnect(new MockConsumer, false));
+    IGraphicBufferProducer::QueueBufferOutput output;
+    CHECK_EQ(OK, producer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output));
+    producer->setMaxDequeuedBufferCount(buffers);
+    producer->setAsyncMode(async);
+
+    runFrames(state, producer, consumer, buffers, fenceType);
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    consumer->consumerDisconnect();
+}
+
+static void bufferQueueMatrix(benchmark::internal::Benchmark* b) {
+    for (int64_t queueType : {LOCAL, REMOTE, SPLITTER}) {
+        for (int64_t buffers : {1, 2, 3}) {
+            for (int64_t async : {0, 1}) {
+                for (int64_t fenceType : {NONE, GPU}) {
+                    b->Args({queueType, buffers, async, fenceType});
+                }
+            }
+        }
+    }
+    b->ArgNames({"queue", "buffers", "async", "fence"});
+}
+BENCHMARK(BM_bufferQueue)->Apply(bufferQueueMatrix)->UseRealTime();
+
+void BM_blastBufferQueue(benchmark::State& state) {
+    const int64_t buffers = state.range(0);
+    const bool async = state.range(1) != 0;
+    const FenceType fenceType = static_cast<FenceType>(state.range(2));
+    if (!checkFenceType(state, fenceType)) return;
+
+    sp<SurfaceComposerClient> client = new SurfaceComposerClient();
+    if (client->initCheck() != NO_ERROR) {
+        state.SkipWithError("SurfaceFlinger not available");
+        return;
+    }
+    sp<SurfaceControl> surfaceControl =
+            client->createSurface(String8("BufferQueue_benchmark"), 1, 1, PIXEL_FORMAT_RGBA_8888,
+                                  ISurfaceComposerClient::eFXSurfaceBufferState,
+                                  /*parent*/ nullptr);
+    if (surfaceControl == nullptr) {
+        state.SkipWithError("could not create a surface");
+        return;
+    }
+    SurfaceComposerClient::Transaction()
+            .setLayerStack(surfaceControl, 0)
+            .setLayer(surfaceControl, std::numeric_limits<int32_t>::max())
+            .show(surfaceControl)
+            .apply(true /*synchronous*/);
+
+    sp<BLASTBufferQueue> blastBufferQueue =
+            new BLASTBufferQueue("BufferQueue_benchmark", surfaceControl, 1, 1,
+                                 PIXEL_FORMAT_RGBA_8888);
+    sp<IGraphicBufferProducer> producer = blastBufferQueue->getIGraphicBufferProducer();
+    IGraphicBufferProducer::QueueBufferOutput output;
+    CHECK_EQ(OK, producer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false, &output));
+    producer->setMaxDequeuedBufferCount(buffers);
+    producer->setAsyncMode(async);
+
+    runFrames(state, producer, nullptr /*consumer*/, buffers, fenceType);
+
+    producer->disconnect(NATIVE_WINDOW_API_CPU);
+    SurfaceComposerClient::Transaction().reparent(surfaceControl, nullptr).apply();
+}
+
+static void blastBufferQueueMatrix(benchmark::internal::Benchmark* b) {
+    for (int64_t buffers : {1, 2, 3}) {
+        for (int64_t async : {0, 1}) {
+            for (int64_t fenceType : {NONE, GPU}) {
+                b->Args({buffers, async, fenceType});
+            }
+        }
+    }
+    b->ArgNames({"buffers", "async", "fence"});
+}
+BENCHMARK(BM_blastBufferQueue)->Apply(blastBufferQueueMatrix)->UseRealTime();
+
+// Must be forked before this process uses binder.
+static void forkQueueServer() {
+    if (fork() == 0) {
+        prctl(PR_SET_PDEATHSIG, SIGHUP);
+        sp<IGraphicBufferProducer> producer;
+        sp<IGraphicBufferConsumer> consumer;
+        BufferQueue::createBufferQueue(&producer, &consumer);
+        sp<IServiceManager> serviceManager = defaultServiceManager();
+        CHECK_EQ(OK, serviceManager->addService(kProducerName, IInterface::asBinder(producer)));
+        CHECK_EQ(OK, serviceManager->addService(kConsumerName, IInterface::asBinder(consumer)));
+        ProcessState::self()->startThreadPool();
+        IPCThreadState::self()->joinThreadPool();
+        exit(1);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::benchmark::Initialize(&argc, argv);
+    if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+
+    forkQueueServer();
+
+    ProcessState::self()->startThreadPool();
+    sp<IServiceManager> serviceManager = defaultServiceManager();
+    gRemoteProducer =
+            interface_cast<IGraphicBufferProducer>(serviceManager->waitForService(kProducerName));
+    gRemoteConsumer =
+            interface_cast<IGraphicBufferConsumer>(serviceManager->waitForService(kConsumerName));
+    gHaveGpuFences = gGpuFences.init();
+
+    ::benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
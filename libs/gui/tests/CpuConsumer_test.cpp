@@ -608,6 +608,41 @@ TEST_P(CpuConsumerTest, FromCpuManyInQueue) {
     }
 }
 
+TEST_P(CpuConsumerTest, FromCpuPersistentMapping) {
+    status_t err;
+    CpuConsumerTestParams params = GetParam();
+
+    // Set up
+
+    ASSERT_NO_FATAL_FAILURE(configureANW(mANW, params, 1));
+    mCC->setPersistentMapping(true);
+
+    // Cycle through the slots several times, so that mappings are reused
+
+    const int numFrames = 10;
+    for (int i = 0; i < numFrames; i++) {
+        const int64_t time = i + 1;
+        uint32_t stride;
+        ASSERT_NO_FATAL_FAILURE(produceOneFrame(mANW, params, time, &stride));
+
+        CpuConsumer::LockedBuffer b;
+        err = mCC->lockNextBuffer(&b);
+        ASSERT_NO_ERROR(err, "getNextBuffer error: ");
+
+        ASSERT_TRUE(b.data != nullptr);
+        EXPECT_EQ(params.width,  b.width);
+        EXPECT_EQ(params.height, b.height);
+        EXPECT_EQ(stride, b.stride);
+        EXPECT_EQ(time, b.timestamp);
+
+        checkAnyBuffer(b, GetParam().format);
+
+        ASSERT_EQ(OK, mCC->unlockBuffer(b));
+    }
+
+    mCC->setPersistentMapping(false);
+}
+
 // This test is disabled because the HAL_PIXEL_FORMAT_RAW16 format is not
 // supported on all devices.
 TEST_P(CpuConsumerTest, FromCpuLockMax) {
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <gui/FrameTimestamps.h>
+
+#include <chrono>
+#include <vector>
+
+namespace android {
+namespace test {
+
+using namespace std::chrono_literals;
+
+static size_t flattenAndUnflatten(const FrameEventHistoryDelta& in, FrameEventHistoryDelta* out) {
+    const size_t flattenedSize = in.getFlattenedSize();
+    std::vector<uint8_t> buffer(flattenedSize);
+    std::vector<int> fds(in.getFdCount());
+
+    void* writeBuffer = buffer.data();
+    size_t size = buffer.size();
+    int* writeFds = fds.data();
+    size_t count = fds.size();
+    EXPECT_EQ(NO_ERROR, in.flatten(writeBuffer, size, writeFds, count));
+    EXPECT_EQ(0u, size);
+
+    const void* readBuffer = buffer.data();
+    size = buffer.size();
+    const int* readFds = fds.data();
+    count = fds.size();
+    EXPECT_EQ(NO_ERROR, out->unflatten(readBuffer, size, readFds, count));
+    EXPECT_EQ(0u, size);
+    return flattenedSize;
+}
+
+TEST(FrameTimestampsTest, SignaledFencesAreSentAsTimes) {
+    const nsecs_t posted = systemTime();
+    ConsumerFrameEventHistory consumer;
+    consumer.addQueue({1, posted, posted + 1000, FenceTime::NO_FENCE});
+    consumer.addLatch(1, posted + 2000);
+    consumer.addPreComposition(1, posted + 3000);
+    consumer.addPostComposition(1, FenceTime::NO_FENCE,
+                                std::make_shared<FenceTime>(posted + 4000), {});
+    consumer.addRelease(1, posted + 5000, std::make_shared<FenceTime>(posted + 6000));
+
+    FrameEventHistoryDelta delta;
+    consumer.getAndResetDelta(&delta);
+    EXPECT_EQ(0u, delta.getFdCount());
+
+    FrameEventHistoryDelta received;
+    // The history header, then the frame header and one time, followed by
+    // seven 32 bit offsets.
+    EXPECT_EQ(sizeof(CompositorTiming) + sizeof(uint32_t) + 12 + 8 + 7 * sizeof(int32_t),
+              flattenAndUnflatten(delta, &received));
+
+    ProducerFrameEventHistory producer;
+    producer.applyDelta(received);
+    FrameEvents* frame = producer.getFrame(1);
+    ASSERT_NE(nullptr, frame);
+    EXPECT_EQ(posted, frame->postedTime);
+    EXPECT_EQ(posted + 1000, frame->requestedPresentTime);
+    EXPECT_EQ(posted + 2000, frame->latchTime);
+    EXPECT_EQ(posted + 3000, frame->firstRefreshStartTime);
+    EXPECT_EQ(posted + 3000, frame->lastRefreshStartTime);
+    EXPECT_EQ(posted + 5000, frame->dequeueReadyTime);
+    EXPECT_TRUE(frame->addPostCompositeCalled);
+    EXPECT_TRUE(frame->addReleaseCalled);
+    EXPECT_FALSE(frame->gpuCompositionDoneFence->isValid());
+    EXPECT_EQ(posted + 4000, frame->displayPresentFence->getSignalTime());
+    EXPECT_EQ(posted + 6000, frame->releaseFence->getSignalTime());
+}
+
+TEST(FrameTimestampsTest, FarApartTimesRoundTrip) {
+    const nsecs_t posted = systemTime();
+    const nsecs_t requestedPresent = posted + std::chrono::nanoseconds(10s).count();
+    ConsumerFrameEventHistory consumer;
+    consumer.addQueue({7, posted, requestedPresent, FenceTime::NO_FENCE});
+    consumer.addLatch(7, posted - 1);
+
+    FrameEventHistoryDelta delta;
+    consumer.getAndResetDelta(&delta);
+    FrameEventHistoryDelta received;
+    flattenAndUnflatten(delta, &received);
+
+    ProducerFrameEventHistory producer;
+    producer.applyDelta(received);
+    FrameEvents* frame = producer.getFrame(7);
+    ASSERT_NE(nullptr, frame);
+    EXPECT_EQ(posted, frame->postedTime);
+    EXPECT_EQ(requestedPresent, frame->requestedPresentTime);
+    EXPECT_EQ(posted - 1, frame->latchTime);
+    EXPECT_EQ(FrameEvents::TIMESTAMP_PENDING, frame->firstRefreshStartTime);
+    EXPECT_EQ(FrameEvents::TIMESTAMP_PENDING, frame->dequeueReadyTime);
+    EXPECT_FALSE(frame->addReleaseCalled);
+    EXPECT_FALSE(frame->releaseFence->isValid());
+}
+
+} // namespace test
+} // namespace android
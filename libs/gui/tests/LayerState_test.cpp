@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <android/native_window.h>
+#include <binder/Parcel.h>
+#include <gui/LayerState.h>
+
+namespace android {
+namespace test {
+
+TEST(LayerStateTest, ParcelOnlyChangedFields) {
+    layer_state_t positionOnly;
+    positionOnly.what = layer_state_t::ePositionChanged;
+    positionOnly.x = 10;
+    positionOnly.y = 20;
+    Parcel positionParcel;
+    ASSERT_EQ(NO_ERROR, positionOnly.write(positionParcel));
+
+    layer_state_t everything = positionOnly;
+    everything.what |= layer_state_t::eMatrixChanged | layer_state_t::eColorTransformChanged |
+            layer_state_t::eBlurRegionsChanged;
+    Parcel everythingParcel;
+    ASSERT_EQ(NO_ERROR, everything.write(everythingParcel));
+
+    EXPECT_LT(positionParcel.dataSize(), everythingParcel.dataSize());
+}
+
+TEST(LayerStateTest, ParcelRoundTrip) {
+    layer_state_t state;
+    state.what = layer_state_t::ePositionChanged | layer_state_t::eAlphaChanged |
+            layer_state_t::eFlagsChanged | layer_state_t::eCornerRadiusChanged |
+            layer_state_t::eBlurRegionsChanged | layer_state_t::eFrameRateChanged;
+    state.x = 10;
+    state.y = 20;
+    state.alpha = 0.5f;
+    state.flags = layer_state_t::eLayerOpaque;
+    state.mask = layer_state_t::eLayerOpaque | layer_state_t::eLayerHidden;
+    state.cornerRadius = 4;
+    BlurRegion region{};
+    region.blurRadius = 8;
+    region.alpha = 1;
+    region.left = 1;
+    region.top = 2;
+    region.right = 3;
+    region.bottom = 4;
+    state.blurRegions.push_back(region);
+    state.frameRate = 60;
+    state.frameRateCompatibility = ANATIVEWINDOW_FRAME_RATE_COMPATIBILITY_FIXED_SOURCE;
+    // not parceled, the bit is not set
+    state.shadowRadius = 3;
+
+    Parcel p;
+    ASSERT_EQ(NO_ERROR, state.write(p));
+    p.setDataPosition(0);
+
+    layer_state_t result;
+    ASSERT_EQ(NO_ERROR, result.read(p));
+    EXPECT_EQ(p.dataSize(), p.dataPosition());
+
+    EXPECT_EQ(state.what, result.what);
+    EXPECT_EQ(state.x, result.x);
+    EXPECT_EQ(state.y, result.y);
+    EXPECT_EQ(state.alpha, result.alpha);
+    EXPECT_EQ(state.flags, result.flags);
+    EXPECT_EQ(state.mask, result.mask);
+    EXPECT_EQ(state.cornerRadius, result.cornerRadius);
+    ASSERT_EQ(1u, result.blurRegions.size());
+    EXPECT_EQ(region.blurRadius, result.blurRegions[0].blurRadius);
+    EXPECT_EQ(region.bottom, result.blurRegions[0].bottom);
+    EXPECT_EQ(state.frameRate, result.frameRate);
+    EXPECT_EQ(state.frameRateCompatibility, result.frameRateCompatibility);
+    EXPECT_EQ(0, result.shadowRadius);
+}
+
+} // namespace test
+} // namespace android
@@ -28,6 +28,10 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 namespace android {
 
 class StreamSplitterTest : public ::testing::Test {
@@ -54,6 +58,27 @@ struct FakeListener : public BnConsumerListener {
     virtual void onSidebandStreamChanged() {}
 };
 
+// Lets a test wait for a buffer queued from the thread of an asynchronous output
+struct FrameWaiter : public BnConsumerListener {
+    virtual void onFrameAvailable(const BufferItem& /* item */) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ++mFrameCount;
+        mCondition.notify_all();
+    }
+    virtual void onBuffersReleased() {}
+    virtual void onSidebandStreamChanged() {}
+
+    bool waitForFrame() {
+        std::unique_lock<std::mutex> lock(mMutex);
+        return mCondition.wait_for(lock, std::chrono::seconds(1),
+                [this] { return mFrameCount > 0; });
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    int mFrameCount = 0;
+};
+
 static const uint32_t TEST_DATA = 0x12345678u;
 
 TEST_F(StreamSplitterTest, OneInputOneOutput) {
@@ -196,6 +221,85 @@ TEST_F(StreamSplitterTest, OneInputMultipleOutputs) {
                                            nullptr, nullptr));
 }
 
+TEST_F(StreamSplitterTest, OneInputSynchronousAndAsynchronousOutputs) {
+    sp<IGraphicBufferProducer> inputProducer;
+    sp<IGraphicBufferConsumer> inputConsumer;
+    BufferQueue::createBufferQueue(&inputProducer, &inputConsumer);
+
+    sp<IGraphicBufferProducer> syncProducer;
+    sp<IGraphicBufferConsumer> syncConsumer;
+    BufferQueue::createBufferQueue(&syncProducer, &syncConsumer);
+    ASSERT_EQ(OK, syncConsumer->consumerConnect(new FakeListener, false));
+
+    sp<IGraphicBufferProducer> asyncProducer;
+    sp<IGraphicBufferConsumer> asyncConsumer;
+    BufferQueue::createBufferQueue(&asyncProducer, &asyncConsumer);
+    sp<FrameWaiter> asyncWaiter = new FrameWaiter;
+    ASSERT_EQ(OK, asyncConsumer->consumerConnect(asyncWaiter, false));
+
+    sp<StreamSplitter> splitter;
+    status_t status = StreamSplitter::createSplitter(inputConsumer, &splitter);
+    ASSERT_EQ(OK, status);
+    ASSERT_EQ(OK, splitter->addOutput(syncProducer));
+    ASSERT_EQ(OK, splitter->addOutput(asyncProducer,
+            StreamSplitter::OutputPolicy::ASYNCHRONOUS));
+
+    // Never allow the output BufferQueues to allocate a buffer
+    ASSERT_EQ(OK, syncProducer->allowAllocation(false));
+    ASSERT_EQ(OK, asyncProducer->allowAllocation(false));
+
+    IGraphicBufferProducer::QueueBufferOutput qbOutput;
+    ASSERT_EQ(OK,
+              inputProducer->connect(new StubProducerListener, NATIVE_WINDOW_API_CPU, false,
+                                     &qbOutput));
+
+    int slot;
+    sp<Fence> fence;
+    sp<GraphicBuffer> buffer;
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+    ASSERT_EQ(OK, inputProducer->requestBuffer(slot, &buffer));
+
+    uint32_t* dataIn;
+    ASSERT_EQ(OK, buffer->lock(GraphicBuffer::USAGE_SW_WRITE_OFTEN,
+            reinterpret_cast<void**>(&dataIn)));
+    *dataIn = TEST_DATA;
+    ASSERT_EQ(OK, buffer->unlock());
+
+    IGraphicBufferProducer::QueueBufferInput qbInput(0, false,
+            HAL_DATASPACE_UNKNOWN, Rect(0, 0, 1, 1),
+            NATIVE_WINDOW_SCALING_MODE_FREEZE, 0, Fence::NO_FENCE);
+    ASSERT_EQ(OK, inputProducer->queueBuffer(slot, qbInput, &qbOutput));
+
+    // Now that we have dequeued/allocated one buffer, prevent any further
+    // allocations
+    ASSERT_EQ(OK, inputProducer->allowAllocation(false));
+
+    // The synchronous output has the buffer as soon as it is queued, the
+    // asynchronous one once its thread has queued it
+    ASSERT_TRUE(asyncWaiter->waitForFrame());
+    for (const sp<IGraphicBufferConsumer>& consumer : {syncConsumer, asyncConsumer}) {
+        BufferItem item;
+        ASSERT_EQ(OK, consumer->acquireBuffer(&item, 0));
+
+        uint32_t* dataOut;
+        ASSERT_EQ(OK, item.mGraphicBuffer->lock(GraphicBuffer::USAGE_SW_READ_OFTEN,
+                    reinterpret_cast<void**>(&dataOut)));
+        ASSERT_EQ(*dataOut, TEST_DATA);
+        ASSERT_EQ(OK, item.mGraphicBuffer->unlock());
+
+        ASSERT_EQ(OK, consumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                    EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    }
+
+    // This should succeed even with allocation disabled since it will have
+    // received the buffer back from both output BufferQueues
+    ASSERT_EQ(IGraphicBufferProducer::BUFFER_NEEDS_REALLOCATION,
+              inputProducer->dequeueBuffer(&slot, &fence, 0, 0, 0, GRALLOC_USAGE_SW_WRITE_OFTEN,
+                                           nullptr, nullptr));
+}
+
 TEST_F(StreamSplitterTest, OutputAbandonment) {
     sp<IGraphicBufferProducer> inputProducer;
     sp<IGraphicBufferConsumer> inputConsumer;
@@ -2015,6 +2015,55 @@ TEST_F(SurfaceTest, DequeueWithConsumerDrivenSize) {
     ASSERT_EQ(NO_ERROR, window->cancelBuffer(window.get(), buffer, fence));
 }
 
+TEST_F(SurfaceTest, DequeueAhead) {
+    sp<IGraphicBufferProducer> producer;
+    sp<IGraphicBufferConsumer> consumer;
+    BufferQueue::createBufferQueue(&producer, &consumer);
+
+    sp<MockConsumer> mockConsumer(new MockConsumer);
+    consumer->consumerConnect(mockConsumer, false);
+    consumer->setDefaultBufferSize(10, 10);
+
+    sp<Surface> surface = new Surface(producer);
+    sp<ANativeWindow> window(surface);
+    ASSERT_EQ(NO_ERROR, native_window_set_dequeue_ahead(window.get(), true));
+    ASSERT_EQ(NO_ERROR, native_window_api_connect(window.get(), NATIVE_WINDOW_API_CPU));
+
+    int fence;
+    ANativeWindowBuffer* buffer;
+    auto cycleFrame = [&](int expectedWidth) {
+        ASSERT_EQ(NO_ERROR, window->dequeueBuffer(window.get(), &buffer, &fence));
+        EXPECT_EQ(expectedWidth, buffer->width);
+        ASSERT_EQ(NO_ERROR, window->queueBuffer(window.get(), buffer, fence));
+
+        BufferItem item;
+        ASSERT_EQ(NO_ERROR, consumer->acquireBuffer(&item, 0));
+        ASSERT_EQ(NO_ERROR, consumer->releaseBuffer(item.mSlot, item.mFrameNumber,
+                EGL_NO_DISPLAY, EGL_NO_SYNC_KHR, Fence::NO_FENCE));
+    };
+
+    // Every dequeue but the first is served by the buffer dequeued ahead
+    for (int i = 0; i < 3; i++) {
+        cycleFrame(10);
+    }
+
+    // The buffer dequeued ahead no longer matches and is replaced
+    ASSERT_EQ(NO_ERROR, native_window_set_buffers_dimensions(window.get(), 20, 20));
+    cycleFrame(20);
+    cycleFrame(20);
+
+    // Changing the buffer count returns the buffer dequeued ahead
+    ASSERT_EQ(NO_ERROR, native_window_set_buffer_count(window.get(), 4));
+    cycleFrame(20);
+
+    ASSERT_EQ(NO_ERROR, native_window_set_dequeue_ahead(window.get(), false));
+    cycleFrame(20);
+
+    ASSERT_EQ(NO_ERROR, native_window_set_dequeue_ahead(window.get(), true));
+    cycleFrame(20);
+    ASSERT_EQ(NO_ERROR, native_window_api_disconnect(window.get(), NATIVE_WINDOW_API_CPU));
+}
+
 TEST_F(SurfaceTest, DefaultMaxBufferCountSetAndUpdated) {
     sp<IGraphicBufferProducer> producer;
     sp<IGraphicBufferConsumer> consumer;
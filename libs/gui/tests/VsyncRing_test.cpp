@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include <binder/Parcel.h>
+#include <private/gui/VsyncRing.h>
+
+#include <poll.h>
+
+namespace android {
+namespace test {
+
+static DisplayEventReceiver::Event makeVsync(uint32_t count) {
+    DisplayEventReceiver::Event event{};
+    event.header.type = DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
+    event.header.timestamp = 1000 * count;
+    event.vsync.count = count;
+    event.vsync.vsyncId = count;
+    return event;
+}
+
+static bool isReadable(int fd) {
+    pollfd pfd{fd, POLLIN, 0};
+    return poll(&pfd, 1, 0) == 1;
+}
+
+TEST(VsyncRingTest, ReadsLatestEvent) {
+    gui::VsyncRing writer(gui::VsyncRing::Create);
+    ASSERT_EQ(NO_ERROR, writer.initCheck());
+    gui::VsyncRing reader;
+    ASSERT_EQ(NO_ERROR, writer.share(&reader));
+
+    DisplayEventReceiver::Event event;
+    uint64_t sequence;
+    EXPECT_EQ(NOT_ENOUGH_DATA, reader.readLatest(&event, &sequence));
+    EXPECT_FALSE(isReadable(reader.getDoorbellFd()));
+
+    // Wrap around the ring a few times, only the last event is visible.
+    const uint32_t count = gui::VsyncRing::kCapacity * 3 + 1;
+    for (uint32_t i = 1; i <= count; i++) {
+        ASSERT_EQ(NO_ERROR, writer.publish(makeVsync(i)));
+    }
+    EXPECT_TRUE(isReadable(reader.getDoorbellFd()));
+    ASSERT_EQ(NO_ERROR, reader.readLatest(&event, &sequence));
+    EXPECT_EQ(count, sequence);
+    EXPECT_EQ(count, event.vsync.count);
+    EXPECT_EQ(1000 * count, event.header.timestamp);
+
+    reader.clearDoorbell();
+    EXPECT_FALSE(isReadable(reader.getDoorbellFd()));
+    EXPECT_EQ(INVALID_OPERATION, reader.publish(makeVsync(0)));
+}
+
+TEST(VsyncRingTest, ParcelsReadOnlyView) {
+    gui::VsyncRing writer(gui::VsyncRing::Create);
+    ASSERT_EQ(NO_ERROR, writer.initCheck());
+
+    Parcel parcel;
+    ASSERT_EQ(NO_ERROR, writer.writeToParcel(&parcel));
+    parcel.setDataPosition(0);
+    gui::VsyncRing reader;
+    ASSERT_EQ(NO_ERROR, reader.readFromParcel(&parcel));
+
+    ASSERT_EQ(NO_ERROR, writer.publish(makeVsync(7)));
+    DisplayEventReceiver::Event event;
+    uint64_t sequence;
+    ASSERT_EQ(NO_ERROR, reader.readLatest(&event, &sequence));
+    EXPECT_EQ(1u, sequence);
+    EXPECT_EQ(7u, event.vsync.count);
+    EXPECT_EQ(INVALID_OPERATION, reader.publish(makeVsync(8)));
+}
+
+} // namespace test
+} // namespace android
@@ -23,10 +23,13 @@ static constexpr bool DEBUG_TRANSPORT_ACTIONS = false;
 #include <fcntl.h>
 #include <inttypes.h>
 #include <math.h>
+#include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <android-base/stringprintf.h>
 #include <binder/Parcel.h>
 #include <cutils/properties.h>
@@ -49,10 +52,6 @@ static const size_t SOCKET_BUFFER_SIZE = 32 * 1024;
 // Nanoseconds per milliseconds.
 static const nsecs_t NANOS_PER_MS = 1000000;
 
-// Latency added during resampling.  A few milliseconds doesn't hurt much but
-// reduces the impact of mispredicted touch positions.
-static const nsecs_t RESAMPLE_LATENCY = 5 * NANOS_PER_MS;
-
 // Minimum time difference between consecutive samples before attempting to resample.
 static const nsecs_t RESAMPLE_MIN_DELTA = 2 * NANOS_PER_MS;
 
@@ -60,10 +59,6 @@ static const nsecs_t RESAMPLE_MIN_DELTA = 2 * NANOS_PER_MS;
 // by extrapolation.
 static const nsecs_t RESAMPLE_MAX_DELTA = 20 * NANOS_PER_MS;
 
-// Maximum time to predict forward from the last known state, to avoid predicting too
-// far into the future.  This time is further bounded by 50% of the last time delta.
-static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
-
 /**
  * System property for enabling / disabling touch resampling.
  * Resampling extrapolates / interpolates the reported touch event coordinates to better
@@ -76,10 +71,13 @@ static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
  */
 static const char* PROPERTY_RESAMPLING_ENABLED = "ro.input.resampling";
 
-template<typename T>
-inline static T min(const T& a, const T& b) {
-    return a < b ? a : b;
-}
+/**
+ * System property for choosing how touches are predicted when resampling them past the most
+ * recent sample.
+ * Set to "linear" to extrapolate linearly, a few milliseconds behind the frame time (default).
+ * Set to "acceleration" to extrapolate with a bounded constant acceleration, up to the frame time.
+ */
+static const char* PROPERTY_RESAMPLING_STRATEGY = "ro.input.resampling_strategy";
 
 inline static float lerp(float a, float b, float alpha) {
     return a + alpha * (b - a);
@@ -93,6 +91,10 @@ inline static const char* toString(bool value) {
     return value ? "true" : "false";
 }
 
+inline static const char* toString(TouchResampler::Strategy strategy) {
+    return strategy == TouchResampler::Strategy::ACCELERATION ? "acceleration" : "linear";
+}
+
 // --- InputMessage ---
 
 bool InputMessage::isValid(size_t actualSize) const {
@@ -352,6 +354,17 @@ status_t InputChannel::openInputChannelPair(const std::string& name,
     return OK;
 }
 
+// Maps the errno of a failed send to the status returned to the sender.
+static status_t statusFromSendError(int error) {
+    if (error == EAGAIN || error == EWOULDBLOCK) {
+        return WOULD_BLOCK;
+    }
+    if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
+        return DEAD_OBJECT;
+    }
+    return -error;
+}
+
 status_t InputChannel::sendMessage(const InputMessage* msg) {
     const size_t msgLength = msg->size();
     InputMessage cleanMsg;
@@ -367,13 +380,7 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
         ALOGD("channel '%s' ~ error sending message of type %d, %s", mName.c_str(),
               msg->header.type, strerror(error));
 #endif
-        if (error == EAGAIN || error == EWOULDBLOCK) {
-            return WOULD_BLOCK;
-        }
-        if (error == EPIPE || error == ENOTCONN || error == ECONNREFUSED || error == ECONNRESET) {
-            return DEAD_OBJECT;
-        }
-        return -error;
+        return statusFromSendError(error);
     }
 
     if (size_t(nWrite) != msgLength) {
@@ -390,6 +397,61 @@ status_t InputChannel::sendMessage(const InputMessage* msg) {
     return OK;
 }
 
+status_t InputChannel::sendMessages(const InputMessage* msgs, size_t count,
+                                    size_t* outSentCount) {
+    // The messages are sanitized a few at a time, so that their copies fit on the stack.
+    static constexpr size_t MAX_MESSAGES_PER_SEND = 8;
+    InputMessage cleanMsgs[MAX_MESSAGES_PER_SEND];
+    struct iovec iovs[MAX_MESSAGES_PER_SEND];
+    struct mmsghdr headers[MAX_MESSAGES_PER_SEND];
+
+    *outSentCount = 0;
+    while (*outSentCount < count) {
+        const size_t sendCount = std::min(MAX_MESSAGES_PER_SEND, count - *outSentCount);
+        for (size_t i = 0; i < sendCount; i++) {
+            const InputMessage& msg = msgs[*outSentCount + i];
+            msg.getSanitizedCopy(&cleanMsgs[i]);
+            iovs[i].iov_base = &cleanMsgs[i];
+            iovs[i].iov_len = msg.size();
+            headers[i] = {};
+            headers[i].msg_hdr.msg_iov = &iovs[i];
+            headers[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int nSent;
+        do {
+            nSent = ::sendmmsg(getFd(), headers, sendCount, MSG_DONTWAIT | MSG_NOSIGNAL);
+        } while (nSent == -1 && errno == EINTR);
+
+        if (nSent < 0) {
+            int error = errno;
+#if DEBUG_CHANNEL_MESSAGES
+            ALOGD("channel '%s' ~ error sending message of type %d, %s", mName.c_str(),
+                  msgs[*outSentCount].header.type, strerror(error));
+#endif
+            return statusFromSendError(error);
+        }
+
+        // Each message is a packet of its own, so it is either sent whole or not at all. When
+        // only some of them were sent, the next send reports why the others were not.
+        for (int i = 0; i < nSent; i++) {
+            if (headers[i].msg_len != iovs[i].iov_len) {
+#if DEBUG_CHANNEL_MESSAGES
+                ALOGD("channel '%s' ~ error sending message type %d, send was incomplete",
+                      mName.c_str(), cleanMsgs[i].header.type);
+#endif
+                return DEAD_OBJECT;
+            }
+            (*outSentCount)++;
+        }
+    }
+
+#if DEBUG_CHANNEL_MESSAGES
+    ALOGD("channel '%s' ~ sent %zu messages", mName.c_str(), count);
+#endif
+    return OK;
+}
+
 status_t InputChannel::receiveMessage(InputMessage* msg) {
     ssize_t nRead;
     do {
@@ -525,7 +587,7 @@ status_t InputPublisher::publishKeyEvent(uint32_t seq, int32_t eventId, int32_t
     msg.body.key.repeatCount = repeatCount;
     msg.body.key.downTime = downTime;
     msg.body.key.eventTime = eventTime;
-    return mChannel->sendMessage(&msg);
+    return sendOrDeferMessage(msg);
 }
 
 status_t InputPublisher::publishMotionEvent(
@@ -603,7 +665,7 @@ status_t InputPublisher::publishMotionEvent(
         msg.body.motion.pointers[i].coords.copyFrom(pointerCoords[i]);
     }
 
-    return mChannel->sendMessage(&msg);
+    return sendOrDeferMessage(msg);
 }
 
 status_t InputPublisher::publishFocusEvent(uint32_t seq, int32_t eventId, bool hasFocus,
@@ -622,7 +684,7 @@ status_t InputPublisher::publishFocusEvent(uint32_t seq, int32_t eventId, bool h
     msg.body.focus.eventId = eventId;
     msg.body.focus.hasFocus = hasFocus;
     msg.body.focus.inTouchMode = inTouchMode;
-    return mChannel->sendMessage(&msg);
+    return sendOrDeferMessage(msg);
 }
 
 status_t InputPublisher::publishCaptureEvent(uint32_t seq, int32_t eventId,
@@ -639,7 +701,7 @@ status_t InputPublisher::publishCaptureEvent(uint32_t seq, int32_t eventId,
     msg.header.seq = seq;
     msg.body.capture.eventId = eventId;
     msg.body.capture.pointerCaptureEnabled = pointerCaptureEnabled;
-    return mChannel->sendMessage(&msg);
+    return sendOrDeferMessage(msg);
 }
 
 status_t InputPublisher::publishDragEvent(uint32_t seq, int32_t eventId, float x, float y,
@@ -658,7 +720,52 @@ status_t InputPublisher::publishDragEvent(uint32_t seq, int32_t eventId, float x
     msg.body.drag.isExiting = isExiting;
     msg.body.drag.x = x;
     msg.body.drag.y = y;
-    return mChannel->sendMessage(&msg);
+    return sendOrDeferMessage(msg);
+}
+
+status_t InputPublisher::publishMessageCopy(uint32_t seq, const InputMessage& msg) {
+    if (ATRACE_ENABLED()) {
+        std::string message = StringPrintf("publishMessageCopy(inputChannel=%s, type=%s)",
+                                           mChannel->getName().c_str(),
+                                           NamedEnum::string(msg.header.type).c_str());
+        ATRACE_NAME(message.c_str());
+    }
+
+    if (!seq) {
+        ALOGE("Attempted to publish a message with sequence number 0.");
+        return BAD_VALUE;
+    }
+
+    InputMessage copy = msg;
+    copy.header.seq = seq;
+    return sendOrDeferMessage(copy);
+}
+
+void InputPublisher::deferEvents() {
+    mDeferEvents = true;
+}
+
+status_t InputPublisher::sendDeferredEvents(size_t* outSentCount) {
+    if (ATRACE_ENABLED()) {
+        std::string message = StringPrintf("sendDeferredEvents(inputChannel=%s, count=%zu)",
+                                           mChannel->getName().c_str(),
+                                           mDeferredMessages.size());
+        ATRACE_NAME(message.c_str());
+    }
+    mDeferEvents = false;
+    status_t status = mChannel->sendMessages(mDeferredMessages.data(), mDeferredMessages.size(),
+                                             outSentCount);
+    // Keep the storage around for the next deferred events.
+    mDeferredMessages.clear();
+    return status;
+}
+
+status_t InputPublisher::sendOrDeferMessage(const InputMessage& msg) {
+    if (!mDeferEvents) {
+        return mChannel->sendMessage(&msg);
+    }
+    mDeferredMessages.push_back(msg);
+    return OK;
 }
 
 android::base::Result<InputPublisher::ConsumerResponse> InputPublisher::receiveConsumerResponse() {
@@ -694,7 +801,10 @@ android::base::Result<InputPublisher::ConsumerResponse> InputPublisher::receiveC
 // --- InputConsumer ---
 
 InputConsumer::InputConsumer(const std::shared_ptr<InputChannel>& channel)
-      : mResampleTouch(isTouchResamplingEnabled()), mChannel(channel), mMsgDeferred(false) {}
+      : mResampleTouch(isTouchResamplingEnabled()),
+        mResampler(getTouchResamplingStrategy()),
+        mChannel(channel),
+        mMsgDeferred(false) {}
 
 InputConsumer::~InputConsumer() {
 }
@@ -703,6 +813,18 @@ bool InputConsumer::isTouchResamplingEnabled() {
     return property_get_bool(PROPERTY_RESAMPLING_ENABLED, true);
 }
 
+TouchResampler::Strategy InputConsumer::getTouchResamplingStrategy() {
+    char value[PROPERTY_VALUE_MAX];
+    property_get(PROPERTY_RESAMPLING_STRATEGY, value, "");
+    if (!strcmp(value, "acceleration")) {
+        return TouchResampler::Strategy::ACCELERATION;
+    }
+    if (value[0] != '\0' && strcmp(value, "linear")) {
+        ALOGW("Unrecognized touch resampling strategy '%s', using the default one.", value);
+    }
+    return TouchResampler::Strategy::DEFAULT;
+}
+
 status_t InputConsumer::consume(InputEventFactoryInterface* factory, bool consumeBatches,
                                 nsecs_t frameTime, uint32_t* outSeq, InputEvent** outEvent,
                                 int* motionEventType, int* touchMoveNumber, bool* flag) {
@@ -892,7 +1014,7 @@ status_t InputConsumer::consumeBatch(InputEventFactoryInterface* factory,
 
         nsecs_t sampleTime = frameTime;
         if (mResampleTouch && (*touchMoveNumber != 1)) {
-            sampleTime -= RESAMPLE_LATENCY;
+            sampleTime -= mResampler.getLatency();
         }
         ssize_t split = findSampleNoLaterThan(batch, sampleTime);
         if (split < 0) {
@@ -1123,7 +1245,7 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
 #endif
             return;
         }
-        nsecs_t maxPredict = current->eventTime + min(delta / 2, RESAMPLE_MAX_PREDICTION);
+        nsecs_t maxPredict = mResampler.getMaxPredictionTime(current->eventTime, other->eventTime);
         if (sampleTime > maxPredict) {
 #if DEBUG_RESAMPLING
             ALOGD("Sample time is too far in the future, adjusting prediction "
@@ -1140,9 +1262,20 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         return;
     }
 
-    // Resample touch coordinates.
+    // The previously resampled values are only kept for pointers that haven't moved since, so
+    // only save them if there are any.
     History oldLastResample;
-    oldLastResample.initializeFrom(touchState.lastResample);
+    oldLastResample.idBits.clear();
+    for (size_t i = 0; i < pointerCount; i++) {
+        uint32_t id = event->getPointerId(i);
+        if (touchState.lastResample.hasPointerId(id) &&
+            touchState.recentCoordinatesAreIdentical(id)) {
+            oldLastResample.initializeFrom(touchState.lastResample);
+            break;
+        }
+    }
+
+    // Resample touch coordinates.
     touchState.lastResample.eventTime = sampleTime;
     touchState.lastResample.idBits.clear();
     for (size_t i = 0; i < pointerCount; i++) {
@@ -1167,10 +1300,26 @@ void InputConsumer::resampleTouchState(nsecs_t sampleTime, MotionEvent* event,
         if (other->idBits.hasBit(id)
                 && shouldResampleTool(event->getToolType(i))) {
             const PointerCoords& otherCoords = other->getPointerById(id);
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
-                    lerp(currentCoords.getX(), otherCoords.getX(), alpha));
-            resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
-                    lerp(currentCoords.getY(), otherCoords.getY(), alpha));
+            if (next) {
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X,
+                        lerp(currentCoords.getX(), otherCoords.getX(), alpha));
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y,
+                        lerp(currentCoords.getY(), otherCoords.getY(), alpha));
+            } else {
+                TouchResampler::Sample samples[TouchResampler::MAX_SAMPLES];
+                size_t sampleCount = touchState.getPointerSamples(id, samples);
+                // Samples too far apart, or too close, say little about the current movement.
+                if (sampleCount > 2) {
+                    nsecs_t previousDelta = samples[1].eventTime - samples[2].eventTime;
+                    if (previousDelta < RESAMPLE_MIN_DELTA || previousDelta > RESAMPLE_MAX_DELTA) {
+                        sampleCount = 2;
+                    }
+                }
+                float x, y;
+                mResampler.extrapolate(samples, sampleCount, sampleTime, &x, &y);
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_X, x);
+                resampledCoords.setAxisValue(AMOTION_EVENT_AXIS_Y, y);
+            }
 #if DEBUG_RESAMPLING
             ALOGD("[%d] - out (%0.3f, %0.3f), cur (%0.3f, %0.3f), "
                     "other (%0.3f, %0.3f), alpha %0.3f",
@@ -1416,6 +1565,7 @@ ssize_t InputConsumer::findSampleNoLaterThan(const Batch& batch, nsecs_t time) {
 std::string InputConsumer::dump() const {
     std::string out;
     out = out + "mResampleTouch = " + toString(mResampleTouch) + "\n";
+    out = out + "mResampler strategy = " + toString(mResampler.getStrategy()) + "\n";
     out = out + "mChannel = " + mChannel->getName() + "\n";
     out = out + "mMsgDeferred: " + toString(mMsgDeferred) + "\n";
     if (mMsgDeferred) {
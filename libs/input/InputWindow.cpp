@@ -69,6 +69,40 @@ bool InputWindowInfo::operator==(const InputWindowInfo& info) const {
             info.applicationInfo == applicationInfo;
 }
 
+Flags<InputWindowInfo::Change> InputWindowInfo::getChanges(const InputWindowInfo& other) const {
+    Flags<Change> changes;
+    if (other.frameLeft != frameLeft || other.frameTop != frameTop ||
+        other.frameRight != frameRight || other.frameBottom != frameBottom ||
+        other.surfaceInset != surfaceInset || other.globalScaleFactor != globalScaleFactor ||
+        other.alpha != alpha || !(other.transform == transform) ||
+        other.displayWidth != displayWidth || other.displayHeight != displayHeight ||
+        !other.touchableRegion.hasSameRects(touchableRegion)) {
+        changes |= Change::GEOMETRY;
+    }
+
+    // Compare everything else by copying the geometry over.
+    InputWindowInfo otherState = other;
+    otherState.frameLeft = frameLeft;
+    otherState.frameTop = frameTop;
+    otherState.frameRight = frameRight;
+    otherState.frameBottom = frameBottom;
+    otherState.surfaceInset = surfaceInset;
+    otherState.globalScaleFactor = globalScaleFactor;
+    otherState.alpha = alpha;
+    otherState.transform = transform;
+    otherState.displayWidth = displayWidth;
+    otherState.displayHeight = displayHeight;
+    otherState.touchableRegion = touchableRegion;
+    if (!(otherState == *this) ||
+        other.touchableRegionCropHandle != touchableRegionCropHandle) {
+        changes |= Change::STATE;
+    }
+    if (other.token != token || other.visible != visible || other.focusable != focusable) {
+        changes |= Change::FOCUS;
+    }
+    return changes;
+}
+
 status_t InputWindowInfo::writeToParcel(android::Parcel* parcel) const {
     if (parcel == nullptr) {
         ALOGE("%s: Null parcel", __func__);
@@ -17,6 +17,7 @@
 #define LOG_TAG "Keyboard"
 
 #include <stdlib.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <limits.h>
 
@@ -28,8 +29,20 @@
 #include <utils/Errors.h>
 #include <utils/Log.h>
 
+#include "LoadedFileCache.h"
+
 namespace android {
 
+static LoadedFileCache<KeyLayoutMap>& getKeyLayoutMapCache() {
+    static LoadedFileCache<KeyLayoutMap>* sCache = new LoadedFileCache<KeyLayoutMap>();
+    return *sCache;
+}
+
+static LoadedFileCache<KeyCharacterMap>& getKeyCharacterMapCache() {
+    static LoadedFileCache<KeyCharacterMap>* sCache = new LoadedFileCache<KeyCharacterMap>();
+    return *sCache;
+}
+
 // --- KeyMap ---
 
 KeyMap::KeyMap() {
@@ -110,7 +123,10 @@ status_t KeyMap::loadKeyLayout(const InputDeviceIdentifier& deviceIdentifier,
         return NAME_NOT_FOUND;
     }
 
-    base::Result<std::shared_ptr<KeyLayoutMap>> ret = KeyLayoutMap::load(path);
+    base::Result<std::shared_ptr<KeyLayoutMap>> ret =
+            getKeyLayoutMapCache().load(path, [](const std::string& filename) {
+                return KeyLayoutMap::load(filename);
+            });
     if (!ret.ok()) {
         return ret.error().code();
     }
@@ -128,7 +144,9 @@ status_t KeyMap::loadKeyCharacterMap(const InputDeviceIdentifier& deviceIdentifi
     }
 
     base::Result<std::shared_ptr<KeyCharacterMap>> ret =
-            KeyCharacterMap::load(path, KeyCharacterMap::Format::BASE);
+            getKeyCharacterMapCache().load(path, [](const std::string& filename) {
+                return KeyCharacterMap::load(filename, KeyCharacterMap::Format::BASE);
+            });
     if (!ret.ok()) {
         return ret.error().code();
     }
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _LIBINPUT_LOADED_FILE_CACHE_H
+#define _LIBINPUT_LOADED_FILE_CACHE_H
+
+#include <sys/stat.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <android-base/result.h>
+#include <android-base/thread_annotations.h>
+
+namespace android {
+
+/**
+ * The maps that were loaded from each file and are still in use, such as key maps and device
+ * configurations. Most devices fall back on the same few files, such as Generic.kl, so devices
+ * share the maps of these rather than parse them again. A file is only parsed again once it is
+ * changed, which is noticed by its identity, size or modification time changing.
+ *
+ * The maps are immutable once loaded. Key character maps are copied before an overlay is combined
+ * into them, so that the other devices keep the original one.
+ */
+template <typename T>
+class LoadedFileCache {
+public:
+    template <typename LoadFunction>
+    base::Result<std::shared_ptr<T>> load(const std::string& path, LoadFunction loadFunction) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            // Let the loader report the error.
+            return loadFunction(path);
+        }
+        const FileVersion version{st.st_dev, st.st_ino, st.st_size, st.st_mtime};
+
+        std::scoped_lock _l(mLock);
+        auto it = mEntries.find(path);
+        if (it != mEntries.end() && it->second.version == version) {
+            if (std::shared_ptr<T> map = it->second.map.lock()) {
+                return map;
+            }
+        }
+
+        base::Result<std::shared_ptr<T>> ret = loadFunction(path);
+        if (ret.ok()) {
+            // Forget the maps that are no longer used by any device.
+            for (auto entryIt = mEntries.begin(); entryIt != mEntries.end();) {
+                if (entryIt->second.map.expired()) {
+                    entryIt = mEntries.erase(entryIt);
+                } else {
+                    entryIt++;
+                }
+            }
+            mEntries[path] = {version, *ret};
+        }
+        return ret;
+    }
+
+private:
+    struct FileVersion {
+        dev_t device;
+        ino_t inode;
+        off_t size;
+        time_t modificationTime;
+
+        bool operator==(const FileVersion& other) const {
+            return device == other.device && inode == other.inode && size == other.size &&
+                    modificationTime == other.modificationTime;
+        }
+    };
+
+    struct Entry {
+        FileVersion version;
+        std::weak_ptr<T> map;
+    };
+
+    std::mutex mLock;
+    std::map<std::string, Entry> mEntries GUARDED_BY(mLock);
+};
+
+} // namespace android
+
+#endif // _LIBINPUT_LOADED_FILE_CACHE_H
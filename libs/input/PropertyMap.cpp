@@ -18,6 +18,8 @@
 
 #include <input/PropertyMap.h>
 
+#include "LoadedFileCache.h"
+
 // Enables debug output for the parser.
 #define DEBUG_PARSER 0
 
@@ -137,6 +139,19 @@ android::base::Result<std::unique_ptr<PropertyMap>> PropertyMap::load(const char
     return std::move(outMap);
 }
 
+android::base::Result<std::shared_ptr<const PropertyMap>> PropertyMap::loadShared(
+        const char* filename) {
+    using SharedMapResult = android::base::Result<std::shared_ptr<const PropertyMap>>;
+    static LoadedFileCache<const PropertyMap>* sCache = new LoadedFileCache<const PropertyMap>();
+    return sCache->load(filename, [](const std::string& path) -> SharedMapResult {
+        android::base::Result<std::unique_ptr<PropertyMap>> map = load(path.c_str());
+        if (!map.ok()) {
+            return map.error();
+        }
+        return std::shared_ptr<const PropertyMap>(std::move(*map));
+    });
+}
+
 // --- PropertyMap::Parser ---
 
 PropertyMap::Parser::Parser(PropertyMap* map, Tokenizer* tokenizer)
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TouchResampler"
+
+#include <math.h>
+#include <algorithm>
+
+#include <input/TouchResampler.h>
+
+namespace android {
+
+// Nanoseconds per milliseconds.
+static const nsecs_t NANOS_PER_MS = 1000000;
+
+// Latency added during linear resampling.  A few milliseconds doesn't hurt much but
+// reduces the impact of mispredicted touch positions.
+static const nsecs_t RESAMPLE_LATENCY = 5 * NANOS_PER_MS;
+
+// Maximum time to predict forward from the last known state, to avoid predicting too
+// far into the future.  This time is further bounded by the last time delta, or by 50%
+// of it for linear resampling.
+static const nsecs_t RESAMPLE_MAX_PREDICTION = 8 * NANOS_PER_MS;
+
+// Largest correction that the acceleration makes to the linear prediction, relative to the
+// distance that the linear prediction moves the pointer by.
+static const float ACCELERATION_MAX_CORRECTION = 0.5f;
+
+TouchResampler::TouchResampler(Strategy strategy)
+      : mStrategy(strategy == Strategy::DEFAULT ? DEFAULT_STRATEGY : strategy) {}
+
+nsecs_t TouchResampler::getLatency() const {
+    return mStrategy == Strategy::ACCELERATION ? 0 : RESAMPLE_LATENCY;
+}
+
+nsecs_t TouchResampler::getMaxPredictionTime(nsecs_t currentTime, nsecs_t previousTime) const {
+    const nsecs_t delta = currentTime - previousTime;
+    if (mStrategy == Strategy::ACCELERATION) {
+        return currentTime + std::min(delta, RESAMPLE_MAX_PREDICTION);
+    }
+    return currentTime + std::min(delta / 2, RESAMPLE_MAX_PREDICTION);
+}
+
+void TouchResampler::extrapolate(const Sample* samples, size_t count, nsecs_t sampleTime,
+                                 float* outX, float* outY) const {
+    const Sample& current = samples[0];
+    const Sample& previous = samples[1];
+    const float delta = current.eventTime - previous.eventTime;
+    const float vx = (current.x - previous.x) / delta;
+    const float vy = (current.y - previous.y) / delta;
+    const float predictionTime = sampleTime - current.eventTime;
+    *outX = current.x + vx * predictionTime;
+    *outY = current.y + vy * predictionTime;
+    if (mStrategy != Strategy::ACCELERATION || count < 3) {
+        return;
+    }
+
+    const Sample& oldest = samples[2];
+    const float previousDelta = previous.eventTime - oldest.eventTime;
+    if (previousDelta <= 0) {
+        return;
+    }
+    // Each velocity is the one at the middle of its interval.
+    const float ax = (vx - (previous.x - oldest.x) / previousDelta) * 2 / (delta + previousDelta);
+    const float ay = (vy - (previous.y - oldest.y) / previousDelta) * 2 / (delta + previousDelta);
+    // The linear prediction keeps the velocity of the middle of the last interval, so the
+    // acceleration applies from there on.
+    const float accelerationTime = predictionTime * (predictionTime + delta) / 2;
+    float cx = ax * accelerationTime;
+    float cy = ay * accelerationTime;
+    const float correction = hypotf(cx, cy);
+    const float maxCorrection =
+            ACCELERATION_MAX_CORRECTION * hypotf(vx * predictionTime, vy * predictionTime);
+    if (correction > maxCorrection) {
+        const float scale = maxCorrection / correction;
+        cx *= scale;
+        cy *= scale;
+    }
+    *outX += cx;
+    *outY += cy;
+}
+
+} // namespace android
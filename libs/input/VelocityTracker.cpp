@@ -23,11 +23,9 @@
 // Log debug messages about the progress of the algorithm itself.
 #define DEBUG_STRATEGY 0
 
-#include <array>
 #include <inttypes.h>
 #include <limits.h>
 #include <math.h>
-#include <optional>
 
 #include <android-base/stringprintf.h>
 #include <cutils/properties.h>
@@ -47,23 +45,6 @@ static const nsecs_t NANOS_PER_MS = 1000000;
 static const nsecs_t ASSUME_POINTER_STOPPED_TIME = 40 * NANOS_PER_MS;
 
 
-static float vectorDot(const float* a, const float* b, uint32_t m) {
-    float r = 0;
-    for (size_t i = 0; i < m; i++) {
-        r += *(a++) * *(b++);
-    }
-    return r;
-}
-
-static float vectorNorm(const float* a, uint32_t m) {
-    float r = 0;
-    for (size_t i = 0; i < m; i++) {
-        float t = *(a++);
-        r += t * t;
-    }
-    return sqrtf(r);
-}
-
 #if DEBUG_STRATEGY || DEBUG_VELOCITY
 static std::string vectorToString(const float* a, uint32_t m) {
     std::string str;
@@ -79,28 +60,6 @@ static std::string vectorToString(const float* a, uint32_t m) {
 }
 #endif
 
-#if DEBUG_STRATEGY
-static std::string matrixToString(const float* a, uint32_t m, uint32_t n, bool rowMajor) {
-    std::string str;
-    str = "[";
-    for (size_t i = 0; i < m; i++) {
-        if (i) {
-            str += ",";
-        }
-        str += " [";
-        for (size_t j = 0; j < n; j++) {
-            if (j) {
-                str += ",";
-            }
-            str += android::base::StringPrintf(" %f", a[rowMajor ? i * n + j : j * m + i]);
-        }
-        str += " ]";
-    }
-    str += " ]";
-    return str;
-}
-#endif
-
 
 // --- VelocityTracker ---
 
@@ -373,12 +332,12 @@ void LeastSquaresVelocityTrackerStrategy::addMovement(
  *
  * Returns true if a solution is found, false otherwise.
  *
- * The input consists of two vectors of data points X and Y with indices 0..m-1
- * along with a weight vector W of the same size.
+ * The input consists of two arrays of data points X and Y with indices 0..m-1
+ * along with a weight array W of the same size.
  *
- * The output is a vector B with indices 0..n that describes a polynomial
+ * The output is a vector B with indices 0..n-1 that describes a polynomial
  * that fits the data, such the sum of W[i] * W[i] * abs(Y[i] - (B[0] + B[1] X[i]
- * + B[2] X[i]^2 ... B[n] X[i]^n)) for all i between 0 and m-1 is minimized.
+ * + B[2] X[i]^2 ... B[n-1] X[i]^(n-1))) for all i between 0 and m-1 is minimized.
  *
  * Accordingly, the weight vector W should be initialized by the caller with the
  * reciprocal square root of the variance of the error in each input data point.
@@ -392,118 +351,129 @@ void LeastSquaresVelocityTrackerStrategy::addMovement(
  * as a vector although in the literature it is typically taken to be a diagonal matrix.
  *
  * That is to say, the function that generated the input data can be approximated
- * by y(x) ~= B[0] + B[1] x + B[2] x^2 + ... + B[n] x^n.
+ * by y(x) ~= B[0] + B[1] x + B[2] x^2 + ... + B[n-1] x^(n-1).
  *
- * The coefficient of determination (R^2) is also returned to describe the goodness
- * of fit of the model for the given data.  It is a value between 0 and 1, where 1
- * indicates perfect correspondence.
+ * If outDet is not null, the coefficient of determination (R^2) is also returned to
+ * describe the goodness of fit of the model for the given data.  It is a value between
+ * 0 and 1, where 1 indicates perfect correspondence.
  *
- * This function first expands the X vector to a m by n matrix A such that
- * A[i][0] = 1, A[i][1] = X[i], A[i][2] = X[i]^2, ..., A[i][n] = X[i]^n, then
- * multiplies it by w[i]./
+ * With A the m by n matrix such that A[i][j] = X[i]^j, the solution satisfies the normal
+ * equations (At W^2 A) B = At W^2 Y.  At W^2 A only holds the weighted moments of X, and
+ * At W^2 Y those of X times Y, so both are accumulated in a single pass over the data.
+ * Forming them squares the condition number of the problem, so they are accumulated in
+ * double precision, and about the weighted mean of X, which keeps them from all being of
+ * the same sign.  The system is then solved by Cholesky decomposition, and the polynomial
+ * moved back to the origin.  A column of A that is linearly dependent on the previous ones,
+ * as happens when the data points share the same X, has no solution.
  *
- * Then it calculates the QR decomposition of A yielding an m by m orthonormal matrix Q
- * and an m by n upper triangular matrix R.  Because R is upper triangular (lower
- * part is all zeroes), we can simplify the decomposition into an m by n matrix
- * Q1 and a n by n matrix R1 such that A = Q1 R1.
- *
- * Finally we solve the system of linear equations given by R1 B = (Qtranspose W Y)
- * to find B.
- *
- * For efficiency, we lay out A and Q column-wise in memory because we frequently
- * operate on the column vectors.  Conversely, we lay out R row-wise.
+ * None of this allocates, as the velocity is queried on every move of a pointer.
  *
  * http://en.wikipedia.org/wiki/Numerical_methods_for_linear_least_squares
- * http://en.wikipedia.org/wiki/Gram-Schmidt
+ * http://en.wikipedia.org/wiki/Cholesky_decomposition
  */
-static bool solveLeastSquares(const std::vector<float>& x, const std::vector<float>& y,
-                              const std::vector<float>& w, uint32_t n, float* outB, float* outDet) {
-    const size_t m = x.size();
+static bool solveLeastSquares(const float* x, const float* y, const float* w, uint32_t m,
+                              uint32_t n, float* outB, float* outDet) {
+    static constexpr uint32_t MAX_N = VelocityTracker::Estimator::MAX_DEGREE + 1;
+    LOG_ALWAYS_FATAL_IF(n > MAX_N, "Polynomial degree %u is too high", n - 1);
 #if DEBUG_STRATEGY
     ALOGD("solveLeastSquares: m=%d, n=%d, x=%s, y=%s, w=%s", int(m), int(n),
             vectorToString(x, m).c_str(), vectorToString(y, m).c_str(),
             vectorToString(w, m).c_str());
 #endif
-    LOG_ALWAYS_FATAL_IF(m != y.size() || m != w.size(), "Mismatched vector sizes");
 
-    // Expand the X vector to a matrix A, pre-multiplied by the weights.
-    float a[n][m]; // column-major order
+    double weightSum = 0;
+    double xMean = 0;
     for (uint32_t h = 0; h < m; h++) {
-        a[0][h] = w[h];
-        for (uint32_t i = 1; i < n; i++) {
-            a[i][h] = a[i - 1][h] * x[h];
-        }
+        const double w2 = double(w[h]) * w[h];
+        weightSum += w2;
+        xMean += w2 * x[h];
     }
-#if DEBUG_STRATEGY
-    ALOGD("  - a=%s", matrixToString(&a[0][0], m, n, false /*rowMajor*/).c_str());
-#endif
+    if (weightSum <= 0) {
+        return false;
+    }
+    xMean /= weightSum;
 
-    // Apply the Gram-Schmidt process to A to obtain its QR decomposition.
-    float q[n][m]; // orthonormal basis, column-major order
-    float r[n][n]; // upper triangular matrix, row-major order
-    for (uint32_t j = 0; j < n; j++) {
-        for (uint32_t h = 0; h < m; h++) {
-            q[j][h] = a[j][h];
-        }
-        for (uint32_t i = 0; i < j; i++) {
-            float dot = vectorDot(&q[j][0], &q[i][0], m);
-            for (uint32_t h = 0; h < m; h++) {
-                q[j][h] -= dot * q[i][h];
+    // Accumulate the moments sum(W^2 X^k) and sum(W^2 X^k Y), about the mean of X.
+    double xMoments[2 * MAX_N - 1] = {};
+    double xyMoments[MAX_N] = {};
+    for (uint32_t h = 0; h < m; h++) {
+        const double dx = x[h] - xMean;
+        double term = double(w[h]) * w[h];
+        for (uint32_t k = 0; k < 2 * n - 1; k++) {
+            xMoments[k] += term;
+            if (k < n) {
+                xyMoments[k] += term * y[h];
             }
+            term *= dx;
         }
+    }
 
-        float norm = vectorNorm(&q[j][0], m);
-        if (norm < 0.000001f) {
+    // Decompose At W^2 A into L Lt, with L lower triangular.
+    double l[MAX_N][MAX_N];
+    for (uint32_t j = 0; j < n; j++) {
+        double diagonal = xMoments[2 * j];
+        for (uint32_t k = 0; k < j; k++) {
+            diagonal -= l[j][k] * l[j][k];
+        }
+        // The diagonal of L is the norm of the columns of W A once orthogonalized, so this
+        // is the same check as orthogonalizing them explicitly would make.
+        if (diagonal < 0.000001 * 0.000001) {
             // vectors are linearly dependent or zero so no solution
 #if DEBUG_STRATEGY
-            ALOGD("  - no solution, norm=%f", norm);
+            ALOGD("  - no solution, norm=%f", sqrt(fmax(diagonal, 0.0)));
 #endif
             return false;
         }
-
-        float invNorm = 1.0f / norm;
-        for (uint32_t h = 0; h < m; h++) {
-            q[j][h] *= invNorm;
-        }
-        for (uint32_t i = 0; i < n; i++) {
-            r[j][i] = i < j ? 0 : vectorDot(&q[j][0], &a[i][0], m);
-        }
-    }
-#if DEBUG_STRATEGY
-    ALOGD("  - q=%s", matrixToString(&q[0][0], m, n, false /*rowMajor*/).c_str());
-    ALOGD("  - r=%s", matrixToString(&r[0][0], n, n, true /*rowMajor*/).c_str());
-
-    // calculate QR, if we factored A correctly then QR should equal A
-    float qr[n][m];
-    for (uint32_t h = 0; h < m; h++) {
-        for (uint32_t i = 0; i < n; i++) {
-            qr[i][h] = 0;
-            for (uint32_t j = 0; j < n; j++) {
-                qr[i][h] += q[j][h] * r[j][i];
+        l[j][j] = sqrt(diagonal);
+        for (uint32_t i = j + 1; i < n; i++) {
+            double value = xMoments[i + j];
+            for (uint32_t k = 0; k < j; k++) {
+                value -= l[i][k] * l[j][k];
             }
+            l[i][j] = value / l[j][j];
         }
     }
-    ALOGD("  - qr=%s", matrixToString(&qr[0][0], m, n, false /*rowMajor*/).c_str());
-#endif
 
-    // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
-    // We just work from bottom-right to top-left calculating B's coefficients.
-    float wy[m];
-    for (uint32_t h = 0; h < m; h++) {
-        wy[h] = y[h] * w[h];
+    // Solve L Z = At W^2 Y, then Lt B = Z.
+    double z[MAX_N];
+    for (uint32_t i = 0; i < n; i++) {
+        z[i] = xyMoments[i];
+        for (uint32_t k = 0; k < i; k++) {
+            z[i] -= l[i][k] * z[k];
+        }
+        z[i] /= l[i][i];
     }
+    double c[MAX_N];
     for (uint32_t i = n; i != 0; ) {
         i--;
-        outB[i] = vectorDot(&q[i][0], wy, m);
-        for (uint32_t j = n - 1; j > i; j--) {
-            outB[i] -= r[i][j] * outB[j];
+        c[i] = z[i];
+        for (uint32_t k = i + 1; k < n; k++) {
+            c[i] -= l[k][i] * c[k];
+        }
+        c[i] /= l[i][i];
+    }
+
+    // Expand sum(C[k] (X - mean)^k) into B, by Horner's method.
+    double b[MAX_N] = {};
+    for (uint32_t k = n; k != 0; ) {
+        k--;
+        // B = B * (X - mean) + C[k]
+        for (uint32_t i = n - 1; i != 0; i--) {
+            b[i] = b[i - 1] - xMean * b[i];
         }
-        outB[i] /= r[i][i];
+        b[0] = c[k] - xMean * b[0];
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        outB[i] = b[i];
     }
 #if DEBUG_STRATEGY
     ALOGD("  - b=%s", vectorToString(outB, n).c_str());
 #endif
 
+    if (outDet == nullptr) {
+        return true;
+    }
+
     // Calculate the coefficient of determination as 1 - (SSerr / SStot) where
     // SSerr is the residual sum of squares (variance of the error),
     // and SStot is the total sum of squares (variance of the data) where each
@@ -536,69 +506,16 @@ static bool solveLeastSquares(const std::vector<float>& x, const std::vector<flo
     return true;
 }
 
-/*
- * Optimized unweighted second-order least squares fit. About 2x speed improvement compared to
- * the default implementation
- */
-static std::optional<std::array<float, 3>> solveUnweightedLeastSquaresDeg2(
-        const std::vector<float>& x, const std::vector<float>& y) {
-    const size_t count = x.size();
-    LOG_ALWAYS_FATAL_IF(count != y.size(), "Mismatching array sizes");
-    // Solving y = a*x^2 + b*x + c
-    float sxi = 0, sxiyi = 0, syi = 0, sxi2 = 0, sxi3 = 0, sxi2yi = 0, sxi4 = 0;
-
-    for (size_t i = 0; i < count; i++) {
-        float xi = x[i];
-        float yi = y[i];
-        float xi2 = xi*xi;
-        float xi3 = xi2*xi;
-        float xi4 = xi3*xi;
-        float xiyi = xi*yi;
-        float xi2yi = xi2*yi;
-
-        sxi += xi;
-        sxi2 += xi2;
-        sxiyi += xiyi;
-        sxi2yi += xi2yi;
-        syi += yi;
-        sxi3 += xi3;
-        sxi4 += xi4;
-    }
-
-    float Sxx = sxi2 - sxi*sxi / count;
-    float Sxy = sxiyi - sxi*syi / count;
-    float Sxx2 = sxi3 - sxi*sxi2 / count;
-    float Sx2y = sxi2yi - sxi2*syi / count;
-    float Sx2x2 = sxi4 - sxi2*sxi2 / count;
-
-    float denominator = Sxx*Sx2x2 - Sxx2*Sxx2;
-    if (denominator == 0) {
-        ALOGW("division by 0 when computing velocity, Sxx=%f, Sx2x2=%f, Sxx2=%f", Sxx, Sx2x2, Sxx2);
-        return std::nullopt;
-    }
-    // Compute a
-    float numerator = Sx2y*Sxx - Sxy*Sxx2;
-    float a = numerator / denominator;
-
-    // Compute b
-    numerator = Sxy*Sx2x2 - Sx2y*Sxx2;
-    float b = numerator / denominator;
-
-    // Compute c
-    float c = syi/count - b * sxi/count - a * sxi2/count;
-
-    return std::make_optional(std::array<float, 3>({c, b, a}));
-}
-
 bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         VelocityTracker::Estimator* outEstimator) const {
     outEstimator->clear();
 
     // Iterate over movement samples in reverse time order and collect samples.
-    std::vector<float> x;
-    std::vector<float> y;
-    std::vector<float> w;
-    std::vector<float> time;
+    float x[HISTORY_SIZE];
+    float y[HISTORY_SIZE];
+    float w[HISTORY_SIZE];
+    float time[HISTORY_SIZE];
+    uint32_t m = 0;
 
     uint32_t index = mIndex;
     const Movement& newestMovement = mMovements[mIndex];
@@ -614,14 +531,14 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
         }
 
         const VelocityTracker::Position& position = movement.getPosition(id);
-        x.push_back(position.x);
-        y.push_back(position.y);
-        w.push_back(chooseWeight(index));
-        time.push_back(-age * 0.000000001f);
+        x[m] = position.x;
+        y[m] = position.y;
+        w[m] = chooseWeight(index);
+        time[m] = -age * 0.000000001f;
+        m++;
         index = (index == 0 ? HISTORY_SIZE : index) - 1;
-    } while (x.size() < HISTORY_SIZE);
+    } while (m < HISTORY_SIZE);
 
-    const size_t m = x.size();
     if (m == 0) {
         return false; // no data
     }
@@ -633,25 +550,21 @@ bool LeastSquaresVelocityTrackerStrategy::getEstimator(uint32_t id,
     }
 
     if (degree == 2 && mWeighting == WEIGHTING_NONE) {
-        // Optimize unweighted, quadratic polynomial fit
-        std::optional<std::array<float, 3>> xCoeff = solveUnweightedLeastSquaresDeg2(time, x);
-        std::optional<std::array<float, 3>> yCoeff = solveUnweightedLeastSquaresDeg2(time, y);
-        if (xCoeff && yCoeff) {
+        // The unweighted quadratic fit is the default strategy, so skip computing how good of
+        // a fit it is, which nothing uses it for.
+        if (solveLeastSquares(time, x, w, m, 3, outEstimator->xCoeff, nullptr) &&
+            solveLeastSquares(time, y, w, m, 3, outEstimator->yCoeff, nullptr)) {
             outEstimator->time = newestMovement.eventTime;
             outEstimator->degree = 2;
             outEstimator->confidence = 1;
-            for (size_t i = 0; i <= outEstimator->degree; i++) {
-                outEstimator->xCoeff[i] = (*xCoeff)[i];
-                outEstimator->yCoeff[i] = (*yCoeff)[i];
-            }
             return true;
         }
     } else if (degree >= 1) {
         // General case for an Nth degree polynomial fit
         float xdet, ydet;
         uint32_t n = degree + 1;
-        if (solveLeastSquares(time, x, w, n, outEstimator->xCoeff, &xdet) &&
-            solveLeastSquares(time, y, w, n, outEstimator->yCoeff, &ydet)) {
+        if (solveLeastSquares(time, x, w, m, n, outEstimator->xCoeff, &xdet) &&
+            solveLeastSquares(time, y, w, m, n, outEstimator->yCoeff, &ydet)) {
             outEstimator->time = newestMovement.eventTime;
             outEstimator->degree = degree;
             outEstimator->confidence = xdet * ydet;
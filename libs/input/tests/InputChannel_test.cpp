@@ -163,6 +163,67 @@ TEST_F(InputChannelTest, SendSignal_WhenPeerClosed_ReturnsAnError) {
             << "sendMessage should have returned DEAD_OBJECT";
 }
 
+TEST_F(InputChannelTest, SendMessages_SendsAllMessagesInOrder) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel));
+
+    std::vector<InputMessage> serverMsgs(20);
+    for (size_t i = 0; i < serverMsgs.size(); i++) {
+        memset(&serverMsgs[i], 0, sizeof(InputMessage));
+        serverMsgs[i].header.type = InputMessage::Type::KEY;
+        serverMsgs[i].header.seq = i + 1;
+    }
+    size_t sentCount;
+    EXPECT_EQ(OK, serverChannel->sendMessages(serverMsgs.data(), serverMsgs.size(), &sentCount));
+    EXPECT_EQ(serverMsgs.size(), sentCount);
+
+    InputMessage clientMsg;
+    for (const InputMessage& serverMsg : serverMsgs) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+        EXPECT_EQ(serverMsg.header.type, clientMsg.header.type);
+        EXPECT_EQ(serverMsg.header.seq, clientMsg.header.seq);
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+}
+
+TEST_F(InputChannelTest, SendMessages_WhenChannelFull_ReportsTheMessagesSent) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel));
+
+    // Far more messages than the socket buffer holds.
+    std::vector<InputMessage> serverMsgs(1000);
+    for (size_t i = 0; i < serverMsgs.size(); i++) {
+        memset(&serverMsgs[i], 0, sizeof(InputMessage));
+        serverMsgs[i].header.type = InputMessage::Type::KEY;
+        serverMsgs[i].header.seq = i + 1;
+    }
+    size_t sentCount;
+    EXPECT_EQ(WOULD_BLOCK,
+              serverChannel->sendMessages(serverMsgs.data(), serverMsgs.size(), &sentCount));
+    ASSERT_GT(sentCount, 0u);
+    ASSERT_LT(sentCount, serverMsgs.size());
+
+    InputMessage clientMsg;
+    for (size_t i = 0; i < sentCount; i++) {
+        ASSERT_EQ(OK, clientChannel->receiveMessage(&clientMsg));
+        EXPECT_EQ(serverMsgs[i].header.seq, clientMsg.header.seq);
+    }
+    EXPECT_EQ(WOULD_BLOCK, clientChannel->receiveMessage(&clientMsg));
+}
+
+TEST_F(InputChannelTest, SendMessages_WhenPeerClosed_ReturnsAnError) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    ASSERT_EQ(OK, InputChannel::openInputChannelPair("channel name", serverChannel, clientChannel));
+
+    serverChannel.reset(); // close server channel
+
+    InputMessage msg = {};
+    msg.header.type = InputMessage::Type::KEY;
+    size_t sentCount;
+    EXPECT_EQ(DEAD_OBJECT, clientChannel->sendMessages(&msg, 1, &sentCount));
+    EXPECT_EQ(0u, sentCount);
+}
+
 TEST_F(InputChannelTest, SendAndReceive_MotionClassification) {
     std::unique_ptr<InputChannel> serverChannel, clientChannel;
     status_t result = InputChannel::openInputChannelPair("channel name",
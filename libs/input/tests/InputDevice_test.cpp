@@ -82,4 +82,18 @@ TEST_F(InputDeviceKeyMapTest, keyCharacterMapParcelingTest) {
     ASSERT_EQ(*map, *mKeyMap.keyCharacterMap);
 }
 
+TEST_F(InputDeviceKeyMapTest, DevicesShareLoadedKeyMaps) {
+    InputDeviceIdentifier identifier;
+    identifier.name = "test device";
+    KeyMap first;
+    ASSERT_EQ(OK, first.load(identifier, nullptr));
+    KeyMap second;
+    ASSERT_EQ(OK, second.load(identifier, nullptr));
+
+    ASSERT_EQ(first.keyLayoutFile, second.keyLayoutFile);
+    ASSERT_EQ(first.keyLayoutMap, second.keyLayoutMap);
+    ASSERT_EQ(first.keyCharacterMapFile, second.keyCharacterMapFile);
+    ASSERT_EQ(first.keyCharacterMap, second.keyCharacterMap);
+}
+
 } // namespace android
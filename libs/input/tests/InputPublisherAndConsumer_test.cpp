@@ -466,6 +466,72 @@ TEST_F(InputPublisherAndConsumerTest, PublishDragEvent_EndToEnd) {
     ASSERT_NO_FATAL_FAILURE(PublishAndConsumeDragEvent());
 }
 
+TEST_F(InputPublisherAndConsumerTest, PublishDeferredEvents_EndToEnd) {
+    mPublisher->deferEvents();
+    ASSERT_EQ(OK, mPublisher->publishFocusEvent(1, InputEvent::nextId(), true, true));
+    ASSERT_EQ(OK, mPublisher->publishCaptureEvent(2, InputEvent::nextId(), true));
+
+    uint32_t consumeSeq;
+    InputEvent* event;
+    int motionEventType;
+    int touchMoveNumber;
+    bool flag;
+    ASSERT_EQ(WOULD_BLOCK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq, &event,
+                                 &motionEventType, &touchMoveNumber, &flag))
+            << "deferred events should not be sent before sendDeferredEvents";
+
+    size_t sentCount;
+    ASSERT_EQ(OK, mPublisher->sendDeferredEvents(&sentCount));
+    EXPECT_EQ(2u, sentCount);
+
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq, &event,
+                                 &motionEventType, &touchMoveNumber, &flag));
+    ASSERT_EQ(AINPUT_EVENT_TYPE_FOCUS, event->getType());
+    EXPECT_EQ(1u, consumeSeq);
+    ASSERT_EQ(OK,
+              mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq, &event,
+                                 &motionEventType, &touchMoveNumber, &flag));
+    ASSERT_EQ(AINPUT_EVENT_TYPE_CAPTURE, event->getType());
+    EXPECT_EQ(2u, consumeSeq);
+
+    // Events published after sending the deferred ones are sent right away.
+    ASSERT_NO_FATAL_FAILURE(PublishAndConsumeKeyEvent());
+}
+
+TEST_F(InputPublisherAndConsumerTest, PublishMessageCopy_EndToEnd) {
+    EXPECT_EQ(nullptr, mPublisher->getLastDeferredMessage());
+    mPublisher->deferEvents();
+    const int32_t eventId = InputEvent::nextId();
+    ASSERT_EQ(OK, mPublisher->publishDragEvent(1, eventId, 10, 20, false));
+    const InputMessage* message = mPublisher->getLastDeferredMessage();
+    ASSERT_NE(nullptr, message);
+    const InputMessage original = *message;
+    size_t sentCount;
+    ASSERT_EQ(OK, mPublisher->sendDeferredEvents(&sentCount));
+
+    ASSERT_EQ(BAD_VALUE, mPublisher->publishMessageCopy(0, original));
+    ASSERT_EQ(OK, mPublisher->publishMessageCopy(2, original));
+
+    uint32_t consumeSeq;
+    InputEvent* event;
+    int motionEventType;
+    int touchMoveNumber;
+    bool flag;
+    for (uint32_t expectedSeq : {1u, 2u}) {
+        ASSERT_EQ(OK,
+                  mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
+                                     &event, &motionEventType, &touchMoveNumber, &flag));
+        ASSERT_EQ(AINPUT_EVENT_TYPE_DRAG, event->getType());
+        EXPECT_EQ(expectedSeq, consumeSeq);
+        const DragEvent* dragEvent = static_cast<DragEvent*>(event);
+        EXPECT_EQ(eventId, dragEvent->getId());
+        EXPECT_EQ(10, dragEvent->getX());
+        EXPECT_EQ(20, dragEvent->getY());
+    }
+}
+
 TEST_F(InputPublisherAndConsumerTest, PublishMotionEvent_WhenSequenceNumberIsZero_ReturnsError) {
     status_t status;
     const size_t pointerCount = 1;
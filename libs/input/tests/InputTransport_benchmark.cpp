@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <input/InputTransport.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+namespace {
+
+// Publishes a motion event with the given number of pointers, consumes it on the other end of the
+// channel and sends its finished signal back, as the dispatcher and an app do for every event.
+// The latency of an event is the time from publishing it to receiving its finished signal.
+void BM_PublishConsumeFinish(benchmark::State& state) {
+    std::unique_ptr<InputChannel> serverChannel, clientChannel;
+    if (InputChannel::openInputChannelPair("benchmark", serverChannel, clientChannel) != OK) {
+        state.SkipWithError("Could not open the input channels");
+        return;
+    }
+    InputPublisher publisher(std::move(serverChannel));
+    InputConsumer consumer(std::move(clientChannel));
+    PreallocatedInputEventFactory eventFactory;
+
+    const uint32_t pointerCount = static_cast<uint32_t>(state.range(0));
+    PointerProperties pointerProperties[MAX_POINTERS];
+    PointerCoords pointerCoords[MAX_POINTERS];
+    for (uint32_t i = 0; i < pointerCount; i++) {
+        pointerProperties[i].clear();
+        pointerProperties[i].id = i;
+        pointerProperties[i].toolType = AMOTION_EVENT_TOOL_TYPE_FINGER;
+        pointerCoords[i].clear();
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_X, 100 * (i + 1));
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_Y, 200 * (i + 1));
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_PRESSURE, 0.5);
+        pointerCoords[i].setAxisValue(AMOTION_EVENT_AXIS_SIZE, 0.1);
+    }
+    const ui::Transform identityTransform;
+
+    std::vector<nsecs_t> latencies;
+    uint32_t seq = 0;
+    for (auto _ : state) {
+        const nsecs_t publishTime = systemTime(SYSTEM_TIME_MONOTONIC);
+        seq++;
+        status_t status =
+                publisher.publishMotionEvent(seq, /*eventId*/ seq, /*deviceId*/ 1,
+                                             AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                                             /*hmac*/ {}, AMOTION_EVENT_ACTION_MOVE,
+                                             /*actionButton*/ 0, /*flags*/ 0,
+                                             AMOTION_EVENT_EDGE_FLAG_NONE, AMETA_NONE,
+                                             /*buttonState*/ 0, MotionClassification::NONE,
+                                             identityTransform, /*xPrecision*/ 0,
+                                             /*yPrecision*/ 0,
+                                             AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                             AMOTION_EVENT_INVALID_CURSOR_POSITION,
+                                             AMOTION_EVENT_INVALID_DISPLAY_SIZE,
+                                             AMOTION_EVENT_INVALID_DISPLAY_SIZE, publishTime,
+                                             publishTime, pointerCount, pointerProperties,
+                                             pointerCoords);
+        if (status != OK) {
+            state.SkipWithError("Could not publish the motion event");
+            break;
+        }
+
+        uint32_t consumeSeq;
+        InputEvent* event;
+        int motionEventType;
+        int touchMoveNumber;
+        bool flag;
+        status = consumer.consume(&eventFactory, /*consumeBatches*/ true, /*frameTime*/ -1,
+                                  &consumeSeq, &event, &motionEventType, &touchMoveNumber, &flag);
+        if (status != OK || consumer.sendFinishedSignal(consumeSeq, /*handled*/ true) != OK) {
+            state.SkipWithError("Could not consume the motion event");
+            break;
+        }
+
+        if (!publisher.receiveConsumerResponse().ok()) {
+            state.SkipWithError("Could not receive the finished signal");
+            break;
+        }
+        latencies.push_back(systemTime(SYSTEM_TIME_MONOTONIC) - publishTime);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double fraction) {
+        const size_t index = std::min(latencies.size() - 1,
+                                      static_cast<size_t>(fraction * latencies.size()));
+        return static_cast<double>(ns2us(latencies[index]));
+    };
+    state.counters["LatencyP50Us"] = percentile(0.5);
+    state.counters["LatencyP90Us"] = percentile(0.9);
+    state.counters["LatencyP99Us"] = percentile(0.99);
+}
+BENCHMARK(BM_PublishConsumeFinish)->ArgName("pointers")->Arg(1)->Arg(5)->Arg(10);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -111,6 +111,54 @@ TEST(InputWindowInfo, Parcelling) {
     ASSERT_EQ(i.applicationInfo, i2.applicationInfo);
 }
 
+TEST(InputWindowInfo, GetChanges) {
+    InputWindowInfo i;
+    i.token = new BBinder();
+    i.id = 1;
+    i.name = "Foobar";
+    i.frameRight = 100;
+    i.frameBottom = 100;
+    i.alpha = 1.0;
+    i.addTouchableRegion(Rect(0, 0, 100, 100));
+    i.focusable = true;
+
+    InputWindowInfo i2 = i;
+    ASSERT_EQ(0u, i2.getChanges(i).get());
+
+    i2.frameLeft = 10;
+    i2.transform.set(-10, 0);
+    i2.touchableRegion = Region(Rect(10, 0, 100, 100));
+    ASSERT_EQ(Flags<InputWindowInfo::Change>(InputWindowInfo::Change::GEOMETRY),
+              i2.getChanges(i));
+
+    i2.alpha = 0.5;
+    ASSERT_EQ(Flags<InputWindowInfo::Change>(InputWindowInfo::Change::GEOMETRY),
+              i2.getChanges(i));
+
+    i2 = i;
+    i2.name = "Foobaz";
+    ASSERT_EQ(Flags<InputWindowInfo::Change>(InputWindowInfo::Change::STATE), i2.getChanges(i));
+
+    i2 = i;
+    i2.focusable = false;
+    ASSERT_EQ(Flags<InputWindowInfo::Change>(InputWindowInfo::Change::STATE) |
+                      InputWindowInfo::Change::FOCUS,
+              i2.getChanges(i));
+
+    i2.frameRight = 200;
+    ASSERT_EQ(Flags<InputWindowInfo::Change>(InputWindowInfo::Change::GEOMETRY) |
+                      InputWindowInfo::Change::STATE | InputWindowInfo::Change::FOCUS,
+              i2.getChanges(i));
+
+    i2 = i;
+    i2.visible = false;
+    ASSERT_TRUE(i2.getChanges(i).test(InputWindowInfo::Change::FOCUS));
+
+    i2 = i;
+    i2.token = new BBinder();
+    ASSERT_TRUE(i2.getChanges(i).test(InputWindowInfo::Change::FOCUS));
+}
+
 TEST(InputApplicationInfo, Parcelling) {
     InputApplicationInfo i;
     i.token = new BBinder();
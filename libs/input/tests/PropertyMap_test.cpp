@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+#include <input/PropertyMap.h>
+
+namespace android {
+
+TEST(PropertyMapTest, LoadShared_SharesTheMapOfAnUnchangedFile) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteStringToFile("touch.deviceType = touchScreen\n", file.path));
+
+    base::Result<std::shared_ptr<const PropertyMap>> first = PropertyMap::loadShared(file.path);
+    ASSERT_TRUE(first.ok());
+    base::Result<std::shared_ptr<const PropertyMap>> second = PropertyMap::loadShared(file.path);
+    ASSERT_TRUE(second.ok());
+    ASSERT_EQ(*first, *second);
+
+    String8 deviceType;
+    ASSERT_TRUE((*second)->tryGetProperty(String8("touch.deviceType"), deviceType));
+    ASSERT_EQ(String8("touchScreen"), deviceType);
+}
+
+TEST(PropertyMapTest, LoadShared_LoadsAChangedFileAgain) {
+    TemporaryFile file;
+    ASSERT_TRUE(base::WriteStringToFile("device.internal = 1\n", file.path));
+    base::Result<std::shared_ptr<const PropertyMap>> first = PropertyMap::loadShared(file.path);
+    ASSERT_TRUE(first.ok());
+
+    // The size of the file changes, even if it is written within the same second.
+    ASSERT_TRUE(base::WriteStringToFile("device.internal = 0\naudio.mic = 1\n", file.path));
+    base::Result<std::shared_ptr<const PropertyMap>> second = PropertyMap::loadShared(file.path);
+    ASSERT_TRUE(second.ok());
+    ASSERT_NE(*first, *second);
+
+    bool internal = true;
+    ASSERT_TRUE((*second)->tryGetProperty(String8("device.internal"), internal));
+    ASSERT_FALSE(internal);
+    ASSERT_TRUE((*second)->hasProperty(String8("audio.mic")));
+    ASSERT_FALSE((*first)->hasProperty(String8("audio.mic")));
+}
+
+} // namespace android
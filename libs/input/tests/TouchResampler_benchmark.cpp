@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <input/TouchResampler.h>
+
+namespace android {
+
+namespace {
+
+constexpr nsecs_t kSampleInterval = 1000000000 / 120;
+constexpr size_t kSampleCount = 64;
+
+// Samples of a swipe along a curve, reported at 120Hz.
+std::vector<TouchResampler::Sample> makeSwipe() {
+    std::vector<TouchResampler::Sample> samples;
+    for (size_t i = 0; i < kSampleCount; i++) {
+        const float progress = float(i) / kSampleCount;
+        samples.push_back({nsecs_t(i) * kSampleInterval, 100 + 900 * progress * progress,
+                           1500 - 600 * sinf(progress)});
+    }
+    return samples;
+}
+
+// Resamples every frame of the swipe half an interval past its most recent sample, as
+// InputConsumer does when a frame is drawn before the next sample arrives.
+void BM_Extrapolate(benchmark::State& state, TouchResampler::Strategy strategy) {
+    const std::vector<TouchResampler::Sample> swipe = makeSwipe();
+    const TouchResampler resampler(strategy);
+    for (auto _ : state) {
+        for (size_t i = TouchResampler::MAX_SAMPLES - 1; i < swipe.size(); i++) {
+            const TouchResampler::Sample samples[] = {swipe[i], swipe[i - 1], swipe[i - 2]};
+            float x, y;
+            resampler.extrapolate(samples, TouchResampler::MAX_SAMPLES,
+                                  swipe[i].eventTime + kSampleInterval / 2, &x, &y);
+            benchmark::DoNotOptimize(x);
+            benchmark::DoNotOptimize(y);
+        }
+    }
+}
+BENCHMARK_CAPTURE(BM_Extrapolate, Linear, TouchResampler::Strategy::LINEAR);
+BENCHMARK_CAPTURE(BM_Extrapolate, Acceleration, TouchResampler::Strategy::ACCELERATION);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
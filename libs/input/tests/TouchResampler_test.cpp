@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <input/TouchResampler.h>
+
+namespace android {
+
+using Sample = TouchResampler::Sample;
+using Strategy = TouchResampler::Strategy;
+
+static constexpr nsecs_t NANOS_PER_MS = 1000000;
+
+// A swipe reported at 120Hz, with the coordinates quantized to a tenth of a pixel and some
+// jitter, as digitizers report them. It speeds up, then slows down to a stop.
+static const std::vector<Sample> SWIPE = {
+        {0, 100.3f, 1499.7f},
+        {8333333, 107.2f, 1496.6f},
+        {16666667, 123.9f, 1485.7f},
+        {25000000, 148.3f, 1469.4f},
+        {33333333, 180.9f, 1446.5f},
+        {41666667, 219.3f, 1419.3f},
+        {50000000, 263.5f, 1387.6f},
+        {58333333, 313.0f, 1351.7f},
+        {66666667, 365.5f, 1313.5f},
+        {75000000, 421.9f, 1272.1f},
+        {83333333, 479.8f, 1229.5f},
+        {91666667, 540.0f, 1184.7f},
+        {100000000, 599.9f, 1140.0f},
+        {108333333, 659.7f, 1095.2f},
+        {116666667, 718.9f, 1050.5f},
+        {125000000, 775.1f, 1008.0f},
+        {133333333, 829.4f, 966.6f},
+        {141666667, 879.3f, 928.3f},
+        {150000000, 925.8f, 892.3f},
+        {158333333, 966.2f, 860.7f},
+        {166666667, 1000.8f, 833.4f},
+        {175000000, 1028.9f, 810.6f},
+        {183333333, 1048.5f, 794.4f},
+        {191666667, 1060.5f, 783.5f},
+};
+
+/*
+ * Mean distance between the positions predicted predictionTime after each sample of the swipe
+ * and the actual ones, taken on the line to the sample after it.
+ */
+static float getMeanExtrapolationError(Strategy strategy, nsecs_t predictionTime) {
+    TouchResampler resampler(strategy);
+    float totalError = 0;
+    size_t count = 0;
+    for (size_t i = TouchResampler::MAX_SAMPLES - 1; i + 1 < SWIPE.size(); i++) {
+        const Sample samples[] = {SWIPE[i], SWIPE[i - 1], SWIPE[i - 2]};
+        const Sample& next = SWIPE[i + 1];
+        const nsecs_t sampleTime = SWIPE[i].eventTime + predictionTime;
+        float x, y;
+        resampler.extrapolate(samples, TouchResampler::MAX_SAMPLES, sampleTime, &x, &y);
+
+        const float alpha =
+                float(predictionTime) / float(next.eventTime - SWIPE[i].eventTime);
+        const float expectedX = SWIPE[i].x + alpha * (next.x - SWIPE[i].x);
+        const float expectedY = SWIPE[i].y + alpha * (next.y - SWIPE[i].y);
+        totalError += hypotf(x - expectedX, y - expectedY);
+        count++;
+    }
+    return totalError / count;
+}
+
+TEST(TouchResamplerTest, DefaultStrategyIsLinear) {
+    TouchResampler resampler;
+    EXPECT_EQ(Strategy::LINEAR, resampler.getStrategy());
+    EXPECT_EQ(5 * NANOS_PER_MS, resampler.getLatency());
+}
+
+TEST(TouchResamplerTest, AccelerationPredictsUpToTheFrameTime) {
+    TouchResampler resampler(Strategy::ACCELERATION);
+    EXPECT_EQ(0, resampler.getLatency());
+    EXPECT_EQ(106 * NANOS_PER_MS, resampler.getMaxPredictionTime(100 * NANOS_PER_MS,
+                                                                 94 * NANOS_PER_MS));
+    // Still bounded for slow digitizers.
+    EXPECT_EQ(108 * NANOS_PER_MS, resampler.getMaxPredictionTime(100 * NANOS_PER_MS,
+                                                                 84 * NANOS_PER_MS));
+
+    TouchResampler linearResampler(Strategy::LINEAR);
+    EXPECT_EQ(103 * NANOS_PER_MS, linearResampler.getMaxPredictionTime(100 * NANOS_PER_MS,
+                                                                       94 * NANOS_PER_MS));
+}
+
+TEST(TouchResamplerTest, ConstantVelocity_StrategiesAgree) {
+    const Sample samples[] = {{20 * NANOS_PER_MS, 300, 150},
+                              {12 * NANOS_PER_MS, 200, 100},
+                              {4 * NANOS_PER_MS, 100, 50}};
+    for (Strategy strategy : {Strategy::LINEAR, Strategy::ACCELERATION}) {
+        TouchResampler resampler(strategy);
+        float x, y;
+        resampler.extrapolate(samples, 3, 24 * NANOS_PER_MS, &x, &y);
+        EXPECT_FLOAT_EQ(350, x);
+        EXPECT_FLOAT_EQ(175, y);
+    }
+}
+
+TEST(TouchResamplerTest, Acceleration_TwoSamples_IsLinear) {
+    const Sample samples[] = {{20 * NANOS_PER_MS, 300, 150}, {12 * NANOS_PER_MS, 200, 100}};
+    TouchResampler resampler(Strategy::ACCELERATION);
+    float x, y;
+    resampler.extrapolate(samples, 2, 24 * NANOS_PER_MS, &x, &y);
+    EXPECT_FLOAT_EQ(350, x);
+    EXPECT_FLOAT_EQ(175, y);
+}
+
+TEST(TouchResamplerTest, Acceleration_CorrectionIsBounded) {
+    // The pointer was still, then moved by 100 pixels in 8ms. The acceleration alone would
+    // predict it much further than the linear prediction does.
+    const Sample samples[] = {{20 * NANOS_PER_MS, 200, 100},
+                              {12 * NANOS_PER_MS, 100, 100},
+                              {4 * NANOS_PER_MS, 100, 100}};
+    TouchResampler resampler(Strategy::ACCELERATION);
+    float x, y;
+    resampler.extrapolate(samples, 3, 28 * NANOS_PER_MS, &x, &y);
+    // At most half of the 100 pixels that the linear prediction adds.
+    EXPECT_FLOAT_EQ(350, x);
+    EXPECT_FLOAT_EQ(100, y);
+}
+
+TEST(TouchResamplerTest, Swipe_AccelerationIsMoreAccurate) {
+    const float linearError = getMeanExtrapolationError(Strategy::LINEAR, 4 * NANOS_PER_MS);
+    const float accelerationError =
+            getMeanExtrapolationError(Strategy::ACCELERATION, 4 * NANOS_PER_MS);
+    EXPECT_LT(accelerationError, linearError / 2);
+}
+
+/*
+ * Guards against regressions of the prediction accuracy on the swipe, at the horizon of the
+ * linear strategy and at the longest one of the acceleration strategy. The bounds are a few
+ * percent above the errors measured when the strategies were introduced.
+ */
+TEST(TouchResamplerTest, Swipe_ErrorRegression) {
+    EXPECT_LT(getMeanExtrapolationError(Strategy::LINEAR, 4 * NANOS_PER_MS), 2.7f);
+    EXPECT_LT(getMeanExtrapolationError(Strategy::ACCELERATION, 4 * NANOS_PER_MS), 1.0f);
+    EXPECT_LT(getMeanExtrapolationError(Strategy::ACCELERATION, 8 * NANOS_PER_MS), 1.8f);
+}
+
+} // namespace android
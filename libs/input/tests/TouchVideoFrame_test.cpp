@@ -70,6 +70,24 @@ TEST(TouchVideoFrame, Equality) {
 
 // --- Rotate 90 degrees ---
 
+TEST(TouchVideoFrame, Copy_SharesData) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    TouchVideoFrame copy = frame;
+    ASSERT_EQ(frame, copy);
+    ASSERT_EQ(frame.getData().data(), copy.getData().data());
+}
+
+TEST(TouchVideoFrame, RotateCopy_DoesNotChangeOriginal) {
+    TouchVideoFrame frame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP);
+    for (int32_t orientation :
+         {DISPLAY_ORIENTATION_90, DISPLAY_ORIENTATION_180, DISPLAY_ORIENTATION_270}) {
+        TouchVideoFrame copy = frame;
+        copy.rotate(orientation);
+        ASSERT_EQ(frame, TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, TIMESTAMP));
+        ASSERT_FALSE(frame == copy);
+    }
+}
+
 TEST(TouchVideoFrame, Rotate90_0x0) {
     TouchVideoFrame frame(0, 0, {}, TIMESTAMP);
     TouchVideoFrame frameRotated(0, 0, {}, TIMESTAMP);
@@ -18,6 +18,8 @@
 
 #include <array>
 #include <chrono>
+#include <utility>
+#include <vector>
 #include <math.h>
 
 #include <android-base/stringprintf.h>
@@ -844,10 +846,8 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_ThreeFi
         { 272700us, {{1063, 1128}, {NAN, NAN}, {NAN, NAN}} },
     };
 
-    // Velocity should actually be zero, but we expect 0.016 here instead.
-    // This is close enough to zero, and is likely caused by division by a very small number.
-    computeAndCheckVelocity(VelocityTracker::Strategy::LSQ2, motions, AMOTION_EVENT_AXIS_X, -0.016);
-    computeAndCheckVelocity(VelocityTracker::Strategy::LSQ2, motions, AMOTION_EVENT_AXIS_Y, -0.016);
+    computeAndCheckVelocity(VelocityTracker::Strategy::LSQ2, motions, AMOTION_EVENT_AXIS_X, 0);
+    computeAndCheckVelocity(VelocityTracker::Strategy::LSQ2, motions, AMOTION_EVENT_AXIS_Y, 0);
     computeAndCheckVelocity(VelocityTracker::Strategy::IMPULSE, motions, AMOTION_EVENT_AXIS_X, 0);
     computeAndCheckVelocity(VelocityTracker::Strategy::IMPULSE, motions, AMOTION_EVENT_AXIS_Y, 0);
 }
@@ -964,4 +964,130 @@ TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_Parabol
     computeAndCheckQuadraticEstimate(motions, std::array<float, 3>({0, 0E3, 1E6}));
 }
 
+/**
+ * Reference implementation of the least squares fit, by QR decomposition of the Vandermonde
+ * matrix of the data points, which LeastSquaresVelocityTrackerStrategy used to solve its fits
+ * with. It is slower, but does not square the condition number of the problem like solving the
+ * normal equations does, so it checks that those are solved precisely enough.
+ */
+static bool solveLeastSquaresByQrDecomposition(const std::vector<float>& x,
+                                               const std::vector<float>& y,
+                                               const std::vector<float>& w, uint32_t n,
+                                               float* outB) {
+    const size_t m = x.size();
+
+    // Expand the X vector to a matrix A, pre-multiplied by the weights.
+    float a[n][m]; // column-major order
+    for (uint32_t h = 0; h < m; h++) {
+        a[0][h] = w[h];
+        for (uint32_t i = 1; i < n; i++) {
+            a[i][h] = a[i - 1][h] * x[h];
+        }
+    }
+
+    // Apply the Gram-Schmidt process to A to obtain its QR decomposition.
+    float q[n][m]; // orthonormal basis, column-major order
+    float r[n][n]; // upper triangular matrix, row-major order
+    for (uint32_t j = 0; j < n; j++) {
+        for (uint32_t h = 0; h < m; h++) {
+            q[j][h] = a[j][h];
+        }
+        for (uint32_t i = 0; i < j; i++) {
+            float dot = 0;
+            for (uint32_t h = 0; h < m; h++) {
+                dot += q[j][h] * q[i][h];
+            }
+            for (uint32_t h = 0; h < m; h++) {
+                q[j][h] -= dot * q[i][h];
+            }
+        }
+
+        float norm = 0;
+        for (uint32_t h = 0; h < m; h++) {
+            norm += q[j][h] * q[j][h];
+        }
+        norm = sqrtf(norm);
+        if (norm < 0.000001f) {
+            // vectors are linearly dependent or zero so no solution
+            return false;
+        }
+
+        for (uint32_t h = 0; h < m; h++) {
+            q[j][h] /= norm;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            r[j][i] = 0;
+            for (uint32_t h = 0; i >= j && h < m; h++) {
+                r[j][i] += q[j][h] * a[i][h];
+            }
+        }
+    }
+
+    // Solve R B = Qt W Y to find B.  This is easy because R is upper triangular.
+    // We just work from bottom-right to top-left calculating B's coefficients.
+    for (uint32_t i = n; i != 0;) {
+        i--;
+        outB[i] = 0;
+        for (uint32_t h = 0; h < m; h++) {
+            outB[i] += q[i][h] * y[h] * w[h];
+        }
+        for (uint32_t j = n - 1; j > i; j--) {
+            outB[i] -= r[i][j] * outB[j];
+        }
+        outB[i] /= r[i][i];
+    }
+    return true;
+}
+
+/*
+ * A fling sampled at irregular intervals, with some jitter, fitted by every unweighted least
+ * squares strategy. The estimators should match the ones the QR decomposition finds.
+ */
+TEST_F(VelocityTrackerTest, LeastSquaresVelocityTrackerStrategyEstimator_MatchesQrDecomposition) {
+    const std::vector<nsecs_t> eventTimes = {0,        8100000,  15900000, 24300000,
+                                             31800000, 40200000, 48900000, 56200000,
+                                             64800000, 72100000, 80700000, 88300000};
+    const std::vector<float> jitter = {0.3, -0.2, 0.1, -0.4, 0.2, 0, -0.1, 0.3, -0.3, 0.2, 0.1,
+                                       -0.2};
+    BitSet32 idBits;
+    idBits.markBit(DEFAULT_POINTER_ID);
+
+    // The fit is made against the time in seconds since the newest sample, newest first.
+    std::vector<float> time, x, y, w;
+    std::vector<std::vector<VelocityTracker::Position>> positions;
+    for (size_t i = 0; i < eventTimes.size(); i++) {
+        const float millis = eventTimes[i] * 0.000001f;
+        const float px = 100 + 2.4f * millis + 0.012f * millis * millis + jitter[i];
+        const float py = 800 - 1.6f * millis + 0.00004f * millis * millis * millis - jitter[i];
+        positions.push_back({{px, py}});
+        time.insert(time.begin(), (eventTimes[i] - eventTimes.back()) * 0.000000001f);
+        x.insert(x.begin(), px);
+        y.insert(y.begin(), py);
+        w.push_back(1);
+    }
+
+    for (const auto& [strategy, degree] :
+         std::vector<std::pair<VelocityTracker::Strategy, uint32_t>>{
+                 {VelocityTracker::Strategy::LSQ1, 1},
+                 {VelocityTracker::Strategy::LSQ2, 2},
+                 {VelocityTracker::Strategy::LSQ3, 3}}) {
+        VelocityTracker vt(strategy);
+        for (size_t i = 0; i < eventTimes.size(); i++) {
+            vt.addMovement(eventTimes[i], idBits, positions[i]);
+        }
+        VelocityTracker::Estimator estimator;
+        ASSERT_TRUE(vt.getEstimator(DEFAULT_POINTER_ID, &estimator));
+        ASSERT_EQ(degree, estimator.degree);
+
+        float xCoeff[degree + 1];
+        float yCoeff[degree + 1];
+        ASSERT_TRUE(solveLeastSquaresByQrDecomposition(time, x, w, degree + 1, xCoeff));
+        ASSERT_TRUE(solveLeastSquaresByQrDecomposition(time, y, w, degree + 1, yCoeff));
+        for (uint32_t i = 0; i <= degree; i++) {
+            EXPECT_NEAR_BY_FRACTION(estimator.xCoeff[i], xCoeff[i], 0.005);
+            EXPECT_NEAR_BY_FRACTION(estimator.yCoeff[i], yCoeff[i], 0.005);
+        }
+    }
+}
+
 } // namespace android
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * SIMD kernels for the float specializations of mat4. The kernel is chosen at
+ * compile time: NEON on ARM, SSE on x86, and the generic templates are used
+ * everywhere else.
+ *
+ * Don't use this file directly, instead include math/mat4.h
+ */
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MATH_SIMD_NEON 1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define MATH_SIMD_SSE 1
+#endif
+
+#if defined(MATH_SIMD_NEON) || defined(MATH_SIMD_SSE)
+#define MATH_HAS_SIMD 1
+#else
+#define MATH_HAS_SIMD 0
+#endif
+
+namespace android {
+namespace details {
+namespace simd {
+
+#if MATH_HAS_SIMD
+
+// All matrices are 16 floats in column-major order, vectors are 4 floats.
+// None of the pointers needs to be aligned, and out may alias v.
+
+#if defined(MATH_SIMD_NEON)
+
+struct Columns {
+    float32x4_t c0, c1, c2, c3;
+};
+
+inline Columns load(const float* m) {
+    return { vld1q_f32(m), vld1q_f32(m + 4), vld1q_f32(m + 8), vld1q_f32(m + 12) };
+}
+
+inline float32x4_t multiply(const Columns& m, float x, float y, float z, float w) {
+    float32x4_t r = vmulq_n_f32(m.c0, x);
+    r = vmlaq_n_f32(r, m.c1, y);
+    r = vmlaq_n_f32(r, m.c2, z);
+    return vmlaq_n_f32(r, m.c3, w);
+}
+
+inline void store(float* out, float32x4_t r) {
+    vst1q_f32(out, r);
+}
+
+inline void store2(float* out, float32x4_t r) {
+    vst1_f32(out, vget_low_f32(r));
+}
+
+#else // MATH_SIMD_SSE
+
+struct Columns {
+    __m128 c0, c1, c2, c3;
+};
+
+inline Columns load(const float* m) {
+    return { _mm_loadu_ps(m), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12) };
+}
+
+inline __m128 multiply(const Columns& m, float x, float y, float z, float w) {
+    __m128 r = _mm_mul_ps(m.c0, _mm_set1_ps(x));
+    r = _mm_add_ps(r, _mm_mul_ps(m.c1, _mm_set1_ps(y)));
+    r = _mm_add_ps(r, _mm_mul_ps(m.c2, _mm_set1_ps(z)));
+    return _mm_add_ps(r, _mm_mul_ps(m.c3, _mm_set1_ps(w)));
+}
+
+inline void store(float* out, __m128 r) {
+    _mm_storeu_ps(out, r);
+}
+
+inline void store2(float* out, __m128 r) {
+    _mm_storel_pi(reinterpret_cast<__m64*>(out), r);
+}
+
+#endif
+
+// out = m * v
+inline void multiplyVector(const float* m, const float* v, float* out) {
+    const Columns c = load(m);
+    store(out, multiply(c, v[0], v[1], v[2], v[3]));
+}
+
+// out = lhs * rhs
+inline void multiplyMatrix(const float* lhs, const float* rhs, float* out) {
+    const Columns c = load(lhs);
+    const float* r = rhs;
+    // the columns of rhs are read before out is written, so that out may alias rhs
+    auto r0 = multiply(c, r[0], r[1], r[2], r[3]);
+    auto r1 = multiply(c, r[4], r[5], r[6], r[7]);
+    auto r2 = multiply(c, r[8], r[9], r[10], r[11]);
+    auto r3 = multiply(c, r[12], r[13], r[14], r[15]);
+    store(out, r0);
+    store(out + 4, r1);
+    store(out + 8, r2);
+    store(out + 12, r3);
+}
+
+// out[i] = m * in[i] for count vec4s
+inline void transformVectors(const float* m, const float* in, float* out, size_t count) {
+    const Columns c = load(m);
+    for (size_t i = 0; i < count; i++, in += 4, out += 4) {
+        store(out, multiply(c, in[0], in[1], in[2], in[3]));
+    }
+}
+
+// out[i] = (m * vec4(in[i], 0, 1)).xy for count vec2s
+inline void transformPoints(const float* m, const float* in, float* out, size_t count) {
+    const Columns c = load(m);
+    for (size_t i = 0; i < count; i++, in += 2, out += 2) {
+        store2(out, multiply(c, in[0], in[1], 0.0f, 1.0f));
+    }
+}
+
+#endif // MATH_HAS_SIMD
+
+} // namespace simd
+} // namespace details
+} // namespace android
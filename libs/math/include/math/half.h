@@ -16,7 +16,9 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <functional>
 #include <iosfwd>
 #include <limits>
@@ -39,6 +41,12 @@
 #define CONSTEXPR
 #endif
 
+#if defined(__F16C__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
 /*
@@ -156,6 +164,117 @@ inline CONSTEXPR android::half operator"" _hf(long double v) {
     return android::half(android::half::binary, android::half::ftoh(static_cast<float>(v)).bits);
 }
 
+// ----------------------------------------------------------------------------------------
+// Bulk conversions
+// ----------------------------------------------------------------------------------------
+
+/*
+ * halfToFloat() and floatToHalf() convert whole buffers, with the F16C or NEON
+ * conversion instructions when the target has them. Unlike the conversions of
+ * the half class, they follow IEEE 754 on every target: rounding is to nearest
+ * even and denormals are kept.
+ */
+
+static_assert(sizeof(half) == sizeof(uint16_t), "half must be stored as its bits");
+
+namespace details {
+
+// scalar versions, see https://fgiesen.wordpress.com/2012/03/28/half-to-float-done-quic/
+inline float halfBitsToFloat(uint16_t h) noexcept {
+    constexpr uint32_t kShiftedExponent = 0x7c00 << 13;
+    constexpr float magic = 0x1p-14f;  // 113 << 23
+
+    uint32_t bits = (h & 0x7fffu) << 13;
+    const uint32_t exponent = bits & kShiftedExponent;
+    bits += (127 - 15) << 23;
+    if (exponent == kShiftedExponent) {  // inf or nan
+        bits += (128 - 16) << 23;
+    } else if (exponent == 0) {  // zero or denormal, let the FPU renormalize
+        bits += 1 << 23;
+        float v;
+        memcpy(&v, &bits, sizeof(v));
+        v -= magic;
+        memcpy(&bits, &v, sizeof(bits));
+    }
+    bits |= (h & 0x8000u) << 16;
+
+    float out;
+    memcpy(&out, &bits, sizeof(out));
+    return out;
+}
+
+inline uint16_t floatToHalfBits(float f) noexcept {
+    constexpr uint32_t kInfinity = 0xffu << 23;
+    constexpr uint32_t kHalfMax = (127 + 16) << 23;
+    constexpr uint32_t kDenormMagic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    const uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint32_t out;
+    if (bits >= kHalfMax) {  // inf or nan, nans become quiet nans
+        out = bits > kInfinity ? 0x7e00 : 0x7c00;
+    } else if (bits < (113u << 23)) {  // zero or denormal, let the FPU round
+        float v;
+        float magic;
+        memcpy(&v, &bits, sizeof(v));
+        memcpy(&magic, &kDenormMagic, sizeof(magic));
+        v += magic;
+        memcpy(&bits, &v, sizeof(bits));
+        out = bits - kDenormMagic;
+    } else {
+        const uint32_t mantissaOdd = (bits >> 13) & 1;
+        bits += ((15u - 127u) << 23) + 0xfff;
+        bits += mantissaOdd;
+        out = bits >> 13;
+    }
+    return static_cast<uint16_t>(out | (sign >> 16));
+}
+
+} // namespace details
+
+// out[i] = in[i] for count values, in and out must not overlap
+inline void halfToFloat(const half* in, float* out, size_t count) noexcept {
+    const uint16_t* src = reinterpret_cast<const uint16_t*>(in);
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        const float16x4_t h = vreinterpret_f16_u16(vld1_u16(src + i));
+        vst1q_f32(out + i, vcvt_f32_f16(h));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = details::halfBitsToFloat(src[i]);
+    }
+}
+
+// out[i] = in[i] for count values, in and out must not overlap
+inline void floatToHalf(const float* in, half* out, size_t count) noexcept {
+    uint16_t* dst = reinterpret_cast<uint16_t*>(out);
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8) {
+        const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+#elif defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        const float16x4_t h = vcvt_f16_f32(vld1q_f32(in + i));
+        vst1_u16(dst + i, vreinterpret_u16_f16(h));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = details::floatToHalfBits(in[i]);
+    }
+}
+
 } // namespace android
 
 namespace std {
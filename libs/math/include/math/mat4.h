@@ -19,6 +19,7 @@
 #include <math/mat3.h>
 #include <math/quat.h>
 #include <math/TMatHelpers.h>
+#include <math/TMatSimd.h>
 #include <math/vec3.h>
 #include <math/vec4.h>
 
@@ -530,6 +531,32 @@ CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, con
     return result;
 }
 
+// float matrix * column-vector, uses the SIMD kernel when there is one
+inline TVec4<float> PURE operator *(const TMat44<float>& lhs, const TVec4<float>& rhs) {
+#if MATH_HAS_SIMD
+    TVec4<float> result(TVec4<float>::NO_INIT);
+    simd::multiplyVector(lhs.asArray(), &rhs[0], &result[0]);
+    return result;
+#else
+    TVec4<float> result;
+    for (size_t col = 0; col < TMat44<float>::NUM_COLS; ++col) {
+        result += lhs[col] * rhs[col];
+    }
+    return result;
+#endif
+}
+
+// float matrix * matrix, uses the SIMD kernel when there is one
+inline TMat44<float> PURE operator *(const TMat44<float>& lhs, const TMat44<float>& rhs) {
+#if MATH_HAS_SIMD
+    TMat44<float> result(TMat44<float>::NO_INIT);
+    simd::multiplyMatrix(lhs.asArray(), rhs.asArray(), &result[0][0]);
+    return result;
+#else
+    return matrix::multiply<TMat44<float>>(lhs, rhs);
+#endif
+}
+
 // mat44 * vec3, result is vec3( mat44 * {vec3, 1} )
 template <typename T, typename U>
 CONSTEXPR typename TMat44<T>::col_type PURE operator *(const TMat44<T>& lhs, const TVec3<U>& rhs) {
@@ -561,6 +588,44 @@ operator *(U lhs, const TMat44<T>& rhs) {
     return rhs * lhs;
 }
 
+// ----------------------------------------------------------------------------------------
+// Batch transforms
+// ----------------------------------------------------------------------------------------
+
+/* These apply the same matrix to count vectors, in may be the same array as out.
+ * The float versions keep the matrix in SIMD registers for the whole batch.
+ */
+
+// out[i] = m * in[i]
+template <typename T>
+void transformVectors(const TMat44<T>& m, const TVec4<T>* in, TVec4<T>* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = m * in[i];
+    }
+}
+
+// out[i] = (m * {in[i], 0, 1}).xy, the points are not divided by w
+template <typename T>
+void transformPoints(const TMat44<T>& m, const TVec2<T>* in, TVec2<T>* out, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = (m * TVec4<T>(in[i], 0, 1)).xy;
+    }
+}
+
+#if MATH_HAS_SIMD
+inline void transformVectors(const TMat44<float>& m, const TVec4<float>* in, TVec4<float>* out,
+                             size_t count) {
+    simd::transformVectors(m.asArray(), reinterpret_cast<const float*>(in),
+                           reinterpret_cast<float*>(out), count);
+}
+
+inline void transformPoints(const TMat44<float>& m, const TVec2<float>* in, TVec2<float>* out,
+                            size_t count) {
+    simd::transformPoints(m.asArray(), reinterpret_cast<const float*>(in),
+                          reinterpret_cast<float*>(out), count);
+}
+#endif
+
 // ----------------------------------------------------------------------------------------
 
 /* FIXME: this should go into TMatSquareFunctions<> but for some reason
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <math/half.h>
+
+namespace android {
+
+namespace {
+
+// an RGBA_FP16 buffer, in number of channels
+constexpr size_t kSmallBuffer = 256 * 256 * 4;
+constexpr size_t kLargeBuffer = 1080 * 2340 * 4;
+
+std::vector<float> makeFloats(size_t count) {
+    std::default_random_engine generator(42);
+    std::uniform_real_distribution<float> distribution(0.0f, 4.0f);
+    std::vector<float> floats(count);
+    for (float& f : floats) {
+        f = distribution(generator);
+    }
+    return floats;
+}
+
+void BM_HalfToFloat_Scalar(benchmark::State& state) {
+    const std::vector<float> floats = makeFloats(state.range(0));
+    std::vector<half> halfs(floats.begin(), floats.end());
+    std::vector<float> out(floats.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < halfs.size(); i++) {
+            out[i] = halfs[i];
+        }
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * halfs.size() * sizeof(half));
+}
+BENCHMARK(BM_HalfToFloat_Scalar)->Arg(kSmallBuffer)->Arg(kLargeBuffer);
+
+void BM_HalfToFloat_Bulk(benchmark::State& state) {
+    const std::vector<float> floats = makeFloats(state.range(0));
+    std::vector<half> halfs(floats.begin(), floats.end());
+    std::vector<float> out(floats.size());
+    for (auto _ : state) {
+        halfToFloat(halfs.data(), out.data(), halfs.size());
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * halfs.size() * sizeof(half));
+}
+BENCHMARK(BM_HalfToFloat_Bulk)->Arg(kSmallBuffer)->Arg(kLargeBuffer);
+
+void BM_FloatToHalf_Scalar(benchmark::State& state) {
+    const std::vector<float> floats = makeFloats(state.range(0));
+    std::vector<half> out(floats.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < floats.size(); i++) {
+            out[i] = floats[i];
+        }
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * floats.size() * sizeof(float));
+}
+BENCHMARK(BM_FloatToHalf_Scalar)->Arg(kSmallBuffer)->Arg(kLargeBuffer);
+
+void BM_FloatToHalf_Bulk(benchmark::State& state) {
+    const std::vector<float> floats = makeFloats(state.range(0));
+    std::vector<half> out(floats.size());
+    for (auto _ : state) {
+        floatToHalf(floats.data(), out.data(), floats.size());
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * floats.size() * sizeof(float));
+}
+BENCHMARK(BM_FloatToHalf_Bulk)->Arg(kSmallBuffer)->Arg(kLargeBuffer);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
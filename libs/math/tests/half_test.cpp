@@ -18,6 +18,10 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
 
 #include <math/half.h>
 #include <math/vec4.h>
@@ -103,4 +107,74 @@ TEST_F(HalfTest, Hash) {
     EXPECT_NE(std::hash<half4>{}(h4a), std::hash<half4>{}(h4b));
 }
 
+TEST_F(HalfTest, BulkHalfToFloat) {
+    // every half, the count isn't a multiple of the vector width to cover the tail
+    std::vector<uint16_t> bits(0x10000 + 3);
+    for (size_t i = 0; i < bits.size(); i++) {
+        bits[i] = static_cast<uint16_t>(i);
+    }
+    std::vector<float> floats(bits.size());
+    halfToFloat(reinterpret_cast<const half*>(bits.data()), floats.data(), bits.size());
+
+    for (size_t i = 0; i < bits.size(); i++) {
+        const float expected = details::halfBitsToFloat(bits[i]);
+        if (isnan(expected)) {
+            EXPECT_TRUE(isnan(floats[i])) << std::hex << bits[i];
+        } else {
+            uint32_t expectedBits, actualBits;
+            memcpy(&expectedBits, &expected, sizeof(expected));
+            memcpy(&actualBits, &floats[i], sizeof(floats[i]));
+            EXPECT_EQ(expectedBits, actualBits) << std::hex << bits[i];
+        }
+    }
+
+    EXPECT_EQ(1.0f, details::halfBitsToFloat(0x3c00));
+    EXPECT_EQ(-2.0f, details::halfBitsToFloat(0xc000));
+    EXPECT_EQ(65504.0f, details::halfBitsToFloat(0x7bff));
+    EXPECT_EQ(0x1p-24f, details::halfBitsToFloat(0x0001));
+    EXPECT_EQ(-0x1p-14f, details::halfBitsToFloat(0x8400));
+    EXPECT_TRUE(isinf(details::halfBitsToFloat(0x7c00)));
+}
+
+TEST_F(HalfTest, BulkFloatToHalf) {
+    // every half round trips
+    std::vector<float> floats;
+    for (uint32_t i = 0; i < 0x10000; i++) {
+        const float f = details::halfBitsToFloat(static_cast<uint16_t>(i));
+        if (!isnan(f)) {
+            floats.push_back(f);
+        }
+    }
+    std::vector<uint16_t> bits(floats.size());
+    floatToHalf(floats.data(), reinterpret_cast<half*>(bits.data()), floats.size());
+    for (size_t i = 0; i < floats.size(); i++) {
+        EXPECT_EQ(details::floatToHalfBits(floats[i]), bits[i]);
+        EXPECT_EQ(floats[i], details::halfBitsToFloat(bits[i]));
+    }
+
+    // rounding agrees with the scalar version
+    std::default_random_engine generator(1234);
+    std::uniform_real_distribution<float> distribution(-70000.0f, 70000.0f);
+    floats.resize(1001);
+    for (float& f : floats) {
+        f = distribution(generator) / (1 << (generator() % 32));
+    }
+    bits.resize(floats.size());
+    floatToHalf(floats.data(), reinterpret_cast<half*>(bits.data()), floats.size());
+    for (size_t i = 0; i < floats.size(); i++) {
+        EXPECT_EQ(details::floatToHalfBits(floats[i]), bits[i]) << floats[i];
+    }
+
+    // round to nearest even, overflow and denormals
+    EXPECT_EQ(0x3c00, details::floatToHalfBits(1.0f + 0x1p-11f));
+    EXPECT_EQ(0x3c02, details::floatToHalfBits(1.0f + 3 * 0x1p-11f));
+    EXPECT_EQ(0x7bff, details::floatToHalfBits(65519.0f));
+    EXPECT_EQ(0x7c00, details::floatToHalfBits(65520.0f));
+    EXPECT_EQ(0xfc00, details::floatToHalfBits(-1e9f));
+    EXPECT_EQ(0x0001, details::floatToHalfBits(0x1p-24f));
+    EXPECT_EQ(0x0000, details::floatToHalfBits(0x1p-26f));
+    EXPECT_EQ(0x8000, details::floatToHalfBits(-0.0f));
+    EXPECT_EQ(0x7e00, details::floatToHalfBits(NAN));
+}
+
 }; // namespace android
@@ -163,6 +163,67 @@ TEST_F(MatTest, ElementAccess) {
     EXPECT_FLOAT_EQ(m(3, 2), 100);
 }
 
+TEST_F(MatTest, FloatProducts) {
+    std::default_random_engine generator(82828);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; i++) {
+        mat4 a, b;
+        mat4d ad, bd;
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                ad[c][r] = a[c][r] = rand_gen();
+                bd[c][r] = b[c][r] = rand_gen();
+            }
+        }
+        const vec4 v(rand_gen(), rand_gen(), rand_gen(), rand_gen());
+        const double4 vd(v);
+
+        const mat4 product = a * b;
+        const mat4d productd = ad * bd;
+        const vec4 transformed = a * v;
+        const double4 transformedd = ad * vd;
+        mat4 inplace(a);
+        inplace *= b;
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                EXPECT_NEAR(productd[c][r], product[c][r], 1e-3);
+                EXPECT_NEAR(productd[c][r], inplace[c][r], 1e-3);
+            }
+            EXPECT_NEAR(transformedd[c], transformed[c], 1e-3);
+        }
+    }
+}
+
+TEST_F(MatTest, BatchTransforms) {
+    const mat4 m(vec4(0, 2, 0, 0), vec4(-3, 0, 0, 0), vec4(0, 0, 1, 0), vec4(10, 20, 0, 1));
+
+    vec4 vectors[7];
+    vec2 points[7];
+    for (size_t i = 0; i < 7; i++) {
+        vectors[i] = vec4(i, i + 1, i + 2, 1);
+        points[i] = vec2(i, -float(i));
+    }
+    vec4 transformedVectors[7];
+    transformVectors(m, vectors, transformedVectors, 7);
+    for (size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(m * vectors[i], transformedVectors[i]);
+    }
+
+    // in place
+    transformPoints(m, points, points, 7);
+    for (size_t i = 0; i < 7; i++) {
+        EXPECT_EQ(vec2(10 + 3.0f * i, 20 + 2.0f * i), points[i]);
+    }
+
+    const mat4d md(m);
+    double2 pointsd[2] = {double2(1, 1), double2(2, 2)};
+    transformPoints(md, pointsd, pointsd, 2);
+    EXPECT_EQ(double2(7, 22), pointsd[0]);
+    EXPECT_EQ(double2(4, 24), pointsd[1]);
+}
+
 //------------------------------------------------------------------------------
 // MAT 3
 //------------------------------------------------------------------------------
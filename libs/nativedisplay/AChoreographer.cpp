@@ -27,6 +27,7 @@
 #include <utils/Timers.h>
 
 #include <cinttypes>
+#include <limits>
 #include <mutex>
 #include <optional>
 #include <queue>
@@ -145,11 +146,20 @@ private:
                                     std::vector<FrameRateOverride> overrides) override;
 
     void scheduleCallbacks();
+    // Arms the looper message that schedules a vsync for delayed callbacks at dueTime, unless one
+    // is already armed for an earlier time. Only one such message is kept, for the earliest
+    // delayed callback, so that posting many of them doesn't wake up the looper for each.
+    // Must be called with mLock held.
+    void scheduleWakeupLocked(nsecs_t dueTime);
+    void cancelWakeupLocked();
+
+    static constexpr nsecs_t NO_WAKEUP = std::numeric_limits<nsecs_t>::max();
 
     std::mutex mLock;
     // Protected by mLock
     std::priority_queue<FrameCallback> mFrameCallbacks;
     std::vector<RefreshRateCallback> mRefreshRateCallbacks;
+    nsecs_t mWakeupTime = NO_WAKEUP;
 
     nsecs_t mLatestVsyncPeriod = -1;
     VsyncEventData mLastVsyncEventData;
@@ -167,6 +177,8 @@ Choreographer* Choreographer::getForThread() {
             return nullptr;
         }
         gChoreographer = new Choreographer(looper);
+        // Falls back to reading vsyncs from the event queue if this fails.
+        gChoreographer->useVsyncRing();
         status_t result = gChoreographer->initialize();
         if (result != OK) {
             ALOGW("Failed to initialize");
@@ -218,6 +230,9 @@ void Choreographer::postFrameCallbackDelayed(
     {
         std::lock_guard<std::mutex> _l{mLock};
         mFrameCallbacks.push(callback);
+        if (callback.dueTime > now) {
+            scheduleWakeupLocked(callback.dueTime);
+        }
     }
     if (callback.dueTime <= now) {
         if (std::this_thread::get_id() != mThreadId) {
@@ -230,13 +245,8 @@ void Choreographer::postFrameCallbackDelayed(
         } else {
             scheduleVsync();
         }
-    } else {
-        if (mLooper != nullptr) {
-            Message m{MSG_SCHEDULE_CALLBACKS};
-            mLooper->sendMessageDelayed(delay, this, m);
-        } else {
-            scheduleCallbacks();
-        }
+    } else if (mLooper == nullptr) {
+        scheduleCallbacks();
     }
 }
 
@@ -317,18 +327,40 @@ void Choreographer::scheduleCallbacks() {
     nsecs_t dueTime;
     {
         std::lock_guard<std::mutex> _l{mLock};
+        // This is either the armed wakeup firing or a direct call, so nothing is armed anymore.
+        mWakeupTime = NO_WAKEUP;
         // If there are no pending callbacks then don't schedule a vsync
         if (mFrameCallbacks.empty()) {
             return;
         }
         dueTime = mFrameCallbacks.top().dueTime;
+        if (dueTime > now) {
+            scheduleWakeupLocked(dueTime);
+            return;
+        }
     }
 
-    if (dueTime <= now) {
-        ALOGV("choreographer %p ~ scheduling vsync", this);
-        scheduleVsync();
+    ALOGV("choreographer %p ~ scheduling vsync", this);
+    scheduleVsync();
+}
+
+void Choreographer::scheduleWakeupLocked(nsecs_t dueTime) {
+    if (mLooper == nullptr || dueTime >= mWakeupTime) {
         return;
     }
+    if (mWakeupTime != NO_WAKEUP) {
+        mLooper->removeMessages(this, MSG_SCHEDULE_CALLBACKS);
+    }
+    mWakeupTime = dueTime;
+    Message m{MSG_SCHEDULE_CALLBACKS};
+    mLooper->sendMessageAtTime(dueTime, this, m);
+}
+
+void Choreographer::cancelWakeupLocked() {
+    if (mLooper != nullptr && mWakeupTime != NO_WAKEUP) {
+        mLooper->removeMessages(this, MSG_SCHEDULE_CALLBACKS);
+    }
+    mWakeupTime = NO_WAKEUP;
 }
 
 void Choreographer::handleRefreshRateUpdates() {
@@ -359,6 +391,7 @@ void Choreographer::handleRefreshRateUpdates() {
 void Choreographer::dispatchVsync(nsecs_t timestamp, PhysicalDisplayId, uint32_t,
                                   VsyncEventData vsyncEventData) {
     std::vector<FrameCallback> callbacks{};
+    bool dueByNextVsync = false;
     {
         std::lock_guard<std::mutex> _l{mLock};
         nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
@@ -366,6 +399,22 @@ void Choreographer::dispatchVsync(nsecs_t timestamp, PhysicalDisplayId, uint32_t
             callbacks.push_back(mFrameCallbacks.top());
             mFrameCallbacks.pop();
         }
+        // A delayed callback that becomes due before the next vsync would otherwise wake up the
+        // looper once at its due time, only to request that vsync. Request it right away instead.
+        if (!mFrameCallbacks.empty()) {
+            const nsecs_t dueTime = mFrameCallbacks.top().dueTime;
+            if (vsyncEventData.frameInterval > 0 &&
+                dueTime <= now + vsyncEventData.frameInterval) {
+                cancelWakeupLocked();
+                dueByNextVsync = true;
+            } else {
+                // The wakeup may have been canceled by an earlier vsync.
+                scheduleWakeupLocked(dueTime);
+            }
+        }
+    }
+    if (dueByNextVsync) {
+        scheduleVsync();
     }
     mLastVsyncEventData = vsyncEventData;
     for (const auto& cb : callbacks) {
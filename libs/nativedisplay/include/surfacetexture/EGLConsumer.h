@@ -22,6 +22,9 @@
 #include <ui/FenceTime.h>
 #include <ui/GraphicBuffer.h>
 #include <utils/Mutex.h>
+#include <utils/String8.h>
+
+#include <vector>
 
 namespace android {
 
@@ -111,6 +114,11 @@ public:
      */
     void onAbandonLocked();
 
+    /**
+     * dumpLocked appends the EGLImage creation counters to result.
+     */
+    void dumpLocked(String8& result, const char* prefix) const;
+
 protected:
     struct PendingRelease {
         PendingRelease()
@@ -169,9 +177,21 @@ protected:
 
         /**
          * createIfNeeded creates an EGLImage if required (we haven't created
-         * one yet, or the EGLDisplay or crop-rect has changed).
+         * one yet, or the EGLDisplay has changed). If outCreated is not null,
+         * it is set to whether a new EGLImage was created.
          */
-        status_t createIfNeeded(EGLDisplay display, bool forceCreate = false);
+        status_t createIfNeeded(EGLDisplay display, bool forceCreate = false,
+                                bool* outCreated = nullptr);
+
+        /**
+         * setGraphicBuffer makes this image track graphicBuffer, another
+         * GraphicBuffer object for the allocation the image was made for, as
+         * when the allocation is attached again to the BufferQueue. The
+         * EGLImage is kept.
+         */
+        void setGraphicBuffer(const sp<GraphicBuffer>& graphicBuffer);
+
+        bool hasEglImage() const { return mEglImage != EGL_NO_IMAGE_KHR; }
 
         /**
          * This calls glEGLImageTargetTexture2DOES to bind the image to the
@@ -205,11 +225,23 @@ protected:
         // mEGLDisplay is the EGLDisplay that was used to create mEglImage.
         EGLDisplay mEglDisplay;
 
-        // mCropRect is the crop rectangle passed to EGL when mEglImage
-        // was created.
-        Rect mCropRect;
+        // mImageBuffer is the buffer mEglImage was created from. It differs
+        // from mGraphicBuffer after setGraphicBuffer, and is kept as long as
+        // mEglImage so that its handle outlives the image.
+        sp<GraphicBuffer> mImageBuffer;
     };
 
+    /**
+     * takeImageLocked returns an EglImage for graphicBuffer, reusing a
+     * retained one of the same allocation if there is one.
+     */
+    sp<EglImage> takeImageLocked(const sp<GraphicBuffer>& graphicBuffer);
+
+    /**
+     * noteImageCreatedLocked updates the EGLImage creation counters.
+     */
+    void noteImageCreatedLocked();
+
     /**
      * doGLFenceWaitLocked inserts a wait command into the OpenGL ES command
      * stream to ensure that it is safe for future OpenGL ES commands to
@@ -304,6 +336,31 @@ protected:
      */
     static sp<GraphicBuffer> sReleasedTexImageBuffer;
     sp<EglImage> mReleasedTexImage;
+
+    /**
+     * mRetainedImages keeps the images of the most recently freed slots, most
+     * recent first. A producer that cycles its buffers through attachBuffer
+     * and detachBuffer frees a slot on every frame, and then gets the same
+     * allocation back in a slot, whose image is reused from here instead of
+     * creating a new EGLImage. Images that aren't reused within
+     * kRetainedImageMaxAge acquires are dropped, so that buffers the producer
+     * got rid of aren't kept alive.
+     */
+    struct RetainedImage {
+        sp<EglImage> image;
+        uint64_t acquireCount;
+    };
+    static constexpr size_t kMaxRetainedImages = 8;
+    static constexpr uint64_t kRetainedImageMaxAge = 64;
+    std::vector<RetainedImage> mRetainedImages;
+    uint64_t mAcquireCount = 0;
+
+    // EGLImage creation counters, reported by dumpLocked.
+    uint64_t mImageCreations = 0;
+    uint64_t mImageReuses = 0;
+    nsecs_t mImageCreationWindowStart = 0;
+    uint32_t mImageCreationsInWindow = 0;
+    uint32_t mImageCreationsLastWindow = 0;
 };
 
 } // namespace android
@@ -30,8 +30,11 @@
 #include <private/gui/SyncFeatures.h>
 #include <utils/Log.h>
 #include <utils/String8.h>
+#include <utils/Timers.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
+
 #define PROT_CONTENT_EXT_STR "EGL_EXT_protected_content"
 #define EGL_PROTECTED_CONTENT_EXT 0x32C0
 
@@ -216,9 +219,62 @@ void EGLConsumer::onAcquireBufferLocked(BufferItem* item, SurfaceTexture& st) {
     // before, so any prior EglImage created is using a stale buffer. This
     // replaces any old EglImage with a new one (using the new buffer).
     int slot = item->mSlot;
+    mAcquireCount++;
     if (item->mGraphicBuffer != nullptr || mEglSlots[slot].mEglImage.get() == nullptr) {
-        mEglSlots[slot].mEglImage = new EglImage(st.mSlots[slot].mGraphicBuffer);
+        mEglSlots[slot].mEglImage = takeImageLocked(st.mSlots[slot].mGraphicBuffer);
+    }
+}
+
+sp<EGLConsumer::EglImage> EGLConsumer::takeImageLocked(const sp<GraphicBuffer>& graphicBuffer) {
+    mRetainedImages.erase(std::remove_if(mRetainedImages.begin(), mRetainedImages.end(),
+                                         [this](const RetainedImage& retained) {
+                                             return mAcquireCount - retained.acquireCount >
+                                                     kRetainedImageMaxAge;
+                                         }),
+                          mRetainedImages.end());
+    if (graphicBuffer != nullptr) {
+        // Buffer ids are unique to each allocation, across processes.
+        const uint64_t id = graphicBuffer->getId();
+        auto it = std::find_if(mRetainedImages.begin(), mRetainedImages.end(),
+                               [id](const RetainedImage& retained) {
+                                   return retained.image->graphicBuffer()->getId() == id;
+                               });
+        if (it != mRetainedImages.end()) {
+            sp<EglImage> image = it->image;
+            mRetainedImages.erase(it);
+            image->setGraphicBuffer(graphicBuffer);
+            mImageReuses++;
+            return image;
+        }
     }
+    return new EglImage(graphicBuffer);
+}
+
+void EGLConsumer::noteImageCreatedLocked() {
+    const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    mImageCreations++;
+    if (now - mImageCreationWindowStart >= s2ns(1)) {
+        // A window without creations after the last one doesn't count for it.
+        mImageCreationsLastWindow =
+                now - mImageCreationWindowStart < s2ns(2) ? mImageCreationsInWindow : 0;
+        mImageCreationWindowStart = now;
+        mImageCreationsInWindow = 0;
+    }
+    mImageCreationsInWindow++;
+}
+
+void EGLConsumer::dumpLocked(String8& result, const char* prefix) const {
+    const nsecs_t age = systemTime(SYSTEM_TIME_MONOTONIC) - mImageCreationWindowStart;
+    uint32_t perSecond = 0;
+    if (age < s2ns(1)) {
+        perSecond = mImageCreationsLastWindow;
+    } else if (age < s2ns(2)) {
+        perSecond = mImageCreationsInWindow;
+    }
+    result.appendFormat("%sEGLImages: created=%" PRIu64 " (%u/s) reused=%" PRIu64
+                        " retained=%zu\n",
+                        prefix, mImageCreations, perSecond, mImageReuses,
+                        mRetainedImages.size());
 }
 
 void EGLConsumer::onReleaseBufferLocked(int buf) {
@@ -250,7 +306,11 @@ status_t EGLConsumer::updateAndReleaseLocked(const BufferItem& item, PendingRele
     // ConsumerBase.
     // We may have to do this even when item.mGraphicBuffer == NULL (which
     // means the buffer was previously acquired).
-    err = mEglSlots[slot].mEglImage->createIfNeeded(mEglDisplay);
+    bool created = false;
+    err = mEglSlots[slot].mEglImage->createIfNeeded(mEglDisplay, false, &created);
+    if (created) {
+        noteImageCreatedLocked();
+    }
     if (err != NO_ERROR) {
         EGC_LOGW("updateAndRelease: unable to createImage on display=%p slot=%d", mEglDisplay,
                  slot);
@@ -338,7 +398,11 @@ status_t EGLConsumer::bindTextureImageLocked(SurfaceTexture& st) {
         return NO_INIT;
     }
 
-    status_t err = mCurrentTextureImage->createIfNeeded(mEglDisplay);
+    bool created = false;
+    status_t err = mCurrentTextureImage->createIfNeeded(mEglDisplay, false, &created);
+    if (created) {
+        noteImageCreatedLocked();
+    }
     if (err != NO_ERROR) {
         EGC_LOGW("bindTextureImage: can't create image on display=%p slot=%d", mEglDisplay,
                  st.mCurrentTexture);
@@ -352,7 +416,10 @@ status_t EGLConsumer::bindTextureImageLocked(SurfaceTexture& st) {
     // forcing the creation of a new image.
     if ((error = glGetError()) != GL_NO_ERROR) {
         glBindTexture(st.mTexTarget, st.mTexName);
-        status_t result = mCurrentTextureImage->createIfNeeded(mEglDisplay, true);
+        status_t result = mCurrentTextureImage->createIfNeeded(mEglDisplay, true, &created);
+        if (created) {
+            noteImageCreatedLocked();
+        }
         if (result != NO_ERROR) {
             EGC_LOGW("bindTextureImage: can't create image on display=%p slot=%d", mEglDisplay,
                      st.mCurrentTexture);
@@ -593,16 +660,28 @@ status_t EGLConsumer::doGLFenceWaitLocked(SurfaceTexture& st) const {
 }
 
 void EGLConsumer::onFreeBufferLocked(int slotIndex) {
-    mEglSlots[slotIndex].mEglImage.clear();
+    sp<EglImage>& image = mEglSlots[slotIndex].mEglImage;
+    if (image != nullptr && image->hasEglImage() && image->graphicBuffer() != nullptr) {
+        mRetainedImages.insert(mRetainedImages.begin(), RetainedImage{image, mAcquireCount});
+        if (mRetainedImages.size() > kMaxRetainedImages) {
+            mRetainedImages.pop_back();
+        }
+    }
+    image.clear();
 }
 
 void EGLConsumer::onAbandonLocked() {
     mCurrentTextureImage.clear();
+    mRetainedImages.clear();
 }
 
 EGLConsumer::EglImage::EglImage(sp<GraphicBuffer> graphicBuffer)
       : mGraphicBuffer(graphicBuffer), mEglImage(EGL_NO_IMAGE_KHR), mEglDisplay(EGL_NO_DISPLAY) {}
 
+void EGLConsumer::EglImage::setGraphicBuffer(const sp<GraphicBuffer>& graphicBuffer) {
+    mGraphicBuffer = graphicBuffer;
+}
+
 EGLConsumer::EglImage::~EglImage() {
     if (mEglImage != EGL_NO_IMAGE_KHR) {
         if (!eglDestroyImageKHR(mEglDisplay, mEglImage)) {
@@ -612,7 +691,11 @@ EGLConsumer::EglImage::~EglImage() {
     }
 }
 
-status_t EGLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay, bool forceCreation) {
+status_t EGLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay, bool forceCreation,
+                                               bool* outCreated) {
+    if (outCreated != nullptr) {
+        *outCreated = false;
+    }
     // If there's an image and it's no longer valid, destroy it.
     bool haveImage = mEglImage != EGL_NO_IMAGE_KHR;
     bool displayInvalid = mEglDisplay != eglDisplay;
@@ -623,17 +706,23 @@ status_t EGLConsumer::EglImage::createIfNeeded(EGLDisplay eglDisplay, bool force
         eglTerminate(mEglDisplay);
         mEglImage = EGL_NO_IMAGE_KHR;
         mEglDisplay = EGL_NO_DISPLAY;
+        mImageBuffer.clear();
     }
 
     // If there's no image, create one.
     if (mEglImage == EGL_NO_IMAGE_KHR) {
         mEglDisplay = eglDisplay;
         mEglImage = createImage(mEglDisplay, mGraphicBuffer);
+        mImageBuffer = mGraphicBuffer;
+        if (outCreated != nullptr) {
+            *outCreated = true;
+        }
     }
 
     // Fail if we can't create a valid image.
     if (mEglImage == EGL_NO_IMAGE_KHR) {
         mEglDisplay = EGL_NO_DISPLAY;
+        mImageBuffer.clear();
         const sp<GraphicBuffer>& buffer = mGraphicBuffer;
         ALOGE("Failed to create image. size=%ux%u st=%u usage=%#" PRIx64 " fmt=%d",
               buffer->getWidth(), buffer->getHeight(), buffer->getStride(), buffer->getUsage(),
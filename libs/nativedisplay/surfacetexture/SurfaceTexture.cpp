@@ -445,8 +445,10 @@ void SurfaceTexture::freeBufferLocked(int slotIndex) {
 
 void SurfaceTexture::abandonLocked() {
     SFT_LOGV("abandonLocked");
-    mEGLConsumer.onAbandonLocked();
+    // ConsumerBase frees every slot, which retains their images in EGLConsumer, so they are
+    // dropped after that.
     ConsumerBase::abandonLocked();
+    mEGLConsumer.onAbandonLocked();
 }
 
 status_t SurfaceTexture::setConsumerUsageBits(uint64_t usage) {
@@ -459,6 +461,7 @@ void SurfaceTexture::dumpLocked(String8& result, const char* prefix) const {
                         prefix, mTexName, mCurrentTexture, prefix, mCurrentCrop.left,
                         mCurrentCrop.top, mCurrentCrop.right, mCurrentCrop.bottom,
                         mCurrentTransform);
+    mEGLConsumer.dumpLocked(result, prefix);
 
     ConsumerBase::dumpLocked(result, prefix);
 }
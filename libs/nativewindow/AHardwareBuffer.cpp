@@ -150,9 +150,6 @@ int AHardwareBuffer_lockAndGetInfo(AHardwareBuffer* buffer, uint64_t usage,
 
 int AHardwareBuffer_lock(AHardwareBuffer* buffer, uint64_t usage,
                          int32_t fence, const ARect* rect, void** outVirtualAddress) {
-    int32_t bytesPerPixel;
-    int32_t bytesPerStride;
-
     if (!buffer) return BAD_VALUE;
 
     if (usage & ~(AHARDWAREBUFFER_USAGE_CPU_READ_MASK |
@@ -177,7 +174,9 @@ int AHardwareBuffer_lock(AHardwareBuffer* buffer, uint64_t usage,
     } else {
         bounds.set(Rect(rect->left, rect->top, rect->right, rect->bottom));
     }
-    return gbuffer->lockAsync(usage, usage, bounds, outVirtualAddress, fence, &bytesPerPixel, &bytesPerStride);
+    // The bytes per pixel and per stride aren't returned from here, so don't have the mapper
+    // decode the plane layouts of the buffer for them on every lock.
+    return gbuffer->lockAsync(usage, usage, bounds, outVirtualAddress, fence);
 }
 
 int AHardwareBuffer_lockPlanes(AHardwareBuffer* buffer, uint64_t usage,
@@ -257,6 +257,7 @@ enum {
     NATIVE_WINDOW_SET_QUERY_INTERCEPTOR           = 47,    /* private */
     NATIVE_WINDOW_SET_FRAME_TIMELINE_INFO         = 48,    /* private */
     NATIVE_WINDOW_GET_LAST_QUEUED_BUFFER2         = 49,    /* private */
+    NATIVE_WINDOW_SET_DEQUEUE_AHEAD               = 50,    /* private */
     // clang-format on
 };
 
@@ -1031,6 +1032,18 @@ static inline int native_window_set_frame_timeline_info(struct ANativeWindow* wi
                            frameTimelineVsyncId, inputEventId);
 }
 
+/*
+ * native_window_set_dequeue_ahead(..., dequeueAhead)
+ * Enable/disable dequeueing the next buffer in the background as soon as a
+ * buffer is queued, so that the following dequeueBuffer call returns without
+ * waiting for the consumer. If the buffer size, format or usage change in
+ * between, the buffer dequeued ahead is returned and a new one is dequeued.
+ */
+static inline int native_window_set_dequeue_ahead(struct ANativeWindow* window,
+                                                  bool dequeueAhead) {
+    return window->perform(window, NATIVE_WINDOW_SET_DEQUEUE_AHEAD, dequeueAhead);
+}
+
 // ------------------------------------------------------------------------------------------------
 // Candidates for APEX visibility
 // These functions are planned to be made stable for APEX modules, but have not
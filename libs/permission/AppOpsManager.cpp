@@ -14,9 +14,13 @@
  * limitations under the License.
  */
 
+#include <map>
 #include <mutex>
+#include <set>
+#include <tuple>
 #include <binder/AppOpsManager.h>
 #include <binder/Binder.h>
+#include <binder/IAppOpsCallback.h>
 #include <binder/IServiceManager.h>
 
 #include <utils/SystemClock.h>
@@ -31,6 +35,93 @@
 
 namespace android {
 
+namespace {
+
+// How long a mode returned by the app ops service is reused for.
+constexpr int64_t kModeCacheLifetimeMs = 250;
+
+// Past this many entries, expired ones are pruned when a new one is added.
+constexpr size_t kModeCachePruneSize = 256;
+
+// Per-process cache of the modes returned by checkOp and noteOp. The cache watches the op and
+// package of each entry, and drops the entries of a package when the app ops service reports a
+// mode change for it. Modes also depend on state that isn't reported that way, such as whether
+// the uid is in the foreground, so entries expire after kModeCacheLifetimeMs as well.
+class ModeCache : public BnAppOpsCallback {
+public:
+    enum class Kind { CHECK, NOTE };
+    // Kind, op, uid, package and attribution tag of a call.
+    using Key = std::tuple<Kind, int32_t, int32_t, String16, std::optional<String16>>;
+
+    std::optional<int32_t> get(const Key& key) {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mModes.find(key);
+        if (it == mModes.end()) {
+            return std::nullopt;
+        }
+        if (uptimeMillis() - it->second.time >= kModeCacheLifetimeMs) {
+            mModes.erase(it);
+            return std::nullopt;
+        }
+        return it->second.mode;
+    }
+
+    void put(const sp<IAppOpsService>& service, const Key& key, int32_t mode) {
+        const int32_t op = std::get<1>(key);
+        const String16& packageName = std::get<3>(key);
+        bool watch;
+        {
+            std::lock_guard<std::mutex> lock(mLock);
+            const int64_t now = uptimeMillis();
+            sp<IBinder> binder = IInterface::asBinder(service);
+            if (binder != mWatchedService) {
+                // Watches don't outlive the service they were registered with.
+                mModes.clear();
+                mWatched.clear();
+                mWatchedService = binder;
+            }
+            if (mModes.size() >= kModeCachePruneSize) {
+                for (auto it = mModes.begin(); it != mModes.end();) {
+                    it = now - it->second.time >= kModeCacheLifetimeMs ? mModes.erase(it)
+                                                                       : std::next(it);
+                }
+            }
+            mModes[key] = {mode, now};
+            watch = mWatched.emplace(op, packageName).second;
+        }
+        if (watch) {
+            service->startWatchingMode(op, packageName, this);
+        }
+    }
+
+    void opChanged(int32_t, const String16& packageName) override {
+        // The service reports the switch op of the changed op, which may not be the op that was
+        // cached, so every entry of the package is dropped.
+        std::lock_guard<std::mutex> lock(mLock);
+        for (auto it = mModes.begin(); it != mModes.end();) {
+            it = std::get<3>(it->first) == packageName ? mModes.erase(it) : std::next(it);
+        }
+    }
+
+private:
+    struct CachedMode {
+        int32_t mode;
+        int64_t time;
+    };
+
+    std::mutex mLock;
+    std::map<Key, CachedMode> mModes;
+    std::set<std::pair<int32_t, String16>> mWatched;
+    sp<IBinder> mWatchedService;
+};
+
+const sp<ModeCache>& getModeCache() {
+    static const sp<ModeCache> gModeCache = sp<ModeCache>::make();
+    return gModeCache;
+}
+
+} // namespace
+
 static const sp<IBinder>& getClientId() {
     static pthread_mutex_t gClientIdMutex = PTHREAD_MUTEX_INITIALIZER;
     static sp<IBinder> gClientId;
@@ -77,10 +168,17 @@ sp<IAppOpsService> AppOpsManager::getService()
 
 int32_t AppOpsManager::checkOp(int32_t op, int32_t uid, const String16& callingPackage)
 {
+    const ModeCache::Key key{ModeCache::Kind::CHECK, op, uid, callingPackage, std::nullopt};
+    if (std::optional<int32_t> mode = getModeCache()->get(key)) {
+        return *mode;
+    }
     sp<IAppOpsService> service = getService();
-    return service != nullptr
-            ? service->checkOperation(op, uid, callingPackage)
-            : AppOpsManager::MODE_IGNORED;
+    if (service == nullptr) {
+        return AppOpsManager::MODE_IGNORED;
+    }
+    int32_t mode = service->checkOperation(op, uid, callingPackage);
+    getModeCache()->put(service, key, mode);
+    return mode;
 }
 
 int32_t AppOpsManager::checkAudioOpNoThrow(int32_t op, int32_t usage, int32_t uid,
@@ -99,10 +197,24 @@ int32_t AppOpsManager::noteOp(int32_t op, int32_t uid, const String16& callingPa
 int32_t AppOpsManager::noteOp(int32_t op, int32_t uid, const String16& callingPackage,
         const std::optional<String16>& attributionTag, const String16& message) {
     sp<IAppOpsService> service = getService();
-    int32_t mode = service != nullptr
-            ? service->noteOperation(op, uid, callingPackage, attributionTag,
-                    shouldCollectNotes(op), message, uid == AID_SYSTEM)
-            : AppOpsManager::MODE_IGNORED;
+    if (service == nullptr) {
+        return AppOpsManager::MODE_IGNORED;
+    }
+    const bool collectNotes = shouldCollectNotes(op);
+    // Repeated notes of the same access are coalesced over the lifetime of the cached mode: the
+    // service already recorded the access, only its count and time would change. Ops whose notes
+    // are collected are always reported, along with their message.
+    const ModeCache::Key key{ModeCache::Kind::NOTE, op, uid, callingPackage, attributionTag};
+    if (!collectNotes) {
+        if (std::optional<int32_t> mode = getModeCache()->get(key)) {
+            return *mode;
+        }
+    }
+    int32_t mode = service->noteOperation(op, uid, callingPackage, attributionTag, collectNotes,
+            message, uid == AID_SYSTEM);
+    if (!collectNotes) {
+        getModeCache()->put(service, key, mode);
+    }
 
     return mode;
 }
@@ -0,0 +1,219 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "PersistentCacheFile.h"
+
+#include <android-base/file.h>
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace android::renderengine {
+
+namespace {
+
+// FNV-1a, which is enough to tell a corrupt or truncated file apart.
+uint64_t hash(const void* data, size_t size) {
+    const auto* bytes = static_cast<const uint8_t*>(data);
+    uint64_t result = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; i++) {
+        result = (result ^ bytes[i]) * 0x100000001b3;
+    }
+    return result;
+}
+
+uint64_t hash(const std::string& string) {
+    return hash(string.data(), string.size());
+}
+
+template <typename T>
+void append(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+class Reader {
+public:
+    explicit Reader(const std::string& contents) : mContents(contents) {}
+
+    template <typename T>
+    bool read(T* value) {
+        if (remaining() < sizeof(T)) return false;
+        std::memcpy(value, mContents.data() + mOffset, sizeof(T));
+        mOffset += sizeof(T);
+        return true;
+    }
+
+    bool read(size_t size, std::string* value) {
+        if (remaining() < size) return false;
+        value->assign(mContents, mOffset, size);
+        mOffset += size;
+        return true;
+    }
+
+    const char* position() const { return mContents.data() + mOffset; }
+    size_t remaining() const { return mContents.size() - mOffset; }
+
+private:
+    const std::string& mContents;
+    size_t mOffset = 0;
+};
+
+} // namespace
+
+PersistentCacheFile::PersistentCacheFile(std::string path, uint32_t magic, uint32_t version,
+                                         std::function<Entries()> snapshot)
+      : mPath(std::move(path)), mMagic(magic), mVersion(version), mSnapshot(std::move(snapshot)) {
+    mThread = std::thread([this] { threadMain(); });
+}
+
+PersistentCacheFile::~PersistentCacheFile() {
+    {
+        std::lock_guard lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    mThread.join();
+}
+
+PersistentCacheFile::Entries PersistentCacheFile::read(const std::string& identity) {
+    ATRACE_CALL();
+
+    const uint64_t identityHash = hash(identity);
+    {
+        std::lock_guard lock(mMutex);
+        mIdentityHash = identityHash;
+    }
+
+    std::string contents;
+    if (!base::ReadFileToString(mPath, &contents)) {
+        ALOGI("No shader cache at %s", mPath.c_str());
+        return {};
+    }
+
+    Reader reader(contents);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t fileIdentityHash = 0;
+    uint64_t checksum = 0;
+    uint32_t entryCount = 0;
+    if (!reader.read(&magic) || !reader.read(&version) || !reader.read(&fileIdentityHash) ||
+        !reader.read(&checksum) || !reader.read(&entryCount) || magic != mMagic) {
+        ALOGW("Discarding shader cache at %s: bad header", mPath.c_str());
+        return {};
+    }
+    if (version != mVersion || fileIdentityHash != identityHash) {
+        ALOGI("Discarding shader cache at %s: written by another driver or version",
+              mPath.c_str());
+        return {};
+    }
+    if (hash(reader.position(), reader.remaining()) != checksum) {
+        ALOGW("Discarding shader cache at %s: bad checksum", mPath.c_str());
+        return {};
+    }
+
+    Entries entries;
+    for (uint32_t i = 0; i < entryCount; i++) {
+        uint32_t keySize = 0;
+        uint32_t valueSize = 0;
+        std::string key;
+        std::string value;
+        if (!reader.read(&keySize) || !reader.read(&valueSize) || !reader.read(keySize, &key) ||
+            !reader.read(valueSize, &value)) {
+            ALOGW("Discarding shader cache at %s: truncated", mPath.c_str());
+            return {};
+        }
+        entries.emplace(std::move(key), std::move(value));
+    }
+
+    ALOGI("Loaded %zu shaders (%zu bytes) from %s", entries.size(), contents.size(),
+          mPath.c_str());
+    return entries;
+}
+
+void PersistentCacheFile::scheduleWrite() {
+    {
+        std::lock_guard lock(mMutex);
+        mWritePending = true;
+        mWriteTime = std::chrono::steady_clock::now() + kWriteDelay;
+    }
+    mCondition.notify_one();
+}
+
+size_t PersistentCacheFile::getWriteCount() const {
+    std::lock_guard lock(mMutex);
+    return mWriteCount;
+}
+
+void PersistentCacheFile::write(const Entries& entries, uint64_t identityHash) {
+    ATRACE_CALL();
+
+    std::string payload;
+    for (const auto& [key, value] : entries) {
+        append(payload, static_cast<uint32_t>(key.size()));
+        append(payload, static_cast<uint32_t>(value.size()));
+        payload.append(key);
+        payload.append(value);
+    }
+
+    std::string contents;
+    append(contents, mMagic);
+    append(contents, mVersion);
+    append(contents, identityHash);
+    append(contents, hash(payload));
+    append(contents, static_cast<uint32_t>(entries.size()));
+    contents.append(payload);
+
+    // Write to a temporary file first, so that a crash while writing does not lose the cache.
+    const std::string tempPath = mPath + ".tmp";
+    if (!base::WriteStringToFile(contents, tempPath) ||
+        std::rename(tempPath.c_str(), mPath.c_str()) != 0) {
+        ALOGW("Failed to write shader cache to %s: %s", mPath.c_str(), strerror(errno));
+        std::remove(tempPath.c_str());
+    }
+}
+
+void PersistentCacheFile::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mMutex);
+    while (true) {
+        if (!mWritePending) {
+            if (!mRunning) break;
+            mCondition.wait(lock);
+            continue;
+        }
+        // Each request pushes the write back, until the compiles settle, unless the file is
+        // being destroyed.
+        if (mRunning && std::chrono::steady_clock::now() < mWriteTime) {
+            mCondition.wait_until(lock, mWriteTime);
+            continue;
+        }
+
+        mWritePending = false;
+        mWriteCount++;
+        const uint64_t identityHash = mIdentityHash;
+        lock.unlock();
+        write(mSnapshot(), identityHash);
+        lock.lock();
+    }
+}
+
+} // namespace android::renderengine
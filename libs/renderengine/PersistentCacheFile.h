@@ -0,0 +1,82 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace android::renderengine {
+
+// File that RenderEngine persists compiled shaders to, as blobs keyed by byte strings. The file
+// is versioned, checksummed, and tagged with the identity of the driver that compiled the
+// shaders, so that a file that is corrupt or out of date is discarded.
+//
+// Writes are deferred to a background thread until a few seconds after the last request, so
+// that bursts of compiles, as when priming the cache, are written once.
+class PersistentCacheFile {
+public:
+    using Entries = std::unordered_map<std::string, std::string>;
+
+    // The snapshot is called on the background thread to get the entries to write. The owner of
+    // the file must keep what the snapshot reads alive until the file is destroyed, which writes
+    // the entries if a write is still pending.
+    PersistentCacheFile(std::string path, uint32_t magic, uint32_t version,
+                        std::function<Entries()> snapshot);
+    ~PersistentCacheFile();
+
+    PersistentCacheFile(const PersistentCacheFile&) = delete;
+    PersistentCacheFile& operator=(const PersistentCacheFile&) = delete;
+
+    // Reads the entries, which are empty if the file is missing, corrupt, or was written for
+    // another identity, which is also the identity that later writes are tagged with.
+    Entries read(const std::string& identity);
+
+    void scheduleWrite();
+
+    const std::string& getPath() const { return mPath; }
+    size_t getWriteCount() const;
+
+private:
+    static constexpr std::chrono::seconds kWriteDelay{4};
+
+    void write(const Entries&, uint64_t identityHash);
+    void threadMain();
+
+    const std::string mPath;
+    const uint32_t mMagic;
+    const uint32_t mVersion;
+    const std::function<Entries()> mSnapshot;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    uint64_t mIdentityHash GUARDED_BY(mMutex) = 0;
+    bool mWritePending GUARDED_BY(mMutex) = false;
+    std::chrono::steady_clock::time_point mWriteTime GUARDED_BY(mMutex);
+    bool mRunning GUARDED_BY(mMutex) = true;
+    size_t mWriteCount GUARDED_BY(mMutex) = 0;
+    std::thread mThread;
+};
+
+} // namespace android::renderengine
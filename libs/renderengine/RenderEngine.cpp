@@ -17,15 +17,26 @@
 #include <renderengine/RenderEngine.h>
 
 #include <cutils/properties.h>
+#include <ftl/future.h>
 #include <log/log.h>
 #include "gl/GLESRenderEngine.h"
 #include "threaded/RenderEngineThreaded.h"
 
 #include "skia/SkiaGLRenderEngine.h"
+#include "skia/SkiaVkRenderEngine.h"
 
 namespace android {
 namespace renderengine {
 
+static std::unique_ptr<RenderEngine> createSkiaVkOrFallBackToSkiaGL(
+        const RenderEngineCreationArgs& args) {
+    if (std::unique_ptr<RenderEngine> engine = skia::SkiaVkRenderEngine::create(args)) {
+        return engine;
+    }
+    ALOGW("Vulkan is not supported, falling back to SkiaGL");
+    return skia::SkiaGLRenderEngine::create(args);
+}
+
 std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArgs& args) {
     RenderEngineType renderEngineType = args.renderEngineType;
 
@@ -44,6 +55,12 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
     if (strcmp(prop, "skiaglthreaded") == 0) {
         renderEngineType = RenderEngineType::SKIA_GL_THREADED;
     }
+    if (strcmp(prop, "skiavk") == 0) {
+        renderEngineType = RenderEngineType::SKIA_VK;
+    }
+    if (strcmp(prop, "skiavkthreaded") == 0) {
+        renderEngineType = RenderEngineType::SKIA_VK_THREADED;
+    }
 
     switch (renderEngineType) {
         case RenderEngineType::THREADED:
@@ -54,9 +71,13 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
         case RenderEngineType::SKIA_GL:
             ALOGD("RenderEngine with SkiaGL Backend");
             return renderengine::skia::SkiaGLRenderEngine::create(args);
-        case RenderEngineType::SKIA_GL_THREADED: {
+        case RenderEngineType::SKIA_VK:
+            ALOGD("RenderEngine with SkiaVk Backend");
+            return createSkiaVkOrFallBackToSkiaGL(args);
+        case RenderEngineType::SKIA_GL_THREADED:
+        case RenderEngineType::SKIA_VK_THREADED: {
             // These need to be recreated, since they are a constant reference, and we need to
-            // let SkiaRE know that it's running as threaded, and all GL operation will happen on
+            // let SkiaRE know that it's running as threaded, and all GPU operations will happen on
             // the same thread.
             RenderEngineCreationArgs skiaArgs =
                     RenderEngineCreationArgs::Builder()
@@ -68,7 +89,14 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
                             .setSupportsBackgroundBlur(args.supportsBackgroundBlur)
                             .setContextPriority(args.contextPriority)
                             .setRenderEngineType(renderEngineType)
+                            .setShaderCachePath(args.shaderCachePath)
                             .build();
+            if (renderEngineType == RenderEngineType::SKIA_VK_THREADED) {
+                ALOGD("Threaded RenderEngine with SkiaVk Backend");
+                return renderengine::threaded::RenderEngineThreaded::create(
+                        [skiaArgs]() { return createSkiaVkOrFallBackToSkiaGL(skiaArgs); },
+                        renderEngineType);
+            }
             ALOGD("Threaded RenderEngine with SkiaGL Backend");
             return renderengine::threaded::RenderEngineThreaded::create(
                     [skiaArgs]() {
@@ -85,6 +113,22 @@ std::unique_ptr<RenderEngine> RenderEngine::create(const RenderEngineCreationArg
 
 RenderEngine::~RenderEngine() = default;
 
+std::future<RenderEngine::DrawLayersResult> RenderEngine::drawLayersAsync(
+        const DisplaySettings& display, std::vector<LayerSettings> layers,
+        const std::shared_ptr<ExternalTexture>& buffer, const bool useFramebufferCache,
+        base::unique_fd&& bufferFence) {
+    std::vector<const LayerSettings*> layerPointers;
+    layerPointers.reserve(layers.size());
+    for (const LayerSettings& layer : layers) {
+        layerPointers.push_back(&layer);
+    }
+
+    DrawLayersResult result;
+    result.status = drawLayers(display, layerPointers, buffer, useFramebufferCache,
+                               std::move(bufferFence), &result.drawFence);
+    return ftl::yield(std::move(result));
+}
+
 void RenderEngine::validateInputBufferUsage(const sp<GraphicBuffer>& buffer) {
     LOG_ALWAYS_FATAL_IF(!(buffer->getUsage() & GraphicBuffer::USAGE_HW_TEXTURE),
                         "input buffer not gpu readable");
@@ -46,8 +46,8 @@
 #include "GLESRenderEngine.h"
 #include "GLExtensions.h"
 #include "GLFramebuffer.h"
+#include "GLGpuTimer.h"
 #include "GLImage.h"
-#include "GLShadowVertexGenerator.h"
 #include "Program.h"
 #include "ProgramCache.h"
 #include "filters/BlurFilter.h"
@@ -445,6 +445,22 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
         mFlushTracer = std::make_unique<FlushTracer>(this);
     }
 
+    // Program binaries are only valid for the driver that built them, which the build fingerprint
+    // covers for drivers updated along with the system. The file is kept apart from Skia's, which
+    // has its own layout.
+    const GLExtensions& extensions = GLExtensions::getInstance();
+    if (!args.shaderCachePath.empty() && extensions.hasProgramBinary()) {
+        char fingerprint[PROPERTY_VALUE_MAX];
+        property_get("ro.build.fingerprint", fingerprint, "");
+        property_get(PROPERTY_DEBUG_RENDERENGINE_LEARNED_PRIMING, value, "0");
+        ProgramCache::getInstance()
+                .setBinaryCacheFile(args.shaderCachePath + ".gl",
+                                    base::StringPrintf("%s/%s/%s/%s", extensions.getVendor(),
+                                                       extensions.getRenderer(),
+                                                       extensions.getVersion(), fingerprint),
+                                    atoi(value) != 0);
+    }
+
     if (args.supportsBackgroundBlur) {
         mBlurFilter = new BlurFilter(*this);
         checkErrors("BlurFilter creation");
@@ -472,11 +488,18 @@ GLESRenderEngine::GLESRenderEngine(const RenderEngineCreationArgs& args, EGLDisp
              eglGetError());
 
     mShadowTexture = std::make_unique<GLShadowTexture>();
+
+    property_get(PROPERTY_DEBUG_RENDERENGINE_GPU_TIMING, value, "0");
+    if (atoi(value)) {
+        mGpuTimer = GLGpuTimer::create();
+        ALOGW_IF(!mGpuTimer, "GPU timing requested, but timestamp queries are not supported");
+    }
 }
 
 GLESRenderEngine::~GLESRenderEngine() {
     // Destroy the image manager first.
     mImageManager = nullptr;
+    mGpuTimer = nullptr;
     mShadowTexture = nullptr;
     cleanFramebufferCache();
     ProgramCache::getInstance().purgeCaches();
@@ -760,7 +783,11 @@ std::shared_ptr<ImageManager::Barrier> GLESRenderEngine::cacheExternalTextureBuf
     return barrier;
 }
 
-status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer) {
+status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer,
+                                                              bool* outCreated) {
+    if (outCreated) {
+        *outCreated = false;
+    }
     if (buffer == nullptr) {
         return BAD_VALUE;
     }
@@ -795,6 +822,9 @@ status_t GLESRenderEngine::cacheExternalTextureBufferInternal(const sp<GraphicBu
         }
         mImageCache.insert(std::make_pair(buffer->getId(), std::move(newImage)));
     }
+    if (outCreated) {
+        *outCreated = true;
+    }
 
     return NO_ERROR;
 }
@@ -1105,6 +1135,12 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
 
     validateOutputBufferUsage(buffer->getBuffer());
 
+    // Queries cannot be shared with the protected context, which is not worth timing anyway.
+    GLGpuTimer* const gpuTimer = mInProtectedContext ? nullptr : mGpuTimer.get();
+    if (gpuTimer) {
+        gpuTimer->beginDraw();
+    }
+
     std::unique_ptr<BindNativeBufferAsFramebuffer> fbo;
     // Gathering layers that requested blur, we'll need them to decide when to render to an
     // offscreen buffer, and when to render to the native buffer.
@@ -1167,10 +1203,14 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                         .setTexCoords(2 /* size */)
                         .setCropCoords(2 /* size */)
                         .build();
-    for (auto const layer : layers) {
+    for (size_t i = 0; i < layers.size(); i++) {
+        const LayerSettings* const layer = layers[i];
         if (blurLayers.size() > 0 && blurLayers.front() == layer) {
             blurLayers.pop_front();
 
+            if (gpuTimer) {
+                gpuTimer->beginPass(GLGpuTimer::Pass::Blur);
+            }
             auto status = mBlurFilter->prepare();
             if (status != NO_ERROR) {
                 ALOGE("Failed to render blur effect! Aborting GPU composition for buffer (%p).",
@@ -1208,6 +1248,20 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
                 checkErrors("Can't render blur filter");
                 return status;
             }
+            if (gpuTimer) {
+                gpuTimer->endPass();
+            }
+        }
+
+        // Runs of solid color layers, as for dims and backgrounds, are drawn with one call.
+        size_t batchEnd = i + 1;
+        while (batchEnd < layers.size() && canBatchColorLayers(*layer, *layers[batchEnd])) {
+            batchEnd++;
+        }
+        if (batchEnd - i > 1) {
+            drawColorLayerBatch(layers, i, batchEnd, projectionMatrix);
+            i = batchEnd - 1;
+            continue;
         }
 
         // Ensure luminance is at least 100 nits to avoid div-by-zero
@@ -1273,8 +1327,14 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         setSourceDataSpace(layer->sourceDataspace);
 
         if (layer->shadow.length > 0.0f) {
+            if (gpuTimer) {
+                gpuTimer->beginPass(GLGpuTimer::Pass::Shadow);
+            }
             handleShadow(layer->geometry.boundaries, layer->geometry.roundedCornersRadius,
                          layer->shadow);
+            if (gpuTimer) {
+                gpuTimer->endPass();
+            }
         }
         // We only want to do a special handling for rounded corners when having rounded corners
         // is the only reason it needs to turn on blending, otherwise, we handle it like the
@@ -1293,6 +1353,9 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
         }
     }
 
+    if (gpuTimer) {
+        gpuTimer->endDraw();
+    }
     if (drawFence != nullptr) {
         *drawFence = flush();
     }
@@ -1319,6 +1382,70 @@ status_t GLESRenderEngine::drawLayers(const DisplaySettings& display,
     return NO_ERROR;
 }
 
+bool GLESRenderEngine::canBatchColorLayers(const LayerSettings& first, const LayerSettings& next) {
+    const auto isPlainColorLayer = [](const LayerSettings& layer) {
+        return layer.source.buffer.buffer == nullptr && layer.backgroundBlurRadius == 0 &&
+                layer.shadow.length <= 0.0f && layer.geometry.roundedCornersRadius <= 0.0f;
+    };
+    return isPlainColorLayer(first) && isPlainColorLayer(next) &&
+            first.source.solidColor == next.source.solidColor && first.alpha == next.alpha &&
+            first.colorTransform == next.colorTransform &&
+            first.sourceDataspace == next.sourceDataspace &&
+            first.disableBlending == next.disableBlending &&
+            first.source.buffer.maxLuminanceNits == next.source.buffer.maxLuminanceNits;
+}
+
+void GLESRenderEngine::drawColorLayerBatch(const std::vector<const LayerSettings*>& layers,
+                                           size_t begin, size_t end, const mat4& projectionMatrix) {
+    ATRACE_CALL();
+    Mesh mesh = Mesh::Builder()
+                        .setPrimitive(Mesh::TRIANGLES)
+                        .setVertices((end - begin) * 6 /* count */, 2 /* size */)
+                        .build();
+    Mesh::VertexArray<vec2> position(mesh.getPositionArray<vec2>());
+    size_t vertex = 0;
+    for (size_t i = begin; i < end; i++) {
+        // Each layer has its own transform, so it is applied here rather than in the shader.
+        const mat4& transform = layers[i]->geometry.positionTransform;
+        const auto transformed = [&transform](float x, float y) {
+            const vec4 point = transform * vec4(x, y, 0.0f, 1.0f);
+            return point.xy / point.w;
+        };
+        const FloatRect& bounds = layers[i]->geometry.boundaries;
+        const vec2 topLeft = transformed(bounds.left, bounds.top);
+        const vec2 bottomLeft = transformed(bounds.left, bounds.bottom);
+        const vec2 bottomRight = transformed(bounds.right, bounds.bottom);
+        const vec2 topRight = transformed(bounds.right, bounds.top);
+        // Triangles are rasterized in order, so overlapping translucent layers still blend as if
+        // they were drawn one by one.
+        position[vertex++] = topLeft;
+        position[vertex++] = bottomLeft;
+        position[vertex++] = bottomRight;
+        position[vertex++] = topLeft;
+        position[vertex++] = bottomRight;
+        position[vertex++] = topRight;
+    }
+
+    const LayerSettings& first = *layers[begin];
+    // Ensure luminance is at least 100 nits to avoid div-by-zero
+    const float maxLuminance = std::max(100.f, first.source.buffer.maxLuminanceNits);
+    mState.maxMasteringLuminance = maxLuminance;
+    mState.maxContentLuminance = maxLuminance;
+    mState.projectionMatrix = projectionMatrix;
+    setColorTransform(first.colorTransform);
+
+    const half3 solidColor = first.source.solidColor;
+    setupLayerBlending(true /* premultipliedAlpha */, false /* opaque */,
+                       true /* disableTexture */,
+                       half4(solidColor.r, solidColor.g, solidColor.b, first.alpha),
+                       0.0f /* cornerRadius */);
+    if (first.disableBlending) {
+        glDisable(GL_BLEND);
+    }
+    setSourceDataSpace(first.sourceDataspace);
+    drawMesh(mesh);
+}
+
 void GLESRenderEngine::setViewportAndProjection(Rect viewport, Rect clip) {
     ATRACE_CALL();
     mVpWidth = viewport.getWidth();
@@ -1572,6 +1699,10 @@ size_t GLESRenderEngine::getMaxTextureSize() const {
     return mMaxTextureSize;
 }
 
+std::vector<RenderEngine::GpuDuration> GLESRenderEngine::takeGpuDurations() {
+    return mGpuTimer ? mGpuTimer->takeDurations() : std::vector<GpuDuration>();
+}
+
 size_t GLESRenderEngine::getMaxViewportDims() const {
     return mMaxViewportDims[0] < mMaxViewportDims[1] ? mMaxViewportDims[0] : mMaxViewportDims[1];
 }
@@ -1592,6 +1723,14 @@ void GLESRenderEngine::dump(std::string& result) {
                   cache.getSize(mEGLContext));
     StringAppendF(&result, "RenderEngine program cache size for protected context: %zu\n",
                   cache.getSize(mProtectedEGLContext));
+    cache.dumpBinaryCache(result);
+    mShadowMeshCache.dump(result);
+    mImageManager->dump(result);
+    if (mGpuTimer) {
+        mGpuTimer->dump(result);
+    } else {
+        result.append("RenderEngine GPU timing: disabled\n");
+    }
     StringAppendF(&result, "RenderEngine last dataspace conversion: (%s) to (%s)\n",
                   dataspaceDetails(static_cast<android_dataspace>(mDataSpace)).c_str(),
                   dataspaceDetails(static_cast<android_dataspace>(mOutputDataSpace)).c_str());
@@ -1828,25 +1967,7 @@ void GLESRenderEngine::FlushTracer::loop() {
 void GLESRenderEngine::handleShadow(const FloatRect& casterRect, float casterCornerRadius,
                                     const ShadowSettings& settings) {
     ATRACE_CALL();
-    const float casterZ = settings.length / 2.0f;
-    const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
-                                          settings.casterIsTranslucent, settings.ambientColor,
-                                          settings.spotColor, settings.lightPos,
-                                          settings.lightRadius);
-
-    // setup mesh for both shadows
-    Mesh mesh = Mesh::Builder()
-                        .setPrimitive(Mesh::TRIANGLES)
-                        .setVertices(shadows.getVertexCount(), 2 /* size */)
-                        .setShadowAttrs()
-                        .setIndices(shadows.getIndexCount())
-                        .build();
-
-    Mesh::VertexArray<vec2> position = mesh.getPositionArray<vec2>();
-    Mesh::VertexArray<vec4> shadowColor = mesh.getShadowColorArray<vec4>();
-    Mesh::VertexArray<vec3> shadowParams = mesh.getShadowParamsArray<vec3>();
-    shadows.fillVertices(position, shadowColor, shadowParams);
-    shadows.fillIndices(mesh.getIndicesArray());
+    const Mesh& mesh = mShadowMeshCache.get(casterRect, casterCornerRadius, settings);
 
     mState.cornerRadius = 0.0f;
     mState.drawShadows = true;
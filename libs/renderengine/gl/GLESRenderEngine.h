@@ -31,6 +31,7 @@
 #include <renderengine/RenderEngine.h>
 #include <renderengine/private/Description.h>
 #include <sys/types.h>
+#include "GLShadowMeshCache.h"
 #include "GLShadowTexture.h"
 #include "ImageManager.h"
 
@@ -47,6 +48,7 @@ namespace gl {
 
 class GLImage;
 class BlurFilter;
+class GLGpuTimer;
 
 class GLESRenderEngine : public RenderEngine {
 public:
@@ -72,6 +74,7 @@ public:
     int getContextPriority() override;
     bool supportsBackgroundBlur() override { return mBlurFilter != nullptr; }
     void onPrimaryDisplaySizeChanged(ui::Size size) override {}
+    std::vector<GpuDuration> takeGpuDurations() override;
 
     EGLDisplay getEGLDisplay() const { return mEGLDisplay; }
     // Creates an output image for rendering to
@@ -136,7 +139,9 @@ private:
     void setScissor(const Rect& region);
     void disableScissor();
     bool waitSync(EGLSyncKHR sync, EGLint flags);
-    status_t cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer)
+    // Sets outCreated to whether an image was created, rather than already cached.
+    status_t cacheExternalTextureBufferInternal(const sp<GraphicBuffer>& buffer,
+                                                bool* outCreated = nullptr)
             EXCLUDES(mRenderingMutex);
     void unbindExternalTextureBufferInternal(uint64_t bufferId) EXCLUDES(mRenderingMutex);
     status_t bindFrameBuffer(Framebuffer* framebuffer);
@@ -165,6 +170,12 @@ private:
     // blending is an expensive operation, we want to turn off blending when it's not necessary.
     void handleRoundedCorners(const DisplaySettings& display, const LayerSettings& layer,
                               const Mesh& mesh);
+    // Whether next can be drawn in the same call as first, which is the case for solid color
+    // layers that only differ in their geometry.
+    static bool canBatchColorLayers(const LayerSettings& first, const LayerSettings& next);
+    // Draws the layers in [begin, end), which can all be batched with the first one, in one call.
+    void drawColorLayerBatch(const std::vector<const LayerSettings*>& layers, size_t begin,
+                             size_t end, const mat4& projectionMatrix);
     base::unique_fd flush();
     bool finish();
     bool waitFence(base::unique_fd fenceFd);
@@ -203,6 +214,9 @@ private:
     GLuint mVpHeight;
     Description mState;
     std::unique_ptr<GLShadowTexture> mShadowTexture = nullptr;
+    GLShadowMeshCache mShadowMeshCache;
+    // Null unless GPU timing is enabled.
+    std::unique_ptr<GLGpuTimer> mGpuTimer;
 
     mat4 mSrgbToXyz;
     mat4 mDisplayP3ToXyz;
@@ -23,6 +23,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
 ANDROID_SINGLETON_STATIC_INSTANCE(android::renderengine::gl::GLExtensions)
 
 namespace android {
@@ -65,6 +68,17 @@ void GLExtensions::initWithGLStrings(GLubyte const* vendor, GLubyte const* rende
     if (extensionSet.hasExtension("GL_EXT_protected_textures")) {
         mHasProtectedTexture = true;
     }
+    if (extensionSet.hasExtension("GL_OES_get_program_binary")) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+        mHasProgramBinary = formatCount > 0;
+    }
+    if (extensionSet.hasExtension("GL_EXT_disjoint_timer_query")) {
+        // Timestamps are optional, in which case the counter has no bits.
+        GLint timestampBits = 0;
+        glGetQueryivEXT(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &timestampBits);
+        mHasTimestampQuery = timestampBits > 0;
+    }
 }
 
 char const* GLExtensions::getVendor() const {
@@ -42,6 +42,8 @@ public:
     bool hasSurfacelessContext() const { return mHasSurfacelessContext; }
     bool hasProtectedTexture() const { return mHasProtectedTexture; }
     bool hasRealtimePriority() const { return mHasRealtimePriority; }
+    bool hasProgramBinary() const { return mHasProgramBinary; }
+    bool hasTimestampQuery() const { return mHasTimestampQuery; }
 
     void initWithGLStrings(GLubyte const* vendor, GLubyte const* renderer, GLubyte const* version,
                            GLubyte const* extensions);
@@ -69,6 +71,8 @@ private:
     bool mHasSurfacelessContext = false;
     bool mHasProtectedTexture = false;
     bool mHasRealtimePriority = false;
+    bool mHasProgramBinary = false;
+    bool mHasTimestampQuery = false;
 
     String8 mVendor;
     String8 mRenderer;
@@ -0,0 +1,243 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "GLGpuTimer.h"
+
+#include <GLES2/gl2ext.h>
+#include <android-base/stringprintf.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cinttypes>
+
+#include "GLExtensions.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+using base::StringAppendF;
+
+std::unique_ptr<GLGpuTimer> GLGpuTimer::create() {
+    if (!GLExtensions::getInstance().hasTimestampQuery()) {
+        return nullptr;
+    }
+    // Reset the disjoint flag, which may have been raised before any query was issued.
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    return std::unique_ptr<GLGpuTimer>(new GLGpuTimer());
+}
+
+GLGpuTimer::~GLGpuTimer() {
+    if (mCurrentDraw) {
+        releaseQueries(*mCurrentDraw);
+    }
+    for (const PendingDraw& draw : mPendingDraws) {
+        releaseQueries(draw);
+    }
+    if (mCurrentPass) {
+        mFreeQueries.push_back(mCurrentPass->begin);
+    }
+    glDeleteQueriesEXT(static_cast<GLsizei>(mFreeQueries.size()), mFreeQueries.data());
+}
+
+void GLGpuTimer::beginDraw() {
+    if (mCurrentDraw) {
+        releaseQueries(*mCurrentDraw);
+        mCurrentDraw.reset();
+    }
+    if (mCurrentPass) {
+        mFreeQueries.push_back(mCurrentPass->begin);
+        mCurrentPass.reset();
+    }
+    collectResults();
+
+    const GLuint begin = acquireQuery();
+    glQueryCounterEXT(begin, GL_TIMESTAMP_EXT);
+    mCurrentDraw = PendingDraw{systemTime(), {PassQueries{Pass::DrawLayers, begin, 0}}};
+}
+
+void GLGpuTimer::endDraw() {
+    if (!mCurrentDraw) return;
+
+    const GLuint end = acquireQuery();
+    glQueryCounterEXT(end, GL_TIMESTAMP_EXT);
+    mCurrentDraw->passes.front().end = end;
+    mPendingDraws.push_back(std::move(*mCurrentDraw));
+    mCurrentDraw.reset();
+
+    while (mPendingDraws.size() > kMaxPendingDraws) {
+        releaseQueries(mPendingDraws.front());
+        mPendingDraws.pop_front();
+        std::lock_guard lock(mMutex);
+        mDroppedDraws++;
+    }
+}
+
+void GLGpuTimer::beginPass(Pass pass) {
+    if (!mCurrentDraw || mCurrentPass) return;
+
+    const GLuint begin = acquireQuery();
+    glQueryCounterEXT(begin, GL_TIMESTAMP_EXT);
+    mCurrentPass = PassQueries{pass, begin, 0};
+}
+
+void GLGpuTimer::endPass() {
+    if (!mCurrentDraw || !mCurrentPass) return;
+
+    mCurrentPass->end = acquireQuery();
+    glQueryCounterEXT(mCurrentPass->end, GL_TIMESTAMP_EXT);
+    mCurrentDraw->passes.push_back(*mCurrentPass);
+    mCurrentPass.reset();
+}
+
+std::vector<RenderEngine::GpuDuration> GLGpuTimer::takeDurations() {
+    std::lock_guard lock(mMutex);
+    std::vector<RenderEngine::GpuDuration> durations;
+    durations.swap(mUntakenDurations);
+    return durations;
+}
+
+GLuint GLGpuTimer::acquireQuery() {
+    if (mFreeQueries.empty()) {
+        GLuint query = 0;
+        glGenQueriesEXT(1, &query);
+        return query;
+    }
+    const GLuint query = mFreeQueries.back();
+    mFreeQueries.pop_back();
+    return query;
+}
+
+void GLGpuTimer::releaseQueries(const PendingDraw& draw) {
+    for (const PassQueries& pass : draw.passes) {
+        mFreeQueries.push_back(pass.begin);
+        if (pass.end != 0) {
+            mFreeQueries.push_back(pass.end);
+        }
+    }
+}
+
+void GLGpuTimer::collectResults() {
+    ATRACE_CALL();
+    // The results of the pending queries are meaningless if the GPU was reset or changed its
+    // clock since they were issued.
+    GLint disjoint = 0;
+    glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+    if (disjoint) {
+        std::lock_guard lock(mMutex);
+        mDisjointDraws += mPendingDraws.size();
+        for (const PendingDraw& draw : mPendingDraws) {
+            releaseQueries(draw);
+        }
+        mPendingDraws.clear();
+        return;
+    }
+
+    while (!mPendingDraws.empty()) {
+        const PendingDraw& draw = mPendingDraws.front();
+        // The end of the draw is its last timestamp, so all of them are available once it is.
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuivEXT(draw.passes.front().end, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+        if (!available) break;
+
+        std::array<std::optional<nsecs_t>, kPassCount> durations;
+        for (const PassQueries& pass : draw.passes) {
+            GLuint64 begin = 0;
+            GLuint64 end = 0;
+            glGetQueryObjectui64vEXT(pass.begin, GL_QUERY_RESULT_EXT, &begin);
+            glGetQueryObjectui64vEXT(pass.end, GL_QUERY_RESULT_EXT, &end);
+            auto& duration = durations[static_cast<size_t>(pass.pass)];
+            duration = duration.value_or(0) + static_cast<nsecs_t>(end > begin ? end - begin : 0);
+        }
+
+        {
+            std::lock_guard lock(mMutex);
+            mMeasuredDraws++;
+            for (size_t i = 0; i < kPassCount; i++) {
+                if (!durations[i]) continue;
+                mHistory[i].push_back(*durations[i]);
+                if (mHistory[i].size() > kHistorySize) {
+                    mHistory[i].pop_front();
+                }
+            }
+            const nsecs_t drawDuration = *durations[static_cast<size_t>(Pass::DrawLayers)];
+            mUntakenDurations.push_back({draw.startTime, drawDuration});
+            if (mUntakenDurations.size() > kMaxUntakenDurations) {
+                mUntakenDurations.erase(mUntakenDurations.begin());
+            }
+        }
+        ATRACE_INT64("RE GPU duration", *durations[static_cast<size_t>(Pass::DrawLayers)]);
+
+        releaseQueries(draw);
+        mPendingDraws.pop_front();
+    }
+}
+
+void GLGpuTimer::dump(std::string& result) const {
+    std::lock_guard lock(mMutex);
+    StringAppendF(&result,
+                  "RenderEngine GPU timing: %zu draws measured, %zu dropped, %zu disjoint\n",
+                  mMeasuredDraws, mDroppedDraws, mDisjointDraws);
+
+    // Upper bounds of the histogram buckets, in milliseconds.
+    static constexpr std::array<nsecs_t, 7> kBucketsMs = {1, 2, 4, 8, 12, 16, 33};
+    for (size_t i = 0; i < kPassCount; i++) {
+        if (mHistory[i].empty()) continue;
+
+        std::vector<nsecs_t> sorted(mHistory[i].begin(), mHistory[i].end());
+        std::sort(sorted.begin(), sorted.end());
+        const auto percentile = [&sorted](size_t percent) {
+            return sorted[(sorted.size() - 1) * percent / 100] / 1e6;
+        };
+        StringAppendF(&result,
+                      "- %s, last %zu: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                      toString(static_cast<Pass>(i)), sorted.size(), percentile(50),
+                      percentile(90), percentile(99), sorted.back() / 1e6);
+
+        result.append("  histogram:");
+        size_t counted = 0;
+        for (const nsecs_t bucketMs : kBucketsMs) {
+            const auto bucketEnd = std::lower_bound(sorted.begin() + counted, sorted.end(),
+                                                    ms2ns(bucketMs));
+            const size_t bucketCount =
+                    static_cast<size_t>(bucketEnd - sorted.begin()) - counted;
+            StringAppendF(&result, " <%" PRId64 "ms: %zu", bucketMs, bucketCount);
+            counted += bucketCount;
+        }
+        StringAppendF(&result, " >=%" PRId64 "ms: %zu\n", kBucketsMs.back(),
+                      sorted.size() - counted);
+    }
+}
+
+const char* GLGpuTimer::toString(Pass pass) {
+    switch (pass) {
+        case Pass::DrawLayers:
+            return "drawLayers";
+        case Pass::Blur:
+            return "blur";
+        case Pass::Shadow:
+            return "shadow";
+    }
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
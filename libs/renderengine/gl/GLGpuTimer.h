@@ -0,0 +1,108 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <android-base/thread_annotations.h>
+#include <renderengine/RenderEngine.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/**
+ * Measures how long the GPU spends on each drawLayers call, and on its blur and shadow passes,
+ * with GL_EXT_disjoint_timer_query timestamps. Timestamps are used rather than elapsed time
+ * queries since the latter cannot nest. The results are read back by later draws, once the GPU
+ * has reached them, so measuring never stalls the pipeline.
+ *
+ * Other than takeDurations and dump, the timer must be used with its context current.
+ */
+class GLGpuTimer {
+public:
+    enum class Pass { DrawLayers, Blur, Shadow };
+
+    // Returns null if the GPU does not support timestamp queries.
+    static std::unique_ptr<GLGpuTimer> create();
+    ~GLGpuTimer();
+
+    // Called around the GL commands of each drawLayers call, before they are flushed. A draw that
+    // is not ended, as when drawLayers fails, is discarded by the next one.
+    void beginDraw();
+    void endDraw();
+    // Called around the sub-passes of the current draw, which may not nest.
+    void beginPass(Pass pass);
+    void endPass();
+
+    // Returns the durations of the draws measured since the last call.
+    std::vector<RenderEngine::GpuDuration> takeDurations();
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t kPassCount = static_cast<size_t>(Pass::Shadow) + 1;
+    // Draws whose results are not available by then are dropped, rather than waited for.
+    static constexpr size_t kMaxPendingDraws = 8;
+    // Number of draws that the histograms cover.
+    static constexpr size_t kHistorySize = 256;
+    // Durations that nobody takes are dropped past this.
+    static constexpr size_t kMaxUntakenDurations = 64;
+
+    struct PassQueries {
+        Pass pass;
+        GLuint begin;
+        GLuint end;
+    };
+
+    struct PendingDraw {
+        nsecs_t startTime;
+        // The first one times the whole draw.
+        std::vector<PassQueries> passes;
+    };
+
+    GLGpuTimer() = default;
+
+    GLuint acquireQuery();
+    void releaseQueries(const PendingDraw& draw);
+    void collectResults();
+    static const char* toString(Pass pass);
+
+    std::vector<GLuint> mFreeQueries;
+    std::optional<PendingDraw> mCurrentDraw;
+    std::optional<PassQueries> mCurrentPass;
+    std::deque<PendingDraw> mPendingDraws;
+
+    mutable std::mutex mMutex;
+    // Most recent durations of each pass, leaving out the draws that did not have it.
+    std::array<std::deque<nsecs_t>, kPassCount> mHistory GUARDED_BY(mMutex);
+    std::vector<RenderEngine::GpuDuration> mUntakenDurations GUARDED_BY(mMutex);
+    size_t mMeasuredDraws GUARDED_BY(mMutex) = 0;
+    size_t mDroppedDraws GUARDED_BY(mMutex) = 0;
+    size_t mDisjointDraws GUARDED_BY(mMutex) = 0;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "GLShadowMeshCache.h"
+
+#include <android-base/stringprintf.h>
+#include <utils/Trace.h>
+
+#include "GLShadowVertexGenerator.h"
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+const Mesh& GLShadowMeshCache::get(const FloatRect& casterRect, float casterCornerRadius,
+                                   const ShadowSettings& settings) {
+    for (auto it = mEntries.begin(); it != mEntries.end(); it++) {
+        if (it->casterRect == casterRect && it->casterCornerRadius == casterCornerRadius &&
+            it->settings == settings) {
+            mHits++;
+            mEntries.splice(mEntries.begin(), mEntries, it);
+            return *mEntries.front().mesh;
+        }
+    }
+
+    mMisses++;
+    if (mEntries.size() >= kMaxEntries) {
+        mEntries.pop_back();
+    }
+    mEntries.push_front(Entry{casterRect, casterCornerRadius, settings,
+                              generateMesh(casterRect, casterCornerRadius, settings)});
+    return *mEntries.front().mesh;
+}
+
+void GLShadowMeshCache::dump(std::string& result) const {
+    base::StringAppendF(&result, "RenderEngine shadow mesh cache: %zu hits, %zu misses\n", mHits,
+                        mMisses);
+}
+
+std::unique_ptr<Mesh> GLShadowMeshCache::generateMesh(const FloatRect& casterRect,
+                                                      float casterCornerRadius,
+                                                      const ShadowSettings& settings) {
+    ATRACE_CALL();
+    const float casterZ = settings.length / 2.0f;
+    const GLShadowVertexGenerator shadows(casterRect, casterCornerRadius, casterZ,
+                                          settings.casterIsTranslucent, settings.ambientColor,
+                                          settings.spotColor, settings.lightPos,
+                                          settings.lightRadius);
+
+    // setup mesh for both shadows
+    std::unique_ptr<Mesh> mesh(new Mesh(Mesh::Builder()
+                                                .setPrimitive(Mesh::TRIANGLES)
+                                                .setVertices(shadows.getVertexCount(), 2 /* size */)
+                                                .setShadowAttrs()
+                                                .setIndices(shadows.getIndexCount())
+                                                .build()));
+
+    Mesh::VertexArray<vec2> position = mesh->getPositionArray<vec2>();
+    Mesh::VertexArray<vec4> shadowColor = mesh->getShadowColorArray<vec4>();
+    Mesh::VertexArray<vec3> shadowParams = mesh->getShadowParamsArray<vec3>();
+    shadows.fillVertices(position, shadowColor, shadowParams);
+    shadows.fillIndices(mesh->getIndicesArray());
+    return mesh;
+}
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
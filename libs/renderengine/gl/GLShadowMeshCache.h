@@ -0,0 +1,66 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <renderengine/LayerSettings.h>
+#include <renderengine/Mesh.h>
+#include <ui/Rect.h>
+
+#include <list>
+#include <memory>
+#include <string>
+
+namespace android {
+namespace renderengine {
+namespace gl {
+
+/**
+ * Least recently used cache of the shadow meshes that GLShadowVertexGenerator tessellates. Most
+ * shadows, such as the ones of windows and cards, keep the same geometry and light from frame to
+ * frame, so they only need to be tessellated once.
+ */
+class GLShadowMeshCache {
+public:
+    // Returns the mesh of the shadow, tessellating it if it is not cached. The mesh is valid until
+    // the next call.
+    const Mesh& get(const FloatRect& casterRect, float casterCornerRadius,
+                    const ShadowSettings& settings);
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t kMaxEntries = 16;
+
+    struct Entry {
+        FloatRect casterRect;
+        float casterCornerRadius;
+        ShadowSettings settings;
+        std::unique_ptr<Mesh> mesh;
+    };
+
+    static std::unique_ptr<Mesh> generateMesh(const FloatRect& casterRect,
+                                              float casterCornerRadius,
+                                              const ShadowSettings& settings);
+
+    // Most recently used first.
+    std::list<Entry> mEntries;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+};
+
+} // namespace gl
+} // namespace renderengine
+} // namespace android
@@ -21,6 +21,10 @@
 
 #include <pthread.h>
 
+#include <algorithm>
+#include <cinttypes>
+
+#include <android-base/stringprintf.h>
 #include <processgroup/sched_policy.h>
 #include <utils/Trace.h>
 #include "GLESRenderEngine.h"
@@ -30,6 +34,8 @@ namespace android {
 namespace renderengine {
 namespace gl {
 
+using base::StringAppendF;
+
 ImageManager::ImageManager(GLESRenderEngine* engine) : mEngine(engine) {}
 
 void ImageManager::initThread() {
@@ -66,12 +72,31 @@ void ImageManager::cacheAsync(const sp<GraphicBuffer>& buffer,
         return;
     }
     ATRACE_CALL();
-    QueueEntry entry = {QueueEntry::Operation::Insert, buffer, buffer->getId(), barrier};
+    QueueEntry entry = {QueueEntry::Operation::Insert, buffer, buffer->getId(), barrier,
+                        systemTime()};
     queueOperation(std::move(entry));
 }
 
 status_t ImageManager::cache(const sp<GraphicBuffer>& buffer) {
     ATRACE_CALL();
+    if (buffer == nullptr) {
+        return BAD_VALUE;
+    }
+    bool releasing;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        releasing = mPendingDeletes.count(buffer->getId()) > 0;
+        if (!releasing) {
+            mSyncCreations++;
+        }
+    }
+    // Creating the image does not need the EGL context, so there is no reason to wait for the
+    // thread to get through the rest of its queue. A pending release of the buffer has to run
+    // first though, or it would destroy the image that the caller is about to use.
+    if (!releasing) {
+        return createImage(buffer, systemTime());
+    }
+
     auto barrier = std::make_shared<Barrier>();
     cacheAsync(buffer, barrier);
     std::lock_guard<std::mutex> lock(barrier->mutex);
@@ -82,19 +107,113 @@ status_t ImageManager::cache(const sp<GraphicBuffer>& buffer) {
 
 void ImageManager::releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) {
     ATRACE_CALL();
-    QueueEntry entry = {QueueEntry::Operation::Delete, nullptr, bufferId, barrier};
+    QueueEntry entry = {QueueEntry::Operation::Delete, nullptr, bufferId, barrier, systemTime()};
     queueOperation(std::move(entry));
 }
 
+void ImageManager::dump(std::string& result) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    StringAppendF(&result,
+                  "RenderEngine image manager: %zu operations in %zu batches, %zu creations "
+                  "skipped for released buffers, %zu synchronous creations\n",
+                  mBatchedOperations, mBatches, mSkippedCreations, mSyncCreations);
+
+    const auto dumpPercentiles = [&result](const char* name, const std::deque<nsecs_t>& history) {
+        if (history.empty()) {
+            return;
+        }
+        std::vector<nsecs_t> sorted(history.begin(), history.end());
+        std::sort(sorted.begin(), sorted.end());
+        const auto percentile = [&sorted](size_t percent) {
+            return sorted[(sorted.size() - 1) * percent / 100] / 1e6;
+        };
+        StringAppendF(&result,
+                      "- %s, last %zu: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                      name, sorted.size(), percentile(50), percentile(90), percentile(99),
+                      sorted.back() / 1e6);
+    };
+    dumpPercentiles("EGLImage creation", mCreationDurations);
+    dumpPercentiles("EGLImage ready after request", mReadyLatencies);
+}
+
 void ImageManager::queueOperation(const QueueEntry&& entry) {
     {
         std::lock_guard<std::mutex> lock(mMutex);
-        mQueue.emplace(entry);
+        if (entry.op == QueueEntry::Operation::Delete) {
+            mPendingDeletes[entry.bufferId]++;
+        }
+        mQueue.push_back(entry);
         ATRACE_INT("ImageManagerQueueDepth", mQueue.size());
     }
     mCondition.notify_one();
 }
 
+status_t ImageManager::createImage(const sp<GraphicBuffer>& buffer, nsecs_t queueTime) {
+    const nsecs_t start = systemTime();
+    bool created = false;
+    const status_t result = mEngine->cacheExternalTextureBufferInternal(buffer, &created);
+    if (!created) {
+        return result;
+    }
+    const nsecs_t end = systemTime();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mCreationDurations.push_back(end - start);
+    mReadyLatencies.push_back(end - queueTime);
+    if (mCreationDurations.size() > kHistorySize) {
+        mCreationDurations.pop_front();
+        mReadyLatencies.pop_front();
+    }
+    return result;
+}
+
+void ImageManager::processBatch(std::vector<QueueEntry>& batch) {
+    ATRACE_CALL();
+    // The image of a buffer that a later operation of the batch releases would be destroyed
+    // without ever being drawn, so it is only created when someone waits for it.
+    std::unordered_map<uint64_t, size_t> lastDeletes;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].op == QueueEntry::Operation::Delete) {
+            lastDeletes[batch[i].bufferId] = i;
+        }
+    }
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        QueueEntry& entry = batch[i];
+        status_t result = NO_ERROR;
+        switch (entry.op) {
+            case QueueEntry::Operation::Delete: {
+                mEngine->unbindExternalTextureBufferInternal(entry.bufferId);
+                std::lock_guard<std::mutex> lock(mMutex);
+                const auto pendingDelete = mPendingDeletes.find(entry.bufferId);
+                if (pendingDelete != mPendingDeletes.end() && --pendingDelete->second == 0) {
+                    mPendingDeletes.erase(pendingDelete);
+                }
+                break;
+            }
+            case QueueEntry::Operation::Insert: {
+                const auto lastDelete = lastDeletes.find(entry.bufferId);
+                if (entry.barrier == nullptr && lastDelete != lastDeletes.end() &&
+                    lastDelete->second > i) {
+                    std::lock_guard<std::mutex> lock(mMutex);
+                    mSkippedCreations++;
+                    break;
+                }
+                result = createImage(entry.buffer, entry.queueTime);
+                break;
+            }
+        }
+        if (entry.barrier != nullptr) {
+            {
+                std::lock_guard<std::mutex> entryLock(entry.barrier->mutex);
+                entry.barrier->result = result;
+                entry.barrier->isOpen = true;
+            }
+            entry.barrier->condition.notify_one();
+        }
+    }
+}
+
 void ImageManager::threadMain() {
     set_sched_policy(0, SP_FOREGROUND);
     bool run;
@@ -103,7 +222,7 @@ void ImageManager::threadMain() {
         run = mRunning;
     }
     while (run) {
-        QueueEntry entry;
+        std::vector<QueueEntry> batch;
         {
             std::lock_guard<std::mutex> lock(mMutex);
             mCondition.wait(mMutex,
@@ -116,28 +235,15 @@ void ImageManager::threadMain() {
                 break;
             }
 
-            entry = mQueue.front();
-            mQueue.pop();
-            ATRACE_INT("ImageManagerQueueDepth", mQueue.size());
+            // Take everything that was queued at once, rather than locking the
+            // queue again for each operation.
+            std::swap(batch, mQueue);
+            mBatches++;
+            mBatchedOperations += batch.size();
+            ATRACE_INT("ImageManagerQueueDepth", 0);
         }
 
-        status_t result = NO_ERROR;
-        switch (entry.op) {
-            case QueueEntry::Operation::Delete:
-                mEngine->unbindExternalTextureBufferInternal(entry.bufferId);
-                break;
-            case QueueEntry::Operation::Insert:
-                result = mEngine->cacheExternalTextureBufferInternal(entry.buffer);
-                break;
-        }
-        if (entry.barrier != nullptr) {
-            {
-                std::lock_guard<std::mutex> entryLock(entry.barrier->mutex);
-                entry.barrier->result = result;
-                entry.barrier->isOpen = true;
-            }
-            entry.barrier->condition.notify_one();
-        }
+        processBatch(batch);
     }
 
     ALOGD("Reached end of threadMain, terminating ImageManager thread!");
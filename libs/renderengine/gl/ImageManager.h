@@ -17,9 +17,12 @@
 #pragma once
 
 #include <condition_variable>
+#include <deque>
 #include <mutex>
-#include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include <ui/GraphicBuffer.h>
 
@@ -43,10 +46,16 @@ public:
     // We need this to guarantee that the class is fully-constructed before the
     // thread begins running.
     void initThread();
+    // Queues the creation of the image of buffer without waiting for it. This is what callers
+    // should use as soon as they know that a buffer will be rendered, so that its image is ready
+    // by the time it is drawn.
     void cacheAsync(const sp<GraphicBuffer>& buffer, const std::shared_ptr<Barrier>& barrier)
             EXCLUDES(mMutex);
-    status_t cache(const sp<GraphicBuffer>& buffer);
+    // Creates the image of buffer before returning. Unless the buffer is being released, the
+    // image is created on the calling thread rather than behind the queued operations.
+    status_t cache(const sp<GraphicBuffer>& buffer) EXCLUDES(mMutex);
     void releaseAsync(uint64_t bufferId, const std::shared_ptr<Barrier>& barrier) EXCLUDES(mMutex);
+    void dump(std::string& result) const EXCLUDES(mMutex);
 
 private:
     struct QueueEntry {
@@ -56,17 +65,36 @@ private:
         sp<GraphicBuffer> buffer = nullptr;
         uint64_t bufferId = 0;
         std::shared_ptr<Barrier> barrier = nullptr;
+        nsecs_t queueTime = 0;
     };
 
+    // Number of image creations kept for the latency percentiles of the dump.
+    static constexpr size_t kHistorySize = 256;
+
     void queueOperation(const QueueEntry&& entry);
     void threadMain();
+    // Runs a batch of operations taken from the queue at once, in order.
+    void processBatch(std::vector<QueueEntry>& batch) EXCLUDES(mMutex);
+    status_t createImage(const sp<GraphicBuffer>& buffer, nsecs_t queueTime) EXCLUDES(mMutex);
     GLESRenderEngine* const mEngine;
     std::thread mThread;
     std::condition_variable_any mCondition;
-    std::mutex mMutex;
-    std::queue<QueueEntry> mQueue GUARDED_BY(mMutex);
+    mutable std::mutex mMutex;
+    std::vector<QueueEntry> mQueue GUARDED_BY(mMutex);
+    // Number of queued or running Delete operations of each buffer, which cache() must not run
+    // ahead of.
+    std::unordered_map<uint64_t, size_t> mPendingDeletes GUARDED_BY(mMutex);
 
     bool mRunning GUARDED_BY(mMutex) = true;
+
+    // How long the most recent image creations took, and how long after being requested their
+    // images were ready.
+    std::deque<nsecs_t> mCreationDurations GUARDED_BY(mMutex);
+    std::deque<nsecs_t> mReadyLatencies GUARDED_BY(mMutex);
+    size_t mBatches GUARDED_BY(mMutex) = 0;
+    size_t mBatchedOperations GUARDED_BY(mMutex) = 0;
+    size_t mSkippedCreations GUARDED_BY(mMutex) = 0;
+    size_t mSyncCreations GUARDED_BY(mMutex) = 0;
 };
 
 } // namespace gl
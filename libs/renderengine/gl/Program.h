@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <GLES2/gl2.h>
 #include <renderengine/private/Description.h>
 #include "ProgramCache.h"
@@ -54,6 +56,9 @@ public:
     };
 
     Program(const ProgramCache::Key& needs, const char* vertex, const char* fragment);
+    // Loads a binary retrieved from getBinary; the program is not valid if the driver rejects it.
+    Program(const ProgramCache::Key& needs, GLenum binaryFormat,
+            const std::vector<uint8_t>& binary);
     ~Program();
 
     /* whether this object is usable */
@@ -71,16 +76,20 @@ public:
     /* set-up uniforms from the description */
     void setUniforms(const Description& desc);
 
+    /* Retrieves the linked program in the driver's binary format */
+    bool getBinary(GLenum* binaryFormat, std::vector<uint8_t>* binary) const;
+
 private:
     GLuint buildShader(const char* source, GLenum type);
+    void initialize(GLuint programId);
 
     // whether the initialization succeeded
     bool mInitialized;
 
-    // Name of the OpenGL program and shaders
-    GLuint mProgram;
-    GLuint mVertexShader;
-    GLuint mFragmentShader;
+    // Name of the OpenGL program and shaders, which are 0 for programs loaded from a binary
+    GLuint mProgram = 0;
+    GLuint mVertexShader = 0;
+    GLuint mFragmentShader = 0;
 
     /* location of the projection matrix uniform */
     GLint mProjectionMatrixLoc;
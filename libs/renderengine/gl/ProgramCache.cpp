@@ -20,12 +20,16 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <android-base/stringprintf.h>
 #include <log/log.h>
 #include <renderengine/private/Description.h>
 #include <utils/String8.h>
 #include <utils/Trace.h>
 #include "Program.h"
 
+#include <cstring>
+#include <vector>
+
 ANDROID_SINGLETON_STATIC_INSTANCE(android::renderengine::gl::ProgramCache)
 
 namespace android {
@@ -77,6 +81,40 @@ Formatter& dedent(Formatter& f) {
     return f;
 }
 
+namespace {
+
+constexpr uint32_t kBinaryCacheMagic = 0x50474552; // "REGP" in little endian
+
+// Prefixes each binary in the cache.
+struct BinaryHeader {
+    uint32_t format;
+    uint32_t used;
+};
+
+} // namespace
+
+void ProgramCache::setBinaryCacheFile(const std::string& path, const std::string& identity,
+                                      bool learnedPriming) {
+    mBinaryFile =
+            std::make_unique<PersistentCacheFile>(path, kBinaryCacheMagic, kBinaryCacheVersion,
+                                                  [this] {
+                                                      std::lock_guard lock(mBinaryMutex);
+                                                      return mBinaries;
+                                                  });
+    mLearnedPriming = learnedPriming;
+
+    PersistentCacheFile::Entries binaries = mBinaryFile->read(identity);
+    size_t size = 0;
+    for (const auto& [key, binary] : binaries) {
+        size += key.size() + binary.size();
+    }
+
+    std::lock_guard lock(mBinaryMutex);
+    mBinaries = std::move(binaries);
+    mBinarySize = size;
+    mBinaryLoadedCount = mBinaries.size();
+}
+
 void ProgramCache::primeCache(
         EGLContext context, bool useColorManagement, bool toneMapperShaderOnly) {
     auto& cache = mCaches[context];
@@ -109,12 +147,46 @@ void ProgramCache::primeCache(
         return;
     }
 
+    nsecs_t timeBefore = systemTime();
+
+    // Prime the programs that previous runs used, rather than every permutation below.
+    if (mLearnedPriming) {
+        std::vector<Key> usedKeys;
+        {
+            std::lock_guard lock(mBinaryMutex);
+            for (const auto& [key, binary] : mBinaries) {
+                BinaryHeader header;
+                if (key.size() != sizeof(Key::key_t) || binary.size() < sizeof(header)) {
+                    continue;
+                }
+                std::memcpy(&header, binary.data(), sizeof(header));
+                if (header.used) {
+                    Key::key_t value;
+                    std::memcpy(&value, key.data(), sizeof(value));
+                    usedKeys.push_back(Key().set(~Key::key_t(0), value));
+                }
+            }
+        }
+
+        if (!usedKeys.empty()) {
+            for (const Key& shaderKey : usedKeys) {
+                if (cache.count(shaderKey) == 0) {
+                    cache.emplace(shaderKey, generateProgram(shaderKey));
+                    shaderCount++;
+                }
+            }
+            const float compileTimeMs = static_cast<float>(systemTime() - timeBefore) / 1.0E6;
+            ALOGD("shader cache generated from previously used programs - %u shaders in %f ms\n",
+                  shaderCount, compileTimeMs);
+            return;
+        }
+    }
+
     uint32_t keyMask = Key::BLEND_MASK | Key::OPACITY_MASK | Key::ALPHA_MASK | Key::TEXTURE_MASK
         | Key::ROUNDED_CORNERS_MASK;
     // Prime the cache for all combinations of the above masks,
     // leaving off the experimental color matrix mask options.
 
-    nsecs_t timeBefore = systemTime();
     for (uint32_t keyVal = 0; keyVal <= keyMask; keyVal++) {
         Key shaderKey;
         shaderKey.set(keyMask, keyVal);
@@ -791,13 +863,122 @@ String8 ProgramCache::generateFragmentShader(const Key& needs) {
 std::unique_ptr<Program> ProgramCache::generateProgram(const Key& needs) {
     ATRACE_CALL();
 
+    if (auto program = loadProgramBinary(needs)) {
+        return program;
+    }
+
     // vertex shader
     String8 vs = generateVertexShader(needs);
 
     // fragment shader
     String8 fs = generateFragmentShader(needs);
 
-    return std::make_unique<Program>(needs, vs.string(), fs.string());
+    auto program = std::make_unique<Program>(needs, vs.string(), fs.string());
+    storeProgramBinary(needs, *program);
+    return program;
+}
+
+std::string ProgramCache::toBinaryKey(const Key& needs) {
+    return std::string(reinterpret_cast<const char*>(&needs.mKey), sizeof(needs.mKey));
+}
+
+std::unique_ptr<Program> ProgramCache::loadProgramBinary(const Key& needs) {
+    if (!mBinaryFile) {
+        return nullptr;
+    }
+
+    BinaryHeader header;
+    std::vector<uint8_t> binary;
+    {
+        std::lock_guard lock(mBinaryMutex);
+        const auto it = mBinaries.find(toBinaryKey(needs));
+        if (it == mBinaries.end() || it->second.size() <= sizeof(header)) {
+            return nullptr;
+        }
+        std::memcpy(&header, it->second.data(), sizeof(header));
+        binary.assign(it->second.begin() + sizeof(header), it->second.end());
+    }
+
+    ATRACE_NAME("loadProgramBinary");
+    auto program = std::make_unique<Program>(needs, header.format, binary);
+
+    std::lock_guard lock(mBinaryMutex);
+    if (!program->isValid()) {
+        // Compile the program instead, which replaces the binary.
+        mBinaryRejects++;
+        return nullptr;
+    }
+    mBinaryLoadHits++;
+    return program;
+}
+
+void ProgramCache::storeProgramBinary(const Key& needs, const Program& program) {
+    BinaryHeader header = {};
+    std::vector<uint8_t> binary;
+    if (!mBinaryFile || !program.getBinary(&header.format, &binary)) {
+        return;
+    }
+
+    std::lock_guard lock(mBinaryMutex);
+    const std::string key = toBinaryKey(needs);
+    auto it = mBinaries.find(key);
+    const size_t oldSize = it == mBinaries.end() ? 0 : key.size() + it->second.size();
+    const size_t newSize = key.size() + sizeof(header) + binary.size();
+    if (mBinarySize - oldSize + newSize > kMaxBinaryCacheSize) {
+        return;
+    }
+
+    if (it == mBinaries.end()) {
+        it = mBinaries.emplace(key, std::string()).first;
+    } else if (it->second.size() >= sizeof(header)) {
+        // A replaced binary keeps whether it was used.
+        BinaryHeader oldHeader;
+        std::memcpy(&oldHeader, it->second.data(), sizeof(oldHeader));
+        header.used = oldHeader.used;
+    }
+    mBinarySize = mBinarySize - oldSize + newSize;
+
+    it->second.assign(reinterpret_cast<const char*>(&header), sizeof(header));
+    it->second.append(reinterpret_cast<const char*>(binary.data()), binary.size());
+    mBinaryFile->scheduleWrite();
+}
+
+void ProgramCache::markProgramUsed(const Key& needs) {
+    if (!mBinaryFile || !mUsedKeys.insert(needs).second) {
+        return;
+    }
+
+    std::lock_guard lock(mBinaryMutex);
+    const auto it = mBinaries.find(toBinaryKey(needs));
+    if (it == mBinaries.end() || it->second.size() < sizeof(BinaryHeader)) {
+        return;
+    }
+
+    BinaryHeader header;
+    std::memcpy(&header, it->second.data(), sizeof(header));
+    if (header.used) {
+        return;
+    }
+    header.used = 1;
+    std::memcpy(it->second.data(), &header, sizeof(header));
+    mBinaryFile->scheduleWrite();
+}
+
+void ProgramCache::dumpBinaryCache(std::string& result) {
+    if (!mBinaryFile) {
+        result.append("Program binary cache: not persisted\n");
+        return;
+    }
+
+    std::lock_guard lock(mBinaryMutex);
+    base::StringAppendF(&result,
+                        "Program binary cache: %s, %zu programs (%zu bytes), %zu loaded at "
+                        "startup, %zu hits, %zu rejected, %zu saves, %zu used this run, "
+                        "learned priming %s\n",
+                        mBinaryFile->getPath().c_str(), mBinaries.size(), mBinarySize,
+                        mBinaryLoadedCount, mBinaryLoadHits, mBinaryRejects,
+                        mBinaryFile->getWriteCount(), mUsedKeys.size(),
+                        mLearnedPriming ? "on" : "off");
 }
 
 void ProgramCache::useProgram(EGLContext context, const Description& description) {
@@ -820,6 +1001,7 @@ void ProgramCache::useProgram(EGLContext context, const Description& description
     // here we have a suitable program for this description
     std::unique_ptr<Program>& program = it->second;
     if (program->isValid()) {
+        markProgramUsed(needs);
         program->use();
         program->setUniforms(description);
     }
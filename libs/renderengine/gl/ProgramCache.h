@@ -18,14 +18,20 @@
 #define SF_RENDER_ENGINE_PROGRAMCACHE_H
 
 #include <memory>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <EGL/egl.h>
 #include <GLES2/gl2.h>
+#include <android-base/thread_annotations.h>
 #include <renderengine/private/Description.h>
 #include <utils/Singleton.h>
 #include <utils/TypeHelpers.h>
 
+#include "../PersistentCacheFile.h"
+
 namespace android {
 
 class String8;
@@ -194,6 +200,13 @@ public:
     ProgramCache() = default;
     ~ProgramCache() = default;
 
+    // Persists the program binaries to the file, so that programs compiled by a previous run are
+    // loaded rather than compiled. The file is discarded if it was written for another identity.
+    // With learnedPriming, primeCache only generates the programs that previous runs used, as
+    // long as any were recorded.
+    void setBinaryCacheFile(const std::string& path, const std::string& identity,
+                            bool learnedPriming);
+
     // Generate shaders to populate the cache
     void primeCache(const EGLContext context, bool useColorManagement, bool toneMapperShaderOnly);
 
@@ -205,7 +218,14 @@ public:
 
     void purgeCaches() { mCaches.clear(); }
 
+    void dumpBinaryCache(std::string& result);
+
 private:
+    // Bumped whenever the layout of the entries, or the generated shaders, change.
+    static constexpr uint32_t kBinaryCacheVersion = 1;
+    // The file stops growing past this size, since it is read in full at startup.
+    static constexpr size_t kMaxBinaryCacheSize = 4 * 1024 * 1024;
+
     // compute a cache Key from a Description
     static Key computeKey(const Description& description);
     // Generate EOTF based from Key.
@@ -216,8 +236,13 @@ private:
     static void generateOOTF(Formatter& fs, const Key& needs);
     // Generate OETF based from Key.
     static void generateOETF(Formatter& fs, const Key& needs);
-    // generates a program from the Key
-    static std::unique_ptr<Program> generateProgram(const Key& needs);
+    // generates a program from the Key, or loads it from the binary cache
+    std::unique_ptr<Program> generateProgram(const Key& needs);
+    std::unique_ptr<Program> loadProgramBinary(const Key& needs);
+    void storeProgramBinary(const Key& needs, const Program& program);
+    static std::string toBinaryKey(const Key& needs);
+    // records that the program was used, for learned priming
+    void markProgramUsed(const Key& needs);
     // generates the vertex shader from the Key
     static String8 generateVertexShader(const Key& needs);
     // generates the fragment shader from the Key
@@ -227,6 +252,20 @@ private:
     // is never shrunk (and the GL program objects are never deleted).
     std::unordered_map<EGLContext, std::unordered_map<Key, std::unique_ptr<Program>, Key::Hash>>
             mCaches;
+
+    // Keys that were marked used in the binary cache by this run.
+    std::unordered_set<Key, Key::Hash> mUsedKeys;
+    bool mLearnedPriming = false;
+
+    std::mutex mBinaryMutex;
+    // Binaries keyed by the Key value, each prefixed by its format and whether it was used.
+    PersistentCacheFile::Entries mBinaries GUARDED_BY(mBinaryMutex);
+    size_t mBinarySize GUARDED_BY(mBinaryMutex) = 0;
+    size_t mBinaryLoadedCount GUARDED_BY(mBinaryMutex) = 0;
+    size_t mBinaryLoadHits GUARDED_BY(mBinaryMutex) = 0;
+    size_t mBinaryRejects GUARDED_BY(mBinaryMutex) = 0;
+    // Declared last, since destroying it writes the binaries that are still pending.
+    std::unique_ptr<PersistentCacheFile> mBinaryFile;
 };
 
 } // namespace gl
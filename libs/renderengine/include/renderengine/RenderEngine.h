@@ -28,12 +28,15 @@
 #include <sys/types.h>
 #include <ui/GraphicTypes.h>
 #include <ui/Transform.h>
+#include <utils/Timers.h>
 
 #include <future>
 #include <memory>
+#include <string>
+#include <vector>
 
 /**
- * Allows to set RenderEngine backend to GLES (default) or SkiaGL (NOT yet supported).
+ * Allows to set RenderEngine backend to GLES (default), SkiaGL or SkiaVk.
  */
 #define PROPERTY_DEBUG_RENDERENGINE_BACKEND "debug.renderengine.backend"
 
@@ -54,6 +57,25 @@
  */
 #define PROPERTY_SKIA_ATRACE_ENABLED "debug.renderengine.skia_atrace_enabled"
 
+/**
+ * Makes GLESRenderEngine only prime the programs that were used in previous runs, as recorded in
+ * its program binary cache, rather than every common permutation.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_LEARNED_PRIMING "debug.renderengine.learned_priming"
+
+/**
+ * Budget in MiB of the textures that SkiaRenderEngine keeps for mapped buffers, past which the
+ * least recently drawn ones are evicted.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_TEXTURE_CACHE_BUDGET_MB \
+    "debug.renderengine.texture_cache_budget_mb"
+
+/**
+ * Measures the GPU duration of each drawLayers call with timer queries, for dumpsys and
+ * FrameTimeline.
+ */
+#define PROPERTY_DEBUG_RENDERENGINE_GPU_TIMING "debug.renderengine.gpu_timing"
+
 struct ANativeWindowBuffer;
 
 namespace android {
@@ -96,6 +118,8 @@ public:
         THREADED = 2,
         SKIA_GL = 3,
         SKIA_GL_THREADED = 4,
+        SKIA_VK = 5,
+        SKIA_VK_THREADED = 6,
     };
 
     static std::unique_ptr<RenderEngine> create(const RenderEngineCreationArgs& args);
@@ -170,6 +194,19 @@ public:
                                 const bool useFramebufferCache, base::unique_fd&& bufferFence,
                                 base::unique_fd* drawFence) = 0;
 
+    struct DrawLayersResult {
+        status_t status = NO_ERROR;
+        base::unique_fd drawFence;
+    };
+
+    // Asynchronous variant of drawLayers, which may return before the layers are drawn, so that
+    // the caller can overlap its own work with rendering. The settings are copied, so they need
+    // not outlive the call. The default implementation draws the layers before returning.
+    virtual std::future<DrawLayersResult> drawLayersAsync(
+            const DisplaySettings& display, std::vector<LayerSettings> layers,
+            const std::shared_ptr<ExternalTexture>& buffer, const bool useFramebufferCache,
+            base::unique_fd&& bufferFence);
+
     // Clean-up method that should be called on the main thread after the
     // drawFence returned by drawLayers fires. This method will free up
     // resources used by the most recently drawn frame. If the frame is still
@@ -187,6 +224,19 @@ public:
     // query is required to be thread safe.
     virtual bool supportsBackgroundBlur() = 0;
 
+    // Time that the GPU spent on a drawLayers call.
+    struct GpuDuration {
+        // When the call started on the CPU.
+        nsecs_t drawStartTime = 0;
+        nsecs_t duration = 0;
+    };
+
+    // Returns the GPU durations of the drawLayers calls measured since the last call. They are
+    // only measured if PROPERTY_DEBUG_RENDERENGINE_GPU_TIMING is set and the GPU supports timer
+    // queries, and are reported some frames after the draws. This query is required to be thread
+    // safe.
+    virtual std::vector<GpuDuration> takeGpuDurations() { return {}; }
+
     // Returns the current type of RenderEngine instance that was created.
     // TODO(b/180767535): This is only implemented to allow for backend-specific behavior, which
     // we should not allow in general, so remove this.
@@ -246,6 +296,8 @@ struct RenderEngineCreationArgs {
     bool supportsBackgroundBlur;
     RenderEngine::ContextPriority contextPriority;
     RenderEngine::RenderEngineType renderEngineType;
+    // File that the compiled shaders are persisted to, if not empty.
+    std::string shaderCachePath;
 
     struct Builder;
 
@@ -255,7 +307,8 @@ private:
                              bool _enableProtectedContext, bool _precacheToneMapperShaderOnly,
                              bool _supportsBackgroundBlur,
                              RenderEngine::ContextPriority _contextPriority,
-                             RenderEngine::RenderEngineType _renderEngineType)
+                             RenderEngine::RenderEngineType _renderEngineType,
+                             std::string _shaderCachePath)
           : pixelFormat(_pixelFormat),
             imageCacheSize(_imageCacheSize),
             useColorManagement(_useColorManagement),
@@ -263,7 +316,8 @@ private:
             precacheToneMapperShaderOnly(_precacheToneMapperShaderOnly),
             supportsBackgroundBlur(_supportsBackgroundBlur),
             contextPriority(_contextPriority),
-            renderEngineType(_renderEngineType) {}
+            renderEngineType(_renderEngineType),
+            shaderCachePath(std::move(_shaderCachePath)) {}
     RenderEngineCreationArgs() = delete;
 };
 
@@ -302,10 +356,15 @@ struct RenderEngineCreationArgs::Builder {
         this->renderEngineType = renderEngineType;
         return *this;
     }
+    Builder& setShaderCachePath(std::string shaderCachePath) {
+        this->shaderCachePath = std::move(shaderCachePath);
+        return *this;
+    }
     RenderEngineCreationArgs build() const {
         return RenderEngineCreationArgs(pixelFormat, imageCacheSize, useColorManagement,
                                         enableProtectedContext, precacheToneMapperShaderOnly,
-                                        supportsBackgroundBlur, contextPriority, renderEngineType);
+                                        supportsBackgroundBlur, contextPriority, renderEngineType,
+                                        shaderCachePath);
     }
 
 private:
@@ -319,6 +378,7 @@ private:
     RenderEngine::ContextPriority contextPriority = RenderEngine::ContextPriority::MEDIUM;
     RenderEngine::RenderEngineType renderEngineType =
             RenderEngine::RenderEngineType::SKIA_GL_THREADED;
+    std::string shaderCachePath;
 };
 
 } // namespace renderengine
@@ -56,6 +56,7 @@ public:
     MOCK_METHOD0(cleanFramebufferCache, void());
     MOCK_METHOD0(getContextPriority, int());
     MOCK_METHOD0(supportsBackgroundBlur, bool());
+    MOCK_METHOD0(takeGpuDurations, std::vector<GpuDuration>());
     MOCK_METHOD1(onPrimaryDisplaySizeChanged, void(ui::Size));
     MOCK_METHOD0(getRETid, int());
 
@@ -423,6 +423,8 @@ void Cache::primeShaderCache(SkiaRenderEngine* renderengine) {
 
         const nsecs_t timeAfter = systemTime();
         const float compileTimeMs = static_cast<float>(timeAfter - timeBefore) / 1.0E6;
+        // Shaders persisted by a previous run are loaded rather than compiled, so only the ones
+        // missing from the persistent cache are counted.
         const int shadersCompiled = renderengine->reportShadersCompiled();
         ALOGD("Shader cache generated %d shaders in %f ms\n", shadersCompiled, compileTimeMs);
     }
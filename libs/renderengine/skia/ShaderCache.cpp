@@ -0,0 +1,108 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ShaderCache.h"
+
+#include <android-base/stringprintf.h>
+
+namespace android::renderengine::skia {
+
+using base::StringAppendF;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x43534552; // "RESC" in little endian
+
+std::string toString(const SkData& data) {
+    return std::string(static_cast<const char*>(data.data()), data.size());
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(std::string path) {
+    if (path.empty()) return;
+
+    mFile = std::make_unique<PersistentCacheFile>(std::move(path), kMagic, kVersion, [this] {
+        std::lock_guard lock(mMutex);
+        return mEntries;
+    });
+}
+
+ShaderCache::~ShaderCache() = default;
+
+void ShaderCache::initialize(const std::string& identity) {
+    if (!mFile) return;
+
+    PersistentCacheFile::Entries entries = mFile->read(identity);
+    size_t size = 0;
+    for (const auto& [key, data] : entries) {
+        size += key.size() + data.size();
+    }
+
+    std::lock_guard lock(mMutex);
+    mEntries = std::move(entries);
+    mSize = size;
+    mLoadedCount = mEntries.size();
+}
+
+sk_sp<SkData> ShaderCache::load(const SkData& key) {
+    std::lock_guard lock(mMutex);
+    const auto it = mEntries.find(toString(key));
+    if (it == mEntries.end()) return nullptr;
+
+    mLoadHits++;
+    return SkData::MakeWithCopy(it->second.data(), it->second.size());
+}
+
+void ShaderCache::store(const SkData& key, const SkData& data, const SkString&) {
+    std::lock_guard lock(mMutex);
+    mShadersCachedSinceLastCall++;
+
+    if (!mFile || mSize + key.size() + data.size() > kMaxSize) return;
+
+    auto [it, inserted] = mEntries.try_emplace(toString(key));
+    if (!inserted) {
+        mSize -= it->second.size();
+    } else {
+        mSize += key.size();
+    }
+    it->second = toString(data);
+    mSize += data.size();
+
+    mFile->scheduleWrite();
+}
+
+int ShaderCache::shadersCachedSinceLastCall() {
+    std::lock_guard lock(mMutex);
+    const int shadersCachedSinceLastCall = mShadersCachedSinceLastCall;
+    mShadersCachedSinceLastCall = 0;
+    return shadersCachedSinceLastCall;
+}
+
+void ShaderCache::dump(std::string& result) const {
+    if (!mFile) {
+        result.append("Shader cache: not persisted\n");
+        return;
+    }
+    std::lock_guard lock(mMutex);
+    StringAppendF(&result,
+                  "Shader cache: %s, %zu shaders (%zu bytes), %zu loaded at startup, %zu hits, "
+                  "%zu saves\n",
+                  mFile->getPath().c_str(), mEntries.size(), mSize, mLoadedCount, mLoadHits,
+                  mFile->getWriteCount());
+}
+
+} // namespace android::renderengine::skia
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <GrContextOptions.h>
+#include <SkData.h>
+#include <android-base/thread_annotations.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "../PersistentCacheFile.h"
+
+namespace android::renderengine::skia {
+
+// Cache of the program binaries that Skia compiles, which persists them to a file so that the
+// shaders compiled by a previous SurfaceFlinger run do not need to be compiled again. The file is
+// tagged with the driver and Skia version that wrote it.
+class ShaderCache : public GrContextOptions::PersistentCache {
+public:
+    // The cache is kept in memory only if the path is empty.
+    explicit ShaderCache(std::string path);
+    ~ShaderCache() override;
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // Loads the file, if it was written for the same identity. Must be called before the cache
+    // is handed to Skia.
+    void initialize(const std::string& identity);
+
+    sk_sp<SkData> load(const SkData& key) override;
+    void store(const SkData& key, const SkData& data, const SkString& description) override;
+
+    // Number of shaders that Skia compiled, rather than loaded, since the last call.
+    int shadersCachedSinceLastCall();
+
+    void dump(std::string& result) const;
+
+private:
+    // Bumped whenever the layout of the entries changes.
+    static constexpr uint32_t kVersion = 1;
+    // The cache stops growing past this size, since it is read in full at startup.
+    static constexpr size_t kMaxSize = 2 * 1024 * 1024;
+
+    mutable std::mutex mMutex;
+    PersistentCacheFile::Entries mEntries GUARDED_BY(mMutex);
+    size_t mSize GUARDED_BY(mMutex) = 0;
+
+    int mShadersCachedSinceLastCall GUARDED_BY(mMutex) = 0;
+    size_t mLoadedCount GUARDED_BY(mMutex) = 0;
+    size_t mLoadHits GUARDED_BY(mMutex) = 0;
+
+    // Declared last, since destroying it writes the entries that are still pending.
+    std::unique_ptr<PersistentCacheFile> mFile;
+};
+
+} // namespace android::renderengine::skia
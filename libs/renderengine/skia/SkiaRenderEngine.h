@@ -17,9 +17,30 @@
 #ifndef SF_SKIARENDERENGINE_H_
 #define SF_SKIARENDERENGINE_H_
 
+#include <GrDirectContext.h>
+#include <SkSurface.h>
+#include <android-base/thread_annotations.h>
+#include <renderengine/ExternalTexture.h>
 #include <renderengine/RenderEngine.h>
 #include <sys/types.h>
 
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "AutoBackendTexture.h"
+#include "GrContextOptions.h"
+#include "SkImageInfo.h"
+#include "ShaderCache.h"
+#include "TextureCache.h"
+#include "android-base/macros.h"
+#include "debug/SkiaCapture.h"
+#include "filters/BlurCache.h"
+#include "filters/BlurFilter.h"
+#include "filters/LinearEffect.h"
+#include "filters/StretchShaderFactory.h"
+
 namespace android {
 
 namespace renderengine {
@@ -31,40 +52,148 @@ namespace skia {
 
 class BlurFilter;
 
-// TODO: Put common skia stuff here that can be shared between the GL & Vulkan backends
-// Currently mostly just handles all the no-op / missing APIs
+// Draws with Skia, independently of the GPU API that Skia targets. The backends create the
+// GrContexts and implement the context switches and synchronization that their API requires.
 class SkiaRenderEngine : public RenderEngine {
 public:
     static std::unique_ptr<SkiaRenderEngine> create(const RenderEngineCreationArgs& args);
-    SkiaRenderEngine(RenderEngineType type);
-    ~SkiaRenderEngine() override {}
-
-    virtual std::future<void> primeCache() override { return {}; };
-    virtual void genTextures(size_t /*count*/, uint32_t* /*names*/) override{};
-    virtual void deleteTextures(size_t /*count*/, uint32_t const* /*names*/) override{};
-    virtual bool isProtected() const override { return false; } // mInProtectedContext; }
-    virtual bool supportsProtectedContent() const override { return false; };
-    virtual status_t drawLayers(const DisplaySettings& /*display*/,
-                                const std::vector<const LayerSettings*>& /*layers*/,
-                                const std::shared_ptr<ExternalTexture>& /*buffer*/,
-                                const bool /*useFramebufferCache*/,
-                                base::unique_fd&& /*bufferFence*/,
-                                base::unique_fd* /*drawFence*/) override {
-        return 0;
-    };
-    virtual int getContextPriority() override { return 0; }
-    virtual void assertShadersCompiled(int numShaders) {}
-    virtual int reportShadersCompiled() { return 0; }
-    void setViewportAndProjection(Rect /*viewPort*/, Rect /*sourceCrop*/) override { }
+    // The shaders that Skia compiles are persisted to shaderCachePath, if not empty.
+    SkiaRenderEngine(const RenderEngineCreationArgs& args, std::string shaderCachePath);
+    ~SkiaRenderEngine() override EXCLUDES(mRenderingMutex);
+
+    std::future<void> primeCache() override;
+    void genTextures(size_t /*count*/, uint32_t* /*names*/) override{};
+    void deleteTextures(size_t /*count*/, uint32_t const* /*names*/) override{};
+    status_t drawLayers(const DisplaySettings& display,
+                        const std::vector<const LayerSettings*>& layers,
+                        const std::shared_ptr<ExternalTexture>& buffer,
+                        const bool useFramebufferCache, base::unique_fd&& bufferFence,
+                        base::unique_fd* drawFence) override;
+    void cleanupPostRender() override;
+    void cleanFramebufferCache() override{};
+    bool isProtected() const override { return mInProtectedContext; }
+    bool supportsProtectedContent() const override;
+    void useProtectedContext(bool useProtectedContext) override;
+    bool supportsBackgroundBlur() override { return mBlurFilter != nullptr; }
+    void assertShadersCompiled(int numShaders) override;
+    void onPrimaryDisplaySizeChanged(ui::Size size) override;
+    int reportShadersCompiled() override;
+    void setViewportAndProjection(Rect /*viewPort*/, Rect /*sourceCrop*/) override {}
+    int getRETid() { return gettid(); }
 
 protected:
-    virtual void mapExternalTextureBuffer(const sp<GraphicBuffer>& /*buffer*/,
-                                          bool /*isRenderable*/) override = 0;
-    virtual void unmapExternalTextureBuffer(const sp<GraphicBuffer>& /*buffer*/) override = 0;
+    using Contexts = std::pair<sk_sp<GrDirectContext>, sk_sp<GrDirectContext>>;
+
+    // Creates the unprotected and, if supported, protected GrContexts. Must be called at the end
+    // of the backend's constructor, with the identity of the driver that compiles the shaders.
+    void initializeGrContexts(const std::string& shaderCacheIdentity);
+    // Releases the GPU resources and abandons the GrContexts. Must be called at the start of the
+    // backend's destructor, while the objects that the contexts use are still alive.
+    void finishRenderingAndAbandonContexts() EXCLUDES(mRenderingMutex);
+
+    // Implemented by the backends. The contexts are created with the unprotected one current.
+    virtual Contexts createDirectContexts(const GrContextOptions& options) = 0;
+    virtual bool supportsProtectedContentImpl() const = 0;
+    // Makes the protected or unprotected context current, returning whether it could.
+    virtual bool useProtectedContextImpl(GrProtected isProtected) = 0;
+    // Makes the GPU wait for the fence before running the commands submitted after this.
+    virtual void waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) = 0;
+    // Submits the commands that Skia flushed for the surface. The fence signals once the GPU is
+    // done with them; if none is requested, or one cannot be created, waits for the GPU instead.
+    virtual status_t flushAndSubmit(GrDirectContext* grContext, SkSurface* surface,
+                                    base::unique_fd* drawFence) = 0;
+    virtual void appendBackendSpecificInfoToDump(std::string& result) = 0;
+    // Called before Skia records the commands of each drawLayers call, and after they are flushed
+    // to the GPU API but before they are submitted.
+    virtual void onDrawBegin() {}
+    virtual void onDrawEnd() {}
+
+    void dump(std::string& result) override;
+    size_t getMaxTextureSize() const override;
+    size_t getMaxViewportDims() const override;
+    void mapExternalTextureBuffer(const sp<GraphicBuffer>& buffer, bool isRenderable) override;
+    void unmapExternalTextureBuffer(const sp<GraphicBuffer>& buffer) override;
+    bool canSkipPostRenderCleanup() const override;
+
+    // Mutex guarding rendering operations, so that:
+    // 1. GPU operations aren't interleaved, and
+    // 2. Internal state related to rendering that is potentially modified by
+    // multiple threads is guaranteed thread-safe.
+    mutable std::mutex mRenderingMutex;
+
+    // Graphics context used for creating surfaces and submitting commands
+    sk_sp<GrDirectContext> mGrContext;
+    // Same as above, but for protected content (eg. DRM)
+    sk_sp<GrDirectContext> mProtectedGrContext;
+    bool mInProtectedContext = false;
+
+private:
+    inline SkRect getSkRect(const FloatRect& layer);
+    inline SkRect getSkRect(const Rect& layer);
+    inline std::pair<SkRRect, SkRRect> getBoundsAndClip(const FloatRect& bounds,
+                                                        const FloatRect& crop, float cornerRadius);
+    inline bool layerHasBlur(const LayerSettings* layer, bool colorTransformModifiesAlpha);
+    inline SkColor getSkColor(const vec4& color);
+    inline SkM44 getSkM44(const mat4& matrix);
+    inline SkPoint3 getSkPoint3(const vec3& vector);
+    inline GrDirectContext* getActiveGrContext() const;
+    bool isThreaded() const;
+    TextureCache& getTextureCache(bool isProtected) REQUIRES(mRenderingMutex);
+    AutoBackendTexture::CleanupManager& getTextureCleanupManager(bool isProtected)
+            REQUIRES(mRenderingMutex);
+
+    void initCanvas(SkCanvas* canvas, const DisplaySettings& display);
+    void drawShadow(SkCanvas* canvas, const SkRRect& casterRRect,
+                    const ShadowSettings& shadowSettings);
+    // If requiresLinearEffect is true or the layer has a stretchEffect a new shader is returned.
+    // Otherwise it returns the input shader.
+    sk_sp<SkShader> createRuntimeEffectShader(sk_sp<SkShader> shader,
+                                              const LayerSettings* layer,
+                                              const DisplaySettings& display,
+                                              bool undoPremultipliedAlpha,
+                                              bool requiresLinearEffect);
+
+    BlurFilter* mBlurFilter = nullptr;
+    // Blurs reused while the content beneath them is unchanged.
+    BlurCache mBlurCache GUARDED_BY(mRenderingMutex);
+
+    const PixelFormat mDefaultPixelFormat;
+    const bool mUseColorManagement;
+
+    // Identifier used or various mappings of layers to various
+    // textures or shaders
+    using GraphicBufferId = uint64_t;
+
+    // Number of external holders of ExternalTexture references, per GraphicBuffer ID.
+    std::unordered_map<GraphicBufferId, int32_t> mGraphicBufferExternalRefs
+            GUARDED_BY(mRenderingMutex);
+    // Cache of textures that we'll store per GraphicBuffer ID, shared between GPU contexts.
+    TextureCache mTextureCache GUARDED_BY(mRenderingMutex);
+    std::unordered_map<LinearEffect, sk_sp<SkRuntimeEffect>, LinearEffectHasher> mRuntimeEffects;
+    AutoBackendTexture::CleanupManager mTextureCleanupMgr GUARDED_BY(mRenderingMutex);
+    // Same as above, but for protected buffers, whose textures may only be created and deleted
+    // while the protected context is current.
+    TextureCache mProtectedTextureCache GUARDED_BY(mRenderingMutex);
+    AutoBackendTexture::CleanupManager mProtectedTextureCleanupMgr GUARDED_BY(mRenderingMutex);
+
+    StretchShaderFactory mStretchShaderFactory;
+
+    sp<Fence> mLastDrawFence;
+
+    // Statistics of the switches between the protected and unprotected contexts.
+    size_t mContextSwitchCount = 0;
+    nsecs_t mLastContextSwitchDuration = 0;
+    nsecs_t mMaxContextSwitchDuration = 0;
+    nsecs_t mTotalContextSwitchDuration = 0;
+    // Object to capture commands send to Skia.
+    std::unique_ptr<SkiaCapture> mCapture;
+
+    // Persists the shaders that Skia compiles, and counts the ones it had to compile.
+    ShaderCache mShaderCache;
 };
 
 } // namespace skia
 } // namespace renderengine
 } // namespace android
 
-#endif /* SF_GLESRENDERENGINE_H_ */
+#endif /* SF_SKIARENDERENGINE_H_ */
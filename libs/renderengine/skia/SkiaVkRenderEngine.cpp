@@ -0,0 +1,218 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "SkiaVkRenderEngine.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GrBackendSemaphore.h>
+#include <GrBackendSurfaceMutableState.h>
+#include <GrContextOptions.h>
+#include <SkMilestone.h>
+#include <android-base/properties.h>
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <sync/sync.h>
+#include <utils/Trace.h>
+
+#include <memory>
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+namespace {
+
+std::string getShaderCachePath(const RenderEngineCreationArgs& args) {
+    // Skia's Vulkan pipelines cannot be loaded by the GL backend, nor the other way around.
+    return args.shaderCachePath.empty() ? std::string() : args.shaderCachePath + ".vk";
+}
+
+// Destroys the semaphore signaled by a flush, once the GPU is done with the flushed work.
+struct SemaphoreCleanup {
+    VulkanInterface* vulkan;
+    VkSemaphore semaphore;
+
+    static void destroy(GrGpuFinishedContext context) {
+        SemaphoreCleanup* cleanup = static_cast<SemaphoreCleanup*>(context);
+        cleanup->vulkan->destroySemaphore(cleanup->semaphore);
+        delete cleanup;
+    }
+};
+
+} // namespace
+
+std::unique_ptr<SkiaVkRenderEngine> SkiaVkRenderEngine::create(
+        const RenderEngineCreationArgs& args) {
+    std::unique_ptr<VulkanInterface> vulkan =
+            VulkanInterface::create(args.enableProtectedContext, args.contextPriority);
+    if (!vulkan) {
+        return nullptr;
+    }
+    return std::make_unique<SkiaVkRenderEngine>(args, std::move(vulkan));
+}
+
+bool SkiaVkRenderEngine::canSupportSkiaVkRenderEngine() {
+    return VulkanInterface::create(false, std::nullopt) != nullptr;
+}
+
+SkiaVkRenderEngine::SkiaVkRenderEngine(const RenderEngineCreationArgs& args,
+                                       std::unique_ptr<VulkanInterface> vulkan)
+      : SkiaRenderEngine(args, getShaderCachePath(args)), mVulkan(std::move(vulkan)) {
+    // Pipelines are only valid for the driver that built them, which the build fingerprint
+    // covers for drivers updated along with the system.
+    const VkPhysicalDeviceProperties& properties = mVulkan->getPhysicalDeviceProperties();
+    std::string pipelineCacheUuid;
+    for (uint8_t byte : properties.pipelineCacheUUID) {
+        base::StringAppendF(&pipelineCacheUuid, "%02x", byte);
+    }
+    initializeGrContexts(base::StringPrintf("%s/%08x/%08x/%08x/%s/skia-vk-%d/%s",
+                                            properties.deviceName, properties.vendorID,
+                                            properties.deviceID, properties.driverVersion,
+                                            pipelineCacheUuid.c_str(), SK_MILESTONE,
+                                            base::GetProperty("ro.build.fingerprint", "").c_str()));
+}
+
+SkiaVkRenderEngine::~SkiaVkRenderEngine() {
+    finishRenderingAndAbandonContexts();
+}
+
+std::future<void> SkiaVkRenderEngine::primeCache() {
+    std::future<void> result = SkiaRenderEngine::primeCache();
+    // Skia only hands the pipeline cache over to the shader cache when asked to, so persist the
+    // pipelines created while priming.
+    std::lock_guard<std::mutex> lock(mRenderingMutex);
+    mGrContext->storeVkPipelineCacheData();
+    return result;
+}
+
+int SkiaVkRenderEngine::getContextPriority() {
+    // Reported the way the EGL backends do, since SurfaceFlinger hands it to its clients.
+    switch (mVulkan->getQueuePriority().value_or(ContextPriority::MEDIUM)) {
+        case ContextPriority::LOW:
+            return EGL_CONTEXT_PRIORITY_LOW_IMG;
+        case ContextPriority::HIGH:
+            return EGL_CONTEXT_PRIORITY_HIGH_IMG;
+        case ContextPriority::REALTIME:
+            return EGL_CONTEXT_PRIORITY_REALTIME_NV;
+        case ContextPriority::MEDIUM:
+        default:
+            return EGL_CONTEXT_PRIORITY_MEDIUM_IMG;
+    }
+}
+
+SkiaRenderEngine::Contexts SkiaVkRenderEngine::createDirectContexts(
+        const GrContextOptions& options) {
+    Contexts contexts;
+    contexts.first = GrDirectContext::MakeVulkan(mVulkan->getBackendContext(GrProtected::kNo),
+                                                 options);
+    if (supportsProtectedContentImpl()) {
+        contexts.second =
+                GrDirectContext::MakeVulkan(mVulkan->getBackendContext(GrProtected::kYes),
+                                            options);
+    }
+    return contexts;
+}
+
+bool SkiaVkRenderEngine::supportsProtectedContentImpl() const {
+    return mVulkan->supportsProtectedContent();
+}
+
+bool SkiaVkRenderEngine::useProtectedContextImpl(GrProtected isProtected) {
+    // Each context submits to its own queue, so there is nothing to make current.
+    return isProtected == GrProtected::kNo || supportsProtectedContentImpl();
+}
+
+void SkiaVkRenderEngine::waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) {
+    if (fenceFd.get() < 0) {
+        return;
+    }
+
+    // The semaphore takes ownership of the fd it imports.
+    base::unique_fd fenceDup(dup(fenceFd.get()));
+    VkSemaphore semaphore = fenceDup.get() >= 0 ? mVulkan->importSemaphoreFromSyncFd(fenceDup)
+                                                : VK_NULL_HANDLE;
+    if (semaphore != VK_NULL_HANDLE) {
+        GrBackendSemaphore backendSemaphore;
+        backendSemaphore.initVulkan(semaphore);
+        if (grContext->wait(1, &backendSemaphore, true /* deleteSemaphoresAfterWait */)) {
+            return;
+        }
+        mVulkan->destroySemaphore(semaphore);
+    }
+
+    ATRACE_NAME("SkiaVkRenderEngine::waitFence");
+    sync_wait(fenceFd.get(), -1);
+}
+
+status_t SkiaVkRenderEngine::flushAndSubmit(GrDirectContext* grContext, SkSurface* surface,
+                                            base::unique_fd* drawFence) {
+    VkSemaphore semaphore =
+            drawFence != nullptr ? mVulkan->createExportableSemaphore() : VK_NULL_HANDLE;
+    GrBackendSemaphore backendSemaphore;
+    GrFlushInfo flushInfo;
+    if (semaphore != VK_NULL_HANDLE) {
+        backendSemaphore.initVulkan(semaphore);
+        flushInfo.fNumSemaphores = 1;
+        flushInfo.fSignalSemaphores = &backendSemaphore;
+        // Skia calls it even if the flush fails.
+        flushInfo.fFinishedProc = SemaphoreCleanup::destroy;
+        flushInfo.fFinishedContext = new SemaphoreCleanup{mVulkan.get(), semaphore};
+    }
+
+    // The output buffer is read by the display or by the client next, outside of this device, so
+    // hand it over to the foreign queue family without changing its layout.
+    const GrBackendSurfaceMutableState releasedState(VK_IMAGE_LAYOUT_UNDEFINED,
+                                                     VK_QUEUE_FAMILY_FOREIGN_EXT);
+    const GrSemaphoresSubmitted submitted = surface->flush(flushInfo, &releasedState);
+
+    // The semaphore can only be exported once its signal operation is submitted, so submit
+    // first, waiting for the GPU unless a fence is wanted.
+    bool requireSync = semaphore == VK_NULL_HANDLE || submitted == GrSemaphoresSubmitted::kNo;
+    if (requireSync) {
+        ATRACE_BEGIN("Submit(sync=true)");
+    } else {
+        ATRACE_BEGIN("Submit(sync=false)");
+    }
+    bool success = grContext->submit(requireSync);
+    ATRACE_END();
+    if (!success) {
+        ALOGE("Failed to flush RenderEngine commands");
+        return INVALID_OPERATION;
+    }
+
+    if (drawFence != nullptr) {
+        *drawFence = requireSync ? base::unique_fd() : mVulkan->exportSemaphoreSyncFd(semaphore);
+        if (!requireSync && drawFence->get() < 0) {
+            ATRACE_NAME("Submit(sync=true)");
+            grContext->submit(true);
+        }
+    }
+    return NO_ERROR;
+}
+
+void SkiaVkRenderEngine::appendBackendSpecificInfoToDump(std::string& result) {
+    mVulkan->dump(result);
+}
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SF_SKIAVKRENDERENGINE_H_
+#define SF_SKIAVKRENDERENGINE_H_
+
+#include <GrDirectContext.h>
+#include <SkSurface.h>
+#include <android-base/thread_annotations.h>
+#include <renderengine/RenderEngine.h>
+
+#include <memory>
+
+#include "GrContextOptions.h"
+#include "SkiaRenderEngine.h"
+#include "VulkanInterface.h"
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+class SkiaVkRenderEngine : public skia::SkiaRenderEngine {
+public:
+    // Returns null if the device cannot run RenderEngine on Vulkan.
+    static std::unique_ptr<SkiaVkRenderEngine> create(const RenderEngineCreationArgs& args);
+    static bool canSupportSkiaVkRenderEngine();
+    SkiaVkRenderEngine(const RenderEngineCreationArgs& args,
+                       std::unique_ptr<VulkanInterface> vulkan);
+    ~SkiaVkRenderEngine() override EXCLUDES(mRenderingMutex);
+
+    std::future<void> primeCache() override;
+    int getContextPriority() override;
+
+protected:
+    Contexts createDirectContexts(const GrContextOptions& options) override;
+    bool supportsProtectedContentImpl() const override;
+    bool useProtectedContextImpl(GrProtected isProtected) override;
+    void waitFence(GrDirectContext* grContext, base::borrowed_fd fenceFd) override;
+    status_t flushAndSubmit(GrDirectContext* grContext, SkSurface* surface,
+                            base::unique_fd* drawFence) override;
+    void appendBackendSpecificInfoToDump(std::string& result) override;
+
+private:
+    std::unique_ptr<VulkanInterface> mVulkan;
+};
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
+
+#endif /* SF_SKIAVKRENDERENGINE_H_ */
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "TextureCache.h"
+
+#include <android-base/stringprintf.h>
+#include <ui/PixelFormat.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+using base::StringAppendF;
+
+TextureCache::TextureCache(const char* name, size_t budgetBytes)
+      : mName(name), mBudgetBytes(budgetBytes) {}
+
+TextureCache::Ref TextureCache::get(GraphicBufferId id, nsecs_t now) {
+    const auto it = mEntries.find(id);
+    if (it == mEntries.end()) return nullptr;
+
+    Entry& entry = it->second;
+    entry.lastUsedTime = now;
+    mUsage.splice(mUsage.begin(), mUsage, entry.usage);
+    return entry.ref;
+}
+
+void TextureCache::insert(const GraphicBuffer& buffer, bool isOutputBuffer, Ref ref,
+                          nsecs_t now) {
+    const GraphicBufferId id = buffer.getId();
+    if (mEntries.count(id)) return;
+
+    const Kind kind = getKind(buffer, isOutputBuffer);
+    const size_t bytes = getSizeBytes(buffer);
+    mUsage.push_front(id);
+    mEntries.emplace(id, Entry{std::move(ref), kind, bytes, now, mUsage.begin()});
+
+    mBytes += bytes;
+    mKindCounts[static_cast<size_t>(kind)]++;
+    mKindBytes[static_cast<size_t>(kind)] += bytes;
+}
+
+void TextureCache::reinsert(const GraphicBuffer& buffer, bool isOutputBuffer, Ref ref,
+                            nsecs_t now) {
+    mReinsertions++;
+    insert(buffer, isOutputBuffer, std::move(ref), now);
+}
+
+void TextureCache::erase(GraphicBufferId id) {
+    if (const auto it = mEntries.find(id); it != mEntries.end()) {
+        evict(it);
+    }
+}
+
+void TextureCache::clear() {
+    while (!mEntries.empty()) {
+        evict(mEntries.begin());
+    }
+}
+
+void TextureCache::trim(nsecs_t now) {
+    if (mEntries.empty()) return;
+    ATRACE_CALL();
+
+    // Keep at least the most recently used texture, which is being drawn if the budget is small.
+    while (mBytes > mBudgetBytes && mUsage.size() > 1) {
+        evict(mEntries.find(mUsage.back()));
+        mBudgetEvictions++;
+    }
+    while (!mUsage.empty()) {
+        const auto it = mEntries.find(mUsage.back());
+        if (now - it->second.lastUsedTime < kMaxUnusedTime) break;
+        evict(it);
+        mStaleEvictions++;
+    }
+}
+
+void TextureCache::evict(std::unordered_map<GraphicBufferId, Entry>::iterator it) {
+    const Entry& entry = it->second;
+    mBytes -= entry.bytes;
+    mKindCounts[static_cast<size_t>(entry.kind)]--;
+    mKindBytes[static_cast<size_t>(entry.kind)] -= entry.bytes;
+    mUsage.erase(entry.usage);
+    // The texture is deleted once the last reference to it is dropped, which the cleanup manager
+    // defers until the end of the frame if it is being drawn.
+    mEntries.erase(it);
+}
+
+TextureCache::Kind TextureCache::getKind(const GraphicBuffer& buffer, bool isOutputBuffer) {
+    if (isOutputBuffer) return Kind::Output;
+
+    switch (buffer.getPixelFormat()) {
+        case PIXEL_FORMAT_RGBA_8888:
+        case PIXEL_FORMAT_RGBX_8888:
+        case PIXEL_FORMAT_BGRA_8888:
+            return Kind::Rgba8888;
+        case PIXEL_FORMAT_RGBA_1010102:
+            return Kind::Rgba1010102;
+        case PIXEL_FORMAT_RGBA_FP16:
+            return Kind::RgbaFp16;
+        case HAL_PIXEL_FORMAT_YCBCR_420_888:
+        case HAL_PIXEL_FORMAT_YCRCB_420_SP:
+        case HAL_PIXEL_FORMAT_YV12:
+        case HAL_PIXEL_FORMAT_YCBCR_P010:
+            return Kind::Yuv;
+        default:
+            return Kind::Other;
+    }
+}
+
+size_t TextureCache::getSizeBytes(const GraphicBuffer& buffer) {
+    const size_t pixels = static_cast<size_t>(buffer.getStride()) * buffer.getHeight() *
+            buffer.getLayerCount();
+    if (const uint32_t bytesPerPixel = android::bytesPerPixel(buffer.getPixelFormat())) {
+        return pixels * bytesPerPixel;
+    }
+    // YUV and vendor formats, which are mostly 4:2:0 with 8 or 10 bit samples.
+    return buffer.getPixelFormat() == HAL_PIXEL_FORMAT_YCBCR_P010 ? pixels * 3 : pixels * 3 / 2;
+}
+
+const char* TextureCache::toString(Kind kind) {
+    switch (kind) {
+        case Kind::Output:
+            return "output";
+        case Kind::Rgba8888:
+            return "RGBA_8888";
+        case Kind::Rgba1010102:
+            return "RGBA_1010102";
+        case Kind::RgbaFp16:
+            return "RGBA_FP16";
+        case Kind::Yuv:
+            return "YUV";
+        case Kind::Other:
+            return "other";
+    }
+}
+
+void TextureCache::dump(std::string& result) const {
+    StringAppendF(&result,
+                  "%s: %zu textures, %zu of %zu KiB, %zu evicted over budget, %zu evicted "
+                  "unused, %zu cached again\n",
+                  mName, mEntries.size(), mBytes / 1024, mBudgetBytes / 1024, mBudgetEvictions,
+                  mStaleEvictions, mReinsertions);
+    for (size_t i = 0; i < kKindCount; i++) {
+        if (mKindCounts[i] == 0) continue;
+        StringAppendF(&result, "- %s: %zu textures, %zu KiB\n", toString(static_cast<Kind>(i)),
+                      mKindCounts[i], mKindBytes[i] / 1024);
+    }
+    StringAppendF(&result, "Dumping buffer ids, most recently used first...\n");
+    for (const GraphicBufferId id : mUsage) {
+        const Entry& entry = mEntries.at(id);
+        StringAppendF(&result, "- 0x%" PRIx64 " - %s, %zu KiB\n", id, toString(entry.kind),
+                      entry.bytes / 1024);
+    }
+}
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
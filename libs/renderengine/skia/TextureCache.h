@@ -0,0 +1,100 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <ui/GraphicBuffer.h>
+#include <utils/Timers.h>
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "AutoBackendTexture.h"
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+// Cache of the textures of the buffers mapped into RenderEngine, keyed by buffer id. Once the
+// textures add up to more than the budget, the least recently drawn ones are evicted, as are the
+// ones that were not drawn for a while, so that buffers which stay mapped but are no longer
+// composited by the GPU do not keep their textures. A buffer that is drawn after its texture
+// was evicted is cached again.
+class TextureCache {
+public:
+    using GraphicBufferId = uint64_t;
+    using Ref = std::shared_ptr<AutoBackendTexture::LocalRef>;
+
+    // The name describes the cache in dumps.
+    TextureCache(const char* name, size_t budgetBytes);
+
+    // Returns the cached texture, or nullptr, marking it as used.
+    Ref get(GraphicBufferId id, nsecs_t now);
+    void insert(const GraphicBuffer& buffer, bool isOutputBuffer, Ref ref, nsecs_t now);
+    // Inserts the texture of a buffer that is still mapped, but whose texture was evicted.
+    void reinsert(const GraphicBuffer& buffer, bool isOutputBuffer, Ref ref, nsecs_t now);
+    void erase(GraphicBufferId id);
+    // Evicts every texture, before the GPU context that created them goes away.
+    void clear();
+
+    // Evicts the textures over the budget, and the ones not used since kMaxUnusedTime.
+    void trim(nsecs_t now);
+
+    size_t size() const { return mEntries.size(); }
+    void dump(std::string& result) const;
+
+private:
+    static constexpr nsecs_t kMaxUnusedTime = s2ns(30);
+
+    enum class Kind { Output, Rgba8888, Rgba1010102, RgbaFp16, Yuv, Other };
+    static constexpr size_t kKindCount = static_cast<size_t>(Kind::Other) + 1;
+
+    static Kind getKind(const GraphicBuffer& buffer, bool isOutputBuffer);
+    static size_t getSizeBytes(const GraphicBuffer& buffer);
+    static const char* toString(Kind kind);
+
+    struct Entry {
+        Ref ref;
+        Kind kind;
+        size_t bytes;
+        nsecs_t lastUsedTime;
+        // Position in mUsage.
+        std::list<GraphicBufferId>::iterator usage;
+    };
+
+    void evict(std::unordered_map<GraphicBufferId, Entry>::iterator it);
+
+    const char* const mName;
+    const size_t mBudgetBytes;
+    std::unordered_map<GraphicBufferId, Entry> mEntries;
+    // Most recently used first.
+    std::list<GraphicBufferId> mUsage;
+
+    size_t mBytes = 0;
+    std::array<size_t, kKindCount> mKindCounts = {};
+    std::array<size_t, kKindCount> mKindBytes = {};
+    size_t mBudgetEvictions = 0;
+    size_t mStaleEvictions = 0;
+    size_t mReinsertions = 0;
+};
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
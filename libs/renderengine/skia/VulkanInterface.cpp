@@ -0,0 +1,412 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "RenderEngine"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "VulkanInterface.h"
+
+#include <android-base/stringprintf.h>
+#include <log/log.h>
+#include <utils/Trace.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace android::renderengine::skia {
+
+using base::StringAppendF;
+
+namespace {
+
+// Needed to sample and render to AHardwareBuffers, and to exchange fences with the rest of the
+// system, on top of what Vulkan 1.1 provides.
+constexpr const char* kRequiredDeviceExtensions[] = {
+        VK_ANDROID_EXTERNAL_MEMORY_ANDROID_HARDWARE_BUFFER_EXTENSION_NAME,
+        VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME,
+        VK_EXT_QUEUE_FAMILY_FOREIGN_EXTENSION_NAME,
+};
+
+bool contains(const std::vector<std::string>& names, const char* name) {
+    return std::find(names.begin(), names.end(), name) != names.end();
+}
+
+std::vector<const char*> toCStrings(const std::vector<std::string>& names) {
+    std::vector<const char*> result;
+    result.reserve(names.size());
+    for (const std::string& name : names) {
+        result.push_back(name.c_str());
+    }
+    return result;
+}
+
+VkQueueGlobalPriorityEXT toGlobalPriority(RenderEngine::ContextPriority priority) {
+    switch (priority) {
+        case RenderEngine::ContextPriority::LOW:
+            return VK_QUEUE_GLOBAL_PRIORITY_LOW_EXT;
+        case RenderEngine::ContextPriority::MEDIUM:
+            return VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_EXT;
+        case RenderEngine::ContextPriority::HIGH:
+            return VK_QUEUE_GLOBAL_PRIORITY_HIGH_EXT;
+        case RenderEngine::ContextPriority::REALTIME:
+            return VK_QUEUE_GLOBAL_PRIORITY_REALTIME_EXT;
+    }
+    return VK_QUEUE_GLOBAL_PRIORITY_MEDIUM_EXT;
+}
+
+const char* toString(std::optional<RenderEngine::ContextPriority> priority) {
+    if (!priority) return "default";
+    switch (*priority) {
+        case RenderEngine::ContextPriority::LOW:
+            return "low";
+        case RenderEngine::ContextPriority::MEDIUM:
+            return "medium";
+        case RenderEngine::ContextPriority::HIGH:
+            return "high";
+        case RenderEngine::ContextPriority::REALTIME:
+            return "realtime";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+std::unique_ptr<VulkanInterface> VulkanInterface::create(
+        bool enableProtectedQueue, std::optional<RenderEngine::ContextPriority> priority) {
+    ATRACE_CALL();
+    std::unique_ptr<VulkanInterface> vulkan(new VulkanInterface());
+    if (!vulkan->initialize(enableProtectedQueue, priority)) {
+        return nullptr;
+    }
+    return vulkan;
+}
+
+VulkanInterface::~VulkanInterface() {
+    if (mDevice != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(mDevice);
+        vkDestroyDevice(mDevice, nullptr);
+    }
+    if (mInstance != VK_NULL_HANDLE) {
+        vkDestroyInstance(mInstance, nullptr);
+    }
+}
+
+bool VulkanInterface::initialize(bool enableProtectedQueue,
+                                 std::optional<RenderEngine::ContextPriority> priority) {
+    uint32_t instanceVersion = 0;
+    if (vkEnumerateInstanceVersion(&instanceVersion) != VK_SUCCESS ||
+        instanceVersion < VK_API_VERSION_1_1) {
+        ALOGW("Vulkan 1.1 is not supported");
+        return false;
+    }
+
+    uint32_t count = 0;
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> instanceExtensions(count);
+    vkEnumerateInstanceExtensionProperties(nullptr, &count, instanceExtensions.data());
+    for (const VkExtensionProperties& extension : instanceExtensions) {
+        // Debug reporting would only slow the composition down.
+        if (strcmp(extension.extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) == 0) continue;
+        mInstanceExtensionNames.emplace_back(extension.extensionName);
+    }
+
+    mApiVersion = VK_API_VERSION_1_1;
+    const VkApplicationInfo appInfo = {
+            .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+            .pApplicationName = "surfaceflinger",
+            .pEngineName = "RenderEngine",
+            .apiVersion = mApiVersion,
+    };
+    const std::vector<const char*> instanceExtensionNames = toCStrings(mInstanceExtensionNames);
+    const VkInstanceCreateInfo instanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+            .pApplicationInfo = &appInfo,
+            .enabledExtensionCount = static_cast<uint32_t>(instanceExtensionNames.size()),
+            .ppEnabledExtensionNames = instanceExtensionNames.data(),
+    };
+    if (VkResult result = vkCreateInstance(&instanceInfo, nullptr, &mInstance);
+        result != VK_SUCCESS) {
+        ALOGW("Failed to create a Vulkan instance: %d", result);
+        mInstance = VK_NULL_HANDLE;
+        return false;
+    }
+
+    // Like the rest of the system, draw with the first device.
+    count = 1;
+    if (vkEnumeratePhysicalDevices(mInstance, &count, &mPhysicalDevice) < VK_SUCCESS ||
+        count == 0) {
+        ALOGW("No Vulkan device");
+        return false;
+    }
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &mPhysicalDeviceProperties);
+    if (mPhysicalDeviceProperties.apiVersion < VK_API_VERSION_1_1) {
+        ALOGW("%s does not support Vulkan 1.1", mPhysicalDeviceProperties.deviceName);
+        return false;
+    }
+
+    count = 0;
+    vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> deviceExtensions(count);
+    vkEnumerateDeviceExtensionProperties(mPhysicalDevice, nullptr, &count,
+                                         deviceExtensions.data());
+    for (const VkExtensionProperties& extension : deviceExtensions) {
+        mDeviceExtensionNames.emplace_back(extension.extensionName);
+    }
+    for (const char* name : kRequiredDeviceExtensions) {
+        if (!contains(mDeviceExtensionNames, name)) {
+            ALOGW("%s does not support %s", mPhysicalDeviceProperties.deviceName, name);
+            return false;
+        }
+    }
+
+    mYcbcrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SAMPLER_YCBCR_CONVERSION_FEATURES;
+    mProtectedMemoryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROTECTED_MEMORY_FEATURES;
+    mProtectedMemoryFeatures.pNext = &mYcbcrFeatures;
+    mFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    mFeatures.pNext = &mProtectedMemoryFeatures;
+    vkGetPhysicalDeviceFeatures2(mPhysicalDevice, &mFeatures);
+    // Bounds checking only costs performance, since Skia's shaders stay in bounds.
+    mFeatures.features.robustBufferAccess = VK_FALSE;
+    if (!mYcbcrFeatures.samplerYcbcrConversion) {
+        ALOGW("%s does not support YCbCr sampling", mPhysicalDeviceProperties.deviceName);
+        return false;
+    }
+
+    count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &count, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &count, queueFamilies.data());
+    const auto graphicsFamily =
+            std::find_if(queueFamilies.begin(), queueFamilies.end(),
+                         [](const VkQueueFamilyProperties& family) {
+                             return family.queueFlags & VK_QUEUE_GRAPHICS_BIT;
+                         });
+    if (graphicsFamily == queueFamilies.end()) {
+        ALOGW("%s has no graphics queue", mPhysicalDeviceProperties.deviceName);
+        return false;
+    }
+    mQueueFamilyIndex = static_cast<uint32_t>(graphicsFamily - queueFamilies.begin());
+
+    // Both queues come from the same family, so it needs room for two of them.
+    enableProtectedQueue = enableProtectedQueue && mProtectedMemoryFeatures.protectedMemory &&
+            (graphicsFamily->queueFlags & VK_QUEUE_PROTECTED_BIT) &&
+            graphicsFamily->queueCount >= 2;
+    if (!enableProtectedQueue) {
+        mProtectedMemoryFeatures.protectedMemory = VK_FALSE;
+    }
+
+    // Degrade the priority as GLES does, falling back to the default one when the driver does
+    // not let SurfaceFlinger raise it.
+    std::vector<std::optional<RenderEngine::ContextPriority>> priorities;
+    if (priority && contains(mDeviceExtensionNames, VK_EXT_GLOBAL_PRIORITY_EXTENSION_NAME)) {
+        priorities.push_back(priority);
+        if (*priority == RenderEngine::ContextPriority::REALTIME) {
+            priorities.push_back(RenderEngine::ContextPriority::HIGH);
+        }
+    }
+    priorities.push_back(std::nullopt);
+    for (const auto& candidate : priorities) {
+        if (createDevice(enableProtectedQueue, candidate)) {
+            mQueuePriority = candidate;
+            break;
+        }
+    }
+    if (mDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    mImportSemaphoreFd = reinterpret_cast<PFN_vkImportSemaphoreFdKHR>(
+            vkGetDeviceProcAddr(mDevice, "vkImportSemaphoreFdKHR"));
+    mGetSemaphoreFd = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(
+            vkGetDeviceProcAddr(mDevice, "vkGetSemaphoreFdKHR"));
+    if (!mImportSemaphoreFd || !mGetSemaphoreFd) {
+        ALOGW("Failed to load the sync fd semaphore entry points");
+        return false;
+    }
+
+    const std::vector<const char*> deviceExtensionNames = toCStrings(mDeviceExtensionNames);
+    mGrExtensions.init(getBackendContext(GrProtected::kNo).fGetProc, mInstance, mPhysicalDevice,
+                       instanceExtensionNames.size(), instanceExtensionNames.data(),
+                       deviceExtensionNames.size(), deviceExtensionNames.data());
+
+    ALOGI("Using Vulkan device %s, protected queue %s, priority %s",
+          mPhysicalDeviceProperties.deviceName, mProtectedQueue ? "enabled" : "disabled",
+          toString(mQueuePriority));
+    return true;
+}
+
+bool VulkanInterface::createDevice(bool enableProtectedQueue,
+                                   std::optional<RenderEngine::ContextPriority> priority) {
+    const VkDeviceQueueGlobalPriorityCreateInfoEXT priorityInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_GLOBAL_PRIORITY_CREATE_INFO_EXT,
+            .globalPriority =
+                    toGlobalPriority(priority.value_or(RenderEngine::ContextPriority::MEDIUM)),
+    };
+    const float queuePriority = 1.0f;
+    const VkDeviceQueueCreateInfo queueInfos[] = {
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = priority ? &priorityInfo : nullptr,
+                    .queueFamilyIndex = mQueueFamilyIndex,
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority,
+            },
+            {
+                    .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                    .pNext = priority ? &priorityInfo : nullptr,
+                    .flags = VK_DEVICE_QUEUE_CREATE_PROTECTED_BIT,
+                    .queueFamilyIndex = mQueueFamilyIndex,
+                    .queueCount = 1,
+                    .pQueuePriorities = &queuePriority,
+            },
+    };
+
+    const std::vector<const char*> deviceExtensionNames = toCStrings(mDeviceExtensionNames);
+    const VkDeviceCreateInfo deviceInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+            .pNext = &mFeatures,
+            .queueCreateInfoCount = enableProtectedQueue ? 2u : 1u,
+            .pQueueCreateInfos = queueInfos,
+            .enabledExtensionCount = static_cast<uint32_t>(deviceExtensionNames.size()),
+            .ppEnabledExtensionNames = deviceExtensionNames.data(),
+    };
+    if (VkResult result = vkCreateDevice(mPhysicalDevice, &deviceInfo, nullptr, &mDevice);
+        result != VK_SUCCESS) {
+        ALOGW_IF(result != VK_ERROR_NOT_PERMITTED_EXT, "Failed to create a Vulkan device: %d",
+                 result);
+        mDevice = VK_NULL_HANDLE;
+        return false;
+    }
+
+    const VkDeviceQueueInfo2 queueInfo = {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_INFO_2,
+            .queueFamilyIndex = mQueueFamilyIndex,
+            .queueIndex = 0,
+    };
+    vkGetDeviceQueue2(mDevice, &queueInfo, &mQueue);
+    if (enableProtectedQueue) {
+        const VkDeviceQueueInfo2 protectedQueueInfo = {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_INFO_2,
+                .flags = VK_DEVICE_QUEUE_CREATE_PROTECTED_BIT,
+                .queueFamilyIndex = mQueueFamilyIndex,
+                .queueIndex = 0,
+        };
+        vkGetDeviceQueue2(mDevice, &protectedQueueInfo, &mProtectedQueue);
+    }
+    return true;
+}
+
+GrVkBackendContext VulkanInterface::getBackendContext(GrProtected isProtected) const {
+    GrVkBackendContext backendContext;
+    backendContext.fInstance = mInstance;
+    backendContext.fPhysicalDevice = mPhysicalDevice;
+    backendContext.fDevice = mDevice;
+    backendContext.fQueue = isProtected == GrProtected::kYes ? mProtectedQueue : mQueue;
+    backendContext.fGraphicsQueueIndex = mQueueFamilyIndex;
+    backendContext.fMaxAPIVersion = mApiVersion;
+    backendContext.fVkExtensions = &mGrExtensions;
+    backendContext.fDeviceFeatures2 = &mFeatures;
+    backendContext.fGetProc = [](const char* name, VkInstance instance, VkDevice device) {
+        return device != VK_NULL_HANDLE ? vkGetDeviceProcAddr(device, name)
+                                        : vkGetInstanceProcAddr(instance, name);
+    };
+    backendContext.fProtectedContext = isProtected;
+    return backendContext;
+}
+
+VkSemaphore VulkanInterface::createExportableSemaphore() {
+    const VkExportSemaphoreCreateInfo exportInfo = {
+            .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+            .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+    };
+    const VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &exportInfo,
+    };
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    if (VkResult result = vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &semaphore);
+        result != VK_SUCCESS) {
+        ALOGE("Failed to create an exportable semaphore: %d", result);
+        return VK_NULL_HANDLE;
+    }
+    return semaphore;
+}
+
+VkSemaphore VulkanInterface::importSemaphoreFromSyncFd(base::unique_fd& fenceFd) {
+    const VkSemaphoreCreateInfo semaphoreInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+    };
+    VkSemaphore semaphore = VK_NULL_HANDLE;
+    if (VkResult result = vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &semaphore);
+        result != VK_SUCCESS) {
+        ALOGE("Failed to create a semaphore: %d", result);
+        return VK_NULL_HANDLE;
+    }
+
+    const VkImportSemaphoreFdInfoKHR importInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+            .semaphore = semaphore,
+            .flags = VK_SEMAPHORE_IMPORT_TEMPORARY_BIT,
+            .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+            .fd = fenceFd.get(),
+    };
+    if (VkResult result = mImportSemaphoreFd(mDevice, &importInfo); result != VK_SUCCESS) {
+        ALOGE("Failed to import a sync fd into a semaphore: %d", result);
+        vkDestroySemaphore(mDevice, semaphore, nullptr);
+        return VK_NULL_HANDLE;
+    }
+    // The driver owns the fd once the import succeeds.
+    (void)fenceFd.release();
+    return semaphore;
+}
+
+base::unique_fd VulkanInterface::exportSemaphoreSyncFd(VkSemaphore semaphore) {
+    const VkSemaphoreGetFdInfoKHR getFdInfo = {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+            .semaphore = semaphore,
+            .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_SYNC_FD_BIT,
+    };
+    int fd = -1;
+    if (VkResult result = mGetSemaphoreFd(mDevice, &getFdInfo, &fd); result != VK_SUCCESS) {
+        ALOGE("Failed to export a semaphore as a sync fd: %d", result);
+        return base::unique_fd();
+    }
+    return base::unique_fd(fd);
+}
+
+void VulkanInterface::destroySemaphore(VkSemaphore semaphore) {
+    vkDestroySemaphore(mDevice, semaphore, nullptr);
+}
+
+void VulkanInterface::dump(std::string& result) const {
+    const VkPhysicalDeviceProperties& properties = mPhysicalDeviceProperties;
+    StringAppendF(&result, "Vulkan device: %s, vendor %#x, device %#x, driver %#x, API %u.%u.%u\n",
+                  properties.deviceName, properties.vendorID, properties.deviceID,
+                  properties.driverVersion, VK_VERSION_MAJOR(properties.apiVersion),
+                  VK_VERSION_MINOR(properties.apiVersion),
+                  VK_VERSION_PATCH(properties.apiVersion));
+    StringAppendF(&result, "Vulkan queues: family %u, protected queue %s, priority %s\n",
+                  mQueueFamilyIndex, mProtectedQueue ? "enabled" : "disabled",
+                  toString(mQueuePriority));
+    result.append("Vulkan device extensions:");
+    for (const std::string& name : mDeviceExtensionNames) {
+        StringAppendF(&result, " %s", name.c_str());
+    }
+    result.append("\n");
+}
+
+} // namespace android::renderengine::skia
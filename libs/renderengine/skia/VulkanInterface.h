@@ -0,0 +1,99 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <GrTypes.h>
+#include <android-base/unique_fd.h>
+#include <renderengine/RenderEngine.h>
+#include <vk/GrVkBackendContext.h>
+#include <vk/GrVkExtensions.h>
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace android::renderengine::skia {
+
+// Owns the Vulkan device that SkiaVkRenderEngine draws with. The device has an unprotected queue
+// and, if protected memory is supported, a protected queue of the same family, so that the
+// GrContexts created for each queue share the images imported from AHardwareBuffers.
+class VulkanInterface {
+public:
+    // Returns null if the device lacks what RenderEngine needs: Vulkan 1.1, YCbCr sampling,
+    // AHardwareBuffer import and sync fd semaphores.
+    static std::unique_ptr<VulkanInterface> create(
+            bool enableProtectedQueue, std::optional<RenderEngine::ContextPriority> priority);
+    ~VulkanInterface();
+
+    VulkanInterface(const VulkanInterface&) = delete;
+    VulkanInterface& operator=(const VulkanInterface&) = delete;
+
+    // The returned context refers to this object, which must outlive the GrContexts made of it.
+    GrVkBackendContext getBackendContext(GrProtected isProtected) const;
+    bool supportsProtectedContent() const { return mProtectedQueue != VK_NULL_HANDLE; }
+    // Priority granted to the queues, if the driver lets it be chosen.
+    std::optional<RenderEngine::ContextPriority> getQueuePriority() const {
+        return mQueuePriority;
+    }
+    const VkPhysicalDeviceProperties& getPhysicalDeviceProperties() const {
+        return mPhysicalDeviceProperties;
+    }
+
+    // Returns VK_NULL_HANDLE on failure.
+    VkSemaphore createExportableSemaphore();
+    // Takes ownership of the fd on success; the semaphore is only waited on once.
+    VkSemaphore importSemaphoreFromSyncFd(base::unique_fd& fenceFd);
+    // The semaphore's signal operation must have been submitted. Returns -1 on failure.
+    base::unique_fd exportSemaphoreSyncFd(VkSemaphore semaphore);
+    void destroySemaphore(VkSemaphore semaphore);
+
+    void dump(std::string& result) const;
+
+private:
+    VulkanInterface() = default;
+    bool initialize(bool enableProtectedQueue,
+                    std::optional<RenderEngine::ContextPriority> priority);
+    bool createDevice(bool enableProtectedQueue,
+                      std::optional<RenderEngine::ContextPriority> priority);
+
+    VkInstance mInstance = VK_NULL_HANDLE;
+    VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE;
+    VkDevice mDevice = VK_NULL_HANDLE;
+    VkQueue mQueue = VK_NULL_HANDLE;
+    VkQueue mProtectedQueue = VK_NULL_HANDLE;
+    uint32_t mQueueFamilyIndex = 0;
+    uint32_t mApiVersion = 0;
+    VkPhysicalDeviceProperties mPhysicalDeviceProperties{};
+
+    std::vector<std::string> mInstanceExtensionNames;
+    std::vector<std::string> mDeviceExtensionNames;
+    GrVkExtensions mGrExtensions;
+
+    // Features enabled on the device, which Skia reads through the chain.
+    VkPhysicalDeviceFeatures2 mFeatures{};
+    VkPhysicalDeviceSamplerYcbcrConversionFeatures mYcbcrFeatures{};
+    VkPhysicalDeviceProtectedMemoryFeatures mProtectedMemoryFeatures{};
+
+    std::optional<RenderEngine::ContextPriority> mQueuePriority;
+
+    PFN_vkImportSemaphoreFdKHR mImportSemaphoreFd = nullptr;
+    PFN_vkGetSemaphoreFdKHR mGetSemaphoreFd = nullptr;
+};
+
+} // namespace android::renderengine::skia
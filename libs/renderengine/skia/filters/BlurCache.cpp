@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlurCache.h"
+
+#include <android-base/stringprintf.h>
+#include <renderengine/ExternalTexture.h>
+
+#include <algorithm>
+
+#include "BlurFilter.h"
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+using base::StringAppendF;
+
+BlurCache::Content::Content(GrRecordingContext* context, const DisplaySettings& display,
+                            const SkImageInfo& inputInfo)
+      : mContext(context), mDisplay(display), mInputInfo(inputInfo) {}
+
+void BlurCache::Content::addLayer(const LayerSettings& layer, const SkRect& bounds) {
+    Layer& added = mLayers.emplace_back(Layer{layer, 0, bounds});
+    if (const auto& buffer = layer.source.buffer.buffer) {
+        added.bufferId = buffer->getBuffer()->getId();
+        added.settings.source.buffer.buffer = nullptr;
+    }
+}
+
+void BlurCache::Content::setBlurRect(const SkRect& blurRect) {
+    mBlurRect = blurRect;
+
+    // The blur samples within the rect, with linear filtering at its downscaled edges.
+    SkRect sampledRect = blurRect;
+    sampledRect.outset(BlurFilter::kInverseInputScale, BlurFilter::kInverseInputScale);
+    mLayers.erase(std::remove_if(mLayers.begin(), mLayers.end(),
+                                 [&](const Layer& layer) {
+                                     return !layer.bounds.isEmpty() &&
+                                             !SkRect::Intersects(layer.bounds, sampledRect);
+                                 }),
+                  mLayers.end());
+}
+
+bool BlurCache::Content::operator==(const Content& other) const {
+    return mContext == other.mContext && mBlurRect == other.mBlurRect &&
+            mInputInfo == other.mInputInfo && mDisplay == other.mDisplay &&
+            std::equal(mLayers.begin(), mLayers.end(), other.mLayers.begin(), other.mLayers.end(),
+                       [](const Layer& lhs, const Layer& rhs) {
+                           return lhs.bufferId == rhs.bufferId && lhs.bounds == rhs.bounds &&
+                                   lhs.settings == rhs.settings;
+                       });
+}
+
+sk_sp<SkImage> BlurCache::get(const Content& content, uint32_t radius) {
+    const auto it = std::find_if(mEntries.begin(), mEntries.end(), [&](const Entry& entry) {
+        return entry.radius == radius && entry.content == content;
+    });
+    if (it == mEntries.end()) {
+        mMisses++;
+        return nullptr;
+    }
+
+    mHits++;
+    it->lastUsedFrame = mFrame;
+    std::rotate(mEntries.begin(), it, it + 1);
+    return mEntries.front().blur;
+}
+
+void BlurCache::put(const Content& content, uint32_t radius, sk_sp<SkImage> blur) {
+    if (mEntries.size() == kMaxEntries) {
+        mEntries.pop_back();
+    }
+    mEntries.insert(mEntries.begin(), Entry{content, radius, std::move(blur), mFrame});
+}
+
+void BlurCache::onFrameEnd() {
+    mEntries.erase(std::remove_if(mEntries.begin(), mEntries.end(),
+                                  [this](const Entry& entry) {
+                                      return mFrame - entry.lastUsedFrame >= kMaxUnusedFrames;
+                                  }),
+                   mEntries.end());
+    mFrame++;
+}
+
+void BlurCache::clear() {
+    mEntries.clear();
+}
+
+void BlurCache::dump(std::string& result) const {
+    const size_t lookups = mHits + mMisses;
+    StringAppendF(&result, "Blur cache: %zu entries, %zu hits, %zu misses (%.1f%% hit rate)\n",
+                  mEntries.size(), mHits, mMisses,
+                  lookups == 0 ? 0.0 : 100.0 * static_cast<double>(mHits) /
+                                  static_cast<double>(lookups));
+}
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <SkImage.h>
+#include <SkRect.h>
+#include <renderengine/DisplaySettings.h>
+#include <renderengine/LayerSettings.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class GrRecordingContext;
+
+namespace android {
+namespace renderengine {
+namespace skia {
+
+/**
+ * Cache of the images generated by BlurFilter, which are reused while the blur and the content
+ * beneath it are unchanged, e.g. when only the layers above a notification shade change. Like
+ * CompositionEngine's ClientCompositionRequestCache, the content is compared by the settings of
+ * the layers it is drawn from, since a layer is given a new buffer or fence when its content
+ * changes. Layers that do not overlap the blurred rect are left out, since the blur only samples
+ * within it, so that changes elsewhere on the display still hit the cache.
+ */
+class BlurCache {
+public:
+    // The content that a blur is generated from.
+    class Content {
+    public:
+        Content(GrRecordingContext* context, const DisplaySettings& display,
+                const SkImageInfo& inputInfo);
+
+        // Adds a layer drawn into the blur input.
+        // @param bounds the bounds that the layer draws to in the blur input, or empty if they
+        // are unknown, e.g. because of shadows.
+        void addLayer(const LayerSettings& layer, const SkRect& bounds);
+        // Sets the rect that is blurred, which drops the layers that do not overlap it.
+        void setBlurRect(const SkRect& blurRect);
+
+        bool operator==(const Content& other) const;
+
+    private:
+        struct Layer {
+            LayerSettings settings;
+            // The buffer is compared by id, so that the cache does not keep layer buffers alive.
+            uint64_t bufferId;
+            SkRect bounds;
+        };
+
+        GrRecordingContext* mContext;
+        DisplaySettings mDisplay;
+        SkImageInfo mInputInfo;
+        SkRect mBlurRect = SkRect::MakeEmpty();
+        std::vector<Layer> mLayers;
+    };
+
+    // Returns the blur generated for the content at this radius, or nullptr on a miss.
+    sk_sp<SkImage> get(const Content& content, uint32_t radius);
+    void put(const Content& content, uint32_t radius, sk_sp<SkImage> blur);
+
+    // Drops the blurs that were not used in the last few frames.
+    void onFrameEnd();
+    void clear();
+
+    void dump(std::string& result) const;
+
+private:
+    // Enough for a shade with a few blur radii, without holding on to many full display blurs.
+    static constexpr size_t kMaxEntries = 4;
+    static constexpr uint64_t kMaxUnusedFrames = 3;
+
+    struct Entry {
+        Content content;
+        uint32_t radius;
+        sk_sp<SkImage> blur;
+        uint64_t lastUsedFrame;
+    };
+
+    // Most recently used first.
+    std::vector<Entry> mEntries;
+    uint64_t mFrame = 0;
+    size_t mHits = 0;
+    size_t mMisses = 0;
+};
+
+} // namespace skia
+} // namespace renderengine
+} // namespace android
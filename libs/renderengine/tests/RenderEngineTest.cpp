@@ -35,6 +35,7 @@
 
 #include "../gl/GLESRenderEngine.h"
 #include "../skia/SkiaGLRenderEngine.h"
+#include "../skia/SkiaVkRenderEngine.h"
 #include "../threaded/RenderEngineThreaded.h"
 
 constexpr int DEFAULT_DISPLAY_WIDTH = 128;
@@ -171,6 +172,73 @@ public:
     bool useColorManagement() const override { return true; }
 };
 
+class SkiaVkRenderEngineFactory : public RenderEngineFactory {
+public:
+    std::string name() override { return "SkiaVkRenderEngineFactory"; }
+
+    renderengine::RenderEngine::RenderEngineType type() {
+        return renderengine::RenderEngine::RenderEngineType::SKIA_VK;
+    }
+
+    std::unique_ptr<renderengine::RenderEngine> createRenderEngine() override {
+        renderengine::RenderEngineCreationArgs reCreationArgs =
+                renderengine::RenderEngineCreationArgs::Builder()
+                        .setPixelFormat(static_cast<int>(ui::PixelFormat::RGBA_8888))
+                        .setImageCacheSize(1)
+                        .setEnableProtectedContext(false)
+                        .setPrecacheToneMapperShaderOnly(false)
+                        .setSupportsBackgroundBlur(true)
+                        .setContextPriority(renderengine::RenderEngine::ContextPriority::MEDIUM)
+                        .setRenderEngineType(type())
+                        .setUseColorManagerment(useColorManagement())
+                        .build();
+        return renderengine::skia::SkiaVkRenderEngine::create(reCreationArgs);
+    }
+
+    bool useColorManagement() const override { return false; }
+};
+
+class SkiaVkCMRenderEngineFactory : public RenderEngineFactory {
+public:
+    std::string name() override { return "SkiaVkCMRenderEngineFactory"; }
+
+    renderengine::RenderEngine::RenderEngineType type() {
+        return renderengine::RenderEngine::RenderEngineType::SKIA_VK;
+    }
+
+    std::unique_ptr<renderengine::RenderEngine> createRenderEngine() override {
+        renderengine::RenderEngineCreationArgs reCreationArgs =
+                renderengine::RenderEngineCreationArgs::Builder()
+                        .setPixelFormat(static_cast<int>(ui::PixelFormat::RGBA_8888))
+                        .setImageCacheSize(1)
+                        .setEnableProtectedContext(false)
+                        .setPrecacheToneMapperShaderOnly(false)
+                        .setSupportsBackgroundBlur(true)
+                        .setContextPriority(renderengine::RenderEngine::ContextPriority::MEDIUM)
+                        .setRenderEngineType(type())
+                        .setUseColorManagerment(useColorManagement())
+                        .build();
+        return renderengine::skia::SkiaVkRenderEngine::create(reCreationArgs);
+    }
+
+    bool useColorManagement() const override { return true; }
+};
+
+// The Vulkan backend is only tested on devices that can run it.
+static std::vector<std::shared_ptr<RenderEngineFactory>> getRenderEngineFactories() {
+    std::vector<std::shared_ptr<RenderEngineFactory>> factories = {
+            std::make_shared<GLESRenderEngineFactory>(),
+            std::make_shared<GLESCMRenderEngineFactory>(),
+            std::make_shared<SkiaGLESRenderEngineFactory>(),
+            std::make_shared<SkiaGLESCMRenderEngineFactory>(),
+    };
+    if (renderengine::skia::SkiaVkRenderEngine::canSupportSkiaVkRenderEngine()) {
+        factories.push_back(std::make_shared<SkiaVkRenderEngineFactory>());
+        factories.push_back(std::make_shared<SkiaVkCMRenderEngineFactory>());
+    }
+    return factories;
+}
+
 class RenderEngineTest : public ::testing::TestWithParam<std::shared_ptr<RenderEngineFactory>> {
 public:
     std::shared_ptr<renderengine::ExternalTexture> allocateDefaultBuffer() {
@@ -1288,10 +1356,7 @@ void RenderEngineTest::drawShadowWithoutCaster(const FloatRect& castingBounds,
 }
 
 INSTANTIATE_TEST_SUITE_P(PerRenderEngineType, RenderEngineTest,
-                         testing::Values(std::make_shared<GLESRenderEngineFactory>(),
-                                         std::make_shared<GLESCMRenderEngineFactory>(),
-                                         std::make_shared<SkiaGLESRenderEngineFactory>(),
-                                         std::make_shared<SkiaGLESCMRenderEngineFactory>()));
+                         testing::ValuesIn(getRenderEngineFactories()));
 
 TEST_P(RenderEngineTest, drawLayers_noLayersToDraw) {
     initializeRenderEngine();
@@ -1328,6 +1393,50 @@ TEST_P(RenderEngineTest, drawLayers_withoutBuffers_withColorTransform) {
                       backgroundColor.a);
 }
 
+TEST_P(RenderEngineTest, drawLayers_batchesMatchingColorLayers) {
+    initializeRenderEngine();
+
+    renderengine::DisplaySettings settings;
+    settings.outputDataspace = ui::Dataspace::V0_SRGB_LINEAR;
+    settings.physicalDisplay = fullscreenRect();
+    // Here logical space is 2x2
+    settings.clip = Rect(2, 2);
+
+    // The two red layers only differ in their geometry, so they may be drawn together, but not
+    // with the green one.
+    renderengine::LayerSettings redLayerOne;
+    redLayerOne.sourceDataspace = ui::Dataspace::V0_SRGB_LINEAR;
+    redLayerOne.geometry.boundaries = Rect(0, 0, 1, 1).toFloatRect();
+    redLayerOne.source.solidColor = half3(1.0f, 0.0f, 0.0f);
+    redLayerOne.alpha = 1.0f;
+
+    renderengine::LayerSettings redLayerTwo = redLayerOne;
+    redLayerTwo.geometry.positionTransform = mat4::translate(vec4(1.0f, 1.0f, 0.0f, 1.0f));
+
+    renderengine::LayerSettings greenLayer = redLayerOne;
+    greenLayer.geometry.boundaries = Rect(1, 0, 2, 1).toFloatRect();
+    greenLayer.source.solidColor = half3(0.0f, 1.0f, 0.0f);
+
+    std::vector<const renderengine::LayerSettings*> layers;
+    layers.push_back(&redLayerOne);
+    layers.push_back(&redLayerTwo);
+    layers.push_back(&greenLayer);
+
+    invokeDraw(settings, layers);
+
+    expectBufferColor(Rect(0, 0, DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT / 2), 255, 0, 0,
+                      255);
+    expectBufferColor(Rect(DEFAULT_DISPLAY_WIDTH / 2, 0, DEFAULT_DISPLAY_WIDTH,
+                           DEFAULT_DISPLAY_HEIGHT / 2),
+                      0, 255, 0, 255);
+    expectBufferColor(Rect(DEFAULT_DISPLAY_WIDTH / 2, DEFAULT_DISPLAY_HEIGHT / 2,
+                           DEFAULT_DISPLAY_WIDTH, DEFAULT_DISPLAY_HEIGHT),
+                      255, 0, 0, 255);
+    expectBufferColor(Rect(0, DEFAULT_DISPLAY_HEIGHT / 2, DEFAULT_DISPLAY_WIDTH / 2,
+                           DEFAULT_DISPLAY_HEIGHT),
+                      0, 0, 0, 0);
+}
+
 TEST_P(RenderEngineTest, drawLayers_nullOutputBuffer) {
     initializeRenderEngine();
 
@@ -169,6 +169,15 @@ TEST_F(RenderEngineThreadedTest, supportsBackgroundBlur_returnsTrue) {
     status_t result = mThreadedRE->supportsBackgroundBlur();
     ASSERT_EQ(true, result);
 }
+
+TEST_F(RenderEngineThreadedTest, takeGpuDurations) {
+    const std::vector<renderengine::RenderEngine::GpuDuration> durations = {{10, 2}, {20, 3}};
+    EXPECT_CALL(*mRenderEngine, takeGpuDurations()).WillOnce(Return(durations));
+    const auto result = mThreadedRE->takeGpuDurations();
+    ASSERT_EQ(2u, result.size());
+    EXPECT_EQ(20, result[1].drawStartTime);
+    EXPECT_EQ(3, result[1].duration);
+}
 TEST_F(RenderEngineThreadedTest, drawLayers) {
     renderengine::DisplaySettings settings;
     std::vector<const renderengine::LayerSettings*> layers;
@@ -190,4 +199,52 @@ TEST_F(RenderEngineThreadedTest, drawLayers) {
     ASSERT_EQ(NO_ERROR, result);
 }
 
+TEST_F(RenderEngineThreadedTest, drawLayersAsync) {
+    renderengine::DisplaySettings settings;
+    std::vector<renderengine::LayerSettings> layers(2);
+    std::shared_ptr<renderengine::ExternalTexture> buffer = std::make_shared<
+            renderengine::ExternalTexture>(new GraphicBuffer(), *mRenderEngine,
+                                           renderengine::ExternalTexture::Usage::READABLE |
+                                                   renderengine::ExternalTexture::Usage::WRITEABLE);
+    base::unique_fd bufferFence;
+
+    EXPECT_CALL(*mRenderEngine, drawLayers)
+            .WillOnce([](const renderengine::DisplaySettings&,
+                         const std::vector<const renderengine::LayerSettings*>& layers,
+                         const std::shared_ptr<renderengine::ExternalTexture>&, const bool,
+                         base::unique_fd&&, base::unique_fd*) -> status_t {
+                return layers.size() == 2 ? NO_ERROR : BAD_VALUE;
+            });
+
+    auto future = mThreadedRE->drawLayersAsync(settings, std::move(layers), buffer, false,
+                                               std::move(bufferFence));
+    ASSERT_EQ(NO_ERROR, future.get().status);
+}
+
+TEST_F(RenderEngineThreadedTest, drawLayersRunsBeforeQueuedWork) {
+    std::promise<void> primeCacheStarted;
+    std::promise<void> unblockPrimeCache;
+    EXPECT_CALL(*mRenderEngine, primeCache()).WillOnce([&] {
+        primeCacheStarted.set_value();
+        unblockPrimeCache.get_future().wait();
+        return std::future<void>();
+    });
+
+    testing::InSequence sequence;
+    EXPECT_CALL(*mRenderEngine, drawLayers).WillOnce(Return(NO_ERROR));
+    EXPECT_CALL(*mRenderEngine, cleanFramebufferCache());
+
+    // Keep the RenderEngine thread busy while queueing, so that the order is up to the queue.
+    mThreadedRE->primeCache();
+    primeCacheStarted.get_future().wait();
+    mThreadedRE->cleanFramebufferCache();
+    auto future = mThreadedRE->drawLayersAsync(renderengine::DisplaySettings(), {}, nullptr,
+                                               false, base::unique_fd());
+    unblockPrimeCache.set_value();
+
+    ASSERT_EQ(NO_ERROR, future.get().status);
+    // Wait for the cleanup to have run before the mock expectations are verified.
+    mThreadedRE->getContextPriority();
+}
+
 } // namespace android
@@ -19,6 +19,7 @@
 #include "RenderEngineThreaded.h"
 
 #include <sched.h>
+#include <algorithm>
 #include <chrono>
 #include <future>
 
@@ -103,12 +104,7 @@ void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_S
     while (mRunning) {
         const auto getNextTask = [this]() -> std::optional<Work> {
             std::scoped_lock lock(mThreadMutex);
-            if (!mFunctionCalls.empty()) {
-                Work task = mFunctionCalls.front();
-                mFunctionCalls.pop();
-                return std::make_optional<Work>(task);
-            }
-            return std::nullopt;
+            return takeNextWorkLocked();
         };
 
         const auto task = getNextTask();
@@ -119,7 +115,7 @@ void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_S
 
         std::unique_lock<std::mutex> lock(mThreadMutex);
         mCondition.wait(lock, [this]() REQUIRES(mThreadMutex) {
-            return !mRunning || !mFunctionCalls.empty();
+            return !mRunning || hasWorkLocked();
         });
     }
 
@@ -127,6 +123,30 @@ void RenderEngineThreaded::threadMain(CreateInstanceFactory factory) NO_THREAD_S
     mRenderEngine.reset();
 }
 
+void RenderEngineThreaded::queueWork(Priority priority, Work&& work) {
+    {
+        std::lock_guard lock(mThreadMutex);
+        mFunctionCalls[static_cast<size_t>(priority)].push(std::move(work));
+    }
+    mCondition.notify_one();
+}
+
+std::optional<RenderEngineThreaded::Work> RenderEngineThreaded::takeNextWorkLocked() {
+    for (auto& queue : mFunctionCalls) {
+        if (!queue.empty()) {
+            Work work = std::move(queue.front());
+            queue.pop();
+            return work;
+        }
+    }
+    return std::nullopt;
+}
+
+bool RenderEngineThreaded::hasWorkLocked() const {
+    return std::any_of(mFunctionCalls.begin(), mFunctionCalls.end(),
+                       [](const auto& queue) { return !queue.empty(); });
+}
+
 void RenderEngineThreaded::waitUntilInitialized() const {
     std::unique_lock<std::mutex> lock(mInitializedMutex);
     mInitializedCondition.wait(lock, [=] { return mIsInitialized; });
@@ -138,23 +158,19 @@ std::future<void> RenderEngineThreaded::primeCache() {
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([resultPromise](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::primeCache");
-            if (setSchedFifo(false) != NO_ERROR) {
-                ALOGW("Couldn't set SCHED_OTHER for primeCache");
-            }
+    queueWork(Priority::Background, [resultPromise](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::primeCache");
+        if (setSchedFifo(false) != NO_ERROR) {
+            ALOGW("Couldn't set SCHED_OTHER for primeCache");
+        }
 
-            instance.primeCache();
-            resultPromise->set_value();
+        instance.primeCache();
+        resultPromise->set_value();
 
-            if (setSchedFifo(true) != NO_ERROR) {
-                ALOGW("Couldn't set SCHED_FIFO for primeCache");
-            }
-        });
-    }
-    mCondition.notify_one();
+        if (setSchedFifo(true) != NO_ERROR) {
+            ALOGW("Couldn't set SCHED_FIFO for primeCache");
+        }
+    });
 
     return resultFuture;
 }
@@ -162,16 +178,12 @@ std::future<void> RenderEngineThreaded::primeCache() {
 void RenderEngineThreaded::dump(std::string& result) {
     std::promise<std::string> resultPromise;
     std::future<std::string> resultFuture = resultPromise.get_future();
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise, &result](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::dump");
-            std::string localResult = result;
-            instance.dump(localResult);
-            resultPromise.set_value(std::move(localResult));
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [&resultPromise, &result](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::dump");
+        std::string localResult = result;
+        instance.dump(localResult);
+        resultPromise.set_value(std::move(localResult));
+    });
     // Note: This is an rvalue.
     result.assign(resultFuture.get());
 }
@@ -193,28 +205,20 @@ void RenderEngineThreaded::mapExternalTextureBuffer(const sp<GraphicBuffer>& buf
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::mapExternalTextureBuffer");
-            instance.mapExternalTextureBuffer(buffer, isRenderable);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Background, [=](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::mapExternalTextureBuffer");
+        instance.mapExternalTextureBuffer(buffer, isRenderable);
+    });
 }
 
 void RenderEngineThreaded::unmapExternalTextureBuffer(const sp<GraphicBuffer>& buffer) {
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
-            instance.unmapExternalTextureBuffer(buffer);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Background, [=](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
+        instance.unmapExternalTextureBuffer(buffer);
+    });
 }
 
 size_t RenderEngineThreaded::getMaxTextureSize() const {
@@ -246,7 +250,8 @@ void RenderEngineThreaded::useProtectedContext(bool useProtectedContext) {
 
     {
         std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([useProtectedContext, this](renderengine::RenderEngine& instance) {
+        auto& queue = mFunctionCalls[static_cast<size_t>(Priority::Rendering)];
+        queue.push([useProtectedContext, this](renderengine::RenderEngine& instance) {
             ATRACE_NAME("REThreaded::useProtectedContext");
             instance.useProtectedContext(useProtectedContext);
             if (instance.isProtected() != useProtectedContext) {
@@ -269,14 +274,10 @@ void RenderEngineThreaded::cleanupPostRender() {
 
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([=](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
-            instance.cleanupPostRender();
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [=](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::unmapExternalTextureBuffer");
+        instance.cleanupPostRender();
+    });
 }
 
 bool RenderEngineThreaded::canSkipPostRenderCleanup() const {
@@ -287,15 +288,12 @@ bool RenderEngineThreaded::canSkipPostRenderCleanup() const {
 void RenderEngineThreaded::setViewportAndProjection(Rect viewPort, Rect sourceCrop) {
     std::promise<void> resultPromise;
     std::future<void> resultFuture = resultPromise.get_future();
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise, viewPort, sourceCrop](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::setViewportAndProjection");
-            instance.setViewportAndProjection(viewPort, sourceCrop);
-            resultPromise.set_value();
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal,
+              [&resultPromise, viewPort, sourceCrop](renderengine::RenderEngine& instance) {
+                  ATRACE_NAME("REThreaded::setViewportAndProjection");
+                  instance.setViewportAndProjection(viewPort, sourceCrop);
+                  resultPromise.set_value();
+              });
     resultFuture.wait();
 }
 
@@ -308,46 +306,64 @@ status_t RenderEngineThreaded::drawLayers(const DisplaySettings& display,
     ATRACE_CALL();
     std::promise<status_t> resultPromise;
     std::future<status_t> resultFuture = resultPromise.get_future();
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise, &display, &layers, &buffer, useFramebufferCache,
-                             &bufferFence, &drawFence](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::drawLayers");
-            status_t status = instance.drawLayers(display, layers, buffer, useFramebufferCache,
-                                                  std::move(bufferFence), drawFence);
-            resultPromise.set_value(status);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Rendering,
+              [&resultPromise, &display, &layers, &buffer, useFramebufferCache, &bufferFence,
+               &drawFence](renderengine::RenderEngine& instance) {
+                  ATRACE_NAME("REThreaded::drawLayers");
+                  status_t status =
+                          instance.drawLayers(display, layers, buffer, useFramebufferCache,
+                                              std::move(bufferFence), drawFence);
+                  resultPromise.set_value(status);
+              });
     return resultFuture.get();
 }
 
+std::future<RenderEngine::DrawLayersResult> RenderEngineThreaded::drawLayersAsync(
+        const DisplaySettings& display, std::vector<LayerSettings> layers,
+        const std::shared_ptr<ExternalTexture>& buffer, const bool useFramebufferCache,
+        base::unique_fd&& bufferFence) {
+    ATRACE_CALL();
+    const auto resultPromise = std::make_shared<std::promise<DrawLayersResult>>();
+    std::future<DrawLayersResult> resultFuture = resultPromise->get_future();
+    // The work must be copyable, which the fence is not.
+    const auto fence = std::make_shared<base::unique_fd>(std::move(bufferFence));
+    queueWork(Priority::Rendering,
+              [resultPromise, display, layers = std::move(layers), buffer, useFramebufferCache,
+               fence](renderengine::RenderEngine& instance) {
+                  ATRACE_NAME("REThreaded::drawLayersAsync");
+                  std::vector<const LayerSettings*> layerPointers;
+                  layerPointers.reserve(layers.size());
+                  for (const LayerSettings& layer : layers) {
+                      layerPointers.push_back(&layer);
+                  }
+
+                  DrawLayersResult result;
+                  result.status = instance.drawLayers(display, layerPointers, buffer,
+                                                      useFramebufferCache, std::move(*fence),
+                                                      &result.drawFence);
+                  resultPromise->set_value(std::move(result));
+              });
+    return resultFuture;
+}
+
 void RenderEngineThreaded::cleanFramebufferCache() {
     ATRACE_CALL();
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::cleanFramebufferCache");
-            instance.cleanFramebufferCache();
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::cleanFramebufferCache");
+        instance.cleanFramebufferCache();
+    });
 }
 
 int RenderEngineThreaded::getContextPriority() {
     std::promise<int> resultPromise;
     std::future<int> resultFuture = resultPromise.get_future();
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::getContextPriority");
-            int priority = instance.getContextPriority();
-            resultPromise.set_value(priority);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [&resultPromise](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::getContextPriority");
+        int priority = instance.getContextPriority();
+        resultPromise.set_value(priority);
+    });
     return resultFuture.get();
 }
 
@@ -356,31 +372,28 @@ bool RenderEngineThreaded::supportsBackgroundBlur() {
     return mRenderEngine->supportsBackgroundBlur();
 }
 
+std::vector<RenderEngine::GpuDuration> RenderEngineThreaded::takeGpuDurations() {
+    waitUntilInitialized();
+    return mRenderEngine->takeGpuDurations();
+}
+
 void RenderEngineThreaded::onPrimaryDisplaySizeChanged(ui::Size size) {
     // This function is designed so it can run asynchronously, so we do not need to wait
     // for the futures.
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([size](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::onPrimaryDisplaySizeChanged");
-            instance.onPrimaryDisplaySizeChanged(size);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [size](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::onPrimaryDisplaySizeChanged");
+        instance.onPrimaryDisplaySizeChanged(size);
+    });
 }
 
 int RenderEngineThreaded::getRETid() {
     std::promise<int> resultPromise;
     std::future<int> resultFuture = resultPromise.get_future();
-    {
-        std::lock_guard lock(mThreadMutex);
-        mFunctionCalls.push([&resultPromise](renderengine::RenderEngine& instance) {
-            ATRACE_NAME("REThreaded::getRETid");
-            int tid = instance.getRETid();
-            resultPromise.set_value(tid);
-        });
-    }
-    mCondition.notify_one();
+    queueWork(Priority::Normal, [&resultPromise](renderengine::RenderEngine& instance) {
+        ATRACE_NAME("REThreaded::getRETid");
+        int tid = instance.getRETid();
+        resultPromise.set_value(tid);
+    });
     return resultFuture.get();
 }
 
@@ -17,8 +17,10 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <array>
 #include <condition_variable>
 #include <mutex>
+#include <optional>
 #include <queue>
 #include <thread>
 
@@ -33,7 +35,8 @@ using CreateInstanceFactory = std::function<std::unique_ptr<renderengine::Render
 /**
  * This class extends a basic RenderEngine class. It contains a thread. Each time a function of
  * this class is called, we create a lambda function that is put on a queue. The main thread then
- * executes the functions in order.
+ * executes the functions in order of priority, and in the order they were called within a
+ * priority, so that rendering does not wait behind background work such as priming the cache.
  */
 class RenderEngineThreaded : public RenderEngine {
 public:
@@ -62,10 +65,16 @@ public:
                         const std::shared_ptr<ExternalTexture>& buffer,
                         const bool useFramebufferCache, base::unique_fd&& bufferFence,
                         base::unique_fd* drawFence) override;
+    std::future<DrawLayersResult> drawLayersAsync(const DisplaySettings& display,
+                                                  std::vector<LayerSettings> layers,
+                                                  const std::shared_ptr<ExternalTexture>& buffer,
+                                                  const bool useFramebufferCache,
+                                                  base::unique_fd&& bufferFence) override;
 
     void cleanFramebufferCache() override;
     int getContextPriority() override;
     bool supportsBackgroundBlur() override;
+    std::vector<GpuDuration> takeGpuDurations() override;
     void onPrimaryDisplaySizeChanged(ui::Size size) override;
     int getRETid() override;
 
@@ -75,6 +84,21 @@ protected:
     bool canSkipPostRenderCleanup() const override;
 
 private:
+    // Work that changes what is rendered, e.g. switching to the protected context, must be
+    // queued at the priority of rendering, so that it stays ordered with the draws.
+    enum class Priority {
+        Rendering,
+        Normal,
+        Background,
+    };
+    static constexpr size_t kPriorityCount = static_cast<size_t>(Priority::Background) + 1;
+
+    using Work = std::function<void(renderengine::RenderEngine&)>;
+
+    void queueWork(Priority priority, Work&& work);
+    std::optional<Work> takeNextWorkLocked() REQUIRES(mThreadMutex);
+    bool hasWorkLocked() const REQUIRES(mThreadMutex);
+
     void threadMain(CreateInstanceFactory factory);
     void waitUntilInitialized() const;
     static status_t setSchedFifo(bool enabled);
@@ -88,8 +112,7 @@ private:
     std::thread mThread GUARDED_BY(mThreadMutex);
     std::atomic<bool> mRunning = true;
 
-    using Work = std::function<void(renderengine::RenderEngine&)>;
-    mutable std::queue<Work> mFunctionCalls GUARDED_BY(mThreadMutex);
+    mutable std::array<std::queue<Work>, kPriorityCount> mFunctionCalls GUARDED_BY(mThreadMutex);
     mutable std::condition_variable mCondition;
 
     // Used to allow select thread safe methods to be accessed without requiring the
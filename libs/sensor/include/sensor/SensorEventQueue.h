@@ -53,6 +53,10 @@ public:
 
     enum { MAX_RECEIVE_BUFFER_EVENT_COUNT = 256 };
 
+    // Flags of enableSensor(). With ENABLE_FLAG_COALESCE_ON_CHANGE, the events of an on-change
+    // sensor that repeat the values last sent to this queue are dropped rather than delivered.
+    enum { ENABLE_FLAG_COALESCE_ON_CHANGE = 1 << 0 };
+
     /**
      * Typical sensor delay (sample period) in microseconds.
      */
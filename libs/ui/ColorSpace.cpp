@@ -196,6 +196,24 @@ ColorSpace::ColorSpace(
         , mWhitePoint(whitePoint) {
 }
 
+ColorSpace::ColorSpace(
+        const std::string& name,
+        const Gamut& gamut,
+        const TransferParameters& parameters,
+        transfer_function OETF,
+        transfer_function EOTF,
+        clamping_function clamper) noexcept
+        : mName(name)
+        , mRGBtoXYZ(gamut.rgbToXYZ)
+        , mXYZtoRGB(gamut.xyzToRGB)
+        , mParameters(parameters)
+        , mOETF(std::move(OETF))
+        , mEOTF(std::move(EOTF))
+        , mClamper(std::move(clamper))
+        , mPrimaries(gamut.primaries)
+        , mWhitePoint(gamut.whitePoint) {
+}
+
 constexpr mat3 ColorSpace::computeXYZMatrix(
         const std::array<float2, 3>& primaries, const float2& whitePoint) {
     const float2& R = primaries[0];
@@ -230,28 +248,140 @@ constexpr mat3 ColorSpace::computeXYZMatrix(
     };
 }
 
+// The RGB<>XYZ matrices below are computeXYZMatrix() and its inverse evaluated
+// for the primaries and white point of each gamut, rounded to float. They save
+// the standard color space factories from recomputing them on every call;
+// colorspace_test checks that they still match.
+const ColorSpace::Gamut ColorSpace::sSRGBGamut = {
+    {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
+    {0.3127f, 0.3290f},
+    mat3{float3{0.412390828f, 0.212639034f, 0.0193308201f},
+         float3{0.357584327f, 0.715168655f, 0.119194724f},
+         float3{0.180480793f, 0.0721923113f, 0.950532138f}},
+    mat3{float3{3.24096966f, -0.969243646f, 0.055630032f},
+         float3{-1.53738308f, 1.8759675f, -0.203976855f},
+         float3{-0.498610735f, 0.041555088f, 1.05697143f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sNTSCGamut = {
+    {{float2{0.67f, 0.33f}, {0.21f, 0.71f}, {0.14f, 0.08f}}},
+    {0.310f, 0.316f},
+    mat3{float3{0.606992781f, 0.298966587f, -2.69996914e-08f},
+         float3{0.173448533f, 0.586421251f, 0.0660756677f},
+         float3{0.200571284f, 0.114612155f, 1.1174686f}},
+    mat3{float3{1.9096756f, -0.984964728f, 0.0582407974f},
+         float3{-0.532364726f, 1.99977696f, -0.118246384f},
+         float3{-0.288160741f, -0.0283167772f, 0.896553993f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sBT2020Gamut = {
+    {{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
+    {0.3127f, 0.3290f},
+    mat3{float3{0.636957943f, 0.26270017f, 0.0f},
+         float3{0.144616917f, 0.677998126f, 0.0280726887f},
+         float3{0.168880954f, 0.0593017116f, 1.06098497f}},
+    mat3{float3{1.71665156f, -0.666684389f, 0.0176398568f},
+         float3{-0.355670899f, 1.6164813f, -0.0427706093f},
+         float3{-0.253366321f, 0.0157685429f, 0.942103267f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sAdobeRGBGamut = {
+    {{float2{0.64f, 0.33f}, {0.21f, 0.71f}, {0.15f, 0.06f}}},
+    {0.3127f, 0.3290f},
+    mat3{float3{0.576669157f, 0.297345042f, 0.0270313676f},
+         float3{0.185558215f, 0.627363503f, 0.0706888884f},
+         float3{0.188228637f, 0.0752914473f, 0.991337478f}},
+    mat3{float3{2.04158735f, -0.969243765f, 0.0134443259f},
+         float3{-0.565006793f, 1.87596774f, -0.118362486f},
+         float3{-0.344731301f, 0.0415550806f, 1.01517498f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sProPhotoRGBGamut = {
+    {{float2{0.7347f, 0.2653f}, {0.1596f, 0.8404f}, {0.0366f, 0.0001f}}},
+    {0.34567f, 0.35850f},
+    mat3{float3{0.797667146f, 0.288037419f, -3.23565175e-08f},
+         float3{0.135192245f, 0.711876929f, 0.0f},
+         float3{0.0313525274f, 8.5662643e-05f, 0.825188279f}},
+    mat3{float3{1.34595656f, -0.544596732f, 5.27763966e-08f},
+         float3{-0.255610019f, 1.50816143f, -1.00227435e-08f},
+         float3{-0.0511122681f, 0.0205350593f, 1.21184468f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sDisplayP3Gamut = {
+    {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+    {0.3127f, 0.3290f},
+    mat3{float3{0.486570925f, 0.228974551f, 0.0f},
+         float3{0.265667677f, 0.691738546f, 0.0451133996f},
+         float3{0.198217288f, 0.0792869106f, 1.04394436f}},
+    mat3{float3{2.49349737f, -0.829488993f, 0.0358458459f},
+         float3{-0.93138361f, 1.7626642f, -0.0761724263f},
+         float3{-0.402710855f, 0.023624694f, 0.956884623f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sDCIP3Gamut = {
+    {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
+    {0.314f, 0.351f},
+    mat3{float3{0.445169777f, 0.20949164f, 0.0f},
+         float3{0.277134418f, 0.721595287f, 0.0470605828f},
+         float3{0.172282666f, 0.0689130649f, 0.907355428f}},
+    mat3{float3{2.72539425f, -0.795167923f, 0.0412419029f},
+         float3{-1.01800311f, 1.68973196f, -0.0876390561f},
+         float3{-0.440163255f, 0.0226471797f, 1.10092938f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sACESGamut = {
+    {{float2{0.73470f, 0.26530f}, {0.0f, 1.0f}, {0.00010f, -0.0770f}}},
+    {0.32168f, 0.33767f},
+    mat3{float3{0.952552319f, 0.343966424f, -3.86392678e-08f},
+         float3{0.0f, 0.728166103f, 0.0f},
+         float3{9.36786237e-05f, -0.0721325427f, 1.00882518f}},
+    mat3{float3{1.04981112f, -0.495903015f, 4.02090805e-08f},
+         float3{0.0f, 1.37331307f, -0.0f},
+         float3{-9.74845461e-05f, 0.0982400328f, 0.991252065f}}
+};
+
+const ColorSpace::Gamut ColorSpace::sACEScgGamut = {
+    {{float2{0.713f, 0.293f}, {0.165f, 0.830f}, {0.128f, 0.044f}}},
+    {0.32168f, 0.33767f},
+    mat3{float3{0.662454247f, 0.272228748f, -0.00557466131f},
+         float3{0.13400422f, 0.674081743f, 0.00406072987f},
+         float3{0.156187668f, 0.0536895096f, 1.0103389f}},
+    mat3{float3{1.64102328f, -0.66366297f, 0.0117219137f},
+         float3{-0.324803293f, 1.61533177f, -0.00828444213f},
+         float3{-0.236424685f, 0.0167563502f, 0.988395095f}}
+};
+
+static constexpr ColorSpace::TransferParameters gammaParameters(float gamma) {
+    return {gamma, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+}
+
 const ColorSpace ColorSpace::sRGB() {
+    constexpr TransferParameters parameters{
+            2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f, 0.0f, 0.0f};
     return {
         "sRGB IEC61966-2.1",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f, 0.0f, 0.0f}
+        sSRGBGamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::linearSRGB() {
     return {
         "sRGB IEC61966-2.1 (Linear)",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f}
+        sSRGBGamut,
+        {},
+        linearResponse,
+        linearResponse
     };
 }
 
 const ColorSpace ColorSpace::extendedSRGB() {
     return {
         "scRGB-nl IEC 61966-2-2:2003",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
+        sSRGBGamut,
+        {},
         std::bind(absRcpResponse, _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
         std::bind(absResponse,    _1, 2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.04045f),
         std::bind(clamp<float>, _1, -0.799f, 2.399f)
@@ -261,82 +391,100 @@ const ColorSpace ColorSpace::extendedSRGB() {
 const ColorSpace ColorSpace::linearExtendedSRGB() {
     return {
         "scRGB IEC 61966-2-2:2003",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        1.0f,
+        sSRGBGamut,
+        gammaParameters(1.0f),
+        toOETF(1.0f),
+        toEOTF(1.0f),
         std::bind(clamp<float>, _1, -0.5f, 7.499f)
     };
 }
 
 const ColorSpace ColorSpace::NTSC() {
+    constexpr TransferParameters parameters{
+            1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f};
     return {
         "NTSC (1953)",
-        {{float2{0.67f, 0.33f}, {0.21f, 0.71f}, {0.14f, 0.08f}}},
-        {0.310f, 0.316f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+        sNTSCGamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::BT709() {
+    constexpr TransferParameters parameters{
+            1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f};
     return {
         "Rec. ITU-R BT.709-5",
-        {{float2{0.640f, 0.330f}, {0.300f, 0.600f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+        sSRGBGamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::BT2020() {
+    constexpr TransferParameters parameters{
+            1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f};
     return {
         "Rec. ITU-R BT.2020-1",
-        {{float2{0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}}},
-        {0.3127f, 0.3290f},
-        {1 / 0.45f, 1 / 1.099f, 0.099f / 1.099f, 1 / 4.5f, 0.081f, 0.0f, 0.0f}
+        sBT2020Gamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::AdobeRGB() {
     return {
         "Adobe RGB (1998)",
-        {{float2{0.64f, 0.33f}, {0.21f, 0.71f}, {0.15f, 0.06f}}},
-        {0.3127f, 0.3290f},
-        2.2f
+        sAdobeRGBGamut,
+        gammaParameters(2.2f),
+        toOETF(2.2f),
+        toEOTF(2.2f)
     };
 }
 
 const ColorSpace ColorSpace::ProPhotoRGB() {
+    constexpr TransferParameters parameters{1.8f, 1.0f, 0.0f, 1 / 16.0f, 0.031248f, 0.0f, 0.0f};
     return {
         "ROMM RGB ISO 22028-2:2013",
-        {{float2{0.7347f, 0.2653f}, {0.1596f, 0.8404f}, {0.0366f, 0.0001f}}},
-        {0.34567f, 0.35850f},
-        {1.8f, 1.0f, 0.0f, 1 / 16.0f, 0.031248f, 0.0f, 0.0f}
+        sProPhotoRGBGamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::DisplayP3() {
+    constexpr TransferParameters parameters{
+            2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.039f, 0.0f, 0.0f};
     return {
         "Display P3",
-        {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-        {0.3127f, 0.3290f},
-        {2.4f, 1 / 1.055f, 0.055f / 1.055f, 1 / 12.92f, 0.039f, 0.0f, 0.0f}
+        sDisplayP3Gamut,
+        parameters,
+        toOETF(parameters),
+        toEOTF(parameters)
     };
 }
 
 const ColorSpace ColorSpace::DCIP3() {
     return {
         "SMPTE RP 431-2-2007 DCI (P3)",
-        {{float2{0.680f, 0.320f}, {0.265f, 0.690f}, {0.150f, 0.060f}}},
-        {0.314f, 0.351f},
-        2.6f
+        sDCIP3Gamut,
+        gammaParameters(2.6f),
+        toOETF(2.6f),
+        toEOTF(2.6f)
     };
 }
 
 const ColorSpace ColorSpace::ACES() {
     return {
         "SMPTE ST 2065-1:2012 ACES",
-        {{float2{0.73470f, 0.26530f}, {0.0f, 1.0f}, {0.00010f, -0.0770f}}},
-        {0.32168f, 0.33767f},
-        1.0f,
+        sACESGamut,
+        gammaParameters(1.0f),
+        toOETF(1.0f),
+        toEOTF(1.0f),
         std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
     };
 }
@@ -344,9 +492,10 @@ const ColorSpace ColorSpace::ACES() {
 const ColorSpace ColorSpace::ACEScg() {
     return {
         "Academy S-2014-004 ACEScg",
-        {{float2{0.713f, 0.293f}, {0.165f, 0.830f}, {0.128f, 0.044f}}},
-        {0.32168f, 0.33767f},
-        1.0f,
+        sACEScgGamut,
+        gammaParameters(1.0f),
+        toOETF(1.0f),
+        toEOTF(1.0f),
         std::bind(clamp<float>, _1, -65504.0f, 65504.0f)
     };
 }
@@ -376,6 +525,29 @@ std::unique_ptr<float3[]> ColorSpace::createLUT(uint32_t size, const ColorSpace&
     return lut;
 }
 
+TransferFunctionLUT::TransferFunctionLUT(
+        const ColorSpace::transfer_function& function,
+        uint32_t size,
+        float min,
+        float max)
+        : mMin(min)
+        , mMax(max) {
+    size = clamp(size, 2u, 65536u);
+    mLastIndex = size - 1;
+    mScale = float(mLastIndex) / (max - min);
+
+    mTable.resize(size);
+    for (uint32_t i = 0; i < size; i++) {
+        mTable[i] = function(min + (max - min) * float(i) / float(mLastIndex));
+    }
+}
+
+void TransferFunctionLUT::apply(float* data, size_t count) const noexcept {
+    for (size_t i = 0; i < count; i++) {
+        data[i] = (*this)(data[i]);
+    }
+}
+
 static const float2 ILLUMINANT_D50_XY = {0.34567f, 0.35850f};
 static const float3 ILLUMINANT_D50_XYZ = {0.964212f, 1.0f, 0.825188f};
 static const mat3 BRADFORD = mat3{
@@ -27,6 +27,7 @@
 #include <sync/sync.h>
 #pragma clang diagnostic pop
 
+#include <poll.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <utils/Log.h>
@@ -34,10 +35,27 @@
 #include <utils/Trace.h>
 #include <utils/CallStack.h>
 
+#include <atomic>
+
 namespace android {
 
 const sp<Fence> Fence::NO_FENCE = sp<Fence>(new Fence);
 
+namespace {
+
+struct {
+    std::atomic<uint64_t> waits{0};
+    std::atomic<uint64_t> merges{0};
+    std::atomic<uint64_t> signalTimeQueries{0};
+    std::atomic<uint64_t> polls{0};
+} sSyscallCounts;
+
+void countSyscall(std::atomic<uint64_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
 Fence::Fence(int fenceFd) :
     mFenceFd(fenceFd) {
 }
@@ -67,6 +85,7 @@ status_t Fence::wait(int timeout) {
     if (mFenceFd == -1) {
         return NO_ERROR;
     }
+    countSyscall(sSyscallCounts.waits);
     int err = sync_wait(mFenceFd, timeout);
     if (err < 0 && (timeout == TIMEOUT_NEVER || timeout >100)) {
         ALOGE("ERROR :Fence didnt signal in %dms. Initiating dump", timeout);
@@ -81,6 +100,7 @@ status_t Fence::waitForever(const char* logname) {
         return NO_ERROR;
     }
     int warningTimeout = 3000;
+    countSyscall(sSyscallCounts.waits);
     int err = sync_wait(mFenceFd, warningTimeout);
     if (err < 0 && errno == ETIME) {
         ALOGE("waitForever: %s: fence %d didn't signal in %u ms", logname, mFenceFd.get(),
@@ -104,6 +124,7 @@ status_t Fence::waitForever(const char* logname) {
             sync_file_info_free(finfo);
         }
 
+        countSyscall(sSyscallCounts.waits);
         err = sync_wait(mFenceFd, TIMEOUT_NEVER);
     }
     return err < 0 ? -errno : status_t(NO_ERROR);
@@ -125,6 +146,7 @@ sp<Fence> Fence::merge(const char* name, const sp<Fence>& f1,
     } else {
         return NO_FENCE;
     }
+    countSyscall(sSyscallCounts.merges);
     if (result == -1) {
         status_t err = -errno;
         ALOGE("merge: sync_merge(\"%s\", %d, %d) returned an error: %s (%d)",
@@ -140,6 +162,36 @@ sp<Fence> Fence::merge(const String8& name, const sp<Fence>& f1,
     return merge(name.string(), f1, f2);
 }
 
+sp<Fence> Fence::merge(const char* name, const std::vector<sp<Fence>>& fences) {
+    ATRACE_CALL();
+    std::vector<int> fds;
+    fds.reserve(fences.size());
+    for (const sp<Fence>& fence : fences) {
+        if (fence != nullptr && fence->isValid()) {
+            fds.push_back(fence->mFenceFd.get());
+        }
+    }
+    if (fds.empty()) {
+        return NO_FENCE;
+    }
+
+    // The kernel merges two fences at a time. Fold the rest into the result,
+    // which only ever holds one point per timeline, so the merges stay cheap.
+    base::unique_fd result(sync_merge(name, fds[0], fds.size() > 1 ? fds[1] : fds[0]));
+    countSyscall(sSyscallCounts.merges);
+    for (size_t i = 2; i < fds.size() && result >= 0; i++) {
+        result.reset(sync_merge(name, result, fds[i]));
+        countSyscall(sSyscallCounts.merges);
+    }
+    if (result < 0) {
+        status_t err = -errno;
+        ALOGE("merge: sync_merge(\"%s\") of %zu fences returned an error: %s (%d)", name,
+              fds.size(), strerror(-err), err);
+        return NO_FENCE;
+    }
+    return sp<Fence>(new Fence(std::move(result)));
+}
+
 int Fence::dup() const {
     return ::dup(mFenceFd);
 }
@@ -149,6 +201,7 @@ nsecs_t Fence::getSignalTime() const {
         return SIGNAL_TIME_INVALID;
     }
 
+    countSyscall(sSyscallCounts.signalTimeQueries);
     struct sync_file_info* finfo = sync_file_info(mFenceFd);
     if (finfo == nullptr) {
         ALOGE("sync_file_info returned NULL for fd %d", mFenceFd.get());
@@ -171,6 +224,44 @@ nsecs_t Fence::getSignalTime() const {
     return nsecs_t(timestamp);
 }
 
+void Fence::getSignalTimes(const sp<Fence>* fences, size_t count, nsecs_t* outTimes) {
+    ATRACE_CALL();
+    std::vector<pollfd> pollFds;
+    std::vector<size_t> indices;
+    pollFds.reserve(count);
+    indices.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (fences[i] == nullptr || !fences[i]->isValid()) {
+            outTimes[i] = SIGNAL_TIME_INVALID;
+            continue;
+        }
+        pollFds.push_back({fences[i]->mFenceFd.get(), POLLIN, 0});
+        indices.push_back(i);
+    }
+    if (pollFds.empty()) {
+        return;
+    }
+
+    countSyscall(sSyscallCounts.polls);
+    const int result = TEMP_FAILURE_RETRY(poll(pollFds.data(), pollFds.size(), 0));
+    for (size_t i = 0; i < pollFds.size(); i++) {
+        const sp<Fence>& fence = fences[indices[i]];
+        // A fence that isn't readable yet hasn't signaled. If poll() itself
+        // failed, ask each fence the slow way.
+        outTimes[indices[i]] = result >= 0 && pollFds[i].revents == 0 ? SIGNAL_TIME_PENDING
+                                                                       : fence->getSignalTime();
+    }
+}
+
+Fence::SyscallCounts Fence::getSyscallCounts() {
+    SyscallCounts counts;
+    counts.waits = sSyscallCounts.waits.load(std::memory_order_relaxed);
+    counts.merges = sSyscallCounts.merges.load(std::memory_order_relaxed);
+    counts.signalTimeQueries = sSyscallCounts.signalTimeQueries.load(std::memory_order_relaxed);
+    counts.polls = sSyscallCounts.polls.load(std::memory_order_relaxed);
+    return counts;
+}
+
 size_t Fence::getFlattenedSize() const {
     return 4;
 }
@@ -150,8 +150,10 @@ nsecs_t FenceTime::getSignalTime() {
     }
 
     // Make the system call without the lock held.
-    signalTime = fence->getSignalTime();
+    return applySignalTime(fence->getSignalTime());
+}
 
+nsecs_t FenceTime::applySignalTime(nsecs_t signalTime) {
     // Allow tests to override SIGNAL_TIME_INVALID behavior, since tests
     // use invalid underlying Fences without real file descriptors.
     if (CC_UNLIKELY(mState == State::FORCED_VALID_FOR_TEST)) {
@@ -171,6 +173,32 @@ nsecs_t FenceTime::getSignalTime() {
     return signalTime;
 }
 
+void FenceTime::updateSignalTimes(const std::vector<std::shared_ptr<FenceTime>>& fences) {
+    std::vector<FenceTime*> pending;
+    // Hold references to the fences, as in getSignalTime().
+    std::vector<sp<Fence>> pendingFences;
+    for (const auto& fenceTime : fences) {
+        if (!fenceTime ||
+            fenceTime->mSignalTime.load(std::memory_order_relaxed) != Fence::SIGNAL_TIME_PENDING) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(fenceTime->mMutex);
+        if (fenceTime->mFence.get()) {
+            pending.push_back(fenceTime.get());
+            pendingFences.push_back(fenceTime->mFence);
+        }
+    }
+    if (pending.empty()) {
+        return;
+    }
+
+    std::vector<nsecs_t> signalTimes(pending.size());
+    Fence::getSignalTimes(pendingFences.data(), pendingFences.size(), signalTimes.data());
+    for (size_t i = 0; i < pending.size(); i++) {
+        pending[i]->applySignalTime(signalTimes[i]);
+    }
+}
+
 nsecs_t FenceTime::getCachedSignalTime() const {
     // memory_order_acquire since we don't have a lock fallback path
     // that will do an acquire.
@@ -308,6 +336,19 @@ void FenceTimeline::push(const std::shared_ptr<FenceTime>& fence) {
 
 void FenceTimeline::updateSignalTimes() {
     std::lock_guard<std::mutex> lock(mMutex);
+
+    // Resolve the whole queue with one poll, rather than a query per fence.
+    std::vector<std::shared_ptr<FenceTime>> fences;
+    fences.reserve(mQueue.size());
+    std::queue<std::weak_ptr<FenceTime>> queue(mQueue);
+    while (!queue.empty()) {
+        if (auto fence = queue.front().lock()) {
+            fences.push_back(std::move(fence));
+        }
+        queue.pop();
+    }
+    FenceTime::updateSignalTimes(fences);
+
     while (!mQueue.empty()) {
         std::shared_ptr<FenceTime> fence = mQueue.front().lock();
         if (!fence) {
@@ -315,7 +356,7 @@ void FenceTimeline::updateSignalTimes() {
             // timestamp anymore.
             mQueue.pop();
             continue;
-        } else if (fence->getSignalTime() != Fence::SIGNAL_TIME_PENDING) {
+        } else if (fence->getCachedSignalTime() != Fence::SIGNAL_TIME_PENDING) {
             // The fence has signaled and we've removed the sp<Fence> ref.
             mQueue.pop();
             continue;
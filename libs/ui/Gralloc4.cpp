@@ -155,6 +155,11 @@ status_t Gralloc4Mapper::importBuffer(const hardware::hidl_handle& rawHandle,
 }
 
 void Gralloc4Mapper::freeBuffer(buffer_handle_t bufferHandle) const {
+    {
+        std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+        mMetadataCache.erase(bufferHandle);
+    }
+
     auto buffer = const_cast<native_handle_t*>(bufferHandle);
     auto ret = mMapper->freeBuffer(buffer);
 
@@ -202,8 +207,13 @@ void Gralloc4Mapper::getTransportSize(buffer_handle_t bufferHandle, uint32_t* ou
 status_t Gralloc4Mapper::lock(buffer_handle_t bufferHandle, uint64_t usage, const Rect& bounds,
                               int acquireFence, void** outData, int32_t* outBytesPerPixel,
                               int32_t* outBytesPerStride) const {
+    // Only decode the plane layouts when they are asked for. Most callers don't need them, or
+    // decode them on their own like the YCbCr lock below, and this is on every lock.
     std::vector<ui::PlaneLayout> planeLayouts;
-    status_t err = getPlaneLayouts(bufferHandle, &planeLayouts);
+    status_t err = NO_ERROR;
+    if (outBytesPerPixel || outBytesPerStride) {
+        err = getPlaneLayouts(bufferHandle, &planeLayouts);
+    }
 
     if (err == NO_ERROR && !planeLayouts.empty()) {
         if (outBytesPerPixel) {
@@ -404,6 +414,13 @@ int Gralloc4Mapper::unlock(buffer_handle_t bufferHandle) const {
     return releaseFence;
 }
 
+status_t Gralloc4Mapper::rereadLockedBuffer(buffer_handle_t bufferHandle) const {
+    auto buffer = const_cast<native_handle_t*>(bufferHandle);
+    auto ret = mMapper->rereadLockedBuffer(buffer);
+
+    return static_cast<status_t>((ret.isOk()) ? static_cast<Error>(ret) : kTransactionError);
+}
+
 status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelFormat format,
                                      uint32_t layerCount, uint64_t usage,
                                      bool* outSupported) const {
@@ -434,19 +451,71 @@ status_t Gralloc4Mapper::isSupported(uint32_t width, uint32_t height, PixelForma
     return static_cast<status_t>(error);
 }
 
-template <class T>
-status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& metadataType,
-                             DecodeFunction<T> decodeFunction, T* outMetadata) const {
-    if (!outMetadata) {
-        return BAD_VALUE;
+bool Gralloc4Mapper::isImmutableMetadataType(const MetadataType& metadataType) {
+    if (!gralloc4::isStandardMetadataType(metadataType)) {
+        return false;
+    }
+    // Only metadata which is fixed at allocation time. Everything that IMapper allows to be set
+    // (dataspace, blend mode, HDR metadata, crop, ...) is always fetched from the HAL.
+    switch (gralloc4::getStandardMetadataTypeValue(metadataType)) {
+        case StandardMetadataType::BUFFER_ID:
+        case StandardMetadataType::NAME:
+        case StandardMetadataType::WIDTH:
+        case StandardMetadataType::HEIGHT:
+        case StandardMetadataType::LAYER_COUNT:
+        case StandardMetadataType::PIXEL_FORMAT_REQUESTED:
+        case StandardMetadataType::PIXEL_FORMAT_FOURCC:
+        case StandardMetadataType::PIXEL_FORMAT_MODIFIER:
+        case StandardMetadataType::USAGE:
+        case StandardMetadataType::ALLOCATION_SIZE:
+        case StandardMetadataType::PLANE_LAYOUTS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Gralloc4Mapper::getCachedMetadata(buffer_handle_t bufferHandle,
+                                       const MetadataType& metadataType,
+                                       hidl_vec<uint8_t>* outVec) const {
+    if (!isImmutableMetadataType(metadataType)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+    auto entry = mMetadataCache.find(bufferHandle);
+    if (entry == mMetadataCache.end()) {
+        return false;
+    }
+    auto value = entry->second.find(metadataType.value);
+    if (value == entry->second.end()) {
+        return false;
+    }
+    *outVec = value->second;
+    return true;
+}
+
+void Gralloc4Mapper::cacheMetadata(buffer_handle_t bufferHandle, const MetadataType& metadataType,
+                                   const hidl_vec<uint8_t>& vec) const {
+    if (!isImmutableMetadataType(metadataType)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMetadataCacheMutex);
+    mMetadataCache[bufferHandle][metadataType.value] = vec;
+}
+
+status_t Gralloc4Mapper::getEncoded(buffer_handle_t bufferHandle, const MetadataType& metadataType,
+                                    hidl_vec<uint8_t>* outVec) const {
+    if (getCachedMetadata(bufferHandle, metadataType, outVec)) {
+        return NO_ERROR;
     }
 
-    hidl_vec<uint8_t> vec;
     Error error;
     auto ret = mMapper->get(const_cast<native_handle_t*>(bufferHandle), metadataType,
                             [&](const auto& tmpError, const hidl_vec<uint8_t>& tmpVec) {
                                 error = tmpError;
-                                vec = tmpVec;
+                                *outVec = tmpVec;
                             });
 
     if (!ret.isOk()) {
@@ -459,9 +528,83 @@ status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& m
         return static_cast<status_t>(error);
     }
 
+    cacheMetadata(bufferHandle, metadataType, *outVec);
+    return NO_ERROR;
+}
+
+template <class T>
+status_t Gralloc4Mapper::get(buffer_handle_t bufferHandle, const MetadataType& metadataType,
+                             DecodeFunction<T> decodeFunction, T* outMetadata) const {
+    if (!outMetadata) {
+        return BAD_VALUE;
+    }
+
+    hidl_vec<uint8_t> vec;
+    status_t error = getEncoded(bufferHandle, metadataType, &vec);
+    if (error != NO_ERROR) {
+        return error;
+    }
+
     return decodeFunction(vec, outMetadata);
 }
 
+status_t Gralloc4Mapper::getMultiple(buffer_handle_t bufferHandle,
+                                     const std::vector<MetadataType>& metadataTypes,
+                                     std::vector<hidl_vec<uint8_t>>* outValues) const {
+    if (!outValues) {
+        return BAD_VALUE;
+    }
+    outValues->clear();
+    outValues->resize(metadataTypes.size());
+
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < metadataTypes.size(); i++) {
+        if (!getCachedMetadata(bufferHandle, metadataTypes[i], &(*outValues)[i])) {
+            missing.push_back(i);
+        }
+    }
+
+    if (missing.size() > 1) {
+        // IMapper 4.0 has no multi-get, but dumpBuffer returns every metadata value of the
+        // buffer in one transaction.
+        BufferDump bufferDump;
+        Error error;
+        auto ret = mMapper->dumpBuffer(const_cast<native_handle_t*>(bufferHandle),
+                                       [&](const auto& tmpError, const auto& tmpBufferDump) {
+                                           error = tmpError;
+                                           bufferDump = tmpBufferDump;
+                                       });
+        if (ret.isOk() && error == Error::NONE) {
+            auto pending = missing.begin();
+            for (size_t i : missing) {
+                bool found = false;
+                for (const auto& metadataDump : bufferDump.metadataDump) {
+                    if (metadataDump.metadataType == metadataTypes[i]) {
+                        (*outValues)[i] = metadataDump.metadata;
+                        cacheMetadata(bufferHandle, metadataTypes[i], metadataDump.metadata);
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    *pending++ = i;
+                }
+            }
+            missing.erase(pending, missing.end());
+        }
+    }
+
+    // Whatever the dump did not cover is fetched one by one.
+    for (size_t i : missing) {
+        status_t error = getEncoded(bufferHandle, metadataTypes[i], &(*outValues)[i]);
+        if (error != NO_ERROR) {
+            outValues->clear();
+            return error;
+        }
+    }
+    return NO_ERROR;
+}
+
 status_t Gralloc4Mapper::getBufferId(buffer_handle_t bufferHandle, uint64_t* outBufferId) const {
     return get(bufferHandle, gralloc4::MetadataType_BufferId, gralloc4::decodeBufferId,
                outBufferId);
@@ -23,6 +23,8 @@
 #include <limits.h>
 #include <stdio.h>
 
+#include <algorithm>
+
 #include <grallocusage/GrallocUsageConversion.h>
 
 #include <android-base/stringprintf.h>
@@ -75,7 +77,7 @@ uint64_t GraphicBufferAllocator::getTotalSize() const {
     for (size_t i = 0; i < sAllocList.size(); ++i) {
         total += sAllocList.valueAt(i).size;
     }
-    return total;
+    return total + mPoolSize;
 }
 
 void GraphicBufferAllocator::dump(std::string& result, bool less) const {
@@ -99,6 +101,25 @@ void GraphicBufferAllocator::dump(std::string& result, bool less) const {
     StringAppendF(&result, "Total allocated by GraphicBufferAllocator (estimate): %.2f KB\n",
                   static_cast<double>(total) / 1024.0);
 
+    if (mPoolLimit > 0 || !mPool.empty()) {
+        const uint64_t lookups = mStats.poolHits + mStats.poolMisses;
+        StringAppendF(&result,
+                      "GraphicBufferAllocator pool: %zu buffers, %.2f KB of %.2f KB, "
+                      "%" PRIu64 " hits, %" PRIu64 " misses (%.1f%% hit rate)\n",
+                      mPool.size(), static_cast<double>(mPoolSize) / 1024.0,
+                      static_cast<double>(mPoolLimit) / 1024.0, mStats.poolHits,
+                      mStats.poolMisses,
+                      lookups ? 100.0 * static_cast<double>(mStats.poolHits) / lookups : 0.0);
+    }
+    if (mStats.allocations > 0) {
+        StringAppendF(&result,
+                      "GraphicBufferAllocator allocations: %" PRIu64
+                      ", latency avg %.3f ms, max %.3f ms\n",
+                      mStats.allocations,
+                      static_cast<double>(mStats.totalAllocationTime) / mStats.allocations / 1e6,
+                      static_cast<double>(mStats.maxAllocationTime) / 1e6);
+    }
+
     result.append(mAllocator->dumpDebugInfo(less));
 }
 
@@ -111,7 +132,8 @@ void GraphicBufferAllocator::dumpToSystemLog(bool less) {
 status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height, PixelFormat format,
                                                 uint32_t layerCount, uint64_t usage,
                                                 buffer_handle_t* handle, uint32_t* stride,
-                                                std::string requestorName, bool importBuffer) {
+                                                std::string requestorName, bool importBuffer,
+                                                bool pooled) {
     ATRACE_CALL();
 
     // make sure to not allocate a N x 0 or 0 x N buffer, since this is
@@ -135,8 +157,33 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
     // TODO(b/72323293, b/72703005): Remove these invalid bits from callers
     usage &= ~static_cast<uint64_t>((1 << 10) | (1 << 13));
 
+    if (pooled) {
+        Mutex::Autolock _l(sLock);
+        if (mPoolLimit > 0) {
+            auto it = std::find_if(mPool.begin(), mPool.end(), [&](const pool_rec_t& entry) {
+                return entry.rec.width == width && entry.rec.height == height &&
+                        entry.rec.format == format && entry.rec.layerCount == layerCount &&
+                        entry.rec.usage == usage;
+            });
+            if (it != mPool.end()) {
+                mStats.poolHits++;
+                mPoolSize -= it->rec.size;
+                *handle = it->handle;
+                *stride = it->rec.stride;
+                alloc_rec_t rec = std::move(it->rec);
+                rec.requestorName = std::move(requestorName);
+                mPool.erase(it);
+                sAllocList.add(*handle, rec);
+                return NO_ERROR;
+            }
+            mStats.poolMisses++;
+        }
+    }
+
+    const nsecs_t start = systemTime();
     status_t error = mAllocator->allocate(requestorName, width, height, format, layerCount, usage,
                                           1, stride, handle, importBuffer);
+    const nsecs_t duration = systemTime() - start;
     if (error != NO_ERROR) {
         ALOGE("Failed to allocate (%u x %u) layerCount %u format %d "
               "usage %" PRIx64 ": %d",
@@ -144,6 +191,11 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
         return error;
     }
 
+    Mutex::Autolock _l(sLock);
+    mStats.allocations++;
+    mStats.totalAllocationTime += duration;
+    mStats.maxAllocationTime = std::max(mStats.maxAllocationTime, duration);
+
     if (!importBuffer) {
         return NO_ERROR;
     }
@@ -158,7 +210,6 @@ status_t GraphicBufferAllocator::allocateHelper(uint32_t width, uint32_t height,
         bufSize = static_cast<size_t>((*stride)) * height * bpp;
     }
 
-    Mutex::Autolock _l(sLock);
     KeyedVector<buffer_handle_t, alloc_rec_t>& list(sAllocList);
     alloc_rec_t rec;
     rec.width = width;
@@ -189,6 +240,14 @@ status_t GraphicBufferAllocator::allocateRawHandle(uint32_t width, uint32_t heig
                           false);
 }
 
+status_t GraphicBufferAllocator::allocatePooled(uint32_t width, uint32_t height,
+                                                PixelFormat format, uint32_t layerCount,
+                                                uint64_t usage, buffer_handle_t* handle,
+                                                uint32_t* stride, std::string requestorName) {
+    return allocateHelper(width, height, format, layerCount, usage, handle, stride, requestorName,
+                          true, true);
+}
+
 // DEPRECATED
 status_t GraphicBufferAllocator::allocate(uint32_t width, uint32_t height, PixelFormat format,
                                           uint32_t layerCount, uint64_t usage,
@@ -213,5 +272,65 @@ status_t GraphicBufferAllocator::free(buffer_handle_t handle)
     return NO_ERROR;
 }
 
+status_t GraphicBufferAllocator::release(buffer_handle_t handle) {
+    ATRACE_CALL();
+
+    std::vector<buffer_handle_t> freed;
+    {
+        Mutex::Autolock _l(sLock);
+        const ssize_t index = sAllocList.indexOfKey(handle);
+        if (mPoolLimit == 0 || index < 0 || sAllocList.valueAt(index).size > mPoolLimit) {
+            freed.push_back(handle);
+            if (index >= 0) {
+                sAllocList.removeItemsAt(index);
+            }
+        } else {
+            mPool.push_front({handle, sAllocList.valueAt(index)});
+            mPoolSize += mPool.front().rec.size;
+            sAllocList.removeItemsAt(index);
+            trimPoolLocked(mPoolLimit, &freed);
+        }
+    }
+
+    for (buffer_handle_t freedHandle : freed) {
+        mMapper.freeBuffer(freedHandle);
+    }
+    return NO_ERROR;
+}
+
+void GraphicBufferAllocator::trimPoolLocked(size_t maxBytes,
+                                            std::vector<buffer_handle_t>* outFreed) {
+    while (mPoolSize > maxBytes && !mPool.empty()) {
+        mPoolSize -= mPool.back().rec.size;
+        outFreed->push_back(mPool.back().handle);
+        mPool.pop_back();
+    }
+}
+
+void GraphicBufferAllocator::setPoolLimit(size_t maxBytes) {
+    std::vector<buffer_handle_t> freed;
+    {
+        Mutex::Autolock _l(sLock);
+        mPoolLimit = maxBytes;
+        trimPoolLocked(maxBytes, &freed);
+    }
+    for (buffer_handle_t handle : freed) {
+        mMapper.freeBuffer(handle);
+    }
+}
+
+void GraphicBufferAllocator::trimPool(size_t maxBytes) {
+    ATRACE_CALL();
+
+    std::vector<buffer_handle_t> freed;
+    {
+        Mutex::Autolock _l(sLock);
+        trimPoolLocked(maxBytes, &freed);
+    }
+    for (buffer_handle_t handle : freed) {
+        mMapper.freeBuffer(handle);
+    }
+}
+
 // ---------------------------------------------------------------------------
 }; // namespace android
@@ -66,6 +66,82 @@ const Region Region::INVALID_REGION(Rect::INVALID_RECT);
 
 // ----------------------------------------------------------------------------
 
+static inline bool contains(const Rect& outer, const Rect& inner) {
+    return outer.left <= inner.left && outer.top <= inner.top && outer.right >= inner.right &&
+            outer.bottom >= inner.bottom;
+}
+
+// Most operations SurfaceFlinger does are between a region and a layer's bounds, where the
+// result is often just one of the operands, empty, or the intersection of two rectangles.
+// Stores 'lhs op rhs' in dst and returns true in those cases, so that no spans need to be
+// rasterized. dst may be lhs.
+static bool shortcutOperation(uint32_t op, Region& dst, const Region& lhs, const Rect& rhs) {
+    const Rect bounds = lhs.getBounds();
+    if (!rhs.isValid() || !bounds.isValid()) {
+        return false;
+    }
+
+    auto setLhs = [&] {
+        if (&dst != &lhs) dst = lhs;
+    };
+    auto setRect = [&](const Rect& rect) {
+        if (rect.isEmpty()) {
+            dst.clear();
+        } else {
+            dst.set(rect);
+        }
+    };
+
+    Rect intersection;
+    switch (op) {
+        case op_or:
+            if (rhs.isEmpty() || (lhs.isRect() && contains(bounds, rhs))) {
+                setLhs();
+                return true;
+            }
+            if (lhs.isEmpty() || contains(rhs, bounds)) {
+                setRect(rhs);
+                return true;
+            }
+            return false;
+        case op_and:
+            if (!bounds.intersect(rhs, &intersection)) {
+                dst.clear();
+                return true;
+            }
+            if (contains(rhs, bounds)) {
+                setLhs();
+                return true;
+            }
+            if (lhs.isRect()) {
+                setRect(intersection);
+                return true;
+            }
+            return false;
+        case op_nand:
+            if (!bounds.intersect(rhs, &intersection)) {
+                setLhs();
+                return true;
+            }
+            if (contains(rhs, bounds)) {
+                dst.clear();
+                return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+// In-place operations need a copy of their left hand side while the result is written to the
+// region itself. Keeping it per thread lets its storage be reused from one operation to the next.
+static Region& getScratchRegion() {
+    static thread_local Region scratch;
+    return scratch;
+}
+
+// ----------------------------------------------------------------------------
+
 Region::Region() {
     mStorage.push_back(Rect(0, 0));
 }
@@ -329,7 +405,11 @@ Region& Region::subtractSelf(const Rect& r) {
     return operationSelf(r, op_nand);
 }
 Region& Region::operationSelf(const Rect& r, uint32_t op) {
-    Region lhs(*this);
+    if (shortcutOperation(op, *this, *this, r)) {
+        return *this;
+    }
+    Region& lhs = getScratchRegion();
+    lhs.mStorage.assign(mStorage.begin(), mStorage.end());
     boolean_operation(op, *this, lhs, r);
     return *this;
 }
@@ -353,7 +433,11 @@ Region& Region::subtractSelf(const Region& rhs) {
     return operationSelf(rhs, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, uint32_t op) {
-    Region lhs(*this);
+    if (rhs.isRect() && &rhs != this) {
+        return operationSelf(rhs.getBounds(), op);
+    }
+    Region& lhs = getScratchRegion();
+    lhs.mStorage.assign(mStorage.begin(), mStorage.end());
     boolean_operation(op, *this, lhs, rhs);
     return *this;
 }
@@ -393,7 +477,9 @@ const Region Region::subtract(const Rect& rhs) const {
 }
 const Region Region::operation(const Rect& rhs, uint32_t op) const {
     Region result;
-    boolean_operation(op, result, *this, rhs);
+    if (!shortcutOperation(op, result, *this, rhs)) {
+        boolean_operation(op, result, *this, rhs);
+    }
     return result;
 }
 
@@ -412,6 +498,9 @@ const Region Region::subtract(const Region& rhs) const {
     return operation(rhs, op_nand);
 }
 const Region Region::operation(const Region& rhs, uint32_t op) const {
+    if (rhs.isRect()) {
+        return operation(rhs.getBounds(), op);
+    }
     Region result;
     boolean_operation(op, result, *this, rhs);
     return result;
@@ -438,7 +527,8 @@ Region& Region::subtractSelf(const Region& rhs, int dx, int dy) {
     return operationSelf(rhs, dx, dy, op_nand);
 }
 Region& Region::operationSelf(const Region& rhs, int dx, int dy, uint32_t op) {
-    Region lhs(*this);
+    Region& lhs = getScratchRegion();
+    lhs.mStorage.assign(mStorage.begin(), mStorage.end());
     boolean_operation(op, *this, lhs, rhs, dx, dy);
     return *this;
 }
@@ -473,12 +563,20 @@ class Region::rasterizer : public region_operator<Rect>::region_rasterizer
     FatVector<Rect>& storage;
     Rect* head;
     Rect* tail;
-    FatVector<Rect> span;
+    // per thread, so that wide spans only grow it once
+    FatVector<Rect>& span;
     Rect* cur;
+
+    static FatVector<Rect>& getSpanStorage() {
+        static thread_local FatVector<Rect> spanStorage;
+        return spanStorage;
+    }
 public:
     explicit rasterizer(Region& reg)
-        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(), cur() {
+        : bounds(INT_MAX, 0, INT_MIN, 0), storage(reg.mStorage), head(), tail(),
+          span(getSpanStorage()), cur() {
         storage.clear();
+        span.clear();
     }
 
     virtual ~rasterizer();
@@ -32,7 +32,8 @@ Transform::Transform() {
 }
 
 Transform::Transform(const Transform&  other)
-    : mMatrix(other.mMatrix), mType(other.mType) {
+    : mMatrix(other.mMatrix), mType(other.mType), mInverse(other.mInverse),
+      mInverseValid(other.mInverseValid) {
 }
 
 Transform::Transform(uint32_t orientation, int w, int h) {
@@ -66,6 +67,7 @@ Transform Transform::operator*(const Transform& rhs) const {
     Transform r(*this);
     if (rhs.mType == IDENTITY)
         return r;
+    r.invalidateInverse();
 
     // TODO: we could use mType to optimize the matrix multiply
     const mat33& A(mMatrix);
@@ -89,6 +91,7 @@ Transform Transform::operator*(const Transform& rhs) const {
 
 Transform Transform::operator * (float value) const {
     Transform r(*this);
+    r.invalidateInverse();
     const mat33& M(mMatrix);
     mat33& R(r.mMatrix);
     for (size_t i = 0; i < 3; i++) {
@@ -103,6 +106,8 @@ Transform Transform::operator * (float value) const {
 Transform& Transform::operator=(const Transform& other) {
     mMatrix = other.mMatrix;
     mType = other.mType;
+    mInverse = other.mInverse;
+    mInverseValid = other.mInverseValid;
     return *this;
 }
 
@@ -144,6 +149,7 @@ float Transform::getScaleY() const {
 
 void Transform::reset() {
     mType = IDENTITY;
+    invalidateInverse();
     for(size_t i = 0; i < 3; i++) {
         vec3& v(mMatrix[i]);
         for (size_t j = 0; j < 3; j++)
@@ -152,6 +158,7 @@ void Transform::reset() {
 }
 
 void Transform::set(float tx, float ty) {
+    invalidateInverse();
     mMatrix[2][0] = tx;
     mMatrix[2][1] = ty;
     mMatrix[2][2] = 1.0f;
@@ -169,6 +176,7 @@ void Transform::set(float a, float b, float c, float d) {
     M[0][1] = c;    M[1][1] = d;
     M[0][2] = 0;    M[1][2] = 0;
     mType = UNKNOWN_TYPE;
+    invalidateInverse();
 }
 
 status_t Transform::set(uint32_t flags, float w, float h) {
@@ -219,6 +227,7 @@ void Transform::set(const std::array<float, 9>& matrix) {
     M[0][1] = matrix[3];  M[1][1] = matrix[4];  M[2][1] = matrix[5];
     M[0][2] = matrix[6];  M[1][2] = matrix[7];  M[2][2] = matrix[8];
     mType = UNKNOWN_TYPE;
+    invalidateInverse();
     type();
 }
 
@@ -249,29 +258,81 @@ Rect Transform::makeBounds(int w, int h) const {
 
 Rect Transform::transform(const Rect& bounds, bool roundOutwards) const {
     Rect r;
-    vec2 lt( bounds.left,  bounds.top    );
-    vec2 rt( bounds.right, bounds.top    );
-    vec2 lb( bounds.left,  bounds.bottom );
-    vec2 rb( bounds.right, bounds.bottom );
+    transform(&bounds, &r, 1, roundOutwards);
+    return r;
+}
 
-    lt = transform(lt);
-    rt = transform(rt);
-    lb = transform(lb);
-    rb = transform(rb);
+void Transform::transform(const Rect* in, Rect* out, size_t count, bool roundOutwards) const {
+    const float rounding = roundOutwards ? 0.f : 0.5f;
+    auto roundMin = [&](float v) {
+        return static_cast<int32_t>(floorf(v + rounding));
+    };
+    auto roundMax = [&](float v) {
+        return static_cast<int32_t>(roundOutwards ? ceilf(v) : floorf(v + rounding));
+    };
 
-    if (roundOutwards) {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]})));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]})));
-        r.right  = static_cast<int32_t>(ceilf(std::max({lt[0], rt[0], lb[0], rb[0]})));
-        r.bottom = static_cast<int32_t>(ceilf(std::max({lt[1], rt[1], lb[1], rb[1]})));
-    } else {
-        r.left   = static_cast<int32_t>(floorf(std::min({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.top    = static_cast<int32_t>(floorf(std::min({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
-        r.right  = static_cast<int32_t>(floorf(std::max({lt[0], rt[0], lb[0], rb[0]}) + 0.5f));
-        r.bottom = static_cast<int32_t>(floorf(std::max({lt[1], rt[1], lb[1], rb[1]}) + 0.5f));
+    const mat33& M(mMatrix);
+    if (type() <= TRANSLATE) {
+        const float x = M[2][0];
+        const float y = M[2][1];
+        for (size_t i = 0; i < count; i++) {
+            const Rect r(in[i]);
+            out[i].left = roundMin(r.left + x);
+            out[i].top = roundMin(r.top + y);
+            out[i].right = roundMax(r.right + x);
+            out[i].bottom = roundMax(r.bottom + y);
+        }
+        return;
     }
 
-    return r;
+    if (preserveRects()) {
+        // Each axis maps to a single axis, either straight (scale and flips)
+        // or swapped (90 degree rotations).
+        const bool swapped = !isZero(M[1][0]) || !isZero(M[0][1]);
+        const float sx = swapped ? M[1][0] : M[0][0];
+        const float sy = swapped ? M[0][1] : M[1][1];
+        const float x = M[2][0];
+        const float y = M[2][1];
+        for (size_t i = 0; i < count; i++) {
+            const Rect r(in[i]);
+            const float x0 = sx * (swapped ? r.top : r.left) + x;
+            const float x1 = sx * (swapped ? r.bottom : r.right) + x;
+            const float y0 = sy * (swapped ? r.left : r.top) + y;
+            const float y1 = sy * (swapped ? r.right : r.bottom) + y;
+            out[i].left = roundMin(std::min(x0, x1));
+            out[i].top = roundMin(std::min(y0, y1));
+            out[i].right = roundMax(std::max(x0, x1));
+            out[i].bottom = roundMax(std::max(y0, y1));
+        }
+        return;
+    }
+
+    // The corners of a batch of rects go through the matrix in one go, so that
+    // it stays in SIMD registers.
+    constexpr size_t kBatchSize = 16;
+    const mat4 m = asMatrix4();
+    vec2 corners[kBatchSize * 4];
+
+    while (count > 0) {
+        const size_t n = std::min(count, kBatchSize);
+        for (size_t i = 0; i < n; i++) {
+            corners[i * 4 + 0] = vec2(in[i].left, in[i].top);
+            corners[i * 4 + 1] = vec2(in[i].right, in[i].top);
+            corners[i * 4 + 2] = vec2(in[i].left, in[i].bottom);
+            corners[i * 4 + 3] = vec2(in[i].right, in[i].bottom);
+        }
+        transformPoints(m, corners, corners, n * 4);
+        for (size_t i = 0; i < n; i++) {
+            const vec2* c = &corners[i * 4];
+            out[i].left = roundMin(std::min({c[0].x, c[1].x, c[2].x, c[3].x}));
+            out[i].top = roundMin(std::min({c[0].y, c[1].y, c[2].y, c[3].y}));
+            out[i].right = roundMax(std::max({c[0].x, c[1].x, c[2].x, c[3].x}));
+            out[i].bottom = roundMax(std::max({c[0].y, c[1].y, c[2].y, c[3].y}));
+        }
+        in += n;
+        out += n;
+        count -= n;
+    }
 }
 
 FloatRect Transform::transform(const FloatRect& bounds) const {
@@ -298,10 +359,18 @@ Region Transform::transform(const Region& reg) const {
     Region out;
     if (CC_UNLIKELY(type() > TRANSLATE)) {
         if (CC_LIKELY(preserveRects())) {
-            Region::const_iterator it = reg.begin();
-            Region::const_iterator const end = reg.end();
-            while (it != end) {
-                out.orSelf(transform(*it++));
+            size_t count;
+            const Rect* rects = reg.getArray(&count);
+            constexpr size_t kBatchSize = 16;
+            Rect transformed[kBatchSize];
+            while (count > 0) {
+                const size_t n = std::min(count, kBatchSize);
+                transform(rects, transformed, n);
+                for (size_t i = 0; i < n; i++) {
+                    out.orSelf(transformed[i]);
+                }
+                rects += n;
+                count -= n;
             }
         } else {
             out.set(transform(reg.bounds()));
@@ -367,17 +436,27 @@ uint32_t Transform::type() const {
 }
 
 Transform Transform::inverse() const {
+    Transform result;
+    result.mType = mType;
+    if (!mInverseValid) {
+        computeInverse(mInverse);
+        mInverseValid = true;
+    }
+    result.mMatrix = mInverse;
+    return result;
+}
+
+void Transform::computeInverse(mat33& inverse) const {
     // our 3x3 matrix is always of the form of a 2x2 transformation
     // followed by a translation: T*M, therefore:
     // (T*M)^-1 = M^-1 * T^-1
-    Transform result;
+    inverse = mMatrix;
     if (mType <= TRANSLATE) {
         // 1 0 0
         // 0 1 0
         // x y 1
-        result = *this;
-        result.mMatrix[2][0] = -result.mMatrix[2][0];
-        result.mMatrix[2][1] = -result.mMatrix[2][1];
+        inverse[2][0] = -inverse[2][0];
+        inverse[2][1] = -inverse[2][1];
     } else {
         // a c 0
         // b d 0
@@ -391,18 +470,17 @@ Transform Transform::inverse() const {
         const float y = M[2][1];
 
         const float idet = 1.0f / (a*d - b*c);
-        result.mMatrix[0][0] =  d*idet;
-        result.mMatrix[0][1] = -c*idet;
-        result.mMatrix[1][0] = -b*idet;
-        result.mMatrix[1][1] =  a*idet;
-        result.mType = mType;
-
-        vec2 T(-x, -y);
-        T = result.transform(T);
-        result.mMatrix[2][0] = T[0];
-        result.mMatrix[2][1] = T[1];
+        inverse[0][0] =  d*idet;
+        inverse[0][1] = -c*idet;
+        inverse[1][0] = -b*idet;
+        inverse[1][1] =  a*idet;
+        inverse[0][2] = 0;
+        inverse[1][2] = 0;
+        inverse[2][2] = 1;
+
+        inverse[2][0] = inverse[0][0]*-x + inverse[1][0]*-y;
+        inverse[2][1] = inverse[0][1]*-x + inverse[1][1]*-y;
     }
-    return result;
 }
 
 uint32_t Transform::getType() const {
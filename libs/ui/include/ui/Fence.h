@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <android-base/unique_fd.h>
 #include <utils/Flattenable.h>
 #include <utils/RefBase.h>
@@ -94,6 +96,11 @@ public:
     static sp<Fence> merge(const String8& name, const sp<Fence>& f1,
             const sp<Fence>& f2);
 
+    // merge combines any number of Fence objects into a new Fence object that
+    // becomes signaled when all of them are signaled. Invalid fences are
+    // skipped, and NO_FENCE is returned if none of the fences is valid.
+    static sp<Fence> merge(const char* name, const std::vector<sp<Fence>>& fences);
+
     // Return a duplicate of the fence file descriptor. The caller is
     // responsible for closing the returned file descriptor. On error, -1 will
     // be returned and errno will indicate the problem.
@@ -111,6 +118,22 @@ public:
     // error occurs then SIGNAL_TIME_INVALID is returned.
     nsecs_t getSignalTime() const;
 
+    // getSignalTimes stores the getSignalTime() of count fences in outTimes.
+    // A single poll() tells which fences have signaled, so that only those
+    // need to be queried for their timestamp.
+    static void getSignalTimes(const sp<Fence>* fences, size_t count, nsecs_t* outTimes);
+
+    // The number of fence syscalls made by this process, for profiling.
+    struct SyscallCounts {
+        uint64_t waits = 0;
+        uint64_t merges = 0;
+        uint64_t signalTimeQueries = 0;
+        uint64_t polls = 0;
+
+        uint64_t total() const { return waits + merges + signalTimeQueries + polls; }
+    };
+    static SyscallCounts getSyscallCounts();
+
     enum class Status {
         Invalid,     // Fence is invalid
         Unsignaled,  // Fence is valid but has not yet signaled
@@ -26,6 +26,7 @@
 #include <mutex>
 #include <queue>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 
@@ -109,6 +110,11 @@ public:
     // Gets the cached timestamp without attempting to query the Fence.
     nsecs_t getCachedSignalTime() const;
 
+    // Updates the cached timestamps of all the fences that haven't signaled
+    // yet, checking them all with a single poll. Afterwards,
+    // getCachedSignalTime() is as current as getSignalTime() would have been.
+    static void updateSignalTimes(const std::vector<std::shared_ptr<FenceTime>>& fences);
+
     // Returns a snapshot of the FenceTime in its current state.
     Snapshot getSnapshot() const;
 
@@ -126,6 +132,9 @@ private:
     // never return SIGNAL_TIME_INVALID and isValid will always return true.
     FenceTime(const sp<Fence>& fence, bool forceValidForTest);
 
+    // Caches signalTime, as returned by mFence, once it is no longer pending.
+    nsecs_t applySignalTime(nsecs_t signalTime);
+
     enum class State {
         VALID,
         INVALID,
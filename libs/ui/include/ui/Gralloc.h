@@ -74,6 +74,15 @@ public:
     // owned by the caller
     virtual int unlock(buffer_handle_t bufferHandle) const = 0;
 
+    // rereadLockedBuffer invalidates the CPU caches of a buffer that is still
+    // locked for CPU reading, so that writes made since by another (non-CPU)
+    // producer become visible through the existing mapping. Note that this
+    // function is not supported before gralloc 4.0, in which case a status_t
+    // of INVALID_OPERATION will be returned.
+    virtual status_t rereadLockedBuffer(buffer_handle_t /*bufferHandle*/) const {
+        return INVALID_OPERATION;
+    }
+
     // isSupported queries whether or not a buffer with the given width, height,
     // format, layer count, and usage can be allocated on the device.  If
     // *outSupported is set to true, a buffer with the given specifications may be successfully
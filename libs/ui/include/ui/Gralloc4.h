@@ -26,7 +26,9 @@
 #include <ui/Rect.h>
 #include <utils/StrongPointer.h>
 
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 namespace android {
 
@@ -64,6 +66,8 @@ public:
 
     int unlock(buffer_handle_t bufferHandle) const override;
 
+    status_t rereadLockedBuffer(buffer_handle_t bufferHandle) const override;
+
     status_t isSupported(uint32_t width, uint32_t height, PixelFormat format, uint32_t layerCount,
                          uint64_t usage, bool* outSupported) const override;
 
@@ -149,9 +153,23 @@ public:
     std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataTypeDescription>
     listSupportedMetadataTypes() const;
 
+    // Fetches the encoded values of several metadata types of a buffer at once. outValues is
+    // filled in the order of metadataTypes. Immutable standard metadata is served from the
+    // per-buffer cache; the rest is fetched with a single dumpBuffer call when more than one
+    // type is missing.
+    status_t getMultiple(
+            buffer_handle_t bufferHandle,
+            const std::vector<android::hardware::graphics::mapper::V4_0::IMapper::MetadataType>&
+                    metadataTypes,
+            std::vector<hardware::hidl_vec<uint8_t>>* outValues) const;
+
 private:
     friend class GraphicBufferAllocator;
 
+    // Standard metadata that cannot change over the lifetime of a buffer, encoded, keyed by
+    // StandardMetadataType.
+    using MetadataCacheEntry = std::unordered_map<int64_t, hardware::hidl_vec<uint8_t>>;
+
     // Determines whether the passed info is compatible with the mapper.
     status_t validateBufferDescriptorInfo(
             hardware::graphics::mapper::V4_0::IMapper::BufferDescriptorInfo* descriptorInfo) const;
@@ -159,6 +177,23 @@ private:
     template <class T>
     using DecodeFunction = status_t (*)(const hardware::hidl_vec<uint8_t>& input, T* output);
 
+    static bool isImmutableMetadataType(
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType);
+
+    bool getCachedMetadata(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
+            hardware::hidl_vec<uint8_t>* outVec) const;
+    void cacheMetadata(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
+            const hardware::hidl_vec<uint8_t>& vec) const;
+
+    status_t getEncoded(
+            buffer_handle_t bufferHandle,
+            const android::hardware::graphics::mapper::V4_0::IMapper::MetadataType& metadataType,
+            hardware::hidl_vec<uint8_t>* outVec) const;
+
     template <class T>
     status_t get(
             buffer_handle_t bufferHandle,
@@ -182,6 +217,12 @@ private:
             std::ostringstream* outDump, uint64_t* outAllocationSize, bool less) const;
 
     sp<hardware::graphics::mapper::V4_0::IMapper> mMapper;
+
+    // Keyed by the imported handle rather than the buffer id, since looking up the id is a HAL
+    // call itself. Entries are dropped in freeBuffer, before the handle can be reused. The map is
+    // guarded by mMetadataCacheMutex.
+    mutable std::mutex mMetadataCacheMutex;
+    mutable std::unordered_map<buffer_handle_t, MetadataCacheEntry> mMetadataCache;
 };
 
 class Gralloc4Allocator : public GrallocAllocator {
@@ -20,8 +20,10 @@
 
 #include <stdint.h>
 
+#include <list>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include <cutils/native_handle.h>
 
@@ -31,6 +33,7 @@
 #include <utils/KeyedVector.h>
 #include <utils/Mutex.h>
 #include <utils/Singleton.h>
+#include <utils/Timers.h>
 
 namespace android {
 
@@ -72,6 +75,34 @@ public:
 
     status_t free(buffer_handle_t handle);
 
+    /**
+     * Like allocate(), but reuses a buffer handed back with release() when one with the same
+     * dimensions, format, layer count and usage is pooled. The contents of a reused buffer are
+     * undefined.
+     */
+    status_t allocatePooled(uint32_t w, uint32_t h, PixelFormat format, uint32_t layerCount,
+                            uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
+                            std::string requestorName);
+
+    /**
+     * Returns a buffer from allocate() or allocatePooled() to the pool, or frees it if pooling is
+     * disabled or the buffer doesn't fit. Only buffers that were never shared with another process
+     * may be released, since their memory is handed out again.
+     */
+    status_t release(buffer_handle_t handle);
+
+    /**
+     * Sets how many bytes of released buffers may be kept for reuse, trimming the least recently
+     * released ones. 0, the default, disables pooling.
+     */
+    void setPoolLimit(size_t maxBytes);
+
+    /**
+     * Frees the least recently released buffers until the pool holds at most maxBytes, e.g. under
+     * memory pressure. The limit itself is unchanged.
+     */
+    void trimPool(size_t maxBytes);
+
     uint64_t getTotalSize() const;
 
     void dump(std::string& res, bool less = true) const;
@@ -91,11 +122,32 @@ protected:
 
     status_t allocateHelper(uint32_t w, uint32_t h, PixelFormat format, uint32_t layerCount,
                             uint64_t usage, buffer_handle_t* handle, uint32_t* stride,
-                            std::string requestorName, bool importBuffer);
+                            std::string requestorName, bool importBuffer, bool pooled = false);
+
+    void trimPoolLocked(size_t maxBytes, std::vector<buffer_handle_t>* outFreed);
 
     static Mutex sLock;
     static KeyedVector<buffer_handle_t, alloc_rec_t> sAllocList;
 
+    struct pool_rec_t {
+        buffer_handle_t handle;
+        alloc_rec_t rec;
+    };
+
+    // Released buffers, most recently released first. Guarded by sLock.
+    std::list<pool_rec_t> mPool;
+    size_t mPoolLimit = 0;
+    size_t mPoolSize = 0;
+
+    // Guarded by sLock.
+    struct {
+        uint64_t poolHits = 0;
+        uint64_t poolMisses = 0;
+        uint64_t allocations = 0;
+        nsecs_t totalAllocationTime = 0;
+        nsecs_t maxAllocationTime = 0;
+    } mStats;
+
     friend class Singleton<GraphicBufferAllocator>;
     GraphicBufferAllocator();
     ~GraphicBufferAllocator();
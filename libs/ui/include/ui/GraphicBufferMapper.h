@@ -86,6 +86,10 @@ public:
 
     status_t unlockAsync(buffer_handle_t handle, int *fenceFd);
 
+    // Makes writes by other producers visible to a buffer that is still locked
+    // for CPU reading. Returns INVALID_OPERATION before gralloc 4.0.
+    status_t rereadLockedBuffer(buffer_handle_t handle);
+
     status_t isSupported(uint32_t width, uint32_t height, android::PixelFormat format,
                          uint32_t layerCount, uint64_t usage, bool* outSupported);
 
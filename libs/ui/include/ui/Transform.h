@@ -95,6 +95,10 @@ public:
     Rect    transform(const Rect& bounds,
                       bool roundOutwards = false) const;
     FloatRect transform(const FloatRect& bounds) const;
+    // transforms count rects at once, in may be the same array as out.
+    // Translations and 90 degree rotations skip the matrix math.
+    void    transform(const Rect* in, Rect* out, size_t count,
+                      bool roundOutwards = false) const;
     Transform& operator = (const Transform& other);
     Transform operator * (const Transform& rhs) const;
     Transform operator * (float value) const;
@@ -105,6 +109,7 @@ public:
     // Expands from the internal 3x3 matrix to an equivalent 4x4 matrix
     mat4 asMatrix4() const;
 
+    // The inverse is computed once and cached until the transform changes.
     Transform inverse() const;
 
     // for debugging
@@ -127,8 +132,13 @@ private:
     static bool absIsOne(float f);
     static bool isZero(float f);
 
+    void computeInverse(mat33& inverse) const;
+    void invalidateInverse() { mInverseValid = false; }
+
     mat33               mMatrix;
     mutable uint32_t    mType;
+    mutable mat33       mInverse;
+    mutable bool        mInverseValid = false;
 };
 
 inline void PrintTo(const Transform& t, ::std::ostream* os) {
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FenceTest"
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+#include <ui/Fence.h>
+#include <ui/FenceTime.h>
+
+namespace android {
+
+TEST(FenceTest, MergeWithoutValidFences) {
+    EXPECT_EQ(Fence::NO_FENCE, Fence::merge("test", std::vector<sp<Fence>>{}));
+    EXPECT_EQ(Fence::NO_FENCE,
+              Fence::merge("test", std::vector<sp<Fence>>{Fence::NO_FENCE, nullptr,
+                                                          sp<Fence>(new Fence())}));
+}
+
+TEST(FenceTest, GetSignalTimesPollsOnce) {
+    // The read end of a pipe stands in for a fence that hasn't signaled: it
+    // isn't readable, so it's reported as pending without being queried.
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    base::unique_fd writeEnd(fds[1]);
+    const sp<Fence> fences[] = {Fence::NO_FENCE, sp<Fence>(new Fence(fds[0])), nullptr};
+
+    const Fence::SyscallCounts before = Fence::getSyscallCounts();
+    nsecs_t times[3] = {};
+    Fence::getSignalTimes(fences, 3, times);
+    const Fence::SyscallCounts after = Fence::getSyscallCounts();
+
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, times[0]);
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, times[1]);
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, times[2]);
+    EXPECT_EQ(before.polls + 1, after.polls);
+    EXPECT_EQ(before.signalTimeQueries, after.signalTimeQueries);
+
+    // No valid fence, no syscall.
+    Fence::getSignalTimes(fences, 1, times);
+    EXPECT_EQ(after.total(), Fence::getSyscallCounts().total());
+}
+
+TEST(FenceTest, UpdateSignalTimes) {
+    FenceToFenceTimeMap fenceMap;
+    const sp<Fence> fence = sp<Fence>(new Fence());
+    std::vector<std::shared_ptr<FenceTime>> fenceTimes = {fenceMap.createFenceTimeForTest(fence),
+                                                          FenceTime::NO_FENCE, nullptr};
+
+    FenceTime::updateSignalTimes(fenceTimes);
+    EXPECT_EQ(Fence::SIGNAL_TIME_PENDING, fenceTimes[0]->getCachedSignalTime());
+    EXPECT_EQ(Fence::SIGNAL_TIME_INVALID, fenceTimes[1]->getCachedSignalTime());
+
+    fenceMap.signalAllForTest(fence, 1234);
+    FenceTime::updateSignalTimes(fenceTimes);
+    EXPECT_EQ(1234, fenceTimes[0]->getCachedSignalTime());
+}
+
+} // namespace android
@@ -53,6 +53,11 @@ public:
                     allocate)
                 .WillOnce(DoAll(SetArgPointee<7>(stride), Return(err)));
     }
+    void setUpAllocateExpectations(status_t err, uint32_t stride, buffer_handle_t handle) {
+        EXPECT_CALL(*(reinterpret_cast<const mock::MockGrallocAllocator*>(mAllocator.get())),
+                    allocate)
+                .WillOnce(DoAll(SetArgPointee<7>(stride), SetArgPointee<8>(handle), Return(err)));
+    }
     std::unique_ptr<const GrallocAllocator>& getAllocator() { return mAllocator; }
 };
 
@@ -113,4 +118,34 @@ TEST_F(GraphicBufferAllocatorTest, AllocateLargeStride) {
     ASSERT_EQ(NO_ERROR, err);
     ASSERT_EQ(expectedStride, stride);
 }
+
+TEST_F(GraphicBufferAllocatorTest, AllocatePooledReusesReleasedBuffer) {
+    android::PixelFormat format = PIXEL_FORMAT_RGBA_8888;
+    // never dereferenced, the buffer stays pooled for the rest of the test
+    const auto fakeHandle = reinterpret_cast<buffer_handle_t>(0x1000);
+
+    mAllocator.setPoolLimit(1024 * 1024);
+    mAllocator.setUpAllocateExpectations(NO_ERROR, kTestWidth, fakeHandle);
+    uint32_t stride = 0;
+    buffer_handle_t handle = nullptr;
+    status_t err = mAllocator.allocatePooled(kTestWidth, kTestHeight, format, kTestLayerCount,
+                                             kTestUsage, &handle, &stride,
+                                             "GraphicBufferAllocatorTest");
+    ASSERT_EQ(NO_ERROR, err);
+    ASSERT_EQ(fakeHandle, handle);
+    ASSERT_EQ(NO_ERROR, mAllocator.release(handle));
+
+    // served from the pool, the gralloc allocator isn't called again
+    stride = 0;
+    handle = nullptr;
+    err = mAllocator.allocatePooled(kTestWidth, kTestHeight, format, kTestLayerCount, kTestUsage,
+                                    &handle, &stride, "GraphicBufferAllocatorTest");
+    ASSERT_EQ(NO_ERROR, err);
+    EXPECT_EQ(fakeHandle, handle);
+    EXPECT_EQ(kTestWidth, stride);
+
+    std::string dump;
+    mAllocator.dump(dump);
+    EXPECT_NE(std::string::npos, dump.find("1 hits, 1 misses"));
+}
 } // namespace android
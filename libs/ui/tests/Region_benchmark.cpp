@@ -0,0 +1,139 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <ui/Region.h>
+
+namespace android {
+
+namespace {
+
+constexpr int32_t kWidth = 1080;
+constexpr int32_t kHeight = 2340;
+
+struct Layer {
+    Region visible;
+    Region opaque;
+};
+
+// Builds a typical phone layer stack, front to back: status bar, navigation
+// bar, a dialog with rounded corners, a wallpaper-like notification shade and
+// the fullscreen app.
+std::vector<Layer> makeLayerStack() {
+    std::vector<Layer> layers;
+
+    Layer statusBar;
+    statusBar.visible.set(Rect(0, 0, kWidth, 80));
+    layers.push_back(statusBar);
+
+    Layer navBar;
+    navBar.visible.set(Rect(0, kHeight - 130, kWidth, kHeight));
+    layers.push_back(navBar);
+
+    Layer dialog;
+    const Rect dialogRect(90, 800, kWidth - 90, 1500);
+    dialog.visible.set(dialogRect);
+    for (int32_t i = 0; i < 16; i++) {
+        const int32_t inset = 16 - i;
+        dialog.opaque.orSelf(Rect(dialogRect.left + inset, dialogRect.top + i,
+                                  dialogRect.right - inset, dialogRect.top + i + 1));
+        dialog.opaque.orSelf(Rect(dialogRect.left + inset, dialogRect.bottom - i - 1,
+                                  dialogRect.right - inset, dialogRect.bottom - i));
+    }
+    dialog.opaque.orSelf(Rect(dialogRect.left, dialogRect.top + 16, dialogRect.right,
+                              dialogRect.bottom - 16));
+    layers.push_back(dialog);
+
+    Layer toast;
+    toast.visible.set(Rect(200, 1900, kWidth - 200, 2000));
+    layers.push_back(toast);
+
+    Layer app;
+    app.visible.set(Rect(0, 0, kWidth, kHeight));
+    app.opaque.set(Rect(0, 0, kWidth, kHeight));
+    layers.push_back(app);
+
+    return layers;
+}
+
+// Mirrors the visible region computation SurfaceFlinger runs on every
+// composition: walk the layers front to back, clip each one against what's
+// covered so far and accumulate the dirty region.
+void BM_ComputeVisibleRegions(benchmark::State& state) {
+    const std::vector<Layer> layers = makeLayerStack();
+    const Rect screen(0, 0, kWidth, kHeight);
+
+    for (auto _ : state) {
+        Region aboveOpaque;
+        Region aboveCovered;
+        Region dirty;
+        for (const Layer& layer : layers) {
+            Region visible = layer.visible.intersect(screen);
+            Region covered = aboveCovered.intersect(visible);
+            aboveCovered.orSelf(visible);
+            visible.subtractSelf(aboveOpaque);
+            aboveOpaque.orSelf(layer.opaque);
+            dirty.orSelf(visible.subtract(covered));
+            benchmark::DoNotOptimize(covered);
+        }
+        benchmark::DoNotOptimize(dirty);
+    }
+}
+BENCHMARK(BM_ComputeVisibleRegions);
+
+// Rectangle against region operations, which take the shortcuts.
+void BM_RegionOpRect(benchmark::State& state) {
+    const std::vector<Layer> layers = makeLayerStack();
+    const Region& dialog = layers[2].opaque;
+    const Rect inside(200, 1000, 800, 1200);
+    const Rect outside(0, 0, kWidth, 80);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(dialog.intersect(outside));
+        benchmark::DoNotOptimize(dialog.subtract(outside));
+        benchmark::DoNotOptimize(dialog.merge(Rect(0, 0, kWidth, kHeight)));
+        Region region(inside);
+        region.orSelf(Rect(250, 1050, 750, 1150));
+        region.andSelf(Rect(0, 0, kWidth, kHeight));
+        benchmark::DoNotOptimize(region);
+    }
+}
+BENCHMARK(BM_RegionOpRect);
+
+// Region against region operations, which always go through the band sweep.
+void BM_RegionOpRegion(benchmark::State& state) {
+    const std::vector<Layer> layers = makeLayerStack();
+    const Region& dialog = layers[2].opaque;
+    Region shifted(dialog);
+    shifted.translateSelf(37, 53);
+
+    for (auto _ : state) {
+        Region region(dialog);
+        region.orSelf(shifted);
+        region.subtractSelf(dialog);
+        benchmark::DoNotOptimize(region.intersect(shifted));
+        benchmark::DoNotOptimize(region.xorSelf(dialog));
+    }
+}
+BENCHMARK(BM_RegionOpRegion);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
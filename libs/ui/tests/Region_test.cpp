@@ -167,6 +167,42 @@ TEST_F(RegionTest, EqualsToSelf) {
     ASSERT_TRUE(touchableRegion.contains(50, 50));
 }
 
+TEST_F(RegionTest, RectOperationsMatchPixels) {
+    constexpr int kSize = 8;
+    auto randomRect = [] {
+        int l = random() % kSize, t = random() % kSize;
+        return Rect(l, t, l + random() % (kSize - l + 1), t + random() % (kSize - t + 1));
+    };
+    srandom(5);
+    for (int iteration = 0; iteration < 1000; iteration++) {
+        Region lhs;
+        for (int i = random() % 4; i > 0; i--) {
+            lhs.orSelf(randomRect());
+        }
+        const Rect rhs = randomRect();
+
+        const Region merged = lhs.merge(rhs);
+        const Region intersected = lhs.intersect(rhs);
+        const Region subtracted = lhs.subtract(rhs);
+        Region andSelf(lhs);
+        andSelf.andSelf(rhs);
+        Region subtractSelf(lhs);
+        subtractSelf.subtractSelf(Region(rhs));
+
+        for (int x = 0; x < kSize; x++) {
+            for (int y = 0; y < kSize; y++) {
+                const bool inLhs = lhs.contains(x, y);
+                const bool inRhs = Region(rhs).contains(x, y);
+                ASSERT_EQ(inLhs || inRhs, merged.contains(x, y));
+                ASSERT_EQ(inLhs && inRhs, intersected.contains(x, y));
+                ASSERT_EQ(inLhs && !inRhs, subtracted.contains(x, y));
+                ASSERT_EQ(inLhs && inRhs, andSelf.contains(x, y));
+                ASSERT_EQ(inLhs && !inRhs, subtractSelf.contains(x, y));
+            }
+        }
+    }
+}
+
 TEST_F(RegionTest, RegionHash) {
     Region region1;
     region1.addRectUnchecked(10, 20, 30, 40);
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <vector>
+
+#include <ui/Transform.h>
+
+#include <gtest/gtest.h>
+
+namespace android::ui {
+
+// maps the four corners and rounds their bounds, the way a generic matrix does
+static Rect transformCorners(const Transform& t, const Rect& r, bool roundOutwards) {
+    const vec2 corners[] = {t.transform(vec2(r.left, r.top)), t.transform(vec2(r.right, r.top)),
+                            t.transform(vec2(r.left, r.bottom)),
+                            t.transform(vec2(r.right, r.bottom))};
+    float left = corners[0].x, top = corners[0].y, right = left, bottom = top;
+    for (const vec2& c : corners) {
+        left = std::min(left, c.x);
+        top = std::min(top, c.y);
+        right = std::max(right, c.x);
+        bottom = std::max(bottom, c.y);
+    }
+    const float rounding = roundOutwards ? 0.f : 0.5f;
+    auto round = [=](float v, bool up) {
+        return static_cast<int32_t>(roundOutwards && up ? ceilf(v) : floorf(v + rounding));
+    };
+    return Rect(round(left, false), round(top, false), round(right, true), round(bottom, true));
+}
+
+TEST(TransformTest, BatchRectsMatchCorners) {
+    Rect rects[37];
+    for (size_t i = 0; i < std::size(rects); i++) {
+        const int32_t v = static_cast<int32_t>(i);
+        rects[i] = Rect(v, 2 * v, 3 * v + 7, 4 * v + 5);
+    }
+
+    Transform translate;
+    translate.set(3.25f, -10.5f);
+    Transform scale;
+    scale.set(1.5f, 0.f, 0.f, 0.75f);
+    scale.set(3.25f, -10.5f);
+    Transform rotate45;
+    rotate45.set(0.7071f, 0.7071f, -0.7071f, 0.7071f);
+
+    std::vector<Transform> transforms = {Transform(), translate, scale, rotate45};
+    for (uint32_t orientation : {Transform::ROT_90, Transform::ROT_180, Transform::ROT_270,
+                                 Transform::FLIP_H, Transform::FLIP_V}) {
+        Transform rotation;
+        rotation.set(orientation, 800, 600);
+        transforms.push_back(rotation);
+        transforms.push_back(scale * rotation);
+    }
+
+    for (const Transform& t : transforms) {
+        for (bool roundOutwards : {false, true}) {
+            Rect out[std::size(rects)];
+            t.transform(rects, out, std::size(rects), roundOutwards);
+            for (size_t i = 0; i < std::size(rects); i++) {
+                EXPECT_EQ(transformCorners(t, rects[i], roundOutwards), out[i]);
+                EXPECT_EQ(out[i], t.transform(rects[i], roundOutwards));
+            }
+        }
+    }
+}
+
+TEST(TransformTest, BatchRectsInPlace) {
+    Rect rects[] = {Rect(0, 0, 10, 20), Rect(5, 5, 6, 6)};
+    Transform transform;
+    transform.set(Transform::ROT_90, 100, 200);
+    const Rect expected[] = {transform.transform(rects[0]), transform.transform(rects[1])};
+
+    transform.transform(rects, rects, std::size(rects));
+    EXPECT_EQ(expected[0], rects[0]);
+    EXPECT_EQ(expected[1], rects[1]);
+}
+
+TEST(TransformTest, InverseFollowsChanges) {
+    Transform transform;
+    transform.set(Transform::ROT_90, 100, 200);
+    const Transform inverse = transform.inverse();
+    EXPECT_EQ(Rect(0, 0, 10, 20), inverse.transform(transform.transform(Rect(0, 0, 10, 20))));
+    EXPECT_EQ(inverse, transform.inverse());
+
+    Transform copy(transform);
+    EXPECT_EQ(inverse, copy.inverse());
+
+    transform.reset();
+    EXPECT_EQ(Transform(), transform.inverse());
+    transform.set(5, 7);
+    EXPECT_EQ(vec2(-5, -7), transform.inverse().transform(vec2(0, 0)));
+    transform.set(2, 0, 0, 4);
+    EXPECT_EQ(vec2(1, 1), transform.inverse().transform(vec2(7, 11)));
+
+    Transform scaled = copy * 2;
+    EXPECT_EQ(vec2(0, 0), (scaled.inverse() * scaled).transform(vec2(0, 0)));
+    EXPECT_FALSE(inverse == scaled.inverse());
+    EXPECT_EQ(inverse, copy.inverse());
+}
+
+} // namespace android::ui
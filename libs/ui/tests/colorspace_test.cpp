@@ -180,4 +180,80 @@ TEST_F(ColorSpaceTest, LUT) {
 
 }
 
+TEST_F(ColorSpaceTest, PrecomputedGamuts) {
+    const ColorSpace spaces[] = {
+        ColorSpace::sRGB(), ColorSpace::linearSRGB(), ColorSpace::extendedSRGB(),
+        ColorSpace::linearExtendedSRGB(), ColorSpace::NTSC(), ColorSpace::BT709(),
+        ColorSpace::BT2020(), ColorSpace::AdobeRGB(), ColorSpace::ProPhotoRGB(),
+        ColorSpace::DisplayP3(), ColorSpace::DCIP3(), ColorSpace::ACES(), ColorSpace::ACEScg(),
+    };
+
+    for (const ColorSpace& space : spaces) {
+        SCOPED_TRACE(space.getName());
+        ColorSpace reference("reference", space.getPrimaries(), space.getWhitePoint());
+        for (size_t c = 0; c < 3; c++) {
+            for (size_t r = 0; r < 3; r++) {
+                EXPECT_NEAR(reference.getRGBtoXYZ()[c][r], space.getRGBtoXYZ()[c][r], 1e-6f);
+                EXPECT_NEAR(reference.getXYZtoRGB()[c][r], space.getXYZtoRGB()[c][r], 1e-5f);
+            }
+        }
+
+        mat3 identity = space.getXYZtoRGB() * space.getRGBtoXYZ();
+        for (size_t c = 0; c < 3; c++) {
+            for (size_t r = 0; r < 3; r++) {
+                EXPECT_NEAR(c == r ? 1.0f : 0.0f, identity[c][r], 1e-5f);
+            }
+        }
+    }
+}
+
+TEST_F(ColorSpaceTest, TransferFunctionLUT) {
+    const ColorSpace spaces[] = {
+        ColorSpace::sRGB(), ColorSpace::DisplayP3(), ColorSpace::BT2020(),
+    };
+
+    for (const ColorSpace& space : spaces) {
+        SCOPED_TRACE(space.getName());
+        TransferFunctionLUT eotf(space.getEOTF());
+        TransferFunctionLUT oetf(space.getOETF());
+        EXPECT_EQ(1024u, eotf.getSize());
+
+        float eotfError = 0.0f;
+        float oetfError = 0.0f;
+        for (uint32_t i = 0; i <= 10000; i++) {
+            float v = i / 10000.0f;
+            eotfError = std::max(eotfError, std::abs(eotf(v) - space.getEOTF()(v)));
+            oetfError = std::max(oetfError, std::abs(oetf(v) - space.getOETF()(v)));
+        }
+        EXPECT_LT(eotfError, 1e-4f);
+        EXPECT_LT(oetfError, 1e-3f);
+
+        // values outside of the range are clamped
+        EXPECT_EQ(eotf(0.0f), eotf(-1.0f));
+        EXPECT_EQ(eotf(1.0f), eotf(2.0f));
+        EXPECT_EQ(eotf(0.0f), eotf(NAN));
+        EXPECT_NEAR(space.getEOTF()(1.0f), eotf(1.0f), 1e-6f);
+    }
+}
+
+TEST_F(ColorSpaceTest, TransferFunctionLUTExtendedRange) {
+    ColorSpace extendedSRGB = ColorSpace::extendedSRGB();
+    TransferFunctionLUT eotf(extendedSRGB.getEOTF(), 4096, -0.799f, 2.399f);
+
+    float values[] = {-0.5f, -0.01f, 0.0f, 0.2f, 0.73f, 1.0f, 1.6f, 2.3f};
+    float expected[8];
+    for (size_t i = 0; i < 8; i++) {
+        expected[i] = extendedSRGB.getEOTF()(values[i]);
+    }
+    eotf.apply(values, 8);
+    for (size_t i = 0; i < 8; i++) {
+        EXPECT_NEAR(expected[i], values[i], 1e-4f * std::max(1.0f, std::abs(expected[i])));
+    }
+
+    float3 rgb = eotf(float3{0.2f, 0.73f, 1.6f});
+    EXPECT_NEAR(extendedSRGB.getEOTF()(0.2f), rgb.r, 1e-4f);
+    EXPECT_NEAR(extendedSRGB.getEOTF()(0.73f), rgb.g, 1e-4f);
+    EXPECT_NEAR(extendedSRGB.getEOTF()(1.6f), rgb.b, 1e-4f);
+}
+
 }; // namespace android
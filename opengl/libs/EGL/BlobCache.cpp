@@ -22,8 +22,9 @@
 #include <errno.h>
 #include <inttypes.h>
 #include <log/log.h>
+#include <string.h>
 
-#include <chrono>
+#include <string_view>
 
 namespace android {
 
@@ -40,19 +41,14 @@ BlobCache::BlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize
       : mMaxTotalSize(maxTotalSize),
         mMaxKeySize(maxKeySize),
         mMaxValueSize(maxValueSize),
-        mTotalSize(0) {
-    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
-#ifdef _WIN32
-    srand(now);
-#else
-    mRandState[0] = (now >> 0) & 0xFFFF;
-    mRandState[1] = (now >> 16) & 0xFFFF;
-    mRandState[2] = (now >> 32) & 0xFFFF;
-#endif
-    ALOGV("initializing random seed using %lld", (unsigned long long)now);
-}
+        mTotalSize(0) {}
 
 void BlobCache::set(const void* key, size_t keySize, const void* value, size_t valueSize) {
+    insert(key, keySize, value, valueSize, true);
+}
+
+void BlobCache::insert(const void* key, size_t keySize, const void* value, size_t valueSize,
+                       bool copyData) {
     if (mMaxKeySize < keySize) {
         ALOGV("set: not caching because the key is too large: %zu (limit: %zu)", keySize,
               mMaxKeySize);
@@ -78,15 +74,12 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
         return;
     }
 
-    std::shared_ptr<Blob> cacheKey(new Blob(key, keySize, false));
-    CacheEntry cacheEntry(cacheKey, nullptr);
-
     while (true) {
-        auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
-        if (index == mCacheEntries.end() || cacheEntry < *index) {
+        auto index = mIndex.find(KeyRef{key, keySize});
+        if (index == mIndex.end()) {
             // Create a new cache entry.
-            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, true));
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
+            std::shared_ptr<Blob> keyBlob(new Blob(key, keySize, copyData));
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
             size_t newTotalSize = mTotalSize + keySize + valueSize;
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -101,14 +94,16 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
                     break;
                 }
             }
-            mCacheEntries.insert(index, CacheEntry(keyBlob, valueBlob));
+            mCacheEntries.emplace_front(keyBlob, valueBlob);
+            mIndex.emplace(KeyRef{keyBlob->getData(), keySize}, mCacheEntries.begin());
             mTotalSize = newTotalSize;
             ALOGV("set: created new cache entry with %zu byte key and %zu byte value", keySize,
                   valueSize);
         } else {
             // Update the existing cache entry.
-            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, true));
-            std::shared_ptr<Blob> oldValueBlob(index->getValue());
+            CacheEntryList::iterator entry = index->second;
+            std::shared_ptr<Blob> valueBlob(new Blob(value, valueSize, copyData));
+            std::shared_ptr<Blob> oldValueBlob(entry->getValue());
             size_t newTotalSize = mTotalSize + valueSize - oldValueBlob->getSize();
             if (mMaxTotalSize < newTotalSize) {
                 if (isCleanable()) {
@@ -122,7 +117,8 @@ void BlobCache::set(const void* key, size_t keySize, const void* value, size_t v
                     break;
                 }
             }
-            index->setValue(valueBlob);
+            entry->setValue(valueBlob);
+            mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
             mTotalSize = newTotalSize;
             ALOGV("set: updated existing cache entry with %zu byte key and %zu byte "
                   "value",
@@ -138,17 +134,19 @@ size_t BlobCache::get(const void* key, size_t keySize, void* value, size_t value
               mMaxKeySize);
         return 0;
     }
-    std::shared_ptr<Blob> cacheKey(new Blob(key, keySize, false));
-    CacheEntry cacheEntry(cacheKey, nullptr);
-    auto index = std::lower_bound(mCacheEntries.begin(), mCacheEntries.end(), cacheEntry);
-    if (index == mCacheEntries.end() || cacheEntry < *index) {
+    auto index = mIndex.find(KeyRef{key, keySize});
+    if (index == mIndex.end()) {
         ALOGV("get: no cache entry found for key of size %zu", keySize);
+        mStats.mMisses++;
         return 0;
     }
+    mStats.mHits++;
 
-    // The key was found. Return the value if the caller's buffer is large
-    // enough.
-    std::shared_ptr<Blob> valueBlob(index->getValue());
+    // The key was found, so it becomes the most recently used one. Return the
+    // value if the caller's buffer is large enough.
+    CacheEntryList::iterator entry = index->second;
+    mCacheEntries.splice(mCacheEntries.begin(), mCacheEntries, entry);
+    std::shared_ptr<Blob> valueBlob(entry->getValue());
     size_t valueBlobSize = valueBlob->getSize();
     if (valueBlobSize <= valueSize) {
         ALOGV("get: copying %zu bytes to caller's buffer", valueBlobSize);
@@ -190,10 +188,12 @@ int BlobCache::flatten(void* buffer, size_t size) const {
     header->mBuildIdLength = buildId.size();
     memcpy(header->mBuildId, buildId.c_str(), header->mBuildIdLength);
 
-    // Write cache entries
+    // Write cache entries from the least recently used one, so that unflatten
+    // adds the most recently used one last and restores the eviction order.
     uint8_t* byteBuffer = reinterpret_cast<uint8_t*>(buffer);
     off_t byteOffset = align4(sizeof(Header) + header->mBuildIdLength);
-    for (const CacheEntry& e : mCacheEntries) {
+    for (auto it = mCacheEntries.rbegin(); it != mCacheEntries.rend(); ++it) {
+        const CacheEntry& e = *it;
         std::shared_ptr<Blob> const& keyBlob = e.getKey();
         std::shared_ptr<Blob> const& valueBlob = e.getValue();
         size_t keySize = keyBlob->getSize();
@@ -226,8 +226,16 @@ int BlobCache::flatten(void* buffer, size_t size) const {
 }
 
 int BlobCache::unflatten(void const* buffer, size_t size) {
+    return unflattenEntries(buffer, size, true);
+}
+
+int BlobCache::unflattenWithoutCopy(void const* buffer, size_t size) {
+    return unflattenEntries(buffer, size, false);
+}
+
+int BlobCache::unflattenEntries(void const* buffer, size_t size, bool copyData) {
     // All errors should result in the BlobCache being in an empty state.
-    mCacheEntries.clear();
+    clear();
 
     // Read the cache header
     if (size < sizeof(Header)) {
@@ -254,7 +262,7 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     size_t numEntries = header->mNumEntries;
     for (size_t i = 0; i < numEntries; i++) {
         if (byteOffset + sizeof(EntryHeader) > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
@@ -266,13 +274,13 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
 
         size_t totalSize = align4(entrySize);
         if (byteOffset + totalSize > size) {
-            mCacheEntries.clear();
+            clear();
             ALOGE("unflatten: not enough room for cache entry headers");
             return -EINVAL;
         }
 
         const uint8_t* data = eheader->mData;
-        set(data, keySize, data + keySize, valueSize);
+        insert(data, keySize, data + keySize, valueSize, copyData);
 
         byteOffset += totalSize;
     }
@@ -280,22 +288,22 @@ int BlobCache::unflatten(void const* buffer, size_t size) {
     return 0;
 }
 
-long int BlobCache::blob_random() {
-#ifdef _WIN32
-    return rand();
-#else
-    return nrand48(mRandState);
-#endif
+void BlobCache::clear() {
+    mIndex.clear();
+    mCacheEntries.clear();
+    mTotalSize = 0;
 }
 
 void BlobCache::clean() {
-    // Remove a random cache entry until the total cache size gets below half
-    // the maximum total cache size.
+    // Remove the least recently used cache entry until the total cache size
+    // gets below half the maximum total cache size.
     while (mTotalSize > mMaxTotalSize / 2) {
-        size_t i = size_t(blob_random() % (mCacheEntries.size()));
-        const CacheEntry& entry(mCacheEntries[i]);
-        mTotalSize -= entry.getKey()->getSize() + entry.getValue()->getSize();
-        mCacheEntries.erase(mCacheEntries.begin() + i);
+        const CacheEntry& entry(mCacheEntries.back());
+        std::shared_ptr<Blob> const& keyBlob = entry.getKey();
+        mTotalSize -= keyBlob->getSize() + entry.getValue()->getSize();
+        mIndex.erase(KeyRef{keyBlob->getData(), keyBlob->getSize()});
+        mCacheEntries.pop_back();
+        mStats.mEvictions++;
     }
 }
 
@@ -316,14 +324,6 @@ BlobCache::Blob::~Blob() {
     }
 }
 
-bool BlobCache::Blob::operator<(const Blob& rhs) const {
-    if (mSize == rhs.mSize) {
-        return memcmp(mData, rhs.mData, mSize) < 0;
-    } else {
-        return mSize < rhs.mSize;
-    }
-}
-
 const void* BlobCache::Blob::getData() const {
     return mData;
 }
@@ -340,10 +340,6 @@ BlobCache::CacheEntry::CacheEntry(const std::shared_ptr<Blob>& key,
 
 BlobCache::CacheEntry::CacheEntry(const CacheEntry& ce) : mKey(ce.mKey), mValue(ce.mValue) {}
 
-bool BlobCache::CacheEntry::operator<(const CacheEntry& rhs) const {
-    return *mKey < *rhs.mKey;
-}
-
 const BlobCache::CacheEntry& BlobCache::CacheEntry::operator=(const CacheEntry& rhs) {
     mKey = rhs.mKey;
     mValue = rhs.mValue;
@@ -362,4 +358,13 @@ void BlobCache::CacheEntry::setValue(const std::shared_ptr<Blob>& value) {
     mValue = value;
 }
 
+bool BlobCache::KeyRef::operator==(const KeyRef& rhs) const {
+    return mSize == rhs.mSize && memcmp(mData, rhs.mData, mSize) == 0;
+}
+
+size_t BlobCache::KeyRefHash::operator()(const KeyRef& key) const {
+    return std::hash<std::string_view>()(
+            std::string_view(reinterpret_cast<const char*>(key.mData), key.mSize));
+}
+
 } // namespace android
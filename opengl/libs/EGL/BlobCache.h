@@ -19,8 +19,9 @@
 
 #include <stddef.h>
 
+#include <list>
 #include <memory>
-#include <vector>
+#include <unordered_map>
 
 namespace android {
 
@@ -31,8 +32,24 @@ namespace android {
 // and then reloaded in a subsequent execution of the program.  This
 // serialization is non-portable and the data should only be used by the device
 // that generated it.
+//
+// When the cache fills up, the entries that were least recently set or
+// retrieved are evicted first.
 class BlobCache {
 public:
+    // Stats counts the lookups and evictions made since the cache was created.
+    struct Stats {
+        // mHits is the number of calls to get that found their key.
+        size_t mHits = 0;
+
+        // mMisses is the number of calls to get that did not find their key.
+        size_t mMisses = 0;
+
+        // mEvictions is the number of entries that were evicted to make room
+        // for new ones.
+        size_t mEvictions = 0;
+    };
+
     // Create an empty blob cache. The blob cache will cache key/value pairs
     // with key and value sizes less than or equal to maxKeySize and
     // maxValueSize, respectively. The total combined size of ALL cache entries
@@ -97,9 +114,18 @@ public:
 
     // clear flushes out all contents of the cache then the BlobCache, leaving
     // it in an empty state.
-    void clear() { mCacheEntries.clear(); }
+    void clear();
+
+    // getStats returns the lookup and eviction counts of the cache.
+    const Stats& getStats() const { return mStats; }
 
 protected:
+    // unflattenWithoutCopy behaves like unflatten, except that the cache
+    // entries refer to the keys and values in 'buffer' instead of copies of
+    // them.  The memory pointed to by 'buffer' must remain valid and unchanged
+    // for as long as the BlobCache object exists.
+    int unflattenWithoutCopy(void const* buffer, size_t size);
+
     // mMaxTotalSize is the maximum size that all cache entries can occupy. This
     // includes space for both keys and values. When a call to BlobCache::set
     // would otherwise cause this limit to be exceeded, either the key/value
@@ -112,10 +138,15 @@ private:
     BlobCache(const BlobCache&);
     void operator=(const BlobCache&);
 
-    // A random function helper to get around MinGW not having nrand48()
-    long int blob_random();
+    // insert implements set.  If copyData is false, the new cache entry refers
+    // to the key and value passed to it instead of copies of them.
+    void insert(const void* key, size_t keySize, const void* value, size_t valueSize,
+                bool copyData);
 
-    // clean evicts a randomly chosen set of entries from the cache such that
+    // unflattenEntries implements unflatten and unflattenWithoutCopy.
+    int unflattenEntries(void const* buffer, size_t size, bool copyData);
+
+    // clean evicts the least recently used entries from the cache such that
     // the total size of all remaining entries is less than mMaxTotalSize/2.
     void clean();
 
@@ -129,8 +160,6 @@ private:
         Blob(const void* data, size_t size, bool copyData);
         ~Blob();
 
-        bool operator<(const Blob& rhs) const;
-
         const void* getData() const;
         size_t getSize() const;
 
@@ -157,7 +186,6 @@ private:
         CacheEntry(const std::shared_ptr<Blob>& key, const std::shared_ptr<Blob>& value);
         CacheEntry(const CacheEntry& ce);
 
-        bool operator<(const CacheEntry& rhs) const;
         const CacheEntry& operator=(const CacheEntry&);
 
         std::shared_ptr<Blob> getKey() const;
@@ -173,6 +201,21 @@ private:
         std::shared_ptr<Blob> mValue;
     };
 
+    // A KeyRef refers to the data of a key without owning it, so that looking
+    // up a key doesn't require copying it.
+    struct KeyRef {
+        const void* mData;
+        size_t mSize;
+
+        bool operator==(const KeyRef& rhs) const;
+    };
+
+    struct KeyRefHash {
+        size_t operator()(const KeyRef& key) const;
+    };
+
+    using CacheEntryList = std::list<CacheEntry>;
+
     // A Header is the header for the entire BlobCache serialization format. No
     // need to make this portable, so we simply write the struct out.
     struct Header {
@@ -233,13 +276,19 @@ private:
     // the cache.
     size_t mTotalSize;
 
-    // mRandState is the pseudo-random number generator state. It is passed to
-    // nrand48 to generate random numbers when needed.
-    unsigned short mRandState[3];
+    // mCacheEntries stores all the cache entries that are resident in memory,
+    // from the most recently used one to the least recently used one. Cache
+    // entries are added to it by the 'set' method, and moved to its front
+    // whenever they are set or retrieved again.
+    CacheEntryList mCacheEntries;
+
+    // mIndex maps the key of each cache entry to its position in
+    // mCacheEntries. The keys refer to the data of the key blobs owned by the
+    // entries.
+    std::unordered_map<KeyRef, CacheEntryList::iterator, KeyRefHash> mIndex;
 
-    // mCacheEntries stores all the cache entries that are resident in memory.
-    // Cache entries are added to it by the 'set' method.
-    std::vector<CacheEntry> mCacheEntries;
+    // mStats counts the lookups and evictions made in the cache.
+    Stats mStats;
 };
 
 } // namespace android
@@ -261,6 +261,42 @@ TEST_F(BlobCacheTest, ExceedingTotalLimitHalvesCacheSize) {
     ASSERT_EQ(maxEntries / 2 + 1, numCached);
 }
 
+TEST_F(BlobCacheTest, ExceedingTotalLimitEvictsLeastRecentlyUsed) {
+    // Fill up the entire cache with 1 char key/value pairs.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // Use the oldest entry again, so that it becomes the most recently used.
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+    // Insert one more entry, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC->set(&k, 1, "x", 1);
+    }
+    // The entries that were used last are the ones that remain.
+    for (int i = 0; i < maxEntries + 1; i++) {
+        uint8_t k = i;
+        bool used = i == 0 || i == maxEntries || i >= maxEntries - maxEntries / 2 + 1;
+        ASSERT_EQ(used ? size_t(1) : size_t(0), mBC->get(&k, 1, nullptr, 0)) << "key " << i;
+    }
+}
+
+TEST_F(BlobCacheTest, StatsCountHitsMissesAndEvictions) {
+    mBC->set("abcd", 4, "efgh", 4);
+    ASSERT_EQ(size_t(4), mBC->get("abcd", 4, nullptr, 0));
+    ASSERT_EQ(size_t(0), mBC->get("ijkl", 4, nullptr, 0));
+    mBC->set("ijkl", 4, "mnop", 4);
+    const BlobCache::Stats& stats = mBC->getStats();
+    ASSERT_EQ(size_t(1), stats.mHits);
+    ASSERT_EQ(size_t(1), stats.mMisses);
+    ASSERT_EQ(size_t(1), stats.mEvictions);
+}
+
 class BlobCacheFlattenTest : public BlobCacheTest {
 protected:
     virtual void SetUp() {
@@ -314,6 +350,30 @@ TEST_F(BlobCacheFlattenTest, FlattenFullCache) {
     }
 }
 
+TEST_F(BlobCacheFlattenTest, FlattenKeepsEvictionOrder) {
+    // Fill up the entire cache with 1 char key/value pairs, and use the oldest
+    // entry again so that it becomes the most recently used.
+    const int maxEntries = MAX_TOTAL_SIZE / 2;
+    for (int i = 0; i < maxEntries; i++) {
+        uint8_t k = i;
+        mBC->set(&k, 1, "x", 1);
+    }
+    {
+        uint8_t k = 0;
+        ASSERT_EQ(size_t(1), mBC->get(&k, 1, nullptr, 0));
+    }
+    roundTrip();
+    // Insert one more entry in the unflattened cache, causing a cache overflow.
+    {
+        uint8_t k = maxEntries;
+        mBC2->set(&k, 1, "x", 1);
+    }
+    uint8_t k = 0;
+    ASSERT_EQ(size_t(1), mBC2->get(&k, 1, nullptr, 0));
+    k = 1;
+    ASSERT_EQ(size_t(0), mBC2->get(&k, 1, nullptr, 0));
+}
+
 TEST_F(BlobCacheFlattenTest, FlattenDoesntChangeCache) {
     // Fill up the entire cache with 1 char key/value pairs.
     const int maxEntries = MAX_TOTAL_SIZE / 2;
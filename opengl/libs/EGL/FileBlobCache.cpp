@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -72,6 +73,12 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
 
         // Check the size before trying to mmap it.
         size_t fileSize = statBuf.st_size;
+        if (fileSize < headerSize) {
+            ALOGE("cache file is too small: %#" PRIx64,
+                  static_cast<off64_t>(statBuf.st_size));
+            close(fd);
+            return;
+        }
         if (fileSize > mMaxTotalSize * 2) {
             ALOGE("cache file is too large: %#" PRIx64,
                   static_cast<off64_t>(statBuf.st_size));
@@ -92,17 +99,23 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
         size_t cacheSize = fileSize - headerSize;
         if (memcmp(buf, cacheFileMagic, 4) != 0) {
             ALOGE("cache file has bad mojo");
+            munmap(buf, fileSize);
             close(fd);
             return;
         }
         uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
         if (crc32c(buf + headerSize, cacheSize) != *crc) {
             ALOGE("cache file failed CRC check");
+            munmap(buf, fileSize);
             close(fd);
             return;
         }
 
-        int err = unflatten(buf + headerSize, cacheSize);
+        // The entries refer to the mapping, so that their keys and values
+        // aren't copied to the heap.  The file is never modified in place, a
+        // new one replaces it when the cache is saved, so the mapping stays
+        // valid.
+        int err = unflattenWithoutCopy(buf + headerSize, cacheSize);
         if (err < 0) {
             ALOGE("error reading cache contents: %s (%d)", strerror(-err),
                     -err);
@@ -111,77 +124,101 @@ FileBlobCache::FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxT
             return;
         }
 
-        munmap(buf, fileSize);
+        mMappedFile = buf;
+        mMappedSize = fileSize;
         close(fd);
     }
 }
 
+FileBlobCache::~FileBlobCache() {
+    // Drop the entries that refer to the mapping before unmapping it.
+    clear();
+    if (mMappedFile != nullptr) {
+        munmap(mMappedFile, mMappedSize);
+    }
+}
+
 void FileBlobCache::writeToFile() {
-    if (mFilename.length() > 0) {
-        size_t cacheSize = getFlattenedSize();
-        size_t headerSize = cacheFileHeaderSize;
-        const char* fname = mFilename.c_str();
+    writeBufferToFile(mFilename, flattenToBuffer());
+}
 
-        // Try to create the file with no permissions so we can write it
-        // without anyone trying to read it.
-        int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-        if (fd == -1) {
-            if (errno == EEXIST) {
-                // The file exists, delete it and try again.
-                if (unlink(fname) == -1) {
-                    // No point in retrying if the unlink failed.
-                    ALOGE("error unlinking cache file %s: %s (%d)", fname,
-                            strerror(errno), errno);
-                    return;
-                }
-                // Retry now that we've unlinked the file.
-                fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
-            }
-            if (fd == -1) {
-                ALOGE("error creating cache file %s: %s (%d)", fname,
+std::vector<uint8_t> FileBlobCache::flattenToBuffer() const {
+    if (mFilename.length() == 0) {
+        return {};
+    }
+
+    size_t cacheSize = getFlattenedSize();
+    size_t headerSize = cacheFileHeaderSize;
+    std::vector<uint8_t> buffer(headerSize + cacheSize);
+
+    int err = flatten(buffer.data() + headerSize, cacheSize);
+    if (err < 0) {
+        ALOGE("error writing cache contents: %s (%d)", strerror(-err),
+                -err);
+        return {};
+    }
+
+    // Write the file magic, the CRC is left to writeBufferToFile
+    memcpy(buffer.data(), cacheFileMagic, 4);
+    return buffer;
+}
+
+void FileBlobCache::writeBufferToFile(const std::string& filename, std::vector<uint8_t> buffer) {
+    if (filename.length() == 0 || buffer.empty()) {
+        return;
+    }
+
+    size_t headerSize = cacheFileHeaderSize;
+    size_t fileSize = buffer.size();
+    uint8_t* buf = buffer.data();
+
+    // Write the CRC
+    uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
+    *crc = crc32c(buf + headerSize, fileSize - headerSize);
+
+    // The contents are written to a temporary file that then replaces the
+    // cache file, so that the cache file is never seen partially written and
+    // the mappings of the previous one stay valid.
+    std::string tempFilename = filename + ".tmp";
+    const char* fname = tempFilename.c_str();
+
+    // Try to create the file with no permissions so we can write it
+    // without anyone trying to read it.
+    int fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
+    if (fd == -1) {
+        if (errno == EEXIST) {
+            // The file exists, delete it and try again.
+            if (unlink(fname) == -1) {
+                // No point in retrying if the unlink failed.
+                ALOGE("error unlinking cache file %s: %s (%d)", fname,
                         strerror(errno), errno);
                 return;
             }
+            // Retry now that we've unlinked the file.
+            fd = open(fname, O_CREAT | O_EXCL | O_RDWR, 0);
         }
-
-        size_t fileSize = headerSize + cacheSize;
-
-        uint8_t* buf = new uint8_t [fileSize];
-        if (!buf) {
-            ALOGE("error allocating buffer for cache contents: %s (%d)",
+        if (fd == -1) {
+            ALOGE("error creating cache file %s: %s (%d)", fname,
                     strerror(errno), errno);
-            close(fd);
-            unlink(fname);
-            return;
-        }
-
-        int err = flatten(buf + headerSize, cacheSize);
-        if (err < 0) {
-            ALOGE("error writing cache contents: %s (%d)", strerror(-err),
-                    -err);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
             return;
         }
+    }
 
-        // Write the file magic and CRC
-        memcpy(buf, cacheFileMagic, 4);
-        uint32_t* crc = reinterpret_cast<uint32_t*>(buf + 4);
-        *crc = crc32c(buf + headerSize, cacheSize);
+    if (write(fd, buf, fileSize) != static_cast<ssize_t>(fileSize)) {
+        ALOGE("error writing cache file: %s (%d)", strerror(errno),
+                errno);
+        close(fd);
+        unlink(fname);
+        return;
+    }
 
-        if (write(fd, buf, fileSize) == -1) {
-            ALOGE("error writing cache file: %s (%d)", strerror(errno),
-                    errno);
-            delete [] buf;
-            close(fd);
-            unlink(fname);
-            return;
-        }
+    fchmod(fd, S_IRUSR);
+    close(fd);
 
-        delete [] buf;
-        fchmod(fd, S_IRUSR);
-        close(fd);
+    if (rename(fname, filename.c_str()) == -1) {
+        ALOGE("error renaming cache file %s: %s (%d)", fname,
+                strerror(errno), errno);
+        unlink(fname);
     }
 }
 
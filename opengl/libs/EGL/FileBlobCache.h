@@ -19,23 +19,45 @@
 
 #include "BlobCache.h"
 #include <string>
+#include <vector>
 
 namespace android {
 
 class FileBlobCache : public BlobCache {
 public:
     // FileBlobCache attempts to load the saved cache contents from disk into
-    // BlobCache.
+    // BlobCache.  The file stays mapped for as long as the FileBlobCache
+    // exists, and the loaded entries refer to the mapping rather than to
+    // copies of it.
     FileBlobCache(size_t maxKeySize, size_t maxValueSize, size_t maxTotalSize,
             const std::string& filename);
+    ~FileBlobCache();
 
     // writeToFile attempts to save the current contents of BlobCache to
     // disk.
     void writeToFile();
 
+    // flattenToBuffer returns the current contents of BlobCache in the format
+    // of the cache file, to be passed to writeBufferToFile.  It returns an
+    // empty buffer if there is no file to save to or if an error occurs.
+    std::vector<uint8_t> flattenToBuffer() const;
+
+    // writeBufferToFile computes the CRC of a buffer returned by
+    // flattenToBuffer and saves it to the given file.  It doesn't use any
+    // FileBlobCache, so the cache may be used while the file is written.  The
+    // file is replaced atomically.
+    static void writeBufferToFile(const std::string& filename, std::vector<uint8_t> buffer);
+
+    const std::string& getFilename() const { return mFilename; }
+
 private:
     // mFilename is the name of the file for storing cache contents.
     std::string mFilename;
+
+    // mMappedFile is the mapping of the cache file that the loaded entries
+    // refer to, or nullptr if nothing was loaded.  mMappedSize is its size.
+    void* mMappedFile = nullptr;
+    size_t mMappedSize = 0;
 };
 
 } // namespace android
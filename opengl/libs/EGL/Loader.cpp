@@ -382,6 +382,24 @@ void Loader::init_api(void* dso,
     }
 }
 
+// Fills the entry-points of api, which lists a subset of ref_api in the same order, from the
+// ones that init_api already resolved for ref_api in the same driver library. The result is the
+// one init_api would give, without looking every entry-point up again.
+static void copy_api(char const* const* api, char const* const* ref_api,
+                     const __eglMustCastToProperFunctionPointerType* ref,
+                     __eglMustCastToProperFunctionPointerType* curr) {
+    while (*api) {
+        if (std::strcmp(*api, *ref_api) == 0) {
+            *curr++ = *ref;
+            api++;
+        } else {
+            *curr++ = nullptr;
+        }
+        ref++;
+        ref_api++;
+    }
+}
+
 static void* load_system_driver(const char* kind, const char* suffix, const bool exact) {
     ATRACE_CALL();
     class MatchFile {
@@ -651,18 +669,25 @@ void Loader::initialize_api(void* dso, egl_connection_t* cnx, uint32_t mask) {
         }
     }
 
-    if (mask & GLESv1_CM) {
-        init_api(dso, gl_names_1, gl_names,
-            (__eglMustCastToProperFunctionPointerType*)
-                &cnx->hooks[egl_connection_t::GLESv1_INDEX]->gl,
-            getProcAddress);
-    }
+    gl_hooks_t* hooks1 = cnx->hooks[egl_connection_t::GLESv1_INDEX];
+    gl_hooks_t* hooks2 = cnx->hooks[egl_connection_t::GLESv2_INDEX];
+    __eglMustCastToProperFunctionPointerType* gles1 =
+            (__eglMustCastToProperFunctionPointerType*)&hooks1->gl;
+    __eglMustCastToProperFunctionPointerType* gles2 =
+            (__eglMustCastToProperFunctionPointerType*)&hooks2->gl;
 
     if (mask & GLESv2) {
-        init_api(dso, gl_names, nullptr,
-            (__eglMustCastToProperFunctionPointerType*)
-                &cnx->hooks[egl_connection_t::GLESv2_INDEX]->gl,
-            getProcAddress);
+        init_api(dso, gl_names, nullptr, gles2, getProcAddress);
+    }
+
+    if (mask & GLESv1_CM) {
+        if (mask & GLESv2) {
+            // Both APIs come from the same library, and the GLESv1 entry-points are all GLESv2
+            // ones, so they are resolved already.
+            copy_api(gl_names_1, gl_names, gles2, gles1);
+        } else {
+            init_api(dso, gl_names_1, gl_names, gles1, getProcAddress);
+        }
     }
 }
 
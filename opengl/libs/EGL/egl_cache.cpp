@@ -58,7 +58,7 @@ static EGLsizeiANDROID getBlob(const void* key, EGLsizeiANDROID keySize, void* v
 //
 // egl_cache_t definition
 //
-egl_cache_t::egl_cache_t() : mInitialized(false) {}
+egl_cache_t::egl_cache_t() : mInitialized(false), mSavePending(false), mUnsavedChanges(false) {}
 
 egl_cache_t::~egl_cache_t() {}
 
@@ -105,9 +105,12 @@ void egl_cache_t::initialize(egl_display_t* display) {
 }
 
 void egl_cache_t::terminate() {
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (mBlobCache) {
-        mBlobCache->writeToFile();
+    std::unique_lock<std::mutex> lock(mMutex);
+    // Entries may be set while the file is written, so save until there are
+    // none left to save.
+    while (mBlobCache && mUnsavedChanges) {
+        saveLocked(lock);
+        lock.lock();
     }
     mBlobCache = nullptr;
 }
@@ -124,16 +127,17 @@ void egl_cache_t::setBlob(const void* key, EGLsizeiANDROID keySize, const void*
     if (mInitialized) {
         BlobCache* bc = getBlobCacheLocked();
         bc->set(key, keySize, value, valueSize);
+        mUnsavedChanges = true;
 
         if (!mSavePending) {
             mSavePending = true;
             std::thread deferredSaveThread([this]() {
                 sleep(deferredSaveDelay);
-                std::lock_guard<std::mutex> lock(mMutex);
-                if (mInitialized && mBlobCache) {
-                    mBlobCache->writeToFile();
-                }
+                std::unique_lock<std::mutex> lock(mMutex);
                 mSavePending = false;
+                if (mInitialized && mBlobCache && mUnsavedChanges) {
+                    saveLocked(lock);
+                }
             });
             deferredSaveThread.detach();
         }
@@ -168,4 +172,18 @@ BlobCache* egl_cache_t::getBlobCacheLocked() {
     return mBlobCache.get();
 }
 
+void egl_cache_t::saveLocked(std::unique_lock<std::mutex>& lock) {
+    std::vector<uint8_t> buffer = mBlobCache->flattenToBuffer();
+    std::string filename = mBlobCache->getFilename();
+    mUnsavedChanges = false;
+
+    // Computing the CRC and writing the file don't use the cache, so mMutex is
+    // released meanwhile and the driver can keep getting and setting blobs.
+    // mWriteMutex is taken first so that saves are written in the order they
+    // were flattened in.
+    std::lock_guard<std::mutex> writeLock(mWriteMutex);
+    lock.unlock();
+    FileBlobCache::writeBufferToFile(filename, std::move(buffer));
+}
+
 }; // namespace android
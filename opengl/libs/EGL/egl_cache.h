@@ -79,6 +79,10 @@ private:
     // possible.
     BlobCache* getBlobCacheLocked();
 
+    // saveLocked writes the contents of mBlobCache to its file.  It must be
+    // called with mMutex held by lock, and returns with it released.
+    void saveLocked(std::unique_lock<std::mutex>& lock);
+
     // mInitialized indicates whether the egl_cache_t is in the initialized
     // state.  It is initialized to false at construction time, and gets set to
     // true when initialize is called.  It is set back to false when terminate
@@ -106,6 +110,15 @@ private:
     // contents to disk.
     bool mSavePending;
 
+    // mUnsavedChanges indicates whether or not key/value pairs were inserted
+    // into the cache since its contents were last saved to disk.
+    bool mUnsavedChanges;
+
+    // mWriteMutex serializes the writes of the cache file, which are made
+    // without holding mMutex.  It is locked while mMutex is held, which is
+    // then released for the duration of the write.
+    std::mutex mWriteMutex;
+
     // mMutex is the mutex used to prevent concurrent access to the member
     // variables. It must be locked whenever the member variables are accessed.
     mutable std::mutex mMutex;
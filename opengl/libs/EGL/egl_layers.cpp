@@ -65,9 +65,6 @@ typedef struct FunctionTable {
 std::unordered_map<std::string, int> func_indices;
 // func_indices.reserve(kFuncCount);
 
-std::unordered_map<int, std::string> func_names;
-// func_names.reserve(kFuncCount);
-
 std::vector<FunctionTable> layer_functions;
 
 const void* getNextLayerProcAddress(void* layer_id, const char* name) {
@@ -78,13 +75,15 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
 
     ALOGV("getNextLayerProcAddress servicing %s", name);
 
-    if (func_indices.find(name) == func_indices.end()) {
+    // Layers call this for every function they intercept, so look the name up only once
+    auto entry = func_indices.find(name);
+    if (entry == func_indices.end()) {
         // No entry for this function - it is an extension
         // call down the GPA chain directly to the impl
         ALOGV("getNextLayerProcAddress - name(%s) no func_indices entry found", name);
 
-        // Look up which GPA we should use
-        int gpaIndex = func_indices["eglGetProcAddress"];
+        // Look up which GPA we should use, its index doesn't change once the maps are set up
+        static const int gpaIndex = func_indices["eglGetProcAddress"];
         ALOGV("getNextLayerProcAddress - name(%s) gpaIndex(%i) <- using GPA from this index", name,
               gpaIndex);
         EGLFuncPointer gpaNext = (*next_layer_funcs)[gpaIndex];
@@ -107,7 +106,7 @@ const void* getNextLayerProcAddress(void* layer_id, const char* name) {
         return reinterpret_cast<void*>(val);
     }
 
-    int index = func_indices[name];
+    int index = entry->second;
     val = (*next_layer_funcs)[index];
     ALOGV("getNextLayerProcAddress - name(%s) index(%i) entry(%llu) - Got a hit, returning known "
           "entry",
@@ -122,12 +121,10 @@ void SetupFuncMaps(FunctionTable& functions, char const* const* entries, EGLFunc
 
         // Some names overlap, only fill with initial entry
         // This does mean that some indices will not be used
-        if (func_indices.find(name) == func_indices.end()) {
+        if (func_indices.emplace(name, func_idx).second) {
             ALOGV("SetupFuncMaps - name(%s), func_idx(%i), No entry for func_indices, assigning "
                   "now",
                   name, func_idx);
-            func_names[func_idx] = name;
-            func_indices[name] = func_idx;
         } else {
             ALOGV("SetupFuncMaps - name(%s), func_idx(%i), Found entry for func_indices", name,
                   func_idx);
@@ -212,6 +209,11 @@ EGLFuncPointer LayerLoader::ApplyLayers(const char* name, EGLFuncPointer next) {
     return val;
 }
 
+unsigned LayerLoader::AppliedLayerCount() const {
+    if (!layers_loaded_ || layer_setup_.empty()) return 0;
+    return current_layer_;
+}
+
 void LayerLoader::LayerPlatformEntries(layer_setup_func layer_setup, EGLFuncPointer* curr,
                                        char const* const* entries) {
     while (*entries) {
@@ -54,6 +54,9 @@ public:
     EGLFuncPointer ApplyLayer(layer_setup_func layer_setup, const char* name, EGLFuncPointer next);
     EGLFuncPointer ApplyLayers(const char* name, EGLFuncPointer next);
 
+    // Number of layers that ApplyLayers currently applies.
+    unsigned AppliedLayerCount() const;
+
     std::vector<layer_init_func> layer_init_;
     std::vector<layer_setup_func> layer_setup_;
 
@@ -217,6 +217,8 @@ static const extension_map_t sExtensionMap[] = {
 // accesses protected by sExtensionMapMutex
 static std::unordered_map<std::string, __eglMustCastToProperFunctionPointerType> sGLExtensionMap;
 static std::unordered_map<std::string, int> sGLExtensionSlotMap;
+// Number of layers applied to the entry point in each extension slot
+static unsigned sGLExtensionLayerCount[MAX_NUMBER_OF_GL_EXTENSIONS];
 
 static int sGLExtensionSlot = 0;
 static pthread_mutex_t sExtensionMapMutex = PTHREAD_MUTEX_INITIALIZER;
@@ -1193,6 +1195,7 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char* procn
                     // Track the top most entry point return the extension forwarder
                     cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[slot] =
                             cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[slot] = addr;
+                    sGLExtensionLayerCount[slot] = layer_loader.AppliedLayerCount();
                     addr = gExtensionForwarders[slot];
 
                     // Remember the slot for this extension
@@ -1218,13 +1221,21 @@ __eglMustCastToProperFunctionPointerType eglGetProcAddressImpl(const char* procn
             return nullptr;
         }
 
-        // We tracked the bottom of the stack, so re-apply layers since
-        // more layers might have been enabled
-        addr = layer_loader.ApplyLayers(procname, addr);
+        // We tracked the bottom of the stack, so re-apply layers if more
+        // layers have been enabled since. Otherwise the slot already holds
+        // the top most entry point, and asking every layer for it again on
+        // each lookup would be wasted.
+        const unsigned layerCount = layer_loader.AppliedLayerCount();
+        if (layerCount != sGLExtensionLayerCount[ext_slot]) {
+            addr = layer_loader.ApplyLayers(procname, addr);
+
+            // Track the top most entry point
+            cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[ext_slot] =
+                    cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[ext_slot] = addr;
+            sGLExtensionLayerCount[ext_slot] = layerCount;
+        }
 
-        // Track the top most entry point and return the extension forwarder
-        cnx->hooks[egl_connection_t::GLESv1_INDEX]->ext.extensions[ext_slot] =
-                cnx->hooks[egl_connection_t::GLESv2_INDEX]->ext.extensions[ext_slot] = addr;
+        // Return the extension forwarder
         addr = gExtensionForwarders[ext_slot];
     }
 
@@ -24,6 +24,8 @@
 #include <libbpf.h>
 #include <libbpf_android.h>
 #include <log/log.h>
+#include <string.h>
+#include <sys/syscall.h>
 #include <unistd.h>
 #include <utils/Timers.h>
 #include <utils/Trace.h>
@@ -81,6 +83,61 @@ void GpuMem::setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map) {
     mGpuMemTotalMap = std::move(map);
 }
 
+static int lookupMapBatch(int mapFd, const uint64_t* inBatch, uint64_t* outBatch, uint64_t* keys,
+                          uint64_t* values, uint32_t* count) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.batch.in_batch = reinterpret_cast<uintptr_t>(inBatch);
+    attr.batch.out_batch = reinterpret_cast<uintptr_t>(outBatch);
+    attr.batch.keys = reinterpret_cast<uintptr_t>(keys);
+    attr.batch.values = reinterpret_cast<uintptr_t>(values);
+    attr.batch.count = *count;
+    attr.batch.map_fd = mapFd;
+    int ret = syscall(__NR_bpf, BPF_MAP_LOOKUP_BATCH, &attr, sizeof(attr));
+    *count = attr.batch.count;
+    return ret;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> GpuMem::readGpuMemTotals() {
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+
+    // BPF_MAP_LOOKUP_BATCH, from kernel 5.6 on, reads many entries with a single system call.
+    uint64_t keys[kMapBatchSize];
+    uint64_t values[kMapBatchSize];
+    uint64_t inBatch, outBatch;
+    bool first = true;
+    while (true) {
+        uint32_t count = kMapBatchSize;
+        int ret = lookupMapBatch(mGpuMemTotalMap.getMap().get(), first ? nullptr : &inBatch,
+                                 &outBatch, keys, values, &count);
+        int savedErrno = errno;
+        if (ret && savedErrno != ENOENT) break;
+        for (uint32_t i = 0; i < count; i++) {
+            entries.emplace_back(keys[i], values[i]);
+        }
+        // ENOENT means that the last entries were read.
+        if (ret) return entries;
+        inBatch = outBatch;
+        first = false;
+    }
+
+    // Otherwise each entry takes two system calls.
+    entries.clear();
+    auto res = mGpuMemTotalMap.getFirstKey();
+    if (!res.ok()) return entries;
+    uint64_t key = res.value();
+    while (true) {
+        auto value = mGpuMemTotalMap.readValue(key);
+        if (!value.ok()) break;
+        entries.emplace_back(key, value.value());
+
+        res = mGpuMemTotalMap.getNextKey(key);
+        if (!res.ok()) break;
+        key = res.value();
+    }
+    return entries;
+}
+
 // Dump the snapshots of global and per process memory usage on all gpus
 void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
     ATRACE_CALL();
@@ -90,27 +147,17 @@ void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
         return;
     }
 
-    auto res = mGpuMemTotalMap.getFirstKey();
-    if (!res.ok()) {
+    const auto entries = readGpuMemTotals();
+    if (entries.empty()) {
         result->append("GPU memory total usage map is empty\n");
         return;
     }
-    uint64_t key = res.value();
     // unordered_map<gpu_id, vector<pair<pid, size>>>
     std::unordered_map<uint32_t, std::vector<std::pair<uint32_t, uint64_t>>> dumpMap;
-    while (true) {
+    for (const auto& [key, size] : entries) {
         uint32_t gpu_id = key >> 32;
         uint32_t pid = key;
-
-        res = mGpuMemTotalMap.readValue(key);
-        if (!res.ok()) break;
-        uint64_t size = res.value();
-
         dumpMap[gpu_id].emplace_back(pid, size);
-
-        res = mGpuMemTotalMap.getNextKey(key);
-        if (!res.ok()) break;
-        key = res.value();
     }
 
     for (auto& gpu : dumpMap) {
@@ -136,21 +183,13 @@ void GpuMem::dump(const Vector<String16>& /* args */, std::string* result) {
 
 void GpuMem::traverseGpuMemTotals(const std::function<void(int64_t ts, uint32_t gpuId, uint32_t pid,
                                                            uint64_t size)>& callback) {
-    auto res = mGpuMemTotalMap.getFirstKey();
-    if (!res.ok()) return;
-    uint64_t key = res.value();
-    while (true) {
+    // All the entries are read at once, so they share the timestamp of the snapshot.
+    const auto entries = readGpuMemTotals();
+    const int64_t ts = systemTime();
+    for (const auto& [key, size] : entries) {
         uint32_t gpu_id = key >> 32;
         uint32_t pid = key;
-
-        res = mGpuMemTotalMap.readValue(key);
-        if (!res.ok()) break;
-        uint64_t size = res.value();
-
-        callback(systemTime(), gpu_id, pid, size);
-        res = mGpuMemTotalMap.getNextKey(key);
-        if (!res.ok()) break;
-        key = res.value();
+        callback(ts, gpu_id, pid, size);
     }
 }
 
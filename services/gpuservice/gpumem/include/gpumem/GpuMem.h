@@ -21,6 +21,8 @@
 #include <utils/Vector.h>
 
 #include <functional>
+#include <utility>
+#include <vector>
 
 namespace android {
 
@@ -45,6 +47,8 @@ private:
 
     // set gpu memory total map
     void setGpuMemTotalMap(bpf::BpfMap<uint64_t, uint64_t>& map);
+    // read all the {key, size} entries of the gpu memory total map
+    std::vector<std::pair<uint64_t, uint64_t>> readGpuMemTotals();
 
     // indicate whether ebpf has been initialized
     std::atomic<bool> mInitialized = false;
@@ -62,6 +66,8 @@ private:
     static constexpr char kGpuMemTotalMapPath[] = "/sys/fs/bpf/map_gpu_mem_gpu_mem_total_map";
     // 30 seconds timeout for trying to attach bpf program to tracepoint
     static constexpr int kGpuWaitTimeout = 30;
+    // number of map entries read by each BPF_MAP_LOOKUP_BATCH command
+    static constexpr uint32_t kMapBatchSize = 128;
 };
 
 } // namespace android
@@ -91,8 +91,6 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
                                  bool isDriverLoaded, int64_t driverLoadingTime) {
     ATRACE_CALL();
 
-    std::lock_guard<std::mutex> lock(mLock);
-    registerStatsdCallbacksIfNeeded();
     ALOGV("Received:\n"
           "\tdriverPackageName[%s]\n"
           "\tdriverVersionName[%s]\n"
@@ -107,35 +105,37 @@ void GpuStats::insertDriverStats(const std::string& driverPackageName,
           appPackageName.c_str(), vulkanVersion, static_cast<int32_t>(driver), isDriverLoaded,
           driverLoadingTime);
 
-    if (!mGlobalStats.count(driverVersionCode)) {
-        GpuStatsGlobalInfo globalInfo;
-        addLoadingCount(driver, isDriverLoaded, &globalInfo);
+    // Everything that doesn't need the maps is done before taking mLock, as every app launch
+    // using the GPU goes through here. Each map is then only looked up once.
+    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
+
+    std::lock_guard<std::mutex> lock(mLock);
+    registerStatsdCallbacksIfNeeded();
+
+    auto [globalIt, globalInserted] = mGlobalStats.try_emplace(driverVersionCode);
+    GpuStatsGlobalInfo& globalInfo = globalIt->second;
+    if (globalInserted) {
         globalInfo.driverPackageName = driverPackageName;
         globalInfo.driverVersionName = driverVersionName;
         globalInfo.driverVersionCode = driverVersionCode;
         globalInfo.driverBuildTime = driverBuildTime;
         globalInfo.vulkanVersion = vulkanVersion;
-        mGlobalStats.insert({driverVersionCode, globalInfo});
-    } else {
-        addLoadingCount(driver, isDriverLoaded, &mGlobalStats[driverVersionCode]);
     }
+    addLoadingCount(driver, isDriverLoaded, &globalInfo);
 
-    const std::string appStatsKey = appPackageName + std::to_string(driverVersionCode);
-    if (!mAppStats.count(appStatsKey)) {
+    auto appIt = mAppStats.find(appStatsKey);
+    if (appIt == mAppStats.end()) {
         if (mAppStats.size() >= MAX_NUM_APP_RECORDS) {
             ALOGV("GpuStatsAppInfo has reached maximum size. Ignore new stats.");
             return;
         }
 
-        GpuStatsAppInfo appInfo;
-        addLoadingTime(driver, driverLoadingTime, &appInfo);
-        appInfo.appPackageName = appPackageName;
-        appInfo.driverVersionCode = driverVersionCode;
-        mAppStats.insert({appStatsKey, appInfo});
-        return;
+        appIt = mAppStats.emplace(appStatsKey, GpuStatsAppInfo()).first;
+        appIt->second.appPackageName = appPackageName;
+        appIt->second.driverVersionCode = driverVersionCode;
     }
 
-    addLoadingTime(driver, driverLoadingTime, &mAppStats[appStatsKey]);
+    addLoadingTime(driver, driverLoadingTime, &appIt->second);
 }
 
 void GpuStats::insertTargetStats(const std::string& appPackageName,
@@ -147,19 +147,20 @@ void GpuStats::insertTargetStats(const std::string& appPackageName,
 
     std::lock_guard<std::mutex> lock(mLock);
     registerStatsdCallbacksIfNeeded();
-    if (!mAppStats.count(appStatsKey)) {
+    auto appIt = mAppStats.find(appStatsKey);
+    if (appIt == mAppStats.end()) {
         return;
     }
 
     switch (stats) {
         case GpuStatsInfo::Stats::CPU_VULKAN_IN_USE:
-            mAppStats[appStatsKey].cpuVulkanInUse = true;
+            appIt->second.cpuVulkanInUse = true;
             break;
         case GpuStatsInfo::Stats::FALSE_PREROTATION:
-            mAppStats[appStatsKey].falsePrerotation = true;
+            appIt->second.falsePrerotation = true;
             break;
         case GpuStatsInfo::Stats::GLES_1_IN_USE:
-            mAppStats[appStatsKey].gles1InUse = true;
+            appIt->second.gles1InUse = true;
             break;
         default:
             break;
@@ -25,6 +25,7 @@
 #include <unistd.h>
 
 #include <thread>
+#include <vector>
 
 PERFETTO_DEFINE_DATA_SOURCE_STATIC_MEMBERS(android::GpuMemTracer::GpuMemDataSource);
 
@@ -107,20 +108,32 @@ void GpuMemTracer::traceInitialCounters() {
         ALOGE("Cannot trace without GpuMem initialization");
         return;
     }
-    mGpuMem->traverseGpuMemTotals([](int64_t ts, uint32_t gpuId, uint32_t pid, uint64_t size) {
-        GpuMemDataSource::Trace([&](GpuMemDataSource::TraceContext ctx) {
+    struct GpuMemTotal {
+        int64_t ts;
+        uint32_t gpuId;
+        uint32_t pid;
+        uint64_t size;
+    };
+    std::vector<GpuMemTotal> totals;
+    mGpuMem->traverseGpuMemTotals([&](int64_t ts, uint32_t gpuId, uint32_t pid, uint64_t size) {
+        totals.push_back({ts, gpuId, pid, size});
+    });
+    // Write all the packets from a single trace context rather than looking up the data source
+    // instances for each of them.
+    GpuMemDataSource::Trace([&](GpuMemDataSource::TraceContext ctx) {
+        for (const GpuMemTotal& total : totals) {
             auto packet = ctx.NewTracePacket();
             packet->set_timestamp_clock_id(perfetto::protos::pbzero::BUILTIN_CLOCK_MONOTONIC);
-            packet->set_timestamp(ts);
+            packet->set_timestamp(total.ts);
             auto* event = packet->set_gpu_mem_total_event();
-            event->set_gpu_id(gpuId);
-            event->set_pid(pid);
-            event->set_size(size);
-        });
+            event->set_gpu_id(total.gpuId);
+            event->set_pid(total.pid);
+            event->set_size(total.size);
+        }
+        // Flush the TraceContext. The last packet in the above loop will go
+        // missing without this flush.
+        ctx.Flush();
     });
-    // Flush the TraceContext. The last packet in the above loop will go
-    // missing without this flush.
-    GpuMemDataSource::Trace([](GpuMemDataSource::TraceContext ctx) { ctx.Flush(); });
 }
 
 } // namespace android
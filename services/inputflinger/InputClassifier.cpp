@@ -179,7 +179,9 @@ void MotionClassifier::processEvents() {
                 NotifyMotionArgs* motionArgs = static_cast<NotifyMotionArgs*>(event.args.get());
                 common::V1_0::MotionEvent motionEvent =
                         notifyMotionArgsToHalMotionEvent(*motionArgs);
+                const nsecs_t classifyStartTime = systemTime(SYSTEM_TIME_MONOTONIC);
                 Return<common::V1_0::Classification> response = mService->classify(motionEvent);
+                recordClassifyLatency(systemTime(SYSTEM_TIME_MONOTONIC) - classifyStartTime);
                 halResponseOk = response.isOk();
                 if (halResponseOk) {
                     common::V1_0::Classification halClassification = response;
@@ -268,6 +270,12 @@ void MotionClassifier::clearDeviceState(int32_t deviceId) {
     mLastDownTimes.erase(deviceId);
 }
 
+void MotionClassifier::recordClassifyLatency(nsecs_t latency) {
+    std::scoped_lock lock(mLock);
+    mClassifyLatencies[mClassifyCount % CLASSIFY_LATENCY_SAMPLES] = latency;
+    mClassifyCount++;
+}
+
 MotionClassification MotionClassifier::classify(const NotifyMotionArgs& args) {
     if ((args.action & AMOTION_EVENT_ACTION_MASK) == AMOTION_EVENT_ACTION_DOWN) {
         updateLastDownTime(args.deviceId, args.downTime);
@@ -297,7 +305,7 @@ void MotionClassifier::reset(const NotifyDeviceResetArgs& args) {
     enqueueEvent(std::make_unique<NotifyDeviceResetArgs>(args));
 }
 
-const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
+const char* MotionClassifier::getServiceStatus() {
     if (!mService) {
         return "null";
     }
@@ -308,10 +316,25 @@ const char* MotionClassifier::getServiceStatus() REQUIRES(mLock) {
 }
 
 void MotionClassifier::dump(std::string& dump) {
-    std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mService status: %s\n", getServiceStatus());
+    std::scoped_lock lock(mLock);
     dump += StringPrintf(INDENT2 "mEvents: %zu element(s) (max=%zu)\n",
             mEvents.size(), MAX_EVENTS);
+    const size_t latencyCount = std::min(mClassifyCount, CLASSIFY_LATENCY_SAMPLES);
+    if (latencyCount > 0) {
+        std::array<nsecs_t, CLASSIFY_LATENCY_SAMPLES> latencies = mClassifyLatencies;
+        std::sort(latencies.begin(), latencies.begin() + latencyCount);
+        auto percentile = [&](size_t percent) {
+            return nanoseconds_to_microseconds(latencies[(latencyCount - 1) * percent / 100]) /
+                    1000.0;
+        };
+        dump += StringPrintf(INDENT2 "HAL classify latency of the last %zu of %zu calls: "
+                                     "p50=%.1fms, p90=%.1fms, p99=%.1fms, max=%.1fms\n",
+                             latencyCount, mClassifyCount, percentile(50), percentile(90),
+                             percentile(99), percentile(100));
+    } else {
+        dump += INDENT2 "HAL classify latency: no calls yet\n";
+    }
     dump += INDENT2 "mClassifications, mLastDownTimes:\n";
     dump += INDENT3 "Device Id\tClassification\tLast down time";
     // Combine mClassifications and mLastDownTimes into a single table.
@@ -378,16 +401,28 @@ void InputClassifier::notifyKey(const NotifyKeyArgs* args) {
 }
 
 void InputClassifier::notifyMotion(const NotifyMotionArgs* args) {
-    std::scoped_lock lock(mLock);
     // MotionClassifier is only used for touch events, for now
-    const bool sendToMotionClassifier = mMotionClassifier && isTouchEvent(*args);
-    if (!sendToMotionClassifier) {
+    if (!isTouchEvent(*args)) {
+        mListener->notifyMotion(args);
+        return;
+    }
+
+    std::optional<MotionClassification> classification;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        if (mMotionClassifier) {
+            // Only queues the event for the HAL, and returns the latest classification that the
+            // HAL has made for the gesture.
+            classification = mMotionClassifier->classify(*args);
+        }
+    } // release lock
+    if (!classification) {
         mListener->notifyMotion(args);
         return;
     }
 
     NotifyMotionArgs newArgs(*args);
-    newArgs.classification = mMotionClassifier->classify(newArgs);
+    newArgs.classification = *classification;
     mListener->notifyMotion(&newArgs);
 }
 
@@ -407,10 +442,12 @@ void InputClassifier::notifySwitch(const NotifySwitchArgs* args) {
 }
 
 void InputClassifier::notifyDeviceReset(const NotifyDeviceResetArgs* args) {
-    std::scoped_lock lock(mLock);
-    if (mMotionClassifier) {
-        mMotionClassifier->reset(*args);
-    }
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        if (mMotionClassifier) {
+            mMotionClassifier->reset(*args);
+        }
+    } // release lock
     // continue to next stage
     mListener->notifyDeviceReset(args);
 }
@@ -422,16 +459,27 @@ void InputClassifier::notifyPointerCaptureChanged(const NotifyPointerCaptureChan
 
 void InputClassifier::setMotionClassifier(
         std::unique_ptr<MotionClassifierInterface> motionClassifier) {
-    std::scoped_lock lock(mLock);
-    mMotionClassifier = std::move(motionClassifier);
+    std::shared_ptr<MotionClassifierInterface> oldMotionClassifier;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        oldMotionClassifier = std::move(mMotionClassifier);
+        mMotionClassifier = std::move(motionClassifier);
+    } // release lock
+    // The old classifier, if this is its last reference, joins its HAL thread. Do this without
+    // holding up the events.
+    oldMotionClassifier = nullptr;
 }
 
 void InputClassifier::dump(std::string& dump) {
-    std::scoped_lock lock(mLock);
+    std::shared_ptr<MotionClassifierInterface> motionClassifier;
+    { // acquire lock
+        std::scoped_lock lock(mLock);
+        motionClassifier = mMotionClassifier;
+    } // release lock
     dump += "Input Classifier State:\n";
     dump += INDENT1 "Motion Classifier:\n";
-    if (mMotionClassifier) {
-        mMotionClassifier->dump(dump);
+    if (motionClassifier) {
+        motionClassifier->dump(dump);
     } else {
         dump += INDENT2 "<nullptr>";
     }
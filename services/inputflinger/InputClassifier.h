@@ -19,6 +19,7 @@
 
 #include <android-base/thread_annotations.h>
 #include <utils/RefBase.h>
+#include <array>
 #include <thread>
 #include <unordered_map>
 
@@ -204,15 +205,26 @@ private:
 
     void clearDeviceState(int32_t deviceId);
 
+    static constexpr size_t CLASSIFY_LATENCY_SAMPLES = 128;
+    /**
+     * Durations of the most recent classify calls to the HAL, oldest overwritten first, and the
+     * number of calls so far. The classifications lag behind the events by these durations, so
+     * their distribution is reported in the dump.
+     */
+    std::array<nsecs_t, CLASSIFY_LATENCY_SAMPLES> mClassifyLatencies GUARDED_BY(mLock);
+    size_t mClassifyCount GUARDED_BY(mLock) = 0;
+
+    void recordClassifyLatency(nsecs_t latency);
+
     /**
      * Exit the InputClassifier HAL thread.
      * Useful for tests to ensure proper cleanup.
      */
     void requestExit();
     /**
-     * Return string status of mService
+     * Return string status of mService. Pings the HAL, so must not be called with mLock held.
      */
-    const char* getServiceStatus() REQUIRES(mLock);
+    const char* getServiceStatus() EXCLUDES(mLock);
 };
 
 /**
@@ -242,12 +254,14 @@ public:
     virtual void setMotionClassifierEnabled(bool enabled) override;
 
 private:
-    // Protect access to mMotionClassifier, since it may become null via a hidl callback
+    // Protect access to mMotionClassifier, since it may become null via a hidl callback.
+    // The lock is not held while events are passed to the next stage, nor while the classifier is
+    // dumped, which calls into the HAL.
     std::mutex mLock;
     // The next stage to pass input events to
     sp<InputListenerInterface> mListener;
 
-    std::unique_ptr<MotionClassifierInterface> mMotionClassifier GUARDED_BY(mLock);
+    std::shared_ptr<MotionClassifierInterface> mMotionClassifier GUARDED_BY(mLock);
     std::thread mInitializeMotionClassifierThread;
     /**
      * Set the value of mMotionClassifier.
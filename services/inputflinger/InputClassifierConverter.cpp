@@ -17,6 +17,7 @@
 #include "InputClassifierConverter.h"
 
 using android::hardware::hidl_bitfield;
+using android::hardware::hidl_vec;
 using namespace android::hardware::input;
 
 namespace android {
@@ -305,24 +306,27 @@ static_assert(static_cast<common::V1_0::Axis>(AMOTION_EVENT_AXIS_GENERIC_15) ==
 static_assert(static_cast<common::V1_0::Axis>(AMOTION_EVENT_AXIS_GENERIC_16) ==
         common::V1_0::Axis::GENERIC_16);
 
-static common::V1_0::VideoFrame getHalVideoFrame(const TouchVideoFrame& frame) {
-    common::V1_0::VideoFrame out;
-    out.width = frame.getWidth();
-    out.height = frame.getHeight();
-    out.data = frame.getData();
+/**
+ * The data of the HAL frame refers to the data of the given frame rather than copying it, so the
+ * given frame must outlive the HAL frame.
+ */
+static void getHalVideoFrame(const TouchVideoFrame& frame, common::V1_0::VideoFrame* out) {
+    out->width = frame.getWidth();
+    out->height = frame.getHeight();
+    const std::vector<int16_t>& data = frame.getData();
+    // The data is only read, when the frame is written to the HAL.
+    out->data.setToExternal(const_cast<int16_t*>(data.data()), data.size());
     struct timeval timestamp = frame.getTimestamp();
-    out.timestamp = seconds_to_nanoseconds(timestamp.tv_sec) +
+    out->timestamp = seconds_to_nanoseconds(timestamp.tv_sec) +
              microseconds_to_nanoseconds(timestamp.tv_usec);
-    return out;
 }
 
-static std::vector<common::V1_0::VideoFrame> convertVideoFrames(
-        const std::vector<TouchVideoFrame>& frames) {
-    std::vector<common::V1_0::VideoFrame> out;
-    for (const TouchVideoFrame& frame : frames) {
-        out.push_back(getHalVideoFrame(frame));
+static void convertVideoFrames(const std::vector<TouchVideoFrame>& frames,
+                               hidl_vec<common::V1_0::VideoFrame>* out) {
+    out->resize(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        getHalVideoFrame(frames[i], &(*out)[i]);
     }
-    return out;
 }
 
 static uint8_t getActionIndex(int32_t action) {
@@ -376,7 +380,7 @@ common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(const NotifyMotionArg
     event.pointerProperties = pointerProperties;
     event.pointerCoords = pointerCoords;
 
-    event.frames = convertVideoFrames(args.videoFrames);
+    convertVideoFrames(args.videoFrames, &event.frames);
 
     return event;
 }
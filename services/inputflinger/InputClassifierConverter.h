@@ -24,7 +24,9 @@
 namespace android {
 
 /**
- * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent
+ * Convert from framework's NotifyMotionArgs to hidl's common::V1_0::MotionEvent.
+ * The video frames of the event refer to the data of the frames in args, which must therefore
+ * outlive the event.
  */
 ::android::hardware::input::common::V1_0::MotionEvent notifyMotionArgsToHalMotionEvent(
         const NotifyMotionArgs& args);
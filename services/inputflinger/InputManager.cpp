@@ -25,6 +25,7 @@
 #include <binder/IPCThreadState.h>
 
 #include <log/log.h>
+#include <algorithm>
 #include <unordered_map>
 
 #include <private/android_filesystem_config.h>
@@ -123,11 +124,15 @@ binder::Status InputManager::setInputWindows(
         const std::vector<InputWindowInfo>& infos,
         const sp<ISetInputWindowsListener>& setInputWindowsListener) {
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
-
-    std::vector<sp<InputWindowHandle>> handles;
-    for (const auto& info : infos) {
-        handlesPerDisplay.emplace(info.displayId, std::vector<sp<InputWindowHandle>>());
-        handlesPerDisplay[info.displayId].push_back(new BinderWindowHandle(info));
+    {
+        std::scoped_lock _l(mLock);
+        mWindowHandlesById.clear();
+        for (const auto& info : infos) {
+            sp<InputWindowHandle> handle = new BinderWindowHandle(info);
+            mWindowHandlesById[info.id] = handle;
+            handlesPerDisplay[info.displayId].push_back(handle);
+        }
+        mHandlesPerDisplay = handlesPerDisplay;
     }
     mDispatcher->setInputWindows(handlesPerDisplay);
 
@@ -137,6 +142,81 @@ binder::Status InputManager::setInputWindows(
     return binder::Status::ok();
 }
 
+static bool haveSameWindows(const std::vector<sp<InputWindowHandle>>& handles,
+                            const std::vector<sp<InputWindowHandle>>& otherHandles) {
+    return std::equal(handles.begin(), handles.end(), otherHandles.begin(), otherHandles.end(),
+                      [](const sp<InputWindowHandle>& handle,
+                         const sp<InputWindowHandle>& otherHandle) {
+                          return handle->getId() == otherHandle->getId();
+                      });
+}
+
+binder::Status InputManager::updateInputWindows(
+        const InputWindowsDelta& delta,
+        const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    if (delta.changes.size() != delta.changedWindows.size()) {
+        return binder::Status::fromExceptionCode(binder::Status::EX_ILLEGAL_ARGUMENT,
+                                                 "Every changed window needs its changes");
+    }
+
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> changedHandlesPerDisplay;
+    std::unordered_map<int32_t, Flags<InputWindowInfo::Change>> changesPerDisplay;
+    {
+        std::scoped_lock _l(mLock);
+        std::unordered_map<int32_t, sp<InputWindowHandle>> windowHandlesById;
+        for (size_t i = 0; i < delta.changedWindows.size(); i++) {
+            const InputWindowInfo& info = delta.changedWindows[i];
+            windowHandlesById[info.id] = new BinderWindowHandle(info);
+            changesPerDisplay[info.displayId] |= Flags<InputWindowInfo::Change>(delta.changes[i]);
+        }
+
+        std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> handlesPerDisplay;
+        for (int32_t id : delta.windowIds) {
+            auto it = windowHandlesById.find(id);
+            if (it == windowHandlesById.end()) {
+                auto oldIt = mWindowHandlesById.find(id);
+                if (oldIt == mWindowHandlesById.end()) {
+                    ALOGE("Input windows update refers to unknown window %d", id);
+                    continue;
+                }
+                it = windowHandlesById.insert(*oldIt).first;
+            }
+            handlesPerDisplay[it->second->getInfo()->displayId].push_back(it->second);
+        }
+
+        // Windows that were added, removed or reordered change the state of their display, and
+        // may change its focus. A display that has no windows left is cleared.
+        const Flags<InputWindowInfo::Change> windowsChanged =
+                Flags<InputWindowInfo::Change>(InputWindowInfo::Change::STATE) |
+                InputWindowInfo::Change::FOCUS;
+        for (const auto& [displayId, handles] : handlesPerDisplay) {
+            auto oldIt = mHandlesPerDisplay.find(displayId);
+            if (oldIt == mHandlesPerDisplay.end() || !haveSameWindows(handles, oldIt->second)) {
+                changesPerDisplay[displayId] |= windowsChanged;
+            }
+        }
+        for (const auto& [displayId, _] : mHandlesPerDisplay) {
+            if (handlesPerDisplay.find(displayId) == handlesPerDisplay.end()) {
+                changesPerDisplay[displayId] |= windowsChanged;
+            }
+        }
+        for (const auto& [displayId, _] : changesPerDisplay) {
+            changedHandlesPerDisplay[displayId] = handlesPerDisplay[displayId];
+        }
+
+        mWindowHandlesById = std::move(windowHandlesById);
+        mHandlesPerDisplay = std::move(handlesPerDisplay);
+    }
+    if (!changedHandlesPerDisplay.empty()) {
+        mDispatcher->updateInputWindows(changedHandlesPerDisplay, changesPerDisplay);
+    }
+
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
+    }
+    return binder::Status::ok();
+}
+
 // Used by tests only.
 binder::Status InputManager::createInputChannel(const std::string& name, InputChannel* outChannel) {
     IPCThreadState* ipc = IPCThreadState::self();
@@ -26,6 +26,8 @@
 
 #include <InputDispatcherInterface.h>
 #include <InputDispatcherPolicyInterface.h>
+#include <android-base/thread_annotations.h>
+#include <android/InputWindowsDelta.h>
 #include <android/os/ISetInputWindowsListener.h>
 #include <input/Input.h>
 #include <input/InputTransport.h>
@@ -37,6 +39,9 @@
 #include <utils/Timers.h>
 #include <utils/Vector.h>
 
+#include <mutex>
+#include <unordered_map>
+
 using android::os::BnInputFlinger;
 using android::os::ISetInputWindowsListener;
 
@@ -107,6 +112,9 @@ public:
     binder::Status setInputWindows(
             const std::vector<InputWindowInfo>& handles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) override;
+    binder::Status updateInputWindows(
+            const InputWindowsDelta& delta,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) override;
 
     binder::Status createInputChannel(const std::string& name, InputChannel* outChannel) override;
     binder::Status removeInputChannel(const sp<IBinder>& connectionToken) override;
@@ -118,6 +126,13 @@ private:
     sp<InputClassifierInterface> mClassifier;
 
     sp<InputDispatcherInterface> mDispatcher;
+
+    std::mutex mLock;
+    // The windows of the last update, which the windows that did not change in a delta are
+    // taken from.
+    std::unordered_map<int32_t /*id*/, sp<InputWindowHandle>> mWindowHandlesById GUARDED_BY(mLock);
+    std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mHandlesPerDisplay
+            GUARDED_BY(mLock);
 };
 
 } // namespace android
@@ -18,7 +18,9 @@
 
 #include <android/os/IInputConstants.h>
 #include <binder/Binder.h>
+#include "../dispatcher/EntryPool.h"
 #include "../dispatcher/InputDispatcher.h"
+#include "LatencyCounters.h"
 
 using android::os::IInputConstants;
 using android::os::InputEventInjectionResult;
@@ -134,9 +136,14 @@ public:
 
 class FakeInputReceiver {
 public:
-    void consumeEvent() {
+    // Consumes and finishes the next event, and returns how long after its event time it was
+    // consumed.
+    nsecs_t consumeEvent() {
         uint32_t consumeSeq = 0;
-        InputEvent* event;
+        InputEvent* event = nullptr;
+        int motionEventType;
+        int touchMoveNumber;
+        bool flag;
 
         std::chrono::time_point start = std::chrono::steady_clock::now();
         status_t result = WOULD_BLOCK;
@@ -147,15 +154,20 @@ public:
                 break;
             }
             result = mConsumer->consume(&mEventFactory, true /*consumeBatches*/, -1, &consumeSeq,
-                                        &event);
+                                        &event, &motionEventType, &touchMoveNumber, &flag);
         }
+        const nsecs_t consumeTime = now();
         if (result != OK) {
             ALOGE("Received result = %d from consume()", result);
+            return 0;
         }
         result = mConsumer->sendFinishedSignal(consumeSeq, true);
         if (result != OK) {
             ALOGE("Received result = %d from sendFinishedSignal", result);
         }
+        return event->getType() == AINPUT_EVENT_TYPE_MOTION
+                ? consumeTime - static_cast<MotionEvent*>(event)->getEventTime()
+                : 0;
     }
 
 protected:
@@ -165,6 +177,12 @@ protected:
         mConsumer = std::make_unique<InputConsumer>(mClientChannel);
     }
 
+    FakeInputReceiver(const sp<InputDispatcher>& dispatcher,
+                      std::shared_ptr<InputChannel> clientChannel)
+          : mDispatcher(dispatcher), mClientChannel(std::move(clientChannel)) {
+        mConsumer = std::make_unique<InputConsumer>(mClientChannel);
+    }
+
     virtual ~FakeInputReceiver() {}
 
     sp<InputDispatcher> mDispatcher;
@@ -179,8 +197,9 @@ public:
     static const int32_t HEIGHT = 200;
 
     FakeWindowHandle(const std::shared_ptr<InputApplicationHandle>& inputApplicationHandle,
-                     const sp<InputDispatcher>& dispatcher, const std::string name)
-          : FakeInputReceiver(dispatcher, name), mFrame(Rect(0, 0, WIDTH, HEIGHT)) {
+                     const sp<InputDispatcher>& dispatcher, const std::string name,
+                     const Rect& frame = Rect(0, 0, WIDTH, HEIGHT))
+          : FakeInputReceiver(dispatcher, name), mFrame(frame) {
         inputApplicationHandle->updateInfo();
         mInfo.applicationInfo = *inputApplicationHandle->getInfo();
     }
@@ -189,6 +208,8 @@ public:
         mInfo.token = mClientChannel->getConnectionToken();
         mInfo.name = "FakeWindowHandle";
         mInfo.type = InputWindowInfo::Type::APPLICATION;
+        // Like most windows, only take the touches within the frame.
+        mInfo.flags = InputWindowInfo::Flag::NOT_TOUCH_MODAL;
         mInfo.dispatchingTimeout = DISPATCHING_TIMEOUT;
         mInfo.frameLeft = mFrame.left;
         mInfo.frameTop = mFrame.top;
@@ -212,6 +233,16 @@ protected:
     Rect mFrame;
 };
 
+// Receives every event of its display, like the monitors of the system UI.
+class FakeMonitorReceiver : public FakeInputReceiver {
+public:
+    FakeMonitorReceiver(const sp<InputDispatcher>& dispatcher, const std::string name)
+          : FakeInputReceiver(dispatcher,
+                              *dispatcher->createInputMonitor(ADISPLAY_ID_DEFAULT,
+                                                              /*isGestureMonitor*/ false, name,
+                                                              INJECTOR_PID)) {}
+};
+
 static MotionEvent generateMotionEvent() {
     PointerProperties pointerProperties[1];
     PointerCoords pointerCoords[1];
@@ -281,8 +312,7 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
     dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
 
     NotifyMotionArgs motionArgs = generateMotionArgs();
-
-    for (auto _ : state) {
+    const auto sendAndConsumeTap = [&]() {
         // Send ACTION_DOWN
         motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
         motionArgs.downTime = now();
@@ -296,8 +326,21 @@ static void benchmarkNotifyMotion(benchmark::State& state) {
 
         window->consumeEvent();
         window->consumeEvent();
+    };
+
+    // Warm up the entry pools, after which the entries of each event are recycled rather than
+    // taken from the heap.
+    sendAndConsumeTap();
+    const size_t heapAllocations = gEntryPoolHeapAllocations;
+
+    for (auto _ : state) {
+        sendAndConsumeTap();
     }
 
+    // Expected to stay at 0.
+    state.counters["EntryHeapAllocations"] =
+            static_cast<double>(gEntryPoolHeapAllocations - heapAllocations);
+
     dispatcher->stop();
 }
 
@@ -334,8 +377,149 @@ static void benchmarkInjectMotion(benchmark::State& state) {
     dispatcher->stop();
 }
 
+static void benchmarkNotifyMotionManyWindows(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    // The windows in front of the touched one do not contain the touch, as with many small
+    // windows tiled next to each other. The touched window is at the back, so that every window
+    // has to be hit-tested before it is found.
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows;
+    const int32_t windowCount = static_cast<int32_t>(state.range(0));
+    for (int32_t i = 0; i < windowCount - 1; i++) {
+        const int32_t left = FakeWindowHandle::WIDTH + (i % 10) * FakeWindowHandle::WIDTH;
+        const int32_t top = (i / 10) * FakeWindowHandle::HEIGHT;
+        windows.push_back(new FakeWindowHandle(application, dispatcher,
+                                               "Fake Window " + std::to_string(i),
+                                               Rect(left, top, left + FakeWindowHandle::WIDTH,
+                                                    top + FakeWindowHandle::HEIGHT)));
+    }
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Touched Window");
+    windows.push_back(window);
+
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        window->consumeEvent();
+        window->consumeEvent();
+    }
+
+    dispatcher->stop();
+}
+
+static void benchmarkSetInputWindows(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    // Updating the windows also rebuilds the hit-testing index of the display.
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows;
+    for (int32_t i = 0; i < static_cast<int32_t>(state.range(0)); i++) {
+        const int32_t left = (i % 10) * FakeWindowHandle::WIDTH;
+        const int32_t top = (i / 10) * FakeWindowHandle::HEIGHT;
+        windows.push_back(new FakeWindowHandle(application, dispatcher,
+                                               "Fake Window " + std::to_string(i),
+                                               Rect(left, top, left + FakeWindowHandle::WIDTH,
+                                                    top + FakeWindowHandle::HEIGHT)));
+    }
+
+    for (auto _ : state) {
+        dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+    }
+
+    dispatcher->stop();
+}
+
+/**
+ * Sends taps through a display with many windows, which all have to be hit-tested, and with
+ * monitors that each get every event in addition to the touched window. The latency of an event is
+ * the time from its event time to each of its receivers consuming it.
+ */
+static void benchmarkNotifyMotionFanOut(benchmark::State& state) {
+    // Create dispatcher
+    sp<FakeInputDispatcherPolicy> fakePolicy = new FakeInputDispatcherPolicy();
+    sp<InputDispatcher> dispatcher = new InputDispatcher(fakePolicy);
+    dispatcher->setInputDispatchMode(/*enabled*/ true, /*frozen*/ false);
+    dispatcher->start();
+
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    std::vector<sp<InputWindowHandle>> windows;
+    const int32_t windowCount = static_cast<int32_t>(state.range(0));
+    for (int32_t i = 0; i < windowCount - 1; i++) {
+        const int32_t left = FakeWindowHandle::WIDTH + (i % 10) * FakeWindowHandle::WIDTH;
+        const int32_t top = (i / 10) * FakeWindowHandle::HEIGHT;
+        windows.push_back(new FakeWindowHandle(application, dispatcher,
+                                               "Fake Window " + std::to_string(i),
+                                               Rect(left, top, left + FakeWindowHandle::WIDTH,
+                                                    top + FakeWindowHandle::HEIGHT)));
+    }
+    sp<FakeWindowHandle> window = new FakeWindowHandle(application, dispatcher, "Touched Window");
+    windows.push_back(window);
+    dispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, windows}});
+
+    std::vector<std::unique_ptr<FakeMonitorReceiver>> monitors;
+    for (int64_t i = 0; i < state.range(1); i++) {
+        monitors.push_back(
+                std::make_unique<FakeMonitorReceiver>(dispatcher,
+                                                      "Fake Monitor " + std::to_string(i)));
+    }
+
+    NotifyMotionArgs motionArgs = generateMotionArgs();
+    std::vector<nsecs_t> latencies;
+    for (auto _ : state) {
+        // Send ACTION_DOWN
+        motionArgs.action = AMOTION_EVENT_ACTION_DOWN;
+        motionArgs.downTime = now();
+        motionArgs.eventTime = motionArgs.downTime;
+        dispatcher->notifyMotion(&motionArgs);
+
+        // Send ACTION_UP
+        motionArgs.action = AMOTION_EVENT_ACTION_UP;
+        motionArgs.eventTime = now();
+        dispatcher->notifyMotion(&motionArgs);
+
+        for (int i = 0; i < 2; i++) {
+            latencies.push_back(window->consumeEvent());
+            for (const std::unique_ptr<FakeMonitorReceiver>& monitor : monitors) {
+                latencies.push_back(monitor->consumeEvent());
+            }
+        }
+    }
+
+    reportLatencyCounters(state, latencies, 2 * (1 + monitors.size()));
+    dispatcher->stop();
+}
+
 BENCHMARK(benchmarkNotifyMotion);
 BENCHMARK(benchmarkInjectMotion);
+BENCHMARK(benchmarkNotifyMotionManyWindows)->Arg(10)->Arg(100)->Arg(200);
+BENCHMARK(benchmarkSetInputWindows)->Arg(10)->Arg(100)->Arg(200);
+BENCHMARK(benchmarkNotifyMotionFanOut)
+        ->ArgNames({"windows", "monitors"})
+        ->Args({1, 0})
+        ->Args({1, 4})
+        ->Args({100, 0})
+        ->Args({100, 4});
 
 } // namespace android::inputdispatcher
 
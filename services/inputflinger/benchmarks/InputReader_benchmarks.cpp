@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <EventHub.h>
+#include <InputReader.h>
+#include <UinputDevice.h>
+#include <android-base/thread_annotations.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+#include "LatencyCounters.h"
+
+using namespace std::chrono_literals;
+
+namespace android {
+
+static const int32_t DISPLAY_ID = 0;
+static const int32_t DISPLAY_WIDTH = 1080;
+static const int32_t DISPLAY_HEIGHT = 1920;
+static const std::string DISPLAY_UNIQUE_ID = "local:0";
+
+// Long enough for the devices to be added and their events to be read, even on a loaded device.
+static constexpr std::chrono::duration WAIT_TIMEOUT = 2s;
+
+static nsecs_t now() {
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+// --- FakeInputReaderPolicy ---
+
+class FakeInputReaderPolicy : public InputReaderPolicyInterface {
+public:
+    FakeInputReaderPolicy() {
+        // Touch screens are only enabled once there is an internal display for them.
+        DisplayViewport viewport;
+        viewport.displayId = DISPLAY_ID;
+        viewport.orientation = DISPLAY_ORIENTATION_0;
+        viewport.logicalRight = DISPLAY_WIDTH;
+        viewport.logicalBottom = DISPLAY_HEIGHT;
+        viewport.physicalRight = DISPLAY_WIDTH;
+        viewport.physicalBottom = DISPLAY_HEIGHT;
+        viewport.deviceWidth = DISPLAY_WIDTH;
+        viewport.deviceHeight = DISPLAY_HEIGHT;
+        viewport.isActive = true;
+        viewport.uniqueId = DISPLAY_UNIQUE_ID;
+        viewport.type = ViewportType::INTERNAL;
+        mConfig.setDisplayViewports({viewport});
+    }
+
+    // Waits for the reader to report count devices with the given name, and returns their ids.
+    std::set<int32_t> waitForDevices(const std::string& name, size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        base::ScopedLockAssertion assumeLocked(mLock);
+        std::set<int32_t> deviceIds;
+        mDevicesChanged.wait_for(lock, WAIT_TIMEOUT, [&]() REQUIRES(mLock) {
+            deviceIds.clear();
+            for (const InputDeviceInfo& info : mInputDevices) {
+                if (info.getIdentifier().name == name) {
+                    deviceIds.insert(info.getId());
+                }
+            }
+            return deviceIds.size() >= count;
+        });
+        return deviceIds;
+    }
+
+protected:
+    virtual ~FakeInputReaderPolicy() {}
+
+private:
+    void getReaderConfiguration(InputReaderConfiguration* outConfig) override {
+        *outConfig = mConfig;
+    }
+
+    std::shared_ptr<PointerControllerInterface> obtainPointerController(int32_t) override {
+        return nullptr;
+    }
+
+    void notifyInputDevicesChanged(const std::vector<InputDeviceInfo>& inputDevices) override {
+        std::scoped_lock _l(mLock);
+        mInputDevices = inputDevices;
+        mDevicesChanged.notify_all();
+    }
+
+    std::shared_ptr<KeyCharacterMap> getKeyboardLayoutOverlay(
+            const InputDeviceIdentifier&) override {
+        return nullptr;
+    }
+
+    std::string getDeviceAlias(const InputDeviceIdentifier&) override { return ""; }
+
+    TouchAffineTransformation getTouchAffineTransformation(const std::string&,
+                                                           int32_t) override {
+        return TouchAffineTransformation();
+    }
+
+    InputReaderConfiguration mConfig;
+    std::mutex mLock;
+    std::condition_variable mDevicesChanged;
+    std::vector<InputDeviceInfo> mInputDevices GUARDED_BY(mLock);
+};
+
+// --- MotionListener ---
+
+// Keeps the time at which each motion event of the benchmarked devices came out of the reader.
+class MotionListener : public InputListenerInterface {
+public:
+    void setDeviceIds(std::set<int32_t> deviceIds) {
+        std::scoped_lock _l(mLock);
+        mDeviceIds = std::move(deviceIds);
+    }
+
+    // Waits for count motion events, and returns the times at which they were notified, or an
+    // empty vector if they did not all come in time.
+    std::vector<nsecs_t> waitForMotions(size_t count) {
+        std::unique_lock<std::mutex> lock(mLock);
+        base::ScopedLockAssertion assumeLocked(mLock);
+        if (!mMotionNotified.wait_for(lock, WAIT_TIMEOUT, [&]() REQUIRES(mLock) {
+                return mMotionTimes.size() >= count;
+            })) {
+            return {};
+        }
+        std::vector<nsecs_t> times;
+        std::swap(times, mMotionTimes);
+        return times;
+    }
+
+protected:
+    virtual ~MotionListener() {}
+
+private:
+    void notifyConfigurationChanged(const NotifyConfigurationChangedArgs*) override {}
+    void notifyKey(const NotifyKeyArgs*) override {}
+
+    void notifyMotion(const NotifyMotionArgs* args) override {
+        const nsecs_t notifyTime = now();
+        std::scoped_lock _l(mLock);
+        if (mDeviceIds.find(args->deviceId) == mDeviceIds.end()) {
+            return;
+        }
+        mMotionTimes.push_back(notifyTime);
+        mMotionNotified.notify_all();
+    }
+
+    void notifySwitch(const NotifySwitchArgs*) override {}
+    void notifySensor(const NotifySensorArgs*) override {}
+    void notifyVibratorState(const NotifyVibratorStateArgs*) override {}
+    void notifyDeviceReset(const NotifyDeviceResetArgs*) override {}
+    void notifyPointerCaptureChanged(const NotifyPointerCaptureChangedArgs*) override {}
+
+    std::mutex mLock;
+    std::condition_variable mMotionNotified;
+    std::set<int32_t> mDeviceIds GUARDED_BY(mLock);
+    std::vector<nsecs_t> mMotionTimes GUARDED_BY(mLock);
+};
+
+// --- UinputMultiTouchScreen ---
+
+// A touch screen that reports all of its fingers in each frame, as real touch screens do.
+class UinputMultiTouchScreen : public UinputTouchScreen {
+public:
+    template <class D, class... Ts>
+    friend std::unique_ptr<D> createUinputDevice(Ts... args);
+
+    void sendFingersDown(int32_t fingerCount) {
+        for (int32_t i = 0; i < fingerCount; i++) {
+            injectEvent(EV_ABS, ABS_MT_SLOT, i);
+            injectEvent(EV_ABS, ABS_MT_TRACKING_ID, i);
+            injectEvent(EV_ABS, ABS_MT_POSITION_X, getFingerX(i));
+            injectEvent(EV_ABS, ABS_MT_POSITION_Y, DISPLAY_HEIGHT / 2);
+        }
+        injectEvent(EV_KEY, BTN_TOUCH, 1);
+        injectEvent(EV_SYN, SYN_REPORT, 0);
+    }
+
+    // Moves every finger by offset from where it went down, in a single frame.
+    void sendFingersMove(int32_t fingerCount, int32_t offset) {
+        for (int32_t i = 0; i < fingerCount; i++) {
+            injectEvent(EV_ABS, ABS_MT_SLOT, i);
+            injectEvent(EV_ABS, ABS_MT_POSITION_X, getFingerX(i) + offset);
+            injectEvent(EV_ABS, ABS_MT_POSITION_Y, DISPLAY_HEIGHT / 2 + offset);
+        }
+        injectEvent(EV_SYN, SYN_REPORT, 0);
+    }
+
+    void sendFingersUp(int32_t fingerCount) {
+        for (int32_t i = 0; i < fingerCount; i++) {
+            injectEvent(EV_ABS, ABS_MT_SLOT, i);
+            injectEvent(EV_ABS, ABS_MT_TRACKING_ID, -1);
+        }
+        injectEvent(EV_KEY, BTN_TOUCH, 0);
+        injectEvent(EV_SYN, SYN_REPORT, 0);
+    }
+
+protected:
+    explicit UinputMultiTouchScreen(const Rect* size) : UinputTouchScreen(size) {}
+
+private:
+    static int32_t getFingerX(int32_t finger) { return (finger + 1) * DISPLAY_WIDTH / 12; }
+};
+
+/**
+ * Reads a frame from each of several touch screens at once, with several fingers down on each,
+ * through the EventHub and the MultiTouchInputMapper of every device. The latency of an event is
+ * the time from the start of its frame to the reader notifying its motion.
+ *
+ * The devices are real uinput devices, so this has to run as root.
+ */
+static void benchmarkMultiTouchMove(benchmark::State& state) {
+    const size_t deviceCount = static_cast<size_t>(state.range(0));
+    const int32_t fingerCount = static_cast<int32_t>(state.range(1));
+
+    sp<FakeInputReaderPolicy> policy = new FakeInputReaderPolicy();
+    sp<MotionListener> listener = new MotionListener();
+    sp<InputReader> reader = new InputReader(std::make_shared<EventHub>(), policy, listener);
+    reader->start();
+
+    std::vector<std::unique_ptr<UinputMultiTouchScreen>> devices;
+    for (size_t i = 0; i < deviceCount; i++) {
+        devices.push_back(createUinputDevice<UinputMultiTouchScreen>(
+                Rect(0, 0, DISPLAY_WIDTH, DISPLAY_HEIGHT)));
+    }
+    std::set<int32_t> deviceIds =
+            policy->waitForDevices(UinputTouchScreen::DEVICE_NAME, deviceCount);
+    if (deviceIds.size() < deviceCount) {
+        state.SkipWithError("The touch screens were not added, is this running as root?");
+        reader->stop();
+        return;
+    }
+    listener->setDeviceIds(std::move(deviceIds));
+
+    // Each touch screen reports a down and then a pointer down for each of its other fingers.
+    for (const std::unique_ptr<UinputMultiTouchScreen>& device : devices) {
+        device->sendFingersDown(fingerCount);
+    }
+    listener->waitForMotions(deviceCount * fingerCount);
+
+    std::vector<nsecs_t> latencies;
+    int32_t offset = 0;
+    for (auto _ : state) {
+        offset = offset == 0 ? 10 : 0;
+        const nsecs_t frameTime = now();
+        for (const std::unique_ptr<UinputMultiTouchScreen>& device : devices) {
+            device->sendFingersMove(fingerCount, offset);
+        }
+        const std::vector<nsecs_t> motionTimes = listener->waitForMotions(deviceCount);
+        if (motionTimes.empty()) {
+            state.SkipWithError("Timed out waiting for the motion events");
+            break;
+        }
+        for (nsecs_t motionTime : motionTimes) {
+            latencies.push_back(motionTime - frameTime);
+        }
+    }
+
+    for (const std::unique_ptr<UinputMultiTouchScreen>& device : devices) {
+        device->sendFingersUp(fingerCount);
+    }
+    reportLatencyCounters(state, latencies, deviceCount);
+    reader->stop();
+}
+
+BENCHMARK(benchmarkMultiTouchMove)
+        ->ArgNames({"devices", "fingers"})
+        ->Args({1, 1})
+        ->Args({1, 10})
+        ->Args({4, 1})
+        ->Args({4, 10});
+
+} // namespace android
+
+BENCHMARK_MAIN();
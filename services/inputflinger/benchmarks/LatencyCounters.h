@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_BENCHMARKS_LATENCYCOUNTERS_H
+#define _UI_INPUT_BENCHMARKS_LATENCYCOUNTERS_H
+
+#include <benchmark/benchmark.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace android {
+
+/**
+ * Reports the percentiles of the latencies of the events that a benchmark measured, in
+ * microseconds, along with the number of events per iteration, so that the CPU time per event can
+ * be told from the time per iteration.
+ */
+inline void reportLatencyCounters(benchmark::State& state, std::vector<nsecs_t>& latencies,
+                                  size_t eventsPerIteration) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * eventsPerIteration));
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double fraction) {
+        const size_t index = std::min(latencies.size() - 1,
+                                      static_cast<size_t>(fraction * latencies.size()));
+        return static_cast<double>(ns2us(latencies[index]));
+    };
+    state.counters["LatencyP50Us"] = percentile(0.5);
+    state.counters["LatencyP90Us"] = percentile(0.9);
+    state.counters["LatencyP99Us"] = percentile(0.99);
+    state.counters["LatencyMaxUs"] = static_cast<double>(ns2us(latencies.back()));
+}
+
+} // namespace android
+
+#endif // _UI_INPUT_BENCHMARKS_LATENCYCOUNTERS_H
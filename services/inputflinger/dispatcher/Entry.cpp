@@ -17,6 +17,7 @@
 #include "Entry.h"
 
 #include "Connection.h"
+#include "EntryPool.h"
 
 #include <android-base/properties.h>
 #include <android-base/stringprintf.h>
@@ -307,6 +308,15 @@ DispatchEntry::DispatchEntry(std::shared_ptr<EventEntry> eventEntry, int32_t tar
         resolvedAction(0),
         resolvedFlags(0) {}
 
+void* DispatchEntry::operator new(size_t) {
+    // DispatchEntry is final, so this is always the size of one.
+    return BlockPool<sizeof(DispatchEntry), alignof(DispatchEntry)>::getInstance().allocate();
+}
+
+void DispatchEntry::operator delete(void* pointer) {
+    BlockPool<sizeof(DispatchEntry), alignof(DispatchEntry)>::getInstance().release(pointer);
+}
+
 uint32_t DispatchEntry::nextSeq() {
     // Sequence number 0 is reserved and will never be returned.
     uint32_t seq;
@@ -208,7 +208,7 @@ struct SensorEntry : EventEntry {
 };
 
 // Tracks the progress of dispatching a particular event to a particular connection.
-struct DispatchEntry {
+struct DispatchEntry final {
     const uint32_t seq; // unique sequence number, never 0
 
     std::shared_ptr<EventEntry> eventEntry; // the event to dispatch
@@ -234,6 +234,10 @@ struct DispatchEntry {
 
     inline bool isSplit() const { return targetFlags & InputTarget::FLAG_SPLIT; }
 
+    // One is created for every event and target, so their memory is recycled.
+    static void* operator new(size_t size);
+    static void operator delete(void* pointer);
+
 private:
     static volatile int32_t sNextSeqAtomic;
 
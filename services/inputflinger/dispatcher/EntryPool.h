@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_ENTRYPOOL_H
+#define _UI_INPUT_INPUTDISPATCHER_ENTRYPOOL_H
+
+#include <android-base/thread_annotations.h>
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+
+namespace android::inputdispatcher {
+
+// Number of blocks the pools had to take from the heap so far, rather than recycle.
+inline std::atomic<size_t> gEntryPoolHeapAllocations{0};
+
+/**
+ * Recycles the memory of blocks of a given size, for the objects the dispatcher allocates for
+ * every event, such as the entries of its queues. Once the pool has warmed up, dispatching an
+ * event no longer needs the heap for them.
+ *
+ * Freed blocks are kept on a free list, up to MAX_FREE_BLOCKS of them, and handed out again by
+ * the next allocations. Entries may be freed on any thread, so the free list has its own lock.
+ * There is one pool per block size and alignment, which is never destroyed, as entries may
+ * outlive the dispatcher.
+ */
+template <size_t Size, size_t Alignment>
+class BlockPool {
+public:
+    static BlockPool& getInstance() {
+        static BlockPool* sPool = new BlockPool();
+        return *sPool;
+    }
+
+    void* allocate() {
+        {
+            std::scoped_lock _l(mLock);
+            if (mFreeBlocks != nullptr) {
+                Block* block = mFreeBlocks;
+                mFreeBlocks = block->next;
+                mFreeBlockCount--;
+                return block;
+            }
+        }
+        gEntryPoolHeapAllocations++;
+        return new Block;
+    }
+
+    void release(void* pointer) {
+        Block* block = static_cast<Block*>(pointer);
+        {
+            std::scoped_lock _l(mLock);
+            if (mFreeBlockCount < MAX_FREE_BLOCKS) {
+                block->next = mFreeBlocks;
+                mFreeBlocks = block;
+                mFreeBlockCount++;
+                return;
+            }
+        }
+        delete block;
+    }
+
+private:
+    // Enough for the events in flight to a handful of slow connections, while bounding the
+    // memory kept around after a burst.
+    static constexpr size_t MAX_FREE_BLOCKS = 64;
+
+    union Block {
+        Block* next;
+        alignas(Alignment) unsigned char storage[Size];
+    };
+
+    BlockPool() = default;
+
+    std::mutex mLock;
+    Block* mFreeBlocks GUARDED_BY(mLock) = nullptr;
+    size_t mFreeBlockCount GUARDED_BY(mLock) = 0;
+};
+
+/**
+ * Allocator that takes single objects from a BlockPool, for use with std::allocate_shared so that
+ * an entry and its reference count share one recycled block.
+ */
+template <typename T>
+struct PoolAllocator {
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) {
+            return std::allocator<T>().allocate(n);
+        }
+        return static_cast<T*>(BlockPool<sizeof(T), alignof(T)>::getInstance().allocate());
+    }
+
+    void deallocate(T* pointer, size_t n) {
+        if (n != 1) {
+            std::allocator<T>().deallocate(pointer, n);
+            return;
+        }
+        BlockPool<sizeof(T), alignof(T)>::getInstance().release(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const {
+        return true;
+    }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const {
+        return false;
+    }
+};
+
+// Creates an entry in a recycled block, shared with its reference count.
+template <typename T, typename... Args>
+std::shared_ptr<T> makePooledEntry(Args&&... args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+}
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_ENTRYPOOL_H
@@ -71,6 +71,7 @@ static constexpr bool DEBUG_TOUCH_OCCLUSION = true;
 #include <sstream>
 
 #include "Connection.h"
+#include "EntryPool.h"
 #include "InputDispatcher.h"
 
 #define INDENT "  "
@@ -126,6 +127,9 @@ constexpr std::chrono::nanoseconds KEY_WAITING_FOR_EVENTS_TIMEOUT = 500ms;
 // Number of recent events to keep for debugging purposes.
 constexpr size_t RECENT_QUEUE_MAX_SIZE = 10;
 
+// Maximum number of events sent to a connection in a single system call.
+constexpr size_t MAX_DEFERRED_EVENTS = 16;
+
 // Event log tags. See EventLogTags.logtags for reference
 constexpr int LOGTAG_INPUT_INTERACTION = 62000;
 constexpr int LOGTAG_INPUT_FOCUS = 62001;
@@ -365,18 +369,18 @@ static std::unique_ptr<DispatchEntry> createDispatchEntry(const InputTarget& inp
         pointerCoords[pointerIndex].transform(inverseFirstTransform);
     }
 
-    std::unique_ptr<MotionEntry> combinedMotionEntry =
-            std::make_unique<MotionEntry>(motionEntry.id, motionEntry.eventTime,
-                                          motionEntry.deviceId, motionEntry.source,
-                                          motionEntry.displayId, motionEntry.policyFlags,
-                                          motionEntry.action, motionEntry.actionButton,
-                                          motionEntry.flags, motionEntry.metaState,
-                                          motionEntry.buttonState, motionEntry.classification,
-                                          motionEntry.edgeFlags, motionEntry.xPrecision,
-                                          motionEntry.yPrecision, motionEntry.xCursorPosition,
-                                          motionEntry.yCursorPosition, motionEntry.downTime,
-                                          motionEntry.pointerCount, motionEntry.pointerProperties,
-                                          pointerCoords.data(), 0 /* xOffset */, 0 /* yOffset */);
+    std::shared_ptr<MotionEntry> combinedMotionEntry =
+            makePooledEntry<MotionEntry>(motionEntry.id, motionEntry.eventTime,
+                                         motionEntry.deviceId, motionEntry.source,
+                                         motionEntry.displayId, motionEntry.policyFlags,
+                                         motionEntry.action, motionEntry.actionButton,
+                                         motionEntry.flags, motionEntry.metaState,
+                                         motionEntry.buttonState, motionEntry.classification,
+                                         motionEntry.edgeFlags, motionEntry.xPrecision,
+                                         motionEntry.yPrecision, motionEntry.xCursorPosition,
+                                         motionEntry.yCursorPosition, motionEntry.downTime,
+                                         motionEntry.pointerCount, motionEntry.pointerProperties,
+                                         pointerCoords.data(), 0 /* xOffset */, 0 /* yOffset */);
 
     if (motionEntry.injectionState) {
         combinedMotionEntry->injectionState = motionEntry.injectionState;
@@ -525,7 +529,7 @@ InputDispatcher::InputDispatcher(const sp<InputDispatcherPolicyInterface>& polic
         mFocusedDisplayId(ADISPLAY_ID_DEFAULT),
         mWindowTokenWithPointerCapture(nullptr),
         mLatencyAggregator(),
-        mLatencyTracker(&mLatencyAggregator),
+        mLatencyRecorder(&mLatencyAggregator),
         mCompatService(getCompatService()) {
     mLooper = new Looper(false);
     mReporter = createInputReporter();
@@ -733,8 +737,9 @@ void InputDispatcher::dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) {
             }
         } else {
             // Inbound queue has at least one entry.
-            mPendingEvent = mInboundQueue.front();
-            mInboundQueue.pop_front();
+            auto it = findNextInboundEventLocked();
+            mPendingEvent = *it;
+            mInboundQueue.erase(it);
             traceInboundQueueLengthLocked();
         }
 
@@ -863,7 +868,40 @@ void InputDispatcher::dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) {
 
         releasePendingEventLocked();
         *nextWakeupTime = LONG_LONG_MIN; // force next poll to wake up immediately
+    } else if (mNoFocusedWindowTimeoutTime.has_value() && mNextUnblockedEvent == nullptr) {
+        // The pending event may be waiting for its display to get a focused window, which should
+        // not hold up the other displays. Put it back at the head of the queue, and dispatch the
+        // events of the other displays queued behind it first, if there are any.
+        mInboundQueue.push_front(mPendingEvent);
+        if (findNextInboundEventLocked() != mInboundQueue.begin()) {
+            mPendingEvent = nullptr;
+            *nextWakeupTime = LONG_LONG_MIN; // force next poll to wake up immediately
+        } else {
+            mInboundQueue.pop_front();
+        }
+    }
+}
+
+std::deque<std::shared_ptr<EventEntry>>::iterator InputDispatcher::findNextInboundEventLocked() {
+    if (!mNoFocusedWindowTimeoutTime.has_value() || mNextUnblockedEvent != nullptr) {
+        return mInboundQueue.begin();
+    }
+
+    // Only keys and motions are tied to a display. Any other event applies to every display, so
+    // nothing may be dispatched ahead of it. The events of a device are never reordered either.
+    std::unordered_set<int32_t> heldBackDeviceIds;
+    for (auto it = mInboundQueue.begin(); it != mInboundQueue.end(); it++) {
+        const EventEntry& entry = **it;
+        if (entry.type != EventEntry::Type::KEY && entry.type != EventEntry::Type::MOTION) {
+            break;
+        }
+        if (getTargetDisplayId(entry) != mAwaitedApplicationDisplayId &&
+            heldBackDeviceIds.find(entry.deviceId) == heldBackDeviceIds.end()) {
+            return it;
+        }
+        heldBackDeviceIds.insert(entry.deviceId);
     }
+    return mInboundQueue.begin();
 }
 
 /**
@@ -878,7 +916,10 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
     // decides to touch a window in a different application.
     // If the application takes too long to catch up then we drop all events preceding
     // the touch into the other window.
-    if (isPointerDownEvent && mAwaitedFocusedApplication != nullptr) {
+    // Touches on other displays are dispatched ahead of the events waiting for the application,
+    // so there is no need to drop those.
+    if (isPointerDownEvent && mAwaitedFocusedApplication != nullptr &&
+        motionEntry.displayId == mAwaitedApplicationDisplayId) {
         int32_t displayId = motionEntry.displayId;
         int32_t x = static_cast<int32_t>(
                 motionEntry.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_X));
@@ -926,7 +967,44 @@ bool InputDispatcher::shouldPruneInboundQueueLocked(const MotionEntry& motionEnt
     return false;
 }
 
-bool InputDispatcher::enqueueInboundEventLocked(std::unique_ptr<EventEntry> newEntry) {
+/**
+ * With pointer capture, a gaming mouse can report its movement thousands of times per second,
+ * more often than the events can be dispatched. Moves that arrive while the previous one is still
+ * waiting in the inbound queue are added to it rather than queued, so that the dispatcher keeps up
+ * without dropping any of the movement. Nothing is coalesced while the dispatcher keeps up.
+ */
+bool InputDispatcher::coalesceCapturedMotionLocked(const NotifyMotionArgs& args,
+                                                   uint32_t policyFlags) {
+    if (mWindowTokenWithPointerCapture == nullptr || args.source != AINPUT_SOURCE_MOUSE_RELATIVE ||
+        args.action != AMOTION_EVENT_ACTION_MOVE || args.pointerCount != 1 ||
+        mInboundQueue.empty() || mInboundQueue.back()->type != EventEntry::Type::MOTION) {
+        return false;
+    }
+    MotionEntry& lastEntry = static_cast<MotionEntry&>(*mInboundQueue.back());
+    if (lastEntry.dispatchInProgress || lastEntry.isInjected() ||
+        lastEntry.policyFlags != policyFlags ||
+        lastEntry.deviceId != args.deviceId || lastEntry.source != args.source ||
+        lastEntry.displayId != args.displayId || lastEntry.action != args.action ||
+        lastEntry.flags != args.flags || lastEntry.metaState != args.metaState ||
+        lastEntry.buttonState != args.buttonState || lastEntry.pointerCount != 1 ||
+        lastEntry.pointerProperties[0] != args.pointerProperties[0]) {
+        return false;
+    }
+
+    // The axes of a captured mouse are all relative, so the moves add up.
+    PointerCoords coords = args.pointerCoords[0];
+    for (int32_t axis : {AMOTION_EVENT_AXIS_X, AMOTION_EVENT_AXIS_Y, AMOTION_EVENT_AXIS_RELATIVE_X,
+                         AMOTION_EVENT_AXIS_RELATIVE_Y}) {
+        coords.setAxisValue(axis,
+                            coords.getAxisValue(axis) +
+                                    lastEntry.pointerCoords[0].getAxisValue(axis));
+    }
+    lastEntry.pointerCoords[0] = coords;
+    lastEntry.eventTime = args.eventTime;
+    return true;
+}
+
+bool InputDispatcher::enqueueInboundEventLocked(std::shared_ptr<EventEntry> newEntry) {
     bool needWake = mInboundQueue.empty();
     mInboundQueue.push_back(std::move(newEntry));
     EventEntry& entry = *(mInboundQueue.back());
@@ -998,45 +1076,61 @@ sp<InputWindowHandle> InputDispatcher::findTouchedWindowAtLocked(int32_t display
         LOG_ALWAYS_FATAL(
                 "Must provide a valid touch state if adding portal windows or outside targets");
     }
-    // Traverse windows from front to back to find touched window.
     const std::vector<sp<InputWindowHandle>>& windowHandles = getWindowHandlesLocked(displayId);
-    for (const sp<InputWindowHandle>& windowHandle : windowHandles) {
+    const TouchableWindowIndex& index = getTouchableWindowIndexLocked(displayId);
+
+    // Traverse the windows that may contain the point from front to back to find touched window.
+    std::optional<size_t> touchedPosition;
+    TouchableWindowIndex::Candidates candidates = index.getCandidates(x, y);
+    while (std::optional<size_t> position = candidates.next()) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[*position];
         if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
             continue;
         }
         const InputWindowInfo* windowInfo = windowHandle->getInfo();
-        if (windowInfo->displayId == displayId) {
-            auto flags = windowInfo->flags;
-
-            if (windowInfo->visible) {
-                if (!flags.test(InputWindowInfo::Flag::NOT_TOUCHABLE)) {
-                    bool isTouchModal = !flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
-                            !flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
-                    if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
-                        int32_t portalToDisplayId = windowInfo->portalToDisplayId;
-                        if (portalToDisplayId != ADISPLAY_ID_NONE &&
-                            portalToDisplayId != displayId) {
-                            if (addPortalWindows) {
-                                // For the monitoring channels of the display.
-                                touchState->addPortalWindow(windowHandle);
-                            }
-                            return findTouchedWindowAtLocked(portalToDisplayId, x, y, touchState,
-                                                             addOutsideTargets, addPortalWindows);
-                        }
-                        // Found window.
-                        return windowHandle;
-                    }
-                }
+        if (windowInfo->displayId == displayId && windowInfo->visible &&
+            !windowInfo->flags.test(InputWindowInfo::Flag::NOT_TOUCHABLE)) {
+            bool isTouchModal = !windowInfo->flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
+                    !windowInfo->flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+            if (isTouchModal || windowInfo->touchableRegionContainsPoint(x, y)) {
+                touchedPosition = position;
+                break;
+            }
+        }
+    }
 
-                if (addOutsideTargets && flags.test(InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH)) {
-                    touchState->addOrUpdateWindow(windowHandle,
-                                                  InputTarget::FLAG_DISPATCH_AS_OUTSIDE,
-                                                  BitSet32(0));
-                }
+    // The touch is outside of the watching windows in front of the touched one.
+    if (addOutsideTargets) {
+        for (size_t position : index.getOutsideTouchWatchers()) {
+            if (touchedPosition && position >= *touchedPosition) {
+                break;
+            }
+            const sp<InputWindowHandle>& windowHandle = windowHandles[position];
+            if (ignoreDragWindow && haveSameToken(windowHandle, mDragState->dragWindow)) {
+                continue;
+            }
+            if (windowHandle->getInfo()->displayId == displayId) {
+                touchState->addOrUpdateWindow(windowHandle, InputTarget::FLAG_DISPATCH_AS_OUTSIDE,
+                                              BitSet32(0));
             }
         }
     }
-    return nullptr;
+
+    if (!touchedPosition) {
+        return nullptr;
+    }
+    const sp<InputWindowHandle>& windowHandle = windowHandles[*touchedPosition];
+    int32_t portalToDisplayId = windowHandle->getInfo()->portalToDisplayId;
+    if (portalToDisplayId != ADISPLAY_ID_NONE && portalToDisplayId != displayId) {
+        if (addPortalWindows) {
+            // For the monitoring channels of the display.
+            touchState->addPortalWindow(windowHandle);
+        }
+        return findTouchedWindowAtLocked(portalToDisplayId, x, y, touchState, addOutsideTargets,
+                                         addPortalWindows);
+    }
+    // Found window.
+    return windowHandle;
 }
 
 std::vector<TouchedMonitor> InputDispatcher::findTouchedGestureMonitorsLocked(
@@ -1844,8 +1938,11 @@ InputEventInjectionResult InputDispatcher::findFocusedWindowTargetsLocked(
         }
     }
 
-    // we have a valid, non-null focused window
-    resetNoFocusedWindowTimeoutLocked();
+    // we have a valid, non-null focused window, but the timer may be for an event of another
+    // display, which is still waiting
+    if (!mNoFocusedWindowTimeoutTime.has_value() || displayId == mAwaitedApplicationDisplayId) {
+        resetNoFocusedWindowTimeoutLocked();
+    }
 
     // Check permissions.
     if (!checkInjectionPermission(focusedWindowHandle, entry.injectionState)) {
@@ -2801,7 +2898,7 @@ void InputDispatcher::prepareDispatchCycleLocked(nsecs_t currentTime,
 
         const MotionEntry& originalMotionEntry = static_cast<const MotionEntry&>(*eventEntry);
         if (inputTarget.pointerIds.count() != originalMotionEntry.pointerCount) {
-            std::unique_ptr<MotionEntry> splitMotionEntry =
+            std::shared_ptr<MotionEntry> splitMotionEntry =
                     splitMotionEvent(originalMotionEntry, inputTarget.pointerIds);
             if (!splitMotionEntry) {
                 return; // split event was dropped
@@ -3094,126 +3191,42 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
     ALOGD("channel '%s' ~ startDispatchCycle", connection->getInputChannelName().c_str());
 #endif
 
+    // Publish the outbound events a few at a time, so that each batch goes out in one system
+    // call. How many are sent at once is bounded, as the socket buffer only fits a few dozen
+    // events anyway.
     while (connection->status == Connection::STATUS_NORMAL && !connection->outboundQueue.empty()) {
-        DispatchEntry* dispatchEntry = connection->outboundQueue.front();
-        dispatchEntry->deliveryTime = currentTime;
-        const std::chrono::nanoseconds timeout =
-                getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
-        dispatchEntry->timeoutTime = currentTime + timeout.count();
-
-        // Publish the event.
-        status_t status;
-        const EventEntry& eventEntry = *(dispatchEntry->eventEntry);
-        switch (eventEntry.type) {
-            case EventEntry::Type::KEY: {
-                const KeyEntry& keyEntry = static_cast<const KeyEntry&>(eventEntry);
-                std::array<uint8_t, 32> hmac = getSignature(keyEntry, *dispatchEntry);
-
-                // Publish the key event.
-                status = connection->inputPublisher
-                                 .publishKeyEvent(dispatchEntry->seq,
-                                                  dispatchEntry->resolvedEventId, keyEntry.deviceId,
-                                                  keyEntry.source, keyEntry.displayId,
-                                                  std::move(hmac), dispatchEntry->resolvedAction,
-                                                  dispatchEntry->resolvedFlags, keyEntry.keyCode,
-                                                  keyEntry.scanCode, keyEntry.metaState,
-                                                  keyEntry.repeatCount, keyEntry.downTime,
-                                                  keyEntry.eventTime);
-                break;
-            }
-
-            case EventEntry::Type::MOTION: {
-                const MotionEntry& motionEntry = static_cast<const MotionEntry&>(eventEntry);
-
-                PointerCoords scaledCoords[MAX_POINTERS];
-                const PointerCoords* usingCoords = motionEntry.pointerCoords;
-
-                // Set the X and Y offset and X and Y scale depending on the input source.
-                if ((motionEntry.source & AINPUT_SOURCE_CLASS_POINTER) &&
-                    !(dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
-                    float globalScaleFactor = dispatchEntry->globalScaleFactor;
-                    if (globalScaleFactor != 1.0f) {
-                        for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
-                            scaledCoords[i] = motionEntry.pointerCoords[i];
-                            // Don't apply window scale here since we don't want scale to affect raw
-                            // coordinates. The scale will be sent back to the client and applied
-                            // later when requesting relative coordinates.
-                            scaledCoords[i].scale(globalScaleFactor, 1 /* windowXScale */,
-                                                  1 /* windowYScale */);
-                        }
-                        usingCoords = scaledCoords;
-                    }
-                } else {
-                    // We don't want the dispatch target to know.
-                    if (dispatchEntry->targetFlags & InputTarget::FLAG_ZERO_COORDS) {
-                        for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
-                            scaledCoords[i].clear();
-                        }
-                        usingCoords = scaledCoords;
-                    }
-                }
-
-                std::array<uint8_t, 32> hmac = getSignature(motionEntry, *dispatchEntry);
-
-                // Publish the motion event.
-                status = connection->inputPublisher
-                                 .publishMotionEvent(dispatchEntry->seq,
-                                                     dispatchEntry->resolvedEventId,
-                                                     motionEntry.deviceId, motionEntry.source,
-                                                     motionEntry.displayId, std::move(hmac),
-                                                     dispatchEntry->resolvedAction,
-                                                     motionEntry.actionButton,
-                                                     dispatchEntry->resolvedFlags,
-                                                     motionEntry.edgeFlags, motionEntry.metaState,
-                                                     motionEntry.buttonState,
-                                                     motionEntry.classification,
-                                                     dispatchEntry->transform,
-                                                     motionEntry.xPrecision, motionEntry.yPrecision,
-                                                     motionEntry.xCursorPosition,
-                                                     motionEntry.yCursorPosition,
-                                                     dispatchEntry->displaySize.x,
-                                                     dispatchEntry->displaySize.y,
-                                                     motionEntry.downTime, motionEntry.eventTime,
-                                                     motionEntry.pointerCount,
-                                                     motionEntry.pointerProperties, usingCoords);
-                break;
-            }
-
-            case EventEntry::Type::FOCUS: {
-                const FocusEntry& focusEntry = static_cast<const FocusEntry&>(eventEntry);
-                status = connection->inputPublisher.publishFocusEvent(dispatchEntry->seq,
-                                                                      focusEntry.id,
-                                                                      focusEntry.hasFocus,
-                                                                      mInTouchMode);
-                break;
-            }
-
-            case EventEntry::Type::POINTER_CAPTURE_CHANGED: {
-                const auto& captureEntry =
-                        static_cast<const PointerCaptureChangedEntry&>(eventEntry);
-                status = connection->inputPublisher
-                                 .publishCaptureEvent(dispatchEntry->seq, captureEntry.id,
-                                                      captureEntry.pointerCaptureRequest.enable);
-                break;
-            }
-
-            case EventEntry::Type::DRAG: {
-                const DragEntry& dragEntry = static_cast<const DragEntry&>(eventEntry);
-                status = connection->inputPublisher.publishDragEvent(dispatchEntry->seq,
-                                                                     dragEntry.id, dragEntry.x,
-                                                                     dragEntry.y,
-                                                                     dragEntry.isExiting);
+        connection->inputPublisher.deferEvents();
+        status_t status = OK;
+        for (size_t i = 0; i < connection->outboundQueue.size() && i < MAX_DEFERRED_EVENTS; i++) {
+            DispatchEntry* dispatchEntry = connection->outboundQueue[i];
+            dispatchEntry->deliveryTime = currentTime;
+            const std::chrono::nanoseconds timeout =
+                    getDispatchingTimeoutLocked(connection->inputChannel->getConnectionToken());
+            dispatchEntry->timeoutTime = currentTime + timeout.count();
+
+            status = publishDispatchEntryLocked(connection, *dispatchEntry);
+            if (status) {
                 break;
             }
+        }
+        size_t sentCount = 0;
+        status_t sendStatus = connection->inputPublisher.sendDeferredEvents(&sentCount);
+        if (!status) {
+            status = sendStatus;
+        }
 
-            case EventEntry::Type::CONFIGURATION_CHANGED:
-            case EventEntry::Type::DEVICE_RESET:
-            case EventEntry::Type::SENSOR: {
-                LOG_ALWAYS_FATAL("Should never start dispatch cycles for %s events",
-                                 NamedEnum::string(eventEntry.type).c_str());
-                return;
+        // Re-enqueue the events that were sent on the wait queue.
+        for (size_t i = 0; i < sentCount; i++) {
+            DispatchEntry* dispatchEntry = connection->outboundQueue.front();
+            connection->outboundQueue.pop_front();
+            connection->waitQueue.push_back(dispatchEntry);
+            if (connection->responsive) {
+                mAnrTracker.insert(dispatchEntry->timeoutTime,
+                                   connection->inputChannel->getConnectionToken());
             }
         }
+        traceOutboundQueueLength(*connection);
+        traceWaitQueueLength(*connection);
 
         // Check the result.
         if (status) {
@@ -3244,21 +3257,142 @@ void InputDispatcher::startDispatchCycleLocked(nsecs_t currentTime,
             }
             return;
         }
+    }
+}
 
-        // Re-enqueue the event on the wait queue.
-        connection->outboundQueue.erase(std::remove(connection->outboundQueue.begin(),
-                                                    connection->outboundQueue.end(),
-                                                    dispatchEntry));
-        traceOutboundQueueLength(*connection);
-        connection->waitQueue.push_back(dispatchEntry);
-        if (connection->responsive) {
-            mAnrTracker.insert(dispatchEntry->timeoutTime,
-                               connection->inputChannel->getConnectionToken());
+status_t InputDispatcher::publishDispatchEntryLocked(const sp<Connection>& connection,
+                                                     const DispatchEntry& dispatchEntry) {
+    const EventEntry& eventEntry = *(dispatchEntry.eventEntry);
+    switch (eventEntry.type) {
+        case EventEntry::Type::KEY: {
+            const KeyEntry& keyEntry = static_cast<const KeyEntry&>(eventEntry);
+            std::array<uint8_t, 32> hmac = getSignature(keyEntry, dispatchEntry);
+
+            // Publish the key event.
+            return connection->inputPublisher
+                    .publishKeyEvent(dispatchEntry.seq, dispatchEntry.resolvedEventId,
+                                     keyEntry.deviceId, keyEntry.source, keyEntry.displayId,
+                                     std::move(hmac), dispatchEntry.resolvedAction,
+                                     dispatchEntry.resolvedFlags, keyEntry.keyCode,
+                                     keyEntry.scanCode, keyEntry.metaState, keyEntry.repeatCount,
+                                     keyEntry.downTime, keyEntry.eventTime);
+        }
+
+        case EventEntry::Type::MOTION: {
+            const MotionEntry& motionEntry = static_cast<const MotionEntry&>(eventEntry);
+            if (connection->monitor && mSharedMonitorMessage.matches(dispatchEntry)) {
+                return connection->inputPublisher
+                        .publishMessageCopy(dispatchEntry.seq, mSharedMonitorMessage.message);
+            }
+
+            PointerCoords scaledCoords[MAX_POINTERS];
+            const PointerCoords* usingCoords = motionEntry.pointerCoords;
+
+            // Set the X and Y offset and X and Y scale depending on the input source.
+            if ((motionEntry.source & AINPUT_SOURCE_CLASS_POINTER) &&
+                !(dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS)) {
+                float globalScaleFactor = dispatchEntry.globalScaleFactor;
+                if (globalScaleFactor != 1.0f) {
+                    for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
+                        scaledCoords[i] = motionEntry.pointerCoords[i];
+                        // Don't apply window scale here since we don't want scale to affect raw
+                        // coordinates. The scale will be sent back to the client and applied
+                        // later when requesting relative coordinates.
+                        scaledCoords[i].scale(globalScaleFactor, 1 /* windowXScale */,
+                                              1 /* windowYScale */);
+                    }
+                    usingCoords = scaledCoords;
+                }
+            } else {
+                // We don't want the dispatch target to know.
+                if (dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS) {
+                    for (uint32_t i = 0; i < motionEntry.pointerCount; i++) {
+                        scaledCoords[i].clear();
+                    }
+                    usingCoords = scaledCoords;
+                }
+            }
+
+            std::array<uint8_t, 32> hmac = getSignature(motionEntry, dispatchEntry);
+
+            // Publish the motion event.
+            status_t status = connection->inputPublisher
+                    .publishMotionEvent(dispatchEntry.seq, dispatchEntry.resolvedEventId,
+                                        motionEntry.deviceId, motionEntry.source,
+                                        motionEntry.displayId, std::move(hmac),
+                                        dispatchEntry.resolvedAction, motionEntry.actionButton,
+                                        dispatchEntry.resolvedFlags, motionEntry.edgeFlags,
+                                        motionEntry.metaState, motionEntry.buttonState,
+                                        motionEntry.classification, dispatchEntry.transform,
+                                        motionEntry.xPrecision, motionEntry.yPrecision,
+                                        motionEntry.xCursorPosition, motionEntry.yCursorPosition,
+                                        dispatchEntry.displaySize.x, dispatchEntry.displaySize.y,
+                                        motionEntry.downTime, motionEntry.eventTime,
+                                        motionEntry.pointerCount, motionEntry.pointerProperties,
+                                        usingCoords);
+            const InputMessage* message = connection->inputPublisher.getLastDeferredMessage();
+            if (connection->monitor && status == OK && message != nullptr) {
+                mSharedMonitorMessage.set(dispatchEntry, *message);
+            }
+            return status;
+        }
+
+        case EventEntry::Type::FOCUS: {
+            const FocusEntry& focusEntry = static_cast<const FocusEntry&>(eventEntry);
+            return connection->inputPublisher.publishFocusEvent(dispatchEntry.seq, focusEntry.id,
+                                                                focusEntry.hasFocus,
+                                                                mInTouchMode);
+        }
+
+        case EventEntry::Type::POINTER_CAPTURE_CHANGED: {
+            const auto& captureEntry =
+                    static_cast<const PointerCaptureChangedEntry&>(eventEntry);
+            return connection->inputPublisher
+                    .publishCaptureEvent(dispatchEntry.seq, captureEntry.id,
+                                         captureEntry.pointerCaptureRequest.enable);
+        }
+
+        case EventEntry::Type::DRAG: {
+            const DragEntry& dragEntry = static_cast<const DragEntry&>(eventEntry);
+            return connection->inputPublisher.publishDragEvent(dispatchEntry.seq, dragEntry.id,
+                                                               dragEntry.x, dragEntry.y,
+                                                               dragEntry.isExiting);
+        }
+
+        case EventEntry::Type::CONFIGURATION_CHANGED:
+        case EventEntry::Type::DEVICE_RESET:
+        case EventEntry::Type::SENSOR: {
+            LOG_ALWAYS_FATAL("Should never start dispatch cycles for %s events",
+                             NamedEnum::string(eventEntry.type).c_str());
+            return INVALID_OPERATION;
         }
-        traceWaitQueueLength(*connection);
     }
 }
 
+bool InputDispatcher::SharedMonitorMessage::matches(const DispatchEntry& dispatchEntry) const {
+    return eventEntry == dispatchEntry.eventEntry &&
+            resolvedEventId == dispatchEntry.resolvedEventId &&
+            resolvedAction == dispatchEntry.resolvedAction &&
+            resolvedFlags == dispatchEntry.resolvedFlags &&
+            zeroCoordsFlag == (dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS) &&
+            transform == dispatchEntry.transform &&
+            globalScaleFactor == dispatchEntry.globalScaleFactor &&
+            displaySize == dispatchEntry.displaySize;
+}
+
+void InputDispatcher::SharedMonitorMessage::set(const DispatchEntry& dispatchEntry,
+                                                const InputMessage& msg) {
+    eventEntry = dispatchEntry.eventEntry;
+    resolvedEventId = dispatchEntry.resolvedEventId;
+    resolvedAction = dispatchEntry.resolvedAction;
+    resolvedFlags = dispatchEntry.resolvedFlags;
+    zeroCoordsFlag = dispatchEntry.targetFlags & InputTarget::FLAG_ZERO_COORDS;
+    transform = dispatchEntry.transform;
+    globalScaleFactor = dispatchEntry.globalScaleFactor;
+    displaySize = dispatchEntry.displaySize;
+    message = msg;
+}
+
 std::array<uint8_t, 32> InputDispatcher::sign(const VerifiedInputEvent& event) const {
     size_t size;
     switch (event.type) {
@@ -3393,7 +3527,7 @@ int InputDispatcher::handleReceiveCallback(int events, sp<IBinder> connectionTok
                 if (shouldReportMetricsForConnection(*connection)) {
                     const InputPublisher::Timeline& timeline =
                             std::get<InputPublisher::Timeline>(*result);
-                    mLatencyTracker
+                    mLatencyRecorder
                             .trackGraphicsLatency(timeline.inputEventId,
                                                   connection->inputChannel->getConnectionToken(),
                                                   std::move(timeline.graphicsTimeline));
@@ -3592,7 +3726,7 @@ void InputDispatcher::synthesizePointerDownEventsForConnectionLocked(
     startDispatchCycleLocked(currentTime, connection);
 }
 
-std::unique_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
+std::shared_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
         const MotionEntry& originalMotionEntry, BitSet32 pointerIds) {
     ALOG_ASSERT(pointerIds.value != 0);
 
@@ -3668,22 +3802,22 @@ std::unique_ptr<MotionEntry> InputDispatcher::splitMotionEvent(
                                            originalMotionEntry.id, newId);
         ATRACE_NAME(message.c_str());
     }
-    std::unique_ptr<MotionEntry> splitMotionEntry =
-            std::make_unique<MotionEntry>(newId, originalMotionEntry.eventTime,
-                                          originalMotionEntry.deviceId, originalMotionEntry.source,
-                                          originalMotionEntry.displayId,
-                                          originalMotionEntry.policyFlags, action,
-                                          originalMotionEntry.actionButton,
-                                          originalMotionEntry.flags, originalMotionEntry.metaState,
-                                          originalMotionEntry.buttonState,
-                                          originalMotionEntry.classification,
-                                          originalMotionEntry.edgeFlags,
-                                          originalMotionEntry.xPrecision,
-                                          originalMotionEntry.yPrecision,
-                                          originalMotionEntry.xCursorPosition,
-                                          originalMotionEntry.yCursorPosition,
-                                          originalMotionEntry.downTime, splitPointerCount,
-                                          splitPointerProperties, splitPointerCoords, 0, 0);
+    std::shared_ptr<MotionEntry> splitMotionEntry =
+            makePooledEntry<MotionEntry>(newId, originalMotionEntry.eventTime,
+                                         originalMotionEntry.deviceId, originalMotionEntry.source,
+                                         originalMotionEntry.displayId,
+                                         originalMotionEntry.policyFlags, action,
+                                         originalMotionEntry.actionButton,
+                                         originalMotionEntry.flags, originalMotionEntry.metaState,
+                                         originalMotionEntry.buttonState,
+                                         originalMotionEntry.classification,
+                                         originalMotionEntry.edgeFlags,
+                                         originalMotionEntry.xPrecision,
+                                         originalMotionEntry.yPrecision,
+                                         originalMotionEntry.xCursorPosition,
+                                         originalMotionEntry.yCursorPosition,
+                                         originalMotionEntry.downTime, splitPointerCount,
+                                         splitPointerProperties, splitPointerCoords, 0, 0);
 
     if (originalMotionEntry.injectionState) {
         splitMotionEntry->injectionState = originalMotionEntry.injectionState;
@@ -3808,11 +3942,11 @@ void InputDispatcher::notifyKey(const NotifyKeyArgs* args) {
             mLock.lock();
         }
 
-        std::unique_ptr<KeyEntry> newEntry =
-                std::make_unique<KeyEntry>(args->id, args->eventTime, args->deviceId, args->source,
-                                           args->displayId, policyFlags, args->action, flags,
-                                           keyCode, args->scanCode, metaState, repeatCount,
-                                           args->downTime);
+        std::shared_ptr<KeyEntry> newEntry =
+                makePooledEntry<KeyEntry>(args->id, args->eventTime, args->deviceId, args->source,
+                                          args->displayId, policyFlags, args->action, flags,
+                                          keyCode, args->scanCode, metaState, repeatCount,
+                                          args->downTime);
 
         needWake = enqueueInboundEventLocked(std::move(newEntry));
         mLock.unlock();
@@ -3895,17 +4029,29 @@ void InputDispatcher::notifyMotion(const NotifyMotionArgs* args) {
             mLock.lock();
         }
 
+        if (coalesceCapturedMotionLocked(*args, policyFlags)) {
+            mLock.unlock();
+            return;
+        }
+
         // Just enqueue a new motion event.
-        std::unique_ptr<MotionEntry> newEntry =
-                std::make_unique<MotionEntry>(args->id, args->eventTime, args->deviceId,
-                                              args->source, args->displayId, policyFlags,
-                                              args->action, args->actionButton, args->flags,
-                                              args->metaState, args->buttonState,
-                                              args->classification, args->edgeFlags,
-                                              args->xPrecision, args->yPrecision,
-                                              args->xCursorPosition, args->yCursorPosition,
-                                              args->downTime, args->pointerCount,
-                                              args->pointerProperties, args->pointerCoords, 0, 0);
+        std::shared_ptr<MotionEntry> newEntry =
+                makePooledEntry<MotionEntry>(args->id, args->eventTime, args->deviceId,
+                                             args->source, args->displayId, policyFlags,
+                                             args->action, args->actionButton, args->flags,
+                                             args->metaState, args->buttonState,
+                                             args->classification, args->edgeFlags,
+                                             args->xPrecision, args->yPrecision,
+                                             args->xCursorPosition, args->yCursorPosition,
+                                             args->downTime, args->pointerCount,
+                                             args->pointerProperties, args->pointerCoords, 0, 0);
+
+        if (args->id != android::os::IInputConstants::INVALID_INPUT_EVENT_ID &&
+            IdGenerator::getSource(args->id) == IdGenerator::Source::INPUT_READER &&
+            !mInputFilterEnabled) {
+            const bool isDown = args->action == AMOTION_EVENT_ACTION_DOWN;
+            mLatencyRecorder.trackListener(args->id, isDown, args->eventTime, args->readTime);
+        }
 
         needWake = enqueueInboundEventLocked(std::move(newEntry));
         mLock.unlock();
@@ -4335,6 +4481,13 @@ const std::vector<sp<InputWindowHandle>>& InputDispatcher::getWindowHandlesLocke
     return it != mWindowHandlesByDisplay.end() ? it->second : EMPTY_WINDOW_HANDLES;
 }
 
+const TouchableWindowIndex& InputDispatcher::getTouchableWindowIndexLocked(
+        int32_t displayId) const {
+    static const TouchableWindowIndex EMPTY_INDEX;
+    auto it = mTouchableWindowIndexByDisplay.find(displayId);
+    return it != mTouchableWindowIndexByDisplay.end() ? it->second : EMPTY_INDEX;
+}
+
 sp<InputWindowHandle> InputDispatcher::getWindowHandleLocked(
         const sp<IBinder>& windowHandleToken) const {
     if (windowHandleToken == nullptr) {
@@ -4428,6 +4581,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     if (inputWindowHandles.empty()) {
         // Remove all handles on a display if there are no windows left.
         mWindowHandlesByDisplay.erase(displayId);
+        mTouchableWindowIndexByDisplay.erase(displayId);
         return;
     }
 
@@ -4477,6 +4631,7 @@ void InputDispatcher::updateWindowHandlesForDisplayLocked(
     }
 
     // Insert or replace
+    mTouchableWindowIndexByDisplay[displayId] = TouchableWindowIndex(newHandles);
     mWindowHandlesByDisplay[displayId] = newHandles;
 }
 
@@ -4485,22 +4640,85 @@ void InputDispatcher::setInputWindows(
     { // acquire lock
         std::scoped_lock _l(mLock);
         for (const auto& [displayId, handles] : handlesPerDisplay) {
-            setInputWindowsLocked(handles, displayId);
+            setInputWindowsLocked(handles, displayId, /*focusMayChange*/ true);
+        }
+    }
+    // Wake up poll loop since it may need to make new input dispatching choices.
+    mLooper->wake();
+}
+
+void InputDispatcher::updateInputWindows(
+        const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>& handlesPerDisplay,
+        const std::unordered_map<int32_t, Flags<InputWindowInfo::Change>>& changesPerDisplay) {
+    { // acquire lock
+        std::scoped_lock _l(mLock);
+        for (const auto& [displayId, handles] : handlesPerDisplay) {
+            const auto changesIt = changesPerDisplay.find(displayId);
+            const bool stateChanged = changesIt == changesPerDisplay.end() ||
+                    changesIt->second.test(InputWindowInfo::Change::STATE);
+            const bool focusMayChange = changesIt == changesPerDisplay.end() ||
+                    changesIt->second.test(InputWindowInfo::Change::FOCUS);
+            if (stateChanged || !updateWindowGeometryLocked(handles, displayId)) {
+                setInputWindowsLocked(handles, displayId, focusMayChange);
+            }
         }
     }
     // Wake up poll loop since it may need to make new input dispatching choices.
     mLooper->wake();
 }
 
+/**
+ * Update the windows of a display in place when only their geometry changed. Focus, touch and
+ * drag state only depend on which windows there are and on their state, so they are kept.
+ * Returns false if the windows are not the current ones, in the same order, in which case they
+ * need to go through setInputWindowsLocked.
+ */
+bool InputDispatcher::updateWindowGeometryLocked(
+        const std::vector<sp<InputWindowHandle>>& inputWindowHandles, int32_t displayId) {
+    auto it = mWindowHandlesByDisplay.find(displayId);
+    if (it == mWindowHandlesByDisplay.end() || it->second.size() != inputWindowHandles.size()) {
+        return false;
+    }
+    std::vector<sp<InputWindowHandle>>& windowHandles = it->second;
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        if (!inputWindowHandles[i]->updateInfo() ||
+            windowHandles[i]->getId() != inputWindowHandles[i]->getId() ||
+            windowHandles[i]->getToken() != inputWindowHandles[i]->getToken()) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const sp<InputWindowHandle>& windowHandle = windowHandles[i];
+        const uint32_t oldOrientation = windowHandle->getInfo()->transform.getOrientation();
+        windowHandle->updateFrom(inputWindowHandles[i]);
+        if (isPerWindowInputRotationEnabled() &&
+            windowHandle->getInfo()->transform.getOrientation() != oldOrientation) {
+            std::shared_ptr<InputChannel> inputChannel =
+                    getInputChannelLocked(windowHandle->getToken());
+            if (inputChannel != nullptr) {
+                CancelationOptions options(CancelationOptions::CANCEL_POINTER_EVENTS,
+                                           "touched window's orientation changed");
+                synthesizeCancelationEventsForInputChannelLocked(inputChannel, options);
+            }
+        }
+    }
+    mTouchableWindowIndexByDisplay[displayId] = TouchableWindowIndex(windowHandles);
+    return true;
+}
+
 /**
  * Called from InputManagerService, update window handle list by displayId that can receive input.
  * A window handle contains information about InputChannel, Touch Region, Types, Focused,...
  * If set an empty list, remove all handles from the specific display.
  * For focused handle, check if need to change and send a cancel event to previous one.
  * For removed handle, check if need to send a cancel event if already in touch.
+ * Focus is only resolved again if focusMayChange is set, as the focusability of a window token
+ * only depends on the tokens, visibility and focusability of the windows.
  */
 void InputDispatcher::setInputWindowsLocked(
-        const std::vector<sp<InputWindowHandle>>& inputWindowHandles, int32_t displayId) {
+        const std::vector<sp<InputWindowHandle>>& inputWindowHandles, int32_t displayId,
+        bool focusMayChange) {
     if (DEBUG_FOCUS) {
         std::string windowList;
         for (const sp<InputWindowHandle>& iwh : inputWindowHandles) {
@@ -4539,10 +4757,12 @@ void InputDispatcher::setInputWindowsLocked(
         mLastHoverWindowHandle = nullptr;
     }
 
-    std::optional<FocusResolver::FocusChanges> changes =
-            mFocusResolver.setInputWindows(displayId, windowHandles);
-    if (changes) {
-        onFocusChangedLocked(*changes);
+    if (focusMayChange) {
+        std::optional<FocusResolver::FocusChanges> changes =
+                mFocusResolver.setInputWindows(displayId, windowHandles);
+        if (changes) {
+            onFocusChangedLocked(*changes);
+        }
     }
 
     std::unordered_map<int32_t, TouchState>::iterator stateIt =
@@ -5176,7 +5396,7 @@ void InputDispatcher::dumpDispatchStateLocked(std::string& dump) {
     dump += StringPrintf(INDENT2 "KeyRepeatDelay: %" PRId64 "ms\n", ns2ms(mConfig.keyRepeatDelay));
     dump += StringPrintf(INDENT2 "KeyRepeatTimeout: %" PRId64 "ms\n",
                          ns2ms(mConfig.keyRepeatTimeout));
-    dump += mLatencyTracker.dump(INDENT2);
+    dump += mLatencyRecorder.dump(INDENT2);
     dump += mLatencyAggregator.dump(INDENT2);
 }
 
@@ -5753,10 +5973,13 @@ void InputDispatcher::doDispatchCycleFinishedLockedInterruptible(CommandEntry* c
               ns2ms(eventDuration), dispatchEntry->eventEntry->getDescription().c_str());
     }
     if (shouldReportFinishedEvent(*dispatchEntry, *connection)) {
-        mLatencyTracker.trackFinishedEvent(dispatchEntry->eventEntry->id,
-                                           connection->inputChannel->getConnectionToken(),
-                                           dispatchEntry->deliveryTime, commandEntry->consumeTime,
-                                           finishTime);
+        const sp<IBinder> connectionToken = connection->inputChannel->getConnectionToken();
+        const sp<InputWindowHandle> windowHandle = getWindowHandleLocked(connectionToken);
+        const int32_t uid = windowHandle != nullptr ? windowHandle->getInfo()->ownerUid
+                                                    : ConnectionTimeline::NO_UID;
+        mLatencyRecorder.trackFinishedEvent(dispatchEntry->eventEntry->id, connectionToken, uid,
+                                            dispatchEntry->deliveryTime, commandEntry->consumeTime,
+                                            finishTime);
     }
 
     bool restartEvent;
@@ -6234,7 +6457,7 @@ void InputDispatcher::displayRemoved(int32_t displayId) {
     { // acquire lock
         std::scoped_lock _l(mLock);
         // Set an empty list to remove all handles from the specific display.
-        setInputWindowsLocked(/* window handles */ {}, displayId);
+        setInputWindowsLocked(/* window handles */ {}, displayId, /*focusMayChange*/ true);
         setFocusedApplicationLocked(displayId, nullptr);
         // Call focus resolver to clean up stale requests. This must be called after input windows
         // have been removed for the removed display.
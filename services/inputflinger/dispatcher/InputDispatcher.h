@@ -30,9 +30,10 @@
 #include "InputTarget.h"
 #include "InputThread.h"
 #include "LatencyAggregator.h"
-#include "LatencyTracker.h"
+#include "LatencyRecorder.h"
 #include "Monitor.h"
 #include "TouchState.h"
+#include "TouchableWindowIndex.h"
 #include "TouchedWindow.h"
 
 #include <attestation/HmacKeyManager.h>
@@ -111,6 +112,11 @@ public:
 
     void setInputWindows(const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>&
                                  handlesPerDisplay) override;
+    void updateInputWindows(
+            const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>&
+                    handlesPerDisplay,
+            const std::unordered_map<int32_t, Flags<InputWindowInfo::Change>>& changesPerDisplay)
+            override;
     void setFocusedApplication(
             int32_t displayId,
             const std::shared_ptr<InputApplicationHandle>& inputApplicationHandle) override;
@@ -180,8 +186,13 @@ private:
 
     void dispatchOnceInnerLocked(nsecs_t* nextWakeupTime) REQUIRES(mLock);
 
+    // Finds the inbound event to dispatch next. This is the oldest one, unless it is waiting for
+    // its display to get a focused window, in which case the oldest event of another display that
+    // can be dispatched ahead of it is returned, if there is one.
+    std::deque<std::shared_ptr<EventEntry>>::iterator findNextInboundEventLocked() REQUIRES(mLock);
+
     // Enqueues an inbound event.  Returns true if mLooper->wake() should be called.
-    bool enqueueInboundEventLocked(std::unique_ptr<EventEntry> entry) REQUIRES(mLock);
+    bool enqueueInboundEventLocked(std::shared_ptr<EventEntry> entry) REQUIRES(mLock);
 
     // Cleans up input state when dropping an inbound event.
     void dropInboundEventLocked(const EventEntry& entry, DropReason dropReason) REQUIRES(mLock);
@@ -316,11 +327,18 @@ private:
 
     std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>> mWindowHandlesByDisplay
             GUARDED_BY(mLock);
+    // Hit-testing index of the windows in mWindowHandlesByDisplay, rebuilt along with them.
+    std::unordered_map<int32_t, TouchableWindowIndex> mTouchableWindowIndexByDisplay
+            GUARDED_BY(mLock);
     void setInputWindowsLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
-                               int32_t displayId) REQUIRES(mLock);
+                               int32_t displayId, bool focusMayChange) REQUIRES(mLock);
+    bool updateWindowGeometryLocked(const std::vector<sp<InputWindowHandle>>& inputWindowHandles,
+                                    int32_t displayId) REQUIRES(mLock);
     // Get a reference to window handles by display, return an empty vector if not found.
     const std::vector<sp<InputWindowHandle>>& getWindowHandlesLocked(int32_t displayId) const
             REQUIRES(mLock);
+    const TouchableWindowIndex& getTouchableWindowIndexLocked(int32_t displayId) const
+            REQUIRES(mLock);
     sp<InputWindowHandle> getWindowHandleLocked(const sp<IBinder>& windowHandleToken) const
             REQUIRES(mLock);
 
@@ -416,6 +434,11 @@ private:
 
     bool shouldPruneInboundQueueLocked(const MotionEntry& motionEntry) REQUIRES(mLock);
 
+    // Adds a captured relative move to the last event of the inbound queue when it is a move of
+    // the same device that has not been dispatched yet. Returns true if the move was added to it.
+    bool coalesceCapturedMotionLocked(const NotifyMotionArgs& args, uint32_t policyFlags)
+            REQUIRES(mLock);
+
     /**
      * Time to stop waiting for the events to be processed while trying to dispatch a key.
      * When this time expires, we just send the pending key event to the currently focused window,
@@ -545,6 +568,27 @@ private:
             REQUIRES(mLock);
     void startDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection)
             REQUIRES(mLock);
+    status_t publishDispatchEntryLocked(const sp<Connection>& connection,
+                                        const DispatchEntry& dispatchEntry) REQUIRES(mLock);
+
+    // The last motion message published to a monitor. The monitors of a display all get their
+    // events the same way, so the next monitors are sent copies of it, rather than building and
+    // signing the same message again for each of them.
+    struct SharedMonitorMessage {
+        std::shared_ptr<EventEntry> eventEntry;
+        int32_t resolvedEventId;
+        int32_t resolvedAction;
+        int32_t resolvedFlags;
+        int32_t zeroCoordsFlag;
+        ui::Transform transform;
+        float globalScaleFactor;
+        int2 displaySize;
+        InputMessage message;
+
+        bool matches(const DispatchEntry& dispatchEntry) const;
+        void set(const DispatchEntry& dispatchEntry, const InputMessage& msg);
+    };
+    SharedMonitorMessage mSharedMonitorMessage GUARDED_BY(mLock);
     void finishDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
                                    uint32_t seq, bool handled, nsecs_t consumeTime) REQUIRES(mLock);
     void abortBrokenDispatchCycleLocked(nsecs_t currentTime, const sp<Connection>& connection,
@@ -574,7 +618,7 @@ private:
             REQUIRES(mLock);
 
     // Splitting motion events across windows.
-    std::unique_ptr<MotionEntry> splitMotionEvent(const MotionEntry& originalMotionEntry,
+    std::shared_ptr<MotionEntry> splitMotionEvent(const MotionEntry& originalMotionEntry,
                                                   BitSet32 pointerIds);
 
     // Reset and drop everything the dispatcher is doing.
@@ -643,9 +687,10 @@ private:
     void doPokeUserActivityLockedInterruptible(CommandEntry* commandEntry) REQUIRES(mLock);
     void doOnPointerDownOutsideFocusLockedInterruptible(CommandEntry* commandEntry) REQUIRES(mLock);
 
-    // Statistics gathering.
-    LatencyAggregator mLatencyAggregator GUARDED_BY(mLock);
-    LatencyTracker mLatencyTracker GUARDED_BY(mLock);
+    // Statistics gathering. Both are thread-safe, and the recorder must be destroyed first as its
+    // thread reports to the aggregator.
+    LatencyAggregator mLatencyAggregator;
+    LatencyRecorder mLatencyRecorder;
     void traceInboundQueueLengthLocked() REQUIRES(mLock);
     void traceOutboundQueueLength(const Connection& connection);
     void traceWaitQueueLength(const Connection& connection);
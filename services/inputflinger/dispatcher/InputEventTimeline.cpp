@@ -32,6 +32,10 @@ bool ConnectionTimeline::isComplete() const {
     return mHasDispatchTimeline && mHasGraphicsTimeline;
 }
 
+bool ConnectionTimeline::hasDispatchTimeline() const {
+    return mHasDispatchTimeline;
+}
+
 bool ConnectionTimeline::setDispatchTimeline(nsecs_t inDeliveryTime, nsecs_t inConsumeTime,
                                              nsecs_t inFinishTime) {
     if (mHasDispatchTimeline) {
@@ -55,7 +59,8 @@ bool ConnectionTimeline::setGraphicsTimeline(std::array<nsecs_t, GraphicsTimelin
 
 bool ConnectionTimeline::operator==(const ConnectionTimeline& rhs) const {
     return deliveryTime == rhs.deliveryTime && consumeTime == rhs.consumeTime &&
-            finishTime == rhs.finishTime && graphicsTimeline == rhs.graphicsTimeline &&
+            finishTime == rhs.finishTime && uid == rhs.uid &&
+            graphicsTimeline == rhs.graphicsTimeline &&
             mHasDispatchTimeline == rhs.mHasDispatchTimeline &&
             mHasGraphicsTimeline == rhs.mHasGraphicsTimeline;
 }
@@ -38,10 +38,14 @@ namespace inputdispatcher {
  * graphics timeline is available.
  */
 struct ConnectionTimeline {
+    // Uid of connections that are not owned by a window, such as monitors.
+    static constexpr int32_t NO_UID = -1;
+
     // DispatchTimeline
     nsecs_t deliveryTime; // time at which the event was sent to the receiver
     nsecs_t consumeTime;  // time at which the receiver read the event
     nsecs_t finishTime;   // time at which the finish event was received
+    int32_t uid = NO_UID; // uid of the app that owns the receiving window
     // GraphicsTimeline
     std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
 
@@ -52,6 +56,10 @@ struct ConnectionTimeline {
      * True if all contained timestamps are valid, false otherwise.
      */
     bool isComplete() const;
+    /**
+     * True if the dispatching-related times have been set.
+     */
+    bool hasDispatchTimeline() const;
     /**
      * Set the dispatching-related times. Return true if the operation succeeded, false if the
      * dispatching times have already been set. If this function returns false, it likely indicates
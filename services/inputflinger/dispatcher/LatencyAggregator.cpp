@@ -18,6 +18,7 @@
 #include "LatencyAggregator.h"
 
 #include <inttypes.h>
+#include <cmath>
 
 #include <android-base/stringprintf.h>
 #include <input/Input.h>
@@ -42,6 +43,13 @@ static inline int64_t ns2hus(nsecs_t nanos) {
 // The value here has been determined empirically.
 static constexpr size_t MAX_EVENTS_FOR_STATISTICS = 20000;
 
+// The maximum number of apps that latency histograms are kept for. It bounds the memory used when
+// many short-lived apps receive input.
+static constexpr size_t MAX_TRACKED_APPS = 64;
+
+static const char* APP_STAGE_NAMES[] = {"eventToDeliver", "eventToConsume", "eventToFinish",
+                                        "eventToPresent"};
+
 // Category (=namespace) name for the input settings that are applied at boot time
 static const char* INPUT_NATIVE_BOOT = "input_native_boot";
 // Feature flag name for the threshold of end-to-end touch latency that would trigger
@@ -95,15 +103,43 @@ private:
     std::vector<char> mBuffer;
 };
 
+void LatencyHistogram::add(nsecs_t latency) {
+    // Bucket i holds the latencies up to 2^i ms, and the last one the ones beyond.
+    size_t bucket = 0;
+    for (nsecs_t bound = ms2ns(1); latency > bound && bucket < BUCKET_COUNT - 1; bound *= 2) {
+        bucket++;
+    }
+    mBuckets[bucket]++;
+    mCount++;
+}
+
+nsecs_t LatencyHistogram::getPercentile(float fraction) const {
+    if (mCount == 0) {
+        return 0;
+    }
+    const size_t rank = static_cast<size_t>(std::ceil(fraction * mCount));
+    size_t seen = 0;
+    nsecs_t bound = ms2ns(1);
+    for (size_t i = 0; i < BUCKET_COUNT - 1; i++, bound *= 2) {
+        seen += mBuckets[i];
+        if (seen >= rank) {
+            return bound;
+        }
+    }
+    // The latencies beyond the last bound are reported as twice that bound.
+    return bound;
+}
+
 LatencyAggregator::LatencyAggregator() {
-    AStatsManager_setPullAtomCallback(android::util::INPUT_EVENT_LATENCY_SKETCH, nullptr,
-                                      LatencyAggregator::pullAtomCallback, this);
     dist_proc::aggregation::KllQuantileOptions options;
     options.set_inv_eps(100); // Request precision of 1.0%, instead of default 0.1%
     for (size_t i = 0; i < SketchIndex::SIZE; i++) {
         mDownSketches[i] = KllQuantile::Create(options);
         mMoveSketches[i] = KllQuantile::Create(options);
     }
+    // The sketches must exist before they can be pulled.
+    AStatsManager_setPullAtomCallback(android::util::INPUT_EVENT_LATENCY_SKETCH, nullptr,
+                                      LatencyAggregator::pullAtomCallback, this);
 }
 
 LatencyAggregator::~LatencyAggregator() {
@@ -121,8 +157,40 @@ AStatsManager_PullAtomCallbackReturn LatencyAggregator::pullAtomCallback(int32_t
 }
 
 void LatencyAggregator::processTimeline(const InputEventTimeline& timeline) {
+    std::scoped_lock _l(mLock);
     processStatistics(timeline);
     processSlowEvent(timeline);
+    processAppLatency(timeline);
+}
+
+void LatencyAggregator::processAppLatency(const InputEventTimeline& timeline) {
+    for (const auto& [connectionToken, connectionTimeline] : timeline.connectionTimelines) {
+        if (connectionTimeline.uid == ConnectionTimeline::NO_UID ||
+            !connectionTimeline.hasDispatchTimeline()) {
+            continue;
+        }
+        auto it = mAppLatencies.find(connectionTimeline.uid);
+        if (it == mAppLatencies.end()) {
+            if (mAppLatencies.size() >= MAX_TRACKED_APPS) {
+                mNumUntrackedAppEvents++;
+                continue;
+            }
+            it = mAppLatencies.try_emplace(connectionTimeline.uid).first;
+        }
+        std::array<LatencyHistogram, AppStageIndex::STAGE_COUNT>& histograms = it->second;
+        histograms[AppStageIndex::EVENT_TO_DELIVER].add(connectionTimeline.deliveryTime -
+                                                        timeline.eventTime);
+        histograms[AppStageIndex::EVENT_TO_CONSUME].add(connectionTimeline.consumeTime -
+                                                        timeline.eventTime);
+        histograms[AppStageIndex::EVENT_TO_FINISH].add(connectionTimeline.finishTime -
+                                                       timeline.eventTime);
+        // Only apps that report their graphics timeline have a present time.
+        if (connectionTimeline.isComplete()) {
+            histograms[AppStageIndex::EVENT_TO_PRESENT].add(
+                    connectionTimeline.graphicsTimeline[GraphicsTimeline::PRESENT_TIME] -
+                    timeline.eventTime);
+        }
+    }
 }
 
 void LatencyAggregator::processStatistics(const InputEventTimeline& timeline) {
@@ -167,6 +235,7 @@ void LatencyAggregator::processStatistics(const InputEventTimeline& timeline) {
 }
 
 AStatsManager_PullAtomCallbackReturn LatencyAggregator::pullData(AStatsEventList* data) {
+    std::scoped_lock _l(mLock);
     std::array<std::unique_ptr<SafeBytesField>, SketchIndex::SIZE> serializedDownData;
     std::array<std::unique_ptr<SafeBytesField>, SketchIndex::SIZE> serializedMoveData;
     for (size_t i = 0; i < SketchIndex::SIZE; i++) {
@@ -257,6 +326,7 @@ void LatencyAggregator::processSlowEvent(const InputEventTimeline& timeline) {
 }
 
 std::string LatencyAggregator::dump(const char* prefix) {
+    std::scoped_lock _l(mLock);
     std::string sketchDump = StringPrintf("%s  Sketches:\n", prefix);
     for (size_t i = 0; i < SketchIndex::SIZE; i++) {
         const int64_t numDown = mDownSketches[i]->num_values();
@@ -276,7 +346,29 @@ std::string LatencyAggregator::dump(const char* prefix) {
             StringPrintf("%s  mLastSlowEventTime=%" PRId64 "\n", prefix, mLastSlowEventTime) +
             StringPrintf("%s  mNumEventsSinceLastSlowEventReport = %zu\n", prefix,
                          mNumEventsSinceLastSlowEventReport) +
-            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents);
+            StringPrintf("%s  mNumSkippedSlowEvents = %zu\n", prefix, mNumSkippedSlowEvents) +
+            dumpAppLatency(prefix);
+}
+
+std::string LatencyAggregator::dumpAppLatency(const char* prefix) {
+    std::string dump = StringPrintf("%s  App latency (p50/p90/p99 in ms, by uid):\n", prefix);
+    for (const auto& [uid, histograms] : mAppLatencies) {
+        dump += StringPrintf("%s    uid=%" PRId32 ": events=%zu", prefix, uid,
+                             histograms[AppStageIndex::EVENT_TO_DELIVER].getCount());
+        for (size_t i = 0; i < AppStageIndex::STAGE_COUNT; i++) {
+            const LatencyHistogram& histogram = histograms[i];
+            if (histogram.getCount() == 0) {
+                continue;
+            }
+            dump += StringPrintf(" %s=%" PRId64 "/%" PRId64 "/%" PRId64, APP_STAGE_NAMES[i],
+                                 ns2ms(histogram.getPercentile(0.5)),
+                                 ns2ms(histogram.getPercentile(0.9)),
+                                 ns2ms(histogram.getPercentile(0.99)));
+        }
+        dump += "\n";
+    }
+    return dump + StringPrintf("%s    mNumUntrackedAppEvents = %zu\n", prefix,
+                               mNumUntrackedAppEvents);
 }
 
 } // namespace android::inputdispatcher
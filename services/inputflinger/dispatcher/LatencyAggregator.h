@@ -17,10 +17,15 @@
 #ifndef _UI_INPUT_INPUTDISPATCHER_LATENCYAGGREGATOR_H
 #define _UI_INPUT_INPUTDISPATCHER_LATENCYAGGREGATOR_H
 
+#include <android-base/thread_annotations.h>
 #include <kll.h>
 #include <statslog.h>
 #include <utils/Timers.h>
 
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
 #include "InputEventTimeline.h"
 
 namespace android::inputdispatcher {
@@ -36,6 +41,33 @@ enum SketchIndex : size_t {
     SIZE = 7,       // Must be last
 };
 
+// Latencies that are kept for each app, from the time of the event to each stage of its handling
+// by the app.
+enum AppStageIndex : size_t {
+    EVENT_TO_DELIVER = 0,
+    EVENT_TO_CONSUME = 1,
+    EVENT_TO_FINISH = 2,
+    EVENT_TO_PRESENT = 3,
+    STAGE_COUNT = 4, // Must be last
+};
+
+/**
+ * Histogram of latencies, with buckets whose bounds double from 1 ms to about 1 s. Percentiles are
+ * estimated by the upper bound of the bucket they fall into.
+ */
+class LatencyHistogram {
+public:
+    void add(nsecs_t latency);
+    size_t getCount() const { return mCount; }
+    // Latency below which the given fraction of the samples are, or 0 if there are no samples.
+    nsecs_t getPercentile(float fraction) const;
+
+private:
+    static constexpr size_t BUCKET_COUNT = 12;
+    std::array<size_t, BUCKET_COUNT> mBuckets{};
+    size_t mCount = 0;
+};
+
 // Let's create a full timeline here:
 // eventTime
 // readTime
@@ -47,7 +79,10 @@ enum SketchIndex : size_t {
 // GraphicsTimeline::PRESENT_TIME
 
 /**
- * Keep sketches of the provided events and report slow events
+ * Keep sketches of the provided events and report slow events.
+ *
+ * The timelines are processed on the thread of the LatencyRecorder, while the sketches are pulled
+ * on a binder thread and dumped on the dispatcher thread, so the state is guarded by a lock.
  */
 class LatencyAggregator final : public InputEventTimelineProcessor {
 public:
@@ -66,23 +101,34 @@ private:
                                                                  AStatsEventList* data,
                                                                  void* cookie);
     AStatsManager_PullAtomCallbackReturn pullData(AStatsEventList* data);
+    std::mutex mLock;
     // ---------- Slow event handling ----------
-    void processSlowEvent(const InputEventTimeline& timeline);
-    nsecs_t mLastSlowEventTime = 0;
+    void processSlowEvent(const InputEventTimeline& timeline) REQUIRES(mLock);
+    nsecs_t mLastSlowEventTime GUARDED_BY(mLock) = 0;
     // How many slow events have been skipped due to rate limiting
-    size_t mNumSkippedSlowEvents = 0;
+    size_t mNumSkippedSlowEvents GUARDED_BY(mLock) = 0;
     // How many events have been received since the last time we reported a slow event
-    size_t mNumEventsSinceLastSlowEventReport = 0;
+    size_t mNumEventsSinceLastSlowEventReport GUARDED_BY(mLock) = 0;
 
     // ---------- Statistics handling ----------
-    void processStatistics(const InputEventTimeline& timeline);
+    void processStatistics(const InputEventTimeline& timeline) REQUIRES(mLock);
     // Sketches
     std::array<std::unique_ptr<dist_proc::aggregation::KllQuantile>, SketchIndex::SIZE>
-            mDownSketches;
+            mDownSketches GUARDED_BY(mLock);
     std::array<std::unique_ptr<dist_proc::aggregation::KllQuantile>, SketchIndex::SIZE>
-            mMoveSketches;
+            mMoveSketches GUARDED_BY(mLock);
     // How many events have been processed so far
-    size_t mNumSketchEventsProcessed = 0;
+    size_t mNumSketchEventsProcessed GUARDED_BY(mLock) = 0;
+
+    // ---------- Per-app latency handling ----------
+    void processAppLatency(const InputEventTimeline& timeline) REQUIRES(mLock);
+    std::string dumpAppLatency(const char* prefix) REQUIRES(mLock);
+    // Histograms of the latency that each app adds, keyed by uid. Unlike the sketches, they are
+    // not reset when they are pulled, so that the dump covers the whole life of the dispatcher.
+    std::unordered_map<int32_t /*uid*/, std::array<LatencyHistogram, AppStageIndex::STAGE_COUNT>>
+            mAppLatencies GUARDED_BY(mLock);
+    // Events that went to apps beyond the first MAX_TRACKED_APPS ones
+    size_t mNumUntrackedAppEvents GUARDED_BY(mLock) = 0;
 };
 
 } // namespace android::inputdispatcher
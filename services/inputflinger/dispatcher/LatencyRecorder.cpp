@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "LatencyRecorder"
+#include "LatencyRecorder.h"
+
+#include <android-base/stringprintf.h>
+
+using android::base::StringPrintf;
+
+namespace android::inputdispatcher {
+
+LatencyRecorder::LatencyRecorder(InputEventTimelineProcessor* processor) : mTracker(processor) {
+    mPendingRecords.reserve(MAX_PENDING_RECORDS);
+    mProcessingRecords.reserve(MAX_PENDING_RECORDS);
+    mThread = std::make_unique<InputThread>(
+            "LatencyRecorder", [this]() { processRecords(); },
+            [this]() {
+                std::scoped_lock _l(mLock);
+                mExiting = true;
+                mRecordsAvailable.notify_all();
+            });
+}
+
+LatencyRecorder::~LatencyRecorder() {
+    mThread.reset();
+}
+
+void LatencyRecorder::trackListener(int32_t inputEventId, bool isDown, nsecs_t eventTime,
+                                    nsecs_t readTime) {
+    record(Listener{inputEventId, isDown, eventTime, readTime});
+}
+
+void LatencyRecorder::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken,
+                                         int32_t uid, nsecs_t deliveryTime, nsecs_t consumeTime,
+                                         nsecs_t finishTime) {
+    record(FinishedEvent{inputEventId, connectionToken, uid, deliveryTime, consumeTime,
+                         finishTime});
+}
+
+void LatencyRecorder::trackGraphicsLatency(int32_t inputEventId,
+                                           const sp<IBinder>& connectionToken,
+                                           std::array<nsecs_t, GraphicsTimeline::SIZE> timeline) {
+    record(GraphicsLatency{inputEventId, connectionToken, std::move(timeline)});
+}
+
+void LatencyRecorder::record(Record&& newRecord) {
+    bool wasEmpty;
+    {
+        std::scoped_lock _l(mLock);
+        if (mPendingRecords.size() >= MAX_PENDING_RECORDS) {
+            mDroppedRecordCount++;
+            return;
+        }
+        wasEmpty = mPendingRecords.empty();
+        mPendingRecords.push_back(std::move(newRecord));
+    }
+    // The thread only waits once it has processed every record, so it is already awake unless
+    // this is the first record it has to process.
+    if (wasEmpty) {
+        mRecordsAvailable.notify_one();
+    }
+}
+
+void LatencyRecorder::processRecords() {
+    {
+        std::unique_lock<std::mutex> lock(mLock);
+        base::ScopedLockAssertion assumeLocked(mLock);
+        mRecordsAvailable.wait(lock, [this]() REQUIRES(mLock) {
+            return !mPendingRecords.empty() || mExiting;
+        });
+        std::swap(mPendingRecords, mProcessingRecords);
+    }
+
+    std::scoped_lock _l(mTrackerLock);
+    for (Record& record : mProcessingRecords) {
+        if (const Listener* listener = std::get_if<Listener>(&record)) {
+            mTracker.trackListener(listener->inputEventId, listener->isDown, listener->eventTime,
+                                   listener->readTime);
+        } else if (const FinishedEvent* finished = std::get_if<FinishedEvent>(&record)) {
+            mTracker.trackFinishedEvent(finished->inputEventId, finished->connectionToken,
+                                        finished->uid, finished->deliveryTime,
+                                        finished->consumeTime, finished->finishTime);
+        } else {
+            GraphicsLatency& graphics = std::get<GraphicsLatency>(record);
+            mTracker.trackGraphicsLatency(graphics.inputEventId, graphics.connectionToken,
+                                          std::move(graphics.timeline));
+        }
+    }
+    mProcessingRecords.clear();
+}
+
+std::string LatencyRecorder::dump(const char* prefix) {
+    std::string dump;
+    {
+        std::scoped_lock _l(mLock);
+        dump += StringPrintf("%sLatencyRecorder:\n", prefix);
+        dump += StringPrintf("%s  mPendingRecords.size() = %zu\n", prefix, mPendingRecords.size());
+        dump += StringPrintf("%s  mDroppedRecordCount = %zu\n", prefix, mDroppedRecordCount);
+    }
+    std::scoped_lock _l(mTrackerLock);
+    return dump + mTracker.dump(prefix);
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _UI_INPUT_INPUTDISPATCHER_LATENCYRECORDER_H
+#define _UI_INPUT_INPUTDISPATCHER_LATENCYRECORDER_H
+
+#include <android-base/thread_annotations.h>
+#include <condition_variable>
+#include <mutex>
+#include <variant>
+#include <vector>
+
+#include "InputThread.h"
+#include "LatencyTracker.h"
+
+namespace android::inputdispatcher {
+
+/**
+ * Records the latency information that the dispatcher learns about its events, and hands it over
+ * to a LatencyTracker on a thread of its own. The dispatcher thread only pays for queueing the
+ * information, while looking up the timelines, reporting the mature ones and adding them to the
+ * sketches happens on the other thread.
+ *
+ * Recording is thread-safe. Should the tracking thread fall behind by more than
+ * MAX_PENDING_RECORDS, the records that do not fit are dropped rather than queued.
+ */
+class LatencyRecorder {
+public:
+    LatencyRecorder(InputEventTimelineProcessor* processor);
+    ~LatencyRecorder();
+
+    void trackListener(int32_t inputEventId, bool isDown, nsecs_t eventTime, nsecs_t readTime);
+    void trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken, int32_t uid,
+                            nsecs_t deliveryTime, nsecs_t consumeTime, nsecs_t finishTime);
+    void trackGraphicsLatency(int32_t inputEventId, const sp<IBinder>& connectionToken,
+                              std::array<nsecs_t, GraphicsTimeline::SIZE> timeline);
+
+    std::string dump(const char* prefix);
+
+private:
+    static constexpr size_t MAX_PENDING_RECORDS = 2048;
+
+    struct Listener {
+        int32_t inputEventId;
+        bool isDown;
+        nsecs_t eventTime;
+        nsecs_t readTime;
+    };
+
+    struct FinishedEvent {
+        int32_t inputEventId;
+        sp<IBinder> connectionToken;
+        int32_t uid;
+        nsecs_t deliveryTime;
+        nsecs_t consumeTime;
+        nsecs_t finishTime;
+    };
+
+    struct GraphicsLatency {
+        int32_t inputEventId;
+        sp<IBinder> connectionToken;
+        std::array<nsecs_t, GraphicsTimeline::SIZE> timeline;
+    };
+
+    using Record = std::variant<Listener, FinishedEvent, GraphicsLatency>;
+
+    void record(Record&& newRecord);
+    void processRecords();
+
+    std::mutex mLock;
+    std::condition_variable mRecordsAvailable;
+    std::vector<Record> mPendingRecords GUARDED_BY(mLock);
+    size_t mDroppedRecordCount GUARDED_BY(mLock) = 0;
+    bool mExiting GUARDED_BY(mLock) = false;
+
+    // The records being processed. They are swapped with the pending ones, so that neither
+    // vector has to grow again once both have reached their usual size.
+    std::vector<Record> mProcessingRecords;
+
+    std::mutex mTrackerLock;
+    LatencyTracker mTracker GUARDED_BY(mTrackerLock);
+
+    // Must be last, so that the thread is stopped before the state it uses is destroyed.
+    std::unique_ptr<InputThread> mThread;
+};
+
+} // namespace android::inputdispatcher
+
+#endif // _UI_INPUT_INPUTDISPATCHER_LATENCYRECORDER_H
@@ -86,7 +86,7 @@ void LatencyTracker::trackListener(int32_t inputEventId, bool isDown, nsecs_t ev
 }
 
 void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken,
-                                        nsecs_t deliveryTime, nsecs_t consumeTime,
+                                        int32_t uid, nsecs_t deliveryTime, nsecs_t consumeTime,
                                         nsecs_t finishTime) {
     const auto it = mTimelines.find(inputEventId);
     if (it == mTimelines.end()) {
@@ -99,9 +99,11 @@ void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>&
     const auto connectionIt = timeline.connectionTimelines.find(connectionToken);
     if (connectionIt == timeline.connectionTimelines.end()) {
         // Most likely case: app calls 'finishInputEvent' before it reports the graphics timeline
-        timeline.connectionTimelines.emplace(connectionToken,
-                                             ConnectionTimeline{deliveryTime, consumeTime,
-                                                                finishTime});
+        auto [newIt, _] =
+                timeline.connectionTimelines.emplace(connectionToken,
+                                                     ConnectionTimeline{deliveryTime, consumeTime,
+                                                                        finishTime});
+        newIt->second.uid = uid;
     } else {
         // Already have a record for this connectionToken
         ConnectionTimeline& connectionTimeline = connectionIt->second;
@@ -111,7 +113,9 @@ void LatencyTracker::trackFinishedEvent(int32_t inputEventId, const sp<IBinder>&
             // We are receiving unreliable data from the app. Just delete the entire connection
             // timeline for this event
             timeline.connectionTimelines.erase(connectionIt);
+            return;
         }
+        connectionTimeline.uid = uid;
     }
 }
 
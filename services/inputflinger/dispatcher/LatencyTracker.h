@@ -45,7 +45,7 @@ public:
      * Start keeping track of an event identified by inputEventId. This must be called first.
      */
     void trackListener(int32_t inputEventId, bool isDown, nsecs_t eventTime, nsecs_t readTime);
-    void trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken,
+    void trackFinishedEvent(int32_t inputEventId, const sp<IBinder>& connectionToken, int32_t uid,
                             nsecs_t deliveryTime, nsecs_t consumeTime, nsecs_t finishTime);
     void trackGraphicsLatency(int32_t inputEventId, const sp<IBinder>& connectionToken,
                               std::array<nsecs_t, GraphicsTimeline::SIZE> timeline);
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "TouchableWindowIndex"
+#define ATRACE_TAG ATRACE_TAG_INPUT
+
+#include <algorithm>
+#include <utility>
+
+#include <utils/Trace.h>
+
+#include "TouchableWindowIndex.h"
+
+namespace android::inputdispatcher {
+
+TouchableWindowIndex::TouchableWindowIndex(
+        const std::vector<sp<InputWindowHandle>>& windowHandles) {
+    ATRACE_CALL();
+    std::vector<std::pair<size_t, Rect>> touchableBounds;
+    for (size_t i = 0; i < windowHandles.size(); i++) {
+        const InputWindowInfo* info = windowHandles[i]->getInfo();
+        if (!info->visible) {
+            continue;
+        }
+        if (info->flags.test(InputWindowInfo::Flag::WATCH_OUTSIDE_TOUCH)) {
+            mOutsideTouchWatchers.push_back(i);
+        }
+        if (info->flags.test(InputWindowInfo::Flag::NOT_TOUCHABLE)) {
+            continue;
+        }
+        const bool isTouchModal = !info->flags.test(InputWindowInfo::Flag::NOT_FOCUSABLE) &&
+                !info->flags.test(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+        if (isTouchModal) {
+            mTouchModalWindows.push_back(i);
+            continue;
+        }
+        const Rect bounds = info->touchableRegion.getBounds();
+        if (!bounds.isEmpty()) {
+            touchableBounds.emplace_back(i, bounds);
+        }
+    }
+    if (touchableBounds.empty()) {
+        return;
+    }
+
+    int32_t right = touchableBounds.front().second.right;
+    int32_t bottom = touchableBounds.front().second.bottom;
+    mLeft = touchableBounds.front().second.left;
+    mTop = touchableBounds.front().second.top;
+    for (const auto& [_, bounds] : touchableBounds) {
+        mLeft = std::min(mLeft, bounds.left);
+        mTop = std::min(mTop, bounds.top);
+        right = std::max(right, bounds.right);
+        bottom = std::max(bottom, bounds.bottom);
+    }
+    const int64_t width = int64_t(right) - mLeft;
+    const int64_t height = int64_t(bottom) - mTop;
+    mCellWidth = (width + kGridSize - 1) / kGridSize;
+    mCellHeight = (height + kGridSize - 1) / kGridSize;
+    mColumns = static_cast<int32_t>((width + mCellWidth - 1) / mCellWidth);
+    mRows = static_cast<int32_t>((height + mCellHeight - 1) / mCellHeight);
+    mCells.resize(mColumns * mRows);
+
+    // The windows are added front to back, which keeps each cell sorted.
+    for (const auto& [position, bounds] : touchableBounds) {
+        const int32_t firstColumn =
+                static_cast<int32_t>((int64_t(bounds.left) - mLeft) / mCellWidth);
+        const int32_t lastColumn =
+                static_cast<int32_t>((int64_t(bounds.right) - 1 - mLeft) / mCellWidth);
+        const int32_t firstRow = static_cast<int32_t>((int64_t(bounds.top) - mTop) / mCellHeight);
+        const int32_t lastRow =
+                static_cast<int32_t>((int64_t(bounds.bottom) - 1 - mTop) / mCellHeight);
+        for (int32_t row = firstRow; row <= lastRow; row++) {
+            for (int32_t column = firstColumn; column <= lastColumn; column++) {
+                mCells[row * mColumns + column].push_back(position);
+            }
+        }
+    }
+}
+
+TouchableWindowIndex::Candidates TouchableWindowIndex::getCandidates(int32_t x, int32_t y) const {
+    return Candidates(getCell(x, y), mTouchModalWindows);
+}
+
+TouchableWindowIndex::Candidates::Candidates(const std::vector<size_t>& cell,
+                                             const std::vector<size_t>& touchModalWindows)
+      : mCellIt(cell.begin()),
+        mCellEnd(cell.end()),
+        mTouchModalIt(touchModalWindows.begin()),
+        mTouchModalEnd(touchModalWindows.end()) {}
+
+std::optional<size_t> TouchableWindowIndex::Candidates::next() {
+    // Both lists are sorted front to back, so merge them.
+    if (mCellIt == mCellEnd && mTouchModalIt == mTouchModalEnd) {
+        return std::nullopt;
+    }
+    if (mTouchModalIt == mTouchModalEnd || (mCellIt != mCellEnd && *mCellIt < *mTouchModalIt)) {
+        return *mCellIt++;
+    }
+    return *mTouchModalIt++;
+}
+
+const std::vector<size_t>& TouchableWindowIndex::getCell(int32_t x, int32_t y) const {
+    static const std::vector<size_t> EMPTY_CELL;
+    if (x < mLeft || y < mTop) {
+        return EMPTY_CELL;
+    }
+    const int64_t column = (int64_t(x) - mLeft) / mCellWidth;
+    const int64_t row = (int64_t(y) - mTop) / mCellHeight;
+    if (column >= mColumns || row >= mRows) {
+        return EMPTY_CELL;
+    }
+    return mCells[row * mColumns + column];
+}
+
+} // namespace android::inputdispatcher
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <optional>
+#include <vector>
+
+#include <input/InputWindow.h>
+
+namespace android::inputdispatcher {
+
+// Spatial index of the windows of a display that can be touched, so that hit-testing a point only
+// looks at the windows whose touchable region may contain it, rather than at every window.
+//
+// The touchable regions are bucketed by their bounds into a grid spanning all of them. Windows
+// are referred to by their position in the list they were indexed from, front to back, and are
+// always visited in that order. Touch modal windows take every touch, so they are candidates at
+// any point. The index is rebuilt whenever the windows of the display are updated.
+class TouchableWindowIndex {
+public:
+    TouchableWindowIndex() = default;
+    // The windows are given front to back, as InputDispatcher keeps them.
+    explicit TouchableWindowIndex(const std::vector<sp<InputWindowHandle>>& windowHandles);
+
+    // Positions of the windows that may be touched at a point, front to back: the visible
+    // touchable windows whose touchable region bounds contain the point, and the touch modal ones.
+    // Whether the region itself contains the point is left to the caller.
+    class Candidates {
+    public:
+        std::optional<size_t> next();
+
+    private:
+        friend class TouchableWindowIndex;
+        Candidates(const std::vector<size_t>& cell, const std::vector<size_t>& touchModalWindows);
+
+        std::vector<size_t>::const_iterator mCellIt;
+        const std::vector<size_t>::const_iterator mCellEnd;
+        std::vector<size_t>::const_iterator mTouchModalIt;
+        const std::vector<size_t>::const_iterator mTouchModalEnd;
+    };
+    // The index must outlive the returned candidates.
+    Candidates getCandidates(int32_t x, int32_t y) const;
+
+    // Positions of the visible windows that watch for touches outside of them, front to back.
+    const std::vector<size_t>& getOutsideTouchWatchers() const { return mOutsideTouchWatchers; }
+
+private:
+    // Cells per side of the grid, which is enough to split a display into areas about the size of
+    // a small window.
+    static constexpr int32_t kGridSize = 16;
+
+    const std::vector<size_t>& getCell(int32_t x, int32_t y) const;
+
+    std::vector<size_t> mTouchModalWindows;
+    std::vector<size_t> mOutsideTouchWatchers;
+
+    // Area covered by the grid, which bounds every indexed touchable region.
+    int32_t mLeft = 0;
+    int32_t mTop = 0;
+    int64_t mCellWidth = 1;
+    int64_t mCellHeight = 1;
+    int32_t mColumns = 0;
+    int32_t mRows = 0;
+    // Positions of the windows whose touchable region bounds overlap each cell, front to back.
+    std::vector<std::vector<size_t>> mCells;
+};
+
+} // namespace android::inputdispatcher
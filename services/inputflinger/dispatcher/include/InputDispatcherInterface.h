@@ -94,6 +94,19 @@ public:
             const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>&
                     handlesPerDisplay) = 0;
 
+    /* Sets the list of input windows of the displays whose windows changed, as setInputWindows
+     * does, along with the groups of fields that changed across each display's windows. Displays
+     * whose windows only changed their geometry are updated in place. Displays that are not
+     * listed keep their windows.
+     *
+     * This method may be called on any thread (usually by the input manager).
+     */
+    virtual void updateInputWindows(
+            const std::unordered_map<int32_t, std::vector<sp<InputWindowHandle>>>&
+                    handlesPerDisplay,
+            const std::unordered_map<int32_t, Flags<InputWindowInfo::Change>>&
+                    changesPerDisplay) = 0;
+
     /* Sets the focused application on the given display.
      *
      * This method may be called on any thread (usually by the input manager).
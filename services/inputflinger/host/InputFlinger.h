@@ -48,6 +48,10 @@ public:
                                    const sp<ISetInputWindowsListener>&) override {
         return binder::Status::ok();
     }
+    binder::Status updateInputWindows(const InputWindowsDelta&,
+                                      const sp<ISetInputWindowsListener>&) override {
+        return binder::Status::ok();
+    }
     binder::Status createInputChannel(const std::string&, InputChannel*) override {
         return binder::Status::ok();
     }
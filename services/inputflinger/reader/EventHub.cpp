@@ -367,6 +367,9 @@ EventHub::Device::Device(int fd, int32_t id, const std::string& path,
         ffEffectId(-1),
         associatedDevice(nullptr),
         controllerNumber(0),
+        readCount(0),
+        readEventCount(0),
+        fullReadCount(0),
         enabled(true),
         isVirtual(fd < 0) {}
 
@@ -470,8 +473,8 @@ void EventHub::Device::loadConfigurationLocked() {
     if (configurationFile.empty()) {
         ALOGD("No input device configuration file found for device '%s'.", identifier.name.c_str());
     } else {
-        android::base::Result<std::unique_ptr<PropertyMap>> propertyMap =
-                PropertyMap::load(configurationFile.c_str());
+        android::base::Result<std::shared_ptr<const PropertyMap>> propertyMap =
+                PropertyMap::loadShared(configurationFile.c_str());
         if (!propertyMap.ok()) {
             ALOGE("Error loading input device configuration file for device '%s'.  "
                   "Using default configuration.",
@@ -1228,7 +1231,12 @@ bool EventHub::setKeyboardLayoutOverlay(int32_t deviceId, std::shared_ptr<KeyCha
     std::scoped_lock _l(mLock);
     Device* device = getDeviceLocked(deviceId);
     if (device != nullptr && map != nullptr && device->keyMap.keyCharacterMap != nullptr) {
-        device->keyMap.keyCharacterMap->combine(*map);
+        // The loaded key character map may be shared with other devices, so the overlay is
+        // combined into a copy of it.
+        std::shared_ptr<KeyCharacterMap> combinedMap =
+                std::make_shared<KeyCharacterMap>(*device->keyMap.keyCharacterMap);
+        combinedMap->combine(*map);
+        device->keyMap.keyCharacterMap = combinedMap;
         device->keyMap.keyCharacterMapFile = device->keyMap.keyCharacterMap->getLoadFileName();
         return true;
     }
@@ -1605,6 +1613,7 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
             if (eventItem.events & EPOLLIN) {
                 int32_t readSize =
                         read(device->fd, readBuffer, sizeof(struct input_event) * capacity);
+                device->readCount++;
                 if (readSize == 0 || (readSize < 0 && errno == ENODEV)) {
                     // Device was removed before INotify noticed.
                     ALOGW("could not get event, removed? (fd: %d size: %" PRId32
@@ -1620,12 +1629,15 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                     ALOGE("could not get event (wrong size: %d)", readSize);
                 } else {
                     int32_t deviceId = device->id == mBuiltInKeyboardId ? 0 : device->id;
+                    // The events were all read by the same call.
+                    const nsecs_t readTime = systemTime(SYSTEM_TIME_MONOTONIC);
 
                     size_t count = size_t(readSize) / sizeof(struct input_event);
+                    device->readEventCount += count;
                     for (size_t i = 0; i < count; i++) {
                         struct input_event& iev = readBuffer[i];
                         event->when = processEventTimestamp(iev);
-                        event->readTime = systemTime(SYSTEM_TIME_MONOTONIC);
+                        event->readTime = readTime;
                         event->deviceId = deviceId;
                         event->type = iev.type;
                         event->code = iev.code;
@@ -1637,6 +1649,7 @@ size_t EventHub::getEvents(int timeoutMillis, RawEvent* buffer, size_t bufferSiz
                         // The result buffer is full.  Reset the pending event index
                         // so we will try to read the device again on the next iteration.
                         mPendingEventIndex -= 1;
+                        device->fullReadCount++;
                         break;
                     }
                 }
@@ -2448,6 +2461,13 @@ void EventHub::dump(std::string& dump) {
                                  device->keyMap.keyCharacterMapFile.c_str());
             dump += StringPrintf(INDENT3 "ConfigurationFile: %s\n",
                                  device->configurationFile.c_str());
+            dump += StringPrintf(INDENT3 "Reads: count=%" PRIu64 ", events=%" PRIu64
+                                         ", eventsPerRead=%.1f, full=%" PRIu64 "\n",
+                                 device->readCount, device->readEventCount,
+                                 device->readCount != 0
+                                         ? double(device->readEventCount) / device->readCount
+                                         : 0.0,
+                                 device->fullReadCount);
             dump += INDENT3 "VideoDevice: ";
             if (device->videoDevice) {
                 dump += device->videoDevice->dump() + "\n";
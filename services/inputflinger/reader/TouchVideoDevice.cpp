@@ -201,10 +201,12 @@ std::optional<TouchVideoFrame> TouchVideoDevice::readFrame() {
         ALOGW("The timestamp %ld.%ld was not acquired using CLOCK_MONOTONIC", buf.timestamp.tv_sec,
               buf.timestamp.tv_usec);
     }
-    std::vector<int16_t> data(mHeight * mWidth);
+    // The buffer goes back to the driver right away, so the frame needs a copy of it. This is the
+    // only copy of the data until the frame is sent to the classifier HAL.
     const int16_t* readFrom = mReadLocations[buf.index];
-    std::copy(readFrom, readFrom + mHeight * mWidth, data.begin());
-    TouchVideoFrame frame(mHeight, mWidth, std::move(data), buf.timestamp);
+    TouchVideoFrame frame(mHeight, mWidth,
+                          std::vector<int16_t>(readFrom, readFrom + mHeight * mWidth),
+                          buf.timestamp);
 
     result = ioctl(mFd.get(), VIDIOC_QBUF, &buf);
     if (result == -1) {
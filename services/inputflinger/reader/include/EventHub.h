@@ -566,7 +566,7 @@ private:
         BitArray<MSC_MAX> mscBitmask;
 
         std::string configurationFile;
-        std::unique_ptr<PropertyMap> configuration;
+        std::shared_ptr<const PropertyMap> configuration;
         std::unique_ptr<VirtualKeyMap> virtualKeyMap;
         KeyMap keyMap;
 
@@ -579,6 +579,12 @@ private:
 
         int32_t controllerNumber;
 
+        // Number of reads of the device, of the events they returned, and of the reads that
+        // filled the caller's buffer and left events to read on the next call to getEvents().
+        uint64_t readCount;
+        uint64_t readEventCount;
+        uint64_t fullReadCount;
+
         Device(int fd, int32_t id, const std::string& path,
                const InputDeviceIdentifier& identifier);
         ~Device();
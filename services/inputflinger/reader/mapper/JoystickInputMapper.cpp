@@ -21,7 +21,12 @@
 namespace android {
 
 JoystickInputMapper::JoystickInputMapper(InputDeviceContext& deviceContext)
-      : InputMapper(deviceContext) {}
+      : InputMapper(deviceContext),
+        mParameters{},
+        mLastReportTime(0),
+        mHasPendingChanges(false),
+        mPendingWhen(0),
+        mPendingReadTime(0) {}
 
 JoystickInputMapper::~JoystickInputMapper() {}
 
@@ -71,6 +76,14 @@ int32_t JoystickInputMapper::getCompatAxis(int32_t axis) {
 void JoystickInputMapper::dump(std::string& dump) {
     dump += INDENT2 "Joystick Input Mapper:\n";
 
+    dump += INDENT3 "Parameters:\n";
+    dump += StringPrintf(INDENT4 "MinReportInterval: %0.3fms\n",
+                         mParameters.minReportInterval * 0.000001f);
+    dump += StringPrintf(INDENT4 "DeadZone: %0.5f\n", mParameters.deadZone);
+    if (mParameters.noiseFilter) {
+        dump += StringPrintf(INDENT4 "NoiseFilter: %0.5f\n", *mParameters.noiseFilter);
+    }
+
     dump += INDENT3 "Axes:\n";
     for (const auto& [rawAxis, axis] : mAxes) {
         const char* label = InputEventLookup::getAxisLabel(axis.axisInfo.axis);
@@ -109,6 +122,8 @@ void JoystickInputMapper::configure(nsecs_t when, const InputReaderConfiguration
     InputMapper::configure(when, config, changes);
 
     if (!changes) { // first time only
+        configureParameters();
+
         // Collect all axes.
         for (int32_t abs = 0; abs <= ABS_MAX; abs++) {
             if (!(getAbsAxisUsage(abs, getDeviceContext().getDeviceClasses())
@@ -128,7 +143,11 @@ void JoystickInputMapper::configure(nsecs_t when, const InputReaderConfiguration
                     axisInfo.mode = AxisInfo::MODE_NORMAL;
                     axisInfo.axis = -1;
                 }
-                mAxes.insert({abs, createAxis(axisInfo, rawAxisInfo, explicitlyMapped)});
+                Axis axis = createAxis(axisInfo, rawAxisInfo, explicitlyMapped);
+                if (mParameters.noiseFilter) {
+                    axis.filter = *mParameters.noiseFilter;
+                }
+                mAxes.insert({abs, axis});
             }
         }
 
@@ -167,6 +186,26 @@ void JoystickInputMapper::configure(nsecs_t when, const InputReaderConfiguration
     }
 }
 
+void JoystickInputMapper::configureParameters() {
+    const PropertyMap& config = getDeviceContext().getConfiguration();
+
+    mParameters.minReportInterval = 0;
+    int32_t maxReportRate;
+    if (config.tryGetProperty(String8("joystick.maxReportRate"), maxReportRate) &&
+        maxReportRate > 0) {
+        mParameters.minReportInterval = 1000000000LL / maxReportRate;
+    }
+
+    mParameters.deadZone = 0;
+    config.tryGetProperty(String8("joystick.deadZone"), mParameters.deadZone);
+
+    float noiseFilter;
+    mParameters.noiseFilter.reset();
+    if (config.tryGetProperty(String8("joystick.noiseFilter"), noiseFilter)) {
+        mParameters.noiseFilter = noiseFilter;
+    }
+}
+
 JoystickInputMapper::Axis JoystickInputMapper::createAxis(const AxisInfo& axisInfo,
                                                           const RawAbsoluteAxisInfo& rawAxisInfo,
                                                           bool explicitlyMapped) {
@@ -253,6 +292,7 @@ void JoystickInputMapper::reset(nsecs_t when) {
         Axis& axis = pair.second;
         axis.resetValue();
     }
+    mHasPendingChanges = false;
 
     InputMapper::reset(when);
 }
@@ -290,6 +330,12 @@ void JoystickInputMapper::process(const RawEvent* rawEvent) {
                         highNewValue = 0.0f;
                         break;
                 }
+                if (fabsf(newValue) < mParameters.deadZone) {
+                    newValue = 0.0f;
+                }
+                if (fabsf(highNewValue) < mParameters.deadZone) {
+                    highNewValue = 0.0f;
+                }
                 axis.newValue = newValue;
                 axis.highNewValue = highNewValue;
             }
@@ -306,11 +352,43 @@ void JoystickInputMapper::process(const RawEvent* rawEvent) {
     }
 }
 
+void JoystickInputMapper::timeoutExpired(nsecs_t when) {
+    if (!mHasPendingChanges) {
+        return;
+    }
+    const nsecs_t reportTime = mLastReportTime + mParameters.minReportInterval;
+    if (when < reportTime) {
+        // The timeout was for another mapper, which replaced the one requested here.
+        getContext()->requestTimeoutAtTime(reportTime);
+        return;
+    }
+    mLastReportTime = when;
+    notifyMotion(mPendingWhen, mPendingReadTime);
+}
+
 void JoystickInputMapper::sync(nsecs_t when, nsecs_t readTime, bool force) {
     if (!filterAxes(force)) {
         return;
     }
 
+    // Hold the changes until the report interval has elapsed. The reader wakes up to report them
+    // in time if no other changes come in by then.
+    if (!force && when < mLastReportTime + mParameters.minReportInterval) {
+        if (!mHasPendingChanges) {
+            getContext()->requestTimeoutAtTime(mLastReportTime + mParameters.minReportInterval);
+        }
+        mHasPendingChanges = true;
+        mPendingWhen = when;
+        mPendingReadTime = readTime;
+        return;
+    }
+    mLastReportTime = when;
+    notifyMotion(when, readTime);
+}
+
+void JoystickInputMapper::notifyMotion(nsecs_t when, nsecs_t readTime) {
+    mHasPendingChanges = false;
+
     int32_t metaState = getContext()->getGlobalMetaState();
     int32_t buttonState = 0;
 
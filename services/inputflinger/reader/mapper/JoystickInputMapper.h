@@ -33,8 +33,24 @@ public:
                            uint32_t changes) override;
     virtual void reset(nsecs_t when) override;
     virtual void process(const RawEvent* rawEvent) override;
+    virtual void timeoutExpired(nsecs_t when) override;
 
 private:
+    // Immutable configuration parameters.
+    struct Parameters {
+        // Shortest time between two reports. Gamepads can report at 1kHz, far more often than
+        // the display refreshes, so the changes within this time are coalesced into the next
+        // report, where the latest value of each axis wins. 0 reports every change.
+        nsecs_t minReportInterval;
+
+        // Normalized axis values nearer to 0 than this are reported as 0, so that a stick that
+        // does not quite return to its center rests at 0.
+        float deadZone;
+
+        // Overrides the size of the variations that are filtered out of all axes, when set.
+        std::optional<float> noiseFilter;
+    } mParameters;
+
     struct Axis {
         explicit Axis(const RawAbsoluteAxisInfo& rawAxisInfo, const AxisInfo& axisInfo,
                       bool explicitlyMapped, float scale, float offset, float highScale,
@@ -92,7 +108,16 @@ private:
     // Axes indexed by raw ABS_* axis index.
     std::unordered_map<int32_t, Axis> mAxes;
 
+    // Time of the last report, and of the changes that are waiting for the report interval to
+    // elapse since then.
+    nsecs_t mLastReportTime;
+    bool mHasPendingChanges;
+    nsecs_t mPendingWhen;
+    nsecs_t mPendingReadTime;
+
+    void configureParameters();
     void sync(nsecs_t when, nsecs_t readTime, bool force);
+    void notifyMotion(nsecs_t when, nsecs_t readTime);
 
     bool haveAxis(int32_t axisId);
     void pruneAxes(bool ignoreExplicitlyMappedAxes);
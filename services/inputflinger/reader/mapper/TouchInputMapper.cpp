@@ -2091,6 +2091,13 @@ void TouchInputMapper::cookPointerData() {
         mCurrentCookedState.buttonState = mCurrentRawState.buttonState;
     }
 
+    // Summed sizes are shared out between the touching pointers, which are the same for all of
+    // the pointers of this sync.
+    uint32_t sizeDivisor = 1;
+    if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
+        sizeDivisor = mCurrentRawState.rawPointerData.touchingIdBits.count();
+    }
+
     // Walk through the the active pointers and map device coordinates onto
     // surface coordinates and adjust for display orientation.
     for (uint32_t i = 0; i < currentPointerCount; i++) {
@@ -2133,15 +2140,12 @@ void TouchInputMapper::cookPointerData() {
                     size = 0;
                 }
 
-                if (mCalibration.haveSizeIsSummed && mCalibration.sizeIsSummed) {
-                    uint32_t touchingCount = mCurrentRawState.rawPointerData.touchingIdBits.count();
-                    if (touchingCount > 1) {
-                        touchMajor /= touchingCount;
-                        touchMinor /= touchingCount;
-                        toolMajor /= touchingCount;
-                        toolMinor /= touchingCount;
-                        size /= touchingCount;
-                    }
+                if (sizeDivisor > 1) {
+                    touchMajor /= sizeDivisor;
+                    touchMinor /= sizeDivisor;
+                    toolMajor /= sizeDivisor;
+                    toolMinor /= sizeDivisor;
+                    size /= sizeDivisor;
                 }
 
                 if (mCalibration.sizeCalibration == Calibration::SizeCalibration::GEOMETRIC) {
@@ -2300,7 +2304,10 @@ void TouchInputMapper::cookPointerData() {
                 break;
         }
 
-        // Write output coords.
+        // Write output coords. The axes are written in increasing order, so that each of them is
+        // appended to the packed values rather than shifting the ones already written.
+        const bool haveCoverageBox =
+                mCalibration.coverageCalibration == Calibration::CoverageCalibration::BOX;
         PointerCoords& out = mCurrentCookedState.cookedPointerData.pointerCoords[i];
         out.clear();
         out.setAxisValue(AMOTION_EVENT_AXIS_X, xTransformed);
@@ -2309,17 +2316,18 @@ void TouchInputMapper::cookPointerData() {
         out.setAxisValue(AMOTION_EVENT_AXIS_SIZE, size);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MAJOR, touchMajor);
         out.setAxisValue(AMOTION_EVENT_AXIS_TOUCH_MINOR, touchMinor);
+        if (!haveCoverageBox) {
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
+            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
+        }
         out.setAxisValue(AMOTION_EVENT_AXIS_ORIENTATION, orientation);
-        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
         out.setAxisValue(AMOTION_EVENT_AXIS_DISTANCE, distance);
-        if (mCalibration.coverageCalibration == Calibration::CoverageCalibration::BOX) {
+        out.setAxisValue(AMOTION_EVENT_AXIS_TILT, tilt);
+        if (haveCoverageBox) {
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_1, left);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_2, top);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_3, right);
             out.setAxisValue(AMOTION_EVENT_AXIS_GENERIC_4, bottom);
-        } else {
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MAJOR, toolMajor);
-            out.setAxisValue(AMOTION_EVENT_AXIS_TOOL_MINOR, toolMinor);
         }
 
         // Write output relative fields if applicable.
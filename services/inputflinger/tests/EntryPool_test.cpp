@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../dispatcher/EntryPool.h"
+
+// atest inputflinger_tests:EntryPoolTest
+
+namespace android::inputdispatcher {
+
+// A size of its own, so that no other user of the pools shares its blocks.
+static constexpr size_t TEST_BLOCK_SIZE = 1234;
+
+struct TestEntry {
+    explicit TestEntry(int32_t value) : value(value) {}
+    virtual ~TestEntry() = default;
+
+    int32_t value;
+};
+
+struct LargeTestEntry : public TestEntry {
+    explicit LargeTestEntry(int32_t value) : TestEntry(value) {}
+
+    char data[TEST_BLOCK_SIZE];
+};
+
+TEST(EntryPoolTest, ReusesReleasedBlocks) {
+    BlockPool<TEST_BLOCK_SIZE, alignof(std::max_align_t)>& pool =
+            BlockPool<TEST_BLOCK_SIZE, alignof(std::max_align_t)>::getInstance();
+    void* block = pool.allocate();
+    pool.release(block);
+
+    const size_t heapAllocations = gEntryPoolHeapAllocations;
+    EXPECT_EQ(block, pool.allocate());
+    EXPECT_EQ(heapAllocations, gEntryPoolHeapAllocations);
+
+    // The free list is empty again, so the next block comes from the heap.
+    void* otherBlock = pool.allocate();
+    EXPECT_NE(block, otherBlock);
+    EXPECT_EQ(heapAllocations + 1, gEntryPoolHeapAllocations);
+    pool.release(block);
+    pool.release(otherBlock);
+}
+
+TEST(EntryPoolTest, PooledEntriesAreRecycled) {
+    // Warm up the pool of the entries and their reference counts.
+    makePooledEntry<LargeTestEntry>(0);
+
+    const size_t heapAllocations = gEntryPoolHeapAllocations;
+    for (int32_t i = 0; i < 100; i++) {
+        std::shared_ptr<TestEntry> entry = makePooledEntry<LargeTestEntry>(i);
+        std::shared_ptr<TestEntry> copy = entry;
+        EXPECT_EQ(i, copy->value);
+    }
+    EXPECT_EQ(heapAllocations, gEntryPoolHeapAllocations);
+}
+
+} // namespace android::inputdispatcher
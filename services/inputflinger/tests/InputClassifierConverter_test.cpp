@@ -80,4 +80,24 @@ TEST(InputClassifierConverterTest, PointerCoordsAxes) {
             BitSet64::count(motionEvent.pointerCoords[0].bits));
 }
 
+/**
+ * Check that the video frames are converted to the hidl VideoFrame in input::common, with the
+ * same heatmap.
+ */
+TEST(InputClassifierConverterTest, VideoFrames) {
+    NotifyMotionArgs motionArgs = generateBasicMotionArgs();
+    const timeval timestamp = {1, 2};
+    motionArgs.videoFrames = {TouchVideoFrame(3, 2, {1, 2, 3, 4, 5, 6}, timestamp)};
+
+    common::V1_0::MotionEvent motionEvent = notifyMotionArgsToHalMotionEvent(motionArgs);
+
+    ASSERT_EQ(1U, motionEvent.frames.size());
+    const common::V1_0::VideoFrame& frame = motionEvent.frames[0];
+    ASSERT_EQ(3U, frame.height);
+    ASSERT_EQ(2U, frame.width);
+    ASSERT_EQ(std::vector<int16_t>({1, 2, 3, 4, 5, 6}), std::vector<int16_t>(frame.data));
+    ASSERT_EQ(static_cast<uint64_t>(seconds_to_nanoseconds(1) + microseconds_to_nanoseconds(2)),
+              frame.timestamp);
+}
+
 } // namespace android
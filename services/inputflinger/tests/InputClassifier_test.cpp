@@ -17,6 +17,9 @@
 #include "../InputClassifier.h"
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <thread>
+
 #include "TestInputListener.h"
 
 #include <android/hardware/input/classifier/1.0/IInputClassifier.h>
@@ -258,6 +261,25 @@ TEST_F(MotionClassifierTest, Classify_TwoVideoFrames) {
     ASSERT_NO_FATAL_FAILURE(mMotionClassifier->classify(motionArgs));
 }
 
+/**
+ * The duration of the classify call should be reported in the dump, once the HAL thread has made
+ * it.
+ */
+TEST_F(MotionClassifierTest, Dump_ReportsClassifyLatency) {
+    mMotionClassifier->classify(generateBasicMotionArgs());
+
+    std::string dump;
+    for (int attempt = 0; attempt < 100; attempt++) {
+        dump.clear();
+        mMotionClassifier->dump(dump);
+        if (dump.find("HAL classify latency of the last 1 of 1 calls") != std::string::npos) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    FAIL() << "Classify latency not reported in dump:\n" << dump;
+}
+
 /**
  * Make sure MotionClassifier does not crash when it is reset.
  */
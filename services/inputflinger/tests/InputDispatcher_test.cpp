@@ -1454,6 +1454,96 @@ TEST_F(InputDispatcherTest, SetInputWindowTwice_SingleWindowTouch) {
     window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
 }
 
+/**
+ * A window whose geometry changed is updated in place, and takes the touches at its new position.
+ */
+TEST_F(InputDispatcherTest, UpdateInputWindows_GeometryChangeMovesWindow) {
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    window->setFrame(Rect(0, 0, 100, 100));
+    window->setFlags(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+
+    window->setFrame(Rect(100, 100, 200, 200));
+    mDispatcher->updateInputWindows({{ADISPLAY_ID_DEFAULT, {window}}},
+                                    {{ADISPLAY_ID_DEFAULT, InputWindowInfo::Change::GEOMETRY}});
+    ASSERT_EQ(InputEventInjectionResult::SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT,
+                               {150, 150}))
+            << "Inject motion event should return InputEventInjectionResult::SUCCEEDED";
+
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+}
+
+/**
+ * A window whose focusability changed goes through focus resolution again.
+ */
+TEST_F(InputDispatcherTest, UpdateInputWindows_FocusChangeUpdatesFocus) {
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    window->setFocusable(true);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+    setFocusedWindow(window);
+    window->consumeFocusEvent(true);
+
+    window->setFocusable(false);
+    mDispatcher->updateInputWindows({{ADISPLAY_ID_DEFAULT, {window}}},
+                                    {{ADISPLAY_ID_DEFAULT,
+                                      Flags<InputWindowInfo::Change>(
+                                              InputWindowInfo::Change::STATE) |
+                                              InputWindowInfo::Change::FOCUS}});
+    window->consumeFocusEvent(false);
+}
+
+/**
+ * A window whose state changed without affecting focus keeps it, and still gets the key events.
+ */
+TEST_F(InputDispatcherTest, UpdateInputWindows_StateChangeKeepsFocus) {
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    window->setFocusable(true);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {window}}});
+    setFocusedWindow(window);
+    window->consumeFocusEvent(true);
+
+    window->setFlags(InputWindowInfo::Flag::NOT_TOUCH_MODAL);
+    mDispatcher->updateInputWindows({{ADISPLAY_ID_DEFAULT, {window}}},
+                                    {{ADISPLAY_ID_DEFAULT, InputWindowInfo::Change::STATE}});
+    ASSERT_EQ(InputEventInjectionResult::SUCCEEDED, injectKeyDown(mDispatcher))
+            << "Inject key event should return InputEventInjectionResult::SUCCEEDED";
+    window->consumeKeyDown(ADISPLAY_ID_DEFAULT);
+    window->assertNoEvents();
+}
+
+/**
+ * Displays that are not part of an update keep their windows.
+ */
+TEST_F(InputDispatcherTest, UpdateInputWindows_UnlistedDisplaysKeepTheirWindows) {
+    constexpr int32_t SECOND_DISPLAY_ID = 1;
+    std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
+    sp<FakeWindowHandle> window =
+            new FakeWindowHandle(application, mDispatcher, "Fake Window", ADISPLAY_ID_DEFAULT);
+    sp<FakeWindowHandle> secondWindow =
+            new FakeWindowHandle(application, mDispatcher, "Second Window", SECOND_DISPLAY_ID);
+    mDispatcher->setInputWindows(
+            {{ADISPLAY_ID_DEFAULT, {window}}, {SECOND_DISPLAY_ID, {secondWindow}}});
+
+    mDispatcher->updateInputWindows({{SECOND_DISPLAY_ID, {}}},
+                                    {{SECOND_DISPLAY_ID, InputWindowInfo::Change::STATE}});
+    ASSERT_EQ(InputEventInjectionResult::SUCCEEDED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, ADISPLAY_ID_DEFAULT))
+            << "Inject motion event should return InputEventInjectionResult::SUCCEEDED";
+    window->consumeMotionDown(ADISPLAY_ID_DEFAULT);
+
+    ASSERT_EQ(InputEventInjectionResult::FAILED,
+              injectMotionDown(mDispatcher, AINPUT_SOURCE_TOUCHSCREEN, SECOND_DISPLAY_ID))
+            << "Inject motion event should return InputEventInjectionResult::FAILED";
+    secondWindow->assertNoEvents();
+}
+
 // The foreground window should receive the first touch down event.
 TEST_F(InputDispatcherTest, SetInputWindow_MultiWindowsTouch) {
     std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
@@ -2291,6 +2381,36 @@ TEST_F(InputDispatcherTest, GestureMonitor_NoWindowTransform) {
     ASSERT_EQ(ui::Transform(), event->getTransform());
 }
 
+/**
+ * The monitors of a display are sent copies of the message built for the first of them. Each of
+ * them should still get the whole event, signed so that it verifies.
+ */
+TEST_F(InputDispatcherTest, MultipleMonitors_ReceiveTheSameVerifiedEvent) {
+    FakeMonitorReceiver firstMonitor =
+            FakeMonitorReceiver(mDispatcher, "M_1", ADISPLAY_ID_DEFAULT);
+    FakeMonitorReceiver secondMonitor =
+            FakeMonitorReceiver(mDispatcher, "M_2", ADISPLAY_ID_DEFAULT);
+
+    NotifyMotionArgs motionArgs =
+            generateMotionArgs(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN,
+                               ADISPLAY_ID_DEFAULT);
+    mDispatcher->notifyMotion(&motionArgs);
+
+    MotionEvent* firstEvent = firstMonitor.consumeMotion();
+    ASSERT_NE(nullptr, firstEvent);
+    const MotionEvent firstCopy = *firstEvent;
+    MotionEvent* secondEvent = secondMonitor.consumeMotion();
+    ASSERT_NE(nullptr, secondEvent);
+
+    EXPECT_EQ(motionArgs.id, firstCopy.getId());
+    EXPECT_EQ(motionArgs.id, secondEvent->getId());
+    EXPECT_EQ(AMOTION_EVENT_ACTION_DOWN, secondEvent->getAction());
+    EXPECT_EQ(firstCopy.getX(0), secondEvent->getX(0));
+    EXPECT_EQ(firstCopy.getY(0), secondEvent->getY(0));
+    EXPECT_NE(nullptr, mDispatcher->verifyInputEvent(firstCopy));
+    EXPECT_NE(nullptr, mDispatcher->verifyInputEvent(*secondEvent));
+}
+
 TEST_F(InputDispatcherTest, TestMoveEvent) {
     std::shared_ptr<FakeApplicationHandle> application = std::make_shared<FakeApplicationHandle>();
     sp<FakeWindowHandle> window =
@@ -3011,6 +3131,34 @@ TEST_F(InputDispatcherFocusOnTwoDisplaysTest, SetInputWindow_MultiDisplayFocus)
     windowInSecondary->assertNoEvents();
 }
 
+/**
+ * A key waiting for a focused window on one display should not hold up the events of another
+ * display that are queued behind it, and should still be dispatched once the window gets focus.
+ */
+TEST_F(InputDispatcherFocusOnTwoDisplaysTest, KeyWaitingForFocus_DoesNotBlockOtherDisplay) {
+    windowInPrimary->setFocusable(false);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windowInPrimary}}});
+    windowInPrimary->consumeFocusEvent(false);
+
+    NotifyKeyArgs keyArgs = generateKeyArgs(AKEY_EVENT_ACTION_DOWN, ADISPLAY_ID_DEFAULT);
+    mDispatcher->notifyKey(&keyArgs);
+    NotifyMotionArgs motionArgs =
+            generateMotionArgs(AMOTION_EVENT_ACTION_DOWN, AINPUT_SOURCE_TOUCHSCREEN,
+                               SECOND_DISPLAY_ID, {{100, 200}});
+    motionArgs.deviceId = DEVICE_ID + 1;
+    mDispatcher->notifyMotion(&motionArgs);
+
+    windowInSecondary->consumeMotionDown(SECOND_DISPLAY_ID);
+    windowInPrimary->assertNoEvents();
+
+    windowInPrimary->setFocusable(true);
+    mDispatcher->setInputWindows({{ADISPLAY_ID_DEFAULT, {windowInPrimary}}});
+    setFocusedWindow(windowInPrimary);
+    windowInPrimary->consumeFocusEvent(true);
+    windowInPrimary->consumeKeyDown(ADISPLAY_ID_DEFAULT);
+    windowInSecondary->assertNoEvents();
+}
+
 // Test per-display input monitors for motion event.
 TEST_F(InputDispatcherFocusOnTwoDisplaysTest, MonitorMotionEvent_MultiDisplay) {
     FakeMonitorReceiver monitorInPrimary =
@@ -4706,6 +4854,33 @@ TEST_F(InputDispatcherPointerCaptureTests, EnableRequestFollowsSequenceNumbers)
     mWindow->consumeCaptureEvent(true);
 }
 
+TEST_F(InputDispatcherPointerCaptureTests, QueuedCapturedMovesAreCoalesced) {
+    requestAndVerifyPointerCapture(mWindow, true);
+
+    // Keep the moves in the inbound queue, as when the mouse reports faster than the dispatcher
+    // can keep up with.
+    mDispatcher->stop();
+    for (int i = 0; i < 3; i++) {
+        NotifyMotionArgs motionArgs =
+                generateMotionArgs(AMOTION_EVENT_ACTION_MOVE, AINPUT_SOURCE_MOUSE_RELATIVE,
+                                   ADISPLAY_ID_DEFAULT, {PointF{1, -2}});
+        motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_RELATIVE_X, 1);
+        motionArgs.pointerCoords[0].setAxisValue(AMOTION_EVENT_AXIS_RELATIVE_Y, -2);
+        mDispatcher->notifyMotion(&motionArgs);
+    }
+    mDispatcher->start();
+
+    MotionEvent* event = mWindow->consumeMotion();
+    ASSERT_NE(nullptr, event);
+    EXPECT_EQ(AMOTION_EVENT_ACTION_MOVE, event->getAction());
+    EXPECT_EQ(0u, event->getHistorySize());
+    EXPECT_EQ(3, event->getX(0));
+    EXPECT_EQ(-6, event->getY(0));
+    EXPECT_EQ(3, event->getAxisValue(AMOTION_EVENT_AXIS_RELATIVE_X, 0));
+    EXPECT_EQ(-6, event->getAxisValue(AMOTION_EVENT_AXIS_RELATIVE_Y, 0));
+    mWindow->assertNoEvents();
+}
+
 class InputDispatcherUntrustedTouchesTest : public InputDispatcherTest {
 protected:
     constexpr static const float MAXIMUM_OBSCURING_OPACITY = 0.8;
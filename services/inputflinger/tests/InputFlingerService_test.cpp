@@ -145,6 +145,9 @@ public:
     binder::Status setInputWindows(
             const std::vector<InputWindowInfo>& handles,
             const sp<ISetInputWindowsListener>& setInputWindowsListener) override;
+    binder::Status updateInputWindows(
+            const InputWindowsDelta& delta,
+            const sp<ISetInputWindowsListener>& setInputWindowsListener) override;
 
     binder::Status createInputChannel(const std::string& name, InputChannel* outChannel) override;
     binder::Status removeInputChannel(const sp<IBinder>& connectionToken) override;
@@ -211,6 +214,15 @@ binder::Status TestInputManager::setInputWindows(
     return binder::Status::ok();
 }
 
+binder::Status TestInputManager::updateInputWindows(
+        const InputWindowsDelta&, const sp<ISetInputWindowsListener>& setInputWindowsListener) {
+    // The windows are only ever set in full by these tests.
+    if (setInputWindowsListener) {
+        setInputWindowsListener->onSetInputWindowsFinished();
+    }
+    return binder::Status::ok();
+}
+
 binder::Status TestInputManager::createInputChannel(const std::string& name,
                                                     InputChannel* outChannel) {
     AutoMutex _l(mLock);
@@ -20,6 +20,7 @@
 #include <InputReader.h>
 #include <InputReaderBase.h>
 #include <InputReaderFactory.h>
+#include <JoystickInputMapper.h>
 #include <KeyboardInputMapper.h>
 #include <MultiTouchInputMapper.h>
 #include <PeripheralController.h>
@@ -3044,6 +3045,70 @@ TEST_F(SensorInputMapperTest, ProcessGyroscopeSensor) {
     mapper.flushSensor(InputDeviceSensorType::GYROSCOPE);
 }
 
+// --- JoystickInputMapperTest ---
+
+class JoystickInputMapperTest : public InputMapperTest {
+protected:
+    void SetUp() override {
+        InputMapperTest::SetUp(DEVICE_CLASSES | InputDeviceClass::JOYSTICK);
+        mFakeEventHub->addAbsoluteAxis(EVENTHUB_ID, ABS_X, 0, 1000, 0, 0);
+    }
+
+    void processAxis(JoystickInputMapper& mapper, nsecs_t when, int32_t value) {
+        process(mapper, when, READ_TIME, EV_ABS, ABS_X, value);
+        process(mapper, when, READ_TIME, EV_SYN, SYN_REPORT, 0);
+    }
+
+    void assertAxisReported(float value, nsecs_t eventTime) {
+        NotifyMotionArgs args;
+        ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasCalled(&args));
+        ASSERT_EQ(AINPUT_SOURCE_JOYSTICK, args.source);
+        ASSERT_EQ(eventTime, args.eventTime);
+        // The axis is not mapped, so it gets the first generic axis.
+        ASSERT_NEAR(value, args.pointerCoords[0].getAxisValue(AMOTION_EVENT_AXIS_GENERIC_1),
+                    EPSILON);
+    }
+};
+
+TEST_F(JoystickInputMapperTest, DeadZone_ReportsSmallValuesAsZero) {
+    addConfigurationProperty("joystick.deadZone", "0.1");
+    JoystickInputMapper& mapper = addMapperAndConfigure<JoystickInputMapper>();
+
+    processAxis(mapper, ARBITRARY_TIME, 500);
+    ASSERT_NO_FATAL_FAILURE(assertAxisReported(0.5f, ARBITRARY_TIME));
+
+    processAxis(mapper, ARBITRARY_TIME + 1, 50);
+    ASSERT_NO_FATAL_FAILURE(assertAxisReported(0.0f, ARBITRARY_TIME + 1));
+
+    // Still within the dead zone, so the axis has not moved.
+    processAxis(mapper, ARBITRARY_TIME + 2, 30);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
+}
+
+TEST_F(JoystickInputMapperTest, MaxReportRate_CoalescesChangesUntilTheReportInterval) {
+    // One report per second at most, which is long enough for the test not to race with the
+    // timeout that the mapper requests from the reader.
+    addConfigurationProperty("joystick.maxReportRate", "1");
+    JoystickInputMapper& mapper = addMapperAndConfigure<JoystickInputMapper>();
+    const nsecs_t startTime = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    processAxis(mapper, startTime, 500);
+    ASSERT_NO_FATAL_FAILURE(assertAxisReported(0.5f, startTime));
+
+    processAxis(mapper, startTime + ms2ns(1), 600);
+    processAxis(mapper, startTime + ms2ns(2), 700);
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
+
+    // Only the latest value is reported once the interval has elapsed.
+    mapper.timeoutExpired(startTime + s2ns(1));
+    ASSERT_NO_FATAL_FAILURE(assertAxisReported(0.7f, startTime + ms2ns(2)));
+    ASSERT_NO_FATAL_FAILURE(mFakeListener->assertNotifyMotionWasNotCalled());
+
+    // Changes after the interval are reported right away.
+    processAxis(mapper, startTime + s2ns(2) + ms2ns(1), 800);
+    ASSERT_NO_FATAL_FAILURE(assertAxisReported(0.8f, startTime + s2ns(2) + ms2ns(1)));
+}
+
 // --- KeyboardInputMapperTest ---
 
 class KeyboardInputMapperTest : public InputMapperTest {
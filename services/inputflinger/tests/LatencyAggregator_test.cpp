@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/LatencyAggregator.h"
+
+#include <binder/Binder.h>
+#include <gtest/gtest.h>
+
+namespace android::inputdispatcher {
+
+static InputEventTimeline createTimeline(int32_t uid, bool withGraphics) {
+    InputEventTimeline timeline(/*isDown*/ true, /*eventTime*/ 0, /*readTime*/ ms2ns(1));
+    ConnectionTimeline connectionTimeline(/*deliveryTime*/ ms2ns(2), /*consumeTime*/ ms2ns(3),
+                                          /*finishTime*/ ms2ns(20));
+    connectionTimeline.uid = uid;
+    if (withGraphics) {
+        std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
+        graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = ms2ns(25);
+        graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = ms2ns(30);
+        connectionTimeline.setGraphicsTimeline(std::move(graphicsTimeline));
+    }
+    timeline.connectionTimelines.emplace(new BBinder(), std::move(connectionTimeline));
+    return timeline;
+}
+
+TEST(LatencyHistogramTest, EmptyHistogramHasNoPercentile) {
+    LatencyHistogram histogram;
+    EXPECT_EQ(0u, histogram.getCount());
+    EXPECT_EQ(0, histogram.getPercentile(0.5));
+}
+
+TEST(LatencyHistogramTest, PercentilesAreBucketBounds) {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 90; i++) {
+        histogram.add(ms2ns(3));
+    }
+    for (int i = 0; i < 10; i++) {
+        histogram.add(ms2ns(100));
+    }
+    EXPECT_EQ(100u, histogram.getCount());
+    EXPECT_EQ(ms2ns(4), histogram.getPercentile(0.5));
+    EXPECT_EQ(ms2ns(4), histogram.getPercentile(0.9));
+    EXPECT_EQ(ms2ns(128), histogram.getPercentile(0.99));
+}
+
+TEST(LatencyAggregatorTest, Dump_ReportsLatencyByApp) {
+    LatencyAggregator aggregator;
+    aggregator.processTimeline(createTimeline(10001, /*withGraphics*/ true));
+    aggregator.processTimeline(createTimeline(10002, /*withGraphics*/ false));
+    // Monitors are not owned by an app.
+    aggregator.processTimeline(createTimeline(ConnectionTimeline::NO_UID, /*withGraphics*/ true));
+
+    const std::string dump = aggregator.dump("");
+    EXPECT_NE(std::string::npos,
+              dump.find("uid=10001: events=1 eventToDeliver=2/2/2 eventToConsume=4/4/4 "
+                        "eventToFinish=32/32/32 eventToPresent=32/32/32\n"))
+            << dump;
+    EXPECT_NE(std::string::npos,
+              dump.find("uid=10002: events=1 eventToDeliver=2/2/2 eventToConsume=4/4/4 "
+                        "eventToFinish=32/32/32\n"))
+            << dump;
+    EXPECT_EQ(std::string::npos, dump.find("uid=-1")) << dump;
+}
+
+} // namespace android::inputdispatcher
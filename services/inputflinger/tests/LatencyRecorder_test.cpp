@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../dispatcher/LatencyRecorder.h"
+
+#include <binder/Binder.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace android::inputdispatcher {
+
+// Long enough for the timelines to be reported, even on a loaded device.
+static constexpr std::chrono::duration REPORT_TIMEOUT = 5s;
+
+// Much later than the ANR timeout, so that the earlier events become mature.
+static constexpr nsecs_t MATURE_EVENT_TIME = 1000'000'000'000;
+
+// --- LatencyRecorderTest ---
+
+class LatencyRecorderTest : public testing::Test, public InputEventTimelineProcessor {
+protected:
+    std::unique_ptr<LatencyRecorder> mRecorder;
+
+    void SetUp() override { mRecorder = std::make_unique<LatencyRecorder>(this); }
+
+    void TearDown() override { mRecorder.reset(); }
+
+    std::optional<InputEventTimeline> waitForTimeline() {
+        std::unique_lock<std::mutex> lock(mLock);
+        base::ScopedLockAssertion assumeLocked(mLock);
+        if (!mTimelineReported.wait_for(lock, REPORT_TIMEOUT,
+                                        [this]() REQUIRES(mLock) {
+                                            return !mReceivedTimelines.empty();
+                                        })) {
+            return {};
+        }
+        InputEventTimeline timeline = mReceivedTimelines.front();
+        mReceivedTimelines.pop_front();
+        return timeline;
+    }
+
+private:
+    void processTimeline(const InputEventTimeline& timeline) override {
+        std::scoped_lock _l(mLock);
+        mReceivedTimelines.push_back(timeline);
+        mTimelineReported.notify_all();
+    }
+
+    std::mutex mLock;
+    std::condition_variable mTimelineReported;
+    std::deque<InputEventTimeline> mReceivedTimelines GUARDED_BY(mLock);
+};
+
+TEST_F(LatencyRecorderTest, RecordedTimeline_IsReportedOnceMature) {
+    sp<IBinder> connection = new BBinder();
+    std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
+    graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = 9;
+    graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = 10;
+
+    mRecorder->trackListener(1 /*inputEventId*/, true /*isDown*/, 2 /*eventTime*/, 3 /*readTime*/);
+    mRecorder->trackFinishedEvent(1 /*inputEventId*/, connection, 10001 /*uid*/,
+                                  6 /*deliveryTime*/, 7 /*consumeTime*/, 8 /*finishTime*/);
+    mRecorder->trackGraphicsLatency(1 /*inputEventId*/, connection, graphicsTimeline);
+    mRecorder->trackListener(2 /*inputEventId*/, false /*isDown*/, MATURE_EVENT_TIME,
+                             MATURE_EVENT_TIME);
+
+    InputEventTimeline expected(true /*isDown*/, 2 /*eventTime*/, 3 /*readTime*/);
+    ConnectionTimeline expectedCT(6 /*deliveryTime*/, 7 /*consumeTime*/, 8 /*finishTime*/);
+    expectedCT.uid = 10001;
+    expectedCT.setGraphicsTimeline(std::move(graphicsTimeline));
+    expected.connectionTimelines.emplace(connection, std::move(expectedCT));
+
+    std::optional<InputEventTimeline> timeline = waitForTimeline();
+    ASSERT_TRUE(timeline);
+    ASSERT_EQ(expected, *timeline);
+}
+
+TEST_F(LatencyRecorderTest, RecordsFromSeveralThreads_AreAllTracked) {
+    constexpr int32_t eventCount = 100;
+    std::thread otherThread([this]() {
+        for (int32_t id = 1; id <= eventCount; id += 2) {
+            mRecorder->trackListener(id, false /*isDown*/, id /*eventTime*/, id /*readTime*/);
+        }
+    });
+    for (int32_t id = 2; id <= eventCount; id += 2) {
+        mRecorder->trackListener(id, false /*isDown*/, id /*eventTime*/, id /*readTime*/);
+    }
+    otherThread.join();
+    mRecorder->trackListener(eventCount + 1, false /*isDown*/, MATURE_EVENT_TIME,
+                             MATURE_EVENT_TIME);
+
+    std::set<nsecs_t> eventTimes;
+    for (int32_t i = 0; i < eventCount; i++) {
+        std::optional<InputEventTimeline> timeline = waitForTimeline();
+        ASSERT_TRUE(timeline) << "Only " << i << " timelines were reported";
+        eventTimes.insert(timeline->eventTime);
+    }
+    ASSERT_EQ(size_t(eventCount), eventTimes.size());
+}
+
+} // namespace android::inputdispatcher
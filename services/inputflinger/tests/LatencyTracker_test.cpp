@@ -34,6 +34,7 @@ InputEventTimeline getTestTimeline() {
             /*eventTime*/ 2,
             /*readTime*/ 3);
     ConnectionTimeline expectedCT(/*deliveryTime*/ 6, /* consumeTime*/ 7, /*finishTime*/ 8);
+    expectedCT.uid = 10001;
     std::array<nsecs_t, GraphicsTimeline::SIZE> graphicsTimeline;
     graphicsTimeline[GraphicsTimeline::GPU_COMPLETED_TIME] = 9;
     graphicsTimeline[GraphicsTimeline::PRESENT_TIME] = 10;
@@ -128,8 +129,8 @@ TEST_F(LatencyTrackerTest, TrackListener_DoesNotTriggerReporting) {
  * A single call to trackFinishedEvent should not cause a timeline to be reported.
  */
 TEST_F(LatencyTrackerTest, TrackFinishedEvent_DoesNotTriggerReporting) {
-    mTracker->trackFinishedEvent(1 /*inputEventId*/, connection1, 2 /*deliveryTime*/,
-                                 3 /*consumeTime*/, 4 /*finishTime*/);
+    mTracker->trackFinishedEvent(1 /*inputEventId*/, connection1, ConnectionTimeline::NO_UID,
+                                 2 /*deliveryTime*/, 3 /*consumeTime*/, 4 /*finishTime*/);
     assertReceivedTimelines({});
 }
 
@@ -151,8 +152,9 @@ TEST_F(LatencyTrackerTest, TrackAllParameters_ReportsFullTimeline) {
     const auto& [connectionToken, expectedCT] = *expected.connectionTimelines.begin();
 
     mTracker->trackListener(inputEventId, expected.isDown, expected.eventTime, expected.readTime);
-    mTracker->trackFinishedEvent(inputEventId, connectionToken, expectedCT.deliveryTime,
-                                 expectedCT.consumeTime, expectedCT.finishTime);
+    mTracker->trackFinishedEvent(inputEventId, connectionToken, expectedCT.uid,
+                                 expectedCT.deliveryTime, expectedCT.consumeTime,
+                                 expectedCT.finishTime);
     mTracker->trackGraphicsLatency(inputEventId, connectionToken, expectedCT.graphicsTimeline);
 
     assertReceivedTimeline(expected);
@@ -194,11 +196,15 @@ TEST_F(LatencyTrackerTest, MultipleEvents_AreReportedConsistently) {
     // Start processing second event
     mTracker->trackListener(inputEventId2, timeline2.isDown, timeline2.eventTime,
                             timeline2.readTime);
-    mTracker->trackFinishedEvent(inputEventId1, connection1, connectionTimeline1.deliveryTime,
-                                 connectionTimeline1.consumeTime, connectionTimeline1.finishTime);
+    mTracker->trackFinishedEvent(inputEventId1, connection1, connectionTimeline1.uid,
+                                 connectionTimeline1.deliveryTime,
+                                 connectionTimeline1.consumeTime,
+                                 connectionTimeline1.finishTime);
 
-    mTracker->trackFinishedEvent(inputEventId2, connection2, connectionTimeline2.deliveryTime,
-                                 connectionTimeline2.consumeTime, connectionTimeline2.finishTime);
+    mTracker->trackFinishedEvent(inputEventId2, connection2, connectionTimeline2.uid,
+                                 connectionTimeline2.deliveryTime,
+                                 connectionTimeline2.consumeTime,
+                                 connectionTimeline2.finishTime);
     mTracker->trackGraphicsLatency(inputEventId1, connection1,
                                    connectionTimeline1.graphicsTimeline);
     mTracker->trackGraphicsLatency(inputEventId2, connection2,
@@ -223,8 +229,9 @@ TEST_F(LatencyTrackerTest, IncompleteEvents_AreHandledConsistently) {
                 InputEventTimeline{timeline.isDown, timeline.eventTime, timeline.readTime});
     }
     // Now, complete the first event that was sent.
-    mTracker->trackFinishedEvent(1 /*inputEventId*/, token, expectedCT.deliveryTime,
-                                 expectedCT.consumeTime, expectedCT.finishTime);
+    mTracker->trackFinishedEvent(1 /*inputEventId*/, token, expectedCT.uid,
+                                 expectedCT.deliveryTime, expectedCT.consumeTime,
+                                 expectedCT.finishTime);
     mTracker->trackGraphicsLatency(1 /*inputEventId*/, token, expectedCT.graphicsTimeline);
 
     expectedTimelines[0].connectionTimelines.emplace(token, std::move(expectedCT));
@@ -241,8 +248,9 @@ TEST_F(LatencyTrackerTest, EventsAreTracked_WhenTrackListenerIsCalledFirst) {
     constexpr int32_t inputEventId = 1;
     InputEventTimeline expected = getTestTimeline();
     const ConnectionTimeline& expectedCT = expected.connectionTimelines.begin()->second;
-    mTracker->trackFinishedEvent(inputEventId, connection1, expectedCT.deliveryTime,
-                                 expectedCT.consumeTime, expectedCT.finishTime);
+    mTracker->trackFinishedEvent(inputEventId, connection1, expectedCT.uid,
+                                 expectedCT.deliveryTime, expectedCT.consumeTime,
+                                 expectedCT.finishTime);
     mTracker->trackGraphicsLatency(inputEventId, connection1, expectedCT.graphicsTimeline);
 
     mTracker->trackListener(inputEventId, expected.isDown, expected.eventTime, expected.readTime);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../TouchableWindowIndex.h"
+
+// atest inputflinger_tests:TouchableWindowIndexTest
+
+using namespace android::flag_operators;
+
+namespace android::inputdispatcher {
+
+using Flag = InputWindowInfo::Flag;
+
+class FakeWindowHandle : public InputWindowHandle {
+public:
+    FakeWindowHandle(const Rect& touchableRegion, Flags<Flag> flags = Flag::NOT_TOUCH_MODAL) {
+        mInfo.visible = true;
+        mInfo.flags = flags;
+        mInfo.addTouchableRegion(touchableRegion);
+    }
+
+    bool updateInfo() { return true; }
+    void setVisible(bool visible) { mInfo.visible = visible; }
+};
+
+static std::vector<size_t> getCandidates(const TouchableWindowIndex& index, int32_t x, int32_t y) {
+    std::vector<size_t> positions;
+    TouchableWindowIndex::Candidates candidates = index.getCandidates(x, y);
+    while (std::optional<size_t> position = candidates.next()) {
+        positions.push_back(*position);
+    }
+    return positions;
+}
+
+TEST(TouchableWindowIndexTest, EmptyIndexHasNoCandidates) {
+    TouchableWindowIndex index;
+    EXPECT_TRUE(getCandidates(index, 0, 0).empty());
+    EXPECT_TRUE(index.getOutsideTouchWatchers().empty());
+}
+
+TEST(TouchableWindowIndexTest, ReturnsWindowsAtPointFrontToBack) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeWindowHandle(Rect(900, 900, 1000, 1000)));
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 1000, 1000)));
+    TouchableWindowIndex index(windows);
+
+    EXPECT_EQ(std::vector<size_t>({0, 2}), getCandidates(index, 50, 50));
+    EXPECT_EQ(std::vector<size_t>({1, 2}), getCandidates(index, 950, 950));
+    EXPECT_EQ(std::vector<size_t>({2}), getCandidates(index, 500, 500));
+    // Outside of every touchable region.
+    EXPECT_TRUE(getCandidates(index, 2000, 2000).empty());
+    EXPECT_TRUE(getCandidates(index, -1, 50).empty());
+}
+
+TEST(TouchableWindowIndexTest, SkipsInvisibleAndNotTouchableWindows) {
+    std::vector<sp<InputWindowHandle>> windows;
+    sp<FakeWindowHandle> invisibleWindow = new FakeWindowHandle(Rect(0, 0, 100, 100));
+    invisibleWindow->setVisible(false);
+    windows.push_back(invisibleWindow);
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100),
+                                           Flag::NOT_TOUCH_MODAL | Flag::NOT_TOUCHABLE));
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100)));
+    TouchableWindowIndex index(windows);
+
+    EXPECT_EQ(std::vector<size_t>({2}), getCandidates(index, 50, 50));
+}
+
+TEST(TouchableWindowIndexTest, TouchModalWindowsAreCandidatesEverywhere) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 10, 10), Flags<Flag>()));
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100)));
+    TouchableWindowIndex index(windows);
+
+    EXPECT_EQ(std::vector<size_t>({0, 1, 2}), getCandidates(index, 50, 50));
+    EXPECT_EQ(std::vector<size_t>({1}), getCandidates(index, 5000, 5000));
+}
+
+TEST(TouchableWindowIndexTest, TracksVisibleOutsideTouchWatchers) {
+    std::vector<sp<InputWindowHandle>> windows;
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100),
+                                           Flag::NOT_TOUCH_MODAL | Flag::WATCH_OUTSIDE_TOUCH));
+    sp<FakeWindowHandle> invisibleWatcher =
+            new FakeWindowHandle(Rect(0, 0, 100, 100),
+                                 Flag::NOT_TOUCH_MODAL | Flag::WATCH_OUTSIDE_TOUCH);
+    invisibleWatcher->setVisible(false);
+    windows.push_back(invisibleWatcher);
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100)));
+    windows.push_back(new FakeWindowHandle(Rect(0, 0, 100, 100),
+                                           Flag::NOT_TOUCH_MODAL | Flag::NOT_TOUCHABLE |
+                                                   Flag::WATCH_OUTSIDE_TOUCH));
+    TouchableWindowIndex index(windows);
+
+    EXPECT_EQ(std::vector<size_t>({0, 3}), index.getOutsideTouchWatchers());
+}
+
+} // namespace android::inputdispatcher
@@ -86,15 +86,60 @@ HalResult<T> PowerHalController::processHalResult(HalResult<T> result, const cha
     return result;
 }
 
+template <size_t N>
+bool PowerHalController::shouldForwardHalCall(std::array<HalCall, N>& calls, size_t index,
+                                              int32_t value) {
+    if (mRateLimitWindow.count() <= 0 || index >= N) {
+        return true;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mLastHalCallMutex);
+    HalCall& last = calls[index];
+    if (last.time && last.value == value && now - *last.time < mRateLimitWindow) {
+        return false;
+    }
+    // Recorded before the call is made, so that concurrent repeats are dropped too.
+    last.time = now;
+    last.value = value;
+    return true;
+}
+
+template <size_t N>
+void PowerHalController::forgetHalCall(std::array<HalCall, N>& calls, size_t index) {
+    if (mRateLimitWindow.count() <= 0 || index >= N) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mLastHalCallMutex);
+    calls[index].time.reset();
+}
+
 HalResult<void> PowerHalController::setBoost(Boost boost, int32_t durationMs) {
+    const size_t idx = static_cast<size_t>(boost);
+    if (!shouldForwardHalCall(mLastBoostCalls, idx, durationMs)) {
+        ALOGV("Skipped setBoost %s with duration %dms because it was just sent",
+              toString(boost).c_str(), durationMs);
+        return HalResult<void>::ok();
+    }
     std::shared_ptr<HalWrapper> handle = initHal();
     auto result = handle->setBoost(boost, durationMs);
+    if (!result.isOk()) {
+        forgetHalCall(mLastBoostCalls, idx);
+    }
     return processHalResult(result, "setBoost");
 }
 
 HalResult<void> PowerHalController::setMode(Mode mode, bool enabled) {
+    const size_t idx = static_cast<size_t>(mode);
+    if (!shouldForwardHalCall(mLastModeCalls, idx, enabled)) {
+        ALOGV("Skipped setMode %s to %s because it was just sent", toString(mode).c_str(),
+              enabled ? "true" : "false");
+        return HalResult<void>::ok();
+    }
     std::shared_ptr<HalWrapper> handle = initHal();
     auto result = handle->setMode(mode, enabled);
+    if (!result.isOk()) {
+        forgetHalCall(mLastModeCalls, idx);
+    }
     return processHalResult(result, "setMode");
 }
 
@@ -243,8 +243,14 @@ HalResult<sp<Aidl::IPowerHintSession>> AidlHalWrapper::createHintSession(
 }
 
 HalResult<int64_t> AidlHalWrapper::getHintSessionPreferredRate() {
-    int64_t rate = -1;
+    int64_t rate = mHintSessionPreferredRate;
+    if (rate >= 0) {
+        return HalResult<int64_t>::ok(rate);
+    }
     auto result = mHandle->getHintSessionPreferredRate(&rate);
+    if (result.isOk() && rate >= 0) {
+        mHintSessionPreferredRate = rate;
+    }
     return HalResult<int64_t>::fromStatus(result, rate);
 }
 
@@ -21,11 +21,15 @@
 #include <benchmark/benchmark.h>
 #include <powermanager/PowerHalController.h>
 #include <testUtil.h>
+#include <atomic>
 #include <chrono>
 
 using android::hardware::power::Boost;
+using android::hardware::power::IPowerHintSession;
 using android::hardware::power::Mode;
+using android::power::HalConnector;
 using android::power::HalResult;
+using android::power::HalWrapper;
 using android::power::PowerHalController;
 
 using namespace android;
@@ -40,6 +44,56 @@ static constexpr int64_t LAST_MODE = static_cast<int64_t>(Mode::CAMERA_STREAMING
 // Delay between oneway method calls to avoid overflowing the binder buffers.
 static constexpr std::chrono::microseconds ONEWAY_API_DELAY = 100us;
 
+// Counts the calls that reach the connected HAL, to compare them with the ones made to the
+// controller.
+class CountingHalWrapper : public HalWrapper {
+public:
+    CountingHalWrapper(std::unique_ptr<HalWrapper> hal, std::atomic<int64_t>* count)
+          : mHal(std::move(hal)), mCount(count) {}
+
+    HalResult<void> setBoost(Boost boost, int32_t durationMs) override {
+        ++*mCount;
+        return mHal->setBoost(boost, durationMs);
+    }
+
+    HalResult<void> setMode(Mode mode, bool enabled) override {
+        ++*mCount;
+        return mHal->setMode(mode, enabled);
+    }
+
+    HalResult<sp<IPowerHintSession>> createHintSession(int32_t tgid, int32_t uid,
+                                                       const std::vector<int32_t>& threadIds,
+                                                       int64_t durationNanos) override {
+        ++*mCount;
+        return mHal->createHintSession(tgid, uid, threadIds, durationNanos);
+    }
+
+    HalResult<int64_t> getHintSessionPreferredRate() override {
+        ++*mCount;
+        return mHal->getHintSessionPreferredRate();
+    }
+
+private:
+    std::unique_ptr<HalWrapper> mHal;
+    std::atomic<int64_t>* mCount;
+};
+
+class CountingHalConnector : public HalConnector {
+public:
+    std::unique_ptr<HalWrapper> connect() override {
+        std::unique_ptr<HalWrapper> hal = HalConnector::connect();
+        if (hal == nullptr) {
+            return nullptr;
+        }
+        return std::make_unique<CountingHalWrapper>(std::move(hal), &mCount);
+    }
+
+    int64_t getCount() const { return mCount; }
+
+private:
+    std::atomic<int64_t> mCount = 0;
+};
+
 template <typename T, class... Args0, class... Args1>
 static void runBenchmark(benchmark::State& state, HalResult<T> (PowerHalController::*fn)(Args0...),
                          Args1&&... args1) {
@@ -71,6 +125,35 @@ static void runCachedBenchmark(benchmark::State& state,
     }
 }
 
+// Repeats the same call as fast as the oneway calls allow, through a controller with a rate limit
+// window of the given milliseconds, and reports how many of them reached the HAL.
+template <typename T, class... Args0, class... Args1>
+static void runRateLimitedBenchmark(benchmark::State& state, int64_t windowMs,
+                                    HalResult<T> (PowerHalController::*fn)(Args0...),
+                                    Args1&&... args1) {
+    std::unique_ptr<CountingHalConnector> connector = std::make_unique<CountingHalConnector>();
+    CountingHalConnector* counter = connector.get();
+    PowerHalController controller(std::move(connector), std::chrono::milliseconds(windowMs));
+    // First call out of test, to cache HAL service and isSupported result.
+    (controller.*fn)(std::forward<Args1>(args1)...);
+    const int64_t countBefore = counter->getCount();
+
+    while (state.KeepRunning()) {
+        HalResult<T> ret = (controller.*fn)(std::forward<Args1>(args1)...);
+        state.PauseTiming();
+        if (ret.isFailed()) {
+            state.SkipWithError("Power HAL request failed");
+        }
+        testDelaySpin(
+                std::chrono::duration_cast<std::chrono::duration<float>>(ONEWAY_API_DELAY).count());
+        state.ResumeTiming();
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.counters["HalCallsPerCall"] = static_cast<double>(counter->getCount() - countBefore) /
+            static_cast<double>(state.iterations());
+}
+
 static void BM_PowerHalControllerBenchmarks_init(benchmark::State& state) {
     while (state.KeepRunning()) {
         PowerHalController controller;
@@ -108,9 +191,27 @@ static void BM_PowerHalControllerBenchmarks_setModeCached(benchmark::State& stat
     runCachedBenchmark(state, &PowerHalController::setMode, mode, false);
 }
 
+static void BM_PowerHalControllerBenchmarks_setBoostRateLimited(benchmark::State& state) {
+    Boost boost = static_cast<Boost>(state.range(0));
+    runRateLimitedBenchmark(state, state.range(1), &PowerHalController::setBoost, boost, 0);
+}
+
+static void BM_PowerHalControllerBenchmarks_setModeRateLimited(benchmark::State& state) {
+    Mode mode = static_cast<Mode>(state.range(0));
+    runRateLimitedBenchmark(state, state.range(1), &PowerHalController::setMode, mode, false);
+}
+
 BENCHMARK(BM_PowerHalControllerBenchmarks_init);
 BENCHMARK(BM_PowerHalControllerBenchmarks_initCached);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setBoost)->DenseRange(FIRST_BOOST, LAST_BOOST, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setBoostCached)->DenseRange(FIRST_BOOST, LAST_BOOST, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setMode)->DenseRange(FIRST_MODE, LAST_MODE, 1);
 BENCHMARK(BM_PowerHalControllerBenchmarks_setModeCached)->DenseRange(FIRST_MODE, LAST_MODE, 1);
+BENCHMARK(BM_PowerHalControllerBenchmarks_setBoostRateLimited)
+        ->ArgNames({"boost", "windowMs"})
+        ->Args({static_cast<int64_t>(Boost::INTERACTION), 0})
+        ->Args({static_cast<int64_t>(Boost::INTERACTION), 10});
+BENCHMARK(BM_PowerHalControllerBenchmarks_setModeRateLimited)
+        ->ArgNames({"mode", "windowMs"})
+        ->Args({static_cast<int64_t>(Mode::LAUNCH), 0})
+        ->Args({static_cast<int64_t>(Mode::LAUNCH), 10});
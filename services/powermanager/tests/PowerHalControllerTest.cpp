@@ -215,6 +215,51 @@ TEST_F(PowerHalControllerTest, TestPowerHalDoesNotTryToRecoverFromFailureOnUnsup
     EXPECT_EQ(powerHalResetCount, 0);
 }
 
+TEST_F(PowerHalControllerTest, TestRateLimitDropsRepeatedCalls) {
+    std::unique_ptr<TestPowerHalConnector> halConnector =
+            std::make_unique<TestPowerHalConnector>(mMockHal);
+    PowerHalController halController(std::move(halConnector), 1h);
+
+    {
+        InSequence seg;
+        EXPECT_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::INTERACTION), Eq(100)))
+                .Times(Exactly(1));
+        EXPECT_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::INTERACTION), Eq(200)))
+                .Times(Exactly(1));
+        EXPECT_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::LAUNCH), Eq(1))).Times(Exactly(1));
+        EXPECT_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::LAUNCH), Eq(0))).Times(Exactly(1));
+    }
+
+    // Only calls that change the duration or enabled state reach the HAL.
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(halController.setBoost(Boost::INTERACTION, 100).isOk());
+    }
+    ASSERT_TRUE(halController.setBoost(Boost::INTERACTION, 200).isOk());
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(halController.setMode(Mode::LAUNCH, true).isOk());
+    }
+    ASSERT_TRUE(halController.setMode(Mode::LAUNCH, false).isOk());
+}
+
+TEST_F(PowerHalControllerTest, TestRateLimitForwardsCallsAfterFailure) {
+    std::unique_ptr<TestPowerHalConnector> halConnector =
+            std::make_unique<TestPowerHalConnector>(mMockHal);
+    PowerHalController halController(std::move(halConnector), 1h);
+
+    ON_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::LAUNCH), _))
+            .WillByDefault([](PowerHint, int32_t) {
+                return hardware::Return<void>(hardware::Status::fromExceptionCode(-1));
+            });
+
+    EXPECT_CALL(*mMockHal.get(), powerHint(Eq(PowerHint::LAUNCH), _)).Times(Exactly(2));
+
+    ASSERT_TRUE(halController.setMode(Mode::LAUNCH, true).isFailed());
+    ASSERT_TRUE(halController.setMode(Mode::LAUNCH, true).isFailed());
+    // Unsupported calls are not recorded either.
+    ASSERT_TRUE(halController.setBoost(Boost::CAMERA_LAUNCH, 1000).isUnsupported());
+    ASSERT_TRUE(halController.setBoost(Boost::CAMERA_LAUNCH, 1000).isUnsupported());
+}
+
 TEST_F(PowerHalControllerTest, TestMultiThreadConnectsOnlyOnce) {
     int powerHalConnectCount = mHalConnector->getConnectCount();
     EXPECT_EQ(powerHalConnectCount, 0);
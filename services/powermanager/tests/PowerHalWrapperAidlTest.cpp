@@ -238,3 +238,16 @@ TEST_F(PowerHalWrapperAidlTest, TestGetHintSessionPreferredRate) {
     int64_t rate = result.value();
     ASSERT_GE(0, rate);
 }
+
+TEST_F(PowerHalWrapperAidlTest, TestGetHintSessionPreferredRateCached) {
+    EXPECT_CALL(*mMockHal.get(), getHintSessionPreferredRate(_))
+            .Times(Exactly(1))
+            .WillRepeatedly(DoAll(SetArgPointee<0>(16666666), Return(Status())));
+
+    auto result = mWrapper->getHintSessionPreferredRate();
+    ASSERT_TRUE(result.isOk());
+    ASSERT_EQ(16666666, result.value());
+    result = mWrapper->getHintSessionPreferredRate();
+    ASSERT_TRUE(result.isOk());
+    ASSERT_EQ(16666666, result.value());
+}
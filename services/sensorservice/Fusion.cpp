@@ -487,7 +487,21 @@ void Fusion::predict(const vec3_t& w, float dT) {
     if (x0.w < 0)
         x0 = -x0;
 
-    P = Phi*P*transpose(Phi) + GQGt;
+    // Only the blocks of Phi that are not constant need to be multiplied out. As P is symmetric:
+    //
+    //  Phi*P*Phi' = | (Phi00*P00 + Phi10*P01)*Phi00' + T*Phi10'   T   |
+    //               | T'                                          P11 |
+    //
+    //  T = Phi00*P10 + Phi10*P11
+    //
+    // which takes 6 products of 3x3 matrices rather than the 16 of the whole 6x6 product.
+    const mat33_t& Phi00 = Phi[0][0];
+    const mat33_t& Phi10 = Phi[1][0];
+    const mat33_t T(Phi00*P[1][0] + Phi10*P[1][1]);
+    P[0][0] = (Phi00*P[0][0] + Phi10*P[0][1])*transpose(Phi00) + T*transpose(Phi10) + GQGt[0][0];
+    P[1][0] = T + GQGt[1][0];
+    P[0][1] = transpose(T) + GQGt[0][1];
+    P[1][1] += GQGt[1][1];
 
     checkState();
 }
@@ -22,6 +22,7 @@
 #include <utils/Timers.h>
 
 #include <inttypes.h>
+#include <string.h>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -30,23 +31,45 @@ namespace {
     constexpr size_t LOG_SIZE = 10;
     constexpr size_t LOG_SIZE_MED = 30;  // debugging for slower sensors
     constexpr size_t LOG_SIZE_LARGE = 50;  // larger samples for debugging
+
+    size_t valueCountBySensorType(int sensorType) {
+        if (sensorType == SENSOR_TYPE_STEP_COUNTER) {
+            return sizeof(uint64_t) / sizeof(float);
+        }
+        return eventSizeBySensorType(sensorType);
+    }
 }// unnamed namespace
 
-RecentEventLogger::RecentEventLogger(int sensorType) :
+RecentEventLogger::RecentEventLogger(int sensorType, bool keepLastEvent) :
         mSensorType(sensorType), mEventSize(eventSizeBySensorType(mSensorType)),
-        mRecentEvents(logSizeBySensorType(sensorType)), mMaskData(false),
-        mIsLastEventCurrent(false) {
+        mValueCount(valueCountBySensorType(sensorType)),
+        mMaxEvents(logSizeBySensorType(sensorType)), mRecentEvents(mMaxEvents),
+        mValues(mMaxEvents * mValueCount), mNextSlot(0), mEventCount(0),
+        mKeepLastEvent(keepLastEvent), mMaskData(false), mIsLastEventCurrent(false) {
     // blank
 }
 
 void RecentEventLogger::addEvent(const sensors_event_t& event) {
+    timespec wallTime;
+    clock_gettime(CLOCK_REALTIME, &wallTime);
     std::lock_guard<std::mutex> lk(mLock);
-    mRecentEvents.emplace(event);
+    SensorEventLog& log = mRecentEvents[mNextSlot];
+    log.mTimestamp = event.timestamp;
+    log.mWallTime = wallTime;
+    // The step count shares its storage with the values.
+    memcpy(&mValues[mNextSlot * mValueCount], event.data, mValueCount * sizeof(float));
+    mNextSlot = (mNextSlot + 1) % mMaxEvents;
+    if (mEventCount < mMaxEvents) {
+        mEventCount++;
+    }
+    if (mKeepLastEvent) {
+        mLastEvent = event;
+    }
     mIsLastEventCurrent = true;
 }
 
 bool RecentEventLogger::isEmpty() const {
-    return mRecentEvents.size() == 0;
+    return mEventCount == 0;
 }
 
 void RecentEventLogger::setLastEventStale() {
@@ -60,22 +83,26 @@ std::string RecentEventLogger::dump() const {
     //TODO: replace String8 with std::string completely in this function
     String8 buffer;
 
-    buffer.appendFormat("last %zu events\n", mRecentEvents.size());
+    buffer.appendFormat("last %zu events\n", mEventCount);
     int j = 0;
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    for (size_t i = mEventCount; i-- > 0;) {
+        const size_t slot = slotOfRecentEvent(i);
+        const auto& ev = mRecentEvents[slot];
         struct tm * timeinfo = localtime(&(ev.mWallTime.tv_sec));
         buffer.appendFormat("\t%2d (ts=%.9f, wall=%02d:%02d:%02d.%03d) ",
-                ++j, ev.mEvent.timestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
+                ++j, ev.mTimestamp/1e9, timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec,
                 (int) ns2ms(ev.mWallTime.tv_nsec));
 
         // data
         if (!mMaskData) {
+            const float* values = valuesOfSlot(slot);
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                buffer.appendFormat("%" PRIu64 ", ", ev.mEvent.u64.step_counter);
+                uint64_t stepCounter;
+                memcpy(&stepCounter, values, sizeof(stepCounter));
+                buffer.appendFormat("%" PRIu64 ", ", stepCounter);
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    buffer.appendFormat("%.2f, ", ev.mEvent.data[k]);
+                    buffer.appendFormat("%.2f, ", values[k]);
                 }
             }
         } else {
@@ -97,22 +124,26 @@ void RecentEventLogger::dump(util::ProtoOutputStream* proto) const {
     using namespace service::SensorEventsProto;
     std::lock_guard<std::mutex> lk(mLock);
 
-    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mRecentEvents.size()));
-    for (int i = mRecentEvents.size() - 1; i >= 0; --i) {
-        const auto& ev = mRecentEvents[i];
+    proto->write(RecentEventsLog::RECENT_EVENTS_COUNT, int(mEventCount));
+    for (size_t i = mEventCount; i-- > 0;) {
+        const size_t slot = slotOfRecentEvent(i);
+        const auto& ev = mRecentEvents[slot];
         const uint64_t token = proto->start(RecentEventsLog::EVENTS);
-        proto->write(Event::TIMESTAMP_SEC, float(ev.mEvent.timestamp) / 1e9f);
+        proto->write(Event::TIMESTAMP_SEC, float(ev.mTimestamp) / 1e9f);
         proto->write(Event::WALL_TIMESTAMP_MS, ev.mWallTime.tv_sec * 1000LL
                 + ns2ms(ev.mWallTime.tv_nsec));
 
         if (mMaskData) {
             proto->write(Event::MASKED, true);
         } else {
+            const float* values = valuesOfSlot(slot);
             if (mSensorType == SENSOR_TYPE_STEP_COUNTER) {
-                proto->write(Event::INT64_DATA, int64_t(ev.mEvent.u64.step_counter));
+                uint64_t stepCounter;
+                memcpy(&stepCounter, values, sizeof(stepCounter));
+                proto->write(Event::INT64_DATA, int64_t(stepCounter));
             } else {
                 for (size_t k = 0; k < mEventSize; ++k) {
-                    proto->write(Event::FLOAT_ARRAY, ev.mEvent.data[k]);
+                    proto->write(Event::FLOAT_ARRAY, values[k]);
                 }
             }
         }
@@ -131,9 +162,8 @@ void RecentEventLogger::setFormat(std::string format) {
 bool RecentEventLogger::populateLastEventIfCurrent(sensors_event_t *event) const {
     std::lock_guard<std::mutex> lk(mLock);
 
-    if (mIsLastEventCurrent && mRecentEvents.size()) {
-        // Index 0 contains the latest event emplace()'ed
-        *event = mRecentEvents[0].mEvent;
+    if (mKeepLastEvent && mIsLastEventCurrent && mEventCount) {
+        *event = mLastEvent;
         return true;
     } else {
         return false;
@@ -154,9 +184,5 @@ size_t RecentEventLogger::logSizeBySensorType(int sensorType) {
     return LOG_SIZE;
 }
 
-RecentEventLogger::SensorEventLog::SensorEventLog(const sensors_event_t& e) : mEvent(e) {
-    clock_gettime(CLOCK_REALTIME, &mWallTime);
-}
-
 } // namespace SensorServiceUtil
 } // namespace android
@@ -17,13 +17,13 @@
 #ifndef ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 #define ANDROID_SENSOR_SERVICE_UTIL_RECENT_EVENT_LOGGER_H
 
-#include "RingBuffer.h"
 #include "SensorServiceUtils.h"
 
 #include <hardware/sensors.h>
 #include <utils/String8.h>
 
 #include <mutex>
+#include <vector>
 
 namespace android {
 namespace SensorServiceUtil {
@@ -35,12 +35,15 @@ namespace SensorServiceUtil {
 // behavior.
 class RecentEventLogger : public Dumpable {
 public:
-    explicit RecentEventLogger(int sensorType);
+    // The whole last event is only kept if keepLastEvent is set, for on-change sensors whose
+    // last value is sent to the clients that register for them.
+    explicit RecentEventLogger(int sensorType, bool keepLastEvent = false);
     void addEvent(const sensors_event_t& event);
 
     // Populate event with the last recorded sensor event if it is not stale. An event is
     // considered stale if the sensor has become deactivated since the event was recorded.
-    // returns true on success, false if no recent event is available or the last event is stale
+    // returns true on success, false if no recent event is available, the last event is stale or
+    // it was not kept
     bool populateLastEventIfCurrent(sensors_event_t *event) const;
     bool isEmpty() const;
     void setLastEventStale();
@@ -52,23 +55,41 @@ public:
     virtual void setFormat(std::string format) override;
 
 protected:
+    // Only what the dumps show of an event is kept: its timestamps here, and its values in
+    // mValues. Most sensors have 3 values, so this is a fraction of a whole sensors_event_t.
     struct SensorEventLog {
-        explicit SensorEventLog(const sensors_event_t& e);
+        int64_t mTimestamp;
         timespec mWallTime;
-        sensors_event_t mEvent;
     };
 
     const int mSensorType;
     const size_t mEventSize;
+    // Values of each event kept in mValues. A step count takes two, as it is 64 bits.
+    const size_t mValueCount;
+    const size_t mMaxEvents;
 
     mutable std::mutex mLock;
-    RingBuffer<SensorEventLog> mRecentEvents;
+    // Ring of the last mMaxEvents events, allocated up front. The next event goes in the slot at
+    // mNextSlot.
+    std::vector<SensorEventLog> mRecentEvents;
+    std::vector<float> mValues;
+    size_t mNextSlot;
+    size_t mEventCount;
+
+    const bool mKeepLastEvent;
+    sensors_event_t mLastEvent;
 
     bool mMaskData;
     bool mIsLastEventCurrent;
 
 private:
     static size_t logSizeBySensorType(int sensorType);
+
+    // Slot of the i-th most recent event, which must be less than mEventCount.
+    size_t slotOfRecentEvent(size_t i) const {
+        return (mNextSlot + mMaxEvents - 1 - i) % mMaxEvents;
+    }
+    const float* valuesOfSlot(size_t slot) const { return &mValues[slot * mValueCount]; }
 };
 
 } // namespace SensorServiceUtil
@@ -120,6 +120,11 @@ SensorDevice::SensorDevice()
           mRestartWaiter(new HidlServiceRegistrationWaiter()),
           mEventQueueFlag(nullptr),
           mWakeLockQueueFlag(nullptr),
+          mPendingWakeLockAcks(0),
+          mFmqWakeups(0),
+          mFmqEventsRead(0),
+          mWakeLockAckWrites(0),
+          mFmqStatsStartTime(systemTime(SYSTEM_TIME_BOOTTIME)),
           mReconnecting(false) {
     if (!connectHidlService()) {
         return;
@@ -281,6 +286,8 @@ SensorDevice::HalConnectionStatus SensorDevice::initializeHidlServiceV2_X() {
     mWakeLockQueue = std::make_unique<WakeLockQueue>(
             SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT,
             true /* configureEventFlagWord */);
+    // The acknowledgements held back were for the events of the previous HAL connection.
+    mPendingWakeLockAcks = 0;
 
     hardware::EventFlag::deleteEventFlag(&mEventQueueFlag);
     hardware::EventFlag::createEventFlag(mSensors->getEventQueue()->getEventFlagWord(), &mEventQueueFlag);
@@ -459,6 +466,18 @@ std::string SensorDevice::dump() const {
         result.appendFormat("}, selected = %.2f ms\n", info.bestBatchParams.mTBatch / 1e6f);
     }
 
+    if (mSensors->supportsMessageQueues()) {
+        const double seconds =
+                std::max(1.0, (systemTime(SYSTEM_TIME_BOOTTIME) - mFmqStatsStartTime) / 1e9);
+        const uint64_t wakeups = mFmqWakeups;
+        const uint64_t eventsRead = mFmqEventsRead;
+        result.appendFormat("Event FMQ: %" PRIu64 " wakeups (%.2f/s), %.1f events per wakeup, "
+                            "%" PRIu64 " wake lock acks\n",
+                            wakeups, wakeups / seconds,
+                            wakeups > 0 ? double(eventsRead) / wakeups : 0.0,
+                            uint64_t(mWakeLockAckWrites));
+    }
+
     return result.string();
 }
 
@@ -576,6 +595,10 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
     if (availableEvents == 0) {
         uint32_t eventFlagState = 0;
 
+        // Nothing is left to read, so the wake up events handled so far are acknowledged before
+        // waiting, letting the HAL release its wake lock.
+        flushWakeLockAcks();
+
         // Wait for events to become available. This is necessary so that the Event FMQ's read() is
         // able to be called with the correct number of events to read. If the specified number of
         // events is not available, then read() would return no events, possibly introducing
@@ -583,6 +606,7 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
         mEventQueueFlag->wait(asBaseType(EventQueueFlagBits::READ_AND_PROCESS) |
                               asBaseType(INTERNAL_WAKE), &eventFlagState);
         availableEvents = mSensors->getEventQueue()->availableToRead();
+        mFmqWakeups++;
 
         if ((eventFlagState & asBaseType(INTERNAL_WAKE)) && mReconnecting) {
             ALOGD("Event FMQ internal wake, returning from poll with no events");
@@ -603,6 +627,7 @@ ssize_t SensorDevice::pollFmq(sensors_event_t* buffer, size_t maxNumEventsToRead
                         getResolutionForSensor(buffer[i].sensor));
             }
             eventsRead = eventsToRead;
+            mFmqEventsRead += eventsToRead;
         } else {
             ALOGW("Failed to read %zu events, currently %zu events available",
                     eventsToRead, availableEvents);
@@ -641,14 +666,29 @@ Return<void> SensorDevice::onDynamicSensorsDisconnected(
 
 void SensorDevice::writeWakeLockHandled(uint32_t count) {
     if (mSensors != nullptr && mSensors->supportsMessageQueues()) {
-        if (mWakeLockQueue->write(&count)) {
-            mWakeLockQueueFlag->wake(asBaseType(WakeLockQueueFlagBits::DATA_WRITTEN));
-        } else {
-            ALOGW("Failed to write wake lock handled");
+        // The service holds its own wake lock while it handles wake up events, so acknowledging
+        // them a batch later keeps the device no more awake. If more events are already queued,
+        // the next poll reads them without waiting, and one write acknowledges both batches.
+        mPendingWakeLockAcks += count;
+        if (mSensors->getEventQueue()->availableToRead() == 0) {
+            flushWakeLockAcks();
         }
     }
 }
 
+void SensorDevice::flushWakeLockAcks() {
+    if (mPendingWakeLockAcks == 0) {
+        return;
+    }
+    if (mWakeLockQueue->write(&mPendingWakeLockAcks)) {
+        mWakeLockQueueFlag->wake(asBaseType(WakeLockQueueFlagBits::DATA_WRITTEN));
+        mWakeLockAckWrites++;
+    } else {
+        ALOGW("Failed to write wake lock handled");
+    }
+    mPendingWakeLockAcks = 0;
+}
+
 void SensorDevice::autoDisable(void *ident, int handle) {
     Mutex::Autolock _l(mLock);
     ssize_t activationIndex = mActivationCount.indexOfKey(handle);
@@ -35,6 +35,7 @@
 #include <string>
 #include <unordered_map>
 #include <algorithm> //std::max std::min
+#include <atomic>
 
 #include "RingBuffer.h"
 
@@ -88,6 +89,8 @@ public:
     int getHalDeviceVersion() const;
 
     ssize_t poll(sensors_event_t* buffer, size_t count);
+    // Acknowledges wake up events to the HAL. While the HAL has more events queued, the
+    // acknowledgements are held back and sent together once the poll thread is about to wait.
     void writeWakeLockHandled(uint32_t count);
 
     status_t activate(void* ident, int handle, int enabled);
@@ -286,6 +289,17 @@ private:
     hardware::EventFlag* mEventQueueFlag;
     hardware::EventFlag* mWakeLockQueueFlag;
 
+    // Wake up events handled but not acknowledged to the HAL yet. Only used by the poll thread.
+    uint32_t mPendingWakeLockAcks;
+    void flushWakeLockAcks();
+
+    // Times the poll thread woke up on the event FMQ, the events it read, and the writes to the
+    // wake lock FMQ, since the service started at mFmqStatsStartTime.
+    std::atomic<uint64_t> mFmqWakeups;
+    std::atomic<uint64_t> mFmqEventsRead;
+    std::atomic<uint64_t> mWakeLockAckWrites;
+    const nsecs_t mFmqStatsStartTime;
+
     std::array<Event, SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT> mEventBuffer;
 
     sp<SensorsHalDeathReceivier> mSensorsHalDeathReceiver;
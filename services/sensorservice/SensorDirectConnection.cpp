@@ -182,18 +182,30 @@ int32_t SensorService::SensorDirectConnection::configureChannel(int handle, int
 
     Mutex::Autolock _l(mConnectionLock);
     SensorDevice& dev(SensorDevice::getInstance());
-    int ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
+    int ret;
+    const auto activated = mActivated.find(handle);
+    const auto reportToken = mReportTokens.find(handle);
+    if (rateLevel != SENSOR_DIRECT_RATE_STOP && activated != mActivated.end() &&
+            activated->second == rateLevel && reportToken != mReportTokens.end()) {
+        // The sensor already reports at this rate on this channel. Configuring the HAL again
+        // would only make it return the same token, so its reports are not disturbed.
+        ret = reportToken->second;
+    } else {
+        ret = dev.configureDirectChannel(handle, getHalChannelHandle(), &config);
+    }
 
     if (rateLevel == SENSOR_DIRECT_RATE_STOP) {
         if (ret == NO_ERROR) {
             mActivated.erase(handle);
             mMicRateBackup.erase(handle);
+            mReportTokens.erase(handle);
         } else if (ret > 0) {
             ret = UNKNOWN_ERROR;
         }
     } else {
         if (ret > 0) {
             mActivated[handle] = rateLevel;
+            mReportTokens[handle] = ret;
             if (mService->isSensorInCappedSet(s.getType())) {
                 // Back up the rates that the app is allowed to have if the mic toggle is off
                 // This is used in the uncapRates() function.
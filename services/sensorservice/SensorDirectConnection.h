@@ -98,6 +98,8 @@ private:
     mutable Mutex mConnectionLock;
     std::unordered_map<int, int> mActivated;
     std::unordered_map<int, int> mActivatedBackup;
+    // Report tokens that the HAL returned for the sensors of this channel, keyed by handle.
+    std::unordered_map<int, int> mReportTokens;
     std::unordered_map<int, int> mMicRateBackup;
 
     std::atomic_bool mIsRateCappedBasedOnPermission;
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <inttypes.h>
 #include <log/log.h>
 #include <sys/socket.h>
 #include <utils/threads.h>
@@ -25,6 +26,7 @@
 #include "vec.h"
 #include "SensorEventConnection.h"
 #include "SensorDevice.h"
+#include "SensorServiceUtils.h"
 
 #define UNUSED(x) (void)(x)
 
@@ -41,7 +43,8 @@ SensorService::SensorEventConnection::SensorEventConnection(
         const String16& opPackageName, const String16& attributionTag)
     : mService(service), mUid(uid), mWakeLockRefCount(0), mHasLooperCallbacks(false),
       mDead(false), mDataInjectionMode(isDataInjectionMode), mEventCache(nullptr),
-      mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
+      mCacheStart(0), mCacheSize(0), mMaxCacheSize(0), mTimeOfLastEventDrop(0), mEventsDropped(0),
+      mCacheOverflows(0), mTotalEventsDropped(0), mSocketFullCount(0),
       mPackageName(packageName), mOpPackageName(opPackageName), mAttributionTag(attributionTag),
       mTargetSdk(kTargetSdkUnknown), mDestroyed(false) {
     mIsRateCappedBasedOnPermission = mService->isRateCappedBasedOnPermission(mOpPackageName);
@@ -93,6 +96,9 @@ void SensorService::SensorEventConnection::dump(String8& result) {
     result.appendFormat("\t %s | WakeLockRefCount %d | uid %d | cache size %d | "
             "max cache size %d\n", mPackageName.string(), mWakeLockRefCount, mUid, mCacheSize,
             mMaxCacheSize);
+    result.appendFormat("\t socket full %" PRId64 " | cache overflows %" PRId64
+            " | events dropped %" PRId64 "\n", mSocketFullCount, mCacheOverflows,
+            mTotalEventsDropped);
     for (auto& it : mSensorInfo) {
         const FlushInfo& flushInfo = it.second;
         result.appendFormat("\t %s 0x%08x | status: %s | pending flush events %d \n",
@@ -167,7 +173,19 @@ bool SensorService::SensorEventConnection::addSensor(int32_t handle) {
         mSensorInfo.count(handle) > 0) {
         return false;
     }
-    mSensorInfo[handle] = FlushInfo();
+    FlushInfo& flushInfo = mSensorInfo[handle];
+    flushInfo = FlushInfo();
+    if (mIsRateCappedBasedOnPermission &&
+            mService->isSensorInCappedSet(si->getSensor().getType())) {
+        // Events come with some jitter, so a sensor running at exactly the capped rate must not
+        // have any of them dropped.
+        constexpr nsecs_t kCappedPeriodNs = SENSOR_SERVICE_CAPPED_SAMPLING_PERIOD_NS;
+        flushInfo.mMinEventPeriodNs = kCappedPeriodNs - kCappedPeriodNs / 10;
+    }
+    if (mEventCache != nullptr) {
+        // Grow the cache for the FIFO of the new sensor now, rather than when events come in.
+        reAllocateCacheLocked();
+    }
     return true;
 }
 
@@ -223,6 +241,26 @@ void SensorService::SensorEventConnection::setFirstFlushPending(int32_t handle,
     }
 }
 
+void SensorService::SensorEventConnection::setCoalescing(int32_t handle, bool coalesce) {
+    sp<SensorInterface> si = mService->getSensorInterfaceFromHandle(handle);
+    Mutex::Autolock _l(mConnectionLock);
+    auto flushInfoIt = mSensorInfo.find(handle);
+    if (si == nullptr || flushInfoIt == mSensorInfo.end()) {
+        return;
+    }
+    FlushInfo& flushInfo = flushInfoIt->second;
+    const Sensor& sensor = si->getSensor();
+    flushInfo.mCoalescedValueSize = 0;
+    flushInfo.mHasLastValues = false;
+    if (coalesce && sensor.getReportingMode() == AREPORTING_MODE_ON_CHANGE) {
+        // The values are quantized to the resolution of the sensor, so repeats within its noise
+        // floor compare equal. A step count is 64 bits.
+        flushInfo.mCoalescedValueSize = sensor.getType() == SENSOR_TYPE_STEP_COUNTER
+                ? sizeof(uint64_t)
+                : SensorServiceUtil::eventSizeBySensorType(sensor.getType()) * sizeof(float);
+    }
+}
+
 void SensorService::SensorEventConnection::updateLooperRegistration(const sp<Looper>& looper) {
     Mutex::Autolock _l(mConnectionLock);
     updateLooperRegistrationLocked(looper);
@@ -297,6 +335,9 @@ status_t SensorService::SensorEventConnection::sendEvents(
 
     int count = 0;
     Mutex::Autolock _l(mConnectionLock);
+    // Checking the access takes the lock of the uid policy, and the access of the app does not
+    // change within a batch, so it is only checked once for all of its events.
+    const bool sensorAccess = hasSensorAccess();
     if (scratch) {
         size_t i=0;
         while (i<numEvents) {
@@ -312,12 +353,13 @@ status_t SensorService::SensorEventConnection::sendEvents(
 
             // Check if this connection has registered for this sensor. If not continue to the
             // next sensor_event.
-            if (mSensorInfo.count(sensor_handle) == 0) {
+            auto flushInfoIt = mSensorInfo.find(sensor_handle);
+            if (flushInfoIt == mSensorInfo.end()) {
                 ++i;
                 continue;
             }
 
-            FlushInfo& flushInfo = mSensorInfo[sensor_handle];
+            FlushInfo& flushInfo = flushInfoIt->second;
             // Check if there is a pending flush_complete event for this sensor on this connection.
             if (buffer[i].type == SENSOR_TYPE_META_DATA && flushInfo.mFirstFlushPending == true &&
                     mapFlushEventsToConnections[i] == this) {
@@ -344,11 +386,27 @@ status_t SensorService::SensorEventConnection::sendEvents(
                     if (mapFlushEventsToConnections[i] == this) {
                         scratch[count++] = buffer[i];
                     }
+                } else if (flushInfo.mMinEventPeriodNs > 0 &&
+                        buffer[i].timestamp - flushInfo.mLastEventTimestamp <
+                                flushInfo.mMinEventPeriodNs) {
+                    // The sensor runs faster for other connections than the rate this one is
+                    // capped to, so only every few of its events are sent on this connection.
+                } else if (flushInfo.mHasLastValues &&
+                        memcmp(buffer[i].data, flushInfo.mLastValues,
+                               flushInfo.mCoalescedValueSize) == 0) {
+                    // The on-change sensor repeated the values last sent on this connection,
+                    // which asked for its repeats to be dropped.
                 } else {
                     // Regular sensor event, just copy it to the scratch buffer after checking
                     // the AppOp.
-                    if (hasSensorAccess() && noteOpIfRequired(buffer[i])) {
+                    if (sensorAccess && noteOpIfRequired(buffer[i])) {
                         scratch[count++] = buffer[i];
+                        flushInfo.mLastEventTimestamp = buffer[i].timestamp;
+                        if (flushInfo.mCoalescedValueSize > 0) {
+                            memcpy(flushInfo.mLastValues, buffer[i].data,
+                                   flushInfo.mCoalescedValueSize);
+                            flushInfo.mHasLastValues = true;
+                        }
                     }
                 }
                 i++;
@@ -358,7 +416,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
                                         buffer[i].meta_data.sensor == sensor_handle)));
         }
     } else {
-        if (hasSensorAccess()) {
+        if (sensorAccess) {
             scratch = const_cast<sensors_event_t *>(buffer);
             count = numEvents;
         } else {
@@ -389,7 +447,7 @@ status_t SensorService::SensorEventConnection::sendEvents(
     }
 
     int index_wake_up_event = -1;
-    if (hasSensorAccess()) {
+    if (sensorAccess) {
         index_wake_up_event = findWakeUpSensorEventLocked(scratch, count);
         if (index_wake_up_event >= 0) {
             scratch[index_wake_up_event].flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
@@ -415,9 +473,11 @@ status_t SensorService::SensorEventConnection::sendEvents(
             --mTotalAcksNeeded;
 #endif
         }
+        ++mSocketFullCount;
         if (mEventCache == nullptr) {
             mMaxCacheSize = computeMaxCacheSizeLocked();
             mEventCache = new sensors_event_t[mMaxCacheSize];
+            mCacheStart = 0;
             mCacheSize = 0;
         }
         // Save the events so that they can be written later
@@ -475,36 +535,45 @@ bool SensorService::SensorEventConnection::noteOpIfRequired(const sensors_event_
     return success;
 }
 
-void SensorService::SensorEventConnection::reAllocateCacheLocked(sensors_event_t const* scratch,
-                                                                 int count) {
-    sensors_event_t *eventCache_new;
+void SensorService::SensorEventConnection::reAllocateCacheLocked() {
     const int new_cache_size = computeMaxCacheSizeLocked();
-    // Allocate new cache, copy over events from the old cache & scratch, free up memory.
-    eventCache_new = new sensors_event_t[new_cache_size];
-    memcpy(eventCache_new, mEventCache, mCacheSize * sizeof(sensors_event_t));
-    memcpy(&eventCache_new[mCacheSize], scratch, count * sizeof(sensors_event_t));
+    if (new_cache_size <= mMaxCacheSize) {
+        return;
+    }
+    // Allocate new cache, copy over the cached events in order from the oldest one, free up
+    // memory.
+    sensors_event_t* eventCache_new = new sensors_event_t[new_cache_size];
+    const int firstSpan = std::min(mCacheSize, mMaxCacheSize - mCacheStart);
+    memcpy(eventCache_new, &mEventCache[mCacheStart], firstSpan * sizeof(sensors_event_t));
+    memcpy(&eventCache_new[firstSpan], mEventCache,
+           (mCacheSize - firstSpan) * sizeof(sensors_event_t));
 
     ALOGD_IF(DEBUG_CONNECTIONS, "reAllocateCacheLocked maxCacheSize=%d %d", mMaxCacheSize,
             new_cache_size);
 
     delete[] mEventCache;
     mEventCache = eventCache_new;
-    mCacheSize += count;
+    mCacheStart = 0;
     mMaxCacheSize = new_cache_size;
 }
 
+void SensorService::SensorEventConnection::dropCachedEventsLocked(int count) {
+    for (int j = 0; j < count;) {
+        // The dropped events may wrap around the end of the cache.
+        const int span = std::min(count - j, mMaxCacheSize - mCacheStart);
+        countFlushCompleteEventsLocked(&mEventCache[mCacheStart], span);
+        mCacheStart = (mCacheStart + span) % mMaxCacheSize;
+        j += span;
+    }
+    mCacheSize -= count;
+}
+
 void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_event_t const* events,
                                                                      int count) {
     if (count <= 0) {
         return;
-    } else if (mCacheSize + count <= mMaxCacheSize) {
-        // The events fit within the current cache: add them
-        memcpy(&mEventCache[mCacheSize], events, count * sizeof(sensors_event_t));
-        mCacheSize += count;
-    } else if (mCacheSize + count <= computeMaxCacheSizeLocked()) {
-        // The events fit within a resized cache: resize the cache and add the events
-        reAllocateCacheLocked(events, count);
-    } else {
+    }
+    if (mCacheSize + count > mMaxCacheSize) {
         // The events do not fit within the cache: drop the oldest events.
         int freeSpace = mMaxCacheSize - mCacheSize;
 
@@ -514,14 +583,13 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
         // New events need to be dropped if there are more new events than the size of the cache
         int newEventsToDrop = std::max(0, count - mMaxCacheSize);
 
-        // Determine the number of new events to copy into the cache
-        int eventsToCopy = std::min(mMaxCacheSize, count);
-
+        ++mCacheOverflows;
+        mTotalEventsDropped += cachedEventsToDrop + newEventsToDrop;
         constexpr nsecs_t kMinimumTimeBetweenDropLogNs = 2 * 1000 * 1000 * 1000; // 2 sec
         if (events[0].timestamp - mTimeOfLastEventDrop > kMinimumTimeBetweenDropLogNs) {
             ALOGW("Dropping %d cached events (%d/%d) to save %d/%d new events. %d events previously"
-                    " dropped", cachedEventsToDrop, mCacheSize, mMaxCacheSize, eventsToCopy,
-                    count, mEventsDropped);
+                    " dropped", cachedEventsToDrop, mCacheSize, mMaxCacheSize,
+                    count - newEventsToDrop, count, mEventsDropped);
             mEventsDropped = 0;
             mTimeOfLastEventDrop = events[0].timestamp;
         } else {
@@ -530,21 +598,18 @@ void SensorService::SensorEventConnection::appendEventsToCacheLocked(sensors_eve
         }
 
         // Check for any flush complete events in the events that will be dropped
-        countFlushCompleteEventsLocked(mEventCache, cachedEventsToDrop);
+        dropCachedEventsLocked(cachedEventsToDrop);
         countFlushCompleteEventsLocked(events, newEventsToDrop);
-
-        // Only shift the events if they will not all be overwritten
-        if (eventsToCopy != mMaxCacheSize) {
-            memmove(mEventCache, &mEventCache[cachedEventsToDrop],
-                    (mCacheSize - cachedEventsToDrop) * sizeof(sensors_event_t));
-        }
-        mCacheSize -= cachedEventsToDrop;
-
-        // Copy the events into the cache
-        memcpy(&mEventCache[mCacheSize], &events[newEventsToDrop],
-                eventsToCopy * sizeof(sensors_event_t));
-        mCacheSize += eventsToCopy;
+        events += newEventsToDrop;
+        count -= newEventsToDrop;
     }
+
+    // Copy the events after the newest cached one, wrapping around the end of the cache.
+    const int end = (mCacheStart + mCacheSize) % mMaxCacheSize;
+    const int firstSpan = std::min(count, mMaxCacheSize - end);
+    memcpy(&mEventCache[end], events, firstSpan * sizeof(sensors_event_t));
+    memcpy(mEventCache, &events[firstSpan], (count - firstSpan) * sizeof(sensors_event_t));
+    mCacheSize += count;
 }
 
 void SensorService::SensorEventConnection::sendPendingFlushEventsLocked() {
@@ -588,15 +653,18 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
     Mutex::Autolock _l(mConnectionLock);
     // Send pending flush complete events (if any)
     sendPendingFlushEventsLocked();
-    for (int numEventsSent = 0; numEventsSent < mCacheSize;) {
-        const int numEventsToWrite = helpers::min(mCacheSize - numEventsSent, maxWriteSize);
+    const bool sensorAccess = hasSensorAccess();
+    while (mCacheSize > 0) {
+        // Each write takes contiguous events, the ones left at the end of the cache are written
+        // before the ones that wrapped around to its beginning.
+        const int numEventsToWrite = helpers::min(helpers::min(mCacheSize, maxWriteSize),
+                                                  mMaxCacheSize - mCacheStart);
+        sensors_event_t* const events = &mEventCache[mCacheStart];
         int index_wake_up_event = -1;
-        if (hasSensorAccess()) {
-            index_wake_up_event =
-                      findWakeUpSensorEventLocked(mEventCache + numEventsSent, numEventsToWrite);
+        if (sensorAccess) {
+            index_wake_up_event = findWakeUpSensorEventLocked(events, numEventsToWrite);
             if (index_wake_up_event >= 0) {
-                mEventCache[index_wake_up_event + numEventsSent].flags |=
-                        WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags |= WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 ++mWakeLockRefCount;
 #if DEBUG_CONNECTIONS
                 ++mTotalAcksNeeded;
@@ -605,13 +673,12 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
         }
 
         ssize_t size = SensorEventQueue::write(mChannel,
-                          reinterpret_cast<ASensorEvent const*>(mEventCache + numEventsSent),
-                          numEventsToWrite);
+                          reinterpret_cast<ASensorEvent const*>(events), numEventsToWrite);
         if (size < 0) {
+            ++mSocketFullCount;
             if (index_wake_up_event >= 0) {
                 // If there was a wake_up sensor_event, reset the flag.
-                mEventCache[index_wake_up_event + numEventsSent].flags  &=
-                        ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
+                events[index_wake_up_event].flags &= ~WAKE_UP_SENSOR_EVENT_NEEDS_ACK;
                 if (mWakeLockRefCount > 0) {
                     --mWakeLockRefCount;
                 }
@@ -619,21 +686,18 @@ void SensorService::SensorEventConnection::writeToSocketFromCache() {
                 --mTotalAcksNeeded;
 #endif
             }
-            memmove(mEventCache, &mEventCache[numEventsSent],
-                                 (mCacheSize - numEventsSent) * sizeof(sensors_event_t));
-            ALOGD_IF(DEBUG_CONNECTIONS, "wrote %d events from cache size==%d ",
-                    numEventsSent, mCacheSize);
-            mCacheSize -= numEventsSent;
+            ALOGD_IF(DEBUG_CONNECTIONS, "events left in cache size==%d ", mCacheSize);
             return;
         }
-        numEventsSent += numEventsToWrite;
+        mCacheStart = (mCacheStart + numEventsToWrite) % mMaxCacheSize;
+        mCacheSize -= numEventsToWrite;
 #if DEBUG_CONNECTIONS
         mEventsSentFromCache += numEventsToWrite;
 #endif
     }
-    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache size=%d ", mCacheSize);
-    // All events from the cache have been sent. Reset cache size to zero.
-    mCacheSize = 0;
+    ALOGD_IF(DEBUG_CONNECTIONS, "wrote all events from cache");
+    // All events from the cache have been sent.
+    mCacheStart = 0;
     // There are no more events in the cache. We don't need to poll for write on the fd.
     // Update Looper registration.
     updateLooperRegistrationLocked(mService->getLooper());
@@ -705,6 +769,10 @@ status_t SensorService::SensorEventConnection::enableDisable(
         }
         err = mService->enable(this, handle, samplingPeriodNs, maxBatchReportLatencyNs,
                                reservedFlags, mOpPackageName);
+        if (err == OK) {
+            setCoalescing(handle,
+                          reservedFlags & SensorEventQueue::ENABLE_FLAG_COALESCE_ON_CHANGE);
+        }
         if (err == OK && isSensorCapped) {
             if (!mIsRateCappedBasedOnPermission ||
                         requestedSamplingPeriodNs >= SENSOR_SERVICE_CAPPED_SAMPLING_PERIOD_NS) {
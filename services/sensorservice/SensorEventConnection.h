@@ -89,6 +89,10 @@ private:
     // separately before the next batch of events.
     void countFlushCompleteEventsLocked(sensors_event_t const* scratch, int numEventsDropped);
 
+    // Sets whether the events of an on-change sensor that repeat the values last sent on this
+    // connection are dropped. The next event of the sensor is always sent.
+    void setCoalescing(int32_t handle, bool coalesce);
+
     // Check if there are any wake up events in the buffer. If yes, return the index of the first
     // wake_up sensor event in the buffer else return -1.  This wake_up sensor event will have the
     // flag WAKE_UP_SENSOR_EVENT_NEEDS_ACK set. Exactly one event per packet will have the wake_up
@@ -109,13 +113,18 @@ private:
     int computeMaxCacheSizeLocked() const;
 
     // When more sensors register, the maximum cache size desired may change.  Compute max cache
-    // size, reallocate memory and copy over events from the older cache.
-    void reAllocateCacheLocked(sensors_event_t const* scratch, int count);
+    // size, reallocate memory and copy over events from the older cache. Only called when a
+    // sensor is added, so that caching events never allocates once the cache exists.
+    void reAllocateCacheLocked();
 
     // Add the events to the cache. If the cache would be exceeded, drop events at the beginning of
     // the cache.
     void appendEventsToCacheLocked(sensors_event_t const* events, int count);
 
+    // Drop the given number of the oldest events in the cache, keeping count of the flush
+    // complete events among them.
+    void dropCachedEventsLocked(int count);
+
     // LooperCallback method. If there is data to read on this fd, it is an ack from the app that it
     // has read events from a wake up sensor, decrement mWakeLockRefCount.  If this fd is available
     // for writing send the data from the cache.
@@ -174,15 +183,34 @@ private:
         // the events for the sensor are sent on that *connection*.
         bool mFirstFlushPending;
 
-        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false) {}
+        // When the rate of this sensor is capped for this connection, the shortest time between
+        // two of the events sent on it, and the timestamp of the last one sent. The sensor may run
+        // faster for other connections.
+        nsecs_t mMinEventPeriodNs;
+        nsecs_t mLastEventTimestamp;
+
+        // When the connection asked for the repeats of this on-change sensor to be dropped, the
+        // size of the values of its events, and the values last sent on the connection.
+        size_t mCoalescedValueSize;
+        bool mHasLastValues;
+        float mLastValues[16];
+
+        FlushInfo() : mPendingFlushEventsToSend(0), mFirstFlushPending(false),
+                mMinEventPeriodNs(0), mLastEventTimestamp(0), mCoalescedValueSize(0),
+                mHasLastValues(false) {}
     };
     // protected by SensorService::mLock. Key for this map is the sensor handle.
     std::unordered_map<int32_t, FlushInfo> mSensorInfo;
 
+    // Ring of the events that could not be written to the socket yet. The oldest one is at
+    // mCacheStart, and the newer ones wrap around the end of the cache.
     sensors_event_t *mEventCache;
-    int mCacheSize, mMaxCacheSize;
+    int mCacheStart, mCacheSize, mMaxCacheSize;
     int64_t mTimeOfLastEventDrop;
     int mEventsDropped;
+    // Times the cache was full when events were added, events dropped because of it and writes
+    // that failed because the socket was full, over the life of the connection.
+    int64_t mCacheOverflows, mTotalEventsDropped, mSocketFullCount;
     String8 mPackageName;
     const String16 mOpPackageName;
     const String16 mAttributionTag;
@@ -29,6 +29,7 @@ ANDROID_SINGLETON_STATIC_INSTANCE(SensorFusion)
 SensorFusion::SensorFusion()
     : mSensorDevice(SensorDevice::getInstance()),
       mAttitude(mAttitudes[FUSION_9AXIS]),
+      mBatchCount(0), mEventCount(0), mRotationMatrixCount(0),
       mGyroTime(0), mAccTime(0)
 {
     sensor_t const* list;
@@ -38,6 +39,7 @@ SensorFusion::SensorFusion()
     mEnabled[FUSION_9AXIS] = false;
     mEnabled[FUSION_NOMAG] = false;
     mEnabled[FUSION_NOGYRO] = false;
+    invalidateRotationMatrices();
 
     if (count > 0) {
         for (size_t i=0 ; i<size_t(count) ; i++) {
@@ -71,7 +73,14 @@ SensorFusion::SensorFusion()
     }
 }
 
+void SensorFusion::invalidateRotationMatrices() {
+    for (int i = 0; i<NUM_FUSION_MODE; ++i) {
+        mRotationMatrixValid[i] = false;
+    }
+}
+
 void SensorFusion::process(const sensors_event_t& event) {
+    invalidateRotationMatrices();
 
     if (event.type == mGyro.getType()) {
         float dT;
@@ -120,6 +129,14 @@ void SensorFusion::process(const sensors_event_t& event) {
     }
 }
 
+void SensorFusion::process(const sensors_event_t* events, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        process(events[i]);
+    }
+    mBatchCount++;
+    mEventCount += count;
+}
+
 template <typename T> inline T min(T a, T b) { return a<b ? a : b; }
 template <typename T> inline T max(T a, T b) { return a>b ? a : b; }
 
@@ -145,6 +162,7 @@ status_t SensorFusion::activate(int mode, void* ident, bool enabled) {
         mEnabled[mode] = newState;
         if (newState) {
             mFusions[mode].init(mode);
+            mRotationMatrixValid[mode] = false;
         }
     }
 
@@ -236,6 +254,11 @@ void SensorFusion::dump(String8& result) const {
             fusion_nogyro.getBias().x,
             fusion_nogyro.getBias().y,
             fusion_nogyro.getBias().z);
+
+    // Each batch of events goes through the fusion once, whichever virtual sensors are active,
+    // and each rotation matrix is worked out at most once per batch.
+    result.appendFormat("fusion batches %zu, events %zu, rotation matrices %zu\n",
+            mBatchCount, mEventCount, mRotationMatrixCount);
 }
 
 void SensorFusion::dumpFusion(FUSION_MODE mode, util::ProtoOutputStream* proto) const {
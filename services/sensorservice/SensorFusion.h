@@ -50,6 +50,16 @@ class SensorFusion : public Singleton<SensorFusion> {
     vec4_t &mAttitude;
     vec4_t mAttitudes[NUM_FUSION_MODE];
 
+    // Rotation matrices of the fusions, worked out on first use after each batch and shared by
+    // all the virtual sensors that derive their events from them.
+    mutable mat33_t mRotationMatrices[NUM_FUSION_MODE];
+    mutable bool mRotationMatrixValid[NUM_FUSION_MODE];
+
+    // Batches and events processed, and rotation matrices worked out, since boot.
+    size_t mBatchCount;
+    size_t mEventCount;
+    mutable size_t mRotationMatrixCount;
+
     SortedVector<void*> mClients[3];
 
     float mEstimatedGyroRate;
@@ -60,8 +70,12 @@ class SensorFusion : public Singleton<SensorFusion> {
 
     SensorFusion();
 
+    void invalidateRotationMatrices();
+
 public:
     void process(const sensors_event_t& event);
+    // Processes a batch of events, in order. The attitudes are those after the last event.
+    void process(const sensors_event_t* events, size_t count);
 
     bool isEnabled() const {
         return mEnabled[FUSION_9AXIS] ||
@@ -74,7 +88,12 @@ public:
     }
 
     mat33_t getRotationMatrix(int mode = FUSION_9AXIS) const {
-        return mFusions[mode].getRotationMatrix();
+        if (!mRotationMatrixValid[mode]) {
+            mRotationMatrices[mode] = mFusions[mode].getRotationMatrix();
+            mRotationMatrixValid[mode] = true;
+            mRotationMatrixCount++;
+        }
+        return mRotationMatrices[mode];
     }
 
     vec4_t getAttitude(int mode = FUSION_9AXIS) const {
@@ -350,7 +350,9 @@ const Sensor& SensorService::registerSensor(SensorInterface* s, bool isDebug, bo
     int handle = s->getSensor().getHandle();
     int type = s->getSensor().getType();
     if (mSensors.add(handle, s, isDebug, isVirtual)){
-        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type));
+        const bool isOnChange =
+                s->getSensor().getReportingMode() == AREPORTING_MODE_ON_CHANGE;
+        mRecentEvent.emplace(handle, new SensorServiceUtil::RecentEventLogger(type, isOnChange));
         return s->getSensor();
     } else {
         return mSensors.getNonSensor();
@@ -952,9 +954,7 @@ bool SensorService::threadLoop() {
                 size_t k = 0;
                 SensorFusion& fusion(SensorFusion::getInstance());
                 if (fusion.isEnabled()) {
-                    for (size_t i=0 ; i<size_t(count) ; i++) {
-                        fusion.process(event[i]);
-                    }
+                    fusion.process(event, size_t(count));
                 }
                 for (size_t i=0 ; i<size_t(count) && k<minBufferSize ; i++) {
                     for (int handle : mActiveVirtualSensors) {
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sensor/Sensor.h>
+#include <sensor/SensorEventQueue.h>
+#include <sensor/SensorManager.h>
+#include <unistd.h>
+#include <utils/Timers.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace android {
+
+namespace {
+
+// Time over which the events of each iteration are received.
+constexpr nsecs_t WINDOW_NS = ms2ns(500);
+
+// Longest time to wait for the first events after the sensor is enabled.
+constexpr nsecs_t FIRST_EVENT_TIMEOUT_NS = s2ns(2);
+
+// Sensor timestamps are in the elapsed realtime base, which includes the time spent suspended.
+nsecs_t elapsedRealtimeNanos() {
+    return systemTime(SYSTEM_TIME_BOOTTIME);
+}
+
+// Path of the stat file of the sensor service thread, or an empty string if it was not found.
+// It can only be read as root.
+std::string findSensorServiceThreadStat() {
+    std::unique_ptr<DIR, decltype(&closedir)> procDir(opendir("/proc"), closedir);
+    if (procDir == nullptr) {
+        return "";
+    }
+    while (dirent* process = readdir(procDir.get())) {
+        const std::string taskPath = std::string("/proc/") + process->d_name + "/task";
+        std::unique_ptr<DIR, decltype(&closedir)> taskDir(opendir(taskPath.c_str()), closedir);
+        if (taskDir == nullptr) {
+            continue;
+        }
+        while (dirent* thread = readdir(taskDir.get())) {
+            const std::string threadPath = taskPath + "/" + thread->d_name;
+            std::string comm;
+            if (base::ReadFileToString(threadPath + "/comm", &comm) &&
+                base::Trim(comm) == "SensorService") {
+                return threadPath + "/stat";
+            }
+        }
+    }
+    return "";
+}
+
+// CPU time that the thread with the given stat file has used so far, or -1 if it is unknown.
+nsecs_t readThreadCpuTime(const std::string& statPath) {
+    std::string stat;
+    if (statPath.empty() || !base::ReadFileToString(statPath, &stat)) {
+        return -1;
+    }
+    // The name of the thread is in parentheses and may contain spaces, the fields after it are
+    // the state and then the 10 fields before utime and stime.
+    const size_t nameEnd = stat.rfind(')');
+    if (nameEnd == std::string::npos) {
+        return -1;
+    }
+    const std::vector<std::string> fields = base::Split(stat.substr(nameEnd + 2), " ");
+    if (fields.size() < 13) {
+        return -1;
+    }
+    const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    const int64_t ticks = std::stoll(fields[11]) + std::stoll(fields[12]);
+    return ticks * s2ns(1) / ticksPerSecond;
+}
+
+/**
+ * Delivers the events of the accelerometer, through the sensor service, to several connections at
+ * once, as happens when several apps listen to the same sensor. The events come from the sensors
+ * HAL of the device, at the given sampling period and batching latency.
+ *
+ * The latency of an event is the time from its HAL timestamp to its read from the queue of a
+ * connection. An event received by some connections but not by others was dropped by the service
+ * for them, so the drop rate compares each connection with the one that received the most events.
+ * The CPU time per event is the one of the sensor service thread, when running as root.
+ *
+ * Sampling periods under 5ms are capped unless the benchmark has HIGH_SAMPLING_RATE_SENSORS.
+ */
+void BM_AccelerometerDelivery(benchmark::State& state) {
+    const size_t connectionCount = static_cast<size_t>(state.range(0));
+    const int32_t samplingPeriodUs = static_cast<int32_t>(state.range(1));
+    const int64_t maxReportLatencyUs = state.range(2);
+
+    SensorManager& manager =
+            SensorManager::getInstanceForPackage(String16("SensorService_benchmark"));
+    Sensor const* accelerometer = manager.getDefaultSensor(ASENSOR_TYPE_ACCELEROMETER);
+    if (accelerometer == nullptr) {
+        state.SkipWithError("There is no accelerometer");
+        return;
+    }
+
+    std::vector<sp<SensorEventQueue>> queues;
+    std::vector<pollfd> fds;
+    for (size_t i = 0; i < connectionCount; i++) {
+        sp<SensorEventQueue> queue = manager.createEventQueue();
+        if (queue == nullptr ||
+            queue->enableSensor(accelerometer->getHandle(), samplingPeriodUs, maxReportLatencyUs,
+                                /*reservedFlags*/ 0) != OK) {
+            state.SkipWithError("Could not enable the accelerometer");
+            return;
+        }
+        fds.push_back({.fd = queue->getFd(), .events = POLLIN});
+        queues.push_back(std::move(queue));
+    }
+
+    const std::string statPath = findSensorServiceThreadStat();
+    std::vector<nsecs_t> latencies;
+    std::vector<size_t> eventCounts(connectionCount);
+    size_t totalEvents = 0;
+    size_t droppedEvents = 0;
+    nsecs_t serviceCpuTime = 0;
+    bool receivedAny = false;
+    ASensorEvent events[SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT];
+
+    for (auto _ : state) {
+        std::fill(eventCounts.begin(), eventCounts.end(), 0);
+        const nsecs_t cpuTimeBefore = readThreadCpuTime(statPath);
+        const nsecs_t start = elapsedRealtimeNanos();
+        const nsecs_t end = start + (receivedAny ? WINDOW_NS : FIRST_EVENT_TIMEOUT_NS);
+        for (nsecs_t now = start; now < end; now = elapsedRealtimeNanos()) {
+            if (poll(fds.data(), fds.size(), static_cast<int>(ns2ms(end - now)) + 1) <= 0) {
+                continue;
+            }
+            for (size_t i = 0; i < connectionCount; i++) {
+                if (!(fds[i].revents & POLLIN)) {
+                    continue;
+                }
+                const ssize_t count =
+                        queues[i]->read(events, SensorEventQueue::MAX_RECEIVE_BUFFER_EVENT_COUNT);
+                const nsecs_t readTime = elapsedRealtimeNanos();
+                for (ssize_t j = 0; j < count; j++) {
+                    if (events[j].type != ASENSOR_TYPE_ACCELEROMETER) {
+                        continue;
+                    }
+                    latencies.push_back(readTime - events[j].timestamp);
+                    eventCounts[i]++;
+                }
+            }
+        }
+        const nsecs_t cpuTimeAfter = readThreadCpuTime(statPath);
+        if (cpuTimeBefore >= 0 && cpuTimeAfter >= 0) {
+            serviceCpuTime += cpuTimeAfter - cpuTimeBefore;
+        }
+
+        const size_t mostEvents = *std::max_element(eventCounts.begin(), eventCounts.end());
+        if (mostEvents == 0) {
+            state.SkipWithError("Timed out waiting for the accelerometer events");
+            break;
+        }
+        receivedAny = true;
+        for (size_t count : eventCounts) {
+            totalEvents += count;
+            droppedEvents += mostEvents - count;
+        }
+    }
+
+    for (const sp<SensorEventQueue>& queue : queues) {
+        queue->disableSensor(accelerometer->getHandle());
+    }
+
+    state.SetItemsProcessed(static_cast<int64_t>(totalEvents));
+    if (latencies.empty()) {
+        return;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](double fraction) {
+        const size_t index = std::min(latencies.size() - 1,
+                                      static_cast<size_t>(fraction * latencies.size()));
+        return static_cast<double>(ns2us(latencies[index]));
+    };
+    state.counters["LatencyP50Us"] = percentile(0.5);
+    state.counters["LatencyP90Us"] = percentile(0.9);
+    state.counters["LatencyP99Us"] = percentile(0.99);
+    state.counters["DropRate"] =
+            static_cast<double>(droppedEvents) / static_cast<double>(totalEvents + droppedEvents);
+    if (!statPath.empty()) {
+        state.counters["ServiceCpuNsPerEvent"] =
+                static_cast<double>(serviceCpuTime) / static_cast<double>(totalEvents);
+    }
+}
+BENCHMARK(BM_AccelerometerDelivery)
+        ->ArgNames({"connections", "periodUs", "latencyUs"})
+        ->Args({1, 5000, 0})
+        ->Args({8, 5000, 0})
+        ->Args({32, 5000, 0})
+        ->Args({8, 5000, 100000})
+        ->Args({8, 20000, 0})
+        ->Iterations(10)
+        ->Unit(benchmark::kMillisecond);
+
+} // namespace
+
+} // namespace android
+
+BENCHMARK_MAIN();
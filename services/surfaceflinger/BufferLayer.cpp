@@ -545,17 +545,15 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime,
     gatherBufferInfo();
 
     mRefreshPending = true;
-    if (oldBufferInfo.mBuffer == nullptr) {
-        // the first time we receive a buffer, we need to trigger a
-        // geometry invalidation.
-        recomputeVisibleRegions = true;
-    }
+    // the first time we receive a buffer, we need to trigger a
+    // geometry invalidation.
+    bool geometryChanged = oldBufferInfo.mBuffer == nullptr;
 
     if ((mBufferInfo.mCrop != oldBufferInfo.mCrop) ||
         (mBufferInfo.mTransform != oldBufferInfo.mTransform) ||
         (mBufferInfo.mScaleMode != oldBufferInfo.mScaleMode) ||
         (mBufferInfo.mTransformToDisplayInverse != oldBufferInfo.mTransformToDisplayInverse)) {
-        recomputeVisibleRegions = true;
+        geometryChanged = true;
     }
 
     if (oldBufferInfo.mBuffer != nullptr) {
@@ -563,10 +561,16 @@ bool BufferLayer::latchBuffer(bool& recomputeVisibleRegions, nsecs_t latchTime,
         uint32_t bufHeight = mBufferInfo.mBuffer->getBuffer()->getHeight();
         if (bufWidth != uint32_t(oldBufferInfo.mBuffer->getBuffer()->width) ||
             bufHeight != uint32_t(oldBufferInfo.mBuffer->getBuffer()->height)) {
-            recomputeVisibleRegions = true;
+            geometryChanged = true;
         }
     }
 
+    if (geometryChanged) {
+        recomputeVisibleRegions = true;
+        // The source bounds and buffer size of the layer follow the latched buffer.
+        invalidateBounds();
+    }
+
     if (oldOpacity != isOpaque(s)) {
         recomputeVisibleRegions = true;
     }
@@ -853,6 +857,7 @@ void BufferLayer::updateCloneBufferInfo() {
     mDrawingState.zOrderRelativeOf = tmpZOrderRelativeOf;
     mDrawingState.zOrderRelatives = tmpZOrderRelatives;
     mDrawingState.inputInfo = tmpInputInfo;
+    invalidateBounds();
 }
 
 void BufferLayer::setTransformHint(ui::Transform::RotationFlags displayTransformHint) {
@@ -441,12 +441,14 @@ bool BufferStateLayer::setBuffer(const std::shared_ptr<renderengine::ExternalTex
             // If mDrawingState has a buffer, and we are about to update again
             // before swapping to drawing state, then the first buffer will be
             // dropped and we should decrement the pending buffer count and
-            // call any release buffer callbacks if set.
-            callReleaseBufferCallback(mDrawingState.releaseBufferListener,
-                                      mDrawingState.buffer->getBuffer(), mDrawingState.frameNumber,
-                                      mDrawingState.acquireFence, mTransformHint,
-                                      mFlinger->getMaxAcquiredBufferCountForCurrentRefreshRate(
-                                              mOwnerUid));
+            // call any release buffer callbacks if set. The release is sent together with the
+            // others for the same listener once the commit is done.
+            mFlinger->getTransactionCallbackInvoker().addReleaseCallback(
+                    mDrawingState.releaseBufferListener,
+                    {{mDrawingState.buffer->getBuffer()->getId(), mDrawingState.frameNumber},
+                     mDrawingState.acquireFence ? mDrawingState.acquireFence : Fence::NO_FENCE,
+                     mTransformHint,
+                     mFlinger->getMaxAcquiredBufferCountForCurrentRefreshRate(mOwnerUid)});
             decrementPendingBufferCount();
             if (mDrawingState.bufferSurfaceFrameTX != nullptr &&
                 mDrawingState.bufferSurfaceFrameTX->getPresentState() != PresentState::Presented) {
@@ -19,8 +19,14 @@
 #define LOG_TAG "ClientCache"
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <algorithm>
 #include <cinttypes>
 
+#include <android-base/properties.h>
+#include <gui/ITransactionCompletedListener.h>
+#include <ui/PixelFormat.h>
+#include <utils/Trace.h>
+
 #include "ClientCache.h"
 
 namespace android {
@@ -29,7 +35,26 @@ using base::StringAppendF;
 
 ANDROID_SINGLETON_STATIC_INSTANCE(ClientCache);
 
-ClientCache::ClientCache() : mDeathRecipient(new CacheDeathRecipient) {}
+namespace {
+
+uint64_t getBufferSize(const GraphicBuffer& buffer) {
+    uint32_t bytesPerPixel = android::bytesPerPixel(buffer.getPixelFormat());
+    if (bytesPerPixel == 0) {
+        // YUV formats have no bytes per pixel, but take up to 2 bytes per pixel.
+        bytesPerPixel = 2;
+    }
+    return static_cast<uint64_t>(buffer.getStride()) * buffer.getHeight() *
+            buffer.getLayerCount() * bytesPerPixel;
+}
+
+} // namespace
+
+ClientCache::ClientCache()
+      : mMaxSize(static_cast<uint64_t>(
+                         std::max(base::GetIntProperty("debug.sf.client_cache_max_size_mb", 1024),
+                                  0))
+                 << 20),
+        mDeathRecipient(new CacheDeathRecipient) {}
 
 bool ClientCache::getBuffer(const client_cache_t& cacheId,
                             ClientCacheBuffer** outClientCacheBuffer) {
@@ -44,7 +69,7 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
         return false;
     }
 
-    auto& processBuffers = it->second.second;
+    auto& processBuffers = it->second.buffers;
 
     auto bufItr = processBuffers.find(id);
     if (bufItr == processBuffers.end()) {
@@ -58,6 +83,16 @@ bool ClientCache::getBuffer(const client_cache_t& cacheId,
 }
 
 bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer) {
+    return add(cacheId, buffer, nullptr);
+}
+
+bool ClientCache::add(const client_cache_t& cacheId,
+                      const std::shared_ptr<renderengine::ExternalTexture>& texture) {
+    return add(cacheId, texture ? texture->getBuffer() : nullptr, texture);
+}
+
+bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer,
+                      std::shared_ptr<renderengine::ExternalTexture> texture) {
     auto& [processToken, id] = cacheId;
     if (processToken == nullptr) {
         ALOGE("failed to cache buffer: invalid process token");
@@ -69,51 +104,151 @@ bool ClientCache::add(const client_cache_t& cacheId, const sp<GraphicBuffer>& bu
         return false;
     }
 
-    std::lock_guard lock(mMutex);
-    sp<IBinder> token;
+    std::vector<ErasedBuffer> evictedBuffers;
+    {
+        std::lock_guard lock(mMutex);
+        sp<IBinder> token;
+
+        // If this is a new process token, set a death recipient. If the client process dies, we
+        // will get a callback through binderDied.
+        auto it = mBuffers.find(processToken);
+        if (it == mBuffers.end()) {
+            token = processToken.promote();
+            if (!token) {
+                ALOGE("failed to cache buffer: invalid token");
+                return false;
+            }
 
-    // If this is a new process token, set a death recipient. If the client process dies, we will
-    // get a callback through binderDied.
-    auto it = mBuffers.find(processToken);
-    if (it == mBuffers.end()) {
-        token = processToken.promote();
-        if (!token) {
-            ALOGE("failed to cache buffer: invalid token");
-            return false;
+            status_t err = token->linkToDeath(mDeathRecipient);
+            if (err != NO_ERROR) {
+                ALOGE("failed to cache buffer: could not link to death");
+                return false;
+            }
+            auto [itr, success] = mBuffers.emplace(processToken, ProcessBuffers{.token = token});
+            LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
+            it = itr;
         }
 
-        status_t err = token->linkToDeath(mDeathRecipient);
-        if (err != NO_ERROR) {
-            ALOGE("failed to cache buffer: could not link to death");
+        auto& processBuffers = it->second;
+
+        if (processBuffers.buffers.size() > BUFFER_CACHE_MAX_SIZE) {
+            ALOGE("failed to cache buffer: cache is full");
             return false;
         }
-        auto [itr, success] =
-                mBuffers.emplace(processToken,
-                                 std::make_pair(token,
-                                                std::unordered_map<uint64_t, ClientCacheBuffer>()));
-        LOG_ALWAYS_FATAL_IF(!success, "failed to insert new process into client cache");
-        it = itr;
-    }
 
-    auto& processBuffers = it->second.second;
+        if (!texture) {
+            LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
+                                "Attempted to build the ClientCache before a RenderEngine instance "
+                                "was ready!");
+            texture = std::make_shared<
+                    renderengine::ExternalTexture>(buffer, *mRenderEngine,
+                                                   renderengine::ExternalTexture::Usage::READABLE);
+        }
+
+        ClientCacheBuffer& cacheBuffer = processBuffers.buffers[id];
+        const uint64_t size = getBufferSize(*buffer);
+        processBuffers.size = processBuffers.size - cacheBuffer.size + size;
+        mTotalSize = mTotalSize - cacheBuffer.size + size;
+        cacheBuffer.buffer = std::move(texture);
+        cacheBuffer.size = size;
+        cacheBuffer.lastUsed = ++mCounter;
 
-    if (processBuffers.size() > BUFFER_CACHE_MAX_SIZE) {
-        ALOGE("failed to cache buffer: cache is full");
-        return false;
+        if (mMaxSize != 0 && mTotalSize > mMaxSize) {
+            evictedBuffers = evictLocked(cacheId);
+        }
     }
 
-    LOG_ALWAYS_FATAL_IF(mRenderEngine == nullptr,
-                        "Attempted to build the ClientCache before a RenderEngine instance was "
-                        "ready!");
-    processBuffers[id].buffer = std::make_shared<
-            renderengine::ExternalTexture>(buffer, *mRenderEngine,
-                                           renderengine::ExternalTexture::Usage::READABLE);
+    notifyErased(evictedBuffers, true /* notifyProcess */);
     return true;
 }
 
+ClientCache::ErasedBuffer ClientCache::eraseLocked(const wp<IBinder>& processToken,
+                                                   ProcessBuffers& processBuffers, uint64_t id) {
+    ErasedBuffer erasedBuffer{.cacheId = {processToken, id}};
+
+    const auto it = processBuffers.buffers.find(id);
+    if (it == processBuffers.buffers.end()) {
+        return erasedBuffer;
+    }
+
+    auto& [_, buf] = *it;
+    for (auto& recipient : buf.recipients) {
+        sp<ErasedRecipient> erasedRecipient = recipient.promote();
+        if (erasedRecipient) {
+            erasedBuffer.recipients.push_back(erasedRecipient);
+        }
+    }
+
+    processBuffers.size -= buf.size;
+    mTotalSize -= buf.size;
+    processBuffers.buffers.erase(it);
+    return erasedBuffer;
+}
+
+std::vector<ClientCache::ErasedBuffer> ClientCache::evictLocked(const client_cache_t& newBuffer) {
+    ATRACE_CALL();
+
+    std::vector<std::pair<const wp<IBinder>, ProcessBuffers>*> processes;
+    processes.reserve(mBuffers.size());
+    for (auto& entry : mBuffers) {
+        processes.push_back(&entry);
+    }
+    std::sort(processes.begin(), processes.end(), [](const auto* lhs, const auto* rhs) {
+        return lhs->second.size > rhs->second.size;
+    });
+
+    std::vector<ErasedBuffer> evictedBuffers;
+    for (auto* process : processes) {
+        auto& [processToken, processBuffers] = *process;
+        while (mTotalSize > mMaxSize) {
+            // Buffers referenced outside of the cache would not free any memory.
+            std::optional<uint64_t> evictedId;
+            uint64_t evictedLastUsed = 0;
+            for (const auto& [id, buf] : processBuffers.buffers) {
+                if (processToken == newBuffer.token && id == newBuffer.id) {
+                    continue;
+                }
+                if (buf.buffer.use_count() == 1 && (!evictedId || buf.lastUsed < evictedLastUsed)) {
+                    evictedId = id;
+                    evictedLastUsed = buf.lastUsed;
+                }
+            }
+            if (!evictedId) {
+                break;
+            }
+
+            ALOGV("evicting buffer %" PRIu64 " over budget", *evictedId);
+            evictedBuffers.push_back(eraseLocked(processToken, processBuffers, *evictedId));
+            mEvictionCount++;
+        }
+        if (mTotalSize <= mMaxSize) {
+            break;
+        }
+    }
+
+    ALOGW_IF(mTotalSize > mMaxSize, "over budget with %" PRIu64 " bytes of buffers in use",
+             mTotalSize);
+    return evictedBuffers;
+}
+
+void ClientCache::notifyErased(const std::vector<ErasedBuffer>& erasedBuffers,
+                               bool notifyProcess) {
+    for (const auto& [cacheId, recipients] : erasedBuffers) {
+        for (auto& recipient : recipients) {
+            recipient->bufferErased(cacheId);
+        }
+        if (!notifyProcess) {
+            continue;
+        }
+        if (sp<IBinder> token = cacheId.token.promote()) {
+            interface_cast<ITransactionCompletedListener>(token)->onBufferUncached(cacheId.id);
+        }
+    }
+}
+
 void ClientCache::erase(const client_cache_t& cacheId) {
     auto& [processToken, id] = cacheId;
-    std::vector<sp<ErasedRecipient>> pendingErase;
+    ErasedBuffer erasedBuffer;
     {
         std::lock_guard lock(mMutex);
         ClientCacheBuffer* buf = nullptr;
@@ -122,19 +257,11 @@ void ClientCache::erase(const client_cache_t& cacheId) {
             return;
         }
 
-        for (auto& recipient : buf->recipients) {
-            sp<ErasedRecipient> erasedRecipient = recipient.promote();
-            if (erasedRecipient) {
-                pendingErase.push_back(erasedRecipient);
-            }
-        }
-
-        mBuffers[processToken].second.erase(id);
+        erasedBuffer = eraseLocked(processToken, mBuffers[processToken], id);
     }
 
-    for (auto& recipient : pendingErase) {
-        recipient->bufferErased(cacheId);
-    }
+    // The process uncached the buffer itself.
+    notifyErased({erasedBuffer}, false /* notifyProcess */);
 }
 
 std::shared_ptr<renderengine::ExternalTexture> ClientCache::get(const client_cache_t& cacheId) {
@@ -146,6 +273,7 @@ std::shared_ptr<renderengine::ExternalTexture> ClientCache::get(const client_cac
         return nullptr;
     }
 
+    buf->lastUsed = ++mCounter;
     return buf->buffer;
 }
 
@@ -176,7 +304,7 @@ void ClientCache::unregisterErasedRecipient(const client_cache_t& cacheId,
 }
 
 void ClientCache::removeProcess(const wp<IBinder>& processToken) {
-    std::vector<std::pair<sp<ErasedRecipient>, client_cache_t>> pendingErase;
+    std::vector<ErasedBuffer> pendingErase;
     {
         if (processToken == nullptr) {
             ALOGE("failed to remove process, invalid (nullptr) process token");
@@ -189,21 +317,15 @@ void ClientCache::removeProcess(const wp<IBinder>& processToken) {
             return;
         }
 
-        for (auto& [id, clientCacheBuffer] : itr->second.second) {
-            client_cache_t cacheId = {processToken, id};
-            for (auto& recipient : clientCacheBuffer.recipients) {
-                sp<ErasedRecipient> erasedRecipient = recipient.promote();
-                if (erasedRecipient) {
-                    pendingErase.emplace_back(erasedRecipient, cacheId);
-                }
-            }
+        auto& processBuffers = itr->second;
+        while (!processBuffers.buffers.empty()) {
+            pendingErase.push_back(eraseLocked(processToken, processBuffers,
+                                               processBuffers.buffers.begin()->first));
         }
         mBuffers.erase(itr);
     }
 
-    for (auto& [recipient, cacheId] : pendingErase) {
-        recipient->bufferErased(cacheId);
-    }
+    notifyErased(pendingErase, false /* notifyProcess */);
 }
 
 void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
@@ -212,14 +334,27 @@ void ClientCache::CacheDeathRecipient::binderDied(const wp<IBinder>& who) {
 
 void ClientCache::dump(std::string& result) {
     std::lock_guard lock(mMutex);
-    for (auto i : mBuffers) {
-        const sp<IBinder>& cacheOwner = i.second.first;
-        StringAppendF(&result," Cache owner: %p\n", cacheOwner.get());
-        auto &buffers = i.second.second;
-        for (auto& [id, clientCacheBuffer] : buffers) {
-            StringAppendF(&result, "\t ID: %d, Width/Height: %d,%d\n", (int)id,
-                          (int)clientCacheBuffer.buffer->getBuffer()->getWidth(),
-                          (int)clientCacheBuffer.buffer->getBuffer()->getHeight());
+    StringAppendF(&result, " Total size: %" PRIu64 " KiB, budget: %" PRIu64 " KiB, evictions: %u\n",
+                  mTotalSize >> 10, mMaxSize >> 10, mEvictionCount);
+
+    // List the biggest holders first
+    std::vector<const ProcessBuffers*> processes;
+    processes.reserve(mBuffers.size());
+    for (const auto& [_, processBuffers] : mBuffers) {
+        processes.push_back(&processBuffers);
+    }
+    std::sort(processes.begin(), processes.end(),
+              [](const auto* lhs, const auto* rhs) { return lhs->size > rhs->size; });
+
+    for (const ProcessBuffers* processBuffers : processes) {
+        StringAppendF(&result, " Cache owner: %p, %zu buffers, %" PRIu64 " KiB\n",
+                      processBuffers->token.get(), processBuffers->buffers.size(),
+                      processBuffers->size >> 10);
+        for (auto& [id, clientCacheBuffer] : processBuffers->buffers) {
+            StringAppendF(&result, "\t ID: %d, Width/Height: %d,%d, Size: %" PRIu64 " KiB\n",
+                          (int)id, (int)clientCacheBuffer.buffer->getBuffer()->getWidth(),
+                          (int)clientCacheBuffer.buffer->getBuffer()->getHeight(),
+                          clientCacheBuffer.size >> 10);
         }
     }
 }
@@ -28,6 +28,7 @@
 #include <mutex>
 #include <set>
 #include <unordered_map>
+#include <vector>
 
 #define BUFFER_CACHE_MAX_SIZE 64
 
@@ -38,6 +39,9 @@ public:
     ClientCache();
 
     bool add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer);
+    // Caches a buffer that was already imported into RenderEngine.
+    bool add(const client_cache_t& cacheId,
+             const std::shared_ptr<renderengine::ExternalTexture>& texture);
     void erase(const client_cache_t& cacheId);
 
     std::shared_ptr<renderengine::ExternalTexture> get(const client_cache_t& cacheId);
@@ -66,11 +70,40 @@ private:
     struct ClientCacheBuffer {
         std::shared_ptr<renderengine::ExternalTexture> buffer;
         std::set<wp<ErasedRecipient>> recipients;
+        // Estimated size of the buffer, in bytes.
+        uint64_t size = 0;
+        // Value of mCounter when the buffer was last cached or looked up.
+        uint64_t lastUsed = 0;
     };
-    std::map<wp<IBinder> /*caching process*/,
-             std::pair<sp<IBinder> /*strong ref to caching process*/,
-                       std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer>>>
-            mBuffers GUARDED_BY(mMutex);
+    struct ProcessBuffers {
+        // Strong ref to the caching process, which is its transaction completed listener.
+        sp<IBinder> token;
+        std::unordered_map<uint64_t /*cache id*/, ClientCacheBuffer> buffers;
+        // Total size of buffers, in bytes.
+        uint64_t size = 0;
+    };
+    std::map<wp<IBinder> /*caching process*/, ProcessBuffers> mBuffers GUARDED_BY(mMutex);
+
+    // Buffers cached by all processes may take up to this many bytes, or any amount if zero. When
+    // over budget, the least-recently used buffers of the process caching the most bytes are
+    // evicted, and the process is notified through ITransactionCompletedListener so that it sends
+    // them again the next time. Buffers still held by a layer are not evicted.
+    uint64_t mMaxSize = 0;
+    uint64_t mTotalSize GUARDED_BY(mMutex) = 0;
+    uint64_t mCounter GUARDED_BY(mMutex) = 0;
+    uint32_t mEvictionCount GUARDED_BY(mMutex) = 0;
+
+    struct ErasedBuffer {
+        client_cache_t cacheId;
+        std::vector<sp<ErasedRecipient>> recipients;
+    };
+    // Removes the buffer from the cache, and returns the recipients to notify after unlocking.
+    ErasedBuffer eraseLocked(const wp<IBinder>& processToken, ProcessBuffers&,
+                             uint64_t id) REQUIRES(mMutex);
+    // Evicts buffers other than the newly cached one until the cache is within budget, and returns
+    // the evicted buffers.
+    std::vector<ErasedBuffer> evictLocked(const client_cache_t& newBuffer) REQUIRES(mMutex);
+    void notifyErased(const std::vector<ErasedBuffer>&, bool notifyProcess);
 
     class CacheDeathRecipient : public IBinder::DeathRecipient {
     public:
@@ -82,6 +115,10 @@ private:
 
     bool getBuffer(const client_cache_t& cacheId, ClientCacheBuffer** outClientCacheBuffer)
             REQUIRES(mMutex);
+
+    // Imports the buffer into RenderEngine unless the texture is given.
+    bool add(const client_cache_t& cacheId, const sp<GraphicBuffer>& buffer,
+             std::shared_ptr<renderengine::ExternalTexture> texture);
 };
 
 }; // namespace android
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <chrono>
+#include <mutex>
 #include <optional>
 #include <vector>
 
@@ -90,6 +91,19 @@ struct CompositionRefreshArgs {
 
     // The predicted next invalidation time
     std::optional<std::chrono::steady_clock::time_point> nextInvalidateTime;
+
+    // If true, the outputs may be presented in parallel on worker threads. This
+    // requires a RenderEngine which can be called from any thread.
+    bool presentOutputsInParallel{false};
+
+    // Set while the outputs are presented in parallel. The composer HAL takes
+    // the calls for all displays through a single command buffer, so each
+    // output holds this lock while it talks to the HAL.
+    std::mutex* hwcMutex{nullptr};
+
+    // If true, the front-end state of the layers is copied into a contiguous
+    // array for the outputs to read while they are presented.
+    bool publishLayerSnapshots{false};
 };
 
 } // namespace android::compositionengine
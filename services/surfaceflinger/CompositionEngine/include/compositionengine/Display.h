@@ -56,6 +56,10 @@ public:
     // similar requests if needed.
     virtual void createClientCompositionCache(uint32_t cacheSize) = 0;
 
+    // Enables drawing the client composition for the composition strategy of
+    // the previous frame while the HWC chooses the strategy of this frame.
+    virtual void setCompositionStrategyPredictionEnabled(bool) = 0;
+
 protected:
     ~Display() = default;
 };
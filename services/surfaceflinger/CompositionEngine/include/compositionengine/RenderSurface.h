@@ -90,6 +90,10 @@ public:
     // which will fire when the buffer is ready for consumption.
     virtual void queueBuffer(base::unique_fd readyFence) = 0;
 
+    // Returns the dequeued buffer, if any, without queueing it, when the frame
+    // turns out not to need it.
+    virtual void cancelBuffer() = 0;
+
     // Called after the HWC calls are made to present the display
     virtual void onPresentDisplayCompleted() = 0;
 
@@ -17,6 +17,12 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/LayerFECompositionState.h>
+#include <compositionengine/impl/WorkerPool.h>
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace android::compositionengine::impl {
 
@@ -57,11 +63,31 @@ public:
     void setNeedsAnotherUpdateForTest(bool);
 
 private:
+    bool canPresentOutputsInParallel(const CompositionRefreshArgs&) const;
+    void presentOutputsInParallel(CompositionRefreshArgs&);
+
+    void publishLayerSnapshots(const CompositionRefreshArgs&);
+    void retractLayerSnapshots(const CompositionRefreshArgs&);
+
     std::unique_ptr<HWComposer> mHwComposer;
     std::unique_ptr<renderengine::RenderEngine> mRenderEngine;
     std::shared_ptr<TimeStats> mTimeStats;
     bool mNeedsAnotherUpdate = false;
     nsecs_t mRefreshStartTime = 0;
+
+    // Created on the first parallel presentation, see presentOutputsInParallel()
+    std::unique_ptr<WorkerPool> mWorkerPool;
+    std::mutex mHwcMutex;
+
+    // Copies of the front-end state of the layers on any output, in front to
+    // back order, see publishLayerSnapshots()
+    struct LayerSnapshot {
+        const LayerFE* layerFE = nullptr;
+        LayerFECompositionState state;
+    };
+    std::vector<LayerSnapshot> mLayerSnapshots;
+    std::unordered_map<const LayerFE*, size_t> mLayerSnapshotIndices;
+    bool mLayerSnapshotsPublished = false;
 };
 
 std::unique_ptr<compositionengine::CompositionEngine> createCompositionEngine();
@@ -23,6 +23,7 @@
 #include <compositionengine/DisplayCreationArgs.h>
 #include <compositionengine/RenderSurface.h>
 #include <compositionengine/impl/Output.h>
+#include <compositionengine/impl/WorkerPool.h>
 #include <ui/PixelFormat.h>
 #include <ui/Size.h>
 
@@ -51,6 +52,8 @@ public:
     void setColorTransform(const CompositionRefreshArgs&) override;
     void setColorProfile(const ColorProfile&) override;
     void chooseCompositionStrategy() override;
+    bool canPredictCompositionStrategy(const CompositionRefreshArgs&) override;
+    void prepareFrameAsync(const CompositionRefreshArgs&) override;
     bool getSkipColorTransform() const override;
     compositionengine::Output::FrameFences presentAndGetFrameFences() override;
     void setExpensiveRenderingExpected(bool) override;
@@ -65,6 +68,7 @@ public:
             const compositionengine::DisplayColorProfileCreationArgs&) override;
     void createRenderSurface(const compositionengine::RenderSurfaceCreationArgs&) override;
     void createClientCompositionCache(uint32_t cacheSize) override;
+    void setCompositionStrategyPredictionEnabled(bool) override;
 
     // Internal helpers used by chooseCompositionStrategy()
     using ChangedTypes = android::HWComposer::DeviceRequestedChanges::ChangedTypes;
@@ -77,6 +81,8 @@ public:
     virtual void applyDisplayRequests(const DisplayRequests&);
     virtual void applyLayerRequestsToLayers(const LayerRequests&);
     virtual void applyClientTargetRequests(const ClientTargetProperty&);
+    void applyDeviceRequestedChanges(
+            const std::optional<android::HWComposer::DeviceRequestedChanges>&);
 
     // Internal
     virtual void setConfiguration(const compositionengine::DisplayCreationArgs&);
@@ -93,6 +99,19 @@ private:
     composer::DisplayExtnIntf *mDisplayExtnIntf = nullptr;
     void beginDraw();
     void endDraw();
+    void recordDeviceRequestedChanges(
+            std::optional<android::HWComposer::DeviceRequestedChanges>&&);
+    std::vector<HWC2::Layer*> getHwcLayers() const;
+
+    // The strategy the HWC chose for the previous frame, which is the predicted
+    // strategy for the next one, as long as the same layers are composed.
+    std::optional<android::HWComposer::DeviceRequestedChanges> mPreviousChanges;
+    std::vector<HWC2::Layer*> mPreviousHwcLayers;
+    bool mPreviousUsedClientComposition = false;
+    // Validates the display while the predicted client composition is drawn.
+    std::unique_ptr<WorkerPool> mHwcValidateWorker;
+    uint64_t mPredictionHits = 0;
+    uint64_t mPredictionMisses = 0;
     ColorProfile mColorProfile = {ui::ColorMode::NATIVE, ui::Dataspace::UNKNOWN,
                                   ui::RenderIntent::COLORIMETRIC, ui::Dataspace::UNKNOWN};
 };
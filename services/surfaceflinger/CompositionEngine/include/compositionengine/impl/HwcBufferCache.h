@@ -16,7 +16,10 @@
 
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <optional>
+#include <string>
 #include <vector>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -46,28 +49,58 @@ namespace compositionengine::impl {
 //
 // To be able to find out whether a buffer is already in the HAL's cache, we
 // use HWComposerBufferCache to mirror the cache in SF.
+//
+// Buffers are looked up by id, so a buffer already held in any slot is never
+// sent again. Buffers that do not come with a slot, such as BLAST buffers the
+// client did not cache, are assigned the least-recently used slot, so a layer
+// cycling through a few of them does not resend each one every frame.
 class HwcBufferCache {
 public:
     HwcBufferCache();
     // Given a buffer, return the HWC cache slot and
     // buffer to be sent to HWC.
     //
+    // slot is the slot the producer holds the buffer in, which is used for the
+    // buffer if it is not cached yet. If it is not a valid slot, the
+    // least-recently used slot is evicted for the buffer instead.
+    //
     // outBuffer is set to buffer when buffer is not in the HWC cache;
     // otherwise, outBuffer is set to nullptr.
     void getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                       sp<GraphicBuffer>* outBuffer);
 
+    // Number of buffers found in the HWC cache, and of buffers sent to HWC.
+    uint32_t getHitCount() const { return mHitCount; }
+    uint32_t getSendCount() const { return mSendCount; }
+    // Number of cached buffers evicted to make room for buffers without a slot.
+    uint32_t getEvictionCount() const { return mEvictionCount; }
+
+    void dump(std::string& out) const;
+
     // Special caching slot for the layer caching feature.
     static const constexpr size_t FLATTENER_CACHING_SLOT = BufferQueue::NUM_BUFFER_SLOTS;
 
 private:
-    // an array where the index corresponds to a slot and the value corresponds to a (counter,
-    // buffer) pair. "counter" is a unique value that indicates the last time this slot was updated
-    // or used and allows us to keep track of the least-recently used buffer.
+    struct Slot {
+        // The id of the buffer held by the HAL in this slot, if any.
+        std::optional<uint64_t> bufferId;
+        // A unique value that indicates the last time this slot was updated
+        // or used, which allows us to keep track of the least-recently used slot.
+        uint64_t counter = 0;
+    };
+
+    uint32_t getLeastRecentlyUsedSlot(uint32_t numSlots) const;
+
+    // The HAL creates the cache of each layer with this many slots, see
+    // Composer::kMaxLayerBufferCount.
     static const constexpr size_t kMaxLayerBufferCount = BufferQueue::NUM_BUFFER_SLOTS + 1;
-    wp<GraphicBuffer> mBuffers[kMaxLayerBufferCount];
-    uint32_t mNextSlot = 0;
+    std::array<Slot, kMaxLayerBufferCount> mSlots;
+    uint64_t mCounter = 0;
     bool mReduceSlotsForWideVideo = false;
+
+    uint32_t mHitCount = 0;
+    uint32_t mSendCount = 0;
+    uint32_t mEvictionCount = 0;
 };
 
 } // namespace compositionengine::impl
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <compositionengine/CompositionEngine.h>
+#include <compositionengine/LayerFECompositionState.h>
 #include <compositionengine/Output.h>
 #include <compositionengine/impl/ClientCompositionRequestCache.h>
 #include <compositionengine/impl/OutputCompositionState.h>
@@ -24,6 +25,7 @@
 #include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -101,6 +103,8 @@ public:
     void setDisplayColorProfileForTest(std::unique_ptr<compositionengine::DisplayColorProfile>);
     void setRenderSurfaceForTest(std::unique_ptr<compositionengine::RenderSurface>);
     bool plannerEnabled() const { return mPlanner != nullptr; }
+    void setCoverageCacheEnabledForTest(bool enabled) { mCoverageCacheEnabled = enabled; }
+    size_t getReusedCoverageCountForTest() const { return mCoverageCache.reusedCount; }
     void getVisibleLayerInfo(std::vector<std::string> *layerName,
                              std::vector<int32_t> *layerSequence) const override;
 
@@ -118,6 +122,27 @@ protected:
     void setExpensiveRenderingExpected(bool enabled) override;
     void dumpBase(std::string&) const;
 
+    // Composition strategy prediction, for outputs whose strategy is chosen by
+    // the HWC. The client composition is drawn for a predicted strategy while
+    // the HWC validates the frame, and is drawn again if the HWC disagrees.
+    virtual bool canPredictCompositionStrategy(const CompositionRefreshArgs&);
+    virtual void prepareFrameAsync(const CompositionRefreshArgs&);
+    // Draws the client composition for the current strategy, before it is final.
+    virtual void predictClientComposition(const CompositionRefreshArgs&);
+    // Marks the predicted client composition as matching the final strategy,
+    // for finishFrame() to queue as is.
+    virtual void confirmPredictedClientComposition();
+    void finishPrepareFrame();
+
+    // The steps of composeSurfaces()
+    virtual bool updateProtectedContentState();
+    virtual bool dequeueRenderBuffer(base::unique_fd* bufferFence,
+                                     std::shared_ptr<renderengine::ExternalTexture>*);
+    virtual std::optional<base::unique_fd> drawClientComposition(
+            const Region& debugRegion, const CompositionRefreshArgs&,
+            bool supportsProtectedContent, const std::shared_ptr<renderengine::ExternalTexture>&,
+            base::unique_fd bufferFence);
+
     // Implemented by the final implementation for the final state it uses.
     virtual compositionengine::OutputLayer* ensureOutputLayer(std::optional<size_t>,
                                                               const sp<LayerFE>&) = 0;
@@ -127,11 +152,69 @@ protected:
     virtual void dumpState(std::string& out) const = 0;
 
 private:
+    // The inputs and results of the coverage computation for a layer, kept from
+    // one geometry update to the next so that layers whose inputs did not
+    // change can skip recomputing their regions.
+    struct CachedLayerCoverage {
+        sp<LayerFE> layerFE;
+
+        // The subset of the front-end state that the coverage depends on
+        ui::Transform geomLayerTransform;
+        FloatRect geomLayerBounds;
+        Region transparentRegionHint;
+        float shadowRadius{0.f};
+        bool isOpaque{false};
+
+        // The coverage of the layers above, before and after adding this layer
+        Region aboveCoveredLayersBefore;
+        Region aboveOpaqueLayersBefore;
+        Region aboveCoveredLayersAfter;
+        Region aboveOpaqueLayersAfter;
+
+        // What this layer added to the dirty region of the output
+        Region dirtyRegion;
+
+        // The regions stored into the output layer, if the layer was visible
+        bool hasOutputLayer{false};
+        Region visibleRegion;
+        Region coveredRegion;
+
+        // Whether the dirty region came from the previous output layer state.
+        bool usedPreviousOutputLayer{false};
+
+        // Whether computing the coverage again with the same inputs would give
+        // the same results. This is not the case when the dirty region depended
+        // on content changes or on a previous output layer state which differed.
+        bool reusable{false};
+    };
+
+    struct CoverageCache {
+        // The output state the coverage depends on
+        ui::Transform transform;
+        Rect displayBounds;
+        Rect layerStackContent;
+
+        // The layers in front to back order, and their index by front-end layer
+        std::vector<CachedLayerCoverage> layers;
+        std::unordered_map<const LayerFE*, size_t> indices;
+
+        // The number of layers which reused their cached coverage
+        size_t reusedCount{0};
+    };
+
+    void beginCoverageCache();
+    void finalizeCoverageCache();
+    bool reuseCachedLayerCoverage(const sp<LayerFE>&, const LayerFECompositionState&,
+                                  compositionengine::Output::CoverageState&);
+    void computeLayerCoverage(const sp<LayerFE>&, const LayerFECompositionState&,
+                              compositionengine::Output::CoverageState&, CachedLayerCoverage&);
     void dirtyEntireOutput();
     compositionengine::OutputLayer* findLayerRequestingBackgroundComposition() const;
     ui::Dataspace getBestDataspace(ui::Dataspace*, bool*) const;
     compositionengine::Output::ColorProfile pickColorProfile(
             const compositionengine::CompositionRefreshArgs&) const;
+    std::optional<base::unique_fd> finishPredictedClientComposition(
+            const CompositionRefreshArgs&);
 
     std::string mName;
 
@@ -142,6 +225,23 @@ private:
     OutputLayer* mLayerRequestingBackgroundBlur = nullptr;
     std::unique_ptr<ClientCompositionRequestCache> mClientCompositionRequestCache;
     std::unique_ptr<planner::Planner> mPlanner;
+
+    // The client composition drawn for a predicted strategy, until finishFrame()
+    struct PredictedClientComposition {
+        std::shared_ptr<renderengine::ExternalTexture> buffer;
+        base::unique_fd bufferFence;
+        std::optional<base::unique_fd> readyFence;
+        bool confirmed{false};
+    };
+    std::optional<PredictedClientComposition> mPredictedClientComposition;
+
+    // The coverage of the last geometry update, and the one being computed.
+    // As long as the layers match the cached ones in order, the coverage of
+    // the layers above is known to be the same without comparing the regions.
+    CoverageCache mCoverageCache;
+    CoverageCache mPendingCoverageCache;
+    size_t mNextInSyncCoverageIndex{0};
+    bool mCoverageCacheEnabled{true};
 };
 
 // This template factory function standardizes the implementation details of the
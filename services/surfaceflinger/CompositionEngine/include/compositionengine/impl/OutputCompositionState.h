@@ -59,6 +59,9 @@ struct OutputCompositionState {
     // If true, the current frame reused the buffer from a previous client composition
     bool reusedClientComposition{false};
 
+    // When the current frame's client composition was handed to RenderEngine, or 0 if it was not
+    nsecs_t clientCompositionStartTime{0};
+
     // If true, this output displays layers that are internal-only
     bool layerStackInternal{false};
 
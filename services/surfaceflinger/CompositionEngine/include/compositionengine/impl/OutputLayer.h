@@ -74,6 +74,9 @@ protected:
     virtual void dumpState(std::string&) const = 0;
 
 private:
+    // The snapshot published by the CompositionEngine for this frame, if any, or else the live
+    // state of the LayerFE.
+    const LayerFECompositionState* getLayerFEState() const;
     Rect calculateInitialCrop() const;
     void writeOutputDependentGeometryStateToHWC(HWC2::Layer*, Hwc2::IComposerClient::Composition,
                                                 uint32_t z);
@@ -48,6 +48,7 @@ class HWComposer;
 
 namespace compositionengine {
 class OutputLayer;
+struct LayerFECompositionState;
 } // namespace compositionengine
 
 namespace compositionengine::impl {
@@ -146,6 +147,11 @@ struct OutputLayerCompositionState {
 
     // Timestamp for when the layer is queued for client composition
     nsecs_t clientCompositionTimestamp{0};
+
+    // A copy of the front-end state of the layer, published by the
+    // CompositionEngine while the output is presented. Otherwise null, and the
+    // front-end state is read from the LayerFE.
+    const LayerFECompositionState* layerFESnapshot{nullptr};
 };
 
 } // namespace compositionengine::impl
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace android::compositionengine::impl {
+
+// A fixed set of threads running batches of tasks on behalf of the thread
+// calling run(). The threads run with the same real-time priority as the main
+// thread of SurfaceFlinger, so that the tasks are not delayed relative to the
+// work left on the calling thread.
+class WorkerPool {
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(size_t threadCount, const char* threadName);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t getThreadCount() const { return mThreads.size(); }
+
+    // Runs the tasks, and returns once all of them are done. The first task
+    // runs on the calling thread, which then helps running the others. There
+    // must only be one call to run() at a time.
+    void run(std::vector<Task>&& tasks);
+
+private:
+    void threadMain(const char* threadName);
+
+    std::mutex mMutex;
+    std::condition_variable mTaskCondition;
+    std::condition_variable mDoneCondition;
+    std::queue<Task> mTasks;
+    // The number of tasks queued or running on the pool threads
+    size_t mPendingCount = 0;
+    bool mRunning = true;
+
+    std::vector<std::thread> mThreads;
+};
+
+} // namespace android::compositionengine::impl
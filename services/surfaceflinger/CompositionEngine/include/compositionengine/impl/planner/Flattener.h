@@ -90,8 +90,17 @@ private:
 
     void resetActivities(NonBufferHash, std::chrono::steady_clock::time_point now);
 
+    // Moves the rendered CachedSets that are still valid for the incoming layers out of mLayers,
+    // and returns them along with single-layer CachedSets for the other layers. A CachedSet stays
+    // valid as long as its layers are unchanged and still contiguous, e.g. while a toast or the
+    // IME is shown above or below them. Returns an empty vector if none stays valid.
+    std::vector<CachedSet> retainCachedSets(const std::vector<const LayerState*>& layers,
+                                            std::chrono::steady_clock::time_point now);
+
     NonBufferHash computeLayersHash() const;
 
+    void recordCachedSetHit(const CachedSet&);
+
     bool mergeWithCachedSets(const std::vector<const LayerState*>& layers,
                              std::chrono::steady_clock::time_point now);
 
@@ -200,6 +209,11 @@ private:
     size_t mCachedSetCreationCount = 0;
     size_t mCachedSetCreationCost = 0;
     std::unordered_map<size_t, size_t> mInvalidatedCachedSetAges;
+    // The number of frames for which each rendered CachedSet replaced its layers
+    size_t mCachedSetHitCount = 0;
+    size_t mRetainedCachedSetCount = 0;
+    // The display cost saved by those frames
+    size_t mCachedSetSavedCost = 0;
     std::chrono::nanoseconds mActiveLayerTimeout = kActiveLayerTimeout;
 
     static constexpr auto kActiveLayerTimeout = std::chrono::nanoseconds(150ms);
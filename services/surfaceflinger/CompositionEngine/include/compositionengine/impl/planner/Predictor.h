@@ -20,9 +20,18 @@
 
 namespace android::compositionengine::impl::planner {
 
+// Compact signature of a layer stack, hashed from its number of layers and their composition
+// types. Layers can only approximately match if these are the same, so all other fields are left
+// out of the signature, and stacks with different signatures need not be compared field by field.
+using ApproximateMatchSignature = size_t;
+ApproximateMatchSignature getApproximateMatchSignature(const std::vector<const LayerState*>&);
+
 class LayerStack {
 public:
-    LayerStack(const std::vector<const LayerState*>& layers) : mLayers(copyLayers(layers)) {}
+    LayerStack(const std::vector<const LayerState*>& layers)
+          : mLayers(copyLayers(layers)), mSignature(getApproximateMatchSignature(layers)) {}
+
+    ApproximateMatchSignature getSignature() const { return mSignature; }
 
     // Describes an approximate match between two layer stacks
     struct ApproximateMatch {
@@ -99,6 +108,7 @@ private:
     }
 
     std::vector<const LayerState> mLayers;
+    ApproximateMatchSignature mSignature;
 
     // TODO(b/180976743): Tune kMaxDifferingFields
     constexpr static int kMaxDifferingFields = 6;
@@ -303,10 +313,20 @@ private:
     };
 
     std::vector<ApproximateStack> mApproximateStacks;
+    void addApproximateStack(const ApproximateStack&);
+    // Indices into mApproximateStacks, in insertion order, keyed by the signature of the example
+    // layer stack of their prediction.
+    std::unordered_map<ApproximateMatchSignature, std::vector<size_t>> mApproximateStackIndices;
 
     mutable size_t mExactHitCount = 0;
     mutable size_t mApproximateHitCount = 0;
     mutable size_t mMissCount = 0;
+    size_t mExactMissCount = 0;
+    size_t mApproximateMissCount = 0;
+
+    // Cost of approximate lookups, in layer stacks compared field by field.
+    mutable size_t mApproximateLookupCount = 0;
+    mutable size_t mApproximateComparisonCount = 0;
 };
 
 // Defining PrintTo helps with Google Tests.
@@ -31,8 +31,10 @@ namespace android::compositionengine::impl::planner {
 // While it is possible to define a texture pool supporting variable-sized textures to save on
 // memory, it is a simpler implementation to only manage screen-sized textures. The texture pool is
 // unbounded - there are a minimum number of textures preallocated. Under heavy system load, new
-// textures may be allocated, but only a maximum number of retained once those textures are no
-// longer necessary.
+// textures may be allocated, and the pool adapts how many it retains once those textures are no
+// longer necessary: every borrow that misses the pool raises that number, up to a maximum, and
+// every window of borrows that all hit the pool while it kept textures idle lowers it again, down
+// to the minimum.
 class TexturePool {
 public:
     // RAII class helping with managing textures from the texture pool
@@ -78,10 +80,14 @@ public:
     // to the pool.
     std::shared_ptr<AutoTexture> borrowTexture();
 
+    void dump(std::string& result) const;
+
 protected:
     // Proteted visibility so that they can be used for testing
     const static constexpr size_t kMinPoolSize = 3;
-    const static constexpr size_t kMaxPoolSize = 4;
+    const static constexpr size_t kMaxPoolSize = 6;
+    // The number of borrows over which the pool looks for idle textures before shrinking.
+    const static constexpr size_t kShrinkWindow = 120;
 
     struct Entry {
         std::shared_ptr<renderengine::ExternalTexture> texture;
@@ -90,13 +96,28 @@ protected:
 
     std::deque<Entry> mPool;
 
+    // The number of textures retained once they are returned.
+    size_t mTargetPoolSize = kMinPoolSize;
+
 private:
     std::shared_ptr<renderengine::ExternalTexture> genTexture();
+    // Accounts for a borrow in the shrink window, and lowers the target size at its end.
+    void updateShrinkWindow();
     // Returns a previously borrowed texture to the pool.
     void returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                        const sp<Fence>& fence);
     renderengine::RenderEngine& mRenderEngine;
     ui::Size mSize;
+
+    // Statistics
+    size_t mHitCount = 0;
+    size_t mMissCount = 0;
+
+    // The borrows so far in the current shrink window, and the fewest textures left in the pool
+    // after any of them.
+    size_t mWindowBorrowCount = 0;
+    size_t mWindowMinIdleCount = 0;
+    bool mWindowHadMiss = false;
 };
 
 } // namespace android::compositionengine::impl::planner
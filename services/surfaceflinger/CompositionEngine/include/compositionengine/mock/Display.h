@@ -41,6 +41,7 @@ public:
     MOCK_METHOD1(createDisplayColorProfile, void(const DisplayColorProfileCreationArgs&));
     MOCK_METHOD1(createRenderSurface, void(const RenderSurfaceCreationArgs&));
     MOCK_METHOD1(createClientCompositionCache, void(uint32_t));
+    MOCK_METHOD1(setCompositionStrategyPredictionEnabled, void(bool));
 };
 
 } // namespace android::compositionengine::mock
@@ -20,6 +20,10 @@
 #include <compositionengine/OutputLayer.h>
 #include <compositionengine/impl/CompositionEngine.h>
 #include <compositionengine/impl/Display.h>
+#include <compositionengine/impl/OutputLayerCompositionState.h>
+
+#include <algorithm>
+#include <unordered_set>
 
 #include <renderengine/RenderEngine.h>
 #include <utils/Trace.h>
@@ -107,9 +111,131 @@ void CompositionEngine::present(CompositionRefreshArgs& args) {
 
     updateLayerStateFromFE(args);
 
+    if (args.publishLayerSnapshots) {
+        publishLayerSnapshots(args);
+    } else {
+        mLayerSnapshots.clear();
+    }
+
+    if (canPresentOutputsInParallel(args)) {
+        presentOutputsInParallel(args);
+    } else {
+        for (const auto& output : args.outputs) {
+            output->present(args);
+        }
+    }
+
+    if (args.publishLayerSnapshots) {
+        retractLayerSnapshots(args);
+    }
+}
+
+bool CompositionEngine::canPresentOutputsInParallel(const CompositionRefreshArgs& args) const {
+    // Flashing the dirty regions sleeps in the middle of the composition,
+    // which there is no point in doing in parallel.
+    if (!args.presentOutputsInParallel || args.outputs.size() < 2 ||
+        args.devOptFlashDirtyRegionsDelay) {
+        return false;
+    }
+
+    // RenderEngine switches to and from its protected context for all outputs
+    // at once, so protected content is composed one output at a time.
+    if (mLayerSnapshotsPublished) {
+        return std::none_of(mLayerSnapshots.begin(), mLayerSnapshots.end(),
+                            [](const LayerSnapshot& snapshot) {
+                                return snapshot.state.hasProtectedContent;
+                            });
+    }
+    for (const auto& output : args.outputs) {
+        for (const auto* layer : output->getOutputLayersOrderedByZ()) {
+            const auto* layerFEState = layer->getLayerFE().getCompositionState();
+            if (layerFEState && layerFEState->hasProtectedContent) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void CompositionEngine::presentOutputsInParallel(CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    // The calling thread presents one of the outputs, so there is no need for
+    // more threads than the other outputs. Displays are rarely added, so the
+    // pool is only replaced when there are more outputs than before.
+    const size_t threadCount = args.outputs.size() - 1;
+    if (!mWorkerPool || mWorkerPool->getThreadCount() < threadCount) {
+        mWorkerPool = std::make_unique<WorkerPool>(threadCount, "CompositionWkr");
+    }
+
+    std::vector<WorkerPool::Task> tasks;
+    tasks.reserve(args.outputs.size());
+    for (const auto& output : args.outputs) {
+        tasks.emplace_back([&args, output = output.get()] { output->present(args); });
+    }
+
+    args.hwcMutex = &mHwcMutex;
+    mWorkerPool->run(std::move(tasks));
+    args.hwcMutex = nullptr;
+}
+
+void CompositionEngine::publishLayerSnapshots(const CompositionRefreshArgs& args) {
+    ATRACE_CALL();
+
+    std::unordered_set<const LayerFE*> outputLayerFEs;
     for (const auto& output : args.outputs) {
-        output->present(args);
+        for (const auto* layer : output->getOutputLayersOrderedByZ()) {
+            outputLayerFEs.insert(&layer->getLayerFE());
+        }
+    }
+
+    // Any change to the committed state of a layer invalidates the geometry,
+    // so otherwise only the layers with new buffers need to be copied again.
+    std::unordered_set<const LayerFE*> layersWithQueuedFrames;
+    if (!args.updatingGeometryThisFrame) {
+        for (const auto& layerFE : args.layersWithQueuedFrames) {
+            layersWithQueuedFrames.insert(layerFE.get());
+        }
+    }
+
+    mLayerSnapshotIndices.clear();
+    size_t count = 0;
+    for (auto it = args.layers.rbegin(); it != args.layers.rend(); ++it) {
+        const LayerFE* layerFE = it->get();
+        const auto* layerFEState = layerFE->getCompositionState();
+        if (!layerFEState || outputLayerFEs.count(layerFE) == 0) {
+            continue;
+        }
+
+        if (count == mLayerSnapshots.size()) {
+            mLayerSnapshots.push_back({layerFE, *layerFEState});
+        } else if (auto& snapshot = mLayerSnapshots[count]; args.updatingGeometryThisFrame ||
+                   snapshot.layerFE != layerFE || layersWithQueuedFrames.count(layerFE) != 0) {
+            snapshot.layerFE = layerFE;
+            snapshot.state = *layerFEState;
+        }
+        mLayerSnapshotIndices[layerFE] = count++;
+    }
+    mLayerSnapshots.erase(mLayerSnapshots.begin() + count, mLayerSnapshots.end());
+
+    // The array is complete, so the pointers stay valid until the next frame.
+    for (const auto& output : args.outputs) {
+        for (auto* layer : output->getOutputLayersOrderedByZ()) {
+            const auto it = mLayerSnapshotIndices.find(&layer->getLayerFE());
+            layer->editState().layerFESnapshot =
+                    it != mLayerSnapshotIndices.end() ? &mLayerSnapshots[it->second].state : nullptr;
+        }
+    }
+    mLayerSnapshotsPublished = true;
+}
+
+void CompositionEngine::retractLayerSnapshots(const CompositionRefreshArgs& args) {
+    for (const auto& output : args.outputs) {
+        for (auto* layer : output->getOutputLayersOrderedByZ()) {
+            layer->editState().layerFESnapshot = nullptr;
+        }
     }
+    mLayerSnapshotsPublished = false;
 }
 
 void CompositionEngine::updateCursorAsync(CompositionRefreshArgs& args) {
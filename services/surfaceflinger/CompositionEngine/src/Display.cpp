@@ -169,6 +169,10 @@ void Display::dump(std::string& out) const {
     out.append("\n   ");
     dumpVal(out, "isVirtual", mIsVirtual);
     dumpVal(out, "DisplayId", to_string(mId));
+    if (mHwcValidateWorker) {
+        dumpVal(out, "predictionHits", std::to_string(mPredictionHits));
+        dumpVal(out, "predictionMisses", std::to_string(mPredictionMisses));
+    }
     out.append("\n");
 
     Output::dumpBase(out);
@@ -277,8 +281,15 @@ void Display::chooseCompositionStrategy() {
         result != NO_ERROR) {
         ALOGE("chooseCompositionStrategy failed for %s: %d (%s)", getName().c_str(), result,
               strerror(-result));
+        mPreviousChanges.reset();
         return;
     }
+    applyDeviceRequestedChanges(changes);
+    recordDeviceRequestedChanges(std::move(changes));
+}
+
+void Display::applyDeviceRequestedChanges(
+        const std::optional<android::HWComposer::DeviceRequestedChanges>& changes) {
     if (changes) {
         applyChangedTypesToLayers(changes->changedTypes);
         applyDisplayRequests(changes->displayRequests);
@@ -292,6 +303,126 @@ void Display::chooseCompositionStrategy() {
     state.usesDeviceComposition = !allLayersRequireClientComposition();
 }
 
+void Display::recordDeviceRequestedChanges(
+        std::optional<android::HWComposer::DeviceRequestedChanges>&& changes) {
+    if (!mHwcValidateWorker) {
+        return;
+    }
+
+    mPreviousChanges = std::move(changes);
+    mPreviousHwcLayers = getHwcLayers();
+    mPreviousUsedClientComposition = getState().usesClientComposition;
+}
+
+std::vector<HWC2::Layer*> Display::getHwcLayers() const {
+    std::vector<HWC2::Layer*> hwcLayers;
+    for (const auto* layer : getOutputLayersOrderedByZ()) {
+        hwcLayers.push_back(layer->getHwcLayer());
+    }
+    return hwcLayers;
+}
+
+void Display::setCompositionStrategyPredictionEnabled(bool enabled) {
+    if (!enabled) {
+        mHwcValidateWorker.reset();
+        mPreviousChanges.reset();
+    } else if (!mHwcValidateWorker) {
+        mHwcValidateWorker = std::make_unique<WorkerPool>(1, "HwcValidate");
+    }
+}
+
+bool Display::canPredictCompositionStrategy(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    // The prediction is only worth it when the previous frame had client
+    // composition, and only holds while the HWC is given the same layers. A
+    // client target dataspace request changes the buffer to draw into, so it
+    // has to be known before drawing. Outputs presented in parallel already
+    // overlap their HWC calls with the composition of other outputs.
+    const auto& state = getState();
+    return mHwcValidateWorker && state.isEnabled && !mIsVirtual && !mIsDisconnected &&
+            PhysicalDisplayId::tryCast(mId) && !refreshArgs.hwcMutex &&
+            !refreshArgs.devOptFlashDirtyRegionsDelay && mPreviousChanges &&
+            mPreviousUsedClientComposition &&
+            mPreviousChanges->clientTargetProperty.dataspace == ui::Dataspace::UNKNOWN &&
+            mPreviousHwcLayers == getHwcLayers();
+}
+
+void Display::prepareFrameAsync(const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    const auto halDisplayId = HalDisplayId::tryCast(mId);
+    LOG_FATAL_IF(!halDisplayId);
+
+    auto& hwc = getCompositionEngine().getHwComposer();
+    beginDraw();
+
+    // The HWC is validated with the inputs chooseCompositionStrategy() would
+    // pass, which are read before the predicted strategy is applied.
+    const bool requiresClientComposition = anyLayersRequireClientComposition();
+    const auto earliestPresentTime = getState().earliestPresentTime;
+    const auto previousPresentFence = getState().previousPresentFence;
+
+    // Applying the predicted strategy leaves the layers in a state only the
+    // final strategy restores, so the requested composition types are saved.
+    struct LayerState {
+        compositionengine::OutputLayer* layer;
+        std::optional<hal::Composition> compositionType;
+    };
+    std::vector<LayerState> savedLayers;
+    for (auto* layer : getOutputLayersOrderedByZ()) {
+        const auto& hwcState = layer->getState().hwc;
+        savedLayers.push_back({layer,
+                               hwcState ? std::make_optional(hwcState->hwcCompositionType)
+                                        : std::nullopt});
+    }
+
+    Output::chooseCompositionStrategy();
+    applyDeviceRequestedChanges(mPreviousChanges);
+    getRenderSurface()->prepareFrame(getState().usesClientComposition,
+                                     getState().usesDeviceComposition);
+
+    std::optional<android::HWComposer::DeviceRequestedChanges> changes;
+    status_t result = NO_ERROR;
+    mHwcValidateWorker->run({[&] { predictClientComposition(refreshArgs); },
+                             [&] {
+                                 result = hwc.getDeviceCompositionChanges(*halDisplayId,
+                                                                          requiresClientComposition,
+                                                                          earliestPresentTime,
+                                                                          previousPresentFence,
+                                                                          &changes);
+                             }});
+
+    if (result == NO_ERROR && changes == mPreviousChanges) {
+        ATRACE_NAME("CompositionStrategyPredictionHit");
+        mPredictionHits++;
+        confirmPredictedClientComposition();
+    } else {
+        ATRACE_NAME("CompositionStrategyPredictionMiss");
+        mPredictionMisses++;
+        for (const auto& [layer, compositionType] : savedLayers) {
+            if (compositionType) {
+                layer->editState().hwc->hwcCompositionType = *compositionType;
+            }
+        }
+
+        Output::chooseCompositionStrategy();
+        if (result != NO_ERROR) {
+            ALOGE("prepareFrameAsync failed for %s: %d (%s)", getName().c_str(), result,
+                  strerror(-result));
+        } else {
+            applyDeviceRequestedChanges(changes);
+        }
+    }
+
+    finishPrepareFrame();
+    if (result == NO_ERROR) {
+        recordDeviceRequestedChanges(std::move(changes));
+    } else {
+        mPreviousChanges.reset();
+    }
+}
+
 void Display::beginDraw() {
     ATRACE_CALL();
     if (mDisplayExtnIntf == nullptr) {
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <compositionengine/impl/DumpHelpers.h>
 #include <compositionengine/impl/HwcBufferCache.h>
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -22,6 +23,7 @@
 
 #include <gui/BufferQueue.h>
 #include <ui/GraphicBuffer.h>
+#include <algorithm>
 #include <cstdlib>
 #include <cutils/properties.h>
 #include <QtiGrallocDefs.h>
@@ -36,7 +38,6 @@ constexpr int MAX_NUM_SLOTS_FOR_WIDE_VIDEOS = 4;
 namespace android::compositionengine::impl {
 
 HwcBufferCache::HwcBufferCache() {
-    std::fill(std::begin(mBuffers), std::end(mBuffers), wp<GraphicBuffer>(nullptr));
     char value[PROPERTY_VALUE_MAX];
     property_get("vendor.display.reduce_slots_for_wide_video", value, "1");
     mReduceSlotsForWideVideo = atoi(value);
@@ -81,8 +82,6 @@ static bool formatIsYuv(const PixelFormat format) {
 
 void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uint32_t* outSlot,
                                   sp<GraphicBuffer>* outBuffer) {
-    // default is 0
-    wp<GraphicBuffer> weakCopy(buffer);
     uint32_t width = 0;
     uint32_t height = 0;
     PixelFormat format = PIXEL_FORMAT_NONE;
@@ -91,36 +90,66 @@ void HwcBufferCache::getHwcBuffer(int slot, const sp<GraphicBuffer>& buffer, uin
         height = buffer->getHeight();
         format = buffer->getPixelFormat();
     }
-    bool widevideo = false;
     uint32_t numSlots = kMaxLayerBufferCount;
 
     // Workaround to reduce slots for 8k buffers
     if ((width * height > MAX_VIDEO_WIDTH * MAX_VIDEO_HEIGHT) && mReduceSlotsForWideVideo &&
         formatIsYuv(format)) {
         numSlots = MAX_NUM_SLOTS_FOR_WIDE_VIDEOS;
-        widevideo = true;
     }
-    if (slot == BufferQueue::INVALID_BUFFER_SLOT || slot < 0 ||
-        static_cast<uint32_t>(slot) >= numSlots) {
-        *outSlot = 0;
-        if (widevideo && static_cast<uint32_t>(slot) >= numSlots) {
-            *outSlot = mNextSlot % numSlots;
-            mNextSlot = *outSlot + 1;
-        }
-    } else {
-        *outSlot = static_cast<uint32_t>(slot);
+    const bool isValidSlot = slot != BufferQueue::INVALID_BUFFER_SLOT && slot >= 0 &&
+            static_cast<uint32_t>(slot) < numSlots;
+
+    if (!buffer) {
+        // Nothing to send, but the slot no longer holds the buffer it used to
+        *outSlot = isValidSlot ? static_cast<uint32_t>(slot) : 0;
+        *outBuffer = nullptr;
+        mSlots[*outSlot] = {};
+        return;
     }
 
-    auto& currentBuffer = mBuffers[*outSlot];
-    if (currentBuffer == weakCopy) {
+    const uint64_t bufferId = buffer->getId();
+    const auto cachedSlot = std::find_if(mSlots.begin(), mSlots.begin() + numSlots,
+                                         [&](const Slot& s) { return s.bufferId == bufferId; });
+    if (cachedSlot != mSlots.begin() + numSlots) {
         // already cached in HWC, skip sending the buffer
+        *outSlot = static_cast<uint32_t>(cachedSlot - mSlots.begin());
         *outBuffer = nullptr;
-    } else {
-        *outBuffer = buffer;
+        cachedSlot->counter = ++mCounter;
+        mHitCount++;
+        return;
+    }
 
-        // update cache
-        currentBuffer = buffer;
+    if (isValidSlot) {
+        *outSlot = static_cast<uint32_t>(slot);
+    } else {
+        // The flattener slot is never evicted, since it is only used for the flattener's buffer
+        *outSlot = getLeastRecentlyUsedSlot(
+                std::min(numSlots, static_cast<uint32_t>(FLATTENER_CACHING_SLOT)));
+        if (mSlots[*outSlot].bufferId) {
+            mEvictionCount++;
+        }
     }
+
+    // update cache
+    *outBuffer = buffer;
+    mSlots[*outSlot] = {.bufferId = bufferId, .counter = ++mCounter};
+    mSendCount++;
+}
+
+uint32_t HwcBufferCache::getLeastRecentlyUsedSlot(uint32_t numSlots) const {
+    const auto leastRecentlyUsed =
+            std::min_element(mSlots.begin(), mSlots.begin() + numSlots,
+                             [](const Slot& lhs, const Slot& rhs) {
+                                 return lhs.counter < rhs.counter;
+                             });
+    return static_cast<uint32_t>(leastRecentlyUsed - mSlots.begin());
+}
+
+void HwcBufferCache::dump(std::string& out) const {
+    dumpVal(out, "buffer cache hits", mHitCount);
+    dumpVal(out, "sends", mSendCount);
+    dumpVal(out, "evictions", mEvictionCount);
 }
 
 } // namespace android::compositionengine::impl
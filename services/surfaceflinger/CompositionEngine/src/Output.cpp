@@ -28,6 +28,7 @@
 #include <compositionengine/impl/OutputLayerCompositionState.h>
 #include <compositionengine/impl/planner/Planner.h>
 
+#include <limits>
 #include <thread>
 
 #include "renderengine/ExternalTexture.h"
@@ -76,6 +77,24 @@ Reversed<T> reversed(const T& c) {
     return Reversed<T>(c);
 }
 
+// Returns true if the regions are known to be the same, which may be a false
+// negative for regions made of different but equivalent rectangles.
+bool isSameRegion(const Region& lhs, const Region& rhs) {
+    return lhs.isTriviallyEqual(rhs) || lhs.hasSameRects(rhs);
+}
+
+// Runs the function while holding the lock on the HAL, if the outputs are
+// presented in parallel.
+template <typename F>
+void lockHwc(const compositionengine::CompositionRefreshArgs& refreshArgs, F&& f) {
+    if (!refreshArgs.hwcMutex) {
+        f();
+        return;
+    }
+    std::lock_guard lock(*refreshArgs.hwcMutex);
+    f();
+}
+
 struct ScaleVector {
     float x;
     float y;
@@ -428,16 +447,24 @@ void Output::present(const compositionengine::CompositionRefreshArgs& refreshArg
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
-    updateColorProfile(refreshArgs);
+    // When presenting in parallel with other outputs, only the steps talking
+    // to the HAL are serialized.
+    lockHwc(refreshArgs, [&] { updateColorProfile(refreshArgs); });
     updateCompositionState(refreshArgs);
     planComposition();
-    writeCompositionState(refreshArgs);
-    setColorTransform(refreshArgs);
-    beginFrame();
-    prepareFrame();
+    lockHwc(refreshArgs, [&] {
+        writeCompositionState(refreshArgs);
+        setColorTransform(refreshArgs);
+        beginFrame();
+    });
+    if (canPredictCompositionStrategy(refreshArgs)) {
+        prepareFrameAsync(refreshArgs);
+    } else {
+        lockHwc(refreshArgs, [&] { prepareFrame(); });
+    }
     devOptRepaintFlash(refreshArgs);
     finishFrame(refreshArgs);
-    postFramebuffer();
+    lockHwc(refreshArgs, [&] { postFramebuffer(); });
     renderCachedSets(refreshArgs);
 }
 
@@ -448,6 +475,12 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
     auto& outputState = editState();
 
+    // Do not hold on to the removed layers while this output is not enabled
+    if (!outputState.isEnabled) {
+        mCoverageCache.layers.clear();
+        mCoverageCache.indices.clear();
+    }
+
     // Do nothing if this output is not enabled or there is no need to perform this update
     if (!outputState.isEnabled || CC_LIKELY(!refreshArgs.updatingOutputGeometryThisFrame)) {
         return;
@@ -468,6 +501,8 @@ void Output::rebuildLayerStacks(const compositionengine::CompositionRefreshArgs&
 
 void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArgs& refreshArgs,
                                   compositionengine::Output::CoverageState& coverage) {
+    beginCoverageCache();
+
     // Evaluate the layers from front to back to determine what is visible. This
     // also incrementally calculates the coverage information for each layer as
     // well as the entire output.
@@ -482,6 +517,104 @@ void Output::collectVisibleLayers(const compositionengine::CompositionRefreshArg
     setReleasedLayers(refreshArgs);
 
     finalizePendingOutputLayers();
+
+    finalizeCoverageCache();
+}
+
+void Output::beginCoverageCache() {
+    const auto& outputState = getState();
+
+    // Every cached region depends on the output projection.
+    if (!(mCoverageCache.transform == outputState.transform) ||
+        mCoverageCache.displayBounds != outputState.displaySpace.bounds ||
+        mCoverageCache.layerStackContent != outputState.layerStackSpace.content) {
+        mCoverageCache.layers.clear();
+        mCoverageCache.indices.clear();
+    }
+
+    mPendingCoverageCache.transform = outputState.transform;
+    mPendingCoverageCache.displayBounds = outputState.displaySpace.bounds;
+    mPendingCoverageCache.layerStackContent = outputState.layerStackSpace.content;
+    mPendingCoverageCache.layers.clear();
+    mPendingCoverageCache.layers.reserve(mCoverageCache.layers.size());
+    mPendingCoverageCache.indices.clear();
+    mPendingCoverageCache.reusedCount = 0;
+
+    // Nothing is above the first layer, as it was the case last time.
+    mNextInSyncCoverageIndex = 0;
+}
+
+void Output::finalizeCoverageCache() {
+    std::swap(mCoverageCache, mPendingCoverageCache);
+    mPendingCoverageCache.layers.clear();
+    mPendingCoverageCache.indices.clear();
+}
+
+bool Output::reuseCachedLayerCoverage(const sp<compositionengine::LayerFE>& layerFE,
+                                      const LayerFECompositionState& layerFEState,
+                                      compositionengine::Output::CoverageState& coverage) {
+    // Content changes always dirty the visible region, so there is nothing to
+    // reuse for the layer.
+    if (!mCoverageCacheEnabled || layerFEState.contentDirty) {
+        return false;
+    }
+
+    const auto indexIt = mCoverageCache.indices.find(layerFE.get());
+    if (indexIt == mCoverageCache.indices.end()) {
+        return false;
+    }
+    const size_t index = indexIt->second;
+    const auto& cached = mCoverageCache.layers[index];
+
+    if (!cached.reusable || !(cached.geomLayerTransform == layerFEState.geomLayerTransform) ||
+        !(cached.geomLayerBounds == layerFEState.geomLayerBounds) ||
+        cached.shadowRadius != layerFEState.shadowRadius ||
+        cached.isOpaque != layerFEState.isOpaque ||
+        !isSameRegion(cached.transparentRegionHint, layerFEState.transparentRegionHint)) {
+        return false;
+    }
+
+    // The layers above must cover the same region as last time. This is known
+    // without comparing the regions if the layer directly above was reused, or
+    // if this is the front-most layer as it was before.
+    if (index != mNextInSyncCoverageIndex &&
+        (!isSameRegion(cached.aboveCoveredLayersBefore, coverage.aboveCoveredLayers) ||
+         !isSameRegion(cached.aboveOpaqueLayersBefore, coverage.aboveOpaqueLayers))) {
+        return false;
+    }
+
+    // The output layer must still hold the regions computed last time, which
+    // are all reused as is.
+    if (cached.hasOutputLayer || cached.usedPreviousOutputLayer) {
+        const auto prevOutputLayerIndex = findCurrentOutputLayerForLayer(layerFE);
+        const auto* prevOutputLayer = prevOutputLayerIndex
+                ? getOutputLayerOrderedByZByIndex(*prevOutputLayerIndex)
+                : nullptr;
+        if (!cached.hasOutputLayer) {
+            if (prevOutputLayer) {
+                return false;
+            }
+        } else {
+            if (!prevOutputLayer ||
+                !prevOutputLayer->getState().visibleRegion.isTriviallyEqual(
+                        cached.visibleRegion) ||
+                !prevOutputLayer->getState().coveredRegion.isTriviallyEqual(
+                        cached.coveredRegion)) {
+                return false;
+            }
+            ensureOutputLayer(prevOutputLayerIndex, layerFE);
+        }
+    }
+
+    coverage.aboveCoveredLayers = cached.aboveCoveredLayersAfter;
+    coverage.aboveOpaqueLayers = cached.aboveOpaqueLayersAfter;
+    coverage.dirtyRegion.orSelf(cached.dirtyRegion);
+
+    mPendingCoverageCache.indices[layerFE.get()] = mPendingCoverageCache.layers.size();
+    mPendingCoverageCache.layers.push_back(cached);
+    mPendingCoverageCache.reusedCount++;
+    mNextInSyncCoverageIndex = index + 1;
+    return true;
 }
 
 void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
@@ -510,6 +643,40 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
         return;
     }
 
+    // Skip the computation if neither the layer nor the layers above changed
+    if (reuseCachedLayerCoverage(layerFE, *layerFEState, coverage)) {
+        return;
+    }
+
+    CachedLayerCoverage cached;
+    cached.layerFE = layerFE;
+    cached.geomLayerTransform = layerFEState->geomLayerTransform;
+    cached.geomLayerBounds = layerFEState->geomLayerBounds;
+    cached.transparentRegionHint = layerFEState->transparentRegionHint;
+    cached.shadowRadius = layerFEState->shadowRadius;
+    cached.isOpaque = layerFEState->isOpaque;
+    cached.aboveCoveredLayersBefore = coverage.aboveCoveredLayers;
+    cached.aboveOpaqueLayersBefore = coverage.aboveOpaqueLayers;
+
+    computeLayerCoverage(layerFE, *layerFEState, coverage, cached);
+
+    cached.aboveCoveredLayersAfter = coverage.aboveCoveredLayers;
+    cached.aboveOpaqueLayersAfter = coverage.aboveOpaqueLayers;
+    mPendingCoverageCache.indices[layerFE.get()] = mPendingCoverageCache.layers.size();
+    mPendingCoverageCache.layers.push_back(std::move(cached));
+
+    // The coverage may have changed, so the next layer needs to compare it.
+    mNextInSyncCoverageIndex = std::numeric_limits<size_t>::max();
+}
+
+void Output::computeLayerCoverage(const sp<compositionengine::LayerFE>& layerFE,
+                                  const LayerFECompositionState& layerFEState,
+                                  compositionengine::Output::CoverageState& coverage,
+                                  CachedLayerCoverage& cached) {
+    // Only the dirty region depends on more than the cached inputs, so the
+    // results are the same next time unless it is computed below.
+    cached.reusable = true;
+
     /*
      * opaqueRegion: area of a surface that is fully opaque.
      */
@@ -544,18 +711,18 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
      */
     Region shadowRegion;
 
-    const ui::Transform& tr = layerFEState->geomLayerTransform;
+    const ui::Transform& tr = layerFEState.geomLayerTransform;
 
     // Get the visible region
     // TODO(b/121291683): Is it worth creating helper methods on LayerFEState
     // for computations like this?
-    const Rect visibleRect(tr.transform(layerFEState->geomLayerBounds));
+    const Rect visibleRect(tr.transform(layerFEState.geomLayerBounds));
     visibleRegion.set(visibleRect);
 
-    if (layerFEState->shadowRadius > 0.0f) {
+    if (layerFEState.shadowRadius > 0.0f) {
         // if the layer casts a shadow, offset the layers visible region and
         // calculate the shadow region.
-        const auto inset = static_cast<int32_t>(ceilf(layerFEState->shadowRadius) * -1.0f);
+        const auto inset = static_cast<int32_t>(ceilf(layerFEState.shadowRadius) * -1.0f);
         Rect visibleRectWithShadows(visibleRect);
         visibleRectWithShadows.inset(inset, inset, inset, inset);
         visibleRegion.set(visibleRectWithShadows);
@@ -567,10 +734,10 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     }
 
     // Remove the transparent area from the visible region
-    if (!layerFEState->isOpaque) {
+    if (!layerFEState.isOpaque) {
         if (tr.preserveRects()) {
             // transform the transparent region
-            transparentRegion = tr.transform(layerFEState->transparentRegionHint);
+            transparentRegion = tr.transform(layerFEState.transparentRegionHint);
         } else {
             // transformation too complex, can't do the
             // transparent region optimization.
@@ -580,7 +747,7 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
 
     // compute the opaque region
     const auto layerOrientation = tr.getOrientation();
-    if (layerFEState->isOpaque && ((layerOrientation & ui::Transform::ROT_INVALID) == 0)) {
+    if (layerFEState.isOpaque && ((layerOrientation & ui::Transform::ROT_INVALID) == 0)) {
         // If we one of the simple category of transforms (0/90/180/270 rotation
         // + any flip), then the opaque region is the layer's footprint.
         // Otherwise we don't try and compute the opaque region since there may
@@ -616,9 +783,14 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     const Region& oldCoveredRegion =
             prevOutputLayer ? prevOutputLayer->getState().coveredRegion : kEmptyRegion;
 
+    // The dirty region computed below only comes out the same next time if the
+    // previous state is the same then, see the checks on the results below.
+    cached.usedPreviousOutputLayer = true;
+    cached.reusable = !layerFEState.contentDirty;
+
     // compute this layer's dirty region
     Region dirty;
-    if (layerFEState->contentDirty) {
+    if (layerFEState.contentDirty) {
         // we need to invalidate the whole region
         dirty = visibleRegion;
         // as well, as the old visible region
@@ -645,6 +817,7 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
 
     // accumulate to the screen dirty region
     coverage.dirtyRegion.orSelf(dirty);
+    cached.dirtyRegion = dirty;
 
     // Update accumAboveOpaqueLayers for next (lower) layer
     coverage.aboveOpaqueLayers.orSelf(opaqueRegion);
@@ -658,9 +831,17 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     Region drawRegion(outputState.transform.transform(visibleNonTransparentRegion));
     drawRegion.andSelf(outputState.displaySpace.bounds);
     if (drawRegion.isEmpty()) {
+        // There will not be any previous output layer next time either.
+        cached.reusable = cached.reusable && !prevOutputLayer;
         return;
     }
 
+    // Compare before the output layer state is updated below. The regions will
+    // be the previous ones next time.
+    cached.reusable = cached.reusable && prevOutputLayer &&
+            isSameRegion(oldVisibleRegion, visibleRegion) &&
+            isSameRegion(oldCoveredRegion, coveredRegion);
+
     Region visibleNonShadowRegion = visibleRegion.subtract(shadowRegion);
 
     // The layer is visible. Either reuse the existing outputLayer if we have
@@ -676,6 +857,10 @@ void Output::ensureOutputLayerIfVisible(sp<compositionengine::LayerFE>& layerFE,
     outputLayerState.outputSpaceVisibleRegion = outputState.transform.transform(
             visibleNonShadowRegion.intersect(outputState.layerStackSpace.content));
     outputLayerState.shadowRegion = shadowRegion;
+
+    cached.hasOutputLayer = true;
+    cached.visibleRegion = outputLayerState.visibleRegion;
+    cached.coveredRegion = outputLayerState.coveredRegion;
 }
 
 void Output::setReleasedLayers(const compositionengine::CompositionRefreshArgs&) {
@@ -990,7 +1175,11 @@ void Output::prepareFrame() {
     }
 
     chooseCompositionStrategy();
+    finishPrepareFrame();
+}
 
+void Output::finishPrepareFrame() {
+    const auto& outputState = getState();
     if (mPlanner) {
         mPlanner->reportFinalPlan(getOutputLayersOrderedByZ());
     }
@@ -999,6 +1188,37 @@ void Output::prepareFrame() {
                                  outputState.usesDeviceComposition);
 }
 
+bool Output::canPredictCompositionStrategy(const compositionengine::CompositionRefreshArgs&) {
+    return false;
+}
+
+void Output::prepareFrameAsync(const compositionengine::CompositionRefreshArgs&) {
+    prepareFrame();
+}
+
+void Output::predictClientComposition(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    ATRACE_CALL();
+    ALOGV(__FUNCTION__);
+
+    auto& prediction = mPredictedClientComposition.emplace();
+    const bool supportsProtectedContent = updateProtectedContentState();
+    if (!dequeueRenderBuffer(&prediction.bufferFence, &prediction.buffer)) {
+        return;
+    }
+
+    prediction.readyFence =
+            drawClientComposition(Region::INVALID_REGION, refreshArgs, supportsProtectedContent,
+                                  prediction.buffer,
+                                  base::unique_fd(dup(prediction.bufferFence.get())));
+}
+
+void Output::confirmPredictedClientComposition() {
+    if (mPredictedClientComposition) {
+        mPredictedClientComposition->confirmed = true;
+    }
+}
+
 void Output::devOptRepaintFlash(const compositionengine::CompositionRefreshArgs& refreshArgs) {
     if (CC_LIKELY(!refreshArgs.devOptFlashDirtyRegionsDelay)) {
         return;
@@ -1033,13 +1253,47 @@ void Output::finishFrame(const compositionengine::CompositionRefreshArgs& refres
 
     // Repaint the framebuffer (if needed), getting the optional fence for when
     // the composition completes.
-    auto optReadyFence = composeSurfaces(Region::INVALID_REGION, refreshArgs);
+    auto optReadyFence = mPredictedClientComposition
+            ? finishPredictedClientComposition(refreshArgs)
+            : composeSurfaces(Region::INVALID_REGION, refreshArgs);
     if (!optReadyFence) {
         return;
     }
 
-    // swap buffers (presentation)
-    mRenderSurface->queueBuffer(std::move(*optReadyFence));
+    // swap buffers (presentation), which passes the client target to the HAL
+    lockHwc(refreshArgs, [&] { mRenderSurface->queueBuffer(std::move(*optReadyFence)); });
+}
+
+std::optional<base::unique_fd> Output::finishPredictedClientComposition(
+        const compositionengine::CompositionRefreshArgs& refreshArgs) {
+    auto prediction = std::move(*mPredictedClientComposition);
+    mPredictedClientComposition.reset();
+
+    if (prediction.confirmed) {
+        return std::move(prediction.readyFence);
+    }
+
+    // The final strategy differs, so the client composition is drawn again, in
+    // the buffer dequeued for the prediction if there is one.
+    if (!prediction.buffer) {
+        return composeSurfaces(Region::INVALID_REGION, refreshArgs);
+    }
+
+    const auto& outputState = getState();
+    if (!outputState.usesClientComposition && !outputState.flipClientTarget) {
+        mRenderSurface->cancelBuffer();
+        setExpensiveRenderingExpected(false);
+        return base::unique_fd();
+    }
+
+    // The predicted draw waited for the buffer, so drawing again only needs to
+    // wait for the predicted draw, if there was one.
+    auto bufferFence = prediction.readyFence && prediction.readyFence->get() >= 0
+            ? std::move(*prediction.readyFence)
+            : std::move(prediction.bufferFence);
+    return drawClientComposition(Region::INVALID_REGION, refreshArgs,
+                                 updateProtectedContentState(), prediction.buffer,
+                                 std::move(bufferFence));
 }
 
 std::optional<base::unique_fd> Output::composeSurfaces(
@@ -1047,10 +1301,20 @@ std::optional<base::unique_fd> Output::composeSurfaces(
     ATRACE_CALL();
     ALOGV(__FUNCTION__);
 
+    const bool supportsProtectedContent = updateProtectedContentState();
+
+    base::unique_fd fd;
+    std::shared_ptr<renderengine::ExternalTexture> tex;
+    if (!dequeueRenderBuffer(&fd, &tex)) {
+        return {};
+    }
+
+    return drawClientComposition(debugRegion, refreshArgs, supportsProtectedContent, tex,
+                                 std::move(fd));
+}
+
+bool Output::updateProtectedContentState() {
     const auto& outputState = getState();
-    OutputCompositionState& outputCompositionState = editState();
-    const TracedOrdinal<bool> hasClientComposition = {"hasClientComposition",
-                                                      outputState.usesClientComposition};
 
     bool hasSecureCamera = false;
     bool hasSecureDisplay = false;
@@ -1082,23 +1346,38 @@ std::optional<base::unique_fd> Output::composeSurfaces(
         supportsProtectedContent == renderEngine.isProtected()) {
         mRenderSurface->setProtected(supportsProtectedContent);
     }
+    return supportsProtectedContent;
+}
 
-    base::unique_fd fd;
-
-    std::shared_ptr<renderengine::ExternalTexture> tex;
+bool Output::dequeueRenderBuffer(base::unique_fd* bufferFence,
+                                 std::shared_ptr<renderengine::ExternalTexture>* tex) {
+    const auto& outputState = getState();
 
     // If we aren't doing client composition on this output, but do have a
     // flipClientTarget request for this frame on this output, we still need to
     // dequeue a buffer.
-    if (hasClientComposition || outputState.flipClientTarget) {
-        tex = mRenderSurface->dequeueBuffer(&fd);
-        if (tex == nullptr) {
+    if (outputState.usesClientComposition || outputState.flipClientTarget) {
+        *tex = mRenderSurface->dequeueBuffer(bufferFence);
+        if (*tex == nullptr) {
             ALOGW("Dequeuing buffer for display [%s] failed, bailing out of "
                   "client composition for this frame",
                   mName.c_str());
-            return {};
+            return false;
         }
     }
+    return true;
+}
+
+std::optional<base::unique_fd> Output::drawClientComposition(
+        const Region& debugRegion, const compositionengine::CompositionRefreshArgs& refreshArgs,
+        bool supportsProtectedContent, const std::shared_ptr<renderengine::ExternalTexture>& tex,
+        base::unique_fd fd) {
+    const auto& outputState = getState();
+    OutputCompositionState& outputCompositionState = editState();
+    auto& renderEngine = getCompositionEngine().getRenderEngine();
+    const TracedOrdinal<bool> hasClientComposition = {"hasClientComposition",
+                                                      outputState.usesClientComposition};
+    outputCompositionState.clientCompositionStartTime = 0;
 
     base::unique_fd readyFence;
     if (!hasClientComposition) {
@@ -1174,6 +1453,7 @@ std::optional<base::unique_fd> Output::composeSurfaces(
                    });
 
     const nsecs_t renderEngineStart = systemTime();
+    outputCompositionState.clientCompositionStartTime = renderEngineStart;
     // Only use the framebuffer cache when rendering to an internal display
     // TODO(b/173560331): This is only to help mitigate memory leaks from virtual displays because
     // right now we don't have a concrete eviction policy for output buffers: GLESRenderEngine
@@ -73,8 +73,13 @@ void OutputLayer::setHwcLayer(std::shared_ptr<HWC2::Layer> hwcLayer) {
     }
 }
 
+const LayerFECompositionState* OutputLayer::getLayerFEState() const {
+    if (const auto* snapshot = getState().layerFESnapshot) return snapshot;
+    return getLayerFE().getCompositionState();
+}
+
 Rect OutputLayer::calculateInitialCrop() const {
-    const auto& layerState = *getLayerFE().getCompositionState();
+    const auto& layerState = *getLayerFEState();
 
     // apply the projection's clipping to the window crop in
     // layerstack space, and convert-back to layer space.
@@ -107,7 +112,7 @@ Rect OutputLayer::calculateInitialCrop() const {
 }
 
 FloatRect OutputLayer::calculateOutputSourceCrop() const {
-    const auto& layerState = *getLayerFE().getCompositionState();
+    const auto& layerState = *getLayerFEState();
     const auto& outputState = getOutput().getState();
 
     if (!layerState.geomUsesSourceCrop) {
@@ -185,7 +190,7 @@ FloatRect OutputLayer::calculateOutputSourceCrop() const {
 }
 
 Rect OutputLayer::calculateOutputDisplayFrame() const {
-    const auto& layerState = *getLayerFE().getCompositionState();
+    const auto& layerState = *getLayerFEState();
     const auto& outputState = getOutput().getState();
 
     // apply the layer's transform, followed by the display's global transform
@@ -243,7 +248,7 @@ Rect OutputLayer::calculateOutputDisplayFrame() const {
 
 uint32_t OutputLayer::calculateOutputRelativeBufferTransform(
         uint32_t internalDisplayRotationFlags) const {
-    const auto& layerState = *getLayerFE().getCompositionState();
+    const auto& layerState = *getLayerFEState();
     const auto& outputState = getOutput().getState();
 
     /*
@@ -286,7 +291,7 @@ uint32_t OutputLayer::calculateOutputRelativeBufferTransform(
 void OutputLayer::updateCompositionState(
         bool includeGeometry, bool forceClientComposition,
         ui::Transform::RotationFlags internalDisplayRotationFlags) {
-    const auto* layerFEState = getLayerFE().getCompositionState();
+    const auto* layerFEState = getLayerFEState();
     if (!layerFEState) {
         return;
     }
@@ -345,7 +350,7 @@ void OutputLayer::writeStateToHWC(bool includeGeometry, bool skipLayer, uint32_t
         return;
     }
 
-    const auto* outputIndependentState = getLayerFE().getCompositionState();
+    const auto* outputIndependentState = getLayerFEState();
     if (!outputIndependentState) {
         return;
     }
@@ -40,6 +40,7 @@ void dumpHwc(const OutputLayerCompositionState::Hwc& hwc, std::string& out) {
     }
 
     dumpVal(out, "composition", toString(hwc.hwcCompositionType), hwc.hwcCompositionType);
+    hwc.hwcBufferCache.dump(out);
 }
 
 } // namespace
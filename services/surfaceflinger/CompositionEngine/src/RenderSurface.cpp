@@ -256,6 +256,15 @@ void RenderSurface::queueBuffer(base::unique_fd readyFence) {
     }
 }
 
+void RenderSurface::cancelBuffer() {
+    if (mTexture == nullptr) {
+        return;
+    }
+
+    mNativeWindow->cancelBuffer(mNativeWindow.get(), mTexture->getBuffer()->getNativeBuffer(), -1);
+    mTexture = nullptr;
+}
+
 void RenderSurface::onPresentDisplayCompleted() {
     mDisplaySurface->onFrameCommitted();
 }
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/WorkerPool.h>
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <log/log.h>
+#include <utils/Trace.h>
+
+namespace android::compositionengine::impl {
+
+WorkerPool::WorkerPool(size_t threadCount, const char* threadName) {
+    mThreads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        mThreads.emplace_back(&WorkerPool::threadMain, this, threadName);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mMutex);
+        mRunning = false;
+    }
+    mTaskCondition.notify_all();
+
+    for (auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void WorkerPool::run(std::vector<Task>&& tasks) {
+    ATRACE_CALL();
+
+    if (tasks.empty()) {
+        return;
+    }
+
+    {
+        std::lock_guard lock(mMutex);
+        for (size_t i = 1; i < tasks.size(); i++) {
+            mTasks.push(std::move(tasks[i]));
+        }
+        mPendingCount += tasks.size() - 1;
+    }
+    mTaskCondition.notify_all();
+
+    tasks[0]();
+
+    std::unique_lock lock(mMutex);
+    while (!mTasks.empty()) {
+        Task task = std::move(mTasks.front());
+        mTasks.pop();
+        lock.unlock();
+        task();
+        lock.lock();
+        mPendingCount--;
+    }
+    mDoneCondition.wait(lock, [this] { return mPendingCount == 0; });
+}
+
+void WorkerPool::threadMain(const char* threadName) {
+    pthread_setname_np(pthread_self(), threadName);
+
+    static constexpr int kFifoPriority = 2;
+    struct sched_param param = {0};
+    param.sched_priority = kFifoPriority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        ALOGW("Couldn't set SCHED_FIFO for %s", threadName);
+    }
+
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mTaskCondition.wait(lock, [this] { return !mRunning || !mTasks.empty(); });
+        if (mTasks.empty()) {
+            return;
+        }
+
+        Task task = std::move(mTasks.front());
+        mTasks.pop();
+        lock.unlock();
+        task();
+        lock.lock();
+
+        if (--mPendingCount == 0) {
+            mDoneCondition.notify_one();
+        }
+    }
+}
+
+} // namespace android::compositionengine::impl
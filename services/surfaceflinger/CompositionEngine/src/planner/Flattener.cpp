@@ -25,6 +25,8 @@
 
 #include <gui/TraceUtils.h>
 
+#include <algorithm>
+
 using time_point = std::chrono::steady_clock::time_point;
 using namespace std::chrono_literals;
 
@@ -86,9 +88,16 @@ NonBufferHash Flattener::flattenLayers(const std::vector<const LayerState*>& lay
     // 3. A stricter equality check demonstrates that the layer stack really did change, since the
     // hashed geometry does not guarantee uniqueness.
     if (mCurrentGeometry != hash || (!mLayers.empty() && !isSameStack(layers, mLayers))) {
+        std::vector<CachedSet> retained = retainCachedSets(layers, now);
         resetActivities(hash, now);
-        mFlattenedDisplayCost += unflattenedDisplayCost;
-        return hash;
+        if (retained.empty()) {
+            mFlattenedDisplayCost += unflattenedDisplayCost;
+            return hash;
+        }
+
+        // Merge with the CachedSets that are still valid as if the stack had not changed, so that
+        // their buffers keep being used from this frame on.
+        mLayers = std::move(retained);
     }
 
     ++mInitialLayerCounts[layers.size()];
@@ -199,12 +208,27 @@ void Flattener::dump(std::string& result) const {
     base::StringAppendF(&result, "    Cost: %.2f\n",
                         static_cast<float>(mCachedSetCreationCost) / displayArea);
 
+    const size_t invalidatedCount =
+            std::accumulate(mInvalidatedCachedSetAges.cbegin(), mInvalidatedCachedSetAges.cend(),
+                            size_t(0), [](size_t sum, const auto& entry) {
+                                return sum + entry.second;
+                            });
+    base::StringAppendF(&result, "\n    Cached set hits (frames used): %zd\n", mCachedSetHitCount);
+    base::StringAppendF(&result, "    Cached set misses (invalidated): %zd\n", invalidatedCount);
+    base::StringAppendF(&result, "    Retained across layer stack changes: %zd\n",
+                        mRetainedCachedSetCount);
+    base::StringAppendF(&result, "    Composition cost saved: %.2f\n",
+                        static_cast<float>(mCachedSetSavedCost) / displayArea);
+
     const auto lastUpdate =
             std::chrono::duration_cast<std::chrono::milliseconds>(now - mLastGeometryUpdate);
     base::StringAppendF(&result, "\n  Current hash %016zx, last update %sago\n\n", mCurrentGeometry,
                         durationString(lastUpdate).c_str());
 
     dumpLayers(result);
+
+    result.append("\n\n");
+    mTexturePool.dump(result);
 }
 
 size_t Flattener::calculateDisplayCost(const std::vector<const LayerState*>& layers) const {
@@ -253,6 +277,75 @@ void Flattener::resetActivities(NonBufferHash hash, time_point now) {
     }
 }
 
+std::vector<CachedSet> Flattener::retainCachedSets(const std::vector<const LayerState*>& layers,
+                                                   time_point now) {
+    ATRACE_CALL();
+
+    // Holes are punched for, and blurs are rendered from, the layers behind a CachedSet, which may
+    // be the ones that changed.
+    const auto canRetain = [](const CachedSet& cachedSet) {
+        if (cachedSet.getLayerCount() <= 1 || !cachedSet.hasReadyBuffer() ||
+            cachedSet.getHolePunchLayer() || cachedSet.getBlurLayer() ||
+            cachedSet.hasBlurBehind() || cachedSet.hasBufferUpdate()) {
+            return false;
+        }
+        return std::all_of(cachedSet.getConstituentLayers().begin(),
+                           cachedSet.getConstituentLayers().end(),
+                           [](const CachedSet::Layer& layer) {
+                               return layer.getHash() == layer.getState()->getHash();
+                           });
+    };
+
+    const auto matchesLayers = [&](const CachedSet& cachedSet,
+                                   std::vector<const LayerState*>::const_iterator incoming) {
+        const auto& constituents = cachedSet.getConstituentLayers();
+        if (static_cast<size_t>(layers.end() - incoming) < constituents.size()) {
+            return false;
+        }
+        return std::equal(constituents.begin(), constituents.end(), incoming,
+                          [](const CachedSet::Layer& layer, const LayerState* state) {
+                              return layer.getState()->getId() == state->getId();
+                          });
+    };
+
+    std::vector<CachedSet> retained;
+    bool retainedAny = false;
+    for (auto incoming = layers.begin(); incoming != layers.end();) {
+        const auto it = std::find_if(mLayers.begin(), mLayers.end(), [&](const CachedSet& set) {
+            return set.getFirstLayer().getState()->getId() == (*incoming)->getId() &&
+                    canRetain(set) && matchesLayers(set, incoming);
+        });
+
+        if (it == mLayers.end()) {
+            retained.emplace_back(*incoming, now);
+            ++incoming;
+            continue;
+        }
+
+        ALOGV("[%s] Retaining cached set starting at %s", __func__,
+              it->getFirstLayer().getName().c_str());
+        incoming += static_cast<std::ptrdiff_t>(it->getLayerCount());
+        retained.push_back(std::move(*it));
+        mLayers.erase(it);
+        ++mRetainedCachedSetCount;
+        retainedAny = true;
+    }
+
+    if (!retainedAny) {
+        return {};
+    }
+    return retained;
+}
+
+void Flattener::recordCachedSetHit(const CachedSet& cachedSet) {
+    ++mCachedSetHitCount;
+    const size_t componentCost = cachedSet.getComponentDisplayCost();
+    const size_t cost = cachedSet.getDisplayCost();
+    if (componentCost > cost) {
+        mCachedSetSavedCost += componentCost - cost;
+    }
+}
+
 NonBufferHash Flattener::computeLayersHash() const{
     size_t hash = 0;
     for (const auto& layer : mLayers) {
@@ -342,6 +435,7 @@ bool Flattener::mergeWithCachedSets(const std::vector<const LayerState*>& layers
                     skipCount -= layerCount;
                 }
                 priorBlurLayer = mNewCachedSet->getBlurLayer();
+                recordCachedSetHit(*mNewCachedSet);
                 merged.emplace_back(std::move(*mNewCachedSet));
                 mNewCachedSet = std::nullopt;
                 continue;
@@ -350,6 +444,9 @@ bool Flattener::mergeWithCachedSets(const std::vector<const LayerState*>& layers
 
         if (!currentLayerIter->hasBufferUpdate()) {
             currentLayerIter->incrementAge();
+            if (currentLayerIter->hasRenderedBuffer()) {
+                recordCachedSetHit(*currentLayerIter);
+            }
             merged.emplace_back(*currentLayerIter);
 
             // Skip the incoming layers corresponding to this valid current layer
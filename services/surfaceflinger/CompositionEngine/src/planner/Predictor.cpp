@@ -23,6 +23,15 @@
 
 namespace android::compositionengine::impl::planner {
 
+ApproximateMatchSignature getApproximateMatchSignature(
+        const std::vector<const LayerState*>& layers) {
+    size_t signature = std::hash<size_t>{}(layers.size());
+    for (const LayerState* layer : layers) {
+        android::hashCombineSingle(signature, layer->getCompositionType());
+    }
+    return signature;
+}
+
 std::optional<LayerStack::ApproximateMatch> LayerStack::getApproximateMatch(
         const std::vector<const LayerState*>& other) const {
     // Differing numbers of layers are never an approximate match
@@ -208,7 +217,26 @@ void Predictor::dump(std::string& result) const {
                         100.0f * hitCount / totalAttempts, hitCount, totalAttempts);
     base::StringAppendF(&result, "  Exact hits: %zd\n", mExactHitCount);
     base::StringAppendF(&result, "  Approximate hits: %zd\n", mApproximateHitCount);
-    base::StringAppendF(&result, "  Misses: %zd\n\n", mMissCount);
+    base::StringAppendF(&result, "  Misses: %zd\n", mMissCount);
+
+    const auto dumpAccuracy = [&](const char* name, size_t hits, size_t misses) {
+        const size_t predictions = hits + misses;
+        base::StringAppendF(&result, "  %s accuracy: %.2f%% (%zd/%zd)\n", name,
+                            predictions ? 100.0f * static_cast<float>(hits) / predictions : 0.0f,
+                            hits, predictions);
+    };
+    dumpAccuracy("Exact", mExactHitCount, mExactMissCount);
+    dumpAccuracy("Approximate", mApproximateHitCount, mApproximateMissCount);
+
+    base::StringAppendF(&result,
+                        "  Approximate lookups: %zd, %.2f stacks compared per lookup "
+                        "(%zd approximate stacks in %zd signatures)\n\n",
+                        mApproximateLookupCount,
+                        mApproximateLookupCount
+                                ? static_cast<float>(mApproximateComparisonCount) /
+                                        mApproximateLookupCount
+                                : 0.0f,
+                        mApproximateStacks.size(), mApproximateStackIndices.size());
 
     dumpPredictionsByFrequency(result);
 }
@@ -313,7 +341,14 @@ std::optional<Plan> Predictor::getExactMatch(NonBufferHash hash) const {
 
 std::optional<NonBufferHash> Predictor::getApproximateMatch(
         const std::vector<const LayerState*>& layers) const {
-    const auto approximateStackMatches = [&](const ApproximateStack& approximateStack) {
+    ++mApproximateLookupCount;
+
+    // Only stacks sharing the signature of the layers can match, so look those up first
+    const ApproximateMatchSignature signature = getApproximateMatchSignature(layers);
+
+    const auto approximateStackMatches = [&](size_t index) {
+        ++mApproximateComparisonCount;
+        const ApproximateStack& approximateStack = mApproximateStacks[index];
         const auto& exampleStack = mPredictions.at(approximateStack.hash).getExampleLayerStack();
         if (const auto approximateMatchOpt = exampleStack.getApproximateMatch(layers);
             approximateMatchOpt) {
@@ -323,24 +358,35 @@ std::optional<NonBufferHash> Predictor::getApproximateMatch(
     };
 
     const auto candidateMatches = [&](const PromotionCandidate& candidate) {
+        const LayerStack& exampleStack = candidate.prediction.getExampleLayerStack();
+        if (exampleStack.getSignature() != signature) {
+            return false;
+        }
         ALOGV("[getApproximateMatch] checking against %zx", candidate.hash);
-        return candidate.prediction.getExampleLayerStack().getApproximateMatch(layers) !=
-                std::nullopt;
+        ++mApproximateComparisonCount;
+        return exampleStack.getApproximateMatch(layers) != std::nullopt;
     };
 
     const Prediction* match = nullptr;
     NonBufferHash hash;
-    if (const auto approximateStackIter =
-                std::find_if(mApproximateStacks.cbegin(), mApproximateStacks.cend(),
-                             approximateStackMatches);
-        approximateStackIter != mApproximateStacks.cend()) {
-        match = &mPredictions.at(approximateStackIter->hash);
-        hash = approximateStackIter->hash;
-    } else if (const auto candidateEntry =
-                       std::find_if(mCandidates.cbegin(), mCandidates.cend(), candidateMatches);
-               candidateEntry != mCandidates.cend()) {
-        match = &(candidateEntry->prediction);
-        hash = candidateEntry->hash;
+    if (const auto indicesEntry = mApproximateStackIndices.find(signature);
+        indicesEntry != mApproximateStackIndices.cend()) {
+        const auto& [_, indices] = *indicesEntry;
+        if (const auto indexIter =
+                    std::find_if(indices.cbegin(), indices.cend(), approximateStackMatches);
+            indexIter != indices.cend()) {
+            hash = mApproximateStacks[*indexIter].hash;
+            match = &mPredictions.at(hash);
+        }
+    }
+
+    if (match == nullptr) {
+        if (const auto candidateEntry =
+                    std::find_if(mCandidates.cbegin(), mCandidates.cend(), candidateMatches);
+            candidateEntry != mCandidates.cend()) {
+            match = &(candidateEntry->prediction);
+            hash = candidateEntry->hash;
+        }
     }
 
     if (match == nullptr) {
@@ -355,6 +401,13 @@ std::optional<NonBufferHash> Predictor::getApproximateMatch(
     return hash;
 }
 
+void Predictor::addApproximateStack(const ApproximateStack& approximateStack) {
+    const ApproximateMatchSignature signature =
+            getPrediction(approximateStack.hash).getExampleLayerStack().getSignature();
+    mApproximateStackIndices[signature].push_back(mApproximateStacks.size());
+    mApproximateStacks.push_back(approximateStack);
+}
+
 void Predictor::promoteIfCandidate(NonBufferHash predictionHash) {
     // Return if the candidate has already been promoted
     if (mPredictions.count(predictionHash) != 0) {
@@ -380,6 +433,11 @@ void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
               to_string(result).c_str());
         prediction.recordMiss(predictedPlan.type);
         ++mMissCount;
+        if (predictedPlan.type == Prediction::Type::Approximate) {
+            ++mApproximateMissCount;
+        } else {
+            ++mExactMissCount;
+        }
         return;
     }
 
@@ -410,7 +468,7 @@ void Predictor::recordPredictedResult(PredictedPlan predictedPlan,
             const auto approximateMatchOpt =
                     prediction.getExampleLayerStack().getApproximateMatch(layers);
             ALOGE_IF(!approximateMatchOpt, "Expected an approximate match");
-            mApproximateStacks.emplace_back(predictedPlan.hash, *approximateMatchOpt);
+            addApproximateStack({predictedPlan.hash, *approximateMatchOpt});
         }
     }
 
@@ -445,7 +503,7 @@ bool Predictor::findSimilarPrediction(const std::vector<const LayerState*>& laye
 
     ALOGV("[%s] Adding %zx to approximate stacks", __func__, bestMatch->hash);
 
-    mApproximateStacks.emplace_back(*bestMatch);
+    addApproximateStack(*bestMatch);
     return true;
 }
 
@@ -19,6 +19,7 @@
 #undef LOG_TAG
 #define LOG_TAG "Planner"
 
+#include <android-base/stringprintf.h>
 #include <compositionengine/impl/planner/TexturePool.h>
 #include <utils/Log.h>
 
@@ -32,18 +33,48 @@ void TexturePool::setDisplaySize(ui::Size size) {
     mPool.clear();
     mPool.resize(kMinPoolSize);
     std::generate_n(mPool.begin(), kMinPoolSize, [&]() { return Entry{genTexture(), nullptr}; });
+    mTargetPoolSize = kMinPoolSize;
+    mWindowBorrowCount = 0;
 }
 
 std::shared_ptr<TexturePool::AutoTexture> TexturePool::borrowTexture() {
     if (mPool.empty()) {
+        mMissCount++;
+        mWindowHadMiss = true;
+        // Retain one more texture from now on, as the pool fell short of the demand.
+        mTargetPoolSize = std::min(mTargetPoolSize + 1, kMaxPoolSize);
+        updateShrinkWindow();
         return std::make_shared<AutoTexture>(*this, genTexture(), nullptr);
     }
 
+    mHitCount++;
     const auto entry = mPool.front();
     mPool.pop_front();
+    updateShrinkWindow();
     return std::make_shared<AutoTexture>(*this, entry.texture, entry.fence);
 }
 
+void TexturePool::updateShrinkWindow() {
+    mWindowMinIdleCount =
+            mWindowBorrowCount == 0 ? mPool.size() : std::min(mWindowMinIdleCount, mPool.size());
+    if (++mWindowBorrowCount < kShrinkWindow) {
+        return;
+    }
+
+    // Textures that stayed idle for the whole window are not needed to serve the demand.
+    if (!mWindowHadMiss && mWindowMinIdleCount > 0 && mTargetPoolSize > kMinPoolSize) {
+        mTargetPoolSize--;
+        if (mPool.size() > mTargetPoolSize) {
+            ALOGV("Deallocating texture from Planner's pool - target size lowered to %zu",
+                  mTargetPoolSize);
+            mPool.pop_back();
+        }
+    }
+
+    mWindowBorrowCount = 0;
+    mWindowHadMiss = false;
+}
+
 void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&& texture,
                                 const sp<Fence>& fence) {
     // Drop the texture on the floor if the pool is no longer tracking textures of the same size.
@@ -56,16 +87,28 @@ void TexturePool::returnTexture(std::shared_ptr<renderengine::ExternalTexture>&&
         return;
     }
 
-    // Also ensure the pool does not grow beyond a maximum size.
-    if (mPool.size() == kMaxPoolSize) {
-        ALOGD("Deallocating texture from Planner's pool - max size [%" PRIu64 "] reached",
-              static_cast<uint64_t>(kMaxPoolSize));
+    // Also ensure the pool does not grow beyond its target size.
+    if (mPool.size() >= mTargetPoolSize) {
+        ALOGD("Deallocating texture from Planner's pool - target size [%" PRIu64 "] reached",
+              static_cast<uint64_t>(mTargetPoolSize));
         return;
     }
 
     mPool.push_back({std::move(texture), fence});
 }
 
+void TexturePool::dump(std::string& result) const {
+    const size_t borrowCount = mHitCount + mMissCount;
+    base::StringAppendF(&result, "  Texture pool: %zu idle, retaining up to %zu (%zu..%zu)\n",
+                        mPool.size(), mTargetPoolSize, kMinPoolSize, kMaxPoolSize);
+    base::StringAppendF(&result, "    Borrows: %zu hits, %zu misses (%.1f%% hit rate)\n",
+                        mHitCount, mMissCount,
+                        borrowCount == 0
+                                ? 0.f
+                                : 100.f * static_cast<float>(mHitCount) /
+                                        static_cast<float>(borrowCount));
+}
+
 std::shared_ptr<renderengine::ExternalTexture> TexturePool::genTexture() {
     LOG_ALWAYS_FATAL_IF(!mSize.isValid(), "Attempted to generate texture with invalid size");
     return std::make_shared<
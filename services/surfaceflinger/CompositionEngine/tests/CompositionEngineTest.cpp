@@ -31,7 +31,10 @@ namespace {
 
 using ::testing::_;
 using ::testing::DoAll;
+using ::testing::Field;
 using ::testing::InSequence;
+using ::testing::IsNull;
+using ::testing::Invoke;
 using ::testing::Ref;
 using ::testing::Return;
 using ::testing::ReturnRef;
@@ -123,6 +126,107 @@ TEST_F(CompositionEnginePresentTest, worksAsExpected) {
     mEngine.present(mRefreshArgs);
 }
 
+TEST_F(CompositionEnginePresentTest, presentsOutputsInParallelIfRequested) {
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+
+    std::mutex* hwcMutex = nullptr;
+    for (const auto& output : {mOutput1, mOutput2, mOutput3}) {
+        EXPECT_CALL(*output, prepare(Ref(mRefreshArgs), _));
+        EXPECT_CALL(*output, updateLayerStateFromFE(Ref(mRefreshArgs)));
+        EXPECT_CALL(*output, getOutputLayerCount()).WillRepeatedly(Return(0u));
+
+        // Each output is presented while the HWC lock is available to it.
+        EXPECT_CALL(*output, present(Ref(mRefreshArgs)))
+                .WillOnce(Invoke([&](const CompositionRefreshArgs& args) {
+                    EXPECT_NE(nullptr, args.hwcMutex);
+                    std::lock_guard lock(*args.hwcMutex);
+                    hwcMutex = args.hwcMutex;
+                }));
+    }
+
+    mRefreshArgs.presentOutputsInParallel = true;
+    mRefreshArgs.outputs = {mOutput1, mOutput2, mOutput3};
+    mEngine.present(mRefreshArgs);
+
+    EXPECT_NE(nullptr, hwcMutex);
+    EXPECT_EQ(nullptr, mRefreshArgs.hwcMutex);
+}
+
+TEST_F(CompositionEnginePresentTest, presentsOutputsSeriallyWithProtectedContent) {
+    StrictMock<mock::OutputLayer> outputLayer;
+    sp<StrictMock<mock::LayerFE>> layerFE = sp<StrictMock<mock::LayerFE>>::make();
+    LayerFECompositionState layerFEState;
+    layerFEState.hasProtectedContent = true;
+
+    EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(*layerFE));
+    EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+    EXPECT_CALL(*mOutput1, getOutputLayerCount()).WillRepeatedly(Return(0u));
+    EXPECT_CALL(*mOutput2, getOutputLayerCount()).WillRepeatedly(Return(1u));
+    EXPECT_CALL(*mOutput2, getOutputLayerOrderedByZByIndex(0)).WillRepeatedly(Return(&outputLayer));
+
+    InSequence seq;
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput2, prepare(Ref(mRefreshArgs), _));
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput2, updateLayerStateFromFE(Ref(mRefreshArgs)));
+    EXPECT_CALL(*mOutput1, present(Field(&CompositionRefreshArgs::hwcMutex, IsNull())));
+    EXPECT_CALL(*mOutput2, present(Field(&CompositionRefreshArgs::hwcMutex, IsNull())));
+
+    mRefreshArgs.presentOutputsInParallel = true;
+    mRefreshArgs.outputs = {mOutput1, mOutput2};
+    mEngine.present(mRefreshArgs);
+}
+
+TEST_F(CompositionEnginePresentTest, publishesLayerSnapshotsWhilePresentingIfRequested) {
+    StrictMock<mock::OutputLayer> outputLayer;
+    impl::OutputLayerCompositionState outputLayerState;
+    sp<StrictMock<mock::LayerFE>> layerFE = sp<StrictMock<mock::LayerFE>>::make();
+    LayerFECompositionState layerFEState;
+    layerFEState.alpha = 0.5f;
+
+    EXPECT_CALL(outputLayer, getLayerFE()).WillRepeatedly(ReturnRef(*layerFE));
+    EXPECT_CALL(outputLayer, getState()).WillRepeatedly(ReturnRef(outputLayerState));
+    EXPECT_CALL(outputLayer, editState()).WillRepeatedly(ReturnRef(outputLayerState));
+    EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+    EXPECT_CALL(*mOutput1, getOutputLayerCount()).WillRepeatedly(Return(1u));
+    EXPECT_CALL(*mOutput1, getOutputLayerOrderedByZByIndex(0)).WillRepeatedly(Return(&outputLayer));
+
+    EXPECT_CALL(mEngine, preComposition(Ref(mRefreshArgs))).Times(3);
+    EXPECT_CALL(*mOutput1, prepare(Ref(mRefreshArgs), _)).Times(3);
+    EXPECT_CALL(*mOutput1, updateLayerStateFromFE(Ref(mRefreshArgs))).Times(3);
+
+    float presentedAlpha = 0.f;
+    EXPECT_CALL(*mOutput1, present(Ref(mRefreshArgs)))
+            .Times(3)
+            .WillRepeatedly(Invoke([&](const CompositionRefreshArgs&) {
+                ASSERT_NE(nullptr, outputLayerState.layerFESnapshot);
+                EXPECT_NE(&layerFEState, outputLayerState.layerFESnapshot);
+                presentedAlpha = outputLayerState.layerFESnapshot->alpha;
+            }));
+
+    mRefreshArgs.publishLayerSnapshots = true;
+    mRefreshArgs.outputs = {mOutput1};
+    mRefreshArgs.layers = {layerFE};
+
+    // The geometry update copies the state of every layer.
+    mRefreshArgs.updatingGeometryThisFrame = true;
+    mEngine.present(mRefreshArgs);
+    EXPECT_EQ(0.5f, presentedAlpha);
+    EXPECT_EQ(nullptr, outputLayerState.layerFESnapshot);
+
+    // Otherwise, the copy is only refreshed for layers with queued frames.
+    layerFEState.alpha = 0.25f;
+    mRefreshArgs.updatingGeometryThisFrame = false;
+    mEngine.present(mRefreshArgs);
+    EXPECT_EQ(0.5f, presentedAlpha);
+
+    mRefreshArgs.layersWithQueuedFrames = {layerFE};
+    mEngine.present(mRefreshArgs);
+    EXPECT_EQ(0.25f, presentedAlpha);
+}
+
 /*
  * CompositionEngine::updateCursorAsync
  */
@@ -44,6 +44,7 @@ namespace {
 namespace hal = android::hardware::graphics::composer::hal;
 
 using testing::_;
+using testing::AnyNumber;
 using testing::DoAll;
 using testing::Eq;
 using testing::InSequence;
@@ -123,6 +124,8 @@ struct DisplayTestCommon : public testing::Test {
         MOCK_METHOD1(applyChangedTypesToLayers, void(const impl::Display::ChangedTypes&));
         MOCK_METHOD1(applyDisplayRequests, void(const impl::Display::DisplayRequests&));
         MOCK_METHOD1(applyLayerRequestsToLayers, void(const impl::Display::LayerRequests&));
+        MOCK_METHOD1(predictClientComposition, void(const CompositionRefreshArgs&));
+        MOCK_METHOD0(confirmPredictedClientComposition, void());
 
         const compositionengine::CompositionEngine& mCompositionEngine;
         impl::OutputCompositionState mState;
@@ -647,6 +650,136 @@ TEST_F(DisplayChooseCompositionStrategyTest, normalOperationWithChanges) {
     EXPECT_TRUE(state.usesDeviceComposition);
 }
 
+/*
+ * Display::canPredictCompositionStrategy()
+ * Display::prepareFrameAsync()
+ */
+
+struct DisplayPrepareFrameAsyncTest : public PartialMockDisplayTestCommon {
+    DisplayPrepareFrameAsyncTest() {
+        mDisplay->setRenderSurfaceForTest(std::unique_ptr<RenderSurface>(mRenderSurface));
+        mDisplay->editState().isEnabled = true;
+        mDisplay->setCompositionStrategyPredictionEnabled(true);
+
+        EXPECT_CALL(*mDisplay, getOutputLayerCount()).WillRepeatedly(Return(0u));
+        EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillRepeatedly(Return(true));
+        EXPECT_CALL(*mDisplay, allLayersRequireClientComposition()).WillRepeatedly(Return(false));
+        EXPECT_CALL(*mDisplay, applyChangedTypesToLayers(_)).Times(AnyNumber());
+        EXPECT_CALL(*mDisplay, applyDisplayRequests(_)).Times(AnyNumber());
+        EXPECT_CALL(*mDisplay, applyLayerRequestsToLayers(_)).Times(AnyNumber());
+    }
+
+    // Has the HWC choose mChanges, which predicts the strategy of the next frame.
+    void choosePreviousStrategy() {
+        EXPECT_CALL(mHwComposer,
+                    getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), _, _, _, _))
+                .WillOnce(DoAll(SetArgPointee<4>(mChanges), Return(NO_ERROR)));
+        mDisplay->chooseCompositionStrategy();
+    }
+
+    mock::RenderSurface* mRenderSurface = new StrictMock<mock::RenderSurface>();
+    CompositionRefreshArgs mRefreshArgs;
+    android::HWComposer::DeviceRequestedChanges mChanges{
+            {{nullptr, hal::Composition::CLIENT}},
+            hal::DisplayRequest::FLIP_CLIENT_TARGET,
+            {{nullptr, hal::LayerRequest::CLEAR_CLIENT_TARGET}},
+            {hal::PixelFormat::RGBA_8888, hal::Dataspace::UNKNOWN},
+    };
+};
+
+TEST_F(DisplayPrepareFrameAsyncTest, predictsOnceTheHwcChoseAStrategy) {
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+
+    choosePreviousStrategy();
+    EXPECT_TRUE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+
+    mDisplay->setCompositionStrategyPredictionEnabled(false);
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, doesNotPredictWithoutClientComposition) {
+    EXPECT_CALL(*mDisplay, anyLayersRequireClientComposition()).WillRepeatedly(Return(false));
+    choosePreviousStrategy();
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, doesNotPredictWhenPresentingOutputsInParallel) {
+    choosePreviousStrategy();
+
+    std::mutex hwcMutex;
+    mRefreshArgs.hwcMutex = &hwcMutex;
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, doesNotPredictAfterHwcError) {
+    choosePreviousStrategy();
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), _, _, _, _))
+            .WillOnce(Return(INVALID_OPERATION));
+    mDisplay->chooseCompositionStrategy();
+
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, confirmsThePredictedClientCompositionOnHit) {
+    choosePreviousStrategy();
+
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true)).Times(2);
+    EXPECT_CALL(*mDisplay, predictClientComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), true, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<4>(mChanges), Return(NO_ERROR)));
+    EXPECT_CALL(*mDisplay, confirmPredictedClientComposition());
+
+    mDisplay->prepareFrameAsync(mRefreshArgs);
+
+    auto& state = mDisplay->getState();
+    EXPECT_TRUE(state.usesClientComposition);
+    EXPECT_TRUE(state.usesDeviceComposition);
+    EXPECT_TRUE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, appliesTheChosenStrategyOnMiss) {
+    choosePreviousStrategy();
+
+    const android::HWComposer::DeviceRequestedChanges changes{
+            {},
+            static_cast<hal::DisplayRequest>(0),
+            {},
+            {hal::PixelFormat::RGBA_8888, hal::Dataspace::UNKNOWN},
+    };
+
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true)).Times(2);
+    EXPECT_CALL(*mDisplay, predictClientComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), true, _, _, _))
+            .WillOnce(DoAll(SetArgPointee<4>(changes), Return(NO_ERROR)));
+    EXPECT_CALL(*mDisplay, applyChangedTypesToLayers(changes.changedTypes)).Times(1);
+    EXPECT_CALL(*mDisplay, applyDisplayRequests(changes.displayRequests)).Times(1);
+    EXPECT_CALL(*mDisplay, applyLayerRequestsToLayers(changes.layerRequests)).Times(1);
+
+    mDisplay->prepareFrameAsync(mRefreshArgs);
+}
+
+TEST_F(DisplayPrepareFrameAsyncTest, fallsBackToClientCompositionOnHwcError) {
+    choosePreviousStrategy();
+
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, true));
+    EXPECT_CALL(*mDisplay, predictClientComposition(Ref(mRefreshArgs)));
+    EXPECT_CALL(mHwComposer,
+                getDeviceCompositionChanges(HalDisplayId(DEFAULT_DISPLAY_ID), true, _, _, _))
+            .WillOnce(Return(INVALID_OPERATION));
+    EXPECT_CALL(*mRenderSurface, prepareFrame(true, false));
+
+    mDisplay->prepareFrameAsync(mRefreshArgs);
+
+    auto& state = mDisplay->getState();
+    EXPECT_TRUE(state.usesClientComposition);
+    EXPECT_FALSE(state.usesDeviceComposition);
+    EXPECT_FALSE(mDisplay->canPredictCompositionStrategy(mRefreshArgs));
+}
+
 /*
  * Display::getSkipColorTransform()
  */
@@ -19,6 +19,8 @@
 #include <gui/BufferQueue.h>
 #include <ui/GraphicBuffer.h>
 
+#include <vector>
+
 namespace android::compositionengine {
 namespace {
 
@@ -78,8 +80,104 @@ TEST_F(HwcBufferCacheTest, cacheWorksForMaxSlot) {
     testSlot(BufferQueue::NUM_BUFFER_SLOTS - 1, BufferQueue::NUM_BUFFER_SLOTS - 1);
 }
 
-TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToZero) {
-    testSlot(-123, 0);
+TEST_F(HwcBufferCacheTest, cacheMapsNegativeSlotToLeastRecentlyUsed) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(-123, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    // A new buffer without a slot does not evict the first one.
+    mCache.getHwcBuffer(-123, mBuffer2, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer2, outBuffer);
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+    EXPECT_EQ(0u, mCache.getEvictionCount());
+}
+
+TEST_F(HwcBufferCacheTest, cacheDoesNotResendCyclingBuffersWithoutSlot) {
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (int i = 0; i < 3; i++) {
+        buffers.push_back(new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0));
+    }
+
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+    for (const auto& buffer : buffers) {
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffer, &outSlot, &outBuffer);
+        EXPECT_EQ(buffer, outBuffer);
+    }
+
+    for (int frame = 0; frame < 10; frame++) {
+        const auto& buffer = buffers[static_cast<size_t>(frame) % buffers.size()];
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffer, &outSlot, &outBuffer);
+        EXPECT_EQ(nullptr, outBuffer.get());
+    }
+
+    EXPECT_EQ(3u, mCache.getSendCount());
+    EXPECT_EQ(10u, mCache.getHitCount());
+}
+
+TEST_F(HwcBufferCacheTest, cacheFindsBufferInAnySlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(3, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(3u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+
+    mCache.getHwcBuffer(5, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(3u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+}
+
+TEST_F(HwcBufferCacheTest, cacheEvictsLeastRecentlyUsedBufferWithoutSlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    // Fill every slot but the flattener's, touching the buffer in slot 0 last.
+    std::vector<sp<GraphicBuffer>> buffers;
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS; i++) {
+        buffers.push_back(new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0));
+        mCache.getHwcBuffer(i, buffers.back(), &outSlot, &outBuffer);
+    }
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers[0], &outSlot, &outBuffer);
+    EXPECT_EQ(0u, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
+
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, mBuffer1, &outSlot, &outBuffer);
+    EXPECT_EQ(1u, outSlot);
+    EXPECT_EQ(mBuffer1, outBuffer);
+    EXPECT_EQ(1u, mCache.getEvictionCount());
+
+    // The evicted buffer has to be sent again.
+    mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffers[1], &outSlot, &outBuffer);
+    EXPECT_EQ(2u, outSlot);
+    EXPECT_EQ(buffers[1], outBuffer);
+}
+
+TEST_F(HwcBufferCacheTest, cacheDoesNotEvictFlattenerSlot) {
+    uint32_t outSlot;
+    sp<GraphicBuffer> outBuffer;
+
+    mCache.getHwcBuffer(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, mBuffer1, &outSlot,
+                        &outBuffer);
+    EXPECT_EQ(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, outSlot);
+
+    for (int i = 0; i < BufferQueue::NUM_BUFFER_SLOTS + 1; i++) {
+        sp<GraphicBuffer> buffer = new GraphicBuffer(1, 1, HAL_PIXEL_FORMAT_RGBA_8888, 1, 0);
+        mCache.getHwcBuffer(BufferQueue::INVALID_BUFFER_SLOT, buffer, &outSlot, &outBuffer);
+        EXPECT_NE(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, outSlot);
+    }
+
+    mCache.getHwcBuffer(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, mBuffer1, &outSlot,
+                        &outBuffer);
+    EXPECT_EQ(impl::HwcBufferCache::FLATTENER_CACHING_SLOT, outSlot);
+    EXPECT_EQ(nullptr, outBuffer.get());
 }
 
 } // namespace
@@ -31,6 +31,7 @@
 
 #include <cmath>
 #include <cstdint>
+#include <random>
 
 #include "CallOrderStateMachineHelper.h"
 #include "MockHWC2.h"
@@ -1748,6 +1749,199 @@ TEST_F(OutputEnsureOutputLayerIfVisibleTest, takesNotSoEarlyOutifLayerWithShadow
     ensureOutputLayerIfVisible();
 }
 
+/*
+ * Output::ensureOutputLayerIfVisible() reusing the cached coverage
+ */
+
+struct OutputCoverageCacheTest : public testing::Test {
+    static constexpr uint32_t kLayerStack = 1u;
+    static const Rect kDisplayBounds;
+
+    struct Layer {
+        Layer() {
+            EXPECT_CALL(*layerFE, getCompositionState()).WillRepeatedly(Return(&layerFEState));
+            EXPECT_CALL(*layerFE, prepareCompositionState(_)).WillRepeatedly(Return());
+
+            layerFEState.layerStackId = kLayerStack;
+        }
+
+        void setBounds(float left, float top, float right, float bottom) {
+            layerFEState.geomLayerBounds = FloatRect{0, 0, right - left, bottom - top};
+            layerFEState.geomLayerTransform.set(left, top);
+        }
+
+        sp<StrictMock<mock::LayerFE>> layerFE = new StrictMock<mock::LayerFE>();
+        LayerFECompositionState layerFEState;
+    };
+
+    OutputCoverageCacheTest() {
+        mFullOutput->setCoverageCacheEnabledForTest(false);
+
+        for (auto* output : {mCachedOutput.get(), mFullOutput.get()}) {
+            auto& state = output->editState();
+            state.isEnabled = true;
+            state.layerStackId = kLayerStack;
+            state.displaySpace.bounds = kDisplayBounds;
+            state.layerStackSpace.content = kDisplayBounds;
+            state.transform = ui::Transform(TR_IDENT, kDisplayBounds.width(),
+                                            kDisplayBounds.height());
+        }
+
+        mRefreshArgs.updatingOutputGeometryThisFrame = true;
+    }
+
+    Layer& addLayer(float left, float top, float right, float bottom) {
+        mLayers.push_back(std::make_unique<Layer>());
+        mLayers.back()->setBounds(left, top, right, bottom);
+        return *mLayers.back();
+    }
+
+    // Rebuilds the layer stacks of both outputs, and checks that they agree.
+    void rebuildLayerStacks() {
+        mRefreshArgs.layers.clear();
+        for (const auto& layer : mLayers) {
+            mRefreshArgs.layers.push_back(layer->layerFE);
+        }
+
+        LayerFESet cachedGeomSnapshots;
+        LayerFESet fullGeomSnapshots;
+        mCachedOutput->rebuildLayerStacks(mRefreshArgs, cachedGeomSnapshots);
+        mFullOutput->rebuildLayerStacks(mRefreshArgs, fullGeomSnapshots);
+
+        const auto& cachedState = mCachedOutput->getState();
+        const auto& fullState = mFullOutput->getState();
+        EXPECT_THAT(cachedState.dirtyRegion, RegionEq(fullState.dirtyRegion));
+        EXPECT_THAT(cachedState.undefinedRegion, RegionEq(fullState.undefinedRegion));
+
+        ASSERT_EQ(mFullOutput->getOutputLayerCount(), mCachedOutput->getOutputLayerCount());
+        for (size_t i = 0; i < mFullOutput->getOutputLayerCount(); i++) {
+            const auto* cachedLayer = mCachedOutput->getOutputLayerOrderedByZByIndex(i);
+            const auto* fullLayer = mFullOutput->getOutputLayerOrderedByZByIndex(i);
+            ASSERT_EQ(&fullLayer->getLayerFE(), &cachedLayer->getLayerFE());
+
+            const auto& cachedLayerState = cachedLayer->getState();
+            const auto& fullLayerState = fullLayer->getState();
+            EXPECT_THAT(cachedLayerState.visibleRegion, RegionEq(fullLayerState.visibleRegion));
+            EXPECT_THAT(cachedLayerState.visibleNonTransparentRegion,
+                        RegionEq(fullLayerState.visibleNonTransparentRegion));
+            EXPECT_THAT(cachedLayerState.coveredRegion, RegionEq(fullLayerState.coveredRegion));
+            EXPECT_THAT(cachedLayerState.outputSpaceVisibleRegion,
+                        RegionEq(fullLayerState.outputSpaceVisibleRegion));
+            EXPECT_THAT(cachedLayerState.shadowRegion, RegionEq(fullLayerState.shadowRegion));
+        }
+
+        // Start over for the next frame, as presenting would.
+        mCachedOutput->editState().dirtyRegion.clear();
+        mFullOutput->editState().dirtyRegion.clear();
+        for (const auto& layer : mLayers) {
+            layer->layerFEState.contentDirty = false;
+        }
+    }
+
+    StrictMock<mock::CompositionEngine> mCompositionEngine;
+    std::shared_ptr<OutputTest::Output> mCachedOutput = OutputTest::createOutput(mCompositionEngine);
+    std::shared_ptr<OutputTest::Output> mFullOutput = OutputTest::createOutput(mCompositionEngine);
+    CompositionRefreshArgs mRefreshArgs;
+    std::vector<std::unique_ptr<Layer>> mLayers;
+};
+
+const Rect OutputCoverageCacheTest::kDisplayBounds{200, 300};
+
+TEST_F(OutputCoverageCacheTest, reusesCoverageOfUnchangedLayers) {
+    for (int i = 0; i < 8; i++) {
+        addLayer(i * 10, i * 20, i * 10 + 100, i * 20 + 100).layerFEState.isOpaque = (i % 2) == 0;
+    }
+
+    // The first geometry update creates the output layers, and the second one
+    // sees them as they will be from then on.
+    rebuildLayerStacks();
+    rebuildLayerStacks();
+    EXPECT_EQ(0u, mCachedOutput->getReusedCoverageCountForTest());
+
+    rebuildLayerStacks();
+    EXPECT_EQ(mLayers.size(), mCachedOutput->getReusedCoverageCountForTest());
+
+    mLayers[3]->layerFEState.contentDirty = true;
+    rebuildLayerStacks();
+    EXPECT_EQ(mLayers.size() - 1, mCachedOutput->getReusedCoverageCountForTest());
+}
+
+TEST_F(OutputCoverageCacheTest, reusesCoverageBelowOpaqueLayerCoveringChange) {
+    for (int i = 0; i < 8; i++) {
+        addLayer(0, i * 30, 200, i * 30 + 50);
+    }
+    addLayer(0, 0, 200, 300).layerFEState.isOpaque = true;
+    auto& animatedLayer = addLayer(10, 10, 50, 50);
+    animatedLayer.layerFEState.isOpaque = false;
+
+    rebuildLayerStacks();
+    rebuildLayerStacks();
+    rebuildLayerStacks();
+    EXPECT_EQ(mLayers.size(), mCachedOutput->getReusedCoverageCountForTest());
+
+    // Only the animated layer and the one right below it are computed again,
+    // as the layers further below are covered all the same.
+    for (int i = 1; i <= 4; i++) {
+        animatedLayer.setBounds(10 + i * 10, 10, 50 + i * 10, 50);
+        rebuildLayerStacks();
+        EXPECT_EQ(mLayers.size() - 2, mCachedOutput->getReusedCoverageCountForTest());
+    }
+}
+
+TEST_F(OutputCoverageCacheTest, matchesFullComputationForRandomChanges) {
+    std::mt19937 random(0x5eed);
+    const auto randomInt = [&](int min, int max) {
+        return std::uniform_int_distribution<int>(min, max)(random);
+    };
+
+    const auto randomizeBounds = [&](Layer& layer) {
+        const int left = randomInt(-50, 200);
+        const int top = randomInt(-50, 300);
+        layer.setBounds(left, top, left + randomInt(0, 150), top + randomInt(0, 150));
+    };
+
+    for (int i = 0; i < 24; i++) {
+        auto& layer = addLayer(0, 0, 0, 0);
+        randomizeBounds(layer);
+        layer.layerFEState.isOpaque = randomInt(0, 1);
+        layer.layerFEState.transparentRegionHint = Region(Rect(0, 0, 10, 10));
+    }
+
+    const int maxIndex = static_cast<int>(mLayers.size()) - 1;
+    size_t reusedCount = 0;
+    for (int frame = 0; frame < 300; frame++) {
+        auto& layer = *mLayers[randomInt(0, maxIndex)];
+        switch (randomInt(0, 7)) {
+            case 0:
+                randomizeBounds(layer);
+                break;
+            case 1:
+                layer.layerFEState.isOpaque = !layer.layerFEState.isOpaque;
+                break;
+            case 2:
+                layer.layerFEState.isVisible = !layer.layerFEState.isVisible;
+                break;
+            case 3:
+                layer.layerFEState.shadowRadius = randomInt(0, 2) * 5.0f;
+                break;
+            case 4:
+                layer.layerFEState.contentDirty = true;
+                break;
+            case 5:
+                std::swap(mLayers[randomInt(0, maxIndex)], mLayers[randomInt(0, maxIndex)]);
+                break;
+            default:
+                // Some frames change nothing at all.
+                break;
+        }
+
+        rebuildLayerStacks();
+        reusedCount += mCachedOutput->getReusedCoverageCountForTest();
+    }
+
+    EXPECT_GT(reusedCount, 0u);
+}
+
 /*
  * Output::present()
  */
@@ -2769,6 +2963,18 @@ struct OutputFinishFrameTest : public testing::Test {
                      std::optional<base::unique_fd>(
                              const Region&, const compositionengine::CompositionRefreshArgs&));
         MOCK_METHOD0(postFramebuffer, void());
+        MOCK_METHOD0(updateProtectedContentState, bool());
+        MOCK_METHOD2(dequeueRenderBuffer,
+                     bool(base::unique_fd*, std::shared_ptr<renderengine::ExternalTexture>*));
+        MOCK_METHOD5(drawClientComposition,
+                     std::optional<base::unique_fd>(
+                             const Region&, const compositionengine::CompositionRefreshArgs&, bool,
+                             const std::shared_ptr<renderengine::ExternalTexture>&,
+                             base::unique_fd));
+        MOCK_METHOD1(setExpensiveRenderingExpected, void(bool));
+
+        using impl::Output::confirmPredictedClientComposition;
+        using impl::Output::predictClientComposition;
     };
 
     OutputFinishFrameTest() {
@@ -2809,6 +3015,82 @@ TEST_F(OutputFinishFrameTest, queuesBufferIfComposeSurfacesReturnsAFence) {
     mOutput.finishFrame(mRefreshArgs);
 }
 
+struct OutputFinishFramePredictedTest : public OutputFinishFrameTest {
+    OutputFinishFramePredictedTest() {
+        mOutput.mState.isEnabled = true;
+        mOutput.mState.usesClientComposition = true;
+    }
+
+    // Draws the client composition for the current state, as prepareFrameAsync() does.
+    void predictClientComposition() {
+        EXPECT_CALL(mOutput, updateProtectedContentState()).WillOnce(Return(false));
+        EXPECT_CALL(mOutput, dequeueRenderBuffer(_, _))
+                .WillOnce(DoAll(SetArgPointee<1>(mTexture), Return(true)));
+        EXPECT_CALL(mOutput,
+                    drawClientComposition(RegionEq(Region::INVALID_REGION), _, false, Eq(mTexture),
+                                          _))
+                .WillOnce(Return(ByMove(base::unique_fd())));
+        mOutput.predictClientComposition(mRefreshArgs);
+    }
+
+    StrictMock<renderengine::mock::RenderEngine> mRenderEngine;
+    std::shared_ptr<renderengine::ExternalTexture> mTexture = std::make_shared<
+            renderengine::ExternalTexture>(new GraphicBuffer(), mRenderEngine,
+                                           renderengine::ExternalTexture::Usage::READABLE |
+                                                   renderengine::ExternalTexture::Usage::WRITEABLE);
+};
+
+TEST_F(OutputFinishFramePredictedTest, queuesThePredictedClientCompositionOnHit) {
+    predictClientComposition();
+    mOutput.confirmPredictedClientComposition();
+
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
+TEST_F(OutputFinishFramePredictedTest, drawsAgainInThePredictedBufferOnMiss) {
+    predictClientComposition();
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, updateProtectedContentState()).WillOnce(Return(false));
+    EXPECT_CALL(mOutput,
+                drawClientComposition(RegionEq(Region::INVALID_REGION), _, false, Eq(mTexture), _))
+            .WillOnce(Return(ByMove(base::unique_fd())));
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
+TEST_F(OutputFinishFramePredictedTest, cancelsThePredictedBufferIfNotNeededOnMiss) {
+    predictClientComposition();
+    mOutput.mState.usesClientComposition = false;
+
+    InSequence seq;
+    EXPECT_CALL(*mRenderSurface, cancelBuffer());
+    EXPECT_CALL(mOutput, setExpensiveRenderingExpected(false));
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
+TEST_F(OutputFinishFramePredictedTest, composesIfThePredictionHadNoBufferOnMiss) {
+    mOutput.mState.usesClientComposition = false;
+    EXPECT_CALL(mOutput, updateProtectedContentState()).WillOnce(Return(false));
+    EXPECT_CALL(mOutput, dequeueRenderBuffer(_, _)).WillOnce(Return(true));
+    EXPECT_CALL(mOutput, drawClientComposition(RegionEq(Region::INVALID_REGION), _, false, _, _))
+            .WillOnce(Return(ByMove(base::unique_fd())));
+    mOutput.predictClientComposition(mRefreshArgs);
+    mOutput.mState.usesClientComposition = true;
+
+    InSequence seq;
+    EXPECT_CALL(mOutput, composeSurfaces(RegionEq(Region::INVALID_REGION), _))
+            .WillOnce(Return(ByMove(base::unique_fd())));
+    EXPECT_CALL(*mRenderSurface, queueBuffer(_));
+
+    mOutput.finishFrame(mRefreshArgs);
+}
+
 /*
  * Output::postFramebuffer()
  */
@@ -347,6 +347,27 @@ TEST_F(RenderSurfaceTest, queueBufferHandlesNativeWindowQueueBufferFailureOnVirt
     EXPECT_EQ(nullptr, mSurface.mutableTextureForTest().get());
 }
 
+/*
+ * RenderSurface::cancelBuffer()
+ */
+
+TEST_F(RenderSurfaceTest, cancelBufferReturnsDequeuedBuffer) {
+    const auto buffer = std::make_shared<renderengine::ExternalTexture>(new GraphicBuffer(),
+                                                                        mRenderEngine, false);
+    mSurface.mutableTextureForTest() = buffer;
+
+    EXPECT_CALL(*mNativeWindow, cancelBuffer(buffer->getBuffer()->getNativeBuffer(), -1))
+            .WillOnce(Return(NO_ERROR));
+
+    mSurface.cancelBuffer();
+
+    EXPECT_EQ(nullptr, mSurface.mutableTextureForTest().get());
+}
+
+TEST_F(RenderSurfaceTest, cancelBufferDoesNothingWithoutDequeuedBuffer) {
+    mSurface.cancelBuffer();
+}
+
 /*
  * RenderSurface::onPresentDisplayCompleted()
  */
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <compositionengine/impl/WorkerPool.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+namespace android::compositionengine {
+namespace {
+
+TEST(WorkerPoolTest, runsFirstTaskOnCallingThread) {
+    impl::WorkerPool pool(2, "WorkerPoolTest");
+
+    std::thread::id firstTaskThread;
+    std::vector<impl::WorkerPool::Task> tasks;
+    tasks.emplace_back([&] { firstTaskThread = std::this_thread::get_id(); });
+    pool.run(std::move(tasks));
+
+    EXPECT_EQ(std::this_thread::get_id(), firstTaskThread);
+}
+
+TEST(WorkerPoolTest, runsAllTasksBeforeReturning) {
+    impl::WorkerPool pool(2, "WorkerPoolTest");
+
+    for (int batch = 0; batch < 100; batch++) {
+        std::atomic<int> count = 0;
+        std::vector<impl::WorkerPool::Task> tasks;
+        for (int i = 0; i < 5; i++) {
+            tasks.emplace_back([&] { count++; });
+        }
+        pool.run(std::move(tasks));
+
+        EXPECT_EQ(5, count);
+    }
+}
+
+TEST(WorkerPoolTest, runsTasksInParallel) {
+    impl::WorkerPool pool(1, "WorkerPoolTest");
+
+    // Each task waits for the other one, so this only returns if they run at
+    // the same time.
+    std::atomic<int> started = 0;
+    const auto task = [&] {
+        started++;
+        while (started < 2) {
+            std::this_thread::yield();
+        }
+    };
+    pool.run({task, task});
+
+    EXPECT_EQ(2, started);
+}
+
+TEST(WorkerPoolTest, runsTasksWithoutThreads) {
+    impl::WorkerPool pool(0, "WorkerPoolTest");
+
+    int count = 0;
+    pool.run({[&] { count++; }, [&] { count++; }});
+
+    EXPECT_EQ(2, count);
+    EXPECT_EQ(0u, pool.getThreadCount());
+}
+
+} // namespace
+} // namespace android::compositionengine
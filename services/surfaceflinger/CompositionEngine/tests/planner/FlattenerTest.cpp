@@ -361,8 +361,8 @@ TEST_F(FlattenerTest, flattenLayers_addLayerToFlattenedCauseReset) {
     initializeOverrideBuffer(layers);
     expectAllLayersFlattened(layers);
 
-    // add a new layer to the stack, this will cause all the flatenner to reset
-    layers.push_back(layerState3.get());
+    // add a new layer in the middle of the stack, this will cause all the flatenner to reset
+    layers.insert(layers.begin() + 1, layerState3.get());
 
     initializeOverrideBuffer(layers);
     EXPECT_EQ(getNonBufferHash(layers),
@@ -374,6 +374,52 @@ TEST_F(FlattenerTest, flattenLayers_addLayerToFlattenedCauseReset) {
     EXPECT_EQ(nullptr, overrideBuffer3);
 }
 
+TEST_F(FlattenerTest, flattenLayers_addLayerAboveFlattenedKeepsCachedSet) {
+    auto& layerState1 = mTestLayers[0]->layerState;
+    const auto& overrideBuffer1 = layerState1->getOutputLayer()->getState().overrideInfo.buffer;
+
+    auto& layerState2 = mTestLayers[1]->layerState;
+    const auto& overrideBuffer2 = layerState2->getOutputLayer()->getState().overrideInfo.buffer;
+
+    auto& layerState3 = mTestLayers[2]->layerState;
+    const auto& overrideBuffer3 = layerState3->getOutputLayer()->getState().overrideInfo.buffer;
+
+    std::vector<const LayerState*> layers = {
+            layerState1.get(),
+            layerState2.get(),
+    };
+
+    initializeFlattener(layers);
+    // make all layers inactive
+    mTime += 200ms;
+
+    initializeOverrideBuffer(layers);
+    expectAllLayersFlattened(layers);
+    const auto cachedSetBuffer = overrideBuffer1;
+
+    // add a new layer on top of the stack, e.g. a toast, which leaves the cached set valid
+    layers.push_back(layerState3.get());
+
+    initializeOverrideBuffer(layers);
+    EXPECT_NE(getNonBufferHash(layers),
+              mFlattener->flattenLayers(layers, getNonBufferHash(layers), mTime));
+    mFlattener->renderCachedSets(mOutputState, std::nullopt);
+
+    EXPECT_EQ(cachedSetBuffer, overrideBuffer1);
+    EXPECT_EQ(cachedSetBuffer, overrideBuffer2);
+    EXPECT_EQ(nullptr, overrideBuffer3);
+
+    // remove the layer again, and the cached set is still used
+    layers.pop_back();
+
+    initializeOverrideBuffer(layers);
+    EXPECT_NE(getNonBufferHash(layers),
+              mFlattener->flattenLayers(layers, getNonBufferHash(layers), mTime));
+
+    EXPECT_EQ(cachedSetBuffer, overrideBuffer1);
+    EXPECT_EQ(cachedSetBuffer, overrideBuffer2);
+}
+
 TEST_F(FlattenerTest, flattenLayers_BufferUpdateToFlatten) {
     auto& layerState1 = mTestLayers[0]->layerState;
     const auto& overrideBuffer1 = layerState1->getOutputLayer()->getState().overrideInfo.buffer;
@@ -328,6 +328,50 @@ TEST_F(LayerStackTest, getApproximateMatch_doesNotMatchMultipleApproximations) {
     EXPECT_FALSE(stack.getApproximateMatch({&layerStateTwo, &layerStateTwo}));
 }
 
+TEST_F(LayerStackTest, getApproximateMatchSignature_onlyDependsOnCompositionTypes) {
+    mock::OutputLayer outputLayerOne;
+    mock::LayerFE layerFEOne;
+    OutputLayerCompositionState outputLayerCompositionStateOne{
+            .sourceCrop = sFloatRectOne,
+    };
+    LayerFECompositionState layerFECompositionStateOne;
+    layerFECompositionStateOne.compositionType = hal::Composition::DEVICE;
+    setupMocksForLayer(outputLayerOne, layerFEOne, outputLayerCompositionStateOne,
+                       layerFECompositionStateOne);
+    LayerState layerStateOne(&outputLayerOne);
+
+    mock::OutputLayer outputLayerTwo;
+    mock::LayerFE layerFETwo;
+    OutputLayerCompositionState outputLayerCompositionStateTwo{
+            .sourceCrop = sFloatRectTwo,
+    };
+    LayerFECompositionState layerFECompositionStateTwo;
+    layerFECompositionStateTwo.compositionType = hal::Composition::DEVICE;
+    layerFECompositionStateTwo.alpha = sAlphaTwo;
+    setupMocksForLayer(outputLayerTwo, layerFETwo, outputLayerCompositionStateTwo,
+                       layerFECompositionStateTwo);
+    LayerState layerStateTwo(&outputLayerTwo);
+
+    mock::OutputLayer outputLayerThree;
+    mock::LayerFE layerFEThree;
+    OutputLayerCompositionState outputLayerCompositionStateThree{
+            .sourceCrop = sFloatRectOne,
+    };
+    LayerFECompositionState layerFECompositionStateThree;
+    layerFECompositionStateThree.compositionType = hal::Composition::SOLID_COLOR;
+    setupMocksForLayer(outputLayerThree, layerFEThree, outputLayerCompositionStateThree,
+                       layerFECompositionStateThree);
+    LayerState layerStateThree(&outputLayerThree);
+
+    const LayerStack stack({&layerStateOne});
+    EXPECT_EQ(stack.getSignature(), getApproximateMatchSignature({&layerStateOne}));
+    EXPECT_EQ(stack.getSignature(), getApproximateMatchSignature({&layerStateTwo}));
+    EXPECT_NE(stack.getSignature(), getApproximateMatchSignature({&layerStateThree}));
+    EXPECT_NE(stack.getSignature(), getApproximateMatchSignature({&layerStateOne, &layerStateTwo}));
+    EXPECT_NE(getApproximateMatchSignature({&layerStateOne, &layerStateThree}),
+              getApproximateMatchSignature({&layerStateThree, &layerStateOne}));
+}
+
 struct PredictionTest : public testing::Test {
     PredictionTest() {
         const ::testing::TestInfo* const test_info =
@@ -499,6 +543,71 @@ TEST_F(PredictorTest, getPredictedPlan_recordCandidateAndRetrieveApproximateMatc
     EXPECT_EQ(expectedPlan, predictedPlan);
 }
 
+TEST_F(PredictorTest, getPredictedPlan_approximateMatchAmongDifferentSignatures) {
+    mock::OutputLayer outputLayerOne;
+    mock::LayerFE layerFEOne;
+    OutputLayerCompositionState outputLayerCompositionStateOne{
+            .sourceCrop = sFloatRectOne,
+    };
+    LayerFECompositionState layerFECompositionStateOne;
+    layerFECompositionStateOne.compositionType = hal::Composition::DEVICE;
+    setupMocksForLayer(outputLayerOne, layerFEOne, outputLayerCompositionStateOne,
+                       layerFECompositionStateOne);
+    LayerState layerStateOne(&outputLayerOne);
+
+    mock::OutputLayer outputLayerTwo;
+    mock::LayerFE layerFETwo;
+    OutputLayerCompositionState outputLayerCompositionStateTwo{
+            .sourceCrop = sFloatRectTwo,
+    };
+    LayerFECompositionState layerFECompositionStateTwo;
+    layerFECompositionStateTwo.compositionType = hal::Composition::DEVICE;
+    setupMocksForLayer(outputLayerTwo, layerFETwo, outputLayerCompositionStateTwo,
+                       layerFECompositionStateTwo);
+    LayerState layerStateTwo(&outputLayerTwo);
+
+    mock::OutputLayer outputLayerThree;
+    mock::LayerFE layerFEThree;
+    OutputLayerCompositionState outputLayerCompositionStateThree{
+            .sourceCrop = sFloatRectOne,
+    };
+    LayerFECompositionState layerFECompositionStateThree;
+    layerFECompositionStateThree.compositionType = hal::Composition::SOLID_COLOR;
+    setupMocksForLayer(outputLayerThree, layerFEThree, outputLayerCompositionStateThree,
+                       layerFECompositionStateThree);
+    LayerState layerStateThree(&outputLayerThree);
+
+    Plan devicePlan;
+    devicePlan.addLayerType(hal::Composition::DEVICE);
+    Plan solidColorPlan;
+    solidColorPlan.addLayerType(hal::Composition::SOLID_COLOR);
+
+    Predictor predictor;
+
+    NonBufferHash hashOne = getNonBufferHash({&layerStateOne});
+    NonBufferHash hashTwo = getNonBufferHash({&layerStateTwo});
+    NonBufferHash hashThree = getNonBufferHash({&layerStateThree});
+
+    predictor.recordResult(std::nullopt, hashThree, {&layerStateThree}, false, solidColorPlan);
+    predictor.recordResult(std::nullopt, hashOne, {&layerStateOne}, false, devicePlan);
+
+    // Promote the first stack through an approximate hit, so that it is looked up by signature
+    auto predictedPlan = predictor.getPredictedPlan({&layerStateTwo}, hashTwo);
+    ASSERT_TRUE(predictedPlan);
+    EXPECT_EQ((Predictor::PredictedPlan{hashOne, devicePlan, Prediction::Type::Approximate}),
+              predictedPlan);
+    predictor.recordResult(predictedPlan, hashTwo, {&layerStateTwo}, false, devicePlan);
+
+    predictedPlan = predictor.getPredictedPlan({&layerStateTwo}, hashTwo);
+    EXPECT_EQ((Predictor::PredictedPlan{hashOne, devicePlan, Prediction::Type::Approximate}),
+              predictedPlan);
+
+    // Stacks of another signature are matched against candidates of that signature only
+    predictedPlan = predictor.getPredictedPlan({&layerStateThree}, 0);
+    EXPECT_EQ((Predictor::PredictedPlan{hashThree, solidColorPlan, Prediction::Type::Approximate}),
+              predictedPlan);
+}
+
 TEST_F(PredictorTest, recordMissedPlan_skipsApproximateMatch) {
     mock::OutputLayer outputLayerOne;
     mock::LayerFE layerFEOne;
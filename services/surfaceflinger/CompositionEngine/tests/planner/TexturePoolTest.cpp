@@ -34,7 +34,9 @@ public:
 
     size_t getMinPoolSize() const { return kMinPoolSize; }
     size_t getMaxPoolSize() const { return kMaxPoolSize; }
+    size_t getShrinkWindow() const { return kShrinkWindow; }
     size_t getPoolSize() const { return mPool.size(); }
+    size_t getTargetPoolSize() const { return mTargetPoolSize; }
 };
 
 struct TexturePoolTest : public testing::Test {
@@ -109,6 +111,46 @@ TEST_F(TexturePoolTest, goesPastMaxSizeAndRebounds) {
     EXPECT_EQ(mTexturePool.getMaxPoolSize(), newBufferIds.size());
 }
 
+TEST_F(TexturePoolTest, retainsMoreTexturesAfterMisses) {
+    EXPECT_EQ(mTexturePool.getMinPoolSize(), mTexturePool.getTargetPoolSize());
+
+    std::vector<std::shared_ptr<TexturePool::AutoTexture>> textures;
+    for (size_t i = 0; i < mTexturePool.getMinPoolSize() + 1; i++) {
+        textures.emplace_back(mTexturePool.borrowTexture());
+    }
+
+    EXPECT_EQ(mTexturePool.getMinPoolSize() + 1, mTexturePool.getTargetPoolSize());
+
+    textures.clear();
+    EXPECT_EQ(mTexturePool.getMinPoolSize() + 1, mTexturePool.getPoolSize());
+}
+
+TEST_F(TexturePoolTest, shrinksWhenTexturesStayIdle) {
+    {
+        std::vector<std::shared_ptr<TexturePool::AutoTexture>> textures;
+        for (size_t i = 0; i < mTexturePool.getMinPoolSize() + 1; i++) {
+            textures.emplace_back(mTexturePool.borrowTexture());
+        }
+    }
+    EXPECT_EQ(mTexturePool.getMinPoolSize() + 1, mTexturePool.getPoolSize());
+
+    // Borrowing one texture at a time leaves the others idle. The window of the miss above does
+    // not count, so this takes up to two windows.
+    for (size_t i = 0; i < 2 * mTexturePool.getShrinkWindow(); i++) {
+        auto texture = mTexturePool.borrowTexture();
+    }
+
+    EXPECT_EQ(mTexturePool.getMinPoolSize(), mTexturePool.getTargetPoolSize());
+    EXPECT_EQ(mTexturePool.getMinPoolSize(), mTexturePool.getPoolSize());
+
+    // The pool never shrinks below its minimum size.
+    for (size_t i = 0; i < 2 * mTexturePool.getShrinkWindow(); i++) {
+        auto texture = mTexturePool.borrowTexture();
+    }
+
+    EXPECT_EQ(mTexturePool.getMinPoolSize(), mTexturePool.getPoolSize());
+}
+
 TEST_F(TexturePoolTest, reallocatesWhenDisplaySizeChanges) {
     auto texture = mTexturePool.borrowTexture();
 
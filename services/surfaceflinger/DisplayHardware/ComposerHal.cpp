@@ -24,6 +24,7 @@
 
 #include "ComposerHal.h"
 
+#include <android-base/stringprintf.h>
 #include <composer-command-buffer/2.2/ComposerCommandBuffer.h>
 #include <hidl/HidlTransportSupport.h>
 #include <hidl/HidlTransportUtils.h>
@@ -292,6 +293,11 @@ std::string Composer::dumpDebugInfo()
         info = tmpInfo.c_str();
     });
 
+    base::StringAppendF(&info,
+                        "\nCommand queue: %" PRIu64 " executions, %" PRIu64 " bytes written"
+                        " (last %" PRIu32 ", peak %" PRIu32 "), %" PRIu64 " queue changes\n",
+                        mExecuteCount.load(), mCommandBytes.load(), mLastCommandBytes.load(),
+                        mPeakCommandBytes.load(), mInputQueueChangeCount.load());
     return info;
 }
 
@@ -923,8 +929,15 @@ Error Composer::execute()
         return Error::NO_RESOURCES;
     }
 
+    const uint32_t commandBytes = commandLength * static_cast<uint32_t>(sizeof(uint32_t));
+    mExecuteCount++;
+    mCommandBytes += commandBytes;
+    mLastCommandBytes = commandBytes;
+    mPeakCommandBytes = std::max(mPeakCommandBytes.load(), commandBytes);
+
     // set up new input command queue if necessary
     if (queueChanged) {
+        mInputQueueChangeCount++;
         auto ret = mClient->setInputCommandQueue(*mWriter.getMQDescriptor());
         auto error = unwrapRet(ret);
         if (error != Error::NONE) {
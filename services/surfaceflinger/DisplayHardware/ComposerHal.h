@@ -17,6 +17,7 @@
 #ifndef ANDROID_SF_COMPOSER_HAL_H
 #define ANDROID_SF_COMPOSER_HAL_H
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
@@ -531,6 +532,14 @@ private:
     static const constexpr uint32_t kMaxLayerBufferCount = BufferQueue::NUM_BUFFER_SLOTS + 1;
     CommandWriter mWriter;
     CommandReader mReader;
+
+    // Statistics of the command queue, to size it and to track the cost of each frame's commands,
+    // see dumpDebugInfo(). Written by execute(), and read by dumps.
+    std::atomic<uint64_t> mExecuteCount = 0;
+    std::atomic<uint64_t> mCommandBytes = 0;
+    std::atomic<uint32_t> mLastCommandBytes = 0;
+    std::atomic<uint32_t> mPeakCommandBytes = 0;
+    std::atomic<uint64_t> mInputQueueChangeCount = 0;
 };
 
 } // namespace impl
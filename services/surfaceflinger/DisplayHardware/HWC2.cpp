@@ -702,8 +702,16 @@ Error Layer::setBlendMode(BlendMode mode)
         return Error::BAD_DISPLAY;
     }
 
+    if (mode == mBlendMode) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerBlendMode(mDisplay->getId(), mId, mode);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mBlendMode = mode;
+    return error;
 }
 
 Error Layer::setColor(Color color) {
@@ -711,8 +719,16 @@ Error Layer::setColor(Color color) {
         return Error::BAD_DISPLAY;
     }
 
+    if (color == mColor) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerColor(mDisplay->getId(), mId, color);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mColor = color;
+    return error;
 }
 
 Error Layer::setCompositionType(Composition type)
@@ -814,8 +830,16 @@ Error Layer::setDisplayFrame(const Rect& frame)
 
     Hwc2::IComposerClient::Rect hwcRect{frame.left, frame.top,
         frame.right, frame.bottom};
+    if (hwcRect == mDisplayFrame) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerDisplayFrame(mDisplay->getId(), mId, hwcRect);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mDisplayFrame = hwcRect;
+    return error;
 }
 
 Error Layer::setPlaneAlpha(float alpha)
@@ -824,8 +848,16 @@ Error Layer::setPlaneAlpha(float alpha)
         return Error::BAD_DISPLAY;
     }
 
+    if (alpha == mPlaneAlpha) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerPlaneAlpha(mDisplay->getId(), mId, alpha);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mPlaneAlpha = alpha;
+    return error;
 }
 
 Error Layer::setSidebandStream(const native_handle_t* stream)
@@ -851,8 +883,16 @@ Error Layer::setSourceCrop(const FloatRect& crop)
 
     Hwc2::IComposerClient::FRect hwcRect{
         crop.left, crop.top, crop.right, crop.bottom};
+    if (hwcRect == mSourceCrop) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerSourceCrop(mDisplay->getId(), mId, hwcRect);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mSourceCrop = hwcRect;
+    return error;
 }
 
 Error Layer::setTransform(Transform transform)
@@ -861,9 +901,17 @@ Error Layer::setTransform(Transform transform)
         return Error::BAD_DISPLAY;
     }
 
+    if (transform == mTransform) {
+        return Error::NONE;
+    }
     auto intTransform = static_cast<Hwc2::Transform>(transform);
     auto intError = mComposer.setLayerTransform(mDisplay->getId(), mId, intTransform);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mTransform = transform;
+    return error;
 }
 
 Error Layer::setVisibleRegion(const Region& region)
@@ -897,8 +945,16 @@ Error Layer::setZOrder(uint32_t z)
         return Error::BAD_DISPLAY;
     }
 
+    if (z == mZOrder) {
+        return Error::NONE;
+    }
     auto intError = mComposer.setLayerZOrder(mDisplay->getId(), mId, z);
-    return static_cast<Error>(intError);
+    Error error = static_cast<Error>(intError);
+    if (error != Error::NONE) {
+        return error;
+    }
+    mZOrder = z;
+    return error;
 }
 
 Error Layer::setType(uint32_t type)
@@ -28,6 +28,7 @@
 
 #include <functional>
 #include <future>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -374,6 +375,15 @@ private:
     android::mat4 mColorMatrix;
     uint32_t mBufferSlot;
     uint32_t mType{0};
+    // Unset until first sent, as the HWC defaults are unspecified. The composition type is not
+    // cached, since the HWC may change it on validate.
+    std::optional<hal::BlendMode> mBlendMode;
+    std::optional<hal::Color> mColor;
+    std::optional<hal::IComposerClient::Rect> mDisplayFrame;
+    std::optional<float> mPlaneAlpha;
+    std::optional<hal::IComposerClient::FRect> mSourceCrop;
+    std::optional<hal::Transform> mTransform;
+    std::optional<uint32_t> mZOrder;
 #ifdef QTI_UNIFIED_DRAW
     IQtiComposerClient::LayerFlag mLayerFlag = IQtiComposerClient::LayerFlag::DEFAULT;
 #endif
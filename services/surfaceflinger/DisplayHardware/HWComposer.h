@@ -84,6 +84,12 @@ public:
         DisplayRequests displayRequests;
         LayerRequests layerRequests;
         ClientTargetProperty clientTargetProperty;
+
+        bool operator==(const DeviceRequestedChanges& other) const {
+            return changedTypes == other.changedTypes && displayRequests == other.displayRequests &&
+                    layerRequests == other.layerRequests &&
+                    clientTargetProperty == other.clientTargetProperty;
+        }
     };
 
     struct HWCDisplayMode {
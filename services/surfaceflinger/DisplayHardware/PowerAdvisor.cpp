@@ -19,6 +19,8 @@
 #undef LOG_TAG
 #define LOG_TAG "PowerAdvisor"
 
+#include <unistd.h>
+
 #include <cinttypes>
 
 #include <android-base/properties.h>
@@ -27,6 +29,8 @@
 
 #include <android/hardware/power/1.3/IPower.h>
 #include <android/hardware/power/IPower.h>
+#include <android/hardware/power/IPowerHintSession.h>
+#include <android/hardware/power/WorkDuration.h>
 #include <binder/IServiceManager.h>
 
 #include "../SurfaceFlingerProperties.h"
@@ -47,7 +51,9 @@ using V1_3::PowerHint;
 
 using android::hardware::power::Boost;
 using android::hardware::power::IPower;
+using android::hardware::power::IPowerHintSession;
 using android::hardware::power::Mode;
+using android::hardware::power::WorkDuration;
 using base::GetIntProperty;
 using scheduler::OneShotTimer;
 
@@ -86,6 +92,7 @@ void PowerAdvisor::onBootFinished() {
 }
 
 void PowerAdvisor::setExpensiveRenderingExpected(DisplayId displayId, bool expected) {
+    std::lock_guard expensiveRenderingLock(mExpensiveRenderingMutex);
     if (expected) {
         mExpensiveDisplays.insert(displayId);
     } else {
@@ -144,6 +151,52 @@ bool PowerAdvisor::canNotifyDisplayUpdateImminent() {
     return canNotify;
 }
 
+void PowerAdvisor::startPowerHintSession(const std::vector<int32_t>& threadIds) {
+    std::lock_guard lock(mPowerHalMutex);
+    HalWrapper* const halWrapper = getPowerHal();
+    if (halWrapper == nullptr || !halWrapper->supportsPowerHintSession()) {
+        ALOGI("Power HAL does not support hint sessions");
+        return;
+    }
+
+    mHintSessionThreadIds = threadIds;
+    getPowerHintSessionHal();
+}
+
+bool PowerAdvisor::isPowerHintSessionRunning() {
+    std::lock_guard lock(mPowerHalMutex);
+    HalWrapper* const halWrapper = getPowerHal();
+    return halWrapper != nullptr && halWrapper->isPowerHintSessionRunning();
+}
+
+void PowerAdvisor::setTargetWorkDuration(int64_t targetDurationNanos) {
+    std::lock_guard lock(mPowerHalMutex);
+    mTargetDuration = targetDurationNanos;
+
+    HalWrapper* const halWrapper = getPowerHintSessionHal();
+    if (halWrapper == nullptr) {
+        return;
+    }
+
+    if (!halWrapper->setTargetWorkDuration(targetDurationNanos)) {
+        // The HAL has become unavailable; attempt to reconnect later
+        mReconnectPowerHal = true;
+    }
+}
+
+void PowerAdvisor::sendActualWorkDuration(int64_t actualDurationNanos, nsecs_t timestamp) {
+    std::lock_guard lock(mPowerHalMutex);
+    HalWrapper* const halWrapper = getPowerHintSessionHal();
+    if (halWrapper == nullptr) {
+        return;
+    }
+
+    if (!halWrapper->sendActualWorkDuration(actualDurationNanos, timestamp)) {
+        // The HAL has become unavailable; attempt to reconnect later
+        mReconnectPowerHal = true;
+    }
+}
+
 class HidlPowerHalWrapper : public PowerAdvisor::HalWrapper {
 public:
     HidlPowerHalWrapper(sp<V1_3::IPower> powerHal) : mPowerHal(std::move(powerHal)) {}
@@ -186,6 +239,13 @@ public:
         return true;
     }
 
+    // Power HAL 1.x doesn't have hint sessions
+    bool supportsPowerHintSession() override { return false; }
+    bool startPowerHintSession(const std::vector<int32_t>&, int64_t) override { return true; }
+    bool isPowerHintSessionRunning() override { return false; }
+    bool setTargetWorkDuration(int64_t) override { return true; }
+    bool sendActualWorkDuration(int64_t, nsecs_t) override { return true; }
+
 private:
     const sp<V1_3::IPower> mPowerHal = nullptr;
 };
@@ -203,9 +263,19 @@ public:
         if (!ret.isOk()) {
             mHasDisplayUpdateImminent = false;
         }
+
+        // A negative rate means that the HAL does not support hint sessions.
+        ret = mPowerHal->getHintSessionPreferredRate(&mPreferredReportRate);
+        if (!ret.isOk()) {
+            mPreferredReportRate = -1;
+        }
     }
 
-    ~AidlPowerHalWrapper() override = default;
+    ~AidlPowerHalWrapper() override {
+        if (mPowerHintSession != nullptr) {
+            mPowerHintSession->close();
+        }
+    }
 
     static std::unique_ptr<HalWrapper> connect() {
         // This only waits if the service is actually declared
@@ -240,10 +310,64 @@ public:
         return ret.isOk();
     }
 
+    bool supportsPowerHintSession() override { return mPreferredReportRate >= 0; }
+
+    bool startPowerHintSession(const std::vector<int32_t>& threadIds,
+                               int64_t targetDurationNanos) override {
+        ALOGV("AIDL startPowerHintSession for %zu threads", threadIds.size());
+        auto ret = mPowerHal->createHintSession(getpid(), static_cast<int32_t>(getuid()),
+                                                threadIds, targetDurationNanos,
+                                                &mPowerHintSession);
+        if (!ret.isOk()) {
+            mPowerHintSession = nullptr;
+            return false;
+        }
+
+        mTargetDuration = targetDurationNanos;
+        return true;
+    }
+
+    bool isPowerHintSessionRunning() override { return mPowerHintSession != nullptr; }
+
+    bool setTargetWorkDuration(int64_t targetDurationNanos) override {
+        if (targetDurationNanos == mTargetDuration) {
+            return true;
+        }
+
+        ALOGV("AIDL setTargetWorkDuration %" PRId64, targetDurationNanos);
+        mTargetDuration = targetDurationNanos;
+        auto ret = mPowerHintSession->updateTargetWorkDuration(targetDurationNanos);
+        return ret.isOk();
+    }
+
+    bool sendActualWorkDuration(int64_t actualDurationNanos, nsecs_t timestamp) override {
+        mPendingDurations.push_back(
+                {.timeStampNanos = timestamp, .durationNanos = actualDurationNanos});
+
+        // Durations are sent in batches at the rate the HAL prefers, except for missed deadlines,
+        // which are sent right away so that the CPU ramps up in time for the next frame.
+        if (actualDurationNanos <= mTargetDuration &&
+            timestamp - mLastReportTime < mPreferredReportRate) {
+            return true;
+        }
+
+        ALOGV("AIDL reportActualWorkDuration for %zu frames", mPendingDurations.size());
+        auto ret = mPowerHintSession->reportActualWorkDuration(mPendingDurations);
+        mPendingDurations.clear();
+        mLastReportTime = timestamp;
+        return ret.isOk();
+    }
+
 private:
     const sp<IPower> mPowerHal = nullptr;
     bool mHasExpensiveRendering = false;
     bool mHasDisplayUpdateImminent = false;
+
+    sp<IPowerHintSession> mPowerHintSession;
+    int64_t mPreferredReportRate = -1;
+    int64_t mTargetDuration = 0;
+    std::vector<WorkDuration> mPendingDurations;
+    nsecs_t mLastReportTime = 0;
 };
 
 PowerAdvisor::HalWrapper* PowerAdvisor::getPowerHal() {
@@ -281,6 +405,31 @@ PowerAdvisor::HalWrapper* PowerAdvisor::getPowerHal() {
     return sHalWrapper.get();
 }
 
+PowerAdvisor::HalWrapper* PowerAdvisor::getPowerHintSessionHal() {
+    if (mHintSessionThreadIds.empty() || !mTargetDuration) {
+        return nullptr;
+    }
+
+    HalWrapper* const halWrapper = getPowerHal();
+    if (halWrapper == nullptr) {
+        return nullptr;
+    }
+
+    if (halWrapper->isPowerHintSessionRunning()) {
+        return halWrapper;
+    }
+
+    if (!halWrapper->startPowerHintSession(mHintSessionThreadIds, *mTargetDuration)) {
+        // Rather than reconnecting to the HAL on every frame, give up on the session.
+        ALOGW("Failed to start a power hint session");
+        mHintSessionThreadIds.clear();
+        return nullptr;
+    }
+
+    ALOGI("Started a power hint session for %zu threads", mHintSessionThreadIds.size());
+    return halWrapper;
+}
+
 } // namespace impl
 } // namespace Hwc2
 } // namespace android
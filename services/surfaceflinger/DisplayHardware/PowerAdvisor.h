@@ -17,9 +17,12 @@
 #pragma once
 
 #include <atomic>
+#include <optional>
 #include <unordered_set>
+#include <vector>
 
 #include <utils/Mutex.h>
+#include <utils/Timers.h>
 
 #include "../Scheduler/OneShotTimer.h"
 #include "DisplayIdentification.h"
@@ -41,6 +44,14 @@ public:
     virtual bool isUsingExpensiveRendering() = 0;
     virtual void notifyDisplayUpdateImminent() = 0;
     virtual bool canNotifyDisplayUpdateImminent() = 0;
+
+    // Runs the given threads in a power hint session, which is told how long their work for each
+    // frame should take, and how long it actually took, so that the CPU ramps up ahead of missed
+    // deadlines. Does nothing if the Power HAL does not support hint sessions.
+    virtual void startPowerHintSession(const std::vector<int32_t>& threadIds) = 0;
+    virtual bool isPowerHintSessionRunning() = 0;
+    virtual void setTargetWorkDuration(int64_t targetDurationNanos) = 0;
+    virtual void sendActualWorkDuration(int64_t actualDurationNanos, nsecs_t timestamp) = 0;
 };
 
 namespace impl {
@@ -55,6 +66,14 @@ public:
 
         virtual bool setExpensiveRendering(bool enabled) = 0;
         virtual bool notifyDisplayUpdateImminent() = 0;
+
+        // Session calls return false if the HAL has become unavailable.
+        virtual bool supportsPowerHintSession() = 0;
+        virtual bool startPowerHintSession(const std::vector<int32_t>& threadIds,
+                                           int64_t targetDurationNanos) = 0;
+        virtual bool isPowerHintSessionRunning() = 0;
+        virtual bool setTargetWorkDuration(int64_t targetDurationNanos) = 0;
+        virtual bool sendActualWorkDuration(int64_t actualDurationNanos, nsecs_t timestamp) = 0;
     };
 
     PowerAdvisor(SurfaceFlinger& flinger);
@@ -66,16 +85,28 @@ public:
     bool isUsingExpensiveRendering() override { return mNotifiedExpensiveRendering; }
     void notifyDisplayUpdateImminent() override;
     bool canNotifyDisplayUpdateImminent() override;
+    void startPowerHintSession(const std::vector<int32_t>& threadIds) override;
+    bool isPowerHintSessionRunning() override;
+    void setTargetWorkDuration(int64_t targetDurationNanos) override;
+    void sendActualWorkDuration(int64_t actualDurationNanos, nsecs_t timestamp) override;
 
 private:
     HalWrapper* getPowerHal() REQUIRES(mPowerHalMutex);
+    // Returns the HAL if the hint session is running, restarting it after a reconnection.
+    HalWrapper* getPowerHintSessionHal() REQUIRES(mPowerHalMutex);
     bool mReconnectPowerHal GUARDED_BY(mPowerHalMutex) = false;
     std::mutex mPowerHalMutex;
 
+    // The session is started once the threads are known, and its target may be set before.
+    std::vector<int32_t> mHintSessionThreadIds GUARDED_BY(mPowerHalMutex);
+    std::optional<int64_t> mTargetDuration GUARDED_BY(mPowerHalMutex);
+
     std::atomic_bool mBootFinished = false;
 
-    std::unordered_set<DisplayId> mExpensiveDisplays;
-    bool mNotifiedExpensiveRendering = false;
+    // Displays may be composed in parallel, see CompositionRefreshArgs.
+    std::mutex mExpensiveRenderingMutex;
+    std::unordered_set<DisplayId> mExpensiveDisplays GUARDED_BY(mExpensiveRenderingMutex);
+    std::atomic_bool mNotifiedExpensiveRendering = false;
 
     SurfaceFlinger& mFlinger;
     const bool mUseScreenUpdateTimer;
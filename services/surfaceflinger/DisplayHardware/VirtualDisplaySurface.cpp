@@ -84,7 +84,7 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc, VirtualDisplayId d
         mDbgState(DBG_STATE_IDLE),
         mDbgLastCompositionType(COMPOSITION_UNKNOWN),
         mMustRecompose(false),
-        mForceHwcCopy(SurfaceFlinger::useHwcForRgbToYuv),
+        mForceHwcCopy(false),
         mSecure(secure),
         mSinkUsage(0) {
     mSource[SOURCE_SINK] = sink;
@@ -115,6 +115,12 @@ VirtualDisplaySurface::VirtualDisplaySurface(HWComposer& hwc, VirtualDisplayId d
     }
     mOutputFormat = mDefaultOutputFormat;
 
+    // The HWC copy only exists to convert GPU output to YUV for a video
+    // encoder. Other consumers take the GPU output as is, so their GPU-only
+    // frames are rendered straight into the sink buffer.
+    mForceHwcCopy = SurfaceFlinger::useHwcForRgbToYuv &&
+            (sinkUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER);
+
     ConsumerBase::mName = String8::format("VDS: %s", mDisplayName.c_str());
     mConsumer->setConsumerName(ConsumerBase::mName);
     mConsumer->setConsumerUsageBits(GRALLOC_USAGE_HW_COMPOSER);
@@ -174,8 +180,11 @@ status_t VirtualDisplaySurface::prepareFrame(CompositionType compositionType) {
         mDbgLastCompositionType = mCompositionType;
     }
 
+    const uint64_t gpuOnlyUsage =
+            mOutputUsage & ~(static_cast<uint64_t>(mSinkUsage) | GRALLOC_USAGE_PROTECTED);
     if (mCompositionType != COMPOSITION_GPU &&
-        (mOutputFormat != mDefaultOutputFormat || !(mOutputUsage & GRALLOC_USAGE_HW_COMPOSER))) {
+        (mOutputFormat != mDefaultOutputFormat || !(mOutputUsage & GRALLOC_USAGE_HW_COMPOSER) ||
+         gpuOnlyUsage != 0)) {
         // We must have just switched from GPU-only to MIXED or HWC
         // composition. Stop using the format and usage requested by the GPU
         // driver; they may be suboptimal when HWC is writing to the output
@@ -738,9 +747,12 @@ const char* VirtualDisplaySurface::dbgSourceStr(Source s) {
 
 /* Helper to update the output usage when the display is secure */
 
-void VirtualDisplaySurface::setOutputUsage(uint64_t /*flag*/) {
+void VirtualDisplaySurface::setOutputUsage(uint64_t flag) {
 
-    mOutputUsage = mSinkUsage;
+    // Keep the usage that the GPU driver asked for on GPU-only frames, so the
+    // sink buffer dequeued by the next beginFrame() can be rendered to as is,
+    // instead of being cancelled and dequeued again in dequeueBuffer().
+    mOutputUsage = mSinkUsage | flag;
     if (mSecure && (mOutputUsage & GRALLOC_USAGE_HW_VIDEO_ENCODER)) {
         /*TODO: Currently, the framework can only say whether the display
          * and its subsequent session are secure or not. However, there is
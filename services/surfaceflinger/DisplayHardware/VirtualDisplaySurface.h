@@ -259,6 +259,9 @@ private:
 
     compositionengine::impl::HwcBufferCache mHwcBufferCache;
 
+    // Whether GPU-only frames go through the scratch buffers so that HWC
+    // copies them to the output buffer, which is only done for video encoder
+    // sinks when the device prefers HWC for RGB to YUV conversion.
     bool mForceHwcCopy;
     bool mSecure;
     int mSinkUsage;
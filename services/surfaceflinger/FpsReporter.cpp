@@ -32,17 +32,17 @@ FpsReporter::FpsReporter(frametimeline::FrameTimeline& frameTimeline, SurfaceFli
     LOG_ALWAYS_FATAL_IF(mClock == nullptr, "Passed in null clock when constructing FpsReporter!");
 }
 
-void FpsReporter::dispatchLayerFps() {
+std::vector<FpsReporter::FpsReport> FpsReporter::computeLayerFps() {
     const auto now = mClock->now();
     if (now - mLastDispatch < kMinDispatchDuration) {
-        return;
+        return {};
     }
 
     std::vector<TrackedListener> localListeners;
     {
         std::scoped_lock lock(mMutex);
         if (mListeners.empty()) {
-            return;
+            return {};
         }
 
         std::transform(mListeners.begin(), mListeners.end(), std::back_inserter(localListeners),
@@ -71,16 +71,40 @@ void FpsReporter::dispatchLayerFps() {
         }
     });
 
+    std::vector<FpsReport> reports;
     for (const auto& [listener, layer] : listenersAndLayersToReport) {
         std::unordered_set<int32_t> layerIds;
 
         layer->traverse(LayerVector::StateSet::Current,
                         [&](Layer* layer) { layerIds.insert(layer->getSequence()); });
 
-        listener.listener->onFpsReported(mFrameTimeline.computeFps(layerIds));
+        reports.push_back({listener.listener, mFrameTimeline.computeFps(layerIds)});
     }
 
     mLastDispatch = now;
+
+    // Only the fps values that changed are reported. The listeners could have been removed
+    // meanwhile, in which case they aren't reported either.
+    std::scoped_lock lock(mMutex);
+    reports.erase(std::remove_if(reports.begin(), reports.end(),
+                                 [this](const FpsReport& report) REQUIRES(mMutex) {
+                                     const auto it = mListeners.find(
+                                             wp<IBinder>(IInterface::asBinder(report.listener)));
+                                     if (it == mListeners.end() ||
+                                         it->second.lastReportedFps == report.fps) {
+                                         return true;
+                                     }
+                                     it->second.lastReportedFps = report.fps;
+                                     return false;
+                                 }),
+                  reports.end());
+    return reports;
+}
+
+void FpsReporter::sendLayerFps(const std::vector<FpsReport>& reports) {
+    for (const auto& [listener, fps] : reports) {
+        listener->onFpsReported(fps);
+    }
 }
 
 void FpsReporter::binderDied(const wp<IBinder>& who) {
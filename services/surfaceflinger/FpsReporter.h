@@ -20,7 +20,9 @@
 #include <android/gui/IFpsListener.h>
 #include <binder/IBinder.h>
 
+#include <optional>
 #include <unordered_map>
+#include <vector>
 
 #include "Clock.h"
 #include "FrameTimeline/FrameTimeline.h"
@@ -35,10 +37,24 @@ public:
     FpsReporter(frametimeline::FrameTimeline& frameTimeline, SurfaceFlinger& flinger,
                 std::unique_ptr<Clock> clock = std::make_unique<SteadyClock>());
 
-    // Dispatches updated layer fps values for the registered listeners
+    struct FpsReport {
+        sp<gui::IFpsListener> listener;
+        float fps;
+    };
+
+    // Computes the layer fps values to report to the registered listeners, leaving out the ones
+    // that haven't changed since they were last reported.
     // This method promotes Layer weak pointers and performs layer stack traversals, so mStateLock
     // must be held when calling this method.
-    void dispatchLayerFps() EXCLUDES(mMutex);
+    std::vector<FpsReport> computeLayerFps() EXCLUDES(mMutex);
+
+    // Sends the reports to their listeners. This doesn't need mStateLock, so that the binder
+    // transactions aren't made with it held.
+    static void sendLayerFps(const std::vector<FpsReport>& reports);
+
+    // Dispatches updated layer fps values for the registered listeners
+    // mStateLock must be held when calling this method, see computeLayerFps.
+    void dispatchLayerFps() EXCLUDES(mMutex) { sendLayerFps(computeLayerFps()); }
 
     // Override for IBinder::DeathRecipient
     void binderDied(const wp<IBinder>&) override;
@@ -59,6 +75,8 @@ private:
     struct TrackedListener {
         sp<gui::IFpsListener> listener;
         int32_t taskId;
+        // The fps last reported to the listener, if any.
+        std::optional<float> lastReportedFps;
     };
 
     frametimeline::FrameTimeline& mFrameTimeline;
@@ -24,10 +24,13 @@
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cinttypes>
+#include <iterator>
 #include <numeric>
 #include <unordered_set>
+#include <vector>
 
 namespace android::frametimeline {
 
@@ -299,8 +302,10 @@ int64_t TraceCookieCounter::getCookieForTracing() {
 }
 
 SurfaceFrame::SurfaceFrame(const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid,
-                           uid_t ownerUid, int32_t layerId, std::string layerName,
-                           std::string debugName, PredictionState predictionState,
+                           uid_t ownerUid, int32_t layerId,
+                           std::shared_ptr<const std::string> layerName,
+                           std::shared_ptr<const std::string> debugName,
+                           PredictionState predictionState,
                            frametimeline::TimelineItem&& predictions,
                            std::shared_ptr<TimeStats> timeStats,
                            JankClassificationThresholds thresholds,
@@ -347,7 +352,7 @@ void SurfaceFrame::setPresentState(PresentState presentState, nsecs_t lastLatchT
     LOG_ALWAYS_FATAL_IF(mPresentState != PresentState::Unknown,
                         "setPresentState called on a SurfaceFrame from Layer - %s, that has a "
                         "PresentState - %s set already.",
-                        mDebugName.c_str(), toString(mPresentState).c_str());
+                        mDebugName->c_str(), toString(mPresentState).c_str());
     mPresentState = presentState;
     mLastLatchTime = lastLatchTime;
 }
@@ -415,7 +420,7 @@ void SurfaceFrame::promoteToBuffer() {
     LOG_ALWAYS_FATAL_IF(mIsBuffer == true,
                         "Trying to promote an already promoted BufferSurfaceFrame from layer %s "
                         "with token %" PRId64 "",
-                        mDebugName.c_str(), mToken);
+                        mDebugName->c_str(), mToken);
     mIsBuffer = true;
 }
 
@@ -427,7 +432,7 @@ bool SurfaceFrame::getIsBuffer() const {
 void SurfaceFrame::dump(std::string& result, const std::string& indent, nsecs_t baseTime) const {
     std::scoped_lock lock(mMutex);
     StringAppendF(&result, "%s", indent.c_str());
-    StringAppendF(&result, "Layer - %s", mDebugName.c_str());
+    StringAppendF(&result, "Layer - %s", mDebugName->c_str());
     if (mJankType != JankType::None) {
         // Easily identify a janky Surface Frame in the dump
         StringAppendF(&result, " [*] ");
@@ -478,7 +483,7 @@ void SurfaceFrame::dump(std::string& result, const std::string& indent, nsecs_t
 std::string SurfaceFrame::miniDump() const {
     std::scoped_lock lock(mMutex);
     std::string result;
-    StringAppendF(&result, "Layer - %s\n", mDebugName.c_str());
+    StringAppendF(&result, "Layer - %s\n", mDebugName->c_str());
     StringAppendF(&result, "Token: %" PRId64 "\n", mToken);
     StringAppendF(&result, "Is Buffer?: %d\n", mIsBuffer);
     StringAppendF(&result, "Present State : %s\n", toString(mPresentState).c_str());
@@ -607,7 +612,7 @@ void SurfaceFrame::onPresent(nsecs_t presentTime, int32_t displayFrameJankType,
 
     if (mPredictionState != PredictionState::None) {
         // Only update janky frames if the app used vsync predictions
-        mTimeStats->incrementJankyFrames({refreshRate, mRenderRate, mOwnerUid, mLayerName,
+        mTimeStats->incrementJankyFrames({refreshRate, mRenderRate, mOwnerUid, *mLayerName,
                                           mGameMode, mJankType, displayDeadlineDelta,
                                           displayPresentDelta, deadlineDelta});
     }
@@ -632,7 +637,7 @@ void SurfaceFrame::tracePredictions(int64_t displayFrameToken) const {
         expectedSurfaceFrameStartEvent->set_display_frame_token(displayFrameToken);
 
         expectedSurfaceFrameStartEvent->set_pid(mOwnerPid);
-        expectedSurfaceFrameStartEvent->set_layer_name(mDebugName);
+        expectedSurfaceFrameStartEvent->set_layer_name(*mDebugName);
     });
 
     // Expected timeline end
@@ -679,7 +684,7 @@ void SurfaceFrame::traceActuals(int64_t displayFrameToken) const {
         actualSurfaceFrameStartEvent->set_display_frame_token(displayFrameToken);
 
         actualSurfaceFrameStartEvent->set_pid(mOwnerPid);
-        actualSurfaceFrameStartEvent->set_layer_name(mDebugName);
+        actualSurfaceFrameStartEvent->set_layer_name(*mDebugName);
 
         if (mPresentState == PresentState::Dropped) {
             actualSurfaceFrameStartEvent->set_present_type(FrameTimelineEvent::PRESENT_DROPPED);
@@ -753,9 +758,87 @@ std::optional<TimelineItem> TokenManager::getPredictionsForToken(int64_t token)
     return {};
 }
 
+// Keeps the memory of released SurfaceFrames for the next ones. allocate_shared places a SurfaceFrame
+// and its control block in a single allocation, so all blocks have the same size.
+class SurfaceFramePool {
+public:
+    SurfaceFramePool() { mFreeBlocks.reserve(kMaxFreeBlocks); }
+
+    ~SurfaceFramePool() {
+        for (void* block : mFreeBlocks) {
+            ::operator delete(block);
+        }
+    }
+
+    void* allocate(size_t size) {
+        {
+            std::scoped_lock lock(mMutex);
+            if (mBlockSize == 0) {
+                mBlockSize = size;
+            }
+            if (size == mBlockSize && !mFreeBlocks.empty()) {
+                void* block = mFreeBlocks.back();
+                mFreeBlocks.pop_back();
+                return block;
+            }
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* block, size_t size) {
+        {
+            std::scoped_lock lock(mMutex);
+            if (size == mBlockSize && mFreeBlocks.size() < kMaxFreeBlocks) {
+                mFreeBlocks.push_back(block);
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+private:
+    // Enough for the SurfaceFrames of the default number of display frames, at a few layers each.
+    static constexpr size_t kMaxFreeBlocks = 256;
+
+    std::mutex mMutex;
+    size_t mBlockSize GUARDED_BY(mMutex) = 0;
+    std::vector<void*> mFreeBlocks GUARDED_BY(mMutex);
+};
+
+namespace {
+
+template <typename T>
+struct SurfaceFrameAllocator {
+    using value_type = T;
+
+    explicit SurfaceFrameAllocator(std::shared_ptr<SurfaceFramePool> pool)
+          : pool(std::move(pool)) {}
+
+    template <typename U>
+    SurfaceFrameAllocator(const SurfaceFrameAllocator<U>& other) : pool(other.pool) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(pool->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { pool->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const SurfaceFrameAllocator<U>& other) const {
+        return pool == other.pool;
+    }
+
+    template <typename U>
+    bool operator!=(const SurfaceFrameAllocator<U>& other) const {
+        return pool != other.pool;
+    }
+
+    std::shared_ptr<SurfaceFramePool> pool;
+};
+
+} // namespace
+
 FrameTimeline::FrameTimeline(std::shared_ptr<TimeStats> timeStats, pid_t surfaceFlingerPid,
                              JankClassificationThresholds thresholds)
-      : mMaxDisplayFrames(kDefaultMaxDisplayFrames),
+      : mSurfaceFramePool(std::make_shared<SurfaceFramePool>()),
+        mMaxDisplayFrames(kDefaultMaxDisplayFrames),
         mTimeStats(std::move(timeStats)),
         mSurfaceFlingerPid(surfaceFlingerPid),
         mJankClassificationThresholds(thresholds) {
@@ -776,31 +859,54 @@ void FrameTimeline::registerDataSource() {
     FrameTimelineDataSource::Register(dsd);
 }
 
+std::shared_ptr<const std::string> FrameTimeline::internName(const std::string& name) {
+    if (const auto it = mNames.find(name); it != mNames.end()) {
+        return it->second;
+    }
+
+    if (mNames.size() >= mNamesSweepThreshold) {
+        // Only the map holds on to the names of destroyed layers.
+        for (auto it = mNames.begin(); it != mNames.end();) {
+            it = it->second.use_count() == 1 ? mNames.erase(it) : std::next(it);
+        }
+        mNamesSweepThreshold = std::max(kMinNamesSweepThreshold, 2 * mNames.size());
+    }
+    return mNames.emplace(name, std::make_shared<const std::string>(name)).first->second;
+}
+
 std::shared_ptr<SurfaceFrame> FrameTimeline::createSurfaceFrameForToken(
         const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid, int32_t layerId,
-        std::string layerName, std::string debugName, bool isBuffer, int32_t gameMode) {
+        const std::string& layerName, const std::string& debugName, bool isBuffer,
+        int32_t gameMode) {
     ATRACE_CALL();
-    if (frameTimelineInfo.vsyncId == FrameTimelineInfo::INVALID_VSYNC_ID) {
-        return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                              std::move(layerName), std::move(debugName),
-                                              PredictionState::None, TimelineItem(), mTimeStats,
+    std::shared_ptr<const std::string> internedLayerName;
+    std::shared_ptr<const std::string> internedDebugName;
+    {
+        std::scoped_lock lock(mNamesMutex);
+        internedLayerName = internName(layerName);
+        internedDebugName = internName(debugName);
+    }
+
+    PredictionState predictionState = PredictionState::None;
+    TimelineItem predictions;
+    if (frameTimelineInfo.vsyncId != FrameTimelineInfo::INVALID_VSYNC_ID) {
+        std::optional<TimelineItem> tokenPredictions =
+                mTokenManager.getPredictionsForToken(frameTimelineInfo.vsyncId);
+        if (tokenPredictions) {
+            predictionState = PredictionState::Valid;
+            predictions = std::move(*tokenPredictions);
+        } else {
+            predictionState = PredictionState::Expired;
+        }
+    }
+    return std::allocate_shared<SurfaceFrame>(SurfaceFrameAllocator<SurfaceFrame>(
+                                                      mSurfaceFramePool),
+                                              frameTimelineInfo, ownerPid, ownerUid, layerId,
+                                              std::move(internedLayerName),
+                                              std::move(internedDebugName), predictionState,
+                                              std::move(predictions), mTimeStats,
                                               mJankClassificationThresholds, &mTraceCookieCounter,
                                               isBuffer, gameMode);
-    }
-    std::optional<TimelineItem> predictions =
-            mTokenManager.getPredictionsForToken(frameTimelineInfo.vsyncId);
-    if (predictions) {
-        return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                              std::move(layerName), std::move(debugName),
-                                              PredictionState::Valid, std::move(*predictions),
-                                              mTimeStats, mJankClassificationThresholds,
-                                              &mTraceCookieCounter, isBuffer, gameMode);
-    }
-    return std::make_shared<SurfaceFrame>(frameTimelineInfo, ownerPid, ownerUid, layerId,
-                                          std::move(layerName), std::move(debugName),
-                                          PredictionState::Expired, TimelineItem(), mTimeStats,
-                                          mJankClassificationThresholds, &mTraceCookieCounter,
-                                          isBuffer, gameMode);
 }
 
 FrameTimeline::DisplayFrame::DisplayFrame(std::shared_ptr<TimeStats> timeStats,
@@ -814,6 +920,21 @@ FrameTimeline::DisplayFrame::DisplayFrame(std::shared_ptr<TimeStats> timeStats,
     mSurfaceFrames.reserve(kNumSurfaceFramesInitial);
 }
 
+void FrameTimeline::DisplayFrame::reset() {
+    mToken = FrameTimelineInfo::INVALID_VSYNC_ID;
+    mSurfaceFlingerPredictions = TimelineItem();
+    mSurfaceFlingerActuals = TimelineItem();
+    mSurfaceFrames.clear();
+    mPredictionState = PredictionState::None;
+    mJankType = JankType::None;
+    mGpuFence = FenceTime::NO_FENCE;
+    mGpuDuration = 0;
+    mFramePresentMetadata = FramePresentMetadata::UnknownPresent;
+    mFrameReadyMetadata = FrameReadyMetadata::UnknownFinish;
+    mFrameStartMetadata = FrameStartMetadata::UnknownStart;
+    mRefreshRate = Fps();
+}
+
 void FrameTimeline::addSurfaceFrame(std::shared_ptr<SurfaceFrame> surfaceFrame) {
     ATRACE_CALL();
     std::scoped_lock lock(mMutex);
@@ -839,6 +960,19 @@ void FrameTimeline::setSfPresent(nsecs_t sfPresentTime,
     finalizeCurrentDisplayFrame();
 }
 
+void FrameTimeline::setGpuDuration(nsecs_t drawStartTime, nsecs_t gpuDuration) {
+    std::scoped_lock lock(mMutex);
+    // The draw is most likely one of the last frames, so search from the newest.
+    for (auto it = mDisplayFrames.rbegin(); it != mDisplayFrames.rend(); ++it) {
+        const TimelineItem actuals = (*it)->getActuals();
+        if (drawStartTime > actuals.endTime) return;
+        if (drawStartTime >= actuals.startTime) {
+            (*it)->setGpuDuration(gpuDuration);
+            return;
+        }
+    }
+}
+
 void FrameTimeline::DisplayFrame::addSurfaceFrame(std::shared_ptr<SurfaceFrame> surfaceFrame) {
     mSurfaceFrames.push_back(surfaceFrame);
 }
@@ -1158,11 +1292,19 @@ float FrameTimeline::computeFps(const std::unordered_set<int32_t>& layerIds) {
 }
 
 void FrameTimeline::flushPendingPresentFences() {
+    // Check all the fences at once, below only the cached signal times are read.
+    std::vector<std::shared_ptr<FenceTime>> fences;
+    fences.reserve(mPendingPresentFences.size());
+    for (const auto& pendingPresentFence : mPendingPresentFences) {
+        fences.push_back(pendingPresentFence.first);
+    }
+    FenceTime::updateSignalTimes(fences);
+
     for (size_t i = 0; i < mPendingPresentFences.size(); i++) {
         const auto& pendingPresentFence = mPendingPresentFences[i];
         nsecs_t signalTime = Fence::SIGNAL_TIME_INVALID;
         if (pendingPresentFence.first && pendingPresentFence.first->isValid()) {
-            signalTime = pendingPresentFence.first->getSignalTime();
+            signalTime = pendingPresentFence.first->getCachedSignalTime();
             if (signalTime == Fence::SIGNAL_TIME_PENDING) {
                 continue;
             }
@@ -1178,14 +1320,23 @@ void FrameTimeline::flushPendingPresentFences() {
 }
 
 void FrameTimeline::finalizeCurrentDisplayFrame() {
+    std::shared_ptr<DisplayFrame> oldestDisplayFrame;
     while (mDisplayFrames.size() >= mMaxDisplayFrames) {
         // We maintain only a fixed number of frames' data. Pop older frames
+        oldestDisplayFrame = std::move(mDisplayFrames.front());
         mDisplayFrames.pop_front();
     }
-    mDisplayFrames.push_back(mCurrentDisplayFrame);
-    mCurrentDisplayFrame.reset();
-    mCurrentDisplayFrame = std::make_shared<DisplayFrame>(mTimeStats, mJankClassificationThresholds,
-                                                          &mTraceCookieCounter);
+    mDisplayFrames.push_back(std::move(mCurrentDisplayFrame));
+
+    // The popped frame is reused, unless it is still waiting for its present fence.
+    if (oldestDisplayFrame && oldestDisplayFrame.use_count() == 1) {
+        oldestDisplayFrame->reset();
+        mCurrentDisplayFrame = std::move(oldestDisplayFrame);
+    } else {
+        mCurrentDisplayFrame =
+                std::make_shared<DisplayFrame>(mTimeStats, mJankClassificationThresholds,
+                                               &mTraceCookieCounter);
+    }
 }
 
 nsecs_t FrameTimeline::DisplayFrame::getBaseTime() const {
@@ -1245,6 +1396,12 @@ void FrameTimeline::DisplayFrame::dump(std::string& result, nsecs_t baseTime) co
     std::chrono::nanoseconds deltaToVsync(std::abs(presentDelta) % mRefreshRate.getPeriodNsecs());
     StringAppendF(&result, "Present delta %% refreshrate: %10f\n",
                   std::chrono::duration<double, std::milli>(deltaToVsync).count());
+    if (mGpuDuration > 0) {
+        StringAppendF(&result, "GPU duration: %10f\n",
+                      std::chrono::duration<double, std::milli>(
+                              std::chrono::nanoseconds(mGpuDuration))
+                              .count());
+    }
     dumpTable(result, mSurfaceFlingerPredictions, mSurfaceFlingerActuals, "", mPredictionState,
               baseTime);
     StringAppendF(&result, "\n");
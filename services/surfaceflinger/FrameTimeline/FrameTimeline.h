@@ -29,7 +29,10 @@
 #include <utils/Vector.h>
 
 #include <deque>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace android::frametimeline {
 
@@ -149,9 +152,11 @@ public:
     };
 
     // Only FrameTimeline can construct a SurfaceFrame as it provides Predictions(through
-    // TokenManager), Thresholds and TimeStats pointer.
+    // TokenManager), Thresholds and TimeStats pointer. The names are interned by FrameTimeline, so
+    // the frames of a layer share them.
     SurfaceFrame(const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid,
-                 int32_t layerId, std::string layerName, std::string debugName,
+                 int32_t layerId, std::shared_ptr<const std::string> layerName,
+                 std::shared_ptr<const std::string> debugName,
                  PredictionState predictionState, TimelineItem&& predictions,
                  std::shared_ptr<TimeStats> timeStats, JankClassificationThresholds thresholds,
                  TraceCookieCounter* traceCookieCounter, bool isBuffer, int32_t gameMode);
@@ -226,8 +231,8 @@ private:
     const int32_t mInputEventId;
     const pid_t mOwnerPid;
     const uid_t mOwnerUid;
-    const std::string mLayerName;
-    const std::string mDebugName;
+    const std::shared_ptr<const std::string> mLayerName;
+    const std::shared_ptr<const std::string> mDebugName;
     const int32_t mLayerId;
     PresentState mPresentState GUARDED_BY(mMutex);
     const PredictionState mPredictionState;
@@ -280,8 +285,8 @@ public:
     // Debug name is the human-readable debugging string for dumpsys.
     virtual std::shared_ptr<SurfaceFrame> createSurfaceFrameForToken(
             const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid,
-            int32_t layerId, std::string layerName, std::string debugName, bool isBuffer,
-            int32_t gameMode) = 0;
+            int32_t layerId, const std::string& layerName, const std::string& debugName,
+            bool isBuffer, int32_t gameMode) = 0;
 
     // Adds a new SurfaceFrame to the current DisplayFrame. Frames from multiple layers can be
     // composited into one display frame.
@@ -298,6 +303,11 @@ public:
     virtual void setSfPresent(nsecs_t sfPresentTime, const std::shared_ptr<FenceTime>& presentFence,
                               const std::shared_ptr<FenceTime>& gpuFence) = 0;
 
+    // Records how long the GPU spent compositing the DisplayFrame during which a RenderEngine draw
+    // started. The durations are only known a few frames later, so this is dropped if the
+    // DisplayFrame is no longer tracked.
+    virtual void setGpuDuration(nsecs_t drawStartTime, nsecs_t gpuDuration) = 0;
+
     // Args:
     // -jank : Dumps only the Display Frames that are either janky themselves
     //         or contain janky Surface Frames.
@@ -318,6 +328,8 @@ public:
 
 namespace impl {
 
+class SurfaceFramePool;
+
 class TokenManager : public android::frametimeline::TokenManager {
 public:
     TokenManager() : mCurrentToken(FrameTimelineInfo::INVALID_VSYNC_ID + 1) {}
@@ -370,11 +382,15 @@ public:
         void onPresent(nsecs_t signalTime, nsecs_t previousPresentTime);
         // Adds the provided SurfaceFrame to the current display frame.
         void addSurfaceFrame(std::shared_ptr<SurfaceFrame> surfaceFrame);
+        // Restores the state of a newly constructed DisplayFrame, so that it can be reused for a
+        // later frame. Releases the SurfaceFrames, but keeps the capacity to hold them.
+        void reset();
 
         void setPredictions(PredictionState predictionState, TimelineItem predictions);
         void setActualStartTime(nsecs_t actualStartTime);
         void setActualEndTime(nsecs_t actualEndTime);
         void setGpuFence(const std::shared_ptr<FenceTime>& gpuFence);
+        void setGpuDuration(nsecs_t gpuDuration) { mGpuDuration = gpuDuration; }
 
         // BaseTime is the smallest timestamp in a DisplayFrame.
         // Used for dumping all timestamps relative to the oldest, making it easy to read.
@@ -387,6 +403,7 @@ public:
         FramePresentMetadata getFramePresentMetadata() const { return mFramePresentMetadata; };
         FrameReadyMetadata getFrameReadyMetadata() const { return mFrameReadyMetadata; };
         int32_t getJankType() const { return mJankType; }
+        nsecs_t getGpuDuration() const { return mGpuDuration; }
         const std::vector<std::shared_ptr<SurfaceFrame>>& getSurfaceFrames() const {
             return mSurfaceFrames;
         }
@@ -418,6 +435,8 @@ public:
         int32_t mJankType = JankType::None;
         // A valid gpu fence indicates that the DisplayFrame was composited by the GPU
         std::shared_ptr<FenceTime> mGpuFence = FenceTime::NO_FENCE;
+        // Time that the GPU spent on the composition, as measured by RenderEngine, if known
+        nsecs_t mGpuDuration = 0;
         // Enum for the type of present
         FramePresentMetadata mFramePresentMetadata = FramePresentMetadata::UnknownPresent;
         // Enum for the type of finish
@@ -440,12 +459,13 @@ public:
     frametimeline::TokenManager* getTokenManager() override { return &mTokenManager; }
     std::shared_ptr<SurfaceFrame> createSurfaceFrameForToken(
             const FrameTimelineInfo& frameTimelineInfo, pid_t ownerPid, uid_t ownerUid,
-            int32_t layerId, std::string layerName, std::string debugName, bool isBuffer,
-            int32_t gameMode) override;
+            int32_t layerId, const std::string& layerName, const std::string& debugName,
+            bool isBuffer, int32_t gameMode) override;
     void addSurfaceFrame(std::shared_ptr<frametimeline::SurfaceFrame> surfaceFrame) override;
     void setSfWakeUp(int64_t token, nsecs_t wakeupTime, Fps refreshRate) override;
     void setSfPresent(nsecs_t sfPresentTime, const std::shared_ptr<FenceTime>& presentFence,
                       const std::shared_ptr<FenceTime>& gpuFence = FenceTime::NO_FENCE) override;
+    void setGpuDuration(nsecs_t drawStartTime, nsecs_t gpuDuration) override;
     void parseArgs(const Vector<String16>& args, std::string& result) override;
     void setMaxDisplayFrames(uint32_t size) override;
     float computeFps(const std::unordered_set<int32_t>& layerIds) override;
@@ -465,6 +485,8 @@ private:
 
     void flushPendingPresentFences() REQUIRES(mMutex);
     void finalizeCurrentDisplayFrame() REQUIRES(mMutex);
+    // Returns the shared copy of the name, which is made the first time the name is seen.
+    std::shared_ptr<const std::string> internName(const std::string& name) REQUIRES(mNamesMutex);
     void dumpAll(std::string& result);
     void dumpJank(std::string& result);
 
@@ -473,6 +495,15 @@ private:
     std::vector<std::pair<std::shared_ptr<FenceTime>, std::shared_ptr<DisplayFrame>>>
             mPendingPresentFences GUARDED_BY(mMutex);
     std::shared_ptr<DisplayFrame> mCurrentDisplayFrame GUARDED_BY(mMutex);
+    // SurfaceFrames are allocated from the pool, which the allocations share ownership of, as they
+    // may outlive FrameTimeline.
+    const std::shared_ptr<SurfaceFramePool> mSurfaceFramePool;
+    // Names of the layers that SurfaceFrames were created for. Names that are no longer used by any
+    // SurfaceFrame are swept once the map grows past the threshold.
+    std::mutex mNamesMutex;
+    std::unordered_map<std::string, std::shared_ptr<const std::string>> mNames
+            GUARDED_BY(mNamesMutex);
+    size_t mNamesSweepThreshold GUARDED_BY(mNamesMutex) = kMinNamesSweepThreshold;
     TokenManager mTokenManager;
     TraceCookieCounter mTraceCookieCounter;
     mutable std::mutex mMutex;
@@ -482,6 +513,7 @@ private:
     nsecs_t mPreviousPresentTime = 0;
     const JankClassificationThresholds mJankClassificationThresholds;
     static constexpr uint32_t kDefaultMaxDisplayFrames = 64;
+    static constexpr size_t kMinNamesSweepThreshold = 64;
     // The initial container size for the vector<SurfaceFrames> inside display frame. Although
     // this number doesn't represent any bounds on the number of surface frames that can go in a
     // display frame, this is a good starting size for the vector so that we can avoid the
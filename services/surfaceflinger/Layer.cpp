@@ -331,6 +331,38 @@ FloatRect Layer::getBounds(const Region& activeTransparentRegion) const {
 
 void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
                           float parentShadowRadius) {
+    const BoundsInputs inputs{parentBounds, parentTransform, parentShadowRadius,
+                              DisplayDevice::getPrimaryDisplayRotationFlags()};
+    // Clones copy the drawing state of the layer they mirror on every commit.
+    const bool boundsDirty = mBoundsDirty || isClone() || mBoundsInputs != inputs;
+    if (!boundsDirty && !mChildBoundsDirty) {
+        return;
+    }
+    mBoundsDirty = false;
+    mChildBoundsDirty = false;
+
+    if (boundsDirty) {
+        mBoundsInputs = inputs;
+        auto& costTracker = mFlinger->mLayerCostTracker;
+        const nsecs_t start = costTracker.isEnabled() ? systemTime() : 0;
+        computeOwnBounds(parentBounds, parentTransform, parentShadowRadius);
+        if (start > 0) {
+            costTracker.addCpuTime(sequence, getOwnerUid(), mName,
+                                   LayerCostTracker::CpuStage::Bounds, systemTime() - start);
+        }
+    }
+
+    // Shadow radius is passed down to only one layer so if the layer can draw shadows,
+    // don't pass it to its children.
+    const float childShadowRadius = canDrawShadows() ? 0.f : mEffectiveShadowRadius;
+
+    for (const sp<Layer>& child : mDrawingChildren) {
+        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
+    }
+}
+
+void Layer::computeOwnBounds(FloatRect parentBounds, const ui::Transform& parentTransform,
+                             float parentShadowRadius) {
     const State& s(getDrawingState());
 
     // Calculate effective layer transform
@@ -360,13 +392,14 @@ void Layer::computeBounds(FloatRect parentBounds, ui::Transform parentTransform,
     } else {
         mEffectiveShadowRadius = parentShadowRadius;
     }
+}
 
-    // Shadow radius is passed down to only one layer so if the layer can draw shadows,
-    // don't pass it to its children.
-    const float childShadowRadius = canDrawShadows() ? 0.f : mEffectiveShadowRadius;
-
-    for (const sp<Layer>& child : mDrawingChildren) {
-        child->computeBounds(mBounds, mEffectiveTransform, childShadowRadius);
+void Layer::invalidateBounds() {
+    mBoundsDirty = true;
+    // Ancestors of a flagged layer are flagged as well, so the walk can stop at the first one.
+    for (sp<Layer> parent = mDrawingParent.promote(); parent && !parent->mChildBoundsDirty;
+         parent = parent->mDrawingParent.promote()) {
+        parent->mChildBoundsDirty = true;
     }
 }
 
@@ -469,13 +502,14 @@ void Layer::prepareGeometryCompositionState() {
         }
         const uint32_t id = compatIter->second;
 
-        auto it = drawingState.metadata.mMap.find(id);
-        if (it == std::end(drawingState.metadata.mMap)) {
+        const auto value = drawingState.metadata.mMap.find(id);
+        if (!value) {
             continue;
         }
 
-        compositionState->metadata
-                .emplace(key, compositionengine::GenericLayerMetadataEntry{mandatory, it->second});
+        compositionState->metadata.emplace(key,
+                                           compositionengine::GenericLayerMetadataEntry{mandatory,
+                                                                                        value->get()});
     }
 }
 
@@ -643,8 +677,14 @@ void Layer::prepareClearClientComposition(LayerFE::LayerSettings& layerSettings,
 // this method entirely in favor of calling prepareClientComposition directly.
 std::vector<compositionengine::LayerFE::LayerSettings> Layer::prepareClientCompositionList(
         compositionengine::LayerFE::ClientCompositionTargetSettings& targetSettings) {
+    auto& costTracker = mFlinger->mLayerCostTracker;
+    const nsecs_t start = costTracker.isEnabled() ? systemTime() : 0;
     std::optional<compositionengine::LayerFE::LayerSettings> layerSettings =
             prepareClientComposition(targetSettings);
+    if (start > 0) {
+        costTracker.addCpuTime(sequence, getOwnerUid(), mName,
+                               LayerCostTracker::CpuStage::ClientComposition, systemTime() - start);
+    }
     // Nothing to render.
     if (!layerSettings) {
         return {};
@@ -723,6 +763,10 @@ uint32_t Layer::doTransaction(uint32_t flags) {
 
     const State& s(getDrawingState());
 
+    if (mDrawingStateModified || s.sequence != mLastCommittedTxSequence) {
+        invalidateBounds();
+    }
+
     if (updateGeometry()) {
         // invalidate and recompute the visible regions if needed
         flags |= Layer::eVisibleRegion;
@@ -1909,7 +1953,7 @@ void Layer::traverseChildrenInZOrder(LayerVector::StateSet stateSet,
     traverseChildrenInZOrderInner(layersInTree, stateSet, visitor);
 }
 
-ui::Transform Layer::getTransform() const {
+const ui::Transform& Layer::getTransform() const {
     return mEffectiveTransform;
 }
 
@@ -2014,7 +2058,10 @@ void Layer::commitChildList() {
         child->commitChildList();
     }
     mDrawingChildren = mCurrentChildren;
-    mDrawingParent = mCurrentParent;
+    if (mDrawingParent != mCurrentParent) {
+        mDrawingParent = mCurrentParent;
+        invalidateBounds();
+    }
 }
 
 
@@ -2433,6 +2480,9 @@ void Layer::updateMirrorInfo() {
     mClonedChild->updateClonedDrawingState(clonedLayersMap);
     mClonedChild->updateClonedChildren(this, clonedLayersMap);
     mClonedChild->updateClonedRelatives(clonedLayersMap);
+
+    // The clones are rebuilt from the layers they mirror.
+    invalidateBounds();
 }
 
 void Layer::updateClonedDrawingState(std::map<sp<Layer>, sp<Layer>>& clonedLayersMap) {
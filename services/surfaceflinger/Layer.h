@@ -654,7 +654,8 @@ public:
     FloatRect getBounds(const Region& activeTransparentRegion) const;
     FloatRect getBounds() const;
 
-    // Compute bounds for the layer and cache the results.
+    // Compute bounds for the layer and cache the results. Layers whose inputs are the same as last
+    // time are skipped, along with their subtree unless a layer in it was invalidated.
     void computeBounds(FloatRect parentBounds, ui::Transform parentTransform, float shadowRadius);
 
     int32_t getSequence() const override { return sequence; }
@@ -756,7 +757,7 @@ public:
     void addAndGetFrameTimestamps(const NewFrameEventsEntry* newEntry,
                                   FrameEventHistoryDelta* outDelta);
 
-    ui::Transform getTransform() const;
+    const ui::Transform& getTransform() const;
 
     // Returns the Alpha of the Surface, accounting for the Alpha
     // of parent Surfaces in the hierarchy (alpha's will be multiplied
@@ -936,6 +937,10 @@ protected:
     void addChildToDrawing(const sp<Layer>&);
     void updateClonedInputInfo(const std::map<sp<Layer>, sp<Layer>>& clonedLayersMap);
 
+    // Makes the next computeBounds() recompute this layer, after a change to its drawing state,
+    // hierarchy or latched buffer. Its ancestors are flagged so that they visit their children.
+    void invalidateBounds();
+
     // Modifies the passed in layer settings to clear the contents. If the blackout flag is set,
     // the settings clears the content with a solid black fill.
     void prepareClearClientComposition(LayerFE::LayerSettings&, bool blackout) const;
@@ -952,6 +957,8 @@ protected:
      * crop coordinates, transforming them into layer space.
      */
     void setupRoundedCornersCropCoordinates(Rect win, const FloatRect& roundedCornersCrop) const;
+    void computeOwnBounds(FloatRect parentBounds, const ui::Transform& parentTransform,
+                          float parentShadowRadius);
     void setParent(const sp<Layer>&);
     LayerVector makeTraversalList(LayerVector::StateSet, bool* outSkipRelativeZUsers);
     void addZOrderRelative(const wp<Layer>& relative);
@@ -1099,6 +1106,29 @@ private:
     // Layer bounds in screen space.
     FloatRect mScreenBounds;
 
+    // The arguments of the last computeBounds() along with the rotation of the primary display,
+    // which the buffer size of layers with transformToDisplayInverse depends on.
+    struct BoundsInputs {
+        FloatRect parentBounds;
+        ui::Transform parentTransform;
+        float parentShadowRadius;
+        ui::Transform::RotationFlags displayRotationFlags;
+
+        bool operator==(const BoundsInputs& other) const {
+            return parentBounds == other.parentBounds &&
+                    parentTransform == other.parentTransform &&
+                    parentShadowRadius == other.parentShadowRadius &&
+                    displayRotationFlags == other.displayRotationFlags;
+        }
+        bool operator!=(const BoundsInputs& other) const { return !(*this == other); }
+    };
+    std::optional<BoundsInputs> mBoundsInputs;
+
+    // Whether the layer needs to recompute its bounds regardless of its inputs, and whether a
+    // layer in its subtree does.
+    bool mBoundsDirty = true;
+    bool mChildBoundsDirty = false;
+
     bool mGetHandleCalled = false;
 
     // Tracks the process and user id of the caller when creating this layer
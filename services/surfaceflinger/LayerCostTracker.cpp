@@ -0,0 +1,214 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#undef LOG_TAG
+#define LOG_TAG "LayerCostTracker"
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+
+#include "LayerCostTracker.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include <android-base/stringprintf.h>
+#include <utils/String8.h>
+#include <utils/Trace.h>
+
+namespace android {
+
+using base::StringAppendF;
+
+nsecs_t LayerCostTracker::Cost::cpuTotal() const {
+    return std::accumulate(cpu.begin(), cpu.end(), nsecs_t(0));
+}
+
+void LayerCostTracker::setEnabled(bool enabled) {
+    std::lock_guard lock(mMutex);
+    mEnabled = enabled;
+    if (!enabled) {
+        mPendingCompositions.clear();
+        mFrameUids.clear();
+        traceFrameLocked();
+    }
+}
+
+void LayerCostTracker::clear() {
+    std::lock_guard lock(mMutex);
+    mLayers.clear();
+    mUids.clear();
+    mPendingCompositions.clear();
+    mFrameCount = 0;
+}
+
+void LayerCostTracker::addCpuTime(int32_t layerId, uid_t uid, const std::string& name,
+                                  CpuStage stage, nsecs_t duration) {
+    if (!isEnabled()) return;
+
+    std::lock_guard lock(mMutex);
+    const auto index = static_cast<size_t>(stage);
+    auto& layer = mLayers.try_emplace(layerId, LayerRecord{uid, name, {}}).first->second;
+    layer.cost.cpu[index] += duration;
+    mUids[uid].cpu[index] += duration;
+    mFrameUids[uid].cpu[index] += duration;
+}
+
+void LayerCostTracker::addClientComposition(nsecs_t startTime,
+                                            std::shared_ptr<FenceTime> doneFence,
+                                            std::vector<ClientCompositionLayer> layers) {
+    if (!isEnabled() || layers.empty()) return;
+
+    std::lock_guard lock(mMutex);
+    mPendingCompositions.push_back({startTime, std::move(doneFence), std::move(layers)});
+    if (mPendingCompositions.size() > kMaxPendingCompositions) {
+        mPendingCompositions.pop_front();
+    }
+}
+
+void LayerCostTracker::onFrameEnd() {
+    if (!isEnabled()) return;
+
+    ATRACE_CALL();
+    std::lock_guard lock(mMutex);
+    mFrameCount++;
+
+    // Client compositions finish in order, so the first one that is still pending ends the ones
+    // that can be attributed.
+    while (!mPendingCompositions.empty()) {
+        const auto& composition = mPendingCompositions.front();
+        const nsecs_t doneTime = composition.doneFence->getSignalTime();
+        if (doneTime == Fence::SIGNAL_TIME_PENDING) break;
+
+        if (doneTime != Fence::SIGNAL_TIME_INVALID && doneTime > composition.startTime) {
+            addGpuTimeLocked(composition, doneTime - composition.startTime);
+        }
+        mPendingCompositions.pop_front();
+    }
+
+    traceFrameLocked();
+    mFrameUids.clear();
+}
+
+void LayerCostTracker::addGpuTimeLocked(const PendingComposition& composition,
+                                        nsecs_t duration) {
+    const int64_t totalArea =
+            std::accumulate(composition.layers.begin(), composition.layers.end(), int64_t(0),
+                            [](int64_t area, const auto& layer) { return area + layer.area; });
+    if (totalArea <= 0) return;
+
+    for (const auto& layer : composition.layers) {
+        const auto gpuTime = static_cast<nsecs_t>(static_cast<double>(duration) *
+                                                  static_cast<double>(layer.area) /
+                                                  static_cast<double>(totalArea));
+        auto& record = mLayers.try_emplace(layer.layerId, LayerRecord{layer.uid, layer.name, {}})
+                               .first->second;
+        record.cost.gpu += gpuTime;
+        mUids[layer.uid].gpu += gpuTime;
+        mFrameUids[layer.uid].gpu += gpuTime;
+    }
+}
+
+void LayerCostTracker::traceFrameLocked() {
+    if (!ATRACE_ENABLED()) return;
+
+    for (const uid_t uid : mTracedUids) {
+        if (mFrameUids.count(uid) == 0) {
+            ATRACE_INT64(base::StringPrintf("LayerCost cpu uid %d", uid).c_str(), 0);
+            ATRACE_INT64(base::StringPrintf("LayerCost gpu uid %d", uid).c_str(), 0);
+        }
+    }
+
+    mTracedUids.clear();
+    for (const auto& [uid, cost] : mFrameUids) {
+        ATRACE_INT64(base::StringPrintf("LayerCost cpu uid %d", uid).c_str(), cost.cpuTotal());
+        ATRACE_INT64(base::StringPrintf("LayerCost gpu uid %d", uid).c_str(), cost.gpu);
+        mTracedUids.push_back(uid);
+    }
+}
+
+void LayerCostTracker::onLayerDestroyed(int32_t layerId) {
+    std::lock_guard lock(mMutex);
+    mLayers.erase(layerId);
+}
+
+void LayerCostTracker::parseArgs(const Vector<String16>& args, std::string& result) {
+    ATRACE_CALL();
+    std::unordered_map<std::string, bool> argsMap;
+    for (size_t i = 0; i < args.size(); i++) {
+        argsMap[std::string(String8(args[i]).c_str())] = true;
+    }
+
+    if (argsMap.count("-disable")) {
+        setEnabled(false);
+    }
+    if (argsMap.count("-clear")) {
+        clear();
+    }
+    if (argsMap.count("-enable")) {
+        setEnabled(true);
+    }
+
+    dump(result);
+}
+
+void LayerCostTracker::appendCost(const Cost& cost, std::string& result) {
+    const auto ms = [](nsecs_t duration) { return static_cast<double>(duration) / 1e6; };
+    StringAppendF(&result, "latch %8.3f  bounds %8.3f  client %8.3f  gpu %9.3f  total %9.3f ms\n",
+                  ms(cost.cpu[static_cast<size_t>(CpuStage::Latch)]),
+                  ms(cost.cpu[static_cast<size_t>(CpuStage::Bounds)]),
+                  ms(cost.cpu[static_cast<size_t>(CpuStage::ClientComposition)]), ms(cost.gpu),
+                  ms(cost.total()));
+}
+
+void LayerCostTracker::dump(std::string& result) const {
+    std::lock_guard lock(mMutex);
+    StringAppendF(&result, "Layer cost (%s) over %zu frames, as total time:\n",
+                  isEnabled() ? "enabled" : "disabled", mFrameCount);
+
+    std::vector<std::pair<uid_t, const Cost*>> uids;
+    uids.reserve(mUids.size());
+    for (const auto& [uid, cost] : mUids) {
+        uids.emplace_back(uid, &cost);
+    }
+    std::sort(uids.begin(), uids.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.second->total() > rhs.second->total();
+    });
+
+    result.append(" By uid:\n");
+    for (const auto& [uid, cost] : uids) {
+        StringAppendF(&result, "  uid %6d: ", uid);
+        appendCost(*cost, result);
+    }
+
+    std::vector<const LayerRecord*> layers;
+    layers.reserve(mLayers.size());
+    for (const auto& [_, layer] : mLayers) {
+        layers.push_back(&layer);
+    }
+    const size_t count = std::min(layers.size(), kMaxDumpedLayers);
+    std::partial_sort(layers.begin(), layers.begin() + static_cast<std::ptrdiff_t>(count),
+                      layers.end(), [](const auto* lhs, const auto* rhs) {
+                          return lhs->cost.total() > rhs->cost.total();
+                      });
+
+    StringAppendF(&result, " By layer, top %zu of %zu:\n", count, layers.size());
+    for (size_t i = 0; i < count; i++) {
+        StringAppendF(&result, "  %s (uid %d)\n    ", layers[i]->name.c_str(), layers[i]->uid);
+        appendCost(layers[i]->cost, result);
+    }
+}
+
+} // namespace android
@@ -0,0 +1,124 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <ui/FenceTime.h>
+#include <utils/String16.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace android {
+
+// Attributes the cost of composition to the layers that cause it, and to the uids that own them:
+// the main thread time spent latching their buffers, computing their bounds and preparing their
+// client composition, and their share of the GPU time spent on client composition.
+//
+// Tracking is off by default. It is controlled with dumpsys SurfaceFlinger --layer-cost, and
+// while enabled, the cost of each uid is traced as counters.
+class LayerCostTracker {
+public:
+    enum class CpuStage { Latch, Bounds, ClientComposition };
+
+    struct ClientCompositionLayer {
+        int32_t layerId;
+        uid_t uid;
+        std::string name;
+        // Pixels of the output that the layer is drawn to
+        int64_t area;
+    };
+
+    bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+    void clear();
+
+    void addCpuTime(int32_t layerId, uid_t uid, const std::string& name, CpuStage,
+                    nsecs_t duration);
+
+    // RenderEngine draws the client composition of an output in one go, so its GPU time, from
+    // its start until its fence signals, is split between the layers by the area they cover.
+    void addClientComposition(nsecs_t startTime, std::shared_ptr<FenceTime> doneFence,
+                              std::vector<ClientCompositionLayer> layers);
+
+    // Attributes the GPU time of the client compositions that have finished, and traces the cost
+    // of the uids for the frame.
+    void onFrameEnd();
+
+    void onLayerDestroyed(int32_t layerId);
+
+    // Handles -enable, -disable and -clear, then dumps the costs.
+    void parseArgs(const Vector<String16>& args, std::string& result);
+    void dump(std::string& result) const;
+
+private:
+    static constexpr size_t kCpuStageCount = static_cast<size_t>(CpuStage::ClientComposition) + 1;
+
+    // Fences of client compositions whose GPU work never finishes are dropped past this many.
+    static constexpr size_t kMaxPendingCompositions = 8;
+    // Layers with the highest cost that are dumped
+    static constexpr size_t kMaxDumpedLayers = 20;
+
+    struct Cost {
+        std::array<nsecs_t, kCpuStageCount> cpu{};
+        nsecs_t gpu = 0;
+
+        nsecs_t cpuTotal() const;
+        nsecs_t total() const { return cpuTotal() + gpu; }
+    };
+
+    struct LayerRecord {
+        uid_t uid;
+        std::string name;
+        Cost cost;
+    };
+
+    struct PendingComposition {
+        nsecs_t startTime;
+        std::shared_ptr<FenceTime> doneFence;
+        std::vector<ClientCompositionLayer> layers;
+    };
+
+    void addGpuTimeLocked(const PendingComposition&, nsecs_t duration) REQUIRES(mMutex);
+    void traceFrameLocked() REQUIRES(mMutex);
+    static void appendCost(const Cost&, std::string& result);
+
+    std::atomic_bool mEnabled = false;
+
+    mutable std::mutex mMutex;
+    std::unordered_map<int32_t, LayerRecord> mLayers GUARDED_BY(mMutex);
+    // Costs of the layers that were destroyed stay with their uid.
+    std::unordered_map<uid_t, Cost> mUids GUARDED_BY(mMutex);
+    std::deque<PendingComposition> mPendingCompositions GUARDED_BY(mMutex);
+    size_t mFrameCount GUARDED_BY(mMutex) = 0;
+
+    // Cost of the uids during the current frame, and the uids traced on the previous one, whose
+    // counters are reset if they did not cost anything since.
+    std::unordered_map<uid_t, Cost> mFrameUids GUARDED_BY(mMutex);
+    std::vector<uid_t> mTracedUids GUARDED_BY(mMutex);
+};
+
+} // namespace android
@@ -33,8 +33,10 @@
 #include <gui/IRegionSamplingListener.h>
 #include <gui/SyncScreenCaptureListener.h>
 #include <ui/DisplayStatInfo.h>
+#include <ui/GraphicBufferAllocator.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <string>
 
 #include "DisplayDevice.h"
@@ -64,6 +66,9 @@ constexpr auto defaultRegionSamplingWorkDuration = 3ms;
 constexpr auto defaultRegionSamplingPeriod = 100ms;
 constexpr auto defaultRegionSamplingTimerTimeout = 100ms;
 constexpr auto maxRegionSamplingDelay = 100ms;
+// The sampled bounds are rendered at this fraction of their size in each dimension, so that the
+// GPU does the bulk of the reduction, and the CPU reads back a sixteenth of the pixels.
+constexpr int32_t kSampleDownsampleFactor = 4;
 // TODO: (b/127403193) duration to string conversion could probably be constexpr
 template <typename Rep, typename Per>
 inline std::string toNsString(std::chrono::duration<Rep, Per> t) {
@@ -236,9 +241,42 @@ float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t st
     return accumulatedLuma / (255.0f * pixelCount);
 }
 
-std::vector<float> RegionSamplingThread::sampleBuffer(
-        const sp<GraphicBuffer>& buffer, const Point& leftTop,
-        const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation) {
+Rect downsampleArea(const Rect& area, const Rect& bounds, ui::Size size) {
+    const int32_t boundsWidth = bounds.getWidth();
+    const int32_t boundsHeight = bounds.getHeight();
+    if (boundsWidth <= 0 || boundsHeight <= 0) {
+        return Rect::INVALID_RECT;
+    }
+
+    const auto scaleDown = [](int32_t x, int32_t from, int32_t to) {
+        return static_cast<int32_t>(static_cast<int64_t>(x) * to / from);
+    };
+    const auto scaleUp = [](int32_t x, int32_t from, int32_t to) {
+        return static_cast<int32_t>((static_cast<int64_t>(x) * to + from - 1) / from);
+    };
+
+    const Rect relative = area - bounds.leftTop();
+    Rect downsampled(scaleDown(relative.left, boundsWidth, size.width),
+                     scaleDown(relative.top, boundsHeight, size.height),
+                     scaleUp(relative.right, boundsWidth, size.width),
+                     scaleUp(relative.bottom, boundsHeight, size.height));
+    downsampled.intersect(Rect(size), &downsampled);
+
+    if (downsampled.right <= downsampled.left) {
+        downsampled.right = std::min(downsampled.left + 1, size.width);
+        downsampled.left = downsampled.right - 1;
+    }
+    if (downsampled.bottom <= downsampled.top) {
+        downsampled.bottom = std::min(downsampled.top + 1, size.height);
+        downsampled.top = downsampled.bottom - 1;
+    }
+    return downsampled;
+}
+
+std::vector<float> RegionSamplingThread::sampleBuffer(const sp<GraphicBuffer>& buffer,
+                                                      const Rect& bounds,
+                                                      const std::vector<Rect>& areas,
+                                                      uint32_t orientation) {
     void* data_raw = nullptr;
     buffer->lock(GRALLOC_USAGE_SW_READ_OFTEN, &data_raw);
     std::shared_ptr<uint32_t> data(reinterpret_cast<uint32_t*>(data_raw),
@@ -248,12 +286,12 @@ std::vector<float> RegionSamplingThread::sampleBuffer(
     const int32_t width = buffer->getWidth();
     const int32_t height = buffer->getHeight();
     const int32_t stride = buffer->getStride();
-    std::vector<float> lumas(descriptors.size());
-    std::transform(descriptors.begin(), descriptors.end(), lumas.begin(),
-                   [&](auto const& descriptor) {
-                       return sampleArea(data.get(), width, height, stride, orientation,
-                                         descriptor.area - leftTop);
-                   });
+    const ui::Size size(width, height);
+    std::vector<float> lumas(areas.size());
+    std::transform(areas.begin(), areas.end(), lumas.begin(), [&](const Rect& area) {
+        return sampleArea(data.get(), width, height, stride, orientation,
+                          downsampleArea(area, bounds, size));
+    });
     return lumas;
 }
 
@@ -290,8 +328,12 @@ void RegionSamplingThread::captureSample() {
     const Rect sampledBounds = sampleRegion.bounds();
     constexpr bool kUseIdentityTransform = false;
 
+    // The luma of an area is its mean, which the filtered downsample preserves closely enough.
+    const ui::Size sampleSize(std::max(1, sampledBounds.getWidth() / kSampleDownsampleFactor),
+                              std::max(1, sampledBounds.getHeight() / kSampleDownsampleFactor));
+
     SurfaceFlinger::RenderAreaFuture renderAreaFuture = ftl::defer([=] {
-        return DisplayRenderArea::create(displayWeak, sampledBounds, sampledBounds.getSize(),
+        return DisplayRenderArea::create(displayWeak, sampledBounds, sampleSize,
                                          ui::Dataspace::V0_SRGB, kUseIdentityTransform);
     });
 
@@ -339,18 +381,32 @@ void RegionSamplingThread::captureSample() {
     };
 
     std::shared_ptr<renderengine::ExternalTexture> buffer = nullptr;
-    if (mCachedBuffer && mCachedBuffer->getBuffer()->getWidth() == sampledBounds.getWidth() &&
-        mCachedBuffer->getBuffer()->getHeight() == sampledBounds.getHeight()) {
+    if (mCachedBuffer &&
+        mCachedBuffer->getBuffer()->getWidth() == static_cast<uint32_t>(sampleSize.width) &&
+        mCachedBuffer->getBuffer()->getHeight() == static_cast<uint32_t>(sampleSize.height)) {
         buffer = mCachedBuffer;
     } else {
         const uint32_t usage =
                 GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_HW_RENDER | GRALLOC_USAGE_HW_TEXTURE;
-        sp<GraphicBuffer> graphicBuffer =
-                new GraphicBuffer(sampledBounds.getWidth(), sampledBounds.getHeight(),
-                                  PIXEL_FORMAT_RGBA_8888, 1, usage, "RegionSamplingThread");
-        const status_t bufferStatus = graphicBuffer->initCheck();
+        // The sampled bounds change with the sampled areas, so recycle the buffers. They never
+        // leave SurfaceFlinger, which makes this safe.
+        buffer_handle_t handle;
+        uint32_t stride;
+        const status_t bufferStatus = GraphicBufferAllocator::get()
+                .allocatePooled(sampleSize.width, sampleSize.height,
+                                PIXEL_FORMAT_RGBA_8888, 1, usage, &handle, &stride,
+                                "RegionSamplingThread");
         LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "captureSample: Buffer failed to allocate: %d",
                             bufferStatus);
+        sp<GraphicBuffer> graphicBuffer =
+                new GraphicBuffer(handle, GraphicBuffer::WRAP_HANDLE, sampleSize.width,
+                                  sampleSize.height, PIXEL_FORMAT_RGBA_8888, 1, usage, stride);
+        graphicBuffer->addDeathCallback(
+                [](void* context, uint64_t) {
+                    GraphicBufferAllocator::get().release(
+                            static_cast<buffer_handle_t>(context));
+                },
+                const_cast<native_handle_t*>(handle));
         buffer = std::make_shared<
                 renderengine::ExternalTexture>(graphicBuffer, mFlinger.getRenderEngine(),
                                                renderengine::ExternalTexture::Usage::WRITEABLE);
@@ -368,17 +424,28 @@ void RegionSamplingThread::captureSample() {
         }
     }
 
-    ALOGV("Sampling %zu descriptors", activeDescriptors.size());
-    std::vector<float> lumas = sampleBuffer(buffer->getBuffer(), sampledBounds.leftTop(),
-                                            activeDescriptors, orientation);
-    if (lumas.size() != activeDescriptors.size()) {
-        ALOGW("collected %zu median luma values for %zu descriptors", lumas.size(),
-              activeDescriptors.size());
+    // Listeners often sample the same area, e.g. several clients of the navigation bar region, so
+    // each distinct area is only sampled once.
+    std::vector<Rect> areas;
+    std::vector<size_t> areaIndices;
+    areaIndices.reserve(activeDescriptors.size());
+    for (const auto& descriptor : activeDescriptors) {
+        const auto it = std::find(areas.begin(), areas.end(), descriptor.area);
+        areaIndices.push_back(static_cast<size_t>(it - areas.begin()));
+        if (it == areas.end()) {
+            areas.push_back(descriptor.area);
+        }
+    }
+
+    ALOGV("Sampling %zu areas for %zu descriptors", areas.size(), activeDescriptors.size());
+    std::vector<float> lumas = sampleBuffer(buffer->getBuffer(), sampledBounds, areas, orientation);
+    if (lumas.size() != areas.size()) {
+        ALOGW("collected %zu median luma values for %zu areas", lumas.size(), areas.size());
         return;
     }
 
     for (size_t d = 0; d < activeDescriptors.size(); ++d) {
-        activeDescriptors[d].listener->onSampleCollected(lumas[d]);
+        activeDescriptors[d].listener->onSampleCollected(lumas[areaIndices[d]]);
     }
 
     mCachedBuffer = buffer;
@@ -21,6 +21,7 @@
 #include <renderengine/ExternalTexture.h>
 #include <ui/GraphicBuffer.h>
 #include <ui/Rect.h>
+#include <ui/Size.h>
 #include <utils/StrongPointer.h>
 
 #include <chrono>
@@ -42,6 +43,10 @@ struct SamplingOffsetCallback;
 float sampleArea(const uint32_t* data, int32_t width, int32_t height, int32_t stride,
                  uint32_t orientation, const Rect& area);
 
+// Maps an area within bounds to the pixels covering it in a capture of bounds downsampled to size.
+// The result covers at least one pixel, so that small areas are still sampled.
+Rect downsampleArea(const Rect& area, const Rect& bounds, ui::Size size);
+
 class RegionSamplingThread : public IBinder::DeathRecipient {
 public:
     struct TimingTunables {
@@ -93,9 +98,8 @@ private:
             return std::hash<IBinder*>()(p.unsafe_get());
         }
     };
-    std::vector<float> sampleBuffer(
-            const sp<GraphicBuffer>& buffer, const Point& leftTop,
-            const std::vector<RegionSamplingThread::Descriptor>& descriptors, uint32_t orientation);
+    std::vector<float> sampleBuffer(const sp<GraphicBuffer>& buffer, const Rect& bounds,
+                                    const std::vector<Rect>& areas, uint32_t orientation);
 
     void doSample(std::optional<std::chrono::steady_clock::time_point> samplingDeadline);
     void binderDied(const wp<IBinder>& who) override;
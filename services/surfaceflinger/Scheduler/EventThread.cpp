@@ -24,8 +24,10 @@
 #include <sched.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <functional>
 #include <optional>
 #include <type_traits>
 
@@ -76,8 +78,23 @@ std::string toString(VSyncRequest request) {
 }
 
 std::string toString(const EventThreadConnection& connection) {
-    return StringPrintf("Connection{%p, %s}", &connection,
-                        toString(connection.vsyncRequest).c_str());
+    return StringPrintf("Connection{%p, %s, delivered=%" PRIu64 ", dropped=%" PRIu64 "}",
+                        &connection, toString(connection.vsyncRequest).c_str(),
+                        connection.deliveredVSyncCount, connection.droppedVSyncCount);
+}
+
+// Returns the count of the first VSYNC after the given one that the request is due for, which
+// for a divided rate is the next multiple of the period.
+uint32_t nextVSyncCount(VSyncRequest request, uint32_t count) {
+    switch (request) {
+        case VSyncRequest::Single:
+        case VSyncRequest::SingleSuppressCallback:
+            return count + 1;
+        default: {
+            const auto period = static_cast<uint32_t>(vsyncPeriod(request));
+            return (count / period + 1) * period;
+        }
+    }
 }
 
 std::string toString(const DisplayEventReceiver::Event& event) {
@@ -186,11 +203,31 @@ void EventThreadConnection::requestNextVsync() {
     mEventThread->requestNextVsync(this);
 }
 
+status_t EventThreadConnection::getVsyncRing(gui::VsyncRing* outRing) {
+    std::lock_guard<std::mutex> lock(mVsyncRingMutex);
+    if (!mVsyncRing) {
+        auto ring = std::make_unique<gui::VsyncRing>(gui::VsyncRing::Create);
+        if (status_t err = ring->initCheck(); err != NO_ERROR) {
+            return err;
+        }
+        mVsyncRing = std::move(ring);
+    }
+    return mVsyncRing->share(outRing);
+}
+
 status_t EventThreadConnection::postEvent(const DisplayEventReceiver::Event& event) {
     constexpr auto toStatus = [](ssize_t size) {
         return size < 0 ? status_t(size) : status_t(NO_ERROR);
     };
 
+    if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+        std::lock_guard<std::mutex> lock(mVsyncRingMutex);
+        if (mVsyncRing) {
+            // The ring never fills up, so unlike mChannel this can't fail with EAGAIN.
+            return mVsyncRing->publish(event);
+        }
+    }
+
     if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE ||
         event.header.type == DisplayEventReceiver::DISPLAY_EVENT_FRAME_RATE_OVERRIDE_FLUSH) {
         mPendingEvents.emplace_back(event);
@@ -289,6 +326,8 @@ status_t EventThread::registerDisplayEventConnection(const sp<EventThreadConnect
     }
 
     mDisplayEventConnections.push_back(connection);
+    connection->registered = true;
+    scheduleVSyncLocked(connection);
     mCondition.notify_all();
     return NO_ERROR;
 }
@@ -299,6 +338,66 @@ void EventThread::removeDisplayEventConnectionLocked(const wp<EventThreadConnect
     if (it != mDisplayEventConnections.cend()) {
         mDisplayEventConnections.erase(it);
     }
+
+    unscheduleVSyncLocked(connection);
+    if (const auto strongConnection = connection.promote()) {
+        strongConnection->registered = false;
+    }
+}
+
+void EventThread::scheduleVSyncLocked(const sp<EventThreadConnection>& connection) {
+    if (!connection->registered || connection->vsyncRequest == VSyncRequest::None) {
+        return;
+    }
+
+    mVSyncSchedule.push_back(
+            {nextVSyncCount(connection->vsyncRequest, mDispatchedVSyncCount), connection});
+    std::push_heap(mVSyncSchedule.begin(), mVSyncSchedule.end(), std::greater<>());
+}
+
+void EventThread::unscheduleVSyncLocked(const wp<EventThreadConnection>& connection) {
+    const auto it = std::find_if(mVSyncSchedule.begin(), mVSyncSchedule.end(),
+                                 [&](const auto& entry) { return entry.connection == connection; });
+    if (it == mVSyncSchedule.end()) {
+        return;
+    }
+
+    mVSyncSchedule.erase(it);
+    std::make_heap(mVSyncSchedule.begin(), mVSyncSchedule.end(), std::greater<>());
+}
+
+void EventThread::rescheduleVSyncsLocked() {
+    auto schedule = std::move(mVSyncSchedule);
+    mVSyncSchedule.clear();
+    for (const auto& entry : schedule) {
+        if (const auto connection = entry.connection.promote()) {
+            scheduleVSyncLocked(connection);
+        }
+    }
+}
+
+void EventThread::collectVSyncConsumersLocked(const DisplayEventReceiver::Event& event,
+                                              DisplayEventConsumers& consumers) {
+    mDispatchedVSyncCount = event.vsync.count;
+
+    while (!mVSyncSchedule.empty() && mVSyncSchedule.front().count <= event.vsync.count) {
+        std::pop_heap(mVSyncSchedule.begin(), mVSyncSchedule.end(), std::greater<>());
+        const auto weakConnection = std::move(mVSyncSchedule.back().connection);
+        mVSyncSchedule.pop_back();
+
+        const auto connection = weakConnection.promote();
+        if (!connection) {
+            removeDisplayEventConnectionLocked(weakConnection);
+            continue;
+        }
+
+        if (shouldConsumeEvent(event, connection)) {
+            consumers.push_back(connection);
+        }
+
+        // The next due count is past this event, so this loop does not visit it again.
+        scheduleVSyncLocked(connection);
+    }
 }
 
 void EventThread::setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& connection) {
@@ -310,7 +409,9 @@ void EventThread::setVsyncRate(uint32_t rate, const sp<EventThreadConnection>& c
 
     const auto request = rate == 0 ? VSyncRequest::None : static_cast<VSyncRequest>(rate);
     if (connection->vsyncRequest != request) {
+        unscheduleVSyncLocked(connection);
         connection->vsyncRequest = request;
+        scheduleVSyncLocked(connection);
         mCondition.notify_all();
     }
 }
@@ -324,6 +425,7 @@ void EventThread::requestNextVsync(const sp<EventThreadConnection>& connection)
 
     if (connection->vsyncRequest == VSyncRequest::None) {
         connection->vsyncRequest = VSyncRequest::Single;
+        scheduleVSyncLocked(connection);
         mCondition.notify_all();
     } else if (connection->vsyncRequest == VSyncRequest::SingleSuppressCallback) {
         connection->vsyncRequest = VSyncRequest::Single;
@@ -415,6 +517,8 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
                 case DisplayEventReceiver::DISPLAY_EVENT_HOTPLUG:
                     if (event->hotplug.connected && !mVSyncState) {
                         mVSyncState.emplace(event->header.displayId);
+                        mDispatchedVSyncCount = 0;
+                        rescheduleVSyncsLocked();
                     } else if (!event->hotplug.connected && mVSyncState &&
                                mVSyncState->displayId == event->header.displayId) {
                         mVSyncState.reset();
@@ -429,21 +533,21 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             }
         }
 
-        bool vsyncRequested = false;
-
         // Find connections that should consume this event.
-        auto it = mDisplayEventConnections.begin();
-        while (it != mDisplayEventConnections.end()) {
-            if (const auto connection = it->promote()) {
-                vsyncRequested |= connection->vsyncRequest != VSyncRequest::None;
+        if (event && event->header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+            collectVSyncConsumersLocked(*event, consumers);
+        } else {
+            auto it = mDisplayEventConnections.begin();
+            while (it != mDisplayEventConnections.end()) {
+                if (const auto connection = it->promote()) {
+                    if (event && shouldConsumeEvent(*event, connection)) {
+                        consumers.push_back(connection);
+                    }
 
-                if (event && shouldConsumeEvent(*event, connection)) {
-                    consumers.push_back(connection);
+                    ++it;
+                } else {
+                    it = mDisplayEventConnections.erase(it);
                 }
-
-                ++it;
-            } else {
-                it = mDisplayEventConnections.erase(it);
             }
         }
 
@@ -452,6 +556,10 @@ void EventThread::threadMain(std::unique_lock<std::mutex>& lock) {
             consumers.clear();
         }
 
+        // Connections that went away stay scheduled until they are due, which keeps VSYNC
+        // enabled for at most their period.
+        const bool vsyncRequested = !mVSyncSchedule.empty();
+
         State nextState;
         if (mVSyncState && vsyncRequested) {
             nextState = mVSyncState->synthetic ? State::SyntheticVSync : State::VSync;
@@ -540,6 +648,7 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
                     return false;
                 case VSyncRequest::Single: {
                     if (throttleVsync()) {
+                        connection->droppedVSyncCount++;
                         return false;
                     }
                     connection->vsyncRequest = VSyncRequest::SingleSuppressCallback;
@@ -547,6 +656,7 @@ bool EventThread::shouldConsumeEvent(const DisplayEventReceiver::Event& event,
                 }
                 case VSyncRequest::Periodic:
                     if (throttleVsync()) {
+                        connection->droppedVSyncCount++;
                         return false;
                     }
                     return true;
@@ -572,15 +682,18 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                                 const DisplayEventConsumers& consumers) {
     const uint8_t num_attempts = 3;
     for (const auto& consumer : consumers) {
+        const bool isVSync = event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC;
         DisplayEventReceiver::Event copy = event;
-        if (event.header.type == DisplayEventReceiver::DISPLAY_EVENT_VSYNC) {
+        if (isVSync) {
             copy.vsync.frameInterval = mGetVsyncPeriodFunction(consumer->mOwnerUid);
         }
         bool needs_retry = true;
+        bool posted = false;
         for (uint8_t attempt = 0; needs_retry && (attempt < num_attempts); attempt++) {
             switch (consumer->postEvent(copy)) {
                 case NO_ERROR:
                     needs_retry = false;
+                    posted = true;
                     break;
 
                 case -EAGAIN:
@@ -595,6 +708,10 @@ void EventThread::dispatchEvent(const DisplayEventReceiver::Event& event,
                     needs_retry = false;
             }
         }
+
+        if (isVSync) {
+            (posted ? consumer->deliveredVSyncCount : consumer->droppedVSyncCount)++;
+        }
     }
 }
 
@@ -20,6 +20,7 @@
 #include <gui/DisplayEventReceiver.h>
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <private/gui/VsyncRing.h>
 #include <sys/types.h>
 #include <utils/Errors.h>
 
@@ -91,11 +92,18 @@ public:
     status_t stealReceiveChannel(gui::BitTube* outChannel) override;
     status_t setVsyncRate(uint32_t rate) override;
     void requestNextVsync() override; // asynchronous
+    status_t getVsyncRing(gui::VsyncRing* outRing) override;
 
     // Called in response to requestNextVsync.
     const ResyncCallback resyncCallback;
 
     VSyncRequest vsyncRequest = VSyncRequest::None;
+    // Whether the EventThread dispatches events to this connection.
+    bool registered = false;
+    // VSYNC events posted to this connection, and those it was due for but did not get, because
+    // they were throttled or could not be posted.
+    uint64_t deliveredVSyncCount = 0;
+    uint64_t droppedVSyncCount = 0;
     const uid_t mOwnerUid;
     const ISurfaceComposer::EventRegistrationFlags mEventRegistration;
 
@@ -105,6 +113,10 @@ private:
     gui::BitTube mChannel;
 
     std::vector<DisplayEventReceiver::Event> mPendingEvents;
+
+    // Created on the first getVsyncRing, after which vsync events bypass mChannel.
+    std::mutex mVsyncRingMutex;
+    std::unique_ptr<gui::VsyncRing> mVsyncRing GUARDED_BY(mVsyncRingMutex);
 };
 
 class EventThread {
@@ -202,6 +214,16 @@ private:
     void removeDisplayEventConnectionLocked(const wp<EventThreadConnection>& connection)
             REQUIRES(mMutex);
 
+    // Adds the connection to mVSyncSchedule for the next VSYNC its request is due for, if any.
+    void scheduleVSyncLocked(const sp<EventThreadConnection>&) REQUIRES(mMutex);
+    void unscheduleVSyncLocked(const wp<EventThreadConnection>&) REQUIRES(mMutex);
+    // Recomputes the due VSYNC counts, after the count restarts with a newly connected display.
+    void rescheduleVSyncsLocked() REQUIRES(mMutex);
+    // Takes the connections due for the VSYNC event out of mVSyncSchedule, and schedules them
+    // again for their next VSYNC.
+    void collectVSyncConsumersLocked(const DisplayEventReceiver::Event&, DisplayEventConsumers&)
+            REQUIRES(mMutex);
+
     // Implements VSyncSource::Callback
     void onVSyncEvent(nsecs_t timestamp, nsecs_t expectedVSyncTimestamp,
                       nsecs_t deadlineTimestamp) override;
@@ -221,6 +243,19 @@ private:
     std::vector<wp<EventThreadConnection>> mDisplayEventConnections GUARDED_BY(mMutex);
     std::deque<DisplayEventReceiver::Event> mPendingEvents GUARDED_BY(mMutex);
 
+    // The connections with a VSYNC request, in a min-heap by the count of the next VSYNC they
+    // are due for, so that VSYNC events only visit the connections they may be posted to rather
+    // than every connection, most of which are idle or at a divided rate.
+    struct ScheduledVSync {
+        uint32_t count;
+        wp<EventThreadConnection> connection;
+
+        bool operator>(const ScheduledVSync& other) const { return count > other.count; }
+    };
+    std::vector<ScheduledVSync> mVSyncSchedule GUARDED_BY(mMutex);
+    // The count of the last VSYNC event dispatched, which due counts are computed from.
+    uint32_t mDispatchedVSyncCount GUARDED_BY(mMutex) = 0;
+
     // VSYNC state of connected display.
     struct VSyncState {
         explicit VSyncState(PhysicalDisplayId displayId) : displayId(displayId) {}
@@ -85,9 +85,9 @@ LayerHistory::~LayerHistory() = default;
 
 void LayerHistory::registerLayer(Layer* layer, LayerVoteType type) {
     std::lock_guard lock(mLock);
-    for (const auto& info : mLayerInfos) {
-        LOG_ALWAYS_FATAL_IF(info.first == layer, "%s already registered", layer->getName().c_str());
-    }
+    const bool inserted = mLayerIndices.try_emplace(layer, mLayerInfos.size()).second;
+    LOG_ALWAYS_FATAL_IF(!inserted, "%s already registered", layer->getName().c_str());
+
     auto info = std::make_unique<LayerInfo>(layer->getName(), layer->getOwnerUid(), type);
     mLayerInfos.emplace_back(layer, std::move(info));
 }
@@ -95,32 +95,41 @@ void LayerHistory::registerLayer(Layer* layer, LayerVoteType type) {
 void LayerHistory::deregisterLayer(Layer* layer) {
     std::lock_guard lock(mLock);
 
-    const auto it = std::find_if(mLayerInfos.begin(), mLayerInfos.end(),
-                                 [layer](const auto& pair) { return pair.first == layer; });
-    LOG_ALWAYS_FATAL_IF(it == mLayerInfos.end(), "%s: unknown layer %p", __FUNCTION__, layer);
+    const auto index = mLayerIndices.find(layer);
+    LOG_ALWAYS_FATAL_IF(!index, "%s: unknown layer %p", __FUNCTION__, layer);
 
-    const size_t i = static_cast<size_t>(it - mLayerInfos.begin());
+    // Move the layer to the end of its partition, and then to the end of the vector.
+    size_t i = index->get();
     if (i < mActiveLayersEnd) {
-        mActiveLayersEnd--;
+        swapLayers(i, --mActiveLayersEnd);
+        i = mActiveLayersEnd;
     }
-    const size_t last = mLayerInfos.size() - 1;
-    std::swap(mLayerInfos[i], mLayerInfos[last]);
-    mLayerInfos.erase(mLayerInfos.begin() + static_cast<long>(last));
+    swapLayers(i, mLayerInfos.size() - 1);
+    mLayerInfos.pop_back();
+    mLayerIndices.erase(layer);
+}
+
+void LayerHistory::swapLayers(size_t i, size_t j) {
+    if (i == j) return;
+
+    std::swap(mLayerInfos[i], mLayerInfos[j]);
+    mLayerIndices[mLayerInfos[i].first] = i;
+    mLayerIndices[mLayerInfos[j].first] = j;
 }
 
 void LayerHistory::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
                           LayerUpdateType updateType) {
     std::lock_guard lock(mLock);
 
-    const auto it = std::find_if(mLayerInfos.begin(), mLayerInfos.end(),
-                                 [layer](const auto& pair) { return pair.first == layer; });
-    if (it == mLayerInfos.end()) {
+    const auto index = mLayerIndices.find(layer);
+    if (!index) {
         // Offscreen layer
         ALOGV("LayerHistory::record: %s not registered", layer->getName().c_str());
         return;
     }
 
-    const auto& info = it->second;
+    const size_t i = index->get();
+    const auto& info = mLayerInfos[i].second;
     const auto layerProps = LayerInfo::LayerProps{
             .visible = layer->isVisible(),
             .bounds = layer->getBounds(),
@@ -132,9 +141,8 @@ void LayerHistory::record(Layer* layer, nsecs_t presentTime, nsecs_t now,
     info->setLastPresentTime(presentTime, now, updateType, mModeChangePending, layerProps);
 
     // Activate layer if inactive.
-    if (const auto end = activeLayers().end(); it >= end) {
-        std::iter_swap(it, end);
-        mActiveLayersEnd++;
+    if (i >= mActiveLayersEnd) {
+        swapLayers(i, mActiveLayersEnd++);
     }
 }
 
@@ -219,7 +227,7 @@ void LayerHistory::partitionLayers(nsecs_t now) {
         }
 
         info->onLayerInactive(now);
-        std::swap(mLayerInfos[i], mLayerInfos[--mActiveLayersEnd]);
+        swapLayers(i, --mActiveLayersEnd);
     }
 }
 
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <android-base/thread_annotations.h>
+#include <ftl/flat_hash_map.h>
 #include <utils/RefBase.h>
 #include <utils/Timers.h>
 
@@ -92,11 +93,13 @@ private:
 
     ActiveLayers activeLayers() REQUIRES(mLock) { return {mLayerInfos, mActiveLayersEnd}; }
 
-    // Iterates over layers in a single pass, swapping pairs such that active layers precede
-    // inactive layers, and inactive layers precede expired layers. Removes expired layers by
-    // truncating after inactive layers.
+    // Iterates over active layers in a single pass, swapping pairs such that active layers precede
+    // inactive layers.
     void partitionLayers(nsecs_t now) REQUIRES(mLock);
 
+    // Swaps the layers at the given indices, and updates their entries in mLayerIndices.
+    void swapLayers(size_t i, size_t j) REQUIRES(mLock);
+
     mutable std::mutex mLock;
 
     // Partitioned such that active layers precede inactive layers. For fast lookup, the few active
@@ -104,6 +107,9 @@ private:
     LayerInfos mLayerInfos GUARDED_BY(mLock);
     size_t mActiveLayersEnd GUARDED_BY(mLock) = 0;
 
+    // Index of each layer in mLayerInfos, so that recording does not search all layers.
+    ftl::FlatHashMap<const Layer*, size_t, 0> mLayerIndices GUARDED_BY(mLock);
+
     uint32_t mDisplayArea = 0;
 
     // Whether to emit systrace output and debug logs.
@@ -61,9 +61,6 @@ void LayerInfo::setLastPresentTime(nsecs_t lastPresentTime, nsecs_t now, LayerUp
                                        .queueTime = mLastUpdatedTime,
                                        .pendingModeChange = pendingModeChange};
             mFrameTimes.push_back(frameTime);
-            if (mFrameTimes.size() > HISTORY_SIZE) {
-                mFrameTimes.pop_front();
-            }
             break;
     }
 }
@@ -82,21 +79,21 @@ bool LayerInfo::isFrequent(nsecs_t now) const {
     }
 
     // Find the first active frame
-    auto it = mFrameTimes.begin();
-    for (; it != mFrameTimes.end(); ++it) {
-        if (it->queueTime >= getActiveLayerThreshold(now)) {
+    size_t first = 0;
+    for (; first < mFrameTimes.size(); first++) {
+        if (mFrameTimes[first].queueTime >= getActiveLayerThreshold(now)) {
             break;
         }
     }
 
-    const auto numFrames = std::distance(it, mFrameTimes.end());
+    const size_t numFrames = mFrameTimes.size() - first;
     if (numFrames < kFrequentLayerWindowSize) {
         return false;
     }
 
     // Layer is considered frequent if the average frame rate is higher than the threshold
-    const auto totalTime = mFrameTimes.back().queueTime - it->queueTime;
-    return Fps::fromPeriodNsecs(totalTime / (numFrames - 1))
+    const auto totalTime = mFrameTimes.back().queueTime - mFrameTimes[first].queueTime;
+    return Fps::fromPeriodNsecs(totalTime / static_cast<nsecs_t>(numFrames - 1))
             .greaterThanOrEqualWithMargin(kMinFpsForFrequentLayer);
 }
 
@@ -127,23 +124,34 @@ bool LayerInfo::hasEnoughDataForHeuristic() const {
 }
 
 std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
+    if (!mFrameTimeSummary || mFrameTimeSummary->generation != mFrameTimes.generation()) {
+        mFrameTimeSummary = summarizeFrameTimes();
+    }
+
     // Ignore frames captured during a mode change
-    const bool isDuringModeChange =
-            std::any_of(mFrameTimes.begin(), mFrameTimes.end(),
-                        [](const auto& frame) { return frame.pendingModeChange; });
-    if (isDuringModeChange) {
+    if (mFrameTimeSummary->isDuringModeChange) {
         return std::nullopt;
     }
 
-    const bool isMissingPresentTime =
-            std::any_of(mFrameTimes.begin(), mFrameTimes.end(),
-                        [](auto frame) { return frame.presentTime == 0; });
-    if (isMissingPresentTime && !mLastRefreshRate.reported.isValid()) {
+    if (mFrameTimeSummary->isMissingPresentTime && !mLastRefreshRate.reported.isValid()) {
         // If there are no presentation timestamps and we haven't calculated
         // one in the past then we can't calculate the refresh rate
         return std::nullopt;
     }
 
+    return mFrameTimeSummary->averageFrameTime;
+}
+
+LayerInfo::FrameTimeSummary LayerInfo::summarizeFrameTimes() const {
+    FrameTimeSummary summary{.generation = mFrameTimes.generation()};
+    for (size_t i = 0; i < mFrameTimes.size(); i++) {
+        summary.isDuringModeChange |= mFrameTimes[i].pendingModeChange;
+        summary.isMissingPresentTime |= mFrameTimes[i].presentTime == 0;
+    }
+    if (summary.isDuringModeChange) {
+        return summary;
+    }
+
     // Calculate the average frame time based on presentation timestamps. If those
     // doesn't exist, we look at the time the buffer was queued only. We can do that only if
     // we calculated a refresh rate based on presentation timestamps in the past. The reason
@@ -152,20 +160,21 @@ std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
     // presentation timestamps we look at the queue time to see if the current refresh rate still
     // matches the content.
 
-    auto getFrameTime = isMissingPresentTime ? [](FrameTimeData data) { return data.queueTime; }
-                                             : [](FrameTimeData data) { return data.presentTime; };
+    auto getFrameTime = summary.isMissingPresentTime
+            ? [](const FrameTimeData& data) { return data.queueTime; }
+            : [](const FrameTimeData& data) { return data.presentTime; };
 
     nsecs_t totalDeltas = 0;
     int numDeltas = 0;
-    auto prevFrame = mFrameTimes.begin();
-    for (auto it = mFrameTimes.begin() + 1; it != mFrameTimes.end(); ++it) {
-        const auto currDelta = getFrameTime(*it) - getFrameTime(*prevFrame);
+    size_t prevFrame = 0;
+    for (size_t i = 1; i < mFrameTimes.size(); i++) {
+        const auto currDelta = getFrameTime(mFrameTimes[i]) - getFrameTime(mFrameTimes[prevFrame]);
         if (currDelta < kMinPeriodBetweenFrames) {
             // Skip this frame, but count the delta into the next frame
             continue;
         }
 
-        prevFrame = it;
+        prevFrame = i;
 
         if (currDelta > kMaxPeriodBetweenFrames) {
             // Skip this frame and the current delta.
@@ -176,12 +185,12 @@ std::optional<nsecs_t> LayerInfo::calculateAverageFrameTime() const {
         numDeltas++;
     }
 
-    if (numDeltas == 0) {
-        return std::nullopt;
+    if (numDeltas > 0) {
+        const auto averageFrameTime =
+                static_cast<double>(totalDeltas) / static_cast<double>(numDeltas);
+        summary.averageFrameTime = static_cast<nsecs_t>(averageFrameTime);
     }
-
-    const auto averageFrameTime = static_cast<double>(totalDeltas) / static_cast<double>(numDeltas);
-    return static_cast<nsecs_t>(averageFrameTime);
+    return summary;
 }
 
 std::optional<Fps> LayerInfo::calculateRefreshRateIfPossible(nsecs_t now) {
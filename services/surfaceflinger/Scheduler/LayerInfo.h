@@ -19,8 +19,10 @@
 #include <ui/Transform.h>
 #include <utils/Timers.h>
 
+#include <array>
 #include <chrono>
 #include <deque>
+#include <optional>
 
 #include "LayerHistory.h"
 #include "RefreshRateConfigs.h"
@@ -260,11 +262,21 @@ private:
         static constexpr float MARGIN_CONSISTENT_FPS = 1.0;
     };
 
+    // Summary of the recorded frame times, from which the average frame time is derived.
+    struct FrameTimeSummary {
+        // Generation of the frame times that the summary was computed from.
+        uint64_t generation = 0;
+        bool isDuringModeChange = false;
+        bool isMissingPresentTime = false;
+        std::optional<nsecs_t> averageFrameTime;
+    };
+
     bool isFrequent(nsecs_t now) const;
     bool isAnimating(nsecs_t now) const;
     bool hasEnoughDataForHeuristic() const;
     std::optional<Fps> calculateRefreshRateIfPossible(nsecs_t now);
     std::optional<nsecs_t> calculateAverageFrameTime() const;
+    FrameTimeSummary summarizeFrameTimes() const;
     bool isFrameTimeValid(const FrameTimeData&) const;
 
     const std::string mName;
@@ -287,12 +299,53 @@ private:
 
     RefreshRateHeuristicData mLastRefreshRate;
 
-    std::deque<FrameTimeData> mFrameTimes;
-    std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
-            std::chrono::steady_clock::now();
     static constexpr size_t HISTORY_SIZE = RefreshRateHistory::HISTORY_SIZE;
     static constexpr std::chrono::nanoseconds HISTORY_DURATION = 1s;
 
+    // Ring of the HISTORY_SIZE most recent frame times, in which a new frame overwrites the oldest
+    // one. The generation changes whenever the frames do.
+    class FrameTimes {
+    public:
+        size_t size() const { return mSize; }
+        bool empty() const { return mSize == 0; }
+        uint64_t generation() const { return mGeneration; }
+
+        // Index 0 is the oldest frame.
+        const FrameTimeData& operator[](size_t i) const {
+            return mFrames[(mBegin + i) % HISTORY_SIZE];
+        }
+        const FrameTimeData& front() const { return (*this)[0]; }
+        const FrameTimeData& back() const { return (*this)[mSize - 1]; }
+
+        void push_back(const FrameTimeData& frameTime) {
+            mFrames[(mBegin + mSize) % HISTORY_SIZE] = frameTime;
+            if (mSize < HISTORY_SIZE) {
+                mSize++;
+            } else {
+                mBegin = (mBegin + 1) % HISTORY_SIZE;
+            }
+            mGeneration++;
+        }
+
+        void clear() {
+            mBegin = 0;
+            mSize = 0;
+            mGeneration++;
+        }
+
+    private:
+        std::array<FrameTimeData, HISTORY_SIZE> mFrames;
+        size_t mBegin = 0;
+        size_t mSize = 0;
+        uint64_t mGeneration = 0;
+    };
+
+    FrameTimes mFrameTimes;
+    // Only recomputed when new frames are recorded, rather than every time the layer is summarized.
+    mutable std::optional<FrameTimeSummary> mFrameTimeSummary;
+    std::chrono::time_point<std::chrono::steady_clock> mFrameTimeValidSince =
+            std::chrono::steady_clock::now();
+
     LayerProps mLayerProps;
 
     RefreshRateHistory mRefreshRateHistory;
@@ -16,6 +16,7 @@
 
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 
+#include <android-base/unique_fd.h>
 #include <binder/IPCThreadState.h>
 
 #include <utils/Log.h>
@@ -252,4 +253,36 @@ std::optional<std::chrono::steady_clock::time_point> MessageQueue::nextExpectedI
     return std::nullopt;
 }
 
+// Keeps a duplicate of the fence file descriptor open while the Looper polls it. The Looper drops
+// the callback, which closes the descriptor, once it has removed the registration.
+class MessageQueue::FenceCallback : public LooperCallback {
+public:
+    FenceCallback(base::unique_fd fd, std::function<void()>&& onSignaled)
+          : mFd(std::move(fd)), mOnSignaled(std::move(onSignaled)) {}
+
+    int getFd() const { return mFd.get(); }
+
+    int handleEvent(int, int, void*) override {
+        mOnSignaled();
+        return 0; // Remove registration.
+    }
+
+private:
+    const base::unique_fd mFd;
+    const std::function<void()> mOnSignaled;
+};
+
+void MessageQueue::waitForFence(const sp<Fence>& fence, std::function<void()> onSignaled) {
+    base::unique_fd fd(fence->isValid() ? fence->dup() : -1);
+    if (fd < 0) {
+        // Either the fence is already signaled, or there is nothing to wait on.
+        mLooper->sendMessage(makeTask(std::move(onSignaled)).first, Message());
+        return;
+    }
+
+    sp<FenceCallback> callback = new FenceCallback(std::move(fd), std::move(onSignaled));
+    mLooper->addFd(callback->getFd(), Looper::POLL_CALLBACK, Looper::EVENT_INPUT, callback,
+                   nullptr);
+}
+
 } // namespace android::impl
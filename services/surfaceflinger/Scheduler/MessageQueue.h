@@ -17,6 +17,7 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <future>
 #include <type_traits>
 #include <utility>
@@ -24,6 +25,7 @@
 #include <android-base/thread_annotations.h>
 #include <gui/IDisplayEventConnection.h>
 #include <private/gui/BitTube.h>
+#include <ui/Fence.h>
 #include <utils/Looper.h>
 #include <utils/Timers.h>
 
@@ -74,6 +76,8 @@ public:
     virtual void invalidateImmed() = 0;
     virtual void refresh() = 0;
     virtual std::optional<std::chrono::steady_clock::time_point> nextExpectedInvalidate() = 0;
+    // Runs onSignaled on the main thread once the fence signals.
+    virtual void waitForFence(const sp<Fence>&, std::function<void()> onSignaled) = 0;
 };
 
 // ---------------------------------------------------------------------------
@@ -134,6 +138,8 @@ protected:
     void vsyncCallback(nsecs_t vsyncTime, nsecs_t targetWakeupTime, nsecs_t readyTime);
     void injectorCallback();
 
+    class FenceCallback;
+
 public:
     ~MessageQueue() override = default;
     void init(const sp<SurfaceFlinger>& flinger) override;
@@ -154,6 +160,8 @@ public:
     void refresh() override;
 
     std::optional<std::chrono::steady_clock::time_point> nextExpectedInvalidate() override;
+
+    void waitForFence(const sp<Fence>&, std::function<void()> onSignaled) override;
 };
 
 } // namespace impl
@@ -26,6 +26,7 @@
 #include <utils/Trace.h>
 #include <chrono>
 #include <cmath>
+#include <iterator>
 #include "../SurfaceFlingerProperties.h"
 
 #undef LOG_TAG
@@ -220,19 +221,37 @@ struct RefreshRateScore {
 RefreshRate RefreshRateConfigs::getBestRefreshRate(const std::vector<LayerRequirement>& layers,
                                                    const GlobalSignals& globalSignals,
                                                    GlobalSignals* outSignalsConsidered) const {
+    std::vector<const LayerRequirement*> sortedLayers;
+    sortedLayers.reserve(layers.size());
+    for (const auto& layer : layers) {
+        sortedLayers.push_back(&layer);
+    }
+    std::stable_sort(sortedLayers.begin(), sortedLayers.end(),
+                     [](const auto* lhs, const auto* rhs) { return lhs->name < rhs->name; });
+
     std::lock_guard lock(mLock);
 
-    if (auto cached = getCachedBestRefreshRate(layers, globalSignals, outSignalsConsidered)) {
+    if (auto cached = getCachedBestRefreshRate(sortedLayers, globalSignals, outSignalsConsidered)) {
         return *cached;
     }
 
     GlobalSignals signalsConsidered;
     RefreshRate result = getBestRefreshRateLocked(layers, globalSignals, &signalsConsidered);
-    lastBestRefreshRateInvocation.emplace(
-            GetBestRefreshRateInvocation{.layerRequirements = layers,
+
+    std::vector<LayerRequirement> layerRequirements;
+    layerRequirements.reserve(sortedLayers.size());
+    for (const auto* layer : sortedLayers) {
+        layerRequirements.push_back(*layer);
+    }
+    mBestRefreshRateInvocations.push_front(
+            GetBestRefreshRateInvocation{.layerRequirements = std::move(layerRequirements),
                                          .globalSignals = globalSignals,
                                          .outSignalsConsidered = signalsConsidered,
                                          .resultingBestRefreshRate = result});
+    if (mBestRefreshRateInvocations.size() > kMaxCachedInvocations) {
+        mBestRefreshRateInvocations.pop_back();
+    }
+
     if (outSignalsConsidered) {
         *outSignalsConsidered = signalsConsidered;
     }
@@ -240,20 +259,33 @@ RefreshRate RefreshRateConfigs::getBestRefreshRate(const std::vector<LayerRequir
 }
 
 std::optional<RefreshRate> RefreshRateConfigs::getCachedBestRefreshRate(
-        const std::vector<LayerRequirement>& layers, const GlobalSignals& globalSignals,
-        GlobalSignals* outSignalsConsidered) const {
-    const bool sameAsLastCall = lastBestRefreshRateInvocation &&
-            lastBestRefreshRateInvocation->layerRequirements == layers &&
-            lastBestRefreshRateInvocation->globalSignals == globalSignals;
-
-    if (sameAsLastCall) {
-        if (outSignalsConsidered) {
-            *outSignalsConsidered = lastBestRefreshRateInvocation->outSignalsConsidered;
-        }
-        return lastBestRefreshRateInvocation->resultingBestRefreshRate;
+        const std::vector<const LayerRequirement*>& sortedLayers,
+        const GlobalSignals& globalSignals, GlobalSignals* outSignalsConsidered) const {
+    const auto it =
+            std::find_if(mBestRefreshRateInvocations.begin(), mBestRefreshRateInvocations.end(),
+                         [&](const GetBestRefreshRateInvocation& invocation) {
+                             return invocation.globalSignals == globalSignals &&
+                                     std::equal(invocation.layerRequirements.begin(),
+                                                invocation.layerRequirements.end(),
+                                                sortedLayers.begin(), sortedLayers.end(),
+                                                [](const LayerRequirement& cachedLayer,
+                                                   const LayerRequirement* layer) {
+                                                    return cachedLayer == *layer;
+                                                });
+                         });
+
+    if (it == mBestRefreshRateInvocations.end()) {
+        mBestRefreshRateCacheMisses++;
+        return {};
+    }
+
+    mBestRefreshRateCacheHits++;
+    std::rotate(mBestRefreshRateInvocations.begin(), it, std::next(it));
+    const auto& invocation = mBestRefreshRateInvocations.front();
+    if (outSignalsConsidered) {
+        *outSignalsConsidered = invocation.outSignalsConsidered;
     }
-
-    return {};
+    return invocation.resultingBestRefreshRate;
 }
 
 RefreshRate RefreshRateConfigs::getBestRefreshRateLocked(
@@ -673,9 +705,9 @@ const RefreshRate& RefreshRateConfigs::getCurrentRefreshRateByPolicyLocked() con
 void RefreshRateConfigs::setCurrentModeId(DisplayModeId modeId) {
     std::lock_guard lock(mLock);
 
-    // Invalidate the cached invocation to getBestRefreshRate. This forces
+    // Invalidate the cached invocations to getBestRefreshRate. This forces
     // the refresh rate to be recomputed on the next call to getBestRefreshRate.
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateInvocations.clear();
 
     mCurrentRefreshRate = mRefreshRates.at(modeId).get();
 }
@@ -695,9 +727,9 @@ void RefreshRateConfigs::updateDisplayModes(const DisplayModes& modes,
         return mode->getId() == currentModeId;
     }));
 
-    // Invalidate the cached invocation to getBestRefreshRate. This forces
+    // Invalidate the cached invocations to getBestRefreshRate. This forces
     // the refresh rate to be recomputed on the next call to getBestRefreshRate.
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateInvocations.clear();
 
     mRefreshRates.clear();
     for (const auto& mode : modes) {
@@ -755,7 +787,7 @@ status_t RefreshRateConfigs::setDisplayManagerPolicy(const Policy& policy) {
         ALOGE("Invalid refresh rate policy: %s", policy.toString().c_str());
         return BAD_VALUE;
     }
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateInvocations.clear();
     Policy previousPolicy = *getCurrentPolicyLocked();
     mDisplayManagerPolicy = policy;
     if (*getCurrentPolicyLocked() == previousPolicy) {
@@ -770,7 +802,7 @@ status_t RefreshRateConfigs::setOverridePolicy(const std::optional<Policy>& poli
     if (policy && !isPolicyValidLocked(*policy)) {
         return BAD_VALUE;
     }
-    lastBestRefreshRateInvocation.reset();
+    mBestRefreshRateInvocations.clear();
     Policy previousPolicy = *getCurrentPolicyLocked();
     mOverridePolicy = policy;
     if (*getCurrentPolicyLocked() == previousPolicy) {
@@ -949,6 +981,14 @@ void RefreshRateConfigs::dump(std::string& result) const {
 
     base::StringAppendF(&result, "Supports Frame Rate Override: %s\n",
                         mSupportsFrameRateOverride ? "yes" : "no");
+
+    const size_t lookups = mBestRefreshRateCacheHits + mBestRefreshRateCacheMisses;
+    base::StringAppendF(&result,
+                        "Best refresh rate cache: %zu hits, %zu misses (%.1f%% hit rate)\n",
+                        mBestRefreshRateCacheHits, mBestRefreshRateCacheMisses,
+                        lookups ? 100.f * static_cast<float>(mBestRefreshRateCacheHits) /
+                                        static_cast<float>(lookups)
+                                : 0.f);
     result.append("\n");
 }
 
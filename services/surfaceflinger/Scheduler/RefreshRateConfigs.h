@@ -20,6 +20,7 @@
 #include <gui/DisplayEventReceiver.h>
 
 #include <algorithm>
+#include <deque>
 #include <numeric>
 #include <optional>
 #include <type_traits>
@@ -366,9 +367,10 @@ private:
             const std::function<bool(const RefreshRate&)>& shouldAddRefreshRate,
             std::vector<const RefreshRate*>* outRefreshRates) REQUIRES(mLock);
 
-    std::optional<RefreshRate> getCachedBestRefreshRate(const std::vector<LayerRequirement>& layers,
-                                                        const GlobalSignals& globalSignals,
-                                                        GlobalSignals* outSignalsConsidered) const
+    // Looks up a previous invocation with the same layers, which are ordered by name, and signals.
+    std::optional<RefreshRate> getCachedBestRefreshRate(
+            const std::vector<const LayerRequirement*>& sortedLayers,
+            const GlobalSignals& globalSignals, GlobalSignals* outSignalsConsidered) const
             REQUIRES(mLock);
 
     RefreshRate getBestRefreshRateLocked(const std::vector<LayerRequirement>& layers,
@@ -444,13 +446,19 @@ private:
     bool mSupportsFrameRateOverride;
 
     struct GetBestRefreshRateInvocation {
+        // Ordered by name, so that the same layers match regardless of the order of the query.
         std::vector<LayerRequirement> layerRequirements;
         GlobalSignals globalSignals;
         GlobalSignals outSignalsConsidered;
         RefreshRate resultingBestRefreshRate;
     };
-    mutable std::optional<GetBestRefreshRateInvocation> lastBestRefreshRateInvocation
-            GUARDED_BY(mLock);
+
+    // The most recent invocations to getBestRefreshRate, most recently used first. Invalidated when
+    // the policy or display modes change.
+    static constexpr size_t kMaxCachedInvocations = 8;
+    mutable std::deque<GetBestRefreshRateInvocation> mBestRefreshRateInvocations GUARDED_BY(mLock);
+    mutable size_t mBestRefreshRateCacheHits GUARDED_BY(mLock) = 0;
+    mutable size_t mBestRefreshRateCacheMisses GUARDED_BY(mLock) = 0;
 };
 
 } // namespace android::scheduler
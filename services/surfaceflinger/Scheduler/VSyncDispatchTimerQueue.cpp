@@ -17,6 +17,7 @@
 #define ATRACE_TAG ATRACE_TAG_GRAPHICS
 #include <android-base/stringprintf.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <vector>
 
 #include "TimeKeeper.h"
@@ -42,6 +43,7 @@ nsecs_t getExpectedCallbackTime(VSyncTracker& tracker, nsecs_t now,
 
 VSyncDispatch::~VSyncDispatch() = default;
 VSyncTracker::~VSyncTracker() = default;
+Clock::~Clock() = default;
 TimeKeeper::~TimeKeeper() = default;
 
 VSyncDispatchTimerQueueEntry::VSyncDispatchTimerQueueEntry(std::string const& name,
@@ -219,7 +221,80 @@ void VSyncDispatchTimerQueue::setTimer(nsecs_t targetTime, nsecs_t /*now*/) {
 }
 
 void VSyncDispatchTimerQueue::rearmTimer(nsecs_t now) {
-    rearmTimerSkippingUpdateFor(now, mCallbacks.end());
+    rearmTimerSkippingUpdateFor(now, nullptr);
+}
+
+void VSyncDispatchTimerQueue::placeArmed(size_t i, nsecs_t wakeupTime, CallbackState* state) {
+    mArmedCallbacks[i] = {wakeupTime, state};
+    state->heapIndex = i;
+}
+
+void VSyncDispatchTimerQueue::siftArmedUp(size_t i) {
+    auto const armed = mArmedCallbacks[i];
+    while (i > 0) {
+        auto const parent = (i - 1) / 2;
+        if (mArmedCallbacks[parent].wakeupTime <= armed.wakeupTime) {
+            break;
+        }
+        placeArmed(i, mArmedCallbacks[parent].wakeupTime, mArmedCallbacks[parent].state);
+        i = parent;
+    }
+    placeArmed(i, armed.wakeupTime, armed.state);
+}
+
+void VSyncDispatchTimerQueue::siftArmedDown(size_t i) {
+    auto const armed = mArmedCallbacks[i];
+    auto const size = mArmedCallbacks.size();
+    while (true) {
+        auto child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size &&
+            mArmedCallbacks[child + 1].wakeupTime < mArmedCallbacks[child].wakeupTime) {
+            child++;
+        }
+        if (armed.wakeupTime <= mArmedCallbacks[child].wakeupTime) {
+            break;
+        }
+        placeArmed(i, mArmedCallbacks[child].wakeupTime, mArmedCallbacks[child].state);
+        i = child;
+    }
+    placeArmed(i, armed.wakeupTime, armed.state);
+}
+
+void VSyncDispatchTimerQueue::insertOrUpdateArmed(CallbackState& state) {
+    auto const wakeupTime = *state.entry->wakeupTime();
+    if (state.heapIndex == kNotArmed) {
+        mArmedCallbacks.push_back({});
+        placeArmed(mArmedCallbacks.size() - 1, wakeupTime, &state);
+    } else {
+        mArmedCallbacks[state.heapIndex].wakeupTime = wakeupTime;
+    }
+    siftArmedUp(state.heapIndex);
+    siftArmedDown(state.heapIndex);
+}
+
+void VSyncDispatchTimerQueue::removeArmed(CallbackState& state) {
+    auto const i = state.heapIndex;
+    if (i == kNotArmed) {
+        return;
+    }
+    state.heapIndex = kNotArmed;
+
+    auto const last = mArmedCallbacks.back();
+    mArmedCallbacks.pop_back();
+    if (last.state != &state) {
+        placeArmed(i, last.wakeupTime, last.state);
+        siftArmedUp(i);
+        siftArmedDown(last.state->heapIndex);
+    }
+}
+
+void VSyncDispatchTimerQueue::rebuildArmed() {
+    for (size_t i = mArmedCallbacks.size() / 2; i-- > 0;) {
+        siftArmedDown(i);
+    }
 }
 
 void VSyncDispatchTimerQueue::TraceBuffer::note(std::string_view name, nsecs_t alarmIn,
@@ -232,33 +307,41 @@ void VSyncDispatchTimerQueue::TraceBuffer::note(std::string_view name, nsecs_t a
     ATRACE_NAME(str_buffer.data());
 }
 
-void VSyncDispatchTimerQueue::rearmTimerSkippingUpdateFor(
-        nsecs_t now, CallbackMap::iterator const& skipUpdateIt) {
-    std::optional<nsecs_t> min;
-    std::optional<nsecs_t> targetVsync;
-    std::optional<std::string_view> nextWakeupName;
-    for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-        auto& callback = it->second;
-        if (!callback->wakeupTime() && !callback->hasPendingWorkloadUpdate()) {
-            continue;
-        }
-
-        if (it != skipUpdateIt) {
-            callback->update(mTracker, now);
-        }
-        auto const wakeupTime = *callback->wakeupTime();
-        if (!min || (min && *min > wakeupTime)) {
-            nextWakeupName = callback->name();
-            min = wakeupTime;
-            targetVsync = callback->targetVsync();
+void VSyncDispatchTimerQueue::rearmTimerSkippingUpdateFor(nsecs_t now,
+                                                          const CallbackState* skipUpdate) {
+    // Armed callbacks are predicted again from the latest model, which may move any of them, so
+    // the heap is rebuilt rather than fixed up for each one.
+    for (auto& armed : mArmedCallbacks) {
+        if (armed.state != skipUpdate) {
+            armed.state->entry->update(mTracker, now);
+            armed.wakeupTime = *armed.state->entry->wakeupTime();
         }
     }
 
-    if (min && (min < mIntendedWakeupTime)) {
-        if (targetVsync && nextWakeupName) {
-            mTraceBuffer.note(*nextWakeupName, *min - now, *targetVsync - now);
-        }
-        setTimer(*min, now);
+    // The others with a pending workload update are armed by applying it.
+    auto const pendingEnd =
+            std::remove_if(mPendingUpdates.begin(), mPendingUpdates.end(),
+                           [&](CallbackState* state) REQUIRES(mMutex) {
+                               if (state == skipUpdate) {
+                                   return false;
+                               }
+                               if (state->entry->hasPendingWorkloadUpdate()) {
+                                   state->entry->update(mTracker, now);
+                               }
+                               auto const wakeupTime = state->entry->wakeupTime();
+                               if (state->heapIndex == kNotArmed && wakeupTime) {
+                                   mArmedCallbacks.push_back({});
+                                   placeArmed(mArmedCallbacks.size() - 1, *wakeupTime, state);
+                               }
+                               return true;
+                           });
+    mPendingUpdates.erase(pendingEnd, mPendingUpdates.end());
+    rebuildArmed();
+
+    if (!mArmedCallbacks.empty() && mArmedCallbacks.front().wakeupTime < mIntendedWakeupTime) {
+        auto const [min, next] = mArmedCallbacks.front();
+        mTraceBuffer.note(next->entry->name(), min - now, *next->entry->targetVsync() - now);
+        setTimer(min, now);
     } else {
         ATRACE_NAME("cancel timer");
         cancelTimer();
@@ -277,21 +360,21 @@ void VSyncDispatchTimerQueue::timerCallback() {
         std::lock_guard lock(mMutex);
         auto const now = mTimeKeeper->now();
         mLastTimerCallback = now;
-        for (auto it = mCallbacks.begin(); it != mCallbacks.end(); it++) {
-            auto& callback = it->second;
-            auto const wakeupTime = callback->wakeupTime();
-            if (!wakeupTime) {
-                continue;
-            }
-
-            auto const readyTime = callback->readyTime();
 
-            auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
-            if (*wakeupTime < mIntendedWakeupTime + mTimerSlack + lagAllowance) {
-                callback->executing();
-                invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
-                                                    *wakeupTime, *readyTime});
+        // Callbacks come due in order of their wakeup, so stop at the first that is not.
+        auto const lagAllowance = std::max(now - mIntendedWakeupTime, static_cast<nsecs_t>(0));
+        while (!mArmedCallbacks.empty()) {
+            auto const [wakeupTime, state] = mArmedCallbacks.front();
+            if (wakeupTime >= mIntendedWakeupTime + mTimerSlack + lagAllowance) {
+                break;
             }
+            auto const callback = state->entry;
+
+            auto const readyTime = *callback->readyTime();
+            removeArmed(*state);
+            callback->executing();
+            invocations.emplace_back(Invocation{callback, *callback->lastExecutedVsyncTarget(),
+                                                wakeupTime, readyTime});
         }
 
         mIntendedWakeupTime = kInvalidTime;
@@ -310,9 +393,9 @@ VSyncDispatchTimerQueue::CallbackToken VSyncDispatchTimerQueue::registerCallback
     return CallbackToken{
             mCallbacks
                     .emplace(++mCallbackToken,
-                             std::make_shared<VSyncDispatchTimerQueueEntry>(callbackName,
-                                                                            callbackFn,
-                                                                            mMinVsyncDistance))
+                             CallbackState{std::make_shared<
+                                     VSyncDispatchTimerQueueEntry>(callbackName, callbackFn,
+                                                                   mMinVsyncDistance)})
                     .first->first};
 }
 
@@ -322,7 +405,12 @@ void VSyncDispatchTimerQueue::unregisterCallback(CallbackToken token) {
         std::lock_guard lock(mMutex);
         auto it = mCallbacks.find(token);
         if (it != mCallbacks.end()) {
-            entry = it->second;
+            auto& state = it->second;
+            removeArmed(state);
+            mPendingUpdates.erase(std::remove(mPendingUpdates.begin(), mPendingUpdates.end(),
+                                              &state),
+                                  mPendingUpdates.end());
+            entry = std::move(state.entry);
             mCallbacks.erase(it);
         }
     }
@@ -342,13 +430,17 @@ ScheduleResult VSyncDispatchTimerQueue::schedule(CallbackToken token,
         if (it == mCallbacks.end()) {
             return result;
         }
-        auto& callback = it->second;
+        auto& state = it->second;
+        auto& callback = state.entry;
         auto const now = mTimeKeeper->now();
 
         /* If the timer thread will run soon, we'll apply this work update via the callback
          * timer recalculation to avoid cancelling a callback that is about to fire. */
         auto const rearmImminent = now > mIntendedWakeupTime;
         if (CC_UNLIKELY(rearmImminent)) {
+            if (!callback->hasPendingWorkloadUpdate()) {
+                mPendingUpdates.push_back(&state);
+            }
             callback->addPendingWorkloadUpdate(scheduleTiming);
             return getExpectedCallbackTime(mTracker, now, scheduleTiming);
         }
@@ -357,9 +449,10 @@ ScheduleResult VSyncDispatchTimerQueue::schedule(CallbackToken token,
         if (!result.has_value()) {
             return result;
         }
+        insertOrUpdateArmed(state);
 
         if (callback->wakeupTime() < mIntendedWakeupTime - mTimerSlack) {
-            rearmTimerSkippingUpdateFor(now, it);
+            rearmTimerSkippingUpdateFor(now, &state);
         }
     }
 
@@ -373,10 +466,12 @@ CancelResult VSyncDispatchTimerQueue::cancel(CallbackToken token) {
     if (it == mCallbacks.end()) {
         return CancelResult::Error;
     }
-    auto& callback = it->second;
+    auto& state = it->second;
+    auto& callback = state.entry;
 
     auto const wakeupTime = callback->wakeupTime();
     if (wakeupTime) {
+        removeArmed(state);
         callback->disarm();
 
         if (*wakeupTime == mIntendedWakeupTime) {
@@ -400,8 +495,8 @@ void VSyncDispatchTimerQueue::dump(std::string& result) const {
                   (mTimeKeeper->now() - mLastTimerCallback) / 1e6f,
                   (mTimeKeeper->now() - mLastTimerSchedule) / 1e6f);
     StringAppendF(&result, "\tCallbacks:\n");
-    for (const auto& [token, entry] : mCallbacks) {
-        entry->dump(result);
+    for (const auto& [token, state] : mCallbacks) {
+        state.entry->dump(result);
     }
 }
 
@@ -19,11 +19,13 @@
 #include <android-base/thread_annotations.h>
 #include <array>
 #include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "SchedulerUtils.h"
 #include "VSyncDispatch.h"
@@ -131,16 +133,30 @@ private:
     VSyncDispatchTimerQueue(VSyncDispatchTimerQueue const&) = delete;
     VSyncDispatchTimerQueue& operator=(VSyncDispatchTimerQueue const&) = delete;
 
-    using CallbackMap =
-            std::unordered_map<CallbackToken, std::shared_ptr<VSyncDispatchTimerQueueEntry>>;
+    static constexpr size_t kNotArmed = std::numeric_limits<size_t>::max();
+
+    struct CallbackState {
+        std::shared_ptr<VSyncDispatchTimerQueueEntry> entry;
+        // Position of the entry in mArmedCallbacks, or kNotArmed.
+        size_t heapIndex = kNotArmed;
+    };
+    using CallbackMap = std::unordered_map<CallbackToken, CallbackState>;
 
     void timerCallback();
     void setTimer(nsecs_t, nsecs_t) REQUIRES(mMutex);
     void rearmTimer(nsecs_t now) REQUIRES(mMutex);
-    void rearmTimerSkippingUpdateFor(nsecs_t now, CallbackMap::iterator const& skipUpdate)
+    void rearmTimerSkippingUpdateFor(nsecs_t now, const CallbackState* skipUpdate)
             REQUIRES(mMutex);
     void cancelTimer() REQUIRES(mMutex);
 
+    // Maintain the heap of armed callbacks, as their entries are armed, rearmed and disarmed.
+    void insertOrUpdateArmed(CallbackState&) REQUIRES(mMutex);
+    void removeArmed(CallbackState&) REQUIRES(mMutex);
+    void rebuildArmed() REQUIRES(mMutex);
+    void placeArmed(size_t i, nsecs_t wakeupTime, CallbackState*) REQUIRES(mMutex);
+    void siftArmedUp(size_t i) REQUIRES(mMutex);
+    void siftArmedDown(size_t i) REQUIRES(mMutex);
+
     static constexpr nsecs_t kInvalidTime = std::numeric_limits<int64_t>::max();
     std::unique_ptr<TimeKeeper> const mTimeKeeper;
     VSyncTracker& mTracker;
@@ -151,6 +167,16 @@ private:
     size_t mCallbackToken GUARDED_BY(mMutex) = 0;
 
     CallbackMap mCallbacks GUARDED_BY(mMutex);
+    // Armed callbacks, in a binary min-heap on their wakeup time, so that the next wakeup and the
+    // callbacks that are due are found without walking every registered callback. The states are
+    // owned by mCallbacks, whose nodes do not move.
+    struct ArmedCallback {
+        nsecs_t wakeupTime;
+        CallbackState* state;
+    };
+    std::vector<ArmedCallback> mArmedCallbacks GUARDED_BY(mMutex);
+    // Callbacks with a workload update to apply on the next rearm, armed or not.
+    std::vector<CallbackState*> mPendingUpdates GUARDED_BY(mMutex);
     nsecs_t mIntendedWakeupTime GUARDED_BY(mMutex) = kInvalidTime;
 
     struct TraceBuffer {
@@ -39,6 +39,19 @@ namespace android::scheduler {
 using base::StringAppendF;
 
 static auto constexpr kMaxPercent = 100u;
+// Drift of the period over the span of the timestamps, from the period their ordinals were snapped
+// to, past which they are snapped again.
+static auto constexpr kResnapDriftPercent = 1u;
+
+// Rounds to the nearest vsync count, down rather than toward zero for negative durations.
+static int64_t snapToPeriod(nsecs_t duration, nsecs_t period) {
+    auto const halfwayDuration = duration + period / 2;
+    auto periods = halfwayDuration / period;
+    if (halfwayDuration % period < 0) {
+        periods--;
+    }
+    return periods;
+}
 
 VSyncPredictor::~VSyncPredictor() = default;
 
@@ -62,6 +75,26 @@ inline size_t VSyncPredictor::next(size_t i) const {
     return (i + 1) % mTimestamps.size();
 }
 
+inline size_t VSyncPredictor::oldestIndex() const {
+    return mTimestamps.size() < kHistorySize ? 0 : next(mLastTimestampIndex);
+}
+
+void VSyncPredictor::RegressionSums::add(int64_t dx, int64_t dy) {
+    n++;
+    x += dx;
+    y += dy;
+    xx += dx * dx;
+    xy += dx * dy;
+}
+
+void VSyncPredictor::RegressionSums::shift(int64_t dx, int64_t dy) {
+    // Expands Sigma_i((X_i - dx) * (Y_i - dy)) and the like in terms of the current sums.
+    xx += n * dx * dx - 2 * dx * x;
+    xy += n * dx * dy - dy * x - dx * y;
+    x -= n * dx;
+    y -= n * dy;
+}
+
 bool VSyncPredictor::validate(nsecs_t timestamp) const {
     if (mLastTimestampIndex < 0 || mTimestamps.empty()) {
         return true;
@@ -113,12 +146,52 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
         return false;
     }
 
+    auto it = mRateMap.find(mIdealPeriod);
+    auto const currentPeriod = it->second.slope;
+
+    if (mTimestamps.size() >= kMinimumSamplesForPrediction) {
+        recordPredictionError(timestamp, it->second);
+    }
+
+    // The ordinal of the vsync count is snapped to the current period from the earliest timestamp,
+    // only for the new timestamp, so that the fit is updated in constant time.
+    int64_t ordinal = 0;
+    if (mTimestamps.empty()) {
+        mSnappedPeriod = currentPeriod;
+    } else {
+        ordinal = mOrdinals[mEarliestIndex] +
+                snapToPeriod(timestamp - mTimestamps[mEarliestIndex], currentPeriod);
+    }
+
     if (mTimestamps.size() != kHistorySize) {
         mTimestamps.push_back(timestamp);
+        mOrdinals.push_back(ordinal);
         mLastTimestampIndex = next(mLastTimestampIndex);
     } else {
+        // The oldest timestamp is the origin of the sums, so drop it, and move the origin to
+        // the next oldest.
         mLastTimestampIndex = next(mLastTimestampIndex);
+        auto const nextOldest = next(mLastTimestampIndex);
+        mSums.n--;
+        mSums.shift(mOrdinals[nextOldest] - mOrdinals[mLastTimestampIndex],
+                    mTimestamps[nextOldest] - mTimestamps[mLastTimestampIndex]);
+
         mTimestamps[mLastTimestampIndex] = timestamp;
+        mOrdinals[mLastTimestampIndex] = ordinal;
+    }
+
+    auto const oldest = oldestIndex();
+    mSums.add(ordinal - mOrdinals[oldest], timestamp - mTimestamps[oldest]);
+    auto const [earliest, latest] = std::minmax_element(mTimestamps.begin(), mTimestamps.end());
+    mEarliestIndex = static_cast<size_t>(earliest - mTimestamps.begin());
+    traceInt64If("VSP-ts", timestamp);
+
+    // The other timestamps would only snap to other ordinals once the period has drifted enough,
+    // over their span, to round them differently.
+    auto const span = (*latest - *earliest) / currentPeriod;
+    auto const drift = span * std::abs(currentPeriod - mSnappedPeriod);
+    if (drift * kMaxPercent >= currentPeriod * kResnapDriftPercent) {
+        resnapOrdinals(currentPeriod);
     }
 
     if (mTimestamps.size() < kMinimumSamplesForPrediction) {
@@ -141,39 +214,25 @@ bool VSyncPredictor::addVsyncTimestamp(nsecs_t timestamp) {
     //
     // intercept = mean(Y) - slope * mean(X)
     //
-    std::vector<nsecs_t> vsyncTS(mTimestamps.size());
-    std::vector<nsecs_t> ordinals(mTimestamps.size());
+    // Both sums are expanded in terms of the running sums of X, Y, X^2 and X*Y.
+
+    // normalizing to the earliest timestamp cuts down on error in calculating the intercept.
+    auto sums = mSums;
+    sums.shift(mOrdinals[mEarliestIndex] - mOrdinals[oldest],
+               mTimestamps[mEarliestIndex] - mTimestamps[oldest]);
 
-    // normalizing to the oldest timestamp cuts down on error in calculating the intercept.
-    auto const oldest_ts = *std::min_element(mTimestamps.begin(), mTimestamps.end());
-    auto it = mRateMap.find(mIdealPeriod);
-    auto const currentPeriod = it->second.slope;
     // TODO (b/144707443): its important that there's some precision in the mean of the ordinals
     //                     for the intercept calculation, so scale the ordinals by 1000 to continue
     //                     fixed point calculation. Explore expanding
     //                     scheduler::utils::calculate_mean to have a fixed point fractional part.
     static constexpr int64_t kScalingFactor = 1000;
 
-    for (auto i = 0u; i < mTimestamps.size(); i++) {
-        traceInt64If("VSP-ts", mTimestamps[i]);
-
-        vsyncTS[i] = mTimestamps[i] - oldest_ts;
-        ordinals[i] = ((vsyncTS[i] + (currentPeriod / 2)) / currentPeriod) * kScalingFactor;
-    }
-
-    auto meanTS = scheduler::calculate_mean(vsyncTS);
-    auto meanOrdinal = scheduler::calculate_mean(ordinals);
-    for (size_t i = 0; i < vsyncTS.size(); i++) {
-        vsyncTS[i] -= meanTS;
-        ordinals[i] -= meanOrdinal;
-    }
-
-    auto top = 0ll;
-    auto bottom = 0ll;
-    for (size_t i = 0; i < vsyncTS.size(); i++) {
-        top += vsyncTS[i] * ordinals[i];
-        bottom += ordinals[i] * ordinals[i];
-    }
+    auto const meanTS = sums.y / sums.n;
+    auto const meanOrdinal = sums.x * kScalingFactor / sums.n;
+    auto const top = kScalingFactor * sums.xy - meanOrdinal * sums.y -
+            kScalingFactor * meanTS * sums.x + sums.n * meanTS * meanOrdinal;
+    auto const bottom = kScalingFactor * kScalingFactor * sums.xx -
+            2 * kScalingFactor * meanOrdinal * sums.x + sums.n * meanOrdinal * meanOrdinal;
 
     if (CC_UNLIKELY(bottom == 0)) {
         it->second = {mIdealPeriod, 0};
@@ -211,7 +270,7 @@ nsecs_t VSyncPredictor::nextAnticipatedVSyncTimeFromLocked(nsecs_t timePoint) co
         return knownTimestamp + numPeriodsOut * mIdealPeriod;
     }
 
-    auto const oldest = *std::min_element(mTimestamps.begin(), mTimestamps.end());
+    auto const oldest = mTimestamps[mEarliestIndex];
 
     // See b/145667109, the ordinal calculation must take into account the intercept.
     auto const zeroPoint = oldest + intercept;
@@ -335,8 +394,36 @@ void VSyncPredictor::clearTimestamps() {
         }
 
         mTimestamps.clear();
+        mOrdinals.clear();
         mLastTimestampIndex = 0;
+        mEarliestIndex = 0;
+        mSums = {};
+    }
+}
+
+void VSyncPredictor::resnapOrdinals(nsecs_t period) {
+    auto const earliest = mTimestamps[mEarliestIndex];
+    auto const oldest = oldestIndex();
+    auto const oldestOrdinal = snapToPeriod(mTimestamps[oldest] - earliest, period);
+
+    mSums = {};
+    for (size_t i = 0; i < mTimestamps.size(); i++) {
+        mOrdinals[i] = snapToPeriod(mTimestamps[i] - earliest, period);
+        mSums.add(mOrdinals[i] - oldestOrdinal, mTimestamps[i] - mTimestamps[oldest]);
     }
+    mSnappedPeriod = period;
+}
+
+void VSyncPredictor::recordPredictionError(nsecs_t timestamp, const Model& model) {
+    auto const [slope, intercept] = model;
+    auto const zeroPoint = mTimestamps[mEarliestIndex] + intercept;
+    auto const ordinal = (timestamp - zeroPoint + slope / 2) / slope;
+    auto const error = std::abs(timestamp - (zeroPoint + ordinal * slope));
+
+    mPredictionErrorStats.count++;
+    mPredictionErrorStats.totalAbsError += error;
+    mPredictionErrorStats.maxAbsError = std::max(mPredictionErrorStats.maxAbsError, error);
+    traceInt64If("VSP-error", error);
 }
 
 bool VSyncPredictor::needsMoreSamples() const {
@@ -360,6 +447,13 @@ void VSyncPredictor::dump(std::string& result) const {
                       idealPeriod / 1e6f, periodInterceptTuple.slope / 1e6f,
                       periodInterceptTuple.intercept);
     }
+
+    const auto& stats = mPredictionErrorStats;
+    const auto meanAbsError = stats.count
+            ? static_cast<float>(stats.totalAbsError) / static_cast<float>(stats.count)
+            : 0.f;
+    StringAppendF(&result, "\tPrediction error: %zu vsyncs, mean = %.3fms, max = %.3fms\n",
+                  stats.count, meanAbsError / 1e6f, stats.maxAbsError / 1e6f);
 }
 
 } // namespace android::scheduler
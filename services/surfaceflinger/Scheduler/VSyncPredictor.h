@@ -72,6 +72,8 @@ private:
     VSyncPredictor(VSyncPredictor const&) = delete;
     VSyncPredictor& operator=(VSyncPredictor const&) = delete;
     void clearTimestamps() REQUIRES(mMutex);
+    void resnapOrdinals(nsecs_t period) REQUIRES(mMutex);
+    void recordPredictionError(nsecs_t timestamp, const Model&) REQUIRES(mMutex);
 
     inline void traceInt64If(const char* name, int64_t value) const;
     bool const mTraceOn;
@@ -82,6 +84,7 @@ private:
 
     std::mutex mutable mMutex;
     size_t next(size_t i) const REQUIRES(mMutex);
+    size_t oldestIndex() const REQUIRES(mMutex);
     bool validate(nsecs_t timestamp) const REQUIRES(mMutex);
 
     Model getVSyncPredictionModelLocked() const REQUIRES(mMutex);
@@ -99,6 +102,36 @@ private:
 
     size_t mLastTimestampIndex GUARDED_BY(mMutex) = 0;
     std::vector<nsecs_t> mTimestamps GUARDED_BY(mMutex);
+    // Vsync count of each timestamp, snapped to the model period when the timestamp was added, or
+    // when the period last drifted too far from mSnappedPeriod.
+    std::vector<int64_t> mOrdinals GUARDED_BY(mMutex);
+    nsecs_t mSnappedPeriod GUARDED_BY(mMutex) = 0;
+
+    // Running sums for the least-squares fit of the timestamps (y) over their ordinals (x), which
+    // are updated as timestamps enter and leave the ring. Both are relative to the oldest
+    // timestamp in the ring, so that the sums stay small.
+    struct RegressionSums {
+        int64_t n = 0;
+        int64_t x = 0;
+        int64_t y = 0;
+        int64_t xx = 0;
+        int64_t xy = 0;
+
+        void add(int64_t dx, int64_t dy);
+        // Moves the origin of the samples by the given offsets.
+        void shift(int64_t dx, int64_t dy);
+    };
+    RegressionSums mSums GUARDED_BY(mMutex);
+    // Timestamps may be added out of order, so the model is relative to the earliest one.
+    size_t mEarliestIndex GUARDED_BY(mMutex) = 0;
+
+    // Distance of the timestamps from the prediction of the model, when they were added.
+    struct PredictionErrorStats {
+        size_t count = 0;
+        nsecs_t totalAbsError = 0;
+        nsecs_t maxAbsError = 0;
+    };
+    PredictionErrorStats mPredictionErrorStats GUARDED_BY(mMutex);
 };
 
 } // namespace android::scheduler
@@ -0,0 +1,151 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define ATRACE_TAG ATRACE_TAG_GRAPHICS
+#undef LOG_TAG
+#define LOG_TAG "ScreenCaptureThread"
+
+#include "ScreenCaptureThread.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+
+#include <hardware/gralloc.h>
+#include <log/log.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Trace.h>
+
+#include "SurfaceFlingerFactory.h"
+
+namespace android {
+
+ScreenCaptureThread::ScreenCaptureThread(surfaceflinger::Factory& factory,
+                                         renderengine::RenderEngine& renderEngine)
+      : mFactory(factory), mRenderEngine(renderEngine) {
+    mThread = std::thread([this]() { threadMain(); });
+    pthread_setname_np(mThread.native_handle(), "ScreenCapture");
+}
+
+ScreenCaptureThread::~ScreenCaptureThread() {
+    {
+        std::lock_guard lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+void ScreenCaptureThread::post(Task&& task) {
+    {
+        std::lock_guard lock(mMutex);
+        mTasks.push(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+std::shared_ptr<renderengine::ExternalTexture> ScreenCaptureThread::acquireBuffer(
+        ui::Size size, ui::PixelFormat format, uint64_t usage) {
+    ATRACE_CALL();
+
+    const BufferSpec spec{size, format, usage};
+    std::shared_ptr<renderengine::ExternalTexture> buffer;
+    {
+        std::lock_guard lock(mMutex);
+        const auto it = std::find_if(mBuffers.begin(), mBuffers.end(),
+                                     [&](const auto& entry) { return entry.first == spec; });
+        if (it != mBuffers.end()) {
+            buffer = std::move(it->second);
+            mBuffers.erase(it);
+        }
+
+        // Protected memory is scarce, so it is never set aside.
+        if (!(usage & GRALLOC_USAGE_PROTECTED)) {
+            mRefills.push(spec);
+        }
+    }
+    mCondition.notify_one();
+
+    return buffer ? buffer : allocateBuffer(spec);
+}
+
+std::shared_ptr<renderengine::ExternalTexture> ScreenCaptureThread::allocateBuffer(
+        const BufferSpec& spec) {
+    ATRACE_CALL();
+
+    sp<GraphicBuffer> buffer =
+            mFactory.createGraphicBuffer(spec.size.getWidth(), spec.size.getHeight(),
+                                         static_cast<android_pixel_format>(spec.format),
+                                         1 /* layerCount */, spec.usage, "screenshot");
+
+    const status_t bufferStatus = buffer->initCheck();
+    LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "captureScreenCommon: Buffer failed to allocate: %d",
+                        bufferStatus);
+    return std::make_shared<
+            renderengine::ExternalTexture>(buffer, mRenderEngine,
+                                           renderengine::ExternalTexture::Usage::WRITEABLE);
+}
+
+void ScreenCaptureThread::refillBuffer(const BufferSpec& spec) {
+    {
+        std::lock_guard lock(mMutex);
+        const bool pooled = std::any_of(mBuffers.begin(), mBuffers.end(),
+                                        [&](const auto& entry) { return entry.first == spec; });
+        if (pooled) return;
+    }
+
+    auto buffer = allocateBuffer(spec);
+
+    std::lock_guard lock(mMutex);
+    mBuffers.emplace_back(spec, std::move(buffer));
+    if (mBuffers.size() > kMaxPooledBuffers) {
+        mBuffers.pop_front();
+    }
+}
+
+void ScreenCaptureThread::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return !mRunning || !mTasks.empty() || !mRefills.empty();
+        });
+
+        // Pending captures are drawn before exiting, as their listeners are waiting for them.
+        if (!mTasks.empty()) {
+            Task task = std::move(mTasks.front());
+            mTasks.pop();
+            lock.unlock();
+            task();
+            lock.lock();
+        } else if (!mRunning) {
+            break;
+        } else {
+            const BufferSpec spec = mRefills.front();
+            mRefills.pop();
+            lock.unlock();
+            refillBuffer(spec);
+            lock.lock();
+        }
+    }
+
+    // Release the pooled buffers while RenderEngine, which they are mapped into, is alive.
+    mBuffers.clear();
+}
+
+} // namespace android
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/thread_annotations.h>
+#include <renderengine/ExternalTexture.h>
+#include <renderengine/RenderEngine.h>
+#include <ui/PixelFormat.h>
+#include <ui/Size.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace android {
+
+namespace surfaceflinger {
+class Factory;
+} // namespace surfaceflinger
+
+// Draws screen captures off the main thread. The main thread snapshots the layers to capture into
+// client composition requests, and posts the draw, which goes through the threaded RenderEngine, to
+// this thread. It also keeps a small pool of capture buffers, which are allocated and mapped into
+// RenderEngine ahead of the captures that need them.
+class ScreenCaptureThread {
+public:
+    using Task = std::function<void()>;
+
+    ScreenCaptureThread(surfaceflinger::Factory&, renderengine::RenderEngine&);
+    ~ScreenCaptureThread();
+
+    ScreenCaptureThread(const ScreenCaptureThread&) = delete;
+    ScreenCaptureThread& operator=(const ScreenCaptureThread&) = delete;
+
+    // Runs the task on the capture thread, after the tasks posted before it.
+    void post(Task&&);
+
+    // Returns a writeable capture buffer, from the pool if one matches, or else newly allocated.
+    // Buffers are handed over to the capturing client for good, so the pool is refilled on the
+    // capture thread, when idle, to have a buffer ready for the next capture of the same kind.
+    std::shared_ptr<renderengine::ExternalTexture> acquireBuffer(ui::Size, ui::PixelFormat,
+                                                                 uint64_t usage);
+
+private:
+    struct BufferSpec {
+        ui::Size size;
+        ui::PixelFormat format;
+        uint64_t usage;
+
+        bool operator==(const BufferSpec& other) const {
+            return size == other.size && format == other.format && usage == other.usage;
+        }
+    };
+
+    std::shared_ptr<renderengine::ExternalTexture> allocateBuffer(const BufferSpec&);
+    void refillBuffer(const BufferSpec&);
+    void threadMain();
+
+    // Pooled buffers hold on to graphics memory, so only the most recent few are kept around.
+    static constexpr size_t kMaxPooledBuffers = 2;
+
+    surfaceflinger::Factory& mFactory;
+    renderengine::RenderEngine& mRenderEngine;
+
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    std::queue<Task> mTasks GUARDED_BY(mMutex);
+    // Buffers are refilled once there are no captures left to draw.
+    std::queue<BufferSpec> mRefills GUARDED_BY(mMutex);
+    std::deque<std::pair<BufferSpec, std::shared_ptr<renderengine::ExternalTexture>>> mBuffers
+            GUARDED_BY(mMutex);
+    bool mRunning GUARDED_BY(mMutex) = true;
+
+    std::thread mThread;
+};
+
+} // namespace android
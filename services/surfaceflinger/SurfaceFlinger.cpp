@@ -128,6 +128,7 @@
 #include "NativeWindowSurface.h"
 #include "RefreshRateOverlay.h"
 #include "RegionSamplingThread.h"
+#include "ScreenCaptureThread.h"
 #include "Scheduler/DispSyncSource.h"
 #include "Scheduler/EventThread.h"
 #include "Scheduler/LayerHistory.h"
@@ -205,6 +206,9 @@ namespace hal = android::hardware::graphics::composer::hal;
 
 namespace {
 
+// RenderEngine persists the shaders it compiles there, so they are not compiled again at boot.
+constexpr auto kShaderCachePath = "/data/misc/surfaceflinger/shader_cache";
+
 #pragma clang diagnostic push
 #pragma clang diagnostic error "-Wswitch-enum"
 
@@ -269,6 +273,47 @@ struct SCOPED_CAPABILITY UnnecessaryLock {
     ~UnnecessaryLock() RELEASE() {}
 };
 
+// Dumps go on without the lock after a timeout, so that a stuck main thread can be diagnosed.
+void appendDumpLockStatus(const TimedLock& lock, std::string& result) {
+    if (!lock.locked()) {
+        StringAppendF(&result, "Dumping without lock after timeout: %s (%d)\n",
+                      strerror(-lock.status), lock.status);
+        ALOGW("Dumping without lock after timeout: %s (%d)", strerror(-lock.status), lock.status);
+    }
+}
+
+bool isColorizedDump(const Vector<String16>& args) {
+    return !args.empty() && args[0] == String16("--color");
+}
+
+// Times the phases of SurfaceFlinger::init, which hold back the boot animation.
+class StartupTimer {
+public:
+    // Ends the phase that started when the previous one ended.
+    void endPhase(const char* name) {
+        const nsecs_t now = systemTime();
+        addPhase(name, now - mPhaseStart);
+        mPhaseStart = now;
+    }
+
+    // Adds a phase that ran concurrently with the others.
+    void addPhase(const char* name, nsecs_t duration) {
+        StringAppendF(&mTimings, "%s%s %.1fms", mTimings.empty() ? "" : ", ", name,
+                      static_cast<double>(duration) / 1e6);
+    }
+
+    std::string finish() {
+        StringAppendF(&mTimings, " (total %.1fms)",
+                      static_cast<double>(systemTime() - mStart) / 1e6);
+        return std::move(mTimings);
+    }
+
+private:
+    const nsecs_t mStart = systemTime();
+    nsecs_t mPhaseStart = mStart;
+    std::string mTimings;
+};
+
 // TODO(b/141333600): Consolidate with DisplayMode::Builder::getDefaultDensity.
 constexpr float FALLBACK_DENSITY = ACONFIGURATION_DENSITY_TV;
 
@@ -662,6 +707,12 @@ SurfaceFlinger::SurfaceFlinger(Factory& factory) : SurfaceFlinger(factory, SkipI
     property_get("debug.sf.luma_sampling", value, "1");
     mLumaSampling = atoi(value);
 
+    // Off by default; only buffers that never leave SurfaceFlinger are recycled.
+    GraphicBufferAllocator::get().setPoolLimit(
+            static_cast<size_t>(std::max(base::GetIntProperty("debug.sf.buffer_pool_size_kb"s, 0),
+                                         0)) *
+            1024);
+
     property_get("debug.sf.disable_client_composition_cache", value, "0");
     mDisableClientCompositionCache = atoi(value);
 
@@ -767,7 +818,10 @@ void SurfaceFlinger::binderDied(const wp<IBinder>&) {
     mBootFinished = false;
 
     // Sever the link to inputflinger since its gone as well.
-    static_cast<void>(schedule([=] { mInputFlinger = nullptr; }));
+    static_cast<void>(schedule([=] {
+        mInputFlinger = nullptr;
+        mInputWindowInfosSent = false;
+    }));
 
     // restore initial conditions (default device unblank, etc)
     initializeDisplays();
@@ -993,10 +1047,20 @@ void SurfaceFlinger::bootFinished() {
             ALOGE("Failed to link to input service");
         } else {
             mInputFlinger = interface_cast<os::IInputFlinger>(input);
+            mInputWindowInfosSent = false;
         }
 
         readPersistentProperties();
         mPowerAdvisor.onBootFinished();
+        if (mUsePowerHintSession) {
+            // RenderEngine may run on the main thread.
+            std::vector<int32_t> threadIds = {gettid()};
+            if (const int32_t renderEngineTid = getRenderEngine().getRETid();
+                renderEngineTid != threadIds.front()) {
+                threadIds.push_back(renderEngineTid);
+            }
+            mPowerAdvisor.startPowerHintSession(threadIds);
+        }
         mBootStage = BootStage::FINISHED;
 
         if (property_get_bool("sf.debug.show_refresh_rate_overlay", false)) {
@@ -1063,8 +1127,19 @@ void SurfaceFlinger::init() {
     ALOGI(  "SurfaceFlinger's main thread ready to run. "
             "Initializing graphics H/W...");
     Mutex::Autolock _l(mStateLock);
+    StartupTimer startupTimer;
 
     InitComposerExtn();
+
+    // Connecting to the composer HAL does not depend on RenderEngine, so it is done while
+    // RenderEngine sets up its context.
+    auto hwComposerFuture = std::async(std::launch::async, [this] {
+        ATRACE_NAME("createHWComposer");
+        const nsecs_t start = systemTime();
+        auto hwComposer = getFactory().createHWComposer(mHwcServiceName);
+        return std::make_pair(std::move(hwComposer), systemTime() - start);
+    });
+
     // Get a RenderEngine for the given display / config (can't fail)
     // TODO(b/77156734): We need to stop casting and use HAL types when possible.
     // Sending maxFrameBufferAcquiredBuffers as the cache size is tightly tuned to single-display.
@@ -1080,7 +1155,34 @@ void SurfaceFlinger::init() {
                             useContextPriority
                                     ? renderengine::RenderEngine::ContextPriority::REALTIME
                                     : renderengine::RenderEngine::ContextPriority::MEDIUM)
+                    .setShaderCachePath(base::GetProperty("debug.sf.shader_cache_path"s,
+                                                          kShaderCachePath))
                     .build()));
+    startupTimer.endPhase("RenderEngine");
+
+    const auto renderEngineType = getRenderEngine().getRenderEngineType();
+    const bool renderEngineIsThreaded =
+            renderEngineType == renderengine::RenderEngine::RenderEngineType::THREADED ||
+            renderEngineType == renderengine::RenderEngine::RenderEngineType::SKIA_GL_THREADED ||
+            renderEngineType == renderengine::RenderEngine::RenderEngineType::SKIA_VK_THREADED;
+    mImportBuffersOnBinderThreads = renderEngineIsThreaded;
+    mPresentOutputsInParallel =
+            base::GetBoolProperty("debug.sf.present_outputs_in_parallel"s, false) &&
+            renderEngineIsThreaded;
+    ALOGI_IF(mPresentOutputsInParallel, "Presenting outputs in parallel");
+    mPredictCompositionStrategy =
+            base::GetBoolProperty("debug.sf.predict_hwc_composition_strategy"s, false);
+    ALOGI_IF(mPredictCompositionStrategy, "Predicting the HWC composition strategy");
+    mUsePowerHintSession = base::GetBoolProperty("debug.sf.enable_adpf_cpu_hint"s, false);
+    mPublishLayerSnapshots = base::GetBoolProperty("debug.sf.publish_layer_snapshots"s, false);
+
+    // RenderEngine switches between its protected and unprotected contexts for the main thread,
+    // so the capture thread cannot draw in between if it supports protected content.
+    if (base::GetBoolProperty("debug.sf.capture_screen_off_main_thread"s, true) &&
+        renderEngineIsThreaded && !getRenderEngine().supportsProtectedContent()) {
+        mScreenCaptureThread =
+                std::make_unique<ScreenCaptureThread>(getFactory(), getRenderEngine());
+    }
 
     // Set SF main policy after initializing RenderEngine which has its own policy.
     if (!SetTaskProfiles(0, {"SFMainPolicy"})) {
@@ -1088,7 +1190,10 @@ void SurfaceFlinger::init() {
     }
 
     mCompositionEngine->setTimeStats(mTimeStats);
-    mCompositionEngine->setHwComposer(getFactory().createHWComposer(mHwcServiceName));
+    auto [hwComposer, hwComposerDuration] = hwComposerFuture.get();
+    startupTimer.addPhase("HWComposer", hwComposerDuration);
+    startupTimer.endPhase("HWComposer wait");
+    mCompositionEngine->setHwComposer(std::move(hwComposer));
     mCompositionEngine->getHwComposer().setCallback(this);
     ClientCache::getInstance().setRenderEngine(&getRenderEngine());
 
@@ -1098,6 +1203,7 @@ void SurfaceFlinger::init() {
 
     // Process any initial hotplug and resulting display changes.
     processDisplayHotplugEventsLocked();
+    startupTimer.endPhase("hotplug");
     const auto display = getDefaultDisplayDeviceLocked();
     LOG_ALWAYS_FATAL_IF(!display, "Missing internal display after registering composer callback.");
     const auto displayId = display->getPhysicalId();
@@ -1118,6 +1224,7 @@ void SurfaceFlinger::init() {
 
     // set initial conditions (e.g. unblank default device)
     initializeDisplays();
+    startupTimer.endPhase("initializeDisplays");
 
     mPowerAdvisor.init();
 
@@ -1134,6 +1241,8 @@ void SurfaceFlinger::init() {
             ALOGW("Can't set SCHED_OTHER for primeCache");
         }
     }
+    // A threaded RenderEngine primes its cache in the background, so this only times the launch.
+    startupTimer.endPhase("primeCache");
 
     getRenderEngine().onPrimaryDisplaySizeChanged(display->getSize());
 
@@ -1180,6 +1289,9 @@ void SurfaceFlinger::init() {
 #endif
 
     startUnifiedDraw();
+
+    mStartupTimings = startupTimer.finish();
+    ALOGI("Startup: %s", mStartupTimings.c_str());
     ALOGV("Done initializing");
 }
 
@@ -2067,7 +2179,7 @@ status_t SurfaceFlinger::getLayerDebugInfo(std::vector<LayerDebugInfo>* outLayer
     outLayers->clear();
     schedule([=] {
         const auto display = ON_MAIN_THREAD(getDefaultDisplayDeviceLocked());
-        mDrawingState.traverseInZOrder([&](Layer* layer) {
+        traverseDrawingLayersInZOrder([&](Layer* layer) {
             outLayers->push_back(layer->getLayerDebugInfo(display.get()));
         });
     }).wait();
@@ -2676,6 +2788,8 @@ void SurfaceFlinger::onMessageInvalidate(int64_t vsyncId, nsecs_t expectedVSyncT
         }
     }
 
+    finishScreenCaptures();
+
     bool refreshNeeded;
     {
         mTracePostComposition = mTracing.flagIsSet(SurfaceTracing::TRACE_COMPOSITION) ||
@@ -2768,7 +2882,7 @@ void SurfaceFlinger::onMessageRefresh() {
     for (const auto& [_, display] : displays) {
         refreshArgs.outputs.push_back(display->getCompositionDisplay());
     }
-    mDrawingState.traverseInZOrder([&refreshArgs](Layer* layer) {
+    traverseDrawingLayersInZOrder([&refreshArgs](Layer* layer) {
         if (auto layerFE = layer->getCompositionEngineLayerFE())
             refreshArgs.layers.push_back(layerFE);
     });
@@ -2788,6 +2902,8 @@ void SurfaceFlinger::onMessageRefresh() {
     refreshArgs.updatingOutputGeometryThisFrame = mVisibleRegionsDirty;
     refreshArgs.updatingGeometryThisFrame = mGeometryInvalid || mVisibleRegionsDirty;
     refreshArgs.blursAreExpensive = mBlursAreExpensive;
+    refreshArgs.presentOutputsInParallel = mPresentOutputsInParallel;
+    refreshArgs.publishLayerSnapshots = mPublishLayerSnapshots;
     refreshArgs.internalDisplayRotationFlags = DisplayDevice::getPrimaryDisplayRotationFlags();
 
     if (CC_UNLIKELY(mDrawingState.colorMatrixChanged)) {
@@ -2821,7 +2937,11 @@ void SurfaceFlinger::onMessageRefresh() {
       }
     }
     mCompositionEngine->present(refreshArgs);
-    mTimeStats->recordFrameDuration(mFrameStartTime, systemTime());
+    const nsecs_t frameEnd = systemTime();
+    mTimeStats->recordFrameDuration(mFrameStartTime, frameEnd);
+    if (mUsePowerHintSession && mFrameStartTime > 0) {
+        mPowerAdvisor.sendActualWorkDuration(frameEnd - mFrameStartTime, frameEnd);
+    }
     // Reset the frame start time now that we've recorded this frame.
     mFrameStartTime = 0;
     mScheduler->onDisplayRefreshed(presentTime);
@@ -2982,6 +3102,37 @@ void SurfaceFlinger::updateCompositorTiming(const DisplayStatInfo& stats, nsecs_
     setCompositorTimingSnapped(stats, compositeToPresentLatency);
 }
 
+void SurfaceFlinger::trackClientCompositionCost() {
+    for (const auto& [_, display] : ON_MAIN_THREAD(mDisplays)) {
+        const auto compositionDisplay = display->getCompositionDisplay();
+        const auto& state = compositionDisplay->getState();
+        if (!state.usesClientComposition || state.reusedClientComposition ||
+            state.clientCompositionStartTime == 0) {
+            continue;
+        }
+
+        std::vector<LayerCostTracker::ClientCompositionLayer> layers;
+        mDrawingState.traverse([&](Layer* layer) {
+            const auto* outputLayer = layer->findOutputLayerForDisplay(display.get());
+            if (!outputLayer || !outputLayer->requiresClientComposition()) return;
+
+            int64_t area = 0;
+            for (const Rect& rect : outputLayer->getState().visibleRegion) {
+                area += static_cast<int64_t>(rect.getWidth()) * rect.getHeight();
+            }
+            if (area > 0) {
+                layers.push_back({layer->getSequence(), layer->getOwnerUid(), layer->getName(),
+                                  area});
+            }
+        });
+
+        const auto doneFence = std::make_shared<FenceTime>(
+                compositionDisplay->getRenderSurface()->getClientTargetAcquireFence());
+        mLayerCostTracker.addClientComposition(state.clientCompositionStartTime, doneFence,
+                                               std::move(layers));
+    }
+}
+
 void SurfaceFlinger::setCompositorTimingSnapped(const DisplayStatInfo& stats,
                                                 nsecs_t compositeToPresentLatency) {
     // Integer division and modulo round toward 0 not -inf, so we need to
@@ -3052,6 +3203,15 @@ void SurfaceFlinger::postComposition() {
     // to clients, so they get jank classification as early as possible.
     mFrameTimeline->setSfPresent(/* sfPresentTime */ now, mPreviousPresentFences[0].fenceTime,
                                  glCompositionDoneFenceTime);
+    // Empty unless GPU timing is enabled in RenderEngine.
+    for (const auto& [drawStartTime, duration] : getRenderEngine().takeGpuDurations()) {
+        mFrameTimeline->setGpuDuration(drawStartTime, duration);
+    }
+
+    if (mLayerCostTracker.isEnabled()) {
+        trackClientCompositionCost();
+        mLayerCostTracker.onFrameEnd();
+    }
 
     const DisplayStatInfo stats = mScheduler->getDisplayStatInfo(now);
 
@@ -3078,11 +3238,12 @@ void SurfaceFlinger::postComposition() {
 
     std::vector<std::pair<std::shared_ptr<compositionengine::Display>, sp<HdrLayerInfoReporter>>>
             hdrInfoListeners;
+    std::vector<FpsReporter::FpsReport> fpsReports;
     bool haveNewListeners = false;
     {
         Mutex::Autolock lock(mStateLock);
         if (mFpsReporter) {
-            mFpsReporter->dispatchLayerFps();
+            fpsReports = mFpsReporter->computeLayerFps();
         }
 
         if (mTunnelModeEnabledReporter) {
@@ -3100,34 +3261,35 @@ void SurfaceFlinger::postComposition() {
         mAddingHDRLayerInfoListener = false;
     }
 
+    // The listeners are oneway, but each of them is still a binder transaction, so they are
+    // sent once the state lock is released.
+    FpsReporter::sendLayerFps(fpsReports);
+
     if (haveNewListeners || mSomeDataspaceChanged || mVisibleRegionsWereDirtyThisFrame) {
         for (auto& [compositionDisplay, listener] : hdrInfoListeners) {
+            // The output layers of the display are the visible layers that were just composited
+            // on it, so there is no need to look for them in the whole layer tree.
             HdrLayerInfoReporter::HdrLayerInfo info;
             int32_t maxArea = 0;
-            mDrawingState.traverse([&, compositionDisplay = compositionDisplay](Layer* layer) {
-                const auto layerFe = layer->getCompositionEngineLayerFE();
-                if (layer->isVisible() && compositionDisplay->belongsInOutput(layerFe)) {
-                    const Dataspace transfer =
-                        static_cast<Dataspace>(layer->getDataSpace() & Dataspace::TRANSFER_MASK);
-                    const bool isHdr = (transfer == Dataspace::TRANSFER_ST2084 ||
-                                        transfer == Dataspace::TRANSFER_HLG);
-
-                    if (isHdr) {
-                        const auto* outputLayer =
-                            compositionDisplay->getOutputLayerForLayer(layerFe);
-                        if (outputLayer) {
-                            info.numberOfHdrLayers++;
-                            const auto displayFrame = outputLayer->getState().displayFrame;
-                            const int32_t area = displayFrame.width() * displayFrame.height();
-                            if (area > maxArea) {
-                                maxArea = area;
-                                info.maxW = displayFrame.width();
-                                info.maxH = displayFrame.height();
-                            }
-                        }
-                    }
+            for (const auto* outputLayer : compositionDisplay->getOutputLayersOrderedByZ()) {
+                const auto* layerFEState = outputLayer->getLayerFE().getCompositionState();
+                if (!layerFEState) {
+                    continue;
                 }
-            });
+                const Dataspace transfer =
+                        static_cast<Dataspace>(layerFEState->dataspace & Dataspace::TRANSFER_MASK);
+                if (transfer != Dataspace::TRANSFER_ST2084 && transfer != Dataspace::TRANSFER_HLG) {
+                    continue;
+                }
+                info.numberOfHdrLayers++;
+                const auto displayFrame = outputLayer->getState().displayFrame;
+                const int32_t area = displayFrame.width() * displayFrame.height();
+                if (area > maxArea) {
+                    maxArea = area;
+                    info.maxW = displayFrame.width();
+                    info.maxH = displayFrame.height();
+                }
+            }
             listener->dispatchHdrLayerInfo(info);
         }
     }
@@ -3170,6 +3332,7 @@ void SurfaceFlinger::postComposition() {
     dumpDrawCycle(false);
 
     mTimeStats->incrementTotalFrames();
+    mCompositedFrameCount++;
     if (mHadClientComposition) {
         mTimeStats->incrementClientCompositionFrames();
     }
@@ -3742,6 +3905,7 @@ void SurfaceFlinger::processDisplayAdded(const wp<IBinder>& displayToken,
     builder.setDisplayExtnIntf(mDisplayExtnIntf);
     auto compositionDisplay = getCompositionEngine().createDisplay(builder.build());
     compositionDisplay->setLayerCachingEnabled(mLayerCachingEnabled);
+    compositionDisplay->setCompositionStrategyPredictionEnabled(mPredictCompositionStrategy);
 
     sp<compositionengine::DisplaySurface> displaySurface;
     sp<IGraphicBufferProducer> producer;
@@ -4171,7 +4335,7 @@ bool enablePerWindowInputRotation() {
 void SurfaceFlinger::updateInputWindowInfo() {
     std::vector<InputWindowInfo> inputInfos;
 
-    mDrawingState.traverseInReverseZOrder([&](Layer* layer) {
+    traverseDrawingLayersInReverseZOrder([&](Layer* layer) {
         if (!layer->needsInputInfo()) return;
         sp<DisplayDevice> display;
         if (enablePerWindowInputRotation()) {
@@ -4190,9 +4354,45 @@ void SurfaceFlinger::updateInputWindowInfo() {
         inputInfos.push_back(layer->fillInputInfo(display));
     });
 
-    mInputFlinger->setInputWindows(inputInfos,
-                               mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener
-                                                                     : nullptr);
+    const sp<os::ISetInputWindowsListener> listener =
+            mInputWindowCommands.syncInputWindows ? mSetInputWindowsListener : nullptr;
+    std::vector<int32_t> windowIds;
+    windowIds.reserve(inputInfos.size());
+    std::unordered_map<int32_t, InputWindowInfo> infosById;
+    bool hasUniqueIds = true;
+    for (const InputWindowInfo& info : inputInfos) {
+        windowIds.push_back(info.id);
+        hasUniqueIds &= infosById.emplace(info.id, info).second;
+    }
+
+    // Once InputFlinger has the windows, only send the ones that changed. Windows are told apart
+    // by their id, as their tokens may be shared or missing.
+    if (!mInputWindowInfosSent || !hasUniqueIds) {
+        mInputFlinger->setInputWindows(inputInfos, listener);
+    } else {
+        InputWindowsDelta delta;
+        for (const InputWindowInfo& info : inputInfos) {
+            const auto lastIt = mLastInputWindowInfos.find(info.id);
+            const Flags<InputWindowInfo::Change> changes = lastIt == mLastInputWindowInfos.end()
+                    ? Flags<InputWindowInfo::Change>(InputWindowInfo::Change::GEOMETRY) |
+                            InputWindowInfo::Change::STATE | InputWindowInfo::Change::FOCUS
+                    : info.getChanges(lastIt->second);
+            if (changes.get() != 0) {
+                delta.changedWindows.push_back(info);
+                delta.changes.push_back(static_cast<int32_t>(changes.get()));
+            }
+        }
+        if (!delta.changedWindows.empty() || windowIds != mLastInputWindowIds) {
+            delta.windowIds = windowIds;
+            mInputFlinger->updateInputWindows(delta, listener);
+        } else if (listener) {
+            // Nothing changed for InputFlinger to apply.
+            setInputWindowsFinished();
+        }
+    }
+    mInputWindowInfosSent = hasUniqueIds;
+    mLastInputWindowIds = std::move(windowIds);
+    mLastInputWindowInfos = std::move(infosById);
 }
 
 void SurfaceFlinger::updateCursorAsync() {
@@ -4303,6 +4503,10 @@ void SurfaceFlinger::setVsyncConfig(const VsyncModulator::VsyncConfig& config,
                             /*workDuration=*/std::chrono::nanoseconds(vsyncPeriod),
                             /*readyDuration=*/config.sfWorkDuration);
     mEventQueue->setDuration(config.sfWorkDuration);
+    if (mUsePowerHintSession) {
+        // The frame is due sfWorkDuration after the main thread wakes up for it.
+        mPowerAdvisor.setTargetWorkDuration(config.sfWorkDuration.count());
+    }
 }
 
 void SurfaceFlinger::commitTransaction() {
@@ -4337,6 +4541,17 @@ void SurfaceFlinger::commitTransactionLocked() {
     // we composite should be considered an animation as well.
     mAnimCompositionPending = mAnimTransactionPending;
 
+    // The Z order of the drawing state only changes along with its visible regions, when the top
+    // level layers are reordered, e.g. on a layer stack change, or when clones mirror again.
+    const auto& drawingLayers = mDrawingState.layersSortedByZ;
+    const auto& currentLayers = mCurrentState.layersSortedByZ;
+    if (mVisibleRegionsDirty || mNumClones > 0 ||
+        !std::equal(drawingLayers.begin(), drawingLayers.end(), currentLayers.begin(),
+                    currentLayers.end())) {
+        mDrawingLayerZOrderValid = false;
+        mDrawingLayersInZOrder.clear();
+    }
+
     mDrawingState = mCurrentState;
     // clear the "changed" flags in current state
     mCurrentState.colorMatrixChanged = false;
@@ -4440,10 +4655,18 @@ bool SurfaceFlinger::handlePageFlip() {
         // writes to Layer current state. See also b/119481871
         Mutex::Autolock lock(mStateLock);
 
+        const bool trackLayerCost = mLayerCostTracker.isEnabled();
         for (const auto& layer : mLayersWithQueuedFrames) {
+            const nsecs_t latchStart = trackLayerCost ? systemTime() : 0;
             if (layer->latchBuffer(visibleRegions, latchTime, expectedPresentTime)) {
                 mLayersPendingRefresh.push_back(layer);
             }
+            if (trackLayerCost) {
+                mLayerCostTracker.addCpuTime(layer->getSequence(), layer->getOwnerUid(),
+                                             layer->getName(),
+                                             LayerCostTracker::CpuStage::Latch,
+                                             systemTime() - latchStart);
+            }
             layer->useSurfaceDamage();
             if (layer->isBufferLatched()) {
                 newDataLatched = true;
@@ -4568,7 +4791,14 @@ void SurfaceFlinger::flushTransactionQueues() {
             // Collect transactions from pending transaction queue.
             auto it = mPendingTransactionQueues.begin();
             while (it != mPendingTransactionQueues.end()) {
-                auto& [applyToken, transactionQueue] = *it;
+                auto& [applyToken, pendingQueue] = *it;
+                auto& transactionQueue = pendingQueue.transactions;
+
+                // The front transaction is re-evaluated once its fence signals.
+                if (pendingQueue.blockingFence) {
+                    it = std::next(it, 1);
+                    continue;
+                }
 
                 while (!transactionQueue.empty()) {
                     auto& transaction = transactionQueue.front();
@@ -4576,8 +4806,14 @@ void SurfaceFlinger::flushTransactionQueues() {
                                                        transaction.isAutoTimestamp,
                                                        transaction.desiredPresentTime,
                                                        transaction.originUid, transaction.states,
-                                                       bufferLayersReadyToPresent)) {
-                        setTransactionFlags(eTransactionFlushNeeded);
+                                                       transaction.resolvedStates,
+                                                       bufferLayersReadyToPresent,
+                                                       &pendingQueue.blockingFence)) {
+                        if (pendingQueue.blockingFence) {
+                            waitForBlockingFence(applyToken, pendingQueue.blockingFence);
+                        } else {
+                            setTransactionFlags(eTransactionFlushNeeded);
+                        }
                         break;
                     }
                     transaction.traverseStatesWithBuffers([&](const layer_state_t& state) {
@@ -4599,48 +4835,77 @@ void SurfaceFlinger::flushTransactionQueues() {
             // Case 1: push to pending when transactionIsReadyToBeApplied is false.
             // Case 2: push to pending when there exist a pending queue.
             // Case 3: others are ready to apply.
-            while (!mTransactionQueue.empty()) {
-                auto& transaction = mTransactionQueue.front();
-                bool pendingTransactions = mPendingTransactionQueues.find(transaction.applyToken) !=
+            while (auto transaction = mTransactionQueue.try_pop()) {
+                bool pendingTransactions = mPendingTransactionQueues.find(transaction->applyToken) !=
                         mPendingTransactionQueues.end();
+                sp<Fence> blockingFence;
                 if (pendingTransactions ||
-                    !transactionIsReadyToBeApplied(transaction.frameTimelineInfo,
-                                                   transaction.isAutoTimestamp,
-                                                   transaction.desiredPresentTime,
-                                                   transaction.originUid, transaction.states,
-                                                   bufferLayersReadyToPresent)) {
-                    mPendingTransactionQueues[transaction.applyToken].push(std::move(transaction));
+                    !transactionIsReadyToBeApplied(transaction->frameTimelineInfo,
+                                                   transaction->isAutoTimestamp,
+                                                   transaction->desiredPresentTime,
+                                                   transaction->originUid, transaction->states,
+                                                   transaction->resolvedStates,
+                                                   bufferLayersReadyToPresent, &blockingFence)) {
+                    auto& pendingQueue = mPendingTransactionQueues[transaction->applyToken];
+                    if (blockingFence) {
+                        pendingQueue.blockingFence = blockingFence;
+                        waitForBlockingFence(transaction->applyToken, blockingFence);
+                    }
+                    pendingQueue.transactions.push(std::move(*transaction));
                 } else {
-                    transaction.traverseStatesWithBuffers([&](const layer_state_t& state) {
+                    transaction->traverseStatesWithBuffers([&](const layer_state_t& state) {
                         bufferLayersReadyToPresent.insert(state.surface);
                     });
-                    transactions.emplace_back(std::move(transaction));
+                    transactions.emplace_back(std::move(*transaction));
                 }
-                mTransactionQueue.pop();
-                ATRACE_INT("TransactionQueue", mTransactionQueue.size());
             }
+            ATRACE_INT("TransactionQueue", mTransactionQueue.size());
         }
 
         // Now apply all transactions.
         for (const auto& transaction : transactions) {
             applyTransactionState(transaction.frameTimelineInfo, transaction.states,
-                                  transaction.displays, transaction.flags,
-                                  transaction.inputWindowCommands, transaction.desiredPresentTime,
-                                  transaction.isAutoTimestamp, transaction.buffer,
-                                  transaction.postTime, transaction.permissions,
-                                  transaction.hasListenerCallbacks, transaction.listenerCallbacks,
-                                  transaction.originPid, transaction.originUid, transaction.id);
+                                  transaction.resolvedStates, transaction.displays,
+                                  transaction.flags, transaction.inputWindowCommands,
+                                  transaction.desiredPresentTime, transaction.isAutoTimestamp,
+                                  transaction.buffer, transaction.postTime,
+                                  transaction.permissions, transaction.hasListenerCallbacks,
+                                  transaction.listenerCallbacks, transaction.originPid,
+                                  transaction.originUid, transaction.id);
             if (transaction.transactionCommittedSignal) {
                 mTransactionCommittedSignals.emplace_back(
                         std::move(transaction.transactionCommittedSignal));
             }
         }
+        // Buffers dropped by the transactions above are released together, one callback per
+        // listener.
+        mTransactionCallbackInvoker.sendReleaseCallbacks();
     }
 }
 
 bool SurfaceFlinger::transactionFlushNeeded() {
+    if (!mTransactionQueue.empty()) {
+        return true;
+    }
+
+    // Queues held back by a fence are flushed when it signals, rather than polled every frame.
     Mutex::Autolock _l(mQueueLock);
-    return !mPendingTransactionQueues.empty() || !mTransactionQueue.empty();
+    return std::any_of(mPendingTransactionQueues.begin(), mPendingTransactionQueues.end(),
+                       [](const auto& pair) { return !pair.second.blockingFence; });
+}
+
+void SurfaceFlinger::waitForBlockingFence(const sp<IBinder>& applyToken, const sp<Fence>& fence) {
+    mEventQueue->waitForFence(fence, [this, applyToken, fence] {
+        {
+            Mutex::Autolock _l(mQueueLock);
+            const auto it = mPendingTransactionQueues.find(applyToken);
+            if (it == mPendingTransactionQueues.end() || it->second.blockingFence != fence) {
+                return;
+            }
+            it->second.blockingFence = nullptr;
+        }
+        setTransactionFlags(eTransactionFlushNeeded);
+    });
 }
 
 bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId) const {
@@ -4668,8 +4933,10 @@ bool SurfaceFlinger::frameIsEarly(nsecs_t expectedPresentTime, int64_t vsyncId)
 bool SurfaceFlinger::transactionIsReadyToBeApplied(
         const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
         uid_t originUid, const Vector<ComposerState>& states,
+        const std::vector<ResolvedComposerState>& resolvedStates,
         const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
-                bufferLayersReadyToPresent) const {
+                bufferLayersReadyToPresent,
+        sp<Fence>* outBlockingFence) const {
     ATRACE_CALL();
     const nsecs_t expectedPresentTime = mExpectedPresentTime.load();
     // Do not present if the desiredPresentTime has not passed unless it is more than one second
@@ -4692,18 +4959,22 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(
         return false;
     }
 
-    for (const ComposerState& state : states) {
-        const layer_state_t& s = state.state;
+    const bool resolved = resolvedStates.size() == states.size();
+    for (size_t i = 0; i < states.size(); i++) {
+        const layer_state_t& s = states[i].state;
         const bool acquireFenceChanged = (s.what & layer_state_t::eAcquireFenceChanged);
         if (acquireFenceChanged && s.acquireFence && !enableLatchUnsignaled &&
             s.acquireFence->getStatus() == Fence::Status::Unsignaled) {
             ATRACE_NAME("fence unsignaled");
+            if (outBlockingFence) {
+                *outBlockingFence = s.acquireFence;
+            }
             return false;
         }
 
         sp<Layer> layer = nullptr;
         if (s.surface) {
-            layer = fromHandle(s.surface).promote();
+            layer = resolved ? resolvedStates[i].layer.promote() : fromHandle(s.surface).promote();
         } else if (s.hasBufferChanges()) {
             ALOGW("Transaction with buffer, but no Layer?");
             continue;
@@ -4744,14 +5015,54 @@ bool SurfaceFlinger::transactionIsReadyToBeApplied(
     return true;
 }
 
-void SurfaceFlinger::queueTransaction(TransactionState& state) {
-    Mutex::Autolock _l(mQueueLock);
+void SurfaceFlinger::resolveTransactionState(TransactionState& transaction) const {
+    ATRACE_CALL();
+    const bool privileged = transaction.permissions & Permission::ACCESS_SURFACE_FLINGER;
+
+    transaction.resolvedStates.reserve(transaction.states.size());
+    for (const ComposerState& state : transaction.states) {
+        const layer_state_t& s = state.state;
+        ResolvedComposerState& resolved = transaction.resolvedStates.emplace_back();
+        resolved.layer = fromHandle(s.surface);
+        resolved.what = s.what;
+
+        if (!privileged) {
+            if (resolved.what & layer_state_t::eInputInfoChanged) {
+                ALOGE("Attempt to update InputWindowInfo without permission ACCESS_SURFACE_FLINGER");
+            }
+            if (resolved.what & layer_state_t::eTrustedOverlayChanged) {
+                ALOGE("Attempt to set trusted overlay without permission ACCESS_SURFACE_FLINGER");
+            }
+            resolved.what &= ~(layer_state_t::eInputInfoChanged |
+                               layer_state_t::eTrustedOverlayChanged |
+                               layer_state_t::eFrameRateSelectionPriority);
+        }
+
+        if ((resolved.what & layer_state_t::eFrameRateChanged) &&
+            !ValidateFrameRate(s.frameRate, s.frameRateCompatibility, s.changeFrameRateStrategy,
+                               "SurfaceFlinger::resolveTransactionState", privileged)) {
+            resolved.what &= ~layer_state_t::eFrameRateChanged;
+        }
+
+        // A threaded RenderEngine serializes imports on its own thread. The cache is left for the
+        // main thread to update in order, along with the uncaching of buffers.
+        if (mImportBuffersOnBinderThreads && (s.what & layer_state_t::eBufferChanged) &&
+            s.buffer != nullptr) {
+            resolved.buffer = std::make_shared<
+                    renderengine::ExternalTexture>(s.buffer, getRenderEngine(),
+                                                   renderengine::ExternalTexture::Usage::READABLE);
+        }
+    }
+}
 
-    // If its TransactionQueue already has a pending TransactionState or if it is pending
-    auto itr = mPendingTransactionQueues.find(state.applyToken);
+void SurfaceFlinger::queueTransaction(TransactionState& state) {
     // if this is an animation frame, wait until prior animation frame has
     // been applied by SF
     if (state.flags & eAnimation) {
+        Mutex::Autolock _l(mQueueLock);
+
+        // If its TransactionQueue already has a pending TransactionState or if it is pending
+        auto itr = mPendingTransactionQueues.find(state.applyToken);
         while (itr != mPendingTransactionQueues.end()) {
             status_t err = mTransactionQueueCV.waitRelative(mQueueLock, s2ns(5));
             if (CC_UNLIKELY(err != NO_ERROR)) {
@@ -4772,7 +5083,7 @@ void SurfaceFlinger::queueTransaction(TransactionState& state) {
                          : CountDownLatch::eSyncTransaction));
     }
 
-    mTransactionQueue.emplace(state);
+    mTransactionQueue.push(state);
     ATRACE_INT("TransactionQueue", mTransactionQueue.size());
 
     const auto schedule = [](uint32_t flags) {
@@ -4845,6 +5156,7 @@ status_t SurfaceFlinger::setTransactionState(
                            permissions,        hasListenerCallbacks,
                            listenerCallbacks,  originPid,
                            originUid,          transactionId};
+    resolveTransactionState(state);
 
     // Check for incoming buffer updates and increment the pending buffer count.
     state.traverseStatesWithBuffers([&](const layer_state_t& state) {
@@ -4901,6 +5213,7 @@ status_t SurfaceFlinger::setTransactionState(
 
 void SurfaceFlinger::applyTransactionState(const FrameTimelineInfo& frameTimelineInfo,
                                            const Vector<ComposerState>& states,
+                                           const std::vector<ResolvedComposerState>& resolvedStates,
                                            const Vector<DisplayState>& displays, uint32_t flags,
                                            const InputWindowCommands& inputWindowCommands,
                                            const int64_t desiredPresentTime, bool isAutoTimestamp,
@@ -4924,12 +5237,18 @@ void SurfaceFlinger::applyTransactionState(const FrameTimelineInfo& frameTimelin
 
     std::unordered_set<ListenerCallbacks, ListenerCallbacksHash> listenerCallbacksWithSurfaces;
     uint32_t clientStateFlags = 0;
-    for (const ComposerState& state : states) {
+    const bool resolved = resolvedStates.size() == states.size();
+    for (size_t i = 0; i < states.size(); i++) {
+        const ComposerState& state = states[i];
+        const ResolvedComposerState* resolvedState = resolved ? &resolvedStates[i] : nullptr;
         clientStateFlags |=
-                setClientStateLocked(frameTimelineInfo, state, desiredPresentTime, isAutoTimestamp,
-                                     postTime, permissions, listenerCallbacksWithSurfaces);
+                setClientStateLocked(frameTimelineInfo, state, resolvedState, desiredPresentTime,
+                                     isAutoTimestamp, postTime, permissions,
+                                     listenerCallbacksWithSurfaces);
         if ((flags & eAnimation) && state.state.surface) {
-            if (const auto layer = fromHandle(state.state.surface).promote(); layer) {
+            const auto layer = resolvedState ? resolvedState->layer.promote()
+                                             : fromHandle(state.state.surface).promote();
+            if (layer) {
                 mScheduler->recordLayerHistory(layer.get(),
                                                isAutoTimestamp ? 0 : desiredPresentTime,
                                                LayerHistory::LayerUpdateType::AnimationTX);
@@ -5093,7 +5412,8 @@ bool SurfaceFlinger::callingThreadHasUnscopedSurfaceFlingerAccess(bool usePermis
 
 uint32_t SurfaceFlinger::setClientStateLocked(
         const FrameTimelineInfo& frameTimelineInfo, const ComposerState& composerState,
-        int64_t desiredPresentTime, bool isAutoTimestamp, int64_t postTime, uint32_t permissions,
+        const ResolvedComposerState* resolvedState, int64_t desiredPresentTime,
+        bool isAutoTimestamp, int64_t postTime, uint32_t permissions,
         std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& outListenerCallbacks) {
     const layer_state_t& s = composerState.state;
     const bool privileged = permissions & Permission::ACCESS_SURFACE_FLINGER;
@@ -5120,7 +5440,7 @@ uint32_t SurfaceFlinger::setClientStateLocked(
         }
     }
 
-    const uint64_t what = s.what;
+    const uint64_t what = resolvedState ? resolvedState->what : s.what;
     uint32_t flags = 0;
     sp<Layer> layer = nullptr;
     if (s.surface) {
@@ -5130,6 +5450,8 @@ uint32_t SurfaceFlinger::setClientStateLocked(
                 flags |= eTransactionNeeded | eTraversalNeeded;
                 mLayersAdded = true;
             }
+        } else if (resolvedState) {
+            layer = resolvedState->layer.promote();
         } else {
             layer = fromHandle(s.surface).promote();
         }
@@ -5341,7 +5663,9 @@ uint32_t SurfaceFlinger::setClientStateLocked(
         }
     }
     if (what & layer_state_t::eFrameRateChanged) {
-        if (ValidateFrameRate(s.frameRate, s.frameRateCompatibility, s.changeFrameRateStrategy,
+        // Resolved states only keep the change if it is valid.
+        if (resolvedState ||
+            ValidateFrameRate(s.frameRate, s.frameRateCompatibility, s.changeFrameRateStrategy,
                               "SurfaceFlinger::setClientStateLocked", privileged)) {
             const auto compatibility =
                     Layer::FrameRate::convertCompatibility(s.frameRateCompatibility);
@@ -5410,16 +5734,26 @@ uint32_t SurfaceFlinger::setClientStateLocked(
     }
     bool bufferChanged = what & layer_state_t::eBufferChanged;
     bool cacheIdChanged = what & layer_state_t::eCachedBufferChanged;
+    // The cache is only updated here, so that lookups see the buffers cached by prior transactions.
+    const std::shared_ptr<renderengine::ExternalTexture> importedBuffer =
+            resolvedState ? resolvedState->buffer : nullptr;
     std::shared_ptr<renderengine::ExternalTexture> buffer;
     if (bufferChanged && cacheIdChanged && s.buffer != nullptr) {
-        ClientCache::getInstance().add(s.cachedBuffer, s.buffer);
+        if (importedBuffer) {
+            ClientCache::getInstance().add(s.cachedBuffer, importedBuffer);
+        } else {
+            ClientCache::getInstance().add(s.cachedBuffer, s.buffer);
+        }
         buffer = ClientCache::getInstance().get(s.cachedBuffer);
     } else if (cacheIdChanged) {
         buffer = ClientCache::getInstance().get(s.cachedBuffer);
     } else if (bufferChanged && s.buffer != nullptr) {
-        buffer = std::make_shared<
-                renderengine::ExternalTexture>(s.buffer, getRenderEngine(),
-                                               renderengine::ExternalTexture::Usage::READABLE);
+        buffer = importedBuffer;
+        if (!buffer) {
+            buffer = std::make_shared<
+                    renderengine::ExternalTexture>(s.buffer, getRenderEngine(),
+                                                   renderengine::ExternalTexture::Usage::READABLE);
+        }
     }
     if (buffer) {
         const bool frameNumberChanged = what & layer_state_t::eFrameNumberChanged;
@@ -5727,7 +6061,7 @@ void SurfaceFlinger::onInitializeDisplays() {
 
     nsecs_t now = systemTime();
     // It should be on the main thread, apply it directly.
-    applyTransactionState(FrameTimelineInfo{}, state, displays, 0, mInputWindowCommands,
+    applyTransactionState(FrameTimelineInfo{}, state, {}, displays, 0, mInputWindowCommands,
                           /* desiredPresentTime */ now, true, {}, /* postTime */ now, true, false,
                           {}, getpid(), getuid(), 0 /* Undefined transactionId */);
 
@@ -5812,6 +6146,10 @@ void SurfaceFlinger::setPowerModeInternal(const sp<DisplayDevice>& display, hal:
             }
             // Make sure HWVsync is disabled before turning off the display
             getHwComposer().setVsyncEnabled(displayId, hal::Vsync::DISABLE);
+            if (display->isPrimary()) {
+                // Nothing is sampled while the screen is off, give the memory back.
+                GraphicBufferAllocator::get().trimPool(0);
+            }
         } else {
             updateVsyncSource();
         }
@@ -5980,31 +6318,28 @@ status_t SurfaceFlinger::doDump(int fd, const DumpArgs& args, bool asProto) {
                 {"--vsync"s, dumper(&SurfaceFlinger::dumpVSync)},
                 {"--wide-color"s, dumper(&SurfaceFlinger::dumpWideColorInfo)},
                 {"--frametimeline"s, argsDumper(&SurfaceFlinger::dumpFrameTimeline)},
+                {"--layer-cost"s, argsDumper(&SurfaceFlinger::dumpLayerCost)},
         };
 
         const auto flag = args.empty() ? ""s : std::string(String8(args[0]));
 
         bool dumpLayers = true;
-        {
+        if (const auto it = dumpers.find(flag); it != dumpers.end()) {
             TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
-            if (!lock.locked()) {
-                StringAppendF(&result, "Dumping without lock after timeout: %s (%d)\n",
-                              strerror(-lock.status), lock.status);
-                ALOGW("Dumping without lock after timeout: %s (%d)",
-                              strerror(-lock.status), lock.status);
-            }
-
-            if (const auto it = dumpers.find(flag); it != dumpers.end()) {
-                (it->second)(args, asProto, result);
+            appendDumpLockStatus(lock, result);
+            (it->second)(args, asProto, result);
+            dumpLayers = false;
+        } else if (!asProto) {
+            // selection of mini dumpsys (Format: adb shell dumpsys SurfaceFlinger --mini)
+            if (numArgs && ((args[0] == String16("--mini")))) {
+                TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
+                appendDumpLockStatus(lock, result);
+                dumpMini(result);
                 dumpLayers = false;
-            } else if (!asProto) {
-                // selection of mini dumpsys (Format: adb shell dumpsys SurfaceFlinger --mini)
-                if (numArgs && ((args[0] == String16("--mini")))) {
-                    dumpMini(result);
-                    dumpLayers = false;
-                } else {
-                    dumpAllLocked(args, result);
-                }
+            } else {
+                // The full dump is long, so it is streamed, and only locks the sections that
+                // need mStateLock, leaving the main thread free to compose in between.
+                dumpAll(fd, args);
             }
         }
 
@@ -6197,6 +6532,10 @@ void SurfaceFlinger::dumpFrameTimeline(const DumpArgs& args, std::string& result
     mFrameTimeline->parseArgs(args, result);
 }
 
+void SurfaceFlinger::dumpLayerCost(const DumpArgs& args, std::string& result) {
+    mLayerCostTracker.parseArgs(args, result);
+}
+
 // This should only be called from the main thread.  Otherwise it would need
 // the lock and should use mCurrentState rather than mDrawingState.
 void SurfaceFlinger::logFrameStats() {
@@ -6486,14 +6825,41 @@ void SurfaceFlinger::dumpMini(std::string& result) const {
     getHwComposer().dump(result);
 }
 
+const std::array<SurfaceFlinger::DumpSection, 7> SurfaceFlinger::kDumpSections = {{
+        {&SurfaceFlinger::dumpConfigurationLocked, /*needsStateLock=*/true},
+        {&SurfaceFlinger::dumpFrameStats, /*needsStateLock=*/false},
+        {&SurfaceFlinger::dumpCompositionLocked, /*needsStateLock=*/true},
+        {&SurfaceFlinger::dumpRenderEngineState, /*needsStateLock=*/false},
+        {&SurfaceFlinger::dumpGlobalStateLocked, /*needsStateLock=*/true},
+        {&SurfaceFlinger::dumpHwcLocked, /*needsStateLock=*/true},
+        {&SurfaceFlinger::dumpAllocations, /*needsStateLock=*/false},
+}};
+
 void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) const {
-    const bool colorize = !args.empty() && args[0] == String16("--color");
-    Colorizer colorizer(colorize);
+    for (const auto& section : kDumpSections) {
+        (this->*section.dump)(args, result);
+    }
+}
 
-    // figure out if we're stuck somewhere
-    const nsecs_t now = systemTime();
-    const nsecs_t inTransaction(mDebugInTransaction);
-    nsecs_t inTransactionDuration = (inTransaction) ? now-inTransaction : 0;
+void SurfaceFlinger::dumpAll(int fd, const DumpArgs& args) {
+    std::string result;
+    for (const auto& section : kDumpSections) {
+        if (section.needsStateLock) {
+            TimedLock lock(mStateLock, s2ns(1), __FUNCTION__);
+            appendDumpLockStatus(lock, result);
+            (this->*section.dump)(args, result);
+        } else {
+            (this->*section.dump)(args, result);
+        }
+
+        // Write out each section once done, rather than the whole dump at the end.
+        write(fd, result.c_str(), result.size());
+        result.clear();
+    }
+}
+
+void SurfaceFlinger::dumpConfigurationLocked(const DumpArgs& args, std::string& result) const {
+    Colorizer colorizer(isColorizedDump(args));
 
     /*
      * Dump library configuration.
@@ -6504,6 +6870,7 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     colorizer.reset(result);
     appendSfConfigString(result);
     result.append("\n");
+    StringAppendF(&result, "Startup: %s\n", mStartupTimings.c_str());
 
     result.append("\nDisplay identification data:\n");
     dumpDisplayIdentificationData(result);
@@ -6522,7 +6889,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     colorizer.reset(result);
     dumpVSync(result);
     result.append("\n");
+}
 
+void SurfaceFlinger::dumpFrameStats(const DumpArgs&, std::string& result) const {
     dumpStaticScreenStats(result);
     result.append("\n");
 
@@ -6530,7 +6899,23 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     StringAppendF(&result, "HWC missed frame count: %u\n", mHwcFrameMissedCount.load());
     StringAppendF(&result, "GPU missed frame count: %u\n\n", mGpuFrameMissedCount.load());
 
+    const Fence::SyscallCounts fenceCounts = Fence::getSyscallCounts();
+    const uint32_t frameCount = std::max(mCompositedFrameCount.load(), 1u);
+    StringAppendF(&result,
+                  "Fence syscalls: %" PRIu64 " (%.1f per frame): %" PRIu64 " waits, %" PRIu64
+                  " merges, %" PRIu64 " signal time queries, %" PRIu64 " polls\n\n",
+                  fenceCounts.total(), static_cast<double>(fenceCounts.total()) / frameCount,
+                  fenceCounts.waits, fenceCounts.merges, fenceCounts.signalTimeQueries,
+                  fenceCounts.polls);
+
+    mTransactionCallbackInvoker.dump(result);
+    result.append("\n");
+
     dumpBufferingStats(result);
+}
+
+void SurfaceFlinger::dumpCompositionLocked(const DumpArgs& args, std::string& result) const {
+    Colorizer colorizer(isColorizedDump(args));
 
     /*
      * Dump the visible layer list
@@ -6571,6 +6956,10 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
      */
 
     mCompositionEngine->dump(result);
+}
+
+void SurfaceFlinger::dumpRenderEngineState(const DumpArgs& args, std::string& result) const {
+    Colorizer colorizer(isColorizedDump(args));
 
     /*
      * Dump SurfaceFlinger global state
@@ -6585,6 +6974,13 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     result.append("ClientCache state:\n");
     ClientCache::getInstance().dump(result);
     DebugEGLImageTracker::getInstance()->dump(result);
+}
+
+void SurfaceFlinger::dumpGlobalStateLocked(const DumpArgs&, std::string& result) const {
+    // figure out if we're stuck somewhere
+    const nsecs_t now = systemTime();
+    const nsecs_t inTransaction(mDebugInTransaction);
+    nsecs_t inTransactionDuration = (inTransaction) ? now-inTransaction : 0;
 
     if (const auto display = getDefaultDisplayDeviceLocked()) {
         display->getCompositionDisplay()->getState().undefinedRegion.dump(result,
@@ -6622,6 +7018,10 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
      */
     mTracing.dump(result);
     result.append("\n");
+}
+
+void SurfaceFlinger::dumpHwcLocked(const DumpArgs& args, std::string& result) const {
+    Colorizer colorizer(isColorizedDump(args));
 
     /*
      * HWC layer minidump
@@ -6656,7 +7056,9 @@ void SurfaceFlinger::dumpAllLocked(const DumpArgs& args, std::string& result) co
     bool hwcDisabled = mDebugDisableHWC || mDebugRegion;
     StringAppendF(&result, "  h/w composer %s\n", hwcDisabled ? "disabled" : "enabled");
     getHwComposer().dump(result);
+}
 
+void SurfaceFlinger::dumpAllocations(const DumpArgs&, std::string& result) const {
     /*
      * Dump gralloc state
      */
@@ -7894,17 +8296,22 @@ status_t SurfaceFlinger::captureScreenCommon(RenderAreaFuture renderAreaFuture,
             (hasProtectedLayer && allowProtected && supportsProtected
                      ? GRALLOC_USAGE_PROTECTED
                      : GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN);
-    sp<GraphicBuffer> buffer =
-            getFactory().createGraphicBuffer(bufferSize.getWidth(), bufferSize.getHeight(),
-                                             static_cast<android_pixel_format>(reqPixelFormat),
-                                             1 /* layerCount */, usage, "screenshot");
-
-    const status_t bufferStatus = buffer->initCheck();
-    LOG_ALWAYS_FATAL_IF(bufferStatus != OK, "captureScreenCommon: Buffer failed to allocate: %d",
-                        bufferStatus);
-    const auto texture = std::make_shared<
-            renderengine::ExternalTexture>(buffer, getRenderEngine(),
-                                           renderengine::ExternalTexture::Usage::WRITEABLE);
+    std::shared_ptr<renderengine::ExternalTexture> texture;
+    if (mScreenCaptureThread) {
+        texture = mScreenCaptureThread->acquireBuffer(bufferSize, reqPixelFormat, usage);
+    } else {
+        sp<GraphicBuffer> buffer =
+                getFactory().createGraphicBuffer(bufferSize.getWidth(), bufferSize.getHeight(),
+                                                 static_cast<android_pixel_format>(reqPixelFormat),
+                                                 1 /* layerCount */, usage, "screenshot");
+
+        const status_t bufferStatus = buffer->initCheck();
+        LOG_ALWAYS_FATAL_IF(bufferStatus != OK,
+                            "captureScreenCommon: Buffer failed to allocate: %d", bufferStatus);
+        texture = std::make_shared<
+                renderengine::ExternalTexture>(buffer, getRenderEngine(),
+                                               renderengine::ExternalTexture::Usage::WRITEABLE);
+    }
     return captureScreenCommon(std::move(renderAreaFuture), traverseLayers, texture,
                                false /* regionSampling */, grayscale, captureListener);
 }
@@ -7938,15 +8345,45 @@ status_t SurfaceFlinger::captureScreenCommon(
             return;
         }
 
+        if (!mScreenCaptureThread) {
+            status_t result = NO_ERROR;
+            renderArea->render([&] {
+                result = renderScreenImplLocked(*renderArea, traverseLayers, buffer,
+                                                canCaptureBlackoutContent, regionSampling,
+                                                grayscale, captureResults);
+            });
+
+            captureResults.result = result;
+            captureListener->onScreenCaptureCompleted(captureResults);
+            return;
+        }
+
+        auto request = std::make_shared<ScreenCaptureRequest>();
         status_t result = NO_ERROR;
         renderArea->render([&] {
-            result = renderScreenImplLocked(*renderArea, traverseLayers, buffer,
-                                            canCaptureBlackoutContent, regionSampling, grayscale,
-                                            captureResults);
+            result = prepareScreenCaptureLocked(*renderArea, traverseLayers, buffer,
+                                                canCaptureBlackoutContent, regionSampling,
+                                                grayscale, captureResults, *request);
         });
 
-        captureResults.result = result;
-        captureListener->onScreenCaptureCompleted(captureResults);
+        if (result != NO_ERROR) {
+            captureResults.result = result;
+            captureListener->onScreenCaptureCompleted(captureResults);
+            return;
+        }
+
+        // The layers stay on the main thread, so that they are not destroyed elsewhere.
+        auto releaseFence = std::make_shared<std::promise<sp<Fence>>>();
+        mPendingScreenCaptures.push_back(
+                {std::move(request->renderedLayers), releaseFence->get_future()});
+
+        mScreenCaptureThread->post([=, captureResults = std::move(captureResults)]() mutable {
+            drawScreenCapture(*request, buffer, captureResults);
+            releaseFence->set_value(captureResults.fence);
+
+            captureResults.result = NO_ERROR;
+            captureListener->onScreenCaptureCompleted(captureResults);
+        });
     }));
 
     return NO_ERROR;
@@ -7959,12 +8396,39 @@ status_t SurfaceFlinger::renderScreenImplLocked(
         ScreenCaptureResults& captureResults) {
     ATRACE_CALL();
 
+    ScreenCaptureRequest request;
+    const status_t result =
+            prepareScreenCaptureLocked(renderArea, traverseLayers, buffer,
+                                       canCaptureBlackoutContent, regionSampling, grayscale,
+                                       captureResults, request);
+    if (result != NO_ERROR) {
+        return result;
+    }
+
+    drawScreenCapture(request, buffer, captureResults);
+
+    if (captureResults.fence->isValid()) {
+        for (const auto& layer : request.renderedLayers) {
+            layer->onLayerDisplayed(captureResults.fence);
+        }
+    }
+    return NO_ERROR;
+}
+
+status_t SurfaceFlinger::prepareScreenCaptureLocked(
+        const RenderArea& renderArea, TraverseLayersFunction traverseLayers,
+        const std::shared_ptr<renderengine::ExternalTexture>& buffer,
+        bool canCaptureBlackoutContent, bool regionSampling, bool grayscale,
+        ScreenCaptureResults& captureResults, ScreenCaptureRequest& request) {
+    ATRACE_CALL();
+
     traverseLayers([&](Layer* layer) {
         captureResults.capturedSecureLayers =
                 captureResults.capturedSecureLayers || (layer->isVisible() && layer->isSecure());
     });
 
     const bool useProtected = buffer->getBuffer()->getUsage() & GRALLOC_USAGE_PROTECTED;
+    request.useProtected = useProtected;
 
     // We allow the system server to take screenshots of secure layers for
     // use in situations like the Screen-rotation animation and place
@@ -7984,8 +8448,9 @@ status_t SurfaceFlinger::renderScreenImplLocked(
     const auto rotation = renderArea.getRotationFlags();
     const auto& layerStackSpaceRect = renderArea.getLayerStackSpaceRect();
 
-    renderengine::DisplaySettings clientCompositionDisplay;
-    std::vector<compositionengine::LayerFE::LayerSettings> clientCompositionLayers;
+    renderengine::DisplaySettings& clientCompositionDisplay = request.display;
+    std::vector<compositionengine::LayerFE::LayerSettings>& clientCompositionLayers =
+            request.layers;
 
     // assume that bounds are never offset, and that they are the same as the
     // buffer bounds.
@@ -8010,7 +8475,6 @@ status_t SurfaceFlinger::renderScreenImplLocked(
     clientCompositionLayers.push_back(fillLayer);
 
     const auto display = renderArea.getDisplayDevice();
-    std::vector<Layer*> renderedLayers;
     Region clearRegion = Region::INVALID_REGION;
     bool disableBlurs = false;
     traverseLayers([&](Layer* layer) {
@@ -8053,40 +8517,59 @@ status_t SurfaceFlinger::renderScreenImplLocked(
             clientCompositionLayers.insert(clientCompositionLayers.end(),
                                            std::make_move_iterator(results.begin()),
                                            std::make_move_iterator(results.end()));
-            renderedLayers.push_back(layer);
+            request.renderedLayers.push_back(layer);
         }
 
     });
 
+    clientCompositionDisplay.clearRegion = clearRegion;
+    return NO_ERROR;
+}
+
+void SurfaceFlinger::drawScreenCapture(const ScreenCaptureRequest& request,
+                                       const std::shared_ptr<renderengine::ExternalTexture>& buffer,
+                                       ScreenCaptureResults& captureResults) {
+    ATRACE_CALL();
+
     std::vector<const renderengine::LayerSettings*> clientCompositionLayerPointers(
-            clientCompositionLayers.size());
-    std::transform(clientCompositionLayers.begin(), clientCompositionLayers.end(),
+            request.layers.size());
+    std::transform(request.layers.begin(), request.layers.end(),
                    clientCompositionLayerPointers.begin(),
-                   std::pointer_traits<renderengine::LayerSettings*>::pointer_to);
+                   [](const compositionengine::LayerFE::LayerSettings& settings) {
+                       return &settings;
+                   });
 
-    clientCompositionDisplay.clearRegion = clearRegion;
     // Use an empty fence for the buffer fence, since we just created the buffer so
     // there is no need for synchronization with the GPU.
     base::unique_fd bufferFence;
     base::unique_fd drawFence;
-    getRenderEngine().useProtectedContext(useProtected);
+    getRenderEngine().useProtectedContext(request.useProtected);
 
     const constexpr bool kUseFramebufferCache = false;
-    getRenderEngine().drawLayers(clientCompositionDisplay, clientCompositionLayerPointers, buffer,
+    getRenderEngine().drawLayers(request.display, clientCompositionLayerPointers, buffer,
                                  kUseFramebufferCache, std::move(bufferFence), &drawFence);
 
-    if (drawFence >= 0) {
-        sp<Fence> releaseFence = new Fence(dup(drawFence));
-        for (auto* layer : renderedLayers) {
-            layer->onLayerDisplayed(releaseFence);
-        }
-    }
-
     captureResults.fence = new Fence(drawFence.release());
     // Always switch back to unprotected context.
     getRenderEngine().useProtectedContext(false);
+}
 
-    return NO_ERROR;
+void SurfaceFlinger::finishScreenCaptures() {
+    if (mPendingScreenCaptures.empty()) {
+        return;
+    }
+    ATRACE_CALL();
+
+    for (auto& capture : mPendingScreenCaptures) {
+        const sp<Fence> releaseFence = capture.releaseFence.get();
+        if (!releaseFence->isValid()) {
+            continue;
+        }
+        for (const auto& layer : capture.renderedLayers) {
+            layer->onLayerDisplayed(releaseFence);
+        }
+    }
+    mPendingScreenCaptures.clear();
 }
 
 void SurfaceFlinger::setInputWindowsFinished() {
@@ -8112,12 +8595,12 @@ void SurfaceFlinger::traverseLayersInLayerStack(ui::LayerStack layerStack, const
                                                 const LayerVector::Visitor& visitor) {
     // We loop through the first level of layers without traversing,
     // as we need to determine which layers belong to the requested display.
-    for (const auto& layer : mDrawingState.layersSortedByZ) {
-        if (!layer->belongsToDisplay(layerStack)) {
+    for (size_t i = 0; i < mDrawingState.layersSortedByZ.size(); i++) {
+        if (!mDrawingState.layersSortedByZ[i]->belongsToDisplay(layerStack)) {
             continue;
         }
         // relative layers are traversed in Layer::traverseInZOrder
-        layer->traverseInZOrder(LayerVector::StateSet::Drawing, [&](Layer* layer) {
+        traverseDrawingLayerTreeInZOrder(i, [&](Layer* layer) {
             if (layer->getPrimaryDisplayOnly()) {
                 return;
             }
@@ -8132,6 +8615,63 @@ void SurfaceFlinger::traverseLayersInLayerStack(ui::LayerStack layerStack, const
     }
 }
 
+bool SurfaceFlinger::updateDrawingLayerZOrder() {
+    if (std::this_thread::get_id() != mMainThreadId) {
+        return false;
+    }
+    if (mDrawingLayerZOrderValid) {
+        return true;
+    }
+
+    ATRACE_CALL();
+    mDrawingLayersInZOrder.clear();
+    mDrawingLayerTreeEnds.clear();
+    for (const auto& root : mDrawingState.layersSortedByZ) {
+        // relative layers are traversed along with the tree they are relative to
+        if (!root->getDrawingState().isRelativeOf) {
+            root->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
+                mDrawingLayersInZOrder.emplace_back(layer);
+            });
+        }
+        mDrawingLayerTreeEnds.push_back(mDrawingLayersInZOrder.size());
+    }
+    mDrawingLayerZOrderValid = true;
+    return true;
+}
+
+void SurfaceFlinger::traverseDrawingLayersInZOrder(const LayerVector::Visitor& visitor) {
+    if (!updateDrawingLayerZOrder()) {
+        mDrawingState.traverseInZOrder(visitor);
+        return;
+    }
+    for (const auto& layer : mDrawingLayersInZOrder) {
+        visitor(layer.get());
+    }
+}
+
+void SurfaceFlinger::traverseDrawingLayersInReverseZOrder(const LayerVector::Visitor& visitor) {
+    if (!updateDrawingLayerZOrder()) {
+        mDrawingState.traverseInReverseZOrder(visitor);
+        return;
+    }
+    for (auto it = mDrawingLayersInZOrder.rbegin(); it != mDrawingLayersInZOrder.rend(); ++it) {
+        visitor(it->get());
+    }
+}
+
+void SurfaceFlinger::traverseDrawingLayerTreeInZOrder(size_t index,
+                                                      const LayerVector::Visitor& visitor) {
+    const auto& root = mDrawingState.layersSortedByZ[index];
+    if (!updateDrawingLayerZOrder() || root->getDrawingState().isRelativeOf) {
+        root->traverseInZOrder(LayerVector::StateSet::Drawing, visitor);
+        return;
+    }
+    const size_t begin = index == 0 ? 0 : mDrawingLayerTreeEnds[index - 1];
+    for (size_t i = begin; i < mDrawingLayerTreeEnds[index]; i++) {
+        visitor(mDrawingLayersInZOrder[i].get());
+    }
+}
+
 status_t SurfaceFlinger::setDesiredDisplayModeSpecsInternal(
         const sp<DisplayDevice>& display,
         const std::optional<scheduler::RefreshRateConfigs::Policy>& policy, bool overridePolicy) {
@@ -8345,6 +8885,7 @@ void SurfaceFlinger::onLayerFirstRef(Layer* layer) {
 
 void SurfaceFlinger::onLayerDestroyed(Layer* layer) {
     mNumLayers--;
+    mLayerCostTracker.onLayerDestroyed(layer->getSequence());
     removeHierarchyFromOffscreenLayers(layer);
     if (!layer->isRemovedFromCurrentState()) {
         mScheduler->deregisterLayer(layer);
@@ -23,9 +23,11 @@
  */
 
 #include <android-base/thread_annotations.h>
+#include <compositionengine/LayerFE.h>
 #include <compositionengine/OutputColorSetting.h>
 #include <cutils/atomic.h>
 #include <cutils/compiler.h>
+#include <ftl/concurrent_queue.h>
 #include <gui/BufferQueue.h>
 #include <gui/FrameTimestamps.h>
 #include <gui/ISurfaceComposer.h>
@@ -35,6 +37,7 @@
 #include <gui/OccupancyTracker.h>
 #include <layerproto/LayerProtoHeader.h>
 #include <math/mat4.h>
+#include <renderengine/DisplaySettings.h>
 #include <renderengine/LayerSettings.h>
 #include <serviceutils/PriorityDumper.h>
 #include <system/graphics.h>
@@ -56,6 +59,7 @@
 #include "Effects/Daltonizer.h"
 #include "Fps.h"
 #include "FrameTracker.h"
+#include "LayerCostTracker.h"
 #include "LayerVector.h"
 #include "Scheduler/RefreshRateConfigs.h"
 #include "Scheduler/RefreshRateStats.h"
@@ -66,6 +70,7 @@
 #include "TracedOrdinal.h"
 #include "TransactionCallbackInvoker.h"
 
+#include <array>
 #include <atomic>
 #include <cstdint>
 #include <functional>
@@ -120,6 +125,7 @@ class MessageBase;
 class RefreshRateOverlay;
 class RegionSamplingThread;
 class RenderArea;
+class ScreenCaptureThread;
 class TimeStats;
 class FrameTracer;
 
@@ -415,8 +421,8 @@ protected:
 
     virtual uint32_t setClientStateLocked(
             const FrameTimelineInfo& info, const ComposerState& composerState,
-            int64_t desiredPresentTime, bool isAutoTimestamp, int64_t postTime,
-            uint32_t permissions,
+            const ResolvedComposerState* resolvedState, int64_t desiredPresentTime,
+            bool isAutoTimestamp, int64_t postTime, uint32_t permissions,
             std::unordered_set<ListenerCallbacks, ListenerCallbacksHash>& listenerCallbacks)
             REQUIRES(mStateLock);
     virtual void commitTransactionLocked();
@@ -601,6 +607,17 @@ private:
         mutable std::mutex mMutex;
     };
 
+    // What the binder thread resolves for each ComposerState of a transaction, with no locks held,
+    // so that the main thread only has to apply it.
+    struct ResolvedComposerState {
+        wp<Layer> layer;
+        // The changes of the state, without those that the client is not allowed to make or that
+        // are invalid.
+        uint64_t what = 0;
+        // The new buffer of the state, already imported into RenderEngine if it is threaded.
+        std::shared_ptr<renderengine::ExternalTexture> buffer;
+    };
+
     struct TransactionState {
         TransactionState(const FrameTimelineInfo& frameTimelineInfo,
                          const Vector<ComposerState>& composerStates,
@@ -647,6 +664,8 @@ private:
         int originUid;
         uint64_t id;
         std::shared_ptr<CountDownLatch> transactionCommittedSignal;
+        // Parallel to states, unless the transaction was not submitted through a binder thread.
+        std::vector<ResolvedComposerState> resolvedStates;
     };
 
     template <typename F, std::enable_if_t<!std::is_member_function_pointer_v<F>>* = nullptr>
@@ -926,7 +945,10 @@ private:
     /*
      * Transactions
      */
+    // Resolves the layers, permissions and buffers of the transaction on the binder thread.
+    void resolveTransactionState(TransactionState& transaction) const;
     void applyTransactionState(const FrameTimelineInfo& info, const Vector<ComposerState>& state,
+                               const std::vector<ResolvedComposerState>& resolvedStates,
                                const Vector<DisplayState>& displays, uint32_t flags,
                                const InputWindowCommands& inputWindowCommands,
                                const int64_t desiredPresentTime, bool isAutoTimestamp,
@@ -955,8 +977,13 @@ private:
     bool transactionIsReadyToBeApplied(
             const FrameTimelineInfo& info, bool isAutoTimestamp, int64_t desiredPresentTime,
             uid_t originUid, const Vector<ComposerState>& states,
+            const std::vector<ResolvedComposerState>& resolvedStates,
             const std::unordered_set<sp<IBinder>, ISurfaceComposer::SpHash<IBinder>>&
-                    bufferLayersReadyToPresent) const REQUIRES(mStateLock);
+                    bufferLayersReadyToPresent,
+            sp<Fence>* outBlockingFence = nullptr) const REQUIRES(mStateLock);
+    // Parks the pending transactions of applyToken until the fence signals.
+    void waitForBlockingFence(const sp<IBinder>& applyToken, const sp<Fence>& fence)
+            REQUIRES(mQueueLock);
     uint32_t setDisplayStateLocked(const DisplayState& s) REQUIRES(mStateLock);
     void checkVirtualDisplayHint(const Vector<DisplayState>& displays);
     uint32_t addInputWindowCommands(const InputWindowCommands& inputWindowCommands)
@@ -1024,6 +1051,30 @@ private:
                                     bool canCaptureBlackoutContent, bool regionSampling,
                                     bool grayscale, ScreenCaptureResults&);
 
+    // The client composition of a screen capture, snapshotted from the layers on the main thread.
+    struct ScreenCaptureRequest {
+        renderengine::DisplaySettings display;
+        std::vector<compositionengine::LayerFE::LayerSettings> layers;
+        std::vector<sp<Layer>> renderedLayers;
+        bool useProtected = false;
+    };
+
+    // The two halves of renderScreenImplLocked. The request is prepared on the main thread, and
+    // may be drawn on the capture thread, which does not touch the layers.
+    status_t prepareScreenCaptureLocked(const RenderArea&, TraverseLayersFunction,
+                                        const std::shared_ptr<renderengine::ExternalTexture>&,
+                                        bool canCaptureBlackoutContent, bool regionSampling,
+                                        bool grayscale, ScreenCaptureResults&,
+                                        ScreenCaptureRequest&);
+    void drawScreenCapture(const ScreenCaptureRequest&,
+                           const std::shared_ptr<renderengine::ExternalTexture>&,
+                           ScreenCaptureResults&);
+
+    // Hands the release fences of the captures drawn on the capture thread to the layers they
+    // rendered, which waits for the draws that are still being submitted. This runs before
+    // each frame latches new buffers, so a buffer is never released while a capture reads it.
+    void finishScreenCaptures();
+
 
     bool canAllocateHwcDisplayIdForVDS(uint64_t usage);
     bool skipColorLayer(const char* layerType);
@@ -1032,6 +1083,15 @@ private:
     // matching ownerUid
     void traverseLayersInLayerStack(ui::LayerStack, const int32_t uid, const LayerVector::Visitor&);
 
+    // Like mDrawingState.traverseInZOrder, but replays the order flattened by the first traversal
+    // since the hierarchy, Z or relative Z of the drawing state last changed. Other threads, which
+    // may only read the drawing state under mStateLock, traverse the tree instead.
+    void traverseDrawingLayersInZOrder(const LayerVector::Visitor&);
+    void traverseDrawingLayersInReverseZOrder(const LayerVector::Visitor&);
+    // Traverses the tree of mDrawingState.layersSortedByZ[index] in Z order.
+    void traverseDrawingLayerTreeInZOrder(size_t index, const LayerVector::Visitor&);
+    bool updateDrawingLayerZOrder();
+
     void readPersistentProperties();
 
     size_t getMaxTextureSize() const;
@@ -1116,6 +1176,8 @@ private:
     sp<DisplayDevice> getVsyncSource();
     void updateVsyncSource();
     void postComposition();
+    // Hands the client compositions of the frame to the layer cost tracker.
+    void trackClientCompositionCost();
     void getCompositorTiming(CompositorTiming* compositorTiming);
     void updateCompositorTiming(const DisplayStatInfo& stats, nsecs_t compositeTime,
                                 std::shared_ptr<FenceTime>& presentFenceTime);
@@ -1232,6 +1294,23 @@ private:
      * Debugging & dumpsys
      */
     void dumpAllLocked(const DumpArgs& args, std::string& result) const REQUIRES(mStateLock);
+    // Writes the same as dumpAllLocked to the fd, section by section, holding mStateLock only for
+    // the sections that need it.
+    void dumpAll(int fd, const DumpArgs& args) EXCLUDES(mStateLock);
+    void dumpConfigurationLocked(const DumpArgs&, std::string& result) const REQUIRES(mStateLock);
+    void dumpFrameStats(const DumpArgs&, std::string& result) const;
+    void dumpCompositionLocked(const DumpArgs&, std::string& result) const REQUIRES(mStateLock);
+    void dumpRenderEngineState(const DumpArgs&, std::string& result) const;
+    void dumpGlobalStateLocked(const DumpArgs&, std::string& result) const REQUIRES(mStateLock);
+    void dumpHwcLocked(const DumpArgs&, std::string& result) const REQUIRES(mStateLock);
+    void dumpAllocations(const DumpArgs&, std::string& result) const;
+
+    struct DumpSection {
+        void (SurfaceFlinger::*dump)(const DumpArgs&, std::string&) const;
+        bool needsStateLock;
+    };
+    // The sections of the full dump, in order.
+    static const std::array<DumpSection, 7> kDumpSections;
     void dumpMini(std::string& result) const REQUIRES(mStateLock);
     void appendSfConfigString(std::string& result) const;
     void listLayersLocked(std::string& result) const;
@@ -1239,6 +1318,7 @@ private:
     void clearStatsLocked(const DumpArgs& args, std::string& result);
     void dumpTimeStats(const DumpArgs& args, bool asProto, std::string& result) const;
     void dumpFrameTimeline(const DumpArgs& args, std::string& result) const;
+    void dumpLayerCost(const DumpArgs& args, std::string& result);
     void logFrameStats();
 
     void dumpVSync(std::string& result) const REQUIRES(mStateLock);
@@ -1360,6 +1440,8 @@ private:
     surfaceflinger::Factory& mFactory;
 
     std::future<void> mRenderEnginePrimeCacheFuture;
+    // Durations of the phases of init(), for dumpsys.
+    std::string mStartupTimings;
 
     // access must be protected by mStateLock
     mutable Mutex mStateLock;
@@ -1402,6 +1484,14 @@ private:
     State mDrawingState{LayerVector::StateSet::Drawing};
     bool mVisibleRegionsDirty = false;
 
+    // The layers of mDrawingState in Z order, see traverseDrawingLayersInZOrder(). For each layer
+    // in mDrawingState.layersSortedByZ, mDrawingLayerTreeEnds holds the end of its tree in that
+    // order, which is empty for layers relative to another tree. Cleared on commit whenever the
+    // order may have changed.
+    std::vector<sp<Layer>> mDrawingLayersInZOrder;
+    std::vector<size_t> mDrawingLayerTreeEnds;
+    bool mDrawingLayerZOrderValid = false;
+
     // VisibleRegions dirty is already cleared by postComp, but we need to track it to prevent
     // extra work in the HDR layer info listener.
     bool mVisibleRegionsWereDirtyThisFrame = false;
@@ -1479,14 +1569,27 @@ private:
     bool mSupportsBlur = false;
     // If blurs are considered expensive and should require high GPU frequency.
     bool mBlursAreExpensive = false;
+    // If the outputs are presented in parallel, which needs a threaded RenderEngine.
+    bool mPresentOutputsInParallel = false;
+    // If the client composition is drawn for the previous frame's HWC composition strategy while
+    // the HWC validates the frame.
+    bool mPredictCompositionStrategy = false;
+    // If the main and RenderEngine threads report their work durations to a power hint session.
+    bool mUsePowerHintSession = false;
+    // If binder threads may import transaction buffers, which needs a threaded RenderEngine.
+    bool mImportBuffersOnBinderThreads = false;
+    // If the outputs read a contiguous copy of the layer state while they are presented.
+    bool mPublishLayerSnapshots = false;
     bool mUseAdvanceSfOffset = false;
     bool mUseFbScaling = false;
     bool mAsyncVdsCreationSupported = false;
     std::atomic<uint32_t> mFrameMissedCount = 0;
     std::atomic<uint32_t> mHwcFrameMissedCount = 0;
     std::atomic<uint32_t> mGpuFrameMissedCount = 0;
+    std::atomic<uint32_t> mCompositedFrameCount = 0;
 
     TransactionCallbackInvoker mTransactionCallbackInvoker;
+    LayerCostTracker mLayerCostTracker;
 
     // these are thread safe
     std::unique_ptr<MessageQueue> mEventQueue;
@@ -1509,9 +1612,18 @@ private:
 
     mutable Mutex mQueueLock;
     Condition mTransactionQueueCV;
-    std::unordered_map<sp<IBinder>, std::queue<TransactionState>, IListenerHash>
+    // Transactions of an apply token that wait for the front one to be ready.
+    struct PendingTransactionQueue {
+        std::queue<TransactionState> transactions;
+        // The unsignaled acquire fence that holds back the front transaction, if any. The front is
+        // not re-evaluated while it is set, since the fence wakes up the main thread on signaling.
+        sp<Fence> blockingFence;
+    };
+    std::unordered_map<sp<IBinder>, PendingTransactionQueue, IListenerHash>
             mPendingTransactionQueues GUARDED_BY(mQueueLock);
-    std::queue<TransactionState> mTransactionQueue GUARDED_BY(mQueueLock);
+    // Transactions submitted since the last flush. Binder threads push without taking a lock, and
+    // the main thread drains it.
+    ftl::UnboundedMpscQueue<TransactionState> mTransactionQueue;
     /*
      * Feature prototyping
      */
@@ -1591,6 +1703,14 @@ private:
 
     bool mLumaSampling = true;
     sp<RegionSamplingThread> mRegionSamplingThread;
+    std::unique_ptr<ScreenCaptureThread> mScreenCaptureThread;
+
+    struct PendingScreenCapture {
+        std::vector<sp<Layer>> renderedLayers;
+        std::future<sp<Fence>> releaseFence;
+    };
+    // Captures posted to mScreenCaptureThread whose layers are yet to be released. Main thread only.
+    std::vector<PendingScreenCapture> mPendingScreenCaptures;
     sp<FpsReporter> mFpsReporter;
     sp<TunnelModeEnabledReporter> mTunnelModeEnabledReporter;
     ui::DisplayPrimaries mInternalDisplayPrimaries;
@@ -1604,6 +1724,12 @@ private:
 
     sp<SetInputWindowsListener> mSetInputWindowsListener;
 
+    // The input windows last sent to mInputFlinger, which later updates only send the changes
+    // to. Should only be accessed by the main thread.
+    bool mInputWindowInfosSent = false;
+    std::vector<int32_t> mLastInputWindowIds;
+    std::unordered_map<int32_t, InputWindowInfo> mLastInputWindowInfos;
+
     Hwc2::impl::PowerAdvisor mPowerAdvisor;
 
     // This should only be accessed on the main thread.
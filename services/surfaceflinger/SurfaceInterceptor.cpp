@@ -25,9 +25,15 @@
 #include "SurfaceFlinger.h"
 #include "SurfaceInterceptor.h"
 
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <algorithm>
 #include <fstream>
+#include <vector>
 
 #include <android-base/file.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 #include <utils/Trace.h>
 
@@ -40,6 +46,13 @@ SurfaceInterceptor::~SurfaceInterceptor() = default;
 
 namespace impl {
 
+SurfaceInterceptor::~SurfaceInterceptor() {
+    std::scoped_lock lock(mTraceMutex);
+    if (mWriterThread.joinable()) {
+        stopWriter();
+    }
+}
+
 void SurfaceInterceptor::addTransactionTraceListener(
         const sp<gui::ITransactionTraceListener>& listener) {
     sp<IBinder> asBinder = IInterface::asBinder(listener);
@@ -61,6 +74,7 @@ void SurfaceInterceptor::binderDied(const wp<IBinder>& who) {
 void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
+    std::scoped_lock<std::mutex> protoGuard(mTraceMutex);
     if (mEnabled) {
         return;
     }
@@ -71,13 +85,26 @@ void SurfaceInterceptor::enable(const SortedVector<sp<Layer>>& layers,
             listener->onToggled(true);
         }
     }
+
+    // Drop the increments saved while the previous trace was being written out.
+    while (mPendingIncrements.try_pop()) {
+    }
+
+    if (base::GetBoolProperty("debug.sf.interceptor_stream", false)) {
+        mStreamFd.reset(open(mOutputFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                             0666));
+        ALOGE_IF(!mStreamFd.ok(), "Could not open %s to stream the trace (%s), keeping it in memory",
+                 mOutputFileName.c_str(), strerror(errno));
+    }
+
     mEnabled = true;
-    std::scoped_lock<std::mutex> protoGuard(mTraceMutex);
-    saveExistingDisplaysLocked(displays);
-    saveExistingSurfacesLocked(layers);
+    startWriter();
+    saveExistingDisplays(displays);
+    saveExistingSurfaces(layers);
 }
 
 void SurfaceInterceptor::disable() {
+    std::scoped_lock<std::mutex> protoGuard(mTraceMutex);
     if (!mEnabled) {
         return;
     }
@@ -89,39 +116,125 @@ void SurfaceInterceptor::disable() {
         }
     }
     mEnabled = false;
-    std::scoped_lock<std::mutex> protoGuard(mTraceMutex);
-    status_t err(writeProtoFileLocked());
+    stopWriter();
+
+    if (mStreamFd.ok()) {
+        mStreamFd.reset();
+        return;
+    }
+    status_t err(writeProtoFile());
     ALOGE_IF(err == PERMISSION_DENIED, "Could not save the proto file! Permission denied");
-    ALOGE_IF(err == NOT_ENOUGH_DATA, "Could not save the proto file! There are missing fields");
-    mTrace.Clear();
+    mEncodedTrace.clear();
+    mEncodedTrace.shrink_to_fit();
+}
+
+void SurfaceInterceptor::startWriter() {
+    {
+        std::scoped_lock lock(mWriterMutex);
+        mWriterRunning = true;
+    }
+    mWriterThread = std::thread([this]() { threadMain(); });
+    pthread_setname_np(mWriterThread.native_handle(), "SfInterceptor");
+}
+
+void SurfaceInterceptor::stopWriter() {
+    {
+        std::scoped_lock lock(mWriterMutex);
+        mWriterRunning = false;
+    }
+    mWriterCondition.notify_one();
+    mWriterThread.join();
+}
+
+void SurfaceInterceptor::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mWriterMutex);
+    bool running = true;
+    while (running) {
+        // Intercepting threads do not wake the writer, so that queueing an increment stays a
+        // single atomic exchange. The increments queued by the time it is stopped are still written.
+        mWriterCondition.wait_for(lock, kWriterInterval, [this] { return !mWriterRunning; });
+        running = mWriterRunning;
+        lock.unlock();
+        writeIncrements();
+        lock.lock();
+    }
+}
+
+void SurfaceInterceptor::writeIncrements() {
+    std::vector<Increment> increments;
+    while (auto increment = mPendingIncrements.try_pop()) {
+        increments.push_back(std::move(*increment));
+    }
+    if (increments.empty()) {
+        return;
+    }
+    ATRACE_CALL();
+
+    // Increments are stamped before they are queued, so concurrent callers may queue them slightly
+    // out of order.
+    std::stable_sort(increments.begin(), increments.end(),
+                     [](const Increment& lhs, const Increment& rhs) {
+                         return lhs.time_stamp() < rhs.time_stamp();
+                     });
+
+    Trace batch;
+    for (auto& increment : increments) {
+        batch.add_increment()->Swap(&increment);
+    }
+    if (!batch.IsInitialized()) {
+        ALOGE("Dropping %zu increments! There are missing fields", increments.size());
+        return;
+    }
+
+    // Serialized messages concatenate into the message with their repeated fields appended, so
+    // each batch extends the encoded trace as is.
+    if (!mStreamFd.ok()) {
+        batch.AppendToString(&mEncodedTrace);
+        return;
+    }
+    std::string output;
+    if (!batch.SerializeToString(&output) ||
+        !base::WriteFully(mStreamFd, output.data(), output.size())) {
+        ALOGE("Could not stream %zu increments (%s)", increments.size(), strerror(errno));
+    }
 }
 
 bool SurfaceInterceptor::isEnabled() {
     return mEnabled;
 }
 
-void SurfaceInterceptor::saveExistingDisplaysLocked(
+void SurfaceInterceptor::saveExistingDisplays(
         const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays)
 {
     // Caveat: The initial snapshot does not capture the power mode of the existing displays
     ATRACE_CALL();
     for (size_t i = 0 ; i < displays.size() ; i++) {
-        addDisplayCreationLocked(createTraceIncrementLocked(), displays[i]);
-        addInitialDisplayStateLocked(createTraceIncrementLocked(), displays[i]);
+        Increment creation(createTraceIncrement());
+        addDisplayCreation(&creation, displays[i]);
+        addIncrement(std::move(creation));
+
+        Increment initialState(createTraceIncrement());
+        addInitialDisplayState(&initialState, displays[i]);
+        addIncrement(std::move(initialState));
     }
 }
 
-void SurfaceInterceptor::saveExistingSurfacesLocked(const SortedVector<sp<Layer>>& layers) {
+void SurfaceInterceptor::saveExistingSurfaces(const SortedVector<sp<Layer>>& layers) {
     ATRACE_CALL();
     for (const auto& l : layers) {
         l->traverseInZOrder(LayerVector::StateSet::Drawing, [this](Layer* layer) {
-            addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
-            addInitialSurfaceStateLocked(createTraceIncrementLocked(), layer);
+            Increment creation(createTraceIncrement());
+            addSurfaceCreation(&creation, layer);
+            addIncrement(std::move(creation));
+
+            Increment initialState(createTraceIncrement());
+            addInitialSurfaceState(&initialState, layer);
+            addIncrement(std::move(initialState));
         });
     }
 }
 
-void SurfaceInterceptor::addInitialSurfaceStateLocked(Increment* increment,
+void SurfaceInterceptor::addInitialSurfaceState(Increment* increment,
         const sp<const Layer>& layer)
 {
     Transaction* transaction(increment->mutable_transaction());
@@ -130,53 +243,45 @@ void SurfaceInterceptor::addInitialSurfaceStateLocked(Increment* increment,
     transaction->set_animation(layerFlags & BnSurfaceComposer::eAnimation);
 
     const int32_t layerId(getLayerId(layer));
-    addPositionLocked(transaction, layerId, layer->mDrawingState.transform.tx(),
-                      layer->mDrawingState.transform.ty());
-    addDepthLocked(transaction, layerId, layer->mDrawingState.z);
-    addAlphaLocked(transaction, layerId, layer->mDrawingState.color.a);
-    addTransparentRegionLocked(transaction, layerId,
-                               layer->mDrawingState.activeTransparentRegion_legacy);
-    addLayerStackLocked(transaction, layerId, layer->mDrawingState.layerStack);
-    addCropLocked(transaction, layerId, layer->mDrawingState.crop);
-    addCornerRadiusLocked(transaction, layerId, layer->mDrawingState.cornerRadius);
-    addBackgroundBlurRadiusLocked(transaction, layerId, layer->mDrawingState.backgroundBlurRadius);
-    addBlurRegionsLocked(transaction, layerId, layer->mDrawingState.blurRegions);
-    addFlagsLocked(transaction, layerId, layer->mDrawingState.flags,
-                   layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque |
-                           layer_state_t::eLayerSecure);
-    addReparentLocked(transaction, layerId, getLayerIdFromWeakRef(layer->mDrawingParent));
-    addRelativeParentLocked(transaction, layerId,
-                            getLayerIdFromWeakRef(layer->mDrawingState.zOrderRelativeOf),
-                            layer->mDrawingState.z);
-    addShadowRadiusLocked(transaction, layerId, layer->mDrawingState.shadowRadius);
-    addTrustedOverlayLocked(transaction, layerId, layer->mDrawingState.isTrustedOverlay);
-}
-
-void SurfaceInterceptor::addInitialDisplayStateLocked(Increment* increment,
+    addPosition(transaction, layerId, layer->mDrawingState.transform.tx(),
+                layer->mDrawingState.transform.ty());
+    addDepth(transaction, layerId, layer->mDrawingState.z);
+    addAlpha(transaction, layerId, layer->mDrawingState.color.a);
+    addTransparentRegion(transaction, layerId,
+                         layer->mDrawingState.activeTransparentRegion_legacy);
+    addLayerStack(transaction, layerId, layer->mDrawingState.layerStack);
+    addCrop(transaction, layerId, layer->mDrawingState.crop);
+    addCornerRadius(transaction, layerId, layer->mDrawingState.cornerRadius);
+    addBackgroundBlurRadius(transaction, layerId, layer->mDrawingState.backgroundBlurRadius);
+    addBlurRegions(transaction, layerId, layer->mDrawingState.blurRegions);
+    addFlags(transaction, layerId, layer->mDrawingState.flags,
+             layer_state_t::eLayerHidden | layer_state_t::eLayerOpaque |
+                     layer_state_t::eLayerSecure);
+    addReparent(transaction, layerId, getLayerIdFromWeakRef(layer->mDrawingParent));
+    addRelativeParent(transaction, layerId,
+                      getLayerIdFromWeakRef(layer->mDrawingState.zOrderRelativeOf),
+                      layer->mDrawingState.z);
+    addShadowRadius(transaction, layerId, layer->mDrawingState.shadowRadius);
+    addTrustedOverlay(transaction, layerId, layer->mDrawingState.isTrustedOverlay);
+}
+
+void SurfaceInterceptor::addInitialDisplayState(Increment* increment,
         const DisplayDeviceState& display)
 {
     Transaction* transaction(increment->mutable_transaction());
     transaction->set_synchronous(false);
     transaction->set_animation(false);
 
-    addDisplaySurfaceLocked(transaction, display.sequenceId, display.surface);
-    addDisplayLayerStackLocked(transaction, display.sequenceId, display.layerStack);
-    addDisplaySizeLocked(transaction, display.sequenceId, display.width, display.height);
-    addDisplayProjectionLocked(transaction, display.sequenceId, toRotationInt(display.orientation),
-                               display.layerStackSpaceRect, display.orientedDisplaySpaceRect);
+    addDisplaySurface(transaction, display.sequenceId, display.surface);
+    addDisplayLayerStack(transaction, display.sequenceId, display.layerStack);
+    addDisplaySize(transaction, display.sequenceId, display.width, display.height);
+    addDisplayProjection(transaction, display.sequenceId, toRotationInt(display.orientation),
+                         display.layerStackSpaceRect, display.orientedDisplaySpaceRect);
 }
 
-status_t SurfaceInterceptor::writeProtoFileLocked() {
+status_t SurfaceInterceptor::writeProtoFile() {
     ATRACE_CALL();
-    std::string output;
-
-    if (!mTrace.IsInitialized()) {
-        return NOT_ENOUGH_DATA;
-    }
-    if (!mTrace.SerializeToString(&output)) {
-        return PERMISSION_DENIED;
-    }
-    if (!android::base::WriteStringToFile(output, mOutputFileName, true)) {
+    if (!android::base::WriteStringToFile(mEncodedTrace, mOutputFileName, true)) {
         return PERMISSION_DENIED;
     }
 
@@ -208,13 +313,17 @@ int32_t SurfaceInterceptor::getLayerIdFromHandle(const sp<IBinder>& handle) cons
     return layer == nullptr ? -1 : getLayerId(layer);
 }
 
-Increment* SurfaceInterceptor::createTraceIncrementLocked() {
-    Increment* increment(mTrace.add_increment());
-    increment->set_time_stamp(elapsedRealtimeNano());
+Increment SurfaceInterceptor::createTraceIncrement() {
+    Increment increment;
+    increment.set_time_stamp(elapsedRealtimeNano());
     return increment;
 }
 
-SurfaceChange* SurfaceInterceptor::createSurfaceChangeLocked(Transaction* transaction,
+void SurfaceInterceptor::addIncrement(Increment&& increment) {
+    mPendingIncrements.push(std::move(increment));
+}
+
+SurfaceChange* SurfaceInterceptor::createSurfaceChange(Transaction* transaction,
         int32_t layerId)
 {
     SurfaceChange* change(transaction->add_surface_change());
@@ -222,7 +331,7 @@ SurfaceChange* SurfaceInterceptor::createSurfaceChangeLocked(Transaction* transa
     return change;
 }
 
-DisplayChange* SurfaceInterceptor::createDisplayChangeLocked(Transaction* transaction,
+DisplayChange* SurfaceInterceptor::createDisplayChange(Transaction* transaction,
         int32_t sequenceId)
 {
     DisplayChange* dispChange(transaction->add_display_change());
@@ -230,58 +339,58 @@ DisplayChange* SurfaceInterceptor::createDisplayChangeLocked(Transaction* transa
     return dispChange;
 }
 
-void SurfaceInterceptor::setProtoRectLocked(Rectangle* protoRect, const Rect& rect) {
+void SurfaceInterceptor::setProtoRect(Rectangle* protoRect, const Rect& rect) {
     protoRect->set_left(rect.left);
     protoRect->set_top(rect.top);
     protoRect->set_right(rect.right);
     protoRect->set_bottom(rect.bottom);
 }
 
-void SurfaceInterceptor::setTransactionOriginLocked(Transaction* transaction, int32_t pid,
-                                                    int32_t uid) {
+void SurfaceInterceptor::setTransactionOrigin(Transaction* transaction, int32_t pid,
+                                              int32_t uid) {
     Origin* origin(transaction->mutable_origin());
     origin->set_pid(pid);
     origin->set_uid(uid);
 }
 
-void SurfaceInterceptor::addPositionLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addPosition(Transaction* transaction, int32_t layerId,
         float x, float y)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     PositionChange* posChange(change->mutable_position());
     posChange->set_x(x);
     posChange->set_y(y);
 }
 
-void SurfaceInterceptor::addDepthLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addDepth(Transaction* transaction, int32_t layerId,
         uint32_t z)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     LayerChange* depthChange(change->mutable_layer());
     depthChange->set_layer(z);
 }
 
-void SurfaceInterceptor::addSizeLocked(Transaction* transaction, int32_t layerId, uint32_t w,
+void SurfaceInterceptor::addSize(Transaction* transaction, int32_t layerId, uint32_t w,
         uint32_t h)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     SizeChange* sizeChange(change->mutable_size());
     sizeChange->set_w(w);
     sizeChange->set_h(h);
 }
 
-void SurfaceInterceptor::addAlphaLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addAlpha(Transaction* transaction, int32_t layerId,
         float alpha)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     AlphaChange* alphaChange(change->mutable_alpha());
     alphaChange->set_alpha(alpha);
 }
 
-void SurfaceInterceptor::addMatrixLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addMatrix(Transaction* transaction, int32_t layerId,
         const layer_state_t::matrix22_t& matrix)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     MatrixChange* matrixChange(change->mutable_matrix());
     matrixChange->set_dsdx(matrix.dsdx);
     matrixChange->set_dtdx(matrix.dtdx);
@@ -289,73 +398,73 @@ void SurfaceInterceptor::addMatrixLocked(Transaction* transaction, int32_t layer
     matrixChange->set_dtdy(matrix.dtdy);
 }
 
-void SurfaceInterceptor::addTransparentRegionLocked(Transaction* transaction,
+void SurfaceInterceptor::addTransparentRegion(Transaction* transaction,
         int32_t layerId, const Region& transRegion)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     TransparentRegionHintChange* transparentChange(change->mutable_transparent_region_hint());
 
     for (const auto& rect : transRegion) {
         Rectangle* protoRect(transparentChange->add_region());
-        setProtoRectLocked(protoRect, rect);
+        setProtoRect(protoRect, rect);
     }
 }
 
-void SurfaceInterceptor::addFlagsLocked(Transaction* transaction, int32_t layerId, uint8_t flags,
-                                        uint8_t mask) {
+void SurfaceInterceptor::addFlags(Transaction* transaction, int32_t layerId, uint8_t flags,
+                                  uint8_t mask) {
     // There can be multiple flags changed
     if (mask & layer_state_t::eLayerHidden) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         HiddenFlagChange* flagChange(change->mutable_hidden_flag());
         flagChange->set_hidden_flag(flags & layer_state_t::eLayerHidden);
     }
     if (mask & layer_state_t::eLayerOpaque) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         OpaqueFlagChange* flagChange(change->mutable_opaque_flag());
         flagChange->set_opaque_flag(flags & layer_state_t::eLayerOpaque);
     }
     if (mask & layer_state_t::eLayerSecure) {
-        SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+        SurfaceChange* change(createSurfaceChange(transaction, layerId));
         SecureFlagChange* flagChange(change->mutable_secure_flag());
         flagChange->set_secure_flag(flags & layer_state_t::eLayerSecure);
     }
 }
 
-void SurfaceInterceptor::addLayerStackLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addLayerStack(Transaction* transaction, int32_t layerId,
         uint32_t layerStack)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     LayerStackChange* layerStackChange(change->mutable_layer_stack());
     layerStackChange->set_layer_stack(layerStack);
 }
 
-void SurfaceInterceptor::addCropLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addCrop(Transaction* transaction, int32_t layerId,
         const Rect& rect)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     CropChange* cropChange(change->mutable_crop());
     Rectangle* protoRect(cropChange->mutable_rectangle());
-    setProtoRectLocked(protoRect, rect);
+    setProtoRect(protoRect, rect);
 }
 
-void SurfaceInterceptor::addCornerRadiusLocked(Transaction* transaction, int32_t layerId,
+void SurfaceInterceptor::addCornerRadius(Transaction* transaction, int32_t layerId,
                                        float cornerRadius)
 {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     CornerRadiusChange* cornerRadiusChange(change->mutable_corner_radius());
     cornerRadiusChange->set_corner_radius(cornerRadius);
 }
 
-void SurfaceInterceptor::addBackgroundBlurRadiusLocked(Transaction* transaction, int32_t layerId,
-                                                       int32_t backgroundBlurRadius) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addBackgroundBlurRadius(Transaction* transaction, int32_t layerId,
+                                                 int32_t backgroundBlurRadius) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     BackgroundBlurRadiusChange* blurRadiusChange(change->mutable_background_blur_radius());
     blurRadiusChange->set_background_blur_radius(backgroundBlurRadius);
 }
 
-void SurfaceInterceptor::addBlurRegionsLocked(Transaction* transaction, int32_t layerId,
-                                              const std::vector<BlurRegion>& blurRegions) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addBlurRegions(Transaction* transaction, int32_t layerId,
+                                        const std::vector<BlurRegion>& blurRegions) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     BlurRegionsChange* blurRegionsChange(change->mutable_blur_regions());
     for (const auto blurRegion : blurRegions) {
         const auto blurRegionChange = blurRegionsChange->add_blur_regions();
@@ -372,36 +481,36 @@ void SurfaceInterceptor::addBlurRegionsLocked(Transaction* transaction, int32_t
     }
 }
 
-void SurfaceInterceptor::addReparentLocked(Transaction* transaction, int32_t layerId,
-                                           int32_t parentId) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addReparent(Transaction* transaction, int32_t layerId,
+                                     int32_t parentId) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     ReparentChange* overrideChange(change->mutable_reparent());
     overrideChange->set_parent_id(parentId);
 }
 
-void SurfaceInterceptor::addRelativeParentLocked(Transaction* transaction, int32_t layerId,
-                                                 int32_t parentId, int z) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addRelativeParent(Transaction* transaction, int32_t layerId,
+                                           int32_t parentId, int z) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     RelativeParentChange* overrideChange(change->mutable_relative_parent());
     overrideChange->set_relative_parent_id(parentId);
     overrideChange->set_z(z);
 }
 
-void SurfaceInterceptor::addShadowRadiusLocked(Transaction* transaction, int32_t layerId,
-                                               float shadowRadius) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addShadowRadius(Transaction* transaction, int32_t layerId,
+                                         float shadowRadius) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     ShadowRadiusChange* overrideChange(change->mutable_shadow_radius());
     overrideChange->set_radius(shadowRadius);
 }
 
-void SurfaceInterceptor::addTrustedOverlayLocked(Transaction* transaction, int32_t layerId,
-                                                 bool isTrustedOverlay) {
-    SurfaceChange* change(createSurfaceChangeLocked(transaction, layerId));
+void SurfaceInterceptor::addTrustedOverlay(Transaction* transaction, int32_t layerId,
+                                           bool isTrustedOverlay) {
+    SurfaceChange* change(createSurfaceChange(transaction, layerId));
     TrustedOverlayChange* overrideChange(change->mutable_trusted_overlay());
     overrideChange->set_is_trusted_overlay(isTrustedOverlay);
 }
 
-void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
+void SurfaceInterceptor::addSurfaceChanges(Transaction* transaction,
         const layer_state_t& state)
 {
     const sp<const Layer> layer(getLayer(state.surface));
@@ -414,83 +523,82 @@ void SurfaceInterceptor::addSurfaceChangesLocked(Transaction* transaction,
     const int32_t layerId(getLayerId(layer));
 
     if (state.what & layer_state_t::ePositionChanged) {
-        addPositionLocked(transaction, layerId, state.x, state.y);
+        addPosition(transaction, layerId, state.x, state.y);
     }
     if (state.what & layer_state_t::eLayerChanged) {
-        addDepthLocked(transaction, layerId, state.z);
+        addDepth(transaction, layerId, state.z);
     }
     if (state.what & layer_state_t::eSizeChanged) {
-        addSizeLocked(transaction, layerId, state.w, state.h);
+        addSize(transaction, layerId, state.w, state.h);
     }
     if (state.what & layer_state_t::eAlphaChanged) {
-        addAlphaLocked(transaction, layerId, state.alpha);
+        addAlpha(transaction, layerId, state.alpha);
     }
     if (state.what & layer_state_t::eMatrixChanged) {
-        addMatrixLocked(transaction, layerId, state.matrix);
+        addMatrix(transaction, layerId, state.matrix);
     }
     if (state.what & layer_state_t::eTransparentRegionChanged) {
-        addTransparentRegionLocked(transaction, layerId, state.transparentRegion);
+        addTransparentRegion(transaction, layerId, state.transparentRegion);
     }
     if (state.what & layer_state_t::eFlagsChanged) {
-        addFlagsLocked(transaction, layerId, state.flags, state.mask);
+        addFlags(transaction, layerId, state.flags, state.mask);
     }
     if (state.what & layer_state_t::eLayerStackChanged) {
-        addLayerStackLocked(transaction, layerId, state.layerStack);
+        addLayerStack(transaction, layerId, state.layerStack);
     }
     if (state.what & layer_state_t::eCropChanged) {
-        addCropLocked(transaction, layerId, state.crop);
+        addCrop(transaction, layerId, state.crop);
     }
     if (state.what & layer_state_t::eCornerRadiusChanged) {
-        addCornerRadiusLocked(transaction, layerId, state.cornerRadius);
+        addCornerRadius(transaction, layerId, state.cornerRadius);
     }
     if (state.what & layer_state_t::eBackgroundBlurRadiusChanged) {
-        addBackgroundBlurRadiusLocked(transaction, layerId, state.backgroundBlurRadius);
+        addBackgroundBlurRadius(transaction, layerId, state.backgroundBlurRadius);
     }
     if (state.what & layer_state_t::eBlurRegionsChanged) {
-        addBlurRegionsLocked(transaction, layerId, state.blurRegions);
+        addBlurRegions(transaction, layerId, state.blurRegions);
     }
     if (state.what & layer_state_t::eReparent) {
         auto parentHandle = (state.parentSurfaceControlForChild)
                 ? state.parentSurfaceControlForChild->getHandle()
                 : nullptr;
-        addReparentLocked(transaction, layerId, getLayerIdFromHandle(parentHandle));
+        addReparent(transaction, layerId, getLayerIdFromHandle(parentHandle));
     }
     if (state.what & layer_state_t::eRelativeLayerChanged) {
-        addRelativeParentLocked(transaction, layerId,
-                                getLayerIdFromHandle(
-                                        state.relativeLayerSurfaceControl->getHandle()),
-                                state.z);
+        addRelativeParent(transaction, layerId,
+                          getLayerIdFromHandle(state.relativeLayerSurfaceControl->getHandle()),
+                          state.z);
     }
     if (state.what & layer_state_t::eShadowRadiusChanged) {
-        addShadowRadiusLocked(transaction, layerId, state.shadowRadius);
+        addShadowRadius(transaction, layerId, state.shadowRadius);
     }
     if (state.what & layer_state_t::eTrustedOverlayChanged) {
-        addTrustedOverlayLocked(transaction, layerId, state.isTrustedOverlay);
+        addTrustedOverlay(transaction, layerId, state.isTrustedOverlay);
     }
     if (state.what & layer_state_t::eStretchChanged) {
         ALOGW("SurfaceInterceptor not implemented for eStretchChanged");
     }
 }
 
-void SurfaceInterceptor::addDisplayChangesLocked(Transaction* transaction,
+void SurfaceInterceptor::addDisplayChanges(Transaction* transaction,
         const DisplayState& state, int32_t sequenceId)
 {
     if (state.what & DisplayState::eSurfaceChanged) {
-        addDisplaySurfaceLocked(transaction, sequenceId, state.surface);
+        addDisplaySurface(transaction, sequenceId, state.surface);
     }
     if (state.what & DisplayState::eLayerStackChanged) {
-        addDisplayLayerStackLocked(transaction, sequenceId, state.layerStack);
+        addDisplayLayerStack(transaction, sequenceId, state.layerStack);
     }
     if (state.what & DisplayState::eDisplaySizeChanged) {
-        addDisplaySizeLocked(transaction, sequenceId, state.width, state.height);
+        addDisplaySize(transaction, sequenceId, state.width, state.height);
     }
     if (state.what & DisplayState::eDisplayProjectionChanged) {
-        addDisplayProjectionLocked(transaction, sequenceId, toRotationInt(state.orientation),
-                                   state.layerStackSpaceRect, state.orientedDisplaySpaceRect);
+        addDisplayProjection(transaction, sequenceId, toRotationInt(state.orientation),
+                             state.layerStackSpaceRect, state.orientedDisplaySpaceRect);
     }
 }
 
-void SurfaceInterceptor::addTransactionLocked(
+void SurfaceInterceptor::addTransaction(
         Increment* increment, const Vector<ComposerState>& stateUpdates,
         const DefaultKeyedVector<wp<IBinder>, DisplayDeviceState>& displays,
         const Vector<DisplayState>& changedDisplays, uint32_t transactionFlags, int originPid,
@@ -498,21 +606,21 @@ void SurfaceInterceptor::addTransactionLocked(
     Transaction* transaction(increment->mutable_transaction());
     transaction->set_synchronous(transactionFlags & BnSurfaceComposer::eSynchronous);
     transaction->set_animation(transactionFlags & BnSurfaceComposer::eAnimation);
-    setTransactionOriginLocked(transaction, originPid, originUid);
+    setTransactionOrigin(transaction, originPid, originUid);
     transaction->set_id(transactionId);
     for (const auto& compState: stateUpdates) {
-        addSurfaceChangesLocked(transaction, compState.state);
+        addSurfaceChanges(transaction, compState.state);
     }
     for (const auto& disp: changedDisplays) {
         ssize_t dpyIdx = displays.indexOfKey(disp.token);
         if (dpyIdx >= 0) {
             const DisplayDeviceState& dispState(displays.valueAt(dpyIdx));
-            addDisplayChangesLocked(transaction, disp, dispState.sequenceId);
+            addDisplayChanges(transaction, disp, dispState.sequenceId);
         }
     }
 }
 
-void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
+void SurfaceInterceptor::addSurfaceCreation(Increment* increment,
         const sp<const Layer>& layer)
 {
     SurfaceCreation* creation(increment->mutable_surface_creation());
@@ -522,14 +630,14 @@ void SurfaceInterceptor::addSurfaceCreationLocked(Increment* increment,
     creation->set_h(layer->mDrawingState.active_legacy.h);
 }
 
-void SurfaceInterceptor::addSurfaceDeletionLocked(Increment* increment,
+void SurfaceInterceptor::addSurfaceDeletion(Increment* increment,
         const sp<const Layer>& layer)
 {
     SurfaceDeletion* deletion(increment->mutable_surface_deletion());
     deletion->set_id(getLayerId(layer));
 }
 
-void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, int32_t layerId,
+void SurfaceInterceptor::addBufferUpdate(Increment* increment, int32_t layerId,
         uint32_t width, uint32_t height, uint64_t frameNumber)
 {
     BufferUpdate* update(increment->mutable_buffer_update());
@@ -539,12 +647,12 @@ void SurfaceInterceptor::addBufferUpdateLocked(Increment* increment, int32_t lay
     update->set_frame_number(frameNumber);
 }
 
-void SurfaceInterceptor::addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp) {
+void SurfaceInterceptor::addVSyncUpdate(Increment* increment, nsecs_t timestamp) {
     VSyncEvent* event(increment->mutable_vsync_event());
     event->set_when(timestamp);
 }
 
-void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32_t sequenceId,
+void SurfaceInterceptor::addDisplaySurface(Transaction* transaction, int32_t sequenceId,
         const sp<const IGraphicBufferProducer>& surface)
 {
     if (surface == nullptr) {
@@ -553,7 +661,7 @@ void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32
     uint64_t bufferQueueId = 0;
     status_t err(surface->getUniqueId(&bufferQueueId));
     if (err == NO_ERROR) {
-        DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
+        DisplayChange* dispChange(createDisplayChange(transaction, sequenceId));
         DispSurfaceChange* surfaceChange(dispChange->mutable_surface());
         surfaceChange->set_buffer_queue_id(bufferQueueId);
         surfaceChange->set_buffer_queue_name(surface->getConsumerName().string());
@@ -564,36 +672,36 @@ void SurfaceInterceptor::addDisplaySurfaceLocked(Transaction* transaction, int32
     }
 }
 
-void SurfaceInterceptor::addDisplayLayerStackLocked(Transaction* transaction,
+void SurfaceInterceptor::addDisplayLayerStack(Transaction* transaction,
         int32_t sequenceId, uint32_t layerStack)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
+    DisplayChange* dispChange(createDisplayChange(transaction, sequenceId));
     LayerStackChange* layerStackChange(dispChange->mutable_layer_stack());
     layerStackChange->set_layer_stack(layerStack);
 }
 
-void SurfaceInterceptor::addDisplaySizeLocked(Transaction* transaction, int32_t sequenceId,
+void SurfaceInterceptor::addDisplaySize(Transaction* transaction, int32_t sequenceId,
         uint32_t w, uint32_t h)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
+    DisplayChange* dispChange(createDisplayChange(transaction, sequenceId));
     SizeChange* sizeChange(dispChange->mutable_size());
     sizeChange->set_w(w);
     sizeChange->set_h(h);
 }
 
-void SurfaceInterceptor::addDisplayProjectionLocked(Transaction* transaction,
+void SurfaceInterceptor::addDisplayProjection(Transaction* transaction,
         int32_t sequenceId, int32_t orientation, const Rect& viewport, const Rect& frame)
 {
-    DisplayChange* dispChange(createDisplayChangeLocked(transaction, sequenceId));
+    DisplayChange* dispChange(createDisplayChange(transaction, sequenceId));
     ProjectionChange* projectionChange(dispChange->mutable_projection());
     projectionChange->set_orientation(orientation);
     Rectangle* viewportRect(projectionChange->mutable_viewport());
-    setProtoRectLocked(viewportRect, viewport);
+    setProtoRect(viewportRect, viewport);
     Rectangle* frameRect(projectionChange->mutable_frame());
-    setProtoRectLocked(frameRect, frame);
+    setProtoRect(frameRect, frame);
 }
 
-void SurfaceInterceptor::addDisplayCreationLocked(Increment* increment,
+void SurfaceInterceptor::addDisplayCreation(Increment* increment,
         const DisplayDeviceState& info)
 {
     DisplayCreation* creation(increment->mutable_display_creation());
@@ -605,12 +713,12 @@ void SurfaceInterceptor::addDisplayCreationLocked(Increment* increment,
     }
 }
 
-void SurfaceInterceptor::addDisplayDeletionLocked(Increment* increment, int32_t sequenceId) {
+void SurfaceInterceptor::addDisplayDeletion(Increment* increment, int32_t sequenceId) {
     DisplayDeletion* deletion(increment->mutable_display_deletion());
     deletion->set_id(sequenceId);
 }
 
-void SurfaceInterceptor::addPowerModeUpdateLocked(Increment* increment, int32_t sequenceId,
+void SurfaceInterceptor::addPowerModeUpdate(Increment* increment, int32_t sequenceId,
         int32_t mode)
 {
     PowerModeUpdate* powerModeUpdate(increment->mutable_power_mode_update());
@@ -627,9 +735,10 @@ void SurfaceInterceptor::saveTransaction(
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addTransactionLocked(createTraceIncrementLocked(), stateUpdates, displays, changedDisplays,
-                         flags, originPid, originUid, transactionId);
+    Increment increment(createTraceIncrement());
+    addTransaction(&increment, stateUpdates, displays, changedDisplays, flags, originPid, originUid,
+                   transactionId);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
@@ -637,8 +746,9 @@ void SurfaceInterceptor::saveSurfaceCreation(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceCreationLocked(createTraceIncrementLocked(), layer);
+    Increment increment(createTraceIncrement());
+    addSurfaceCreation(&increment, layer);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
@@ -646,8 +756,9 @@ void SurfaceInterceptor::saveSurfaceDeletion(const sp<const Layer>& layer) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addSurfaceDeletionLocked(createTraceIncrementLocked(), layer);
+    Increment increment(createTraceIncrement());
+    addSurfaceDeletion(&increment, layer);
+    addIncrement(std::move(increment));
 }
 
 /**
@@ -664,16 +775,18 @@ void SurfaceInterceptor::saveBufferUpdate(int32_t layerId, uint32_t width,
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addBufferUpdateLocked(createTraceIncrementLocked(), layerId, width, height, frameNumber);
+    Increment increment(createTraceIncrement());
+    addBufferUpdate(&increment, layerId, width, height, frameNumber);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::saveVSyncEvent(nsecs_t timestamp) {
     if (!mEnabled) {
         return;
     }
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addVSyncUpdateLocked(createTraceIncrementLocked(), timestamp);
+    Increment increment(createTraceIncrement());
+    addVSyncUpdate(&increment, timestamp);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
@@ -681,8 +794,9 @@ void SurfaceInterceptor::saveDisplayCreation(const DisplayDeviceState& info) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayCreationLocked(createTraceIncrementLocked(), info);
+    Increment increment(createTraceIncrement());
+    addDisplayCreation(&increment, info);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
@@ -690,8 +804,9 @@ void SurfaceInterceptor::saveDisplayDeletion(int32_t sequenceId) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addDisplayDeletionLocked(createTraceIncrementLocked(), sequenceId);
+    Increment increment(createTraceIncrement());
+    addDisplayDeletion(&increment, sequenceId);
+    addIncrement(std::move(increment));
 }
 
 void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
@@ -699,8 +814,9 @@ void SurfaceInterceptor::savePowerModeUpdate(int32_t sequenceId, int32_t mode) {
         return;
     }
     ATRACE_CALL();
-    std::lock_guard<std::mutex> protoGuard(mTraceMutex);
-    addPowerModeUpdateLocked(createTraceIncrementLocked(), sequenceId, mode);
+    Increment increment(createTraceIncrement());
+    addPowerModeUpdate(&increment, sequenceId, mode);
+    addIncrement(std::move(increment));
 }
 
 } // namespace impl
@@ -19,9 +19,17 @@
 
 #include <frameworks/native/cmds/surfacereplayer/proto/src/trace.pb.h>
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <string>
+#include <thread>
 
+#include <android-base/thread_annotations.h>
+#include <android-base/unique_fd.h>
 #include <binder/IBinder.h>
+#include <ftl/concurrent_queue.h>
 
 #include <gui/LayerState.h>
 
@@ -89,11 +97,16 @@ namespace impl {
 /*
  * SurfaceInterceptor intercepts and stores incoming streams of window
  * properties on SurfaceFlinger.
+ *
+ * Increments are built on the intercepting thread, and queued without locking for a writer
+ * thread, which encodes them in batches. The encoded trace is either kept in memory until the
+ * interceptor is disabled, or streamed to the output file as it grows if
+ * debug.sf.interceptor_stream is set.
  */
 class SurfaceInterceptor final : public android::SurfaceInterceptor {
 public:
     SurfaceInterceptor() = default;
-    ~SurfaceInterceptor() override = default;
+    ~SurfaceInterceptor() override;
 
     // Both vectors are used to capture the current state of SF as the initial snapshot in the trace
     void enable(const SortedVector<sp<Layer>>& layers,
@@ -126,79 +139,100 @@ private:
     // The creation increments of Surfaces and Displays do not contain enough information to capture
     // the initial state of each object, so a transaction with all of the missing properties is
     // performed at the initial snapshot for each display and surface.
-    void saveExistingDisplaysLocked(
+    void saveExistingDisplays(
             const DefaultKeyedVector< wp<IBinder>, DisplayDeviceState>& displays);
-    void saveExistingSurfacesLocked(const SortedVector<sp<Layer>>& layers);
-    void addInitialSurfaceStateLocked(Increment* increment, const sp<const Layer>& layer);
-    void addInitialDisplayStateLocked(Increment* increment, const DisplayDeviceState& display);
+    void saveExistingSurfaces(const SortedVector<sp<Layer>>& layers);
+    void addInitialSurfaceState(Increment* increment, const sp<const Layer>& layer);
+    void addInitialDisplayState(Increment* increment, const DisplayDeviceState& display);
+
+    // The writer thread runs while the interceptor is enabled.
+    void startWriter() REQUIRES(mTraceMutex);
+    void stopWriter() REQUIRES(mTraceMutex);
+    void threadMain();
+    void writeIncrements();
+    status_t writeProtoFile() REQUIRES(mTraceMutex);
 
-    status_t writeProtoFileLocked();
     const sp<const Layer> getLayer(const wp<IBinder>& weakHandle) const;
     int32_t getLayerId(const sp<const Layer>& layer) const;
     int32_t getLayerIdFromWeakRef(const wp<const Layer>& layer) const;
     int32_t getLayerIdFromHandle(const sp<IBinder>& weakHandle) const;
 
-    Increment* createTraceIncrementLocked();
-    void addSurfaceCreationLocked(Increment* increment, const sp<const Layer>& layer);
-    void addSurfaceDeletionLocked(Increment* increment, const sp<const Layer>& layer);
-    void addBufferUpdateLocked(Increment* increment, int32_t layerId, uint32_t width,
+    Increment createTraceIncrement();
+    void addIncrement(Increment&& increment);
+    void addSurfaceCreation(Increment* increment, const sp<const Layer>& layer);
+    void addSurfaceDeletion(Increment* increment, const sp<const Layer>& layer);
+    void addBufferUpdate(Increment* increment, int32_t layerId, uint32_t width,
             uint32_t height, uint64_t frameNumber);
-    void addVSyncUpdateLocked(Increment* increment, nsecs_t timestamp);
-    void addDisplayCreationLocked(Increment* increment, const DisplayDeviceState& info);
-    void addDisplayDeletionLocked(Increment* increment, int32_t sequenceId);
-    void addPowerModeUpdateLocked(Increment* increment, int32_t sequenceId, int32_t mode);
+    void addVSyncUpdate(Increment* increment, nsecs_t timestamp);
+    void addDisplayCreation(Increment* increment, const DisplayDeviceState& info);
+    void addDisplayDeletion(Increment* increment, int32_t sequenceId);
+    void addPowerModeUpdate(Increment* increment, int32_t sequenceId, int32_t mode);
 
     // Add surface transactions to the trace
-    SurfaceChange* createSurfaceChangeLocked(Transaction* transaction, int32_t layerId);
-    void setProtoRectLocked(Rectangle* protoRect, const Rect& rect);
-    void addPositionLocked(Transaction* transaction, int32_t layerId, float x, float y);
-    void addDepthLocked(Transaction* transaction, int32_t layerId, uint32_t z);
-    void addSizeLocked(Transaction* transaction, int32_t layerId, uint32_t w, uint32_t h);
-    void addAlphaLocked(Transaction* transaction, int32_t layerId, float alpha);
-    void addMatrixLocked(Transaction* transaction, int32_t layerId,
+    SurfaceChange* createSurfaceChange(Transaction* transaction, int32_t layerId);
+    void setProtoRect(Rectangle* protoRect, const Rect& rect);
+    void addPosition(Transaction* transaction, int32_t layerId, float x, float y);
+    void addDepth(Transaction* transaction, int32_t layerId, uint32_t z);
+    void addSize(Transaction* transaction, int32_t layerId, uint32_t w, uint32_t h);
+    void addAlpha(Transaction* transaction, int32_t layerId, float alpha);
+    void addMatrix(Transaction* transaction, int32_t layerId,
             const layer_state_t::matrix22_t& matrix);
-    void addTransparentRegionLocked(Transaction* transaction, int32_t layerId,
+    void addTransparentRegion(Transaction* transaction, int32_t layerId,
             const Region& transRegion);
-    void addFlagsLocked(Transaction* transaction, int32_t layerId, uint8_t flags, uint8_t mask);
-    void addLayerStackLocked(Transaction* transaction, int32_t layerId, uint32_t layerStack);
-    void addCropLocked(Transaction* transaction, int32_t layerId, const Rect& rect);
-    void addCornerRadiusLocked(Transaction* transaction, int32_t layerId, float cornerRadius);
-    void addBackgroundBlurRadiusLocked(Transaction* transaction, int32_t layerId,
-                                       int32_t backgroundBlurRadius);
-    void addBlurRegionsLocked(Transaction* transaction, int32_t layerId,
-                              const std::vector<BlurRegion>& effectRegions);
-    void addSurfaceChangesLocked(Transaction* transaction, const layer_state_t& state);
-    void addTransactionLocked(Increment* increment, const Vector<ComposerState>& stateUpdates,
-                              const DefaultKeyedVector<wp<IBinder>, DisplayDeviceState>& displays,
-                              const Vector<DisplayState>& changedDisplays,
-                              uint32_t transactionFlags, int originPid, int originUid,
-                              uint64_t transactionId);
-    void addReparentLocked(Transaction* transaction, int32_t layerId, int32_t parentId);
-    void addRelativeParentLocked(Transaction* transaction, int32_t layerId, int32_t parentId,
-                                 int z);
-    void addShadowRadiusLocked(Transaction* transaction, int32_t layerId, float shadowRadius);
-    void addTrustedOverlayLocked(Transaction* transaction, int32_t layerId, bool isTrustedOverlay);
+    void addFlags(Transaction* transaction, int32_t layerId, uint8_t flags, uint8_t mask);
+    void addLayerStack(Transaction* transaction, int32_t layerId, uint32_t layerStack);
+    void addCrop(Transaction* transaction, int32_t layerId, const Rect& rect);
+    void addCornerRadius(Transaction* transaction, int32_t layerId, float cornerRadius);
+    void addBackgroundBlurRadius(Transaction* transaction, int32_t layerId,
+                                 int32_t backgroundBlurRadius);
+    void addBlurRegions(Transaction* transaction, int32_t layerId,
+                        const std::vector<BlurRegion>& effectRegions);
+    void addSurfaceChanges(Transaction* transaction, const layer_state_t& state);
+    void addTransaction(Increment* increment, const Vector<ComposerState>& stateUpdates,
+                        const DefaultKeyedVector<wp<IBinder>, DisplayDeviceState>& displays,
+                        const Vector<DisplayState>& changedDisplays,
+                        uint32_t transactionFlags, int originPid, int originUid,
+                        uint64_t transactionId);
+    void addReparent(Transaction* transaction, int32_t layerId, int32_t parentId);
+    void addRelativeParent(Transaction* transaction, int32_t layerId, int32_t parentId,
+                           int z);
+    void addShadowRadius(Transaction* transaction, int32_t layerId, float shadowRadius);
+    void addTrustedOverlay(Transaction* transaction, int32_t layerId, bool isTrustedOverlay);
 
     // Add display transactions to the trace
-    DisplayChange* createDisplayChangeLocked(Transaction* transaction, int32_t sequenceId);
-    void addDisplaySurfaceLocked(Transaction* transaction, int32_t sequenceId,
+    DisplayChange* createDisplayChange(Transaction* transaction, int32_t sequenceId);
+    void addDisplaySurface(Transaction* transaction, int32_t sequenceId,
             const sp<const IGraphicBufferProducer>& surface);
-    void addDisplayLayerStackLocked(Transaction* transaction, int32_t sequenceId,
+    void addDisplayLayerStack(Transaction* transaction, int32_t sequenceId,
             uint32_t layerStack);
-    void addDisplaySizeLocked(Transaction* transaction, int32_t sequenceId, uint32_t w,
+    void addDisplaySize(Transaction* transaction, int32_t sequenceId, uint32_t w,
             uint32_t h);
-    void addDisplayProjectionLocked(Transaction* transaction, int32_t sequenceId,
+    void addDisplayProjection(Transaction* transaction, int32_t sequenceId,
             int32_t orientation, const Rect& viewport, const Rect& frame);
-    void addDisplayChangesLocked(Transaction* transaction,
+    void addDisplayChanges(Transaction* transaction,
             const DisplayState& state, int32_t sequenceId);
 
     // Add transaction origin to trace
-    void setTransactionOriginLocked(Transaction* transaction, int32_t pid, int32_t uid);
+    void setTransactionOrigin(Transaction* transaction, int32_t pid, int32_t uid);
+
+    // Queued increments are encoded this often, so that each write covers a batch of them.
+    static constexpr std::chrono::milliseconds kWriterInterval{100};
 
-    bool mEnabled {false};
+    std::atomic<bool> mEnabled {false};
     std::string mOutputFileName {DEFAULT_FILENAME};
+    // Serializes enabling and disabling the interceptor, and thereby the writer thread's lifetime.
     std::mutex mTraceMutex {};
-    Trace mTrace {};
+    ftl::UnboundedMpscQueue<Increment> mPendingIncrements;
+    // Only touched by the writer thread while it runs, and by the thread toggling the interceptor
+    // otherwise.
+    std::string mEncodedTrace;
+    base::unique_fd mStreamFd;
+
+    std::mutex mWriterMutex;
+    std::condition_variable mWriterCondition;
+    bool mWriterRunning GUARDED_BY(mWriterMutex) = false;
+    std::thread mWriterThread;
+
     std::mutex mListenersMutex;
     std::map<wp<IBinder>, sp<gui::ITransactionTraceListener>> mTraceToggledListeners
             GUARDED_BY(mListenersMutex);
@@ -24,6 +24,7 @@
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <log/log.h>
+#include <pthread.h>
 #include <utils/SystemClock.h>
 #include <utils/Trace.h>
 
@@ -48,12 +49,17 @@ bool SurfaceTracing::enable() {
 }
 
 bool SurfaceTracing::disable() {
-    std::scoped_lock lock(mTraceLock);
-    if (!mEnabled) {
-        return false;
+    std::unique_ptr<Runner> stoppedRunner;
+    {
+        std::scoped_lock lock(mTraceLock);
+        if (!mEnabled) {
+            return false;
+        }
+        mEnabled = false;
+        stoppedRunner = std::move(runner);
     }
-    mEnabled = false;
-    runner->stop();
+    // Write the trace without the lock, so that the drawing thread is not blocked meanwhile.
+    stoppedRunner->stop();
     return true;
 }
 
@@ -63,11 +69,16 @@ bool SurfaceTracing::isEnabled() const {
 }
 
 status_t SurfaceTracing::writeToFile() {
-    std::scoped_lock lock(mTraceLock);
-    if (!mEnabled) {
-        return STATUS_OK;
+    std::future<status_t> written;
+    {
+        std::scoped_lock lock(mTraceLock);
+        if (!mEnabled) {
+            return STATUS_OK;
+        }
+        written = runner->requestWriteToFile();
     }
-    return runner->writeToFile();
+    // Wait without the lock, so that the drawing thread can keep adding entries meanwhile.
+    return written.get();
 }
 
 void SurfaceTracing::notify(const char* where) {
@@ -92,52 +103,96 @@ void SurfaceTracing::dump(std::string& result) const {
     }
 }
 
-void SurfaceTracing::LayersTraceBuffer::reset(size_t newSize) {
-    // use the swap trick to make sure memory is released
-    std::queue<LayersTraceProto>().swap(mStorage);
-    mSizeInBytes = newSize;
-    mUsedInBytes = 0U;
+SurfaceTracing::LayersTraceBuffer::LayersTraceBuffer(size_t sizeInBytes)
+      : mSizeInBytes(sizeInBytes) {
+    mThread = std::thread(&LayersTraceBuffer::threadMain, this);
+    pthread_setname_np(mThread.native_handle(), "SurfaceTracing");
+}
+
+SurfaceTracing::LayersTraceBuffer::~LayersTraceBuffer() {
+    {
+        std::scoped_lock lock(mMutex);
+        mRunning = false;
+    }
+    mCondition.notify_one();
+    mThread.join();
 }
 
 void SurfaceTracing::LayersTraceBuffer::emplace(LayersTraceProto&& proto) {
-    size_t protoSize = static_cast<size_t>(proto.ByteSize());
-    while (mUsedInBytes + protoSize > mSizeInBytes) {
-        if (mStorage.empty()) {
+    {
+        std::scoped_lock lock(mMutex);
+        if (mPendingEntries.size() >= kMaxPendingEntries) {
+            mDroppedEntries++;
             return;
         }
-        mUsedInBytes -= static_cast<size_t>(mStorage.front().ByteSize());
-        mStorage.pop();
+        mPendingEntries.emplace();
+        mPendingEntries.back().Swap(&proto);
     }
-    mUsedInBytes += protoSize;
-    mStorage.emplace();
-    mStorage.back().Swap(&proto);
+    mCondition.notify_one();
 }
 
-void SurfaceTracing::LayersTraceBuffer::flush(LayersTraceFileProto* fileProto) {
-    fileProto->mutable_entry()->Reserve(static_cast<int>(mStorage.size()));
-
-    while (!mStorage.empty()) {
-        auto entry = fileProto->add_entry();
-        entry->Swap(&mStorage.front());
-        mStorage.pop();
+std::future<status_t> SurfaceTracing::LayersTraceBuffer::writeToFile() {
+    std::future<status_t> written;
+    {
+        std::scoped_lock lock(mMutex);
+        written = mPendingWrites.emplace_back().get_future();
     }
+    mCondition.notify_one();
+    return written;
 }
 
-SurfaceTracing::Runner::Runner(SurfaceFlinger& flinger, SurfaceTracing::Config& config)
-      : mFlinger(flinger), mConfig(config) {
-    mBuffer.setSize(mConfig.bufferSize);
-}
-
-void SurfaceTracing::Runner::notify(const char* where) {
-    LayersTraceProto entry = traceLayers(where);
-    mBuffer.emplace(std::move(entry));
-}
-
-status_t SurfaceTracing::Runner::stop() {
-    return writeToFile();
+void SurfaceTracing::LayersTraceBuffer::threadMain() NO_THREAD_SAFETY_ANALYSIS {
+    std::unique_lock lock(mMutex);
+    while (true) {
+        mCondition.wait(lock, [this] {
+            return !mRunning || !mPendingEntries.empty() || !mPendingWrites.empty();
+        });
+
+        // Entries added before a write are encoded before writing, pending ones before exiting.
+        if (!mPendingEntries.empty()) {
+            LayersTraceFileProto fileProto;
+            fileProto.add_entry()->Swap(&mPendingEntries.front());
+            mPendingEntries.pop();
+            lock.unlock();
+
+            ATRACE_NAME("encode trace entry");
+            std::string entry;
+            const bool encoded = fileProto.SerializeToString(&entry);
+            // Free the proto off the lock, as it is a tree of many small allocations.
+            fileProto.Clear();
+
+            lock.lock();
+            if (!encoded || entry.size() > mSizeInBytes) {
+                mDroppedEntries++;
+                continue;
+            }
+            while (mUsedInBytes + entry.size() > mSizeInBytes) {
+                mUsedInBytes -= mEntries.front().size();
+                mEntries.pop_front();
+            }
+            mUsedInBytes += entry.size();
+            mEntries.push_back(std::move(entry));
+        } else if (!mPendingWrites.empty()) {
+            std::vector<std::promise<status_t>> writes = std::move(mPendingWrites);
+            mPendingWrites.clear();
+            std::deque<std::string> entries = std::move(mEntries);
+            mEntries.clear();
+            mUsedInBytes = 0U;
+            lock.unlock();
+
+            const status_t result = writeEntriesToFile(std::move(entries));
+            for (auto& write : writes) {
+                write.set_value(result);
+            }
+
+            lock.lock();
+        } else if (!mRunning) {
+            break;
+        }
+    }
 }
 
-status_t SurfaceTracing::Runner::writeToFile() {
+status_t SurfaceTracing::LayersTraceBuffer::writeEntriesToFile(std::deque<std::string>&& entries) {
     ATRACE_CALL();
 
     LayersTraceFileProto fileProto;
@@ -145,14 +200,22 @@ status_t SurfaceTracing::Runner::writeToFile() {
 
     fileProto.set_magic_number(uint64_t(LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_H) << 32 |
                                LayersTraceFileProto_MagicNumber_MAGIC_NUMBER_L);
-    mBuffer.flush(&fileProto);
-    mBuffer.reset(mConfig.bufferSize);
-
     if (!fileProto.SerializeToString(&output)) {
         ALOGE("Could not save the proto file! Permission denied");
         return PERMISSION_DENIED;
     }
 
+    // Concatenated messages are parsed as their merge, which appends the repeated entries.
+    size_t outputSize = output.size();
+    for (const auto& entry : entries) {
+        outputSize += entry.size();
+    }
+    output.reserve(outputSize);
+    while (!entries.empty()) {
+        output.append(entries.front());
+        entries.pop_front();
+    }
+
     // -rw-r--r--
     const mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
     if (!android::base::WriteStringToFile(output, DEFAULT_FILE_NAME, mode, getuid(), getgid(),
@@ -164,6 +227,30 @@ status_t SurfaceTracing::Runner::writeToFile() {
     return NO_ERROR;
 }
 
+void SurfaceTracing::LayersTraceBuffer::dump(std::string& result) const {
+    std::scoped_lock lock(mMutex);
+    base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n", mEntries.size(),
+                        float(mUsedInBytes) / float(1_MB), float(mSizeInBytes) / float(1_MB));
+    base::StringAppendF(&result, "  pending entries: %zu, dropped entries: %u\n",
+                        mPendingEntries.size(), mDroppedEntries);
+}
+
+SurfaceTracing::Runner::Runner(SurfaceFlinger& flinger, SurfaceTracing::Config& config)
+      : mFlinger(flinger), mConfig(config), mBuffer(mConfig.bufferSize) {}
+
+void SurfaceTracing::Runner::notify(const char* where) {
+    LayersTraceProto entry = traceLayers(where);
+    mBuffer.emplace(std::move(entry));
+}
+
+status_t SurfaceTracing::Runner::stop() {
+    return writeToFile();
+}
+
+std::future<status_t> SurfaceTracing::Runner::requestWriteToFile() {
+    return mBuffer.writeToFile();
+}
+
 LayersTraceProto SurfaceTracing::Runner::traceLayers(const char* where) {
     ATRACE_CALL();
 
@@ -191,9 +278,7 @@ LayersTraceProto SurfaceTracing::Runner::traceLayers(const char* where) {
 }
 
 void SurfaceTracing::Runner::dump(std::string& result) const {
-    base::StringAppendF(&result, "  number of entries: %zu (%.2fMB / %.2fMB)\n",
-                        mBuffer.frameCount(), float(mBuffer.used()) / float(1_MB),
-                        float(mBuffer.size()) / float(1_MB));
+    mBuffer.dump(result);
 }
 
 SurfaceTracing::AsyncRunner::AsyncRunner(SurfaceFlinger& flinger, SurfaceTracing::Config& config,
@@ -210,10 +295,6 @@ void SurfaceTracing::AsyncRunner::loop() {
         if (entryAdded) {
             mBuffer.emplace(std::move(entry));
         }
-        if (mWriteToFile) {
-            Runner::writeToFile();
-            mWriteToFile = false;
-        }
     }
 }
 
@@ -243,12 +324,6 @@ void SurfaceTracing::AsyncRunner::notifyLocked(const char* where) {
     mCanStartTrace.notify_one();
 }
 
-status_t SurfaceTracing::AsyncRunner::writeToFile() {
-    mWriteToFile = true;
-    mCanStartTrace.notify_one();
-    return STATUS_OK;
-}
-
 status_t SurfaceTracing::AsyncRunner::stop() {
     mEnabled = false;
     mCanStartTrace.notify_one();
@@ -22,10 +22,14 @@
 #include <utils/StrongPointer.h>
 
 #include <condition_variable>
+#include <deque>
+#include <future>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <vector>
 
 using namespace android::surfaceflinger;
 
@@ -90,23 +94,41 @@ private:
     } mConfig;
 
     /*
-     * ring buffer.
+     * Ring buffer of encoded trace entries, bounded by their encoded size. The entries are encoded,
+     * and the trace file written, on a background thread, so that adding an entry only hands its
+     * proto over to that thread.
      */
     class LayersTraceBuffer {
     public:
-        size_t size() const { return mSizeInBytes; }
-        size_t used() const { return mUsedInBytes; }
-        size_t frameCount() const { return mStorage.size(); }
+        explicit LayersTraceBuffer(size_t sizeInBytes);
+        ~LayersTraceBuffer();
 
-        void setSize(size_t newSize) { mSizeInBytes = newSize; }
-        void reset(size_t newSize);
         void emplace(LayersTraceProto&& proto);
-        void flush(LayersTraceFileProto* fileProto);
+        // Writes the entries added so far to the trace file, and clears the buffer.
+        std::future<status_t> writeToFile();
+        void dump(std::string& result) const;
 
     private:
-        size_t mUsedInBytes = 0U;
-        size_t mSizeInBytes = DEFAULT_BUFFER_SIZE;
-        std::queue<LayersTraceProto> mStorage;
+        void threadMain();
+        status_t writeEntriesToFile(std::deque<std::string>&& entries);
+
+        // Entries are dropped instead of queued when the background thread falls this far behind.
+        static constexpr size_t kMaxPendingEntries = 64;
+
+        const size_t mSizeInBytes;
+
+        mutable std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::queue<LayersTraceProto> mPendingEntries GUARDED_BY(mMutex);
+        std::vector<std::promise<status_t>> mPendingWrites GUARDED_BY(mMutex);
+        // Each entry is encoded as a LayersTraceFileProto holding only that entry, so that the
+        // trace file is the concatenation of the entries.
+        std::deque<std::string> mEntries GUARDED_BY(mMutex);
+        size_t mUsedInBytes GUARDED_BY(mMutex) = 0U;
+        uint32_t mDroppedEntries GUARDED_BY(mMutex) = 0;
+        bool mRunning GUARDED_BY(mMutex) = true;
+
+        std::thread mThread;
     };
 
     /*
@@ -118,7 +140,8 @@ private:
         Runner(SurfaceFlinger& flinger, SurfaceTracing::Config& config);
         virtual ~Runner() = default;
         virtual status_t stop();
-        virtual status_t writeToFile();
+        status_t writeToFile() { return requestWriteToFile().get(); }
+        std::future<status_t> requestWriteToFile();
         virtual void notify(const char* where);
         /* Cannot be called with a synchronous runner. */
         virtual void notifyLocked(const char* /* where */) {}
@@ -143,7 +166,6 @@ private:
         AsyncRunner(SurfaceFlinger& flinger, SurfaceTracing::Config& config, std::mutex& sfLock);
         virtual ~AsyncRunner() = default;
         status_t stop() override;
-        status_t writeToFile() override;
         void notify(const char* where) override;
         void notifyLocked(const char* where);
 
@@ -152,7 +174,6 @@ private:
         std::condition_variable mCanStartTrace;
         std::thread mThread;
         const char* mWhere = "";
-        bool mWriteToFile = false;
         bool mEnabled = false;
         bool mAddEntry = false;
         void loop();
@@ -38,13 +38,14 @@ namespace impl {
 
 namespace {
 
-FrameTimingHistogram histogramToProto(const std::unordered_map<int32_t, int32_t>& histogram,
+FrameTimingHistogram histogramToProto(const std::vector<std::pair<int32_t, int32_t>>& histogram,
                                       size_t maxPulledHistogramBuckets) {
-    auto buckets = std::vector<std::pair<int32_t, int32_t>>(histogram.begin(), histogram.end());
-    std::sort(buckets.begin(), buckets.end(),
-              [](std::pair<int32_t, int32_t>& left, std::pair<int32_t, int32_t>& right) {
-                  return left.second > right.second;
-              });
+    auto buckets = histogram;
+    std::stable_sort(buckets.begin(), buckets.end(),
+                     [](const std::pair<int32_t, int32_t>& left,
+                        const std::pair<int32_t, int32_t>& right) {
+                         return left.second > right.second;
+                     });
 
     FrameTimingHistogram histogramProto;
     int histogramSize = 0;
@@ -95,6 +96,7 @@ bool TimeStats::populateGlobalAtom(std::string* pulledData) {
         return false;
     }
     flushPowerTimeLocked();
+    gatherStatsLocked();
     SurfaceflingerStatsGlobalInfoWrapper atomList;
     for (const auto& globalSlice : mTimeStats.stats) {
         SurfaceflingerStatsGlobalInfo* atom = atomList.add_atom();
@@ -141,6 +143,7 @@ bool TimeStats::populateGlobalAtom(std::string* pulledData) {
 
 bool TimeStats::populateLayerAtom(std::string* pulledData) {
     std::lock_guard<std::mutex> lock(mMutex);
+    gatherStatsLocked();
 
     std::vector<TimeStatsHelper::TimeStatsLayer*> dumpStats;
     uint32_t numLayers = 0;
@@ -296,8 +299,9 @@ std::string TimeStats::miniDump() {
 
     std::string result = "TimeStats miniDump:\n";
     std::lock_guard<std::mutex> lock(mMutex);
+    gatherStatsLocked();
     android::base::StringAppendF(&result, "Number of layers currently being tracked is %zu\n",
-                                 mTimeStatsTracker.size());
+                                 mNumLayerRecords.load());
     android::base::StringAppendF(&result, "Number of layers in the stats pool is %zu\n",
                                  mTimeStats.stats.size());
     return result;
@@ -411,6 +415,14 @@ void TimeStats::recordRenderEngineDuration(nsecs_t startTime,
     mGlobalRecord.renderEngineDurations.push_back({startTime, endTime});
 }
 
+TimeStats::LayerRecordShard& TimeStats::getLayerRecordShard(int32_t layerId) {
+    return mLayerRecordShards[static_cast<uint32_t>(layerId) % NUM_SHARDS];
+}
+
+TimeStats::StatsShard& TimeStats::getStatsShard(uid_t uid) {
+    return mStatsShards[uid % NUM_SHARDS];
+}
+
 bool TimeStats::recordReadyLocked(int32_t layerId, TimeRecord* timeRecord) {
     if (!timeRecord->ready) {
         ALOGV("[%d]-[%" PRIu64 "]-presentFence is still not received", layerId,
@@ -451,14 +463,14 @@ static int32_t clampToNearestBucket(Fps fps, size_t bucketWidth) {
     return std::round(fps.getValue() / bucketWidth) * bucketWidth;
 }
 
-void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
+void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, LayerRecord& layerRecord,
+                                                   Fps displayRefreshRate,
                                                    std::optional<Fps> renderRate,
                                                    SetFrameRateVote frameRateVote,
                                                    int32_t gameMode) {
     ATRACE_CALL();
     ALOGV("[%d]-flushAvailableRecordsToStatsLocked", layerId);
 
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
     TimeRecord& prevTimeRecord = layerRecord.prevTimeRecord;
     std::deque<TimeRecord>& timeRecords = layerRecord.timeRecords;
     const int32_t refreshRateBucket =
@@ -474,12 +486,14 @@ void TimeStats::flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayR
         if (prevTimeRecord.ready) {
             uid_t uid = layerRecord.uid;
             const std::string& layerName = layerRecord.layerName;
+            StatsShard& statsShard = getStatsShard(uid);
+            std::lock_guard<std::mutex> statsLock(statsShard.mutex);
             TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
-            if (!mTimeStats.stats.count(timelineKey)) {
-                mTimeStats.stats[timelineKey].key = timelineKey;
+            if (!statsShard.stats.count(timelineKey)) {
+                statsShard.stats[timelineKey].key = timelineKey;
             }
 
-            TimeStatsHelper::TimelineStats& displayStats = mTimeStats.stats[timelineKey];
+            TimeStatsHelper::TimelineStats& displayStats = statsShard.stats[timelineKey];
 
             TimeStatsHelper::LayerStatsKey layerKey = {uid, layerName, gameMode};
             if (!displayStats.stats.count(layerKey)) {
@@ -555,16 +569,15 @@ static bool layerNameIsValid(const std::string& layerName) {
 
 bool TimeStats::canAddNewAggregatedStats(uid_t uid, const std::string& layerName,
                                          int32_t gameMode) {
-    uint32_t layerRecords = 0;
-    for (const auto& record : mTimeStats.stats) {
+    StatsShard& statsShard = getStatsShard(uid);
+    std::lock_guard<std::mutex> lock(statsShard.mutex);
+    for (const auto& record : statsShard.stats) {
         if (record.second.stats.count({uid, layerName, gameMode}) > 0) {
             return true;
         }
-
-        layerRecords += record.second.stats.size();
     }
 
-    return mTimeStats.stats.size() < MAX_NUM_LAYER_STATS;
+    return statsShard.stats.size() < MAX_NUM_LAYER_STATS;
 }
 
 void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::string& layerName,
@@ -575,22 +588,27 @@ void TimeStats::setPostTime(int32_t layerId, uint64_t frameNumber, const std::st
     ALOGV("[%d]-[%" PRIu64 "]-[%s]-PostTime[%" PRId64 "]", layerId, frameNumber, layerName.c_str(),
           postTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
     if (!canAddNewAggregatedStats(uid, layerName, gameMode)) {
         return;
     }
-    if (!mTimeStatsTracker.count(layerId) && mTimeStatsTracker.size() < MAX_NUM_LAYER_RECORDS &&
-        layerNameIsValid(layerName)) {
-        mTimeStatsTracker[layerId].uid = uid;
-        mTimeStatsTracker[layerId].layerName = layerName;
-        mTimeStatsTracker[layerId].gameMode = gameMode;
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId) && layerNameIsValid(layerName)) {
+        if (mNumLayerRecords.fetch_add(1) < MAX_NUM_LAYER_RECORDS) {
+            shard.records[layerId].uid = uid;
+            shard.records[layerId].layerName = layerName;
+            shard.records[layerId].gameMode = gameMode;
+        } else {
+            mNumLayerRecords--;
+        }
     }
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.timeRecords.size() == MAX_NUM_TIME_RECORDS) {
         ALOGE("[%d]-[%s]-timeRecords is at its maximum size[%zu]. Ignore this when unittesting.",
               layerId, layerRecord.layerName.c_str(), MAX_NUM_TIME_RECORDS);
-        mTimeStatsTracker.erase(layerId);
+        shard.records.erase(layerId);
+        mNumLayerRecords--;
         return;
     }
     // For most media content, the acquireFence is invalid because the buffer is
@@ -618,9 +636,10 @@ void TimeStats::setLatchTime(int32_t layerId, uint64_t frameNumber, nsecs_t latc
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-LatchTime[%" PRId64 "]", layerId, frameNumber, latchTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -637,9 +656,10 @@ void TimeStats::incrementLatchSkipped(int32_t layerId, LatchSkipReason reason) {
     ALOGV("[%d]-LatchSkipped-Reason[%d]", layerId,
           static_cast<std::underlying_type<LatchSkipReason>::type>(reason));
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
 
     switch (reason) {
         case LatchSkipReason::LateAcquire:
@@ -654,9 +674,10 @@ void TimeStats::incrementBadDesiredPresent(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-BadDesiredPresent", layerId);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     layerRecord.badDesiredPresentFrames++;
 }
 
@@ -666,9 +687,10 @@ void TimeStats::setDesiredTime(int32_t layerId, uint64_t frameNumber, nsecs_t de
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-DesiredTime[%" PRId64 "]", layerId, frameNumber, desiredTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -684,9 +706,10 @@ void TimeStats::setAcquireTime(int32_t layerId, uint64_t frameNumber, nsecs_t ac
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-AcquireTime[%" PRId64 "]", layerId, frameNumber, acquireTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -704,9 +727,10 @@ void TimeStats::setAcquireFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-AcquireFenceTime[%" PRId64 "]", layerId, frameNumber,
           acquireFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -724,9 +748,10 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-PresentTime[%" PRId64 "]", layerId, frameNumber, presentTime);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -737,8 +762,8 @@ void TimeStats::setPresentTime(int32_t layerId, uint64_t frameNumber, nsecs_t pr
         layerRecord.waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
+    flushAvailableRecordsToStatsLocked(layerId, layerRecord, displayRefreshRate, renderRate,
+                                       frameRateVote, gameMode);
 }
 
 void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
@@ -751,9 +776,10 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
     ALOGV("[%d]-[%" PRIu64 "]-PresentFenceTime[%" PRId64 "]", layerId, frameNumber,
           presentFence->getSignalTime());
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     if (layerRecord.waitData < 0 ||
         layerRecord.waitData >= static_cast<int32_t>(layerRecord.timeRecords.size()))
         return;
@@ -764,8 +790,8 @@ void TimeStats::setPresentFence(int32_t layerId, uint64_t frameNumber,
         layerRecord.waitData++;
     }
 
-    flushAvailableRecordsToStatsLocked(layerId, displayRefreshRate, renderRate, frameRateVote,
-                                       gameMode);
+    flushAvailableRecordsToStatsLocked(layerId, layerRecord, displayRefreshRate, renderRate,
+                                       frameRateVote, gameMode);
 }
 
 static const constexpr int32_t kValidJankyReason = JankType::DisplayHAL |
@@ -809,7 +835,8 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
     if (!mEnabled.load()) return;
 
     ATRACE_CALL();
-    std::lock_guard<std::mutex> lock(mMutex);
+    StatsShard& statsShard = getStatsShard(info.uid);
+    std::lock_guard<std::mutex> lock(statsShard.mutex);
 
     // Only update layer stats if we're already tracking the layer in TimeStats.
     // Otherwise, continue tracking the statistic but use a default layer name instead.
@@ -832,11 +859,11 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
                                  RENDER_RATE_BUCKET_WIDTH);
     const TimeStatsHelper::TimelineStatsKey timelineKey = {refreshRateBucket, renderRateBucket};
 
-    if (!mTimeStats.stats.count(timelineKey)) {
-        mTimeStats.stats[timelineKey].key = timelineKey;
+    if (!statsShard.stats.count(timelineKey)) {
+        statsShard.stats[timelineKey].key = timelineKey;
     }
 
-    TimeStatsHelper::TimelineStats& timelineStats = mTimeStats.stats[timelineKey];
+    TimeStatsHelper::TimelineStats& timelineStats = statsShard.stats[timelineKey];
 
     updateJankPayload<TimeStatsHelper::TimelineStats>(timelineStats, info.reasons);
 
@@ -866,8 +893,9 @@ void TimeStats::incrementJankyFrames(const JankyFramesInfo& info) {
 void TimeStats::onDestroy(int32_t layerId) {
     ATRACE_CALL();
     ALOGV("[%d]-onDestroy", layerId);
-    std::lock_guard<std::mutex> lock(mMutex);
-    mTimeStatsTracker.erase(layerId);
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    mNumLayerRecords -= shard.records.erase(layerId);
 }
 
 void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
@@ -876,9 +904,10 @@ void TimeStats::removeTimeRecord(int32_t layerId, uint64_t frameNumber) {
     ATRACE_CALL();
     ALOGV("[%d]-[%" PRIu64 "]-removeTimeRecord", layerId, frameNumber);
 
-    std::lock_guard<std::mutex> lock(mMutex);
-    if (!mTimeStatsTracker.count(layerId)) return;
-    LayerRecord& layerRecord = mTimeStatsTracker[layerId];
+    LayerRecordShard& shard = getLayerRecordShard(layerId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (!shard.records.count(layerId)) return;
+    LayerRecord& layerRecord = shard.records[layerId];
     size_t removeAt = 0;
     for (const TimeRecord& record : layerRecord.timeRecords) {
         if (record.frameTime.frameNumber == frameNumber) break;
@@ -1048,6 +1077,10 @@ void TimeStats::disable() {
 
 void TimeStats::clearAll() {
     std::lock_guard<std::mutex> lock(mMutex);
+    for (StatsShard& statsShard : mStatsShards) {
+        std::lock_guard<std::mutex> statsLock(statsShard.mutex);
+        statsShard.stats.clear();
+    }
     mTimeStats.stats.clear();
     clearGlobalLocked();
     clearLayersLocked();
@@ -1071,8 +1104,11 @@ void TimeStats::clearGlobalLocked() {
     mTimeStats.renderEngineTimingLegacy.hist.clear();
     mTimeStats.refreshRateStatsLegacy.clear();
     mPowerTime.prevTime = systemTime();
-    for (auto& globalRecord : mTimeStats.stats) {
-        globalRecord.second.clearGlobals();
+    for (StatsShard& statsShard : mStatsShards) {
+        std::lock_guard<std::mutex> statsLock(statsShard.mutex);
+        for (auto& globalRecord : statsShard.stats) {
+            globalRecord.second.clearGlobals();
+        }
     }
     mGlobalRecord.prevPresentTime = 0;
     mGlobalRecord.presentFences.clear();
@@ -1082,14 +1118,39 @@ void TimeStats::clearGlobalLocked() {
 void TimeStats::clearLayersLocked() {
     ATRACE_CALL();
 
-    mTimeStatsTracker.clear();
+    for (LayerRecordShard& shard : mLayerRecordShards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        mNumLayerRecords -= shard.records.size();
+        shard.records.clear();
+    }
 
-    for (auto& globalRecord : mTimeStats.stats) {
-        globalRecord.second.stats.clear();
+    for (StatsShard& statsShard : mStatsShards) {
+        std::lock_guard<std::mutex> statsLock(statsShard.mutex);
+        for (auto& globalRecord : statsShard.stats) {
+            globalRecord.second.stats.clear();
+        }
     }
     ALOGD("Cleared layer stats");
 }
 
+void TimeStats::gatherStatsLocked() {
+    ATRACE_CALL();
+
+    mTimeStats.stats.clear();
+    for (StatsShard& statsShard : mStatsShards) {
+        std::lock_guard<std::mutex> statsLock(statsShard.mutex);
+        for (const auto& [timelineKey, shardStats] : statsShard.stats) {
+            TimeStatsHelper::TimelineStats& timelineStats = mTimeStats.stats[timelineKey];
+            timelineStats.key = timelineKey;
+            timelineStats.jankPayload.merge(shardStats.jankPayload);
+            timelineStats.displayDeadlineDeltas.merge(shardStats.displayDeadlineDeltas);
+            timelineStats.displayPresentDeltas.merge(shardStats.displayPresentDeltas);
+            // Each uid only has stats in one shard, so the layer stats are disjoint.
+            timelineStats.stats.insert(shardStats.stats.begin(), shardStats.stats.end());
+        }
+    }
+}
+
 bool TimeStats::isEnabled() {
     return mEnabled.load();
 }
@@ -1105,6 +1166,7 @@ void TimeStats::dump(bool asProto, std::optional<uint32_t> maxLayers, std::strin
     mTimeStats.statsEndLegacy = static_cast<int64_t>(std::time(0));
 
     flushPowerTimeLocked();
+    gatherStatsLocked();
 
     if (asProto) {
         ALOGD("Dumping TimeStats as proto");
@@ -19,6 +19,7 @@
 #include <cstdint>
 
 #include <../Fps.h>
+#include <android-base/thread_annotations.h>
 #include <android/hardware/graphics/composer/2.4/IComposerClient.h>
 #include <gui/JankInfo.h>
 #include <timestatsproto/TimeStatsHelper.h>
@@ -27,6 +28,8 @@
 #include <utils/String16.h>
 #include <utils/Vector.h>
 
+#include <array>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <optional>
@@ -220,6 +223,24 @@ class TimeStats : public android::TimeStats {
         std::deque<RenderEngineDuration> renderEngineDurations;
     };
 
+    // Per-layer records are recorded for every layer on every frame, from the main thread and
+    // binder threads, so they are sharded by layer id rather than guarded by mMutex.
+    struct LayerRecordShard {
+        std::mutex mutex;
+        // Hashmap for LayerRecord with layerId as the hash key
+        std::unordered_map<int32_t, LayerRecord> records GUARDED_BY(mutex);
+    };
+
+    // The stats aggregated from the layer records are sharded by uid, which keeps all the stats of
+    // a layer, including the fallback ones for its jank, in the same shard. The timeline stats of
+    // the shards are combined when pulled or dumped.
+    struct StatsShard {
+        std::mutex mutex;
+        std::unordered_map<TimeStatsHelper::TimelineStatsKey, TimeStatsHelper::TimelineStats,
+                           TimeStatsHelper::TimelineStatsKey::Hasher>
+                stats GUARDED_BY(mutex);
+    };
+
 public:
     TimeStats();
     // For testing only for injecting custom dependencies.
@@ -278,8 +299,11 @@ public:
 private:
     bool populateGlobalAtom(std::string* pulledData);
     bool populateLayerAtom(std::string* pulledData);
+    LayerRecordShard& getLayerRecordShard(int32_t layerId);
+    StatsShard& getStatsShard(uid_t uid);
     bool recordReadyLocked(int32_t layerId, TimeRecord* timeRecord);
-    void flushAvailableRecordsToStatsLocked(int32_t layerId, Fps displayRefreshRate,
+    void flushAvailableRecordsToStatsLocked(int32_t layerId, LayerRecord& layerRecord,
+                                            Fps displayRefreshRate,
                                             std::optional<Fps> renderRate,
                                             SetFrameRateVote frameRateVote, int32_t gameMode);
     void flushPowerTimeLocked();
@@ -291,16 +315,23 @@ private:
     void clearAll();
     void clearGlobalLocked();
     void clearLayersLocked();
+    void gatherStatsLocked();
     void dump(bool asProto, std::optional<uint32_t> maxLayers, std::string& result);
 
     std::atomic<bool> mEnabled = false;
+    // Locked before the shards, and the layer record shards before the stats shards.
     std::mutex mMutex;
+    // The timeline stats are only gathered from the stats shards when pulled or dumped.
     TimeStatsHelper::TimeStatsGlobal mTimeStats;
-    // Hashmap for LayerRecord with layerId as the hash key
-    std::unordered_map<int32_t, LayerRecord> mTimeStatsTracker;
     PowerTime mPowerTime;
     GlobalRecord mGlobalRecord;
 
+    static const size_t NUM_SHARDS = 8;
+    std::array<LayerRecordShard, NUM_SHARDS> mLayerRecordShards;
+    std::array<StatsShard, NUM_SHARDS> mStatsShards;
+    // Number of layer records across the shards.
+    std::atomic<size_t> mNumLayerRecords = 0;
+
     static const size_t MAX_NUM_LAYER_RECORDS = 200;
 
     static const size_t REFRESH_RATE_BUCKET_WIDTH = 30;
@@ -18,6 +18,7 @@
 #include <android-base/stringprintf.h>
 #include <inttypes.h>
 
+#include <algorithm>
 #include <array>
 
 #define HISTOGRAM_SIZE 85
@@ -37,15 +38,34 @@ static const std::array<int32_t, HISTOGRAM_SIZE> histogramConfig =
          86,  90,  94,  98,  102, 106, 110, 114, 118, 122, 126, 130, 134, 138, 142, 146, 150,
          200, 250, 300, 350, 400, 450, 500, 550, 600, 650, 700, 750, 800, 850, 900, 950, 1000};
 
+static bool bucketLess(const std::pair<int32_t, int32_t>& bucket, int32_t millis) {
+    return bucket.first < millis;
+}
+
+static void addToBucket(std::vector<std::pair<int32_t, int32_t>>& hist, int32_t millis,
+                        int32_t count) {
+    auto iter = std::lower_bound(hist.begin(), hist.end(), millis, bucketLess);
+    if (iter == hist.end() || iter->first != millis) {
+        iter = hist.insert(iter, {millis, 0});
+    }
+    iter->second += count;
+}
+
 void TimeStatsHelper::Histogram::insert(int32_t delta) {
     if (delta < 0) return;
     // std::lower_bound won't work on out of range values
     if (delta > histogramConfig[HISTOGRAM_SIZE - 1]) {
-        hist[histogramConfig[HISTOGRAM_SIZE - 1]]++;
+        addToBucket(hist, histogramConfig[HISTOGRAM_SIZE - 1], 1);
         return;
     }
     auto iter = std::lower_bound(histogramConfig.begin(), histogramConfig.end(), delta);
-    hist[*iter]++;
+    addToBucket(hist, *iter, 1);
+}
+
+void TimeStatsHelper::Histogram::merge(const Histogram& other) {
+    for (const auto& [millis, count] : other.hist) {
+        addToBucket(hist, millis, count);
+    }
 }
 
 int64_t TimeStatsHelper::Histogram::totalTime() const {
@@ -68,15 +88,32 @@ float TimeStatsHelper::Histogram::averageTime() const {
 
 std::string TimeStatsHelper::Histogram::toString() const {
     std::string result;
+    auto iter = hist.begin();
     for (int32_t i = 0; i < HISTOGRAM_SIZE; ++i) {
         int32_t bucket = histogramConfig[i];
-        int32_t count = (hist.count(bucket) == 0) ? 0 : hist.at(bucket);
+        int32_t count = 0;
+        if (iter != hist.end() && iter->first == bucket) {
+            count = iter->second;
+            ++iter;
+        }
         StringAppendF(&result, "%dms=%d ", bucket, count);
     }
     result.back() = '\n';
     return result;
 }
 
+void TimeStatsHelper::JankPayload::merge(const JankPayload& other) {
+    totalFrames += other.totalFrames;
+    totalJankyFrames += other.totalJankyFrames;
+    totalSFLongCpu += other.totalSFLongCpu;
+    totalSFLongGpu += other.totalSFLongGpu;
+    totalSFUnattributed += other.totalSFUnattributed;
+    totalAppUnattributed += other.totalAppUnattributed;
+    totalSFScheduling += other.totalSFScheduling;
+    totalSFPredictionError += other.totalSFPredictionError;
+    totalAppBufferStuffing += other.totalAppBufferStuffing;
+}
+
 std::string TimeStatsHelper::JankPayload::toString() const {
     std::string result;
     StringAppendF(&result, "totalTimelineFrames = %d\n", totalFrames);
@@ -21,6 +21,7 @@
 #include <optional>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace android {
@@ -30,11 +31,14 @@ class TimeStatsHelper {
 public:
     class Histogram {
     public:
-        // Key is the delta time between timestamps
-        // Value is the number of appearances of that delta
-        std::unordered_map<int32_t, int32_t> hist;
+        // First is the delta time between timestamps, lower bounded to its bucket
+        // Second is the number of appearances of that delta
+        // Only the buckets that were hit are stored, in increasing order of delta.
+        std::vector<std::pair<int32_t, int32_t>> hist;
 
         void insert(int32_t delta);
+        // Adds the counts of the other histogram to this one.
+        void merge(const Histogram& other);
         int64_t totalTime() const;
         float averageTime() const;
         std::string toString() const;
@@ -52,6 +56,7 @@ public:
         int32_t totalSFPredictionError = 0;
         int32_t totalAppBufferStuffing = 0;
 
+        void merge(const JankPayload& other);
         std::string toString() const;
     };
 
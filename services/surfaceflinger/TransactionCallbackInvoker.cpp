@@ -25,10 +25,13 @@
 
 #include "TransactionCallbackInvoker.h"
 
+#include <algorithm>
 #include <cinttypes>
 
+#include <android-base/stringprintf.h>
 #include <binder/IInterface.h>
 #include <utils/RefBase.h>
+#include <utils/Trace.h>
 
 namespace android {
 
@@ -248,15 +251,54 @@ void TransactionCallbackInvoker::addPresentFence(const sp<Fence>& presentFence)
     mPresentFence = presentFence;
 }
 
+void TransactionCallbackInvoker::addReleaseCallback(
+        const sp<ITransactionCompletedListener>& listener,
+        const ReleasedBufferStats& releasedBuffer) {
+    if (!listener) {
+        return;
+    }
+    std::lock_guard lock(mMutex);
+    mPendingReleases[IInterface::asBinder(listener)].push_back(releasedBuffer);
+}
+
+void TransactionCallbackInvoker::sendReleaseCallbacks() {
+    std::lock_guard lock(mMutex);
+    sendReleaseCallbacksLocked();
+}
+
+void TransactionCallbackInvoker::sendReleaseCallbacksLocked() {
+    for (auto& [listener, releasedBuffers] : mPendingReleases) {
+        interface_cast<ITransactionCompletedListener>(listener)->onReleaseBuffers(
+                std::move(releasedBuffers));
+    }
+    mPendingReleases.clear();
+}
+
 void TransactionCallbackInvoker::sendCallbacks() {
+    ATRACE_CALL();
     std::lock_guard lock(mMutex);
+    const nsecs_t start = systemTime();
+    sendReleaseCallbacksLocked();
 
     // For each listener
     auto completedTransactionsItr = mCompletedTransactions.begin();
     while (completedTransactionsItr != mCompletedTransactions.end()) {
         auto& [listener, transactionStatsDeque] = *completedTransactionsItr;
+
+        // Listeners are kept once idle, as they are likely to be back next frame, so that they are
+        // only linked to death once. They are dropped once dead.
+        if (transactionStatsDeque.empty()) {
+            if (listener->isBinderAlive()) {
+                completedTransactionsItr++;
+            } else {
+                completedTransactionsItr = mCompletedTransactions.erase(completedTransactionsItr);
+            }
+            continue;
+        }
+
         ListenerStats listenerStats;
         listenerStats.listener = listener;
+        listenerStats.transactionStats.reserve(transactionStatsDeque.size());
 
         // For each transaction
         auto transactionStatsItr = transactionStatsDeque.begin();
@@ -301,15 +343,14 @@ void TransactionCallbackInvoker::sendCallbacks() {
                 // keep it as an IBinder due to consistency reasons: if we
                 // interface_cast at the IPC boundary when reading a Parcel,
                 // we get pointers that compare unequal in the SF process.
-                interface_cast<ITransactionCompletedListener>(listenerStats.listener)
-                        ->onTransactionCompleted(listenerStats);
-                if (transactionStatsDeque.empty()) {
-                    listener->unlinkToDeath(mDeathRecipient);
-                    completedTransactionsItr =
-                            mCompletedTransactions.erase(completedTransactionsItr);
-                } else {
-                    completedTransactionsItr++;
-                }
+                //
+                // All the transactions completed for the listener this frame go in one callback,
+                // which is moved rather than copied, since it is only parceled.
+                mSentTransactionCount += listenerStats.transactionStats.size();
+                mSentCallbackCount++;
+                interface_cast<ITransactionCompletedListener>(listener)->onTransactionCompleted(
+                        std::move(listenerStats));
+                completedTransactionsItr++;
             } else {
                 completedTransactionsItr =
                         mCompletedTransactions.erase(completedTransactionsItr);
@@ -322,6 +363,19 @@ void TransactionCallbackInvoker::sendCallbacks() {
     if (mPresentFence) {
         mPresentFence.clear();
     }
+
+    mSendCount++;
+    mSendDuration += systemTime() - start;
+}
+
+void TransactionCallbackInvoker::dump(std::string& result) const {
+    std::lock_guard lock(mMutex);
+    const uint64_t sendCount = std::max<uint64_t>(mSendCount, 1);
+    base::StringAppendF(&result,
+                        "Transaction callbacks: %" PRIu64 " callbacks for %" PRIu64
+                        " transactions in %" PRIu64 " sends, %.1f us per send\n",
+                        mSentCallbackCount, mSentTransactionCount, mSendCount,
+                        static_cast<double>(mSendDuration) / 1000.0 / sendCount);
 }
 
 // -----------------------------------------------------------------------
@@ -19,6 +19,7 @@
 #include <condition_variable>
 #include <deque>
 #include <mutex>
+#include <string>
 #include <thread>
 #include <unordered_map>
 #include <unordered_set>
@@ -84,8 +85,16 @@ public:
 
     void addPresentFence(const sp<Fence>& presentFence);
 
+    // Queues a release buffer callback. All the releases queued for a listener are sent together
+    // by the next sendReleaseCallbacks or sendCallbacks.
+    void addReleaseCallback(const sp<ITransactionCompletedListener>& listener,
+                            const ReleasedBufferStats& releasedBuffer);
+    void sendReleaseCallbacks();
+
     void sendCallbacks();
 
+    void dump(std::string& result) const;
+
 private:
 
     bool isRegisteringTransaction(const sp<IBinder>& transactionListener,
@@ -101,6 +110,8 @@ private:
     status_t finalizeCallbackHandle(const sp<CallbackHandle>& handle,
                                     const std::vector<JankData>& jankData) REQUIRES(mMutex);
 
+    void sendReleaseCallbacksLocked() REQUIRES(mMutex);
+
     class CallbackDeathRecipient : public IBinder::DeathRecipient {
     public:
         // This function is a no-op. isBinderAlive needs a linked DeathRecipient to work.
@@ -113,7 +124,7 @@ private:
     sp<CallbackDeathRecipient> mDeathRecipient =
         new CallbackDeathRecipient();
 
-    std::mutex mMutex;
+    mutable std::mutex mMutex;
     std::condition_variable_any mConditionVariable;
 
     std::unordered_set<ListenerCallbacks, ListenerCallbacksHash> mRegisteringTransactions
@@ -128,7 +139,16 @@ private:
     std::unordered_map<sp<IBinder>, std::deque<TransactionStats>, IListenerHash>
             mCompletedTransactions GUARDED_BY(mMutex);
 
+    std::unordered_map<sp<IBinder>, std::vector<ReleasedBufferStats>, IListenerHash>
+            mPendingReleases GUARDED_BY(mMutex);
+
     sp<Fence> mPresentFence GUARDED_BY(mMutex);
+
+    // Counters of sendCallbacks, for dumpsys.
+    uint64_t mSendCount GUARDED_BY(mMutex) = 0;
+    nsecs_t mSendDuration GUARDED_BY(mMutex) = 0;
+    uint64_t mSentCallbackCount GUARDED_BY(mMutex) = 0;
+    uint64_t mSentTransactionCount GUARDED_BY(mMutex) = 0;
 };
 
 } // namespace android
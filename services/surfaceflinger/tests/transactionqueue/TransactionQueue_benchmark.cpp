@@ -0,0 +1,159 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <android-base/unique_fd.h>
+#include <benchmark/benchmark.h>
+#include <ftl/concurrent_queue.h>
+#include <ui/Fence.h>
+#include <utils/Looper.h>
+
+#include <unistd.h>
+
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace {
+
+constexpr int kBatch = 1024;
+
+// Stands in for SurfaceFlinger::TransactionState, which is copied onto the queue.
+struct Transaction {
+    explicit Transaction(int id) : id(id), states(4) {}
+
+    int id;
+    std::vector<uint64_t> states;
+};
+
+// How transactions used to be submitted: every binder thread contends on the queue lock, which the
+// main thread also holds while flushing.
+class LockedQueue {
+public:
+    void push(Transaction&& transaction) {
+        std::lock_guard lock(mMutex);
+        mQueue.push(std::move(transaction));
+    }
+
+    bool tryPop() {
+        std::lock_guard lock(mMutex);
+        if (mQueue.empty()) return false;
+        benchmark::DoNotOptimize(mQueue.front().id);
+        mQueue.pop();
+        return true;
+    }
+
+private:
+    std::mutex mMutex;
+    std::queue<Transaction> mQueue;
+};
+
+class LockFreeQueue {
+public:
+    void push(Transaction&& transaction) { mQueue.push(std::move(transaction)); }
+
+    bool tryPop() {
+        const auto transaction = mQueue.try_pop();
+        if (!transaction) return false;
+        benchmark::DoNotOptimize(transaction->id);
+        return true;
+    }
+
+private:
+    ftl::UnboundedMpscQueue<Transaction> mQueue;
+};
+
+// Submits kBatch transactions per iteration from the given number of binder threads, while the
+// benchmark thread drains them like flushTransactionQueues.
+template <typename Queue>
+void BM_Submit(benchmark::State& state) {
+    const int producers = static_cast<int>(state.range(0));
+    Queue queue;
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; p++) {
+            threads.emplace_back([&queue, producers] {
+                for (int i = 0; i < kBatch / producers; i++) queue.push(Transaction(i));
+            });
+        }
+
+        for (int popped = 0; popped < kBatch / producers * producers;) {
+            if (queue.tryPop()) {
+                popped++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+
+        for (auto& thread : threads) thread.join();
+    }
+    state.SetItemsProcessed(state.iterations() * kBatch);
+}
+BENCHMARK_TEMPLATE(BM_Submit, LockedQueue)->Arg(1)->Arg(4)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Submit, LockFreeQueue)->Arg(1)->Arg(4)->UseRealTime();
+
+// Pipes poll like sync fences: readable once written to, i.e. signaled.
+struct FakeFences {
+    explicit FakeFences(int count) {
+        for (int i = 0; i < count; i++) {
+            int fds[2];
+            if (pipe(fds) != 0) abort();
+            fences.push_back(new Fence(fds[0]));
+            writers.emplace_back(fds[1]);
+        }
+    }
+
+    std::vector<sp<Fence>> fences;
+    std::vector<base::unique_fd> writers;
+};
+
+// Cost per frame of re-evaluating every pending transaction that waits on an unsignaled fence.
+void BM_PollUnsignaledFences(benchmark::State& state) {
+    FakeFences fakes(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        int unsignaled = 0;
+        for (const auto& fence : fakes.fences) {
+            if (fence->getStatus() == Fence::Status::Unsignaled) unsignaled++;
+        }
+        benchmark::DoNotOptimize(unsignaled);
+    }
+}
+BENCHMARK(BM_PollUnsignaledFences)->Arg(1)->Arg(8)->Arg(32);
+
+// Cost per frame when the fences are parked in the Looper instead: nothing until one signals.
+void BM_WaitForUnsignaledFences(benchmark::State& state) {
+    FakeFences fakes(static_cast<int>(state.range(0)));
+    sp<Looper> looper = new Looper(true);
+    for (const auto& fence : fakes.fences) {
+        looper->addFd(
+                fence->get(), Looper::POLL_CALLBACK, Looper::EVENT_INPUT,
+                [](int, int, void* data) {
+                    benchmark::DoNotOptimize(data);
+                    return 1; // Keep registration.
+                },
+                nullptr);
+    }
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(looper->pollOnce(0));
+    }
+}
+BENCHMARK(BM_WaitForUnsignaledFences)->Arg(1)->Arg(8)->Arg(32);
+
+} // namespace
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -35,6 +35,7 @@ using namespace std::placeholders;
 
 using namespace android::flag_operators;
 using testing::_;
+using testing::HasSubstr;
 using testing::Invoke;
 
 namespace android {
@@ -628,6 +629,25 @@ TEST_F(EventThreadTest, requestNextVsyncWithThrottleVsyncDoesntPostVSync) {
     EXPECT_FALSE(mVSyncSetEnabledCallRecorder.waitForUnexpectedCall().has_value());
 }
 
+TEST_F(EventThreadTest, dumpsDeliveredAndDroppedVSyncsPerConnection) {
+    mThread->setVsyncRate(1, mConnection);
+    mThread->setVsyncRate(1, mThrottledConnection);
+
+    // EventThread should enable vsync callbacks.
+    expectVSyncSetEnabledCallReceived(true);
+
+    // The connection gets the event, while it is throttled for the other connection.
+    mCallback->onVSyncEvent(123, 456, 789);
+    expectInterceptCallReceived(123);
+    expectVsyncEventReceivedByConnection(123, 1u);
+    EXPECT_FALSE(mThrottledConnectionEventCallRecorder.waitForUnexpectedCall().has_value());
+
+    std::string dump;
+    mThread->dump(dump);
+    EXPECT_THAT(dump, HasSubstr("VSyncRequest::Periodic{period=1}, delivered=1, dropped=0}"));
+    EXPECT_THAT(dump, HasSubstr("VSyncRequest::Periodic{period=1}, delivered=0, dropped=1}"));
+}
+
 } // namespace
 } // namespace android
 
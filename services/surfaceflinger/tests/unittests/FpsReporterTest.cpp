@@ -52,9 +52,11 @@ struct TestableFpsListener : public gui::BnFpsListener {
     TestableFpsListener() {}
 
     float lastReportedFps = 0;
+    int reportCount = 0;
 
     binder::Status onFpsReported(float fps) override {
         lastReportedFps = fps;
+        reportCount++;
         return binder::Status::ok();
     }
 };
@@ -211,5 +213,34 @@ TEST_F(FpsReporterTest, rateLimits) {
     EXPECT_EQ(secondFps, mFpsListener->lastReportedFps);
 }
 
+TEST_F(FpsReporterTest, onlyReportsChanges) {
+    const constexpr int32_t kTaskId = 12;
+    LayerMetadata targetMetadata;
+    targetMetadata.setInt32(METADATA_TASK_ID, kTaskId);
+    mTarget = createBufferStateLayer(targetMetadata);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(mTarget);
+
+    float firstFps = 44.0;
+    float secondFps = 53.0;
+
+    EXPECT_CALL(mFrameTimeline, computeFps(UnorderedElementsAre(mTarget->getSequence())))
+            .WillOnce(Return(firstFps))
+            .WillOnce(Return(firstFps))
+            .WillOnce(Return(secondFps));
+
+    mFpsReporter->addListener(mFpsListener, kTaskId);
+    mClock->advanceTime(600ms);
+    mFpsReporter->dispatchLayerFps();
+    EXPECT_EQ(firstFps, mFpsListener->lastReportedFps);
+    EXPECT_EQ(1, mFpsListener->reportCount);
+    mClock->advanceTime(600ms);
+    mFpsReporter->dispatchLayerFps();
+    EXPECT_EQ(1, mFpsListener->reportCount);
+    mClock->advanceTime(600ms);
+    mFpsReporter->dispatchLayerFps();
+    EXPECT_EQ(secondFps, mFpsListener->lastReportedFps);
+    EXPECT_EQ(2, mFpsListener->reportCount);
+}
+
 } // namespace
 } // namespace android
@@ -24,7 +24,9 @@
 #include <gtest/gtest.h>
 #include <log/log.h>
 #include <perfetto/trace/trace.pb.h>
+#include <chrono>
 #include <cinttypes>
+#include <unordered_set>
 
 using namespace std::chrono_literals;
 using testing::_;
@@ -310,6 +312,25 @@ TEST_F(FrameTimelineTest, presentFenceSignaled_presentedFramesUpdated) {
     EXPECT_NE(surfaceFrame2->getJankType(), std::nullopt);
 }
 
+TEST_F(FrameTimelineTest, setGpuDuration_matchesDisplayFrameByDrawStartTime) {
+    auto presentFence1 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    auto presentFence2 = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    int64_t sfToken1 = mTokenManager->generateTokenForPredictions({22, 26, 30});
+    int64_t sfToken2 = mTokenManager->generateTokenForPredictions({52, 56, 60});
+    mFrameTimeline->setSfWakeUp(sfToken1, 22, Fps::fromPeriodNsecs(11));
+    mFrameTimeline->setSfPresent(26, presentFence1);
+    mFrameTimeline->setSfWakeUp(sfToken2, 52, Fps::fromPeriodNsecs(11));
+    mFrameTimeline->setSfPresent(56, presentFence2);
+
+    mFrameTimeline->setGpuDuration(24, 5);
+    // Draws outside of the tracked frames are dropped.
+    mFrameTimeline->setGpuDuration(40, 6);
+    mFrameTimeline->setGpuDuration(10, 7);
+
+    EXPECT_EQ(5, getDisplayFrame(0)->getGpuDuration());
+    EXPECT_EQ(0, getDisplayFrame(1)->getGpuDuration());
+}
+
 TEST_F(FrameTimelineTest, displayFramesSlidingWindowMovesAfterLimit) {
     // Insert kMaxDisplayFrames' count of DisplayFrames to fill the deque
     int frameTimeFactor = 0;
@@ -434,6 +455,53 @@ TEST_F(FrameTimelineTest, setMaxDisplayFramesSetsSizeProperly) {
     EXPECT_EQ(getNumberOfDisplayFrames(), *maxDisplayFrames);
 }
 
+TEST_F(FrameTimelineTest, steadyStateFrameTrackingReusesAllocations) {
+    constexpr uint32_t kMaxDisplayFrames = 4;
+    constexpr size_t kFrames = 10000;
+    mFrameTimeline->setMaxDisplayFrames(kMaxDisplayFrames);
+
+    std::unordered_set<const void*> displayFrames;
+    std::unordered_set<const void*> surfaceFrames;
+    const auto presentFrame = [&] {
+        auto presentFence = fenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+        int64_t sfToken = mTokenManager->generateTokenForPredictions({22, 26, 30});
+        mFrameTimeline->setSfWakeUp(sfToken, 22, Fps::fromPeriodNsecs(11));
+        for (const auto& [layerId, layerName] :
+             {std::make_pair(sLayerIdOne, sLayerNameOne),
+              std::make_pair(sLayerIdTwo, sLayerNameTwo)}) {
+            auto surfaceFrame =
+                    mFrameTimeline->createSurfaceFrameForToken({}, sPidOne, sUidOne, layerId,
+                                                               layerName, layerName,
+                                                               /*isBuffer*/ true, sGameMode);
+            surfaceFrame->setPresentState(SurfaceFrame::PresentState::Presented);
+            surfaceFrames.insert(surfaceFrame.get());
+            mFrameTimeline->addSurfaceFrame(std::move(surfaceFrame));
+        }
+        mFrameTimeline->setSfPresent(27, presentFence);
+        displayFrames.insert(getDisplayFrame(getNumberOfDisplayFrames() - 1).get());
+    };
+
+    // Fill the sliding window, after which frames are recycled rather than allocated.
+    for (size_t i = 0; i < kMaxDisplayFrames + 1; i++) {
+        presentFrame();
+    }
+    displayFrames.clear();
+    surfaceFrames.clear();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kFrames; i++) {
+        presentFrame();
+    }
+    const std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+    ALOGD("Tracked %zu display frames in %.2f us per frame", kFrames,
+          elapsed.count() / static_cast<double>(kFrames));
+
+    // Besides the window, only the frame being built is live.
+    EXPECT_LE(displayFrames.size(), kMaxDisplayFrames + 1);
+    EXPECT_LE(surfaceFrames.size(), 2u * (kMaxDisplayFrames + 1));
+}
+
 TEST_F(FrameTimelineTest, presentFenceSignaled_invalidSignalTime) {
     Fps refreshRate = Fps::fromPeriodNsecs(11);
 
@@ -179,5 +179,33 @@ TEST_F(HWComposerLayerGenericMetadataTest, forwardsSupportedMetadata) {
     EXPECT_EQ(hal::Error::UNSUPPORTED, result);
 }
 
+struct HWComposerLayerStateTest : public HWComposerLayerTest {
+    HWComposerLayerStateTest() : HWComposerLayerTest({}) {}
+};
+
+TEST_F(HWComposerLayerStateTest, skipsUnchangedState) {
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 1u)).WillOnce(Return(hal::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerPlaneAlpha(kDisplayId, kLayerId, 0.5f))
+            .WillOnce(Return(hal::Error::NONE));
+    EXPECT_CALL(*mHal, setLayerBlendMode(kDisplayId, kLayerId, hal::BlendMode::PREMULTIPLIED))
+            .WillOnce(Return(hal::Error::NONE));
+    for (int frame = 0; frame < 2; frame++) {
+        EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+        EXPECT_EQ(hal::Error::NONE, mLayer.setPlaneAlpha(0.5f));
+        EXPECT_EQ(hal::Error::NONE, mLayer.setBlendMode(hal::BlendMode::PREMULTIPLIED));
+    }
+
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 2u)).WillOnce(Return(hal::Error::NONE));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(2u));
+}
+
+TEST_F(HWComposerLayerStateTest, resendsStateAfterError) {
+    EXPECT_CALL(*mHal, setLayerZOrder(kDisplayId, kLayerId, 1u))
+            .WillOnce(Return(hal::Error::NO_RESOURCES))
+            .WillOnce(Return(hal::Error::NONE));
+    EXPECT_EQ(hal::Error::NO_RESOURCES, mLayer.setZOrder(1u));
+    EXPECT_EQ(hal::Error::NONE, mLayer.setZOrder(1u));
+}
+
 } // namespace
 } // namespace android
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include "EffectLayer.h"
+#include "Layer.h"
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+#include "mock/MockVsyncController.h"
+
+namespace android {
+namespace {
+
+using testing::_;
+using testing::Return;
+
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+
+class LayerBoundsTest : public testing::Test {
+protected:
+    LayerBoundsTest();
+
+    void setupScheduler();
+    sp<Layer> createLayer(const char* name);
+    void computeBounds() { mParent->computeBounds(kDisplayBounds, ui::Transform(), 0.f); }
+
+    static const FloatRect kDisplayBounds;
+
+    TestableSurfaceFlinger mFlinger;
+    mock::MessageQueue* mMessageQueue = new mock::MessageQueue();
+
+    sp<Layer> mParent;
+    sp<Layer> mChild;
+};
+
+const FloatRect LayerBoundsTest::kDisplayBounds{0.f, 0.f, 1000.f, 1000.f};
+
+LayerBoundsTest::LayerBoundsTest() {
+    const ::testing::TestInfo* const test_info =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+    ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+
+    setupScheduler();
+    mFlinger.setupComposer(std::make_unique<Hwc2::mock::Composer>());
+    mFlinger.mutableEventQueue().reset(mMessageQueue);
+
+    mParent = createLayer("parent");
+    mChild = createLayer("child");
+    mParent->setCrop(Rect(0, 0, 100, 100));
+    mChild->setCrop(Rect(0, 0, 50, 50));
+    mChild->setPosition(10.f, 10.f);
+    mParent->addChild(mChild);
+    mParent->commitChildList();
+    mParent->doTransaction(0);
+    mChild->doTransaction(0);
+}
+
+void LayerBoundsTest::setupScheduler() {
+    auto eventThread = std::make_unique<mock::EventThread>();
+    auto sfEventThread = std::make_unique<mock::EventThread>();
+
+    EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*eventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    auto vsyncController = std::make_unique<mock::VsyncController>();
+    auto vsyncTracker = std::make_unique<mock::VSyncTracker>();
+
+    EXPECT_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*vsyncTracker, currentPeriod())
+            .WillRepeatedly(Return(FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+    mFlinger.setupScheduler(std::move(vsyncController), std::move(vsyncTracker),
+                            std::move(eventThread), std::move(sfEventThread));
+}
+
+sp<Layer> LayerBoundsTest::createLayer(const char* name) {
+    sp<Client> client;
+    LayerCreationArgs args(mFlinger.flinger(), client, name, 100, 100, 0, LayerMetadata());
+    return new EffectLayer(args);
+}
+
+TEST_F(LayerBoundsTest, computesBoundsOfSubtree) {
+    computeBounds();
+    EXPECT_EQ(Rect(0, 0, 100, 100), mParent->getScreenBounds(false));
+    EXPECT_EQ(Rect(10, 10, 60, 60), mChild->getScreenBounds(false));
+}
+
+TEST_F(LayerBoundsTest, recomputesSubtreeOfChangedLayer) {
+    computeBounds();
+
+    mParent->setPosition(5.f, 5.f);
+    mParent->doTransaction(0);
+    computeBounds();
+    EXPECT_EQ(Rect(5, 5, 105, 105), mParent->getScreenBounds(false));
+    EXPECT_EQ(Rect(15, 15, 65, 65), mChild->getScreenBounds(false));
+}
+
+TEST_F(LayerBoundsTest, recomputesChangedChild) {
+    computeBounds();
+
+    mChild->setCrop(Rect(0, 0, 20, 20));
+    mChild->doTransaction(0);
+    computeBounds();
+    EXPECT_EQ(Rect(0, 0, 100, 100), mParent->getScreenBounds(false));
+    EXPECT_EQ(Rect(10, 10, 30, 30), mChild->getScreenBounds(false));
+}
+
+TEST_F(LayerBoundsTest, skipsLayersUntilTheirChangesAreCommitted) {
+    computeBounds();
+
+    mChild->setCrop(Rect(0, 0, 20, 20));
+    computeBounds();
+    EXPECT_EQ(Rect(10, 10, 60, 60), mChild->getScreenBounds(false));
+
+    mChild->doTransaction(0);
+    computeBounds();
+    EXPECT_EQ(Rect(10, 10, 30, 30), mChild->getScreenBounds(false));
+}
+
+TEST_F(LayerBoundsTest, recomputesForNewParentBounds) {
+    computeBounds();
+
+    mParent->computeBounds(FloatRect(0.f, 0.f, 30.f, 30.f), ui::Transform(), 0.f);
+    EXPECT_EQ(Rect(0, 0, 30, 30), mParent->getScreenBounds(false));
+    EXPECT_EQ(Rect(10, 10, 30, 30), mChild->getScreenBounds(false));
+}
+
+} // namespace
+} // namespace android
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LayerCostTrackerTest"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "LayerCostTracker.h"
+
+namespace android {
+namespace {
+
+using testing::HasSubstr;
+using testing::Not;
+
+using CpuStage = LayerCostTracker::CpuStage;
+
+constexpr uid_t kUid = 10001;
+constexpr uid_t kOtherUid = 10002;
+
+class LayerCostTrackerTest : public testing::Test {
+protected:
+    LayerCostTrackerTest() { mTracker.setEnabled(true); }
+
+    std::string parseArgs(std::initializer_list<const char*> args) {
+        Vector<String16> argsVector;
+        for (const char* arg : args) {
+            argsVector.add(String16(arg));
+        }
+        std::string result;
+        mTracker.parseArgs(argsVector, result);
+        return result;
+    }
+
+    std::string dump() {
+        std::string result;
+        mTracker.dump(result);
+        return result;
+    }
+
+    LayerCostTracker mTracker;
+    FenceToFenceTimeMap mFenceFactory;
+};
+
+TEST_F(LayerCostTrackerTest, ignoresCostWhileDisabled) {
+    mTracker.setEnabled(false);
+    mTracker.addCpuTime(1, kUid, "A", CpuStage::Latch, ms2ns(1));
+    mTracker.onFrameEnd();
+
+    EXPECT_THAT(dump(), HasSubstr("Layer cost (disabled) over 0 frames"));
+    EXPECT_THAT(dump(), Not(HasSubstr("uid  10001")));
+}
+
+TEST_F(LayerCostTrackerTest, attributesCpuTimeToLayersAndUids) {
+    mTracker.addCpuTime(1, kUid, "A", CpuStage::Latch, ms2ns(2));
+    mTracker.addCpuTime(1, kUid, "A", CpuStage::Bounds, ms2ns(1));
+    mTracker.addCpuTime(2, kUid, "B", CpuStage::ClientComposition, ms2ns(3));
+    mTracker.addCpuTime(3, kOtherUid, "C", CpuStage::Bounds, ms2ns(1));
+    mTracker.onFrameEnd();
+
+    const std::string result = dump();
+    EXPECT_THAT(result, HasSubstr("over 1 frames"));
+    EXPECT_THAT(result,
+                HasSubstr("uid  10001: latch    2.000  bounds    1.000  client    3.000  gpu     "
+                          "0.000  total     6.000 ms"));
+    EXPECT_THAT(result, HasSubstr("uid  10002: latch    0.000  bounds    1.000"));
+    EXPECT_THAT(result, HasSubstr("A (uid 10001)\n    latch    2.000  bounds    1.000"));
+    EXPECT_THAT(result, HasSubstr("B (uid 10001)\n    latch    0.000  bounds    0.000  client    "
+                                  "3.000"));
+
+    // Uids are sorted by cost.
+    EXPECT_LT(result.find("uid  10001"), result.find("uid  10002"));
+}
+
+TEST_F(LayerCostTrackerTest, splitsGpuTimeByArea) {
+    const auto doneFence = mFenceFactory.createFenceTimeForTest(Fence::NO_FENCE);
+    mTracker.addClientComposition(ms2ns(10), doneFence,
+                                  {{1, kUid, "A", 200}, {2, kOtherUid, "B", 100}});
+
+    // The GPU time is only known once the composition is done.
+    mTracker.onFrameEnd();
+    EXPECT_THAT(dump(), Not(HasSubstr("gpu    20.000")));
+
+    mFenceFactory.signalAllForTest(Fence::NO_FENCE, ms2ns(40));
+    mTracker.onFrameEnd();
+
+    const std::string result = dump();
+    EXPECT_THAT(result, HasSubstr("A (uid 10001)\n    latch    0.000  bounds    0.000  client    "
+                                  "0.000  gpu    20.000"));
+    EXPECT_THAT(result, HasSubstr("B (uid 10002)\n    latch    0.000  bounds    0.000  client    "
+                                  "0.000  gpu    10.000"));
+}
+
+TEST_F(LayerCostTrackerTest, keepsUidCostOfDestroyedLayers) {
+    mTracker.addCpuTime(1, kUid, "A", CpuStage::Latch, ms2ns(2));
+    mTracker.onLayerDestroyed(1);
+
+    const std::string result = dump();
+    EXPECT_THAT(result, HasSubstr("uid  10001: latch    2.000"));
+    EXPECT_THAT(result, HasSubstr("By layer, top 0 of 0"));
+}
+
+TEST_F(LayerCostTrackerTest, parsesArgs) {
+    mTracker.addCpuTime(1, kUid, "A", CpuStage::Latch, ms2ns(2));
+
+    EXPECT_THAT(parseArgs({"-disable", "-clear"}), Not(HasSubstr("uid  10001")));
+    EXPECT_FALSE(mTracker.isEnabled());
+
+    EXPECT_THAT(parseArgs({"-enable"}), HasSubstr("Layer cost (enabled)"));
+    EXPECT_TRUE(mTracker.isEnabled());
+}
+
+} // namespace
+} // namespace android
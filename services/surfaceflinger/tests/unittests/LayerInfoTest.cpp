@@ -30,9 +30,20 @@ protected:
     using FrameTimeData = LayerInfo::FrameTimeData;
 
     void setFrameTimes(const std::deque<FrameTimeData>& frameTimes) {
-        layerInfo.mFrameTimes = frameTimes;
+        layerInfo.mFrameTimes.clear();
+        for (const auto& frameTime : frameTimes) {
+            recordFrameTime(frameTime);
+        }
     }
 
+    void recordFrameTime(const FrameTimeData& frameTime) {
+        layerInfo.mFrameTimes.push_back(frameTime);
+    }
+
+    size_t frameTimeCount() const { return layerInfo.mFrameTimes.size(); }
+
+    static constexpr size_t kHistorySize = LayerInfo::HISTORY_SIZE;
+
     void setLastRefreshRate(Fps fps) {
         layerInfo.mLastRefreshRate.reported = fps;
         layerInfo.mLastRefreshRate.calculated = fps;
@@ -177,5 +188,29 @@ TEST_F(LayerInfoTest, ignoresLargePeriods) {
             << "Expected " << averageFps << " to be equal to " << kExpectedFps;
 }
 
+// Once the history is full, new frames replace the oldest ones, and the average is recalculated.
+TEST_F(LayerInfoTest, keepsMostRecentFrames) {
+    constexpr auto kPeriod = Fps(50.0f).getPeriodNsecs();
+    constexpr auto kNewPeriod = Fps(25.0f).getPeriodNsecs();
+
+    nsecs_t time = kPeriod; // Start with non-zero time.
+    for (size_t i = 0; i < kHistorySize; i++, time += kPeriod) {
+        recordFrameTime(
+                FrameTimeData{.presentTime = time, .queueTime = 0, .pendingModeChange = false});
+    }
+    auto averageFrameTime = calculateAverageFrameTime();
+    ASSERT_TRUE(averageFrameTime.has_value());
+    EXPECT_TRUE(Fps(50.0f).equalsWithMargin(Fps::fromPeriodNsecs(*averageFrameTime)));
+
+    for (size_t i = 0; i < kHistorySize; i++, time += kNewPeriod) {
+        recordFrameTime(
+                FrameTimeData{.presentTime = time, .queueTime = 0, .pendingModeChange = false});
+    }
+    EXPECT_EQ(kHistorySize, frameTimeCount());
+    averageFrameTime = calculateAverageFrameTime();
+    ASSERT_TRUE(averageFrameTime.has_value());
+    EXPECT_TRUE(Fps(25.0f).equalsWithMargin(Fps::fromPeriodNsecs(*averageFrameTime)));
+}
+
 } // namespace
 } // namespace android::scheduler
@@ -91,7 +91,7 @@ TEST_F(LayerMetadataTest, merge) {
     ASSERT_EQ(3, metadata.mMap.size());
     ASSERT_EQ(someData, second.mMap[2]);
     ASSERT_EQ(5, metadata.getInt32(6, 0));
-    ASSERT_TRUE(metadata.mMap.at(4).empty());
+    ASSERT_TRUE(metadata.mMap.find(4)->get().empty());
 
     LayerMetadata withErase;
     withErase.mMap[6].clear();
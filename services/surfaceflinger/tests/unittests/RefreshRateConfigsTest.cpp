@@ -81,14 +81,26 @@ protected:
     void setLastBestRefreshRateInvocation(RefreshRateConfigs& refreshRateConfigs,
                                           const GetBestRefreshRateInvocation& invocation) {
         std::lock_guard lock(refreshRateConfigs.mLock);
-        refreshRateConfigs.lastBestRefreshRateInvocation.emplace(
-                GetBestRefreshRateInvocation(invocation));
+        refreshRateConfigs.mBestRefreshRateInvocations.push_front(invocation);
     }
 
     std::optional<GetBestRefreshRateInvocation> getLastBestRefreshRateInvocation(
             const RefreshRateConfigs& refreshRateConfigs) {
         std::lock_guard lock(refreshRateConfigs.mLock);
-        return refreshRateConfigs.lastBestRefreshRateInvocation;
+        if (refreshRateConfigs.mBestRefreshRateInvocations.empty()) {
+            return {};
+        }
+        return refreshRateConfigs.mBestRefreshRateInvocations.front();
+    }
+
+    // Number of cache hits and misses of getBestRefreshRate.
+    using CacheStats = std::pair<size_t, size_t>;
+
+    CacheStats getBestRefreshRateCacheStats(
+            const RefreshRateConfigs& refreshRateConfigs) {
+        std::lock_guard lock(refreshRateConfigs.mLock);
+        return {refreshRateConfigs.mBestRefreshRateCacheHits,
+                refreshRateConfigs.mBestRefreshRateCacheMisses};
     }
 
     // Test config IDs
@@ -2003,6 +2015,40 @@ TEST_F(RefreshRateConfigsTest, getBestRefreshRate_WritesCache) {
     ASSERT_FALSE(detaultSignals == lastInvocation->outSignalsConsidered);
 }
 
+TEST_F(RefreshRateConfigsTest, getBestRefreshRate_ReadsCacheRegardlessOfLayerOrder) {
+    auto refreshRateConfigs =
+            std::make_unique<RefreshRateConfigs>(m30_60_72_90_120Device,
+                                                 /*currentConfigId=*/HWC_CONFIG_ID_60);
+
+    const auto layers = std::vector<LayerRequirement>{
+            LayerRequirement{.name = "A",
+                             .vote = LayerVoteType::ExplicitDefault,
+                             .desiredRefreshRate = Fps(60.0f),
+                             .weight = 1.0f},
+            LayerRequirement{.name = "B", .vote = LayerVoteType::Min, .weight = 0.5f}};
+    const auto reorderedLayers = std::vector<LayerRequirement>{layers[1], layers[0]};
+    const auto otherLayers = std::vector<LayerRequirement>{
+            LayerRequirement{.name = "C", .vote = LayerVoteType::Max, .weight = 1.0f}};
+
+    const auto result = refreshRateConfigs->getBestRefreshRate(layers, {});
+    const auto otherResult = refreshRateConfigs->getBestRefreshRate(otherLayers, {});
+    EXPECT_EQ(CacheStats(0, 2), getBestRefreshRateCacheStats(*refreshRateConfigs));
+
+    // Both invocations are cached, and the order of the layers is irrelevant.
+    EXPECT_EQ(result, refreshRateConfigs->getBestRefreshRate(reorderedLayers, {}));
+    EXPECT_EQ(otherResult, refreshRateConfigs->getBestRefreshRate(otherLayers, {}));
+    EXPECT_EQ(CacheStats(2, 2), getBestRefreshRateCacheStats(*refreshRateConfigs));
+
+    // The signals are part of the key.
+    refreshRateConfigs->getBestRefreshRate(layers, {.touch = true});
+    EXPECT_EQ(CacheStats(2, 3), getBestRefreshRateCacheStats(*refreshRateConfigs));
+
+    // Mode changes invalidate the cache.
+    refreshRateConfigs->setCurrentModeId(HWC_CONFIG_ID_90);
+    refreshRateConfigs->getBestRefreshRate(layers, {});
+    EXPECT_EQ(CacheStats(2, 4), getBestRefreshRateCacheStats(*refreshRateConfigs));
+}
+
 TEST_F(RefreshRateConfigsTest, getBestRefreshRate_ExplicitExactTouchBoost) {
     RefreshRateConfigs::Config config = {.enableFrameRateOverride = true};
     auto refreshRateConfigs =
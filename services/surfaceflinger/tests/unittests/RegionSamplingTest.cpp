@@ -140,6 +140,18 @@ TEST_F(RegionSamplingTest, orientation_90) {
                 testing::Eq(1.0));
 }
 
+TEST_F(RegionSamplingTest, downsample_area) {
+    const Rect bounds{100, 200, 500, 300};
+    const ui::Size size{100, 25};
+
+    EXPECT_EQ(Rect(0, 0, 100, 25), downsampleArea(bounds, bounds, size));
+    EXPECT_EQ(Rect(10, 5, 20, 10), downsampleArea(Rect{140, 220, 180, 240}, bounds, size));
+
+    // Partially covered pixels are included.
+    EXPECT_EQ(Rect(10, 5, 11, 6), downsampleArea(Rect{141, 221, 143, 222}, bounds, size));
+    EXPECT_EQ(Rect(0, 0, 1, 1), downsampleArea(Rect{101, 201, 102, 202}, bounds, size));
+}
+
 } // namespace android
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#undef LOG_TAG
+#define LOG_TAG "LibSurfaceFlingerUnittests"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include <gui/LayerMetadata.h>
+
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wconversion"
+#include "EffectLayer.h"
+#include "Layer.h"
+// TODO(b/129481165): remove the #pragma below and fix conversion issues
+#pragma clang diagnostic pop // ignored "-Wconversion"
+#include "TestableSurfaceFlinger.h"
+#include "mock/DisplayHardware/MockComposer.h"
+#include "mock/MockEventThread.h"
+#include "mock/MockMessageQueue.h"
+#include "mock/MockVsyncController.h"
+
+namespace android {
+namespace {
+
+using testing::_;
+using testing::ElementsAre;
+using testing::Return;
+
+using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
+
+class TraverseDrawingLayersTest : public testing::Test {
+protected:
+    TraverseDrawingLayersTest();
+    ~TraverseDrawingLayersTest() override;
+
+    void setupScheduler();
+    sp<Layer> createLayer(const char* name, int32_t z);
+    void addRoot(const sp<Layer>& layer);
+    void commitTransaction() { mFlinger.handleTransactionLocked(0); }
+
+    std::vector<Layer*> traverseInZOrder();
+    std::vector<Layer*> traverseInReverseZOrder();
+
+    TestableSurfaceFlinger mFlinger;
+    mock::MessageQueue* mMessageQueue = new mock::MessageQueue();
+
+    // A(0) { C(-1), D(1) }, B(1)
+    sp<Layer> mA;
+    sp<Layer> mB;
+    sp<Layer> mC;
+    sp<Layer> mD;
+};
+
+TraverseDrawingLayersTest::TraverseDrawingLayersTest() {
+    const ::testing::TestInfo* const test_info =
+            ::testing::UnitTest::GetInstance()->current_test_info();
+    ALOGD("**** Setting up for %s.%s\n", test_info->test_case_name(), test_info->name());
+
+    setupScheduler();
+    mFlinger.setupComposer(std::make_unique<Hwc2::mock::Composer>());
+    mFlinger.mutableEventQueue().reset(mMessageQueue);
+
+    mA = createLayer("A", 0);
+    mB = createLayer("B", 1);
+    mC = createLayer("C", -1);
+    mD = createLayer("D", 1);
+    mA->addChild(mC);
+    mA->addChild(mD);
+    addRoot(mA);
+    addRoot(mB);
+    commitTransaction();
+}
+
+TraverseDrawingLayersTest::~TraverseDrawingLayersTest() {
+    // Release the layers while the scheduler they are registered with is still alive.
+    mFlinger.mutableCurrentState().layersSortedByZ.clear();
+    mFlinger.mutableDrawingState().layersSortedByZ.clear();
+    mFlinger.mutableDrawingLayersInZOrder().clear();
+}
+
+void TraverseDrawingLayersTest::setupScheduler() {
+    auto eventThread = std::make_unique<mock::EventThread>();
+    auto sfEventThread = std::make_unique<mock::EventThread>();
+
+    EXPECT_CALL(*eventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*eventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(eventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    EXPECT_CALL(*sfEventThread, registerDisplayEventConnection(_));
+    EXPECT_CALL(*sfEventThread, createEventConnection(_, _))
+            .WillOnce(Return(new EventThreadConnection(sfEventThread.get(), /*callingUid=*/0,
+                                                       ResyncCallback())));
+
+    auto vsyncController = std::make_unique<mock::VsyncController>();
+    auto vsyncTracker = std::make_unique<mock::VSyncTracker>();
+
+    EXPECT_CALL(*vsyncTracker, nextAnticipatedVSyncTimeFrom(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*vsyncTracker, currentPeriod())
+            .WillRepeatedly(Return(FakeHwcDisplayInjector::DEFAULT_VSYNC_PERIOD));
+    mFlinger.setupScheduler(std::move(vsyncController), std::move(vsyncTracker),
+                            std::move(eventThread), std::move(sfEventThread));
+}
+
+sp<Layer> TraverseDrawingLayersTest::createLayer(const char* name, int32_t z) {
+    sp<Client> client;
+    LayerCreationArgs args(mFlinger.flinger(), client, name, 100, 100, 0, LayerMetadata());
+    sp<Layer> layer = new EffectLayer(args);
+    layer->setLayer(z);
+    return layer;
+}
+
+void TraverseDrawingLayersTest::addRoot(const sp<Layer>& layer) {
+    layer->setIsAtRoot(true);
+    mFlinger.mutableCurrentState().layersSortedByZ.add(layer);
+}
+
+std::vector<Layer*> TraverseDrawingLayersTest::traverseInZOrder() {
+    std::vector<Layer*> layers;
+    mFlinger.traverseDrawingLayersInZOrder([&](Layer* layer) { layers.push_back(layer); });
+
+    // The cached order matches the traversal of the tree.
+    std::vector<Layer*> expected;
+    mFlinger.mutableDrawingState().traverseInZOrder(
+            [&](Layer* layer) { expected.push_back(layer); });
+    EXPECT_EQ(expected, layers);
+    return layers;
+}
+
+std::vector<Layer*> TraverseDrawingLayersTest::traverseInReverseZOrder() {
+    std::vector<Layer*> layers;
+    mFlinger.traverseDrawingLayersInReverseZOrder([&](Layer* layer) { layers.push_back(layer); });
+
+    std::vector<Layer*> expected;
+    mFlinger.mutableDrawingState().traverseInReverseZOrder(
+            [&](Layer* layer) { expected.push_back(layer); });
+    EXPECT_EQ(expected, layers);
+    return layers;
+}
+
+TEST_F(TraverseDrawingLayersTest, traversesInZOrder) {
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mC.get(), mA.get(), mD.get(), mB.get()));
+    EXPECT_THAT(traverseInReverseZOrder(), ElementsAre(mB.get(), mD.get(), mA.get(), mC.get()));
+
+    // Repeated traversals replay the same order.
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mC.get(), mA.get(), mD.get(), mB.get()));
+}
+
+TEST_F(TraverseDrawingLayersTest, reordersOnCommit) {
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mC.get(), mA.get(), mD.get(), mB.get()));
+
+    ASSERT_TRUE(mA->setChildLayer(mD, -2));
+    commitTransaction();
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mD.get(), mC.get(), mA.get(), mB.get()));
+    EXPECT_THAT(traverseInReverseZOrder(), ElementsAre(mB.get(), mA.get(), mC.get(), mD.get()));
+}
+
+TEST_F(TraverseDrawingLayersTest, dropsRemovedLayersOnCommit) {
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mC.get(), mA.get(), mD.get(), mB.get()));
+
+    mA->removeChild(mC);
+    commitTransaction();
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mA.get(), mD.get(), mB.get()));
+
+    mFlinger.mutableCurrentState().layersSortedByZ.remove(mB);
+    commitTransaction();
+    EXPECT_THAT(traverseInZOrder(), ElementsAre(mA.get(), mD.get()));
+}
+
+} // namespace
+} // namespace android
@@ -321,6 +321,14 @@ public:
         return mFlinger->handleTransactionLocked(transactionFlags);
     }
 
+    void traverseDrawingLayersInZOrder(const LayerVector::Visitor& visitor) {
+        mFlinger->traverseDrawingLayersInZOrder(visitor);
+    }
+
+    void traverseDrawingLayersInReverseZOrder(const LayerVector::Visitor& visitor) {
+        mFlinger->traverseDrawingLayersInReverseZOrder(visitor);
+    }
+
     void onComposerHalHotplug(hal::HWDisplayId hwcDisplayId, hal::Connection connection) {
         mFlinger->onComposerHalHotplug(hwcDisplayId, connection);
     }
@@ -383,6 +391,7 @@ public:
     }
 
     auto flushTransactionQueues() { return mFlinger->flushTransactionQueues(); };
+    auto transactionFlushNeeded() { return mFlinger->transactionFlushNeeded(); }
 
     auto onTransact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags) {
         return mFlinger->onTransact(code, data, reply, flags);
@@ -425,6 +434,7 @@ public:
     auto& mutableDisplayColorSetting() { return mFlinger->mDisplayColorSetting; }
     auto& mutableDisplays() { return mFlinger->mDisplays; }
     auto& mutableDrawingState() { return mFlinger->mDrawingState; }
+    auto& mutableDrawingLayersInZOrder() { return mFlinger->mDrawingLayersInZOrder; }
     auto& mutableEventQueue() { return mFlinger->mEventQueue; }
     auto& mutableGeometryInvalid() { return mFlinger->mGeometryInvalid; }
     auto& mutableInterceptor() { return mFlinger->mInterceptor; }
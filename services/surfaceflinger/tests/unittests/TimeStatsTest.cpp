@@ -32,6 +32,7 @@
 
 #include <chrono>
 #include <random>
+#include <thread>
 #include <unordered_set>
 
 #include "libsurfaceflinger_unittest_main.h"
@@ -1457,6 +1458,65 @@ TEST_F(TimeStatsTest, layerStatsCallback_limitsLayers) {
     EXPECT_EQ(atomList.atom(0).layer_name(), genLayerName(LAYER_ID_1));
 }
 
+TEST_F(TimeStatsTest, layerStatsCallback_recordsLayersFromConcurrentThreads) {
+    constexpr int32_t NUM_LAYERS_RECORDED = 4;
+    constexpr int32_t NUM_FRAMES = 100;
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    std::vector<std::thread> threads;
+    for (int32_t layerId = 0; layerId < NUM_LAYERS_RECORDED; layerId++) {
+        threads.emplace_back([this, layerId] {
+            for (int32_t frameNumber = 1; frameNumber <= NUM_FRAMES; frameNumber++) {
+                insertTimeRecord(NORMAL_SEQUENCE, layerId, frameNumber, frameNumber * 10000000);
+                // The layer stats only exist once a frame has been presented after the first.
+                if (frameNumber == 1) continue;
+                mTimeStats->incrementJankyFrames({kRefreshRate0, kRenderRate0, UID_0,
+                                                  genLayerName(layerId), kGameMode,
+                                                  JankType::AppDeadlineMissed, 0, 0, 0});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::string pulledData;
+    EXPECT_TRUE(mTimeStats->onPullAtom(10063 /*SURFACEFLINGER_STATS_LAYER_INFO*/, &pulledData));
+
+    SurfaceflingerStatsLayerInfoWrapper atomList;
+    ASSERT_TRUE(atomList.ParseFromString(pulledData));
+    ASSERT_EQ(atomList.atom_size(), NUM_LAYERS_RECORDED);
+    for (const auto& atom : atomList.atom()) {
+        EXPECT_EQ(atom.total_frames(), NUM_FRAMES - 1);
+        EXPECT_EQ(atom.total_janky_frames(), NUM_FRAMES - 1);
+        EXPECT_THAT(atom.present_to_present(),
+                    HistogramEq(buildExpectedHistogram({10}, {NUM_FRAMES - 1})));
+    }
+}
+
+TEST_F(TimeStatsTest, globalStatsCallback_sumsJankOfAllUids) {
+    EXPECT_TRUE(inputCommand(InputCommand::ENABLE, FMT_STRING).empty());
+
+    for (uid_t uid = UID_0; uid < UID_0 + 3; uid++) {
+        mTimeStats->incrementJankyFrames({kRefreshRate0, kRenderRate0, uid,
+                                          genLayerName(LAYER_ID_0), kGameMode,
+                                          JankType::SurfaceFlingerCpuDeadlineMissed, 1'000'000,
+                                          0, 0});
+    }
+
+    std::string pulledData;
+    EXPECT_TRUE(mTimeStats->onPullAtom(10062 /*SURFACEFLINGER_STATS_GLOBAL_INFO*/, &pulledData));
+
+    SurfaceflingerStatsGlobalInfoWrapper atomList;
+    ASSERT_TRUE(atomList.ParseFromString(pulledData));
+    ASSERT_EQ(atomList.atom_size(), 1);
+    const SurfaceflingerStatsGlobalInfo& atom = atomList.atom(0);
+    EXPECT_EQ(atom.total_timeline_frames(), 3);
+    EXPECT_EQ(atom.total_janky_frames(), 3);
+    EXPECT_EQ(atom.total_janky_frames_with_long_cpu(), 3);
+    EXPECT_THAT(atom.sf_deadline_misses(), HistogramEq(buildExpectedHistogram({1}, {3})));
+}
+
 TEST_F(TimeStatsTest, canSurviveMonkey) {
     if (g_noSlowTests) {
         GTEST_SKIP();
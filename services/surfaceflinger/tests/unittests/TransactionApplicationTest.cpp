@@ -24,8 +24,11 @@
 #include <gtest/gtest.h>
 #include <gui/SurfaceComposerClient.h>
 #include <log/log.h>
+#include <ui/Fence.h>
 #include <utils/String8.h>
 
+#include <unistd.h>
+
 #include "TestableScheduler.h"
 #include "TestableSurfaceFlinger.h"
 #include "mock/MockEventThread.h"
@@ -36,6 +39,7 @@ namespace android {
 
 using testing::_;
 using testing::Return;
+using testing::SaveArg;
 
 using FakeHwcDisplayInjector = TestableSurfaceFlinger::FakeHwcDisplayInjector;
 
@@ -150,8 +154,7 @@ public:
             EXPECT_LE(returnedTime, applicationTime + s2ns(5));
         }
         // Each transaction should have been placed on the transaction queue
-        auto transactionQueue = mFlinger.getTransactionQueue();
-        EXPECT_EQ(1u, transactionQueue.size());
+        EXPECT_EQ(1u, mFlinger.getTransactionQueue().size());
     }
 
     void PlaceOnTransactionQueue(uint32_t flags, bool syncInputWindows) {
@@ -180,8 +183,7 @@ public:
             EXPECT_LE(returnedTime, applicationSentTime + s2ns(5));
         }
         // This transaction should have been placed on the transaction queue
-        auto transactionQueue = mFlinger.getTransactionQueue();
-        EXPECT_EQ(1u, transactionQueue.size());
+        EXPECT_EQ(1u, mFlinger.getTransactionQueue().size());
     }
 
     void BlockedByPriorTransaction(uint32_t flags, bool syncInputWindows) {
@@ -269,7 +271,8 @@ TEST_F(TransactionApplicationTest, Flush_RemovesFromQueue) {
     auto& transactionQueue = mFlinger.getTransactionQueue();
     ASSERT_EQ(1u, transactionQueue.size());
 
-    auto& transactionState = transactionQueue.front();
+    ASSERT_NE(nullptr, transactionQueue.peek());
+    auto& transactionState = *transactionQueue.peek();
     checkEqual(transactionA, transactionState);
 
     // because flushing uses the cached expected present time, we send an empty
@@ -325,6 +328,83 @@ TEST_F(TransactionApplicationTest, BlockWithPriorTransaction_SyncInputWindows) {
     BlockedByPriorTransaction(/*flags*/ 0, /*syncInputWindows*/ true);
 }
 
+TEST_F(TransactionApplicationTest, UnsignaledFence_WaitsForSignalInsteadOfPolling) {
+    // A pipe stands in for a sync fence, which polls readable once signaled.
+    int fds[2];
+    ASSERT_EQ(0, pipe(fds));
+    sp<Fence> fence = new Fence(fds[0]);
+    ASSERT_EQ(Fence::Status::Unsignaled, fence->getStatus());
+
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(testing::AtLeast(1));
+
+    TransactionInfo transaction;
+    setupSingle(transaction, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ systemTime(), /*isAutoTimestamp*/ true, FrameTimelineInfo{});
+    ComposerState composerState;
+    composerState.state.what = layer_state_t::eAcquireFenceChanged;
+    composerState.state.acquireFence = fence;
+    transaction.states.add(composerState);
+
+    mFlinger.setTransactionState(transaction.frameTimelineInfo, transaction.states,
+                                 transaction.displays, transaction.flags, transaction.applyToken,
+                                 transaction.inputWindowCommands, transaction.desiredPresentTime,
+                                 transaction.isAutoTimestamp, transaction.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks, transaction.id);
+
+    std::function<void()> onSignaled;
+    EXPECT_CALL(*mMessageQueue, waitForFence(fence, _)).WillOnce(SaveArg<1>(&onSignaled));
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(1u, mFlinger.getPendingTransactionQueue().size());
+
+    // The parked transaction neither asks for another flush, nor is re-evaluated by one.
+    EXPECT_FALSE(mFlinger.transactionFlushNeeded());
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(1u, mFlinger.getPendingTransactionQueue().size());
+
+    const char signal = 0;
+    ASSERT_EQ(1, write(fds[1], &signal, 1));
+    ASSERT_TRUE(onSignaled);
+    onSignaled();
+    EXPECT_TRUE(mFlinger.transactionFlushNeeded());
+
+    mFlinger.flushTransactionQueues();
+    EXPECT_EQ(0u, mFlinger.getPendingTransactionQueue().size());
+    close(fds[1]);
+}
+
+TEST_F(TransactionApplicationTest, ResolvesStatesBeforeQueueing) {
+    EXPECT_CALL(*mMessageQueue, invalidate()).Times(1);
+
+    TransactionInfo transaction;
+    setupSingle(transaction, /*flags*/ 0, /*syncInputWindows*/ false,
+                /*desiredPresentTime*/ systemTime(), /*isAutoTimestamp*/ true, FrameTimelineInfo{});
+    ComposerState validState;
+    validState.state.what = layer_state_t::ePositionChanged | layer_state_t::eFrameRateChanged;
+    validState.state.frameRate = 60.f;
+    transaction.states.add(validState);
+    ComposerState invalidState;
+    invalidState.state.what = layer_state_t::ePositionChanged | layer_state_t::eFrameRateChanged;
+    invalidState.state.frameRate = -1.f;
+    transaction.states.add(invalidState);
+
+    mFlinger.setTransactionState(transaction.frameTimelineInfo, transaction.states,
+                                 transaction.displays, transaction.flags, transaction.applyToken,
+                                 transaction.inputWindowCommands, transaction.desiredPresentTime,
+                                 transaction.isAutoTimestamp, transaction.uncacheBuffer,
+                                 mHasListenerCallbacks, mCallbacks, transaction.id);
+
+    auto* transactionState = mFlinger.getTransactionQueue().peek();
+    ASSERT_NE(nullptr, transactionState);
+    const auto& resolvedStates = transactionState->resolvedStates;
+    ASSERT_EQ(2u, resolvedStates.size());
+
+    // There is no layer behind a null handle, and invalid frame rates are dropped up front.
+    EXPECT_EQ(nullptr, resolvedStates[0].layer.promote());
+    EXPECT_EQ(validState.state.what, resolvedStates[0].what);
+    EXPECT_EQ(static_cast<uint64_t>(layer_state_t::ePositionChanged), resolvedStates[1].what);
+    EXPECT_EQ(nullptr, resolvedStates[1].buffer);
+}
+
 TEST_F(TransactionApplicationTest, FromHandle) {
     sp<IBinder> badHandle;
     auto ret = mFlinger.fromHandle(badHandle);
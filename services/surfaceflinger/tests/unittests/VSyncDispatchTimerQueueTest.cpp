@@ -963,6 +963,35 @@ TEST_F(VSyncDispatchTimerQueueTest, updatesVsyncTimeForCloseWakeupTime) {
     EXPECT_THAT(cb.mReadyTime[0], Eq(2000));
 }
 
+TEST_F(VSyncDispatchTimerQueueTest, dispatchesManyCallbacksInWakeupOrder) {
+    std::vector<std::unique_ptr<CountingCallback>> callbacks;
+    for (int i = 0; i < 8; i++) {
+        callbacks.push_back(std::make_unique<CountingCallback>(mDispatch));
+        const auto result = mDispatch.schedule(*callbacks.back(),
+                                               {.workDuration = 100 + 10 * i,
+                                                .readyDuration = 0,
+                                                .earliestVsync = 1000});
+        EXPECT_TRUE(result.has_value());
+        EXPECT_EQ(900 - 10 * i, *result);
+    }
+
+    EXPECT_EQ(mDispatch.cancel(*callbacks[3]), CancelResult::Cancelled);
+    const auto result = mDispatch.schedule(*callbacks[0],
+                                           {.workDuration = 200,
+                                            .readyDuration = 0,
+                                            .earliestVsync = 1000});
+    EXPECT_TRUE(result.has_value());
+    EXPECT_EQ(800, *result);
+
+    for (const int i : {0, 7, 6, 5, 4, 2, 1}) {
+        advanceToNextCallback();
+        ASSERT_THAT(callbacks[i]->mWakeupTime.size(), Eq(1)) << "callback " << i;
+        EXPECT_THAT(callbacks[i]->mWakeupTime[0], Eq(i == 0 ? 800 : 900 - 10 * i));
+        EXPECT_THAT(callbacks[i]->mCalls[0], Eq(1000));
+    }
+    EXPECT_THAT(callbacks[3]->mCalls.size(), Eq(0));
+}
+
 class VSyncDispatchTimerQueueEntryTest : public testing::Test {
 protected:
     nsecs_t const mPeriod = 1000;
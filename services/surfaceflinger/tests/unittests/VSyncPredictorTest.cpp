@@ -532,6 +532,37 @@ TEST_F(VSyncPredictorTest, robustToDuplicateTimestamps_60hzRealTraceData) {
     EXPECT_THAT(intercept, IsCloseTo(expectedIntercept, mMaxRoundingError));
 }
 
+TEST_F(VSyncPredictorTest, keepsExactModelAcrossHistoryWraparound) {
+    auto const changedPeriod = 1234;
+    auto const bias = 10;
+    tracker.setPeriod(changedPeriod);
+
+    for (auto const& timestamp : generateVsyncTimestamps(kHistorySize * 10, changedPeriod, bias)) {
+        EXPECT_TRUE(tracker.addVsyncTimestamp(timestamp));
+    }
+    auto [slope, intercept] = tracker.getVSyncPredictionModel();
+    EXPECT_THAT(slope, Eq(changedPeriod));
+    EXPECT_THAT(intercept, Eq(0));
+}
+
+TEST_F(VSyncPredictorTest, dumpsPredictionError) {
+    auto constexpr idealPeriod = 16'666'666;
+    tracker.setPeriod(idealPeriod);
+
+    auto const vsyncs = generateVsyncTimestamps(kMinimumSamplesForPrediction + 1, idealPeriod, 0);
+    for (auto const& timestamp : vsyncs) {
+        tracker.addVsyncTimestamp(timestamp);
+    }
+    std::string dump;
+    tracker.dump(dump);
+    EXPECT_THAT(dump, HasSubstr("Prediction error: 1 vsyncs, mean = 0.000ms, max = 0.000ms"));
+
+    tracker.addVsyncTimestamp(vsyncs.back() + idealPeriod + 2'000'000);
+    dump.clear();
+    tracker.dump(dump);
+    EXPECT_THAT(dump, HasSubstr("Prediction error: 2 vsyncs, mean = 1.000ms, max = 2.000ms"));
+}
+
 } // namespace android::scheduler
 
 // TODO(b/129481165): remove the #pragma below and fix conversion issues
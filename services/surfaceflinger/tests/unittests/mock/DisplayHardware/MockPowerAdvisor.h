@@ -33,6 +33,10 @@ public:
     MOCK_METHOD0(isUsingExpensiveRendering, bool());
     MOCK_METHOD0(notifyDisplayUpdateImminent, void());
     MOCK_METHOD0(canNotifyDisplayUpdateImminent, bool());
+    MOCK_METHOD1(startPowerHintSession, void(const std::vector<int32_t>& threadIds));
+    MOCK_METHOD0(isPowerHintSessionRunning, bool());
+    MOCK_METHOD1(setTargetWorkDuration, void(int64_t targetDurationNanos));
+    MOCK_METHOD2(sendActualWorkDuration, void(int64_t actualDurationNanos, nsecs_t timestamp));
 };
 
 } // namespace android::Hwc2::mock
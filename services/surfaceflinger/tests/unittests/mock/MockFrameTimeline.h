@@ -35,6 +35,7 @@ public:
     MOCK_METHOD3(setSfPresent,
                  void(nsecs_t, const std::shared_ptr<FenceTime>&,
                       const std::shared_ptr<FenceTime>&));
+    MOCK_METHOD2(setGpuDuration, void(nsecs_t, nsecs_t));
     MOCK_METHOD1(computeFps, float(const std::unordered_set<int32_t>&));
 };
 
@@ -41,6 +41,7 @@ public:
                       std::chrono::nanoseconds));
     MOCK_METHOD1(setDuration, void(std::chrono::nanoseconds workDuration));
     MOCK_METHOD0(nextExpectedInvalidate, std::optional<std::chrono::steady_clock::time_point>());
+    MOCK_METHOD2(waitForFence, void(const sp<Fence>&, std::function<void()>));
 };
 
 } // namespace android::mock
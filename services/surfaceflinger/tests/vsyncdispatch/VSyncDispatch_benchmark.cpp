@@ -0,0 +1,173 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Scheduler/TimeKeeper.h"
+#include "Scheduler/VSyncDispatchTimerQueue.h"
+#include "Scheduler/VSyncTracker.h"
+
+namespace android::scheduler {
+namespace {
+
+constexpr nsecs_t kPeriod = 16'666'667;
+constexpr nsecs_t kTimerSlack = 500'000;
+constexpr nsecs_t kMinVsyncDistance = 3'000'000;
+
+class FixedRateTracker : public VSyncTracker {
+public:
+    bool addVsyncTimestamp(nsecs_t) final { return true; }
+
+    nsecs_t nextAnticipatedVSyncTimeFrom(nsecs_t timePoint) const final {
+        return (timePoint + kPeriod - 1) / kPeriod * kPeriod;
+    }
+
+    nsecs_t currentPeriod() const final { return kPeriod; }
+    void setPeriod(nsecs_t) final {}
+    void resetModel() final {}
+    bool needsMoreSamples() const final { return false; }
+    bool isVSyncInPhase(nsecs_t, Fps) const final { return true; }
+    void dump(std::string&) const final {}
+};
+
+// Fires the alarm on demand rather than from a timer thread.
+class ManualTimeKeeper : public TimeKeeper {
+public:
+    void alarmAt(std::function<void()> const& callback, nsecs_t time) final {
+        mCallback = callback;
+        mAlarmTime = time;
+    }
+    void alarmCancel() final { mCallback = nullptr; }
+    nsecs_t now() const final { return mNow; }
+    void dump(std::string&) const final {}
+
+    void fire() {
+        mNow = std::max(mNow, mAlarmTime);
+        if (const auto callback = mCallback) {
+            callback();
+        }
+    }
+
+private:
+    std::function<void()> mCallback;
+    nsecs_t mAlarmTime = 0;
+    nsecs_t mNow = 0;
+};
+
+// Registers the given number of callbacks, with work durations spread over a vsync period, like
+// the app, sf and offset-based callbacks of several displays.
+class Dispatch {
+public:
+    explicit Dispatch(int64_t count)
+          : mTimeKeeper(new ManualTimeKeeper),
+            mDispatch(std::unique_ptr<TimeKeeper>(mTimeKeeper), mTracker, kTimerSlack,
+                      kMinVsyncDistance) {
+        for (int64_t i = 0; i < count; i++) {
+            const size_t index = mTokens.size();
+            auto callback = [this, index](nsecs_t, nsecs_t, nsecs_t) { mFired.push_back(index); };
+            mTokens.push_back(mDispatch.registerCallback(callback, "benchmark"));
+        }
+    }
+
+    ~Dispatch() {
+        for (const auto token : mTokens) {
+            mDispatch.unregisterCallback(token);
+        }
+    }
+
+    size_t size() const { return mTokens.size(); }
+
+    VSyncDispatch::ScheduleTiming timing(size_t index) const {
+        const auto workDuration = static_cast<nsecs_t>(index % 64) * kPeriod / 64;
+        return {.workDuration = workDuration, .readyDuration = 0, .earliestVsync = 0};
+    }
+
+    void schedule(size_t index) { mDispatch.schedule(mTokens[index], timing(index)); }
+    void cancel(size_t index) { mDispatch.cancel(mTokens[index]); }
+
+    void scheduleAll() {
+        for (size_t i = 0; i < size(); i++) schedule(i);
+    }
+
+    // Fires the next wakeup, and schedules the dispatched callbacks again for their next vsync.
+    void fire() {
+        mTimeKeeper->fire();
+        for (const auto index : mFired) schedule(index);
+        mFired.clear();
+    }
+
+private:
+    FixedRateTracker mTracker;
+    ManualTimeKeeper* const mTimeKeeper;
+    VSyncDispatchTimerQueue mDispatch;
+    std::vector<VSyncDispatch::CallbackToken> mTokens;
+    std::vector<size_t> mFired;
+};
+
+// Cost of a timer wakeup, which dispatches the callbacks that are due and rearms the timer.
+void BM_TimerCallback(benchmark::State& state) {
+    Dispatch dispatch(state.range(0));
+    dispatch.scheduleAll();
+    for (auto _ : state) {
+        dispatch.fire();
+    }
+}
+BENCHMARK(BM_TimerCallback)->RangeMultiplier(4)->Range(1, 1024);
+
+// Same, with only a few of the registered callbacks scheduled, as for idle displays or listeners.
+void BM_TimerCallbackMostlyIdle(benchmark::State& state) {
+    Dispatch dispatch(state.range(0));
+    for (size_t i = 0; i < std::min<size_t>(dispatch.size(), 4); i++) dispatch.schedule(i);
+    for (auto _ : state) {
+        dispatch.fire();
+    }
+}
+BENCHMARK(BM_TimerCallbackMostlyIdle)->RangeMultiplier(4)->Range(1, 1024);
+
+// Cost of rescheduling a callback for the vsync it is already armed for.
+void BM_Schedule(benchmark::State& state) {
+    Dispatch dispatch(state.range(0));
+    dispatch.scheduleAll();
+    size_t index = 0;
+    for (auto _ : state) {
+        dispatch.schedule(index);
+        index = (index + 1) % dispatch.size();
+    }
+}
+BENCHMARK(BM_Schedule)->RangeMultiplier(4)->Range(1, 1024);
+
+// Cost of cancelling and scheduling again a callback, cycling through all of them.
+void BM_CancelAndSchedule(benchmark::State& state) {
+    Dispatch dispatch(state.range(0));
+    dispatch.scheduleAll();
+    size_t index = 0;
+    for (auto _ : state) {
+        dispatch.cancel(index);
+        dispatch.schedule(index);
+        index = (index + 1) % dispatch.size();
+    }
+}
+BENCHMARK(BM_CancelAndSchedule)->RangeMultiplier(4)->Range(1, 1024);
+
+} // namespace
+} // namespace android::scheduler
+
+BENCHMARK_MAIN();
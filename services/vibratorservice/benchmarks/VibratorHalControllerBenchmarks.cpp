@@ -198,6 +198,30 @@ BENCHMARK_WRAPPER(VibratorBench, setAmplitudeCached, {
     }
 });
 
+BENCHMARK_WRAPPER(VibratorBench, setAmplitudeBatch, {
+    if (!hasCapabilities(vibrator::Capabilities::AMPLITUDE_CONTROL, state)) {
+        return;
+    }
+
+    auto duration = 6000s;
+    auto callback = []() {};
+    // A ramp of amplitude updates sent as a single controller call.
+    std::vector<vibrator::HalFunction<vibrator::HalResult<void>>> ramp;
+    for (auto amplitude : {0.25f, 0.5f, 0.75f, 1.0f}) {
+        ramp.push_back([amplitude](auto hal) { return hal->setAmplitude(amplitude); });
+    }
+
+    auto onResult =
+            halCall<void>(mController, [&](auto hal) { return hal->on(duration, callback); });
+    checkHalResult(onResult, state);
+
+    for (auto _ : state) {
+        auto ret = mController.doBatchWithRetry(ramp, "setAmplitudeBatch");
+        checkHalResult(ret, state);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(ramp.size()));
+});
+
 BENCHMARK_WRAPPER(VibratorBench, setExternalControl, {
     if (!hasCapabilities(vibrator::Capabilities::EXTERNAL_CONTROL, state)) {
         return;
@@ -75,6 +75,29 @@ public:
         return apply(halFn, HalResult<T>::unsupported(), functionName);
     }
 
+    /* Calls given HAL functions in order, on the same HAL connection, as a single controller call.
+     * Each function is retried like in doWithRetry, and the sequence stops at the first result
+     * that is not ok. Returns that result, or the result of the last function. This saves sending
+     * a sequence of effect operations through doWithRetry one by one. Parameter functionName is
+     * for logging purposes.
+     */
+    HalResult<void> doBatchWithRetry(const std::vector<HalFunction<HalResult<void>>>& halFns,
+                                     const char* functionName) {
+        std::shared_ptr<HalWrapper> hal = getConnectedHal();
+        if (hal == nullptr) {
+            ALOGV("Skipped %s because Vibrator HAL is not available", functionName);
+            return HalResult<void>::unsupported();
+        }
+        HalResult<void> result = HalResult<void>::ok();
+        for (const auto& halFn : halFns) {
+            result = applyWithRetry(hal.get(), halFn, functionName);
+            if (!result.isOk()) {
+                break;
+            }
+        }
+        return result;
+    }
+
 private:
     static constexpr int MAX_RETRIES = 1;
 
@@ -91,18 +114,18 @@ private:
      */
     template <typename T>
     T apply(const HalFunction<T>& halFn, T defaultValue, const char* functionName) {
-        if (!init()) {
+        std::shared_ptr<HalWrapper> hal = getConnectedHal();
+        if (hal == nullptr) {
             ALOGV("Skipped %s because Vibrator HAL is not available", functionName);
             return defaultValue;
         }
-        std::shared_ptr<HalWrapper> hal;
-        {
-            std::lock_guard<std::mutex> lock(mConnectedHalMutex);
-            hal = mConnectedHal;
-        }
+        return applyWithRetry(hal.get(), halFn, functionName);
+    }
 
+    template <typename T>
+    T applyWithRetry(HalWrapper* hal, const HalFunction<T>& halFn, const char* functionName) {
         for (int i = 0; i < MAX_RETRIES; i++) {
-            T result = halFn(hal.get());
+            T result = halFn(hal);
             if (result.checkAndLogFailure(functionName)) {
                 tryReconnect();
             } else {
@@ -110,7 +133,18 @@ private:
             }
         }
 
-        return halFn(hal.get());
+        return halFn(hal);
+    }
+
+    /* Returns the connected HAL, connecting to it first if needed, or nullptr if no HAL is
+     * available.
+     */
+    std::shared_ptr<HalWrapper> getConnectedHal() {
+        if (!init()) {
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(mConnectedHalMutex);
+        return mConnectedHal;
     }
 };
 
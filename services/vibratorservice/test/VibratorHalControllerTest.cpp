@@ -175,6 +175,50 @@ TEST_F(VibratorHalControllerTest, TestFailedApiResultReturnsSuccessAfterRetries)
     ASSERT_EQ(1, mConnectCounter);
 }
 
+TEST_F(VibratorHalControllerTest, TestBatchCallsAreForwardedInOrder) {
+    {
+        InSequence seq;
+        EXPECT_CALL(*mMockHal.get(), setAmplitude(Eq(0.5f)))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::ok()));
+        EXPECT_CALL(*mMockHal.get(), on(_, _))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::failed("message")));
+        EXPECT_CALL(*mMockHal.get(), tryReconnect()).Times(Exactly(1));
+        EXPECT_CALL(*mMockHal.get(), on(_, _))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::ok()));
+        EXPECT_CALL(*mMockHal.get(), setAmplitude(Eq(1.0f)))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::ok()));
+    }
+
+    auto result = mController->doBatchWithRetry(
+            {[](vibrator::HalWrapper* hal) { return hal->setAmplitude(0.5f); }, ON_FN,
+             [](vibrator::HalWrapper* hal) { return hal->setAmplitude(1.0f); }},
+            "batch");
+    ASSERT_TRUE(result.isOk());
+    ASSERT_EQ(1, mConnectCounter);
+}
+
+TEST_F(VibratorHalControllerTest, TestBatchStopsAtFirstResultNotOk) {
+    {
+        InSequence seq;
+        EXPECT_CALL(*mMockHal.get(), ping())
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::ok()));
+        EXPECT_CALL(*mMockHal.get(), setAmplitude(_))
+                .Times(Exactly(1))
+                .WillRepeatedly(Return(vibrator::HalResult<void>::unsupported()));
+    }
+
+    auto result = mController->doBatchWithRetry(
+            {PING_FN, [](vibrator::HalWrapper* hal) { return hal->setAmplitude(0.5f); }, OFF_FN},
+            "batch");
+    ASSERT_TRUE(result.isUnsupported());
+    ASSERT_EQ(1, mConnectCounter);
+}
+
 TEST_F(VibratorHalControllerTest, TestMultiThreadConnectsOnlyOnce) {
     ASSERT_EQ(0, mConnectCounter);
 
@@ -76,8 +76,17 @@ class Hal {
 
     int GetDebugReportIndex() const { return debug_report_index_; }
 
+    // Enumerates the instance extensions of the driver itself, like the HAL
+    // does. They can't change once the HAL is open, so they are only queried
+    // once per process rather than on each enumeration and instance creation.
+    VkResult EnumerateInstanceExtensions(uint32_t* count,
+                                         VkExtensionProperties* props) const;
+
    private:
-    Hal() : dev_(nullptr), debug_report_index_(-1) {}
+    Hal()
+        : dev_(nullptr),
+          debug_report_index_(-1),
+          instance_extensions_cached_(false) {}
     Hal(const Hal&) = delete;
     Hal& operator=(const Hal&) = delete;
 
@@ -89,6 +98,11 @@ class Hal {
 
     const hwvulkan_device_t* dev_;
     int debug_report_index_;
+
+    // The instance extensions of the driver, valid if
+    // instance_extensions_cached_ is set.
+    std::vector<VkExtensionProperties> instance_extensions_;
+    bool instance_extensions_cached_;
 };
 
 class CreateInfoWrapper {
@@ -321,6 +335,8 @@ void Hal::UnloadBuiltinDriver() {
 
     hal_.dev_ = nullptr;
     hal_.debug_report_index_ = -1;
+    hal_.instance_extensions_.clear();
+    hal_.instance_extensions_cached_ = false;
 }
 
 bool Hal::InitDebugReportIndex() {
@@ -333,19 +349,13 @@ bool Hal::InitDebugReportIndex() {
         return false;
     }
 
-    VkExtensionProperties* exts = reinterpret_cast<VkExtensionProperties*>(
-        malloc(sizeof(VkExtensionProperties) * count));
-    if (!exts) {
-        ALOGE("failed to allocate HAL instance extension array");
-        return false;
-    }
-
-    if (dev_->EnumerateInstanceExtensionProperties(nullptr, &count, exts) !=
-        VK_SUCCESS) {
+    std::vector<VkExtensionProperties> exts(count);
+    if (dev_->EnumerateInstanceExtensionProperties(nullptr, &count,
+                                                   exts.data()) != VK_SUCCESS) {
         ALOGE("failed to enumerate HAL instance extensions");
-        free(exts);
         return false;
     }
+    exts.resize(count);
 
     for (uint32_t i = 0; i < count; i++) {
         if (strcmp(exts[i].extensionName, VK_EXT_DEBUG_REPORT_EXTENSION_NAME) ==
@@ -355,11 +365,30 @@ bool Hal::InitDebugReportIndex() {
         }
     }
 
-    free(exts);
+    instance_extensions_ = std::move(exts);
+    instance_extensions_cached_ = true;
 
     return true;
 }
 
+VkResult Hal::EnumerateInstanceExtensions(uint32_t* count,
+                                          VkExtensionProperties* props) const {
+    if (!instance_extensions_cached_)
+        return dev_->EnumerateInstanceExtensionProperties(nullptr, count,
+                                                          props);
+
+    const uint32_t ext_count =
+        static_cast<uint32_t>(instance_extensions_.size());
+    if (!props) {
+        *count = ext_count;
+        return VK_SUCCESS;
+    }
+
+    *count = std::min(*count, ext_count);
+    std::copy_n(instance_extensions_.data(), *count, props);
+    return *count < ext_count ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
 CreateInfoWrapper::CreateInfoWrapper(const VkInstanceCreateInfo& create_info,
                                      uint32_t icd_api_version,
                                      const VkAllocationCallbacks& allocator)
@@ -540,8 +569,7 @@ VkResult CreateInfoWrapper::SanitizeExtensions() {
 
 VkResult CreateInfoWrapper::QueryExtensionCount(uint32_t& count) const {
     if (is_instance_) {
-        return Hal::Device().EnumerateInstanceExtensionProperties(
-            nullptr, &count, nullptr);
+        return Hal::Get().EnumerateInstanceExtensions(&count, nullptr);
     } else {
         const auto& driver = GetData(physical_dev_).driver;
         return driver.EnumerateDeviceExtensionProperties(physical_dev_, nullptr,
@@ -553,8 +581,7 @@ VkResult CreateInfoWrapper::EnumerateExtensions(
     uint32_t& count,
     VkExtensionProperties* props) const {
     if (is_instance_) {
-        return Hal::Device().EnumerateInstanceExtensionProperties(
-            nullptr, &count, props);
+        return Hal::Get().EnumerateInstanceExtensions(&count, props);
     } else {
         const auto& driver = GetData(physical_dev_).driver;
         return driver.EnumerateDeviceExtensionProperties(physical_dev_, nullptr,
@@ -954,10 +981,16 @@ VkResult EnumerateInstanceExtensionProperties(
         }
     }
 
-    ATRACE_BEGIN("driver.EnumerateInstanceExtensionProperties");
-    VkResult result = Hal::Device().EnumerateInstanceExtensionProperties(
-        pLayerName, pPropertyCount, pProperties);
-    ATRACE_END();
+    VkResult result;
+    if (pLayerName) {
+        ATRACE_BEGIN("driver.EnumerateInstanceExtensionProperties");
+        result = Hal::Device().EnumerateInstanceExtensionProperties(
+            pLayerName, pPropertyCount, pProperties);
+        ATRACE_END();
+    } else {
+        result = Hal::Get().EnumerateInstanceExtensions(pPropertyCount,
+                                                        pProperties);
+    }
 
     if (!pLayerName && (result == VK_SUCCESS || result == VK_INCOMPLETE)) {
         int idx = Hal::Get().GetDebugReportIndex();
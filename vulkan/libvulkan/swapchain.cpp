@@ -1616,6 +1616,12 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
     android_native_rect_t* rects = nullptr;
     uint32_t nrects = 0;
 
+    // The wait semaphores are waited on once for the whole present, by the
+    // release of the first image. The queue executes the releases in order, so
+    // the fences of the later images can't signal before those waits are done
+    // either, and the driver doesn't wait on each semaphore again per image.
+    uint32_t wait_semaphore_count = present_info->waitSemaphoreCount;
+
     for (uint32_t sc = 0; sc < present_info->swapchainCount; sc++) {
         Swapchain& swapchain =
             *SwapchainFromHandle(present_info->pSwapchains[sc]);
@@ -1630,11 +1636,13 @@ VkResult QueuePresentKHR(VkQueue queue, const VkPresentInfoKHR* present_info) {
 
         int fence = -1;
         result = dispatch.QueueSignalReleaseImageANDROID(
-            queue, present_info->waitSemaphoreCount,
-            present_info->pWaitSemaphores, img.image, &fence);
+            queue, wait_semaphore_count, present_info->pWaitSemaphores,
+            img.image, &fence);
         if (result != VK_SUCCESS) {
             ALOGE("QueueSignalReleaseImageANDROID failed: %d", result);
             swapchain_result = result;
+        } else {
+            wait_semaphore_count = 0;
         }
         if (img.release_fence >= 0)
             close(img.release_fence);